@@ -0,0 +1,360 @@
+//
+//  QuadTree.cpp
+//
+//  Native baseline for the Go and D concurrent models.  Runs the same
+//  depthTest/depthTestSerial experiments on a complete pointer quad tree:
+//  every leaf executes the dumby work and the time is compared to the
+//  serial traversal.
+//
+//  The concurrent test uses the WorkStealingPool of the QuadTree directory,
+//  every thread owns a deque and idle threads steal from the others, so there
+//  is no single shared queue serializing the producer like the Go channel.
+//  Two ways of handing out the work are supported:
+//
+//      -chunk=0    a task per node, internal nodes spawn a task for each
+//                  child so the traversal itself is spread over the threads
+//      -chunk=n    the caller traverses the tree and submits the leaves as
+//                  runs of n consecutive leaves, one task per run
+//
+//  Same command line arguments and csv output as goTree and dTree (times in
+//  microseconds):
+//
+//      ./QuadTree -case=0 -filename=depthTest4.csv -depth=11 -maxIter=1
+//                 -dumbyIter=60000 -numCores=4 [-chunk=0]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../../QuadTree/WorkStealingPool.h"
+
+using namespace std;
+
+
+/*
+ * This is the basic struct used to build the quad tree
+ * It contains pointers to each of its children (NULL if leaf)
+ * A pointer to its parent
+ * Which child of its parent (root defaults to -1)
+ * Its location in space, x,y is the lower left corner
+ * Its level in the tree
+ */
+
+struct Node {
+    Node * NE;
+    Node * NW;
+    Node * SW;
+    Node * SE;
+    Node * parent;
+    bool isLeaf;
+    double x, y, w, h;
+    int currentLevel;
+    int childType;
+};
+
+
+/*
+ * Constructs the complete quad tree to the desired level
+ * The pointer to the root is returned
+ */
+
+static Node * Construct(Node * par, double x, double y, double w, double h,
+                        int level, int CT, int levelRemaining){
+    Node * node         = new Node();
+    node->parent        = par;
+    node->x             = x;
+    node->y             = y;
+    node->w             = w;
+    node->h             = h;
+    node->currentLevel  = level;
+    node->childType     = CT;
+    node->isLeaf        = levelRemaining == 1;
+    if(node->isLeaf)
+        return node;
+
+    double hw = w/2.0, hh = h/2.0;
+    node->NE = Construct(node, x+hw, y+hh, hw, hh, level+1, 0, levelRemaining-1);
+    node->NW = Construct(node, x, y+hh, hw, hh, level+1, 1, levelRemaining-1);
+    node->SW = Construct(node, x, y, hw, hh, level+1, 2, levelRemaining-1);
+    node->SE = Construct(node, x+hw, y, hw, hh, level+1, 3, levelRemaining-1);
+    return node;
+}
+
+static void destroy(Node * node){
+    if(!node->isLeaf){
+        destroy(node->NE);
+        destroy(node->NW);
+        destroy(node->SW);
+        destroy(node->SE);
+    }
+    delete node;
+}
+
+
+/************************** Dumby work ***********************************/
+
+
+/*
+ * Simulates the work done on each leaf, the counter is volatile so the
+ * compiler keeps the empty loop
+ */
+
+static void dumby(Node *, int iter){
+    for(volatile int i = 0; i < iter; i++){
+        //dumby work
+    }
+}
+
+
+/*
+ * Executes the fake work serially
+ * Used to measure speedup
+ */
+
+static void dumbyWorkSerial(Node * node, int iter){
+    if(node->isLeaf){
+        dumby(node, iter);
+    } else {
+        dumbyWorkSerial(node->NE, iter);
+        dumbyWorkSerial(node->NW, iter);
+        dumbyWorkSerial(node->SW, iter);
+        dumbyWorkSerial(node->SE, iter);
+    }
+}
+
+
+/*
+ * Task per node, the children of an internal node are spawned on the deque
+ * of the thread running it and stolen by the idle threads
+ */
+
+static void addDumbyWork(WorkStealingPool& pool, Node * node, int iter){
+    if(node->isLeaf){
+        dumby(node, iter);
+    } else {
+        Node * children[4] = {node->NE, node->NW, node->SW, node->SE};
+        for(int i = 0; i < 4; i++){
+            Node * child = children[i];
+            pool.spawn([&pool, child, iter](){
+                addDumbyWork(pool, child, iter);
+            });
+        }
+    }
+}
+
+
+/*
+ * Chunked submission, the leaves are collected in traversal order and every
+ * run of chunk leaves becomes one task
+ */
+
+static void collectLeaves(Node * node, vector<Node*>& leaves){
+    if(node->isLeaf){
+        leaves.push_back(node);
+    } else {
+        collectLeaves(node->NE, leaves);
+        collectLeaves(node->NW, leaves);
+        collectLeaves(node->SW, leaves);
+        collectLeaves(node->SE, leaves);
+    }
+}
+
+static void addChunkedDumbyWork(WorkStealingPool& pool, Node * node,
+                                int iter, int chunk,
+                                vector<Node*>& leaves){
+    leaves.clear();
+    collectLeaves(node, leaves);
+    Node ** all = leaves.empty() ? NULL : &leaves[0];
+    size_t count = leaves.size();
+    for(size_t begin = 0; begin < count; begin += chunk){
+        size_t end = begin + chunk < count ? begin + chunk : count;
+        pool.spawn([all, begin, end, iter](){
+            for(size_t i = begin; i < end; i++)
+                dumby(all[i], iter);
+        });
+    }
+}
+
+static void dumbyWorkParallel(WorkStealingPool& pool, Node * node, int iter,
+                              int chunk, vector<Node*>& leaves){
+    if(chunk > 0)
+        addChunkedDumbyWork(pool, node, iter, chunk, leaves);
+    else
+        pool.spawn([&pool, node, iter](){ addDumbyWork(pool, node, iter); });
+    pool.wait();
+}
+
+
+/************************** Testing ***********************************/
+
+
+static int countNodes(Node * node){
+    if(node->isLeaf)
+        return 1;
+    return 1 + countNodes(node->NE) + countNodes(node->NW) +
+           countNodes(node->SW) + countNodes(node->SE);
+}
+
+static int countLeaves(Node * node){
+    if(node->isLeaf)
+        return 1;
+    return countLeaves(node->NE) + countLeaves(node->NW) +
+           countLeaves(node->SW) + countLeaves(node->SE);
+}
+
+/*
+ * Monotonic clock in microseconds
+ */
+static double now(){
+    return chrono::duration<double, micro>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static FILE * openOutput(const string& filename){
+    FILE * file = fopen(filename.c_str(), "w");
+    if(file == NULL){
+        perror(filename.c_str());
+        exit(1);
+    }
+    fprintf(file, "leaves,max depth,time,traversal,nodes\n");
+    return file;
+}
+
+
+/*
+ * Conducts the dumby work serially on trees of different depths
+ * The results are outputted to a csv file
+ */
+
+static void depthTestSerial(int level, int dumbyIter, int maxIter,
+                            const string& filename){
+    FILE * file = openOutput(filename);
+    for(int i = 4; i < level; i = i+2){
+        Node * root = Construct(NULL, -4.0, -4.0, 4.0, 4.0, 1, -1, i);
+
+        double start = now();
+        for(int k = 0; k < maxIter; k++)
+            dumbyWorkSerial(root, 0);
+        double tTime = (now() - start)/maxIter;
+
+        start = now();
+        for(int j = 0; j < maxIter; j++)
+            dumbyWorkSerial(root, dumbyIter);
+        double time = (now() - start)/maxIter;
+
+        fprintf(file, "%d,%d,%f,%f,%d\n", countLeaves(root), i, time, tTime,
+                countNodes(root));
+        destroy(root);
+    }
+    fclose(file);
+}
+
+
+/*
+ * Conducts the dumby work concurrently on trees of different depths
+ * The pool is created once, like the goroutines of the Go code its threads
+ * are started before the timing begins
+ */
+
+static void depthTest(int level, int dumbyIter, int maxIter,
+                      const string& filename, int cores, int chunk){
+    FILE * file = openOutput(filename);
+    WorkStealingPool pool(cores);
+    vector<Node*> leaves;
+    for(int i = 4; i < level; i = i+2){
+        Node * root = Construct(NULL, -4.0, -4.0, 4.0, 4.0, 1, -1, i);
+
+        //time traversal
+        double start = now();
+        for(int k = 0; k < maxIter; k++)
+            dumbyWorkParallel(pool, root, 0, chunk, leaves);
+        double tTime = (now() - start)/maxIter;
+        printf("traversal time: %f\n", tTime);
+
+        //timing the dumby work
+        start = now();
+        for(int j = 0; j < maxIter; j++)
+            dumbyWorkParallel(pool, root, dumbyIter, chunk, leaves);
+        double time = (now() - start)/maxIter;
+
+        fprintf(file, "%d,%d,%f,%f,%d\n", countLeaves(root), i, time, tTime,
+                countNodes(root));
+        destroy(root);
+    }
+    fclose(file);
+}
+
+
+/*
+ * Reads -name=value, returns false if the argument is not for name
+ */
+static bool flagValue(const char * arg, const char * name, const char *& value){
+    size_t length = strlen(name);
+    if(arg[0] != '-')
+        return false;
+    arg += (arg[1] == '-') ? 2 : 1; //accept -name and --name like go and d
+    if(strncmp(arg, name, length) != 0 || arg[length] != '=')
+        return false;
+    value = arg + length + 1;
+    return true;
+}
+
+int main(int argc, char ** argv){
+    int function    = 0;
+    string filename = "test";
+    int depth       = 0;
+    int maxIter     = 1;
+    int dumbyIter   = 1;
+    int numCores    = 1;
+    int chunk       = 0;
+
+    for(int a = 1; a < argc; a++){
+        const char * value;
+        if(flagValue(argv[a], "case", value))
+            function = atoi(value);
+        else if(flagValue(argv[a], "filename", value))
+            filename = value;
+        else if(flagValue(argv[a], "depth", value))
+            depth = atoi(value);
+        else if(flagValue(argv[a], "maxIter", value))
+            maxIter = atoi(value);
+        else if(flagValue(argv[a], "dumbyIter", value))
+            dumbyIter = atoi(value);
+        else if(flagValue(argv[a], "numCores", value))
+            numCores = atoi(value);
+        else if(flagValue(argv[a], "chunk", value))
+            chunk = atoi(value);
+        else
+            fprintf(stderr, "unknown argument %s\n", argv[a]);
+    }
+    if(maxIter < 1)
+        maxIter = 1;
+
+    switch(function){
+    case 0: //concurrent depth test
+        printf("Concurrent test\n");
+        depthTest(depth, dumbyIter, maxIter, filename, numCores, chunk);
+        break;
+    case 1: //sequential depth test
+        printf("Serial test\n");
+        depthTestSerial(depth, dumbyIter, maxIter, filename);
+        break;
+    case 2: { //time work
+        Node * node = Construct(NULL, -4.0, -4.0, 4.0, 4.0, 1, -1, 2);
+        double start = now();
+        for(int i = 0; i < 100; i++)
+            dumby(node, dumbyIter);
+        printf("Dummy Work: %f Iterations: %d\n", (now() - start)/100.0,
+               dumbyIter);
+        destroy(node);
+        break;
+    }
+    default:
+        printf("OOPS, bad function case\n");
+        break;
+    }
+    return 0;
+}
@@ -9,6 +9,7 @@ end='.csv' #data output file extension
 maxDepth=11 #maximum depth of the tree
 maxIter=1 #number of iterations of work queue
 dumbyIter=$1 #number of dummy iterations
+chunk=${2:-0} #leaves per batch, 0 hands out one leaf at a time
 
 
 #concurrent program
@@ -18,7 +19,7 @@ maxCores=33 #one more than max cores used, cores increase by powers of two
 
 while [ $COUNTER -lt $maxCores ]; do
 	file=$testName$COUNTER$end
-	./QuadTree --case=$func --filename=$file --depth=$maxDepth --maxIter=$maxIter --dumbyIter=$dumbyIter --numCores=$COUNTER
+	./QuadTree --case=$func --filename=$file --depth=$maxDepth --maxIter=$maxIter --dumbyIter=$dumbyIter --numCores=$COUNTER --chunk=$chunk
 	let COUNTER=COUNTER*2
 	sleep 10
 done
@@ -30,3 +31,14 @@ file=$testName$end
 ./QuadTree --case=$func --filename=$file --depth=$maxDepth --maxIter=$maxIter --dumbyIter=$dumbyIter  --numCores=1
 
 sleep 10
+
+#concurrent neighbor test, uncached, cached and subtree neighbors
+func=3
+COUNTER=1
+
+while [ $COUNTER -lt $maxCores ]; do
+	file='neighborTest'$COUNTER$end
+	./QuadTree --case=$func --filename=$file --depth=$maxDepth --maxIter=$maxIter --numCores=$COUNTER
+	let COUNTER=COUNTER*2
+	sleep 10
+done
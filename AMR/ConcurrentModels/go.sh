@@ -9,6 +9,7 @@ end='.csv' #data output file extension
 maxDepth=11 #maximum depth of the tree
 maxIter=1 #number of times to run the work queue
 dumbyIter=$1 #number of of dummy work iterations (command line argument)
+chunk=${2:-0} #leaves per batch, 0 hands out one leaf at a time
 
 #sequential program
 func=1
@@ -24,7 +25,18 @@ maxCores=33 #one more than max cores used, cores increase by powers of two
 
 while [ $COUNTER -lt $maxCores ]; do
 	file=$testName$COUNTER$end
-	./QuadTree -case=$func -filename=$file -depth=$maxDepth -maxIter=$maxIter -dumbyIter=$dumbyIter -numCores=$COUNTER
+	./QuadTree -case=$func -filename=$file -depth=$maxDepth -maxIter=$maxIter -dumbyIter=$dumbyIter -numCores=$COUNTER -chunk=$chunk
+	let COUNTER=COUNTER*2
+	sleep 10
+done
+
+#concurrent neighbor test, uncached, cached and subtree neighbors
+func=3
+COUNTER=1
+
+while [ $COUNTER -lt $maxCores ]; do
+	file='neighborTest'$COUNTER$end
+	./QuadTree -case=$func -filename=$file -depth=$maxDepth -maxIter=$maxIter -numCores=$COUNTER
 	let COUNTER=COUNTER*2
 	sleep 10
 done
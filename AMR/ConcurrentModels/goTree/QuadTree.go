@@ -6,6 +6,7 @@ import (
 	"time"
 	"os"
 	"flag"
+	"sync"
 )
 
 
@@ -310,13 +311,26 @@ func coarsen(node *Node) bool {
 
 func getNeighbors(node *Node, neighbors *[][]*Node) {
 
-	n 	:= *neighbors
 	if node.parent == nil {//parents have no neighbors
 		return  
 	}
 
 	//Get the neighbor slice of the parent node
 	parentsNeighbors := *getParentsNeighbors(node.parent)
+	
+	neighborsFromParent(node,parentsNeighbors,neighbors)
+}
+
+
+/*
+ * This function fills the neighbor slice of a node that has a parent from
+ * the neighbor slice of the parent
+ */
+
+func neighborsFromParent(node *Node, parentsNeighbors [][]*Node,
+		neighbors *[][]*Node) {
+
+	n 	:= *neighbors
 		
 	//How the neighbor slice is filled depends on its child type
 	switch node.childType {
@@ -568,13 +582,14 @@ type neighborWork struct {
  * have separate documentation
  */
 
-func addNeighborWork(queue chan *neighborWork, node *Node) {
+func addNeighborWork(queue chan *neighborWork, node *Node,
+		f func(*Node,*[][]*Node)) {
 	if node.isLeaf {
 		//create work which takes a node, function, and
 		//slice of slices to hold neighbors
 		w		:= new(neighborWork)
 		w.node		= node
-		w.function	= getNeighbors
+		w.function	= f
 
 		var s []*Node
 		n		:= make([][]*Node,4)
@@ -587,7 +602,7 @@ func addNeighborWork(queue chan *neighborWork, node *Node) {
 		//creat work as above and then recurse on children
 		w		:= new(neighborWork)
 		w.node		= node
-		w.function	= getNeighbors
+		w.function	= f
 
 		var s []*Node
 		n		:= make([][]*Node,4)
@@ -597,22 +612,23 @@ func addNeighborWork(queue chan *neighborWork, node *Node) {
 		w.neighbors 	= n
 		queue<-w
 
-		addNeighborWork(queue,node.NE)
-		addNeighborWork(queue,node.NW)
-		addNeighborWork(queue,node.SW)
-		addNeighborWork(queue,node.SE)
+		addNeighborWork(queue,node.NE,f)
+		addNeighborWork(queue,node.NW,f)
+		addNeighborWork(queue,node.SW,f)
+		addNeighborWork(queue,node.SE,f)
 	}
 }
 
-func neighborWorkParallel(node *Node,done chan int) {
+func neighborWorkParallel(node *Node, f func(*Node,*[][]*Node),
+		done chan int, cores int) {
 	queue	:= make(chan *neighborWork)
 
-	//number of cpus determines the number of go routines 
-	ncpu	:= runtime.NumCPU() 
+	//the cores determine the number of go routines 
+	ncpu	:= cores
 	runtime.GOMAXPROCS(ncpu)
 
 	spawnNeighborWorkers(queue,ncpu)	//set up ncpu number of go routines
-	addNeighborWork(queue,node) 		//add work to the queue
+	addNeighborWork(queue,node,f) 		//add work to the queue
 	finishedNeighbor(queue,ncpu) 		//finished adding work
 	
 	//all done finding neighbors, set info back to main
@@ -643,6 +659,167 @@ func finishedNeighbor(queue chan *neighborWork,ncpu int) {
 	}
 }
 
+
+/************************** Shared Neighbor Work ************************/
+
+
+/*
+ * getNeighbors finds the neighbors of the parent by recursing up to the
+ * root, for every node, so the four siblings of a parent compute the same
+ * slices of all its ancestors four times over.  The functions below share
+ * those slices between the workers instead.
+ *
+ * The cache holds the neighbor slice of each parent, computed once by the
+ * first child that asks for it (from the cached slice of its own parent)
+ * while its siblings wait for it.  The cached slices are only read after
+ * that, so the workers share them without locks.
+ */
+
+type cachedNeighbors struct {
+	once		sync.Once
+	neighbors	[][]*Node
+}
+
+type neighborCache struct {
+	entries		sync.Map	//*Node to *cachedNeighbors
+}
+
+
+/*
+ * Returns an empty slice of the north, south, east and west neighbors
+ */
+
+func newNeighbors() [][]*Node {
+	return make([][]*Node,4)
+}
+
+
+/*
+ * Returns the neighbor slice of the node, computed on the first call
+ */
+
+func (c *neighborCache) neighborsOf(node *Node) [][]*Node {
+	v,ok	:= c.entries.Load(node)
+	if !ok {
+		v,_	= c.entries.LoadOrStore(node,new(cachedNeighbors))
+	}
+	e	:= v.(*cachedNeighbors)
+	e.once.Do(func() {
+		n	:= newNeighbors()
+		c.getNeighbors(node,&n)
+		e.neighbors	= n
+	})
+	return e.neighbors
+}
+
+
+/*
+ * Same as getNeighbors, with the neighbors of the parent from the cache
+ */
+
+func (c *neighborCache) getNeighbors(node *Node, neighbors *[][]*Node) {
+	if node.parent == nil {//parents have no neighbors
+		return
+	}
+	neighborsFromParent(node,c.neighborsOf(node.parent),neighbors)
+}
+
+
+/*
+ * Fills the neighbors of every node of the subtree top down, each node from
+ * the neighbor slice of its parent just computed, so nothing is computed
+ * twice within the subtree
+ */
+
+func neighborSubtree(node *Node, parentsNeighbors [][]*Node) {
+	n	:= newNeighbors()
+	if node.parent != nil {
+		neighborsFromParent(node,parentsNeighbors,&n)
+	}
+	node.neighbors	= n
+
+	if !node.isLeaf {
+		neighborSubtree(node.NE,n)
+		neighborSubtree(node.NW,n)
+		neighborSubtree(node.SW,n)
+		neighborSubtree(node.SE,n)
+	}
+}
+
+
+/*
+ * Splits the tree breadth first until there are at least count subtrees or
+ * only leaves are left.  Returns the subtrees and the nodes above them
+ */
+
+func splitSubtrees(node *Node, count int) ([]*Node,[]*Node) {
+	subtrees	:= []*Node{node}
+	var above []*Node
+
+	for len(subtrees) < count {
+		var next []*Node
+		for _,n := range subtrees {
+			if n.isLeaf {
+				next	= append(next,n)
+			} else {
+				above	= append(above,n)
+				next	= append(next,n.NE,n.NW,n.SW,n.SE)
+			}
+		}
+		if len(next) == len(subtrees) { //only leaves left
+			break
+		}
+		subtrees	= next
+	}
+	return subtrees,above
+}
+
+
+const subtreesPerWorker = 8 //subtrees handed out per worker
+
+
+/*
+ * Finds the neighbors of every node with one work item per subtree instead
+ * of one per node.  The nodes above the subtrees take their slices from the
+ * cache, which also gives each subtree the slice of its parent, so the
+ * workers only do the top down work of their subtrees
+ */
+
+func neighborWorkSubtrees(node *Node, done chan int, cores int) {
+	ncpu	:= cores
+	runtime.GOMAXPROCS(ncpu)
+
+	cache		:= new(neighborCache)
+	subtrees,above	:= splitSubtrees(node,subtreesPerWorker*ncpu)
+	queue		:= make(chan *Node,len(subtrees))
+
+	var workers sync.WaitGroup
+	for i := 0; i < ncpu; i++ {
+		workers.Add(1)
+		go func() {
+			for subtree := range queue { //grab subtrees until closed
+				var pn [][]*Node
+				if subtree.parent != nil {
+					pn	= cache.neighborsOf(subtree.parent)
+				}
+				neighborSubtree(subtree,pn)
+			}
+			workers.Done()
+		}()
+	}
+
+	for _,subtree := range subtrees {
+		queue<-subtree
+	}
+	close(queue)		//all work has been added
+	workers.Wait()		//all finished finding neighbors
+
+	for _,n := range above { //the parents were computed by the cache
+		n.neighbors	= cache.neighborsOf(n)
+	}
+	done<-1
+}
+
 /*
  * This struct is passed to the work queue during the timing phase
  * It simulates very time consuming work that would occur at each leaf
@@ -732,6 +909,152 @@ func finishedDumby(queue chan *dumbyWork,ncpu int) {
 	}
 }
 
+
+/************************** Batched Work ********************************/
+
+
+/*
+ * The functions below hand the workers runs of leaves instead of one leaf
+ * per channel operation
+ *
+ * Every top-level subtree is traversed by its own goroutine, which collects
+ * the nodes in a batch and sends it to the buffered queue once it holds
+ * chunk leaves.  The queue is closed when every traversal is done and the
+ * workers stop after emptying it.
+ */
+
+const batchBuffer = 4 //batches buffered per worker
+
+
+/*
+ * This struct collects the nodes of one traversal goroutine
+ */
+
+type batcher struct {
+	queue	chan []*Node
+	batch	[]*Node
+	chunk	int
+}
+
+func newBatcher(queue chan []*Node, chunk int) *batcher {
+	b		:= new(batcher)
+	b.queue		= queue
+	b.chunk		= chunk
+	b.batch		= make([]*Node,0,chunk)
+	return b
+}
+
+func (b *batcher) add(node *Node) {
+	b.batch		= append(b.batch,node)
+	if len(b.batch) == b.chunk { //batch is full, send it to the workers
+		b.queue<-b.batch
+		b.batch	= make([]*Node,0,b.chunk)
+	}
+}
+
+func (b *batcher) flush() {
+	if len(b.batch) > 0 {
+		b.queue<-b.batch
+		b.batch	= nil
+	}
+}
+
+
+/*
+ * Same traversal as addDumbyWork, the leaves are added to the batch
+ */
+
+func addDumbyWorkBatched(b *batcher, node *Node) {
+	if node.isLeaf {
+		b.add(node)
+	} else {
+		addDumbyWorkBatched(b,node.NE)
+		addDumbyWorkBatched(b,node.NW)
+		addDumbyWorkBatched(b,node.SW)
+		addDumbyWorkBatched(b,node.SE)
+	}
+}
+
+
+/*
+ * Returns the subtrees traversed concurrently, the children of the node or
+ * the node itself if it is a leaf
+ */
+
+func topSubtrees(node *Node) []*Node {
+	if node.isLeaf {
+		return []*Node{node}
+	}
+	return []*Node{node.NE,node.NW,node.SW,node.SE}
+}
+
+
+/*
+ * Traverses each subtree with its own goroutine and executes f on every
+ * leaf with ncpu workers
+ * Returns once all of the work has been executed
+ */
+
+func batchWorkParallel(subtrees []*Node, f func(*Node), ncpu, chunk int) {
+	if chunk < 1 {
+		chunk = 1
+	}
+	queue	:= make(chan []*Node,batchBuffer*ncpu)
+
+	var workers sync.WaitGroup
+	spawnBatchWorkers(queue,f,ncpu,&workers)
+
+	var traversals sync.WaitGroup
+	for _,subtree := range subtrees {
+		traversals.Add(1)
+		go func(node *Node) {
+			b	:= newBatcher(queue,chunk)
+			addDumbyWorkBatched(b,node)
+			b.flush()
+			traversals.Done()
+		}(subtree)
+	}
+
+	traversals.Wait()	//all work has been added
+	close(queue)		//all done
+	workers.Wait()		//all finished updating
+}
+
+func spawnBatchWorkers(queue chan []*Node, f func(*Node), ncpu int,
+		workers *sync.WaitGroup) {
+	for i := 0; i < ncpu; i++ {
+		workers.Add(1)
+		go batchWorker(i,queue,f,workers)
+	}
+}
+
+func batchWorker(id int, queue chan []*Node, f func(*Node),
+		workers *sync.WaitGroup) {
+	for batch := range queue { //grab batches until the queue is closed
+		for _,node := range batch {
+			f(node)
+		}
+	}
+	workers.Done()
+}
+
+
+/*
+ * Batched version of dumbyWorkParallel
+ */
+
+func dumbyWorkParallelBatched(node *Node, iter int, f func(*Node,int),
+		done chan int, cores, chunk int) {
+	ncpu	:= cores
+	runtime.GOMAXPROCS(ncpu)
+
+	work	:= func(n *Node) {
+		f(n,iter)
+	}
+	batchWorkParallel(topSubtrees(node),work,ncpu,chunk)
+	done<-1
+}
+
 /*
  * This function conducts the dumby work serially on trees of different depths
  * Used for time testing
@@ -790,11 +1113,11 @@ func depthTestSerial(level, dumbyIter,maxIter int, filename string) {
  * This function conducts the dumby work concurrently  
  * on trees of different depths
  * 
- * Used for time testing
+ * Used for time testing, chunk > 0 uses the batched work queue
  * The results are outputted to a csv file
  */
 
-func depthTest(level,dumbyIter,maxIter int,filename string,cores int){
+func depthTest(level,dumbyIter,maxIter int,filename string,cores,chunk int){
 	file,err:= os.Create(filename);
 	check(err)
 	l:=[]byte("leaves,max depth,time,traversal,nodes\n")
@@ -821,7 +1144,11 @@ func depthTest(level,dumbyIter,maxIter int,filename string,cores int){
 		
 		startTime	:=time.Now()
 		for k := 0; k < maxIter; k++ {
-			go dumbyWorkParallel(root,0,dumby,done,cores)
+			if chunk > 0 {
+				go dumbyWorkParallelBatched(root,0,dumby,done,cores,chunk)
+			} else {
+				go dumbyWorkParallel(root,0,dumby,done,cores)
+			}
 			(<-done)
 		}
 		elapsedTime 	:= time.Since(startTime)/time.Microsecond
@@ -830,7 +1157,12 @@ func depthTest(level,dumbyIter,maxIter int,filename string,cores int){
 		//timing the dumby work
 		startTime	=time.Now()
 		for j := 0; j< maxIter; j++{
-			go dumbyWorkParallel(root,dumbyIter,dumby,done,cores)
+			if chunk > 0 {
+				go dumbyWorkParallelBatched(root,dumbyIter,dumby,done,
+				cores,chunk)
+			} else {
+				go dumbyWorkParallel(root,dumbyIter,dumby,done,cores)
+			}
 			(<-done)
 		}
 		elapsedTime	= time.Since(startTime)/time.Microsecond
@@ -846,6 +1178,115 @@ func depthTest(level,dumbyIter,maxIter int,filename string,cores int){
 }
 
 
+/*
+ * This function finds the neighbors of every node on trees of different
+ * depths: serially top down, and concurrently with a work item per node
+ * (each recursing to the root, or from the shared cache) and per subtree
+ *
+ * The concurrent neighbors are checked against the serial ones
+ * The results are outputted to a csv file
+ */
+
+func depthNeighborTest(level,maxIter int,filename string,cores int) {
+	file,err	:= os.Create(filename);
+	check(err)
+	l		:=[]byte("leaves,max depth,serial,uncached,cached,subtree,nodes\n")
+	file.Write(l)
+
+	for i := 4; i < level; i = i+2 {
+		//construct the tree
+		maxLevel 	= i;
+		root 		= Construct(nil,Geom{-4.0,-4.0,4.0,4.0},1,-1,i)
+		done		:= make(chan int)
+
+		sTime		:= timeNeighbors(maxIter,func() {
+			neighborSubtree(root,nil)
+		})
+		reference	:= collectNeighbors(root,nil)
+
+		uTime		:= timeNeighbors(maxIter,func() {
+			go neighborWorkParallel(root,getNeighbors,done,cores)
+			(<-done)
+		})
+		checkNeighbors(root,reference,"uncached")
+
+		cTime		:= timeNeighbors(maxIter,func() {
+			cache	:= new(neighborCache)
+			go neighborWorkParallel(root,cache.getNeighbors,done,cores)
+			(<-done)
+		})
+		checkNeighbors(root,reference,"cached")
+
+		tTime		:= timeNeighbors(maxIter,func() {
+			go neighborWorkSubtrees(root,done,cores)
+			(<-done)
+		})
+		checkNeighbors(root,reference,"subtree")
+
+		//write the data to the file
+		line	:=fmt.Sprintf("%d,%d,%f,%f,%f,%f,%d\n",countLeaves(root),i,
+		sTime,uTime,cTime,tTime,CountNodes(root))
+		l	=[]byte(line)
+		file.Write(l)
+	}
+}
+
+
+/*
+ * Returns the time of run in microseconds, averaged over maxIter runs
+ */
+
+func timeNeighbors(maxIter int, run func()) float32 {
+	startTime	:= time.Now()
+	for k := 0; k < maxIter; k++ {
+		run()
+	}
+	elapsedTime	:= time.Since(startTime)/time.Microsecond
+	return float32(elapsedTime)/float32(maxIter)
+}
+
+
+/*
+ * Adds the neighbor slices of the nodes of the subtree to the map
+ */
+
+func collectNeighbors(node *Node, m map[*Node][][]*Node) map[*Node][][]*Node {
+	if m == nil {
+		m	= make(map[*Node][][]*Node)
+	}
+	m[node]	= node.neighbors
+	if !node.isLeaf {
+		collectNeighbors(node.NE,m)
+		collectNeighbors(node.NW,m)
+		collectNeighbors(node.SW,m)
+		collectNeighbors(node.SE,m)
+	}
+	return m
+}
+
+
+/*
+ * Prints a message if the neighbors of a node of the tree are not those of
+ * the reference
+ */
+
+func checkNeighbors(node *Node, reference map[*Node][][]*Node, name string) {
+	for n,ref := range reference {
+		for i := 0; i < 4; i++ {
+			same	:= len(n.neighbors) == 4 &&
+				len(n.neighbors[i]) == len(ref[i])
+			for j := 0; same && j < len(ref[i]); j++ {
+				same	= n.neighbors[i][j] == ref[i][j]
+			}
+			if !same {
+				fmt.Println("Wrong neighbors: ",name,n.geo)
+				return
+			}
+		}
+	}
+}
+
+
 /************************** DEBUGGING ********************************/
 
 
@@ -965,6 +1406,7 @@ func main() {
 	maxIterPtr := flag.Int("maxIter",1,"number of iterations of test")
 	dumbyIterPtr := flag.Int("dumbyIter",1,"iterations of dumby work")
 	numCoresPtr := flag.Int("numCores",1,"cores used")
+	chunkPtr := flag.Int("chunk",0,"leaves per batch, 0 sends one leaf at a time")
 
 	flag.Parse() //parse command line arguments
 
@@ -981,7 +1423,8 @@ func main() {
 	switch *functionPtr {
 	case 0: //concurrent depth test
 		fmt.Println("Concurrent test")
-		depthTest(*depthPtr,*dumbyIterPtr,*maxIterPtr,*filenamePtr,*numCoresPtr)
+		depthTest(*depthPtr,*dumbyIterPtr,*maxIterPtr,*filenamePtr,*numCoresPtr,
+		*chunkPtr)
 	case 1: //sequential depth test
 		fmt.Println("Serial test")
 		depthTestSerial(*depthPtr,*dumbyIterPtr,*maxIterPtr,*filenamePtr)
@@ -994,6 +1437,9 @@ func main() {
 	       	}	
 	       	elapsedTime:=float32(time.Since(startTime)/time.Microsecond)/float32(100.0)
 		fmt.Println("Dummy Work: ",elapsedTime,"Iterations: ",w)
+	case 3: //concurrent neighbor test
+		fmt.Println("Neighbor test")
+		depthNeighborTest(*depthPtr,*maxIterPtr,*filenamePtr,*numCoresPtr)
 	}	
 }
 
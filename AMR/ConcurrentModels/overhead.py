@@ -7,8 +7,9 @@ from matplotlib.backends.backend_pdf import PdfPages
 import cPickle as pickle
 
 
+#The optional baseline is drawn with red triangles for the depths it shares
 def outputFigure(dataDic,filename,xRange,yRange,title,xLabel,yLabel,loc,
-		maxCores,line):
+		maxCores,line,baseDic=None):
 	fig = plt.figure()
 	fig.suptitle(title)
 	fig.set_tight_layout(True)
@@ -21,38 +22,56 @@ def outputFigure(dataDic,filename,xRange,yRange,title,xLabel,yLabel,loc,
 		title='Depth:'+ str(key)+',Leaves: '+str(dataDic[key][2])
             	pt.set_title(title)
 	    	pt.plot(dataDic[key][0],dataDic[key][1],'bs')
+		if baseDic is not None and key in baseDic:
+			pt.plot(baseDic[key][0],baseDic[key][1],'r^')
 	    	pt.axis([0,xRange,0,yRange])
 	    	if line:
 			pt.plot([0,maxCores+1],[0,maxCores+1])
 			plt.tight_layout()
 	fig.savefig(filename)
 
+#Percent overhead of each core count, returns the dictionary and the largest
+#overhead
+def computeOverhead(data):
+	overhead = {}
+	m = 0
+	for key in data.keys():
+		seqTime = data[key][3][0]
+		o = [x-seqTime for x in data[key][3]]
+		over = [(x/y)*100 for x,y in zip(o,data[key][1])]
+		overhead[key] = [data[key][0][1:],over[1:],data[key][2]]
+		m = max(m,max(over))
+	return overhead,m
+
 def main():
 	parser = argparse.ArgumentParser(description="command line args")
 	inputFiles = 4
 	outputFiles = 4
 	parser.add_argument('-i','--inputF',help='input file name',required=True)
 	parser.add_argument('-o','--output',help='output file name',required=True)
+	parser.add_argument('-b','--baseline',
+			help='input file prefix of the native baseline')
 	args = parser.parse_args()
 	inputFile = args.inputF
 	outputFile = args.output
+	baseFile = args.baseline
 
 	for f in range(1,inputFiles+1):
 		inFile = inputFile+str(f)+".p"
 		outFile = outputFile+str(f)+".png"
 
 		data = pickle.load(open(inFile,"rb"))
-		overhead = {}
 		figureLocation = 220
 		maxCores = 32
-		for key in data.keys():
-			seqTime = data[key][3][0]
-			o = [x-seqTime for x in data[key][3]]
-			over = [(x/y)*100 for x,y in zip(o,data[key][1])]
-			overhead[key] = [data[key][0][1:],over[1:],data[key][2]]
-			m = max(over)
+		overhead,m = computeOverhead(data)
+		baseOverhead = None
+		if baseFile is not None:
+			base = pickle.load(open(baseFile+str(f)+".p","rb"))
+			baseOverhead,baseMax = computeOverhead(base)
+			m = max(m,baseMax)
 		outputFigure(overhead,outFile,maxCores+1,m,"Overhead",'number of cores',
-				'percent overhead',figureLocation,maxCores,False)
+				'percent overhead',figureLocation,maxCores,False,
+				baseOverhead)
 		data.clear()
 		overhead.clear()
 
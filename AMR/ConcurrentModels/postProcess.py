@@ -9,6 +9,7 @@ import cPickle as pickle
 
 
 data={}
+baseline={} #native C++ results plotted next to every directory
 
 
 # Reads in the data from the file into a dictionary
@@ -19,7 +20,7 @@ data={}
 	# traversal time
 	# nodes
 	# key is the depth
-def readFile(filename,i,dNum):
+def readFile(filename,i,dNum,data=data):
 	f=open(filename,'rt')
 	reader=csv.reader(f)
 	next(reader,None) #skip header
@@ -37,9 +38,30 @@ def readFile(filename,i,dNum):
 			data[depth][3].append(tTime)
 			#could add panic if leaves don't match
 	
+#Reads the serial file and the file of each core count of a directory
+def readDirectory(directory,maxCores,dNum,data=data):
+	start=directory+'depthTest'
+	end='.csv'
+	readFile(start+end,0,dNum,data) #serial code
+	cores=1
+	while cores<maxCores+1:
+		readFile(start+str(cores)+end,cores,dNum,data)
+		cores=cores*2
+
+#Time of one core (index 1) or of the serial code (index 0) divided by the
+#time of each core count
+def speedUps(dataDic,index):
+	result = {}
+	for key in dataDic.keys():
+		ref = dataDic[key][1][index]
+		t = [ref/s for s in dataDic[key][1]]
+		result[key]=[dataDic[key][0][1:],t[1:],dataDic[key][2]]
+	return result
+
 #Output figures for data mapped with cores on x-axis
+#The optional baseline is drawn with red triangles for the depths it shares
 def outputFigure(dataDic,filename,xRange,yRange,title,xLabel,yLabel,loc,
-		maxCores,line):
+		maxCores,line,baseDic=None):
 
 	fig = plt.figure()
 	fig.suptitle(title)
@@ -53,6 +75,8 @@ def outputFigure(dataDic,filename,xRange,yRange,title,xLabel,yLabel,loc,
 		title='Depth: ' + str(key)+', Leaves: '+str(dataDic[key][2])
 		pt.set_title(title)
 		pt.plot(dataDic[key][0],dataDic[key][1],'bs')
+		if baseDic is not None and key in baseDic:
+			pt.plot(baseDic[key][0],baseDic[key][1],'r^')
 		pt.axis([0,xRange,0,yRange])
 		if line:
 			pt.plot([0,maxCores+1],[0,maxCores+1])
@@ -69,49 +93,42 @@ def main():
 			required=True)
 	parser.add_argument('-o','--output',help='output file name',
 			nargs=outFiles,required=True)
+	parser.add_argument('-b','--baseline',
+			help='directory of the native baseline (cppTree/)')
+	parser.add_argument('-p','--baselineData',
+			help='pickle file for the baseline dictionary')
 	args = parser.parse_args()
 	maxCores=args.maxCores
 	outputFiles=args.output
-	end='.csv'
 	directories=args.directories
 	indexOut = 0
 	figureLocation = 220
 	
+	baseSpeedUp = None
+	baseStrongScale = None
+	if args.baseline is not None:
+		readDirectory(args.baseline,maxCores,0,baseline)
+		baseSpeedUp = speedUps(baseline,0)
+		baseStrongScale = speedUps(baseline,1)
+		if args.baselineData is not None:
+			pickle.dump(baseline,open(args.baselineData,"wb"))
 
 	dircNum = 1
 	#print nodeTime
 	for directory in directories:
-		start=directory+'depthTest'
-		filename=start+end
-		readFile(filename,0,dircNum) #serial code
-		cores=1
-		while cores<maxCores+1:
-			filename = start+str(cores)+end
-			readFile(filename,cores,dircNum)
-			cores=cores*2
+		readDirectory(directory,maxCores,dircNum)
 	#	print nodeTime
-		speedUp = {}
-		for key in data.keys():
-			t=[]
-			seq = data[key][1][0]
-			for s in data[key][1]:
-				t.append(seq/s)
-			speedUp[key]=[data[key][0][1:],t[1:],data[key][2]]
+		speedUp = speedUps(data,0)
 		outputFigure(speedUp,outputFiles[indexOut],maxCores+1,maxCores+1,
 		"Speed up",'number of cores','speed up',figureLocation,maxCores,
-		True)
+		True,baseSpeedUp)
 		indexOut = indexOut+1
-		strongScale = {}
-		for key in data.keys():
-			t = []
-			one = data[key][1][1]
-			for s in data[key][1]:
-				t.append(one/s)
-			strongScale[key]=[data[key][0][1:],t[1:],data[key][2]]
+		strongScale = speedUps(data,1)
 
 		outputFigure(strongScale,outputFiles[indexOut],maxCores+1,
 				maxCores+1,"Strong Scaling",'number of cores',
-				'speed up',figureLocation,maxCores,True)
+				'speed up',figureLocation,maxCores,True,
+				baseStrongScale)
 		
 		indexOut=indexOut+1
 		
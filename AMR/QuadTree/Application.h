@@ -15,8 +15,24 @@
 
 #include <iostream>
 #include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
 
-#endif
+/*
+ * Axis aligned rectangle given by its lower left corner and its size, used to
+ * describe the regions of the tree that need to be updated
+ */
+struct Rect {
+    double x, y, width, height;
+    
+    Rect(double xStart, double yStart, double w, double h){
+        x       = xStart;
+        y       = yStart;
+        width   = w;
+        height  = h;
+    }
+};
 
 class Application {
 public:
@@ -26,6 +42,41 @@ public:
     virtual bool refine(double x, double y, double w, double h) = 0;
     virtual bool coarsen(double x, double y, double w, double h) = 0;
     
+    /*
+     * Batch versions of refine and coarsen used by the batched update, they
+     * evaluate n nodes stored as arrays of their coordinates.  The defaults
+     * just loop over the scalar versions, subclasses can override them with
+     * loops the compiler can vectorize.
+     */
+    virtual void refineBatch(const double* x, const double* y,
+                             const double* w, const double* h,
+                             bool* out, size_t n){
+        for(size_t i = 0; i < n; i++)
+            out[i] = refine(x[i],y[i],w[i],h[i]);
+    }
+    
+    virtual void coarsenBatch(const double* x, const double* y,
+                              const double* w, const double* h,
+                              bool* out, size_t n){
+        for(size_t i = 0; i < n; i++)
+            out[i] = coarsen(x[i],y[i],w[i],h[i]);
+    }
+    
+    /*
+     * Criteria for the cells of an Octree, (z, d) are the position and size
+     * along the third axis.  By default the criteria do not depend on z, so
+     * every 2D application extends through the volume as a prism.
+     */
+    virtual bool refine3D(double x, double y, double,
+                          double w, double h, double){
+        return refine(x,y,w,h);
+    }
+    
+    virtual bool coarsen3D(double x, double y, double,
+                           double w, double h, double){
+        return coarsen(x,y,w,h);
+    }
+    
 
 };
 
@@ -142,6 +193,7 @@ class Line : public Application {
 public:
     Line(Segment * segment){
         seg     = segment;
+        startSweep();
     }
     
     ~Line(){
@@ -192,10 +244,107 @@ public:
         return !(refine(x,y,w,h)); //the segment does not intersect the node
     }
     
+    /*
+     * Same intersection test as refine with the segment read once and the
+     * branches replaced by min/max so the loops vectorize
+     */
+    void refineBatch(const double* x, const double* y,
+                     const double* w, const double* h,
+                     bool* out, size_t n){
+        double x0       = seg->getx0();
+        double x1       = seg->getx1();
+        double y0       = seg->gety0();
+        double y1       = seg->gety1();
+        double dx       = x1 - x0;
+        
+        if(dx > 0){
+            double a    = (y1-y0)/dx;
+            double b    = y0 - a*x0;
+            for(size_t i = 0; i < n; i++){
+                double minX = std::max(x0, x[i]);
+                double maxX = std::min(x1, x[i]+w[i]);
+                double ya   = a*minX + b;
+                double yb   = a*maxX + b;
+                double minY = std::max(std::min(ya,yb), y[i]);
+                double maxY = std::min(std::max(ya,yb), y[i]+h[i]);
+                out[i]      = (minX < maxX) & (minY < maxY);
+            }
+        }
+        else {
+            for(size_t i = 0; i < n; i++){
+                double minX = std::max(x0, x[i]);
+                double maxX = std::min(x1, x[i]+w[i]);
+                double minY = std::max(y0, y[i]);
+                double maxY = std::min(y1, y[i]+h[i]);
+                out[i]      = (minX < maxX) & (minY < maxY);
+            }
+        }
+    }
+    
+    void coarsenBatch(const double* x, const double* y,
+                      const double* w, const double* h,
+                      bool* out, size_t n){
+        refineBatch(x,y,w,h,out,n);
+        for(size_t i = 0; i < n; i++)
+            out[i] = !out[i];
+    }
+    
     Segment * getSegment(){
         return seg;
     }
     
+    /*
+     * Appends rectangles covering the area swept by the segment between its
+     * position at the last call (or construction) and its current position,
+     * then starts a new sweep from the current position.  The x range is
+     * split into pieces so a diagonal segment is covered by a band of small
+     * rectangles instead of one bounding box.  Passing the rectangles to
+     * QuadTree::update revisits only the nodes the segment moved over.
+     */
+    void sweptArea(std::vector<Rect>& areas, int pieces = 16){
+        double minX = std::min(oldX0, seg->getx0());
+        double maxX = std::max(oldX1, seg->getx1());
+        double dx   = (maxX - minX)/pieces;
+        for(int i = 0; i < pieces; i++){
+            double xa   = minX + i*dx;
+            double xb   = (i == pieces-1) ? maxX : xa + dx;
+            double ys[4] = {yAt(oldX0,oldY0,oldX1,oldY1,xa),
+                            yAt(oldX0,oldY0,oldX1,oldY1,xb),
+                            yAt(seg->getx0(),seg->gety0(),
+                                seg->getx1(),seg->gety1(),xa),
+                            yAt(seg->getx0(),seg->gety0(),
+                                seg->getx1(),seg->gety1(),xb)};
+            double minY = *std::min_element(ys, ys+4);
+            double maxY = *std::max_element(ys, ys+4);
+            areas.push_back(Rect(xa, minY, xb-xa, maxY-minY));
+        }
+        startSweep();
+    }
+    
 private:
+    /*
+     * Remembers the current position of the segment as the start of a sweep
+     */
+    void startSweep(){
+        oldX0   = seg->getx0();
+        oldY0   = seg->gety0();
+        oldX1   = seg->getx1();
+        oldY1   = seg->gety1();
+    }
+    
+    /*
+     * y coordinate of the segment (x0,y0)-(x1,y1) at x, clamped to its ends
+     */
+    static double yAt(double x0, double y0, double x1, double y1, double x){
+        if(x1 <= x0 || x <= x0)
+            return y0;
+        if(x >= x1)
+            return y1;
+        return y0 + (y1-y0)*(x-x0)/(x1-x0);
+    }
+    
     Segment * seg;
+    double oldX0, oldY0, oldX1, oldY1; //position at the start of the sweep
 };
+
+#endif
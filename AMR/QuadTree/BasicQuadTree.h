@@ -0,0 +1,331 @@
+//
+//  BasicQuadTree.h
+//
+/*
+ * Quad tree with the criteria fixed at compile time.
+ *
+ * QuadTree decides whether to refine or coarsen a node with two virtual
+ * calls, its own refine/coarsen (overridden by OneLevel and Neighbor) and
+ * the Application's.  BasicQuadTree takes both as template parameters: the
+ * Criteria is an Application class (Line, Interaction, ...) that the tree
+ * holds by value, and the BalancePolicy is one of the global rules below.
+ * The calls to them are not virtual, so the compiler can inline the whole
+ * update.
+ *
+ * The nodes and the node pool are the same as QuadTree's, the traversals
+ * and the face neighbor finding follow QuadTree.  The QuadTree hierarchy
+ * stays the run time configurable version of this class.
+ */
+//
+
+#ifndef ____BasicQuadTree__
+#define ____BasicQuadTree__
+
+#include <vector>
+#include <new>
+#include "QuadTree.h"
+#include "NodePool.h"
+
+/*
+ * Global policies, each answers whether a node that passed the criteria
+ * may actually be refined or coarsened
+ */
+
+//no global restriction (QuadTree)
+struct NoBalance {
+    template <class Tree>
+    static bool refine(Tree&, Node *){ return true; }
+    template <class Tree>
+    static bool coarsen(Tree&, Node *){ return true; }
+};
+
+//only coarsen nodes whose siblings are leaves (OneLevel)
+struct OneLevelBalance {
+    template <class Tree>
+    static bool refine(Tree&, Node *){ return true; }
+    template <class Tree>
+    static bool coarsen(Tree&, Node * node){
+        return node->parent->NEChild->isLeaf && node->parent->NWChild->isLeaf &&
+               node->parent->SWChild->isLeaf && node->parent->SEChild->isLeaf;
+    }
+};
+
+//neighbors may differ by at most one level (Neighbor)
+struct NeighborBalance {
+    template <class Tree>
+    static bool refine(Tree& tree, Node * node){
+        std::vector<std::vector<Node*> > neighbors(4);
+        tree.getNeighbors(node, neighbors);
+        int newLevel = node->currentLevel + 1;
+        for(int direction = 0; direction < 4; direction++){
+            for(size_t i = 0; i < neighbors[direction].size(); i++){
+                if(abs(newLevel - neighbors[direction][i]->currentLevel) > 1)
+                    return false;
+            }
+        }
+        return true;
+    }
+    template <class Tree>
+    static bool coarsen(Tree& tree, Node * node){
+        return OneLevelBalance::coarsen(tree, node);
+    }
+};
+
+template <class Criteria, class BalancePolicy = NoBalance>
+class BasicQuadTree {
+public:
+
+    /*
+     * Same arguments as QuadTree, the criteria is copied into the tree
+     */
+    BasicQuadTree(double x, double y, double width, double height,
+                  int numCells, int max, const Criteria& criteria = Criteria())
+        : criteria(criteria){
+        root            = new Node(x, y, width, height, NULL, 0, -1,
+                                   &this->criteria);
+        maxLevel        = max;
+        int numLevels   = 0;
+        int i           = numCells;
+        while(i>>=1)
+            ++numLevels;
+        insert(root, numLevels/2);
+    }
+
+    ~BasicQuadTree(){
+        delete root; //the pool frees the rest
+    }
+
+    /*
+     * Refines and coarsens the tree until the criteria are met
+     */
+    void update(){
+        checkCriteria(root);
+    }
+
+    bool refine(Node * node){
+        return node->currentLevel < maxLevel &&
+               criteria.Criteria::refine(node->x,node->y,node->width,node->height) &&
+               BalancePolicy::refine(*this, node);
+    }
+
+    bool coarsen(Node * node){
+        return criteria.Criteria::coarsen(node->x,node->y,node->width,node->height) &&
+               BalancePolicy::coarsen(*this, node);
+    }
+
+    void refineNode(Node * node){
+        double x        = node->x;
+        double y        = node->y;
+        double w        = node->width/2.0;
+        double h        = node->height/2.0;
+        int newLevel    = node->currentLevel + 1;
+        Node * block    = pool.allocate();
+        node->NEChild   = new (&block[0]) Node(x+w,y+h,w,h,node,newLevel,0,node->app);
+        node->NWChild   = new (&block[1]) Node(x,y+h,w,h,node,newLevel,1,node->app);
+        node->SWChild   = new (&block[2]) Node(x,y,w,h,node,newLevel,2,node->app);
+        node->SEChild   = new (&block[3]) Node(x+w,y,w,h,node,newLevel,3,node->app);
+        node->isLeaf    = false;
+    }
+
+    void coarsenNode(Node * node){
+        destroyTree(node);
+        node->NEChild   = NULL;
+        node->NWChild   = NULL;
+        node->SWChild   = NULL;
+        node->SEChild   = NULL;
+        node->isLeaf    = true;
+    }
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    void findLeaves(std::vector<Node*>& leaves){
+        findLeavesHelper(leaves, root);
+    }
+
+    /*
+     * Face neighbors in the same layout as QuadTree::getNeighbors (north,
+     * south, east, west)
+     */
+    void getNeighbors(Node * node, std::vector<std::vector<Node*> >& neighbors){
+        for(int direction = 0; direction < 4; direction++){
+            Node * outer = sameSizeNeighbor(node, direction);
+            if(outer != NULL)
+                collectFace(outer, direction^1, neighbors[direction]);
+        }
+    }
+
+    Node * findNode(double x, double y){
+        Node * node = root;
+        while(!node->isLeaf){
+            bool east   = x >= node->x + node->width/2.0;
+            bool north  = y >= node->y + node->height/2.0;
+            if(north)
+                node = east ? node->NEChild : node->NWChild;
+            else
+                node = east ? node->SEChild : node->SWChild;
+        }
+        return node;
+    }
+
+    std::vector<double> getDimensions(){
+        std::vector<double> dims;
+        dims.push_back(root->x);
+        dims.push_back(root->y);
+        dims.push_back(root->width);
+        dims.push_back(root->height);
+        return dims;
+    }
+
+    int countNodes(){
+        return 1 + NodePool::BLOCK_SIZE*pool.getBlocksInUse();
+    }
+
+    //the live nodes, as QuadTree::storage
+    size_t storage(){
+        return sizeof(Node)*(1 + NodePool::BLOCK_SIZE*pool.getBlocksInUse());
+    }
+
+    //the root and all the slabs of the node pool
+    size_t reservedStorage(){
+        return sizeof(Node) + pool.getReservedBytes();
+    }
+
+    int getMaxLevel(){
+        return maxLevel;
+    }
+
+    void setMaxLevel(int level){
+        maxLevel = level;
+    }
+
+    Criteria& getCriteria(){
+        return criteria;
+    }
+
+private:
+    BasicQuadTree(const BasicQuadTree&);
+    BasicQuadTree& operator=(const BasicQuadTree&);
+
+    void insert(Node * node, int levelsRemaining){
+        if(levelsRemaining <= 0)
+            return;
+        refineNode(node);
+        insert(node->NEChild, levelsRemaining - 1);
+        insert(node->NWChild, levelsRemaining - 1);
+        insert(node->SWChild, levelsRemaining - 1);
+        insert(node->SEChild, levelsRemaining - 1);
+    }
+
+    void destroyTree(Node * node){
+        if(node->isLeaf)
+            return;
+        destroyTree(node->NEChild);
+        destroyTree(node->NWChild);
+        destroyTree(node->SWChild);
+        destroyTree(node->SEChild);
+        pool.release(node->NEChild);
+    }
+
+    void checkCriteria(Node * node){
+        if(node->isLeaf){
+            if(refine(node))
+                fullyRefine(node);
+        }
+        else if(coarsen(node))
+            coarsenNode(node);
+        else {
+            checkCriteria(node->NEChild);
+            checkCriteria(node->NWChild);
+            checkCriteria(node->SWChild);
+            checkCriteria(node->SEChild);
+        }
+    }
+
+    void fullyRefine(Node * node){
+        refineNode(node);
+        if(refine(node->NEChild))
+            fullyRefine(node->NEChild);
+        if(refine(node->NWChild))
+            fullyRefine(node->NWChild);
+        if(refine(node->SWChild))
+            fullyRefine(node->SWChild);
+        if(refine(node->SEChild))
+            fullyRefine(node->SEChild);
+    }
+
+    void findLeavesHelper(std::vector<Node*>& leaves, Node * node){
+        if(node->isLeaf)
+            leaves.push_back(node);
+        else {
+            findLeavesHelper(leaves, node->NEChild);
+            findLeavesHelper(leaves, node->NWChild);
+            findLeavesHelper(leaves, node->SWChild);
+            findLeavesHelper(leaves, node->SEChild);
+        }
+    }
+
+    /*
+     * Children are 0 - NE, 1 - NW, 2 - SW, 3 - SE and directions are
+     * 0 - N, 1 - S, 2 - E, 3 - W
+     */
+    static Node * child(Node * node, int type){
+        switch(type){
+            case 0: return node->NEChild;
+            case 1: return node->NWChild;
+            case 2: return node->SWChild;
+            default: return node->SEChild;
+        }
+    }
+
+    static bool onSide(int type, int direction){
+        static const bool sides[4][4] = {{true, false, true, false},
+                                         {true, false, false, true},
+                                         {false, true, false, true},
+                                         {false, true, true, false}};
+        return sides[type][direction];
+    }
+
+    //child type across the face in the given direction
+    static int mirror(int type, int direction){
+        static const int vertical[4]    = {3, 2, 1, 0};
+        static const int horizontal[4]  = {1, 0, 3, 2};
+        return (direction < 2) ? vertical[type] : horizontal[type];
+    }
+
+    /*
+     * The same size node across the face, or the leaf containing it when the
+     * tree is coarser there, NULL on the boundary
+     */
+    static Node * sameSizeNeighbor(Node * node, int direction){
+        if(node->parent == NULL)
+            return NULL;
+        if(!onSide(node->childType, direction))
+            return child(node->parent, mirror(node->childType, direction));
+        Node * outer = sameSizeNeighbor(node->parent, direction);
+        if(outer == NULL || outer->isLeaf)
+            return outer;
+        return child(outer, mirror(node->childType, direction));
+    }
+
+    //leaves of a node on its side facing the given direction
+    static void collectFace(Node * node, int direction, std::vector<Node*>& list){
+        if(node->isLeaf){
+            list.push_back(node);
+            return;
+        }
+        for(int type = 0; type < 4; type++){
+            if(onSide(type, direction))
+                collectFace(child(node, type), direction, list);
+        }
+    }
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    Criteria criteria;
+    Node * root;
+    NodePool pool;
+    int maxLevel;
+
+};
+
+#endif /* defined(____BasicQuadTree__) */
@@ -0,0 +1,326 @@
+//
+//  CompactQuadTree.cpp
+//
+//  See CompactQuadTree.h for more detailed comments
+//
+//
+
+#include <math.h>
+#include <time.h>
+#include "CompactQuadTree.h"
+
+using namespace std;
+
+const int CompactQuadTree::MAX_DEPTH;
+const uint32_t CompactQuadTree::ROOT;
+
+/*
+ * Offsets of the children inside a block are the QuadTree child types,
+ * 0 - NE, 1 - NW, 2 - SW, 3 - SE, these give their x and y bits
+ */
+static const uint32_t childXBit[4] = {1, 0, 0, 1};
+static const uint32_t childYBit[4] = {1, 1, 0, 0};
+
+static int childTypeOf(uint32_t xBit, uint32_t yBit){
+    if(yBit)
+        return xBit ? 0 : 1;
+    else
+        return xBit ? 3 : 2;
+}
+
+/*
+ * Constructor
+ */
+CompactQuadTree::CompactQuadTree(double x, double y, double width,
+                                 double height, int numCells, int max,
+                                 Application * application){
+    app             = application;
+    rootX           = x;
+    rootY           = y;
+    rootWidth       = width;
+    rootHeight      = height;
+    maxLevel        = (max > MAX_DEPTH) ? MAX_DEPTH : max;
+    time            = false;
+    totalCoarsen    = 0;
+    totalRefine     = 0;
+
+    CompactNode root = {0, 0, 0, 0, 0};
+    nodes.push_back(root);
+
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+
+    //uniform initial decomposition, refine level by level
+    vector<uint32_t> level(1, ROOT), next;
+    for(int l = 0; l < numLevels/2; l++){
+        next.clear();
+        for(size_t n = 0; n < level.size(); n++){
+            refineNode(level[n]);
+            for(int t = 0; t < 4; t++)
+                next.push_back(nodes[level[n]].children + t);
+        }
+        level.swap(next);
+    }
+}
+
+CompactQuadTree::~CompactQuadTree(){
+}
+
+/*
+ * Updates the tree using refinement and coarsening criteria
+ * Times the refinement and coarsening if time is true
+ */
+void CompactQuadTree::update(){
+    if(time){
+        totalRefine     = 0;
+        totalCoarsen    = 0;
+    }
+    checkCriteria(ROOT);
+}
+
+void CompactQuadTree::checkCriteria(uint32_t node){
+    double start = 0, finish;
+    if(isLeaf(node)){
+        if(refine(node)){
+            if(time)
+                start       = clock();
+            fullyRefine(node);
+            if(time){
+                finish      = clock();
+                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+            }
+        }
+    }
+    else if(coarsen(node)){
+        if(time)
+            start           = clock();
+        coarsenNode(node);
+        if(time){
+            finish          = clock();
+            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
+        }
+    }
+    else{
+        uint32_t first = nodes[node].children;
+        for(int t = 0; t < 4; t++)
+            checkCriteria(first + t);
+    }
+}
+
+void CompactQuadTree::fullyRefine(uint32_t node){
+    refineNode(node);
+    uint32_t first = nodes[node].children;
+    for(int t = 0; t < 4; t++){
+        if(refine(first + t))
+            fullyRefine(first + t);
+    }
+}
+
+bool CompactQuadTree::coarsen(uint32_t node){
+    double x, y, w, h;
+    getGeometry(node, x, y, w, h);
+    return app->coarsen(x,y,w,h);
+}
+
+bool CompactQuadTree::refine(uint32_t node){
+    if(nodes[node].level >= maxLevel)
+        return false;
+    double x, y, w, h;
+    getGeometry(node, x, y, w, h);
+    return app->refine(x,y,w,h);
+}
+
+/*
+ * Refines a leaf node by adding a block of four children, recycled blocks
+ * are used first
+ */
+void CompactQuadTree::refineNode(uint32_t node){
+    uint32_t first;
+    if(!freeBlocks.empty()){
+        first = freeBlocks.back();
+        freeBlocks.pop_back();
+    }
+    else {
+        first = nodes.size();
+        nodes.resize(first + 4);
+    }
+    CompactNode parent = nodes[node]; //copy, nodes may have moved
+    for(int t = 0; t < 4; t++){
+        CompactNode& child  = nodes[first + t];
+        child.ix            = 2*parent.ix + childXBit[t];
+        child.iy            = 2*parent.iy + childYBit[t];
+        child.children      = 0;
+        child.level         = parent.level + 1;
+        child.unused        = 0;
+    }
+    nodes[node].children = first;
+}
+
+/*
+ * Coarsens a node by returning all of its descendants to the free blocks
+ */
+void CompactQuadTree::coarsenNode(uint32_t node){
+    destroyTree(node);
+}
+
+void CompactQuadTree::destroyTree(uint32_t node){
+    uint32_t first = nodes[node].children;
+    if(first == 0)
+        return;
+    for(int t = 0; t < 4; t++)
+        destroyTree(first + t);
+    freeBlocks.push_back(first);
+    nodes[node].children = 0;
+}
+
+/***************************** ACCESSORS *********************************/
+
+bool CompactQuadTree::isLeaf(uint32_t node){
+    return nodes[node].children == 0;
+}
+
+int CompactQuadTree::getLevel(uint32_t node){
+    return nodes[node].level;
+}
+
+int CompactQuadTree::getChildType(uint32_t node){
+    if(nodes[node].level == 0)
+        return -1;
+    return childTypeOf(nodes[node].ix & 1, nodes[node].iy & 1);
+}
+
+uint32_t CompactQuadTree::getChild(uint32_t node, int childType){
+    return nodes[node].children + childType;
+}
+
+void CompactQuadTree::getGeometry(uint32_t node, double& x, double& y,
+                                  double& w, double& h){
+    const CompactNode& n = nodes[node];
+    w = ldexp(rootWidth, -n.level);
+    h = ldexp(rootHeight, -n.level);
+    x = rootX + n.ix*w;
+    y = rootY + n.iy*h;
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+int CompactQuadTree::getSizeRoot(){
+    return sizeof(CompactNode);
+}
+
+int CompactQuadTree::getMaxLevel(){
+    return maxLevel;
+}
+
+void CompactQuadTree::setMaxLevel(int level){
+    maxLevel = (level > MAX_DEPTH) ? MAX_DEPTH : level;
+}
+
+bool CompactQuadTree::getTime(){
+    return time;
+}
+
+void CompactQuadTree::setTime(bool t){
+    time = t;
+}
+
+double CompactQuadTree::getTotalCoarsen(){
+    return totalCoarsen;
+}
+
+double CompactQuadTree::getTotalRefine(){
+    return totalRefine;
+}
+
+int CompactQuadTree::countNodes(){
+    return nodes.size() - 4*freeBlocks.size();
+}
+
+//memory usage, including the recycled blocks
+int CompactQuadTree::storage(){
+    return nodes.capacity()*sizeof(CompactNode) +
+           freeBlocks.capacity()*sizeof(uint32_t);
+}
+
+std::vector<double> CompactQuadTree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(rootX);
+    dims.push_back(rootY);
+    dims.push_back(rootWidth);
+    dims.push_back(rootHeight);
+    return dims;
+}
+
+uint32_t CompactQuadTree::findNode(double x, double y){
+    double cells    = ldexp(1.0, MAX_DEPTH);
+    double fx       = floor((x - rootX)/rootWidth*cells);
+    double fy       = floor((y - rootY)/rootHeight*cells);
+    if(fx < 0) fx = 0;
+    if(fy < 0) fy = 0;
+    if(fx > cells-1) fx = cells-1;
+    if(fy > cells-1) fy = cells-1;
+    return descend((uint32_t)fx, (uint32_t)fy, MAX_DEPTH);
+}
+
+void CompactQuadTree::findLeaves(std::vector<uint32_t>& leaves){
+    findLeavesHelper(leaves, ROOT);
+}
+
+void CompactQuadTree::findLeavesHelper(std::vector<uint32_t>& leaves,
+                                       uint32_t node){
+    uint32_t first = nodes[node].children;
+    if(first == 0)
+        leaves.push_back(node);
+    else {
+        for(int t = 0; t < 4; t++)
+            findLeavesHelper(leaves, first + t);
+    }
+}
+
+/************************* NEIGHBOR FINDING ******************************/
+
+uint32_t CompactQuadTree::descend(uint32_t ix, uint32_t iy, int level){
+    uint32_t node = ROOT;
+    while(nodes[node].children != 0 && nodes[node].level < level){
+        int shift       = level - nodes[node].level - 1;
+        uint32_t xBit   = (ix >> shift) & 1;
+        uint32_t yBit   = (iy >> shift) & 1;
+        node            = nodes[node].children + childTypeOf(xBit, yBit);
+    }
+    return node;
+}
+
+void CompactQuadTree::getNeighbors(uint32_t node,
+                                   std::vector<std::vector<uint32_t> >& neighbors){
+    CompactNode n   = nodes[node];
+    if(n.level == 0) //we're at the root which has no neighbors
+        return;
+    uint32_t last   = (((uint32_t)1) << n.level) - 1;
+
+    if(n.iy < last) //north
+        collectSide(descend(n.ix, n.iy+1, n.level), 1, neighbors[0]);
+    if(n.iy > 0) //south
+        collectSide(descend(n.ix, n.iy-1, n.level), 0, neighbors[1]);
+    if(n.ix < last) //east
+        collectSide(descend(n.ix+1, n.iy, n.level), 3, neighbors[2]);
+    if(n.ix > 0) //west
+        collectSide(descend(n.ix-1, n.iy, n.level), 2, neighbors[3]);
+}
+
+/*
+ * Directions are 0 - N, 1 - S, 2 - E, 3 - W, the leaves of the node on its
+ * side facing the direction are the neighbors of the node on the other side
+ */
+void CompactQuadTree::collectSide(uint32_t node, int direction,
+                                  std::vector<uint32_t>& list){
+    static const int sides[4][2] = {{0,1},{2,3},{0,3},{1,2}};
+    uint32_t first = nodes[node].children;
+    if(first == 0)
+        list.push_back(node);
+    else {
+        collectSide(first + sides[direction][0], direction, list);
+        collectSide(first + sides[direction][1], direction, list);
+    }
+}
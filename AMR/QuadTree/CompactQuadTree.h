@@ -0,0 +1,166 @@
+//
+//  CompactQuadTree.h
+//
+/*
+ * Pointer free quad tree with a compact node layout.
+ *
+ * A Node of QuadTree stores its own Application pointer, four doubles of
+ * geometry and six pointers.  Here the tree holds the single Application and
+ * a node only stores its integer position (ix, iy) on the 2^level x 2^level
+ * grid of its level, the level itself and the index of its first child.  The
+ * geometry is computed from (level, ix, iy) when it is needed, the child type
+ * is given by the low bits of ix and iy, and the four children are stored
+ * next to each other so one index reaches all of them.  A node takes 16 bytes.
+ *
+ * Nodes live in one array and are referred to by index.  Indices stay valid
+ * while the tree grows, but the index of a node that is coarsened away will be
+ * reused by a later refinement.
+ */
+//
+
+#ifndef ____CompactQuadTree__
+#define ____CompactQuadTree__
+
+#include <vector>
+#include <stdint.h>
+#include "Application.h"
+
+struct CompactNode{
+    uint32_t ix; //position on the grid of this level
+    uint32_t iy;
+    uint32_t children; //index of the NE child, the others follow, 0 for a leaf
+    uint16_t level;
+    uint16_t unused;
+};
+
+class CompactQuadTree {
+public:
+
+    /*
+     * Deepest supported level, positions use 32 bit integers
+     */
+    static const int MAX_DEPTH = 31;
+
+    /*
+     * Index of the root node
+     */
+    static const uint32_t ROOT = 0;
+
+    /*
+     * Constructor with the same arguments as QuadTree
+     * the number of cells in the initial decomposition (must be a power of 4)
+     * the maximum level
+     */
+    CompactQuadTree(double x,double y, double width, double height,
+                    int numCells,int max,Application * app);
+
+    virtual ~CompactQuadTree();
+
+    /*
+     * Refines and coarsens the quadtree until the desired refinement is reached
+     */
+    void update();
+
+    /*
+     * Refines and coarsens the node
+     */
+    void refineNode(uint32_t node);
+    void coarsenNode(uint32_t node);
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(uint32_t node);
+    virtual bool coarsen(uint32_t node);
+
+    /*
+     * Node accessors, the child type follows QuadTree: 0 - NE, 1 - NW,
+     * 2 - SW, 3 - SE and -1 for the root
+     */
+    bool isLeaf(uint32_t node);
+    int getLevel(uint32_t node);
+    int getChildType(uint32_t node);
+    uint32_t getChild(uint32_t node, int childType);
+    void getGeometry(uint32_t node, double& x, double& y,
+                     double& w, double& h);
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns the indices of all the leaf nodes
+     */
+    void findLeaves(std::vector<uint32_t>& leaves);
+
+    /*
+     * Method for getting the face neighbors of a node, same layout as
+     * QuadTree::getNeighbors (north, south, east, west)
+     */
+    void getNeighbors(uint32_t node,
+                      std::vector<std::vector<uint32_t> >& neighbors);
+
+    std::vector<double> getDimensions();
+
+    /*
+     * Returns the memory used to store a single node
+     */
+    int getSizeRoot();
+
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    bool getTime();
+    void setTime(bool t);
+
+    double getTotalCoarsen();
+    double getTotalRefine();
+
+    /*
+     * Counts the number of nodes in the tree
+     */
+    int countNodes();
+
+    /*
+     * Returns the total amount of memory used to store the quad tree
+     */
+    int storage();
+
+    /*
+     * Finds the leaf node that contains the particular x,y point
+     */
+    uint32_t findNode(double x, double y);
+
+private:
+
+    void checkCriteria(uint32_t node);
+    void fullyRefine(uint32_t node);
+    void destroyTree(uint32_t node);
+    void findLeavesHelper(std::vector<uint32_t>& leaves, uint32_t node);
+
+    /*
+     * Descends from the root towards the cell (ix,iy) of the given level and
+     * returns the deepest node on the way, stopping at leaves
+     */
+    uint32_t descend(uint32_t ix, uint32_t iy, int level);
+
+    /*
+     * Collects the leaves of a node on the side facing the given direction
+     */
+    void collectSide(uint32_t node, int direction,
+                     std::vector<uint32_t>& list);
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<CompactNode> nodes;
+    std::vector<uint32_t> freeBlocks; //first index of blocks to reuse
+
+    Application * app;
+    double rootX, rootY, rootWidth, rootHeight;
+
+    int maxLevel;
+    bool time;
+    double totalCoarsen;
+    double totalRefine;
+
+};
+
+#endif /* defined(____CompactQuadTree__) */
@@ -0,0 +1,220 @@
+//
+//  CompositeApplication.h
+//
+/*
+ * Refinement and coarsening criteria combined from several Applications.
+ *
+ * A node is refined when any of the criteria refines it and coarsened when
+ * all of them coarsen it.  The criteria are evaluated in the order of their
+ * cost, cheapest first, and the evaluation stops at the first one that
+ * decides the answer, so an expensive criterion only runs on the nodes the
+ * cheap ones leave open.
+ *
+ * A criterion can be limited to a region: a node that does not touch it is
+ * neither refined nor kept from coarsening by that criterion, which is then
+ * not called at all.  An expensive criterion can also keep its last answers
+ * per cell, looked up from the cell's geometry, until changed() says that
+ * its answers may be different.  The caches are locked, so the composite
+ * can be used by the parallel update.
+ *
+ * The composite does not own the criteria.
+ */
+//
+
+#ifndef ____CompositeApplication__
+#define ____CompositeApplication__
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <stdint.h>
+#include <unordered_map>
+#include "Application.h"
+
+class CompositeApplication : public Application {
+public:
+
+    CompositeApplication(){
+        cacheLimit  = 1 << 20;
+    }
+
+    ~CompositeApplication(){}
+
+    /*
+     * Adds a criterion and returns its id.  cost only orders the criteria,
+     * region (copied, NULL for the whole domain) is where the criterion can
+     * refine or keep a node, cached keeps its answers per cell
+     */
+    int add(Application * app, double cost = 1.0, const Rect * region = NULL,
+            bool cached = false){
+        Criterion * c   = new Criterion();
+        c->app          = app;
+        c->cost         = cost;
+        c->hasRegion    = (region != NULL);
+        if(region != NULL)
+            c->region   = *region;
+        c->cached       = cached;
+        c->evaluations  = 0;
+        criteria.push_back(std::unique_ptr<Criterion>(c));
+
+        //cheapest first, criteria of the same cost in the order added
+        order.clear();
+        for(size_t i = 0; i < criteria.size(); i++)
+            order.push_back(criteria[i].get());
+        std::stable_sort(order.begin(), order.end(),
+                         [](const Criterion * a, const Criterion * b){
+                             return a->cost < b->cost;
+                         });
+        return int(criteria.size()) - 1;
+    }
+
+    /*
+     * The answers of criterion id (or of all of them) may have changed,
+     * drops their cached answers
+     */
+    void changed(int id){
+        Criterion * c = criteria[id].get();
+        std::lock_guard<std::mutex> guard(c->lock);
+        c->cache.clear();
+    }
+
+    void changed(){
+        for(size_t i = 0; i < criteria.size(); i++)
+            changed(int(i));
+    }
+
+    /*
+     * Largest number of cells cached per criterion, the cache of a criterion
+     * is dropped when it grows past it
+     */
+    void setCacheLimit(size_t entries){
+        cacheLimit  = entries;
+    }
+
+    /*
+     * Number of calls made to criterion id, cache hits and nodes outside its
+     * region aside
+     */
+    size_t getEvaluations(int id){
+        return criteria[id]->evaluations;
+    }
+
+    size_t size(){
+        return criteria.size();
+    }
+
+    bool refine(double x, double y, double w, double h){
+        for(size_t i = 0; i < order.size(); i++){
+            Criterion * c = order[i];
+            if(c->hasRegion && !touches(c->region, x, y, w, h))
+                continue;
+            if(evaluate(c, true, x, y, w, h))
+                return true;
+        }
+        return false;
+    }
+
+    bool coarsen(double x, double y, double w, double h){
+        for(size_t i = 0; i < order.size(); i++){
+            Criterion * c = order[i];
+            if(c->hasRegion && !touches(c->region, x, y, w, h))
+                continue;
+            if(!evaluate(c, false, x, y, w, h))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    /*
+     * A cell is identified by its lower left corner and size, the answers
+     * are -1 until the criterion is asked
+     */
+    struct CellKey {
+        double x, y, w, h;
+
+        bool operator==(const CellKey& other) const {
+            return x == other.x && y == other.y && w == other.w &&
+                   h == other.h;
+        }
+    };
+
+    struct CellKeyHash {
+        size_t operator()(const CellKey& key) const {
+            uint64_t bits[4];
+            memcpy(bits, &key, sizeof(bits));
+            uint64_t hash = bits[0];
+            for(int i = 1; i < 4; i++)
+                hash = (hash ^ bits[i]) * 0x9E3779B97F4A7C15ULL;
+            return size_t(hash ^ (hash >> 29));
+        }
+    };
+
+    struct CellAnswer {
+        signed char refine;
+        signed char coarsen;
+    };
+
+    struct Criterion {
+        Application * app;
+        double cost;
+        bool hasRegion;
+        Rect region = Rect(0, 0, 0, 0);
+        bool cached;
+        std::atomic<size_t> evaluations;
+        std::unordered_map<CellKey, CellAnswer, CellKeyHash> cache;
+        std::mutex lock;
+    };
+
+    static bool touches(const Rect& r, double x, double y, double w,
+                        double h){
+        return x <= r.x + r.width && r.x <= x + w &&
+               y <= r.y + r.height && r.y <= y + h;
+    }
+
+    /*
+     * The refine (or coarsen) answer of a criterion, from its cache if it
+     * has one
+     */
+    bool evaluate(Criterion * c, bool refining, double x, double y, double w,
+                  double h){
+        if(!c->cached){
+            c->evaluations++;
+            return refining ? c->app->refine(x,y,w,h)
+                            : c->app->coarsen(x,y,w,h);
+        }
+        CellKey key = {x, y, w, h};
+        {
+            std::lock_guard<std::mutex> guard(c->lock);
+            auto found = c->cache.find(key);
+            if(found != c->cache.end()){
+                signed char answer = refining ? found->second.refine
+                                              : found->second.coarsen;
+                if(answer >= 0)
+                    return answer != 0;
+            }
+        }
+        c->evaluations++;
+        bool answer = refining ? c->app->refine(x,y,w,h)
+                               : c->app->coarsen(x,y,w,h);
+        std::lock_guard<std::mutex> guard(c->lock);
+        if(c->cache.size() >= cacheLimit)
+            c->cache.clear();
+        auto slot = c->cache.insert(std::make_pair(key, CellAnswer{-1, -1}));
+        if(refining)
+            slot.first->second.refine   = answer;
+        else
+            slot.first->second.coarsen  = answer;
+        return answer;
+    }
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<std::unique_ptr<Criterion> > criteria; //in the order added
+    std::vector<Criterion*> order; //cheapest first
+    size_t cacheLimit;
+};
+
+#endif /* defined(____CompositeApplication__) */
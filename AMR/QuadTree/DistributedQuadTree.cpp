@@ -0,0 +1,557 @@
+//
+//  DistributedQuadTree.cpp
+//
+//  See DistributedQuadTree.h for more detailed comments
+//
+//
+
+#include <algorithm>
+#include "DistributedQuadTree.h"
+
+using namespace std;
+
+const int DistributedQuadTree::MAX_DEPTH;
+
+/*
+ * Maps the Morton child index (bit 0 = east, bit 1 = north) to the childType
+ * numbering used by QuadTree (0 - NE, 1 - NW, 2 - SW, 3 - SE)
+ */
+static const int mortonToChildType[4] = {2, 3, 1, 0};
+
+/*
+ * Constructor
+ */
+DistributedQuadTree::DistributedQuadTree(double x, double y, double width,
+                                         double height, int numCells, int max,
+                                         Application * application,
+                                         MPI_Comm communicator){
+    comm                = communicator;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    app                 = application;
+    rootX               = x;
+    rootY               = y;
+    rootWidth           = width;
+    rootHeight          = height;
+    maxLevel            = (max > MAX_DEPTH) ? MAX_DEPTH : max;
+    imbalanceThreshold  = 0.1;
+    numRepartitions     = 0;
+    time                = false;
+    totalCoarsen        = 0;
+    totalRefine         = 0;
+    localBegin          = 0;
+
+    int numLevels       = 0; //stores the number of levels in the tree
+    int i               = numCells;
+    while(i>>=1)
+        ++numLevels;
+    int level           = numLevels/2;
+
+    //uniform initial decomposition, each rank takes an even share of the curve
+    uint64_t numLeaves  = ((uint64_t)1) << (2*level);
+    uint64_t first      = numLeaves*rank/size;
+    uint64_t last       = numLeaves*(rank+1)/size;
+    for(uint64_t k = first; k < last; k++){
+        keys.push_back(k*span(level));
+        levels.push_back(level);
+    }
+    gatherSplitters();
+    exchangeGhosts();
+}
+
+DistributedQuadTree::~DistributedQuadTree(){
+}
+
+/*
+ * Updates the local leaves using the refinement and coarsening criteria,
+ * then restores the balance and the ghosts
+ * Times the refinement and coarsening if time is true
+ */
+void DistributedQuadTree::update(){
+    if(time){
+        totalRefine     = 0;
+        totalCoarsen    = 0;
+    }
+    vector<uint64_t> newKeys;
+    vector<unsigned char> newLevels;
+    newKeys.reserve(keys.size());
+    newLevels.reserve(levels.size());
+
+    size_t pos = 0;
+    checkCriteria(0, 0, pos, newKeys, newLevels);
+    keys.swap(newKeys);
+    levels.swap(newLevels);
+
+    long local = keys.size();
+    long largest, total;
+    MPI_Allreduce(&local, &largest, 1, MPI_LONG, MPI_MAX, comm);
+    MPI_Allreduce(&local, &total, 1, MPI_LONG, MPI_SUM, comm);
+    if(largest > (1.0 + imbalanceThreshold)*double(total)/size)
+        repartition();
+    else
+        exchangeGhosts();
+}
+
+/*
+ * Same walk as LinearQuadTree::checkCriteria restricted to the local piece
+ * [splitters[rank], splitters[rank+1]) of the curve, pos is the index of the
+ * first local leaf inside the current node
+ */
+void DistributedQuadTree::checkCriteria(uint64_t key, int level, size_t& pos,
+                                        vector<uint64_t>& newKeys,
+                                        vector<unsigned char>& newLevels){
+    uint64_t lo     = splitters[rank];
+    uint64_t hi     = splitters[rank+1];
+    uint64_t end    = key + span(level);
+    if(end <= lo || key >= hi) //another rank owns all of it
+        return;
+
+    double start = 0, finish;
+    if(pos < keys.size() && keys[pos] == key && levels[pos] == level){ //leaf
+        pos++;
+        Node node = makeNode(key, level);
+        if(refine(&node)){
+            if(time)
+                start       = clock();
+            fullyRefine(key, level, newKeys, newLevels);
+            if(time){
+                finish      = clock();
+                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+            }
+        }
+        else {
+            newKeys.push_back(key);
+            newLevels.push_back(level);
+        }
+        return;
+    }
+
+    Node node = makeNode(key, level);
+    if(key >= lo && end <= hi && coarsen(&node)){
+        if(time)
+            start           = clock();
+        //skip all of the leaves below this node
+        pos = lower_bound(keys.begin() + pos, keys.end(), end) - keys.begin();
+        newKeys.push_back(key);
+        newLevels.push_back(level);
+        if(time){
+            finish          = clock();
+            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
+        }
+    }
+    else {
+        uint64_t childSpan = span(level+1);
+        for(int q = 0; q < 4; q++)
+            checkCriteria(key + q*childSpan, level+1, pos, newKeys, newLevels);
+    }
+}
+
+void DistributedQuadTree::fullyRefine(uint64_t key, int level,
+                                      vector<uint64_t>& newKeys,
+                                      vector<unsigned char>& newLevels){
+    uint64_t childSpan = span(level+1);
+    for(int q = 0; q < 4; q++){
+        uint64_t childKey = key + q*childSpan;
+        Node child = makeNode(childKey, level+1);
+        if(refine(&child))
+            fullyRefine(childKey, level+1, newKeys, newLevels);
+        else {
+            newKeys.push_back(childKey);
+            newLevels.push_back(level+1);
+        }
+    }
+}
+
+bool DistributedQuadTree::coarsen(Node * node){
+    return app->coarsen(node->x,node->y,node->width,node->height);
+}
+
+bool DistributedQuadTree::refine(Node * node){
+    if(node->currentLevel >= maxLevel)
+        return false;
+    else
+        return app->refine(node->x,node->y,node->width,node->height);
+}
+
+/************************** PARTITIONING ***********************************/
+
+double DistributedQuadTree::getImbalanceThreshold(){
+    return imbalanceThreshold;
+}
+
+void DistributedQuadTree::setImbalanceThreshold(double threshold){
+    imbalanceThreshold = threshold;
+}
+
+int DistributedQuadTree::getNumRepartitions(){
+    return numRepartitions;
+}
+
+/*
+ * The leaf with global index g along the curve goes to rank g*size/total,
+ * so the leaves keep their order and every rank sends one contiguous run
+ * to each of its new owners
+ */
+void DistributedQuadTree::repartition(){
+    long local = keys.size();
+    vector<long> counts(size);
+    MPI_Allgather(&local, 1, MPI_LONG, &counts[0], 1, MPI_LONG, comm);
+    uint64_t offset = 0, total = 0;
+    for(int r = 0; r < size; r++){
+        if(r < rank)
+            offset += counts[r];
+        total += counts[r];
+    }
+
+    vector<int> sendCounts(size, 0), recvCounts(size);
+    for(size_t i = 0; i < keys.size(); i++)
+        sendCounts[(offset + i)*size/total]++;
+    MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &recvCounts[0], 1, MPI_INT, comm);
+
+    vector<int> sendOffsets(size, 0), recvOffsets(size, 0);
+    for(int r = 1; r < size; r++){
+        sendOffsets[r] = sendOffsets[r-1] + sendCounts[r-1];
+        recvOffsets[r] = recvOffsets[r-1] + recvCounts[r-1];
+    }
+    int numReceived = recvOffsets[size-1] + recvCounts[size-1];
+    vector<uint64_t> newKeys(numReceived);
+    vector<unsigned char> newLevels(numReceived);
+    MPI_Alltoallv(keys.data(), &sendCounts[0], &sendOffsets[0], MPI_UINT64_T,
+                  newKeys.data(), &recvCounts[0], &recvOffsets[0], MPI_UINT64_T,
+                  comm);
+    MPI_Alltoallv(levels.data(), &sendCounts[0], &sendOffsets[0],
+                  MPI_UNSIGNED_CHAR, newLevels.data(), &recvCounts[0],
+                  &recvOffsets[0], MPI_UNSIGNED_CHAR, comm);
+    keys.swap(newKeys);
+    levels.swap(newLevels);
+    numRepartitions++;
+
+    gatherSplitters();
+    exchangeGhosts();
+}
+
+/*
+ * A rank without leaves gets the splitter of the next rank, so its piece of
+ * the curve is empty
+ */
+void DistributedQuadTree::gatherSplitters(){
+    uint64_t first = keys.empty() ? span(0) : keys[0];
+    splitters.resize(size+1);
+    MPI_Allgather(&first, 1, MPI_UINT64_T, &splitters[0], 1, MPI_UINT64_T, comm);
+    splitters[size] = span(0);
+    for(int r = size-1; r >= 0; r--)
+        splitters[r] = min(splitters[r], splitters[r+1]);
+    splitters[0] = 0;
+}
+
+int DistributedQuadTree::ownerOf(uint64_t key){
+    return (upper_bound(splitters.begin(), splitters.end()-1, key)
+            - splitters.begin()) - 1;
+}
+
+/*
+ * A local leaf is sent to every other rank that owns part of one of its same
+ * size face neighbors.  Any leaf across the face of a local leaf is sent to
+ * us that way, as its own same size neighbor overlaps the local leaf.  The
+ * pieces follow each other along the curve, so putting the ghosts of lower
+ * ranks before the local leaves and those of higher ranks after them keeps
+ * the merged arrays in Morton order.
+ */
+void DistributedQuadTree::exchangeGhosts(){
+    uint32_t cells = ((uint32_t)1) << MAX_DEPTH;
+    vector<vector<size_t> > toSend(size);
+    vector<size_t> lastSent(size, keys.size()); //last leaf sent to each rank
+    for(size_t i = 0; i < keys.size(); i++){
+        uint32_t ix, iy;
+        decode(keys[i], ix, iy);
+        int level       = levels[i];
+        uint32_t side   = ((uint32_t)1) << (MAX_DEPTH-level);
+        uint32_t nx[4]  = {ix, ix, ix+side, ix-side};
+        uint32_t ny[4]  = {iy+side, iy-side, iy, iy};
+        bool inside[4]  = {iy + side < cells, iy >= side,
+                           ix + side < cells, ix >= side};
+        for(int direction = 0; direction < 4; direction++){
+            if(!inside[direction])
+                continue;
+            uint64_t key    = encode(nx[direction], ny[direction]);
+            int first       = ownerOf(key);
+            int last        = ownerOf(key + span(level) - 1);
+            for(int r = first; r <= last; r++){
+                if(r != rank && lastSent[r] != i){
+                    toSend[r].push_back(i);
+                    lastSent[r] = i;
+                }
+            }
+        }
+    }
+
+    vector<int> sendCounts(size), recvCounts(size);
+    vector<int> sendOffsets(size, 0), recvOffsets(size, 0);
+    for(int r = 0; r < size; r++)
+        sendCounts[r] = toSend[r].size();
+    MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &recvCounts[0], 1, MPI_INT, comm);
+    for(int r = 1; r < size; r++){
+        sendOffsets[r] = sendOffsets[r-1] + sendCounts[r-1];
+        recvOffsets[r] = recvOffsets[r-1] + recvCounts[r-1];
+    }
+    vector<uint64_t> sendKeys;
+    vector<unsigned char> sendLevels;
+    for(int r = 0; r < size; r++){
+        for(size_t j = 0; j < toSend[r].size(); j++){
+            sendKeys.push_back(keys[toSend[r][j]]);
+            sendLevels.push_back(levels[toSend[r][j]]);
+        }
+    }
+    int numGhosts = recvOffsets[size-1] + recvCounts[size-1];
+    vector<uint64_t> ghostKeys(numGhosts);
+    vector<unsigned char> ghostLevels(numGhosts);
+    MPI_Alltoallv(sendKeys.data(), &sendCounts[0], &sendOffsets[0], MPI_UINT64_T,
+                  ghostKeys.data(), &recvCounts[0], &recvOffsets[0],
+                  MPI_UINT64_T, comm);
+    MPI_Alltoallv(sendLevels.data(), &sendCounts[0], &sendOffsets[0],
+                  MPI_UNSIGNED_CHAR, ghostLevels.data(), &recvCounts[0],
+                  &recvOffsets[0], MPI_UNSIGNED_CHAR, comm);
+
+    allKeys.clear();
+    allLevels.clear();
+    allOwners.clear();
+    for(int r = 0; r <= size; r++){
+        if(r == rank){ //the local leaves go between the lower and higher ranks
+            localBegin = allKeys.size();
+            allKeys.insert(allKeys.end(), keys.begin(), keys.end());
+            allLevels.insert(allLevels.end(), levels.begin(), levels.end());
+            allOwners.insert(allOwners.end(), keys.size(), rank);
+        }
+        if(r == size)
+            break;
+        int begin = recvOffsets[r];
+        int end   = begin + recvCounts[r];
+        allKeys.insert(allKeys.end(), ghostKeys.begin() + begin,
+                       ghostKeys.begin() + end);
+        allLevels.insert(allLevels.end(), ghostLevels.begin() + begin,
+                         ghostLevels.begin() + end);
+        allOwners.insert(allOwners.end(), recvCounts[r], r);
+    }
+    buildNodes();
+}
+
+/************************* MORTON KEY HELPERS ******************************/
+
+/*
+ * Spreads the low 32 bits of v so there is a zero bit between each of them
+ */
+static uint64_t spreadBits(uint64_t v){
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+}
+
+/*
+ * Inverse of spreadBits, gathers every other bit back together
+ */
+static uint32_t compactBits(uint64_t v){
+    v = v & 0x5555555555555555ULL;
+    v = (v | (v >> 1))  & 0x3333333333333333ULL;
+    v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+    return (uint32_t)v;
+}
+
+uint64_t DistributedQuadTree::encode(uint32_t ix, uint32_t iy){
+    return spreadBits(ix) | (spreadBits(iy) << 1);
+}
+
+void DistributedQuadTree::decode(uint64_t key, uint32_t& ix, uint32_t& iy){
+    ix = compactBits(key);
+    iy = compactBits(key >> 1);
+}
+
+uint64_t DistributedQuadTree::span(int level){
+    return ((uint64_t)1) << (2*(MAX_DEPTH-level));
+}
+
+Node DistributedQuadTree::makeNode(uint64_t key, int level){
+    uint32_t ix, iy;
+    decode(key, ix, iy);
+    double unitX    = ldexp(rootWidth, -MAX_DEPTH);
+    double unitY    = ldexp(rootHeight, -MAX_DEPTH);
+    int cType       = -1;
+    if(level > 0)
+        cType = mortonToChildType[(key >> (2*(MAX_DEPTH-level))) & 3];
+    return Node(rootX + ix*unitX, rootY + iy*unitY,
+                ldexp(rootWidth, -level), ldexp(rootHeight, -level),
+                NULL, level, cType, app);
+}
+
+uint64_t DistributedQuadTree::keyOf(Node * node){
+    double cells    = ldexp(1.0, MAX_DEPTH);
+    uint32_t ix     = (uint32_t)floor((node->x - rootX)/rootWidth*cells + 0.5);
+    uint32_t iy     = (uint32_t)floor((node->y - rootY)/rootHeight*cells + 0.5);
+    return encode(ix, iy);
+}
+
+void DistributedQuadTree::buildNodes(){
+    nodes.clear();
+    nodes.reserve(allKeys.size());
+    for(size_t i = 0; i < allKeys.size(); i++)
+        nodes.push_back(makeNode(allKeys[i], allLevels[i]));
+}
+
+size_t DistributedQuadTree::findIndex(uint64_t key){
+    size_t i = upper_bound(allKeys.begin(), allKeys.end(), key) - allKeys.begin();
+    if(i > 0 && allKeys[i-1] + span(allLevels[i-1]) > key)
+        return i-1;
+    return i;
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+int DistributedQuadTree::getOwner(Node * node){
+    return allOwners[node - &nodes[0]];
+}
+
+int DistributedQuadTree::getNumLocalLeaves(){
+    return keys.size();
+}
+
+int DistributedQuadTree::getNumGhosts(){
+    return allKeys.size() - keys.size();
+}
+
+long DistributedQuadTree::getNumGlobalLeaves(){
+    long local = keys.size();
+    long total;
+    MPI_Allreduce(&local, &total, 1, MPI_LONG, MPI_SUM, comm);
+    return total;
+}
+
+int DistributedQuadTree::getRank(){
+    return rank;
+}
+
+int DistributedQuadTree::getSize(){
+    return size;
+}
+
+int DistributedQuadTree::getMaxLevel(){
+    return maxLevel;
+}
+
+void DistributedQuadTree::setMaxLevel(int level){
+    maxLevel = (level > MAX_DEPTH) ? MAX_DEPTH : level;
+}
+
+bool DistributedQuadTree::getTime(){
+    return time;
+}
+
+void DistributedQuadTree::setTime(bool t){
+    time = t;
+}
+
+double DistributedQuadTree::getTotalCoarsen(){
+    return totalCoarsen;
+}
+
+double DistributedQuadTree::getTotalRefine(){
+    return totalRefine;
+}
+
+int DistributedQuadTree::storage(){
+    return keys.capacity()*sizeof(uint64_t) +
+           levels.capacity()*sizeof(unsigned char) +
+           allKeys.capacity()*sizeof(uint64_t) +
+           allLevels.capacity()*sizeof(unsigned char) +
+           allOwners.capacity()*sizeof(int) +
+           nodes.capacity()*sizeof(Node);
+}
+
+Node* DistributedQuadTree::findNode(double x, double y){
+    double cells    = ldexp(1.0, MAX_DEPTH);
+    double fx       = floor((x - rootX)/rootWidth*cells);
+    double fy       = floor((y - rootY)/rootHeight*cells);
+    if(fx < 0) fx = 0;
+    if(fy < 0) fy = 0;
+    if(fx > cells-1) fx = cells-1;
+    if(fy > cells-1) fy = cells-1;
+    uint64_t key    = encode((uint32_t)fx, (uint32_t)fy);
+    if(ownerOf(key) != rank)
+        return NULL;
+    return &nodes[findIndex(key)];
+}
+
+void DistributedQuadTree::findLeaves(std::vector<Node*>& leaves){
+    leaves.reserve(leaves.size() + keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        leaves.push_back(&nodes[localBegin + i]);
+}
+
+std::vector<double> DistributedQuadTree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(rootX);
+    dims.push_back(rootY);
+    dims.push_back(rootWidth);
+    dims.push_back(rootHeight);
+    return dims;
+}
+
+/************************* NEIGHBOR FINDING ******************************/
+
+void DistributedQuadTree::getNeighbors(Node * node,
+                                       std::vector<std::vector<Node*> >& neighbors){
+    int level       = node->currentLevel;
+    if(level == 0) //we're at the root which has no neighbors
+        return;
+
+    uint32_t ix, iy;
+    decode(keyOf(node), ix, iy);
+    uint32_t side   = ((uint32_t)1) << (MAX_DEPTH-level);
+    uint32_t cells  = ((uint32_t)1) << MAX_DEPTH;
+
+    if(iy + side < cells) //north
+        collectNeighbors(ix, iy+side, level, 0, iy+side, neighbors[0]);
+    if(iy >= side) //south
+        collectNeighbors(ix, iy-side, level, 1, iy, neighbors[1]);
+    if(ix + side < cells) //east
+        collectNeighbors(ix+side, iy, level, 2, ix+side, neighbors[2]);
+    if(ix >= side) //west
+        collectNeighbors(ix-side, iy, level, 3, ix, neighbors[3]);
+}
+
+/*
+ * As LinearQuadTree::collectNeighbors, except that only the leaves next to
+ * the local piece are stored, so the leaf found for the key of the cell might
+ * not contain it
+ */
+void DistributedQuadTree::collectNeighbors(uint32_t ix, uint32_t iy, int level,
+                                           int direction, uint32_t faceCoord,
+                                           std::vector<Node*>& list){
+    uint64_t key    = encode(ix, iy);
+    size_t i        = findIndex(key);
+    if(i < allKeys.size() && allKeys[i] <= key && allLevels[i] <= level){
+        list.push_back(&nodes[i]); //same level or less refined, covers the cell
+        return;
+    }
+
+    //more refined, keep the leaves of the cell that touch the shared face
+    uint64_t end = key + span(level);
+    for(; i < allKeys.size() && allKeys[i] < end; i++){
+        uint32_t lx, ly;
+        decode(allKeys[i], lx, ly);
+        uint32_t lsize = ((uint32_t)1) << (MAX_DEPTH-allLevels[i]);
+        bool touches;
+        switch(direction){
+            case 0:  touches = (ly == faceCoord);         break; //north
+            case 1:  touches = (ly + lsize == faceCoord); break; //south
+            case 2:  touches = (lx == faceCoord);         break; //east
+            default: touches = (lx + lsize == faceCoord); break; //west
+        }
+        if(touches)
+            list.push_back(&nodes[i]);
+    }
+}
@@ -0,0 +1,212 @@
+//
+//  DistributedQuadTree.h
+//
+/*
+ * Distributed version of the linear quad tree for MPI.
+ *
+ * The leaves are stored as Morton keys and levels like in LinearQuadTree and
+ * the Morton curve is cut into one contiguous piece per rank.  Rank r owns
+ * every leaf whose key lies between its splitter and the splitter of rank
+ * r+1, so refining and coarsening (which only replace a node by its
+ * children or the other way around) never move a leaf to another rank.  A
+ * node whose leaves are split between two ranks is never coarsened.
+ *
+ * Every rank only evaluates the criteria on its own leaves.  After each
+ * update the leaves next to the piece of another rank are exchanged, so
+ * getNeighbors of a local leaf sees the neighbors owned by other ranks as
+ * ghost leaves.  When the largest number of leaves on a rank goes over the
+ * mean by more than the imbalance threshold the leaves are redistributed, so
+ * every rank holds the same number of consecutive leaves along the curve.
+ *
+ * The constructor and update are collective over the communicator.  Leaves
+ * are handed out as pointers into an array of Nodes (local leaves followed
+ * by ghosts in Morton order) that is rebuilt after every update, as in
+ * LinearQuadTree their parent and child pointers are NULL.
+ */
+//
+
+#ifndef ____DistributedQuadTree__
+#define ____DistributedQuadTree__
+
+#include <vector>
+#include <stdint.h>
+#include <mpi.h>
+#include "QuadTree.h"
+
+class DistributedQuadTree {
+public:
+
+    /*
+     * Maximum supported depth, keys use two bits per level
+     */
+    static const int MAX_DEPTH = 30;
+
+    /*
+     * Same arguments as QuadTree plus the communicator, the initial uniform
+     * cells are split evenly between the ranks
+     */
+    DistributedQuadTree(double x, double y, double width, double height,
+                        int numCells, int max, Application * app,
+                        MPI_Comm comm = MPI_COMM_WORLD);
+
+    virtual ~DistributedQuadTree();
+
+    /*
+     * Refines and coarsens the local leaves, repartitions if the leaves are
+     * out of balance and exchanges the ghost leaves, collective
+     */
+    void update();
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(Node * node);
+    virtual bool coarsen(Node * node);
+
+    /*
+     * Getter and setter for the allowed imbalance, the leaves are
+     * redistributed when max leaves > (1 + threshold) * mean leaves
+     * (default 0.1)
+     */
+    double getImbalanceThreshold();
+    void setImbalanceThreshold(double threshold);
+
+    /*
+     * Redistributes the leaves evenly along the curve and exchanges the
+     * ghosts whatever the imbalance, collective
+     */
+    void repartition();
+
+    /*
+     * Number of times the leaves have been redistributed
+     */
+    int getNumRepartitions();
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns pointers to the leaves owned by this rank in Morton order
+     */
+    void findLeaves(std::vector<Node*>& leaves);
+
+    /*
+     * Face neighbors of a local leaf, same layout as QuadTree::getNeighbors
+     * (north, south, east, west), may contain ghost leaves
+     */
+    void getNeighbors(Node * node,
+                      std::vector<std::vector<Node*> >& neighbors);
+
+    /*
+     * Rank owning a leaf returned by findLeaves or getNeighbors
+     */
+    int getOwner(Node * node);
+
+    /*
+     * Local leaf containing the point, NULL if another rank owns it
+     */
+    Node * findNode(double x, double y);
+
+    int getNumLocalLeaves();
+    int getNumGhosts();
+
+    /*
+     * Number of leaves summed over all ranks, collective
+     */
+    long getNumGlobalLeaves();
+
+    int getRank();
+    int getSize();
+
+    std::vector<double> getDimensions();
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    bool getTime();
+    void setTime(bool t);
+    double getTotalCoarsen();
+    double getTotalRefine();
+
+    /*
+     * Memory used to store the local leaves and ghosts
+     */
+    int storage();
+
+private:
+    DistributedQuadTree(const DistributedQuadTree&);
+    DistributedQuadTree& operator=(const DistributedQuadTree&);
+
+    /*
+     * Morton key helpers, same layout as LinearQuadTree
+     */
+    static uint64_t encode(uint32_t ix, uint32_t iy);
+    static void decode(uint64_t key, uint32_t& ix, uint32_t& iy);
+    static uint64_t span(int level);
+    Node makeNode(uint64_t key, int level);
+    uint64_t keyOf(Node * node);
+
+    /*
+     * Walks the nodes overlapping the local piece of the curve, only nodes
+     * that lie entirely inside it are refined or coarsened
+     */
+    void checkCriteria(uint64_t key, int level, size_t& pos,
+                       std::vector<uint64_t>& newKeys,
+                       std::vector<unsigned char>& newLevels);
+    void fullyRefine(uint64_t key, int level,
+                     std::vector<uint64_t>& newKeys,
+                     std::vector<unsigned char>& newLevels);
+
+    /*
+     * Rank whose piece of the curve contains the key
+     */
+    int ownerOf(uint64_t key);
+
+    /*
+     * Collects the first key of every rank after the local leaves changed
+     * hands
+     */
+    void gatherSplitters();
+
+    /*
+     * Sends the local leaves next to other pieces to their owners and
+     * rebuilds the arrays of local leaves and ghosts
+     */
+    void exchangeGhosts();
+    void buildNodes();
+
+    /*
+     * Index in the leaf arrays of the leaf containing key or the first leaf
+     * after it when no stored leaf contains it
+     */
+    size_t findIndex(uint64_t key);
+    void collectNeighbors(uint32_t ix, uint32_t iy, int level, int direction,
+                          uint32_t faceCoord, std::vector<Node*>& list);
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    MPI_Comm comm;
+    int rank, size;
+
+    std::vector<uint64_t> keys; //sorted Morton keys of the local leaves
+    std::vector<unsigned char> levels;
+    std::vector<uint64_t> splitters; //first key of each rank, size+1 entries
+
+    //local leaves and ghosts merged in Morton order
+    std::vector<uint64_t> allKeys;
+    std::vector<unsigned char> allLevels;
+    std::vector<int> allOwners;
+    std::vector<Node> nodes;
+    size_t localBegin; //position of the first local leaf in the merged arrays
+
+    Application * app;
+    double rootX, rootY, rootWidth, rootHeight;
+
+    int maxLevel;
+    double imbalanceThreshold;
+    int numRepartitions;
+    bool time;
+    double totalCoarsen;
+    double totalRefine;
+
+};
+
+#endif /* defined(____DistributedQuadTree__) */
@@ -0,0 +1,130 @@
+//
+//  Instrumentation.cpp
+//
+//  See Instrumentation.h for more detailed comments
+//
+//
+
+#include <chrono>
+#ifdef USE_PAPI
+#include <papi.h>
+#endif
+#include "Instrumentation.h"
+
+using namespace std;
+
+const int PhaseTimer::NUM_COUNTERS;
+
+static double now(){
+    return chrono::duration<double>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PhaseTimer::PhaseTimer(){
+    eventSet    = -1;
+    counting    = false;
+#ifdef USE_PAPI
+    int events[NUM_COUNTERS] = {PAPI_TOT_INS, PAPI_L1_DCM};
+    if((PAPI_is_initialized() != PAPI_NOT_INITED ||
+        PAPI_library_init(PAPI_VER_CURRENT) == PAPI_VER_CURRENT) &&
+       PAPI_create_eventset(&eventSet) == PAPI_OK){
+        counting = PAPI_add_events(eventSet, events, NUM_COUNTERS) == PAPI_OK &&
+                   PAPI_start(eventSet) == PAPI_OK;
+    }
+#endif
+    reset();
+}
+
+PhaseTimer::~PhaseTimer(){
+#ifdef USE_PAPI
+    if(eventSet != -1){
+        long long values[NUM_COUNTERS];
+        if(counting)
+            PAPI_stop(eventSet, values);
+        PAPI_cleanup_eventset(eventSet);
+        PAPI_destroy_eventset(&eventSet);
+    }
+#endif
+}
+
+void PhaseTimer::readCounters(long long * values){
+    for(int c = 0; c < NUM_COUNTERS; c++)
+        values[c] = 0;
+#ifdef USE_PAPI
+    if(counting)
+        PAPI_read(eventSet, values);
+#endif
+}
+
+void PhaseTimer::begin(int phase){
+    if(depth[phase]++ > 0)
+        return;
+    calls[phase]++;
+    if(counting)
+        readCounters(startCounters[phase]);
+    start[phase] = now();
+}
+
+void PhaseTimer::end(int phase){
+    if(--depth[phase] > 0)
+        return;
+    seconds[phase] += now() - start[phase];
+    if(counting){
+        long long values[NUM_COUNTERS];
+        readCounters(values);
+        for(int c = 0; c < NUM_COUNTERS; c++)
+            counters[phase][c] += values[c] - startCounters[phase][c];
+    }
+}
+
+void PhaseTimer::reset(){
+    for(int p = 0; p < NUM_PHASES; p++){
+        depth[p]    = 0;
+        start[p]    = 0;
+        seconds[p]  = 0;
+        calls[p]    = 0;
+        for(int c = 0; c < NUM_COUNTERS; c++){
+            startCounters[p][c] = 0;
+            counters[p][c]      = 0;
+        }
+    }
+}
+
+double PhaseTimer::getSeconds(int phase){
+    return seconds[phase];
+}
+
+long PhaseTimer::getCalls(int phase){
+    return calls[phase];
+}
+
+long long PhaseTimer::getCounter(int phase, int counter){
+    return counters[phase][counter];
+}
+
+bool PhaseTimer::hasCounters(){
+    return counting;
+}
+
+const char * PhaseTimer::phaseName(int phase){
+    static const char * names[NUM_PHASES] = {"traversal", "criteria",
+                                             "allocation", "neighbors"};
+    return names[phase];
+}
+
+const char * PhaseTimer::counterName(int counter){
+    static const char * names[NUM_COUNTERS] = {"instructions", "l1_misses"};
+    return names[counter];
+}
+
+void PhaseTimer::print(FILE * out){
+    for(int p = 0; p < NUM_PHASES; p++){
+        fprintf(out, "%-10s %10ld calls %12.6f s", phaseName(p), calls[p],
+                seconds[p]);
+        if(counting){
+            for(int c = 0; c < NUM_COUNTERS; c++)
+                fprintf(out, " %14lld %s", counters[p][c], counterName(c));
+        }
+        fprintf(out, "\n");
+    }
+}
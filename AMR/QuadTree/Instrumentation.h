@@ -0,0 +1,126 @@
+//
+//  Instrumentation.h
+//
+/*
+ * Per phase instrumentation of the quad tree.
+ *
+ * The tree calls begin(phase) and end(phase) around the parts of its work
+ * listed in Phase.  Phases nest: the traversal of an update contains the
+ * criteria evaluations, allocations and neighbor searches made during it,
+ * and the criteria of Neighbor contain its neighbor searches.  A phase is
+ * only counted once when it is entered again before it ends (recursion).
+ *
+ * The tree does nothing but test a NULL pointer when no instrumentation is
+ * set, and nothing at all when built with -DQUADTREE_NO_INSTRUMENTATION.
+ * The calls always come from the thread calling the tree, the tasks of the
+ * parallel update are only seen as part of its traversal.
+ *
+ * PhaseTimer is the default implementation.  It accumulates wall clock
+ * time from a monotonic clock and, when built with -DUSE_PAPI (and linked
+ * with -lpapi), the PhaseTimer::NUM_COUNTERS hardware counters.
+ */
+//
+
+#ifndef ____Instrumentation__
+#define ____Instrumentation__
+
+#include <cstdio>
+
+enum Phase {
+    PHASE_TRAVERSAL,    //update and findLeaves
+    PHASE_CRITERIA,     //refine and coarsen decisions
+    PHASE_ALLOCATION,   //allocating and releasing child blocks
+    PHASE_NEIGHBORS,    //getNeighbors and the upkeep of cached links
+    NUM_PHASES
+};
+
+class Instrumentation {
+public:
+    virtual ~Instrumentation(){}
+    virtual void begin(int phase) = 0;
+    virtual void end(int phase) = 0;
+};
+
+class PhaseTimer : public Instrumentation {
+public:
+
+    /*
+     * Hardware counters read per phase when PAPI is used: instructions
+     * and level 1 data cache misses
+     */
+    static const int NUM_COUNTERS = 2;
+
+    PhaseTimer();
+    ~PhaseTimer();
+
+    void begin(int phase);
+    void end(int phase);
+
+    /*
+     * Clears all of the totals
+     */
+    void reset();
+
+    /*
+     * Totals for a phase: seconds spent in it, number of times it was
+     * entered and the change of the hardware counter (0 without PAPI)
+     */
+    double getSeconds(int phase);
+    long getCalls(int phase);
+    long long getCounter(int phase, int counter);
+
+    /*
+     * True if the hardware counters are being read
+     */
+    bool hasCounters();
+
+    static const char * phaseName(int phase);
+    static const char * counterName(int counter);
+
+    /*
+     * Writes one line per phase
+     */
+    void print(FILE * out = stdout);
+
+private:
+    PhaseTimer(const PhaseTimer&);
+    PhaseTimer& operator=(const PhaseTimer&);
+
+    void readCounters(long long * values);
+
+    int depth[NUM_PHASES];
+    double start[NUM_PHASES];
+    double seconds[NUM_PHASES];
+    long calls[NUM_PHASES];
+    long long startCounters[NUM_PHASES][NUM_COUNTERS];
+    long long counters[NUM_PHASES][NUM_COUNTERS];
+    int eventSet;
+    bool counting;
+
+};
+
+/*
+ * Calls begin when constructed and end when destroyed, if there is an
+ * instrumentation
+ */
+class ScopedPhase {
+public:
+#ifdef QUADTREE_NO_INSTRUMENTATION
+    ScopedPhase(Instrumentation *, int){}
+#else
+    ScopedPhase(Instrumentation * instrumentation, int phase)
+        : instrumentation(instrumentation), phase(phase){
+        if(instrumentation != NULL)
+            instrumentation->begin(phase);
+    }
+    ~ScopedPhase(){
+        if(instrumentation != NULL)
+            instrumentation->end(phase);
+    }
+private:
+    Instrumentation * instrumentation;
+    int phase;
+#endif
+};
+
+#endif /* defined(____Instrumentation__) */
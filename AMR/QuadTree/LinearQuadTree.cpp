@@ -0,0 +1,376 @@
+//
+//  LinearQuadTree.cpp
+//
+//  See LinearQuadTree.h for more detailed comments
+//
+//
+
+#include <algorithm>
+#include "LinearQuadTree.h"
+
+using namespace std;
+
+const int LinearQuadTree::MAX_DEPTH;
+
+/*
+ * Maps the Morton child index (bit 0 = east, bit 1 = north) to the childType
+ * numbering used by QuadTree (0 - NE, 1 - NW, 2 - SW, 3 - SE)
+ */
+static const int mortonToChildType[4] = {2, 3, 1, 0};
+
+/*
+ * Constructor
+ */
+LinearQuadTree::LinearQuadTree(double x, double y, double width, double height,
+                               int numCells, int max, Application * application){
+    app             = application;
+    rootX           = x;
+    rootY           = y;
+    rootWidth       = width;
+    rootHeight      = height;
+    maxLevel        = (max > MAX_DEPTH) ? MAX_DEPTH : max;
+    time            = false;
+    totalCoarsen    = 0;
+    totalRefine     = 0;
+
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+    int level       = numLevels/2;
+
+    //uniform initial decomposition, already in Morton order
+    uint64_t numLeaves = ((uint64_t)1) << (2*level);
+    keys.reserve(numLeaves);
+    levels.reserve(numLeaves);
+    for(uint64_t k = 0; k < numLeaves; k++){
+        keys.push_back(k*span(level));
+        levels.push_back(level);
+    }
+    buildNodes();
+}
+
+/*
+ * Destructor
+ */
+LinearQuadTree::~LinearQuadTree(){
+}
+
+/*
+ * Updates the tree using refinement and coarsening criteria
+ * Times the refinement and coarsening if time is true
+ */
+void LinearQuadTree::update(){
+    if(time){
+        totalRefine     = 0;
+        totalCoarsen    = 0;
+    }
+    vector<uint64_t> newKeys;
+    vector<unsigned char> newLevels;
+    newKeys.reserve(keys.size());
+    newLevels.reserve(levels.size());
+
+    size_t pos = 0;
+    checkCriteria(0, 0, pos, newKeys, newLevels);
+
+    keys.swap(newKeys);
+    levels.swap(newLevels);
+    buildNodes();
+}
+
+/*
+ * Helper method for updating the tree, walks the implied tree over the sorted
+ * leaves, pos is the index of the first leaf inside the current node
+ */
+void LinearQuadTree::checkCriteria(uint64_t key, int level, size_t& pos,
+                                   vector<uint64_t>& newKeys,
+                                   vector<unsigned char>& newLevels){
+    double start = 0, finish;
+    if(keys[pos] == key && levels[pos] == level){ //leaf
+        pos++;
+        Node node = makeNode(key, level);
+        if(refine(&node)){
+            if(time)
+                start       = clock();
+            fullyRefine(key, level, newKeys, newLevels);
+            if(time){
+                finish      = clock();
+                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+            }
+        }
+        else {
+            newKeys.push_back(key);
+            newLevels.push_back(level);
+        }
+        return;
+    }
+
+    Node node = makeNode(key, level);
+    if(coarsen(&node)){
+        if(time)
+            start           = clock();
+        //skip all of the leaves below this node
+        pos = lower_bound(keys.begin() + pos, keys.end(), key + span(level))
+              - keys.begin();
+        newKeys.push_back(key);
+        newLevels.push_back(level);
+        if(time){
+            finish          = clock();
+            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
+        }
+    }
+    else {
+        uint64_t childSpan = span(level+1);
+        for(int q = 0; q < 4; q++)
+            checkCriteria(key + q*childSpan, level+1, pos, newKeys, newLevels);
+    }
+}
+
+/*
+ * Refines the nodes as far as necessary:
+ *
+ * To the maximum level or
+ * The refinement criteria is no longer satisfied
+ */
+void LinearQuadTree::fullyRefine(uint64_t key, int level,
+                                 vector<uint64_t>& newKeys,
+                                 vector<unsigned char>& newLevels){
+    uint64_t childSpan = span(level+1);
+    for(int q = 0; q < 4; q++){
+        uint64_t childKey = key + q*childSpan;
+        Node child = makeNode(childKey, level+1);
+        if(refine(&child))
+            fullyRefine(childKey, level+1, newKeys, newLevels);
+        else {
+            newKeys.push_back(childKey);
+            newLevels.push_back(level+1);
+        }
+    }
+}
+
+/*
+ * Returns a boolean determining if the node should be coarsened
+ */
+bool LinearQuadTree::coarsen(Node * node){
+    return app->coarsen(node->x,node->y,node->width,node->height);
+}
+
+/*
+ * Returns a boolean determining if the node should be refined
+ */
+bool LinearQuadTree::refine(Node * node){
+    if(node->currentLevel >= maxLevel)
+        return false;
+    else
+        return app->refine(node->x,node->y,node->width,node->height);
+}
+
+/*
+ * Refines a leaf node by replacing it with its four children
+ */
+void LinearQuadTree::refineNode(Node * node){
+    int level = node->currentLevel;
+    if(level >= MAX_DEPTH)
+        return;
+    size_t i           = findIndex(keyOf(node));
+    uint64_t key       = keys[i];
+    uint64_t childSpan = span(level+1);
+
+    levels[i]          = level+1;
+    uint64_t children[3] = {key + childSpan, key + 2*childSpan, key + 3*childSpan};
+    keys.insert(keys.begin() + i + 1, children, children + 3);
+    levels.insert(levels.begin() + i + 1, 3, (unsigned char)(level+1));
+    buildNodes();
+}
+
+/************************* MORTON KEY HELPERS ******************************/
+
+/*
+ * Spreads the low 32 bits of v so there is a zero bit between each of them
+ */
+static uint64_t spreadBits(uint64_t v){
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+}
+
+/*
+ * Inverse of spreadBits, gathers every other bit back together
+ */
+static uint32_t compactBits(uint64_t v){
+    v = v & 0x5555555555555555ULL;
+    v = (v | (v >> 1))  & 0x3333333333333333ULL;
+    v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+    return (uint32_t)v;
+}
+
+uint64_t LinearQuadTree::encode(uint32_t ix, uint32_t iy){
+    return spreadBits(ix) | (spreadBits(iy) << 1);
+}
+
+void LinearQuadTree::decode(uint64_t key, uint32_t& ix, uint32_t& iy){
+    ix = compactBits(key);
+    iy = compactBits(key >> 1);
+}
+
+uint64_t LinearQuadTree::span(int level){
+    return ((uint64_t)1) << (2*(MAX_DEPTH-level));
+}
+
+Node LinearQuadTree::makeNode(uint64_t key, int level){
+    uint32_t ix, iy;
+    decode(key, ix, iy);
+    double unitX    = ldexp(rootWidth, -MAX_DEPTH);
+    double unitY    = ldexp(rootHeight, -MAX_DEPTH);
+    int cType       = -1;
+    if(level > 0)
+        cType = mortonToChildType[(key >> (2*(MAX_DEPTH-level))) & 3];
+    return Node(rootX + ix*unitX, rootY + iy*unitY,
+                ldexp(rootWidth, -level), ldexp(rootHeight, -level),
+                NULL, level, cType, app);
+}
+
+size_t LinearQuadTree::findIndex(uint64_t key){
+    //last leaf whose key is not greater than key
+    return (upper_bound(keys.begin(), keys.end(), key) - keys.begin()) - 1;
+}
+
+uint64_t LinearQuadTree::keyOf(Node * node){
+    double cells    = ldexp(1.0, MAX_DEPTH);
+    uint32_t ix     = (uint32_t)floor((node->x - rootX)/rootWidth*cells + 0.5);
+    uint32_t iy     = (uint32_t)floor((node->y - rootY)/rootHeight*cells + 0.5);
+    return encode(ix, iy);
+}
+
+void LinearQuadTree::buildNodes(){
+    nodes.clear();
+    nodes.reserve(keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+        nodes.push_back(makeNode(keys[i], levels[i]));
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+int LinearQuadTree::getSizeRoot(){
+    return sizeof(uint64_t) + sizeof(unsigned char) + sizeof(Node);
+}
+
+int LinearQuadTree::getMaxLevel(){
+    return maxLevel;
+}
+
+void LinearQuadTree::setMaxLevel(int level){
+    maxLevel = (level > MAX_DEPTH) ? MAX_DEPTH : level;
+}
+
+bool LinearQuadTree::getTime(){
+    return time;
+}
+
+void LinearQuadTree::setTime(bool t){
+    time = t;
+}
+
+double LinearQuadTree::getTotalCoarsen(){
+    return totalCoarsen;
+}
+
+double LinearQuadTree::getTotalRefine(){
+    return totalRefine;
+}
+
+//memory usage of the keys, levels and the Node view of the leaves
+int LinearQuadTree::storage(){
+    return keys.capacity()*sizeof(uint64_t) +
+           levels.capacity()*sizeof(unsigned char) +
+           nodes.capacity()*sizeof(Node);
+}
+
+//every interior node has four children, so leaves = 3*interior + 1
+int LinearQuadTree::countNodes(){
+    return (4*keys.size() - 1)/3;
+}
+
+Node* LinearQuadTree::findNode(double x, double y){
+    double cells    = ldexp(1.0, MAX_DEPTH);
+    double fx       = floor((x - rootX)/rootWidth*cells);
+    double fy       = floor((y - rootY)/rootHeight*cells);
+    if(fx < 0) fx = 0;
+    if(fy < 0) fy = 0;
+    if(fx > cells-1) fx = cells-1;
+    if(fy > cells-1) fy = cells-1;
+    return &nodes[findIndex(encode((uint32_t)fx, (uint32_t)fy))];
+}
+
+void LinearQuadTree::findLeaves(std::vector<Node*>& leaves){
+    leaves.reserve(leaves.size() + nodes.size());
+    for(size_t i = 0; i < nodes.size(); i++)
+        leaves.push_back(&nodes[i]);
+}
+
+std::vector<double> LinearQuadTree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(rootX);
+    dims.push_back(rootY);
+    dims.push_back(rootWidth);
+    dims.push_back(rootHeight);
+    return dims;
+}
+
+/************************* NEIGHBOR FINDING ******************************/
+
+void LinearQuadTree::getNeighbors(Node * node,
+                                  std::vector<std::vector<Node*> >& neighbors){
+    int level       = node->currentLevel;
+    if(level == 0) //we're at the root which has no neighbors
+        return;
+
+    uint32_t ix, iy;
+    decode(keyOf(node), ix, iy);
+    uint32_t size   = ((uint32_t)1) << (MAX_DEPTH-level);
+    uint32_t cells  = ((uint32_t)1) << MAX_DEPTH;
+
+    if(iy + size < cells) //north
+        collectNeighbors(ix, iy+size, level, 0, iy+size, neighbors[0]);
+    if(iy >= size) //south
+        collectNeighbors(ix, iy-size, level, 1, iy, neighbors[1]);
+    if(ix + size < cells) //east
+        collectNeighbors(ix+size, iy, level, 2, ix+size, neighbors[2]);
+    if(ix >= size) //west
+        collectNeighbors(ix-size, iy, level, 3, ix, neighbors[3]);
+}
+
+void LinearQuadTree::collectNeighbors(uint32_t ix, uint32_t iy, int level,
+                                      int direction, uint32_t faceCoord,
+                                      std::vector<Node*>& list){
+    uint64_t key    = encode(ix, iy);
+    size_t i        = findIndex(key);
+    if(levels[i] <= level){ //same level or less refined, covers the cell
+        list.push_back(&nodes[i]);
+        return;
+    }
+
+    //more refined, keep the leaves of the cell that touch the shared face
+    size_t end = lower_bound(keys.begin() + i, keys.end(), key + span(level))
+                 - keys.begin();
+    for(; i < end; i++){
+        uint32_t lx, ly;
+        decode(keys[i], lx, ly);
+        uint32_t lsize = ((uint32_t)1) << (MAX_DEPTH-levels[i]);
+        bool touches;
+        switch(direction){
+            case 0:  touches = (ly == faceCoord);         break; //north
+            case 1:  touches = (ly + lsize == faceCoord); break; //south
+            case 2:  touches = (lx == faceCoord);         break; //east
+            default: touches = (lx + lsize == faceCoord); break; //west
+        }
+        if(touches)
+            list.push_back(&nodes[i]);
+    }
+}
@@ -0,0 +1,197 @@
+//
+//  LinearQuadTree.h
+//
+/*
+ * Linear (Morton ordered) implementation of the quad tree.
+ *
+ * Instead of linking nodes together with child and parent pointers, only the
+ * leaves are stored.  Each leaf is identified by the Morton (Z-order) key of
+ * its lower left corner on a fixed 2^MAX_DEPTH x 2^MAX_DEPTH integer grid
+ * together with its level.  The keys are kept sorted in one contiguous array,
+ * so updating, leaf finding, neighbor finding and point location are all
+ * linear sweeps or binary searches over that array instead of pointer chasing.
+ *
+ * The public interface mirrors QuadTree so the two implementations can be
+ * benchmarked side by side and any Application subclass can be used with
+ * either one.  Leaves are handed out as pointers into an array of Node
+ * objects that is rebuilt after every update or refineNode call, so these
+ * pointers are only valid until the next call that changes the tree.  The
+ * parent and child pointers of these nodes are always NULL, which means the
+ * global criteria of OneLevel and Neighbor (which look at node->parent)
+ * still require the pointer based QuadTree.
+ */
+//
+
+#ifndef ____LinearQuadTree__
+#define ____LinearQuadTree__
+
+#include <vector>
+#include <stdint.h>
+#include "QuadTree.h"
+
+class LinearQuadTree {
+public:
+
+    /*
+     * Maximum supported depth, keys use two bits per level
+     */
+    static const int MAX_DEPTH = 30;
+
+    /*
+     * Constructor that initializes the tree, same arguments as QuadTree
+     * the number of cells in the initial decomposition (must be a power of 4)
+     * the maximum level (clamped to MAX_DEPTH)
+     */
+    LinearQuadTree(double x,double y, double width, double height,
+                   int numCells,int max,Application * app);
+
+    /*
+     * Destructor
+     */
+    virtual ~LinearQuadTree();
+
+    /*
+     * Refines and coarsens the quadtree until the desired refinement is reached
+     */
+    void update();
+
+    /*
+     * Refines a leaf node into four children
+     */
+    void refineNode(Node * node);
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(Node * node);
+    virtual bool coarsen(Node * node);
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns pointers to all the leaf nodes in Morton order
+     */
+    void findLeaves(std::vector<Node*>& leaves);
+
+    /*
+     * Method for getting the face neighbors of a leaf, same layout as
+     * QuadTree::getNeighbors (north, south, east, west)
+     */
+    void getNeighbors(Node * node,
+                      std::vector<std::vector<Node*> >& neighbors);
+
+    /*
+     * Method for getting dimensions of quad tree
+     */
+    std::vector<double> getDimensions();
+
+    /*
+     * Returns the memory used to store a single leaf
+     */
+    int getSizeRoot();
+
+    /*
+     * Getter and setter for max level of the tree
+     */
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    /*
+     * Getter and setter to turn update timing on/off
+     */
+    bool getTime();
+    void setTime(bool t);
+
+    /*
+     * Returns the total amount of time spend in coarsening and refinement
+     */
+    double getTotalCoarsen();
+    double getTotalRefine();
+
+    /*
+     * Counts the number of nodes (leaves and implied interior nodes)
+     */
+    int countNodes();
+
+    /*
+     * Returns the total amount of memory used to store the quad tree
+     */
+    int storage();
+
+    /*
+     * Finds the leaf node that contains the particular x,y point
+     */
+    Node * findNode(double x,double y);
+
+private:
+
+    /*
+     * Morton key helpers, interleave/deinterleave integer grid coordinates
+     */
+    static uint64_t encode(uint32_t ix, uint32_t iy);
+    static void decode(uint64_t key, uint32_t& ix, uint32_t& iy);
+
+    /*
+     * Number of keys covered by a node on the given level
+     */
+    static uint64_t span(int level);
+
+    /*
+     * Builds the Node describing the cell (key, level)
+     */
+    Node makeNode(uint64_t key, int level);
+
+    /*
+     * Traverses the implied tree refining and coarsening the nodes, the new
+     * leaves are appended to newKeys/newLevels in Morton order
+     */
+    void checkCriteria(uint64_t key, int level, size_t& pos,
+                       std::vector<uint64_t>& newKeys,
+                       std::vector<unsigned char>& newLevels);
+
+    /*
+     * Refines the node as far as possible
+     */
+    void fullyRefine(uint64_t key, int level,
+                     std::vector<uint64_t>& newKeys,
+                     std::vector<unsigned char>& newLevels);
+
+    /*
+     * Index of the leaf containing the key
+     */
+    size_t findIndex(uint64_t key);
+
+    /*
+     * Recovers the key of a node from its geometry
+     */
+    uint64_t keyOf(Node * node);
+
+    /*
+     * Collects the leaves of the cell (ix,iy,level) that touch the face
+     * shared with the node we are finding the neighbors of
+     */
+    void collectNeighbors(uint32_t ix, uint32_t iy, int level, int direction,
+                          uint32_t faceCoord, std::vector<Node*>& list);
+
+    /*
+     * Rebuilds the Node array handed out through the public interface
+     */
+    void buildNodes();
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<uint64_t> keys; //sorted Morton keys of the leaves
+    std::vector<unsigned char> levels; //level of each leaf
+    std::vector<Node> nodes; //Node view of the leaves
+
+    Application * app;
+    double rootX, rootY, rootWidth, rootHeight;
+
+    int maxLevel;
+    bool time;
+    double totalCoarsen;
+    double totalRefine;
+
+};
+
+#endif /* defined(____LinearQuadTree__) */
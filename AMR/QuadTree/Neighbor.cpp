@@ -12,12 +12,15 @@ using namespace std;
 
 Neighbor::Neighbor(double x,double y, double width, double height,
                    int numCells, int max, Application * app) : QuadTree(x,y,width,height, numCells, max, app){
+    balancePass = false;
+    balancing   = false;
 }
 
 Neighbor::~Neighbor(){}
 
 bool Neighbor::refine(Node * node){
-
+    if(balancePass) //the ripple refines the neighbors afterwards
+        return QuadTree::refine(node);
     return QuadTree::refine(node) && levelPassed(node);
 }
 
@@ -25,7 +28,12 @@ bool Neighbor::coarsen(Node * node){
     return QuadTree::coarsen(node) && node->parent->NEChild->isLeaf &&
     node->parent->NWChild->isLeaf &&
     node->parent->SWChild->isLeaf &&
-    node->parent->SEChild->isLeaf;
+    node->parent->SEChild->isLeaf &&
+    (!balancePass || coarsenKeepsBalance(node));
+}
+
+bool Neighbor::independentSubtrees(){
+    return false;
 }
 
 bool Neighbor::levelPassed(Node * node){
@@ -43,4 +51,83 @@ bool Neighbor::levelPassed(Node * node){
     }
     return true;
     
+}
+
+bool Neighbor::getBalancePass(){
+    return balancePass;
+}
+
+void Neighbor::setBalancePass(bool b){
+    balancePass = b;
+    if(b){
+        setCacheNeighbors(true);
+        findLeaves(balanceQueue);
+        ripple();
+    }
+}
+
+void Neighbor::nodeRefined(Node * node){
+    if(!balancePass)
+        return;
+    balanceQueue.push_back(node->NEChild);
+    balanceQueue.push_back(node->NWChild);
+    balanceQueue.push_back(node->SWChild);
+    balanceQueue.push_back(node->SEChild);
+    if(!balancing) //refinements made by ripple are only queued
+        ripple();
+}
+
+/*
+ * The cached link of a leaf points at the smallest node at least as large
+ * as the leaf across each face, which is a leaf when it is larger.  While it
+ * is more than one level coarser it gets refined, which moves the link one
+ * level down and queues the new children in turn.
+ */
+void Neighbor::ripple(){
+    balancing = true;
+    while(!balanceQueue.empty()){
+        Node * leaf = balanceQueue.back();
+        balanceQueue.pop_back();
+        if(!leaf->isLeaf)
+            continue;
+        for(int direction = 0; direction < 4; direction++){
+            Node * across = leaf->neighbors[direction];
+            while(across != NULL &&
+                  across->currentLevel < leaf->currentLevel - 1){
+                refineNode(across);
+                across = leaf->neighbors[direction];
+            }
+        }
+    }
+    balancing = false;
+}
+
+/*
+ * Children of a node on the side facing each direction (N, S, E, W)
+ */
+static Node * facingChild(Node * node, int direction, int i){
+    switch(direction){
+        case 0: return i ? node->NWChild : node->NEChild;
+        case 1: return i ? node->SEChild : node->SWChild;
+        case 2: return i ? node->SEChild : node->NEChild;
+        default: return i ? node->SWChild : node->NWChild;
+    }
+}
+
+/*
+ * Once coarsened the node's neighbors may be at most one level finer, so
+ * the children of a same size neighbor that face the node must be leaves
+ */
+bool Neighbor::coarsenKeepsBalance(Node * node){
+    for(int direction = 0; direction < 4; direction++){
+        Node * across = node->neighbors[direction];
+        if(across == NULL || across->isLeaf ||
+           across->currentLevel != node->currentLevel)
+            continue;
+        int face = direction^1; //side of the neighbor facing the node
+        if(!facingChild(across, face, 0)->isLeaf ||
+           !facingChild(across, face, 1)->isLeaf)
+            return false;
+    }
+    return true;
 }
\ No newline at end of file
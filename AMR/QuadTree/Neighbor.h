@@ -8,12 +8,18 @@
 //  Achieved by overriding the global refine/coarsen methods in the QuadTree
 //  base class
 //
+//  With the balance pass on, refinement is no longer refused when a
+//  neighbor is too coarse.  Instead every refinement ripples outwards,
+//  refining the coarse neighbors through a queue using the cached neighbor
+//  links, so the cost is linear in the number of refined cells.
+//
 //
 
 #ifndef ____Neighbor__
 #define ____Neighbor__
 
 #include <iostream>
+#include <vector>
 #include "QuadTree.h"
 
 class Neighbor : public QuadTree {
@@ -25,9 +31,36 @@ public:
     
     bool refine(Node * node);
     bool coarsen(Node * node);
+    bool independentSubtrees(); //refinement looks at the neighbors
+    
+    /*
+     * Getter and setter for the balance pass, turning it on also turns on
+     * neighbor caching (which has to stay on) and balances the current tree
+     */
+    bool getBalancePass();
+    void setBalancePass(bool b);
+    
+protected:
+    void nodeRefined(Node * node);
     
 private:
     bool levelPassed(Node * node);
+    
+    /*
+     * True if turning the node into a leaf leaves its neighbors within
+     * one level of it
+     */
+    bool coarsenKeepsBalance(Node * node);
+    
+    /*
+     * Refines the neighbors of the queued leaves until they are all within
+     * one level of each other
+     */
+    void ripple();
+    
+    bool balancePass;
+    bool balancing; //true while ripple is running
+    std::vector<Node*> balanceQueue; //leaves whose neighbors need checking
 };
 
 #endif /* defined(____Neighbor__) */
\ No newline at end of file
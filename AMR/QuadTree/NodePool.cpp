@@ -0,0 +1,121 @@
+//
+//  NodePool.cpp
+//
+//  See NodePool.h for more detailed comments
+//
+//
+
+#include <new>
+#include <utility>
+#include "NodePool.h"
+#include "QuadTree.h"
+
+NodePool::NodePool(size_t blocks){
+    blocksPerSlab   = (blocks == 0) ? 1 : blocks;
+    slabBlocks      = 0;
+    nextBlock       = 0; //forces a slab on the first allocate
+    reservedBlocks  = 0;
+    freeList        = NULL;
+    shared          = false;
+    blocksInUse     = 0;
+    peakBlocks      = 0;
+    allocations     = 0;
+    reuses          = 0;
+}
+
+NodePool::~NodePool(){
+    for(size_t i = 0; i < slabs.size(); i++)
+        ::operator delete(slabs[i]);
+}
+
+void NodePool::newSlab(){
+    slabs.push_back(::operator new(blocksPerSlab*BLOCK_SIZE*sizeof(Node)));
+    slabBlocks      = blocksPerSlab;
+    nextBlock       = 0;
+    reservedBlocks += blocksPerSlab;
+}
+
+void NodePool::reserve(size_t blocks){
+    if(blocks == 0)
+        return;
+    slabs.push_back(::operator new(blocks*BLOCK_SIZE*sizeof(Node)));
+    slabBlocks      = blocks;
+    nextBlock       = 0;
+    reservedBlocks += blocks;
+}
+
+void NodePool::swapSlabs(NodePool& other){
+    std::swap(slabs, other.slabs);
+    std::swap(slabBlocks, other.slabBlocks);
+    std::swap(nextBlock, other.nextBlock);
+    std::swap(reservedBlocks, other.reservedBlocks);
+    std::swap(freeList, other.freeList);
+    std::swap(blocksInUse, other.blocksInUse);
+}
+
+void NodePool::setShared(bool s){
+    shared = s;
+}
+
+Node * NodePool::allocate(){
+    if(shared){
+        std::lock_guard<std::mutex> guard(lock);
+        return allocateBlock();
+    }
+    return allocateBlock();
+}
+
+Node * NodePool::allocateBlock(){
+    Node * block;
+    if(freeList != NULL){
+        block       = static_cast<Node*>(freeList);
+        freeList    = *static_cast<void**>(freeList);
+        reuses++;
+    }
+    else {
+        if(nextBlock == slabBlocks)
+            newSlab();
+        block       = static_cast<Node*>(slabs.back()) + nextBlock*BLOCK_SIZE;
+        nextBlock++;
+    }
+    allocations++;
+    blocksInUse++;
+    if(blocksInUse > peakBlocks)
+        peakBlocks = blocksInUse;
+    return block;
+}
+
+void NodePool::release(Node * block){
+    std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+    if(shared)
+        guard.lock();
+    *reinterpret_cast<void**>(block) = freeList;
+    freeList = block;
+    blocksInUse--;
+}
+
+size_t NodePool::getBlocksInUse(){
+    return blocksInUse;
+}
+
+size_t NodePool::getPeakBlocks(){
+    return peakBlocks;
+}
+
+size_t NodePool::getAllocations(){
+    return allocations;
+}
+
+size_t NodePool::getReuses(){
+    return reuses;
+}
+
+double NodePool::getReuseRate(){
+    if(allocations == 0)
+        return 0.0;
+    return double(reuses)/double(allocations);
+}
+
+size_t NodePool::getReservedBytes(){
+    return reservedBlocks*BLOCK_SIZE*sizeof(Node);
+}
@@ -0,0 +1,108 @@
+//
+//  NodePool.h
+//
+/*
+ * Slab allocator for the nodes of the QuadTree.
+ *
+ * Nodes are always created and destroyed four siblings at a time, so the pool
+ * hands out blocks of four contiguous nodes (NE, NW, SW, SE) carved out of
+ * large slabs.  Blocks released by coarsening are kept on a free list and
+ * handed out again by the next refinement instead of going back to malloc.
+ * Slabs are only returned to the system when the pool is destroyed, or when
+ * QuadTree::compact copies the tree into a fresh pool and swaps the slabs.
+ */
+//
+
+#ifndef ____NodePool__
+#define ____NodePool__
+
+#include <vector>
+#include <cstddef>
+#include <mutex>
+
+struct Node;
+
+class NodePool {
+public:
+
+    /*
+     * Number of nodes in a block, one for each sibling
+     */
+    static const int BLOCK_SIZE = 4;
+
+    /*
+     * Constructor, takes the number of blocks carved out of each slab
+     */
+    NodePool(size_t blocksPerSlab = 256);
+
+    /*
+     * Destructor, frees all of the slabs
+     */
+    ~NodePool();
+
+    /*
+     * Returns uninitialized memory for BLOCK_SIZE contiguous nodes
+     */
+    Node * allocate();
+
+    /*
+     * Returns a block obtained from allocate to the free list
+     */
+    void release(Node * block);
+
+    /*
+     * Carves the next allocations out of one new slab of exactly that many
+     * blocks, so that they are contiguous in the order they are allocated
+     */
+    void reserve(size_t blocks);
+
+    /*
+     * Exchanges the slabs, free lists and live blocks of two pools, the
+     * statistics of each pool stay with it
+     */
+    void swapSlabs(NodePool& other);
+
+    /*
+     * Turns locking on/off, needed while several threads refine and
+     * coarsen the tree at the same time
+     */
+    void setShared(bool s);
+
+    /*
+     * Pool statistics
+     */
+    size_t getBlocksInUse();
+    size_t getPeakBlocks();
+    size_t getAllocations();
+    size_t getReuses();
+    double getReuseRate(); //fraction of allocations served by the free list
+    size_t getReservedBytes(); //memory held by the slabs
+
+private:
+    /*
+     * Pools can not be copied since they own their slabs
+     */
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+    void newSlab();
+    Node * allocateBlock();
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<void*> slabs;
+    size_t blocksPerSlab;
+    size_t slabBlocks; //blocks in the newest slab
+    size_t nextBlock; //next unused block in the newest slab
+    size_t reservedBlocks; //blocks in all of the slabs
+    void * freeList; //singly linked through the first word of each block
+    bool shared;
+    std::mutex lock;
+
+    size_t blocksInUse;
+    size_t peakBlocks;
+    size_t allocations;
+    size_t reuses;
+};
+
+#endif /* defined(____NodePool__) */
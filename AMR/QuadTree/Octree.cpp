@@ -0,0 +1,320 @@
+//
+//  Octree.cpp
+//
+//  See Octree.h for more detailed comments
+//
+//
+
+#include <math.h>
+#include <time.h>
+#include <cstdlib>
+#include "Octree.h"
+
+using namespace std;
+
+const int Octree::NUM_CHILDREN;
+const int Octree::NUM_FACES;
+
+/*
+ * Directions are 0 - N (+y), 1 - S, 2 - E (+x), 3 - W, 4 - up (+z), 5 - down,
+ * this gives the bit of the child index along the axis of each direction
+ */
+static const int axisBit[6] = {2, 2, 1, 1, 4, 4};
+
+//true if a child of this type touches the face of its parent in direction
+static bool onSide(int type, int direction){
+    bool upper = (type & axisBit[direction]) != 0;
+    return upper == (direction%2 == 0);
+}
+
+//the child next to this one across the face in direction
+static int mirror(int type, int direction){
+    return type ^ axisBit[direction];
+}
+
+static void setNode(OctNode * node, double x, double y, double z, double w,
+                    double h, double d, OctNode * parent, int level, int type){
+    node->children      = NULL;
+    node->parent        = parent;
+    node->x             = x;
+    node->y             = y;
+    node->z             = z;
+    node->width         = w;
+    node->height        = h;
+    node->depth         = d;
+    node->currentLevel  = level;
+    node->childType     = type;
+    node->isLeaf        = true;
+}
+
+/*
+ * Constructor
+ */
+Octree::Octree(double x, double y, double z, double width, double height,
+               double depth, int numCells, int max, Application * application){
+    app             = application;
+    maxLevel        = max;
+    balanced        = false;
+    time            = false;
+    totalCoarsen    = 0;
+    totalRefine     = 0;
+    numBlocks       = 0;
+    root            = new OctNode;
+    setNode(root, x, y, z, width, height, depth, NULL, 0, -1);
+
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+    insert(root, numLevels/3);
+}
+
+void Octree::insert(OctNode * node, int levelsRemaining){
+    if(levelsRemaining <= 0)
+        return;
+    refineNode(node);
+    for(int t = 0; t < NUM_CHILDREN; t++)
+        insert(&node->children[t], levelsRemaining - 1);
+}
+
+Octree::~Octree(){
+    destroyTree(root);
+    delete root;
+}
+
+void Octree::destroyTree(OctNode * node){
+    if(node->isLeaf)
+        return;
+    for(int t = 0; t < NUM_CHILDREN; t++)
+        destroyTree(&node->children[t]);
+    delete [] node->children;
+    numBlocks--;
+}
+
+/*
+ * Updates the tree using refinement and coarsening criteria
+ * Times the refinement and coarsening if time is true
+ */
+void Octree::update(){
+    if(time){
+        totalRefine     = 0;
+        totalCoarsen    = 0;
+    }
+    checkCriteria(root);
+}
+
+void Octree::checkCriteria(OctNode * node){
+    double start = 0, finish;
+    if(node->isLeaf){
+        if(refine(node)){
+            if(time)
+                start       = clock();
+            fullyRefine(node);
+            if(time){
+                finish      = clock();
+                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+            }
+        }
+    }
+    else if(coarsen(node)){
+        if(time)
+            start           = clock();
+        coarsenNode(node);
+        if(time){
+            finish          = clock();
+            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
+        }
+    }
+    else {
+        for(int t = 0; t < NUM_CHILDREN; t++)
+            checkCriteria(&node->children[t]);
+    }
+}
+
+void Octree::fullyRefine(OctNode * node){
+    refineNode(node);
+    for(int t = 0; t < NUM_CHILDREN; t++){
+        if(refine(&node->children[t]))
+            fullyRefine(&node->children[t]);
+    }
+}
+
+bool Octree::refine(OctNode * node){
+    if(node->currentLevel >= maxLevel)
+        return false;
+    return app->refine3D(node->x,node->y,node->z,
+                         node->width,node->height,node->depth) &&
+           (!balanced || levelPassed(node));
+}
+
+bool Octree::coarsen(OctNode * node){
+    if(!app->coarsen3D(node->x,node->y,node->z,
+                       node->width,node->height,node->depth))
+        return false;
+    if(balanced && node->parent != NULL){
+        OctNode * siblings = node->parent->children;
+        for(int t = 0; t < NUM_CHILDREN; t++){
+            if(!siblings[t].isLeaf)
+                return false;
+        }
+    }
+    return true;
+}
+
+void Octree::refineNode(OctNode * node){
+    double w            = node->width/2.0;
+    double h            = node->height/2.0;
+    double d            = node->depth/2.0;
+    node->children      = new OctNode[NUM_CHILDREN];
+    for(int t = 0; t < NUM_CHILDREN; t++){
+        setNode(&node->children[t],
+                node->x + ((t & 1) ? w : 0),
+                node->y + ((t & 2) ? h : 0),
+                node->z + ((t & 4) ? d : 0),
+                w, h, d, node, node->currentLevel + 1, t);
+    }
+    node->isLeaf        = false;
+    numBlocks++;
+}
+
+void Octree::coarsenNode(OctNode * node){
+    destroyTree(node);
+    node->children      = NULL;
+    node->isLeaf        = true;
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+bool Octree::getBalanced(){
+    return balanced;
+}
+
+void Octree::setBalanced(bool b){
+    balanced = b;
+}
+
+int Octree::getSizeRoot(){
+    return sizeof(OctNode);
+}
+
+int Octree::getMaxLevel(){
+    return maxLevel;
+}
+
+void Octree::setMaxLevel(int level){
+    maxLevel = level;
+}
+
+bool Octree::getTime(){
+    return time;
+}
+
+void Octree::setTime(bool t){
+    time = t;
+}
+
+double Octree::getTotalCoarsen(){
+    return totalCoarsen;
+}
+
+double Octree::getTotalRefine(){
+    return totalRefine;
+}
+
+int Octree::countNodes(){
+    return 1 + NUM_CHILDREN*numBlocks;
+}
+
+int Octree::storage(){
+    return countNodes()*sizeof(OctNode);
+}
+
+std::vector<double> Octree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(root->x);
+    dims.push_back(root->y);
+    dims.push_back(root->z);
+    dims.push_back(root->width);
+    dims.push_back(root->height);
+    dims.push_back(root->depth);
+    return dims;
+}
+
+OctNode * Octree::findNode(double x, double y, double z){
+    OctNode * node = root;
+    while(!node->isLeaf){
+        int t = 0;
+        if(x >= node->x + node->width/2.0)
+            t |= 1;
+        if(y >= node->y + node->height/2.0)
+            t |= 2;
+        if(z >= node->z + node->depth/2.0)
+            t |= 4;
+        node = &node->children[t];
+    }
+    return node;
+}
+
+void Octree::findLeaves(std::vector<OctNode*>& leaves){
+    findLeavesHelper(leaves, root);
+}
+
+void Octree::findLeavesHelper(std::vector<OctNode*>& leaves, OctNode * node){
+    if(node->isLeaf)
+        leaves.push_back(node);
+    else {
+        for(int t = 0; t < NUM_CHILDREN; t++)
+            findLeavesHelper(leaves, &node->children[t]);
+    }
+}
+
+/************************* NEIGHBOR FINDING ******************************/
+
+void Octree::getNeighbors(OctNode * node,
+                          std::vector<std::vector<OctNode*> >& neighbors){
+    for(int direction = 0; direction < NUM_FACES; direction++){
+        OctNode * outer = sameSizeNeighbor(node, direction);
+        if(outer != NULL)
+            collectFace(outer, direction^1, neighbors[direction]);
+    }
+}
+
+/*
+ * Siblings are found directly, otherwise we find the same size neighbor of
+ * the parent and step into its child next to the node, NULL on the boundary
+ */
+OctNode * Octree::sameSizeNeighbor(OctNode * node, int direction){
+    if(node->parent == NULL)
+        return NULL;
+    if(!onSide(node->childType, direction))
+        return &node->parent->children[mirror(node->childType, direction)];
+    OctNode * outer = sameSizeNeighbor(node->parent, direction);
+    if(outer == NULL || outer->isLeaf)
+        return outer;
+    return &outer->children[mirror(node->childType, direction)];
+}
+
+void Octree::collectFace(OctNode * node, int direction,
+                         std::vector<OctNode*>& list){
+    if(node->isLeaf){
+        list.push_back(node);
+        return;
+    }
+    for(int t = 0; t < NUM_CHILDREN; t++){
+        if(onSide(t, direction))
+            collectFace(&node->children[t], direction, list);
+    }
+}
+
+bool Octree::levelPassed(OctNode * node){
+    vector<vector<OctNode*> > neighbors(NUM_FACES);
+    getNeighbors(node, neighbors);
+    int newLevel = node->currentLevel + 1;
+    for(int direction = 0; direction < NUM_FACES; direction++){
+        for(size_t i = 0; i < neighbors[direction].size(); i++){
+            if(abs(newLevel - neighbors[direction][i]->currentLevel) > 1)
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,154 @@
+//
+//  Octree.h
+//
+/*
+ * Three dimensional version of the QuadTree.
+ *
+ * Each node covers a box and is refined into eight children.  The index of
+ * a child is made of one bit per axis: bit 0 is set for the east (upper x)
+ * half, bit 1 for the north (upper y) half and bit 2 for the upper z half,
+ * so child 0 is the lower south west corner and child 7 the upper north
+ * east one.  The eight children of a node are allocated together and the
+ * node only keeps a pointer to the first one.
+ *
+ * The refinement criteria come from the same Application as the QuadTree
+ * through refine3D/coarsen3D, which ignore z by default.  Face neighbors are
+ * returned in six lists: north, south, east, west (as in QuadTree), up and
+ * down.  setBalanced(true) applies the Neighbor rule of the QuadTree: a node
+ * is only refined if its neighbors stay within one level of its children and
+ * only coarsened if its siblings are leaves.
+ */
+//
+
+#ifndef ____Octree__
+#define ____Octree__
+
+#include <vector>
+#include <cstddef>
+#include "Application.h"
+
+struct OctNode{
+    OctNode * children; //first of the eight children, NULL for a leaf
+    OctNode * parent;
+    double x, y, z; //lower corner
+    double width, height, depth;
+    int currentLevel;
+    int childType; //index in the parent's block, -1 for the root
+    bool isLeaf;
+};
+
+class Octree {
+public:
+
+    /*
+     * Number of children of a node and number of faces of a cell
+     */
+    static const int NUM_CHILDREN = 8;
+    static const int NUM_FACES = 6;
+
+    /*
+     * Constructor, the number of cells in the initial decomposition must be
+     * a power of 8
+     */
+    Octree(double x, double y, double z, double width, double height,
+           double depth, int numCells, int max, Application * app);
+
+    virtual ~Octree();
+
+    /*
+     * Refines and coarsens the octree until the desired refinement is reached
+     */
+    void update();
+
+    /*
+     * Refines and coarsens the node
+     */
+    void refineNode(OctNode * node);
+    void coarsenNode(OctNode * node);
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(OctNode * node);
+    virtual bool coarsen(OctNode * node);
+
+    /*
+     * Getter and setter for the one level neighbor restriction
+     */
+    bool getBalanced();
+    void setBalanced(bool b);
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    void findLeaves(std::vector<OctNode*>& leaves);
+
+    /*
+     * Face neighbors of a node, six lists in the order north (+y), south,
+     * east (+x), west, up (+z) and down
+     */
+    void getNeighbors(OctNode * node,
+                      std::vector<std::vector<OctNode*> >& neighbors);
+
+    /*
+     * Finds the leaf node that contains the particular x,y,z point
+     */
+    OctNode * findNode(double x, double y, double z);
+
+    /*
+     * x, y, z, width, height and depth of the root
+     */
+    std::vector<double> getDimensions();
+
+    int getSizeRoot();
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    bool getTime();
+    void setTime(bool t);
+    double getTotalCoarsen();
+    double getTotalRefine();
+
+    /*
+     * Counts the number of nodes in the tree
+     */
+    int countNodes();
+
+    /*
+     * Returns the total amount of memory used to store the octree
+     */
+    int storage();
+
+private:
+    Octree(const Octree&);
+    Octree& operator=(const Octree&);
+
+    void insert(OctNode * node, int levelsRemaining);
+    void destroyTree(OctNode * node);
+    void checkCriteria(OctNode * node);
+    void fullyRefine(OctNode * node);
+    void findLeavesHelper(std::vector<OctNode*>& leaves, OctNode * node);
+
+    /*
+     * Neighbor finding helpers, the same size node across a face (or the
+     * leaf containing it) and the leaves of a node facing a direction
+     */
+    OctNode * sameSizeNeighbor(OctNode * node, int direction);
+    void collectFace(OctNode * node, int direction,
+                     std::vector<OctNode*>& list);
+    bool levelPassed(OctNode * node);
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    OctNode * root;
+    Application * app;
+
+    int maxLevel;
+    bool balanced;
+    bool time;
+    double totalCoarsen;
+    double totalRefine;
+    int numBlocks; //blocks of eight children alive
+
+};
+
+#endif /* defined(____Octree__) */
@@ -25,4 +25,8 @@ bool OneLevel::coarsen(Node * node){
     node->parent->NWChild->isLeaf &&
     node->parent->SWChild->isLeaf &&
     node->parent->SEChild->isLeaf;
-}
\ No newline at end of file
+}
+
+bool OneLevel::independentSubtrees(){
+    return false;
+}
@@ -27,6 +27,7 @@ public:
     
     virtual bool refine(Node * node);
     virtual bool coarsen(Node * node);
+    virtual bool independentSubtrees(); //coarsening looks at the siblings
 };
 
 #endif /* defined(____OneLevel__) */
\ No newline at end of file
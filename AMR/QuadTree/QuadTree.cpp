@@ -7,10 +7,27 @@
 //
 //
 
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "QuadTree.h"
 
 using namespace std;
 
+/*
+ * CPU time used by the calling thread, in seconds.  Equivalent to clock() for
+ * a serial update and still meaningful when several threads update the tree
+ */
+static double threadTime(){
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}
+
 /*
  * Constructor
  */
@@ -22,9 +39,25 @@ QuadTree::QuadTree(double x, double y, double width, double height,
     while(i>>=1)
         ++numLevels;
  
+    cacheNeighbors  = false;
+    trackLeaves     = false;
+    lookupLevel     = 0;
+    lookupValid     = false;
+    instrumentation = NULL;
     insert(root, (numLevels/2), 0);
     maxLevel        = max;
     time            = false;
+    totalCoarsen    = 0;
+    totalRefine     = 0;
+    taskPool        = NULL;
+    parallelCutoff  = 0;
+    batched         = false;
+    batchCapacity   = 0;
+    dirtyRegions    = NULL;
+    dirtyBounds     = NULL;
+    compactThreshold = 0;
+    compactInterval = 1;
+    updatesSinceCompact = 0;
 
 }
 
@@ -49,25 +82,79 @@ void QuadTree::insert(Node * node, int levelsRemaining,int currentLevel){
 }
 
 /*
- * Destructor
+ * Destructor, the pool frees all of the descendants of the root at once
  */
 QuadTree::~QuadTree(){
-    destroyTree(root);
+    delete taskPool;
+    delete root;
 }
 
 /*
- * Recursive destructor helper
+ * Returns the sibling blocks below a node to the pool, deepest first.  The
+ * interior nodes are kept on a fixed stack until their subtree is done,
+ * subtrees deeper than the stack are walked through the parent pointers
+ * and child types instead (destroyDeep)
  */
-void QuadTree::destroyTree(Node * node){
-    if(node == NULL)
+void QuadTree::destroyTree(Node * top){
+    if(top->isLeaf){
+        if(trackLeaves)
+            removeLeaf(top);
         return;
-    else {
-        destroyTree(node->NEChild);
-        destroyTree(node->NWChild);
-        destroyTree(node->SWChild);
-        destroyTree(node->SEChild);
-        
-        delete node;
+    }
+    Node * stack[4*TreeWalk::STACK_LEVELS];
+    bool expanded[4*TreeWalk::STACK_LEVELS];
+    int size        = 0;
+    stack[size]     = top;
+    expanded[size++] = false;
+    while(size > 0){
+        Node * node = stack[size-1];
+        if(expanded[size-1]){
+            pool.release(node->NEChild);
+            size--;
+            continue;
+        }
+        if(size + 4 > 4*TreeWalk::STACK_LEVELS){
+            destroyDeep(node);
+            size--;
+            continue;
+        }
+        expanded[size-1] = true;
+        Node * children[4] = {node->SEChild, node->SWChild,
+                              node->NWChild, node->NEChild};
+        for(int i = 0; i < 4; i++){
+            if(children[i]->isLeaf){
+                if(trackLeaves)
+                    removeLeaf(children[i]);
+            }
+            else {
+                stack[size]     = children[i];
+                expanded[size++] = false;
+            }
+        }
+    }
+}
+
+/*
+ * Same as destroyTree for an interior node without any stack, a block is
+ * released when we climb out of its last (SE) child
+ */
+void QuadTree::destroyDeep(Node * top){
+    Node * node = top->NEChild;
+    while(true){
+        if(!node->isLeaf){
+            node = node->NEChild;
+            continue;
+        }
+        if(trackLeaves)
+            removeLeaf(node);
+        while(node->childType == 3){
+            Node * parent = node->parent;
+            pool.release(parent->NEChild);
+            if(parent == top)
+                return;
+            node = parent;
+        }
+        node = node + 1; //siblings are consecutive in their block
     }
 }
 
@@ -76,48 +163,313 @@ void QuadTree::destroyTree(Node * node){
  * Times the refinement and coarsening if time is true
  */
 void QuadTree::update(){
+    dirtyRegions = NULL;
+    updateTree();
+}
+
+void QuadTree::update(const Rect& dirty){
+    vector<Rect> regions(1, dirty);
+    update(regions);
+}
+
+void QuadTree::update(const std::vector<Rect>& dirty){
+    if(dirty.empty())
+        return;
+    //bounding box of all the rectangles, rejects most nodes with one test
+    double minX = dirty[0].x, maxX = dirty[0].x + dirty[0].width;
+    double minY = dirty[0].y, maxY = dirty[0].y + dirty[0].height;
+    for(size_t i = 1; i < dirty.size(); i++){
+        minX = min(minX, dirty[i].x);
+        maxX = max(maxX, dirty[i].x + dirty[i].width);
+        minY = min(minY, dirty[i].y);
+        maxY = max(maxY, dirty[i].y + dirty[i].height);
+    }
+    Rect bounds(minX, minY, maxX-minX, maxY-minY);
+    dirtyBounds  = &bounds;
+    dirtyRegions = &dirty;
+    updateTree();
+    dirtyRegions = NULL;
+    dirtyBounds  = NULL;
+}
+
+static bool touches(Node * node, const Rect& r){
+    return node->x <= r.x + r.width && r.x <= node->x + node->width &&
+           node->y <= r.y + r.height && r.y <= node->y + node->height;
+}
+
+bool QuadTree::isDirty(Node * node){
+    if(dirtyRegions == NULL)
+        return true;
+    if(!touches(node, *dirtyBounds))
+        return false;
+    for(size_t i = 0; i < dirtyRegions->size(); i++){
+        if(touches(node, (*dirtyRegions)[i]))
+            return true;
+    }
+    return false;
+}
+
+void QuadTree::updateTree(){
+    ScopedPhase phase(instrumentation, PHASE_TRAVERSAL);
     if(time){
         totalRefine     = 0;
         totalCoarsen    = 0;
     }
-    checkCriteria(root);
+    if(taskPool != NULL && independentSubtrees() && !cacheNeighbors &&
+       fields.empty() && patchFields.empty()){
+        //the leaf arrays are shared, rebuild them once the tasks are done,
+        //the tasks are not instrumented since they run on other threads
+        bool tracking   = trackLeaves;
+        trackLeaves     = false;
+        Instrumentation * instrumented = instrumentation;
+        instrumentation = NULL;
+        pool.setShared(true);
+        parallelCheckCriteria(root);
+        taskPool->wait();
+        pool.setShared(false);
+        instrumentation = instrumented;
+        setTrackLeaves(tracking);
+    }
+    else if(batched && independentSubtrees())
+        batchedCheckCriteria();
+    else
+        checkCriteria(root, totalRefine, totalCoarsen);
+    checkCompaction();
 
 }
 
 /*
- * Recursive helper method for updating the tree
+ * Helper method for updating the subtree of top, a pre-order walk that
+ * skips the subtrees of the nodes it refines, coarsens or finds clean
  */
-void QuadTree::checkCriteria(Node * node){
-    double start, finish;
-    if(node->isLeaf){
-        if(refine(node)){
-            if(time)
-                start       = clock();
-            fullyRefine(node);
-            if(time){
-                finish      = clock();
-                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+void QuadTree::checkCriteria(Node * top, double& refineTime,
+                             double& coarsenTime){
+    double start = 0;
+    TreeWalk walk(top);
+    while(Node * node = walk.current()){
+        if(!isDirty(node)){
+            walk.skip();
+            continue;
+        }
+        if(node->isLeaf){
+            if(checkRefine(node)){
+                if(time)
+                    start       = threadTime();
+                fullyRefine(node);
+                if(time)
+                    refineTime  = refineTime + (threadTime()-start);
             }
         }
+        else if(checkCoarsen(node)){
+            if(time)
+                start           = threadTime();
+            coarsenNode(node);
+            if(time)
+                coarsenTime     = coarsenTime + (threadTime()-start);
+        }
+        else {
+            walk.descend();
+            continue;
+        }
+        walk.skip();
+    }
+}
+
+/*
+ * Parallel helper method for updating the tree, the subtrees of the children
+ * are independent so each one becomes a task until we reach the cutoff
+ */
+void QuadTree::parallelCheckCriteria(Node * node){
+    double refineTime   = 0;
+    double coarsenTime  = 0;
+    if(!isDirty(node))
+        return;
+    if(node->currentLevel >= parallelCutoff){
+        checkCriteria(node, refineTime, coarsenTime);
+        addTimes(refineTime, coarsenTime);
+    }
+    else if(node->isLeaf){
+        if(refine(node))
+            parallelFullyRefine(node);
     }
     else if(coarsen(node)){
+        double start = 0;
         if(time)
-            start           = clock();
+            start           = threadTime();
         coarsenNode(node);
-        if(time){
-            finish          = clock();
-            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
+        if(time)
+            addTimes(0, threadTime()-start);
+    }
+    else {
+        Node * children[4] = {node->NEChild, node->NWChild,
+                              node->SWChild, node->SEChild};
+        for(int i = 0; i < 4; i++){
+            Node * child = children[i];
+            taskPool->spawn([this, child](){ parallelCheckCriteria(child); });
         }
+    }
+}
 
+void QuadTree::parallelFullyRefine(Node * node){
+    double start = 0;
+    if(time)
+        start = threadTime();
+    if(node->currentLevel >= parallelCutoff){
+        fullyRefine(node);
+        if(time)
+            addTimes(threadTime()-start, 0);
+        return;
     }
-    else{
-        checkCriteria(node->NEChild);
-        checkCriteria(node->NWChild);
-        checkCriteria(node->SWChild);
-        checkCriteria(node->SEChild);
+    refineNode(node);
+    if(time)
+        addTimes(threadTime()-start, 0);
+    Node * children[4] = {node->NEChild, node->NWChild,
+                          node->SWChild, node->SEChild};
+    for(int i = 0; i < 4; i++){
+        Node * child = children[i];
+        taskPool->spawn([this, child](){
+            if(refine(child))
+                parallelFullyRefine(child);
+        });
     }
 }
 
+void QuadTree::addTimes(double refineTime, double coarsenTime){
+    if(!time)
+        return;
+    lock_guard<mutex> guard(timeLock);
+    totalRefine     = totalRefine + refineTime;
+    totalCoarsen    = totalCoarsen + coarsenTime;
+}
+
+/*
+ * Level by level version of checkCriteria.  With independent subtrees the
+ * order the nodes are visited in does not matter, so the nodes are processed
+ * one level (frontier) at a time: leaves are refined and their children join
+ * the next frontier, interior nodes are either coarsened or their children
+ * join the next frontier.  Each frontier needs one refineBatch and one
+ * coarsenBatch call.  Children created by this update are kept apart since
+ * they have to be checked even outside of the dirty regions.
+ */
+void QuadTree::batchedCheckCriteria(){
+    Application * app = root->app;
+    vector<Node*> frontier(1, root);
+    vector<Node*> fresh, next, nextFresh, leaves, interior;
+    double start = 0;
+    
+    while(!frontier.empty() || !fresh.empty()){
+        leaves.clear();
+        interior.clear();
+        for(size_t i = 0; i < frontier.size(); i++){
+            Node * node = frontier[i];
+            if(!isDirty(node))
+                continue;
+            if(!node->isLeaf)
+                interior.push_back(node);
+            else if(node->currentLevel < maxLevel)
+                leaves.push_back(node);
+        }
+        for(size_t i = 0; i < fresh.size(); i++){
+            if(fresh[i]->currentLevel < maxLevel)
+                leaves.push_back(fresh[i]);
+        }
+        next.clear();
+        nextFresh.clear();
+        
+        gatherBatch(leaves);
+        {
+            ScopedPhase criteria(instrumentation, PHASE_CRITERIA);
+            app->refineBatch(&batchX[0], &batchY[0], &batchWidth[0],
+                             &batchHeight[0], batchFlags.get(), leaves.size());
+        }
+        if(time)
+            start = threadTime();
+        for(size_t i = 0; i < leaves.size(); i++){
+            if(!batchFlags[i])
+                continue;
+            Node * node = leaves[i];
+            refineNode(node);
+            nextFresh.push_back(node->NEChild);
+            nextFresh.push_back(node->NWChild);
+            nextFresh.push_back(node->SWChild);
+            nextFresh.push_back(node->SEChild);
+        }
+        if(time)
+            totalRefine = totalRefine + (threadTime()-start);
+        
+        gatherBatch(interior);
+        {
+            ScopedPhase criteria(instrumentation, PHASE_CRITERIA);
+            app->coarsenBatch(&batchX[0], &batchY[0], &batchWidth[0],
+                              &batchHeight[0], batchFlags.get(), interior.size());
+        }
+        for(size_t i = 0; i < interior.size(); i++){
+            Node * node = interior[i];
+            if(batchFlags[i]){
+                if(time)
+                    start = threadTime();
+                coarsenNode(node);
+                if(time)
+                    totalCoarsen = totalCoarsen + (threadTime()-start);
+            }
+            else {
+                next.push_back(node->NEChild);
+                next.push_back(node->NWChild);
+                next.push_back(node->SWChild);
+                next.push_back(node->SEChild);
+            }
+        }
+        frontier.swap(next);
+        fresh.swap(nextFresh);
+    }
+}
+
+void QuadTree::gatherBatch(const std::vector<Node*>& nodes){
+    size_t n = nodes.size();
+    if(n > batchCapacity || batchCapacity == 0){
+        batchCapacity = (n > 2*batchCapacity) ? n : 2*batchCapacity;
+        if(batchCapacity == 0)
+            batchCapacity = 1;
+        batchX.resize(batchCapacity);
+        batchY.resize(batchCapacity);
+        batchWidth.resize(batchCapacity);
+        batchHeight.resize(batchCapacity);
+        batchFlags.reset(new bool[batchCapacity]);
+    }
+    for(size_t i = 0; i < n; i++){
+        batchX[i]       = nodes[i]->x;
+        batchY[i]       = nodes[i]->y;
+        batchWidth[i]   = nodes[i]->width;
+        batchHeight[i]  = nodes[i]->height;
+    }
+}
+
+bool QuadTree::getBatched(){
+    return batched;
+}
+
+void QuadTree::setBatched(bool b){
+    batched = b;
+}
+
+void QuadTree::setParallel(int numThreads, int cutoffLevel){
+    delete taskPool;
+    taskPool        = NULL;
+    parallelCutoff  = cutoffLevel;
+    if(numThreads > 1)
+        taskPool    = new WorkStealingPool(numThreads);
+}
+
+int QuadTree::getParallelThreads(){
+    if(taskPool == NULL)
+        return 1;
+    return taskPool->getNumThreads();
+}
+
+bool QuadTree::independentSubtrees(){
+    return true;
+}
+
 /*
  * Returns a boolean determining if the node should be coarsened
  */
@@ -139,8 +491,19 @@ bool QuadTree::refine(Node * node){
     
 }
 
+bool QuadTree::checkRefine(Node * node){
+    ScopedPhase phase(instrumentation, PHASE_CRITERIA);
+    return refine(node);
+}
+
+bool QuadTree::checkCoarsen(Node * node){
+    ScopedPhase phase(instrumentation, PHASE_CRITERIA);
+    return coarsen(node);
+}
+
 /*
- * Refines a leaf node by adding four children
+ * Refines a leaf node by adding four children, the children share one
+ * contiguous block from the node pool
  */
 void QuadTree::refineNode(Node * node){
     double x        = node->x;
@@ -148,11 +511,58 @@ void QuadTree::refineNode(Node * node){
     double w        = (node->width)/2.0;
     double h        = (node->height)/2.0;
     int newLevel    = node->currentLevel +1;
-    node->NEChild   = new Node((x+w),(y+h),w,h,node,newLevel,0,node->app);
-    node->NWChild   = new Node(x,y+h,w,h,node,newLevel,1,node->app);
-    node->SWChild   = new Node(x,y,w,h,node,newLevel,2,node->app);
-    node->SEChild   = new Node(x+w,y,w,h,node,newLevel,3,node->app);
+    {
+        ScopedPhase phase(instrumentation, PHASE_ALLOCATION);
+        Node * block    = pool.allocate();
+        node->NEChild   = new (&block[0]) Node((x+w),(y+h),w,h,node,newLevel,0,node->app);
+        node->NWChild   = new (&block[1]) Node(x,y+h,w,h,node,newLevel,1,node->app);
+        node->SWChild   = new (&block[2]) Node(x,y,w,h,node,newLevel,2,node->app);
+        node->SEChild   = new (&block[3]) Node(x+w,y,w,h,node,newLevel,3,node->app);
+    }
     node->isLeaf    = false;
+    if(node->currentLevel < lookupLevel)
+        lookupValid = false;
+    
+    if(cacheNeighbors){
+        ScopedPhase phase(instrumentation, PHASE_NEIGHBORS);
+        linkChildren(node);
+        for(int direction = 0; direction < 4; direction++)
+            relinkFace(node, direction, true);
+    }
+    if(trackLeaves){
+        for(size_t f = 0; f < fields.size(); f++)
+            fieldScratch[f] = fields[f].values[node->leafIndex];
+        for(size_t f = 0; f < patchFields.size(); f++){
+            PatchField& field   = patchFields[f];
+            const double * patch = getPatch(f, node->leafIndex);
+            for(int j = 0; j < field.size; j++)
+                copy(patch + (j+field.ghosts)*field.stride + field.ghosts,
+                     patch + (j+field.ghosts)*field.stride + field.ghosts +
+                     field.size, &patchScratch[f][j*field.size]);
+        }
+        removeLeaf(node);
+        addLeaf(node->NEChild);
+        addLeaf(node->NWChild);
+        addLeaf(node->SWChild);
+        addLeaf(node->SEChild);
+        for(size_t f = 0; f < fields.size(); f++){
+            double value        = fieldScratch[f];
+            double children[4]  = {value, value, value, value};
+            if(fields[f].prolongate)
+                fields[f].prolongate(node, value, children);
+            vector<double>& values = fields[f].values;
+            values[node->NEChild->leafIndex] = children[0];
+            values[node->NWChild->leafIndex] = children[1];
+            values[node->SWChild->leafIndex] = children[2];
+            values[node->SEChild->leafIndex] = children[3];
+        }
+        for(size_t f = 0; f < patchFields.size(); f++)
+            prolongPatch(node, patchFields[f], &patchScratch[f][0]);
+    }
+    nodeRefined(node);
+}
+
+void QuadTree::nodeRefined(Node *){
 }
 
 /*
@@ -160,10 +570,23 @@ void QuadTree::refineNode(Node * node){
  */
 void QuadTree::coarsenNode(Node * node){
     //cout<<"we tagged a node for coarsening"<<endl;
-    destroyTree(node->SEChild);
-    destroyTree(node->SWChild);
-    destroyTree(node->NWChild);
-    destroyTree(node->NEChild);
+    if(node->currentLevel < lookupLevel)
+        lookupValid = false;
+    if(cacheNeighbors){
+        ScopedPhase phase(instrumentation, PHASE_NEIGHBORS);
+        for(int direction = 0; direction < 4; direction++)
+            relinkFace(node, direction, false);
+    }
+    if(trackLeaves){
+        for(size_t f = 0; f < fields.size(); f++)
+            fieldScratch[f] = restrictSubtree(node, fields[f]);
+        for(size_t f = 0; f < patchFields.size(); f++)
+            restrictPatch(node, patchFields[f], &patchScratch[f][0]);
+    }
+    {
+        ScopedPhase phase(instrumentation, PHASE_ALLOCATION);
+        destroyTree(node);
+    }
     
     //reset child pointers
     node->NEChild   = NULL;
@@ -171,6 +594,19 @@ void QuadTree::coarsenNode(Node * node){
     node->SWChild   = NULL;
     node->SEChild   = NULL;
     node->isLeaf    = true;
+    if(trackLeaves){
+        addLeaf(node);
+        for(size_t f = 0; f < fields.size(); f++)
+            fields[f].values[node->leafIndex] = fieldScratch[f];
+        for(size_t f = 0; f < patchFields.size(); f++){
+            PatchField& field   = patchFields[f];
+            double * patch      = getPatch(f, node->leafIndex);
+            for(int j = 0; j < field.size; j++)
+                copy(&patchScratch[f][j*field.size],
+                     &patchScratch[f][(j+1)*field.size],
+                     patch + (j+field.ghosts)*field.stride + field.ghosts);
+        }
+    }
 }
 
 /*
@@ -179,22 +615,22 @@ void QuadTree::coarsenNode(Node * node){
  * To the maximum level or
  * The refinement criteria is no longer satisfied
  */
-void QuadTree::fullyRefine(Node * node){
-    
-    refineNode(node);
-    
-    if(refine(node->NEChild))
-        fullyRefine(node->NEChild);
-    
-    if(refine(node->NWChild))
-        fullyRefine(node->NWChild);
+void QuadTree::fullyRefine(Node * top){
     
-    if(refine(node->SWChild))
-        fullyRefine(node->SWChild);
-    
-    if(refine(node->SEChild))
-        fullyRefine(node->SEChild);
+    if(top->isLeaf) //a subclass may already have refined it
+        refineNode(top);
     
+    TreeWalk walk(top);
+    walk.descend();
+    while(Node * node = walk.current()){
+        if(checkRefine(node)){
+            if(node->isLeaf)
+                refineNode(node);
+            walk.descend();
+        }
+        else
+            walk.skip();
+    }
 }
 
 /**********************DEBUGGING AND TREE INFO****************************/
@@ -218,38 +654,442 @@ void QuadTree::setTime(bool t){
     time = t;
 }
 
-double QuadTree::getTotalCoarsen(){
-    return totalCoarsen;
+bool QuadTree::getCacheNeighbors(){
+    return cacheNeighbors;
 }
 
-double QuadTree::getTotalRefine(){
-    return totalRefine;
+void QuadTree::setCacheNeighbors(bool cache){
+    if(cache && !cacheNeighbors)
+        buildNeighborLinks(root);
+    cacheNeighbors = cache;
+}
+
+bool QuadTree::getTrackLeaves(){
+    return trackLeaves;
 }
 
-//memory usage
-int QuadTree::storage(){
-    return storageHelper(root);
+void QuadTree::setTrackLeaves(bool track){
+    if(track && trackLeaves)
+        return;
+    fields.clear();
+    patchFields.clear();
+    leafX.clear();
+    leafY.clear();
+    leafWidth.clear();
+    leafHeight.clear();
+    leafLevel.clear();
+    leafNodes.clear();
+    trackLeaves = track;
+    if(track)
+        buildLeaves(root);
 }
 
-int QuadTree::storageHelper(Node * node){
+void QuadTree::buildLeaves(Node * node){
     if(node->isLeaf)
-        return sizeof(Node);
+        addLeaf(node);
     else {
-        return sizeof(Node)+
-        storageHelper(node->NEChild)+
-        storageHelper(node->NWChild)+
-        storageHelper(node->SWChild)+
-        storageHelper(node->SEChild);
+        buildLeaves(node->NEChild);
+        buildLeaves(node->NWChild);
+        buildLeaves(node->SWChild);
+        buildLeaves(node->SEChild);
+    }
+}
+
+void QuadTree::addLeaf(Node * node){
+    node->leafIndex = leafNodes.size();
+    for(size_t f = 0; f < fields.size(); f++)
+        fields[f].values.push_back(0.0);
+    for(size_t f = 0; f < patchFields.size(); f++){
+        PatchField& field = patchFields[f];
+        field.values.resize(field.values.size() + field.stride*field.stride,
+                            0.0);
+    }
+    leafX.push_back(node->x);
+    leafY.push_back(node->y);
+    leafWidth.push_back(node->width);
+    leafHeight.push_back(node->height);
+    leafLevel.push_back(node->currentLevel);
+    leafNodes.push_back(node);
+}
+
+void QuadTree::removeLeaf(Node * node){
+    size_t i        = node->leafIndex;
+    size_t last     = leafNodes.size() - 1;
+    if(i != last){
+        leafX[i]        = leafX[last];
+        leafY[i]        = leafY[last];
+        leafWidth[i]    = leafWidth[last];
+        leafHeight[i]   = leafHeight[last];
+        leafLevel[i]    = leafLevel[last];
+        leafNodes[i]    = leafNodes[last];
+        leafNodes[i]->leafIndex = i;
+        for(size_t f = 0; f < fields.size(); f++)
+            fields[f].values[i] = fields[f].values[last];
+        for(size_t f = 0; f < patchFields.size(); f++){
+            size_t cells    = patchFields[f].stride*patchFields[f].stride;
+            double * values = &patchFields[f].values[0];
+            copy(values + last*cells, values + (last+1)*cells,
+                 values + i*cells);
+        }
+    }
+    for(size_t f = 0; f < fields.size(); f++)
+        fields[f].values.pop_back();
+    for(size_t f = 0; f < patchFields.size(); f++){
+        PatchField& field = patchFields[f];
+        field.values.resize(field.values.size() - field.stride*field.stride);
+    }
+    leafX.pop_back();
+    leafY.pop_back();
+    leafWidth.pop_back();
+    leafHeight.pop_back();
+    leafLevel.pop_back();
+    leafNodes.pop_back();
+    node->leafIndex = -1;
+}
+
+size_t QuadTree::getNumLeaves(){
+    return leafNodes.size();
+}
+
+const double * QuadTree::getLeafX(){
+    return leafX.empty() ? NULL : &leafX[0];
+}
+
+const double * QuadTree::getLeafY(){
+    return leafY.empty() ? NULL : &leafY[0];
+}
+
+const double * QuadTree::getLeafWidth(){
+    return leafWidth.empty() ? NULL : &leafWidth[0];
+}
+
+const double * QuadTree::getLeafHeight(){
+    return leafHeight.empty() ? NULL : &leafHeight[0];
+}
+
+const int * QuadTree::getLeafLevel(){
+    return leafLevel.empty() ? NULL : &leafLevel[0];
+}
+
+Node * const * QuadTree::getLeafNodes(){
+    return leafNodes.empty() ? NULL : &leafNodes[0];
+}
+
+int QuadTree::addField(const std::string& name,
+                       const Prolongation& prolongate,
+                       const Restriction& restriction){
+    setTrackLeaves(true);
+    CellField field;
+    field.name          = name;
+    field.prolongate    = prolongate;
+    field.restriction   = restriction;
+    field.values.assign(leafNodes.size(), 0.0);
+    fields.push_back(field);
+    fieldScratch.resize(fields.size());
+    return fields.size() - 1;
+}
+
+int QuadTree::getFieldId(const std::string& name){
+    for(size_t f = 0; f < fields.size(); f++){
+        if(fields[f].name == name)
+            return f;
+    }
+    return -1;
+}
+
+double * QuadTree::getField(int id){
+    vector<double>& values = fields[id].values;
+    return values.empty() ? NULL : &values[0];
+}
+
+int QuadTree::getNumFields(){
+    return fields.size();
+}
+
+double QuadTree::restrictSubtree(Node * node, CellField& field){
+    if(node->isLeaf)
+        return field.values[node->leafIndex];
+    double children[4] = {restrictSubtree(node->NEChild, field),
+                          restrictSubtree(node->NWChild, field),
+                          restrictSubtree(node->SWChild, field),
+                          restrictSubtree(node->SEChild, field)};
+    if(field.restriction)
+        return field.restriction(node, children);
+    return 0.25*(children[0] + children[1] + children[2] + children[3]);
+}
+
+int QuadTree::addPatchField(const std::string& name, int size, int ghosts){
+    // a child covers half the cells of its parent in each direction
+    if(size <= 0 || size % 2 != 0 || ghosts < 0)
+        return -1;
+    setTrackLeaves(true);
+    PatchField field;
+    field.name      = name;
+    field.size      = size;
+    field.ghosts    = ghosts;
+    field.stride    = size + 2*ghosts;
+    field.values.assign(leafNodes.size()*field.stride*field.stride, 0.0);
+    patchFields.push_back(field);
+    patchScratch.push_back(vector<double>(size*size));
+    return patchFields.size() - 1;
+}
+
+int QuadTree::getPatchFieldId(const std::string& name){
+    for(size_t f = 0; f < patchFields.size(); f++){
+        if(patchFields[f].name == name)
+            return f;
+    }
+    return -1;
+}
+
+double * QuadTree::getPatch(int id, size_t leafIndex){
+    PatchField& field = patchFields[id];
+    return &field.values[leafIndex*field.stride*field.stride];
+}
+
+int QuadTree::getPatchSize(int id){
+    return patchFields[id].size;
+}
+
+int QuadTree::getPatchGhosts(int id){
+    return patchFields[id].ghosts;
+}
+
+int QuadTree::getPatchStride(int id){
+    return patchFields[id].stride;
+}
+
+int QuadTree::getNumPatchFields(){
+    return patchFields.size();
+}
+
+/*
+ * The quadrants of the children in a patch of the parent, in units of half
+ * a patch: NE, NW, SW, SE
+ */
+static const int quadrantX[4] = {1, 0, 0, 1};
+static const int quadrantY[4] = {1, 1, 0, 0};
+
+void QuadTree::restrictPatch(Node * node, PatchField& field, double * cells){
+    int n = field.size;
+    if(node->isLeaf){
+        const double * patch = getPatch(&field - &patchFields[0],
+                                        node->leafIndex);
+        for(int j = 0; j < n; j++)
+            copy(patch + (j+field.ghosts)*field.stride + field.ghosts,
+                 patch + (j+field.ghosts)*field.stride + field.ghosts + n,
+                 cells + j*n);
+        return;
     }
+    vector<double> child(n*n);
+    Node * children[4] = {node->NEChild, node->NWChild,
+                          node->SWChild, node->SEChild};
+    for(int q = 0; q < 4; q++){
+        restrictPatch(children[q], field, &child[0]);
+        int x0 = quadrantX[q]*n/2;
+        int y0 = quadrantY[q]*n/2;
+        for(int j = 0; j < n/2; j++){
+            for(int i = 0; i < n/2; i++){
+                const double * c = &child[2*j*n + 2*i];
+                cells[(y0+j)*n + x0+i] = 0.25*(c[0] + c[1] + c[n] + c[n+1]);
+            }
+        }
+    }
+}
+
+void QuadTree::prolongPatch(Node * node, PatchField& field,
+                            const double * cells){
+    int n = field.size;
+    Node * children[4] = {node->NEChild, node->NWChild,
+                          node->SWChild, node->SEChild};
+    for(int q = 0; q < 4; q++){
+        double * patch = getPatch(&field - &patchFields[0],
+                                  children[q]->leafIndex);
+        int x0 = quadrantX[q]*n/2;
+        int y0 = quadrantY[q]*n/2;
+        for(int j = 0; j < n; j++){
+            double * row        = patch + (j+field.ghosts)*field.stride +
+                                  field.ghosts;
+            const double * from = cells + (y0 + j/2)*n + x0;
+            for(int i = 0; i < n; i++)
+                row[i] = from[i/2];
+        }
+    }
+}
+
+void QuadTree::fillGhosts(int id){
+    if(!cacheNeighbors)
+        setCacheNeighbors(true);
+    PatchField& field = patchFields[id];
+    vector<vector<Node*> > neighbors(4);
+    for(size_t l = 0; l < leafNodes.size(); l++){
+        for(int d = 0; d < 4; d++)
+            neighbors[d].clear();
+        getNeighbors(leafNodes[l], neighbors);
+        for(int d = 0; d < 4; d++)
+            fillFaceGhosts(leafNodes[l], d, neighbors[d], field);
+    }
+}
+
+/*
+ * Ghost cell (a,b) across a face is layer a out from the face and b along
+ * it, from the west (north and south faces) or the south (east and west
+ * faces).  Its values are summed over the neighbor cells whose centers are
+ * inside it, or taken from the neighbor cell containing it when that is not
+ * smaller.  Ghost cells reaching past a finer neighbor average the part it
+ * covers, those it does not reach copy the layer inside them
+ */
+void QuadTree::fillFaceGhosts(Node * leaf, int direction,
+                              const vector<Node*>& neighbors,
+                              PatchField& field){
+    int n           = field.size;
+    int g           = field.ghosts;
+    int s           = field.stride;
+    double h        = leaf->width/n;
+    double * patch  = getPatch(&field - &patchFields[0], leaf->leafIndex);
+    bool vertical   = (direction < 2); //north or south, b runs along x
+    int outward     = (direction == 0 || direction == 2) ? 1 : -1;
+    
+    //patch coordinates (i,j) of ghost cell (a,b)
+    auto ghostCell = [&](int a, int b, int& i, int& j){
+        int across  = (outward > 0) ? n + a : -1 - a;
+        i           = vertical ? b : across;
+        j           = vertical ? across : b;
+    };
     
+    if(neighbors.empty()){
+        //domain boundary, the edge cell outwards
+        for(int a = 0; a < g; a++){
+            for(int b = 0; b < n; b++){
+                int i, j, ei, ej;
+                ghostCell(a, b, i, j);
+                ghostCell(-1, b, ei, ej);
+                patch[(j+g)*s + i+g] = patch[(ej+g)*s + ei+g];
+            }
+        }
+        return;
+    }
+    
+    vector<double> sum(g*n, 0.0);
+    vector<int> count(g*n, 0);
+    for(size_t m = 0; m < neighbors.size(); m++){
+        Node * other        = neighbors[m];
+        double hm           = other->width/n;
+        const double * from = getPatch(&field - &patchFields[0],
+                                       other->leafIndex);
+        for(int a = 0; a < g; a++){
+            for(int b = 0; b < n; b++){
+                int i, j;
+                ghostCell(a, b, i, j);
+                double gx   = leaf->x + i*h;
+                double gy   = leaf->y + j*h;
+                if(hm >= h){
+                    double cx   = gx + 0.5*h - other->x;
+                    double cy   = gy + 0.5*h - other->y;
+                    if(cx < 0 || cy < 0 || cx >= other->width ||
+                       cy >= other->height)
+                        continue;
+                    int oi      = min(n-1, int(cx/hm));
+                    int oj      = min(n-1, int(cy/hm));
+                    sum[a*n+b]  = from[(oj+g)*s + oi+g];
+                    count[a*n+b] = 1;
+                    continue;
+                }
+                int i0 = max(0, min(n, int(lround((gx - other->x)/hm))));
+                int i1 = max(0, min(n, int(lround((gx + h - other->x)/hm))));
+                int j0 = max(0, min(n, int(lround((gy - other->y)/hm))));
+                int j1 = max(0, min(n, int(lround((gy + h - other->y)/hm))));
+                for(int oj = j0; oj < j1; oj++){
+                    for(int oi = i0; oi < i1; oi++){
+                        sum[a*n+b] += from[(oj+g)*s + oi+g];
+                        count[a*n+b]++;
+                    }
+                }
+            }
+        }
+    }
+    for(int a = 0; a < g; a++){
+        for(int b = 0; b < n; b++){
+            int i, j;
+            ghostCell(a, b, i, j);
+            if(count[a*n+b] > 0){
+                patch[(j+g)*s + i+g] = sum[a*n+b]/count[a*n+b];
+                continue;
+            }
+            int ii, jj;
+            ghostCell(a-1, b, ii, jj);
+            patch[(j+g)*s + i+g] = patch[(jj+g)*s + ii+g];
+        }
+    }
+}
+
+void QuadTree::forEachLeaf(const std::function<void(size_t, size_t)>& body,
+                           size_t grainSize){
+    if(!trackLeaves)
+        setTrackLeaves(true);
+    size_t n = leafNodes.size();
+    if(grainSize == 0)
+        grainSize = 1;
+    if(taskPool == NULL || n <= grainSize){
+        body(0, n);
+        return;
+    }
+    for(size_t begin = 0; begin < n; begin += grainSize){
+        size_t end = min(n, begin + grainSize);
+        taskPool->spawn([&body, begin, end](){ body(begin, end); });
+    }
+    taskPool->wait();
+}
+
+double QuadTree::getTotalCoarsen(){
+    return totalCoarsen;
 }
 
-Node* QuadTree::findNode(float x, float y) {
-    return findNodeHelper(x,y,root);
+Instrumentation * QuadTree::getInstrumentation(){
+    return instrumentation;
+}
+
+void QuadTree::setInstrumentation(Instrumentation * i){
+    instrumentation = i;
+}
+
+double QuadTree::getTotalRefine(){
+    return totalRefine;
+}
+
+//memory usage of the live nodes, the root plus four nodes per live block
+size_t QuadTree::storage(){
+    return sizeof(Node)*(1 + NodePool::BLOCK_SIZE*pool.getBlocksInUse());
+}
+
+//the root plus everything held by the node pool
+size_t QuadTree::reservedStorage(){
+    return sizeof(Node) + pool.getReservedBytes();
+}
+
+int QuadTree::getPeakBlocks(){
+    return pool.getPeakBlocks();
+}
+
+double QuadTree::getReuseRate(){
+    return pool.getReuseRate();
+}
+
+Node* QuadTree::findNode(double x, double y) {
+    if(lookupLevel == 0)
+        return findNodeHelper(x,y,root);
+    if(!lookupValid)
+        buildLookupGrid();
+    int cells   = 1<<lookupLevel;
+    int ix      = int(floor((x - root->x)/root->width*cells));
+    int iy      = int(floor((y - root->y)/root->height*cells));
+    ix          = (ix < 0) ? 0 : ((ix >= cells) ? cells-1 : ix);
+    iy          = (iy < 0) ? 0 : ((iy >= cells) ? cells-1 : iy);
+    return findNodeHelper(x,y,lookupGrid[iy*cells + ix]);
 }
 
 //find which node a given set of coordinates is located
-Node* QuadTree::findNodeHelper(float x, float y, Node * node){
+Node* QuadTree::findNodeHelper(double x, double y, Node * node){
     if(node->isLeaf  && (x < (node->x + node->width)) &&
        (y < (node->y + node->height)))
         return node;
@@ -268,36 +1108,396 @@ Node* QuadTree::findNodeHelper(float x, float y, Node * node){
     
 }
 
+/*
+ * Morton keys of the query points are taken on a 2^KEY_LEVELS grid, a node
+ * on level l covers the keys [key, key + 4^(KEY_LEVELS-l)) in Morton order
+ * SW, SE, NW, NE
+ */
+static const int KEY_LEVELS = 30;
+
+static uint64_t spreadBits(uint64_t v){
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+}
+
+uint64_t QuadTree::pointKey(double x, double y){
+    double cells    = ldexp(1.0, KEY_LEVELS);
+    double fx       = floor((x - root->x)/root->width*cells);
+    double fy       = floor((y - root->y)/root->height*cells);
+    fx              = (fx < 0) ? 0 : ((fx > cells-1) ? cells-1 : fx);
+    fy              = (fy < 0) ? 0 : ((fy > cells-1) ? cells-1 : fy);
+    return spreadBits((uint64_t)fx) | (spreadBits((uint64_t)fy) << 1);
+}
+
+void QuadTree::findNodes(const double* xs, const double* ys, Node** out,
+                         size_t n){
+    //counting sort on the top bits of the key, then sort each small bucket
+    const int bucketBits = 16;
+    const int shift      = 2*KEY_LEVELS - bucketBits;
+    vector<uint64_t> keys(n);
+    vector<size_t> offsets((1<<bucketBits) + 1, 0);
+    for(size_t i = 0; i < n; i++){
+        keys[i] = pointKey(xs[i],ys[i]);
+        offsets[(keys[i] >> shift) + 1]++;
+    }
+    for(size_t b = 1; b < offsets.size(); b++)
+        offsets[b] += offsets[b-1];
+    vector<pair<uint64_t,size_t> > queries(n);
+    vector<size_t> next(offsets.begin(), offsets.end()-1);
+    for(size_t i = 0; i < n; i++)
+        queries[next[keys[i] >> shift]++] = make_pair(keys[i], i);
+    for(size_t b = 0; b+1 < offsets.size(); b++){
+        if(offsets[b+1] - offsets[b] > 1)
+            sort(queries.begin() + offsets[b], queries.begin() + offsets[b+1]);
+    }
+    findNodesHelper(root, 0, 0, queries, 0, n, out);
+}
+
+void QuadTree::findNodesHelper(Node * node, int level, uint64_t key,
+                               const std::vector<std::pair<uint64_t,size_t> >& queries,
+                               size_t begin, size_t end, Node** out){
+    if(begin == end)
+        return;
+    if(node->isLeaf || level == KEY_LEVELS){
+        for(size_t i = begin; i < end; i++)
+            out[queries[i].second] = node;
+        return;
+    }
+    Node * children[4] = {node->SWChild, node->SEChild,
+                          node->NWChild, node->NEChild};
+    uint64_t span = ((uint64_t)1) << (2*(KEY_LEVELS-level-1));
+    for(int q = 0; q < 4; q++){
+        uint64_t childKey = key + q*span;
+        size_t childEnd   = end;
+        if(q < 3)
+            childEnd = lower_bound(queries.begin() + begin,
+                                   queries.begin() + end,
+                                   make_pair(childKey + span, (size_t)0))
+                       - queries.begin();
+        findNodesHelper(children[q], level+1, childKey, queries,
+                        begin, childEnd, out);
+        begin = childEnd;
+    }
+}
+
+/*
+ * Header of a topology file, followed by the bits packed eight to a byte
+ * with the first node in the lowest bit
+ */
+struct TopologyHeader{
+    char magic[4]; //"QTT1"
+    int32_t maxLevel;
+    int32_t capped; //1 if the nodes on maxLevel take no bit
+    int32_t unused;
+    double x, y, width, height;
+    uint64_t numBits;
+};
+
+int QuadTree::treeDepth(Node * node){
+    if(node->isLeaf)
+        return node->currentLevel;
+    return max(max(treeDepth(node->NEChild), treeDepth(node->NWChild)),
+               max(treeDepth(node->SWChild), treeDepth(node->SEChild)));
+}
+
+void QuadTree::writeTopology(Node * node, bool capped,
+                             std::vector<unsigned char>& bits, uint64_t& bit){
+    if(capped && node->currentLevel >= maxLevel)
+        return;
+    if(bit/8 >= bits.size())
+        bits.resize(2*bits.size() + 1, 0);
+    if(!node->isLeaf)
+        bits[bit/8] |= (unsigned char)(1 << (bit%8));
+    bit++;
+    if(!node->isLeaf){
+        writeTopology(node->NEChild, capped, bits, bit);
+        writeTopology(node->NWChild, capped, bits, bit);
+        writeTopology(node->SWChild, capped, bits, bit);
+        writeTopology(node->SEChild, capped, bits, bit);
+    }
+}
+
+bool QuadTree::saveTopology(const std::string& path){
+    TopologyHeader header;
+    memcpy(header.magic, "QTT1", 4);
+    header.maxLevel     = maxLevel;
+    header.capped       = (treeDepth(root) <= maxLevel) ? 1 : 0;
+    header.unused       = 0;
+    header.x            = root->x;
+    header.y            = root->y;
+    header.width        = root->width;
+    header.height       = root->height;
+    vector<unsigned char> bits;
+    uint64_t bit        = 0;
+    writeTopology(root, header.capped == 1, bits, bit);
+    header.numBits      = bit;
+    
+    FILE * file = fopen(path.c_str(), "wb");
+    if(file == NULL)
+        return false;
+    size_t bytes    = (bit + 7)/8;
+    bool ok         = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                      (bytes == 0 || fwrite(&bits[0], 1, bytes, file) == bytes);
+    return (fclose(file) == 0) && ok;
+}
+
+bool QuadTree::readTopology(Node * node, bool capped, const unsigned char * bits,
+                            uint64_t numBits, uint64_t& bit){
+    if(capped && node->currentLevel >= maxLevel)
+        return true;
+    if(bit >= numBits)
+        return false;
+    bool interior = (bits[bit/8] >> (bit%8)) & 1;
+    bit++;
+    if(!interior)
+        return true;
+    if(node->isLeaf) //a subclass may already have refined it
+        refineNode(node);
+    return readTopology(node->NEChild, capped, bits, numBits, bit) &&
+           readTopology(node->NWChild, capped, bits, numBits, bit) &&
+           readTopology(node->SWChild, capped, bits, numBits, bit) &&
+           readTopology(node->SEChild, capped, bits, numBits, bit);
+}
+
+//The walk of readTopology without a tree, from a node on level
+bool QuadTree::checkTopology(int level, int fileMaxLevel, bool capped,
+                             const unsigned char * bits, uint64_t numBits,
+                             uint64_t& bit){
+    if(capped && level >= fileMaxLevel)
+        return true;
+    if(bit >= numBits)
+        return false;
+    bool interior = (bits[bit/8] >> (bit%8)) & 1;
+    bit++;
+    if(!interior)
+        return true;
+    for(int q = 0; q < 4; q++){
+        if(!checkTopology(level+1, fileMaxLevel, capped, bits, numBits, bit))
+            return false;
+    }
+    return true;
+}
+
+bool QuadTree::loadTopology(const std::string& path){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TopologyHeader)){
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return false;
+    
+    TopologyHeader header;
+    memcpy(&header, data, sizeof(header));
+    const unsigned char * bits = static_cast<const unsigned char*>(data) +
+                                 sizeof(header);
+    bool ok = memcmp(header.magic, "QTT1", 4) == 0 &&
+              header.x == root->x && header.y == root->y &&
+              header.width == root->width && header.height == root->height &&
+              (header.numBits + 7)/8 <= size - sizeof(header);
+    //The whole file is walked before the tree is touched, so a bad one
+    //leaves it as it was
+    if(ok){
+        uint64_t bit = 0;
+        ok          = checkTopology(root->currentLevel, header.maxLevel,
+                                    header.capped == 1, bits, header.numBits,
+                                    bit) &&
+                      bit == header.numBits;
+    }
+    if(ok){
+        if(!root->isLeaf)
+            coarsenNode(root);
+        maxLevel    = header.maxLevel;
+        uint64_t bit = 0;
+        ok          = readTopology(root, header.capped == 1, bits,
+                                   header.numBits, bit) &&
+                      bit == header.numBits;
+    }
+    munmap(data, size);
+    return ok;
+}
+
+void QuadTree::setLookupGrid(int level){
+    lookupLevel = (level < 0) ? 0 : level;
+    lookupValid = false;
+    lookupGrid.clear();
+}
+
+void QuadTree::buildLookupGrid(){
+    int cells = 1<<lookupLevel;
+    lookupGrid.assign(cells*cells, root);
+    fillLookupGrid(root, 0, 0);
+    lookupValid = true;
+}
+
+//(ix,iy) is the position of the node on the grid of its own level
+void QuadTree::fillLookupGrid(Node * node, int ix, int iy){
+    if(node->isLeaf || node->currentLevel == lookupLevel){
+        int cells   = 1<<lookupLevel;
+        int size    = 1<<(lookupLevel - node->currentLevel);
+        for(int j = iy*size; j < (iy+1)*size; j++)
+            for(int i = ix*size; i < (ix+1)*size; i++)
+                lookupGrid[j*cells + i] = node;
+        return;
+    }
+    fillLookupGrid(node->NEChild, 2*ix+1, 2*iy+1);
+    fillLookupGrid(node->NWChild, 2*ix,   2*iy+1);
+    fillLookupGrid(node->SWChild, 2*ix,   2*iy);
+    fillLookupGrid(node->SEChild, 2*ix+1, 2*iy);
+}
+
 void QuadTree::findLeaves(std::vector<Node*>& leaves){
+    ScopedPhase phase(instrumentation, PHASE_TRAVERSAL);
     findLeavesHelper(leaves,root);
 }
 
-void QuadTree::findLeavesHelper(std::vector<Node*>& leaves,Node * node){
-    if(node->isLeaf)
-        leaves.push_back(node);
-    else {
-        findLeavesHelper(leaves,node->NEChild);
-        findLeavesHelper(leaves,node->NWChild);
-        findLeavesHelper(leaves,node->SWChild);
-        findLeavesHelper(leaves,node->SEChild);
+void QuadTree::findLeavesHelper(std::vector<Node*>& leaves,Node * top){
+    TreeWalk walk(top);
+    while(Node * node = walk.current()){
+        if(node->isLeaf){
+            leaves.push_back(node);
+            walk.skip();
+        }
+        else
+            walk.descend();
     }
 }
 
-//counts the number of nodes in tree recursively
-int QuadTree::countNodes(){
-    return countNodesHelper(root);
+void QuadTree::setCompaction(double threshold, int interval){
+    compactThreshold    = threshold;
+    compactInterval     = (interval < 1) ? 1 : interval;
+    updatesSinceCompact = 0;
 }
 
-int QuadTree::countNodesHelper(Node * node){
-    if(node->isLeaf)
-        return 1;
-    else{
-        return 1+
-        countNodesHelper(node->NEChild)+
-        countNodesHelper(node->NWChild)+
-        countNodesHelper(node->SWChild)+
-        countNodesHelper(node->SEChild);
+double QuadTree::getCompaction(){
+    return compactThreshold;
+}
+
+void QuadTree::checkCompaction(){
+    if(compactThreshold <= 0 || ++updatesSinceCompact < compactInterval)
+        return;
+    updatesSinceCompact = 0;
+    if(getFragmentation() > compactThreshold)
+        compact();
+}
+
+double QuadTree::getFragmentation(){
+    size_t blocks   = 0;
+    size_t jumps    = 0;
+    Node * last     = NULL;
+    TreeWalk walk(root);
+    while(Node * node = walk.current()){
+        if(node->isLeaf){
+            walk.skip();
+            continue;
+        }
+        Node * block = node->NEChild;
+        if(last != NULL && block != last + NodePool::BLOCK_SIZE)
+            jumps++;
+        last        = block;
+        blocks++;
+        walk.descend();
     }
+    return (blocks < 2) ? 0.0 : double(jumps)/double(blocks - 1);
+}
+
+/*
+ * Copies the blocks in pre-order into a fresh pool, a block is copied when
+ * its parent is popped so the copies are allocated in the order of the
+ * walk.  The parent pointer of each old node is then overwritten with the
+ * address of its copy, so the neighbor links can be moved over before the
+ * old slabs go
+ */
+void QuadTree::compact(){
+    ScopedPhase phase(instrumentation, PHASE_ALLOCATION);
+    NodePool fresh;
+    fresh.reserve(pool.getBlocksInUse());
+    vector<Node*> stack(1, root);
+    while(!stack.empty()){
+        Node * node = stack.back();
+        stack.pop_back();
+        if(node->isLeaf)
+            continue;
+        Node * old      = node->NEChild;
+        Node * block    = fresh.allocate();
+        for(int i = 0; i < NodePool::BLOCK_SIZE; i++){
+            new (&block[i]) Node(old[i]);
+            block[i].parent = node;
+            old[i].parent   = &block[i];
+        }
+        node->NEChild   = &block[0];
+        node->NWChild   = &block[1];
+        node->SWChild   = &block[2];
+        node->SEChild   = &block[3];
+        for(int i = NodePool::BLOCK_SIZE - 1; i >= 0; i--)
+            stack.push_back(&block[i]);
+    }
+    
+    //the root is never a face neighbor, every link points into the old pool
+    vector<Node*> leaves;
+    TreeWalk walk(root);
+    while(Node * node = walk.current()){
+        if(cacheNeighbors && node != root){
+            for(int i = 0; i < 4; i++){
+                if(node->neighbors[i] != NULL)
+                    node->neighbors[i] = node->neighbors[i]->parent;
+            }
+        }
+        if(node->isLeaf){
+            if(trackLeaves)
+                leaves.push_back(node);
+            walk.skip();
+        }
+        else
+            walk.descend();
+    }
+    pool.swapSlabs(fresh);
+    lookupValid     = false;
+    
+    //the leaf arrays in the order of the walk, the fields follow leafIndex
+    if(trackLeaves){
+        for(size_t f = 0; f < fields.size(); f++){
+            vector<double> values(leaves.size());
+            for(size_t i = 0; i < leaves.size(); i++)
+                values[i] = fields[f].values[leaves[i]->leafIndex];
+            fields[f].values.swap(values);
+        }
+        for(size_t f = 0; f < patchFields.size(); f++){
+            size_t cells    = patchFields[f].stride*patchFields[f].stride;
+            const double * old = &patchFields[f].values[0];
+            vector<double> values(leaves.size()*cells);
+            for(size_t i = 0; i < leaves.size(); i++)
+                copy(old + leaves[i]->leafIndex*cells,
+                     old + (leaves[i]->leafIndex+1)*cells,
+                     &values[i*cells]);
+            patchFields[f].values.swap(values);
+        }
+        for(size_t i = 0; i < leaves.size(); i++){
+            Node * leaf     = leaves[i];
+            leaf->leafIndex = i;
+            leafX[i]        = leaf->x;
+            leafY[i]        = leaf->y;
+            leafWidth[i]    = leaf->width;
+            leafHeight[i]   = leaf->height;
+            leafLevel[i]    = leaf->currentLevel;
+            leafNodes[i]    = leaf;
+        }
+    }
+}
+
+//counts the number of nodes in tree, every live block holds four nodes
+int QuadTree::countNodes(){
+    return 1 + NodePool::BLOCK_SIZE*pool.getBlocksInUse();
 }
 
 std::vector<double> QuadTree::getDimensions(){
@@ -314,6 +1514,11 @@ std::vector<double> QuadTree::getDimensions(){
 
 void QuadTree::getNeighbors(Node * node,
                             std::vector<std::vector<Node*> >& neighbors){
+    ScopedPhase phase(instrumentation, PHASE_NEIGHBORS);
+    if(cacheNeighbors){
+        getCachedNeighbors(node,neighbors);
+        return;
+    }
     if(node->parent == NULL){ //we're at the root which has no neighbors
         return;
     }
@@ -429,6 +1634,127 @@ void QuadTree::processNeighbors(std::vector <Node*> pNeighbors,
     }
 }
 
+/*********************** CACHED NEIGHBOR LINKS ****************************/
+
+/*
+ * Directions are numbered like the neighbor vectors: 0 - N, 1 - S, 2 - E, 3 - W
+ * and the opposite direction is found by flipping the lowest bit
+ */
+static int opposite(int direction){
+    return direction^1;
+}
+
+/*
+ * Returns true if a child of the given type lies on the side of its parent
+ * facing the given direction
+ */
+static bool onSide(int childType, int direction){
+    switch(direction){
+        case 0:  return childType == 0 || childType == 1; //north
+        case 1:  return childType == 2 || childType == 3; //south
+        case 2:  return childType == 0 || childType == 3; //east
+        default: return childType == 1 || childType == 2; //west
+    }
+}
+
+/*
+ * Reflects a child type across the face in the given direction, e.g. the
+ * child on the other side of the north face of a NE child is a SE child
+ */
+static int mirror(int childType, int direction){
+    if(direction < 2)
+        return 3 - childType;
+    else
+        return childType^1;
+}
+
+static Node * getChild(Node * node, int childType){
+    switch(childType){
+        case 0:  return node->NEChild;
+        case 1:  return node->NWChild;
+        case 2:  return node->SWChild;
+        default: return node->SEChild;
+    }
+}
+
+/*
+ * Sets the links of the children of a node from the links of the node,
+ * children on an inside face point at their siblings, on an outside face they
+ * point at the same size child of the parent's neighbor if it exists
+ */
+void QuadTree::linkChildren(Node * node){
+    for(int type = 0; type < 4; type++){
+        Node * child = getChild(node,type);
+        for(int direction = 0; direction < 4; direction++){
+            if(!onSide(type,direction))
+                child->neighbors[direction] = getChild(node,mirror(type,direction));
+            else {
+                Node * outer = node->neighbors[direction];
+                if(outer != NULL && !outer->isLeaf &&
+                   outer->currentLevel == node->currentLevel)
+                    outer = getChild(outer,mirror(type,direction));
+                child->neighbors[direction] = outer;
+            }
+        }
+    }
+}
+
+/*
+ * After a node is refined (or coarsened) the nodes in the same size neighbor
+ * across the face that pointed at the node (or its descendants) are pointed
+ * at the adjacent child (or the node)
+ */
+void QuadTree::relinkFace(Node * node, int direction, bool refined){
+    Node * outer = node->neighbors[direction];
+    if(outer == NULL || outer->isLeaf ||
+       outer->currentLevel != node->currentLevel)
+        return;
+    int back = opposite(direction);
+    for(int type = 0; type < 4; type++){
+        if(!onSide(type,back))
+            continue;
+        Node * target = node;
+        if(refined)
+            target = getChild(node,mirror(type,direction));
+        relinkSubtree(getChild(outer,type),back,target);
+    }
+}
+
+void QuadTree::relinkSubtree(Node * node, int direction, Node * target){
+    node->neighbors[direction] = target;
+    if(node->isLeaf)
+        return;
+    for(int type = 0; type < 4; type++){
+        if(onSide(type,direction))
+            relinkSubtree(getChild(node,type),direction,target);
+    }
+}
+
+void QuadTree::buildNeighborLinks(Node * node){
+    if(node->isLeaf)
+        return;
+    linkChildren(node);
+    buildNeighborLinks(node->NEChild);
+    buildNeighborLinks(node->NWChild);
+    buildNeighborLinks(node->SWChild);
+    buildNeighborLinks(node->SEChild);
+}
+
+/*
+ * Same size or larger neighbors are read straight from the links, smaller
+ * neighbors are the leaves of the linked node along the shared face
+ */
+void QuadTree::getCachedNeighbors(Node * node,
+                                  std::vector<std::vector<Node*> >& neighbors){
+    static const int faceTypes[4][2] = {{2,3},{0,1},{1,2},{0,3}};
+    for(int direction = 0; direction < 4; direction++){
+        Node * outer = node->neighbors[direction];
+        if(outer != NULL)
+            getNeighborsSibs(outer,neighbors[direction],
+                             faceTypes[direction][0],faceTypes[direction][1]);
+    }
+}
+
 /*int main(){
  
  }*/
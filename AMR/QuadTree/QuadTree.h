@@ -34,8 +34,15 @@
 #include <math.h>
 #include <time.h>
 #include <vector>
+#include <memory>
+#include <functional>
 #include <cstdlib>
+#include <stdint.h>
+#include <utility>
 #include "Application.h"
+#include "NodePool.h"
+#include "WorkStealingPool.h"
+#include "Instrumentation.h"
 
 
 /*
@@ -59,6 +66,10 @@ public:
     int currentLevel;//level in tree where the node is
     int childType; //what child am I? 0 - NE, 1 - NW, 2-SW, 3-SE.  If root -1
     bool isLeaf;
+    Node * neighbors[4];//same size or larger face neighbors N, S, E, W
+                        //only maintained when neighbor caching is on
+    int leafIndex;//position in the leaf arrays, only maintained when leaf
+                  //tracking is on
     
     //constructor
     Node(double xStart, double yStart, double w, double h,
@@ -77,12 +88,106 @@ public:
      currentLevel   = level;
      childType      = cType;
      isLeaf         = true;
+     for(int i = 0; i < 4; i++)
+         neighbors[i] = NULL;
+     leafIndex      = -1;
 
      }
     
 };
 
+/*
+ * Pre-order walk over the subtree of a node without recursion.  current()
+ * is the node being visited (NULL once the walk is over), descend() moves to
+ * its first child and skip() past its subtree.  The siblings still to visit
+ * are kept on a fixed stack of three entries per level, below STACK_LEVELS
+ * levels under the top the walk follows the parent pointers and child types
+ * instead (siblings are consecutive in their pool block), so a walk never
+ * needs more than the fixed stack whatever the depth of the tree.  Nodes
+ * may be refined during the walk, and the current node coarsened.
+ */
+class TreeWalk {
+public:
+    static const int STACK_LEVELS = 32;
+    
+    TreeWalk(Node * top) : node(top), threadTop(NULL), size(0){}
+    
+    Node * current(){
+        return node;
+    }
+    
+    void descend(){
+        Node * parent = node;
+        node = parent->NEChild;
+        if(threadTop != NULL)
+            return;
+        if(size + 3 > 3*STACK_LEVELS){
+            threadTop = parent;
+            return;
+        }
+        stack[size++] = parent->SEChild;
+        stack[size++] = parent->SWChild;
+        stack[size++] = parent->NWChild;
+    }
+    
+    void skip(){
+        if(threadTop != NULL){
+            while(node != threadTop){
+                if(node->childType < 3){
+                    node = node + 1;
+                    return;
+                }
+                node = node->parent;
+            }
+            threadTop = NULL;
+        }
+        node = (size > 0) ? stack[--size] : NULL;
+    }
+    
+private:
+    Node * node;
+    Node * threadTop; //top of the part walked through the parent pointers
+    Node * stack[3*STACK_LEVELS];
+    int size;
+};
+
+/*
+ * Transfer operators for the cell data stored in the tree.  A prolongation
+ * fills the values of the four children (NE, NW, SW, SE) of a refined leaf
+ * from the value of the leaf, a restriction returns the value of a coarsened
+ * node from the values of its four children.  Empty operators copy the value
+ * into the children and average the children.
+ */
+typedef std::function<void(Node * parent, double value, double children[4])>
+        Prolongation;
+typedef std::function<double(Node * parent, const double children[4])>
+        Restriction;
+
+/*
+ * A named variable with one value per leaf, stored in the order of the leaf
+ * arrays
+ */
+struct CellField{
+    std::string name;
+    std::vector<double> values;
+    Prolongation prolongate;
+    Restriction restriction;
+};
 
+/*
+ * A named variable with a patch of size x size cells per leaf, surrounded by
+ * ghosts layers of ghost cells, the patches stored one after the other in
+ * the order of the leaf arrays.  Cell (i,j) of a patch, i along x and j
+ * along y from the lower left corner of the leaf, is at
+ * (j+ghosts)*stride + i+ghosts from the start of the patch
+ */
+struct PatchField{
+    std::string name;
+    int size;
+    int ghosts;
+    int stride; //size + 2*ghosts
+    std::vector<double> values;
+};
 
 class QuadTree {
 public:
@@ -98,13 +203,22 @@ public:
     /*
      * Destructor
      */
-    ~QuadTree();
+    virtual ~QuadTree();
     
     /*
      * Refines and coarsens the quadtree until the desired refinement is reached
      */
     void update();
     
+    /*
+     * Same as update but only visits the nodes that intersect (or touch) the
+     * dirty rectangles, the rest of the tree is assumed to still satisfy the
+     * criteria.  Used when the criteria only changed inside a known region,
+     * e.g. Line::sweptArea
+     */
+    void update(const Rect& dirty);
+    void update(const std::vector<Rect>& dirty);
+    
     /*
      * Refines and coarsens the node
      */
@@ -116,6 +230,17 @@ public:
      */
     virtual bool refine(Node * node);
     virtual bool coarsen(Node * node);
+    
+    /*
+     * Getter and setter to turn the batched update on/off.  The batched update
+     * walks the tree one level at a time and evaluates the Application
+     * criteria of all the leaves (or interior nodes) of a level with a single
+     * call to refineBatch (or coarsenBatch).  It only uses the base class
+     * global criteria (the maximum level), so like the parallel update it
+     * falls back to the serial update when independentSubtrees() is false.
+     */
+    bool getBatched();
+    void setBatched(bool b);
 
     
     /**********************DEBUGGING AND TREE INFO****************************/
@@ -125,12 +250,98 @@ public:
      */
     void findLeaves(std::vector<Node*>& leaves);
     
+    /*
+     * Getter and setter to turn leaf tracking on/off.  When it is on the tree
+     * keeps the geometry of its leaves in contiguous arrays (one per field)
+     * that refineNode and coarsenNode keep up to date, so loops over the
+     * leaves read consecutive memory instead of walking the tree.  The
+     * order of the leaves is arbitrary and changes when the tree changes.
+     * Turning it on builds the arrays for the whole tree.
+     */
+    bool getTrackLeaves();
+    void setTrackLeaves(bool track);
+    
+    /*
+     * The leaf arrays, all of length getNumLeaves() and only valid while
+     * leaf tracking is on and the tree is not changed
+     */
+    size_t getNumLeaves();
+    const double * getLeafX();
+    const double * getLeafY();
+    const double * getLeafWidth();
+    const double * getLeafHeight();
+    const int * getLeafLevel();
+    Node * const * getLeafNodes();
+    
+    /*
+     * Calls body(begin, end) on ranges of leaf indices covering all of the
+     * leaves, the ranges are run in parallel on the pool of setParallel when
+     * there is one.  Turns leaf tracking on if needed, body must not change
+     * the tree.
+     */
+    void forEachLeaf(const std::function<void(size_t, size_t)>& body,
+                     size_t grainSize = 4096);
+    
+    /*
+     * Cell data owned by the tree.  addField adds a variable with one value
+     * per leaf (initially zero) and returns its id.  The values are indexed
+     * like the leaf arrays, getField(id)[node->leafIndex] is the value of a
+     * leaf, and refineNode and coarsenNode move them with the mesh through
+     * the field's prolongation and restriction.  Adding a field turns leaf
+     * tracking on, turning it off drops the fields.  While there are fields
+     * the update runs serially.
+     */
+    int addField(const std::string& name,
+                 const Prolongation& prolongate = Prolongation(),
+                 const Restriction& restriction = Restriction());
+    int getFieldId(const std::string& name); //-1 if there is no such field
+    double * getField(int id);
+    int getNumFields();
+    
+    /*
+     * Block structured cell data.  addPatchField adds a variable with a
+     * patch of size x size cells per leaf (size even), in contiguous storage
+     * with ghosts layers of ghost cells around it, and returns its id, or
+     * -1 without adding it if size is odd or not positive or ghosts is
+     * negative.
+     * getPatch(id, leafIndex) is the start of the patch of a leaf, rows of
+     * getPatchStride(id) values.  refineNode gives each child the quarter
+     * of the patch it covers, every cell copied into 2x2 cells, and
+     * coarsenNode averages 2x2 cells of the children into one.  fillGhosts
+     * sets the ghost layers of every leaf from the cells across each face:
+     * the cell of a same size or coarser neighbor containing the ghost
+     * cell, or the average of the cells of the finer neighbors inside it,
+     * and the edge cell of the leaf itself at the domain boundary.  The
+     * corners of the ghost layers are not set.  Adding a patch field turns
+     * leaf tracking on and fillGhosts neighbor caching, turning leaf
+     * tracking off drops them.  While there are patch fields the update
+     * runs serially.
+     */
+    int addPatchField(const std::string& name, int size, int ghosts = 1);
+    int getPatchFieldId(const std::string& name); //-1 if there is no such field
+    double * getPatch(int id, size_t leafIndex);
+    int getPatchSize(int id);
+    int getPatchGhosts(int id);
+    int getPatchStride(int id);
+    int getNumPatchFields();
+    void fillGhosts(int id);
+    
     /*
      * Method for getting the neighbors of a node in the tree
      */
     void getNeighbors(Node * node,
                       std::vector<std::vector<Node*> >& neighbors);
     
+    /*
+     * Getter and setter to turn neighbor caching on/off.  When it is on every
+     * node keeps links to its same size or larger face neighbors which are
+     * updated by refineNode and coarsenNode, so getNeighbors only has to
+     * read them instead of walking the tree.  Turning it on builds the links
+     * for the whole tree.
+     */
+    bool getCacheNeighbors();
+    void setCacheNeighbors(bool cache);
+    
     /*
      * Method for getting dimensions of quad tree
      */
@@ -154,25 +365,124 @@ public:
     void setTime(bool t);
     
     /*
-     * Returns the total amount of time spend in coarsening and refinement
+     * Returns the total amount of time spend in coarsening and refinement,
+     * in a parallel update this is the CPU time summed over all threads
      */
     double getTotalCoarsen();
     double getTotalRefine();
     
+    /*
+     * Getter and setter for the per phase instrumentation (see
+     * Instrumentation.h), NULL turns it off.  The tree does not own it
+     */
+    Instrumentation * getInstrumentation();
+    void setInstrumentation(Instrumentation * instrumentation);
+    
+    /*
+     * Turns the parallel update on with the given number of threads (1 turns
+     * it off).  Subtrees of nodes above the cutoff level are handed to a
+     * work stealing pool as separate tasks, below it they are updated
+     * serially inside their task.  The parallel update is only used when the
+     * subtrees are independent, so it falls back to the serial update for
+     * subclasses whose global criteria look across subtrees and while the
+     * neighbor links are being cached.
+     */
+    void setParallel(int numThreads, int cutoffLevel = 4);
+    int getParallelThreads();
+    
+    /*
+     * Returns false if the global refine/coarsen criteria of a node read
+     * nodes outside of its own subtree, which rules out the parallel update
+     */
+    virtual bool independentSubtrees();
+    
     /*
      * Counts the number of nodes in the tree
      */
     int countNodes();
     
     /*
-     * Returns the total amount of memory used to store the quad tree
+     * Returns the total amount of memory used to store the quad tree, the
+     * live nodes only as the other backends count it
+     */
+    size_t storage();
+    
+    /*
+     * Returns the memory held for the tree: the root and all the slabs of
+     * the node pool, including the blocks on its free list
+     */
+    size_t reservedStorage();
+    
+    /*
+     * Node pool statistics: the largest number of sibling blocks alive at
+     * once and the fraction of refinements served by recycled blocks
+     */
+    int getPeakBlocks();
+    double getReuseRate();
+    
+    /*
+     * Rebuilds the node storage in the order of a pre-order walk, the
+     * Morton-like curve of the child order NE, NW, SW, SE: the sibling
+     * blocks are copied into one new slab in the order the update,
+     * findLeaves and the neighbor links visit them, and the leaf arrays and
+     * fields are put in the same order.  The old slabs and the free blocks
+     * are returned to the system.  Node pointers held outside of the tree
+     * are no longer valid afterwards.
+     */
+    void compact();
+    
+    /*
+     * Fraction of the sibling blocks that are not right after the block
+     * visited before them in a pre-order walk, 0 after compact()
      */
-    int storage();
+    double getFragmentation();
+    
+    /*
+     * Compacts the tree at the end of an update when its fragmentation is
+     * above threshold, measured every interval updates.  0 turns it off
+     */
+    void setCompaction(double threshold, int interval = 1);
+    double getCompaction();
     
     /*
      * Finds the leaf node that contains the particular x,y point
      */
-    Node * findNode(float x,float y);
+    Node * findNode(double x,double y);
+    
+    /*
+     * Finds the leaf nodes containing n points at once.  The points are
+     * sorted by their Morton key so the tree is walked a single time for the
+     * whole batch, out[i] is the leaf containing (xs[i],ys[i])
+     */
+    void findNodes(const double* xs, const double* ys, Node** out, size_t n);
+    
+    /*
+     * Writes the topology of the tree to a compact binary file and reads it
+     * back.  The file holds a small header (root geometry, maximum level)
+     * and one bit per node in pre-order, set for nodes that have children.
+     * Nodes on the maximum level are always leaves and take no bit.
+     * loadTopology maps the file into memory and rebuilds the tree with
+     * refineNode only, without evaluating any criteria, the root geometry
+     * has to match.  Both return false on an I/O or format error, which
+     * loadTopology detects before it changes the tree.
+     */
+    bool saveTopology(const std::string& path);
+    bool loadTopology(const std::string& path);
+    
+    /*
+     * Sets the level of a uniform lookup grid used by findNode to jump
+     * straight to a node on that level (or a coarser leaf) instead of
+     * starting at the root, 0 turns it off.  The grid is rebuilt on the next
+     * lookup after a node above that level is refined or coarsened.
+     */
+    void setLookupGrid(int level);
+    
+protected:
+    /*
+     * Called by refineNode after a node has been given its four children,
+     * lets subclasses react to refinement (e.g. to keep the tree balanced)
+     */
+    virtual void nodeRefined(Node * node);
     
 private:
     /*
@@ -182,33 +492,127 @@ private:
     void insert(Node * node, int levelsRemaining,int currentLevel);
     
     /*
-     * Helper method for recursively destructing the tree
+     * Helper method for returning the descendants of a node to the node pool
      */
     void destroyTree(Node * node);
+    void destroyDeep(Node * node);
     
+    /*
+     * Helpers for the leaf arrays, removeLeaf moves the last leaf into the
+     * slot of the removed one
+     */
+    void addLeaf(Node * node);
+    void removeLeaf(Node * node);
+    void buildLeaves(Node * node);
+    
+    /*
+     * Value of a field on a node, restricted up from the leaves below it
+     */
+    double restrictSubtree(Node * node, CellField& field);
     
     /*
-     * Traverses the tree refining and coarsening the nodes
+     * Helpers for the patch fields: the size x size cells of a node averaged
+     * up from the leaves below it, the patches of the children of a refined
+     * node from the cells of the node, and the ghost layer of a leaf across
+     * one face
      */
-    void checkCriteria(Node * node);
+    void restrictPatch(Node * node, PatchField& field, double * cells);
+    void prolongPatch(Node * node, PatchField& field, const double * cells);
+    void fillFaceGhosts(Node * leaf, int direction,
+                        const std::vector<Node*>& neighbors, PatchField& field);
+    
+    
+    /*
+     * Traverses the tree refining and coarsening the nodes, the time spent is
+     * added to refineTime and coarsenTime
+     */
+    void checkCriteria(Node * node, double& refineTime, double& coarsenTime);
     
     /*
      * Refines the node as far as possible
      */
     void fullyRefine(Node * node);
     
+    /*
+     * refine and coarsen counted as the criteria phase
+     */
+    bool checkRefine(Node * node);
+    bool checkCoarsen(Node * node);
+    
+    /*
+     * Parallel versions of checkCriteria and fullyRefine which spawn a task
+     * for each child above the cutoff level
+     */
+    void parallelCheckCriteria(Node * node);
+    void parallelFullyRefine(Node * node);
+    
+    /*
+     * Adds the time measured by one task to the totals
+     */
+    void addTimes(double refineTime, double coarsenTime);
+    
+    /*
+     * Runs the serial, parallel or batched update
+     */
+    void updateTree();
+    
+    /*
+     * Returns true if the node has to be visited by the current update
+     */
+    bool isDirty(Node * node);
+    
+    /*
+     * Compacts the tree if setCompaction asks for it, after each update
+     */
+    void checkCompaction();
+    
+    /*
+     * Level by level update used when batched is true
+     */
+    void batchedCheckCriteria();
+    
+    /*
+     * Copies the coordinates of the nodes into the batch arrays
+     */
+    void gatherBatch(const std::vector<Node*>& nodes);
+    
 /***************** DEBUGGING AND TREE INFO HELPERS ***************************/
     
     /*
-     * Recursive helper methods for counting the nodes, printing the values,
-     * and calculating the left Riemann summ, memory usage, finding the location
-     * of an (x,y) pair, and the leaves of the tree.  These methods are private
+     * Recursive helper methods for finding the location of an (x,y) pair
+     * and the leaves of the tree.  These methods are private
      * in order to prevent the user from needing access to the root
      */
     
-    int storageHelper(Node * node);
-    int countNodesHelper(Node * node);
-    Node * findNodeHelper(float x, float y, Node * node);
+    Node * findNodeHelper(double x, double y, Node * node);
+    
+    /*
+     * Helpers for findNodes, queries holds the (Morton key, query index)
+     * pairs sorted by key, [begin,end) are the queries inside the node whose
+     * first key is key
+     */
+    void findNodesHelper(Node * node, int level, uint64_t key,
+                         const std::vector<std::pair<uint64_t,size_t> >& queries,
+                         size_t begin, size_t end, Node** out);
+    uint64_t pointKey(double x, double y);
+    
+    /*
+     * Helpers for building the lookup grid
+     */
+    void buildLookupGrid();
+    
+    /*
+     * Helpers for saveTopology and loadTopology, bit counts the bits used
+     */
+    void writeTopology(Node * node, bool capped,
+                       std::vector<unsigned char>& bits, uint64_t& bit);
+    bool readTopology(Node * node, bool capped, const unsigned char * bits,
+                      uint64_t numBits, uint64_t& bit);
+    static bool checkTopology(int level, int fileMaxLevel, bool capped,
+                              const unsigned char * bits, uint64_t numBits,
+                              uint64_t& bit);
+    int treeDepth(Node * node);
+    void fillLookupGrid(Node * node, int ix, int iy);
     void findLeavesHelper(std::vector<Node*>& leaves, Node * node);
     
     /*
@@ -229,14 +633,59 @@ private:
     void processNeighbors(std::vector <Node*> pNeighbors,
                           std::vector<Node*>& list, int plevel, int nodeType);
     
+    /*
+     * Helper methods for the cached neighbor links.  linkChildren sets the
+     * links of the children of a freshly refined node, relinkFace points the
+     * nodes across the given face of a node at a new target, and
+     * buildNeighborLinks sets the links of a whole subtree.
+     */
+    void linkChildren(Node * node);
+    void relinkFace(Node * node, int direction, bool refined);
+    void relinkSubtree(Node * node, int direction, Node * target);
+    void buildNeighborLinks(Node * node);
+    void getCachedNeighbors(Node * node,
+                            std::vector<std::vector<Node*> >& neighbors);
+    
 /*********************** INSTANCE VARIABLES *********************************/
   
     Node * root;
+    NodePool pool; //children are allocated four siblings at a time
     
     int maxLevel;
     bool time;
+    bool cacheNeighbors;
     double totalCoarsen;
     double totalRefine;
+    std::mutex timeLock;
+    Instrumentation * instrumentation; //NULL unless instrumented
+    
+    WorkStealingPool * taskPool; //NULL unless the parallel update is on
+    int parallelCutoff;
+    
+    const std::vector<Rect> * dirtyRegions; //NULL when updating the whole tree
+    const Rect * dirtyBounds; //bounding box of the dirty regions
+    
+    bool trackLeaves;
+    std::vector<double> leafX, leafY, leafWidth, leafHeight;
+    std::vector<int> leafLevel;
+    std::vector<Node*> leafNodes;
+    std::vector<CellField> fields;
+    std::vector<double> fieldScratch; //field values of a node being changed
+    std::vector<PatchField> patchFields;
+    std::vector<std::vector<double> > patchScratch; //cells of a node being changed
+    
+    std::vector<Node*> lookupGrid; //row major, 2^lookupLevel cells a side
+    int lookupLevel;
+    bool lookupValid;
+    
+    double compactThreshold; //0 unless compacting after updates
+    int compactInterval;
+    int updatesSinceCompact;
+    
+    bool batched;
+    std::vector<double> batchX, batchY, batchWidth, batchHeight;
+    std::unique_ptr<bool[]> batchFlags;
+    size_t batchCapacity;
     
 };
 
@@ -0,0 +1,122 @@
+//
+//  WorkStealingPool.cpp
+//
+//  See WorkStealingPool.h for more detailed comments
+//
+//
+
+#include "WorkStealingPool.h"
+
+/*
+ * Index of the deque owned by the current thread, -1 outside of the pool
+ */
+static thread_local int ownedQueue = -1;
+static thread_local WorkStealingPool * ownerPool = NULL;
+
+WorkStealingPool::WorkStealingPool(int numThreads) : pending(0), sleepers(0),
+                                                     done(false){
+    if(numThreads <= 0)
+        numThreads = std::thread::hardware_concurrency();
+    if(numThreads <= 0)
+        numThreads = 1;
+    //one deque per helper thread plus one for the caller of wait
+    for(int i = 0; i < numThreads; i++)
+        queues.push_back(new TaskQueue());
+    for(int i = 0; i < numThreads-1; i++)
+        threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        done = true;
+    }
+    wakeUp.notify_all();
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for(size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+}
+
+int WorkStealingPool::getNumThreads(){
+    return queues.size();
+}
+
+int WorkStealingPool::currentQueue(){
+    if(ownerPool == this)
+        return ownedQueue;
+    return queues.size()-1;
+}
+
+void WorkStealingPool::spawn(const std::function<void()>& task){
+    pending++;
+    TaskQueue * queue = queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->tasks.push_back(task);
+    }
+    if(sleepers > 0){
+        std::lock_guard<std::mutex> guard(sleepLock);
+        wakeUp.notify_one();
+    }
+}
+
+bool WorkStealingPool::runOne(int self){
+    std::function<void()> task;
+    bool found = false;
+    int numQueues = queues.size();
+
+    //newest task from our own deque first
+    {
+        TaskQueue * queue = queues[self];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if(!queue->tasks.empty()){
+            task = queue->tasks.back();
+            queue->tasks.pop_back();
+            found = true;
+        }
+    }
+
+    //otherwise steal the oldest task of another deque
+    for(int i = 1; i < numQueues && !found; i++){
+        TaskQueue * queue = queues[(self+i)%numQueues];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if(!queue->tasks.empty()){
+            task = queue->tasks.front();
+            queue->tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if(!found)
+        return false;
+    task();
+    pending--;
+    return true;
+}
+
+void WorkStealingPool::workerLoop(int self){
+    ownedQueue  = self;
+    ownerPool   = this;
+    while(!done){
+        if(runOne(self))
+            continue;
+        if(pending > 0){ //others are busy, more work may show up soon
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepLock);
+        sleepers++;
+        while(!done && pending == 0)
+            wakeUp.wait(lock);
+        sleepers--;
+    }
+}
+
+void WorkStealingPool::wait(){
+    int self = currentQueue();
+    while(pending > 0){
+        if(!runOne(self))
+            std::this_thread::yield();
+    }
+}
@@ -0,0 +1,87 @@
+//
+//  WorkStealingPool.h
+//
+/*
+ * Small work stealing thread pool used for the parallel QuadTree update.
+ *
+ * Every thread owns a deque of tasks.  Tasks spawned by a thread are pushed
+ * onto its own deque and popped from the back (depth first, good locality),
+ * idle threads steal from the front of the other deques (the oldest and
+ * usually largest subtrees).  The thread that calls wait() helps run tasks
+ * until everything that was spawned has finished, so a pool with n threads
+ * uses n-1 helper threads plus the caller.
+ */
+//
+
+#ifndef ____WorkStealingPool__
+#define ____WorkStealingPool__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+
+    /*
+     * Constructor, takes the total number of threads including the caller of
+     * wait(), 0 uses the number of hardware threads
+     */
+    WorkStealingPool(int numThreads = 0);
+
+    /*
+     * Destructor, stops and joins the helper threads
+     */
+    ~WorkStealingPool();
+
+    /*
+     * Queues a task, may be called from inside a running task
+     */
+    void spawn(const std::function<void()>& task);
+
+    /*
+     * Runs tasks until every spawned task has finished
+     */
+    void wait();
+
+    int getNumThreads();
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<std::function<void()> > tasks;
+    };
+
+    /*
+     * Runs one task from our own deque or stolen from another one, returns
+     * false if there was nothing to run
+     */
+    bool runOne(int self);
+
+    void workerLoop(int self);
+
+    /*
+     * Deque owned by the calling thread, the last one is shared by all
+     * threads that are not part of the pool
+     */
+    int currentQueue();
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<TaskQueue*> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> pending; //spawned tasks that have not finished yet
+    std::atomic<int> sleepers;
+    std::atomic<bool> done;
+    std::mutex sleepLock;
+    std::condition_variable wakeUp;
+};
+
+#endif /* defined(____WorkStealingPool__) */
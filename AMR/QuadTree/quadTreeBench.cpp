@@ -0,0 +1,506 @@
+//
+//  quadTreeBench.cpp
+//
+//  Benchmark harness for the quad tree backends (pointer, with and without
+//  compaction, linear, compact and the BasicQuadTree template) and the Octree.  Sweeps the maximum level,
+//  the initial number of cells and the application (a Line through the
+//  domain, Interaction's uniform refinement, the Neighbor 2:1 rule, with
+//  and without its balance pass, and the line combined with a fixed second
+//  line in a CompositeApplication), the patches of block structured data on
+//  the leaves of the line's tree, and
+//  writes one CSV row per operation to stdout:
+//
+//      app,backend,numCells,maxLevel,op,nodes,ns_per_op,nodes_per_sec,bytes_per_node,
+//      reserved_bytes_per_node
+//
+//  Every operation is repeated until it has run for at least minTime seconds
+//  (and at least three times) and the mean is reported.  ns_per_op is the
+//  time of one operation, for findNode that is a single query, for the other
+//  operations it is one pass over the whole tree.  nodes_per_sec is the
+//  number of nodes of the tree processed per second by that pass.
+//  bytes_per_node counts the live data of the tree, reserved_bytes_per_node
+//  what it holds, with the free slabs of the node pool of the pointer trees.
+//
+//  Usage: ./bench [maxLevel] [minTime]
+//  The default makefile flags build without optimization, for meaningful
+//  numbers use e.g. make bench CXXFLAGS="-O2 -std=c++11 -pthread"
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "QuadTree.h"
+#include "Neighbor.h"
+#include "LinearQuadTree.h"
+#include "CompactQuadTree.h"
+#include "BasicQuadTree.h"
+#include "Octree.h"
+#include "CompositeApplication.h"
+
+using namespace std;
+
+static double minTime   = 0.1; //seconds each measurement runs for
+static const int QUERIES = 4096; //points per findNode measurement
+
+static double now(){
+    return chrono::duration<double>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Repeats op until minTime has passed and returns the mean seconds per call
+ */
+template <class Op>
+static double measure(Op op){
+    int iterations  = 0;
+    double start    = now();
+    double elapsed  = 0;
+    do {
+        op();
+        iterations++;
+        elapsed     = now() - start;
+    } while(elapsed < minTime || iterations < 3);
+    return elapsed/iterations;
+}
+
+/*
+ * Bytes per node of a tree, of its live data and of all the memory it holds
+ */
+struct Footprint {
+    double live;
+    double reserved;
+};
+
+/*
+ * The memory held by a tree, storage() for the trees without a node pool
+ */
+template <class Tree>
+static auto reservedStorage(Tree * tree, int)
+    -> decltype(double(tree->reservedStorage())){
+    return double(tree->reservedStorage());
+}
+
+template <class Tree>
+static double reservedStorage(Tree * tree, long){
+    return double(tree->storage());
+}
+
+template <class Tree>
+static Footprint footprint(Tree * tree, long nodes, double extra = 0){
+    Footprint f;
+    f.live      = (double(tree->storage()) + extra)/nodes;
+    f.reserved  = (reservedStorage(tree, 0) + extra)/nodes;
+    return f;
+}
+
+static void report(const string& app, const string& backend, int numCells,
+                   int maxLevel, const string& op, long nodes, double seconds,
+                   long queries, const Footprint& bytes){
+    double perOp = seconds/queries;
+    printf("%s,%s,%d,%d,%s,%ld,%.1f,%.4g,%.1f,%.1f\n", app.c_str(),
+           backend.c_str(), numCells, maxLevel, op.c_str(), nodes, perOp*1.0e9,
+           double(nodes)/seconds, bytes.live, bytes.reserved);
+}
+
+/*
+ * Interaction refines and coarsens everything it can, so a tree that is not
+ * a single leaf collapses on its first update and refines on the next one
+ */
+template <class Tree>
+static void settle(Tree * tree){
+    tree->update();
+    if(tree->countNodes() == 1)
+        tree->update();
+}
+
+/*
+ * Benchmarks a tree handing out Node pointers (QuadTree, Neighbor,
+ * LinearQuadTree and BasicQuadTree), make builds a new tree with the given sizes
+ */
+template <class Tree, class Make>
+static void benchNodeTree(const string& app, const string& backend,
+                          int numCells, int maxLevel, Segment * seg,
+                          Make make){
+    Tree * tree     = NULL;
+
+    //construction plus the initial update, without the destructor
+    double build    = 0;
+    double destroy  = 0;
+    int runs        = 0;
+    do {
+        double start    = now();
+        tree            = make(numCells, maxLevel);
+        settle(tree);
+        double mid      = now();
+        delete tree;
+        double finish   = now();
+        build          += mid - start;
+        destroy        += finish - mid;
+        runs++;
+    } while(build + destroy < minTime || runs < 3);
+
+    tree                = make(numCells, maxLevel);
+    settle(tree);
+    long nodes          = tree->countNodes();
+    Footprint bytes     = footprint(tree, nodes);
+    report(app, backend, numCells, maxLevel, "build", nodes, build/runs, 1, bytes);
+    report(app, backend, numCells, maxLevel, "destroy", nodes, destroy/runs, 1, bytes);
+
+    if(seg != NULL){
+        //move the line forward and back so every update has work to do and
+        //the tree ends up where it started
+        double t = measure([&](){
+            seg->translate(0.05, 0.05);
+            tree->update();
+            seg->translate(-0.05, -0.05);
+            tree->update();
+        });
+        report(app, backend, numCells, maxLevel, "update", nodes, t/2, 1, bytes);
+    }
+
+    vector<Node*> leaves;
+    double t = measure([&](){
+        leaves.clear();
+        tree->findLeaves(leaves);
+    });
+    report(app, backend, numCells, maxLevel, "findLeaves", nodes, t, 1, bytes);
+
+    long count = 0;
+    t = measure([&](){
+        for(size_t i = 0; i < leaves.size(); i++){
+            vector<vector<Node*> > neighbors(4);
+            tree->getNeighbors(leaves[i], neighbors);
+            count += neighbors[0].size() + neighbors[1].size() +
+                     neighbors[2].size() + neighbors[3].size();
+        }
+    });
+    report(app, backend, numCells, maxLevel, "getNeighbors", nodes, t, 1, bytes);
+
+    vector<double> dims = tree->getDimensions();
+    vector<double> xs(QUERIES), ys(QUERIES);
+    srand(1);
+    for(int i = 0; i < QUERIES; i++){
+        xs[i] = dims[0] + dims[2]*(rand()/(RAND_MAX + 1.0));
+        ys[i] = dims[1] + dims[3]*(rand()/(RAND_MAX + 1.0));
+    }
+    uintptr_t found = 0; //every result goes in, or the lookups can be dropped
+    t = measure([&](){
+        for(int i = 0; i < QUERIES; i++)
+            found ^= reinterpret_cast<uintptr_t>(
+                         tree->findNode(xs[i], ys[i]));
+    });
+    report(app, backend, numCells, maxLevel, "findNode", QUERIES, t, QUERIES, bytes);
+
+    if(count < 0 || found == 1) //keeps the loops from being optimized away
+        printf("#\n");
+    delete tree;
+}
+
+/*
+ * Same measurements for the index based CompactQuadTree
+ */
+static void benchCompact(const string& app, int numCells, int maxLevel,
+                         Application * application, Segment * seg){
+    const string backend = "compact";
+    CompactQuadTree * tree = NULL;
+    double build    = 0;
+    double destroy  = 0;
+    int runs        = 0;
+    do {
+        double start    = now();
+        tree            = new CompactQuadTree(-4.0,-4.0,4.0,4.0,numCells,
+                                              maxLevel,application);
+        settle(tree);
+        double mid      = now();
+        delete tree;
+        double finish   = now();
+        build          += mid - start;
+        destroy        += finish - mid;
+        runs++;
+    } while(build + destroy < minTime || runs < 3);
+
+    tree = new CompactQuadTree(-4.0,-4.0,4.0,4.0,numCells,maxLevel,application);
+    settle(tree);
+    long nodes      = tree->countNodes();
+    Footprint bytes = footprint(tree, nodes);
+    report(app, backend, numCells, maxLevel, "build", nodes, build/runs, 1, bytes);
+    report(app, backend, numCells, maxLevel, "destroy", nodes, destroy/runs, 1, bytes);
+
+    if(seg != NULL){
+        double t = measure([&](){
+            seg->translate(0.05, 0.05);
+            tree->update();
+            seg->translate(-0.05, -0.05);
+            tree->update();
+        });
+        report(app, backend, numCells, maxLevel, "update", nodes, t/2, 1, bytes);
+    }
+
+    vector<uint32_t> leaves;
+    double t = measure([&](){
+        leaves.clear();
+        tree->findLeaves(leaves);
+    });
+    report(app, backend, numCells, maxLevel, "findLeaves", nodes, t, 1, bytes);
+
+    long count = 0;
+    t = measure([&](){
+        for(size_t i = 0; i < leaves.size(); i++){
+            vector<vector<uint32_t> > neighbors(4);
+            tree->getNeighbors(leaves[i], neighbors);
+            count += neighbors[0].size() + neighbors[1].size() +
+                     neighbors[2].size() + neighbors[3].size();
+        }
+    });
+    report(app, backend, numCells, maxLevel, "getNeighbors", nodes, t, 1, bytes);
+
+    vector<double> xs(QUERIES), ys(QUERIES);
+    srand(1);
+    for(int i = 0; i < QUERIES; i++){
+        xs[i] = -4.0 + 4.0*(rand()/(RAND_MAX + 1.0));
+        ys[i] = -4.0 + 4.0*(rand()/(RAND_MAX + 1.0));
+    }
+    uint32_t found = 0;
+    t = measure([&](){
+        for(int i = 0; i < QUERIES; i++)
+            found += tree->findNode(xs[i], ys[i]);
+    });
+    report(app, backend, numCells, maxLevel, "findNode", QUERIES, t, QUERIES, bytes);
+
+    if(count < 0 || found == 1)
+        printf("#\n");
+    delete tree;
+}
+
+/*
+ * Block structured data on the pointer tree: each leaf of the line's tree
+ * holds a patch of PATCH x PATCH cells with one ghost layer.  fillGhosts is
+ * one pass setting all of the ghost layers, stencil one Jacobi sweep of the
+ * 5-point Laplacian over the patches, nodes counts the cells
+ */
+static const int PATCH = 8;
+
+static void benchPatches(int numCells, int maxLevel,
+                         Application * application){
+    const string backend = "patch" + to_string(PATCH);
+    QuadTree * tree = new QuadTree(-4.0,-4.0,4.0,4.0,numCells,maxLevel,
+                                   application);
+    settle(tree);
+    int u           = tree->addPatchField("u", PATCH);
+    tree->setCacheNeighbors(true);
+    size_t leaves   = tree->getNumLeaves();
+    long cells      = long(leaves)*PATCH*PATCH;
+    int s           = tree->getPatchStride(u);
+    for(size_t l = 0; l < leaves; l++){
+        double * patch = tree->getPatch(u, l);
+        for(int j = 0; j < s; j++)
+            for(int i = 0; i < s; i++)
+                patch[j*s + i] = tree->getLeafX()[l] + i + j;
+    }
+    Footprint bytes = footprint(tree, cells,
+                                double(leaves*s*s*sizeof(double)));
+
+    double t = measure([&](){ tree->fillGhosts(u); });
+    report("line", backend, numCells, maxLevel, "fillGhosts", cells, t, 1, bytes);
+
+    vector<double> next(PATCH*PATCH);
+    double sum = 0;
+    t = measure([&](){
+        for(size_t l = 0; l < leaves; l++){
+            double * patch = tree->getPatch(u, l);
+            for(int j = 1; j <= PATCH; j++){
+                const double * row = patch + j*s;
+                double * out       = &next[(j-1)*PATCH];
+                for(int i = 1; i <= PATCH; i++)
+                    out[i-1] = 0.25*(row[i-1] + row[i+1] + row[i-s] + row[i+s]);
+            }
+            for(int j = 1; j <= PATCH; j++)
+                copy(&next[(j-1)*PATCH], &next[j*PATCH], patch + j*s + 1);
+            sum += patch[s + 1];
+        }
+    });
+    report("line", backend, numCells, maxLevel, "stencil", cells, t, 1, bytes);
+
+    if(sum != sum) //keeps the loops from being optimized away
+        printf("#\n");
+    delete tree;
+}
+
+/*
+ * Same measurements for the Octree, the Line extends through z as a plane
+ * and balanced applies the Neighbor rule
+ */
+static void benchOctree(const string& app, int numCells, int maxLevel,
+                        Application * application, Segment * seg,
+                        bool balanced){
+    const string backend = "octree";
+    Octree * tree   = NULL;
+    double build    = 0;
+    double destroy  = 0;
+    int runs        = 0;
+    do {
+        double start    = now();
+        tree            = new Octree(-4.0,-4.0,-4.0,4.0,4.0,4.0,numCells,
+                                     maxLevel,application);
+        tree->setBalanced(balanced);
+        settle(tree);
+        double mid      = now();
+        delete tree;
+        double finish   = now();
+        build          += mid - start;
+        destroy        += finish - mid;
+        runs++;
+    } while(build + destroy < minTime || runs < 3);
+
+    tree = new Octree(-4.0,-4.0,-4.0,4.0,4.0,4.0,numCells,maxLevel,application);
+    tree->setBalanced(balanced);
+    settle(tree);
+    long nodes      = tree->countNodes();
+    Footprint bytes = footprint(tree, nodes);
+    report(app, backend, numCells, maxLevel, "build", nodes, build/runs, 1, bytes);
+    report(app, backend, numCells, maxLevel, "destroy", nodes, destroy/runs, 1, bytes);
+
+    if(seg != NULL){
+        double t = measure([&](){
+            seg->translate(0.05, 0.05);
+            tree->update();
+            seg->translate(-0.05, -0.05);
+            tree->update();
+        });
+        report(app, backend, numCells, maxLevel, "update", nodes, t/2, 1, bytes);
+    }
+
+    vector<OctNode*> leaves;
+    double t = measure([&](){
+        leaves.clear();
+        tree->findLeaves(leaves);
+    });
+    report(app, backend, numCells, maxLevel, "findLeaves", nodes, t, 1, bytes);
+
+    long count = 0;
+    t = measure([&](){
+        for(size_t i = 0; i < leaves.size(); i++){
+            vector<vector<OctNode*> > neighbors(Octree::NUM_FACES);
+            tree->getNeighbors(leaves[i], neighbors);
+            for(int d = 0; d < Octree::NUM_FACES; d++)
+                count += neighbors[d].size();
+        }
+    });
+    report(app, backend, numCells, maxLevel, "getNeighbors", nodes, t, 1, bytes);
+
+    vector<double> xs(QUERIES), ys(QUERIES), zs(QUERIES);
+    srand(1);
+    for(int i = 0; i < QUERIES; i++){
+        xs[i] = -4.0 + 4.0*(rand()/(RAND_MAX + 1.0));
+        ys[i] = -4.0 + 4.0*(rand()/(RAND_MAX + 1.0));
+        zs[i] = -4.0 + 4.0*(rand()/(RAND_MAX + 1.0));
+    }
+    uintptr_t found = 0; //every result goes in, or the lookups can be dropped
+    t = measure([&](){
+        for(int i = 0; i < QUERIES; i++)
+            found ^= reinterpret_cast<uintptr_t>(
+                         tree->findNode(xs[i], ys[i], zs[i]));
+    });
+    report(app, backend, numCells, maxLevel, "findNode", QUERIES, t, QUERIES, bytes);
+
+    if(count < 0 || found == 1)
+        printf("#\n");
+    delete tree;
+}
+
+int main(int argc, char** argv){
+    int maxLevelCap = 12;
+    if(argc > 1)
+        maxLevelCap = atoi(argv[1]);
+    if(argc > 2)
+        minTime = atof(argv[2]);
+
+    Segment * seg       = new Segment(-4.0,0.0,-1.0,-7.0);
+    seg->translate(1.5,1.5); //through the center of the domain
+    Line * line         = new Line(seg);
+    Interaction * all   = new Interaction();
+    //a second line that does not move, only asked about the nodes of the
+    //lower left quadrant and cached there, after the moving one
+    Segment * fixedSeg  = new Segment(-4.0,4.0,1.0,0.0);
+    Line * fixedLine    = new Line(fixedSeg);
+    Rect quadrant(-4.0,-4.0,4.0,4.0);
+    CompositeApplication * both = new CompositeApplication();
+    both->add(line, 1.0);
+    both->add(fixedLine, 2.0, &quadrant, true);
+    int cells[3]        = {1, 16, 256};
+
+    printf("app,backend,numCells,maxLevel,op,nodes,ns_per_op,nodes_per_sec,"
+           "bytes_per_node,reserved_bytes_per_node\n");
+    for(int maxLevel = 4; maxLevel <= maxLevelCap; maxLevel += 2){
+        for(int c = 0; c < 3; c++){
+            int numCells    = cells[c];
+            //the initial level has to stay at or below the maximum level
+            if(2*c > maxLevel)
+                continue;
+
+            benchNodeTree<QuadTree>("line", "pointer", numCells, maxLevel, seg,
+                [&](int n, int m){ return new QuadTree(-4.0,-4.0,4.0,4.0,n,m,line); });
+            //the pointer tree laid out again in walk order once a quarter
+            //of its blocks are out of place
+            benchNodeTree<QuadTree>("line", "compacted", numCells, maxLevel, seg,
+                [&](int n, int m){
+                    QuadTree * t = new QuadTree(-4.0,-4.0,4.0,4.0,n,m,line);
+                    t->setCompaction(0.25);
+                    return t;
+                });
+            benchNodeTree<LinearQuadTree>("line", "linear", numCells, maxLevel, seg,
+                [&](int n, int m){ return new LinearQuadTree(-4.0,-4.0,4.0,4.0,n,m,line); });
+            benchCompact("line", numCells, maxLevel, line, seg);
+            benchNodeTree<BasicQuadTree<Line> >("line", "template", numCells, maxLevel, seg,
+                [&](int n, int m){ return new BasicQuadTree<Line>(-4.0,-4.0,4.0,4.0,n,m,*line); });
+            benchPatches(numCells, maxLevel, line);
+            benchNodeTree<QuadTree>("composite", "pointer", numCells, maxLevel, seg,
+                [&](int n, int m){ return new QuadTree(-4.0,-4.0,4.0,4.0,n,m,both); });
+
+            //Neighbor coarsens through node->parent, the line keeps the root
+            //refined
+            benchNodeTree<Neighbor>("neighbor", "pointer", numCells, maxLevel, seg,
+                [&](int n, int m){ return new Neighbor(-4.0,-4.0,4.0,4.0,n,m,line); });
+            benchNodeTree<Neighbor>("balanced", "pointer", numCells, maxLevel, seg,
+                [&](int n, int m){
+                    Neighbor * t = new Neighbor(-4.0,-4.0,4.0,4.0,n,m,line);
+                    t->setBalancePass(true);
+                    return t;
+                });
+            benchNodeTree<BasicQuadTree<Line,NeighborBalance> >("neighbor", "template", numCells, maxLevel, seg,
+                [&](int n, int m){
+                    return new BasicQuadTree<Line,NeighborBalance>(-4.0,-4.0,4.0,4.0,n,m,*line);
+                });
+
+            //uniform refinement grows as 4^maxLevel and the uncached pointer
+            //neighbor search is slow on it, keep the sizes small
+            if(maxLevel <= 6){
+                benchNodeTree<QuadTree>("interaction", "pointer", numCells, maxLevel, NULL,
+                    [&](int n, int m){ return new QuadTree(-4.0,-4.0,4.0,4.0,n,m,all); });
+                benchNodeTree<LinearQuadTree>("interaction", "linear", numCells, maxLevel, NULL,
+                    [&](int n, int m){ return new LinearQuadTree(-4.0,-4.0,4.0,4.0,n,m,all); });
+                benchCompact("interaction", numCells, maxLevel, all, NULL);
+            }
+            //the octree grows much faster, one initial cell (numCells is a
+            //power of 8 there) and smaller levels
+            if(c == 0 && maxLevel <= 8){
+                benchOctree("line", 1, maxLevel, line, seg, false);
+                benchOctree("neighbor", 1, maxLevel, line, seg, true);
+                if(maxLevel <= 4)
+                    benchOctree("interaction", 1, maxLevel, all, NULL, false);
+            }
+            fflush(stdout);
+        }
+    }
+
+    delete both;
+    delete fixedLine;
+    delete fixedSeg;
+    delete line;
+    delete all;
+    delete seg;
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+//  quadTreeMPI.cpp
+//
+//  Driver for the DistributedQuadTree.  Pushes a Line through the domain
+//  like the no graphics mode of quadTreeVis and after every update rank 0
+//  writes one CSV row to stdout:
+//
+//      step,leaves,min_local,max_local,ghosts,repartitions,seconds
+//
+//  where leaves is the global number of leaves, min_local/max_local the
+//  smallest and largest number held by one rank, ghosts the total number of
+//  ghost leaves and seconds the time of the slowest rank for the update.
+//
+//  Usage: mpirun -np <ranks> ./mpiTree [maxLevel] [steps] [threshold]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <mpi.h>
+#include "DistributedQuadTree.h"
+
+using namespace std;
+
+int main(int argc, char ** argv){
+    MPI_Init(&argc, &argv);
+    int maxLevel        = (argc > 1) ? atoi(argv[1]) : 10;
+    int steps           = (argc > 2) ? atoi(argv[2]) : 20;
+    double threshold    = (argc > 3) ? atof(argv[3]) : 0.1;
+
+    Segment segment(-4.0, 0.0, -1.0, -7.0);
+    segment.translate(1.5, 1.5);
+    Line app(&segment);
+    DistributedQuadTree tree(-4, -4, 4, 4, 16, maxLevel, &app);
+    tree.setImbalanceThreshold(threshold);
+    if(tree.getRank() == 0)
+        printf("step,leaves,min_local,max_local,ghosts,repartitions,seconds\n");
+
+    for(int step = 0; step < steps; step++){
+        double start    = MPI_Wtime();
+        tree.update();
+        double elapsed  = MPI_Wtime() - start;
+
+        int local       = tree.getNumLocalLeaves();
+        int ghosts      = tree.getNumGhosts();
+        int smallest, largest, totalGhosts;
+        double slowest;
+        MPI_Reduce(&local, &smallest, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&local, &largest, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&ghosts, &totalGhosts, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        long leaves     = tree.getNumGlobalLeaves();
+        if(tree.getRank() == 0)
+            printf("%d,%ld,%d,%d,%d,%d,%.6f\n", step, leaves, smallest, largest,
+                   totalGhosts, tree.getNumRepartitions(), slowest);
+        segment.translate(0.25, 0.25);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
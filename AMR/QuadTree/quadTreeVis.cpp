@@ -22,6 +22,8 @@
 //#include "QuadTree.h"
 #include "OneLevel.h" //include the derived class
 #include "Neighbor.h"
+#include "LinearQuadTree.h"
+#include "CompactQuadTree.h"
 #include "treeRenderer.h"
 
 //#include "Application.h"
@@ -43,8 +45,8 @@ double originalB;
 
 //holds neighbor info, passed to treeRenderer
 vector<vector<Rectangle> > neighborInfo;
-//holds grid info, passed to treeRenderer
-vector<Rectangle> gridInfo;
+//outlines of the leaves, uploaded as they change
+LeafBuffer leafBuffer;
 
 bool dynamic            = false;
 double sleepTime        = 0;
@@ -53,6 +55,10 @@ bool updateDestructTest = true;
 bool neighborTest       = true;
 bool traversalTest      = true;
 bool updateTest         = false;
+bool backendTest        = false;
+bool cacheNeighbors     = false; //use the cached neighbor links in neighborTest
+int numThreads          = 1; //threads used by the update in updateTest
+bool batchedUpdate      = false; //use the batched update in updateTest
 
 
 /*
@@ -111,16 +117,12 @@ vector<vector<Rectangle> > getNeighbors(double x,double y,
 }
 
 /* 
- * Returns the unfilled rectangles used to draw the grid
- * First finds all the leaves of the quad tree
- * Second convert leaves to rectangles to be drawn by treeRenderer
- * Again this method or variation of it might be later placed in the
- * quad tree class
+ * Brings the leaf buffer up to date with the leaf arrays of the tree, only
+ * the leaves that changed since the last frame are uploaded
  */
-vector<Rectangle> getGrid(){
-    vector<Node*> grid;
-    tree->findLeaves(grid);
-    return convert(grid);
+void syncGrid(){
+    leafBuffer.sync(tree->getNumLeaves(), tree->getLeafX(), tree->getLeafY(),
+                    tree->getLeafWidth(), tree->getLeafHeight());
 }
 
 /* 
@@ -175,7 +177,7 @@ void display(){
     glColor3f (1.0, 1.0, 1.0);
     if(dynamic)
         updateTree();
-    gridInfo = getGrid();
+    syncGrid();
     
     
     treeRenderer::drawString(GLUT_BITMAP_HELVETICA_18, text, leftX, leftY, 0);
@@ -183,7 +185,7 @@ void display(){
     if(displayNeighbors)
         treeRenderer::displayHelperNeighbors(neighborInfo);
     
-    treeRenderer::displayHelperTree(gridInfo);
+    leafBuffer.draw();
     
     if(update || dynamic)
         treeRenderer::drawLine(seg->getx0(),seg->gety0(),
@@ -280,8 +282,6 @@ void mouse(int button, int state, int x, int y){
         if(update){
             updateTree();
             //cout<<"we finished updating"<<endl;
-            gridInfo        = getGrid();
-            
         }
         if(displayNeighbors){//if the 'n' key was pressed, display neighbors
             neighborInfo    = getNeighbors(x,y,NPIX,NPIY);
@@ -291,19 +291,15 @@ void mouse(int button, int state, int x, int y){
             if(coarsen){//if the 'c' key was pressed, coarsen the node
                 if(!coarsenNode(x,y,NPIX,NPIY))
                     text    = "Cannot Coarsen: at root or siblings not leaves";
-                else {
-                    gridInfo = getGrid();
+                else
                     text    = "";
-                }
             }
             else {//if neither key was pressed and we are not using the complete
                 //update, refine the node
                 if(!refineNode(x,y,NPIX,NPIY))
                     text        = "Cannot Refine: reached max level";
-                else {
-                    gridInfo    = getGrid();
+                else
                     text        = "";
-                }
             }
         }
         glutPostRedisplay();//display changes
@@ -366,13 +362,13 @@ int main(int argc, char* argv[]){
             tree                = new Neighbor(-4.0,-4.0,4.0,4.0,16,4,app);
         }
         
+        tree->setTrackLeaves(true);
         vector<double> dims     = tree->getDimensions();
         leftX                   = dims[0];
         leftY                   = dims[1];
         width                   = dims[2];
         height                  = dims[3];
         NPIX = NPIY             = 512;
-        gridInfo                = getGrid();
         
         //glut initialization
         glutInit(&argc, argv);
@@ -389,6 +385,53 @@ int main(int argc, char* argv[]){
         init ();
         glutMainLoop();
     }
+    else if(string(argv[1]) == "frames"){ //line pushing without a window
+        //./vis frames [updates [level [size [every]]]]
+        int updates             = (argc > 2) ? atoi(argv[2]) : 100;
+        int level               = (argc > 3) ? atoi(argv[3]) : 10;
+        int size                = (argc > 4) ? atoi(argv[4]) : 1024;
+        int every               = (argc > 5) ? atoi(argv[5]) : 1;
+        if(updates < 1 || level < 0 || size < 1 || every < 1){
+            cout<<"usage: ./vis frames [updates [level [size [every]]]]"<<endl;
+            return 1;
+        }
+        originalB               = -7.0;
+        seg                     = new Segment(-4.0,0.0,-1.0,originalB);
+        Line * app4             = new Line(seg);
+        tree                    = new QuadTree(-4.0,-4.0,4.0,4.0,16,level,app4);
+        tree->setTrackLeaves(true);
+        vector<double> dims     = tree->getDimensions();
+        double world[4]         = {dims[0], dims[1], dims[2], dims[3]};
+        double step             = world[2]/size;
+        double updateTime       = 0.0;
+        double frameTime        = 0.0;
+        int frames              = 0;
+        clock_t start;
+        for(int u = 0; u < updates; u++){
+            start       = clock();
+            updateTree();
+            updateTime  += double(clock()-start)/CLOCKS_PER_SEC;
+            if(u % every == 0){
+                char name[64];
+                snprintf(name, sizeof(name), "frame_%05d.ppm", frames++);
+                start   = clock();
+                if(!writeFrame(name, size, world, tree->getNumLeaves(),
+                               tree->getLeafX(), tree->getLeafY(),
+                               tree->getLeafWidth(), tree->getLeafHeight(),
+                               true, seg->getx0(), seg->gety0(),
+                               seg->getx1(), seg->gety1()))
+                    cout<<"FILE ERROR "<<name<<endl;
+                frameTime += double(clock()-start)/CLOCKS_PER_SEC;
+            }
+            if(tree->getNumLeaves() == 16 && u > 0)
+                seg->reset(originalB); //the line left the space
+            else
+                seg->translate(step,step);
+        }
+        cout<<"leaves "<<tree->getNumLeaves()<<", "<<updates<<" updates "<<
+        updateTime<<"s, "<<frames<<" frames "<<frameTime<<"s"<<endl;
+        delete tree;
+    }
     else if(string(argv[1]) == "run"){ //we can do some of our testing here
     //outputs csv files of testing results
         originalB               = -7.0;
@@ -408,7 +451,7 @@ int main(int argc, char* argv[]){
                 double averageTimeUpdate = 0.0;
                 double averageTimeDestructor = 0.0;
                 int nodes;
-                int memory;
+                size_t memory;
                 for(int j=0;j<10;j++){
                     tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
                     start   = clock();
@@ -449,6 +492,7 @@ int main(int argc, char* argv[]){
                 for(int j=0;j<10;j++){
                     vector<Node *> leaves;
                     tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    tree->setCacheNeighbors(cacheNeighbors);
                     updateTree();
                     nodes   = tree->countNodes();
                     tree->findLeaves(leaves);
@@ -514,6 +558,8 @@ int main(int argc, char* argv[]){
                 seg->translate(-2.0,-2.0);
                 tree = new QuadTree(-4.0,-4.0,4.0,4.0,1,k,app3);
                 tree->setTime(true);
+                tree->setParallel(numThreads);
+                tree->setBatched(batchedUpdate);
                 double refineTime   = 0.0;
                 double coarsenTime  = 0.0;
                 double updateTime   = 0.0;
@@ -565,6 +611,91 @@ int main(int argc, char* argv[]){
             file.close();
        
         }
+        if(backendTest){
+            // Compares the pointer based, the linear (Morton ordered) and the
+            // compact trees on the same line for trees of different maximum
+            // depths
+            ofstream file;
+            file.open("backendTest.csv");
+            file <<"backend,level,nodes,memory,update,neighbors \n";
+            for(int i=0;i<14;i++){
+                double pointerUpdate = 0.0, pointerNeighbors = 0.0;
+                double linearUpdate  = 0.0, linearNeighbors  = 0.0;
+                double compactUpdate = 0.0, compactNeighbors = 0.0;
+                int pointerNodes, linearNodes, linearMemory;
+                int compactNodes, compactMemory;
+                size_t pointerMemory;
+                for(int j=0;j<10;j++){
+                    vector<Node *> leaves;
+                    tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    start   = clock();
+                    updateTree();
+                    finish  = clock();
+                    pointerUpdate += (double(finish-start)/CLOCKS_PER_SEC);
+                    pointerNodes  = tree->countNodes();
+                    pointerMemory = tree->storage();
+                    tree->findLeaves(leaves);
+                    start   = clock();
+                    for(int m = 0;m<leaves.size();m++) {
+                        vector<Node*> vec;
+                        vector<vector<Node*> > neighbors (4, vec);
+                        tree->getNeighbors(leaves[m],neighbors);
+                    }
+                    finish  = clock();
+                    pointerNeighbors += (double(finish-start)/CLOCKS_PER_SEC);
+                    delete tree;
+
+                    leaves.clear();
+                    LinearQuadTree * linear = new LinearQuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    start   = clock();
+                    linear->update();
+                    finish  = clock();
+                    linearUpdate += (double(finish-start)/CLOCKS_PER_SEC);
+                    linearNodes   = linear->countNodes();
+                    linearMemory  = linear->storage();
+                    linear->findLeaves(leaves);
+                    start   = clock();
+                    for(int m = 0;m<leaves.size();m++) {
+                        vector<Node*> vec;
+                        vector<vector<Node*> > neighbors (4, vec);
+                        linear->getNeighbors(leaves[m],neighbors);
+                    }
+                    finish  = clock();
+                    linearNeighbors += (double(finish-start)/CLOCKS_PER_SEC);
+                    delete linear;
+
+                    vector<uint32_t> indices;
+                    CompactQuadTree * compact = new CompactQuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    start   = clock();
+                    compact->update();
+                    finish  = clock();
+                    compactUpdate += (double(finish-start)/CLOCKS_PER_SEC);
+                    compactNodes  = compact->countNodes();
+                    compactMemory = compact->storage();
+                    compact->findLeaves(indices);
+                    start   = clock();
+                    for(int m = 0;m<indices.size();m++) {
+                        vector<uint32_t> vec;
+                        vector<vector<uint32_t> > neighbors (4, vec);
+                        compact->getNeighbors(indices[m],neighbors);
+                    }
+                    finish  = clock();
+                    compactNeighbors += (double(finish-start)/CLOCKS_PER_SEC);
+                    delete compact;
+                }
+                if(file.is_open()){
+                    file <<"pointer,"<<i<<","<<pointerNodes<<","<<pointerMemory<<","<<
+                    pointerUpdate/10.0<<","<<pointerNeighbors/10.0<<"\n";
+                    file <<"linear,"<<i<<","<<linearNodes<<","<<linearMemory<<","<<
+                    linearUpdate/10.0<<","<<linearNeighbors/10.0<<"\n";
+                    file <<"compact,"<<i<<","<<compactNodes<<","<<compactMemory<<","<<
+                    compactUpdate/10.0<<","<<compactNeighbors/10.0<<"\n";
+                }
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
     }
     cout<<"we exited normally"<<endl;
     return 0;
@@ -7,6 +7,8 @@
 //
 
 
+#include <cstring>
+#include <cmath>
 #include "treeRenderer.h"
 
 using namespace std;
@@ -114,3 +116,128 @@ void treeRenderer::displayHelperTree(std::vector<Rectangle> gridInfo){
     glEnd();
     
 }
+
+LeafBuffer::LeafBuffer(){
+    buffer      = 0;
+    capacity    = 0;
+    count       = 0;
+}
+
+LeafBuffer::~LeafBuffer(){
+    if(buffer != 0)
+        glDeleteBuffers(1, &buffer);
+}
+
+size_t LeafBuffer::sync(size_t n, const double * x, const double * y,
+                        const double * w, const double * h){
+    const size_t FLOATS = 16; //8 vertices of the 4 lines
+    if(buffer == 0)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    
+    bool grown  = n > capacity;
+    if(grown){
+        capacity    = 2*n;
+        glBufferData(GL_ARRAY_BUFFER, capacity*FLOATS*sizeof(float), NULL,
+                     GL_DYNAMIC_DRAW);
+    }
+    vertices.resize(n*FLOATS);
+    
+    size_t uploaded = 0;
+    size_t runStart = n; //first leaf of the run of changed leaves, n if none
+    for(size_t i = 0; i <= n; i++){
+        bool changed = grown || i >= count;
+        if(i < n){
+            float x0    = float(x[i]);
+            float y0    = float(y[i]);
+            float x1    = float(x[i]+w[i]);
+            float y1    = float(y[i]+h[i]);
+            float leaf[FLOATS] = {x0,y0, x1,y0,  x1,y0, x1,y1,
+                                  x1,y1, x0,y1,  x0,y1, x0,y0};
+            float * old = &vertices[i*FLOATS];
+            if(changed || memcmp(old, leaf, sizeof(leaf)) != 0){
+                memcpy(old, leaf, sizeof(leaf));
+                changed = true;
+            }
+        }
+        else
+            changed = false;
+        if(changed && runStart == n)
+            runStart    = i;
+        else if(!changed && runStart != n){
+            glBufferSubData(GL_ARRAY_BUFFER, runStart*FLOATS*sizeof(float),
+                            (i-runStart)*FLOATS*sizeof(float),
+                            &vertices[runStart*FLOATS]);
+            uploaded    += i-runStart;
+            runStart    = n;
+        }
+    }
+    count   = n;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return uploaded;
+}
+
+void LeafBuffer::draw(){
+    if(buffer == 0 || count == 0)
+        return;
+    glColor3f (0.0, 1.0, 0.0);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, NULL);
+    glDrawArrays(GL_LINES, 0, count*8);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+ * Sets the pixels of the line from (x0,y0) to (x1,y1) in pixel space,
+ * clipped to the image
+ */
+static void rasterLine(vector<unsigned char>& image, int size, double x0,
+                       double y0, double x1, double y1,
+                       const unsigned char color[3]){
+    int steps   = int(ceil(max(fabs(x1-x0), fabs(y1-y0)))) + 1;
+    for(int s = 0; s <= steps; s++){
+        double t    = double(s)/steps;
+        int px      = int(x0 + t*(x1-x0));
+        int py      = int(y0 + t*(y1-y0));
+        if(px < 0 || py < 0 || px >= size || py >= size)
+            continue;
+        memcpy(&image[3*(size_t(py)*size + px)], color, 3);
+    }
+}
+
+bool writeFrame(const std::string& path, int size, const double dims[4],
+                size_t n, const double * x, const double * y,
+                const double * w, const double * h, bool drawLine,
+                double x0, double y0, double x1, double y1){
+    const unsigned char green[3] = {0, 255, 0};
+    const unsigned char white[3] = {255, 255, 255};
+    vector<unsigned char> image(3*size_t(size)*size, 0);
+    double sx   = size/dims[2];
+    double sy   = size/dims[3];
+    //world to pixel space, the rows of the file go top down
+    #define PX(wx) (((wx) - dims[0])*sx)
+    #define PY(wy) (size - 1 - ((wy) - dims[1])*sy)
+    for(size_t i = 0; i < n; i++){
+        double left     = PX(x[i]);
+        double right    = min(PX(x[i]+w[i]), size - 1.0);
+        double bottom   = PY(y[i]);
+        double top      = max(PY(y[i]+h[i]), 0.0);
+        rasterLine(image, size, left, bottom, right, bottom, green);
+        rasterLine(image, size, right, bottom, right, top, green);
+        rasterLine(image, size, right, top, left, top, green);
+        rasterLine(image, size, left, top, left, bottom, green);
+    }
+    if(drawLine)
+        rasterLine(image, size, PX(x0), PY(y0), PX(x1), PY(y1), white);
+    #undef PX
+    #undef PY
+    
+    FILE * file = fopen(path.c_str(), "wb");
+    if(file == NULL)
+        return false;
+    fprintf(file, "P6\n%d %d\n255\n", size, size);
+    bool ok     = fwrite(&image[0], 1, image.size(), file) == image.size();
+    return (fclose(file) == 0) && ok;
+}
@@ -13,12 +13,14 @@
 #define ____treeRenderer__
 
 #include <cstdio>
+#define GL_GLEXT_PROTOTYPES //the buffer object calls of GL 1.5
 #include "GLUT/glut.h"
 #include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 /* 
  * Simple struct to hold coordinates of quad tree leaves
@@ -69,4 +71,44 @@ public:
     
 };
 
+/*
+ * The outlines of the leaves in a vertex buffer object, four lines per leaf
+ * in the order of the leaf arrays of the tree.  sync() compares the leaf
+ * arrays with the vertices of the last upload and only uploads the runs of
+ * leaves that changed, since an update moves a few leaves around, so draw()
+ * draws the whole tree with one call without resending it every frame.
+ * The buffer is created on the first sync, which needs a current GL context.
+ */
+class LeafBuffer{
+public:
+    LeafBuffer();
+    ~LeafBuffer();
+    
+    /*
+     * Brings the buffer up to date with n leaves given by their lower left
+     * corners and sizes, returns the number of leaves uploaded
+     */
+    size_t sync(size_t n, const double * x, const double * y,
+                const double * w, const double * h);
+    
+    void draw();
+    
+private:
+    GLuint buffer;
+    size_t capacity; //leaves the buffer has room for
+    size_t count; //leaves in the buffer
+    std::vector<float> vertices; //copy of the buffer, 16 floats per leaf
+};
+
+/*
+ * Software rendering of the tree into image files, for runs without a
+ * window.  The frame is size x size pixels, leaf outlines green on black as
+ * in the window, and the segment (x0,y0)-(x1,y1) in white when drawLine is
+ * set.  Writes a binary PPM, returns false if the file cannot be written.
+ */
+bool writeFrame(const std::string& path, int size, const double dims[4],
+                size_t n, const double * x, const double * y,
+                const double * w, const double * h, bool drawLine,
+                double x0, double y0, double x1, double y1);
+
 #endif /* defined(____treeRenderer__) */
\ No newline at end of file
@@ -0,0 +1,118 @@
+#!/bin/bash
+#
+# Builds the MISH implementations and runs them over a set of initial
+# conditions, collecting the TIME lines into a single CSV
+#
+# usage: ./bench.sh [-o out.csv] [-v "variants"] [-i "inits"] [-s "sizes"]
+#                   [-p nproc] [-t nth] [-f cflags] [-r reps] [-k]
+#
+# sod and crn are run once, wsc and scs once per size multiplier. Variants
+# that fail to build (e.g. no nvcc on the node) are skipped with a note on
+# stderr. -k keeps the scratch directories holding the logs and vis files.
+
+cd "$(dirname "$0")"
+MISH=$(pwd)
+
+OUT=bench.csv
+VARIANTS="hydro_c hydro_c_omp hydro_c_oac hydro_c_mpi hydro_c_mpi_omp hydro_cuda hydro_cuda_mpi"
+INITS="sod crn wsc scs"
+SIZES="1 2 4"
+NPROC=4
+NTH=${OMP_NUM_THREADS:-4}
+BFLAGS="-O3"
+REPS=1
+KEEP=0
+FAIL=0
+MPIRUN=${MPIRUN:-mpirun}
+
+while getopts "o:v:i:s:p:t:f:r:k" opt; do
+  case $opt in
+    o) OUT=$OPTARG;;
+    v) VARIANTS=$OPTARG;;
+    i) INITS=$OPTARG;;
+    s) SIZES=$OPTARG;;
+    p) NPROC=$OPTARG;;
+    t) NTH=$OPTARG;;
+    f) BFLAGS=$OPTARG;;
+    r) REPS=$OPTARG;;
+    k) KEEP=1;;
+    *) sed -n '5,6p' "$0"; exit 1;;
+  esac
+done
+
+# Machine labels that replace the CPU:? and GPU:? placeholders
+CPU=$(grep -m1 "model name" /proc/cpuinfo 2>/dev/null | sed 's/.*: *//')
+[ -z "$CPU" ] && CPU=$(uname -m)
+GPU=$(nvidia-smi --query-gpu=name --format=csv,noheader 2>/dev/null | head -1)
+[ -z "$GPU" ] && GPU=unknown
+MCPU="CPU:$CPU"
+MGPU="GPU:$GPU"
+
+SCRATCH=$(mktemp -d "${TMPDIR:-/tmp}/mish_bench.XXXXXX")
+
+echo "cType,mType,init,size,nproc,nth,niters,ncells,wRunt,wComp,wOut,cellsPerSec" > "$OUT"
+
+for v in $VARIANTS; do
+  if [ ! -d "$v" ]; then
+    echo "bench: no variant $v" >&2
+    continue
+  fi
+
+  # CFLAGS goes through the environment so the += in the Makefiles still
+  # adds -fopenmp to the OpenMP builds
+  echo "bench: building $v" >&2
+  make -C "$v" clean > /dev/null 2>&1
+  if ! CFLAGS="$BFLAGS" make -C "$v" > "$SCRATCH/$v.build" 2>&1 || [ ! -x "$v/hydro" ]; then
+    echo "bench: $v failed to build, see $SCRATCH/$v.build" >&2
+    FAIL=1
+    continue
+  fi
+
+  case $v in
+    *mpi*) LAUNCH="$MPIRUN -np $NPROC";;
+    *) LAUNCH="";;
+  esac
+
+  for init in $INITS; do
+    case $init in
+      wsc|scs) args=$SIZES;;
+      *) args=1;;
+    esac
+    for s in $args; do
+      for r in $(seq 1 $REPS); do
+        run="$SCRATCH/$v.$init.$s.$r"
+        mkdir -p "$run/outDir"
+        if [ "$init" = "sod" ] || [ "$init" = "crn" ]; then
+          parm=""
+        else
+          parm=$s
+        fi
+        echo "bench: $v $init $parm ($r/$REPS)" >&2
+        (cd "$run" && OMP_NUM_THREADS=$NTH $LAUNCH "$MISH/$v/hydro" $init $parm > log 2>&1)
+
+        line=$(grep -m1 "^TIME:" "$run/log")
+        if [ -z "$line" ]; then
+          echo "bench: $v $init $parm produced no TIME line, see $run/log" >&2
+          FAIL=1
+          continue
+        fi
+        # TIME:cType,mType,init,nproc,nth,niters,ncells,wRunt,wComp,wOut
+        echo "${line#TIME:}" | awk -F, -v cpu="$MCPU" -v gpu="$MGPU" -v init="$init" -v s="$s" '
+          {
+            m=($2 ~ /GPU/) ? gpu : cpu;
+            cups=($9>0) ? $6*$7/$9 : 0;
+            printf "%s,\"%s\",\"%s\",%d,%s,%s,%s,%s,%s,%s,%s,%g\n",$1,m,init,s,$4,$5,$6,$7,$8,$9,$10,cups;
+          }' >> "$OUT"
+
+        [ $KEEP -eq 0 ] && rm -rf "$run"
+      done
+    done
+  done
+done
+
+if [ $KEEP -eq 0 ] && [ $FAIL -eq 0 ]; then
+  rm -rf "$SCRATCH"
+else
+  echo "bench: logs kept in $SCRATCH" >&2
+fi
+echo "bench: results in $OUT" >&2
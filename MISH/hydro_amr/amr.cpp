@@ -0,0 +1,501 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "amr.h"
+#include "cody_perf.h"
+
+//Ghost layers of the patches, the cells trace reads past the ends of a
+//pencil
+#define NG 2
+
+static hydro_prob *Hp;
+static hydro_args *Ha;
+static amr_args *Aa;
+static QuadTree *tree;
+static int ids[4];
+//Pencil arrays of one patch and the patch interior addFlux updates
+static real_t *q;
+static real_t *qr, *ql;
+static real_t *flx;
+static real_t *cells;
+//Fluxes through the low and high faces of the pencils of every leaf in the
+//last pass, by conserved variable, for the flux correction
+static std::vector<double> faceFlx;
+static std::vector<double> corr;
+static std::vector<std::vector<Node*> > faceNbrs(4);
+static double wGhost;
+
+static double getNow(){
+  return cody_now();
+}
+
+DensityGradient::DensityGradient(double rJump, double cJump){
+  tree=NULL;
+  rho=-1;
+  flag=-1;
+  refineJump=rJump;
+  coarsenJump=cJump;
+  neighbors.resize(4);
+}
+
+void DensityGradient::setTree(QuadTree *t, int rhoId, int flagId){
+  tree=t;
+  rho=rhoId;
+  flag=flagId;
+}
+
+//Largest relative jump of the density between two cells sharing a face,
+//the ghost layer along each face included
+double DensityGradient::jump(size_t leaf){
+  int n=tree->getPatchSize(rho);
+  int s=tree->getPatchStride(rho);
+  int g=tree->getPatchGhosts(rho);
+  const double *p=tree->getPatch(rho,leaf);
+  const double *c;
+  double a, b, lo, m;
+  int i,j;
+
+  m=0.0;
+  for(j=-1;j<n;j++){
+    for(i=-1;i<n;i++){
+      c=p+(j+g)*s+i+g;
+      a=c[0];
+      if(j>=0){
+        //across the east face of cell i
+        b=c[1];
+        lo=MIN(a,b);
+        lo=MAX(lo,Ha->smallr);
+        if(fabs(b-a)>m*lo)m=fabs(b-a)/lo;
+      }
+      if(i>=0){
+        //across the north face of cell j
+        b=c[s];
+        lo=MIN(a,b);
+        lo=MAX(lo,Ha->smallr);
+        if(fabs(b-a)>m*lo)m=fabs(b-a)/lo;
+      }
+    }
+  }
+  return m;
+}
+
+size_t DensityGradient::flagLeaves(){
+  size_t nl=tree->getNumLeaves();
+  Node * const *nodes=tree->getLeafNodes();
+  const int *level=tree->getLeafLevel();
+  double *f=tree->getField(flag);
+  size_t l, k, count;
+  int d;
+
+  jumps.resize(nl);
+  for(l=0;l<nl;l++){
+    jumps[l]=jump(l);
+  }
+  count=0;
+  for(l=0;l<nl;l++){
+    f[l]=jumps[l];
+    for(d=0;d<4;d++){
+      neighbors[d].clear();
+    }
+    tree->getNeighbors(nodes[l],neighbors);
+    for(d=0;d<4;d++){
+      for(k=0;k<neighbors[d].size();k++){
+        if(neighbors[d][k]->isLeaf&&f[l]<jumps[neighbors[d][k]->leafIndex]){
+          f[l]=jumps[neighbors[d][k]->leafIndex];
+        }
+      }
+    }
+    if(f[l]>refineJump&&level[l]<tree->getMaxLevel())count++;
+  }
+  return count;
+}
+
+bool DensityGradient::refine(double x, double y, double w, double h){
+  Node *leaf=tree->findNode(x+0.5*w,y+0.5*h);
+  return tree->getField(flag)[leaf->leafIndex]>refineJump;
+}
+
+bool DensityGradient::coarsen(double x, double y, double w, double h){
+  Node *node=tree->findNode(x+0.5*w,y+0.5*h);
+  const double *f=tree->getField(flag);
+
+  //The node asked about is the ancestor of that width of the leaf
+  while(node->parent!=NULL&&node->width<0.75*w){
+    node=node->parent;
+  }
+  TreeWalk walk(node);
+  while(Node *c=walk.current()){
+    if(!c->isLeaf){
+      walk.descend();
+      continue;
+    }
+    if(f[c->leafIndex]>=coarsenJump)return false;
+    walk.skip();
+  }
+  return true;
+}
+
+//Conserved state of the initial condition at the cell centres of every leaf
+static void setInit(amr_init init){
+  int n=Aa->patch, s=n+2*NG;
+  size_t l;
+  int i,j,v;
+  double u[4];
+
+  for(l=0;l<tree->getNumLeaves();l++){
+    double x=tree->getLeafX()[l];
+    double y=tree->getLeafY()[l];
+    double cw=tree->getLeafWidth()[l]/n;
+    double ch=tree->getLeafHeight()[l]/n;
+    for(j=0;j<n;j++){
+      for(i=0;i<n;i++){
+        init(x+(i+0.5)*cw,y+(j+0.5)*ch,u);
+        for(v=0;v<4;v++){
+          tree->getPatch(ids[v],l)[(j+NG)*s+i+NG]=u[v];
+        }
+      }
+    }
+  }
+}
+
+//Timestep of the leaves, calcDT of hydro_c with the cell size of each leaf
+static double calcDT(){
+  int n=Aa->patch, s=n+2*NG;
+  size_t l;
+  int i,j,k;
+  double r,vx,vy,eint,p,c,denom,max_denom;
+  double smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  max_denom=Ha->smallc;
+  for(l=0;l<tree->getNumLeaves();l++){
+    double dx=tree->getLeafWidth()[l]/n;
+    double dy=tree->getLeafHeight()[l]/n;
+    const double *u[4];
+    for(i=0;i<4;i++){
+      u[i]=tree->getPatch(ids[i],l);
+    }
+    for(j=0;j<n;j++){
+      for(i=0;i<n;i++){
+        k=(j+NG)*s+i+NG;
+        r   =MAX(u[VARRHO][k],Ha->smallr);
+        vx  =    u[VARVX ][k]/r;
+        vy  =    u[VARVY ][k]/r;
+        eint=    u[VARPR ][k]-0.5*r*(vx*vx+vy*vy);
+        p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
+        c=sqrt((Hp->gamma*p/r));
+        denom=(c+fabs(vx))/dx+(c+fabs(vy))/dy;
+        if(max_denom<denom)max_denom=denom;
+      }
+    }
+  }
+  return 0.5/max_denom;
+}
+
+//Primitive pencils of a patch along dir, the pencils of the y pass have vy
+//in the VARVX rows like toPrimY. The ghost cells come from the last
+//fillGhosts, at the domain boundary they mirror the patch (BND_REFL)
+static void toPrimPatch(size_t l, int dir){
+  int n=Aa->patch, s=n+2*NG;
+  int row=ROW_LEN(n+4);
+  int t,i,src,k;
+  bool lo,hi;
+  double sgn;
+  real_t r,vx,vy,eint,p;
+  real_t smallp;
+  const double *u[4];
+  double lx,lw,tol;
+
+  for(i=0;i<4;i++){
+    u[i]=tree->getPatch(ids[i],l);
+  }
+  lx=(dir==0)?tree->getLeafX()[l]:tree->getLeafY()[l];
+  lw=(dir==0)?tree->getLeafWidth()[l]:tree->getLeafHeight()[l];
+  tol=0.25*lw/n;
+  lo=lx<tol;
+  hi=lx+lw>1.0-tol;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  for(t=0;t<n;t++){
+    for(i=-2;i<n+2;i++){
+      src=i;
+      sgn=1.0;
+      if(i<0&&lo){
+        src=-1-i;
+        sgn=-1.0;
+      }else if(i>=n&&hi){
+        src=2*n-1-i;
+        sgn=-1.0;
+      }
+      k=(dir==0)?(t+NG)*s+src+NG:(src+NG)*s+t+NG;
+      r   =MAX(u[VARRHO][k],Ha->smallr);
+      vx  =u[VARVX ][k]/r;
+      vy  =u[VARVY ][k]/r;
+      eint=u[VARPR ][k]-0.5*r*(vx*vx+vy*vy);
+      p   =MAX((Hp->gamma-1)*r*eint,smallp);
+      q[i+2+row*(t+n*VARRHO)]=r;
+      q[i+2+row*(t+n*VARVX )]=sgn*((dir==0)?vx:vy);
+      q[i+2+row*(t+n*VARVY )]=(dir==0)?vy:vx;
+      q[i+2+row*(t+n*VARPR )]=p;
+    }
+  }
+}
+
+//One pass of a patch: trace, riemann and the flux update of hydro_c on
+//the n pencils of the patch
+static void passPatch(size_t l, int dir, double dt){
+  int n=Aa->patch, s=n+2*NG;
+  int i,j,v;
+  double dxp;
+  double *u;
+
+  dxp=((dir==0)?tree->getLeafWidth()[l]:tree->getLeafHeight()[l])/n;
+  toPrimPatch(l,dir);
+  trace(ql,qr,q,dt/dxp,n,n);
+  riemann(flx,ql,qr,n,n);
+  //The y pass has the vx and vy fluxes swapped, like addFluxY
+  for(v=0;v<4;v++){
+    int cv=(dir==0||v==VARRHO||v==VARPR)?v:VARVX+VARVY-v;
+    double *lo=&faceFlx[((l*2+0)*4+cv)*n];
+    double *hi=&faceFlx[((l*2+1)*4+cv)*n];
+    for(j=0;j<n;j++){
+      lo[j]=flx[0+ROW_LEN(n+1)*(j+n*v)];
+      hi[j]=flx[n+ROW_LEN(n+1)*(j+n*v)];
+    }
+  }
+  //addFluxX and addFluxY both index the cells x+n*(y+n*var)
+  for(v=0;v<4;v++){
+    u=tree->getPatch(ids[v],l);
+    for(j=0;j<n;j++){
+      for(i=0;i<n;i++){
+        cells[i+n*(j+n*v)]=u[(j+NG)*s+i+NG];
+      }
+    }
+  }
+  if(dir==0){
+    addFluxX(cells,flx,dt/dxp,n,n,NULL);
+  }else{
+    addFluxY(cells,flx,dt/dxp,n,n,NULL);
+  }
+  for(v=0;v<4;v++){
+    u=tree->getPatch(ids[v],l);
+    for(j=0;j<n;j++){
+      for(i=0;i<n;i++){
+        u[(j+NG)*s+i+NG]=cells[i+n*(j+n*v)];
+      }
+    }
+  }
+}
+
+//Flux correction of a pass: the edge cells of a leaf next to finer leaves
+//were updated with the flux of the leaf itself through the face, swaps it
+//for the sum of the fluxes of the finer leaves through it so the mass and
+//energy leaving one side of the face are what enters the other
+static void reflux(double dt, int dir){
+  int n=Aa->patch, s=n+2*NG;
+  Node * const *nodes=tree->getLeafNodes();
+  const int *level=tree->getLeafLevel();
+  //Faces of the low and high ends of the pencils, N S E W numbering
+  int dFace[2];
+  size_t l, k;
+  int side, fSide, i, t, ft, v, d;
+  double t0, tw, ft0, ftw, dxp;
+
+  dFace[0]=(dir==0)?3:1;
+  dFace[1]=(dir==0)?2:0;
+  corr.resize(4*n);
+  for(l=0;l<tree->getNumLeaves();l++){
+    for(d=0;d<4;d++){
+      faceNbrs[d].clear();
+    }
+    tree->getNeighbors(nodes[l],faceNbrs);
+    t0 =(dir==0)?tree->getLeafY()[l]:tree->getLeafX()[l];
+    tw =((dir==0)?tree->getLeafHeight()[l]:tree->getLeafWidth()[l])/n;
+    dxp=((dir==0)?tree->getLeafWidth()[l]:tree->getLeafHeight()[l])/n;
+    for(side=0;side<2;side++){
+      std::vector<Node*>& fine=faceNbrs[dFace[side]];
+      if(fine.empty()||fine[0]->currentLevel<=level[l])continue;
+      fSide=1-side;
+      std::fill(corr.begin(),corr.end(),0.0);
+      for(k=0;k<fine.size();k++){
+        size_t m=fine[k]->leafIndex;
+        ft0=(dir==0)?fine[k]->y:fine[k]->x;
+        ftw=((dir==0)?fine[k]->height:fine[k]->width)/n;
+        for(ft=0;ft<n;ft++){
+          t=(int)floor((ft0+(ft+0.5)*ftw-t0)/tw);
+          if(t<0||t>=n)continue;
+          for(v=0;v<4;v++){
+            corr[v*n+t]+=faceFlx[((m*2+fSide)*4+v)*n+ft]*(ftw/tw);
+          }
+        }
+      }
+      i=(side==0)?0:n-1;
+      for(v=0;v<4;v++){
+        double *u=tree->getPatch(ids[v],l);
+        const double *fc=&faceFlx[((l*2+side)*4+v)*n];
+        for(t=0;t<n;t++){
+          k=(dir==0)?(t+NG)*s+i+NG:(i+NG)*s+t+NG;
+          if(side==0){
+            u[k]+=dt/dxp*(corr[v*n+t]-fc[t]);
+          }else{
+            u[k]+=dt/dxp*(fc[t]-corr[v*n+t]);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void runPass(double dt, int dir){
+  double t;
+  size_t l;
+  int v;
+
+  t=getNow();
+  for(v=0;v<4;v++){
+    tree->fillGhosts(ids[v]);
+  }
+  wGhost+=getNow()-t;
+  faceFlx.resize(tree->getNumLeaves()*2*4*Aa->patch);
+  for(l=0;l<tree->getNumLeaves();l++){
+    passPatch(l,dir,dt);
+  }
+  if(Aa->maxLevel>0){
+    reflux(dt,dir);
+  }
+}
+
+//Sum of a variable over the leaves, times the cell areas
+static double sumVar(int var){
+  int n=Aa->patch, s=n+2*NG;
+  size_t l;
+  int i,j;
+  double sum, area;
+
+  sum=0.0;
+  for(l=0;l<tree->getNumLeaves();l++){
+    const double *u=tree->getPatch(ids[var],l);
+    area=tree->getLeafWidth()[l]*tree->getLeafHeight()[l]/(n*n);
+    for(j=0;j<n;j++){
+      for(i=0;i<n;i++){
+        sum+=area*u[(j+NG)*s+i+NG];
+      }
+    }
+  }
+  return sum;
+}
+
+static void regrid(DensityGradient *crit){
+  tree->fillGhosts(ids[VARRHO]);
+  crit->flagLeaves();
+  tree->update();
+}
+
+void amrEngine(amr_init init, hydro_prob *Hyp, hydro_args *Hya, amr_args *Aya,
+               amr_stats *St, double *rho){
+  int n, k, i, j;
+  double dt, cTime;
+  double initT, rgT;
+  size_t l, cellsPerLeaf;
+  int np;
+  DensityGradient *crit;
+
+  Hp=Hyp;
+  Ha=Hya;
+  Aa=Aya;
+  setKernelProb(Hp,Ha);
+  np=Aa->patch;
+  cellsPerLeaf=(size_t)np*np;
+
+  q    =(real_t*)malloc(4*ROW_LEN(np+4)*np*sizeof(real_t));
+  qr   =(real_t*)malloc(4*ROW_LEN(np+2)*np*sizeof(real_t));
+  ql   =(real_t*)malloc(4*ROW_LEN(np+2)*np*sizeof(real_t));
+  flx  =(real_t*)malloc(4*ROW_LEN(np+1)*np*sizeof(real_t));
+  cells=(real_t*)malloc(4*cellsPerLeaf*sizeof(real_t));
+
+  crit=new DensityGradient(Aa->refineJump,Aa->coarsenJump);
+  tree=new QuadTree(0.0,0.0,1.0,1.0,1<<(2*Aa->minLevel),Aa->maxLevel,crit);
+  ids[VARRHO]=tree->addPatchField("rho",np,NG);
+  ids[VARVX ]=tree->addPatchField("rhovx",np,NG);
+  ids[VARVY ]=tree->addPatchField("rhovy",np,NG);
+  ids[VARPR ]=tree->addPatchField("E",np,NG);
+  crit->setTree(tree,ids[VARRHO],tree->addField("flag",Prolongation(),
+      [](Node *, const double children[4]){
+        return std::max(std::max(children[0],children[1]),
+                        std::max(children[2],children[3]));
+      }));
+
+  //Refine around the initial discontinuities, at most one pass per level
+  setInit(init);
+  for(k=Aa->minLevel;k<Aa->maxLevel;k++){
+    tree->fillGhosts(ids[VARRHO]);
+    if(crit->flagLeaves()==0)break;
+    tree->update();
+    setInit(init);
+  }
+
+  wGhost=0.0;
+  St->wRegrid=0.0;
+  St->cellUpdates=0.0;
+  printf("INIT: leaves %zu cells %zu TM: %g TE: %g\n",tree->getNumLeaves(),
+         tree->getNumLeaves()*cellsPerLeaf,sumVar(VARRHO),sumVar(VARPR));
+
+  n=0;
+  cTime=0.0;
+  initT=getNow();
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    dt=Ha->sigma*calcDT();
+    if(Ha->tend>0.0&&dt>Ha->tend-cTime){
+      dt=Ha->tend-cTime;
+    }
+    if(n%2==0){
+      runPass(dt,0);
+      runPass(dt,1);
+    }else{
+      runPass(dt,1);
+      runPass(dt,0);
+    }
+    St->cellUpdates+=(double)tree->getNumLeaves()*cellsPerLeaf;
+    n+=1;
+    cTime+=dt;
+    if(n%Ha->nprtLine==0){
+      printf("Iter %05d time %f dt %g leaves %zu TM: %g TE: %g\n",n,cTime,dt,
+             tree->getNumLeaves(),sumVar(VARRHO),sumVar(VARPR));
+    }
+    if(Aa->maxLevel>0&&n%Aa->regrid==0){
+      rgT=getNow();
+      regrid(crit);
+      St->wRegrid+=getNow()-rgT;
+    }
+  }
+  St->wComp=getNow()-initT;
+  St->wGhost=wGhost;
+  St->niters=n;
+  St->leaves=tree->getNumLeaves();
+  St->cells=St->leaves*cellsPerLeaf;
+  St->TM=sumVar(VARRHO);
+  St->TE=sumVar(VARPR);
+  printf("time: %f, %d iters run\n",cTime,n);
+
+  //Density on the finest mesh, each leaf cell covering f by f cells of it
+  for(l=0;l<tree->getNumLeaves();l++){
+    const double *u=tree->getPatch(ids[VARRHO],l);
+    int f=(int)lround(tree->getLeafWidth()[l]*Hp->nx/np);
+    int x0=(int)lround(tree->getLeafX()[l]*Hp->nx);
+    int y0=(int)lround(tree->getLeafY()[l]*Hp->ny);
+    for(j=0;j<np*f;j++){
+      for(i=0;i<np*f;i++){
+        rho[(size_t)(y0+j)*Hp->nx+x0+i]=u[(j/f+NG)*(np+2*NG)+i/f+NG];
+      }
+    }
+  }
+
+  delete tree;
+  delete crit;
+  free(q);
+  free(qr);
+  free(ql);
+  free(flx);
+  free(cells);
+}
@@ -0,0 +1,77 @@
+#ifndef AMR_H_
+#define AMR_H_
+
+#include <vector>
+#include "QuadTree.h"
+#include "hydro.h"
+
+typedef struct __amrArgs{
+  //Depth of the tree, the leaves of the last level are 2^maxLevel patches
+  //across the domain. 0 runs a single patch, the uniform mesh
+  int maxLevel;
+  //Level of the initial uniform tree the refinement starts from
+  int minLevel;
+  //Cells along each side of a patch
+  int patch;
+  //Steps between two regrids
+  int regrid;
+  //Relative density jump between neighbouring cells that refines a leaf,
+  //a node is coarsened when all of its leaves jump less than coarsenJump
+  double refineJump;
+  double coarsenJump;
+} amr_args;
+
+typedef struct __amrStats{
+  int niters;
+  //Cells updated by the steps, summed over the steps
+  double cellUpdates;
+  //Leaves and cells at the end of the run
+  size_t leaves;
+  size_t cells;
+  //Wall time of the steps, and of the regrids and ghost fills in it
+  double wComp;
+  double wRegrid;
+  double wGhost;
+  double TM, TE;
+} amr_stats;
+
+//Conserved state (rho, rho vx, rho vy, E) at (x,y) of the initial condition
+typedef void (*amr_init)(double x, double y, double *u);
+
+//Refines the leaves whose density jumps by more than refineJump between
+//two neighbouring cells, or next to one across a face. flagLeaves writes
+//the jump of every leaf into the flag field of the tree, refined children
+//inherit the flag of their parent and a coarsened node keeps the largest
+//of its children, so the criteria only read the flags during the update
+class DensityGradient : public Application {
+public:
+  DensityGradient(double refineJump, double coarsenJump);
+
+  //Set once the tree exists, before its first update
+  void setTree(QuadTree *t, int rhoId, int flagId);
+
+  //Sets the flags of the leaves from the density patches, the ghost cells
+  //must have been filled. Returns the number of leaves to refine
+  size_t flagLeaves();
+
+  bool refine(double x, double y, double w, double h);
+  bool coarsen(double x, double y, double w, double h);
+
+private:
+  double jump(size_t leaf);
+
+  QuadTree *tree;
+  int rho, flag;
+  double refineJump, coarsenJump;
+  std::vector<double> jumps;
+  std::vector<std::vector<Node*> > neighbors;
+};
+
+//Runs the problem from init to Ha->tend or Ha->nstepmax on the unit square
+//split into Hp->nx by Hp->ny cells at the finest level, with the pencil
+//kernels of hydro_c over the patches of the tree. rho receives the final
+//density on that mesh, every leaf cell injected into the cells it covers
+void amrEngine(amr_init init, hydro_prob *Hp, hydro_args *Ha, amr_args *Aa,
+               amr_stats *St, double *rho);
+
+#endif //AMR_H_
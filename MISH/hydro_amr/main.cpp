@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "amr.h"
+#include "cody_perf.h"
+
+//Initial conditions on the unit square: the high density corner of crn,
+//and the lower half of sod turned into a square
+static void initCrn(double x, double y, double *u){
+  bool in=(x<0.5&&y<0.5);
+  u[VARRHO]=in?1.0:0.125;
+  u[VARVX ]=0.0;
+  u[VARVY ]=0.0;
+  u[VARPR ]=in?2.5:2.0;
+}
+
+static void initSod(double, double y, double *u){
+  bool in=(y<0.5);
+  u[VARRHO]=in?1.0:0.125;
+  u[VARVX ]=0.0;
+  u[VARVY ]=0.0;
+  u[VARPR ]=in?2.5:2.0;
+}
+
+static void printStats(const char *cType, amr_stats *St){
+  printf("TIME:\"%s\",%s,%s,%d,%d,%d,%.0f,%g,%g,%g\n",cType,"\"CPU:?\"",
+         "\"Init\"",1,1,St->niters,St->cellUpdates/St->niters,St->wComp,
+         St->wComp,0.0);
+}
+
+//The run in the rows shared by the mini-apps, with the regrids and the
+//ghost fills of the AMR run as extra rows
+static void reportStats(const char *variant, amr_stats *St){
+  cody_report(variant,1,1,St->cellUpdates/St->niters,St->niters,St->wComp);
+  cody_metric("wRegrid",St->wRegrid);
+  cody_metric("wGhost",St->wGhost);
+}
+
+int main(int argc, char* argv[]){
+  hydro_prob Hp;
+  hydro_args Ha;
+  amr_args Aa, Ua;
+  amr_stats As, Us;
+  amr_init init=NULL;
+  std::vector<double> aRho, uRho;
+  double l1, rate, uRate;
+  size_t i, nCells;
+
+  if(argc<2){
+    printf("No init supplied\n");
+    return 1;
+  }
+  if(!strcmp(argv[1],"sod")) init=initSod;
+  else if(!strcmp(argv[1],"crn")) init=initCrn;
+  else{
+    printf("Unknown init\n");
+    return 1;
+  }
+
+  Aa.maxLevel=5;
+  Aa.minLevel=2;
+  Aa.patch=16;
+  Aa.regrid=4;
+  Aa.refineJump=0.05;
+  Aa.coarsenJump=0.01;
+  if((argc>2&&sscanf(argv[2],"%d",&Aa.maxLevel)!=1)||
+     (argc>3&&sscanf(argv[3],"%d",&Aa.patch)!=1)||
+     (argc>4&&sscanf(argv[4],"%d",&Aa.regrid)!=1)||
+     (argc>5&&sscanf(argv[5],"%lf",&Aa.refineJump)!=1)||
+     (argc>6&&sscanf(argv[6],"%lf",&Aa.coarsenJump)!=1)){
+    printf("Bad arguments\n");
+    return 1;
+  }
+  if(Aa.maxLevel<1||Aa.patch<2||Aa.patch%2!=0||Aa.regrid<1){
+    printf("Need levels >= 1, an even patch size and regrid >= 1\n");
+    return 1;
+  }
+  if(Aa.minLevel>Aa.maxLevel)Aa.minLevel=Aa.maxLevel;
+
+  //The uniform mesh of the finest level
+  Hp.nx=Aa.patch<<Aa.maxLevel;
+  Hp.ny=Hp.nx;
+  Hp.dx=1.0/Hp.nx;
+  Hp.dy=1.0/Hp.ny;
+  Hp.t=0.0;
+  Hp.nvar=4;
+  Hp.gamma=1.4;
+  Hp.bndL=BND_REFL;
+  Hp.bndR=BND_REFL;
+  Hp.bndU=BND_REFL;
+  Hp.bndD=BND_REFL;
+
+  Ha.sigma=0.9;
+  Ha.nprtLine=100;
+  Ha.tend=0.1;
+  Ha.nstepmax=-1;
+  Ha.smallr=1e-10;
+  Ha.smallc=1e-10;
+  Ha.niter_riemann=10;
+  Ha.riemannMode=RIEMANN_MODE;
+
+  cody_init("MISH");
+  printf("INIT:%s\n",argv[1]);
+  printf("INIT:AMR %d levels of %dx%d patches, %dx%d effective\n",
+         Aa.maxLevel,Aa.patch,Aa.patch,Hp.nx,Hp.ny);
+  nCells=(size_t)Hp.nx*Hp.ny;
+  aRho.resize(nCells);
+  uRho.resize(nCells);
+  amrEngine(init,&Hp,&Ha,&Aa,&As,&aRho[0]);
+
+  //The same kernels on one patch of the whole mesh
+  printf("INIT:UNI %dx%d\n",Hp.nx,Hp.ny);
+  Ua=Aa;
+  Ua.maxLevel=0;
+  Ua.minLevel=0;
+  Ua.patch=Hp.nx;
+  amrEngine(init,&Hp,&Ha,&Ua,&Us,&uRho[0]);
+
+  l1=0.0;
+  for(i=0;i<nCells;i++){
+    l1+=fabs(aRho[i]-uRho[i]);
+  }
+  l1*=Hp.dx*Hp.dy;
+  rate=As.cellUpdates/As.wComp;
+  uRate=Us.cellUpdates/Us.wComp;
+
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printStats("AMR",&As);
+  printStats("UNI",&Us);
+  printf("AFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","levels","patch",
+         "leaves","cells","wRegrid","wGhost","amrCellsPerSec",
+         "uniCellsPerSec","cellFrac","speedup","L1rho","dTM","dTE");
+  printf("AMR:%d,%d,%zu,%zu,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",Aa.maxLevel,
+         Aa.patch,As.leaves,As.cells,As.wRegrid,As.wGhost,rate,uRate,
+         As.cellUpdates/Us.cellUpdates,Us.wComp/As.wComp,l1,As.TM-Us.TM,
+         As.TE-Us.TE);
+  reportStats("hydro_amr",&As);
+  reportStats("hydro_amr_uni",&Us);
+  cody_finish();
+  return 0;
+}
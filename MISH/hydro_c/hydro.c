@@ -1,29 +1,69 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
-#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "hydro.h"
+#include "outfile.h"
+#include "cody_perf.h"
 #include "float.h"
 
-hydro_args *Ha;
-hydro_prob *Hp;
-double *q;
-double *qr, *ql;
-double *flx;
+KERNEL_LOCAL hydro_args *Ha;
+KERNEL_LOCAL hydro_prob *Hp;
+KERNEL_LOCAL real_t *q;
+KERNEL_LOCAL real_t *qr, *ql;
+KERNEL_LOCAL real_t *flx;
+//dt denominator of the mesh left by the last pass, with FUSED_DT
+KERNEL_LOCAL real_t stepDen;
 
-double slope(double *q,int ind);
+real_t slope(real_t *q,int ind);
 
-//Utility function to get wall runtime
+#if STAGE_TIMERS
+//Cumulative wall time of each stage, indexed by ST_*
+KERNEL_LOCAL double stageT[NSTAGE];
+#define STAGE(s,call) {double stT=getNow(); call; stageT[s]+=getNow()-stT;}
+#else
+#define STAGE(s,call) call
+#endif
+
+//Utility function to get wall runtime, the monotonic clock all the
+//mini-apps time with
 double getNow(){
-  struct timeval tv;
-  gettimeofday(&tv,NULL);
-  return (double)tv.tv_sec+1e-6*(double)tv.tv_usec;
+  return cody_now();
+}
+
+//Elements needed by a pass array with halo extra cells per row for the
+//larger of the x and y passes
+size_t passSize(int halo){
+  size_t xLen, yLen;
+
+  xLen=(size_t)ROW_LEN(Hp->nx+halo)*Hp->ny;
+  yLen=(size_t)ROW_LEN(Hp->ny+halo)*Hp->nx;
+  return (xLen>yLen)?xLen:yLen;
+}
+
+//Allocates a pass array of n elements, aligned to ALIGN_BYTES when the
+//rows are padded
+real_t *allocPass(size_t n){
+#if PAD_ROWS
+  void *ptr;
+
+  if(posix_memalign(&ptr,ALIGN_BYTES,n*sizeof(real_t))!=0){
+    return NULL;
+  }
+  return (real_t*)ptr;
+#else
+  return (real_t*)malloc(n*sizeof(real_t));
+#endif
 }
 
 //Utility function for debugging, prints entire state var array
 //in relatively readable format
-void printArray(char* label,double *arr, int nvar, int nx, int ny){
+void printArray(char* label,real_t *arr, int nvar, int nx, int ny){
   int nV,i,j;
   printf("Array %s\n",label);
   for(nV=0;nV<nvar;nV++){
@@ -43,45 +83,88 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny){
   }
 }
 
+//Timestep denominator of mesh cell i, the sum over both dims of the max
+//expected velocity over the cell width
+static inline real_t cellDenom(real_t *mesh, int i){
+  real_t r,vx,vy,eint,p;
+  real_t c,cx,cy;
+  real_t smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  //Get primitive vars
+  r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
+  vx  =    mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
+  vy  =    mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
+  eint=    mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
+
+  //get sound speed
+  c=sqrt((Hp->gamma*p/r));
+
+  //Get max expected velocity in each dim
+  cx=(c+fabs(vx))/Hp->dx;
+  cy=(c+fabs(vy))/Hp->dy;
+  return cx+cy;
+}
+
 //Function to calculate timestep
-double calcDT(double *mesh){
+double calcDT(real_t *mesh){
   int i;
-  double denom, max_denom;
-  double r,vx,vy,eint,p;
-  double c,cx,cy;
-  double smallp;
+  real_t denom, max_denom;
 
-  //Initialize constants
-  c=0.0;
   max_denom=Ha->smallc;
-
-  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
   for (i=0; i<Hp->nx*Hp->ny; i++){
-    //Get primitive vars
-    r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
-    vx  =    mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
-    vy  =    mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
-    eint=    mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
-    p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
-    
-    //get sound speed
-    c=sqrt((Hp->gamma*p/r));
-
-    //Get max expected velocity in each dim
-    cx=(c+fabs(vx))/Hp->dx;
-    cy=(c+fabs(vy))/Hp->dy;
-    denom=cx+cy;
+    denom=cellDenom(mesh,i);
     if(max_denom<denom)max_denom=denom;
   }
   return 0.5/max_denom;
 }
 
+//Problem read by the pencil kernels when they are run outside of engine
+void setKernelProb(hydro_prob *Hyp, hydro_args *Hya){
+  Hp=Hyp;
+  Ha=Hya;
+}
+
+//Allocates q, ql, qr and flx for the passes of the problem set by
+//setKernelProb
+void allocPasses(){
+  size_t primSize, qSize, flxSize;
+  int np;
+
+  //Get state var sizes for allocation
+  if(Ha->sweepTile>0){
+    //Only one tile of pencils of the longer dim at a time
+    np=MAX(Hp->nx,Hp->ny);
+    primSize=Hp->nvar*ROW_LEN(np+4)*Ha->sweepTile;
+    qSize   =Hp->nvar*ROW_LEN(np+2)*Ha->sweepTile;
+    flxSize =Hp->nvar*ROW_LEN(np+1)*Ha->sweepTile;
+  }else{
+    //Rows of the x pass or of the y pass, whichever take more space
+    primSize=Hp->nvar*passSize(4);
+    qSize   =Hp->nvar*passSize(2);
+    flxSize =Hp->nvar*passSize(1);
+  }
+
+  q  =allocPass(primSize);
+  qr =allocPass(qSize);
+  ql =allocPass(qSize);
+  flx=allocPass(flxSize);
+}
+
+void freePasses(){
+  free(q  );
+  free(qr );
+  free(ql );
+  free(flx);
+}
+
 //Convert conserved to primitive for x pass
-void toPrimX(double *q, double *mesh){
+void toPrimX(real_t *restrict q, real_t *restrict mesh){
   int i;
   int xI, yI;
-  double r,vx,vy,eint,p;
-  double smallp;
+  real_t r,vx,vy,eint,p;
+  real_t smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
   for(i=0;i<Hp->ny*Hp->nx;i++){
@@ -92,19 +175,19 @@ void toPrimX(double *q, double *mesh){
     vy  =mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
     eint=mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARRHO)]=r;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARVX )]=vx;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARVY )]=vy;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARPR )]=p;
+    q[xI+2+ROW_LEN(Hp->nx+4)*(yI+Hp->ny*VARRHO)]=r;
+    q[xI+2+ROW_LEN(Hp->nx+4)*(yI+Hp->ny*VARVX )]=vx;
+    q[xI+2+ROW_LEN(Hp->nx+4)*(yI+Hp->ny*VARVY )]=vy;
+    q[xI+2+ROW_LEN(Hp->nx+4)*(yI+Hp->ny*VARPR )]=p;
   }
 }
 
 //Convert conserved to primitive for y pass
-void toPrimY(double *q, double *mesh){
+void toPrimY(real_t *restrict q, real_t *restrict mesh){
   int i;
   int xI, yI;
-  double r,vx,vy,eint,p;
-  double smallp;
+  real_t r,vx,vy,eint,p;
+  real_t smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
   for(i=0;i<Hp->ny*Hp->nx;i++){
@@ -115,15 +198,47 @@ void toPrimY(double *q, double *mesh){
     vy  =mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
     eint=mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVY )]=vx;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARPR )]=p;
+    q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
+    q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
+    q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARVY )]=vx;
+    q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARPR )]=p;
   }
 }
 
 //Set boundary conditions on pass variable
-void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
+//toPrimY over blocks of b by b cells, the mesh rows of a block are read
+//contiguously and the columns of q it writes stay in cache until the
+//block is done
+void toPrimYBlk(real_t *restrict q, real_t *restrict mesh, int b){
+  int x0, y0, xE, yE;
+  int xI, yI, mI;
+  real_t r,vx,vy,eint,p;
+  real_t smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  for(x0=0;x0<Hp->nx;x0+=b){
+    xE=(x0+b<Hp->nx)?x0+b:Hp->nx;
+    for(y0=0;y0<Hp->ny;y0+=b){
+      yE=(y0+b<Hp->ny)?y0+b:Hp->ny;
+      for(yI=y0;yI<yE;yI++){
+        for(xI=x0;xI<xE;xI++){
+          mI=xI+Hp->nx*yI;
+          r   =MAX(mesh[mI+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
+          vx  =mesh[mI+Hp->nx*Hp->ny*VARVX ]/r;
+          vy  =mesh[mI+Hp->nx*Hp->ny*VARVY ]/r;
+          eint=mesh[mI+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+          p   =MAX((Hp->gamma-1)*r*eint,smallp);
+          q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
+          q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
+          q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARVY )]=vx;
+          q[yI+2+ROW_LEN(Hp->ny+4)*(xI+Hp->nx*VARPR )]=p;
+        }
+      }
+    }
+  }
+}
+
+void setBndCnd(real_t *restrict q, int cndL, int cndH, int np, int nt){
   int i;
   int pI,tI;
   int wInd, rInd;
@@ -133,65 +248,65 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
   for(i=0;i<2*nt;i++){
     pI=i%2;
     tI=i/2;
-    wInd=pI+(np+4)*tI;
-    rInd=3-pI+(np+4)*tI;
+    wInd=pI+ROW_LEN(np+4)*tI;
+    rInd=3-pI+ROW_LEN(np+4)*tI;
     //printf("BND: %d refs %d\n",wInd,rInd);
     if(cndL==BND_REFL){
-      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
-      q[wInd+(np+4)*nt*VARVX ]=-q[rInd+(np+4)*nt*VARVX ];
-      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
-      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+      q[wInd+ROW_LEN(np+4)*nt*VARRHO]= q[rInd+ROW_LEN(np+4)*nt*VARRHO];
+      q[wInd+ROW_LEN(np+4)*nt*VARVX ]=-q[rInd+ROW_LEN(np+4)*nt*VARVX ];
+      q[wInd+ROW_LEN(np+4)*nt*VARVY ]= q[rInd+ROW_LEN(np+4)*nt*VARVY ];
+      q[wInd+ROW_LEN(np+4)*nt*VARPR ]= q[rInd+ROW_LEN(np+4)*nt*VARPR ];
     }else if(cndL==BND_PERM){
-      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
-      q[wInd+(np+4)*nt*VARVX ]= q[rInd+(np+4)*nt*VARVX ];
-      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
-      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+      q[wInd+ROW_LEN(np+4)*nt*VARRHO]= q[rInd+ROW_LEN(np+4)*nt*VARRHO];
+      q[wInd+ROW_LEN(np+4)*nt*VARVX ]= q[rInd+ROW_LEN(np+4)*nt*VARVX ];
+      q[wInd+ROW_LEN(np+4)*nt*VARVY ]= q[rInd+ROW_LEN(np+4)*nt*VARVY ];
+      q[wInd+ROW_LEN(np+4)*nt*VARPR ]= q[rInd+ROW_LEN(np+4)*nt*VARPR ];
     }
-    wInd=np+2+pI+(np+4)*tI;
-    rInd=np+1-pI+(np+4)*tI;
+    wInd=np+2+pI+ROW_LEN(np+4)*tI;
+    rInd=np+1-pI+ROW_LEN(np+4)*tI;
     //printf("BND: %d refs %d\n",wInd,rInd);
     if(cndH==BND_REFL){
-      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
-      q[wInd+(np+4)*nt*VARVX ]=-q[rInd+(np+4)*nt*VARVX ];
-      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
-      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+      q[wInd+ROW_LEN(np+4)*nt*VARRHO]= q[rInd+ROW_LEN(np+4)*nt*VARRHO];
+      q[wInd+ROW_LEN(np+4)*nt*VARVX ]=-q[rInd+ROW_LEN(np+4)*nt*VARVX ];
+      q[wInd+ROW_LEN(np+4)*nt*VARVY ]= q[rInd+ROW_LEN(np+4)*nt*VARVY ];
+      q[wInd+ROW_LEN(np+4)*nt*VARPR ]= q[rInd+ROW_LEN(np+4)*nt*VARPR ];
     }else if(cndH==BND_PERM){
-      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
-      q[wInd+(np+4)*nt*VARVX ]= q[rInd+(np+4)*nt*VARVX ];
-      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
-      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+      q[wInd+ROW_LEN(np+4)*nt*VARRHO]= q[rInd+ROW_LEN(np+4)*nt*VARRHO];
+      q[wInd+ROW_LEN(np+4)*nt*VARVX ]= q[rInd+ROW_LEN(np+4)*nt*VARVX ];
+      q[wInd+ROW_LEN(np+4)*nt*VARVY ]= q[rInd+ROW_LEN(np+4)*nt*VARVY ];
+      q[wInd+ROW_LEN(np+4)*nt*VARPR ]= q[rInd+ROW_LEN(np+4)*nt*VARPR ];
     }
   }
 }
 
 //Calculate ql and qr from q
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+void trace(real_t *restrict ql, real_t *restrict qr, real_t *restrict q, double dtdx, int np, int nt){
   int lI;
   int i,j;
-  double  r, u, v1, p, a;
-  double dr,du,dv1,dp,da;
-  double cc,csq;
-  double alpham,alphap,alphazr;
-  double spplus,spzerol,spzeror,spminus;
-  double ap,am,azr,azv1,acmp;
+  real_t  r, u, v1, p;
+  real_t dr,du,dv1,dp;
+  real_t cc,csq;
+  real_t alpham,alphap,alphazr;
+  real_t spplus,spzerol,spzeror,spminus;
+  real_t ap,am,azr,azv1;
 
   for(lI=0;lI<(np+2)*nt;lI++){
     i=lI%(np+2);
     j=lI/(np+2);
     //Get local state vars
-    r =q[i+1+(np+4)*(j+nt*VARRHO)];
-    u =q[i+1+(np+4)*(j+nt*VARVX )];
-    v1=q[i+1+(np+4)*(j+nt*VARVY )];
-    p =q[i+1+(np+4)*(j+nt*VARPR )];
+    r =q[i+1+ROW_LEN(np+4)*(j+nt*VARRHO)];
+    u =q[i+1+ROW_LEN(np+4)*(j+nt*VARVX )];
+    v1=q[i+1+ROW_LEN(np+4)*(j+nt*VARVY )];
+    p =q[i+1+ROW_LEN(np+4)*(j+nt*VARPR )];
     
     csq=Hp->gamma*p/r;
     cc=sqrt(csq);
     
     //Calculate slopes
-    dr =slope(q,i+1+(np+4)*(j+nt*VARRHO));
-    du =slope(q,i+1+(np+4)*(j+nt*VARVX ));
-    dv1=slope(q,i+1+(np+4)*(j+nt*VARVY ));
-    dp =slope(q,i+1+(np+4)*(j+nt*VARPR ));
+    dr =slope(q,i+1+ROW_LEN(np+4)*(j+nt*VARRHO));
+    du =slope(q,i+1+ROW_LEN(np+4)*(j+nt*VARVX ));
+    dv1=slope(q,i+1+ROW_LEN(np+4)*(j+nt*VARVY ));
+    dp =slope(q,i+1+ROW_LEN(np+4)*(j+nt*VARPR ));
     
     alpham = 0.5*(dp/(r*cc)-du)*r/cc;
     alphap = 0.5*(dp/(r*cc)+du)*r/cc;
@@ -205,10 +320,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
     am  =-0.5*spminus*alpham ;
     azr =-0.5*spzeror*alphazr;
     azv1=-0.5*spzeror*dv1;
-    qr[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    qr[i+(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
-    qr[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    qr[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
+    qr[i+ROW_LEN(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
+    qr[i+ROW_LEN(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
+    qr[i+ROW_LEN(np+2)*(j+nt*VARVY )]=v1+(azv1     );
+    qr[i+ROW_LEN(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
     
     //left
     spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
@@ -218,18 +333,18 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
     am  =-0.5*spminus*alpham ;
     azr =-0.5*spzerol*alphazr;
     azv1=-0.5*spzerol*dv1;
-    ql[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    ql[i+(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
-    ql[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    ql[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
+    ql[i+ROW_LEN(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
+    ql[i+ROW_LEN(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
+    ql[i+ROW_LEN(np+2)*(j+nt*VARVY )]=v1+(azv1     );
+    ql[i+ROW_LEN(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
   }
 }
 
 //Approximates slope at a given point in the mesh
 // Uses the consistent structure of the pass state
 // arrays to limit to single index requirement
-double slope(double *q,int ind){
-  double dlft, drgt, dcen, dsgn, dlim;
+real_t slope(real_t *q,int ind){
+  real_t dlft, drgt, dcen, dsgn, dlim;
   dlft=q[ind  ]-q[ind-1];
   drgt=q[ind+1]-q[ind  ];
   dcen=0.5*(dlft+drgt);
@@ -242,38 +357,192 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+//Riemann solver working on RIEMANN_VLEN interfaces at once
+//Every step is a loop over the lanes without data dependent branches so
+//the compiler can vectorize it (sqrt needs -fno-math-errno). With fixed
+//set, every interface runs all niter_riemann newton iterations, otherwise
+//converged lanes are masked out and the iterations stop once every lane
+//has converged, giving the same result as riemann
+void riemannVec(real_t *restrict flx, real_t *restrict qxm, real_t *restrict qxp, int np, int nt, int fixed){
+  int lI, l, n, nLane, nActive;
+  int iL[RIEMANN_VLEN], jL[RIEMANN_VLEN];
+  long active[RIEMANN_VLEN], keep, shk;
+  acc_t smallp, smallpp;
+  acc_t gmma6, entho, gamma, smallr, smallc;
+  acc_t qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
+  acc_t rl[RIEMANN_VLEN],vxl[RIEMANN_VLEN],vyl[RIEMANN_VLEN],pl[RIEMANN_VLEN];
+  acc_t rr[RIEMANN_VLEN],vxr[RIEMANN_VLEN],vyr[RIEMANN_VLEN],pr[RIEMANN_VLEN];
+  acc_t cl[RIEMANN_VLEN],cr[RIEMANN_VLEN],px[RIEMANN_VLEN];
+  acc_t wl,wr,ql,qr,vsl,vsr,delp,pxn;
+  acc_t ro,vxo,po,wo,co;
+  acc_t rx,vxx,cx;
+  acc_t sgnm, scr, frac;
+  acc_t spout,spin,ushk;
+  acc_t ekin,etot;
+  acc_t out[4][RIEMANN_VLEN];
+
+  gamma=Hp->gamma;
+  smallr=Ha->smallr;
+  smallc=Ha->smallc;
+  smallp=smallc*smallc/gamma;
+  smallpp=smallr*smallp;
+  gmma6=(gamma+1.0)/(2.0*gamma);
+  entho=1.0/(gamma-1.0);
+  keep=fixed?1:0;
+  for(lI=0;lI<(np+1)*nt;lI+=RIEMANN_VLEN){
+    nLane=MIN(RIEMANN_VLEN,(np+1)*nt-lI);
+
+    //Gather the interfaces, unused lanes repeat the first one
+    for(l=0;l<RIEMANN_VLEN;l++){
+      iL[l]=(lI+(l<nLane?l:0))%(np+1);
+      jL[l]=(lI+(l<nLane?l:0))/(np+1);
+      rl[l] =qxm[iL[l]  +ROW_LEN(np+2)*(jL[l]+nt*VARRHO)];
+      vxl[l]=qxm[iL[l]  +ROW_LEN(np+2)*(jL[l]+nt*VARVX )];
+      vyl[l]=qxm[iL[l]  +ROW_LEN(np+2)*(jL[l]+nt*VARVY )];
+      pl[l] =qxm[iL[l]  +ROW_LEN(np+2)*(jL[l]+nt*VARPR )];
+
+      rr[l] =qxp[iL[l]+1+ROW_LEN(np+2)*(jL[l]+nt*VARRHO)];
+      vxr[l]=qxp[iL[l]+1+ROW_LEN(np+2)*(jL[l]+nt*VARVX )];
+      vyr[l]=qxp[iL[l]+1+ROW_LEN(np+2)*(jL[l]+nt*VARVY )];
+      pr[l] =qxp[iL[l]+1+ROW_LEN(np+2)*(jL[l]+nt*VARPR )];
+    }
+
+    for(l=0;l<RIEMANN_VLEN;l++){
+      rl[l]=MAX(rl[l],smallr);
+      pl[l]=MAX(pl[l],rl[l]*smallp);
+      rr[l]=MAX(rr[l],smallr);
+      pr[l]=MAX(pr[l],rr[l]*smallp);
+      cl[l]=gamma*pl[l]*rl[l];
+      cr[l]=gamma*pr[l]*rr[l];
+      wl=sqrt(cl[l]);
+      wr=sqrt(cr[l]);
+      pxn=((wr*pl[l]+wl*pr[l])+wl*wr*(vxl[l]-vxr[l]))/(wl+wr);
+      px[l]=MAX(pxn,0.0);
+      active[l]=1;
+    }
+
+    //Newton raphson iterations, converged lanes keep their pressure
+    for(n=0;n<Ha->niter_riemann;n++){
+      nActive=0;
+      for(l=0;l<RIEMANN_VLEN;l++){
+        wl=sqrt(cl[l]*(1.0+gmma6*(px[l]-pl[l])/pl[l]));
+        wr=sqrt(cr[l]*(1.0+gmma6*(px[l]-pr[l])/pr[l]));
+        ql=2.0*wl*wl*wl/(wl*wl+cl[l]);
+        qr=2.0*wr*wr*wr/(wr*wr+cr[l]);
+        vsl=vxl[l]-(px[l]-pl[l])/wl;
+        vsr=vxr[l]+(px[l]-pr[l])/wr;
+        delp=qr*ql/(qr+ql)*(vsl-vsr);
+        delp=MAX(delp,-px[l]+smallp);
+        pxn=px[l]+delp;
+        px[l]=active[l]?pxn:px[l];
+        active[l]&=keep|!(fabs(delp/(pxn+smallpp))<1.0e-6);
+        nActive+=active[l];
+      }
+      if(nActive==0)break;
+    }
+
+    for(l=0;l<RIEMANN_VLEN;l++){
+      wl=sqrt(cl[l]*(1.0+gmma6*(px[l]-pl[l])/pl[l]));
+      wr=sqrt(cr[l]*(1.0+gmma6*(px[l]-pr[l])/pr[l]));
+      ql=2.0*wl*wl*wl/(wl*wl+cl[l]);
+      qr=2.0*wr*wr*wr/(wr*wr+cr[l]);
+      vxx=((vxl[l]-(px[l]-pl[l])/wl)*ql+
+           (vxr[l]+(px[l]-pr[l])/wr)*qr)/(ql+qr);
+      sgnm   =(vxx>=0.0)?  1.0 :   -1.0;
+      ro     =(vxx>=0.0)? rl[l]: rr[l];
+      vxo    =(vxx>=0.0)?vxl[l]:vxr[l];
+      po     =(vxx>=0.0)? pl[l]: pr[l];
+      wo     =(vxx>=0.0)?    wl:    wr;
+      qgdnvVY=(vxx>=0.0)?vyl[l]:vyr[l];
+      co=sqrt(fabs(gamma*po/ro));
+      co=MAX(smallc,co);
+
+      rx=ro/(1.0+ro*(po-px[l])/(wo*wo));
+      rx=MAX(smallr,rx);
+
+      cx=sqrt(fabs(gamma*px[l]/rx));
+      cx=MAX(smallc,cx);
+
+      spout=co   -sgnm*vxo;
+      spin =cx   -sgnm*vxx;
+      ushk =wo/ro-sgnm*vxo;
+
+      shk  =spout<spin;
+      spin =shk?ushk:spin;
+      spout=shk?ushk:spout;
+
+      scr=spout-spin;
+      frac=smallc+fabs(spout+spin);
+      scr=MAX(scr,frac);
+
+      frac=0.5*(1.0+(spout+spin)/scr);
+      frac=MIN(1.0,frac);
+      frac=MAX(0.0,frac);
+      qgdnvR =frac*    rx+(1.0-frac)* ro;
+      qgdnvVX=frac*   vxx+(1.0-frac)*vxo;
+      qgdnvP =frac* px[l]+(1.0-frac)* po;
+      qgdnvR =(spout<0.0)? ro:qgdnvR;
+      qgdnvVX=(spout<0.0)?vxo:qgdnvVX;
+      qgdnvP =(spout<0.0)? po:qgdnvP;
+      qgdnvR =(spin>0.0)?   rx:qgdnvR;
+      qgdnvVX=(spin>0.0)?  vxx:qgdnvVX;
+      qgdnvP =(spin>0.0)?px[l]:qgdnvP;
+
+      //Calculate fluxes
+      out[VARRHO][l]=qgdnvR*qgdnvVX;
+      out[VARVX ][l]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+      out[VARVY ][l]=qgdnvR*qgdnvVX*qgdnvVY;
+      ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
+      etot=qgdnvP*entho+ekin;
+      out[VARPR ][l]=qgdnvVX*(etot+qgdnvP);
+    }
+
+    //Scatter the used lanes
+    for(l=0;l<nLane;l++){
+      flx[iL[l]+ROW_LEN(np+1)*(jL[l]+nt*VARRHO)]=out[VARRHO][l];
+      flx[iL[l]+ROW_LEN(np+1)*(jL[l]+nt*VARVX )]=out[VARVX ][l];
+      flx[iL[l]+ROW_LEN(np+1)*(jL[l]+nt*VARVY )]=out[VARVY ][l];
+      flx[iL[l]+ROW_LEN(np+1)*(jL[l]+nt*VARPR )]=out[VARPR ][l];
+    }
+  }
+}
+
+void riemann(real_t *restrict flx, real_t *restrict qxm, real_t *restrict qxp, int np, int nt){
   int lI, i,j,n;
-  double smallp, smallpp;
-  double gmma6, gra, entho;
-  double qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
-  double rl,vxl,vyl,pl,cl,wl,ql,vsl;
-  double rr,vxr,vyr,pr,cr,wr,qr,vsr;
-  double ro,vxo,po,wo,co;
-  double rx,vxx,px,wx,cx;
-  double sgnm, scr, frac;
-  double spout,spin,ushk;
-  double ekin,etot,delp;
+  acc_t smallp, smallpp;
+  acc_t gmma6, entho;
+  acc_t qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
+  acc_t rl,vxl,vyl,pl,cl,wl,ql,vsl;
+  acc_t rr,vxr,vyr,pr,cr,wr,qr,vsr;
+  acc_t ro,vxo,po,wo,co;
+  acc_t rx,vxx,px,cx;
+  acc_t sgnm, scr, frac;
+  acc_t spout,spin,ushk;
+  acc_t ekin,etot,delp;
+
+  if(Ha->riemannMode!=RIEMANN_SCALAR){
+    riemannVec(flx,qxm,qxp,np,nt,Ha->riemannMode==RIEMANN_FIXED);
+    return;
+  }
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
   smallpp=Ha->smallr*smallp;
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
-  gra=(Hp->gamma-1.0)/(1.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
   for(lI=0;lI<(np+1)*nt;lI++){
     i=lI%(np+1);
     j=lI/(np+1);
     
     //Get state vars on either side of interface
-    rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],Ha->smallr);
-    vxl=    qxm[i  +(np+2)*(j+nt*VARVX )];
-    vyl=    qxm[i  +(np+2)*(j+nt*VARVY )];
-    pl =MAX(qxm[i  +(np+2)*(j+nt*VARPR )],rl*smallp);
-
-    rr =MAX(qxp[i+1+(np+2)*(j+nt*VARRHO)],Ha->smallr);
-    vxr=    qxp[i+1+(np+2)*(j+nt*VARVX )];
-    vyr=    qxp[i+1+(np+2)*(j+nt*VARVY )];
-    pr =MAX(qxp[i+1+(np+2)*(j+nt*VARPR )],rr*smallp);
+    rl =MAX(qxm[i  +ROW_LEN(np+2)*(j+nt*VARRHO)],Ha->smallr);
+    vxl=    qxm[i  +ROW_LEN(np+2)*(j+nt*VARVX )];
+    vyl=    qxm[i  +ROW_LEN(np+2)*(j+nt*VARVY )];
+    pl =MAX(qxm[i  +ROW_LEN(np+2)*(j+nt*VARPR )],rl*smallp);
+
+    rr =MAX(qxp[i+1+ROW_LEN(np+2)*(j+nt*VARRHO)],Ha->smallr);
+    vxr=    qxp[i+1+ROW_LEN(np+2)*(j+nt*VARVX )];
+    vyr=    qxp[i+1+ROW_LEN(np+2)*(j+nt*VARVY )];
+    pr =MAX(qxp[i+1+ROW_LEN(np+2)*(j+nt*VARPR )],rr*smallp);
     
     cl=Hp->gamma*pl*rl;
     cr=Hp->gamma*pr*rr;
@@ -352,56 +621,99 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
     }
 
     //Calculate fluxes
-    flx[i+(np+1)*(j+nt*VARRHO)]=qgdnvR*qgdnvVX;
-    flx[i+(np+1)*(j+nt*VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
-    flx[i+(np+1)*(j+nt*VARVY )]=qgdnvR*qgdnvVX*qgdnvVY;
+    flx[i+ROW_LEN(np+1)*(j+nt*VARRHO)]=qgdnvR*qgdnvVX;
+    flx[i+ROW_LEN(np+1)*(j+nt*VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+    flx[i+ROW_LEN(np+1)*(j+nt*VARVY )]=qgdnvR*qgdnvVX*qgdnvVY;
     ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
     etot=qgdnvP*entho+ekin;
-    flx[i+(np+1)*(j+nt*VARPR )]=qgdnvVX*(etot+qgdnvP);
+    flx[i+ROW_LEN(np+1)*(j+nt*VARPR )]=qgdnvVX*(etot+qgdnvP);
   }
 }
 
 //Add flux from x pass to conserved state vars
-void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxX(real_t *restrict mesh, real_t *restrict flx, double dtdx, int np, int nt, real_t *den){
   int lI, i, j;
+  real_t d;
 
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
-    mesh[i+np*(j+nt*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-				    flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[i+np*(j+nt*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-				    flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[i+np*(j+nt*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-				    flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[i+np*(j+nt*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+    mesh[i+np*(j+nt*VARRHO)]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARRHO)]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARRHO)]);
+    mesh[i+np*(j+nt*VARVX )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVX )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARVX )]);
+    mesh[i+np*(j+nt*VARVY )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVY )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARVY )]);
+    mesh[i+np*(j+nt*VARPR )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARPR )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARPR )]);
+    //Denominator of the updated cell for the next dt
+    if(den){
+      d=cellDenom(mesh,i+np*j);
+      if(*den<d)*den=d;
+    }
   }
 }
 
 //Add flux from y pass to conserved state vars
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxY(real_t *restrict mesh, real_t *restrict flx, double dtdx, int np, int nt, real_t *den){
   int lI, i, j;
+  real_t d;
 
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
-    mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-				    flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[j+nt*(i+np*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-				    flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[j+nt*(i+np*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-				    flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+    mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARRHO)]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARRHO)]);
+    mesh[j+nt*(i+np*VARVX )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVY )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARVY )]);
+    mesh[j+nt*(i+np*VARVY )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVX )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARVX )]);
+    mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARPR )]-
+				    flx[i+1+ROW_LEN(np+1)*(j+nt*VARPR )]);
+    //Denominator of the updated cell for the next dt
+    if(den){
+      d=cellDenom(mesh,j+nt*i);
+      if(*den<d)*den=d;
+    }
   }
 }
 
 //Utility function to sum a state variable over the entire mesh
-double sumArray(double *mesh, int var, int nx, int ny){
+//addFluxY over blocks of b by b cells, the transpose of toPrimYBlk
+void addFluxYBlk(real_t *restrict mesh, real_t *restrict flx, double dtdx, int np, int nt, int b, real_t *den){
+  int i0, j0, iE, jE;
+  int i, j;
+  real_t d;
+
+  for(j0=0;j0<nt;j0+=b){
+    jE=(j0+b<nt)?j0+b:nt;
+    for(i0=0;i0<np;i0+=b){
+      iE=(i0+b<np)?i0+b:np;
+      for(i=i0;i<iE;i++){
+        for(j=j0;j<jE;j++){
+          mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARRHO)]-
+                                          flx[i+1+ROW_LEN(np+1)*(j+nt*VARRHO)]);
+          mesh[j+nt*(i+np*VARVX )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVY )]-
+                                          flx[i+1+ROW_LEN(np+1)*(j+nt*VARVY )]);
+          mesh[j+nt*(i+np*VARVY )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARVX )]-
+                                          flx[i+1+ROW_LEN(np+1)*(j+nt*VARVX )]);
+          mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARPR )]-
+                                          flx[i+1+ROW_LEN(np+1)*(j+nt*VARPR )]);
+          //Denominator of the updated cell for the next dt
+          if(den){
+            d=cellDenom(mesh,j+nt*i);
+            if(*den<d)*den=d;
+          }
+        }
+      }
+    }
+  }
+}
+
+double sumArray(real_t *mesh, int var, int nx, int ny){
   int i;
-  double sum, corr;
-  double nsum, c_nxt;
+  acc_t sum, corr;
+  acc_t nsum, c_nxt;
 
   sum=0.0;
   corr=0.0;
@@ -415,12 +727,141 @@ double sumArray(double *mesh, int var, int nx, int ny){
   return sum+corr;
 }
 
+//Convert conserved to primitive for a tile of nt pencils starting at
+//pencil t0, same layout as toPrimX/toPrimY with the tile as the mesh
+void toPrimTile(real_t *restrict q, real_t *restrict mesh, int t0, int nt, int dir){
+  int i,j;
+  int mI;
+  int np;
+  real_t r,vx,vy,eint,p;
+  real_t smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  if(dir==0){
+    np=Hp->nx;
+  }else{
+    np=Hp->ny;
+  }
+  //Walk the mesh in memory order, rows for x, tile width for y
+  for(i=0;i<np*nt;i++){
+    if(dir==0){
+      j=i/np;
+      mI=i%np+Hp->nx*(t0+j);
+    }else{
+      j=i%nt;
+      mI=t0+j+Hp->nx*(i/nt);
+    }
+    r   =MAX(mesh[mI+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
+    vx  =mesh[mI+Hp->nx*Hp->ny*VARVX ]/r;
+    vy  =mesh[mI+Hp->nx*Hp->ny*VARVY ]/r;
+    eint=mesh[mI+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+    p   =MAX((Hp->gamma-1)*r*eint,smallp);
+    if(dir==0){
+      q[i%np+2+ROW_LEN(np+4)*(j+nt*VARRHO)]=r;
+      q[i%np+2+ROW_LEN(np+4)*(j+nt*VARVX )]=vx;
+      q[i%np+2+ROW_LEN(np+4)*(j+nt*VARVY )]=vy;
+      q[i%np+2+ROW_LEN(np+4)*(j+nt*VARPR )]=p;
+    }else{
+      q[i/nt+2+ROW_LEN(np+4)*(j+nt*VARRHO)]=r;
+      q[i/nt+2+ROW_LEN(np+4)*(j+nt*VARVX )]=vy;
+      q[i/nt+2+ROW_LEN(np+4)*(j+nt*VARVY )]=vx;
+      q[i/nt+2+ROW_LEN(np+4)*(j+nt*VARPR )]=p;
+    }
+  }
+}
+
+//Add flux of a tile of nt pencils starting at pencil t0 to conserved
+//state vars, same as addFluxX/addFluxY
+void addFluxTile(real_t *restrict mesh, real_t *restrict flx, double dtdx, int t0, int nt, int dir, real_t *den){
+  int lI, i, j;
+  int np, mI;
+  int fN, fT;
+  real_t d;
+
+  //Normal and tangential momentum fluxes swap places in the y pass
+  if(dir==0){
+    np=Hp->nx;
+    fN=VARVX;
+    fT=VARVY;
+  }else{
+    np=Hp->ny;
+    fN=VARVY;
+    fT=VARVX;
+  }
+  for(lI=0;lI<np*nt;lI++){
+    if(dir==0){
+      i=lI%np;
+      j=lI/np;
+    }else{
+      i=lI/nt;
+      j=lI%nt;
+    }
+    mI=(dir==0)?i+Hp->nx*(t0+j):t0+j+Hp->nx*i;
+    mesh[mI+Hp->nx*Hp->ny*VARRHO]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARRHO)]-
+                                         flx[i+1+ROW_LEN(np+1)*(j+nt*VARRHO)]);
+    mesh[mI+Hp->nx*Hp->ny*VARVX ]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*fN    )]-
+                                         flx[i+1+ROW_LEN(np+1)*(j+nt*fN    )]);
+    mesh[mI+Hp->nx*Hp->ny*VARVY ]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*fT    )]-
+                                         flx[i+1+ROW_LEN(np+1)*(j+nt*fT    )]);
+    mesh[mI+Hp->nx*Hp->ny*VARPR ]+=dtdx*(flx[i  +ROW_LEN(np+1)*(j+nt*VARPR )]-
+                                         flx[i+1+ROW_LEN(np+1)*(j+nt*VARPR )]);
+    //Denominator of the updated cell for the next dt
+    if(den){
+      d=cellDenom(mesh,mI);
+      if(*den<d)*den=d;
+    }
+  }
+}
+
+//Runs a pass of either dim one tile of Ha->sweepTile pencils at a time
+//q, ql, qr and flx only hold one tile so they stay in cache
+void runPassFused(real_t *mesh, double dt, int dir, real_t *den){
+  int bndL,bndH;
+  int np,nt;
+  int t0,nTile;
+  double dxp;
+
+  if(dir==0){
+    np=Hp->nx;
+    nt=Hp->ny;
+    bndL=Hp->bndL;
+    bndH=Hp->bndR;
+    dxp=Hp->dx;
+  }else{
+    np=Hp->ny;
+    nt=Hp->nx;
+    bndL=Hp->bndU;
+    bndH=Hp->bndD;
+    dxp=Hp->dy;
+  }
+  for(t0=0;t0<nt;t0+=Ha->sweepTile){
+    nTile=MIN(Ha->sweepTile,nt-t0);
+    STAGE(ST_PRIM,toPrimTile(q,mesh,t0,nTile,dir));
+    STAGE(ST_BND,setBndCnd(q,bndL,bndH,np,nTile));
+    STAGE(ST_TRACE,trace(ql,qr,q,dt/dxp,np,nTile));
+    STAGE(ST_RIEM,riemann(flx,ql,qr,np,nTile));
+    STAGE(ST_FLUX,addFluxTile(mesh,flx,dt/dxp,t0,nTile,dir,den));
+  }
+}
+
 //Convenience fuction to run pass of either dim
-void runPass(double *mesh, double dt, int n, int dir){
+void runPass(real_t *mesh, double dt, int n, int dir){
   int bndL,bndH;
   int np,nt;
   double dxp,dxt;
   char dirCh, outfile[30];
+  real_t *den;
+
+  //The second pass of the step reduces the denominator for the next one
+  den=NULL;
+  if(Ha->fusedDT&&dir==1-n%2){
+    stepDen=Ha->smallc;
+    den=&stepDen;
+  }
+  if(Ha->sweepTile>0){
+    runPassFused(mesh,dt,dir,den);
+    return;
+  }
 
   //Set relevant reference values for direction
   if(dir==0){
@@ -432,7 +873,7 @@ void runPass(double *mesh, double dt, int n, int dir){
     dxp=Hp->dx;
     dxt=Hp->dy;
     dirCh='x';
-    toPrimX(q,mesh);
+    STAGE(ST_PRIM,toPrimX(q,mesh));
   }else{
     //y-dir
     np=Hp->ny;
@@ -442,21 +883,180 @@ void runPass(double *mesh, double dt, int n, int dir){
     dxp=Hp->dy;
     dxt=Hp->dx;
     dirCh='y';
-    toPrimY(q,mesh);
+    if(Ha->yBlock>0){
+      STAGE(ST_PRIM,toPrimYBlk(q,mesh,Ha->yBlock));
+    }else{
+      STAGE(ST_PRIM,toPrimY(q,mesh));
+    }
   }
-  setBndCnd(q,bndL,bndH,np,nt);
-  trace(ql,qr,q,dt/dxp,np,nt);
-  riemann(flx,ql,qr,np,nt);
+  STAGE(ST_BND,setBndCnd(q,bndL,bndH,np,nt));
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dxp,np,nt));
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt));
   //Add calculated flux to state var array
   if(dir==0){
-    addFluxX(mesh,flx,dt/dxp,np,nt);
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dxp,np,nt,den));
+  }else if(Ha->yBlock>0){
+    STAGE(ST_FLUX,addFluxYBlk(mesh,flx,dt/dxp,np,nt,Ha->yBlock,den));
   }else{
-    addFluxY(mesh,flx,dt/dxp,np,nt);
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dxp,np,nt,den));
+  }
+}
+
+//Writes the mesh to the vis file name, a single precision mesh is
+//converted in the staging buffer of the writer
+void writeMesh(char *name, real_t *mesh){
+#if !VIS_DUMPS
+  return;
+#elif PRECISION==PREC_DOUBLE
+  writeVisAsync(name,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+#else
+  size_t i, size;
+  double *buf;
+
+  size=(size_t)Hp->nvar*Hp->nx*Hp->ny;
+  buf=visStage(size);
+  for(i=0;i<size;i++){
+    buf[i]=mesh[i];
   }
+  visSubmit(name,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+#endif
+}
+
+//Appends the in-situ record of step n to ins, three lines:
+//TOT,n,t,TM,TE,rhoMin,rhoMax
+//PRF,n,t and the density along the centerline of the longer dim, row
+//ny/2 or column nx/2
+//HST,n,t and the cells in each of INSITU_BINS bins of the density
+//between rhoMin and rhoMax
+void writeInsitu(FILE *ins, real_t *mesh, int n, double cTime){
+  int i, b;
+  int nc=Hp->nx*Hp->ny;
+  int hist[INSITU_BINS];
+  double lo, hi, scale;
+
+  lo=mesh[nc*VARRHO];
+  hi=lo;
+  for(i=1;i<nc;i++){
+    if(mesh[i+nc*VARRHO]<lo)lo=mesh[i+nc*VARRHO];
+    if(mesh[i+nc*VARRHO]>hi)hi=mesh[i+nc*VARRHO];
+  }
+  scale=(hi>lo)?INSITU_BINS/(hi-lo):0.0;
+  for(b=0;b<INSITU_BINS;b++){
+    hist[b]=0;
+  }
+  for(i=0;i<nc;i++){
+    b=(int)((mesh[i+nc*VARRHO]-lo)*scale);
+    hist[MIN(b,INSITU_BINS-1)]++;
+  }
+
+  fprintf(ins,"TOT,%d,%.9g,%.17g,%.17g,%.9g,%.9g\n",n,cTime,
+          Hp->dx*Hp->dy*sumArray(mesh,VARRHO,Hp->nx,Hp->ny),
+          Hp->dx*Hp->dy*sumArray(mesh,VARPR ,Hp->nx,Hp->ny),lo,hi);
+  fprintf(ins,"PRF,%d,%.9g",n,cTime);
+  if(Hp->nx>=Hp->ny){
+    for(i=0;i<Hp->nx;i++){
+      fprintf(ins,",%.9g",(double)mesh[i+Hp->nx*(Hp->ny/2)+nc*VARRHO]);
+    }
+  }else{
+    for(i=0;i<Hp->ny;i++){
+      fprintf(ins,",%.9g",(double)mesh[Hp->nx/2+Hp->nx*i+nc*VARRHO]);
+    }
+  }
+  fprintf(ins,"\nHST,%d,%.9g",n,cTime);
+  for(b=0;b<INSITU_BINS;b++){
+    fprintf(ins,",%d",hist[b]);
+  }
+  fprintf(ins,"\n");
+}
+
+//Writes the mesh after step n to <outPre>.chk with the header needed to
+//resume from it, through a temporary file so an interrupted write leaves
+//the previous checkpoint intact
+void writeCheckpoint(real_t *mesh, int n, double cTime, double nxttout){
+  char name[PREFIX_LEN+8], tmp[PREFIX_LEN+12];
+  union{hydro_chk chk; char pad[CHK_HDR_LEN];} hdr;
+  hydro_chk *chk;
+  size_t size;
+  FILE *fp;
+
+  memset(&hdr,0,CHK_HDR_LEN);
+  chk=&hdr.chk;
+  strcpy(chk->magic,CHK_MAGIC);
+  chk->hdrSize=CHK_HDR_LEN;
+  chk->elSize=sizeof(real_t);
+  chk->prob=*Hp;
+  chk->prob.t=cTime;
+  chk->args=*Ha;
+  chk->args.nstart=n;
+  chk->args.nxtstart=nxttout;
+
+  snprintf(name,sizeof(name),"%s.chk",Ha->outPre);
+  snprintf(tmp,sizeof(tmp),"%s.tmp",name);
+  fp=fopen(tmp,"wb");
+  if(fp==NULL){
+    fprintf(stderr,"Could not open file %s\n",tmp);
+    return;
+  }
+  size=(size_t)Hp->nvar*Hp->nx*Hp->ny;
+  if(fwrite(&hdr,1,CHK_HDR_LEN,fp)!=CHK_HDR_LEN||fwrite(mesh,sizeof(real_t),size,fp)!=size){
+    fprintf(stderr,"Could not write checkpoint %s\n",tmp);
+    fclose(fp);
+    return;
+  }
+  fclose(fp);
+  rename(tmp,name);
+  printf("Checkpoint @ time %f iter %d\n",cTime,n);
+}
+
+//Maps the checkpoint fname and fills Hyp and Hya from its header, the
+//returned mesh is a private mapping so the run does not touch the file
+real_t *readCheckpoint(char *fname, hydro_prob *Hyp, hydro_args *Hya){
+  hydro_chk chk;
+  struct stat st;
+  size_t size;
+  void *base;
+  int fd;
+
+  fd=open(fname,O_RDONLY);
+  if(fd<0){
+    fprintf(stderr,"Could not open file %s\n",fname);
+    return NULL;
+  }
+  if(read(fd,&chk,sizeof(chk))!=sizeof(chk)||strcmp(chk.magic,CHK_MAGIC)||
+     chk.hdrSize!=CHK_HDR_LEN||chk.elSize!=sizeof(real_t)){
+    fprintf(stderr,"%s is not a checkpoint of this build\n",fname);
+    close(fd);
+    return NULL;
+  }
+  size=CHK_HDR_LEN+(size_t)chk.prob.nvar*chk.prob.nx*chk.prob.ny*sizeof(real_t);
+  if(fstat(fd,&st)||(size_t)st.st_size<size){
+    fprintf(stderr,"Checkpoint %s is truncated\n",fname);
+    close(fd);
+    return NULL;
+  }
+  base=mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(base==MAP_FAILED){
+    fprintf(stderr,"Could not map checkpoint %s\n",fname);
+    return NULL;
+  }
+
+  *Hyp=chk.prob;
+  *Hya=chk.args;
+  snprintf(Hya->initFile,INIT_FN_LEN,"%s",fname);
+  return (real_t*)((char*)base+CHK_HDR_LEN);
+}
+
+//Unmaps a mesh returned by readCheckpoint
+void closeCheckpoint(real_t *mesh, hydro_prob *Hyp){
+  size_t size;
+
+  size=CHK_HDR_LEN+(size_t)Hyp->nvar*Hyp->nx*Hyp->ny*sizeof(real_t);
+  munmap((char*)mesh-CHK_HDR_LEN,size);
 }
 
 //Comptutational engine function to handle run
-void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+void engine(real_t *mesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, i,j;
   int bndL;
   int bndH;
@@ -470,44 +1070,39 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   double M_prec, E_prec;
 
   char outfile[30];
-
-  size_t primSize, qSize, flxSize;
+  char insName[PREFIX_LEN+8];
+  FILE *ins;
 
   double initT, endT;
+  double outT;
+  int rOut;
 
   Hp=Hyp;
   Ha=Hya;
+  cody_init("MISH");
+  rOut=cody_region("out");
 
-  n=0;
-  cTime=0;
+  //A restart resumes the step count and clock of the checkpoint
+  n=Ha->nstart;
+  cTime=Hp->t;
   nxttout=-1.0;
 
-  //Get state var sizes for allocation
-  if(Hp->ny>=Hp->nx){
-    primSize=Hp->nvar*(Hp->nx+4)*Hp->ny;
-    qSize   =Hp->nvar*(Hp->nx+2)*Hp->ny;
-    flxSize =Hp->nvar*(Hp->nx+1)*Hp->ny;
-  }else{
-    primSize=Hp->nvar*(Hp->ny+4)*Hp->nx;
-    qSize   =Hp->nvar*(Hp->ny+2)*Hp->nx;
-    flxSize =Hp->nvar*(Hp->ny+1)*Hp->nx;
-  }
-
   //If no end condition provided, end without running
   if(Ha->nstepmax<0&&Ha->tend<0.0)return;
 
   //Allocate state vars
-  q  =(double*)malloc(primSize*sizeof(double));
-  qr =(double*)malloc(qSize*sizeof(double));
-  ql =(double*)malloc(qSize*sizeof(double));
-  flx=(double*)malloc(flxSize*sizeof(double));
+  allocPasses();
 
   //Set initial value of next time to aim to hit exactly
-  if(Ha->tend>0.0){
-    nxttout=Ha->tend;
-  }
-  if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
-    nxttout=Ha->dtoutput;
+  if(Ha->nstart>0){
+    nxttout=Ha->nxtstart;
+  }else{
+    if(Ha->tend>0.0){
+      nxttout=Ha->tend;
+    }
+    if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
+      nxttout=Ha->dtoutput;
+    }
   }
 
   //Setup conservation check vars
@@ -524,17 +1119,37 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   printf("TM:%g+-%g TE:%g+-%g\n",volCell*oTM,volCell*M_prec,volCell*oTE,volCell*E_prec);
 #endif
 
-  //Print initial condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  //Print initial condition, a restart already wrote its vis files
+  if(Ha->nstart==0){
+    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+    writeMesh(outfile,mesh);
+  }
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
+
+  //In-situ records, a restart appends to those of the original run
+  ins=NULL;
+  if(Ha->ninsitu>0){
+    snprintf(insName,sizeof(insName),"%s.ins",Ha->outPre);
+    ins=fopen(insName,(Ha->nstart>0)?"a":"w");
+    if(ins==NULL){
+      printf("Could not open %s\n",insName);
+    }else if(Ha->nstart==0){
+      writeInsitu(ins,mesh,n,cTime);
+    }
+  }
   
-  //Initialize timer
+  //Initialize timer, the output is timed as region out
   initT=getNow();
+  outT=cody_region_secs(rOut);
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-    //Calculate timestep
-    dt=Ha->sigma*calcDT(mesh);
+    //Calculate timestep, after the first step the fused mode already has
+    //the denominator from the last pass
+    if(Ha->fusedDT&&n>Ha->nstart){
+      dt=Ha->sigma*(0.5/stepDen);
+    }else{
+      STAGE(ST_DT,dt=Ha->sigma*calcDT(mesh));
+    }
     if(nxttout>0.0&&dt>(nxttout-cTime)){
       printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
@@ -574,25 +1189,48 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//printf("Next Vis Time: %f\n",nxttout);
       }
+      cody_region_begin(rOut);
       snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-      writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+      STAGE(ST_VIS,writeMesh(outfile,mesh));
+      cody_region_end(rOut);
+    }
+    if(Ha->nchkpt>0&&n%Ha->nchkpt==0){
+      cody_region_begin(rOut);
+      writeCheckpoint(mesh,n,cTime,nxttout);
+      cody_region_end(rOut);
+    }
+    if(ins!=NULL&&n%Ha->ninsitu==0){
+      cody_region_begin(rOut);
+      writeInsitu(ins,mesh,n,cTime);
+      cody_region_end(rOut);
     }
   }
+  //The last step always gets a record
+  if(ins!=NULL){
+    if(n%Ha->ninsitu!=0)writeInsitu(ins,mesh,n,cTime);
+    fclose(ins);
+  }
   printf("time: %f, %d iters run\n",cTime,n);
 
   endT=getNow();
+  outT=cody_region_secs(rOut)-outT;
 
   //Print timing information in manner easily extracted to process as csv
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"C\"","\"CPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,endT-initT);
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"C\"","\"CPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,endT-initT,endT-initT-outT,outT);
+#if STAGE_TIMERS
+  printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+  printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"C\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
+#endif
+  //The same run in the rows of every mini-app, the steps of this run only
+  cody_report("hydro_c",1,1,(double)Hp->nx*Hp->ny,n-Ha->nstart,endT-initT);
+  cody_finish();
 
   //Print final condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeMesh(outfile,mesh);
+  visFinish();
 
-  Hp->t+=cTime;
-  free(q  );
-  free(qr );
-  free(ql );
-  free(flx);
+  Hp->t=cTime;
+  freePasses();
 }
@@ -4,7 +4,33 @@
 #include "hydro_struct.h"
 #include "hydro_defs.h"
 
-void engine(double *mesh, hydro_prob *Hp, hydro_args *Ha);
+#ifdef __cplusplus
+extern "C" {
+#endif
 
+void engine(real_t *mesh, hydro_prob *Hp, hydro_args *Ha);
+real_t *readCheckpoint(char *fname, hydro_prob *Hp, hydro_args *Ha);
+void closeCheckpoint(real_t *mesh, hydro_prob *Hp);
+
+//Pencil kernels of a pass, also run by hydro_amr on the patches of its
+//quadtree. They read gamma and the Riemann options from the problem set by
+//setKernelProb (engine sets it for itself)
+void setKernelProb(hydro_prob *Hyp, hydro_args *Hya);
+void trace(real_t *ql, real_t *qr, real_t *q, double dtdx, int np, int nt);
+void riemann(real_t *flx, real_t *qxm, real_t *qxp, int np, int nt);
+void addFluxX(real_t *mesh, real_t *flx, double dtdx, int np, int nt, real_t *den);
+void addFluxY(real_t *mesh, real_t *flx, double dtdx, int np, int nt, real_t *den);
+
+//Whole passes of the problem set by setKernelProb, run by hydro_ens on the
+//members of its ensemble. allocPasses allocates the pass arrays the calls
+//in between share, calcDT returns the dt of the mesh at a CFL of 1
+void allocPasses();
+void freePasses();
+double calcDT(real_t *mesh);
+void runPass(real_t *mesh, double dt, int n, int dir);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif //HYDRO_H_
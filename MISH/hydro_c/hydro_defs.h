@@ -9,6 +9,138 @@
 #define VARVY  2
 #define VARPR  3
 
+//Pencils per tile of the fused sweep (-DSWEEP_TILE=n), 0 disables it
+#ifndef SWEEP_TILE
+#define SWEEP_TILE 0
+#endif
+
+//Edge of the blocks the y pass transposes the mesh in (-DY_BLOCK=n), 0
+//walks the whole mesh
+#ifndef Y_BLOCK
+#define Y_BLOCK 0
+#endif
+
+//Riemann solver (-DRIEMANN_MODE=n): scalar loop, RIEMANN_VLEN interfaces
+//at once with masked convergence, or at once with all niter_riemann
+//iterations and no convergence test
+#define RIEMANN_SCALAR 0
+#define RIEMANN_VEC    1
+#define RIEMANN_FIXED  2
+#ifndef RIEMANN_MODE
+#define RIEMANN_MODE RIEMANN_SCALAR
+#endif
+#ifndef RIEMANN_VLEN
+#define RIEMANN_VLEN 8
+#endif
+
+//Reduce the dt denominator for the next step in the flux update of the
+//last pass of a step instead of a separate pass over the mesh (-DFUSED_DT=1)
+#ifndef FUSED_DT
+#define FUSED_DT 0
+#endif
+
+//Precision of the mesh and the temporaries (-DPRECISION=n): double,
+//single, or single storage with the Riemann solver and the conservation
+//sums in double
+#define PREC_DOUBLE 0
+#define PREC_SINGLE 1
+#define PREC_MIXED  2
+#ifndef PRECISION
+#define PRECISION PREC_DOUBLE
+#endif
+#if PRECISION==PREC_DOUBLE
+typedef double real_t;
+#else
+typedef float real_t;
+#endif
+#if PRECISION==PREC_SINGLE
+typedef float acc_t;
+#else
+typedef double acc_t;
+#endif
+
+//Pad the rows of the pass arrays (q, ql, qr, flx) to whole cache lines,
+//plus a line when a row would be a multiple of ROW_SET_BYTES so the rows of
+//a column don't map to the same cache sets, and align the arrays to
+//ALIGN_BYTES (-DPAD_ROWS=1)
+#ifndef PAD_ROWS
+#define PAD_ROWS 0
+#endif
+#define ALIGN_BYTES   64
+#define ROW_SET_BYTES 4096
+#define ROW_ALIGN (ALIGN_BYTES/(int)sizeof(real_t))
+#define ROW_SET   (ROW_SET_BYTES/(int)sizeof(real_t))
+#if PAD_ROWS
+#define ROW_UP(n)  ((((n)+ROW_ALIGN-1)/ROW_ALIGN)*ROW_ALIGN)
+#define ROW_LEN(n) ((ROW_UP(n)%ROW_SET==0)?ROW_UP(n)+ROW_ALIGN:ROW_UP(n))
+#else
+#define ROW_LEN(n) (n)
+#endif
+
+//Write a checkpoint to <outPre>.chk every n steps, the run is resumed
+//with ./hydro rst <file> (-DCHKPT_STEPS=n)
+#ifndef CHKPT_STEPS
+#define CHKPT_STEPS 0
+#endif
+
+//Every n steps reduce the mesh to its totals, the density along the
+//centerline and a density histogram of INSITU_BINS bins, and append
+//them to <outPre>.ins (-DINSITU_STEPS=n)
+#ifndef INSITU_STEPS
+#define INSITU_STEPS 0
+#endif
+#ifndef INSITU_BINS
+#define INSITU_BINS 32
+#endif
+
+//Write the vis files of the full mesh (-DVIS_DUMPS=0 writes none, e.g.
+//when the in-situ output is all the run needs)
+#ifndef VIS_DUMPS
+#define VIS_DUMPS 1
+#endif
+
+//Format of the vis dumps (-DVIS_FORMAT=n): ascii .vts, binary .vts with
+//the arrays appended raw, or one binary .vts per rank and a .pvts
+#define VIS_ASCII    0
+#define VIS_BINARY   1
+#define VIS_PARALLEL 2
+#ifndef VIS_FORMAT
+#define VIS_FORMAT VIS_ASCII
+#endif
+
+//Write the vis files from a background thread (-DVIS_ASYNC=1, link with
+//-pthread) so the engine keeps stepping during the write
+#ifndef VIS_ASYNC
+#define VIS_ASYNC 0
+#endif
+
+//Accumulate the time spent in each stage of the passes and print it as a
+//STAGE: line after the TIME: line (-DSTAGE_TIMERS=1)
+#ifndef STAGE_TIMERS
+#define STAGE_TIMERS 0
+#endif
+#define ST_DT    0
+#define ST_PRIM  1
+#define ST_BND   2
+#define ST_TRACE 3
+#define ST_RIEM  4
+#define ST_FLUX  5
+#define ST_HALO  6
+#define ST_VIS   7
+#define NSTAGE   8
+
+//Give every thread its own problem and pass arrays (-DKERNEL_TLS=1), set
+//with setKernelProb and allocPasses, so threads can step different
+//problems at once. hydro_ens builds hydro.c this way
+#ifndef KERNEL_TLS
+#define KERNEL_TLS 0
+#endif
+#if KERNEL_TLS
+#define KERNEL_LOCAL __thread
+#else
+#define KERNEL_LOCAL
+#endif
+
 #define BND_REFL 0
 #define BND_PERM 1
 
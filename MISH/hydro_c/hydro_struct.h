@@ -39,9 +39,38 @@ typedef struct __hydroArgs{
 
     // Numerical scheme
     int niter_riemann;
+    int riemannMode;
     int iorder;
     double slope_type;
     int scheme;
+
+    // Pencils per tile of the fused sweep, 0 runs full mesh passes
+    int sweepTile;
+    // Block edge of the y transpose, 0 walks the whole mesh
+    int yBlock;
+    // Reduce the next dt in the last flux update of a step
+    int fusedDT;
+
+    // Steps between checkpoints, 0 writes none
+    int nchkpt;
+    // Steps between in-situ records, 0 writes none
+    int ninsitu;
+    // Step and next vis time to resume from, set on restart
+    int nstart;
+    double nxtstart;
 } hydro_args;
 
+//Header of a checkpoint file, the nvar arrays of the mesh follow it at
+//CHK_HDR_LEN bytes. prob.t is the time at step args.nstart
+#define CHK_MAGIC "MISHCHK"
+#define CHK_HDR_LEN 4096
+
+typedef struct __hydroChk{
+    char magic[8];
+    int hdrSize;
+    int elSize;
+    hydro_prob prob;
+    hydro_args args;
+} hydro_chk;
+
 #endif
@@ -3,7 +3,7 @@
 #include "hydro.h"
 
 int main(int argc, char* argv[]){
-  double *mesh;
+  real_t *mesh;
   hydro_prob Hp;
   hydro_args Ha;
   int i,j;
@@ -20,9 +20,27 @@ int main(int argc, char* argv[]){
     else if(!strcmp(argv[1],"crn")) init=2;
     else if(!strcmp(argv[1],"wsc")) init=3;
     else if(!strcmp(argv[1],"scs")) init=4;
+    else if(!strcmp(argv[1],"rst")) init=5;
     else printf("Unknown init\n");
   }
 
+  //Resume from a checkpoint with the problem and options stored in it
+  if(init==5){
+    if(argc<3){
+      printf("No checkpoint file supplied\n");
+      return 1;
+    }
+    mesh=readCheckpoint(argv[2],&Hp,&Ha);
+    if(mesh==NULL){
+      return 1;
+    }
+    printf("INIT:%s\n",argv[1]);
+    printf("INIT:%s @ iter %d\n",Ha.initFile,Ha.nstart);
+    engine(mesh,&Hp,&Ha);
+    closeCheckpoint(mesh,&Hp);
+    return 0;
+  }
+
   //Get size multiplier
   if(init>2&&(argc<3||sscanf(argv[2],"%d",&pSMul)!=1)){
     printf("No problem size multiplier supplied\n");
@@ -112,7 +130,7 @@ int main(int argc, char* argv[]){
 
   Hp.nvar=4;
 
-  mesh=(double*)malloc(Hp.nvar*Hp.nx*Hp.ny*sizeof(double));
+  mesh=(real_t*)malloc(Hp.nvar*Hp.nx*Hp.ny*sizeof(real_t));
 
   Hp.gamma=1.4;
 
@@ -124,6 +142,15 @@ int main(int argc, char* argv[]){
   Ha.smallr=1e-10;
   Ha.smallc=1e-10;
   Ha.niter_riemann=10;
+  Ha.riemannMode=RIEMANN_MODE;
+  Ha.sweepTile=SWEEP_TILE;
+  Ha.yBlock=Y_BLOCK;
+  Ha.fusedDT=FUSED_DT;
+  Ha.nchkpt=CHKPT_STEPS;
+  Ha.ninsitu=INSITU_STEPS;
+  Ha.nstart=0;
+  Ha.nxtstart=-1.0;
+  Ha.initFile[0]='\0';
   
   for(j=0;j<Hp.ny;j++){
     for(i=0;i<Hp.nx;i++){
@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
 #include <mpi.h>
 #include "hydro.h"
+#include "outfile.h"
+#include "cody_perf.h"
 #include "float.h"
 
 hydro_args *Ha;
@@ -13,14 +16,37 @@ double *qr, *ql;
 double *flx;
 
 //MPI Vars
-int bndT, bndB;
-int pProc, nProc;
+MPI_Comm cartComm;
+int bndT, bndB, bndL, bndR;
+int pProc, nProc, lProc, rProc;
 int rank, size;
-int myNy;
+int myNx, myNy;
 int varSize;
+MPI_Request vReqs[4];
+//Block of this rank in a checkpoint file and in lMesh
+MPI_Datatype chkFType, chkMType;
+
+//Local part of the fused dt and conservation reduction, the max of denom
+//and the sums of mass and energy with their corrections as in sumArray
+typedef struct __stepRed{
+  double denom;
+  double sum[2], corr[2];
+} stepRed;
+MPI_Datatype redType;
+MPI_Op redOp;
+MPI_Request redReq;
+stepRed redL, redG;
 
 double slope(double *q,int ind);
 
+#if STAGE_TIMERS
+//Cumulative wall time of each stage on this rank, indexed by ST_*
+double stageT[NSTAGE];
+#define STAGE(s,call) {double stT=MPI_Wtime(); call; stageT[s]+=MPI_Wtime()-stT;}
+#else
+#define STAGE(s,call) call
+#endif
+
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
   //printf("N[%2d]: Array %s\n",rank,label);
@@ -54,13 +80,13 @@ double calcDT(double *mesh){
   max_denom=Ha->smallc;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  for (lI=0; lI<Hp->nx*myNy; lI++){
-    i=lI%Hp->nx;
-    j=lI/Hp->nx;
-    r   =MAX(mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for (lI=0; lI<myNx*myNy; lI++){
+    i=lI%myNx;
+    j=lI/myNx;
+    r   =MAX(mesh[i+2+(j+2)*(myNx+4)+varSize*VARRHO],Ha->smallr);
+    vx  =    mesh[i+2+(j+2)*(myNx+4)+varSize*VARVX ]/r;
+    vy  =    mesh[i+2+(j+2)*(myNx+4)+varSize*VARVY ]/r;
+    eint=    mesh[i+2+(j+2)*(myNx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
     
     c=sqrt((Hp->gamma*p/r));
@@ -75,90 +101,202 @@ double calcDT(double *mesh){
   return 0.5/gmax;
 }
 
+//Combines stepRed values, max of the denominators and sum of the rest
+void stepRedOp(void *in, void *inout, int *len, MPI_Datatype *type){
+  stepRed *a=(stepRed *)in, *b=(stepRed *)inout;
+  int l;
+  (void)type; //always the stepRed type
+
+  for(l=0;l<*len;l++){
+    if(b[l].denom<a[l].denom)b[l].denom=a[l].denom;
+    b[l].sum [0]+=a[l].sum [0];
+    b[l].sum [1]+=a[l].sum [1];
+    b[l].corr[0]+=a[l].corr[0];
+    b[l].corr[1]+=a[l].corr[1];
+  }
+}
+
+//Computes the denominator of calcDT and, if diag is set, the mass and
+//energy sums in one pass over the mesh, then posts a single reduction of
+//all of them that is completed by finishStepRed
+void postStepRed(double *mesh, int diag){
+  int lI, i, j, ind;
+  double denom;
+  double r,vx,vy,eint,p;
+  double c,cx,cy;
+  double smallp;
+  double nsum;
+
+  redL.denom=Ha->smallc;
+  redL.sum [0]=redL.sum [1]=0.0;
+  redL.corr[0]=redL.corr[1]=0.0;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  for (lI=0; lI<myNx*myNy; lI++){
+    i=lI%myNx;
+    j=lI/myNx;
+    ind=i+2+(j+2)*(myNx+4);
+    r   =MAX(mesh[ind+varSize*VARRHO],Ha->smallr);
+    vx  =    mesh[ind+varSize*VARVX ]/r;
+    vy  =    mesh[ind+varSize*VARVY ]/r;
+    eint=    mesh[ind+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+    p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
+
+    c=sqrt((Hp->gamma*p/r));
+    cx=(c+fabs(vx))/Hp->dx;
+    cy=(c+fabs(vy))/Hp->dy;
+    denom=cx+cy;
+    if(redL.denom<denom)redL.denom=denom;
+    if(diag){
+      nsum=redL.sum[0]+mesh[ind+varSize*VARRHO];
+      redL.corr[0]=(nsum-redL.sum[0])-mesh[ind+varSize*VARRHO];
+      redL.sum [0]=nsum;
+      nsum=redL.sum[1]+mesh[ind+varSize*VARPR ];
+      redL.corr[1]=(nsum-redL.sum[1])-mesh[ind+varSize*VARPR ];
+      redL.sum [1]=nsum;
+    }
+  }
+  MPI_Iallreduce(&redL,&redG,1,redType,redOp,cartComm,&redReq);
+}
+
+//Waits for the reduction posted by postStepRed, returns the timestep as
+//calcDT does and the mass and energy as sumArray does
+double finishStepRed(double *TM, double *TE){
+  MPI_Wait(&redReq,MPI_STATUS_IGNORE);
+  *TM=redG.sum[0]+redG.corr[0];
+  *TE=redG.sum[1]+redG.corr[1];
+  return 0.5/redG.denom;
+}
+
 void setHHalo(double *mesh, int LBnd, int RBnd){
-  int lI, i,j;
+  int nV, lI, i,j;
+  int row=myNx+4;
+  MPI_Request reqs[4];
+  MPI_Status stat[4];
+
+  //Exchange of the two columns next to the left and right neighbors,
+  //packed like the rows of the y halo
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<2*myNy;lI++){
+      i=lI%2;
+      j=lI/2;
+      bndLS[lI+2*myNy*nV]=mesh[2   +i+row*(j+2+(myNy+4)*nV)];
+      bndHS[lI+2*myNy*nV]=mesh[myNx+i+row*(j+2+(myNy+4)*nV)];
+    }
+  }
+  MPI_Irecv(bndLR,2*myNy*Hp->nvar,MPI_DOUBLE,lProc,3,cartComm,reqs+0);
+  MPI_Irecv(bndHR,2*myNy*Hp->nvar,MPI_DOUBLE,rProc,4,cartComm,reqs+1);
+  MPI_Isend(bndLS,2*myNy*Hp->nvar,MPI_DOUBLE,lProc,4,cartComm,reqs+2);
+  MPI_Isend(bndHS,2*myNy*Hp->nvar,MPI_DOUBLE,rProc,3,cartComm,reqs+3);
+  MPI_Waitall(4,reqs,stat);
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<2*myNy;lI++){
+      i=lI%2;
+      j=lI/2;
+      if(lProc!=MPI_PROC_NULL)mesh[       i+row*(j+2+(myNy+4)*nV)]=bndLR[lI+2*myNy*nV];
+      if(rProc!=MPI_PROC_NULL)mesh[myNx+2+i+row*(j+2+(myNy+4)*nV)]=bndHR[lI+2*myNy*nV];
+    }
+  }
+
   for(lI=0;lI<2*myNy;lI++){
     i=lI%2;
     j=lI/2;
     //Left Boundary
     if(LBnd==BND_REFL){
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }else if(LBnd==BND_PERM){
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVX )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }
     //Right Boundary
     if(RBnd==BND_REFL){
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }else if(RBnd==BND_PERM){
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVX )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }
   }
 }
 
-void setVHalo(double *mesh, int TBnd, int BBnd){
-  int lI, i,j;
-  int row=Hp->nx+4;
-  MPI_Request reqs[16];
-  MPI_Status stat[16];
-  MPI_Irecv(mesh+(     0)*row+VARRHO*varSize,2*row,MPI_DOUBLE,pProc,1,MPI_COMM_WORLD,reqs+ 0);
-  MPI_Irecv(mesh+(     0)*row+VARVX *varSize,2*row,MPI_DOUBLE,pProc,3,MPI_COMM_WORLD,reqs+ 1);
-  MPI_Irecv(mesh+(     0)*row+VARVY *varSize,2*row,MPI_DOUBLE,pProc,5,MPI_COMM_WORLD,reqs+ 2);
-  MPI_Irecv(mesh+(     0)*row+VARPR *varSize,2*row,MPI_DOUBLE,pProc,7,MPI_COMM_WORLD,reqs+ 3);
-  MPI_Isend(mesh+(     2)*row+VARRHO*varSize,2*row,MPI_DOUBLE,pProc,2,MPI_COMM_WORLD,reqs+ 4);
-  MPI_Isend(mesh+(     2)*row+VARVX *varSize,2*row,MPI_DOUBLE,pProc,4,MPI_COMM_WORLD,reqs+ 5);
-  MPI_Isend(mesh+(     2)*row+VARVY *varSize,2*row,MPI_DOUBLE,pProc,6,MPI_COMM_WORLD,reqs+ 6);
-  MPI_Isend(mesh+(     2)*row+VARPR *varSize,2*row,MPI_DOUBLE,pProc,8,MPI_COMM_WORLD,reqs+ 7);
-  MPI_Isend(mesh+(myNy  )*row+VARRHO*varSize,2*row,MPI_DOUBLE,nProc,1,MPI_COMM_WORLD,reqs+ 8);
-  MPI_Isend(mesh+(myNy  )*row+VARVX *varSize,2*row,MPI_DOUBLE,nProc,3,MPI_COMM_WORLD,reqs+ 9);
-  MPI_Isend(mesh+(myNy  )*row+VARVY *varSize,2*row,MPI_DOUBLE,nProc,5,MPI_COMM_WORLD,reqs+10);
-  MPI_Isend(mesh+(myNy  )*row+VARPR *varSize,2*row,MPI_DOUBLE,nProc,7,MPI_COMM_WORLD,reqs+11);
-  MPI_Irecv(mesh+(myNy+2)*row+VARRHO*varSize,2*row,MPI_DOUBLE,nProc,2,MPI_COMM_WORLD,reqs+12);
-  MPI_Irecv(mesh+(myNy+2)*row+VARVX *varSize,2*row,MPI_DOUBLE,nProc,4,MPI_COMM_WORLD,reqs+13);
-  MPI_Irecv(mesh+(myNy+2)*row+VARVY *varSize,2*row,MPI_DOUBLE,nProc,6,MPI_COMM_WORLD,reqs+14);
-  MPI_Irecv(mesh+(myNy+2)*row+VARPR *varSize,2*row,MPI_DOUBLE,nProc,8,MPI_COMM_WORLD,reqs+15);
-  MPI_Waitall(16,reqs,stat);
-  for(lI=0;lI<2*Hp->nx;lI++){
+//Posts the exchange of the two rows next to each neighbor, the four
+//variables are packed into one message per neighbor and direction
+void postVHalo(double *mesh, MPI_Request *reqs){
+  int nV, lI;
+  int row=myNx+4;
+
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<2*row;lI++){
+      bndLS[lI+2*row*nV]=mesh[lI+(     2)*row+nV*varSize];
+      bndHS[lI+2*row*nV]=mesh[lI+(myNy  )*row+nV*varSize];
+    }
+  }
+  MPI_Irecv(bndLR,2*row*Hp->nvar,MPI_DOUBLE,pProc,1,cartComm,reqs+0);
+  MPI_Irecv(bndHR,2*row*Hp->nvar,MPI_DOUBLE,nProc,2,cartComm,reqs+1);
+  MPI_Isend(bndLS,2*row*Hp->nvar,MPI_DOUBLE,pProc,2,cartComm,reqs+2);
+  MPI_Isend(bndHS,2*row*Hp->nvar,MPI_DOUBLE,nProc,1,cartComm,reqs+3);
+}
+
+//Waits for the exchange posted by postVHalo, unpacks the received rows
+//and sets the physical boundaries
+void finishVHalo(double *mesh, MPI_Request *reqs, int TBnd, int BBnd){
+  int nV, lI, i,j;
+  int row=myNx+4;
+  MPI_Status stat[4];
+
+  MPI_Waitall(4,reqs,stat);
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<2*row;lI++){
+      if(pProc!=MPI_PROC_NULL)mesh[lI+(     0)*row+nV*varSize]=bndLR[lI+2*row*nV];
+      if(nProc!=MPI_PROC_NULL)mesh[lI+(myNy+2)*row+nV*varSize]=bndHR[lI+2*row*nV];
+    }
+  }
+  for(lI=0;lI<2*myNx;lI++){
     i=lI/2;
     j=lI%2;
     //Top boundary
     if(TBnd==BND_REFL){
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVY )]=-mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVY )]=-mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARPR )];
     }else if(TBnd==BND_PERM){
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVY )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVY )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARPR )];
     }
     //Bottom boundary
     if(BBnd==BND_REFL){
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVY )]=-mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVY )]=-mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARPR )];
     }else if(BBnd==BND_PERM){
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVY )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVY )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARPR )];
     }
   }
 }
 
+void setVHalo(double *mesh, int TBnd, int BBnd){
+  MPI_Request reqs[4];
+
+  postVHalo(mesh,reqs);
+  finishVHalo(mesh,reqs,TBnd,BBnd);
+}
+
 void toPrimX(double *q, double *mesh){
   int i;
   int xI, yI;
@@ -166,44 +304,50 @@ void toPrimX(double *q, double *mesh){
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  for(i=0;i<myNy*(Hp->nx+4);i++){
-    xI=i%(Hp->nx+4);
-    yI=i/(Hp->nx+4);
-    r   =MAX(mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(i=0;i<myNy*(myNx+4);i++){
+    xI=i%(myNx+4);
+    yI=i/(myNx+4);
+    r   =MAX(mesh[xI+(yI+2)*(myNx+4)+varSize*VARRHO],Ha->smallr);
+    vx  =mesh[xI+(yI+2)*(myNx+4)+varSize*VARVX ]/r;
+    vy  =mesh[xI+(yI+2)*(myNx+4)+varSize*VARVY ]/r;
+    eint=mesh[xI+(yI+2)*(myNx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[xI+(Hp->nx+4)*(yI+myNy*VARRHO)]=r;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARVX )]=vx;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARVY )]=vy;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARPR )]=p;
+    q[xI+(myNx+4)*(yI+myNy*VARRHO)]=r;
+    q[xI+(myNx+4)*(yI+myNy*VARVX )]=vx;
+    q[xI+(myNx+4)*(yI+myNy*VARVY )]=vy;
+    q[xI+(myNx+4)*(yI+myNy*VARPR )]=p;
   }
 }
 
-void toPrimY(double *q, double *mesh){
+//Converts the mesh rows y0 to y1-1 (halo included) for the y pass
+void toPrimYRows(double *q, double *mesh, int y0, int y1){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  for(i=0;i<(myNy+4)*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
-    r   =MAX(mesh[xI+2+yI*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=mesh[xI+2+yI*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(i=0;i<(y1-y0)*myNx;i++){
+    xI=i%myNx;
+    yI=y0+i/myNx;
+    r   =MAX(mesh[xI+2+yI*(myNx+4)+varSize*VARRHO],Ha->smallr);
+    vx  =mesh[xI+2+yI*(myNx+4)+varSize*VARVX ]/r;
+    vy  =mesh[xI+2+yI*(myNx+4)+varSize*VARVY ]/r;
+    eint=mesh[xI+2+yI*(myNx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[yI+(myNy+4)*(xI+Hp->nx*VARRHO)]=r;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARVX )]=vy;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARVY )]=vx;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARPR )]=p;
+    q[yI+(myNy+4)*(xI+myNx*VARRHO)]=r;
+    q[yI+(myNy+4)*(xI+myNx*VARVX )]=vy;
+    q[yI+(myNy+4)*(xI+myNx*VARVY )]=vx;
+    q[yI+(myNy+4)*(xI+myNx*VARPR )]=p;
   }
 }
 
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+void toPrimY(double *q, double *mesh){
+  toPrimYRows(q,mesh,0,myNy+4);
+}
+
+//Traced states of the pencil positions i0 to i1-1 (0 to np+1)
+void traceRange(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i0, int i1){
   int lI;
   int i,j;
   double  r, u, v1, p, a;
@@ -215,9 +359,9 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
 
   //if(isnan(dtdx))printf("N[%2d]: dtdx isnan\n",rank);
 
-  for(lI=0;lI<(np+2)*nt;lI++){
-    i=lI%(np+2);
-    j=lI/(np+2);
+  for(lI=0;lI<(i1-i0)*nt;lI++){
+    i=i0+lI%(i1-i0);
+    j=lI/(i1-i0);
     r =q[i+1+(np+4)*(j+nt*VARRHO)];
     u =q[i+1+(np+4)*(j+nt*VARVX )];
     v1=q[i+1+(np+4)*(j+nt*VARVY )];
@@ -273,6 +417,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
   }
 }
 
+void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+  traceRange(ql,qr,q,dtdx,np,nt,0,np+2);
+}
+
 double slope(double *q,int ind){
   double dlft, drgt, dcen, dsgn, dlim;
   //  printf("Calc slope for %d refs: [%d,%d,%d]\n",ind,ind-1,ind,ind+1);
@@ -286,7 +434,8 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+//Fluxes through the interfaces i0 to i1-1 (0 to np)
+void riemannRange(double *flx, double *qxm, double *qxp, int np, int nt, int i0, int i1){
   int lI, i,j,n;
   double smallp, smallpp;
   double gmma6, entho;
@@ -303,9 +452,9 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   smallpp=Ha->smallr*smallp;
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
-  for(lI=0;lI<(np+1)*nt;lI++){
-    i=lI%(np+1);
-    j=lI/(np+1);
+  for(lI=0;lI<(i1-i0)*nt;lI++){
+    i=i0+lI%(i1-i0);
+    j=lI/(i1-i0);
     
     rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],Ha->smallr);
     vxl=    qxm[i  +(np+2)*(j+nt*VARVX )];
@@ -398,6 +547,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
+void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+  riemannRange(flx,qxm,qxp,np,nt,0,np+1);
+}
+
 void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   int lI, i, j;
 
@@ -415,12 +568,13 @@ void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+//Updates the cells i0 to i1-1 along the y pencils
+void addFluxYRange(double *mesh, double *flx, double dtdx, int np, int nt, int i0, int i1){
   int lI, i, j;
 
-  for(lI=0;lI<np*nt;lI++){
-    i=lI%np;
-    j=lI/np;
+  for(lI=0;lI<(i1-i0)*nt;lI++){
+    i=i0+lI%(i1-i0);
+    j=lI/(i1-i0);
     mesh[j+2+(nt+4)*(i+2+(np+4)*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
 						flx[i+1+(np+1)*(j+nt*VARRHO)]);
     mesh[j+2+(nt+4)*(i+2+(np+4)*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
@@ -432,6 +586,10 @@ void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
+void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+  addFluxYRange(mesh,flx,dtdx,np,nt,0,np);
+}
+
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   int lI,i,j;
   double sum, corr;
@@ -484,44 +642,316 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
-void runPass(double *mesh, double dt, int n, int dir){
-  int np,nt;
-  double dx,dy;
-  char dCh;
-  char outLab[30];
+//Halo exchange and conversion to primitives, the part of a pass that does
+//not need dt. With the overlap the y halo exchange is only posted and the
+//primitives of the rows that do not depend on it are computed
+void beginPass(double *mesh, int dir){
+  int np=myNy;
 
+  if(dir==0){
+    STAGE(ST_HALO,setHHalo(mesh,bndL,bndR));
+    STAGE(ST_PRIM,toPrimX(q,mesh));
+  }else if(Ha->haloOverlap&&myNy>=4){
+    STAGE(ST_HALO,postVHalo(mesh,vReqs));
+    STAGE(ST_PRIM,toPrimYRows(q,mesh,2,np+2));
+  }else{
+    STAGE(ST_HALO,setVHalo(mesh,bndT,bndB));
+    STAGE(ST_PRIM,toPrimY(q,mesh));
+  }
+}
+
+//Rest of the pass started by beginPass. In the overlapped y pass the cells
+//that do not depend on the halo are updated while the exchange is in
+//flight, the two cells next to each end of the slab depend on it through
+//the slopes and are finished after the wait
+void endPass(double *mesh, double dt, int dir){
+  int np,nt;
+  double dx;
 
   if(dir==0){
-    np=Hp->nx;
+    np=myNx;
     nt=myNy;
     dx=Hp->dx;
-    dy=Hp->dy;
-    dCh='x';
-    setHHalo(mesh,Hp->bndL,Hp->bndR);
-    toPrimX(q,mesh);
   }else{
     np=myNy;
-    nt=Hp->nx;
+    nt=myNx;
     dx=Hp->dy;
-    dy=Hp->dx;
-    dCh='y';
-    setVHalo(mesh,bndT,bndB);
-    toPrimY(q,mesh);
   }
-  trace(ql,qr,q,dt/dx,np,nt);
-  riemann(flx,ql,qr,np,nt);
+  //Needs a slab of at least 4 rows to have an interior
+  if(dir==1&&Ha->haloOverlap&&myNy>=4){
+    STAGE(ST_TRACE,traceRange(ql,qr,q,dt/dx,np,nt,2,np));
+    STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,2,np-1));
+    STAGE(ST_FLUX,addFluxYRange(mesh,flx,dt/dx,np,nt,2,np-2));
+
+    STAGE(ST_HALO,finishVHalo(mesh,vReqs,bndT,bndB));
+    STAGE(ST_PRIM,toPrimYRows(q,mesh,0,2));
+    STAGE(ST_PRIM,toPrimYRows(q,mesh,np+2,np+4));
+    STAGE(ST_TRACE,traceRange(ql,qr,q,dt/dx,np,nt,0,2));
+    STAGE(ST_TRACE,traceRange(ql,qr,q,dt/dx,np,nt,np,np+2));
+    STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,0,2));
+    STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,np-1,np+1));
+    STAGE(ST_FLUX,addFluxYRange(mesh,flx,dt/dx,np,nt,0,2));
+    STAGE(ST_FLUX,addFluxYRange(mesh,flx,dt/dx,np,nt,np-2,np));
+    return;
+  }
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dx,np,nt));
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt));
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dx,np,nt));
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dx,np,nt));
   }
 }
 
+void runPass(double *mesh, double dt, int dir){
+  beginPass(mesh,dir);
+  endPass(mesh,dt,dir);
+}
+
+//Copies variable nV of the global mesh into blk, where the blocks of all
+//ranks follow each other in rank order as needed by Scatterv and Gatherv
+void packBlocks(double *blk, double *gMesh, int *ext, int nV){
+  int p, lI, i, j, off;
+
+  off=0;
+  for(p=0;p<size;p++){
+    for(lI=0;lI<ext[4*p+1]*ext[4*p+3];lI++){
+      i=lI%ext[4*p+1];
+      j=lI/ext[4*p+1];
+      blk[off+lI]=gMesh[ext[4*p]+i+Hp->nx*(ext[4*p+2]+j+Hp->ny*nV)];
+    }
+    off+=ext[4*p+1]*ext[4*p+3];
+  }
+}
+
+//Copies the blocks back into variable nV of the global mesh
+void unpackBlocks(double *gMesh, double *blk, int *ext, int nV){
+  int p, lI, i, j, off;
+
+  off=0;
+  for(p=0;p<size;p++){
+    for(lI=0;lI<ext[4*p+1]*ext[4*p+3];lI++){
+      i=lI%ext[4*p+1];
+      j=lI/ext[4*p+1];
+      gMesh[ext[4*p]+i+Hp->nx*(ext[4*p+2]+j+Hp->ny*nV)]=blk[off+lI];
+    }
+    off+=ext[4*p+1]*ext[4*p+3];
+  }
+}
+
+//First cell and number of cells of block b of n cells split in nBlk blocks
+void blockRange(int *r, int n, int nBlk, int b){
+  r[0]=b*(n/nBlk)+((b<n%nBlk)?b:n%nBlk);
+  r[1]=n/nBlk+((n%nBlk)>b);
+}
+
+//Writes the vis file of step n. The interior of every rank is packed into
+//recvMesh, then either each rank writes its own block (VIS_PARALLEL) or the
+//blocks are gathered into gBuf on rank 0, copied into gMesh and written
+void writeMeshVis(double *lMesh, double *recvMesh, double *gMesh, double *gBuf, int *counts, int *dspls, int *ext, int n){
+  int nV,lI,i,j;
+  char outfile[30];
+
+#if !VIS_DUMPS
+  return;
+#endif
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<myNx*myNy;lI++){
+      i=lI%(myNx);
+      j=lI/(myNx);
+      recvMesh[i+myNx*(j+myNy*nV)]=lMesh[i+2+(myNx+4)*(j+2+(myNy+4)*nV)];
+    }
+  }
+  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+#if VIS_FORMAT==VIS_PARALLEL
+  writeVisParAsync(outfile,recvMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny,ext,rank,size);
+#else
+  for(nV=0;nV<Hp->nvar;nV++){
+    MPI_Gatherv(recvMesh+nV*myNx*myNy,myNx*myNy,MPI_DOUBLE,gBuf,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+    if(rank==0)unpackBlocks(gMesh,gBuf,ext,nV);
+  }
+  if(rank==0)writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+#endif
+}
+
+//Appends the in-situ record of step n to ins on rank 0, every rank takes
+//part in the reductions. Three lines:
+//TOT,n,t,TM,TE,rhoMin,rhoMax
+//PRF,n,t and the density along the centerline of the longer dim, row
+//ny/2 or column nx/2, summed over the ranks from the part each one holds
+//HST,n,t and the cells in each of INSITU_BINS bins of the density
+//between rhoMin and rhoMax
+void writeInsitu(FILE *ins, double *lMesh, int *ext, int n, double cTime){
+  int i, j, b, len, c;
+  int hist[INSITU_BINS], gHist[INSITU_BINS];
+  double mm[2], gMm[2];
+  double TM, TE, scale, r;
+  double *prf, *gPrf;
+
+  TM=Hp->dx*Hp->dy*sumArray(lMesh,VARRHO,myNx,myNy,2,2);
+  TE=Hp->dx*Hp->dy*sumArray(lMesh,VARPR ,myNx,myNy,2,2);
+  //The min as the max of its negation, so both take one reduction
+  mm[0]=-lMesh[2+(myNx+4)*(2+(myNy+4)*VARRHO)];
+  mm[1]=-mm[0];
+  for(j=0;j<myNy;j++){
+    for(i=0;i<myNx;i++){
+      r=lMesh[i+2+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      if(-r>mm[0])mm[0]=-r;
+      if( r>mm[1])mm[1]= r;
+    }
+  }
+  MPI_Allreduce(mm,gMm,2,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+  scale=(gMm[1]>-gMm[0])?INSITU_BINS/(gMm[1]+gMm[0]):0.0;
+  for(b=0;b<INSITU_BINS;b++){
+    hist[b]=0;
+  }
+  for(j=0;j<myNy;j++){
+    for(i=0;i<myNx;i++){
+      b=(int)((lMesh[i+2+(myNx+4)*(j+2+(myNy+4)*VARRHO)]+gMm[0])*scale);
+      hist[MIN(b,INSITU_BINS-1)]++;
+    }
+  }
+  MPI_Reduce(hist,gHist,INSITU_BINS,MPI_INT,MPI_SUM,0,MPI_COMM_WORLD);
+
+  len=(Hp->nx>=Hp->ny)?Hp->nx:Hp->ny;
+  prf=(double*)malloc(2*len*sizeof(double));
+  gPrf=prf+len;
+  for(i=0;i<len;i++){
+    prf[i]=0.0;
+  }
+  if(Hp->nx>=Hp->ny){
+    c=Hp->ny/2-ext[4*rank+2];
+    for(i=0;i<myNx&&c>=0&&c<myNy;i++){
+      prf[ext[4*rank]+i]=lMesh[i+2+(myNx+4)*(c+2+(myNy+4)*VARRHO)];
+    }
+  }else{
+    c=Hp->nx/2-ext[4*rank];
+    for(j=0;j<myNy&&c>=0&&c<myNx;j++){
+      prf[ext[4*rank+2]+j]=lMesh[c+2+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+    }
+  }
+  MPI_Reduce(prf,gPrf,len,MPI_DOUBLE,MPI_SUM,0,MPI_COMM_WORLD);
+
+  if(rank==0&&ins!=NULL){
+    fprintf(ins,"TOT,%d,%.9g,%.17g,%.17g,%.9g,%.9g\n",n,cTime,TM,TE,-gMm[0],gMm[1]);
+    fprintf(ins,"PRF,%d,%.9g",n,cTime);
+    for(i=0;i<len;i++){
+      fprintf(ins,",%.9g",gPrf[i]);
+    }
+    fprintf(ins,"\nHST,%d,%.9g",n,cTime);
+    for(b=0;b<INSITU_BINS;b++){
+      fprintf(ins,",%d",gHist[b]);
+    }
+    fprintf(ins,"\n");
+  }
+  free(prf);
+}
+
+//Builds the checkpoint types of this rank, its block of the nvar global
+//arrays in the file and the interior of lMesh, from the extents in ext
+void chkTypes(int *ext){
+  int gSz[3], lSz[3], sub[3], gSt[3], lSt[3];
+
+  gSz[0]=Hp->nvar; gSz[1]=Hp->ny; gSz[2]=Hp->nx;
+  lSz[0]=Hp->nvar; lSz[1]=myNy+4; lSz[2]=myNx+4;
+  sub[0]=Hp->nvar; sub[1]=myNy;   sub[2]=myNx;
+  gSt[0]=0;        gSt[1]=ext[4*rank+2]; gSt[2]=ext[4*rank];
+  lSt[0]=0;        lSt[1]=2;      lSt[2]=2;
+  MPI_Type_create_subarray(3,gSz,sub,gSt,MPI_ORDER_C,MPI_DOUBLE,&chkFType);
+  MPI_Type_create_subarray(3,lSz,sub,lSt,MPI_ORDER_C,MPI_DOUBLE,&chkMType);
+  MPI_Type_commit(&chkFType);
+  MPI_Type_commit(&chkMType);
+}
+
+//Writes the mesh after step n to <outPre>.chk, every rank writes its block
+//with one collective call. The file is written under a temporary name and
+//renamed by rank 0 so an interrupted write leaves the previous checkpoint
+void writeCheckpoint(double *lMesh, int n, double cTime, double nxttout){
+  char name[PREFIX_LEN+8], tmp[PREFIX_LEN+12];
+  union{hydro_chk chk; char pad[CHK_HDR_LEN];} hdr;
+  MPI_File fh;
+  int err;
+
+  snprintf(name,sizeof(name),"%s.chk",Ha->outPre);
+  snprintf(tmp,sizeof(tmp),"%s.tmp",name);
+  err=MPI_File_open(MPI_COMM_WORLD,tmp,MPI_MODE_CREATE|MPI_MODE_WRONLY,MPI_INFO_NULL,&fh);
+  if(err!=MPI_SUCCESS){
+    if(rank==0)fprintf(stderr,"Could not open file %s\n",tmp);
+    return;
+  }
+  if(rank==0){
+    memset(&hdr,0,CHK_HDR_LEN);
+    strcpy(hdr.chk.magic,CHK_MAGIC);
+    hdr.chk.hdrSize=CHK_HDR_LEN;
+    hdr.chk.elSize=sizeof(double);
+    hdr.chk.prob=*Hp;
+    hdr.chk.prob.t=cTime;
+    hdr.chk.args=*Ha;
+    hdr.chk.args.nstart=n;
+    hdr.chk.args.nxtstart=nxttout;
+    MPI_File_write_at(fh,0,&hdr,CHK_HDR_LEN,MPI_BYTE,MPI_STATUS_IGNORE);
+  }
+  MPI_File_set_view(fh,CHK_HDR_LEN,MPI_DOUBLE,chkFType,"native",MPI_INFO_NULL);
+  err=MPI_File_write_all(fh,lMesh,1,chkMType,MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  if(err!=MPI_SUCCESS){
+    if(rank==0)fprintf(stderr,"Could not write checkpoint %s\n",tmp);
+    return;
+  }
+  if(rank==0){
+    rename(tmp,name);
+    printf("Checkpoint @ time %f iter %d\n",cTime,n);
+  }
+}
+
+//Reads the block of this rank from the checkpoint in Ha->initFile
+int readCheckpoint(double *lMesh){
+  MPI_File fh;
+  int err;
+
+  err=MPI_File_open(MPI_COMM_WORLD,Ha->initFile,MPI_MODE_RDONLY,MPI_INFO_NULL,&fh);
+  if(err!=MPI_SUCCESS){
+    return err;
+  }
+  MPI_File_set_view(fh,CHK_HDR_LEN,MPI_DOUBLE,chkFType,"native",MPI_INFO_NULL);
+  err=MPI_File_read_all(fh,lMesh,1,chkMType,MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  return err;
+}
+
+//Fills Hyp and Hya from the header of the checkpoint fname. Called before
+//MPI is initialized, so every rank reads it with stdio and the engine
+//reads the mesh. Returns 0 on success
+int readCheckpointHdr(char *fname, hydro_prob *Hyp, hydro_args *Hya){
+  hydro_chk chk;
+  FILE *fp;
+  int ok;
+
+  fp=fopen(fname,"rb");
+  if(fp==NULL){
+    fprintf(stderr,"Could not open file %s\n",fname);
+    return 1;
+  }
+  ok=fread(&chk,sizeof(chk),1,fp)==1&&!strcmp(chk.magic,CHK_MAGIC)&&
+     chk.hdrSize==CHK_HDR_LEN&&chk.elSize==sizeof(double);
+  fclose(fp);
+  if(!ok){
+    fprintf(stderr,"%s is not a checkpoint of this build\n",fname);
+    return 1;
+  }
+
+  *Hyp=chk.prob;
+  *Hya=chk.args;
+  snprintf(Hya->initFile,INIT_FN_LEN,"%s",fname);
+  return 0;
+}
+
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, nV, lI, i,j;
-  int bndL;
-  int bndH;
-  double dt;
+  int diag;
+  int dims[2], periods[2], coords[2];
+  int bndSize;
+  double dt, pDt;
   double cTime, nxttout;
 
   double volCell;
@@ -534,14 +964,19 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 
   char outfile[30];
   char outLab[30];
+  char insName[PREFIX_LEN+8];
+  FILE *ins;
 
   size_t primSize, qSize, flxSize;
 
   double initT, endT;
+  double outT;
+  int rOut;
 
   int mpi_err;
 
-  int *counts, *dspls;
+  int *counts, *dspls, *ext;
+  double *gBuf;
 
   mpi_err=MPI_Init(argc,argv);
 
@@ -552,8 +987,13 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   Hp=Hyp;
   Ha=Hya;
 
-  n=0;
-  cTime=0;
+  cody_init("MISH");
+  rOut=cody_region("out");
+
+  //A restart resumes the step count and clock of the checkpoint
+  n=Ha->nstart;
+  cTime=Hp->t;
+  pDt=0.0;
   nxttout=-1.0;
 
   if(Ha->nstepmax<0&&Ha->tend<0.0)return;
@@ -562,56 +1002,72 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   //Calculate sizes for dispersal
   MPI_Comm_size(MPI_COMM_WORLD,&size);
   MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  //Process grid, dims[0] ranks along y and dims[1] along x. Slabs of
+  //rows unless the 2D decomposition is used
+  dims[0]=size;
+  dims[1]=1;
+  if(Ha->decomp2D){
+    dims[0]=0;
+    dims[1]=0;
+    MPI_Dims_create(size,2,dims);
+  }
+  periods[0]=0;
+  periods[1]=0;
+  MPI_Cart_create(MPI_COMM_WORLD,2,dims,periods,0,&cartComm);
+  MPI_Type_contiguous(5,MPI_DOUBLE,&redType);
+  MPI_Type_commit(&redType);
+  MPI_Op_create(stepRedOp,1,&redOp);
+  MPI_Cart_shift(cartComm,0,1,&pProc,&nProc);
+  MPI_Cart_shift(cartComm,1,1,&lProc,&rProc);
+  bndT=(pProc==MPI_PROC_NULL)?Hp->bndU:BND_INT;
+  bndB=(nProc==MPI_PROC_NULL)?Hp->bndD:BND_INT;
+  bndL=(lProc==MPI_PROC_NULL)?Hp->bndL:BND_INT;
+  bndR=(rProc==MPI_PROC_NULL)?Hp->bndR:BND_INT;
+  if(rank==0)printf("Process grid %d x %d\n",dims[1],dims[0]);
+
+  //First column, columns, first row and rows of the block of every rank
   //if(rank==0)printf("Before loc size calcs\n");
+  ext=(int *)malloc(4*size*sizeof(int));
   counts=(int *)malloc(size*sizeof(int));
   dspls=(int *)malloc(size*sizeof(int));
-  dspls[0]=0;
-  counts[0]=Hp->ny/size;
-  if((Hp->ny%size)!=0)counts[0]++;
-  counts[0]*=Hp->nx;
-  for(i=1;i<size;i++){
-    counts[i]=Hp->ny/size;
-    if((Hp->ny%size)>i)counts[i]++;
-    counts[i]*=Hp->nx;
-    dspls[i]=dspls[i-1]+counts[i-1];
-  }
-  myNy=counts[rank]/Hp->nx;
-  if(rank==0){
-    pProc=MPI_PROC_NULL;
-    bndT=Hp->bndU;
-  }else{
-    pProc=rank-1;
-    bndT=BND_INT;
-  }
-  if(rank==size-1){
-    nProc=MPI_PROC_NULL;
-    bndB=Hp->bndD;
-  }else{
-    nProc=rank+1;
-    bndB=BND_INT;
+  for(i=0;i<size;i++){
+    MPI_Cart_coords(cartComm,i,2,coords);
+    blockRange(ext+4*i  ,Hp->nx,dims[1],coords[1]);
+    blockRange(ext+4*i+2,Hp->ny,dims[0],coords[0]);
+    counts[i]=ext[4*i+1]*ext[4*i+3];
+    dspls[i]=(i==0)?0:dspls[i-1]+counts[i-1];
   }
+  myNx=ext[4*rank+1];
+  myNy=ext[4*rank+3];
   
 
   //Calculate arraysizes
-  varSize=(Hp->nx+4)*(myNy+4);
-  if(myNy>=Hp->nx){
-    primSize=Hp->nvar*(Hp->nx+4)*myNy;
-    qSize   =Hp->nvar*(Hp->nx+2)*myNy;
-    flxSize =Hp->nvar*(Hp->nx+1)*myNy;
+  varSize=(myNx+4)*(myNy+4);
+  if(myNy>=myNx){
+    primSize=Hp->nvar*(myNx+4)*myNy;
+    qSize   =Hp->nvar*(myNx+2)*myNy;
+    flxSize =Hp->nvar*(myNx+1)*myNy;
   }else{
-    primSize=Hp->nvar*(myNy+4)*Hp->nx;
-    qSize   =Hp->nvar*(myNy+2)*Hp->nx;
-    flxSize =Hp->nvar*(myNy+1)*Hp->nx;
+    primSize=Hp->nvar*(myNy+4)*myNx;
+    qSize   =Hp->nvar*(myNy+2)*myNx;
+    flxSize =Hp->nvar*(myNy+1)*myNx;
   }
   //if(rank==0)printf("Done loc size calcs\n");
 
   //Allocate arrays
-  recvMesh=(double*)malloc(Hp->nvar*Hp->nx*myNy*sizeof(double));
+  recvMesh=(double*)malloc(Hp->nvar*myNx*myNy*sizeof(double));
+  gBuf=(rank==0)?(double*)malloc(Hp->nx*Hp->ny*sizeof(double)):NULL;
   lMesh =(double*)malloc(Hp->nvar*varSize*sizeof(double));
   q  =(double*)malloc(primSize*sizeof(double));
   qr =(double*)malloc(qSize*sizeof(double));
   ql =(double*)malloc(qSize*sizeof(double));
   flx=(double*)malloc(flxSize*sizeof(double));
+  //Shared by the x and y halos
+  bndSize=(myNx+4>myNy)?myNx+4:myNy;
+  bndLS=(double*)malloc(Hp->nvar*2*bndSize*sizeof(double));
+  bndLR=(double*)malloc(Hp->nvar*2*bndSize*sizeof(double));
+  bndHS=(double*)malloc(Hp->nvar*2*bndSize*sizeof(double));
+  bndHR=(double*)malloc(Hp->nvar*2*bndSize*sizeof(double));
 
   //if(rank==0)printf("Arrays allocated\n");
 
@@ -620,35 +1076,49 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
     lMesh[i]=0.0;
   }
 
-  //distribute over processors
-  for(nV=0;nV<Hp->nvar;nV++){
-    mpi_err=MPI_Scatterv(gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,0,MPI_COMM_WORLD);
+  chkTypes(ext);
+
+  //distribute over processors, a restart reads its block from the
+  //checkpoint instead
+  if(Ha->nstart>0){
+    mpi_err=readCheckpoint(lMesh);
+    if(mpi_err!=MPI_SUCCESS){
+      printf("Error reading checkpoint %s\n",Ha->initFile);
+    }
+  }
+  for(nV=0;nV<Hp->nvar&&Ha->nstart==0;nV++){
+    if(rank==0)packBlocks(gBuf,gMesh,ext,nV);
+    mpi_err=MPI_Scatterv(gBuf,counts,dspls,MPI_DOUBLE,recvMesh+nV*myNx*myNy,myNx*myNy,MPI_DOUBLE,0,MPI_COMM_WORLD);
     if(mpi_err!=MPI_SUCCESS){
       printf("Error scattering data to other processors\n");
     }
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)]=recvMesh[i+Hp->nx*(j+myNy*nV)];
+    for(lI=0;lI<myNx*myNy;lI++){
+      i=lI%(myNx);
+      j=lI/(myNx);
+      lMesh[i+2+(myNx+4)*(j+2+(myNy+4)*nV)]=recvMesh[i+myNx*(j+myNy*nV)];
     }
   }
 
   MPI_Barrier(MPI_COMM_WORLD);
   //sprintf(outLab,"Loc mesh n %d",rank);
-  //printArray(outLab,lMesh,4,Hp->nx+4,myNy+4);
+  //printArray(outLab,lMesh,4,myNx+4,myNy+4);
 
   if(rank==0)printf("Initial conditions distributed\n");
 
-  if(Ha->tend>0.0){
-    nxttout=Ha->tend;
-  }
-  if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
-    nxttout=Ha->dtoutput;
+  if(Ha->nstart>0){
+    nxttout=Ha->nxtstart;
+  }else{
+    if(Ha->tend>0.0){
+      nxttout=Ha->tend;
+    }
+    if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
+      nxttout=Ha->dtoutput;
+    }
   }
 
   volCell=Hp->dx*Hp->dy;
-  oTM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-  oTE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
+  oTM=sumArray(lMesh,VARRHO,myNx,myNy,2,2);
+  oTE=sumArray(lMesh,VARPR ,myNx,myNy,2,2);
 #ifdef M_PREC_CMP
   frexp(oTM,&M_exp);
   frexp(oTE,&E_exp);
@@ -659,46 +1129,69 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   if(rank==0)printf("TM:%g+-%g TE:%g+-%g\n",volCell*oTM,volCell*M_prec,volCell*oTE,volCell*E_prec);
 #endif
 
-  //Print initial condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+  //Print initial condition, a restart already wrote its vis files
+  if(Ha->nstart==0){
+    writeMeshVis(lMesh,recvMesh,gMesh,gBuf,counts,dspls,ext,n);
   }
   if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
     printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   }
+
+  //In-situ records written by rank 0, a restart appends to those of the
+  //original run
+  ins=NULL;
+  if(Ha->ninsitu>0){
+    if(rank==0){
+      snprintf(insName,sizeof(insName),"%s.ins",Ha->outPre);
+      ins=fopen(insName,(Ha->nstart>0)?"a":"w");
+      if(ins==NULL)printf("Could not open %s\n",insName);
+    }
+    if(Ha->nstart==0)writeInsitu(ins,lMesh,ext,n,cTime);
+  }
   
-  initT=MPI_Wtime();
+  initT=cody_now();
+  outT=cody_region_secs(rOut);
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-    //Calculate timestep
-    dt=Ha->sigma*calcDT(lMesh);
+    if(Ha->fusedReduce){
+      //One reduction for dt and the sums of the previous step, completed
+      //after the halo exchange of the first half-sweep
+      diag=(n>0&&n%Ha->nprtLine==0);
+      STAGE(ST_DT,postStepRed(lMesh,diag));
+      beginPass(lMesh,n%2);
+      STAGE(ST_DT,dt=Ha->sigma*finishStepRed(&TM,&TE));
+      if(diag&&rank==0){
+	printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,pDt,volCell*TM,volCell*TE);
+      }
+    }else{
+      //Calculate timestep
+      STAGE(ST_DT,dt=Ha->sigma*calcDT(lMesh));
+    }
     if(nxttout>0.0&&dt>(nxttout-cTime)){
       if(rank==0)printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
     }
-    if(n%2==0){
+    if(Ha->fusedReduce){
+      endPass(lMesh,dt,n%2);
+      runPass(lMesh,dt,1-n%2);
+    }else if(n%2==0){
       //X Dir
-      runPass(lMesh,dt,n,0);
+      runPass(lMesh,dt,0);
       //Y Dir
-      runPass(lMesh,dt,n,1);
+      runPass(lMesh,dt,1);
     }else{
       //Y Dir
-      runPass(lMesh,dt,n,1);
+      runPass(lMesh,dt,1);
       //X Dir
-      runPass(lMesh,dt,n,0);
+      runPass(lMesh,dt,0);
     }
     n+=1;
     cTime+=dt;
-    if(n%Ha->nprtLine==0){
-      TM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-      TE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
+    pDt=dt;
+    //The fused mode prints the sums of this step at the start of the next
+    if(n%Ha->nprtLine==0&&!Ha->fusedReduce){
+      TM=sumArray(lMesh,VARRHO,myNx,myNy,2,2);
+      TE=sumArray(lMesh,VARPR ,myNx,myNy,2,2);
       if(rank==0){
 	printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
 	if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
@@ -717,43 +1210,58 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//if(rank==0)printf("Next Vis Time: %f\n",nxttout);
       }
-      for(nV=0;nV<Hp->nvar;nV++){
-	for(lI=0;lI<Hp->nx*myNy;lI++){
-	  i=lI%(Hp->nx);
-	  j=lI/(Hp->nx);
-	  recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-	}
-	MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-      }
-      if(rank==0){
-	snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-	writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-	}
+      cody_region_begin(rOut);
+      STAGE(ST_VIS,writeMeshVis(lMesh,recvMesh,gMesh,gBuf,counts,dspls,ext,n));
+      cody_region_end(rOut);
+    }
+    if(Ha->nchkpt>0&&n%Ha->nchkpt==0){
+      cody_region_begin(rOut);
+      writeCheckpoint(lMesh,n,cTime,nxttout);
+      cody_region_end(rOut);
+    }
+    if(Ha->ninsitu>0&&n%Ha->ninsitu==0){
+      cody_region_begin(rOut);
+      writeInsitu(ins,lMesh,ext,n,cTime);
+      cody_region_end(rOut);
     }
   }
+  //The last step always gets a record
+  if(Ha->ninsitu>0){
+    if(n%Ha->ninsitu!=0)writeInsitu(ins,lMesh,ext,n,cTime);
+    if(ins!=NULL)fclose(ins);
+  }
+  //No following step reduces the sums of the last one
+  if(Ha->fusedReduce&&n>0&&n%Ha->nprtLine==0){
+    postStepRed(lMesh,1);
+    finishStepRed(&TM,&TE);
+    if(rank==0)printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,pDt,volCell*TM,volCell*TE);
+  }
   if(rank==0)printf("time: %f, %d iters run\n",cTime,n);
 
-  endT=MPI_Wtime();
+  endT=cody_now();
+  outT=cody_region_secs(rOut)-outT;
 
   if(rank==0){
-    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"MPI\"","\"CPU:?\"","\"Init\"",size,1,n,Hp->nx*Hp->ny,(endT-initT));
-  }
-
-  //Print final condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"MPI\"","\"CPU:?\"","\"Init\"",size,1,n,Hp->nx*Hp->ny,(endT-initT),endT-initT-outT,outT);
   }
+#if STAGE_TIMERS
+  //Slowest rank of each stage
+  MPI_Reduce(rank==0?MPI_IN_PLACE:stageT,stageT,NSTAGE,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
   if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+    printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"MPI\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
   }
-  Hp->t+=cTime;
+#endif
+  //The same run in the rows of every mini-app, the steps of this run only,
+  //timed on rank 0
+  if(rank==0)cody_report("hydro_c_mpi",size,1,(double)Hp->nx*Hp->ny,n-Ha->nstart,endT-initT);
+  cody_finish();
+
+  //Print final condition
+  writeMeshVis(lMesh,recvMesh,gMesh,gBuf,counts,dspls,ext,n);
+  visFinish();
+  Hp->t=cTime;
 
   free(recvMesh);
   free(lMesh);
@@ -761,6 +1269,19 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   free(qr );
   free(ql );
   free(flx);
+  free(bndLS);
+  free(bndLR);
+  free(bndHS);
+  free(bndHR);
+  free(ext);
+  free(counts);
+  free(dspls);
+  if(rank==0)free(gBuf);
+  MPI_Type_free(&chkFType);
+  MPI_Type_free(&chkMType);
+  MPI_Op_free(&redOp);
+  MPI_Type_free(&redType);
+  MPI_Comm_free(&cartComm);
 
   printf("NODE %d: Finalizing MPI\n",rank);
   MPI_Finalize();
@@ -5,6 +5,7 @@
 #include "hydro_defs.h"
 
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya);
+int readCheckpointHdr(char *fname, hydro_prob *Hyp, hydro_args *Hya);
 
 
 #endif //HYDRO_H_
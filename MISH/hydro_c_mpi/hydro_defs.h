@@ -9,6 +9,76 @@
 #define VARVY  2
 #define VARPR  3
 
+//Write a checkpoint to <outPre>.chk every n steps with collective MPI-IO,
+//the run is resumed with mpirun ./hydro rst <file> (-DCHKPT_STEPS=n)
+#ifndef CHKPT_STEPS
+#define CHKPT_STEPS 0
+#endif
+
+//Every n steps reduce the mesh over the ranks to its totals, the density
+//along the centerline and a density histogram of INSITU_BINS bins, and
+//append them to <outPre>.ins (-DINSITU_STEPS=n)
+#ifndef INSITU_STEPS
+#define INSITU_STEPS 0
+#endif
+#ifndef INSITU_BINS
+#define INSITU_BINS 32
+#endif
+
+//Write the vis files of the full mesh (-DVIS_DUMPS=0 writes none, e.g.
+//when the in-situ output is all the run needs)
+#ifndef VIS_DUMPS
+#define VIS_DUMPS 1
+#endif
+
+//Format of the vis dumps (-DVIS_FORMAT=n): ascii .vts, binary .vts with
+//the arrays appended raw, or one binary .vts per rank and a .pvts
+#define VIS_ASCII    0
+#define VIS_BINARY   1
+#define VIS_PARALLEL 2
+#ifndef VIS_FORMAT
+#define VIS_FORMAT VIS_ASCII
+#endif
+
+//Write the vis files from a background thread (-DVIS_ASYNC=1, link with
+//-pthread) so the engine keeps stepping during the write
+#ifndef VIS_ASYNC
+#define VIS_ASYNC 0
+#endif
+
+//Overlap the y halo exchange with the update of the interior rows
+//(-DHALO_OVERLAP=1)
+#ifndef HALO_OVERLAP
+#define HALO_OVERLAP 0
+#endif
+
+//Split the mesh over a 2D grid of ranks instead of slabs of rows
+//(-DDECOMP_2D=1)
+#ifndef DECOMP_2D
+#define DECOMP_2D 0
+#endif
+
+//Fuse the dt reduction and the conservation sums into one nonblocking
+//reduction that completes during the first half-sweep (-DFUSED_REDUCE=1)
+#ifndef FUSED_REDUCE
+#define FUSED_REDUCE 0
+#endif
+
+//Accumulate the time spent in each stage of the passes and print it as a
+//STAGE: line after the TIME: line (-DSTAGE_TIMERS=1)
+#ifndef STAGE_TIMERS
+#define STAGE_TIMERS 0
+#endif
+#define ST_DT    0
+#define ST_PRIM  1
+#define ST_BND   2
+#define ST_TRACE 3
+#define ST_RIEM  4
+#define ST_FLUX  5
+#define ST_HALO  6
+#define ST_VIS   7
+#define NSTAGE   8
+
 #define BND_REFL 0
 #define BND_PERM 1
 #define BND_INT 2
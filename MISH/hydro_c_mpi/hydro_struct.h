@@ -42,6 +42,34 @@ typedef struct __hydroArgs{
     int iorder;
     double slope_type;
     int scheme;
+
+    // Overlap the y halo exchange with the interior update
+    int haloOverlap;
+    // Split the mesh over a 2D process grid
+    int decomp2D;
+    // One nonblocking reduction for dt and the sums per step
+    int fusedReduce;
+
+    // Steps between checkpoints, 0 writes none
+    int nchkpt;
+    // Steps between in-situ records, 0 writes none
+    int ninsitu;
+    // Step and next vis time to resume from, set on restart
+    int nstart;
+    double nxtstart;
 } hydro_args;
 
+//Header of a checkpoint file, the nvar arrays of the global mesh follow it
+//at CHK_HDR_LEN bytes. prob.t is the time at step args.nstart
+#define CHK_MAGIC "MISHCHK"
+#define CHK_HDR_LEN 4096
+
+typedef struct __hydroChk{
+    char magic[8];
+    int hdrSize;
+    int elSize;
+    hydro_prob prob;
+    hydro_args args;
+} hydro_chk;
+
 #endif
@@ -20,9 +20,28 @@ int main(int argc, char* argv[]){
     else if(!strcmp(argv[1],"crn")) init=2;
     else if(!strcmp(argv[1],"wsc")) init=3;
     else if(!strcmp(argv[1],"scs")) init=4;
+    else if(!strcmp(argv[1],"rst")) init=5;
     else printf("Unknown init\n");
   }
 
+  //Resume from a checkpoint with the problem and options stored in it,
+  //the engine reads the mesh
+  if(init==5){
+    if(argc<3){
+      printf("No checkpoint file supplied\n");
+      return 1;
+    }
+    if(readCheckpointHdr(argv[2],&Hp,&Ha)){
+      return 1;
+    }
+    printf("INIT:%s\n",argv[1]);
+    printf("INIT:%s @ iter %d\n",Ha.initFile,Ha.nstart);
+    mesh=(double*)malloc(Hp.nvar*Hp.nx*Hp.ny*sizeof(double));
+    engine(&argc,&argv,mesh,&Hp,&Ha);
+    free(mesh);
+    return 1;
+  }
+
   //Get size multiplier
   if(init>2&&(argc<3||sscanf(argv[2],"%d",&pSMul)!=1)){
     printf("No problem size multiplier supplied\n");
@@ -119,6 +138,14 @@ int main(int argc, char* argv[]){
   Ha.smallr=1e-10;
   Ha.smallc=1e-10;
   Ha.niter_riemann=10;
+  Ha.haloOverlap=HALO_OVERLAP;
+  Ha.decomp2D=DECOMP_2D;
+  Ha.fusedReduce=FUSED_REDUCE;
+  Ha.nchkpt=CHKPT_STEPS;
+  Ha.ninsitu=INSITU_STEPS;
+  Ha.nstart=0;
+  Ha.nxtstart=-1.0;
+  Ha.initFile[0]='\0';
   
   for(j=0;j<Hp.ny;j++){
     for(i=0;i<Hp.nx;i++){
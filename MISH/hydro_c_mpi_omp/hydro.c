@@ -4,7 +4,12 @@
 #include <omp.h>
 #include <mpi.h>
 #include "hydro.h"
+#include "outfile.h"
+#include "cody_perf.h"
 #include "float.h"
+#if HUGE_PAGES
+#include <sys/mman.h>
+#endif
 
 hydro_args *Ha;
 hydro_prob *Hp;
@@ -21,6 +26,49 @@ int varSize;
 
 double slope(double *q,int ind);
 
+#if STAGE_TIMERS
+//Cumulative wall time of each stage on this rank, indexed by ST_*. Inside
+//a parallel region only the master thread's stages are counted
+double stageT[NSTAGE];
+#define STAGE(s,call) {double stT=MPI_Wtime(); call; if(omp_get_thread_num()==0)stageT[s]+=MPI_Wtime()-stT;}
+#else
+#define STAGE(s,call) call
+#endif
+
+//Allocates nvar arrays of varLen doubles back to back. The pages are first
+//touched by the threads of a static loop over the cells, the same split
+//as the stage loops, so they land on the NUMA node of the thread using
+//them. HUGE_PAGES aligns the block to and advises it onto huge pages
+double *allocArray(int nvar, size_t varLen){
+  double *arr;
+  long i;
+  int nV;
+  size_t len=nvar*varLen*sizeof(double);
+
+#if HUGE_PAGES
+  len=(len+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+  if(posix_memalign((void **)&arr,HUGE_PAGE_SIZE,len)!=0){
+    fprintf(stderr,"Failed to allocate %lu bytes\n",(unsigned long)len);
+    exit(1);
+  }
+  madvise(arr,len,MADV_HUGEPAGE);
+#else
+  arr=(double*)malloc(len);
+#endif
+#pragma omp parallel for schedule(static) private(nV)
+  for(i=0;i<(long)varLen;i++){
+    for(nV=0;nV<nvar;nV++){
+      arr[i+varLen*nV]=0.0;
+    }
+  }
+  return arr;
+}
+
+//First of the n items of block t of nT
+static inline int blockLo(int n, int nT, int t){
+  return (int)(((long)n*t)/nT);
+}
+
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
   //printf("N[%2d]: Array %s\n",rank,label);
@@ -114,11 +162,11 @@ void setHHalo(double *mesh, int LBnd, int RBnd){
   }
 }
 
-void setVHalo(double *mesh, int TBnd, int BBnd){
-  int lI, i,j;
+//Posts the exchange of the two rows next to each neighbor. The rows are
+//sent straight from the mesh, the passes do not write them until the wait
+void postVHalo(double *mesh, MPI_Request *reqs){
   int row=Hp->nx+4;
-  MPI_Request reqs[16];
-  MPI_Status stat[16];
+
   MPI_Irecv(mesh+(     0)*row+VARRHO*varSize,2*row,MPI_DOUBLE,pProc,1,MPI_COMM_WORLD,reqs+ 0);
   MPI_Irecv(mesh+(     0)*row+VARVX *varSize,2*row,MPI_DOUBLE,pProc,3,MPI_COMM_WORLD,reqs+ 1);
   MPI_Irecv(mesh+(     0)*row+VARVY *varSize,2*row,MPI_DOUBLE,pProc,5,MPI_COMM_WORLD,reqs+ 2);
@@ -135,8 +183,17 @@ void setVHalo(double *mesh, int TBnd, int BBnd){
   MPI_Irecv(mesh+(myNy+2)*row+VARVX *varSize,2*row,MPI_DOUBLE,nProc,4,MPI_COMM_WORLD,reqs+13);
   MPI_Irecv(mesh+(myNy+2)*row+VARVY *varSize,2*row,MPI_DOUBLE,nProc,6,MPI_COMM_WORLD,reqs+14);
   MPI_Irecv(mesh+(myNy+2)*row+VARPR *varSize,2*row,MPI_DOUBLE,nProc,8,MPI_COMM_WORLD,reqs+15);
+}
+
+//Waits for the exchange posted by postVHalo and sets the physical
+//boundaries. Called from inside a parallel region it runs on the calling
+//thread only
+void finishVHalo(double *mesh, MPI_Request *reqs, int TBnd, int BBnd){
+  int lI, i,j;
+  MPI_Status stat[16];
+
   MPI_Waitall(16,reqs,stat);
-#pragma omp parallel for private(i,j) shared(mesh,TBnd,BBnd,Hp,myNy)
+#pragma omp parallel for private(i,j) shared(mesh,TBnd,BBnd,Hp,myNy) if(!omp_in_parallel())
   for(lI=0;lI<2*Hp->nx;lI++){
     i=lI/2;
     j=lI%2;
@@ -167,6 +224,13 @@ void setVHalo(double *mesh, int TBnd, int BBnd){
   }
 }
 
+void setVHalo(double *mesh, int TBnd, int BBnd){
+  MPI_Request reqs[16];
+
+  postVHalo(mesh,reqs);
+  finishVHalo(mesh,reqs,TBnd,BBnd);
+}
+
 void toPrimX(double *q, double *mesh){
   int i;
   int xI, yI;
@@ -190,17 +254,20 @@ void toPrimX(double *q, double *mesh){
   }
 }
 
-void toPrimY(double *q, double *mesh){
+//toPrimY of the columns j0 to j1-1 and the mesh rows y0 to y1-1 (0 to
+//myNy+3). Splits its loop over the threads unless called from inside a
+//parallel region, where the calling thread runs all of it
+void toPrimYRange(double *q, double *mesh, int j0, int j1, int y0, int y1){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp prallel for private(xI,yI,r,vx,,vy,eint,p) shared(q,mesh,smallp,Ha,Hp,myNy)
-  for(i=0;i<(myNy+4)*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
+#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp,myNy) if(!omp_in_parallel())
+  for(i=0;i<(y1-y0)*(j1-j0);i++){
+    xI=j0+i%(j1-j0);
+    yI=y0+i/(j1-j0);
     r   =MAX(mesh[xI+2+yI*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
     vx  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVX ]/r;
     vy  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVY ]/r;
@@ -213,7 +280,13 @@ void toPrimY(double *q, double *mesh){
   }
 }
 
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+void toPrimY(double *q, double *mesh){
+  toPrimYRange(q,mesh,0,Hp->nx,0,myNy+4);
+}
+
+//Traced states of the pencils j0 to j1-1 at the positions i0 to i1-1 (0
+//to np+1)
+void traceRange(double *ql, double *qr, double *q, double dtdx, int np, int nt, int j0, int j1, int i0, int i1){
   int lI;
   int i,j;
   double  r, u, v1, p, a;
@@ -227,10 +300,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
 
 #pragma omp parallel for shared(q,qr,ql,dtdx,np,nt,Hp,Ha)\
   private(i,j,r,u,v1,p,dr,du,dv1,dp,cc,csq,ap,am,azr,azv1,acmp)	\
-  private(alpham,alphap,alphazr,spplus,spminus,spzerol,spzeror)
-  for(lI=0;lI<(np+2)*nt;lI++){
-    i=lI%(np+2);
-    j=lI/(np+2);
+  private(alpham,alphap,alphazr,spplus,spminus,spzerol,spzeror) if(!omp_in_parallel())
+  for(lI=0;lI<(i1-i0)*(j1-j0);lI++){
+    i=i0+lI%(i1-i0);
+    j=j0+lI/(i1-i0);
     r =q[i+1+(np+4)*(j+nt*VARRHO)];
     u =q[i+1+(np+4)*(j+nt*VARVX )];
     v1=q[i+1+(np+4)*(j+nt*VARVY )];
@@ -276,6 +349,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
   }
 }
 
+void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+  traceRange(ql,qr,q,dtdx,np,nt,0,nt,0,np+2);
+}
+
 double slope(double *q,int ind){
   double dlft, drgt, dcen, dsgn, dlim;
   //  printf("Calc slope for %d refs: [%d,%d,%d]\n",ind,ind-1,ind,ind+1);
@@ -289,7 +366,9 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+//Fluxes of the pencils j0 to j1-1 through the interfaces i0 to i1-1 (0 to
+//np)
+void riemannRange(double *flx, double *qxm, double *qxp, int np, int nt, int j0, int j1, int i0, int i1){
   int lI, i,j,n;
   double smallp, smallpp;
   double gmma6, entho;
@@ -313,10 +392,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   private(ro,vxo,po,wo,co)\
   private(rx,vxx,px,wx,cx)\
   private(spout,spin,ushk,delp)\
-  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot)
-  for(lI=0;lI<(np+1)*nt;lI++){
-    i=lI%(np+1);
-    j=lI/(np+1);
+  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot) if(!omp_in_parallel())
+  for(lI=0;lI<(i1-i0)*(j1-j0);lI++){
+    i=i0+lI%(i1-i0);
+    j=j0+lI/(i1-i0);
     
     rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],Ha->smallr);
     vxl=    qxm[i  +(np+2)*(j+nt*VARVX )];
@@ -409,6 +488,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
+void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+  riemannRange(flx,qxm,qxp,np,nt,0,nt,0,np+1);
+}
+
 void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   int lI, i, j;
 
@@ -427,13 +510,14 @@ void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+//Updates the cells i0 to i1-1 of the y pencils j0 to j1-1
+void addFluxYRange(double *mesh, double *flx, double dtdx, int np, int nt, int j0, int j1, int i0, int i1){
   int lI, i, j;
 
-#pragma omp parallel for private(i,j) shared(mesh,flx,dtdx,np,nt)
-  for(lI=0;lI<np*nt;lI++){
-    i=lI%np;
-    j=lI/np;
+#pragma omp parallel for private(i,j) shared(mesh,flx,dtdx,np,nt) if(!omp_in_parallel())
+  for(lI=0;lI<(i1-i0)*(j1-j0);lI++){
+    i=i0+lI%(i1-i0);
+    j=j0+lI/(i1-i0);
     mesh[j+2+(nt+4)*(i+2+(np+4)*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
 						flx[i+1+(np+1)*(j+nt*VARRHO)]);
     mesh[j+2+(nt+4)*(i+2+(np+4)*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
@@ -445,6 +529,10 @@ void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
+void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+  addFluxYRange(mesh,flx,dtdx,np,nt,0,nt,0,np);
+}
+
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   int lI,i,j;
   double sum, corr;
@@ -497,6 +585,49 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
+//The y pass in one parallel region. The master thread posts the halo
+//exchange and waits for it, MPI is only called from it (funneled), while
+//the other threads convert, trace and update the interior of their blocks
+//of pencils, the cells that do not depend on the halo. After a barrier
+//all the threads finish the two cells next to each end of their pencils.
+//A single thread updates the interior between the post and the wait
+void runVPassOverlap(double *mesh, double dtdx){
+  int np=myNy;
+  int nt=Hp->nx;
+  MPI_Request reqs[16];
+
+#pragma omp parallel shared(mesh,dtdx,np,nt,reqs)
+  {
+    int tI=omp_get_thread_num();
+    int nT=omp_get_num_threads();
+    int nW=(nT>1)?nT-1:1;
+    int w =(nT>1)?tI-1:0;
+    int j0,j1;
+
+    if(tI==0)STAGE(ST_HALO,postVHalo(mesh,reqs));
+    if(nT==1||tI>0){
+      j0=blockLo(nt,nW,w);
+      j1=blockLo(nt,nW,w+1);
+      STAGE(ST_PRIM,toPrimYRange(q,mesh,j0,j1,2,np+2));
+      STAGE(ST_TRACE,traceRange(ql,qr,q,dtdx,np,nt,j0,j1,2,np));
+      STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,j0,j1,2,np-1));
+      STAGE(ST_FLUX,addFluxYRange(mesh,flx,dtdx,np,nt,j0,j1,2,np-2));
+    }
+    if(tI==0)STAGE(ST_HALO,finishVHalo(mesh,reqs,bndT,bndB));
+#pragma omp barrier
+    j0=blockLo(nt,nT,tI);
+    j1=blockLo(nt,nT,tI+1);
+    STAGE(ST_PRIM,toPrimYRange(q,mesh,j0,j1,0,2));
+    STAGE(ST_PRIM,toPrimYRange(q,mesh,j0,j1,np+2,np+4));
+    STAGE(ST_TRACE,traceRange(ql,qr,q,dtdx,np,nt,j0,j1,0,2));
+    STAGE(ST_TRACE,traceRange(ql,qr,q,dtdx,np,nt,j0,j1,np,np+2));
+    STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,j0,j1,0,2));
+    STAGE(ST_RIEM,riemannRange(flx,ql,qr,np,nt,j0,j1,np-1,np+1));
+    STAGE(ST_FLUX,addFluxYRange(mesh,flx,dtdx,np,nt,j0,j1,0,2));
+    STAGE(ST_FLUX,addFluxYRange(mesh,flx,dtdx,np,nt,j0,j1,np-2,np));
+  }
+}
+
 void runPass(double *mesh, double dt, int n, int dir){
   int np,nt;
   double dx,dy;
@@ -511,8 +642,8 @@ void runPass(double *mesh, double dt, int n, int dir){
     dy=Hp->dy;
     dCh='x';
     //printf("N[%2d]:X-pass\n",rank);
-    setHHalo(mesh,Hp->bndL,Hp->bndR);
-    toPrimX(q,mesh);
+    STAGE(ST_HALO,setHHalo(mesh,Hp->bndL,Hp->bndR));
+    STAGE(ST_PRIM,toPrimX(q,mesh));
   }else{
     np=myNy;
     nt=Hp->nx;
@@ -520,29 +651,67 @@ void runPass(double *mesh, double dt, int n, int dir){
     dy=Hp->dx;
     dCh='y';
     //printf("N[%2d]:Y-pass\n",rank);
-    setVHalo(mesh,bndT,bndB);
-    toPrimY(q,mesh);
+    //Needs a slab of at least 4 rows to have an interior
+    if(Ha->haloOverlap&&myNy>=4){
+      runVPassOverlap(mesh,dt/dx);
+      return;
+    }
+    STAGE(ST_HALO,setVHalo(mesh,bndT,bndB));
+    STAGE(ST_PRIM,toPrimY(q,mesh));
   }
   //sprintf(outLab,"MESH-%c",dCh);
   //if(rank==0)printArray(outLab,mesh,Hp->nvar,Hp->nx+4,myNy+4);
   //sprintf(outLab,"Q   -%c",dCh);
   //if(rank==0)printArray(outLab,q,Hp->nvar,np+4,nt);
-  trace(ql,qr,q,dt/dx,np,nt);
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dx,np,nt));
   //sprintf(outLab,"QL  -%c",dCh);
   //if(rank==0)printArray(outLab,ql,Hp->nvar,np+2,nt);
   //sprintf(outLab,"QR  -%c",dCh);
   //if(rank==0)printArray(outLab,qr,Hp->nvar,np+2,nt);
-  riemann(flx,ql,qr,np,nt);
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt));
   //sprintf(outLab,"FLX -%c",dCh);
   //if(rank==0)printArray(outLab,flx,Hp->nvar,np+1,nt);
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dx,np,nt));
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dx,np,nt));
   }
   //printArray("Post-pass",mesh,Hp->nvar,Hp->nx+4,myNy+4);
 }
 
+//Writes the vis file of step n. The interior of every rank is packed into
+//recvMesh, then either each rank writes its own slab (VIS_PARALLEL) or the
+//slabs are gathered into gMesh and written by rank 0
+void writeMeshVis(double *lMesh, double *recvMesh, double *gMesh, int *counts, int *dspls, int n){
+  int nV,lI,i,j;
+  char outfile[30];
+
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<Hp->nx*myNy;lI++){
+      i=lI%(Hp->nx);
+      j=lI/(Hp->nx);
+      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
+    }
+  }
+  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+#if VIS_FORMAT==VIS_PARALLEL
+  ext=(int *)malloc(4*size*sizeof(int));
+  for(p=0;p<size;p++){
+    ext[4*p  ]=0;
+    ext[4*p+1]=Hp->nx;
+    ext[4*p+2]=dspls[p]/Hp->nx;
+    ext[4*p+3]=counts[p]/Hp->nx;
+  }
+  writeVisParAsync(outfile,recvMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny,ext,rank,size);
+  free(ext);
+#else
+  for(nV=0;nV<Hp->nvar;nV++){
+    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+  }
+  if(rank==0)writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+#endif
+}
+
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, nV, lI, i,j;
   int bndL;
@@ -564,12 +733,17 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   size_t primSize, qSize, flxSize;
 
   double initT, endT;
+  double outT;
+  int rOut;
 
   int mpi_err;
+  int thLevel;
 
   int *counts, *dspls;
 
-  mpi_err=MPI_Init(argc,argv);
+  //The overlapped y pass calls MPI from the master thread of a parallel
+  //region, the rest of the engine only outside of them
+  mpi_err=MPI_Init_thread(argc,argv,MPI_THREAD_FUNNELED,&thLevel);
 
   if(mpi_err!=MPI_SUCCESS){
     printf("Error initializing MPI\n");
@@ -578,6 +752,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   Hp=Hyp;
   Ha=Hya;
 
+  cody_init("MISH");
+  rOut=cody_region("out");
+
   n=0;
   cTime=0;
   nxttout=-1.0;
@@ -588,6 +765,10 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   //Calculate sizes for dispersal
   MPI_Comm_size(MPI_COMM_WORLD,&size);
   MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  if(Ha->haloOverlap&&thLevel<MPI_THREAD_FUNNELED){
+    if(rank==0)printf("MPI_THREAD_FUNNELED not provided, the y halo exchange will not be overlapped\n");
+    Ha->haloOverlap=0;
+  }
   //if(rank==0)printf("Before loc size calcs\n");
   counts=(int *)malloc(size*sizeof(int));
   dspls=(int *)malloc(size*sizeof(int));
@@ -633,19 +814,14 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 
   //Allocate arrays
   recvMesh=(double*)malloc(Hp->nvar*Hp->nx*myNy*sizeof(double));
-  lMesh =(double*)malloc(Hp->nvar*varSize*sizeof(double));
-  q  =(double*)malloc(primSize*sizeof(double));
-  qr =(double*)malloc(qSize*sizeof(double));
-  ql =(double*)malloc(qSize*sizeof(double));
-  flx=(double*)malloc(flxSize*sizeof(double));
+  lMesh =allocArray(Hp->nvar,varSize);
+  q  =allocArray(Hp->nvar,primSize/Hp->nvar);
+  qr =allocArray(Hp->nvar,qSize/Hp->nvar);
+  ql =allocArray(Hp->nvar,qSize/Hp->nvar);
+  flx=allocArray(Hp->nvar,flxSize/Hp->nvar);
 
   //if(rank==0)printf("Arrays allocated\n");
 
-  //Zero lMesh
-  for(i=0;i<Hp->nvar*varSize;i++){
-    lMesh[i]=0.0;
-  }
-
   //distribute over processors
   for(nV=0;nV<Hp->nvar;nV++){
     mpi_err=MPI_Scatterv(gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,0,MPI_COMM_WORLD);
@@ -686,25 +862,17 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 #endif
 
   //Print initial condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
+  writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n);
   if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
     printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   }
   
-  initT=MPI_Wtime();
+  initT=cody_now();
+  outT=cody_region_secs(rOut);
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
     //Calculate timestep
-    dt=Ha->sigma*calcDT(lMesh);
+    STAGE(ST_DT,dt=Ha->sigma*calcDT(lMesh));
     if(nxttout>0.0&&dt>(nxttout-cTime)){
       if(rank==0)printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
@@ -743,42 +911,35 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//if(rank==0)printf("Next Vis Time: %f\n",nxttout);
       }
-      for(nV=0;nV<Hp->nvar;nV++){
-	for(lI=0;lI<Hp->nx*myNy;lI++){
-	  i=lI%(Hp->nx);
-	  j=lI/(Hp->nx);
-	  recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-	}
-	MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-      }
-      if(rank==0){
-	snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-	writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-	}
+      cody_region_begin(rOut);
+      STAGE(ST_VIS,writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n));
+      cody_region_end(rOut);
     }
   }
   if(rank==0)printf("time: %f, %d iters run\n",cTime,n);
 
-  endT=MPI_Wtime();
+  endT=cody_now();
+  outT=cody_region_secs(rOut)-outT;
 
   if(rank==0){
-    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"MPI/OMP\"","\"CPU:?\"","\"Init\"",size,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT));
-  }
-
-  //Print final condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"MPI/OMP\"","\"CPU:?\"","\"Init\"",size,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT),endT-initT-outT,outT);
   }
+#if STAGE_TIMERS
+  //Slowest rank of each stage
+  MPI_Reduce(rank==0?MPI_IN_PLACE:stageT,stageT,NSTAGE,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
   if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+    printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"MPI/OMP\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
   }
+#endif
+  //The same run in the rows of every mini-app, timed on rank 0
+  if(rank==0)cody_report("hydro_c_mpi_omp",size,omp_get_max_threads(),(double)Hp->nx*Hp->ny,n,endT-initT);
+  cody_finish();
+
+  //Print final condition
+  writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n);
+  visFinish();
   Hp->t+=cTime;
 
   free(recvMesh);
@@ -4,6 +4,7 @@
 #include "hydro_struct.h"
 #include "hydro_defs.h"
 
+double *allocArray(int nvar, size_t varLen);
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya);
 
 
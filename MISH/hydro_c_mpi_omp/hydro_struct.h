@@ -42,6 +42,9 @@ typedef struct __hydroArgs{
     int iorder;
     double slope_type;
     int scheme;
+
+    // Overlap the y halo exchange with the interior update
+    int haloOverlap;
 } hydro_args;
 
 #endif
@@ -119,6 +119,7 @@ int main(int argc, char* argv[]){
   Ha.smallr=1e-10;
   Ha.smallc=1e-10;
   Ha.niter_riemann=10;
+  Ha.haloOverlap=HALO_OVERLAP;
   
   for(j=0;j<Hp.ny;j++){
     for(i=0;i<Hp.nx;i++){
@@ -3,8 +3,9 @@
 #include <math.h>
 //#include <openacc.h>
 #include <time.h>
-#include <sys/time.h>
 #include "hydro.h"
+#include "outfile.h"
+#include "cody_perf.h"
 #include "float.h"
 
 hydro_args *Ha;
@@ -16,21 +17,25 @@ double *flx;
 
 size_t meshSize, primSize, qSize, flxSize;
 
+//Queue the pass kernels are launched on, the host only waits on it when
+//it needs a result (dt, the sums or a vis dump)
+#define ACC_Q 1
+
+#if STAGE_TIMERS
+//Cumulative wall time of each stage, indexed by ST_*. The queue is waited
+//on after every stage so the time is that of its kernels
+double stageT[NSTAGE];
+#define STAGE(s,call) {double stT=getNow(); call; _Pragma("acc wait(ACC_Q)") stageT[s]+=getNow()-stT;}
+#else
+#define STAGE(s,call) call
+#endif
 
 double slope(double *q,int ind);
 
-//Utility function to get wall runtime
+//Utility function to get wall runtime, the monotonic clock all the
+//mini-apps time with
 double getNow(){
-  struct timeval tv;
-  struct timezone tz;
-  double t;
-
-  gettimeofday(&tv, &tz);
-
-  t = (double)tv.tv_sec;
-  t += ((double)tv.tv_usec)/1000000.0;
-
-  return t;
+  return cody_now();
 }
 
 
@@ -73,8 +78,8 @@ double calcDT(double *mesh){
   smallr=Ha->smallr;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma acc kernels pcopyin(mesh[0:meshSize]) copyin(smallp,smallr,gamma,nx,ny,dx,dy)
-#pragma acc loop independent reduction(max:max_denom) private(r,vx,vy,eint,p,c,cx,cy,denom) 
+#pragma acc parallel loop present(mesh[0:meshSize]) wait(ACC_Q)\
+  reduction(max:max_denom) private(r,vx,vy,eint,p,c,cx,cy,denom)
   for(i=0; i<nx*ny; i++){
     r   =fmax(mesh[i+nx*ny*VARRHO],smallr);
     vx  =     mesh[i+nx*ny*VARVX ]/r;
@@ -101,11 +106,8 @@ void toPrimX(double *q, double *mesh){
   smallr=Ha->smallr;
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
 
-#pragma acc kernels \
-  pcopyin(mesh[0:meshSize])\
-  pcopyout(q[0:primSize])\
-  copyin(nx,ny,gamma,smallr,smallp)
-#pragma acc loop independent private(i,xI,yI,r,vx,vy,eint,p)
+#pragma acc parallel loop present(mesh[0:meshSize],q[0:primSize]) async(ACC_Q)\
+  private(xI,yI,r,vx,vy,eint,p)
   for(i=0;i<ny*nx;i++){
     xI=i%nx;
     yI=i/nx;
@@ -131,10 +133,8 @@ void toPrimY(double *q, double *mesh){
   smallr=Ha->smallr;
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
 
-#pragma acc kernels pcopyin(mesh[0:meshSize])\
-  pcopyout(q[0:primSize])\
-  copyin(gamma,smallr,smallp)
-#pragma acc loop independent private(xI,yI,r,vx,vy,eint,p)
+#pragma acc parallel loop present(mesh[0:meshSize],q[0:primSize]) async(ACC_Q)\
+  private(xI,yI,r,vx,vy,eint,p)
   for(i=0;i<ny*nx;i++){
     xI=i%nx;
     yI=i/nx;
@@ -158,9 +158,8 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
 
   //printf("Running bnd cnds for %dx%d prims\n",np,nt);
 
-#pragma acc kernels \
-  pcopy(q[0:primSize])
-#pragma acc loop independent private(pI,tI,wInd,rInd)
+#pragma acc parallel loop present(q[0:primSize]) async(ACC_Q)\
+  private(pI,tI,wInd,rInd)
   for(i=0;i<2*nt;i++){
     pI=i%2;
     tI=i/2;
@@ -209,8 +208,9 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
 
   gamma=Hp->gamma;
 
-#pragma acc kernels pcopyin(q[0:primSize]) pcopyout(qr[0:qSize],ql[0:qSize]) copyin(gamma,dtdx,np,nt)
-#pragma acc loop independent private(i,j,r,u,v1,p,csq,cc,dr,du,dv1,dp,ap,am,azr,azv1,acmp)
+#pragma acc parallel loop present(q[0:primSize],qr[0:qSize],ql[0:qSize]) async(ACC_Q)\
+  private(i,j,r,u,v1,p,csq,cc,dr,du,dv1,dp,ap,am,azr,azv1,acmp)\
+  private(dlft,drgt,dcen,dlim,alpham,alphap,alphazr,spplus,spzerol,spzeror,spminus)
   for(lI=0;lI<(np+2)*nt;lI++){
     i=lI%(np+2);
     j=lI/(np+2);
@@ -313,8 +313,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
 
-#pragma acc kernels pcopyin(qxm[0:qSize],qxp[0:qSize]) pcopyout(flx[0:flxSize]) pcopyin(np,nt,gamma,smallr,smallc,smallp,smallpp,gmma6,entho)
-#pragma acc loop independent
+#pragma acc parallel loop present(qxm[0:qSize],qxp[0:qSize],flx[0:flxSize]) async(ACC_Q)\
+  private(i,j,n,qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,rl,vxl,vyl,pl,cl,wl,ql,vsl)\
+  private(rr,vxr,vyr,pr,cr,wr,qr,vsr,ro,vxo,po,wo,co,rx,vxx,px,wx,cx)\
+  private(sgnm,scr,frac,spout,spin,ushk,ekin,etot,delp)
   for(lI=0;lI<(np+1)*nt;lI++){
     i=lI%(np+1);
     j=lI/(np+1);
@@ -413,8 +415,8 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
 void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   int lI, i, j;
 
-#pragma acc kernels pcopy(mesh[0:meshSize]) pcopyin(flx[0:flxSize]) pcopyin(dtdx,np,nt)
-#pragma acc loop independent
+#pragma acc parallel loop present(mesh[0:meshSize],flx[0:flxSize]) async(ACC_Q)\
+  private(i,j)
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
@@ -432,8 +434,8 @@ void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
 void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
   int lI, i, j;
 
-#pragma acc kernels pcopy(mesh[0:meshSize]) pcopyin(flx[0:flxSize]) pcopyin(dtdx,np,nt)
-#pragma acc loop independent
+#pragma acc parallel loop present(mesh[0:meshSize],flx[0:flxSize]) async(ACC_Q)\
+  private(i,j)
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
@@ -484,9 +486,8 @@ double sumArray(double *mesh, int var, int nx, int ny){
   sum=0.0;
   corr=0.0;
 
-#pragma acc kernels \
-  pcopyin(mesh[0:meshSize])
-#pragma acc loop independent reduction(+:sum,corr)
+#pragma acc parallel loop pcopyin(mesh[0:meshSize]) wait(ACC_Q)\
+  reduction(+:sum,corr) private(c_nxt,nsum)
   for(i=0;i<nx*ny;i++){
     c_nxt=mesh[i+nx*ny*var];
     nsum=sum+c_nxt;
@@ -525,22 +526,22 @@ void runPass(double *mesh, double dt, int n, int dir){
   //nanScan(nanList,mesh,4,nx,ny,0,0);
   //printf("Pre-pass mesh: %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
   if(dir==0){
-    toPrimX(q,mesh);
+    STAGE(ST_PRIM,toPrimX(q,mesh));
   }else{
-    toPrimY(q,mesh);
+    STAGE(ST_PRIM,toPrimY(q,mesh));
   }
   //printf("Primitives done\n");
   //#pragma acc update host(q[0:primSize])
   //nanScan(nanList,q,4,np,nt,2,0);
   //printArray("Q   :",q,4,np,nt,2,0);
   //printf("Prim: %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
-  setBndCnd(q,bndL,bndH,np,nt);
+  STAGE(ST_BND,setBndCnd(q,bndL,bndH,np,nt));
   //printf("Bnd cnds set\n");
   //#pragma acc update host(q[0:primSize])
   //nanScan(nanList,q,4,np+4,nt,0,0);
   //printArray("QBND:",q,4,np+4,nt,0,0);
   //printf("Prim(bnd): %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
-  trace(ql,qr,q,dt/dx,np,nt);
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dx,np,nt));
   //#pragma acc update host(qr[0:qSize],ql[0:qSize])
   //printf("Trace complete\n");
   //nanScan(nanList,ql,4,np+2,nt,0,0);
@@ -549,16 +550,16 @@ void runPass(double *mesh, double dt, int n, int dir){
   //nanScan(nanList,qr,4,np+2,nt,0,0);
   //printArray("QR  :",qr,4,np+2,nt,0,0);
   //printf("QR: %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
-  riemann(flx,ql,qr,np,nt);
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt));
   //printf("Riemann and flx computation complete\n");
   //#pragma acc update host(flx[0:flxSize])
   //nanScan(nanList,flx,4,np+1,nt,0,0);
   //printArray("FLX :",flx,4,np+1,nt,0,0);
   //printf("FLX: %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dx,np,nt));
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dx,np,nt));
   }
   //printf("Flx added\n");
   //#pragma acc update host(mesh[0:meshSize])
@@ -583,12 +584,17 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   char outfile[30];
 
   double initT, endT;
+  double outT;
+  int rOut;
 
   Hp=Hyp;
   Ha=Hya;
   nx=Hp->nx;
   ny=Hp->ny;
 
+  cody_init("MISH");
+  rOut=cody_region("out");
+
   n=0;
   cTime=0;
   nxttout=-1.0;
@@ -637,17 +643,20 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 
   //Print initial condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   
   initT=getNow();
+  outT=cody_region_secs(rOut);
 
+  //The kernels only check for presence inside this region, the host copy
+  //of the mesh is refreshed for the vis dumps
 #pragma acc data copy(mesh[0:meshSize]) create(q[0:primSize],qr[0:qSize],ql[0:qSize],flx[0:flxSize])
   {
     while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
       //Calculate timestep
       //printf("Timestep calculation\n");
-      dt=Ha->sigma*calcDT(mesh);
+      STAGE(ST_DT,dt=Ha->sigma*calcDT(mesh));
       //printf("DT=%g\n",dt);
       if(nxttout>0.0&&dt>(nxttout-cTime)){
 	printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
@@ -685,23 +694,35 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 	  if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	  //printf("Next Vis Time: %f\n",nxttout);
 	}
-        //#pragma acc update host(mesh[0:meshSize])
+#pragma acc update host(mesh[0:meshSize]) wait(ACC_Q)
+	cody_region_begin(rOut);
 	snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-	writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+	STAGE(ST_VIS,writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny));
+	cody_region_end(rOut);
         printf("Vis. file \"%s\" written.\n",outfile);
       }
     }
+#pragma acc wait(ACC_Q)
   }
   printf("time: %f, %d iters run\n",cTime,n);
 
   endT=getNow();
+  outT=cody_region_secs(rOut)-outT;
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"OAC\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,endT-initT);
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"OAC\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,endT-initT,endT-initT-outT,outT);
+#if STAGE_TIMERS
+  printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+  printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"OAC\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
+#endif
+  //The same run in the rows of every mini-app
+  cody_report("hydro_c_oac",1,1,(double)Hp->nx*Hp->ny,n,endT-initT);
+  cody_finish();
 
   //Print final condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  visFinish();
 
   Hp->t+=cTime;
   free(q  );
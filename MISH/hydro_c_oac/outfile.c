@@ -1,14 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "hydro_struct.h"
 #include "hydro_defs.h"
+#if VIS_ASYNC
+#include <pthread.h>
+#endif
+
+void writeVisBin(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny);
 
 void writeVis(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny){
   int i,j,nv,argInd;
   FILE *vis;
   char outName[53], *ext;
   char name[30];
+  
+#if VIS_FORMAT!=VIS_ASCII
+  writeVisBin(fname,u,dx,dy,nvar,nx,ny);
+  return;
+#endif
 
   strncpy(outName,fname,50);
   outName[49]='\0';
@@ -101,3 +112,330 @@ void writeVis(char* fname, double *u, double dx, double dy, int nvar, int nx, in
   fclose(vis);
 }
 
+//Name of a state variable in the binary and parallel files
+static void visVarName(char *name, int nv){
+  switch(nv){
+  case VARRHO:
+    sprintf(name, "Density");
+    break;
+  case VARVX:
+    sprintf(name, "MomX");
+    break;
+  case VARVY:
+    sprintf(name, "MomY");
+    break;
+  case VARPR:
+    sprintf(name, "ENE");
+    break;
+  default:
+    sprintf(name, "var%d", nv);
+    break;
+  }
+}
+
+//Builds the output name, fname with its extension replaced by ext
+static void visFileName(char *outName, int len, char *fname, const char *ext){
+  char *dot;
+
+  strncpy(outName,fname,len-12);
+  outName[len-12]='\0';
+  if(!(dot=strrchr(outName,'.'))||strchr(dot,'/')) dot=strchr(outName,'\0');
+  sprintf(dot,"%s",ext);
+}
+
+//Writes the nx x ny block starting at cell (xOff,yOff) of a gnx x gny
+//mesh as a .vts file with Float64 arrays appended as raw binary. Each
+//array is a single fwrite, the points are written a row at a time
+void writeVisPiece(char* outName, double *u, double dx, double dy, int nvar, int nx, int ny,
+		   int gnx, int gny, int xOff, int yOff){
+  int i,j,nv;
+  FILE *vis;
+  char name[30];
+  uint64_t offset, cellBytes, pointBytes;
+  double *row;
+  union{ int i; char c; } endian;
+
+  vis=fopen(outName,"wb");
+  if(vis==NULL){
+    fprintf(stderr,"Could not open file %s\n",outName);
+    return;
+  }
+  endian.i=1;
+  cellBytes=(uint64_t)nx*ny*sizeof(double);
+  pointBytes=(uint64_t)(nx+1)*(ny+1)*3*sizeof(double);
+
+  fprintf(vis, "<?xml version=\"1.0\"?>\n");
+  fprintf(vis, "<VTKFile type=\"StructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n",
+	  endian.c?"LittleEndian":"BigEndian");
+  fprintf(vis, "<StructuredGrid WholeExtent=\"%d %d %d %d %d %d\">\n", 0, gnx, 0, gny, 0, 0);
+  fprintf(vis, "<Piece Extent=\"%d %d %d %d %d %d\">\n", xOff, xOff+nx, yOff, yOff+ny, 0, 0);
+  fprintf(vis, "<PointData></PointData>\n");
+
+  fprintf(vis, "<CellData Scalars=\"");
+  for (nv = 0; nv < nvar; nv++){
+    visVarName(name,nv);
+    fprintf(vis, "%s%s", nv?" ":"", name);
+  }
+  fprintf(vis, "\">\n");
+
+  //Each appended array is its size in bytes followed by the data
+  offset=0;
+  for (nv = 0; nv < nvar; nv++){
+    visVarName(name,nv);
+    fprintf(vis, "<DataArray type=\"Float64\" Name=\"%s\" format=\"appended\" offset=\"%llu\"/>\n",
+	    name, (unsigned long long)offset);
+    offset+=sizeof(uint64_t)+cellBytes;
+  }
+  fprintf(vis, "</CellData>\n");
+  fprintf(vis, "<Points>\n");
+  fprintf(vis, "<DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n",
+	  (unsigned long long)offset);
+  fprintf(vis, "</Points>\n");
+  fprintf(vis, "</Piece>\n");
+  fprintf(vis, "</StructuredGrid>\n");
+  fprintf(vis, "<AppendedData encoding=\"raw\">\n_");
+
+  for (nv = 0; nv < nvar; nv++){
+    fwrite(&cellBytes,sizeof(uint64_t),1,vis);
+    fwrite(u+(size_t)nv*nx*ny,sizeof(double),(size_t)nx*ny,vis);
+  }
+
+  fwrite(&pointBytes,sizeof(uint64_t),1,vis);
+  row=(double*)malloc(3*(nx+1)*sizeof(double));
+  for (j = yOff; j <= yOff+ny; j++){
+    for (i = 0; i <= nx; i++){
+      row[3*i  ]=(xOff+i) * dx;
+      row[3*i+1]=j * dy;
+      row[3*i+2]=0.0;
+    }
+    fwrite(row,sizeof(double),3*(nx+1),vis);
+  }
+  free(row);
+
+  fprintf(vis, "\n</AppendedData>\n");
+  fprintf(vis, "</VTKFile>\n");
+  fclose(vis);
+}
+
+//Binary version of writeVis
+void writeVisBin(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny){
+  char outName[64];
+
+  visFileName(outName,64,fname,".vts");
+  writeVisPiece(outName,u,dx,dy,nvar,nx,ny,nx,ny,0,0);
+}
+
+//Parallel output, called by every rank with its own block of the gnx x gny
+//mesh. ext holds the first column, number of columns, first row and number
+//of rows of the block of every rank. Each rank writes fname_<rank>.vts and
+//rank 0 also writes fname.pvts
+void writeVisPar(char* fname, double *u, double dx, double dy, int nvar, int gnx, int gny,
+		 int *ext, int rank, int nRank){
+  int nv,p;
+  FILE *vis;
+  char outName[64], pieceExt[16], name[30];
+  char *base;
+
+  sprintf(pieceExt,"_%04d.vts",rank);
+  visFileName(outName,64,fname,pieceExt);
+  writeVisPiece(outName,u,dx,dy,nvar,ext[4*rank+1],ext[4*rank+3],gnx,gny,ext[4*rank],ext[4*rank+2]);
+  if(rank!=0) return;
+
+  visFileName(outName,64,fname,".pvts");
+  vis=fopen(outName,"w");
+  if(vis==NULL){
+    fprintf(stderr,"Could not open file %s\n",outName);
+    return;
+  }
+  fprintf(vis, "<?xml version=\"1.0\"?>\n");
+  fprintf(vis, "<VTKFile type=\"PStructuredGrid\" version=\"1.0\">\n");
+  fprintf(vis, "<PStructuredGrid WholeExtent=\"%d %d %d %d %d %d\" GhostLevel=\"0\">\n", 0, gnx, 0, gny, 0, 0);
+  fprintf(vis, "<PPointData></PPointData>\n");
+  fprintf(vis, "<PCellData>\n");
+  for (nv = 0; nv < nvar; nv++){
+    visVarName(name,nv);
+    fprintf(vis, "<PDataArray type=\"Float64\" Name=\"%s\"/>\n", name);
+  }
+  fprintf(vis, "</PCellData>\n");
+  fprintf(vis, "<PPoints>\n");
+  fprintf(vis, "<PDataArray type=\"Float64\" NumberOfComponents=\"3\"/>\n");
+  fprintf(vis, "</PPoints>\n");
+
+  //Pieces are referenced relative to the .pvts file
+  for (p = 0; p < nRank; p++){
+    sprintf(pieceExt,"_%04d.vts",p);
+    visFileName(outName,64,fname,pieceExt);
+    base=strrchr(outName,'/');
+    base=base?base+1:outName;
+    fprintf(vis, "<Piece Extent=\"%d %d %d %d %d %d\" Source=\"%s\"/>\n",
+	    ext[4*p], ext[4*p]+ext[4*p+1], ext[4*p+2], ext[4*p+2]+ext[4*p+3], 0, 0, base);
+  }
+  fprintf(vis, "</PStructuredGrid>\n");
+  fprintf(vis, "</VTKFile>\n");
+  fclose(vis);
+}
+
+//Asynchronous vis dumps. The mesh is copied into one of two staging
+//buffers and written by a writer thread (VIS_ASYNC=1, needs -pthread)
+//while the engine keeps stepping. The engine only waits when both buffers
+//are still waiting to be written. Without VIS_ASYNC the same calls write
+//the file before returning
+typedef struct{
+  double *buf;
+  size_t size;
+  int full;
+  int par;
+  char fname[30];
+  double dx, dy;
+  int nvar, nx, ny, gnx, gny, rank, nRank;
+  int *ext;
+} visJob;
+
+static visJob visJobs[2];
+static int visNext=0;
+
+static void visWriteJob(visJob *job){
+  if(job->par){
+    writeVisPar(job->fname,job->buf,job->dx,job->dy,job->nvar,job->gnx,job->gny,
+		job->ext,job->rank,job->nRank);
+  }else{
+    writeVis(job->fname,job->buf,job->dx,job->dy,job->nvar,job->nx,job->ny);
+  }
+}
+
+#if VIS_ASYNC
+static pthread_t visThread;
+static pthread_mutex_t visLock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t visCond=PTHREAD_COND_INITIALIZER;
+static int visRunning=0, visDone=0;
+
+//Writes the jobs in the order they were submitted
+static void *visWriter(void *arg){
+  int cur=0;
+
+  pthread_mutex_lock(&visLock);
+  while(1){
+    while(!visJobs[cur].full&&!visDone) pthread_cond_wait(&visCond,&visLock);
+    if(!visJobs[cur].full) break;
+    pthread_mutex_unlock(&visLock);
+    visWriteJob(visJobs+cur);
+    pthread_mutex_lock(&visLock);
+    visJobs[cur].full=0;
+    pthread_cond_broadcast(&visCond);
+    cur^=1;
+  }
+  pthread_mutex_unlock(&visLock);
+  return NULL;
+}
+#endif
+
+//Returns a staging buffer of at least size doubles for the next dump,
+//waiting for the writer if it still holds the buffer
+double *visStage(size_t size){
+  visJob *job=visJobs+visNext;
+
+#if VIS_ASYNC
+  pthread_mutex_lock(&visLock);
+  while(job->full) pthread_cond_wait(&visCond,&visLock);
+  pthread_mutex_unlock(&visLock);
+#endif
+  if(job->size<size){
+    free(job->buf);
+    job->buf=(double *)malloc(size*sizeof(double));
+    job->size=size;
+  }
+  return job->buf;
+}
+
+//Hands the buffer returned by visStage to the writer
+static void visQueue(visJob *job){
+#if VIS_ASYNC
+  int queued;
+
+  pthread_mutex_lock(&visLock);
+  if(!visRunning){
+    visDone=0;
+    visRunning=pthread_create(&visThread,NULL,visWriter,NULL)==0;
+  }
+  //Written here if the writer could not be started
+  queued=job->full=visRunning;
+  pthread_cond_broadcast(&visCond);
+  pthread_mutex_unlock(&visLock);
+  if(!queued) visWriteJob(job);
+#else
+  visWriteJob(job);
+#endif
+  visNext^=1;
+}
+
+//Fills in the job of the buffer returned by visStage
+static visJob *visFill(char* fname, double dx, double dy, int nvar, int nx, int ny){
+  visJob *job=visJobs+visNext;
+
+  strncpy(job->fname,fname,29);
+  job->fname[29]='\0';
+  job->par=0;
+  job->dx=dx;
+  job->dy=dy;
+  job->nvar=nvar;
+  job->nx=nx;
+  job->ny=ny;
+  return job;
+}
+
+//Writes the staged mesh with writeVis
+void visSubmit(char* fname, double dx, double dy, int nvar, int nx, int ny){
+  visQueue(visFill(fname,dx,dy,nvar,nx,ny));
+}
+
+//Writes the staged block of this rank with writeVisPar
+void visSubmitPar(char* fname, double dx, double dy, int nvar, int gnx, int gny,
+		  int *ext, int rank, int nRank){
+  visJob *job=visFill(fname,dx,dy,nvar,ext[4*rank+1],ext[4*rank+3]);
+
+  job->par=1;
+  job->gnx=gnx;
+  job->gny=gny;
+  job->rank=rank;
+  job->nRank=nRank;
+  job->ext=(int *)realloc(job->ext,4*nRank*sizeof(int));
+  memcpy(job->ext,ext,4*nRank*sizeof(int));
+  visQueue(job);
+}
+
+//Copies u into a staging buffer and writes it with writeVis, without
+//VIS_ASYNC u is written directly
+void writeVisAsync(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny){
+#if VIS_ASYNC
+  memcpy(visStage((size_t)nvar*nx*ny),u,(size_t)nvar*nx*ny*sizeof(double));
+  visSubmit(fname,dx,dy,nvar,nx,ny);
+#else
+  writeVis(fname,u,dx,dy,nvar,nx,ny);
+#endif
+}
+
+//Same for writeVisPar
+void writeVisParAsync(char* fname, double *u, double dx, double dy, int nvar, int gnx, int gny,
+		      int *ext, int rank, int nRank){
+#if VIS_ASYNC
+  size_t size=(size_t)nvar*ext[4*rank+1]*ext[4*rank+3];
+
+  memcpy(visStage(size),u,size*sizeof(double));
+  visSubmitPar(fname,dx,dy,nvar,gnx,gny,ext,rank,nRank);
+#else
+  writeVisPar(fname,u,dx,dy,nvar,gnx,gny,ext,rank,nRank);
+#endif
+}
+
+//Waits for the pending dumps and stops the writer
+void visFinish(){
+#if VIS_ASYNC
+  pthread_mutex_lock(&visLock);
+  visDone=1;
+  pthread_cond_broadcast(&visCond);
+  pthread_mutex_unlock(&visLock);
+  if(visRunning) pthread_join(visThread,NULL);
+  visRunning=0;
+  visNext=0;
+#endif
+}
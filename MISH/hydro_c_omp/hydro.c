@@ -4,16 +4,66 @@
 #include <omp.h>
 #include <time.h>
 #include "hydro.h"
+#include "outfile.h"
+#include "cody_perf.h"
 #include "float.h"
+#if HUGE_PAGES
+#include <sys/mman.h>
+#endif
 
 hydro_args *Ha;
 hydro_prob *Hp;
 double *q;
 double *qr, *ql;
 double *flx;
+//Per thread partials of the reductions
+double *thRed;
 
 double slope(double *q,int ind);
 
+#if STAGE_TIMERS
+//Cumulative wall time of each stage, indexed by ST_*. Inside the
+//OMP_REGION step only thread 0 adds its own time
+double stageT[NSTAGE];
+#define STAGE(s,call) {double stT=omp_get_wtime(); call; if(omp_get_thread_num()==0)stageT[s]+=omp_get_wtime()-stT;}
+#else
+#define STAGE(s,call) call
+#endif
+
+//Allocates nvar arrays of varLen doubles back to back. The pages are first
+//touched by the threads of a static loop over the cells, the same split
+//as the stage loops, so they land on the NUMA node of the thread using
+//them. HUGE_PAGES aligns the block to and advises it onto huge pages
+double *allocArray(int nvar, size_t varLen){
+  double *arr;
+  long i;
+  int nV;
+  size_t len=nvar*varLen*sizeof(double);
+
+#if HUGE_PAGES
+  len=(len+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+  if(posix_memalign((void **)&arr,HUGE_PAGE_SIZE,len)!=0){
+    fprintf(stderr,"Failed to allocate %lu bytes\n",(unsigned long)len);
+    exit(1);
+  }
+  madvise(arr,len,MADV_HUGEPAGE);
+#else
+  arr=(double*)malloc(len);
+#endif
+#pragma omp parallel for schedule(static) private(nV)
+  for(i=0;i<(long)varLen;i++){
+    for(nV=0;nV<nvar;nV++){
+      arr[i+varLen*nV]=0.0;
+    }
+  }
+  return arr;
+}
+
+//Start of block t of n items split over nT threads
+static inline int blockLo(int n, int nT, int t){
+  return (int)(((long)n*t)/nT);
+}
+
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
   printf("Array %s\n",label);
@@ -34,7 +84,8 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny){
   }
 }
 
-double calcDT(double *mesh){
+//Largest dt denominator of cells lo to hi-1
+double denomRange(double *mesh, int lo, int hi){
   int i;
   double denom, max_denom;
   double r,vx,vy,eint,p;
@@ -45,7 +96,7 @@ double calcDT(double *mesh){
   max_denom=Ha->smallc;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  for (i=0; i<Hp->nx*Hp->ny; i++){
+  for (i=lo; i<hi; i++){
     r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
     vx  =    mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
     vy  =    mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
@@ -58,18 +109,22 @@ double calcDT(double *mesh){
     denom=cx+cy;
     if(max_denom<denom)max_denom=denom;
   }
-  return 0.5/max_denom;
+  return max_denom;
+}
+
+double calcDT(double *mesh){
+  return 0.5/denomRange(mesh,0,Hp->nx*Hp->ny);
 }
 
-void toPrimX(double *q, double *mesh){
+void toPrimX(double *q, double *mesh, int j0, int j1){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp)
-  for(i=0;i<Hp->ny*Hp->nx;i++){
+#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp) if(!omp_in_parallel())
+  for(i=Hp->nx*j0;i<Hp->nx*j1;i++){
     xI=i%Hp->nx;
     yI=i/Hp->nx;
     r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
@@ -84,21 +139,21 @@ void toPrimX(double *q, double *mesh){
   }
 }
 
-void toPrimY(double *q, double *mesh){
+void toPrimY(double *q, double *mesh, int j0, int j1){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp)
-  for(i=0;i<Hp->ny*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
-    r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
-    vx  =mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
-    vy  =mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
-    eint=mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp) if(!omp_in_parallel())
+  for(i=Hp->ny*j0;i<Hp->ny*j1;i++){
+    xI=i/Hp->ny;
+    yI=i%Hp->ny;
+    r   =MAX(mesh[xI+Hp->nx*(yI+Hp->ny*VARRHO)],Ha->smallr);
+    vx  =mesh[xI+Hp->nx*(yI+Hp->ny*VARVX )]/r;
+    vy  =mesh[xI+Hp->nx*(yI+Hp->ny*VARVY )]/r;
+    eint=mesh[xI+Hp->nx*(yI+Hp->ny*VARPR )]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,r*smallp);
     q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
     q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
@@ -107,15 +162,48 @@ void toPrimY(double *q, double *mesh){
   }
 }
 
-void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
+//toPrimY of columns j0 to j1-1 over blocks of b by b cells, the mesh rows
+//of a block are read contiguously and the columns of q it writes stay in
+//cache until the block is done
+void toPrimYBlk(double *q, double *mesh, int j0, int j1, int b){
+  int x0, y0, xE, yE;
+  int xI, yI, mI;
+  double r,vx,vy,eint,p;
+  double smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+#pragma omp parallel for private(y0,xE,yE,xI,yI,mI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp) if(!omp_in_parallel())
+  for(x0=j0;x0<j1;x0+=b){
+    xE=(x0+b<j1)?x0+b:j1;
+    for(y0=0;y0<Hp->ny;y0+=b){
+      yE=(y0+b<Hp->ny)?y0+b:Hp->ny;
+      for(yI=y0;yI<yE;yI++){
+        for(xI=x0;xI<xE;xI++){
+          mI=xI+Hp->nx*yI;
+          r   =MAX(mesh[mI+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
+          vx  =mesh[mI+Hp->nx*Hp->ny*VARVX ]/r;
+          vy  =mesh[mI+Hp->nx*Hp->ny*VARVY ]/r;
+          eint=mesh[mI+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+          p   =MAX((Hp->gamma-1)*r*eint,r*smallp);
+          q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
+          q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
+          q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVY )]=vx;
+          q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARPR )]=p;
+        }
+      }
+    }
+  }
+}
+
+void setBndCnd(double* q, int cndL, int cndH, int np, int nt, int j0, int j1){
   int i;
   int pI,tI;
   int wInd, rInd;
 
 
   //printf("Running bnd cnds for %dx%d prims\n",np,nt);
-#pragma omp parallel for private(i,pI,tI,wInd,rInd) shared(q,cndL,cndH,np,nt,Hp,Ha)
-  for(i=0;i<2*nt;i++){
+#pragma omp parallel for private(i,pI,tI,wInd,rInd) shared(q,cndL,cndH,np,nt,Hp,Ha) if(!omp_in_parallel())
+  for(i=2*j0;i<2*j1;i++){
     pI=i%2;
     tI=i/2;
     wInd=pI+(np+4)*tI;
@@ -149,7 +237,7 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
   }
 }
 
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt, int j0, int j1){
   int lI;
   int i,j;
   double  r, u, v1, p, a;
@@ -159,9 +247,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
   double spplus,spzerol,spzeror,spminus;
   double ap,am,azr,azv1,acmp;
 
-#pragma omp parallel for default(none) shared(qr,ql,q,np,nt,Hp,Ha,dtdx)	\
-  private(i,j,r,u,v1,p,dr,du,dv1,dp,cc,csq,alpham,alphap,alphazr,spplus,spminus,spzeror,spzerol,ap,am,azr,azv1,acmp)
-  for(lI=0;lI<(np+2)*nt;lI++){
+#pragma omp parallel for default(none) shared(qr,ql,q,np,nt,j0,j1,Hp,Ha,dtdx)	\
+  private(i,j,r,u,v1,p,dr,du,dv1,dp,cc,csq,alpham,alphap,alphazr,spplus,spminus,spzeror,spzerol,ap,am,azr,azv1,acmp)\
+  if(!omp_in_parallel())
+  for(lI=(np+2)*j0;lI<(np+2)*j1;lI++){
     i=lI%(np+2);
     j=lI/(np+2);
     r =q[i+1+(np+4)*(j+nt*VARRHO)];
@@ -222,7 +311,7 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+void riemann(double *flx, double *qxm, double *qxp, int np, int nt, int j0, int j1){
   int lI, i,j,n;
   double smallp, smallpp;
   double gmma6, entho;
@@ -239,7 +328,7 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   smallpp=Ha->smallr*smallp;
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
-#pragma omp parallel for shared(flx,qxm,qxp,np,nt,Ha,Hp,gmma6,entho,smallpp,smallp) \
+#pragma omp parallel for shared(flx,qxm,qxp,np,nt,j0,j1,Ha,Hp,gmma6,entho,smallpp,smallp) \
   default(none)\
   private(i,j,n,sgnm,scr,frac)\
   private(rl,vxl,vyl,pl,cl,wl,ql,vsl)\
@@ -247,8 +336,9 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   private(ro,vxo,po,wo,co)\
   private(rx,vxx,px,wx,cx)\
   private(spout,spin,ushk,delp)\
-  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot)
-  for(lI=0;lI<(np+1)*nt;lI++){
+  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot)\
+  if(!omp_in_parallel())
+  for(lI=(np+1)*j0;lI<(np+1)*j1;lI++){
     i=lI%(np+1);
     j=lI/(np+1);
     
@@ -343,11 +433,11 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
-void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt, int j0, int j1){
   int lI, i, j;
 
-#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j)
-  for(lI=0;lI<np*nt;lI++){
+#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j) if(!omp_in_parallel())
+  for(lI=np*j0;lI<np*j1;lI++){
     i=lI%np;
     j=lI/np;
     mesh[i+np*(j+nt*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
@@ -361,11 +451,11 @@ void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt, int j0, int j1){
   int lI, i, j;
 
-#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j)
-  for(lI=0;lI<np*nt;lI++){
+#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j) if(!omp_in_parallel())
+  for(lI=np*j0;lI<np*j1;lI++){
     i=lI%np;
     j=lI/np;
     mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
@@ -379,25 +469,70 @@ void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
   }
 }
 
+//addFluxY of columns j0 to j1-1 over blocks of b by b cells, the
+//transpose of toPrimYBlk
+void addFluxYBlk(double *mesh, double *flx, double dtdx, int np, int nt, int j0, int j1, int b){
+  int i0, jB, iE, jE;
+  int i, j;
+
+#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(i0,iE,jE,i,j) if(!omp_in_parallel())
+  for(jB=j0;jB<j1;jB+=b){
+    jE=(jB+b<j1)?jB+b:j1;
+    for(i0=0;i0<np;i0+=b){
+      iE=(i0+b<np)?i0+b:np;
+      for(i=i0;i<iE;i++){
+        for(j=jB;j<jE;j++){
+          mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
+                                          flx[i+1+(np+1)*(j+nt*VARRHO)]);
+          mesh[j+nt*(i+np*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
+                                          flx[i+1+(np+1)*(j+nt*VARVY )]);
+          mesh[j+nt*(i+np*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
+                                          flx[i+1+(np+1)*(j+nt*VARVX )]);
+          mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
+                                          flx[i+1+(np+1)*(j+nt*VARPR )]);
+        }
+      }
+    }
+  }
+}
+
+//Compensated sum of var. Every thread sums its own block, then the
+//partials are added in thread order so the result does not depend on
+//the timing of the threads
 double sumArray(double *mesh, int var, int nx, int ny){
-  int i;
+  int t;
   double sum, corr;
   double nsum, c_nxt;
 
+  for(t=0;t<2*omp_get_max_threads();t++){
+    thRed[t]=0.0;
+  }
+#pragma omp parallel private(nsum,c_nxt)
+  {
+    int i;
+    int tI=omp_get_thread_num();
+    int nT=omp_get_num_threads();
+    double lSum=0.0, lCorr=0.0;
+
+    for(i=blockLo(nx*ny,nT,tI);i<blockLo(nx*ny,nT,tI+1);i++){
+      c_nxt=mesh[i+nx*ny*var]-lCorr;
+      nsum=lSum+c_nxt;
+      lCorr=(nsum-lSum)-c_nxt;
+      lSum=nsum;
+    }
+    thRed[2*tI  ]=lSum;
+    thRed[2*tI+1]=lCorr;
+  }
+
   sum=0.0;
   corr=0.0;
-
-#pragma omp parallel for reduction(+:sum,corr) shared(mesh,var,nx,ny) private(i,nsum,c_nxt)
-  for(i=0;i<nx*ny;i++){
-    c_nxt=mesh[i+nx*ny*var];
+  for(t=0;t<2*omp_get_max_threads();t++){
+    c_nxt=((t%2)?-thRed[t]:thRed[t])-corr;
     nsum=sum+c_nxt;
-#pragma omp critical
-    {
-      corr=(nsum-sum)-c_nxt;
-      sum=nsum;
-    }
+    corr=(nsum-sum)-c_nxt;
+    sum=nsum;
   }
-  return sum+corr;
+  return sum;
 }
 
 void runPass(double *mesh, double dt, int n, int dir){
@@ -414,7 +549,7 @@ void runPass(double *mesh, double dt, int n, int dir){
     dx=Hp->dx;
     dy=Hp->dy;
     dirCh='x';
-    toPrimX(q,mesh);
+    STAGE(ST_PRIM,toPrimX(q,mesh,0,nt));
   }else{
     np=Hp->ny;
     nt=Hp->nx;
@@ -423,18 +558,100 @@ void runPass(double *mesh, double dt, int n, int dir){
     dx=Hp->dy;
     dy=Hp->dx;
     dirCh='y';
-    toPrimY(q,mesh);
+    if(Ha->yBlock>0){
+      STAGE(ST_PRIM,toPrimYBlk(q,mesh,0,nt,Ha->yBlock));
+    }else{
+      STAGE(ST_PRIM,toPrimY(q,mesh,0,nt));
+    }
+  }
+  STAGE(ST_BND,setBndCnd(q,bndL,bndH,np,nt,0,nt));
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dx,np,nt,0,nt));
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt,0,nt));
+  if(dir==0){
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dx,np,nt,0,nt));
+  }else if(Ha->yBlock>0){
+    STAGE(ST_FLUX,addFluxYBlk(mesh,flx,dt/dx,np,nt,0,nt,Ha->yBlock));
+  }else{
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dx,np,nt,0,nt));
+  }
+}
+
+//Block tI of nT of the pencils of a pass. Every stage of a pencil only
+//reads that pencil, so a thread can run all of them on its own pencils
+//without waiting for the others
+void runPencils(double *mesh, double dt, int dir, int tI, int nT){
+  int np,nt;
+  int j0,j1;
+  double dx;
+
+  if(dir==0){
+    np=Hp->nx;
+    nt=Hp->ny;
+    dx=Hp->dx;
+    j0=blockLo(nt,nT,tI);
+    j1=blockLo(nt,nT,tI+1);
+    STAGE(ST_PRIM,toPrimX(q,mesh,j0,j1));
+    STAGE(ST_BND,setBndCnd(q,Hp->bndL,Hp->bndR,np,nt,j0,j1));
+  }else{
+    np=Hp->ny;
+    nt=Hp->nx;
+    dx=Hp->dy;
+    j0=blockLo(nt,nT,tI);
+    j1=blockLo(nt,nT,tI+1);
+    if(Ha->yBlock>0){
+      STAGE(ST_PRIM,toPrimYBlk(q,mesh,j0,j1,Ha->yBlock));
+    }else{
+      STAGE(ST_PRIM,toPrimY(q,mesh,j0,j1));
+    }
+    STAGE(ST_BND,setBndCnd(q,Hp->bndU,Hp->bndD,np,nt,j0,j1));
   }
-  setBndCnd(q,bndL,bndH,np,nt);
-  trace(ql,qr,q,dt/dx,np,nt);
-  riemann(flx,ql,qr,np,nt);
+  STAGE(ST_TRACE,trace(ql,qr,q,dt/dx,np,nt,j0,j1));
+  STAGE(ST_RIEM,riemann(flx,ql,qr,np,nt,j0,j1));
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxX(mesh,flx,dt/dx,np,nt,j0,j1));
+  }else if(Ha->yBlock>0){
+    STAGE(ST_FLUX,addFluxYBlk(mesh,flx,dt/dx,np,nt,j0,j1,Ha->yBlock));
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    STAGE(ST_FLUX,addFluxY(mesh,flx,dt/dx,np,nt,j0,j1));
   }
 }
 
+//Whole step in one parallel region. The stage loops run serially on each
+//thread's block of pencils, the only barriers are around the dt reduction
+//and between the two passes. Returns the dt used
+double runStep(double *mesh, int n, double cTime, double nxttout){
+  double dt;
+
+#pragma omp parallel shared(dt)
+  {
+    int t;
+    int tI=omp_get_thread_num();
+    int nT=omp_get_num_threads();
+    int nc=Hp->nx*Hp->ny;
+    double max_denom;
+
+    STAGE(ST_DT,thRed[tI]=denomRange(mesh,blockLo(nc,nT,tI),blockLo(nc,nT,tI+1)));
+#pragma omp barrier
+#pragma omp single
+    {
+      max_denom=thRed[0];
+      for(t=1;t<nT;t++){
+        if(max_denom<thRed[t])max_denom=thRed[t];
+      }
+      dt=Ha->sigma*(0.5/max_denom);
+      if(nxttout>0.0&&dt>(nxttout-cTime)){
+        printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+        dt=(nxttout-cTime);
+      }
+    }
+    //X then Y on even steps, Y then X on odd ones
+    runPencils(mesh,dt,n%2,tI,nT);
+#pragma omp barrier
+    runPencils(mesh,dt,1-n%2,tI,nT);
+  }
+  return dt;
+}
+
 void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, i,j;
   int bndL;
@@ -453,10 +670,15 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   size_t primSize, qSize, flxSize;
 
   double initT, endT;
+  double outT;
+  int rOut;
 
   Hp=Hyp;
   Ha=Hya;
 
+  cody_init("MISH");
+  rOut=cody_region("out");
+
   n=0;
   cTime=0;
   nxttout=-1.0;
@@ -473,10 +695,11 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 
   if(Ha->nstepmax<0&&Ha->tend<0.0)return;
 
-  q  =(double*)malloc(primSize*sizeof(double));
-  qr =(double*)malloc(qSize*sizeof(double));
-  ql =(double*)malloc(qSize*sizeof(double));
-  flx=(double*)malloc(flxSize*sizeof(double));
+  q  =allocArray(Hp->nvar,primSize/Hp->nvar);
+  qr =allocArray(Hp->nvar,qSize/Hp->nvar);
+  ql =allocArray(Hp->nvar,qSize/Hp->nvar);
+  flx=allocArray(Hp->nvar,flxSize/Hp->nvar);
+  thRed=(double*)malloc(2*omp_get_max_threads()*sizeof(double));
 
   if(Ha->tend>0.0){
     nxttout=Ha->tend;
@@ -500,28 +723,33 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 
   //Print initial condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   
-  initT=omp_get_wtime();
+  initT=cody_now();
+  outT=cody_region_secs(rOut);
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-    //Calculate timestep
-    dt=Ha->sigma*calcDT(mesh);
-    if(nxttout>0.0&&dt>(nxttout-cTime)){
-      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
-      dt=(nxttout-cTime);
-    }
-    if(n%2==0){
-      //X Dir
-      runPass(mesh,dt,n,0);
-      //Y Dir
-      runPass(mesh,dt,n,1);
+    if(Ha->ompRegion){
+      dt=runStep(mesh,n,cTime,nxttout);
     }else{
-      //Y Dir
-      runPass(mesh,dt,n,1);
-      //X Dir
-      runPass(mesh,dt,n,0);
+      //Calculate timestep
+      STAGE(ST_DT,dt=Ha->sigma*calcDT(mesh));
+      if(nxttout>0.0&&dt>(nxttout-cTime)){
+        printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+        dt=(nxttout-cTime);
+      }
+      if(n%2==0){
+        //X Dir
+        runPass(mesh,dt,n,0);
+        //Y Dir
+        runPass(mesh,dt,n,1);
+      }else{
+        //Y Dir
+        runPass(mesh,dt,n,1);
+        //X Dir
+        runPass(mesh,dt,n,0);
+      }
     }
     n+=1;
     cTime+=dt;
@@ -544,24 +772,36 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//printf("Next Vis Time: %f\n",nxttout);
       }
+      cody_region_begin(rOut);
       snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-      writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+      STAGE(ST_VIS,writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny));
+      cody_region_end(rOut);
     }
   }
   printf("time: %f, %d iters run\n",cTime,n);
 
-  endT=omp_get_wtime();
+  endT=cody_now();
+  outT=cody_region_secs(rOut)-outT;
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"OMP\"","\"CPU:?\"","\"Init\"",1,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT));
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"OMP\"","\"CPU:?\"","\"Init\"",1,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT),endT-initT-outT,outT);
+#if STAGE_TIMERS
+  printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+  printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"OMP\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
+#endif
+  //The same run in the rows of every mini-app
+  cody_report("hydro_c_omp",1,omp_get_max_threads(),(double)Hp->nx*Hp->ny,n,endT-initT);
+  cody_finish();
 
   //Print final condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  visFinish();
 
   Hp->t+=cTime;
   free(q  );
   free(qr );
   free(ql );
   free(flx);
+  free(thRed);
 }
@@ -4,6 +4,7 @@
 #include "hydro_struct.h"
 #include "hydro_defs.h"
 
+double *allocArray(int nvar, size_t varLen);
 void engine(double *mesh, hydro_prob *Hp, hydro_args *Ha);
 
 
@@ -9,6 +9,55 @@
 #define VARVY  2
 #define VARPR  3
 
+//Format of the vis dumps (-DVIS_FORMAT=n): ascii .vts, binary .vts with
+//the arrays appended raw, or one binary .vts per rank and a .pvts
+#define VIS_ASCII    0
+#define VIS_BINARY   1
+#define VIS_PARALLEL 2
+#ifndef VIS_FORMAT
+#define VIS_FORMAT VIS_ASCII
+#endif
+
+//Write the vis files from a background thread (-DVIS_ASYNC=1, link with
+//-pthread) so the engine keeps stepping during the write
+#ifndef VIS_ASYNC
+#define VIS_ASYNC 0
+#endif
+
+//Edge of the blocks the y pass transposes the mesh in (-DY_BLOCK=n), 0
+//walks the whole mesh
+#ifndef Y_BLOCK
+#define Y_BLOCK 0
+#endif
+
+//Run each step in a single parallel region with every thread keeping its
+//own pencils through all the stages of a pass (-DOMP_REGION=1)
+#ifndef OMP_REGION
+#define OMP_REGION 0
+#endif
+
+//Align the mesh and the temporaries to huge pages and advise the kernel
+//to back them with huge pages (-DHUGE_PAGES=1)
+#ifndef HUGE_PAGES
+#define HUGE_PAGES 0
+#endif
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+//Accumulate the time spent in each stage of the passes and print it as a
+//STAGE: line after the TIME: line (-DSTAGE_TIMERS=1)
+#ifndef STAGE_TIMERS
+#define STAGE_TIMERS 0
+#endif
+#define ST_DT    0
+#define ST_PRIM  1
+#define ST_BND   2
+#define ST_TRACE 3
+#define ST_RIEM  4
+#define ST_FLUX  5
+#define ST_HALO  6
+#define ST_VIS   7
+#define NSTAGE   8
+
 #define BND_REFL 0
 #define BND_PERM 1
 
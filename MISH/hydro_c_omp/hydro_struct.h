@@ -42,6 +42,11 @@ typedef struct __hydroArgs{
     int iorder;
     double slope_type;
     int scheme;
+
+    // One parallel region per step instead of one per loop
+    int ompRegion;
+    // Block edge of the y transpose, 0 walks the whole mesh
+    int yBlock;
 } hydro_args;
 
 #endif
@@ -107,7 +107,7 @@ int main(int argc, char* argv[]){
 
   Hp.nvar=4;
 
-  mesh=(double*)malloc(Hp.nvar*Hp.nx*Hp.ny*sizeof(double));
+  mesh=allocArray(Hp.nvar,Hp.nx*Hp.ny);
 
   Hp.gamma=1.4;
 
@@ -119,6 +119,8 @@ int main(int argc, char* argv[]){
   Ha.smallr=1e-10;
   Ha.smallc=1e-10;
   Ha.niter_riemann=10;
+  Ha.ompRegion=OMP_REGION;
+  Ha.yBlock=Y_BLOCK;
   
   for(j=0;j<Hp.ny;j++){
     for(i=0;i<Hp.nx;i++){
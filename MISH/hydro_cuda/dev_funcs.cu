@@ -129,6 +129,20 @@ __global__ void redu_max(double *arrIn, double *arrOut, int nVals){
     if(thInd==0)arrOut[blockIdx.x]=arr[0];
 }
 
+//Timestep from the reduced denominator, cut to reach the output time in
+//step[2] if it is set. step[0] receives dt and step[1] the time after the
+//step, so dt never has to come back to the host
+__global__ void set_dt(double *den, double *step, double sigma){
+  double dt;
+
+  if(threadIdx.x==0&&blockIdx.x==0){
+    dt=0.5*sigma/den[0];
+    if(step[2]>0.0&&dt>(step[2]-step[1]))dt=(step[2]-step[1]);
+    step[0]=dt;
+    step[1]+=dt;
+  }
+}
+
 __global__ void gen_bndXL(double *u, int bndT){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%2;
@@ -278,10 +292,9 @@ __device__ double slope(double *q, int ind){
   return dsgn*fmin(dlim,fabs(dcen));
 }
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+2);
-  int j=thInd/(np+2);
+//Traced states of the cell at q[c], the variables of q are vs apart.
+//They are written to ql[o] and qr[o] with the variables ovs apart
+__device__ void traceState(double *ql, double *qr, int o, int ovs, double *q, int c, int vs, double dtdx){
   double  r,  u,  v1,  p;
   double dr, du, dv1, dp;
   double cc, csq;
@@ -289,57 +302,73 @@ __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, in
   double spplus, spzero, spminus;
   double ap, am, azr, azv1;
 
+  r =q[c+vs*VARRHO];
+  u =q[c+vs*VARVX ];
+  v1=q[c+vs*VARVY ];
+  p =q[c+vs*VARPR ];
+
+  csq=d_gamma*p/r;
+  cc=sqrt(csq);
+
+  dr =slope(q,c+vs*VARRHO);
+  du =slope(q,c+vs*VARVX );
+  dv1=slope(q,c+vs*VARVY );
+  dp =slope(q,c+vs*VARPR );
+ 
+
+  alpham  = 0.5*(dp/(r*cc)-du)*r/cc;
+  alphap  = 0.5*(dp/(r*cc)+du)*r/cc;
+  alphazr = dr-dp/csq;
+
+  //Right
+  spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
+  spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
+  spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
+  ap  =-0.5*spplus *alphap;
+  am  =-0.5*spminus*alpham;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  qr[o+ovs*VARRHO]=r +(ap+am+azr);
+  qr[o+ovs*VARVX ]=u +(am-am    )*cc/r;
+  qr[o+ovs*VARVY ]=v1+(azv1     );
+  qr[o+ovs*VARPR ]=p +(ap+am    )*csq;
+
+  //Left
+  spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
+  spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
+  spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
+  ap  =-0.5*spplus *alphap;
+  am  =-0.5*spminus*alpham;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  ql[o+ovs*VARRHO]=r +(ap+am+azr);
+  ql[o+ovs*VARVX ]=u +(am-am    )*cc/r;
+  ql[o+ovs*VARVY ]=v1+(azv1     );
+  ql[o+ovs*VARPR ]=p +(ap+am    )*csq;
+}
+
+//Traced states of interface thInd, shared by trace and trace_dt
+__device__ void traceCell(double *ql, double *qr, double *q, double dtdx, int np, int nt, int thInd){
+  int i=thInd%(np+2);
+  int j=thInd/(np+2);
+
   if(j<nt){
-    r =q[i+1+(np+4)*(j+nt*VARRHO)];
-    u =q[i+1+(np+4)*(j+nt*VARVX )];
-    v1=q[i+1+(np+4)*(j+nt*VARVY )];
-    p =q[i+1+(np+4)*(j+nt*VARPR )];
-
-    csq=d_gamma*p/r;
-    cc=sqrt(csq);
-
-    dr =slope(q,i+1+(np+4)*(j+nt*VARRHO));
-    du =slope(q,i+1+(np+4)*(j+nt*VARVX ));
-    dv1=slope(q,i+1+(np+4)*(j+nt*VARVY ));
-    dp =slope(q,i+1+(np+4)*(j+nt*VARPR ));
-   
-
-    alpham  = 0.5*(dp/(r*cc)-du)*r/cc;
-    alphap  = 0.5*(dp/(r*cc)+du)*r/cc;
-    alphazr = dr-dp/csq;
-
-    //Right
-    spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
-    spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
-    spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
-    ap  =-0.5*spplus *alphap;
-    am  =-0.5*spminus*alpham;
-    azr =-0.5*spzero *alphazr;
-    azv1=-0.5*spzero *dv1;
-    qr[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    qr[i+(np+2)*(j+nt*VARVX )]=u +(am-am    )*cc/r;
-    qr[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    qr[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
-
-    //Left
-    spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
-    spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
-    spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
-    ap  =-0.5*spplus *alphap;
-    am  =-0.5*spminus*alpham;
-    azr =-0.5*spzero *alphazr;
-    azv1=-0.5*spzero *dv1;
-    ql[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    ql[i+(np+2)*(j+nt*VARVX )]=u +(am-am    )*cc/r;
-    ql[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    ql[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
+    traceState(ql,qr,i+(np+2)*j,(np+2)*nt,q,i+1+(np+4)*j,(np+4)*nt,dtdx);
   }
 }
 
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+1);
-  int j=thInd/(np+1);
+__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+  traceCell(ql,qr,q,dtdx,np,nt,threadIdx.x+blockDim.x*blockIdx.x);
+}
+
+//trace with dt read from device memory, for the captured step graph
+__global__ void trace_dt(double *ql, double *qr, double *q, const double *dt, double dx, int np, int nt){
+  traceCell(ql,qr,q,dt[0]/dx,np,nt,threadIdx.x+blockDim.x*blockIdx.x);
+}
+
+//Flux between the left state qxm[0] and the right state qxp[0], the
+//variables of the states are vs apart and those of flx fvs apart
+__device__ void riemannState(double *flx, int fvs, double *qxm, double *qxp, int vs){
   int n;
   double gmma6, entho, smallpp;
   double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
@@ -355,97 +384,155 @@ __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   gmma6=(d_gamma+1)/(2.0*d_gamma);
   entho=1.0/(d_gamma-1.0);
 
-  if(j<nt){
-    rl =fmax(qxm[i  +(np+2)*(j+nt*VARRHO)],d_smallr);
-    vxl=     qxm[i  +(np+2)*(j+nt*VARVX )];
-    vyl=     qxm[i  +(np+2)*(j+nt*VARVY )];
-    pl =fmax(qxm[i  +(np+2)*(j+nt*VARPR )],rl*d_smallp);
-
-    rr =fmax(qxp[i+1+(np+2)*(j+nt*VARRHO)],d_smallr);
-    vxr=     qxp[i+1+(np+2)*(j+nt*VARVX )];
-    vyr=     qxp[i+1+(np+2)*(j+nt*VARVY )];
-    pr =fmax(qxp[i+1+(np+2)*(j+nt*VARPR )],rl*d_smallp);
-
-    cl=d_gamma*pl*rl;
-    cr=d_gamma*pr*rr;
-
-    wl=sqrt(cl);
-    wr=sqrt(cr);
-
-    px=fmax(0.0,((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr));
-    for(n=0;n<d_niterR;n++){
-      wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
-      wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-      ql=2.0*wl*wl*wl/(wl*wl+cl);
-      qr=2.0*wr*wr*wr/(wr*wr+cr);
-      vsl=vxl-(px-pl)/wl;
-      vsr=vxr+(px-pr)/wr;
-      delp=fmax(-px,qr*ql/(qr+ql)*(vsl-vsr));
-      px+=delp;
-      vxo=fabs(delp/(px+smallpp));
-      if(vxo<1.0e-6)break;
-    }
+  rl =fmax(qxm[vs*VARRHO],d_smallr);
+  vxl=     qxm[vs*VARVX ];
+  vyl=     qxm[vs*VARVY ];
+  pl =fmax(qxm[vs*VARPR ],rl*d_smallp);
+
+  rr =fmax(qxp[vs*VARRHO],d_smallr);
+  vxr=     qxp[vs*VARVX ];
+  vyr=     qxp[vs*VARVY ];
+  pr =fmax(qxp[vs*VARPR ],rl*d_smallp);
+
+  cl=d_gamma*pl*rl;
+  cr=d_gamma*pr*rr;
+
+  wl=sqrt(cl);
+  wr=sqrt(cr);
+
+  px=fmax(0.0,((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr));
+  for(n=0;n<d_niterR;n++){
     wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
     wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-    vxx=0.5*(vxl+(pl-px)/wl+
-             vxr-(pr-px)/wr);
-    if(vxx>=0.0){
-      sgnm=1.0;
-      ro = rl;
-      vxo=vxl;
-      po = pl;
-      wo = wl;
-      qgdnvVY=vyl;
-    }else{
-      sgnm=-1.0;
-      ro = rr;
-      vxo=vxr;
-      po = pr;
-      wo = wr;
-      qgdnvVY=vyr;
-    }
-    co=fmax(d_smallc,sqrt(fabs(d_gamma*po/ro)));
-    rx=fmax(d_smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
-    cx=fmax(d_smallc,sqrt(fabs(d_gamma*px/rx)));
+    ql=2.0*wl*wl*wl/(wl*wl+cl);
+    qr=2.0*wr*wr*wr/(wr*wr+cr);
+    vsl=vxl-(px-pl)/wl;
+    vsr=vxr+(px-pr)/wr;
+    delp=fmax(-px,qr*ql/(qr+ql)*(vsl-vsr));
+    px+=delp;
+    vxo=fabs(delp/(px+smallpp));
+    if(vxo<1.0e-6)break;
+  }
+  wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+  wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+  vxx=0.5*(vxl+(pl-px)/wl+
+           vxr-(pr-px)/wr);
+  if(vxx>=0.0){
+    sgnm=1.0;
+    ro = rl;
+    vxo=vxl;
+    po = pl;
+    wo = wl;
+    qgdnvVY=vyl;
+  }else{
+    sgnm=-1.0;
+    ro = rr;
+    vxo=vxr;
+    po = pr;
+    wo = wr;
+    qgdnvVY=vyr;
+  }
+  co=fmax(d_smallc,sqrt(fabs(d_gamma*po/ro)));
+  rx=fmax(d_smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
+  cx=fmax(d_smallc,sqrt(fabs(d_gamma*px/rx)));
 
-    spout=co   -sgnm*vxo;
-    spin =cx   -sgnm*vxx;
-    ushk =wo/ro-sgnm*vxo;
+  spout=co   -sgnm*vxo;
+  spin =cx   -sgnm*vxx;
+  ushk =wo/ro-sgnm*vxo;
 
-    if(px>=po){
-      spin=ushk;
-      spout=ushk;
-    }
+  if(px>=po){
+    spin=ushk;
+    spout=ushk;
+  }
 
-    scr=fmax(spout-spin,d_smallc+fabs(spout+spin));
-
-    frac=0.5*(1.0+(spout+spin)/scr);
-    frac=fmax(0.0,fmin(1.0,frac));
-    qgdnvR =frac* rx+(1.0-frac)* ro;
-    qgdnvVX=frac*vxx+(1.0-frac)*vxo;
-    qgdnvP=frac* px+(1.0-frac)* po;
-    if(spout<0.0){
-      qgdnvR = ro;
-      qgdnvVX=vxo;
-      qgdnvP = po;
-    }
-    if(spin>0.0){
-      qgdnvR = rx;
-      qgdnvVX=vxx;
-      qgdnvP = px;
+  scr=fmax(spout-spin,d_smallc+fabs(spout+spin));
+
+  frac=0.5*(1.0+(spout+spin)/scr);
+  frac=fmax(0.0,fmin(1.0,frac));
+  qgdnvR =frac* rx+(1.0-frac)* ro;
+  qgdnvVX=frac*vxx+(1.0-frac)*vxo;
+  qgdnvP=frac* px+(1.0-frac)* po;
+  if(spout<0.0){
+    qgdnvR = ro;
+    qgdnvVX=vxo;
+    qgdnvP = po;
+  }
+  if(spin>0.0){
+    qgdnvR = rx;
+    qgdnvVX=vxx;
+    qgdnvP = px;
+  }
+
+  flx[fvs*VARRHO]=qgdnvR*qgdnvVX;
+  flx[fvs*VARVX ]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+  flx[fvs*VARVY ]=qgdnvVY;//qgdnvR*qgdnvVX*qgdnvVY;
+  ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
+  etot=qgdnvP*entho+ekin;
+  flx[fvs*VARPR ]=qgdnvVX*(etot+qgdnvP);
+}
+
+__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd%(np+1);
+  int j=thInd/(np+1);
+
+  if(j<nt){
+    riemannState(flx+i+(np+1)*j,(np+1)*nt,qxm+i+(np+2)*j,qxp+i+1+(np+2)*j,(np+2)*nt);
+  }
+}
+
+//Trace and riemann fused over a tile of blockDim.x interfaces of one
+//pencil. The primitives of the tile with the two cell halo needed by slope
+//and the traced states stay in shared memory, only the fluxes are written
+//to global memory. Needs 4*(blockDim.x+3)+8*(blockDim.x+1) doubles of
+//dynamic shared memory
+__device__ void traceRiemannTile(double *flx, double *q, double dtdx, int np, int nt){
+  int nq=blockDim.x+3;
+  int ns=blockDim.x+1;
+  double *sq=dynVar;
+  double *sl=sq+4*nq;
+  double *sr=sl+4*ns;
+  int nTile=(np+1+blockDim.x-1)/blockDim.x;
+  int j=blockIdx.x/nTile;
+  int i0=(blockIdx.x%nTile)*blockDim.x;
+  int c;
+
+  //The whole block is on the same pencil
+  if(j>=nt)return;
+
+  //Primitives of cells i0 to i0+blockDim.x+2 of the pencil
+  for(c=threadIdx.x;c<nq;c+=blockDim.x){
+    if(i0+c<np+4){
+      sq[c+nq*VARRHO]=q[i0+c+(np+4)*(j+nt*VARRHO)];
+      sq[c+nq*VARVX ]=q[i0+c+(np+4)*(j+nt*VARVX )];
+      sq[c+nq*VARVY ]=q[i0+c+(np+4)*(j+nt*VARVY )];
+      sq[c+nq*VARPR ]=q[i0+c+(np+4)*(j+nt*VARPR )];
     }
+  }
+  __syncthreads();
+
+  //Traced states i0 to i0+blockDim.x, one more than the interfaces
+  for(c=threadIdx.x;c<ns;c+=blockDim.x){
+    if(i0+c<np+2)traceState(sl,sr,c,ns,sq,c+1,nq,dtdx);
+  }
+  __syncthreads();
 
-    flx[i+(np+1)*(j+nt*VARRHO)]=qgdnvR*qgdnvVX;
-    flx[i+(np+1)*(j+nt*VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
-    flx[i+(np+1)*(j+nt*VARVY )]=qgdnvVY;//qgdnvR*qgdnvVX*qgdnvVY;
-    ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
-    etot=qgdnvP*entho+ekin;
-    flx[i+(np+1)*(j+nt*VARPR )]=qgdnvVX*(etot+qgdnvP);
+  c=threadIdx.x;
+  if(i0+c<np+1){
+    riemannState(flx+i0+c+(np+1)*j,(np+1)*nt,sl+c,sr+c+1,ns);
   }
 }
 
-__global__ void addFluxX(double *u, double *flx, double dtdx){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+__global__ void trace_riemann(double *flx, double *q, double dtdx, int np, int nt){
+  traceRiemannTile(flx,q,dtdx,np,nt);
+}
+
+//trace_riemann with dt read from device memory, for the captured step graph
+__global__ void trace_riemann_dt(double *flx, double *q, const double *dt, double dx, int np, int nt){
+  traceRiemannTile(flx,q,dt[0]/dx,np,nt);
+}
+
+__device__ void addFluxXCell(double *u, double *flx, double dtdx, int thInd){
   int i=thInd%d_nx;
   int j=thInd/d_nx;
 
@@ -461,8 +548,7 @@ __global__ void addFluxX(double *u, double *flx, double dtdx){
   }
 }
 
-__global__ void addFluxY(double *u, double *flx, double dtdx){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+__device__ void addFluxYCell(double *u, double *flx, double dtdx, int thInd){
   int i=thInd/d_ny;
   int j=thInd%d_ny;
 
@@ -478,3 +564,19 @@ __global__ void addFluxY(double *u, double *flx, double dtdx){
   }
 }
 
+__global__ void addFluxX(double *u, double *flx, double dtdx){
+  addFluxXCell(u,flx,dtdx,threadIdx.x+blockDim.x*blockIdx.x);
+}
+
+__global__ void addFluxY(double *u, double *flx, double dtdx){
+  addFluxYCell(u,flx,dtdx,threadIdx.x+blockDim.x*blockIdx.x);
+}
+
+//addFlux with dt read from device memory, for the captured step graph
+__global__ void addFluxX_dt(double *u, double *flx, const double *dt, double dx){
+  addFluxXCell(u,flx,dt[0]/dx,threadIdx.x+blockDim.x*blockIdx.x);
+}
+
+__global__ void addFluxY_dt(double *u, double *flx, const double *dt, double dx){
+  addFluxYCell(u,flx,dt[0]/dx,threadIdx.x+blockDim.x*blockIdx.x);
+}
@@ -13,6 +13,7 @@ void device_init(hydro_prob *Hp, hydro_args *Ha);
 
 __global__ void calc_denom(double *u, double *den);
 __global__ void redu_max(double *arrIn, double *arrOut, int nVals);
+__global__ void set_dt(double *den, double *step, double sigma);
 
 __global__ void gen_bndXL(double *u, int bnd);
 __global__ void gen_bndXU(double *u, int bnd);
@@ -23,9 +24,14 @@ __global__ void toPrimX(double *q, double *u);
 __global__ void toPrimY(double *q, double *u);
 
 __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt);
+__global__ void trace_dt(double *ql, double *qr, double *q, const double *dt, double dx, int np, int nt);
 __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt);
+__global__ void trace_riemann(double *flx, double *q, double dtdx, int np, int nt);
+__global__ void trace_riemann_dt(double *flx, double *q, const double *dt, double dx, int np, int nt);
 
 __global__ void addFluxX(double *u, double *flx, double dtdx);
 __global__ void addFluxY(double *u, double *flx, double dtdx);
+__global__ void addFluxX_dt(double *u, double *flx, const double *dt, double dx);
+__global__ void addFluxY_dt(double *u, double *flx, const double *dt, double dx);
 
 #endif
@@ -1,13 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
+#include <sys/time.h>
 #include "hydro.h"
 #include "dev_funcs.h"
 #include "outfile.h"
 
 #define CDT_REGS 64
 #define STEP_REGS 64
+//Shared memory of a trace_riemann block of nTh threads
+#define TR_SHMEM(nTh) ((4*((nTh)+3)+8*((nTh)+1))*sizeof(double))
 
 hydro_args *Ha;
 hydro_prob *Hp;
@@ -23,10 +27,41 @@ double *h_ref;
 
 //CUDA vars
 int nTh;
+int nThCDT, nBlockM;
+//Threads and interfaces per block of trace_riemann
+int nThTR;
+//Threads per block of the pass kernels, nThCDT unless set by autotune
+int nThPrim, nThTrace, nThRiem, nThFlux;
+double *d_denA, *d_denB;
+//Kernels go to cStream, the independent boundary kernels of a pass are
+//forked onto sStream. Both are the default stream unless the step graph
+//is used
+cudaStream_t cStream, sStream;
+cudaEvent_t forkEv, joinEv;
+
+#if STAGE_TIMERS
+//Cumulative time of each stage, indexed by ST_*. The kernels of a stage are
+//bracketed by two events on cStream and the host waits for the second, so
+//the stages no longer overlap. Not timed while capturing the step graph
+double stageT[NSTAGE];
+cudaEvent_t stEv[2];
+#define STAGE(s,...) if(Ha->cudaGraph){__VA_ARGS__;}else{float stMs; cudaEventRecord(stEv[0],cStream); __VA_ARGS__; cudaEventRecord(stEv[1],cStream); cudaEventSynchronize(stEv[1]); cudaEventElapsedTime(&stMs,stEv[0],stEv[1]); stageT[s]+=1.0e-3*stMs;}
+#else
+#define STAGE(s,...) __VA_ARGS__
+#endif
+//dt, time after the step and next output time on the device
+double *d_step;
 
 //MPI Vars
 int bndT, bndB;
 
+//Wall clock time, used to time the vis dumps
+double getNow(){
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return (double)tv.tv_sec+1e-6*(double)tv.tv_usec;
+}
+
 void printArray(char* label,double *arr, int nvar, int nx, int ny, int nHx, int nHy){
   int nV,i,j;
   printf("Array %s\n",label);
@@ -48,13 +83,48 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny, int nHx, int
 }
 
 void setHHalo(int LBnd, int RBnd){
-  gen_bndXL<<<BL_TH(2*Hp->ny,nTh)>>>(d_u,LBnd);
-  gen_bndXU<<<BL_TH(2*Hp->ny,nTh)>>>(d_u,RBnd);
+  cudaEventRecord(forkEv,cStream);
+  cudaStreamWaitEvent(sStream,forkEv,0);
+  gen_bndXL<<<BL_TH(2*Hp->ny,nTh),0,cStream>>>(d_u,LBnd);
+  gen_bndXU<<<BL_TH(2*Hp->ny,nTh),0,sStream>>>(d_u,RBnd);
+  cudaEventRecord(joinEv,sStream);
+  cudaStreamWaitEvent(cStream,joinEv,0);
 }
 
 void setVHalo(int TBnd, int BBnd){
-  gen_bndYL<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,BBnd);
-  gen_bndYU<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,TBnd);
+  cudaEventRecord(forkEv,cStream);
+  cudaStreamWaitEvent(sStream,forkEv,0);
+  gen_bndYL<<<BL_TH(2*Hp->nx,nTh),0,cStream>>>(d_u,BBnd);
+  gen_bndYU<<<BL_TH(2*Hp->nx,nTh),0,sStream>>>(d_u,TBnd);
+  cudaEventRecord(joinEv,sStream);
+  cudaStreamWaitEvent(cStream,joinEv,0);
+}
+
+//Launches the reduction of the timestep denominator over the mesh and
+//returns the device address of the result
+double *launchDenom(){
+  int nDen, redBlocks;
+  double *tmp;
+
+  nDen=nBlockM;
+  redBlocks=nDen;
+  nTh=nThCDT;
+  //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
+  //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
+  calc_denom<<<nBlockM,nTh,nTh*sizeof(double),cStream>>>(d_u,d_denA);
+  //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
+  //printArray("Dens",recvMesh,1,nDen,1,0,0);
+  while(redBlocks>1){
+    redBlocks=(nDen+2*nTh-1)/(2*nTh);
+    redu_max<<<redBlocks,nTh,nTh*sizeof(double),cStream>>>(d_denA,d_denB,nDen);
+    nDen=redBlocks;
+    //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
+    //printArray("Dens",recvMesh,1,nDen,1,0,0);
+    tmp=d_denA;
+    d_denA=d_denB;
+    d_denB=tmp;
+  }
+  return d_denA;
 }
 
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
@@ -106,6 +176,7 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
 
 void runPass(double dt, int dir){
   int np,nt;
+  int nTile;
   double dx;
   char dCh;
   char outLab[30];
@@ -116,15 +187,15 @@ void runPass(double dt, int dir){
     nt=Hp->ny;
     dx=Hp->dx;
     dCh='x';
-    setHHalo(Hp->bndL,Hp->bndR);
-    toPrimX<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    STAGE(ST_BND,setHHalo(Hp->bndL,Hp->bndR));
+    STAGE(ST_PRIM,toPrimX<<<BL_TH((np+4)*nt,nThPrim),0,cStream>>>(d_q,d_u));
   }else{
     np=Hp->ny;
     nt=Hp->nx;
     dx=Hp->dy;
     dCh='y';
-    setVHalo(bndT,bndB);
-    toPrimY<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    STAGE(ST_BND,setVHalo(bndT,bndB));
+    STAGE(ST_PRIM,toPrimY<<<BL_TH((np+4)*nt,nThPrim),0,cStream>>>(d_q,d_u));
   }
   //cudaMemcpy(h_ref,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"MESH-%c",dCh);
@@ -135,33 +206,329 @@ void runPass(double dt, int dir){
   //cudaMemcpy(h_ref,d_q,primSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"Q   -%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,np+4,nt,0,0);
-  trace<<<BL_TH((np+2)*nt,nTh)>>>(d_ql,d_qr,d_q,dt/dx,np,nt);
+  if(Ha->fusedTrace){
+    //One block per tile of nThTR interfaces of a pencil
+    nTile=BL(np+1,nThTR);
+    if(Ha->cudaGraph){
+      trace_riemann_dt<<<nTile*nt,nThTR,TR_SHMEM(nThTR),cStream>>>(d_flx,d_q,d_step,dx,np,nt);
+    }else{
+      //Counted as riemann, the trace is folded into it
+      STAGE(ST_RIEM,trace_riemann<<<nTile*nt,nThTR,TR_SHMEM(nThTR),cStream>>>(d_flx,d_q,dt/dx,np,nt));
+    }
+  }else if(Ha->cudaGraph){
+    trace_dt<<<BL_TH((np+2)*nt,nThTrace),0,cStream>>>(d_ql,d_qr,d_q,d_step,dx,np,nt);
+  }else{
+    STAGE(ST_TRACE,trace<<<BL_TH((np+2)*nt,nThTrace),0,cStream>>>(d_ql,d_qr,d_q,dt/dx,np,nt));
+  }
   //cudaMemcpy(h_ref,d_ql,qSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"QL  -%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,np+2,nt,0,0);
   //cudaMemcpy(h_ref,d_qr,qSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"QR  -%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,np+2,nt,0,0);
-  riemann<<<BL_TH((np+1)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt);
+  if(!Ha->fusedTrace){
+    STAGE(ST_RIEM,riemann<<<BL_TH((np+1)*nt,nThRiem),0,cStream>>>(d_flx,d_ql,d_qr,np,nt));
+  }
   //cudaMemcpy(h_ref,d_flx,flxSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"FLX -%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,np+1,nt,0,0);
-  if(dir==0){
-    addFluxX<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
+  if(Ha->cudaGraph&&dir==0){
+    addFluxX_dt<<<BL_TH((np)*nt,nThFlux),0,cStream>>>(d_u,d_flx,d_step,dx);
+  }else if(Ha->cudaGraph){
+    addFluxY_dt<<<BL_TH((np)*nt,nThFlux),0,cStream>>>(d_u,d_flx,d_step,dx);
+  }else if(dir==0){
+    STAGE(ST_FLUX,addFluxX<<<BL_TH((np)*nt,nThFlux),0,cStream>>>(d_u,d_flx,dt/dx));
   }else{
-    addFluxY<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
+    STAGE(ST_FLUX,addFluxY<<<BL_TH((np)*nt,nThFlux),0,cStream>>>(d_u,d_flx,dt/dx));
   }
   //cudaMemcpy(h_ref,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"POST-%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,Hp->nx,Hp->ny,2,2);
 }
 
+#if AUTOTUNE
+//Kernels with a tuned block size, trace_riemann replaces trace and riemann
+//with FUSED_TRACE
+#define TK_PRIM  0
+#define TK_TRACE 1
+#define TK_RIEM  2
+#define TK_FLUX  3
+#define TK_TR    4
+#define NTUNE    5
+//Timed launches of a kernel per block size and pass direction
+#define TUNE_REPS 10
+//Nominal double operations per item of each kernel, counted from
+//dev_funcs.cu with a divide or square root as one. riemann is counted
+//with two iterations of the pressure solver
+#define FLOPS_PRIM  12
+#define FLOPS_TRACE 100
+#define FLOPS_RIEM  110
+#define FLOPS_FLUX  12
+
+const char *tuneName[NTUNE]={"toPrim","trace","riemann","addFlux","trace_riemann"};
+int *tuneTh[NTUNE]={&nThPrim,&nThTrace,&nThRiem,&nThFlux,&nThTR};
+//Time of the two launches of a step of each kernel at its block size, in ms
+double tuneMs[NTUNE];
+
+//Whether kernel k is launched by runPass with the build's options
+int tuneUsed(int k){
+  if(k==TK_TR)return Ha->fusedTrace;
+  if(k==TK_TRACE||k==TK_RIEM)return !Ha->fusedTrace;
+  return 1;
+}
+
+//Launches kernel k of the pass in direction dir with b threads per block.
+//addFlux adds the fluxes with dt=0, so the mesh is not changed
+void tuneLaunch(int k, int dir, int b, double dtdx){
+  int np, nt;
+
+  np=(dir==0)?Hp->nx:Hp->ny;
+  nt=(dir==0)?Hp->ny:Hp->nx;
+  switch(k){
+    case TK_PRIM:
+      if(dir==0)toPrimX<<<BL_TH((np+4)*nt,b),0,cStream>>>(d_q,d_u);
+      else      toPrimY<<<BL_TH((np+4)*nt,b),0,cStream>>>(d_q,d_u);
+      break;
+    case TK_TRACE:
+      trace<<<BL_TH((np+2)*nt,b),0,cStream>>>(d_ql,d_qr,d_q,dtdx,np,nt);
+      break;
+    case TK_RIEM:
+      riemann<<<BL_TH((np+1)*nt,b),0,cStream>>>(d_flx,d_ql,d_qr,np,nt);
+      break;
+    case TK_FLUX:
+      if(dir==0)addFluxX<<<BL_TH(np*nt,b),0,cStream>>>(d_u,d_flx,0.0);
+      else      addFluxY<<<BL_TH(np*nt,b),0,cStream>>>(d_u,d_flx,0.0);
+      break;
+    case TK_TR:
+      trace_riemann<<<BL(np+1,b)*nt,b,TR_SHMEM(b),cStream>>>(d_flx,d_q,dtdx,np,nt);
+      break;
+  }
+}
+
+//Sets the boundaries and runs the kernels ahead of k in the pass in
+//direction dir, so k works on the arrays of the actual mesh
+void tunePrep(int k, int dir, double dtdx){
+  if(dir==0){
+    setHHalo(Hp->bndL,Hp->bndR);
+  }else{
+    setVHalo(bndT,bndB);
+  }
+  if(k==TK_PRIM)return;
+  tuneLaunch(TK_PRIM,dir,nThPrim,dtdx);
+  if(Ha->fusedTrace){
+    if(k==TK_FLUX)tuneLaunch(TK_TR,dir,nThTR,dtdx);
+    return;
+  }
+  if(k==TK_TRACE)return;
+  tuneLaunch(TK_TRACE,dir,nThTrace,dtdx);
+  if(k==TK_RIEM)return;
+  tuneLaunch(TK_RIEM,dir,nThRiem,dtdx);
+}
+
+//Times kernel k over both passes at the warp size and its doublings up to
+//lim threads per block and keeps the fastest. Sizes the kernel fails to
+//launch with are skipped
+void tuneKernel(int k, int lim, int thWp, double dtdx, cudaEvent_t *ev){
+  int b, dir, r;
+  float ms;
+  double stepMs;
+
+  tuneMs[k]=-1.0;
+  for(b=thWp;b<=lim;b*=2){
+    stepMs=0.0;
+    for(dir=0;dir<2;dir++){
+      tunePrep(k,dir,dtdx);
+      tuneLaunch(k,dir,b,dtdx);
+      cudaEventRecord(ev[0],cStream);
+      for(r=0;r<TUNE_REPS;r++){
+        tuneLaunch(k,dir,b,dtdx);
+      }
+      cudaEventRecord(ev[1],cStream);
+      cudaEventSynchronize(ev[1]);
+      cudaEventElapsedTime(&ms,ev[0],ev[1]);
+      stepMs+=ms/TUNE_REPS;
+    }
+    if(cudaGetLastError()!=cudaSuccess)continue;
+    if(tuneMs[k]<0.0||stepMs<tuneMs[k]){
+      tuneMs[k]=stepMs;
+      *tuneTh[k]=b;
+    }
+  }
+}
+
+//Bytes moved and nominal operations of kernel k over the two passes of a
+//step, with each element of the arrays it reads and writes moved once
+void tuneCost(int k, double *bytes, double *flops){
+  int dir, np, nt;
+  double el, op;
+
+  el=0.0;
+  op=0.0;
+  for(dir=0;dir<2;dir++){
+    np=(dir==0)?Hp->nx:Hp->ny;
+    nt=(dir==0)?Hp->ny:Hp->nx;
+    switch(k){
+      case TK_PRIM:
+        el+=2.0*(np+4)*nt;
+        op+=(double)FLOPS_PRIM*(np+4)*nt;
+        break;
+      case TK_TRACE:
+        el+=((np+4)+2.0*(np+2))*nt;
+        op+=(double)FLOPS_TRACE*(np+2)*nt;
+        break;
+      case TK_RIEM:
+        el+=(2.0*(np+2)+(np+1))*nt;
+        op+=(double)FLOPS_RIEM*(np+1)*nt;
+        break;
+      case TK_FLUX:
+        el+=(3.0*np+1)*nt;
+        op+=(double)FLOPS_FLUX*np*nt;
+        break;
+      case TK_TR:
+        el+=(2.0*np+5)*nt;
+        op+=((double)FLOPS_TRACE*(np+2)+(double)FLOPS_RIEM*(np+1))*nt;
+        break;
+    }
+  }
+  *bytes=el*Hp->nvar*sizeof(double);
+  *flops=op;
+}
+
+//Reads the block size and time of kernel k on this device and mesh from
+//TUNE_CACHE, the last matching line wins. Returns 1 if there is one
+int readTune(const char *model, int k){
+  FILE *fp;
+  char line[512];
+  char cMod[256], cKer[32];
+  int cNx, cNy, cTh;
+  double cMs;
+  int found=0;
+
+  fp=fopen(TUNE_CACHE,"r");
+  if(fp==NULL)return 0;
+  while(fgets(line,sizeof(line),fp)!=NULL){
+    if(sscanf(line,"%255[^|]|%d|%d|%31[^|]|%d %lf",cMod,&cNx,&cNy,cKer,&cTh,&cMs)==6&&
+       !strcmp(cMod,model)&&!strcmp(cKer,tuneName[k])&&cNx==Hp->nx&&cNy==Hp->ny){
+      *tuneTh[k]=cTh;
+      tuneMs[k]=cMs;
+      found=1;
+    }
+  }
+  fclose(fp);
+  return found;
+}
+
+//Picks the block size of each pass kernel, from TUNE_CACHE when this device
+//model has been tuned on a mesh of this size before, otherwise by timing the
+//kernels on the mesh in d_u and appending the result to the cache. Prints a
+//TUNE: line per kernel with the bandwidth and the nominal flop rate it
+//reaches. The mesh is copied back from lMesh afterwards
+void autotune(cudaDeviceProp *prop, double *lMesh){
+  int k, lim, cached;
+  double dtdx, dt_denom;
+  double bytes, flops, peakBW, sec;
+  cudaFuncAttributes attr;
+  cudaEvent_t ev[2];
+  cudaError_t cuErrVar;
+  FILE *fp;
+
+  cached=1;
+  for(k=0;k<NTUNE;k++){
+    if(tuneUsed(k))cached=cached&&readTune(prop->name,k);
+  }
+
+  if(!cached){
+    //The dt of the first step over the larger spacing, both passes are
+    //traced with it
+    cudaMemcpy(&dt_denom,launchDenom(),sizeof(double),cudaMemcpyDeviceToHost);
+    HANDLE_CUDA_ERROR(cuErrVar);
+    dtdx=0.5*Ha->sigma/dt_denom;
+    dtdx/=MAX(Hp->dx,Hp->dy);
+    cudaEventCreate(ev);
+    cudaEventCreate(ev+1);
+    fp=fopen(TUNE_CACHE,"a");
+    for(k=0;k<NTUNE;k++){
+      if(!tuneUsed(k))continue;
+      lim=prop->maxThreadsPerBlock;
+      switch(k){
+        case TK_PRIM:
+          cudaFuncGetAttributes(&attr,toPrimX);
+          lim=MIN(lim,attr.maxThreadsPerBlock);
+          cudaFuncGetAttributes(&attr,toPrimY);
+          break;
+        case TK_TRACE:
+          cudaFuncGetAttributes(&attr,trace_dt);
+          lim=MIN(lim,attr.maxThreadsPerBlock);
+          cudaFuncGetAttributes(&attr,trace);
+          break;
+        case TK_RIEM:
+          cudaFuncGetAttributes(&attr,riemann);
+          break;
+        case TK_FLUX:
+          cudaFuncGetAttributes(&attr,addFluxX_dt);
+          lim=MIN(lim,attr.maxThreadsPerBlock);
+          cudaFuncGetAttributes(&attr,addFluxY_dt);
+          break;
+        case TK_TR:
+          //nThTR is already the largest tile that fits the shared memory
+          lim=nThTR;
+          cudaFuncGetAttributes(&attr,trace_riemann_dt);
+          break;
+      }
+      lim=MIN(lim,attr.maxThreadsPerBlock);
+      tuneKernel(k,lim,prop->warpSize,dtdx,ev);
+      if(fp!=NULL&&tuneMs[k]>=0.0){
+        fprintf(fp,"%s|%d|%d|%s|%d %g\n",prop->name,Hp->nx,Hp->ny,tuneName[k],*tuneTh[k],tuneMs[k]);
+      }
+    }
+    if(fp!=NULL)fclose(fp);
+    cudaEventDestroy(ev[0]);
+    cudaEventDestroy(ev[1]);
+    cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
+
+  //Double data rate memory, memoryClockRate is in kHz
+  peakBW=2.0*1.0e3*prop->memoryClockRate*(prop->memoryBusWidth/8);
+  printf("UFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","kernel","nTh","ms","GBs","GFlops","flopsPerByte","pctPeakBW","from");
+  for(k=0;k<NTUNE;k++){
+    if(!tuneUsed(k)||tuneMs[k]<=0.0)continue;
+    tuneCost(k,&bytes,&flops);
+    sec=1.0e-3*tuneMs[k];
+    printf("TUNE:\"%s\",%d,%g,%g,%g,%g,%g,\"%s\"\n",tuneName[k],*tuneTh[k],tuneMs[k],
+           1.0e-9*bytes/sec,1.0e-9*flops/sec,flops/bytes,100.0*bytes/sec/peakBW,cached?"cache":"timed");
+  }
+}
+#endif
+
+//Captures the kernels of a step with the x pass first (odd=0) or the y
+//pass first (odd=1) into an executable graph. dt is computed by set_dt
+//and read by the kernels from d_step
+void captureStep(cudaGraphExec_t *exec, int odd){
+  cudaGraph_t graph;
+  cudaError_t cuErrVar;
+  double *d_den;
+
+  cudaStreamBeginCapture(cStream,cudaStreamCaptureModeGlobal);
+  d_den=launchDenom();
+  set_dt<<<1,1,0,cStream>>>(d_den,d_step,Ha->sigma);
+  runPass(0.0,odd);
+  runPass(0.0,1-odd);
+  cudaStreamEndCapture(cStream,&graph);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaGraphInstantiate(exec,graph,NULL,NULL,0);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaGraphDestroy(graph);
+}
+
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, nV, lI, i,j,k;
   int bndL;
   int bndH;
   double dt, dt_denom;
   double cTime, nxttout;
+  double *h_step;
+  int timed;
 
   double volCell;
   double oTM,oTE;
@@ -170,26 +537,26 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   double M_prec, E_prec;
   double *lMesh;
   double *recvMesh;
-  double *tmp, *d_denA, *d_denB;
 
   char outfile[30];
   char outLab[30];
 
   float runT;
+  double visT, outT;
+  double *visBuf;
 
   //Cuda vars
   int dev;
   cudaDeviceProp prop;
-  int nDen, redBlocks;
   cudaError_t cuErrVar;
   int rpBl;
   int mxTh, thWp;
-  int nBlockM;
-  int nThCDT, nThStep;
+  int nThStep;
   size_t shMpBl;
   size_t mem_reqd, mem_avail;
 
   cudaEvent_t start, end;
+  cudaGraphExec_t stepExec[2];
 
   Hp=Hyp;
   Ha=Hya;
@@ -216,6 +583,12 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   nBlockM=((Hp->ny*Hp->nx)+nTh-1)/nTh;
   printf("Per block: Max threads %d, regs %d\n", mxTh,rpBl, shMpBl);
   printf("Block size lims: cdt %d step %d\n",nThCDT,nThStep);
+  nThTR=nThCDT;
+  while(nThTR>thWp&&TR_SHMEM(nThTR)>shMpBl)nThTR/=2;
+  nThPrim=nThCDT;
+  nThTrace=nThCDT;
+  nThRiem=nThCDT;
+  nThFlux=nThCDT;
 
   n=0;
   cTime=0;
@@ -242,7 +615,12 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   //printf("Done loc size calcs\n");
 
   //Print relative sizes of memory requirements
-  mem_reqd=(meshSize+primSize+2*qSize+flxSize)*sizeof(double);
+  //The fused kernel keeps the traced states in shared memory
+  if(Ha->fusedTrace){
+    mem_reqd=(meshSize+primSize+flxSize)*sizeof(double);
+  }else{
+    mem_reqd=(meshSize+primSize+2*qSize+flxSize)*sizeof(double);
+  }
   mem_avail=prop.totalGlobalMem;
   printf("%u/%u of %f%% memory required for a %d var %dx%d mesh\n",mem_reqd,mem_avail,
          ((double)mem_reqd/(double)mem_avail)*100.0,Hp->nvar,Hp->nx,Hp->ny);
@@ -260,16 +638,24 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_q,primSize*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_qr,qSize*sizeof(double));
-  HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_ql,qSize*sizeof(double));
-  HANDLE_CUDA_ERROR(cuErrVar);
+  d_qr=NULL;
+  d_ql=NULL;
+  if(!Ha->fusedTrace){
+    cudaMalloc(&d_qr,qSize*sizeof(double));
+    HANDLE_CUDA_ERROR(cuErrVar);
+    cudaMalloc(&d_ql,qSize*sizeof(double));
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
   cudaMalloc(&d_flx,flxSize*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_denA,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_denB,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMalloc(&d_step,3*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMallocHost(&h_step,3*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
 
   //printf("Arrays allocated\n");
 
@@ -304,61 +690,87 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 
   //Print initial condition
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
 
   //Move mesh onto GPU
   cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
   HANDLE_CUDA_ERROR(cuErrVar);
 
+  //The graph of the even and the odd step, launched once per step. The
+  //time only comes back to the host when the run is limited by time or
+  //when the step is printed or written
+  cStream=0;
+  sStream=0;
+  cudaEventCreateWithFlags(&forkEv,cudaEventDisableTiming);
+  cudaEventCreateWithFlags(&joinEv,cudaEventDisableTiming);
+#if STAGE_TIMERS
+  cudaEventCreate(stEv);
+  cudaEventCreate(stEv+1);
+#endif
+#if AUTOTUNE
+  //Before the step graphs are captured with the block sizes
+  if(Ha->autotune){
+    autotune(&prop,lMesh);
+  }
+#endif
+  timed=(Ha->tend>0.0||nxttout>0.0);
+  if(Ha->cudaGraph){
+    cudaStreamCreateWithFlags(&cStream,cudaStreamNonBlocking);
+    cudaStreamCreateWithFlags(&sStream,cudaStreamNonBlocking);
+    h_step[0]=0.0;
+    h_step[1]=cTime;
+    h_step[2]=nxttout;
+    cudaMemcpy(d_step,h_step,3*sizeof(double),cudaMemcpyHostToDevice);
+    HANDLE_CUDA_ERROR(cuErrVar);
+    captureStep(stepExec  ,0);
+    captureStep(stepExec+1,1);
+  }
+
   //Get start time  
   cudaEventCreate(&start);
   cudaEventCreate(&end);
   cudaEventRecord(start,0);
+  outT=0.0;
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-    //Calculate timestep
-    dt=0.0;
-    nDen=nBlockM;
-    redBlocks=nDen;
-    nTh=nThCDT;
-    //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
-    calc_denom<<<nBlockM,nTh,nTh*sizeof(double)>>>(d_u,d_denA);
-    //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Dens",recvMesh,1,nDen,1,0,0);
-    while(redBlocks>1){
-      redBlocks=(nDen+2*nTh-1)/(2*nTh);
-      redu_max<<<redBlocks,nTh,nTh*sizeof(double)>>>(d_denA,d_denB,nDen);
-      nDen=redBlocks;
-      //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
-      //printArray("Dens",recvMesh,1,nDen,1,0,0);
-      tmp=d_denA;
-      d_denA=d_denB;
-      d_denB=tmp;
-    }
-    cudaMemcpy(&dt_denom,d_denA,sizeof(double),cudaMemcpyDeviceToHost);
-    //printf("ITER %d denom=%g\n",n,dt_denom);
-    dt=0.5*Ha->sigma/dt_denom;
-    if(nxttout>0.0&&dt>(nxttout-cTime)){
-      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
-      dt=(nxttout-cTime);
-    }
-    //break;
-    if(n%2==0){
-      //X Dir
-      runPass(dt,0);
-      //Y Dir
-      runPass(dt,1);
+    if(Ha->cudaGraph){
+      cudaGraphLaunch(stepExec[n%2],cStream);
+      n+=1;
+      if(timed||n%Ha->nprtLine==0||(Ha->noutput>0&&n%Ha->noutput==0)){
+        cudaMemcpyAsync(h_step,d_step,2*sizeof(double),cudaMemcpyDeviceToHost,cStream);
+        cudaStreamSynchronize(cStream);
+        HANDLE_CUDA_ERROR(cuErrVar);
+        dt=h_step[0];
+        cTime=h_step[1];
+      }
     }else{
-      //Y Dir
-      runPass(dt,1);
-      //X Dir
-      runPass(dt,0);
+      //Calculate timestep
+      dt=0.0;
+      STAGE(ST_DT,cudaMemcpy(&dt_denom,launchDenom(),sizeof(double),cudaMemcpyDeviceToHost));
+      //printf("ITER %d denom=%g\n",n,dt_denom);
+      dt=0.5*Ha->sigma/dt_denom;
+      if(nxttout>0.0&&dt>(nxttout-cTime)){
+        printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+        dt=(nxttout-cTime);
+      }
+      //break;
+      if(n%2==0){
+        //X Dir
+        runPass(dt,0);
+        //Y Dir
+        runPass(dt,1);
+      }else{
+        //Y Dir
+        runPass(dt,1);
+        //X Dir
+        runPass(dt,0);
+      }
+      n+=1;
+      cTime+=dt;
     }
-    n+=1;
-    cTime+=dt;
     if(n%Ha->nprtLine==0||(cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      cudaStreamSynchronize(cStream);
       cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
       HANDLE_CUDA_ERROR(cuErrVar);
       if(n%Ha->nprtLine==0){
@@ -379,27 +791,47 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
           nxttout+=Ha->dtoutput;
           if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
           printf("Next Vis Time: %f\n",nxttout);
+          if(Ha->cudaGraph){
+            cudaMemcpy(d_step+2,&nxttout,sizeof(double),cudaMemcpyHostToDevice);
+            HANDLE_CUDA_ERROR(cuErrVar);
+          }
         }
+        //Interior goes straight to the staging buffer of the writer
+        visT=getNow();
+        visBuf=visStage((size_t)Hp->nvar*Hp->nx*Hp->ny);
         for(k=0;k<Hp->nvar;k++){
           for(i=0;i<Hp->nx;i++){
 	    for(j=0;j<Hp->ny;j++){
-              gMesh[(k*Hp->ny+j)*Hp->nx+i]=lMesh[(k*(Hp->ny+4)+j+2)*(Hp->nx+4)+i+2];
+              visBuf[(k*Hp->ny+j)*Hp->nx+i]=lMesh[(k*(Hp->ny+4)+j+2)*(Hp->nx+4)+i+2];
 	    }
 	  }
         }
         snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-        writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+        visSubmit(outfile,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+        outT+=getNow()-visT;
+#if STAGE_TIMERS
+        stageT[ST_VIS]+=getNow()-visT;
+#endif
       }
     }
   }
+  if(Ha->cudaGraph){
+    cudaMemcpyAsync(h_step,d_step,2*sizeof(double),cudaMemcpyDeviceToHost,cStream);
+    cudaStreamSynchronize(cStream);
+    cTime=h_step[1];
+  }
   printf("time: %f, %d iters run\n",cTime,n);
 
   //Get end time
   cudaEventRecord(end,0);
   cudaEventElapsedTime(&runT,start,end);
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"CUDA\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,runT*1.0e-3);
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"CUDA\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,runT*1.0e-3,runT*1.0e-3-outT,outT);
+#if STAGE_TIMERS
+  printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+  printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"CUDA\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
+#endif
 
   //Print final condition
   cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
@@ -412,7 +844,8 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
     }
   }
   snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  visFinish();
   Hp->t+=cTime;
 
   free(recvMesh);
@@ -424,6 +857,20 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   cudaFree(d_flx);
   cudaFree(d_denA);
   cudaFree(d_denB);
+  cudaFree(d_step);
+  cudaFreeHost(h_step);
+  cudaEventDestroy(forkEv);
+  cudaEventDestroy(joinEv);
+#if STAGE_TIMERS
+  cudaEventDestroy(stEv[0]);
+  cudaEventDestroy(stEv[1]);
+#endif
+  if(Ha->cudaGraph){
+    cudaGraphExecDestroy(stepExec[0]);
+    cudaGraphExecDestroy(stepExec[1]);
+    cudaStreamDestroy(cStream);
+    cudaStreamDestroy(sStream);
+  }
 
   printf("Returning from engine\n");
 }
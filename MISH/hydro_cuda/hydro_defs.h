@@ -9,6 +9,58 @@
 #define VARVY  2
 #define VARPR  3
 
+//Format of the vis dumps (-DVIS_FORMAT=n): ascii .vts, binary .vts with
+//the arrays appended raw, or one binary .vts per rank and a .pvts
+#define VIS_ASCII    0
+#define VIS_BINARY   1
+#define VIS_PARALLEL 2
+#ifndef VIS_FORMAT
+#define VIS_FORMAT VIS_ASCII
+#endif
+
+//Write the vis files from a background thread (-DVIS_ASYNC=1, link with
+//-pthread) so the engine keeps stepping during the write
+#ifndef VIS_ASYNC
+#define VIS_ASYNC 0
+#endif
+
+//Capture the kernels of a step in a CUDA graph with dt kept on the device
+//(-DCUDA_GRAPH=1)
+#ifndef CUDA_GRAPH
+#define CUDA_GRAPH 0
+#endif
+
+//Fuse trace and riemann into one kernel working on shared memory tiles,
+//ql and qr are not allocated (-DFUSED_TRACE=1)
+#ifndef FUSED_TRACE
+#define FUSED_TRACE 0
+#endif
+
+//Time the pass kernels over the block sizes the device allows on the mesh
+//before the first step and launch each with its fastest, caching the
+//sizes per GPU model and mesh size in TUNE_CACHE (-DAUTOTUNE=1)
+#ifndef AUTOTUNE
+#define AUTOTUNE 0
+#endif
+#ifndef TUNE_CACHE
+#define TUNE_CACHE "autotune.cache"
+#endif
+
+//Accumulate the time spent in each stage of the passes and print it as a
+//STAGE: line after the TIME: line (-DSTAGE_TIMERS=1)
+#ifndef STAGE_TIMERS
+#define STAGE_TIMERS 0
+#endif
+#define ST_DT    0
+#define ST_PRIM  1
+#define ST_BND   2
+#define ST_TRACE 3
+#define ST_RIEM  4
+#define ST_FLUX  5
+#define ST_HALO  6
+#define ST_VIS   7
+#define NSTAGE   8
+
 #define BND_REFL 0
 #define BND_PERM 1
 #define BND_INT 2
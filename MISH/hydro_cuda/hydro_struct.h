@@ -42,6 +42,13 @@ typedef struct __hydroArgs{
     int iorder;
     double slope_type;
     int scheme;
+
+    // Launch each step as a captured CUDA graph
+    int cudaGraph;
+    // trace and riemann in one shared memory kernel
+    int fusedTrace;
+    // Tune the block size of each pass kernel before the first step
+    int autotune;
 } hydro_args;
 
 #endif
@@ -119,6 +119,9 @@ int main(int argc, char* argv[]){
   Ha.smallr=1e-10;
   Ha.smallc=1e-10;
   Ha.niter_riemann=10;
+  Ha.cudaGraph=CUDA_GRAPH;
+  Ha.fusedTrace=FUSED_TRACE;
+  Ha.autotune=AUTOTUNE;
   
   for(j=0;j<Hp.ny;j++){
     for(i=0;i<Hp.nx;i++){
@@ -248,10 +248,7 @@ __global__ void toPrimX(double *q, double *u){
   }
 }
 
-__global__ void toPrimY(double *q, double *u){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd/(d_ny+4);
-  int j=thInd%(d_ny+4);
+__device__ void toPrimYCell(double *q, double *u, int i, int j){
   double r, vx, vy, eint, p;
 
   if(i<d_nx){
@@ -267,6 +264,23 @@ __global__ void toPrimY(double *q, double *u){
   }
 }
 
+__global__ void toPrimY(double *q, double *u){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd/(d_ny+4);
+  int j=thInd%(d_ny+4);
+
+  toPrimYCell(q,u,i,j);
+}
+
+//toPrimY of rows j0 to j0+nj-1 of the mesh, for the overlapped y pass
+__global__ void toPrimY_rng(double *q, double *u, int j0, int nj){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd/nj;
+  int j=j0+thInd%nj;
+
+  toPrimYCell(q,u,i,j);
+}
+
 __device__ double slope(double *q, int ind){
   double dlft, drgt, dcen, dsgn, dlim;
   dlft=q[ind  ]-q[ind-1];
@@ -278,10 +292,7 @@ __device__ double slope(double *q, int ind){
   return dsgn*fmin(dlim,fabs(dcen));
 }
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+2);
-  int j=thInd/(np+2);
+__device__ void traceCell(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i, int j){
   double  r,  u,  v1,  p;
   double dr, du, dv1, dp;
   double cc, csq;
@@ -336,10 +347,24 @@ __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, in
   }
 }
 
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+1);
-  int j=thInd/(np+1);
+  int i=thInd%(np+2);
+  int j=thInd/(np+2);
+
+  traceCell(ql,qr,q,dtdx,np,nt,i,j);
+}
+
+//trace of interfaces i0 to i0+ni-1 of every pencil
+__global__ void trace_rng(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i0, int ni){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=i0+thInd%ni;
+  int j=thInd/ni;
+
+  traceCell(ql,qr,q,dtdx,np,nt,i,j);
+}
+
+__device__ void riemannCell(double *flx, double *qxm, double *qxp, int np, int nt, int i, int j){
   int n;
   double gmma6, entho, smallpp;
   double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
@@ -444,6 +469,23 @@ __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
+__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd%(np+1);
+  int j=thInd/(np+1);
+
+  riemannCell(flx,qxm,qxp,np,nt,i,j);
+}
+
+//riemann of interfaces i0 to i0+ni-1 of every pencil
+__global__ void riemann_rng(double *flx, double *qxm, double *qxp, int np, int nt, int i0, int ni){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=i0+thInd%ni;
+  int j=thInd/ni;
+
+  riemannCell(flx,qxm,qxp,np,nt,i,j);
+}
+
 __global__ void addFluxX(double *u, double *flx, double dtdx){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%d_nx;
@@ -461,11 +503,7 @@ __global__ void addFluxX(double *u, double *flx, double dtdx){
   }
 }
 
-__global__ void addFluxY(double *u, double *flx, double dtdx){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd/d_ny;
-  int j=thInd%d_ny;
-
+__device__ void addFluxYCell(double *u, double *flx, double dtdx, int i, int j){
   if(i<d_nx){
     u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARRHO)]-
                                                  flx[j+1+(d_ny+1)*(i+d_nx*VARRHO)]);
@@ -478,3 +516,48 @@ __global__ void addFluxY(double *u, double *flx, double dtdx){
   }
 }
 
+__global__ void addFluxY(double *u, double *flx, double dtdx){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd/d_ny;
+  int j=thInd%d_ny;
+
+  addFluxYCell(u,flx,dtdx,i,j);
+}
+
+//addFluxY of cells j0 to j0+nj-1 of every pencil
+__global__ void addFluxY_rng(double *u, double *flx, double dtdx, int j0, int nj){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int i=thInd/nj;
+  int j=j0+thInd%nj;
+
+  addFluxYCell(u,flx,dtdx,i,j);
+}
+
+//Packs the two rows from row0 of every variable into buf, the variables
+//are 2*(nx+4) apart, so one message carries them all
+__global__ void pack_rows(double *buf, double *u, int row0){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int row=d_nx+4;
+  int vSize=(d_nx+4)*(d_ny+4);
+
+  if(thInd<2*row){
+    buf[thInd+2*row*VARRHO]=u[thInd+row0*row+VARRHO*vSize];
+    buf[thInd+2*row*VARVX ]=u[thInd+row0*row+VARVX *vSize];
+    buf[thInd+2*row*VARVY ]=u[thInd+row0*row+VARVY *vSize];
+    buf[thInd+2*row*VARPR ]=u[thInd+row0*row+VARPR *vSize];
+  }
+}
+
+//Inverse of pack_rows
+__global__ void unpack_rows(double *u, double *buf, int row0){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int row=d_nx+4;
+  int vSize=(d_nx+4)*(d_ny+4);
+
+  if(thInd<2*row){
+    u[thInd+row0*row+VARRHO*vSize]=buf[thInd+2*row*VARRHO];
+    u[thInd+row0*row+VARVX *vSize]=buf[thInd+2*row*VARVX ];
+    u[thInd+row0*row+VARVY *vSize]=buf[thInd+2*row*VARVY ];
+    u[thInd+row0*row+VARPR *vSize]=buf[thInd+2*row*VARPR ];
+  }
+}
@@ -21,11 +21,18 @@ __global__ void gen_bndYU(double *u, int bnd);
 
 __global__ void toPrimX(double *q, double *u);
 __global__ void toPrimY(double *q, double *u);
+__global__ void toPrimY_rng(double *q, double *u, int j0, int nj);
 
 __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt);
+__global__ void trace_rng(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i0, int ni);
 __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt);
+__global__ void riemann_rng(double *flx, double *qxm, double *qxp, int np, int nt, int i0, int ni);
 
 __global__ void addFluxX(double *u, double *flx, double dtdx);
 __global__ void addFluxY(double *u, double *flx, double dtdx);
+__global__ void addFluxY_rng(double *u, double *flx, double dtdx, int j0, int nj);
+
+__global__ void pack_rows(double *buf, double *u, int row0);
+__global__ void unpack_rows(double *u, double *buf, int row0);
 
 #endif
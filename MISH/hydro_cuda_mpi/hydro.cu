@@ -15,6 +15,7 @@ hydro_args *Ha;
 hydro_prob *Hp;
 double *lMesh;
 double *bndLS, *bndLR, *bndHS, *bndHR;
+double *d_bndLS, *d_bndLR, *d_bndHS, *d_bndHR;
 double *d_u;
 double *d_q;
 double *d_qr, *d_ql;
@@ -25,6 +26,19 @@ double *h_ref;
 
 //CUDA vars
 int nTh;
+cudaStream_t hStream;
+cudaEvent_t haloEv;
+
+#if STAGE_TIMERS
+//Cumulative time of each stage on this rank, indexed by ST_*. The kernels
+//of a stage are bracketed by two events on the default stream and the host
+//waits for the second, so the stages no longer overlap
+double stageT[NSTAGE];
+cudaEvent_t stEv[2];
+#define STAGE(s,...) {float stMs; cudaEventRecord(stEv[0],0); __VA_ARGS__; cudaEventRecord(stEv[1],0); cudaEventSynchronize(stEv[1]); cudaEventElapsedTime(&stMs,stEv[0],stEv[1]); stageT[s]+=1.0e-3*stMs;}
+#else
+#define STAGE(s,...) __VA_ARGS__
+#endif
 
 //MPI Vars
 int bndT, bndB;
@@ -59,28 +73,71 @@ void setHHalo(int LBnd, int RBnd){
   gen_bndXU<<<BL_TH(2*myNy,nTh)>>>(d_u,RBnd);
 }
 
-void setVHalo(int TBnd, int BBnd){
+//Packs the rows sent to each neighbor on hStream, after the work already
+//queued on the default stream, so the interior can be updated meanwhile
+void packVHalo(){
   int row=Hp->nx+4;
-  int nV;
-  MPI_Request reqs[16];
-  MPI_Status stat[16];
-  for(nV=0;nV<Hp->nvar;nV++){
-    cudaMemcpy(lMesh+(2   )*row+nV*varSize,d_u+(2   )*row+nV*varSize,2*row*sizeof(double),cudaMemcpyDeviceToHost);
-    cudaMemcpy(lMesh+(myNy)*row+nV*varSize,d_u+(myNy)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyDeviceToHost);
-    MPI_Irecv(lMesh+(     0)*row+nV*varSize,2*row,MPI_DOUBLE,pProc,1+2*nV,MPI_COMM_WORLD,reqs+ 0+nV);
-    MPI_Isend(lMesh+(     2)*row+nV*varSize,2*row,MPI_DOUBLE,pProc,2+2*nV,MPI_COMM_WORLD,reqs+ 4+nV);
-    MPI_Irecv(lMesh+(myNy+2)*row+nV*varSize,2*row,MPI_DOUBLE,nProc,2+2*nV,MPI_COMM_WORLD,reqs+ 8+nV);
-    MPI_Isend(lMesh+(myNy  )*row+nV*varSize,2*row,MPI_DOUBLE,nProc,1+2*nV,MPI_COMM_WORLD,reqs+12+nV);
+  int cnt=2*row*Hp->nvar;
+
+  cudaEventRecord(haloEv,0);
+  cudaStreamWaitEvent(hStream,haloEv,0);
+  pack_rows<<<BL_TH(2*row,nTh),0,hStream>>>(d_bndLS,d_u,2);
+  pack_rows<<<BL_TH(2*row,nTh),0,hStream>>>(d_bndHS,d_u,myNy);
+  if(!Ha->cudaAware){
+    cudaMemcpyAsync(bndLS,d_bndLS,cnt*sizeof(double),cudaMemcpyDeviceToHost,hStream);
+    cudaMemcpyAsync(bndHS,d_bndHS,cnt*sizeof(double),cudaMemcpyDeviceToHost,hStream);
   }
-  MPI_Waitall(16,reqs,stat);
-  for(nV=0;nV<Hp->nvar;nV++){
-    cudaMemcpy(d_u+(     0)*row+nV*varSize,lMesh+(     0)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyHostToDevice);
-    cudaMemcpy(d_u+(myNy+2)*row+nV*varSize,lMesh+(myNy+2)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyHostToDevice);
+}
+
+//Posts the exchange once the packed rows are ready. With CUDA_AWARE the
+//device buffers are handed to MPI directly, otherwise the pinned copies
+void postVHalo(MPI_Request *reqs){
+  int cnt=2*(Hp->nx+4)*Hp->nvar;
+  double *sL, *sH, *rL, *rH;
+
+  if(Ha->cudaAware){
+    sL=d_bndLS; sH=d_bndHS; rL=d_bndLR; rH=d_bndHR;
+  }else{
+    sL=bndLS; sH=bndHS; rL=bndLR; rH=bndHR;
+  }
+  cudaStreamSynchronize(hStream);
+  MPI_Irecv(rL,cnt,MPI_DOUBLE,pProc,1,MPI_COMM_WORLD,reqs+0);
+  MPI_Isend(sL,cnt,MPI_DOUBLE,pProc,2,MPI_COMM_WORLD,reqs+1);
+  MPI_Irecv(rH,cnt,MPI_DOUBLE,nProc,2,MPI_COMM_WORLD,reqs+2);
+  MPI_Isend(sH,cnt,MPI_DOUBLE,nProc,1,MPI_COMM_WORLD,reqs+3);
+}
+
+//Waits for the exchange and unpacks the received rows into the halo on
+//the default stream, then fills the physical boundaries
+void finishVHalo(MPI_Request *reqs, int TBnd, int BBnd){
+  int row=Hp->nx+4;
+  int cnt=2*row*Hp->nvar;
+
+  MPI_Waitall(4,reqs,MPI_STATUSES_IGNORE);
+  if(pProc!=MPI_PROC_NULL){
+    if(!Ha->cudaAware){
+      cudaMemcpyAsync(d_bndLR,bndLR,cnt*sizeof(double),cudaMemcpyHostToDevice,0);
+    }
+    unpack_rows<<<BL_TH(2*row,nTh)>>>(d_u,d_bndLR,0);
+  }
+  if(nProc!=MPI_PROC_NULL){
+    if(!Ha->cudaAware){
+      cudaMemcpyAsync(d_bndHR,bndHR,cnt*sizeof(double),cudaMemcpyHostToDevice,0);
+    }
+    unpack_rows<<<BL_TH(2*row,nTh)>>>(d_u,d_bndHR,myNy+2);
   }
   gen_bndYL<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,TBnd);
   gen_bndYU<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,BBnd);
 }
 
+void setVHalo(int TBnd, int BBnd){
+  MPI_Request reqs[4];
+
+  packVHalo();
+  postVHalo(reqs);
+  finishVHalo(reqs,TBnd,BBnd);
+}
+
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   int lI,i,j;
   double sum, corr;
@@ -135,13 +192,45 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
+//Y pass with the halo exchange in flight while the cells that do not
+//depend on it are updated on the default stream, the two cells next to
+//each end of the slab are finished after the wait. Needs myNy>=4
+void runPassOverlapY(double dt){
+  int np=myNy;
+  int nt=Hp->nx;
+  double dtdx=dt/Hp->dy;
+  MPI_Request reqs[4];
+
+  STAGE(ST_HALO,packVHalo());
+  STAGE(ST_PRIM,toPrimY_rng<<<BL_TH(np*nt,nTh)>>>(d_q,d_u,2,np));
+  STAGE(ST_TRACE,trace_rng<<<BL_TH((np-2)*nt,nTh)>>>(d_ql,d_qr,d_q,dtdx,np,nt,2,np-2));
+  STAGE(ST_RIEM,riemann_rng<<<BL_TH((np-3)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt,2,np-3));
+  if(np>4){
+    STAGE(ST_FLUX,addFluxY_rng<<<BL_TH((np-4)*nt,nTh)>>>(d_u,d_flx,dtdx,2,np-4));
+  }
+  STAGE(ST_HALO,postVHalo(reqs));
+
+  STAGE(ST_HALO,finishVHalo(reqs,bndT,bndB));
+  STAGE(ST_PRIM,toPrimY_rng<<<BL_TH(2*nt,nTh)>>>(d_q,d_u,0,2));
+  STAGE(ST_PRIM,toPrimY_rng<<<BL_TH(2*nt,nTh)>>>(d_q,d_u,np+2,2));
+  STAGE(ST_TRACE,trace_rng<<<BL_TH(2*nt,nTh)>>>(d_ql,d_qr,d_q,dtdx,np,nt,0,2));
+  STAGE(ST_TRACE,trace_rng<<<BL_TH(2*nt,nTh)>>>(d_ql,d_qr,d_q,dtdx,np,nt,np,2));
+  STAGE(ST_RIEM,riemann_rng<<<BL_TH(2*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt,0,2));
+  STAGE(ST_RIEM,riemann_rng<<<BL_TH(2*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt,np-1,2));
+  STAGE(ST_FLUX,addFluxY_rng<<<BL_TH(2*nt,nTh)>>>(d_u,d_flx,dtdx,0,2));
+  STAGE(ST_FLUX,addFluxY_rng<<<BL_TH(2*nt,nTh)>>>(d_u,d_flx,dtdx,np-2,2));
+}
+
 void runPass(double dt, int dir){
   int np,nt;
   double dx,dy;
   char dCh;
   char outLab[30];
 
-
+  if(dir==1&&Ha->haloOverlap&&myNy>=4){
+    runPassOverlapY(dt);
+    return;
+  }
   if(dir==0){
     np=Hp->nx;
     nt=myNy;
@@ -149,8 +238,8 @@ void runPass(double dt, int dir){
     dy=Hp->dy;
     dCh='x';
     //printf("N[%2d]:X-pass\n",rank);
-    setHHalo(Hp->bndL,Hp->bndR);
-    toPrimX<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    STAGE(ST_BND,setHHalo(Hp->bndL,Hp->bndR));
+    STAGE(ST_PRIM,toPrimX<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u));
   }else{
     np=myNy;
     nt=Hp->nx;
@@ -158,18 +247,52 @@ void runPass(double dt, int dir){
     dy=Hp->dx;
     dCh='y';
     //printf("N[%2d]:Y-pass\n",rank);
-    setVHalo(bndT,bndB);
-    toPrimY<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    STAGE(ST_HALO,setVHalo(bndT,bndB));
+    STAGE(ST_PRIM,toPrimY<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u));
   }
-  trace<<<BL_TH((np+2)*nt,nTh)>>>(d_ql,d_qr,d_q,dt/dx,np,nt);
-  riemann<<<BL_TH((np+1)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt);
+  STAGE(ST_TRACE,trace<<<BL_TH((np+2)*nt,nTh)>>>(d_ql,d_qr,d_q,dt/dx,np,nt));
+  STAGE(ST_RIEM,riemann<<<BL_TH((np+1)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt));
   if(dir==0){
-    addFluxX<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
+    STAGE(ST_FLUX,addFluxX<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx));
   }else{
-    addFluxY<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
+    STAGE(ST_FLUX,addFluxY<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx));
   }
 }
 
+//Writes the vis file of step n. The interior of every rank is packed into
+//recvMesh, then either each rank writes its own slab (VIS_PARALLEL) or the
+//slabs are gathered into gMesh and written by rank 0
+void writeMeshVis(double *lMesh, double *recvMesh, double *gMesh, int *counts, int *dspls, int n){
+  int nV,lI,i,j,p;
+  int *ext;
+  char outfile[30];
+
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<Hp->nx*myNy;lI++){
+      i=lI%(Hp->nx);
+      j=lI/(Hp->nx);
+      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
+    }
+  }
+  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+#if VIS_FORMAT==VIS_PARALLEL
+  ext=(int *)malloc(4*size*sizeof(int));
+  for(p=0;p<size;p++){
+    ext[4*p  ]=0;
+    ext[4*p+1]=Hp->nx;
+    ext[4*p+2]=dspls[p]/Hp->nx;
+    ext[4*p+3]=counts[p]/Hp->nx;
+  }
+  writeVisParAsync(outfile,recvMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny,ext,rank,size);
+  free(ext);
+#else
+  for(nV=0;nV<Hp->nvar;nV++){
+    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
+  }
+  if(rank==0)writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+#endif
+}
+
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, nV, lI, i,j;
   int bndL;
@@ -192,6 +315,10 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   size_t meshSize, primSize, qSize, flxSize;
 
   double initT, endT;
+  double visT, outT;
+#if STAGE_TIMERS
+  double stT;
+#endif
 
   //MPI vars
   int mpi_err;
@@ -210,6 +337,7 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   size_t mem_reqd, mem_avail;
 
   int nanCnt[4];
+  size_t bndSize;
 
   mpi_err=MPI_Init(argc,argv);
 
@@ -324,6 +452,27 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_denB,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
+  bndSize=2*(Hp->nx+4)*Hp->nvar;
+  cudaMalloc(&d_bndLS,bndSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMalloc(&d_bndLR,bndSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMalloc(&d_bndHS,bndSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMalloc(&d_bndHR,bndSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  if(!Ha->cudaAware){
+    cudaMallocHost(&bndLS,bndSize*sizeof(double));
+    cudaMallocHost(&bndLR,bndSize*sizeof(double));
+    cudaMallocHost(&bndHS,bndSize*sizeof(double));
+    cudaMallocHost(&bndHR,bndSize*sizeof(double));
+  }
+  cudaStreamCreateWithFlags(&hStream,cudaStreamNonBlocking);
+  cudaEventCreateWithFlags(&haloEv,cudaEventDisableTiming);
+#if STAGE_TIMERS
+  cudaEventCreate(stEv);
+  cudaEventCreate(stEv+1);
+#endif
 
   //if(rank==0)printf("Arrays allocated\n");
 
@@ -374,23 +523,15 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 #endif
 
   //Print initial condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
+  writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n);
   if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
     printf("INIT: TM: %g TE: %g\n",volCell*ogTM,volCell*ogTE);
   }
  
   cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
  
   initT=MPI_Wtime();
+  outT=0.0;
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
     //Calculate timestep
@@ -400,6 +541,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
     nTh=nThCDT;
     //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
     //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
+#if STAGE_TIMERS
+    stT=MPI_Wtime();
+#endif
     calc_denom<<<nBlockM,nTh,nTh*sizeof(double)>>>(d_u,d_denA);
     //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
     //printArray("Dens",recvMesh,1,nDen,1,0,0);
@@ -416,6 +560,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
     cudaMemcpy(&dt_denom,d_denA,sizeof(double),cudaMemcpyDeviceToHost);
     //printf("N[%2d] ITER %d l denom=%g\n",rank,n,dt_denom);
     MPI_Allreduce(&dt_denom,&gDenom,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
+#if STAGE_TIMERS
+    stageT[ST_DT]+=MPI_Wtime()-stT;
+#endif
     //printf("N[%2d] ITER %d g denom=%g\n",rank,n,gDenom);
     dt=0.5*Ha->sigma/gDenom;
     if(nxttout>0.0&&dt>(nxttout-cTime)){
@@ -462,18 +609,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
           if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
           //if(rank==0)printf("Next Vis Time: %f\n",nxttout);
         }
-        for(nV=0;nV<Hp->nvar;nV++){
-          for(lI=0;lI<Hp->nx*myNy;lI++){
-            i=lI%(Hp->nx);
-            j=lI/(Hp->nx);
-            recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-          }
-          MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-        }
-        if(rank==0){
-          snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-          writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-        }
+        visT=MPI_Wtime();
+        STAGE(ST_VIS,writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n));
+        outT+=MPI_Wtime()-visT;
       }
     }
   }
@@ -482,25 +620,23 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   endT=MPI_Wtime();
 
   if(rank==0){
-    printf("TFMT:%s,%s,%s,%s.%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"MPI/CUDA\"","\"GPU:?\"","\"Init\"",size,1,n,Hp->nx*Hp->ny,(endT-initT));
+    printf("TFMT:%s,%s,%s,%s.%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"MPI/CUDA\"","\"GPU:?\"","\"Init\"",size,1,n,Hp->nx*Hp->ny,(endT-initT),endT-initT-outT,outT);
+  }
+#if STAGE_TIMERS
+  //Slowest rank of each stage
+  MPI_Reduce(rank==0?MPI_IN_PLACE:stageT,stageT,NSTAGE,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+  if(rank==0){
+    printf("SFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","calcDT","toPrim","setBnd","trace","riemann","addFlux","halo","vis");
+    printf("STAGE:%s,%g,%g,%g,%g,%g,%g,%g,%g\n","\"MPI/CUDA\"",stageT[ST_DT],stageT[ST_PRIM],stageT[ST_BND],stageT[ST_TRACE],stageT[ST_RIEM],stageT[ST_FLUX],stageT[ST_HALO],stageT[ST_VIS]);
   }
+#endif
   
   cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
 
   //Print final condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
-  if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-  }
+  writeMeshVis(lMesh,recvMesh,gMesh,counts,dspls,n);
+  visFinish();
   Hp->t+=cTime;
 
   free(recvMesh);
@@ -512,6 +648,22 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   cudaFree(d_flx);
   cudaFree(d_denA);
   cudaFree(d_denB);
+  cudaFree(d_bndLS);
+  cudaFree(d_bndLR);
+  cudaFree(d_bndHS);
+  cudaFree(d_bndHR);
+  if(!Ha->cudaAware){
+    cudaFreeHost(bndLS);
+    cudaFreeHost(bndLR);
+    cudaFreeHost(bndHS);
+    cudaFreeHost(bndHR);
+  }
+  cudaEventDestroy(haloEv);
+#if STAGE_TIMERS
+  cudaEventDestroy(stEv[0]);
+  cudaEventDestroy(stEv[1]);
+#endif
+  cudaStreamDestroy(hStream);
 
   printf("NODE %d: Finalizing MPI\n",rank);
   MPI_Finalize();
@@ -42,6 +42,11 @@ typedef struct __hydroArgs{
     int iorder;
     double slope_type;
     int scheme;
+
+    // Pass device pointers to MPI in the halo exchange
+    int cudaAware;
+    // Overlap the y halo exchange with the interior update
+    int haloOverlap;
 } hydro_args;
 
 #endif
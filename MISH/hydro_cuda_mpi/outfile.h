@@ -1,8 +1,22 @@
 #ifndef OUTFILE_H_
 #define OUTFILE_H_
 
+#include <stddef.h>
 #include "hydro_struct.h"
 
 void writeVis(char *name, double *mesh, double dx, double dy, int nvar, int nx, int ny);
+void writeVisBin(char *name, double *mesh, double dx, double dy, int nvar, int nx, int ny);
+void writeVisPiece(char *outName, double *mesh, double dx, double dy, int nvar, int nx, int ny,
+		   int gnx, int gny, int xOff, int yOff);
+void writeVisPar(char *name, double *mesh, double dx, double dy, int nvar, int gnx, int gny,
+		 int *ext, int rank, int nRank);
+void writeVisAsync(char *name, double *mesh, double dx, double dy, int nvar, int nx, int ny);
+void writeVisParAsync(char *name, double *mesh, double dx, double dy, int nvar, int gnx, int gny,
+		      int *ext, int rank, int nRank);
+double *visStage(size_t size);
+void visSubmit(char *name, double dx, double dy, int nvar, int nx, int ny);
+void visSubmitPar(char *name, double dx, double dy, int nvar, int gnx, int gny,
+		  int *ext, int rank, int nRank);
+void visFinish();
 
 #endif //OUTFILE_H_
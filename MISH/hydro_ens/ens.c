@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "ens.h"
+
+//Sum of variable var over the mesh of a member
+static double sumMesh(ens_member *m, int var){
+  int i;
+  int nc=m->prob.nx*m->prob.ny;
+  double sum=0.0;
+
+  for(i=0;i<nc;i++){
+    sum+=m->mesh[i+nc*var];
+  }
+  return sum*m->prob.dx*m->prob.dy;
+}
+
+//The steps of engine in hydro_c without its output: dt from the mesh,
+//clipped to end on tend, and the two passes in alternating order
+static void runMember(ens_member *m){
+  hydro_prob *Hp=&m->prob;
+  hydro_args *Ha=&m->args;
+  double dt, cTime;
+  double initT;
+  int n;
+
+  m->oTM=sumMesh(m,VARRHO);
+  m->oTE=sumMesh(m,VARPR );
+  initT=omp_get_wtime();
+  setKernelProb(Hp,Ha);
+  allocPasses();
+  n=0;
+  cTime=Hp->t;
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    dt=Ha->sigma*calcDT(m->mesh);
+    if(Ha->tend>0.0&&dt>(Ha->tend-cTime))dt=Ha->tend-cTime;
+    if(n%2==0){
+      runPass(m->mesh,dt,n,0);
+      runPass(m->mesh,dt,n,1);
+    }else{
+      runPass(m->mesh,dt,n,1);
+      runPass(m->mesh,dt,n,0);
+    }
+    n+=1;
+    cTime+=dt;
+  }
+  freePasses();
+  Hp->t=cTime;
+  m->niters=n;
+  m->wComp=omp_get_wtime()-initT;
+  m->TM=sumMesh(m,VARRHO);
+  m->TE=sumMesh(m,VARPR );
+}
+
+void ensEngine(ens_member *mem, int nMem, ens_stats *St){
+  int i;
+  double initT;
+
+  initT=omp_get_wtime();
+  //Members can take very different numbers of steps, so they are handed
+  //out one at a time
+#pragma omp parallel for schedule(dynamic,1)
+  for(i=0;i<nMem;i++){
+    runMember(mem+i);
+  }
+  St->wComp=omp_get_wtime()-initT;
+
+  St->niters=0;
+  St->cellUpdates=0.0;
+  St->wMembers=0.0;
+  for(i=0;i<nMem;i++){
+    St->niters+=mem[i].niters;
+    St->cellUpdates+=(double)mem[i].niters*mem[i].prob.nx*mem[i].prob.ny;
+    St->wMembers+=mem[i].wComp;
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef ENS_H_
+#define ENS_H_
+
+#include "hydro.h"
+
+//One problem of an ensemble, its own mesh, problem and arguments, and what
+//its run left
+typedef struct __ensMember{
+  hydro_prob prob;
+  hydro_args args;
+  real_t *mesh;
+  //Value of the swept parameter
+  double value;
+  int niters;
+  //Wall time of the member's steps
+  double wComp;
+  //Total mass and energy before and after the run
+  double oTM, oTE;
+  double TM, TE;
+} ens_member;
+
+typedef struct __ensStats{
+  int niters;
+  //Cells updated by the steps of all the members
+  double cellUpdates;
+  //Wall time of the whole ensemble, and summed over the members
+  double wComp;
+  double wMembers;
+} ens_stats;
+
+//Runs every member from its initial mesh to its args.tend or
+//args.nstepmax with the passes of hydro_c. The members are spread over the
+//OpenMP threads, each one runs a whole member at a time on its own pass
+//arrays
+void ensEngine(ens_member *mem, int nMem, ens_stats *St);
+
+#endif //ENS_H_
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "ens.h"
+
+//Initial conditions on the unit square: the high density corner of crn,
+//and the lower half of sod turned into a square, rhoIn in the high region
+static void initMesh(ens_member *m, int init, double rhoIn){
+  int i,j;
+  int in;
+  int nx=m->prob.nx;
+  int ny=m->prob.ny;
+
+  for(j=0;j<ny;j++){
+    for(i=0;i<nx;i++){
+      if(init==1)in=(j<ny/2);
+      else in=(i<nx/2&&j<ny/2);
+      m->mesh[i+nx*(j+ny*VARRHO)]=in?rhoIn:0.125;
+      m->mesh[i+nx*(j+ny*VARVX )]=0.0;
+      m->mesh[i+nx*(j+ny*VARVY )]=0.0;
+      m->mesh[i+nx*(j+ny*VARPR )]=in?2.5:2.0;
+    }
+  }
+}
+
+int main(int argc, char* argv[]){
+  ens_member *mem;
+  ens_stats St;
+  ens_member *m;
+  int init=0;
+  int nMem=0;
+  int n=64;
+  int param=0;
+  double lo=0.0, hi=0.0;
+  int i;
+
+  if(argc<3){
+    printf("No init and member count supplied\n");
+    return 1;
+  }
+  if(!strcmp(argv[1],"sod")) init=1;
+  else if(!strcmp(argv[1],"crn")) init=2;
+  else{
+    printf("Unknown init\n");
+    return 1;
+  }
+  if(sscanf(argv[2],"%d",&nMem)!=1||nMem<1){
+    printf("Bad member count\n");
+    return 1;
+  }
+  //Parameter swept over the members, from lo for the first to hi for the
+  //last
+  if(argc>3){
+    if(!strcmp(argv[3],"gamma")) param=1;
+    else if(!strcmp(argv[3],"sigma")) param=2;
+    else if(!strcmp(argv[3],"rho")) param=3;
+    else{
+      printf("Unknown parameter\n");
+      return 1;
+    }
+    if(argc<6||sscanf(argv[4],"%lf",&lo)!=1||sscanf(argv[5],"%lf",&hi)!=1){
+      printf("No parameter range supplied\n");
+      return 1;
+    }
+  }
+  if(argc>6&&(sscanf(argv[6],"%d",&n)!=1||n<4)){
+    printf("Bad mesh size\n");
+    return 1;
+  }
+
+  printf("INIT:%s\n",argv[1]);
+  printf("INIT:%d members of %dx%d\n",nMem,n,n);
+  mem=(ens_member*)malloc(nMem*sizeof(ens_member));
+  for(i=0;i<nMem;i++){
+    m=mem+i;
+    m->prob.nx=n;
+    m->prob.ny=n;
+    m->prob.dx=1.0/n;
+    m->prob.dy=1.0/n;
+    m->prob.t=0.0;
+    m->prob.nvar=4;
+    m->prob.gamma=1.4;
+    m->prob.bndL=BND_REFL;
+    m->prob.bndR=BND_REFL;
+    m->prob.bndU=BND_REFL;
+    m->prob.bndD=BND_REFL;
+
+    m->args.sigma=0.9;
+    m->args.nprtLine=100;
+    m->args.tend=0.1;
+    m->args.nstepmax=-1;
+    m->args.noutput=-1;
+    m->args.dtoutput=-1.0;
+    m->args.outPre[0]='\0';
+    m->args.initFile[0]='\0';
+    m->args.smallr=1e-10;
+    m->args.smallc=1e-10;
+    m->args.niter_riemann=10;
+    m->args.riemannMode=RIEMANN_MODE;
+    m->args.sweepTile=SWEEP_TILE;
+    m->args.yBlock=Y_BLOCK;
+    m->args.fusedDT=0;
+    m->args.nchkpt=0;
+    m->args.ninsitu=0;
+    m->args.nstart=0;
+    m->args.nxtstart=-1.0;
+
+    m->value=(nMem>1)?lo+(hi-lo)*i/(nMem-1):lo;
+    if(param==1)m->prob.gamma=m->value;
+    if(param==2)m->args.sigma=m->value;
+    m->mesh=(real_t*)malloc(m->prob.nvar*n*n*sizeof(real_t));
+    initMesh(m,init,(param==3)?m->value:1.0);
+  }
+
+  ensEngine(mem,nMem,&St);
+
+  printf("MFMT:%s,%s,%s,%s,%s,%s,%s\n","member","value","niters","time","wComp","dTM","dTE");
+  for(i=0;i<nMem;i++){
+    m=mem+i;
+    printf("MEM:%d,%g,%d,%g,%g,%g,%g\n",i,m->value,m->niters,m->prob.t,m->wComp,m->TM-m->oTM,m->TE-m->oTE);
+  }
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt","wComp","wOut");
+  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g,%g,%g\n","\"ENS\"","\"CPU:?\"","\"Init\"",1,omp_get_max_threads(),St.niters,nMem*n*n,St.wComp,St.wComp,0.0);
+  printf("EFMT:%s,%s,%s,%s\n","members","cellsPerSec","wMembers","parEff");
+  printf("ENS:%d,%g,%g,%g\n",nMem,St.cellUpdates/St.wComp,St.wMembers,St.wMembers/(St.wComp*omp_get_max_threads()));
+
+  for(i=0;i<nMem;i++){
+    free(mem[i].mesh);
+  }
+  free(mem);
+  return 0;
+}
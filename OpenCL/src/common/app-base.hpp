@@ -2,17 +2,266 @@
 #define APP_BASE_INCLUDED_H 1
 
 #include <algorithm>
+#include <cmath>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <cstdio>
 #include <cstdlib>
 
+#include <sys/stat.h>
+#include <sys/time.h>
+
 #define __CL_ENABLE_EXCEPTIONS
 #include "common/cl.hpp"
 
+///
+// A buffer the host fills and reads through a mapped pointer, see
+// AppBase::create_host_buffer. On a device sharing memory with the host
+// the kernels use the very memory the host maps, and nothing is copied; on
+// another device the host maps a pinned staging buffer, copied to and from
+// the buffer of the kernels at the full speed of the bus
+///
+struct HostBuffer {
+    cl::Buffer device;      // the buffer of the kernels
+    cl::Buffer staging;     // the pinned buffer the host maps, if not zero copy
+    void * host;            // the mapped pointer, NULL while the device has it
+    size_t size;
+    bool zero_copy;
+};
+
+///
+// A 1D problem the devices each take a part of, see
+// AppBase::partitioned_launch: enqueue runs the items offset .. offset +
+// count - 1 on the queue of device_id, copies and all, without waiting
+///
+class PartitionedKernel {
+
+public:
+
+    virtual ~PartitionedKernel() {}
+
+    virtual void enqueue(cl::CommandQueue & queue,
+                         int device_id,
+                         size_t offset,
+                         size_t count) = 0;
+
+};
+
+///
+// The items of a 1D problem of each device: devices[k] takes count[k] items
+// from offset[k]
+///
+struct Partition {
+    std::vector<int> devices;
+    std::vector<size_t> offset;
+    std::vector<size_t> count;
+};
+
+///
+// A 1D problem run a chunk at a time, see AppBase::pipelined_run: the
+// chunks go through device buffers of nslots slots, and each stage enqueues
+// the items offset .. offset + count - 1 of chunk through slot, after the
+// events of wait, its own event in done
+///
+class ChunkedKernel {
+
+public:
+
+    virtual ~ChunkedKernel() {}
+
+    virtual void enqueue_upload(cl::CommandQueue & queue,
+                                size_t slot,
+                                size_t offset,
+                                size_t count,
+                                std::vector<cl::Event> const * wait,
+                                cl::Event * done) = 0;
+
+    virtual void enqueue_compute(cl::CommandQueue & queue,
+                                 size_t slot,
+                                 size_t offset,
+                                 size_t count,
+                                 std::vector<cl::Event> const * wait,
+                                 cl::Event * done) = 0;
+
+    virtual void enqueue_download(cl::CommandQueue & queue,
+                                  size_t slot,
+                                  size_t offset,
+                                  size_t count,
+                                  std::vector<cl::Event> const * wait,
+                                  cl::Event * done) = 0;
+
+};
+
+///
+// A command of the profile of AppBase::profile and record_event: its name,
+// the device it ran on and the bytes it moved or a kernel reads and writes,
+// and once it is done its times and the queue it ran on, by
+// AppBase::report_profile
+///
+struct ProfileRecord {
+    std::string name;
+    int device_id;
+    size_t bytes;
+    cl::Event event;
+    cl_ulong queued, submit, start, end;
+    size_t queue;
+};
+
+///
+// A buffer of the pool of AppBase::acquire_buffer, free once the last
+// command using it, if any, is complete
+///
+struct PooledBuffer {
+    cl::Buffer buffer;
+    cl::Event last;
+};
+
+///
+// Commands and the commands each waits for, see AppBase::run_task_graph:
+// a node is a kernel, a write, a read or a copy on a device, and it is
+// enqueued with the events of the nodes before it as its wait list, so
+// that on out-of-order queues the nodes that do not depend on each other
+// may run at once. A kernel node runs with the arguments its kernel has
+// when the graph runs, so nodes of one kernel with other arguments need
+// kernel objects of their own, and the host memory of the writes and reads
+// must stay until it returns
+///
+class TaskGraph {
+
+public:
+
+    enum Type { KERNEL, WRITE, READ, COPY };
+
+    struct Node {
+        Type type;
+        std::string name;
+        int device_id;
+        cl::Kernel kernel;
+        cl::NDRange global;
+        cl::NDRange local;
+        cl::Buffer buffer;      // the buffer written or read, or copied from
+        cl::Buffer other;       // the buffer copied to
+        size_t offset;
+        size_t other_offset;
+        size_t size;            // the bytes copied, or a kernel reads and writes
+        void * ptr;
+        std::vector<size_t> after;
+        cl::Event event;
+    };
+
+    // the number of the node of kernel on device_id over global, local if
+    // it is not cl::NullRange
+    size_t add_kernel(std::string const & name,
+                      int device_id,
+                      cl::Kernel const & kernel,
+                      cl::NDRange const & global,
+                      cl::NDRange const & local = cl::NullRange,
+                      size_t bytes = 0)
+        {
+            Node & node = add(KERNEL, name, device_id);
+            node.kernel = kernel;
+            node.global = global;
+            node.local = local;
+            node.size = bytes;
+            return nodes_m.size() - 1;
+        }
+
+    // size bytes of ptr to offset of buffer
+    size_t add_write(std::string const & name,
+                     int device_id,
+                     cl::Buffer const & buffer,
+                     size_t offset,
+                     size_t size,
+                     void const * ptr)
+        {
+            Node & node = add(WRITE, name, device_id);
+            node.buffer = buffer;
+            node.offset = offset;
+            node.size = size;
+            node.ptr = const_cast<void *>(ptr);
+            return nodes_m.size() - 1;
+        }
+
+    // size bytes from offset of buffer to ptr
+    size_t add_read(std::string const & name,
+                    int device_id,
+                    cl::Buffer const & buffer,
+                    size_t offset,
+                    size_t size,
+                    void * ptr)
+        {
+            Node & node = add(READ, name, device_id);
+            node.buffer = buffer;
+            node.offset = offset;
+            node.size = size;
+            node.ptr = ptr;
+            return nodes_m.size() - 1;
+        }
+
+    // size bytes from src_offset of src to dst_offset of dst
+    size_t add_copy(std::string const & name,
+                    int device_id,
+                    cl::Buffer const & src,
+                    cl::Buffer const & dst,
+                    size_t src_offset,
+                    size_t dst_offset,
+                    size_t size)
+        {
+            Node & node = add(COPY, name, device_id);
+            node.buffer = src;
+            node.other = dst;
+            node.offset = src_offset;
+            node.other_offset = dst_offset;
+            node.size = size;
+            return nodes_m.size() - 1;
+        }
+
+    // node waits for before
+    void add_edge(size_t before, size_t node)
+        {
+            nodes_m[node].after.push_back(before);
+        }
+
+    size_t size() const
+        {
+            return nodes_m.size();
+        }
+
+    // the event of node, once the graph ran
+    cl::Event const & event(size_t node) const
+        {
+            return nodes_m[node].event;
+        }
+
+private:
+
+    friend class AppBase;
+
+    Node & add(Type type, std::string const & name, int device_id)
+        {
+            Node node;
+            node.type = type;
+            node.name = name;
+            node.device_id = device_id;
+            node.offset = 0;
+            node.other_offset = 0;
+            node.size = 0;
+            node.ptr = NULL;
+            nodes_m.push_back(node);
+            return nodes_m.back();
+        }
+
+    std::vector<Node> nodes_m;
+
+};
+
 ///
 // A class providing OpenCL boiler plate for simple applications
 ///
@@ -22,13 +271,22 @@ public:
 
     AppBase(int debug,
             int profile,
-            int verbose)
+            int verbose,
+            int out_of_order = 0)
         : debug_m(debug),
           profile_m(profile),
-          verbose_m(verbose)
+          verbose_m(verbose),
+          selected_device_m(-1),
+          pool_hits_m(0),
+          pool_misses_m(0)
         {
             int rc = CL_SUCCESS;
 
+            // Program binaries are cached in $CODY_CL_CACHE, .cl-cache by
+            // default, or not at all if it is set but empty
+            char const * cache_dir = getenv("CODY_CL_CACHE");
+            cache_dir_m = cache_dir ? cache_dir : ".cl-cache";
+
             // Check we have an OpenCL implementation
             cl::Platform::get(&platform_m);
             if (platform_m.size() == 0) {
@@ -99,8 +357,22 @@ public:
             if (profile_m) {
                 properties |= CL_QUEUE_PROFILING_ENABLE;
             }
+            // out-of-order queues where asked for and the device has them,
+            // the commands then ordered by their events only
             for (size_t i = 0; i < device_m.size(); ++i) {
-                queue_m.push_back(cl::CommandQueue(context_m, device_m[i], properties, &rc));
+                cl_uint device_properties = properties;
+                bool const unordered = out_of_order &&
+                    (device_m[i].getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+                if (unordered) {
+                    device_properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+                }
+                queue_m.push_back(cl::CommandQueue(context_m, device_m[i], device_properties, &rc));
+                out_of_order_m.push_back(unordered);
+                if (verbose_m && out_of_order) {
+                    std::cerr << "[Queues]\n  device[" << i << "]: "
+                              << (unordered ? "out of order" : "in order, out of order not supported")
+                              << "\n";
+                }
             }
 		}
 
@@ -108,19 +380,51 @@ public:
 		{
 		}
 
-	virtual void build_program(std::string const & device_program_text = "")
+	///
+	// Build the program for all the devices, with the constants of
+	// define_program_constants as -D options. The program is the one of
+	// $CODY_CL_PROGRAM if it is set, a SPIR-V module or the binary of an
+	// offline compiler, else the binaries of an earlier build of the same
+	// text and options for the same devices and drivers if there are any in
+	// the cache, else the text, caching the binaries. With $CODY_CL_SOURCE
+	// set the text goes to that file too, the constants defined at its top,
+	// for an offline compiler to build for the runs of this problem
+	///
+	virtual void build_program(std::string const & device_program_text = "",
+							   std::string const & options = "")
 		{
 			if (device_program_text.size()) {
 				device_program_text_m = device_program_text;
 			} else {
 				device_program_text_m = get_device_program_text();
 			}
+			program_defines_m.clear();
+			define_program_constants();
+			device_program_text_m += program_defines_kernel();
+
+			std::string build_options = options;
+			for (size_t k = 0; k < program_defines_m.size(); ++k) {
+				std::ostringstream d;
+				d << " -D" << program_defines_m[k].first << "=" << program_defines_m[k].second;
+				build_options += d.str();
+			}
+			if (verbose_m && program_defines_m.size()) {
+				std::cerr << "[Program]\n  options:" << build_options << "\n";
+			}
+			save_program_source();
+
+			if (load_program_file(options)) {
+				return;
+			}
+			if (load_program_binaries(build_options)) {
+				return;
+			}
 			
 			// Build the program
 			cl::Program::Sources source(1, std::make_pair(device_program_text_m.c_str(), device_program_text_m.length()));
 			program_m = cl::Program(context_m, source);
 			try {
-				program_m.build(device_m);
+				program_m.build(device_m, build_options.c_str());
 			}
 			catch (cl::Error error) {
 				std::cerr << "ERROR: Build failed\n";
@@ -131,6 +435,261 @@ public:
 				}
 				throw;
 			}			
+
+			save_program_binaries(build_options);
+		}
+
+	// a constant of the problem for the program, an integer the kernels are
+	// built with as -D name=value, so that the compiler can unroll and fold
+	// on it. a kernel takes the same value as an argument for where the
+	// program has not been built with it
+	void define_constant(std::string const & name, long value)
+		{
+			program_defines_m.push_back(std::make_pair(name, value));
+		}
+
+	// the kernel cody_program_defines, appended to every program: each
+	// constant of define_program_constants as the program was built, -1 for
+	// one it was built without, which check_program_defines compares with
+	// those of this run
+	std::string program_defines_kernel()
+		{
+			std::ostringstream k;
+			k << "\n__kernel void cody_program_defines(__global long* out)\n{\n";
+			for (size_t i = 0; i < program_defines_m.size(); ++i) {
+				std::string const & name = program_defines_m[i].first;
+				k << "#ifdef " << name << "\n"
+				  << "    out[" << i << "] = " << name << ";\n"
+				  << "#else\n"
+				  << "    out[" << i << "] = -1;\n"
+				  << "#endif\n";
+			}
+			k << "}\n";
+			return k.str();
+		}
+
+	// throws if program_m was built with a constant other than the one of
+	// this run, as a program file built for another problem would be
+	void check_program_defines()
+		{
+			if (program_defines_m.empty()) {
+				return;
+			}
+			size_t const n = program_defines_m.size();
+			std::vector<cl_long> values(n);
+			cl::Kernel kernel(program_m, "cody_program_defines");
+			cl::Buffer out(context_m, CL_MEM_WRITE_ONLY, n * sizeof(cl_long));
+			kernel.setArg(0, out);
+			queue_m[0].enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(1), cl::NullRange);
+			queue_m[0].enqueueReadBuffer(out, CL_TRUE, 0, n * sizeof(cl_long), &values[0]);
+			for (size_t i = 0; i < n; ++i) {
+				if (values[i] != -1 && values[i] != program_defines_m[i].second) {
+					std::ostringstream e;
+					e << "the program of CODY_CL_PROGRAM has " << program_defines_m[i].first
+					  << "=" << values[i] << ", this run needs " << program_defines_m[i].second;
+					throw std::runtime_error(e.str());
+				}
+			}
+		}
+
+	// the program text to $CODY_CL_SOURCE, if it is set, with the constants
+	// of the problem defined at its top
+	void save_program_source()
+		{
+			char const * file = getenv("CODY_CL_SOURCE");
+			if (file == NULL || file[0] == '\0') {
+				return;
+			}
+			std::ofstream out(file);
+			for (size_t k = 0; k < program_defines_m.size(); ++k) {
+				out << "#define " << program_defines_m[k].first << " "
+					<< program_defines_m[k].second << "\n";
+			}
+			out << device_program_text_m;
+			if (!out) {
+				std::cerr << "WARNING: could not write " << file << "\n";
+			} else if (verbose_m) {
+				std::cerr << "[Program]\n  text in " << file << "\n";
+			}
+		}
+
+	// program_m from the file of $CODY_CL_PROGRAM, false if it is not set:
+	// a SPIR-V module, by its magic number, or a binary for every device,
+	// built with options and checked against the constants of this run.
+	// unlike a cached binary one the driver turns down is an error, a
+	// deployment that ships the file not wanting a build at run time
+	bool load_program_file(std::string const & options)
+		{
+			char const * file = getenv("CODY_CL_PROGRAM");
+			if (file == NULL || file[0] == '\0') {
+				return false;
+			}
+			std::ifstream in(file, std::ios::binary);
+			std::ostringstream data;
+			data << in.rdbuf();
+			std::string const image = data.str();
+			if (!in || image.size() < 4) {
+				throw std::runtime_error(std::string("could not read ") + file);
+			}
+
+			unsigned char const * bytes = (unsigned char const *)image.data();
+			bool const spirv = bytes[0] == 0x03 && bytes[1] == 0x02 &&
+				bytes[2] == 0x23 && bytes[3] == 0x07;
+			if (spirv) {
+#ifdef CL_VERSION_2_1
+				cl_int rc;
+				cl_program program = clCreateProgramWithIL(context_m(), image.data(), image.size(), &rc);
+				if (rc != CL_SUCCESS) {
+					throw cl::Error(rc, "clCreateProgramWithIL");
+				}
+				// the wrapper takes over the reference of the program
+				program_m = cl::Program();
+				program_m() = program;
+#else
+				throw std::runtime_error(std::string(file) + " is SPIR-V, which needs OpenCL 2.1 headers");
+#endif
+			} else {
+				cl::Program::Binaries binaries;
+				for (size_t i = 0; i < device_m.size(); ++i) {
+					binaries.push_back(std::make_pair((void const *)image.data(), image.size()));
+				}
+				program_m = cl::Program(context_m, device_m, binaries);
+			}
+			try {
+				program_m.build(device_m, options.c_str());
+			}
+			catch (cl::Error const & error) {
+				for (size_t i = 0; i < device_m.size(); ++i) {
+					std::string build_log = program_m.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device_m[i]);
+					std::cerr << "Build log for device[" << i << "]:\n" << build_log << "\n";
+				}
+				throw;
+			}
+			check_program_defines();
+
+			if (verbose_m) {
+				std::cerr << "[Program]\n  loaded " << (spirv ? "SPIR-V" : "binary")
+						  << " " << file << "\n";
+			}
+			return true;
+		}
+
+	// the 64-bit FNV-1a hash of key, the name of what is cached for it
+	static unsigned long long cache_hash(std::string const & key)
+		{
+			unsigned long long hash = 14695981039346656037ULL;
+			for (size_t j = 0; j < key.size(); ++j) {
+				hash ^= (unsigned char)key[j];
+				hash *= 1099511628211ULL;
+			}
+			return hash;
+		}
+
+	// the cache file of the binary of the program for device i: a hash of
+	// the program text, the build options and the name, version and driver
+	// version of the device, the binary changing with any of them
+	std::string program_cache_file(size_t i, std::string const & options)
+		{
+			std::string key = device_program_text_m;
+			key += '\0';
+			key += options;
+			key += '\0';
+			key += device_m[i].getInfo<CL_DEVICE_NAME>();
+			key += '\0';
+			key += device_m[i].getInfo<CL_DEVICE_VERSION>();
+			key += '\0';
+			key += device_m[i].getInfo<CL_DRIVER_VERSION>();
+
+			char name[32];
+			snprintf(name, sizeof(name), "/%016llx.bin", cache_hash(key));
+			return cache_dir_m + name;
+		}
+
+	// program_m from the cached binaries of all the devices, false if one is
+	// missing or the driver turns one down, to build from the text instead
+	bool load_program_binaries(std::string const & options)
+		{
+			if (cache_dir_m.empty()) {
+				return false;
+			}
+
+			std::vector<std::string> images(device_m.size());
+			cl::Program::Binaries binaries;
+			for (size_t i = 0; i < device_m.size(); ++i) {
+				std::ifstream in(program_cache_file(i, options).c_str(), std::ios::binary);
+				if (!in) {
+					return false;
+				}
+				std::ostringstream image;
+				image << in.rdbuf();
+				images[i] = image.str();
+				if (images[i].empty()) {
+					return false;
+				}
+				binaries.push_back(std::make_pair((void const *)images[i].data(), images[i].size()));
+			}
+
+			try {
+				std::vector<cl_int> status(device_m.size());
+				program_m = cl::Program(context_m, device_m, binaries, &status);
+				program_m.build(device_m, options.c_str());
+			}
+			catch (cl::Error const & error) {
+				if (verbose_m) {
+					std::cerr << "[Program cache]\n  cached binaries turned down ("
+							  << opencl_error_string(error.err())
+							  << "), building from source\n";
+				}
+				return false;
+			}
+
+			if (verbose_m) {
+				std::cerr << "[Program cache]\n  loaded " << binaries.size()
+						  << " binaries from " << cache_dir_m << "\n";
+			}
+			return true;
+		}
+
+	// the binaries of program_m to the cache, errors only reported, the
+	// next run then building from the text again
+	void save_program_binaries(std::string const & options)
+		{
+			if (cache_dir_m.empty()) {
+				return;
+			}
+			mkdir(cache_dir_m.c_str(), 0755);
+
+			// cl.hpp hands CL_PROGRAM_BINARIES buffers it did not allocate,
+			// so the binaries are read by the C API into buffers of the
+			// sizes the program gives
+			std::vector<size_t> sizes = program_m.getInfo<CL_PROGRAM_BINARY_SIZES>();
+			std::vector<std::vector<unsigned char> > images(sizes.size());
+			std::vector<unsigned char *> pointers(sizes.size());
+			for (size_t i = 0; i < sizes.size(); ++i) {
+				images[i].resize(sizes[i] > 0 ? sizes[i] : 1);
+				pointers[i] = &images[i][0];
+			}
+			cl_int rc = clGetProgramInfo(program_m(), CL_PROGRAM_BINARIES,
+										 pointers.size() * sizeof(unsigned char *),
+										 &pointers[0], NULL);
+			if (rc != CL_SUCCESS) {
+				std::cerr << "WARNING: no program binaries to cache ("
+						  << opencl_error_string(rc) << ")\n";
+				return;
+			}
+
+			for (size_t i = 0; i < sizes.size() && i < device_m.size(); ++i) {
+				std::string file = program_cache_file(i, options);
+				std::ofstream out(file.c_str(), std::ios::binary);
+				if (sizes[i] == 0 ||
+					!out.write((char const *)&images[i][0], sizes[i])) {
+					std::cerr << "WARNING: could not cache " << file << "\n";
+				}
+			}
+			if (verbose_m) {
+				std::cerr << "[Program cache]\n  saved " << sizes.size()
+						  << " binaries to " << cache_dir_m << "\n";
+			}
 		}
 		
     static const char *opencl_error_string(cl_int err)
@@ -187,47 +746,939 @@ public:
 		return "Unknown error";
     }
 
-	// find the most capable device based on type, and then number of compute units
+	// whether device_id shares memory with the host, as integrated GPUs and
+	// CPU devices do
+	bool host_unified_memory(int device_id)
+	{
+		return device_m[device_id].getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() == CL_TRUE;
+	}
+
+	// a buffer of size bytes for the kernels of device_id, with flags for
+	// them, mapped for the host to fill on return
+	void create_host_buffer(int device_id,
+							cl_mem_flags flags,
+							size_t size,
+							HostBuffer & hb)
+	{
+		hb.size = size;
+		hb.zero_copy = host_unified_memory(device_id);
+		if (hb.zero_copy) {
+			hb.device = cl::Buffer(context_m, flags | CL_MEM_ALLOC_HOST_PTR, size);
+			hb.host = queue_m[device_id].enqueueMapBuffer(hb.device, CL_TRUE,
+														  CL_MAP_READ | CL_MAP_WRITE,
+														  0, size);
+		} else {
+			hb.device = cl::Buffer(context_m, flags, size);
+			hb.staging = cl::Buffer(context_m, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size);
+			hb.host = queue_m[device_id].enqueueMapBuffer(hb.staging, CL_TRUE,
+														  CL_MAP_READ | CL_MAP_WRITE,
+														  0, size);
+		}
+		if (verbose_m) {
+			std::cerr << "  host buffer of " << size << " bytes: "
+					  << (hb.zero_copy ? "zero copy" : "pinned staging") << "\n";
+		}
+	}
+
+	// hands what the host wrote to the kernels: unmaps a zero copy buffer,
+	// or copies the staging buffer, without waiting, to the device buffer,
+	// which the mapped pointer stays valid for
+	void host_buffer_to_device(int device_id,
+							   HostBuffer & hb,
+							   cl::Event * event = NULL)
+	{
+		if (hb.zero_copy) {
+			queue_m[device_id].enqueueUnmapMemObject(hb.device, hb.host, NULL, event);
+			hb.host = NULL;
+		} else {
+			queue_m[device_id].enqueueWriteBuffer(hb.device, CL_FALSE, 0, hb.size,
+												  hb.host, NULL, event);
+		}
+	}
+
+	// hands what the kernels wrote back to the host, waiting for it: maps a
+	// zero copy buffer again, or copies the device buffer to the staging one
+	void host_buffer_to_host(int device_id,
+							 HostBuffer & hb,
+							 cl::Event * event = NULL)
+	{
+		if (hb.zero_copy) {
+			hb.host = queue_m[device_id].enqueueMapBuffer(hb.device, CL_TRUE,
+														  CL_MAP_READ | CL_MAP_WRITE,
+														  0, hb.size, NULL, event);
+		} else {
+			queue_m[device_id].enqueueReadBuffer(hb.device, CL_TRUE, 0, hb.size,
+												 hb.host, NULL, event);
+		}
+	}
+
+	// unmaps the pointer of the host, before the buffers are released
+	void release_host_buffer(int device_id, HostBuffer & hb)
+	{
+		if (hb.host == NULL) {
+			return;
+		}
+		queue_m[device_id].enqueueUnmapMemObject(hb.zero_copy ? hb.device : hb.staging,
+												 hb.host);
+		queue_m[device_id].finish();
+		hb.host = NULL;
+	}
+
+	static double wall_time()
+	{
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+	}
+
+	// the items a sub-buffer of items of item_size bytes starts at a multiple
+	// of, for the base address alignment of all of devices
+	size_t partition_granule(std::vector<int> const & devices, size_t item_size)
+	{
+		size_t granule = 1;
+		for (size_t k = 0; k < devices.size(); ++k) {
+			size_t align = device_m[devices[k]].getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;
+			size_t items = (align + item_size - 1) / item_size;
+			// the alignments are powers of two, the largest is a multiple of the others
+			granule = std::max(granule, items);
+		}
+		return granule;
+	}
+
+	// the view of the bytes offset .. offset + size - 1 of buffer a device
+	// of a partition works on
+	cl::Buffer sub_buffer(cl::Buffer & buffer,
+						  cl_mem_flags flags,
+						  size_t offset,
+						  size_t size)
+	{
+		cl_buffer_region region;
+		region.origin = offset;
+		region.size = size;
+		return buffer.createSubBuffer(flags, CL_BUFFER_CREATE_TYPE_REGION, &region);
+	}
+
+	// the items per second of each of devices on kernel, the best of a few
+	// runs over the first sample items after one to warm up
+	std::vector<double> calibrate_devices(PartitionedKernel & kernel,
+										  std::vector<int> const & devices,
+										  size_t sample)
+	{
+		std::vector<double> rate(devices.size(), 0.0);
+		for (size_t k = 0; k < devices.size(); ++k) {
+			cl::CommandQueue & queue = queue_m[devices[k]];
+			kernel.enqueue(queue, devices[k], 0, sample);
+			queue.finish();
+			double best = 0.0;
+			for (int r = 0; r < 3; ++r) {
+				double const t0 = wall_time();
+				kernel.enqueue(queue, devices[k], 0, sample);
+				queue.finish();
+				double const t = wall_time() - t0;
+				if (t > 0.0 && (best == 0.0 || t < best)) {
+					best = t;
+				}
+			}
+			rate[k] = (best > 0.0) ? sample / best : 1.0;
+		}
+		return rate;
+	}
+
+	// n items over devices in proportion to rate, each part but the last a
+	// multiple of granule items, the last taking the rest
+	Partition partition_range(std::vector<int> const & devices,
+							  std::vector<double> const & rate,
+							  size_t n,
+							  size_t granule)
+	{
+		Partition part;
+		double total = 0.0;
+		for (size_t k = 0; k < rate.size(); ++k) {
+			total += rate[k];
+		}
+
+		size_t offset = 0;
+		for (size_t k = 0; k < devices.size(); ++k) {
+			size_t count = n - offset;
+			if (k + 1 < devices.size() && total > 0.0) {
+				count = (size_t)(n * (rate[k] / total)) / granule * granule;
+				count = std::min(count, n - offset);
+			}
+			part.devices.push_back(devices[k]);
+			part.offset.push_back(offset);
+			part.count.push_back(count);
+			offset += count;
+		}
+
+		if (verbose_m) {
+			std::cerr << "[Partition]\n";
+			for (size_t k = 0; k < part.devices.size(); ++k) {
+				std::cerr << "  device[" << part.devices[k] << "]: "
+						  << part.count[k] << " items from " << part.offset[k]
+						  << ", " << rate[k] << " items/s\n";
+			}
+		}
+		return part;
+	}
+
+	// kernel over the parts of part, all the queues running at once, back
+	// when they have all finished
+	void partitioned_launch(PartitionedKernel & kernel, Partition const & part)
+	{
+		for (size_t k = 0; k < part.devices.size(); ++k) {
+			if (part.count[k] > 0) {
+				kernel.enqueue(queue_m[part.devices[k]], part.devices[k],
+							   part.offset[k], part.count[k]);
+			}
+		}
+		for (size_t k = 0; k < part.devices.size(); ++k) {
+			queue_m[part.devices[k]].flush();
+		}
+		for (size_t k = 0; k < part.devices.size(); ++k) {
+			queue_m[part.devices[k]].finish();
+		}
+	}
+
+	// the download of chunk c of pipelined_run, once its compute has run
+	void pipelined_download(ChunkedKernel & kernel,
+							cl::CommandQueue & queue,
+							size_t c,
+							size_t n,
+							size_t chunk,
+							size_t nslots,
+							std::vector<cl::Event> & compute,
+							std::vector<cl::Event> & down)
+	{
+		size_t const offset = c * chunk;
+		std::vector<cl::Event> wait(1, compute[c]);
+		kernel.enqueue_download(queue, c % nslots, offset,
+								std::min(chunk, n - offset), &wait, &down[c]);
+	}
+
+	// n items of kernel on device_id in chunks of chunk items through nslots
+	// slots, with the uploads, computes and downloads on nqueues queues, 3
+	// for one each, 2 for the copies on one and the computes on the other,
+	// so that the upload of a chunk, the compute of the one before and the
+	// download of the one before that overlap. a chunk waits for the compute
+	// and download of the chunk before it in its slot. the download of a
+	// chunk is enqueued after the upload of the next one, so that on the
+	// shared copy queue of 2 queues the upload does not wait behind it, and
+	// with it behind the compute of the chunk. returns the seconds it took
+	double pipelined_run(ChunkedKernel & kernel,
+						 int device_id,
+						 size_t n,
+						 size_t chunk,
+						 size_t nslots = 2,
+						 int nqueues = 3)
+	{
+		nqueues = std::max(1, std::min(nqueues, 3));
+		cl_uint properties = 0;
+		if (profile_m) {
+			properties |= CL_QUEUE_PROFILING_ENABLE;
+		}
+		std::vector<cl::CommandQueue> queue(1, queue_m[device_id]);
+		for (int q = 1; q < nqueues; ++q) {
+			queue.push_back(cl::CommandQueue(context_m, device_m[device_id], properties));
+		}
+		cl::CommandQueue & up_queue = queue[0];
+		cl::CommandQueue & compute_queue = queue[std::min(1, nqueues - 1)];
+		cl::CommandQueue & down_queue = queue[nqueues - 1 < 2 ? 0 : 2];
+
+		size_t const nchunks = (n + chunk - 1) / chunk;
+		std::vector<cl::Event> up(nchunks), compute(nchunks), down(nchunks);
+		std::vector<cl::Event> wait;
+
+		double const t0 = wall_time();
+		for (size_t c = 0; c < nchunks; ++c) {
+			size_t const slot = c % nslots;
+			size_t const offset = c * chunk;
+			size_t const count = std::min(chunk, n - offset);
+
+			// the input of the slot is free once the compute before has run
+			wait.clear();
+			if (c >= nslots) {
+				wait.push_back(compute[c - nslots]);
+			}
+			kernel.enqueue_upload(up_queue, slot, offset, count,
+								  wait.size() ? &wait : NULL, &up[c]);
+
+			if (c > 0) {
+				pipelined_download(kernel, down_queue, c - 1, n, chunk, nslots,
+								   compute, down);
+			}
+
+			// and the output once the download before has
+			wait.clear();
+			wait.push_back(up[c]);
+			if (c >= nslots) {
+				wait.push_back(down[c - nslots]);
+			}
+			kernel.enqueue_compute(compute_queue, slot, offset, count, &wait, &compute[c]);
+
+			for (size_t q = 0; q < queue.size(); ++q) {
+				queue[q].flush();
+			}
+		}
+		if (nchunks > 0) {
+			pipelined_download(kernel, down_queue, nchunks - 1, n, chunk, nslots,
+							   compute, down);
+		}
+		for (size_t q = 0; q < queue.size(); ++q) {
+			queue[q].finish();
+		}
+		double const secs = wall_time() - t0;
+		for (size_t c = 0; c < nchunks; ++c) {
+			record_event("upload", device_id, up[c]);
+			record_event("compute", device_id, compute[c]);
+			record_event("download", device_id, down[c]);
+		}
+
+		if (verbose_m) {
+			std::cerr << "[Pipeline]\n  " << nchunks << " chunks of " << chunk
+					  << " items, " << nslots << " slots, " << nqueues
+					  << " queues, " << secs << " s\n";
+		}
+		return secs;
+	}
+
+	// whether the queue of device_id runs its commands out of order, see
+	// the constructor
+	bool out_of_order(int device_id) const
+	{
+		return out_of_order_m[device_id];
+	}
+
+	// the nodes of graph, each on the queue of its device after the nodes
+	// it waits for, in an order of the edges, the nodes added first first.
+	// throws if the edges have a cycle. returns the seconds from the first
+	// enqueue to the end of the last node, the events of the nodes in the
+	// graph and the profile
+	double run_task_graph(TaskGraph & graph)
+	{
+		std::vector<TaskGraph::Node> & nodes = graph.nodes_m;
+		std::vector<size_t> waiting(nodes.size(), 0);
+		std::vector<std::vector<size_t> > next(nodes.size());
+		size_t nedges = 0;
+		for (size_t k = 0; k < nodes.size(); ++k) {
+			for (size_t e = 0; e < nodes[k].after.size(); ++e) {
+				next[nodes[k].after[e]].push_back(k);
+			}
+			waiting[k] = nodes[k].after.size();
+			nedges += waiting[k];
+		}
+
+		// the nodes with nothing to wait for, by number, then those each
+		// frees
+		std::vector<size_t> order;
+		for (size_t k = 0; k < nodes.size(); ++k) {
+			if (waiting[k] == 0) {
+				order.push_back(k);
+			}
+		}
+		for (size_t o = 0; o < order.size(); ++o) {
+			for (size_t e = 0; e < next[order[o]].size(); ++e) {
+				if (--waiting[next[order[o]][e]] == 0) {
+					order.push_back(next[order[o]][e]);
+				}
+			}
+		}
+		if (order.size() != nodes.size()) {
+			throw std::runtime_error("task graph has a cycle");
+		}
+
+		std::vector<bool> used(queue_m.size(), false);
+		std::vector<cl::Event> wait;
+		std::vector<cl::Event> all;
+		double const t0 = wall_time();
+		for (size_t o = 0; o < order.size(); ++o) {
+			TaskGraph::Node & node = nodes[order[o]];
+			cl::CommandQueue & queue = queue_m[node.device_id];
+			used[node.device_id] = true;
+			wait.clear();
+			for (size_t e = 0; e < node.after.size(); ++e) {
+				wait.push_back(nodes[node.after[e]].event);
+			}
+			std::vector<cl::Event> const * wait_list = wait.size() ? &wait : NULL;
+
+			if (node.type == TaskGraph::KERNEL) {
+				queue.enqueueNDRangeKernel(node.kernel, cl::NullRange, node.global,
+										   node.local, wait_list, &node.event);
+			} else if (node.type == TaskGraph::WRITE) {
+				queue.enqueueWriteBuffer(node.buffer, CL_FALSE, node.offset, node.size,
+										 node.ptr, wait_list, &node.event);
+			} else if (node.type == TaskGraph::READ) {
+				queue.enqueueReadBuffer(node.buffer, CL_FALSE, node.offset, node.size,
+										node.ptr, wait_list, &node.event);
+			} else {
+				queue.enqueueCopyBuffer(node.buffer, node.other, node.offset,
+										node.other_offset, node.size, wait_list,
+										&node.event);
+			}
+			all.push_back(node.event);
+		}
+		for (size_t q = 0; q < queue_m.size(); ++q) {
+			if (used[q]) {
+				queue_m[q].flush();
+			}
+		}
+		if (all.size()) {
+			cl::Event::waitForEvents(all);
+		}
+		double const secs = wall_time() - t0;
+		for (size_t k = 0; k < nodes.size(); ++k) {
+			record_event(nodes[k].name, nodes[k].device_id, nodes[k].event, nodes[k].size);
+		}
+
+		if (verbose_m) {
+			std::cerr << "[Task graph]\n  " << nodes.size() << " nodes, " << nedges
+					  << " edges, " << secs << " s\n";
+		}
+		return secs;
+	}
+
+	// global rounded up to a multiple of local, the kernels checking their
+	// global id against the size of the problem
+	static size_t padded_size(size_t global, size_t local)
+	{
+		return (global + local - 1) / local * local;
+	}
+
+	// the local size of the 1D kernel, its arguments set, on device_id for
+	// global items: the fastest of the multiples of its preferred work group
+	// size multiple up to its largest work group size, each the best of 3
+	// timed runs, kept in the work-group-sizes file of the cache for the
+	// next run of the same kernel, program text and device
+	size_t tune_work_group_size(cl::Kernel & kernel, int device_id, size_t global)
+	{
+		cl::Device const & device = device_m[device_id];
+		size_t const max_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+		size_t const multiple = std::max<size_t>(1, kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device));
+
+		std::string key = kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+		key += '\0';
+		key += device_program_text_m;
+		key += '\0';
+		key += device.getInfo<CL_DEVICE_NAME>();
+		key += '\0';
+		key += device.getInfo<CL_DRIVER_VERSION>();
+		unsigned long long const hash = cache_hash(key);
+		std::string const file = cache_dir_m + "/work-group-sizes";
+
+		// an earlier winner
+		if (!cache_dir_m.empty()) {
+			std::ifstream in(file.c_str());
+			unsigned long long h;
+			size_t size;
+			while (in >> std::hex >> h >> std::dec >> size) {
+				if (h == hash && size > 0 && size <= max_size) {
+					if (verbose_m) {
+						std::cerr << "  work group size = " << size << " (cached)\n";
+					}
+					return size;
+				}
+			}
+		}
+
+		std::vector<size_t> candidate;
+		for (size_t size = multiple; size <= max_size; size *= 2) {
+			candidate.push_back(size);
+		}
+		if (candidate.empty() || candidate.back() != max_size) {
+			candidate.push_back(max_size);
+		}
+
+		cl::CommandQueue & queue = queue_m[device_id];
+		size_t best_size = max_size;
+		double best = 0.0;
+		for (size_t k = 0; k < candidate.size(); ++k) {
+			size_t const local = candidate[k];
+			cl::NDRange const range(padded_size(global, local));
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, range, cl::NDRange(local));
+			queue.finish();
+			double time = 0.0;
+			for (int r = 0; r < 3; ++r) {
+				double const t0 = wall_time();
+				queue.enqueueNDRangeKernel(kernel, cl::NullRange, range, cl::NDRange(local));
+				queue.finish();
+				double const t = wall_time() - t0;
+				if (time == 0.0 || t < time) {
+					time = t;
+				}
+			}
+			if (best == 0.0 || time < best) {
+				best = time;
+				best_size = local;
+			}
+			if (verbose_m) {
+				std::cerr << "  work group size " << local << ": " << time * 1.0e3 << " ms\n";
+			}
+		}
+
+		if (!cache_dir_m.empty()) {
+			mkdir(cache_dir_m.c_str(), 0755);
+			std::ofstream out(file.c_str(), std::ios::app);
+			char line[48];
+			snprintf(line, sizeof(line), "%016llx %lu\n", hash, (unsigned long)best_size);
+			out << line;
+		}
+		if (verbose_m) {
+			std::cerr << "  work group size = " << best_size << " (tuned)\n";
+		}
+		return best_size;
+	}
+
+	// the event to give the command name on device_id moving bytes bytes to
+	// have it in the profile, NULL, for no event, without profiling. the
+	// records are a deque so the event stays where it is
+	cl::Event * profile(std::string const & name, int device_id, size_t bytes = 0)
+	{
+		if (!profile_m) {
+			return NULL;
+		}
+		ProfileRecord record;
+		record.name = name;
+		record.device_id = device_id;
+		record.bytes = bytes;
+		profile_records_m.push_back(record);
+		return &profile_records_m.back().event;
+	}
+
+	// the command of event in the profile, for events the app keeps
+	void record_event(std::string const & name, int device_id,
+					  cl::Event const & event, size_t bytes = 0)
+	{
+		if (!profile_m) {
+			return;
+		}
+		ProfileRecord record;
+		record.name = name;
+		record.device_id = device_id;
+		record.bytes = bytes;
+		record.event = event;
+		profile_records_m.push_back(record);
+	}
+
+	// once the commands of the profile are done: for each name the count,
+	// mean, median and 99th percentile of the run times, the bandwidth and
+	// the mean time from queued to submitted, the host and runtime
+	// overhead; for each queue the fraction of its span it was busy; and a
+	// Chrome trace of the commands, one process per device and one thread
+	// per queue, in trace_file
+	void report_profile(std::string const & trace_file = "cl-trace.json")
+	{
+		if (!profile_m || profile_records_m.empty()) {
+			return;
+		}
+
+		std::deque<ProfileRecord> & timed = profile_records_m;
+		std::vector<cl_command_queue> queues;
+		cl_ulong origin = 0;
+		for (size_t k = 0; k < profile_records_m.size(); ++k) {
+			cl::Event & event = profile_records_m[k].event;
+			event.wait();
+			timed[k].queued = event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+			timed[k].submit = event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+			timed[k].start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+			timed[k].end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+			cl_command_queue q = event.getInfo<CL_EVENT_COMMAND_QUEUE>()();
+			timed[k].queue = std::find(queues.begin(), queues.end(), q) - queues.begin();
+			if (timed[k].queue == queues.size()) {
+				queues.push_back(q);
+			}
+			if (k == 0 || timed[k].queued < origin) {
+				origin = timed[k].queued;
+			}
+		}
+
+		// per name
+		std::map<std::string, std::vector<size_t> > by_name;
+		for (size_t k = 0; k < profile_records_m.size(); ++k) {
+			by_name[profile_records_m[k].name].push_back(k);
+		}
+		std::cerr << "[Profile]\n";
+		char line[160];
+		snprintf(line, sizeof(line), "  %-16s %6s %10s %10s %10s %10s %12s\n",
+				 "command", "count", "mean ms", "p50 ms", "p99 ms", "GB/s", "overhead us");
+		std::cerr << line;
+		std::map<std::string, std::vector<size_t> >::const_iterator it;
+		for (it = by_name.begin(); it != by_name.end(); ++it) {
+			std::vector<double> ms;
+			double total = 0.0, bytes = 0.0, overhead = 0.0;
+			for (size_t j = 0; j < it->second.size(); ++j) {
+				size_t const k = it->second[j];
+				ms.push_back((timed[k].end - timed[k].start) * 1.0e-6);
+				total += ms.back();
+				bytes += profile_records_m[k].bytes;
+				overhead += (timed[k].submit - timed[k].queued) * 1.0e-3;
+			}
+			std::sort(ms.begin(), ms.end());
+			size_t const n = ms.size();
+			snprintf(line, sizeof(line), "  %-16s %6lu %10.4f %10.4f %10.4f %10.3f %12.2f\n",
+					 it->first.c_str(), (unsigned long)n, total / n,
+					 ms[(n - 1) / 2], ms[(size_t)((n - 1) * 0.99)],
+					 (total > 0.0) ? bytes / total * 1.0e-6 : 0.0,
+					 overhead / n);
+			std::cerr << line;
+		}
+
+		// per queue, the union of its commands over its span
+		for (size_t q = 0; q < queues.size(); ++q) {
+			std::vector<std::pair<cl_ulong, cl_ulong> > busy;
+			int device_id = -1;
+			for (size_t k = 0; k < timed.size(); ++k) {
+				if (timed[k].queue == q) {
+					busy.push_back(std::make_pair(timed[k].start, timed[k].end));
+					device_id = profile_records_m[k].device_id;
+				}
+			}
+			std::sort(busy.begin(), busy.end());
+			cl_ulong covered = 0, reach = busy[0].first;
+			for (size_t j = 0; j < busy.size(); ++j) {
+				cl_ulong const from = std::max(reach, busy[j].first);
+				if (busy[j].second > from) {
+					covered += busy[j].second - from;
+				}
+				reach = std::max(reach, busy[j].second);
+			}
+			cl_ulong const span = reach - busy[0].first;
+			snprintf(line, sizeof(line), "  queue %lu of device[%d]: %lu commands, busy %.1f%% of %.4f ms\n",
+					 (unsigned long)q, device_id, (unsigned long)busy.size(),
+					 (span > 0) ? 100.0 * covered / span : 100.0, span * 1.0e-6);
+			std::cerr << line;
+		}
+
+		// the trace, in microseconds from the first command queued
+		std::ofstream out(trace_file.c_str());
+		out << "{\"traceEvents\": [\n";
+		for (size_t k = 0; k < timed.size(); ++k) {
+			snprintf(line, sizeof(line),
+					 "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %lu, "
+					 "\"ts\": %.3f, \"dur\": %.3f",
+					 profile_records_m[k].name.c_str(), profile_records_m[k].device_id,
+					 (unsigned long)timed[k].queue, (timed[k].start - origin) * 1.0e-3,
+					 (timed[k].end - timed[k].start) * 1.0e-3);
+			out << line << ", \"args\": {\"bytes\": " << profile_records_m[k].bytes
+				<< ", \"queued_us\": " << (timed[k].queued - origin) * 1.0e-3
+				<< ", \"submit_us\": " << (timed[k].submit - origin) * 1.0e-3
+				<< "}}" << ((k + 1 < timed.size()) ? ",\n" : "\n");
+		}
+		out << "]}\n";
+		if (!out) {
+			std::cerr << "WARNING: could not write " << trace_file << "\n";
+		} else if (verbose_m) {
+			std::cerr << "  trace in " << trace_file << "\n";
+		}
+		profile_records_m.clear();
+	}
+
+	// a buffer of at least size bytes with flags from the pool, one of the
+	// power of two size class of size that has been released and whose last
+	// command is complete, or a new one if there is none; it goes back to
+	// the pool by release_buffer
+	cl::Buffer acquire_buffer(cl_mem_flags flags, size_t size)
+	{
+		size_t bytes = 4096;
+		while (bytes < size) {
+			bytes *= 2;
+		}
+		std::vector<PooledBuffer> & bucket = buffer_pool_m[std::make_pair(flags, bytes)];
+		for (size_t k = 0; k < bucket.size(); ++k) {
+			if (bucket[k].last() == NULL ||
+				bucket[k].last.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() == CL_COMPLETE) {
+				cl::Buffer buffer = bucket[k].buffer;
+				bucket.erase(bucket.begin() + k);
+				++pool_hits_m;
+				return buffer;
+			}
+		}
+		++pool_misses_m;
+		return cl::Buffer(context_m, flags, bytes);
+	}
+
+	// buffer of acquire_buffer with flags back to the pool, to be reused when
+	// last, the event of the last command using it if not a null event, is
+	// complete
+	void release_buffer(cl::Buffer const & buffer,
+						cl_mem_flags flags,
+						cl::Event const & last = cl::Event())
+	{
+		PooledBuffer pooled;
+		pooled.buffer = buffer;
+		pooled.last = last;
+		size_t const bytes = buffer.getInfo<CL_MEM_SIZE>();
+		buffer_pool_m[std::make_pair(flags, bytes)].push_back(pooled);
+	}
+
+	// the buffers of the pool released, OpenCL keeping those of commands
+	// still running until they are done
+	void clear_buffer_pool()
+	{
+		if (verbose_m && pool_hits_m + pool_misses_m > 0) {
+			std::cerr << "[Buffer pool]\n  " << pool_hits_m << " reused, "
+					  << pool_misses_m << " allocated\n";
+		}
+		buffer_pool_m.clear();
+	}
+
+	// the device to run on when the app is not given one: the one of
+	// $CODY_CL_DEVICE, its index or a part of its name, if it is set, else
+	// the one of the highest score_device. $CODY_CL_DEVICE_POLICY picks the
+	// scores, measured (default), the bandwidth and flop rate of
+	// measure_device, or type, GPUs before accelerators before CPUs and
+	// then the compute units. The choice is made once per run and printed
+	// with the scores in verbose mode
 	int get_most_capable_device()
 	{
-		int device_id = -1;
-		std::vector<unsigned int> device_type;
-		device_type.push_back(CL_DEVICE_TYPE_GPU);
-		device_type.push_back(CL_DEVICE_TYPE_ACCELERATOR);
-		device_type.push_back(CL_DEVICE_TYPE_CPU);
-		
-		std::vector<unsigned int>::iterator type;
-		for (type = device_type.begin(); type != device_type.end(); ++type) {
-			unsigned int max_compute_units = 0;
-			for (size_t i = 0; i < device_m.size(); ++i) {
-				if (*type == device_m[i].getInfo<CL_DEVICE_TYPE>()) {
-					if (max_compute_units < device_m[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()) {
-						max_compute_units = device_m[i].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+		if (selected_device_m >= 0) {
+			return selected_device_m;
+		}
+		if (device_m.empty()) {
+			throw std::runtime_error("no OpenCL device");
+		}
+		if (verbose_m) {
+			std::cerr << "[Device selection]\n";
+		}
+
+		char const * wanted = getenv("CODY_CL_DEVICE");
+		if (wanted != NULL && wanted[0] != '\0') {
+			std::string const name(wanted);
+			int device_id = -1;
+			if (name.find_first_not_of("0123456789") == std::string::npos) {
+				device_id = atoi(wanted);
+				if (device_id >= (int)device_m.size()) {
+					throw std::runtime_error("CODY_CL_DEVICE=" + name + " is not a device index");
+				}
+			} else {
+				for (size_t i = 0; i < device_m.size() && device_id < 0; ++i) {
+					if (device_m[i].getInfo<CL_DEVICE_NAME>().find(name) != std::string::npos) {
 						device_id = i;
 					}
 				}
+				if (device_id < 0) {
+					throw std::runtime_error("no device name contains CODY_CL_DEVICE=" + name);
+				}
 			}
-			if (device_id >= 0) {
-				break;
+			if (verbose_m) {
+				std::cerr << "  using device[" << device_id << "] "
+						  << device_m[device_id].getInfo<CL_DEVICE_NAME>()
+						  << ", CODY_CL_DEVICE=" << name << "\n";
 			}
+			selected_device_m = device_id;
+			return device_id;
 		}
-		
+
+		char const * policy = getenv("CODY_CL_DEVICE_POLICY");
+		device_policy_m = (policy != NULL && policy[0] != '\0') ? policy : "measured";
+		if (device_policy_m != "measured" && device_policy_m != "type") {
+			throw std::runtime_error("CODY_CL_DEVICE_POLICY=" + device_policy_m + " is not measured or type");
+		}
+		int device_id = 0;
+		double best = -1.0;
+		for (size_t i = 0; i < device_m.size(); ++i) {
+			std::string reason;
+			double const score = score_device(i, reason);
+			if (verbose_m) {
+				std::cerr << "  device[" << i << "] " << device_m[i].getInfo<CL_DEVICE_NAME>()
+						  << ": score " << score << ", " << reason << "\n";
+			}
+			if (score > best) {
+				best = score;
+				device_id = i;
+			}
+		}
+		if (verbose_m) {
+			std::cerr << "  using device[" << device_id << "], the highest score of the "
+					  << device_policy_m << " policy\n";
+		}
+		selected_device_m = device_id;
 		return device_id;
 	}
-	
+
+	// the bandwidth in GB/s and the single precision flop rate in GFLOP/s
+	// of device_id, from a copy and a multiply-add kernel each timed at the
+	// best of 3 runs after one to warm up, a fraction of a second in all.
+	// The rates are kept in the device-scores file of the cache, by device,
+	// driver and platform, so the next run on this machine does not measure
+	// again; cached says which. A device the kernels fail on scores 0
+	void measure_device(int device_id, double & gbs, double & gflops, bool & cached)
+	{
+		cl::Device const & device = device_m[device_id];
+		std::string key = device.getInfo<CL_DEVICE_NAME>();
+		key += '\0';
+		key += device.getInfo<CL_DRIVER_VERSION>();
+		key += '\0';
+		key += device.getInfo<CL_DEVICE_VERSION>();
+		key += '\0';
+		key += platform_m[0].getInfo<CL_PLATFORM_NAME>();
+		unsigned long long const hash = cache_hash(key);
+		std::string const file = cache_dir_m + "/device-scores";
+
+		cached = false;
+		if (!cache_dir_m.empty()) {
+			std::ifstream in(file.c_str());
+			unsigned long long h;
+			double b, f;
+			while (in >> std::hex >> h >> std::dec >> b >> f) {
+				if (h == hash) {
+					gbs = b;
+					gflops = f;
+					cached = true;
+					return;
+				}
+			}
+		}
+
+		gbs = 0.0;
+		gflops = 0.0;
+		try {
+			// the flops of a work item of cody_mad, 4 chains of 256
+			// multiply-adds
+			size_t const mad_flops = 4 * 256 * 2;
+			size_t const mad_items = 1 << 18;
+			std::string const text =
+				"__kernel void cody_copy(__global const float4* in, __global float4* out)\n"
+				"{\n"
+				"    size_t const i = get_global_id(0);\n"
+				"    out[i] = in[i];\n"
+				"}\n"
+				"__kernel void cody_mad(__global float* out, float const a, float const b)\n"
+				"{\n"
+				"    float x0 = get_global_id(0) * 1.0e-9f;\n"
+				"    float x1 = x0 + 0.25f;\n"
+				"    float x2 = x0 + 0.5f;\n"
+				"    float x3 = x0 + 0.75f;\n"
+				"    for (int k = 0; k < 256; ++k) {\n"
+				"        x0 = mad(x0, a, b);\n"
+				"        x1 = mad(x1, a, b);\n"
+				"        x2 = mad(x2, a, b);\n"
+				"        x3 = mad(x3, a, b);\n"
+				"    }\n"
+				"    out[get_global_id(0)] = x0 + x1 + x2 + x3;\n"
+				"}\n";
+			cl::Program::Sources source(1, std::make_pair(text.c_str(), text.length()));
+			cl::Program program(context_m, source);
+			program.build(std::vector<cl::Device>(1, device));
+
+			// 32 MB each way, or what the device allocates
+			size_t const bytes = std::min<size_t>(32 << 20, device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() / 4) / 16 * 16;
+			cl::Buffer in(context_m, CL_MEM_READ_ONLY, bytes);
+			cl::Buffer out(context_m, CL_MEM_WRITE_ONLY, std::max(bytes, mad_items * sizeof(float)));
+			cl::Kernel copy(program, "cody_copy");
+			copy.setArg(0, in);
+			copy.setArg(1, out);
+			cl::Kernel mad(program, "cody_mad");
+			mad.setArg(0, out);
+			mad.setArg(1, 0.999f);
+			mad.setArg(2, 0.001f);
+
+			cl::CommandQueue & queue = queue_m[device_id];
+			cl::Kernel * kernel[2] = {&copy, &mad};
+			size_t const items[2] = {bytes / 16, mad_items};
+			double best[2] = {0.0, 0.0};
+			for (int k = 0; k < 2; ++k) {
+				queue.enqueueNDRangeKernel(*kernel[k], cl::NullRange, cl::NDRange(items[k]), cl::NullRange);
+				queue.finish();
+				for (int r = 0; r < 3; ++r) {
+					double const t0 = wall_time();
+					queue.enqueueNDRangeKernel(*kernel[k], cl::NullRange, cl::NDRange(items[k]), cl::NullRange);
+					queue.finish();
+					double const t = wall_time() - t0;
+					if (t > 0.0 && (best[k] == 0.0 || t < best[k])) {
+						best[k] = t;
+					}
+				}
+			}
+			gbs = (best[0] > 0.0) ? 2.0 * bytes / best[0] * 1.0e-9 : 0.0;
+			gflops = (best[1] > 0.0) ? (double)mad_flops * mad_items / best[1] * 1.0e-9 : 0.0;
+		}
+		catch (cl::Error const & error) {
+			if (verbose_m) {
+				std::cerr << "  device[" << device_id << "]: benchmark failed, "
+						  << error.what() << "(" << opencl_error_string(error.err()) << ")\n";
+			}
+			return;
+		}
+
+		if (!cache_dir_m.empty()) {
+			mkdir(cache_dir_m.c_str(), 0755);
+			std::ofstream out(file.c_str(), std::ios::app);
+			char line[64];
+			snprintf(line, sizeof(line), "%016llx %g %g\n", hash, gbs, gflops);
+			out << line;
+		}
+	}
+
     virtual void host_run() = 0;
 
 protected:
 	
 	virtual std::string const & get_device_program_text() = 0;
 
+	// the constants of the problem the program is specialized for, by
+	// define_constant, once the devices are known; none by default
+	virtual void define_program_constants()
+	{
+	}
+
+	// the score of device_id get_most_capable_device goes by, the highest
+	// wins, and why in reason. An app with criteria of its own overrides
+	// it; by default it is the one of the policy: measured, the geometric
+	// mean of the GB/s and GFLOP/s of measure_device, or type, type_score
+	virtual double score_device(int device_id, std::string & reason)
+	{
+		if (device_policy_m == "type") {
+			return type_score(device_id, reason);
+		}
+		double gbs;
+		double gflops;
+		bool cached;
+		measure_device(device_id, gbs, gflops, cached);
+		std::ostringstream os;
+		os << gbs << " GB/s, " << gflops << " GFLOP/s (" << (cached ? "cached" : "measured") << ")";
+		reason = os.str();
+		return std::sqrt(gbs * gflops);
+	}
+
+	// GPUs before accelerators before CPUs, then by compute units
+	double type_score(int device_id, std::string & reason)
+	{
+		cl_device_type const type = device_m[device_id].getInfo<CL_DEVICE_TYPE>();
+		cl_uint const units = device_m[device_id].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+		int rank = 0;
+		std::ostringstream os;
+		if (type & CL_DEVICE_TYPE_GPU) {
+			rank = 3;
+			os << "GPU";
+		} else if (type & CL_DEVICE_TYPE_ACCELERATOR) {
+			rank = 2;
+			os << "accelerator";
+		} else if (type & CL_DEVICE_TYPE_CPU) {
+			rank = 1;
+			os << "CPU";
+		} else {
+			os << "other";
+		}
+		os << ", " << units << " compute units";
+		reason = os.str();
+		return rank * 1.0e6 + units;
+	}
+
     cl::Context context_m;
     cl::Program program_m;
     int debug_m;
     int profile_m;
     int verbose_m;
     std::string device_program_text_m;
+    std::vector<std::pair<std::string, long> > program_defines_m;
+    std::string cache_dir_m;
+    int selected_device_m;
+    std::string device_policy_m;
+    std::deque<ProfileRecord> profile_records_m;
+    std::map<std::pair<cl_mem_flags, size_t>, std::vector<PooledBuffer> > buffer_pool_m;
+    size_t pool_hits_m;
+    size_t pool_misses_m;
     std::vector<cl::CommandQueue> queue_m;
+    std::vector<bool> out_of_order_m;
     std::vector<cl::Device> device_m;
     std::vector<cl::Platform> platform_m;
 	
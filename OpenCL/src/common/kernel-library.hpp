@@ -0,0 +1,610 @@
+#ifndef KERNEL_LIBRARY_INCLUDED_H
+#define KERNEL_LIBRARY_INCLUDED_H 1
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common/app-base.hpp"
+
+#define KERNEL_LIBRARY_STRINGIFY(X) #X
+
+///
+// Kernels the continuum mini-apps build on, on float arrays: a 2D and a
+// 3D stencil tiled in local memory, a sum by a tree in each work group and
+// a second pass over the sums of the groups, and a gather and a scatter
+// through an index. An app appends program_text() to the text of its own
+// program, and a KernelLibrary on the built program enqueues them; the
+// kernels are all named lib_*. self_check runs each on a device against
+// the same computed on the host
+///
+class KernelLibrary {
+
+public:
+
+    // the kernels, to append to the program text of an app
+    static std::string const & program_text()
+        {
+            // no pragma, declaration or expression of the text may have
+            // a comma outside parentheses, for the preprocessor
+            static std::string const text = KERNEL_LIBRARY_STRINGIFY(
+
+
+    // one step of the 5-point stencil on an nx x ny row major mesh, out =
+    // c0 u + cx (the cells above and below) + cy (the cells left and
+    // right). dimension 0 runs along the rows. a work group first loads its
+    // block of cells and a one cell halo around it into tile, (local size 0
+    // + 2) x (local size 1 + 2) floats, so every cell is read from global
+    // memory about once instead of five times. the edges are copied
+    __kernel void lib_stencil2d(__global const float* in,
+                                __global float* out,
+                                __local float* tile,
+                                uint const nx,
+                                uint const ny,
+                                float const c0,
+                                float const cx,
+                                float const cy)
+    {
+        size_t const wj = get_local_size(0);
+        size_t const wi = get_local_size(1);
+        size_t const tw = wj + 2;
+        size_t const j = get_global_id(0);
+        size_t const i = get_global_id(1);
+        size_t const c = (get_local_id(1) + 1) * tw + get_local_id(0) + 1;
+        size_t k;
+
+        for (k = get_local_id(1) * wj + get_local_id(0); k < (wi + 2) * tw;
+             k += wi * wj) {
+            long const ti = (long)(get_group_id(1) * wi + k / tw) - 1;
+            long const tj = (long)(get_group_id(0) * wj + k % tw) - 1;
+            tile[k] = (ti >= 0 && ti < (long)nx &&
+                       tj >= 0 && tj < (long)ny) ? in[ti * ny + tj] : 0.0f;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (i >= nx || j >= ny) {
+            return;
+        }
+        if (i == 0 || i == nx - 1 || j == 0 || j == ny - 1) {
+            out[i * ny + j] = tile[c];
+        } else {
+            out[i * ny + j] = c0 * tile[c] +
+                              cx * (tile[c - tw] + tile[c + tw]) +
+                              cy * (tile[c - 1] + tile[c + 1]);
+        }
+    }
+
+
+    // the 7-point stencil on an nx x ny x nz mesh, k the fastest, out = c0
+    // u + cx (the cells along i) + cy (along j) + cz (along k), dimension 0
+    // along k. the tile is (local size 0 + 2) x (local size 1 + 2) x (local
+    // size 2 + 2) floats, the edges are copied
+    __kernel void lib_stencil3d(__global const float* in,
+                                __global float* out,
+                                __local float* tile,
+                                uint const nx,
+                                uint const ny,
+                                uint const nz,
+                                float const c0,
+                                float const cx,
+                                float const cy,
+                                float const cz)
+    {
+        size_t const wk = get_local_size(0);
+        size_t const wj = get_local_size(1);
+        size_t const wi = get_local_size(2);
+        size_t const tk = wk + 2;
+        size_t const tjk = (wj + 2) * tk;
+        size_t const k = get_global_id(0);
+        size_t const j = get_global_id(1);
+        size_t const i = get_global_id(2);
+        size_t const c = (get_local_id(2) + 1) * tjk +
+                         (get_local_id(1) + 1) * tk + get_local_id(0) + 1;
+        size_t l;
+
+        for (l = (get_local_id(2) * wj + get_local_id(1)) * wk + get_local_id(0);
+             l < (wi + 2) * tjk; l += wi * wj * wk) {
+            long const ti = (long)(get_group_id(2) * wi + l / tjk) - 1;
+            long const tj = (long)(get_group_id(1) * wj + l % tjk / tk) - 1;
+            long const tl = (long)(get_group_id(0) * wk + l % tk) - 1;
+            tile[l] = (ti >= 0 && ti < (long)nx &&
+                       tj >= 0 && tj < (long)ny &&
+                       tl >= 0 && tl < (long)nz) ?
+                      in[(ti * ny + tj) * nz + tl] : 0.0f;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (i >= nx || j >= ny || k >= nz) {
+            return;
+        }
+        if (i == 0 || i == nx - 1 || j == 0 || j == ny - 1 ||
+            k == 0 || k == nz - 1) {
+            out[(i * ny + j) * nz + k] = tile[c];
+        } else {
+            out[(i * ny + j) * nz + k] = c0 * tile[c] +
+                                         cx * (tile[c - tjk] + tile[c + tjk]) +
+                                         cy * (tile[c - tk] + tile[c + tk]) +
+                                         cz * (tile[c - 1] + tile[c + 1]);
+        }
+    }
+
+
+    // partial[g] = the sum of the items of in work group g sums: each work
+    // item first sums the items a global size apart from its own, then the
+    // group adds up those in scratch, local size floats, a power of two, by
+    // halves
+    __kernel void lib_reduce_sum(__global const float* in,
+                                 __global float* partial,
+                                 __local float* scratch,
+                                 uint const n)
+    {
+        size_t const l = get_local_id(0);
+        size_t i;
+        size_t s;
+        float sum = 0.0f;
+
+        for (i = get_global_id(0); i < n; i += get_global_size(0)) {
+            sum += in[i];
+        }
+        scratch[l] = sum;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (s = get_local_size(0) / 2; s > 0; s /= 2) {
+            if (l < s) {
+                scratch[l] += scratch[l + s];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (l == 0) {
+            partial[get_group_id(0)] = scratch[0];
+        }
+    }
+
+
+    // out[i] = in[index[i]]
+    __kernel void lib_gather(__global const float* in,
+                             __global const uint* index,
+                             __global float* out,
+                             uint const n)
+    {
+        size_t const i = get_global_id(0);
+        if (i < n) {
+            out[i] = in[index[i]];
+        }
+    }
+
+
+    // out[index[i]] += in[i], the items of an index added one at a time by
+    // a compare and exchange of the bits of the float, there being no float
+    // atomics in OpenCL 1.1
+    __kernel void lib_scatter_add(__global const float* in,
+                                  __global const uint* index,
+                                  __global float* out,
+                                  uint const n)
+    {
+        size_t const i = get_global_id(0);
+        volatile __global uint* p;
+        uint old;
+        uint sum;
+
+        if (i >= n) {
+            return;
+        }
+        p = (volatile __global uint*)&out[index[i]];
+        do {
+            old = *p;
+            sum = as_uint(as_float(old) + in[i]);
+        } while (atomic_cmpxchg(p, old, sum) != old);
+    }
+
+
+                );
+            return text;
+        }
+
+    // the kernels of program, built from a text with program_text() in it
+    KernelLibrary(cl::Context const & context,
+                  cl::Program const & program)
+        : context_m(context),
+          stencil2d_m(program, "lib_stencil2d"),
+          stencil3d_m(program, "lib_stencil3d"),
+          reduce_sum_m(program, "lib_reduce_sum"),
+          gather_m(program, "lib_gather"),
+          scatter_add_m(program, "lib_scatter_add"),
+          partial_size_m(0)
+        {
+        }
+
+    // out = the 5-point stencil of in, nx x ny floats, see lib_stencil2d,
+    // on queue of device, event the event of the kernel if not NULL
+    void stencil2d(cl::CommandQueue & queue,
+                   cl::Device const & device,
+                   cl::Buffer const & in,
+                   cl::Buffer const & out,
+                   size_t nx,
+                   size_t ny,
+                   float c0,
+                   float cx,
+                   float cy,
+                   cl::Event * event = NULL)
+        {
+            // work group of at most 16 x 16 cells, halved along i first
+            size_t const max_size = stencil2d_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+            size_t wj = 16;
+            size_t wi = 16;
+            while (wj * wi > max_size) {
+                if (wi > 1) {
+                    wi /= 2;
+                } else {
+                    wj /= 2;
+                }
+            }
+
+            stencil2d_m.setArg(0, in);
+            stencil2d_m.setArg(1, out);
+            stencil2d_m.setArg(2, cl::__local(sizeof(cl_float) * (wj + 2) * (wi + 2)));
+            stencil2d_m.setArg(3, (cl_uint)nx);
+            stencil2d_m.setArg(4, (cl_uint)ny);
+            stencil2d_m.setArg(5, c0);
+            stencil2d_m.setArg(6, cx);
+            stencil2d_m.setArg(7, cy);
+            queue.enqueueNDRangeKernel(stencil2d_m,
+                                       cl::NullRange,
+                                       cl::NDRange(AppBase::padded_size(ny, wj),
+                                                   AppBase::padded_size(nx, wi)),
+                                       cl::NDRange(wj, wi),
+                                       NULL,
+                                       event);
+        }
+
+    // out = the 7-point stencil of in, nx x ny x nz floats, see
+    // lib_stencil3d
+    void stencil3d(cl::CommandQueue & queue,
+                   cl::Device const & device,
+                   cl::Buffer const & in,
+                   cl::Buffer const & out,
+                   size_t nx,
+                   size_t ny,
+                   size_t nz,
+                   float c0,
+                   float cx,
+                   float cy,
+                   float cz,
+                   cl::Event * event = NULL)
+        {
+            // work group of at most 32 x 4 x 2 cells, long along k for
+            // the reads of the rows, halved along i, then j, then k
+            size_t const max_size = stencil3d_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+            size_t wk = 32;
+            size_t wj = 4;
+            size_t wi = 2;
+            while (wk * wj * wi > max_size) {
+                if (wi > 1) {
+                    wi /= 2;
+                } else if (wj > 1) {
+                    wj /= 2;
+                } else {
+                    wk /= 2;
+                }
+            }
+
+            stencil3d_m.setArg(0, in);
+            stencil3d_m.setArg(1, out);
+            stencil3d_m.setArg(2, cl::__local(sizeof(cl_float) * (wk + 2) * (wj + 2) * (wi + 2)));
+            stencil3d_m.setArg(3, (cl_uint)nx);
+            stencil3d_m.setArg(4, (cl_uint)ny);
+            stencil3d_m.setArg(5, (cl_uint)nz);
+            stencil3d_m.setArg(6, c0);
+            stencil3d_m.setArg(7, cx);
+            stencil3d_m.setArg(8, cy);
+            stencil3d_m.setArg(9, cz);
+            queue.enqueueNDRangeKernel(stencil3d_m,
+                                       cl::NullRange,
+                                       cl::NDRange(AppBase::padded_size(nz, wk),
+                                                   AppBase::padded_size(ny, wj),
+                                                   AppBase::padded_size(nx, wi)),
+                                       cl::NDRange(wk, wj, wi),
+                                       NULL,
+                                       event);
+        }
+
+    // the sum of the n floats of in: a pass of at most local size groups
+    // into the sums of the groups, and a pass of one group over those if
+    // there are several, each after the one before for queues out of
+    // order, and the sum is read back blocking
+    float reduce_sum(cl::CommandQueue & queue,
+                     cl::Device const & device,
+                     cl::Buffer const & in,
+                     size_t n)
+        {
+            // the largest power of two of a work group, 256 at most
+            size_t const max_size = reduce_sum_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+            size_t local = 1;
+            while (local * 2 <= std::min<size_t>(256, max_size)) {
+                local *= 2;
+            }
+            size_t const groups = std::max<size_t>(1, std::min(local, (n + local - 1) / local));
+            if (partial_size_m < groups) {
+                partial_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(cl_float) * groups);
+                total_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(cl_float));
+                partial_size_m = groups;
+            }
+
+            reduce_sum_m.setArg(0, in);
+            reduce_sum_m.setArg(1, groups > 1 ? partial_m : total_m);
+            reduce_sum_m.setArg(2, cl::__local(sizeof(cl_float) * local));
+            reduce_sum_m.setArg(3, (cl_uint)n);
+            std::vector<cl::Event> done(1);
+            queue.enqueueNDRangeKernel(reduce_sum_m,
+                                       cl::NullRange,
+                                       cl::NDRange(groups * local),
+                                       cl::NDRange(local),
+                                       NULL,
+                                       &done[0]);
+            if (groups > 1) {
+                reduce_sum_m.setArg(0, partial_m);
+                reduce_sum_m.setArg(1, total_m);
+                reduce_sum_m.setArg(3, (cl_uint)groups);
+                std::vector<cl::Event> first(done);
+                queue.enqueueNDRangeKernel(reduce_sum_m,
+                                           cl::NullRange,
+                                           cl::NDRange(local),
+                                           cl::NDRange(local),
+                                           &first,
+                                           &done[0]);
+            }
+
+            cl_float sum;
+            queue.enqueueReadBuffer(total_m, CL_TRUE, 0, sizeof(cl_float), &sum, &done);
+            return sum;
+        }
+
+    // out[i] = in[index[i]] for i < n
+    void gather(cl::CommandQueue & queue,
+                cl::Device const & device,
+                cl::Buffer const & in,
+                cl::Buffer const & index,
+                cl::Buffer const & out,
+                size_t n,
+                cl::Event * event = NULL)
+        {
+            launch_indexed(gather_m, queue, device, in, index, out, n, event);
+        }
+
+    // out[index[i]] += in[i] for i < n, the items of an index in any order
+    void scatter_add(cl::CommandQueue & queue,
+                     cl::Device const & device,
+                     cl::Buffer const & in,
+                     cl::Buffer const & index,
+                     cl::Buffer const & out,
+                     size_t n,
+                     cl::Event * event = NULL)
+        {
+            launch_indexed(scatter_add_m, queue, device, in, index, out, n, event);
+        }
+
+    // runs each kernel on queue of device on data of a few sizes that do
+    // not fill the last work groups, against the same on the host, each
+    // finished before the next for queues out of order, and
+    // prints a line each, returns the number of kernels that failed
+    int self_check(cl::Context const & context,
+                   cl::CommandQueue & queue,
+                   cl::Device const & device,
+                   int verbose)
+        {
+            int failed = 0;
+            failed += check_stencil2d(context, queue, device, 1001, 777);
+            failed += check_stencil3d(context, queue, device, 67, 45, 101);
+            failed += check_reduce_sum(context, queue, device, 1);
+            failed += check_reduce_sum(context, queue, device, 1000003);
+            failed += check_gather_scatter(context, queue, device, 1000003, 65537);
+            if (verbose || failed) {
+                std::cerr << "[Kernel library]\n  " << failed << " of 5 checks failed\n";
+            }
+            return failed;
+        }
+
+private:
+
+    void launch_indexed(cl::Kernel & kernel,
+                        cl::CommandQueue & queue,
+                        cl::Device const & device,
+                        cl::Buffer const & in,
+                        cl::Buffer const & index,
+                        cl::Buffer const & out,
+                        size_t n,
+                        cl::Event * event)
+        {
+            size_t const local = std::min<size_t>(256, kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+            kernel.setArg(0, in);
+            kernel.setArg(1, index);
+            kernel.setArg(2, out);
+            kernel.setArg(3, (cl_uint)n);
+            queue.enqueueNDRangeKernel(kernel,
+                                       cl::NullRange,
+                                       cl::NDRange(AppBase::padded_size(n, local)),
+                                       cl::NDRange(local),
+                                       NULL,
+                                       event);
+        }
+
+    // pseudo random floats in [0, 1), the same on every run
+    static void fill(std::vector<float> & v)
+        {
+            unsigned int seed = 12345;
+            for (size_t i = 0; i < v.size(); ++i) {
+                seed = seed * 1103515245 + 12345;
+                v[i] = (seed >> 8) / 16777216.0f;
+            }
+        }
+
+    // whether got is within tol of want, relative to want or 1
+    static bool close(double got, double want, double tol)
+        {
+            return std::fabs(got - want) <= tol * std::max(1.0, std::fabs(want));
+        }
+
+    static int report(char const * name, size_t bad, size_t size)
+        {
+            if (bad) {
+                std::cerr << "  " << name << ": " << bad << " of " << size << " wrong\n";
+                return 1;
+            }
+            return 0;
+        }
+
+    int check_stencil2d(cl::Context const & context,
+                        cl::CommandQueue & queue,
+                        cl::Device const & device,
+                        size_t nx,
+                        size_t ny)
+        {
+            float const c0 = 0.5f, cx = 0.125f, cy = 0.125f;
+            std::vector<float> in(nx * ny), out(nx * ny);
+            fill(in);
+            cl::Buffer din(context, CL_MEM_READ_ONLY, sizeof(cl_float) * in.size());
+            cl::Buffer dout(context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * out.size());
+            queue.enqueueWriteBuffer(din, CL_TRUE, 0, sizeof(cl_float) * in.size(), &in[0]);
+            stencil2d(queue, device, din, dout, nx, ny, c0, cx, cy);
+            queue.finish();
+            queue.enqueueReadBuffer(dout, CL_TRUE, 0, sizeof(cl_float) * out.size(), &out[0]);
+
+            size_t bad = 0;
+            for (size_t i = 0; i < nx; ++i) {
+                for (size_t j = 0; j < ny; ++j) {
+                    size_t const c = i * ny + j;
+                    float want = in[c];
+                    if (i > 0 && i < nx - 1 && j > 0 && j < ny - 1) {
+                        want = c0 * in[c] + cx * (in[c - ny] + in[c + ny]) +
+                               cy * (in[c - 1] + in[c + 1]);
+                    }
+                    bad += !close(out[c], want, 1e-6);
+                }
+            }
+            return report("stencil2d", bad, out.size());
+        }
+
+    int check_stencil3d(cl::Context const & context,
+                        cl::CommandQueue & queue,
+                        cl::Device const & device,
+                        size_t nx,
+                        size_t ny,
+                        size_t nz)
+        {
+            float const c0 = 0.25f, cx = 0.125f, cy = 0.125f, cz = 0.125f;
+            std::vector<float> in(nx * ny * nz), out(nx * ny * nz);
+            fill(in);
+            cl::Buffer din(context, CL_MEM_READ_ONLY, sizeof(cl_float) * in.size());
+            cl::Buffer dout(context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * out.size());
+            queue.enqueueWriteBuffer(din, CL_TRUE, 0, sizeof(cl_float) * in.size(), &in[0]);
+            stencil3d(queue, device, din, dout, nx, ny, nz, c0, cx, cy, cz);
+            queue.finish();
+            queue.enqueueReadBuffer(dout, CL_TRUE, 0, sizeof(cl_float) * out.size(), &out[0]);
+
+            size_t const sx = ny * nz;
+            size_t bad = 0;
+            for (size_t i = 0; i < nx; ++i) {
+                for (size_t j = 0; j < ny; ++j) {
+                    for (size_t k = 0; k < nz; ++k) {
+                        size_t const c = (i * ny + j) * nz + k;
+                        float want = in[c];
+                        if (i > 0 && i < nx - 1 && j > 0 && j < ny - 1 &&
+                            k > 0 && k < nz - 1) {
+                            want = c0 * in[c] + cx * (in[c - sx] + in[c + sx]) +
+                                   cy * (in[c - nz] + in[c + nz]) +
+                                   cz * (in[c - 1] + in[c + 1]);
+                        }
+                        bad += !close(out[c], want, 1e-6);
+                    }
+                }
+            }
+            return report("stencil3d", bad, out.size());
+        }
+
+    int check_reduce_sum(cl::Context const & context,
+                         cl::CommandQueue & queue,
+                         cl::Device const & device,
+                         size_t n)
+        {
+            std::vector<float> in(n);
+            fill(in);
+            cl::Buffer din(context, CL_MEM_READ_ONLY, sizeof(cl_float) * n);
+            queue.enqueueWriteBuffer(din, CL_TRUE, 0, sizeof(cl_float) * n, &in[0]);
+            float const sum = reduce_sum(queue, device, din, n);
+
+            // the floats are summed in another order on the device, the
+            // error grows with the log of n at most, the tree being deep
+            double want = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                want += in[i];
+            }
+            if (!close(sum, want, 1e-5)) {
+                std::cerr << "  reduce_sum: " << sum << " instead of " << want
+                          << " for " << n << " floats\n";
+                return 1;
+            }
+            return 0;
+        }
+
+    // gathers n floats of m through a random index, and scatters them
+    // back added, the values integers so that the sums are exact in any
+    // order
+    int check_gather_scatter(cl::Context const & context,
+                             cl::CommandQueue & queue,
+                             cl::Device const & device,
+                             size_t n,
+                             size_t m)
+        {
+            std::vector<float> in(m), out(n), sums(m, 0.0f);
+            std::vector<cl_uint> index(n);
+            unsigned int seed = 54321;
+            for (size_t i = 0; i < m; ++i) {
+                in[i] = (float)(i % 64);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                seed = seed * 1103515245 + 12345;
+                index[i] = (seed >> 8) % m;
+            }
+            cl::Buffer din(context, CL_MEM_READ_ONLY, sizeof(cl_float) * m);
+            cl::Buffer dindex(context, CL_MEM_READ_ONLY, sizeof(cl_uint) * n);
+            cl::Buffer dout(context, CL_MEM_READ_WRITE, sizeof(cl_float) * n);
+            cl::Buffer dsums(context, CL_MEM_READ_WRITE, sizeof(cl_float) * m);
+            queue.enqueueWriteBuffer(din, CL_TRUE, 0, sizeof(cl_float) * m, &in[0]);
+            queue.enqueueWriteBuffer(dindex, CL_TRUE, 0, sizeof(cl_uint) * n, &index[0]);
+            queue.enqueueWriteBuffer(dsums, CL_TRUE, 0, sizeof(cl_float) * m, &sums[0]);
+            gather(queue, device, din, dindex, dout, n);
+            queue.finish();
+            scatter_add(queue, device, dout, dindex, dsums, n);
+            queue.finish();
+            queue.enqueueReadBuffer(dout, CL_TRUE, 0, sizeof(cl_float) * n, &out[0]);
+            queue.enqueueReadBuffer(dsums, CL_TRUE, 0, sizeof(cl_float) * m, &sums[0]);
+
+            size_t bad = 0;
+            std::vector<float> want(m, 0.0f);
+            for (size_t i = 0; i < n; ++i) {
+                bad += out[i] != in[index[i]];
+                want[index[i]] += in[index[i]];
+            }
+            int const failed = report("gather", bad, n);
+            bad = 0;
+            for (size_t i = 0; i < m; ++i) {
+                bad += sums[i] != want[i];
+            }
+            return report("scatter_add", bad, m) || failed;
+        }
+
+    cl::Context context_m;
+    cl::Kernel stencil2d_m;
+    cl::Kernel stencil3d_m;
+    cl::Kernel reduce_sum_m;
+    cl::Kernel gather_m;
+    cl::Kernel scatter_add_m;
+    cl::Buffer partial_m;       // the sums of the groups of reduce_sum
+    cl::Buffer total_m;         // and their sum
+    size_t partial_size_m;
+
+};
+
+#endif
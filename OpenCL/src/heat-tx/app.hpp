@@ -0,0 +1,80 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include <vector>
+
+#include "common/app-base.hpp"
+
+///
+// The problem of the heat-tx mini-app, the same 2D heat transfer simulation as
+// heat-tx/c with the meshes held on the device
+///
+struct HeatParams {
+    size_t nx;      // mesh rows
+    size_t ny;      // mesh columns
+    double c;       // thermal conductivity
+    size_t max_t;   // number of steps
+    int check;      // compare with the same steps run on the host
+    int dump;       // write heat-img.dat at the end
+    int specialize; // build the kernels for the sizes of the problem
+};
+
+class App : public AppBase {
+
+public:
+
+    App(int debug,
+        int profile,
+        int verbose,
+        std::vector<int> const & device_list,
+        HeatParams const & params)
+        : AppBase(debug, profile, verbose),
+          device_list_m(device_list),
+          params_m(params),
+          device_id_m(0),
+          wj_m(1),
+          wi_m(1)
+        {
+        }
+    
+    virtual void host_run();
+	
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    // the mesh and work group sizes of the problem as constants of the
+    // program, unless params_m.specialize is off
+    virtual void define_program_constants();
+
+    // the device of device_list_m or the most capable one
+    int select_device();
+
+    // the work group of at most 16 x 16 cells and max_group work items,
+    // wj x wi, dimension 0 along the rows
+    static void group_size(size_t max_group, size_t & wj, size_t & wi);
+
+    // the circle of constant heat of heat-tx/c in mesh, and as a list of
+    // cell indices and values
+    void set_initial_conds(std::vector<double> & mesh,
+                           std::vector<cl_uint> & source_index,
+                           std::vector<double> & source_value);
+
+    // the same steps as the device on the host, the reference of check
+    void host_steps(std::vector<double> & old_mesh,
+                    std::vector<double> & new_mesh,
+                    std::vector<cl_uint> const & source_index,
+                    std::vector<double> const & source_value,
+                    double cdtods2);
+
+    void dump(std::vector<double> const & mesh);
+
+    std::vector<int> const & device_list_m;
+    HeatParams params_m;
+    int device_id_m;
+    size_t wj_m;
+    size_t wi_m;
+
+};
+
+#endif
@@ -0,0 +1,107 @@
+// Device kernels...
+
+#include "heat-tx/app.hpp"
+
+#define STRINGIFY(X) #X
+
+// the pragmas can not go through STRINGIFY. contraction stays off so the
+// device rounds the stencil the same as the host reference. the mesh and
+// work group sizes are the constants of App::define_program_constants if
+// the program is built with them, so that the tile loads unroll and the
+// work group size is fixed, else the arguments and the launch
+std::string const program_text =
+    "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+    "#pragma OPENCL FP_CONTRACT OFF\n"
+    "#ifdef HEAT_NY\n"
+    "#define MESH_NX HEAT_NX\n"
+    "#define MESH_NY HEAT_NY\n"
+    "#else\n"
+    "#define MESH_NX nx\n"
+    "#define MESH_NY ny\n"
+    "#endif\n"
+    "#ifdef HEAT_WJ\n"
+    "#define GROUP_WJ HEAT_WJ\n"
+    "#define GROUP_WI HEAT_WI\n"
+    "#define GROUP_SIZE __attribute__((reqd_work_group_size(HEAT_WJ, HEAT_WI, 1)))\n"
+    "#else\n"
+    "#define GROUP_WJ get_local_size(0)\n"
+    "#define GROUP_WI get_local_size(1)\n"
+    "#define GROUP_SIZE\n"
+    "#endif\n"
+    STRINGIFY(
+
+
+    // one step of the 5-point stencil on an nx x ny row major mesh. dimension
+    // 0 runs along the rows. a work group first loads its block of cells and
+    // a one cell halo around it into tile, (local size 0 + 2) x (local size 1
+    // + 2) doubles, so every cell is read from global memory about once
+    // instead of five times. the edges of the mesh are fixed
+    __kernel GROUP_SIZE void heat_step(__global const double* old_mesh,
+                                       __global double* new_mesh,
+                                       __local double* tile,
+                                       uint const nx,
+                                       uint const ny,
+                                       double const cdtods2)
+    {
+        size_t const lj = get_local_id(0);
+        size_t const li = get_local_id(1);
+        size_t const wj = GROUP_WJ;
+        size_t const wi = GROUP_WI;
+        size_t const tw = wj + 2;
+        size_t const j = get_global_id(0);
+        size_t const i = get_global_id(1);
+        size_t k;
+
+        for (k = li * wj + lj; k < (wi + 2) * tw; k += wi * wj) {
+            long const ti = (long)(get_group_id(1) * wi + k / tw) - 1;
+            long const tj = (long)(get_group_id(0) * wj + k % tw) - 1;
+            tile[k] = (ti >= 0 && ti < (long)MESH_NX &&
+                       tj >= 0 && tj < (long)MESH_NY) ? old_mesh[ti * MESH_NY + tj] : 0.0;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (i > 0 && i < MESH_NX - 1 && j > 0 && j < MESH_NY - 1) {
+            size_t const c = (li + 1) * tw + lj + 1;
+            new_mesh[i * MESH_NY + j] = tile[c] + (cdtods2 * (tile[c + tw] +
+                                   tile[c - tw] - 4.0 * tile[c] +
+                                   tile[c + 1] + tile[c - 1]));
+        }
+    }
+
+
+    // stamps the constant heat source on mesh
+    __kernel void heat_source(__global double* mesh,
+                              __global const uint* index,
+                              __global const double* value,
+                              uint const ncells)
+    {
+        size_t k = get_global_id(0);
+        if (k < ncells) {
+            mesh[index[k]] = value[k];
+        }
+    }
+
+
+    );
+
+
+std::string const & App::get_device_program_text()
+{
+    return program_text;
+}
+
+
+void App::define_program_constants()
+{
+    // the work group of host_run, a kernel taking the largest of the device
+    device_id_m = select_device();
+    size_t const max_group = device_m[device_id_m].getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+    group_size(max_group, wj_m, wi_m);
+    if (!params_m.specialize) {
+        return;
+    }
+    define_constant("HEAT_NX", params_m.nx);
+    define_constant("HEAT_NY", params_m.ny);
+    define_constant("HEAT_WJ", wj_m);
+    define_constant("HEAT_WI", wi_m);
+}
@@ -0,0 +1,310 @@
+// Host code...
+
+#include <cmath>
+#include <stdexcept>
+#include <sys/time.h>
+
+#include "heat-tx/app.hpp"
+
+// some constant, as in heat-tx/c
+#define K 0.4
+
+// bytes moved per cell update with the neighbours in local memory: the old
+// cell is read and the new one written
+#define BYTES_PER_UPDATE (2 * sizeof(double))
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+}
+
+
+void App::set_initial_conds(std::vector<double> & mesh,
+                            std::vector<cl_uint> & source_index,
+                            std::vector<double> & source_value)
+{
+    long const nx = params_m.nx;
+    long const ny = params_m.ny;
+    long const x0 = nx / 2;
+    long const y0 = ny / 2;
+    long x = std::min(nx, ny) / 4;
+    long y = 0;
+    long radius_err = 1 - x;
+
+    mesh.assign(nx * ny, 0.0);
+    while (x >= y) {
+        mesh[( x + x0) * ny +  y + y0] = K * .50;
+        mesh[( y + x0) * ny +  x + y0] = K * .60;
+        mesh[(-x + x0) * ny +  y + y0] = K * .70;
+        mesh[(-y + x0) * ny +  x + y0] = K * .80;
+        mesh[(-x + x0) * ny + -y + y0] = K * .70;
+        mesh[(-y + x0) * ny + -x + y0] = K * .60;
+        mesh[( x + x0) * ny + -y + y0] = K * .50;
+        mesh[( y + x0) * ny + -x + y0] = K;
+        y++;
+        if (radius_err < 0) {
+            radius_err += 2 * y + 1;
+        } else {
+            --x;
+            radius_err += 2 * (y - x + 1);
+        }
+    }
+
+    // every source value is non-zero, so the non-zero cells are the source
+    source_index.clear();
+    source_value.clear();
+    for (size_t i = 0; i < mesh.size(); ++i) {
+        if (mesh[i] != 0.0) {
+            source_index.push_back(i);
+            source_value.push_back(mesh[i]);
+        }
+    }
+}
+
+
+void App::host_steps(std::vector<double> & old_mesh,
+                     std::vector<double> & new_mesh,
+                     std::vector<cl_uint> const & source_index,
+                     std::vector<double> const & source_value,
+                     double cdtods2)
+{
+    size_t const nx = params_m.nx;
+    size_t const ny = params_m.ny;
+
+    for (size_t t = 0; t < params_m.max_t; ++t) {
+        for (size_t i = 1; i < nx - 1; ++i) {
+            double const * oci = &old_mesh[i * ny];
+            double * nci = &new_mesh[i * ny];
+            for (size_t j = 1; j < ny - 1; ++j) {
+                nci[j] = oci[j] + (cdtods2 * (oci[j + ny] + oci[j - ny] -
+                                   4.0 * oci[j] + oci[j + 1] + oci[j - 1]));
+            }
+        }
+        for (size_t k = 0; k < source_index.size(); ++k) {
+            new_mesh[source_index[k]] = source_value[k];
+        }
+        old_mesh.swap(new_mesh);
+    }
+    // old_mesh holds step max_t, put the meshes back in the places the
+    // device buffers hold them
+    if (params_m.max_t % 2) {
+        old_mesh.swap(new_mesh);
+    }
+}
+
+
+// plot './heat-img.dat' matrix with image
+void App::dump(std::vector<double> const & mesh)
+{
+    FILE *imgfp = fopen("heat-img.dat", "wb");
+    if (!imgfp) {
+        std::cerr << "ERROR: could not open heat-img.dat\n";
+        return;
+    }
+    for (size_t i = 0; i < params_m.nx; ++i) {
+        for (size_t j = 0; j < params_m.ny; ++j) {
+            fprintf(imgfp, "%lf%s", mesh[i * params_m.ny + j],
+                    (j == params_m.ny - 1) ? "" : " ");
+        }
+        fprintf(imgfp, "\n");
+    }
+    fclose(imgfp);
+}
+
+
+int App::select_device()
+{
+    if (device_list_m.size()) {
+        // use first device in the device list
+        return device_list_m[0];
+    }
+    return get_most_capable_device();
+}
+
+
+void App::group_size(size_t max_group, size_t & wj, size_t & wi)
+{
+    wj = 16;
+    wi = 16;
+    while (wj * wi > max_group) {
+        if (wi > 1) {
+            wi /= 2;
+        } else {
+            wj /= 2;
+        }
+    }
+}
+
+
+void App::host_run()
+{
+    int rc;
+    size_t const nx = params_m.nx;
+    size_t const ny = params_m.ny;
+    size_t const size = nx * ny;
+
+    // the parameters of heat-tx/c
+    double const delta_s = 1.0 / (double)(std::max(nx, ny) + 1);
+    double const delta_t = pow(delta_s, 2.0) / (4.0 * params_m.c);
+    double const cdtods2 = (params_m.c * delta_t) / (delta_s * delta_s);
+
+    // host data: step 0 and the source
+    std::vector<double> mesh0;
+    std::vector<double> mesh1(size, 0.0);
+    std::vector<cl_uint> source_index;
+    std::vector<double> source_value;
+    set_initial_conds(mesh0, source_index, source_value);
+    cl_uint const ncells = source_index.size();
+
+    // Events for timing
+    cl::Event event1, event2, event3;
+
+    // Allocate device memory. step t is held by buf[t % 2], the steps stay on
+    // the device and the meshes are only read back at the end
+    cl::Buffer buf[2] = {
+        cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * size),
+        cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * size)
+    };
+    cl::Buffer ibuf(context_m, CL_MEM_READ_ONLY, sizeof(cl_uint) * ncells);
+    cl::Buffer vbuf(context_m, CL_MEM_READ_ONLY, sizeof(double) * ncells);
+
+    // Create kernels
+    cl::Kernel step(program_m, "heat_step", &rc);
+    cl::Kernel source(program_m, "heat_source", &rc);
+
+    // the device of define_program_constants
+    int const device_id = device_id_m;
+    if (verbose_m) {
+        std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n";
+    }
+    cl::CommandQueue & queue = queue_m[device_id];
+
+    // Work group of define_program_constants, which the program may be
+    // built for, the one the kernel takes if that is less
+    size_t work_group_size;
+    work_group_size = step.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device_id]);
+    size_t wj = wj_m;
+    size_t wi = wi_m;
+    if (wj * wi > work_group_size) {
+        if (params_m.specialize) {
+            throw std::runtime_error("the kernel takes less than the work group it is built for, run with --generic");
+        }
+        group_size(work_group_size, wj, wi);
+    }
+    size_t const gj = (ny + wj - 1) / wj * wj;
+    size_t const gi = (nx + wi - 1) / wi * wi;
+    size_t const source_group = std::min<size_t>(64, work_group_size);
+    size_t const gs = (ncells + source_group - 1) / source_group * source_group;
+    if (verbose_m) {
+        std::cerr << "  work group size = " << wj << " x " << wi << "\n";
+    }
+
+    rc = step.setArg(2, cl::__local(sizeof(double) * (wj + 2) * (wi + 2)));
+    rc = step.setArg(3, (cl_uint)nx);
+    rc = step.setArg(4, (cl_uint)ny);
+    rc = step.setArg(5, cdtods2);
+    rc = source.setArg(1, ibuf);
+    rc = source.setArg(2, vbuf);
+    rc = source.setArg(3, ncells);
+
+    // Copy input
+    queue.enqueueWriteBuffer(buf[0], CL_TRUE, 0, sizeof(double) * size,
+                             &mesh0[0], NULL, &event1);
+    queue.enqueueWriteBuffer(buf[1], CL_TRUE, 0, sizeof(double) * size,
+                             &mesh1[0]);
+    queue.enqueueWriteBuffer(ibuf, CL_TRUE, 0, sizeof(cl_uint) * ncells,
+                             &source_index[0]);
+    queue.enqueueWriteBuffer(vbuf, CL_TRUE, 0, sizeof(double) * ncells,
+                             &source_value[0]);
+
+    // Run the steps, the queue is in order so each step waits for the last
+    double const t0 = now();
+    for (size_t t = 0; t < params_m.max_t; ++t) {
+        rc = step.setArg(0, buf[t % 2]);
+        rc = step.setArg(1, buf[(t + 1) % 2]);
+        queue.enqueueNDRangeKernel(step,
+                                   cl::NullRange,
+                                   cl::NDRange(gj, gi),
+                                   cl::NDRange(wj, wi),
+                                   NULL,
+                                   (0 == t) ? &event2 : NULL);
+        rc = source.setArg(0, buf[(t + 1) % 2]);
+        queue.enqueueNDRangeKernel(source,
+                                   cl::NullRange,
+                                   cl::NDRange(gs),
+                                   cl::NDRange(source_group),
+                                   NULL,
+                                   (params_m.max_t - 1 == t) ? &event3 : NULL);
+    }
+    queue.finish();
+    double const secs = now() - t0;
+
+    // Timings
+    double const updates = (double)(nx - 2) * (ny - 2) * params_m.max_t;
+    double const cups = (secs > 0.0) ? updates / secs : 0.0;
+    if (profile_m && params_m.max_t > 0) {
+        cl_ulong start, end;
+        float t; // execution time in milliseconds
+
+        std::cerr << "[Timing]\n";
+        start = event1.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        end = event1.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        t = (end - start) * 1.0e-6f;
+        std::cerr << "  write execution time = " << t << " ms\n";
+        start = event2.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        end = event3.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        t = (end - start) * 1.0e-6f;
+        std::cerr << "  steps execution time = " << t << " ms\n";
+    }
+    std::cout << "[Results]\n"
+              << "  run time = " << secs << " s\n"
+              << "  cell updates/s = " << cups << "\n"
+              << "  effective bandwidth = "
+              << cups * BYTES_PER_UPDATE * 1.0e-9 << " GB/s\n";
+    // TIME:app,engine,nx,ny,threads,steps,secs,cell updates/s,GB/s as heat-tx/c
+    std::cout << "TIME:ocl-heat-tx,opencl," << nx << "," << ny << ","
+              << device_m[device_id].getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>()
+              << "," << params_m.max_t << "," << secs << "," << cups << ","
+              << cups * BYTES_PER_UPDATE * 1.0e-9 << "\n";
+
+    if (!params_m.check && !params_m.dump) {
+        return;
+    }
+
+    // Copy output, both meshes for the check
+    std::vector<double> odata0(size);
+    std::vector<double> odata1(size);
+    if (params_m.check) {
+        queue.enqueueReadBuffer(buf[0], CL_TRUE, 0, sizeof(double) * size,
+                                &odata0[0]);
+    }
+    queue.enqueueReadBuffer(buf[1], CL_TRUE, 0, sizeof(double) * size,
+                            &odata1[0]);
+
+    // the second mesh, the one heat-tx/c writes
+    if (params_m.dump) {
+        dump(odata1);
+    }
+
+    // Check results
+    if (params_m.check) {
+        host_steps(mesh0, mesh1, source_index, source_value, cdtods2);
+        int nerror = 0;
+        double maxdiff = 0.0;
+        for (size_t i = 0; i < size; ++i) {
+            double const d = std::max(std::fabs(odata0[i] - mesh0[i]),
+                                      std::fabs(odata1[i] - mesh1[i]));
+            maxdiff = std::max(maxdiff, d);
+            if (d > 1.0e-12) {
+                nerror++;
+            }
+        }
+        std::cerr << "  found " << nerror << " error(s) out of " << size
+                  << ", max difference " << maxdiff << "\n";
+        if (nerror) {
+            throw std::runtime_error("results differ from the host");
+        }
+    }
+}
@@ -0,0 +1,217 @@
+///
+// The main program of the OpenCL heat-tx mini-app
+///
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <getopt.h>
+
+#include "app.hpp"
+
+void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << "[options] [args]\n"
+              << "       " << name << "-h | --help\n";
+    exit(1);
+}
+
+
+void help(const char *name)
+{
+    std::cout << "Usage: " << name << "[options]\n"
+              << "\n"
+              << "Options:\n"
+              << "  -h | --help         print help (this message)\n"
+              << "  -D | --device-list  comma-separated list of devices to use\n"
+              << "  -d | --debug        enable debugging\n"
+              << "  -p | --profile      enable profiling\n"
+              << "  -v | --verbose      verbose output\n"
+              << "  -x | --nx           mesh rows (512)\n"
+              << "  -y | --ny           mesh columns (512)\n"
+              << "  -n | --n            mesh rows and columns\n"
+              << "  -c | --c            thermal conductivity (0.6)\n"
+              << "  -t | --max-t        number of steps (1024)\n"
+              << "  -C | --check        compare with the steps run on the host\n"
+              << "  -o | --dump         write heat-img.dat at the end\n"
+              << "  -g | --generic      build the kernels without the sizes of the problem\n"
+              << "\n";
+    exit(0);
+}
+
+
+int csv_to_list(const char *string, std::vector<int> & list)
+{
+    std::string sep(",");
+    std::string s(string);
+    size_t start = 0;
+    size_t end = 0;
+
+    do {
+        int val;
+        end = s.find(sep, start);
+        if (!(std::istringstream(s.substr(start, end - start)) >> val)) {
+            return -1;
+        }
+        list.push_back(val);
+        start = end + sep.size();
+    } while (end != std::string::npos);
+    return 0;
+}
+
+
+// a mesh size or step count of at least min
+int parse_size(const char *string, size_t min, size_t & val)
+{
+    std::istringstream is(string);
+    if (!(is >> val) || !is.eof() || val < min) {
+        return -1;
+    }
+    return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+    // default options
+    int debug = 0;
+    int profile = 0;
+    int verbose = 0;
+    std::vector<int> device_list;
+    HeatParams params;
+    params.nx = 512;
+    params.ny = 512;
+    params.c = 0.6;
+    params.max_t = 1024;
+    params.check = 0;
+    params.dump = 0;
+    params.specialize = 1;
+
+    // process options
+    while (1) {
+        static struct option long_options[] = {
+            {"help", no_argument, NULL, 'h'},
+            {"debug", no_argument, NULL, 'd'},
+            {"profile", no_argument, NULL, 'p'},
+            {"verbose", no_argument, NULL, 'v'},
+            {"device-list", required_argument, NULL, 'D'},
+            {"nx", required_argument, NULL, 'x'},
+            {"ny", required_argument, NULL, 'y'},
+            {"n", required_argument, NULL, 'n'},
+            {"c", required_argument, NULL, 'c'},
+            {"max-t", required_argument, NULL, 't'},
+            {"check", no_argument, NULL, 'C'},
+            {"dump", no_argument, NULL, 'o'},
+            {"generic", no_argument, NULL, 'g'},
+            {NULL, 0, NULL, 0}
+        };
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "dhpvD:x:y:n:c:t:Cog", long_options, &option_index);
+        if (c == -1) {
+            break;
+        } else if (c == '?') {
+            usage(argv[0]);
+            return 1;
+        } else if ('h' == c) {
+            help(argv[0]);
+            return 0;
+        } else if ('d' == c) {
+            debug = 1;
+        } else if ('p' == c) {
+            profile = 1;
+        } else if ('v' == c) {
+            verbose = 1;
+        } else if ('D' == c) {
+            if (csv_to_list(optarg, device_list) < 0) {
+                fprintf(stderr, "Invalid device list: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('x' == c || 'y' == c || 'n' == c || 't' == c) {
+            size_t val;
+            // the source circle needs a mesh of at least 4 x 4
+            if (parse_size(optarg, ('t' == c) ? 1 : 4, val) < 0) {
+                fprintf(stderr, "Invalid -%c: %s\n", c, optarg);
+                usage(argv[0]);
+                return 1;
+            }
+            if ('x' == c || 'n' == c) {
+                params.nx = val;
+            }
+            if ('y' == c || 'n' == c) {
+                params.ny = val;
+            }
+            if ('t' == c) {
+                params.max_t = val;
+            }
+        } else if ('c' == c) {
+            std::istringstream is(optarg);
+            if (!(is >> params.c) || !is.eof() || params.c <= 0.0) {
+                fprintf(stderr, "Invalid conductivity: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('C' == c) {
+            params.check = 1;
+        } else if ('o' == c) {
+            params.dump = 1;
+        } else if ('g' == c) {
+            params.specialize = 0;
+        } else {
+            return 1;
+        }
+    }
+    if (debug) {
+        std::cerr << "[Options]\n"
+                  << "  debug = " << debug << "\n"
+                  << "  profile = " << profile << "\n"
+                  << "  verbose = " << verbose << "\n"
+                  << "  nx = " << params.nx << "\n"
+                  << "  ny = " << params.ny << "\n"
+                  << "  c = " << params.c << "\n"
+                  << "  max_t = " << params.max_t << "\n"
+                  << "  check = " << params.check << "\n"
+                  << "  dump = " << params.dump << "\n"
+                  << "  specialize = " << params.specialize << "\n"
+                  << "  device list = ";
+        for (size_t i = 0; i < device_list.size(); ++i) {
+            std::cerr << " " << device_list[i];
+        }
+        std::cerr << "\n";
+        if (optind < argc) {
+            std::cerr << "Non-option arguments: ";
+            while (optind < argc) {
+                std::cerr << argv[optind++];
+            }
+            std::cerr << "\n";
+        }
+    }
+
+    // start work
+    try {
+        App app(debug,
+                profile,
+                verbose,
+                device_list,
+                params);
+		app.build_program();
+        app.host_run();
+        
+    }
+    catch (cl::Error const & e) {
+        std::cerr << "ERROR: OpenCL: "
+                  << e.what()
+                  << "("
+                  << App::opencl_error_string(e.err())
+                  << ")\n";
+        return 1;
+    }
+    catch (std::runtime_error const & e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include "common/app-base.hpp"
+#include "common/kernel-library.hpp"
+
+///
+// Checks the kernels of KernelLibrary on each device of the device list,
+// and a task graph of them, on out-of-order queues if asked for
+///
+class App : public AppBase {
+
+public:
+
+    App(int debug,
+        int profile,
+        int verbose,
+        std::vector<int> const & device_list,
+        int out_of_order)
+        : AppBase(debug, profile, verbose, out_of_order),
+          device_list_m(device_list)
+        {
+        }
+    
+    virtual void host_run();
+	
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    // two gathers of one array on device_id that do not depend on each
+    // other, between their writes and reads, as a TaskGraph, returns 1 if
+    // they are wrong
+    int check_task_graph(int device_id);
+
+    std::vector<int> const & device_list_m;
+
+};
+
+#endif
@@ -0,0 +1,10 @@
+// Device kernels...
+
+#include "kernels/app.hpp"
+
+
+// the library alone, an app with kernels of its own appends it to them
+std::string const & App::get_device_program_text()
+{
+    return KernelLibrary::program_text();
+}
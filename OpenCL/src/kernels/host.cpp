@@ -0,0 +1,112 @@
+// Host code...
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "kernels/app.hpp"
+
+
+int App::check_task_graph(int device_id)
+{
+    size_t const m = 65537;
+    size_t const n = 100003;
+    std::vector<float> in(m);
+    std::vector<cl_uint> index0(n), index1(n);
+    std::vector<float> out0(n), out1(n);
+    unsigned int seed = 2468;
+    for (size_t i = 0; i < m; ++i) {
+        in[i] = (float)i;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1103515245 + 12345;
+        index0[i] = (seed >> 8) % m;
+        index1[i] = (n - i) % m;
+    }
+
+    cl::Buffer din(context_m, CL_MEM_READ_ONLY, sizeof(cl_float) * m);
+    cl::Buffer dindex0(context_m, CL_MEM_READ_ONLY, sizeof(cl_uint) * n);
+    cl::Buffer dindex1(context_m, CL_MEM_READ_ONLY, sizeof(cl_uint) * n);
+    cl::Buffer dout0(context_m, CL_MEM_READ_WRITE, sizeof(cl_float) * n);
+    cl::Buffer dout1(context_m, CL_MEM_READ_WRITE, sizeof(cl_float) * n);
+    cl::Buffer dcopy(context_m, CL_MEM_READ_WRITE, sizeof(cl_float) * n);
+
+    // a kernel object each, the arguments taken when the graph runs
+    cl::Kernel gather0(program_m, "lib_gather");
+    cl::Kernel gather1(program_m, "lib_gather");
+    gather0.setArg(0, din);
+    gather0.setArg(1, dindex0);
+    gather0.setArg(2, dout0);
+    gather0.setArg(3, (cl_uint)n);
+    gather1.setArg(0, din);
+    gather1.setArg(1, dindex1);
+    gather1.setArg(2, dout1);
+    gather1.setArg(3, (cl_uint)n);
+    size_t const local = std::min<size_t>(256, gather0.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device_id]));
+    cl::NDRange const global(padded_size(n, local));
+    size_t const bytes = (sizeof(cl_uint) + 2 * sizeof(cl_float)) * n;
+
+    // the second gather goes to the host through a copy, the first
+    // straight, neither waiting for the other
+    TaskGraph graph;
+    size_t const w = graph.add_write("write", device_id, din, 0, sizeof(cl_float) * m, &in[0]);
+    size_t const w0 = graph.add_write("write", device_id, dindex0, 0, sizeof(cl_uint) * n, &index0[0]);
+    size_t const w1 = graph.add_write("write", device_id, dindex1, 0, sizeof(cl_uint) * n, &index1[0]);
+    size_t const g0 = graph.add_kernel("lib_gather", device_id, gather0, global, cl::NDRange(local), bytes);
+    size_t const g1 = graph.add_kernel("lib_gather", device_id, gather1, global, cl::NDRange(local), bytes);
+    size_t const c1 = graph.add_copy("copy", device_id, dout1, dcopy, 0, 0, sizeof(cl_float) * n);
+    size_t const r0 = graph.add_read("read", device_id, dout0, 0, sizeof(cl_float) * n, &out0[0]);
+    size_t const r1 = graph.add_read("read", device_id, dcopy, 0, sizeof(cl_float) * n, &out1[0]);
+    graph.add_edge(w, g0);
+    graph.add_edge(w0, g0);
+    graph.add_edge(w, g1);
+    graph.add_edge(w1, g1);
+    graph.add_edge(g1, c1);
+    graph.add_edge(g0, r0);
+    graph.add_edge(c1, r1);
+    run_task_graph(graph);
+
+    size_t bad = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bad += out0[i] != in[index0[i]];
+        bad += out1[i] != in[index1[i]];
+    }
+    if (bad) {
+        std::cerr << "  task graph: " << bad << " of " << 2 * n << " wrong\n";
+        return 1;
+    }
+    return 0;
+}
+
+
+void App::host_run()
+{
+    // the devices of the device list, or the most capable one
+    std::vector<int> devices(device_list_m);
+    if (devices.empty()) {
+        devices.push_back(get_most_capable_device());
+    }
+
+    KernelLibrary library(context_m, program_m);
+    int failed = 0;
+    for (size_t k = 0; k < devices.size(); ++k) {
+        int const device_id = devices[k];
+        if (verbose_m) {
+            std::cerr << "[Device selection]\n  checking device[" << device_id << "]: "
+                      << device_m[device_id].getInfo<CL_DEVICE_NAME>() << "\n";
+        }
+        double const t0 = wall_time();
+        int const f = library.self_check(context_m, queue_m[device_id],
+                                         device_m[device_id], verbose_m);
+        if (profile_m) {
+            std::cerr << "[Timing]\n  checks of device[" << device_id << "] = "
+                      << (wall_time() - t0) * 1.0e3 << " ms\n";
+        }
+        failed += f + check_task_graph(device_id);
+    }
+
+    std::cout << "[Results]\n  " << failed << " failed checks\n";
+    report_profile("kernels-trace.json");
+    if (failed) {
+        throw std::runtime_error("kernel library checks failed");
+    }
+}
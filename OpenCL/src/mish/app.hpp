@@ -0,0 +1,136 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include <string>
+#include <vector>
+
+#include "common/app-base.hpp"
+
+// the variables of the mesh and the boundaries, as MISH/hydro_cuda
+#define VARRHO 0
+#define VARVX  1
+#define VARVY  2
+#define VARPR  3
+#define NVAR   4
+
+#define BND_REFL 0
+#define BND_PERM 1
+
+///
+// The problem of the mish mini-app, an initial condition of the MISH
+// hydrocode and the options of its engine, see main.cpp
+///
+struct HydroParams {
+    std::string init;   // name of the initial condition
+    int nx;             // cells along x
+    int ny;             // cells along y
+    double dx;          // cell width
+    double dy;          // cell height
+    int idiv;           // the high state fills the cells i < idiv,
+    int jdiv;           // j < jdiv
+    double tend;        // end time, none if negative
+    int nstepmax;       // number of steps, none if negative
+    int nprtline;       // steps between the Iter lines
+    double sigma;       // Courant number
+    double gamma;       // ratio of specific heats
+    double smallr;      // density floor
+    double smallc;      // sound speed floor
+    int niter_riemann;  // iterations of the Riemann solver
+    int bnd[4];         // boundaries left, right, down and up
+};
+
+///
+// The physical constants of the kernels, the __constant HydroConsts of the
+// program in device.cpp, field for field
+///
+struct HydroConsts {
+    cl_double gamma;
+    cl_double dx;
+    cl_double dy;
+    cl_double smallr;
+    cl_double smallc;
+    cl_double smallp;
+};
+
+///
+// The kernels of MISH/hydro_cuda on an OpenCL device: the conserved
+// variables stay on the device for the whole run and dt is reduced there,
+// the host only reads the mesh back for the Iter lines and at the end
+///
+class App : public AppBase {
+
+public:
+
+    App(int debug,
+        int profile,
+        int verbose,
+        std::vector<int> const & device_list,
+        HydroParams const & params)
+        : AppBase(debug, profile, verbose),
+          device_list_m(device_list),
+          params_m(params),
+          device_id_m(0),
+          nth_m(1),
+          nblock_m(1)
+        {
+        }
+
+    virtual void host_run();
+
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    // the mesh size and the Riemann iterations as constants of the program
+    virtual void define_program_constants();
+
+    // the device of device_list_m or the most capable one
+    int select_device();
+
+    // the power of two work group of every kernel, at most 256 and what
+    // the device and the kernels take
+    size_t work_group_size(std::vector<cl::Kernel> const & kernels);
+
+    // enqueues kernel over global items, rounded up to the work group, in
+    // the profile as name moving bytes bytes
+    void launch(cl::Kernel & kernel, size_t global, char const * name,
+                size_t bytes);
+
+    // the reduction of the dt denominator over the mesh and set_dt, which
+    // leaves dt in step_m[0] and the time after the step in step_m[1]
+    void launch_dt();
+
+    // the halo, primitive, trace, Riemann and flux kernels of a pass along
+    // x (dir 0) or y (dir 1), with the dt of step_m
+    void run_pass(int dir);
+
+    // the sum of variable var of the nvar x (ny + 4) x (nx + 4) mesh
+    double sum_array(std::vector<double> const & mesh, int var);
+
+    std::vector<int> const & device_list_m;
+    HydroParams params_m;
+    int device_id_m;
+    size_t nth_m;
+    size_t nblock_m;
+
+    cl::Buffer u_m;
+    cl::Buffer q_m;
+    cl::Buffer ql_m;
+    cl::Buffer qr_m;
+    cl::Buffer flx_m;
+    cl::Buffer den_m[2];
+    cl::Buffer step_m;
+    cl::Buffer consts_m;
+
+    cl::Kernel calc_denom_m;
+    cl::Kernel redu_max_m;
+    cl::Kernel set_dt_m;
+    cl::Kernel gen_bnd_m[4];
+    cl::Kernel to_prim_m[2];
+    cl::Kernel trace_m;
+    cl::Kernel riemann_m;
+    cl::Kernel add_flux_m[2];
+
+};
+
+#endif
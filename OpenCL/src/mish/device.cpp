@@ -0,0 +1,514 @@
+// Device kernels...
+
+#include "mish/app.hpp"
+
+#define STRINGIFY(X) #X
+
+// the kernels of MISH/hydro_cuda/dev_funcs.cu. the preprocessor lines can
+// not go through STRINGIFY: the mesh size and the iterations of the
+// Riemann solver are the constants of App::define_program_constants, the
+// physical constants the __constant HydroConsts of app.hpp. the mesh u is
+// nvar x (ny + 4) x (nx + 4) with a two cell halo, the primitives q of a
+// pass nvar x nt x (np + 4) with np the cells along the pass and nt the
+// pencils, the traced states ql and qr nvar x nt x (np + 2) and the fluxes
+// nvar x nt x (np + 1)
+std::string const program_text =
+    "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+    "#define NX MISH_NX\n"
+    "#define NY MISH_NY\n"
+    "#define NITER_RIEMANN MISH_NITER_RIEMANN\n"
+    "#define VARRHO 0\n"
+    "#define VARVX 1\n"
+    "#define VARVY 2\n"
+    "#define VARPR 3\n"
+    "#define BND_REFL 0\n"
+    "#define BND_PERM 1\n"
+    STRINGIFY(
+
+
+    typedef struct {
+        double gamma;
+        double dx;
+        double dy;
+        double smallr;
+        double smallc;
+        double smallp;
+    } HydroConsts;
+
+
+    // the denominator of dt of each cell, reduced to its maximum over the
+    // work group in den[group], with local size doubles of den_local. the
+    // local size is a power of two
+    __kernel void calc_denom(__global const double* u,
+                             __global double* den,
+                             __local double* den_local,
+                             __constant HydroConsts* hc)
+    {
+        int const th = get_local_id(0);
+        int const k = get_global_id(0);
+        int stride;
+
+        den_local[th] = 0.0;
+        if (k < NX * NY) {
+            int const i = k % NX;
+            int const j = k / NX;
+            double const rho = fmax(u[(VARRHO * (NY + 4) + j + 2) * (NX + 4) + i + 2], hc->smallr);
+            double const vx = u[(VARVX * (NY + 4) + j + 2) * (NX + 4) + i + 2] / rho;
+            double const vy = u[(VARVY * (NY + 4) + j + 2) * (NX + 4) + i + 2] / rho;
+            double const eint = u[(VARPR * (NY + 4) + j + 2) * (NX + 4) + i + 2] / rho -
+                                0.5 * (vx * vx + vy * vy);
+            double const p = fmax((hc->gamma - 1.0) * rho * eint, rho * hc->smallp);
+            double const c = sqrt(hc->gamma * p / rho);
+            den_local[th] = (c + fabs(vx)) / hc->dx + (c + fabs(vy)) / hc->dy;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+            if (th < stride) {
+                den_local[th] = fmax(den_local[th], den_local[th + stride]);
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (th == 0) {
+            den[get_group_id(0)] = den_local[0];
+        }
+    }
+
+
+    // the maximum of the n values of in, two per work item, in out[group]
+    __kernel void redu_max(__global const double* in,
+                           __global double* out,
+                           __local double* arr,
+                           int const n)
+    {
+        int const th = get_local_id(0);
+        int const nth = get_local_size(0);
+        int const k = th + 2 * nth * get_group_id(0);
+        int stride;
+
+        arr[th] = 0.0;
+        if (k < n) {
+            arr[th] = in[k];
+        }
+        if (k + nth < n) {
+            arr[th] = fmax(arr[th], in[k + nth]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (stride = nth / 2; stride > 0; stride >>= 1) {
+            if (th < stride) {
+                arr[th] = fmax(arr[th], arr[th + stride]);
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (th == 0) {
+            out[get_group_id(0)] = arr[0];
+        }
+    }
+
+
+    // dt from the reduced denominator, cut to reach the end time in step[2]
+    // if it is set. step[0] receives dt and step[1] the time after the
+    // step, so dt never has to come back to the host
+    __kernel void set_dt(__global const double* den,
+                         __global double* step,
+                         double const sigma)
+    {
+        if (get_global_id(0) == 0) {
+            double dt = 0.5 * sigma / den[0];
+            if (step[2] > 0.0 && dt > step[2] - step[1]) {
+                dt = step[2] - step[1];
+            }
+            step[0] = dt;
+            step[1] += dt;
+        }
+    }
+
+
+    // the halo cell w of every variable from the cell r inside, the normal
+    // velocity vn turned around by a reflecting boundary
+    void bnd_copy(__global double* u, int const w, int const r, int const vn,
+                  int const bnd)
+    {
+        int const vsize = (NX + 4) * (NY + 4);
+        int v;
+
+        if (bnd != BND_REFL && bnd != BND_PERM) {
+            return;
+        }
+        for (v = 0; v < 4; ++v) {
+            u[w + v * vsize] = (bnd == BND_REFL && v == vn) ? -u[r + v * vsize] : u[r + v * vsize];
+        }
+    }
+
+
+    __kernel void gen_bndXL(__global double* u, int const bnd)
+    {
+        int const k = get_global_id(0);
+        int const i = k % 2;
+        int const j = k / 2;
+
+        if (j < NY) {
+            bnd_copy(u, i + (NX + 4) * (j + 2), 3 - i + (NX + 4) * (j + 2), VARVX, bnd);
+        }
+    }
+
+
+    __kernel void gen_bndXU(__global double* u, int const bnd)
+    {
+        int const k = get_global_id(0);
+        int const i = k % 2;
+        int const j = k / 2;
+
+        if (j < NY) {
+            bnd_copy(u, NX + 2 + i + (NX + 4) * (j + 2), NX + 1 - i + (NX + 4) * (j + 2), VARVX, bnd);
+        }
+    }
+
+
+    __kernel void gen_bndYL(__global double* u, int const bnd)
+    {
+        int const k = get_global_id(0);
+        int const i = k / 2;
+        int const j = k % 2;
+
+        if (i < NX) {
+            bnd_copy(u, i + 2 + (NX + 4) * j, i + 2 + (NX + 4) * (3 - j), VARVY, bnd);
+        }
+    }
+
+
+    __kernel void gen_bndYU(__global double* u, int const bnd)
+    {
+        int const k = get_global_id(0);
+        int const i = k / 2;
+        int const j = k % 2;
+
+        if (i < NX) {
+            bnd_copy(u, i + 2 + (NX + 4) * (NY + 2 + j), i + 2 + (NX + 4) * (NY + 1 - j), VARVY, bnd);
+        }
+    }
+
+
+    // the primitives of the rows of u with their x halo
+    __kernel void toPrimX(__global double* q,
+                          __global const double* u,
+                          __constant HydroConsts* hc)
+    {
+        int const k = get_global_id(0);
+        int const i = k % (NX + 4);
+        int const j = k / (NX + 4);
+
+        if (j < NY) {
+            double const r = fmax(u[i + (NX + 4) * (j + 2 + (NY + 4) * VARRHO)], hc->smallr);
+            double const vx = u[i + (NX + 4) * (j + 2 + (NY + 4) * VARVX)] / r;
+            double const vy = u[i + (NX + 4) * (j + 2 + (NY + 4) * VARVY)] / r;
+            double const eint = u[i + (NX + 4) * (j + 2 + (NY + 4) * VARPR)] - 0.5 * r * (vx * vx + vy * vy);
+            double const p = fmax((hc->gamma - 1.0) * r * eint, hc->smallp);
+            q[i + (NX + 4) * (j + NY * VARRHO)] = r;
+            q[i + (NX + 4) * (j + NY * VARVX)] = vx;
+            q[i + (NX + 4) * (j + NY * VARVY)] = vy;
+            q[i + (NX + 4) * (j + NY * VARPR)] = p;
+        }
+    }
+
+
+    // the primitives of the columns of u with their y halo, transposed so
+    // a pencil is contiguous and the velocity along it comes first
+    __kernel void toPrimY(__global double* q,
+                          __global const double* u,
+                          __constant HydroConsts* hc)
+    {
+        int const k = get_global_id(0);
+        int const i = k / (NY + 4);
+        int const j = k % (NY + 4);
+
+        if (i < NX) {
+            double const r = fmax(u[i + 2 + (NX + 4) * (j + (NY + 4) * VARRHO)], hc->smallr);
+            double const vx = u[i + 2 + (NX + 4) * (j + (NY + 4) * VARVX)] / r;
+            double const vy = u[i + 2 + (NX + 4) * (j + (NY + 4) * VARVY)] / r;
+            double const eint = u[i + 2 + (NX + 4) * (j + (NY + 4) * VARPR)] - 0.5 * r * (vx * vx + vy * vy);
+            double const p = fmax((hc->gamma - 1.0) * r * eint, hc->smallp);
+            q[j + (NY + 4) * (i + NX * VARRHO)] = r;
+            q[j + (NY + 4) * (i + NX * VARVX)] = vy;
+            q[j + (NY + 4) * (i + NX * VARVY)] = vx;
+            q[j + (NY + 4) * (i + NX * VARPR)] = p;
+        }
+    }
+
+
+    double slope(__global const double* q, int const ind)
+    {
+        double const dlft = q[ind] - q[ind - 1];
+        double const drgt = q[ind + 1] - q[ind];
+        double const dcen = 0.5 * (dlft + drgt);
+        double const dsgn = (dcen >= 0.0) ? 1.0 : -1.0;
+        double const dlim = (dlft * drgt < 0.0) ? 0.0 : fmin(fabs(dlft), fabs(drgt));
+        return dsgn * fmin(dlim, fabs(dcen));
+    }
+
+
+    // the traced states of interface k of the pencils, dt from step[0]
+    __kernel void trace(__global double* ql,
+                        __global double* qr,
+                        __global const double* q,
+                        __global const double* step,
+                        double const dx,
+                        int const np,
+                        int const nt,
+                        __constant HydroConsts* hc)
+    {
+        int const k = get_global_id(0);
+        int const i = k % (np + 2);
+        int const j = k / (np + 2);
+
+        if (j < nt) {
+            double const dtdx = step[0] / dx;
+            int const c = i + 1 + (np + 4) * j;
+            int const vs = (np + 4) * nt;
+            int const o = i + (np + 2) * j;
+            int const ovs = (np + 2) * nt;
+
+            double const r = q[c + vs * VARRHO];
+            double const u = q[c + vs * VARVX];
+            double const v1 = q[c + vs * VARVY];
+            double const p = q[c + vs * VARPR];
+
+            double const csq = hc->gamma * p / r;
+            double const cc = sqrt(csq);
+
+            double const dr = slope(q, c + vs * VARRHO);
+            double const du = slope(q, c + vs * VARVX);
+            double const dv1 = slope(q, c + vs * VARVY);
+            double const dp = slope(q, c + vs * VARPR);
+
+            double const alpham = 0.5 * (dp / (r * cc) - du) * r / cc;
+            double const alphap = 0.5 * (dp / (r * cc) + du) * r / cc;
+            double const alphazr = dr - dp / csq;
+            double spminus;
+            double spzero;
+            double spplus;
+            double ap;
+            double am;
+            double azr;
+            double azv1;
+
+            // right
+            spminus = ((u - cc) >= 0.0) ? 0.0 : (u - cc) * dtdx + 1.0;
+            spzero = (u >= 0.0) ? 0.0 : u * dtdx + 1.0;
+            spplus = ((u + cc) >= 0.0) ? 0.0 : (u + cc) * dtdx + 1.0;
+            ap = -0.5 * spplus * alphap;
+            am = -0.5 * spminus * alpham;
+            azr = -0.5 * spzero * alphazr;
+            azv1 = -0.5 * spzero * dv1;
+            qr[o + ovs * VARRHO] = r + (ap + am + azr);
+            qr[o + ovs * VARVX] = u + (am - am) * cc / r;
+            qr[o + ovs * VARVY] = v1 + azv1;
+            qr[o + ovs * VARPR] = p + (ap + am) * csq;
+
+            // left
+            spminus = ((u - cc) <= 0.0) ? 0.0 : (u - cc) * dtdx - 1.0;
+            spzero = (u <= 0.0) ? 0.0 : u * dtdx - 1.0;
+            spplus = ((u + cc) <= 0.0) ? 0.0 : (u + cc) * dtdx - 1.0;
+            ap = -0.5 * spplus * alphap;
+            am = -0.5 * spminus * alpham;
+            azr = -0.5 * spzero * alphazr;
+            azv1 = -0.5 * spzero * dv1;
+            ql[o + ovs * VARRHO] = r + (ap + am + azr);
+            ql[o + ovs * VARVX] = u + (am - am) * cc / r;
+            ql[o + ovs * VARVY] = v1 + azv1;
+            ql[o + ovs * VARPR] = p + (ap + am) * csq;
+        }
+    }
+
+
+    // the flux of interface k of the pencils between the left state of
+    // qxm and the right state of qxp
+    __kernel void riemann(__global double* flx,
+                          __global const double* qxm,
+                          __global const double* qxp,
+                          int const np,
+                          int const nt,
+                          __constant HydroConsts* hc)
+    {
+        int const k = get_global_id(0);
+        int const i = k % (np + 1);
+        int const j = k / (np + 1);
+
+        if (j < nt) {
+            int const vs = (np + 2) * nt;
+            int const m = i + (np + 2) * j;
+            int const f = i + (np + 1) * j;
+            int const fvs = (np + 1) * nt;
+            double const gamma = hc->gamma;
+            double const smallr = hc->smallr;
+            double const smallc = hc->smallc;
+            double const smallp = hc->smallp;
+            double const smallpp = smallr * smallp;
+            double const gmma6 = (gamma + 1.0) / (2.0 * gamma);
+            double const entho = 1.0 / (gamma - 1.0);
+
+            double const rl = fmax(qxm[m + vs * VARRHO], smallr);
+            double const vxl = qxm[m + vs * VARVX];
+            double const vyl = qxm[m + vs * VARVY];
+            double const pl = fmax(qxm[m + vs * VARPR], rl * smallp);
+
+            double const rr = fmax(qxp[m + 1 + vs * VARRHO], smallr);
+            double const vxr = qxp[m + 1 + vs * VARVX];
+            double const vyr = qxp[m + 1 + vs * VARVY];
+            double const pr = fmax(qxp[m + 1 + vs * VARPR], rl * smallp);
+
+            double const cl = gamma * pl * rl;
+            double const cr = gamma * pr * rr;
+
+            double wl = sqrt(cl);
+            double wr = sqrt(cr);
+            double px = fmax(0.0, ((wr * pl + wl * pr) + wl * wr * (vxl - vxr)) / (wl + wr));
+            double vxx;
+            double sgnm;
+            double ro;
+            double vxo;
+            double po;
+            double wo;
+            double vyo;
+            double co;
+            double rx;
+            double cx;
+            double spout;
+            double spin;
+            double ushk;
+            double scr;
+            double frac;
+            double gr;
+            double gvx;
+            double gp;
+            int n;
+
+            for (n = 0; n < NITER_RIEMANN; n++) {
+                double ql;
+                double qr;
+                double delp;
+                wl = sqrt(cl * (1.0 + gmma6 * (px - pl) / pl));
+                wr = sqrt(cr * (1.0 + gmma6 * (px - pr) / pr));
+                ql = 2.0 * wl * wl * wl / (wl * wl + cl);
+                qr = 2.0 * wr * wr * wr / (wr * wr + cr);
+                delp = fmax(-px, qr * ql / (qr + ql) * ((vxl - (px - pl) / wl) - (vxr + (px - pr) / wr)));
+                px += delp;
+                if (fabs(delp / (px + smallpp)) < 1.0e-6) {
+                    break;
+                }
+            }
+            wl = sqrt(cl * (1.0 + gmma6 * (px - pl) / pl));
+            wr = sqrt(cr * (1.0 + gmma6 * (px - pr) / pr));
+            vxx = 0.5 * (vxl + (pl - px) / wl + vxr - (pr - px) / wr);
+            if (vxx >= 0.0) {
+                sgnm = 1.0;
+                ro = rl;
+                vxo = vxl;
+                po = pl;
+                wo = wl;
+                vyo = vyl;
+            } else {
+                sgnm = -1.0;
+                ro = rr;
+                vxo = vxr;
+                po = pr;
+                wo = wr;
+                vyo = vyr;
+            }
+            co = fmax(smallc, sqrt(fabs(gamma * po / ro)));
+            rx = fmax(smallr, ro / (1.0 + ro * (po - px) / (wo * wo)));
+            cx = fmax(smallc, sqrt(fabs(gamma * px / rx)));
+
+            spout = co - sgnm * vxo;
+            spin = cx - sgnm * vxx;
+            ushk = wo / ro - sgnm * vxo;
+            if (px >= po) {
+                spin = ushk;
+                spout = ushk;
+            }
+            scr = fmax(spout - spin, smallc + fabs(spout + spin));
+            frac = fmax(0.0, fmin(1.0, 0.5 * (1.0 + (spout + spin) / scr)));
+
+            gr = frac * rx + (1.0 - frac) * ro;
+            gvx = frac * vxx + (1.0 - frac) * vxo;
+            gp = frac * px + (1.0 - frac) * po;
+            if (spout < 0.0) {
+                gr = ro;
+                gvx = vxo;
+                gp = po;
+            }
+            if (spin > 0.0) {
+                gr = rx;
+                gvx = vxx;
+                gp = px;
+            }
+
+            flx[f + fvs * VARRHO] = gr * gvx;
+            flx[f + fvs * VARVX] = gr * gvx * gvx + gp;
+            flx[f + fvs * VARVY] = vyo;
+            flx[f + fvs * VARPR] = gvx * (gp * entho + 0.5 * gr * (gvx * gvx + vyo * vyo) + gp);
+        }
+    }
+
+
+    // the fluxes of the x pass into the cells of u, dt from step[0]
+    __kernel void addFluxX(__global double* u,
+                           __global const double* flx,
+                           __global const double* step,
+                           double const dx)
+    {
+        int const k = get_global_id(0);
+        int const i = k % NX;
+        int const j = k / NX;
+
+        if (j < NY) {
+            double const dtdx = step[0] / dx;
+            int v;
+            for (v = 0; v < 4; ++v) {
+                u[i + 2 + (NX + 4) * (j + 2 + (NY + 4) * v)] += dtdx * (flx[i + (NX + 1) * (j + NY * v)] -
+                                                                        flx[i + 1 + (NX + 1) * (j + NY * v)]);
+            }
+        }
+    }
+
+
+    // the fluxes of the y pass into the cells of u, the velocities of the
+    // pencils swapped back
+    __kernel void addFluxY(__global double* u,
+                           __global const double* flx,
+                           __global const double* step,
+                           double const dy)
+    {
+        int const k = get_global_id(0);
+        int const i = k / NY;
+        int const j = k % NY;
+
+        if (i < NX) {
+            double const dtdy = step[0] / dy;
+            int v;
+            for (v = 0; v < 4; ++v) {
+                int const fv = (v == VARVX) ? VARVY : ((v == VARVY) ? VARVX : v);
+                u[i + 2 + (NX + 4) * (j + 2 + (NY + 4) * v)] += dtdy * (flx[j + (NY + 1) * (i + NX * fv)] -
+                                                                        flx[j + 1 + (NY + 1) * (i + NX * fv)]);
+            }
+        }
+    }
+
+
+    );
+
+
+std::string const & App::get_device_program_text()
+{
+    return program_text;
+}
+
+
+void App::define_program_constants()
+{
+    device_id_m = select_device();
+    define_constant("MISH_NX", params_m.nx);
+    define_constant("MISH_NY", params_m.ny);
+    define_constant("MISH_NITER_RIEMANN", params_m.niter_riemann);
+}
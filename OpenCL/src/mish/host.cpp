@@ -0,0 +1,314 @@
+// Host code...
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <sys/time.h>
+
+#include "mish/app.hpp"
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1.0e-6 * tv.tv_usec;
+}
+
+
+int App::select_device()
+{
+    if (device_list_m.size()) {
+        // use first device in the device list
+        return device_list_m[0];
+    }
+    return get_most_capable_device();
+}
+
+
+size_t App::work_group_size(std::vector<cl::Kernel> const & kernels)
+{
+    cl::Device const & device = device_m[device_id_m];
+    size_t max_size = std::min<size_t>(256, device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        max_size = std::min(max_size, kernels[k].getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    }
+    // the reductions halve the work group
+    size_t size = 1;
+    while (2 * size <= max_size) {
+        size *= 2;
+    }
+    return size;
+}
+
+
+void App::launch(cl::Kernel & kernel, size_t global, char const * name,
+                 size_t bytes)
+{
+    size_t const items = (global + nth_m - 1) / nth_m * nth_m;
+    queue_m[device_id_m].enqueueNDRangeKernel(kernel,
+                                              cl::NullRange,
+                                              cl::NDRange(items),
+                                              cl::NDRange(nth_m),
+                                              NULL,
+                                              profile(name, device_id_m, bytes));
+}
+
+
+void App::launch_dt()
+{
+    size_t const ncells = (size_t)params_m.nx * params_m.ny;
+    int nden = nblock_m;
+    int a = 0;
+
+    calc_denom_m.setArg(1, den_m[a]);
+    launch(calc_denom_m, ncells, "calc_denom", NVAR * sizeof(double) * ncells);
+    while (nden > 1) {
+        int const nred = (nden + 2 * (int)nth_m - 1) / (2 * (int)nth_m);
+        redu_max_m.setArg(0, den_m[a]);
+        redu_max_m.setArg(1, den_m[1 - a]);
+        redu_max_m.setArg(3, nden);
+        launch(redu_max_m, nred * nth_m, "redu_max", sizeof(double) * (nden + nred));
+        nden = nred;
+        a = 1 - a;
+    }
+    set_dt_m.setArg(0, den_m[a]);
+    launch(set_dt_m, 1, "set_dt", 0);
+}
+
+
+void App::run_pass(int dir)
+{
+    int const np = (dir == 0) ? params_m.nx : params_m.ny;
+    int const nt = (dir == 0) ? params_m.ny : params_m.nx;
+    double const dx = (dir == 0) ? params_m.dx : params_m.dy;
+    size_t const sv = NVAR * sizeof(double);
+
+    // the two halo kernels of the pass, from the left, right, down and up
+    // boundaries
+    for (int side = 0; side < 2; ++side) {
+        cl::Kernel & bnd = gen_bnd_m[2 * dir + side];
+        bnd.setArg(1, params_m.bnd[2 * dir + side]);
+        launch(bnd, 2 * nt, "gen_bnd", 4 * sv * nt);
+    }
+    launch(to_prim_m[dir], (size_t)(np + 4) * nt, "toPrim", 2 * sv * (np + 4) * nt);
+
+    trace_m.setArg(4, dx);
+    trace_m.setArg(5, np);
+    trace_m.setArg(6, nt);
+    launch(trace_m, (size_t)(np + 2) * nt, "trace", sv * ((np + 4) + 2 * (np + 2)) * nt);
+
+    riemann_m.setArg(3, np);
+    riemann_m.setArg(4, nt);
+    launch(riemann_m, (size_t)(np + 1) * nt, "riemann", sv * (2 * (np + 2) + (np + 1)) * nt);
+
+    launch(add_flux_m[dir], (size_t)np * nt, "addFlux", sv * (3 * np + 1) * nt);
+}
+
+
+double App::sum_array(std::vector<double> const & mesh, int var)
+{
+    int const nx = params_m.nx;
+    int const ny = params_m.ny;
+    double sum = 0.0;
+    double corr = 0.0;
+
+    // as sumArray of hydro_cuda, so the Iter lines compare
+    for (int k = 0; k < nx * ny; ++k) {
+        double const c_nxt = mesh[k % nx + 2 + (nx + 4) * (k / nx + 2 + (ny + 4) * var)];
+        double const nsum = sum + c_nxt;
+        corr = (nsum - sum) - c_nxt;
+        sum = nsum;
+    }
+    return sum + corr;
+}
+
+
+void App::host_run()
+{
+    int const nx = params_m.nx;
+    int const ny = params_m.ny;
+    size_t const ncells = (size_t)nx * ny;
+    size_t const mesh_size = NVAR * (size_t)(nx + 4) * (ny + 4);
+    size_t const np = std::max(nx, ny);
+    size_t const nt = std::min(nx, ny);
+    size_t const prim_size = NVAR * (np + 4) * nt;
+    size_t const q_size = NVAR * (np + 2) * nt;
+    size_t const flx_size = NVAR * (np + 1) * nt;
+
+    // the device of define_program_constants
+    int const device_id = device_id_m;
+    cl::Device const & device = device_m[device_id];
+    cl::CommandQueue & queue = queue_m[device_id];
+    std::string const name = device.getInfo<CL_DEVICE_NAME>();
+    if (verbose_m) {
+        std::cerr << "[Device selection]\n  using device[" << device_id << "]: " << name << "\n";
+    }
+    if (device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_fp64") == std::string::npos) {
+        throw std::runtime_error("the device has no double precision (cl_khr_fp64)");
+    }
+
+    // Create kernels
+    calc_denom_m = cl::Kernel(program_m, "calc_denom");
+    redu_max_m = cl::Kernel(program_m, "redu_max");
+    set_dt_m = cl::Kernel(program_m, "set_dt");
+    gen_bnd_m[0] = cl::Kernel(program_m, "gen_bndXL");
+    gen_bnd_m[1] = cl::Kernel(program_m, "gen_bndXU");
+    gen_bnd_m[2] = cl::Kernel(program_m, "gen_bndYL");
+    gen_bnd_m[3] = cl::Kernel(program_m, "gen_bndYU");
+    to_prim_m[0] = cl::Kernel(program_m, "toPrimX");
+    to_prim_m[1] = cl::Kernel(program_m, "toPrimY");
+    trace_m = cl::Kernel(program_m, "trace");
+    riemann_m = cl::Kernel(program_m, "riemann");
+    add_flux_m[0] = cl::Kernel(program_m, "addFluxX");
+    add_flux_m[1] = cl::Kernel(program_m, "addFluxY");
+
+    std::vector<cl::Kernel> kernels;
+    kernels.push_back(calc_denom_m);
+    kernels.push_back(redu_max_m);
+    kernels.push_back(trace_m);
+    kernels.push_back(riemann_m);
+    nth_m = work_group_size(kernels);
+    nblock_m = (ncells + nth_m - 1) / nth_m;
+    if (verbose_m) {
+        std::cerr << "  work group size = " << nth_m << "\n";
+    }
+
+    // Print relative sizes of memory requirements
+    size_t const mem_reqd = (mesh_size + prim_size + 2 * q_size + flx_size + 2 * nblock_m) * sizeof(double);
+    size_t const mem_avail = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+    printf("%lu/%lu of %f%% memory required for a %d var %dx%d mesh\n",
+           (unsigned long)mem_reqd, (unsigned long)mem_avail,
+           100.0 * mem_reqd / mem_avail, NVAR, nx, ny);
+    if (mem_reqd > mem_avail) {
+        throw std::runtime_error("not enough memory on the device");
+    }
+
+    // Allocate device memory, the state stays there for the whole run
+    u_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * mesh_size);
+    q_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * prim_size);
+    ql_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * q_size);
+    qr_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * q_size);
+    flx_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * flx_size);
+    den_m[0] = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * nblock_m);
+    den_m[1] = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * nblock_m);
+    step_m = cl::Buffer(context_m, CL_MEM_READ_WRITE, sizeof(double) * 3);
+    consts_m = cl::Buffer(context_m, CL_MEM_READ_ONLY, sizeof(HydroConsts));
+
+    // the arguments that stay, as device_init of hydro_cuda does for its
+    // constants
+    HydroConsts hc;
+    hc.gamma = params_m.gamma;
+    hc.dx = params_m.dx;
+    hc.dy = params_m.dy;
+    hc.smallr = params_m.smallr;
+    hc.smallc = params_m.smallc;
+    hc.smallp = params_m.smallc * params_m.smallc / params_m.gamma;
+    queue.enqueueWriteBuffer(consts_m, CL_TRUE, 0, sizeof(HydroConsts), &hc);
+
+    calc_denom_m.setArg(0, u_m);
+    calc_denom_m.setArg(2, cl::__local(sizeof(double) * nth_m));
+    calc_denom_m.setArg(3, consts_m);
+    redu_max_m.setArg(2, cl::__local(sizeof(double) * nth_m));
+    set_dt_m.setArg(1, step_m);
+    set_dt_m.setArg(2, params_m.sigma);
+    for (int k = 0; k < 4; ++k) {
+        gen_bnd_m[k].setArg(0, u_m);
+    }
+    for (int dir = 0; dir < 2; ++dir) {
+        to_prim_m[dir].setArg(0, q_m);
+        to_prim_m[dir].setArg(1, u_m);
+        to_prim_m[dir].setArg(2, consts_m);
+        add_flux_m[dir].setArg(0, u_m);
+        add_flux_m[dir].setArg(1, flx_m);
+        add_flux_m[dir].setArg(2, step_m);
+        add_flux_m[dir].setArg(3, (dir == 0) ? params_m.dx : params_m.dy);
+    }
+    trace_m.setArg(0, ql_m);
+    trace_m.setArg(1, qr_m);
+    trace_m.setArg(2, q_m);
+    trace_m.setArg(3, step_m);
+    trace_m.setArg(7, consts_m);
+    riemann_m.setArg(0, flx_m);
+    riemann_m.setArg(1, ql_m);
+    riemann_m.setArg(2, qr_m);
+    riemann_m.setArg(5, consts_m);
+
+    // the initial condition of main.cu, the high state below and left of
+    // idiv, jdiv
+    std::vector<double> mesh(mesh_size, 0.0);
+    for (int j = 0; j < ny; ++j) {
+        for (int i = 0; i < nx; ++i) {
+            bool const high = (i < params_m.idiv && j < params_m.jdiv);
+            mesh[i + 2 + (nx + 4) * (j + 2 + (ny + 4) * VARRHO)] = high ? 1.0 : 0.125;
+            mesh[i + 2 + (nx + 4) * (j + 2 + (ny + 4) * VARVX)] = 0.0;
+            mesh[i + 2 + (nx + 4) * (j + 2 + (ny + 4) * VARVY)] = 0.0;
+            mesh[i + 2 + (nx + 4) * (j + 2 + (ny + 4) * VARPR)] = high ? 2.5 : 0.25;
+        }
+    }
+    double const vol_cell = params_m.dx * params_m.dy;
+    printf("INIT: TM: %g TE: %g\n", vol_cell * sum_array(mesh, VARRHO),
+           vol_cell * sum_array(mesh, VARPR));
+
+    // Copy input, dt, the time and the end time of step_m
+    double step[3] = {0.0, 0.0, params_m.tend};
+    queue.enqueueWriteBuffer(u_m, CL_TRUE, 0, sizeof(double) * mesh_size, &mesh[0],
+                             NULL, profile("write", device_id, sizeof(double) * mesh_size));
+    queue.enqueueWriteBuffer(step_m, CL_TRUE, 0, sizeof(step), step);
+
+    // Run the steps, the queue is in order so each kernel waits for the
+    // last. dt and the time only come back for a run to an end time and
+    // for the Iter lines
+    bool const timed = (params_m.tend > 0.0);
+    double ctime = 0.0;
+    double dt = 0.0;
+    int n = 0;
+    double const t0 = now();
+    while ((n < params_m.nstepmax || params_m.nstepmax < 0) &&
+           (ctime < params_m.tend || params_m.tend < 0.0)) {
+        launch_dt();
+        if (n % 2 == 0) {
+            run_pass(0);
+            run_pass(1);
+        } else {
+            run_pass(1);
+            run_pass(0);
+        }
+        n += 1;
+        if (timed || n % params_m.nprtline == 0) {
+            queue.enqueueReadBuffer(step_m, CL_TRUE, 0, 2 * sizeof(double), step);
+            dt = step[0];
+            ctime = step[1];
+        }
+        if (n % params_m.nprtline == 0) {
+            queue.enqueueReadBuffer(u_m, CL_TRUE, 0, sizeof(double) * mesh_size, &mesh[0]);
+            printf("Iter %05d time %f dt %g TM: %g TE: %g\n", n, ctime, dt,
+                   vol_cell * sum_array(mesh, VARRHO), vol_cell * sum_array(mesh, VARPR));
+        }
+    }
+    queue.enqueueReadBuffer(step_m, CL_TRUE, 0, 2 * sizeof(double), step);
+    ctime = step[1];
+    double const secs = now() - t0;
+    printf("time: %f, %d iters run\n", ctime, n);
+
+    // Copy output
+    queue.enqueueReadBuffer(u_m, CL_TRUE, 0, sizeof(double) * mesh_size, &mesh[0],
+                            NULL, profile("read", device_id, sizeof(double) * mesh_size));
+    printf("FINAL: TM: %g TE: %g\n", vol_cell * sum_array(mesh, VARRHO),
+           vol_cell * sum_array(mesh, VARPR));
+
+    // TIME:cType,mType,init,nproc,nth,niters,ncells,wRunt,wComp,wOut as the
+    // MISH implementations, the device type and name as mType and its
+    // compute units as nth. Nothing is written, so wOut is 0
+    cl_device_type const type = device.getInfo<CL_DEVICE_TYPE>();
+    char const * type_name = (type == CL_DEVICE_TYPE_CPU) ? "CPU" :
+                             (type == CL_DEVICE_TYPE_GPU) ? "GPU" : "ACC";
+    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n", "cType", "mType", "init", "nproc",
+           "nth", "niters", "ncells", "wRunt", "wComp", "wOut");
+    printf("TIME:%s,\"%s:%s\",%s,%d,%d,%d,%lu,%g,%g,%g\n", "\"OpenCL\"",
+           type_name, name.c_str(), "\"Init\"", 1,
+           (int)device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>(), n,
+           (unsigned long)ncells, secs, secs, 0.0);
+    fflush(stdout);
+
+    report_profile("mish-trace.json");
+}
@@ -0,0 +1,248 @@
+///
+// The main program of the OpenCL mish mini-app
+///
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <getopt.h>
+
+#include "app.hpp"
+
+void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options] init [size]\n"
+              << "       " << name << " -h | --help\n";
+    exit(1);
+}
+
+
+void help(const char *name)
+{
+    std::cout << "Usage: " << name << " [options] init [size]\n"
+              << "\n"
+              << "  init is an initial condition of MISH, sod, crn, wsc size or\n"
+              << "  scs size (MISH/README.md)\n"
+              << "\n"
+              << "Options:\n"
+              << "  -h | --help         print help (this message)\n"
+              << "  -D | --device-list  comma-separated list of devices to use\n"
+              << "  -d | --debug        enable debugging\n"
+              << "  -p | --profile      enable profiling\n"
+              << "  -v | --verbose      verbose output\n"
+              << "  -s | --steps        number of steps (the init's)\n"
+              << "  -T | --tend         end time, none by default\n"
+              << "\n";
+    exit(0);
+}
+
+
+int csv_to_list(const char *string, std::vector<int> & list)
+{
+    std::string sep(",");
+    std::string s(string);
+    size_t start = 0;
+    size_t end = 0;
+
+    do {
+        int val;
+        end = s.find(sep, start);
+        if (!(std::istringstream(s.substr(start, end - start)) >> val)) {
+            return -1;
+        }
+        list.push_back(val);
+        start = end + sep.size();
+    } while (end != std::string::npos);
+    return 0;
+}
+
+
+// the mesh and the steps of init, with size the multiplier of wsc and scs,
+// as main.cu of MISH/hydro_cuda
+int set_init(HydroParams & params, std::string const & init, int size)
+{
+    params.init = init;
+    params.tend = -1.0;
+    params.nstepmax = 1000;
+    if ("sod" == init) {
+        params.nx = 100;
+        params.ny = 1000;
+        params.dx = 0.25 / params.nx;
+        params.dy = 1.0 / params.ny;
+        params.idiv = 100;
+        params.jdiv = 500;
+    } else if ("crn" == init) {
+        params.nx = 1000;
+        params.ny = 1000;
+        params.dx = 1.0 / params.nx;
+        params.dy = 1.0 / params.ny;
+        params.idiv = 500;
+        params.jdiv = 500;
+    } else if ("wsc" == init) {
+        params.nx = 100;
+        params.ny = 1000 * size;
+        params.dx = 0.25 / params.nx;
+        params.dy = 1.0 / params.ny;
+        params.idiv = 100;
+        params.jdiv = params.ny / 2;
+    } else if ("scs" == init) {
+        params.nx = 10 * size;
+        params.ny = 10 * size;
+        params.dx = 1.0 / params.nx;
+        params.dy = 1.0 / params.ny;
+        params.idiv = 4;
+        params.jdiv = 500;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+    // default options
+    int debug = 0;
+    int profile = 0;
+    int verbose = 0;
+    std::vector<int> device_list;
+    int nstepmax = -1;
+    double tend = -1.0;
+
+    // process options
+    while (1) {
+        static struct option long_options[] = {
+            {"help", no_argument, NULL, 'h'},
+            {"debug", no_argument, NULL, 'd'},
+            {"profile", no_argument, NULL, 'p'},
+            {"verbose", no_argument, NULL, 'v'},
+            {"device-list", required_argument, NULL, 'D'},
+            {"steps", required_argument, NULL, 's'},
+            {"tend", required_argument, NULL, 'T'},
+            {NULL, 0, NULL, 0}
+        };
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "dhpvD:s:T:", long_options, &option_index);
+        if (c == -1) {
+            break;
+        } else if (c == '?') {
+            usage(argv[0]);
+            return 1;
+        } else if ('h' == c) {
+            help(argv[0]);
+            return 0;
+        } else if ('d' == c) {
+            debug = 1;
+        } else if ('p' == c) {
+            profile = 1;
+        } else if ('v' == c) {
+            verbose = 1;
+        } else if ('D' == c) {
+            if (csv_to_list(optarg, device_list) < 0) {
+                fprintf(stderr, "Invalid device list: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('s' == c) {
+            std::istringstream is(optarg);
+            if (!(is >> nstepmax) || !is.eof() || nstepmax < 1) {
+                fprintf(stderr, "Invalid number of steps: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('T' == c) {
+            std::istringstream is(optarg);
+            if (!(is >> tend) || !is.eof() || tend <= 0.0) {
+                fprintf(stderr, "Invalid end time: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            return 1;
+        }
+    }
+
+    // the initial condition and its size multiplier
+    if (optind >= argc) {
+        fprintf(stderr, "No init supplied\n");
+        usage(argv[0]);
+        return 1;
+    }
+    std::string const init(argv[optind]);
+    int size = 1;
+    if (("wsc" == init || "scs" == init) &&
+        (optind + 1 >= argc || sscanf(argv[optind + 1], "%d", &size) != 1 || size <= 0)) {
+        fprintf(stderr, "No problem size multiplier supplied\n");
+        usage(argv[0]);
+        return 1;
+    }
+    HydroParams params;
+    if (set_init(params, init, size) < 0) {
+        fprintf(stderr, "Unknown init: %s\n", init.c_str());
+        usage(argv[0]);
+        return 1;
+    }
+    if (nstepmax > 0) {
+        params.nstepmax = nstepmax;
+    }
+    if (tend > 0.0) {
+        params.tend = tend;
+        if (nstepmax < 0) {
+            params.nstepmax = -1;
+        }
+    }
+    params.nprtline = 100;
+    params.sigma = 0.9;
+    params.gamma = 1.4;
+    params.smallr = 1e-10;
+    params.smallc = 1e-10;
+    params.niter_riemann = 10;
+    for (int k = 0; k < 4; ++k) {
+        params.bnd[k] = BND_REFL;
+    }
+    printf("INIT:%s\n", init.c_str());
+
+    if (debug) {
+        std::cerr << "[Options]\n"
+                  << "  debug = " << debug << "\n"
+                  << "  profile = " << profile << "\n"
+                  << "  verbose = " << verbose << "\n"
+                  << "  init = " << params.init << "\n"
+                  << "  nx = " << params.nx << "\n"
+                  << "  ny = " << params.ny << "\n"
+                  << "  nstepmax = " << params.nstepmax << "\n"
+                  << "  tend = " << params.tend << "\n"
+                  << "  device list = ";
+        for (size_t i = 0; i < device_list.size(); ++i) {
+            std::cerr << " " << device_list[i];
+        }
+        std::cerr << "\n";
+    }
+
+    // start work
+    try {
+        App app(debug,
+                profile,
+                verbose,
+                device_list,
+                params);
+        app.build_program();
+        app.host_run();
+    }
+    catch (cl::Error const & e) {
+        std::cerr << "ERROR: OpenCL: "
+                  << e.what()
+                  << "("
+                  << App::opencl_error_string(e.err())
+                  << ")\n";
+        return 1;
+    }
+    catch (std::runtime_error const & e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
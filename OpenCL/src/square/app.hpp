@@ -3,6 +3,15 @@
 
 #include "common/app-base.hpp"
 
+///
+// The options of the square mini-app
+///
+struct SquareParams {
+    size_t chunks;      // chunks of the pipelined run, 0 to run in one
+    int vector_width;   // floats per vector of the kernel, 0 for the device's
+    int per_item;       // vectors per work item, 0 for the device's
+};
+
 class App : public AppBase {
 
 public:
@@ -10,9 +19,11 @@ public:
     App(int debug,
         int profile,
         int verbose,
-        std::vector<int> const & device_list)
+        std::vector<int> const & device_list,
+        SquareParams const & params)
         : AppBase(debug, profile, verbose),
-          device_list_m(device_list)
+          device_list_m(device_list),
+          params_m(params)
         {
         }
     
@@ -22,7 +33,18 @@ private:
 
     virtual std::string const & get_device_program_text();
 
+    // host_run over all the devices of the device list, if there are several
+    void host_run_partitioned();
+
+    // host_run in params_m.chunks chunks, the copies overlapping the kernels
+    void host_run_pipelined();
+
+    // the vectorized kernel of device_id, of the params_m vector width and
+    // vectors per work item, or those the device prefers, see device.cpp
+    std::string vector_kernel_name(int device_id, int & width, int & per_item);
+
     std::vector<int> const & device_list_m;
+    SquareParams params_m;
 
 };
 
@@ -34,7 +34,78 @@ std::string const program_text = STRINGIFY(
     );
 
 
+// the square kernel over floatW vectors, per_item of them per work item a
+// global size apart, so that the work items of a group read contiguous
+// memory, the size % W floats after the last vector squared by work item 0.
+// square_vW_xK for W = width and K = per_item
+static std::string vector_kernel(int width, int per_item)
+{
+    std::ostringstream k;
+    k << "__kernel void square_v" << width << "_x" << per_item
+      << "(__global const float* input,\n"
+      << "                        __global float* output,\n"
+      << "                        size_t const size)\n"
+      << "{\n"
+      << "    size_t const n = size / " << width << ";\n"
+      << "    size_t const stride = get_global_size(0);\n"
+      << "    size_t i = get_global_id(0);\n"
+      << "    for (int k = 0; k < " << per_item << "; ++k, i += stride) {\n"
+      << "        if (i < n) {\n";
+    if (width == 1) {
+        k << "            float x = input[i];\n"
+          << "            output[i] = x * x;\n";
+    } else {
+        k << "            float" << width << " x = vload" << width << "(i, input);\n"
+          << "            vstore" << width << "(x * x, i, output);\n";
+    }
+    k << "        }\n"
+      << "    }\n"
+      << "    if (get_global_id(0) == 0) {\n"
+      << "        for (size_t j = n * " << width << "; j < size; ++j) {\n"
+      << "            output[j] = input[j] * input[j];\n"
+      << "        }\n"
+      << "    }\n"
+      << "}\n\n";
+    return k.str();
+}
+
+
 std::string const & App::get_device_program_text()
 {
-    return program_text;
+    static std::string text;
+    if (text.empty()) {
+        int const width[] = {1, 2, 4, 8, 16};
+        int const per_item[] = {1, 2, 4, 8};
+        text = program_text + "\n";
+        for (size_t w = 0; w < sizeof(width) / sizeof(width[0]); ++w) {
+            for (size_t e = 0; e < sizeof(per_item) / sizeof(per_item[0]); ++e) {
+                text += vector_kernel(width[w], per_item[e]);
+            }
+        }
+    }
+    return text;
+}
+
+
+std::string App::vector_kernel_name(int device_id, int & width, int & per_item)
+{
+    width = params_m.vector_width;
+    if (width == 0) {
+        // the preferred width up to a vector width of OpenCL C
+        cl_uint const preferred = device_m[device_id].getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>();
+        width = 1;
+        while (width < 16 && (cl_uint)width < preferred) {
+            width *= 2;
+        }
+    }
+    per_item = params_m.per_item;
+    if (per_item == 0) {
+        // a CPU work item is a loop, longer ones cost less to schedule; a
+        // GPU has the threads to hide its latency without them
+        per_item = (device_m[device_id].getInfo<CL_DEVICE_TYPE>() == CL_DEVICE_TYPE_CPU) ? 8 : 1;
+    }
+
+    std::ostringstream name;
+    name << "square_v" << width << "_x" << per_item;
+    return name.str();
 }
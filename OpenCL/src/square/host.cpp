@@ -2,32 +2,287 @@
 
 #include "square/app.hpp"
 
-void App::host_run()
+// number of items squared
+#define SIZE (1 << 25)
+
+
+// the errors of odata against the squares of idata, printed
+static int check_results(float const * idata, float const * odata, size_t size)
 {
-    int rc;
+    std::cout << "[Results]\n";
+    int nerror = 0;
+    for (size_t i = 0; i < size; ++i) {
+        float result = idata[i] * idata[i];
+        if (result != odata[i]) {
+            nerror++;
+            std::cout << "  error: idata[" << i << "]^2 ("
+                      << result
+                      << ") != odata["
+                      << i
+                      << "] ("
+                      << odata[i]
+                      << ")\n";
+        }
+    }
+    std::cerr << "  found " << nerror << " error(s) out of " << size << "\n";
+    return nerror;
+}
+
+
+///
+// The square kernel over the part of the items of a device: the input of
+// the part written to a sub-buffer, squared and read back, on one queue
+///
+class SquarePart : public PartitionedKernel {
+
+public:
+
+    SquarePart(AppBase & app,
+               cl::Program & program,
+               std::vector<cl::Device> const & devices,
+               cl::Buffer & ibuf,
+               cl::Buffer & obuf,
+               float const * idata,
+               float * odata)
+        : app_m(app),
+          program_m(program),
+          devices_m(devices),
+          ibuf_m(ibuf),
+          obuf_m(obuf),
+          idata_m(idata),
+          odata_m(odata)
+        {
+        }
+
+    virtual void enqueue(cl::CommandQueue & queue,
+                         int device_id,
+                         size_t offset,
+                         size_t count)
+        {
+            size_t const bytes = sizeof(float) * count;
+            cl::Buffer ipart = app_m.sub_buffer(ibuf_m, CL_MEM_READ_ONLY,
+                                                sizeof(float) * offset, bytes);
+            cl::Buffer opart = app_m.sub_buffer(obuf_m, CL_MEM_WRITE_ONLY,
+                                                sizeof(float) * offset, bytes);
+
+            // a kernel per part, the arguments of the others may change
+            // before they run
+            cl::Kernel kernel(program_m, "square");
+            kernel.setArg(0, ipart);
+            kernel.setArg(1, opart);
+            kernel.setArg(2, count);
+            size_t const wg = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(devices_m[device_id]);
+            size_t const global = (count + wg - 1) / wg * wg;
+
+            queue.enqueueWriteBuffer(ipart, CL_FALSE, 0, bytes, idata_m + offset);
+            queue.enqueueNDRangeKernel(kernel,
+                                       cl::NullRange,
+                                       cl::NDRange(global),
+                                       cl::NDRange(wg));
+            queue.enqueueReadBuffer(opart, CL_FALSE, 0, bytes, odata_m + offset);
+        }
 
-    // host data for tests
-    size_t const size = 1 << 25;
-    std::vector<float> idata;
-    std::vector<float> odata;
+private:
 
+    AppBase & app_m;
+    cl::Program & program_m;
+    std::vector<cl::Device> const & devices_m;
+    cl::Buffer & ibuf_m;
+    cl::Buffer & obuf_m;
+    float const * idata_m;
+    float * odata_m;
+
+};
+
+
+// the items split over all the devices of the device list, in proportion
+// to the rates of a calibration run on a sixteenth of them
+void App::host_run_partitioned()
+{
+    size_t const size = SIZE;
+    std::vector<float> idata(size);
+    std::vector<float> odata(size, 0.0f);
     for (size_t i = 0; i < size; ++i) {
-        idata.push_back((i));
+        idata[i] = i;
     }
-    odata.resize(idata.size());
 
-    // Events for timing
-    cl::Event event1, event2, event3;
+    cl::Buffer ibuf(context_m, CL_MEM_READ_ONLY, sizeof(float) * size);
+    cl::Buffer obuf(context_m, CL_MEM_WRITE_ONLY, sizeof(float) * size);
+    SquarePart square(*this, program_m, device_m, ibuf, obuf, &idata[0], &odata[0]);
 
-    // Allocate device memory
-    cl::Buffer ibuf(context_m, CL_MEM_READ_ONLY, sizeof(float) * idata.size());
-    cl::Buffer obuf(context_m, CL_MEM_WRITE_ONLY, sizeof(float) * odata.size());
+    size_t const granule = partition_granule(device_list_m, sizeof(float));
+    size_t const sample = std::max(granule, size / 16 / granule * granule);
+    std::vector<double> rate = calibrate_devices(square, device_list_m, sample);
+    Partition part = partition_range(device_list_m, rate, size, granule);
 
-    // Create kernel
-    cl::Kernel kernel(program_m, "square", &rc);
-    rc = kernel.setArg(0, ibuf);
-    rc = kernel.setArg(1, obuf);
-    rc = kernel.setArg(2, size);
+    double const t0 = wall_time();
+    partitioned_launch(square, part);
+    double const secs = wall_time() - t0;
+
+    if (profile_m) {
+        std::cerr << "[Timing]\n"
+                  << "  partitioned run time = " << secs * 1.0e3 << " ms, "
+                  << 2.0 * sizeof(float) * size / secs * 1.0e-9 << " GB/s\n";
+    }
+    check_results(&idata[0], &odata[0], size);
+}
+
+
+///
+// The square kernel a chunk at a time, each slot an input and an output
+// buffer of a chunk, the host data in pinned memory so the copies run
+// while the kernels do
+///
+class SquareChunks : public ChunkedKernel {
+
+public:
+
+    SquareChunks(std::vector<cl::Buffer> & ibuf,
+                 std::vector<cl::Buffer> & obuf,
+                 std::vector<cl::Kernel> & kernel,
+                 size_t work_group_size,
+                 float const * idata,
+                 float * odata)
+        : ibuf_m(ibuf),
+          obuf_m(obuf),
+          kernel_m(kernel),
+          work_group_size_m(work_group_size),
+          idata_m(idata),
+          odata_m(odata)
+        {
+        }
+
+    virtual void enqueue_upload(cl::CommandQueue & queue,
+                                size_t slot,
+                                size_t offset,
+                                size_t count,
+                                std::vector<cl::Event> const * wait,
+                                cl::Event * done)
+        {
+            queue.enqueueWriteBuffer(ibuf_m[slot], CL_FALSE, 0,
+                                     sizeof(float) * count, idata_m + offset,
+                                     wait, done);
+        }
+
+    virtual void enqueue_compute(cl::CommandQueue & queue,
+                                 size_t slot,
+                                 size_t /* offset */,
+                                 size_t count,
+                                 std::vector<cl::Event> const * wait,
+                                 cl::Event * done)
+        {
+            size_t const wg = work_group_size_m;
+            kernel_m[slot].setArg(2, count);
+            queue.enqueueNDRangeKernel(kernel_m[slot],
+                                       cl::NullRange,
+                                       cl::NDRange((count + wg - 1) / wg * wg),
+                                       cl::NDRange(wg),
+                                       wait,
+                                       done);
+        }
+
+    virtual void enqueue_download(cl::CommandQueue & queue,
+                                  size_t slot,
+                                  size_t offset,
+                                  size_t count,
+                                  std::vector<cl::Event> const * wait,
+                                  cl::Event * done)
+        {
+            queue.enqueueReadBuffer(obuf_m[slot], CL_FALSE, 0,
+                                    sizeof(float) * count, odata_m + offset,
+                                    wait, done);
+        }
+
+private:
+
+    std::vector<cl::Buffer> & ibuf_m;
+    std::vector<cl::Buffer> & obuf_m;
+    std::vector<cl::Kernel> & kernel_m;
+    size_t work_group_size_m;
+    float const * idata_m;
+    float * odata_m;
+
+};
+
+
+void App::host_run_pipelined()
+{
+    size_t const size = SIZE;
+    size_t const nslots = 2;
+    size_t const chunk = (size + params_m.chunks - 1) / params_m.chunks;
+
+    int device_id;
+    if (device_list_m.size()) {
+        device_id = device_list_m[0];
+    } else {
+        device_id = get_most_capable_device();
+    }
+    cl::CommandQueue & queue = queue_m[device_id];
+
+    // pinned host memory, which the copies of a chunk need to be
+    // asynchronous on most drivers
+    cl::Buffer ipinned(context_m, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, sizeof(float) * size);
+    cl::Buffer opinned(context_m, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, sizeof(float) * size);
+    float * idata = static_cast<float *>(queue.enqueueMapBuffer(ipinned, CL_TRUE, CL_MAP_WRITE, 0, sizeof(float) * size));
+    float * odata = static_cast<float *>(queue.enqueueMapBuffer(opinned, CL_TRUE, CL_MAP_READ, 0, sizeof(float) * size));
+    for (size_t i = 0; i < size; ++i) {
+        idata[i] = i;
+    }
+
+    // the slots, each with its kernel, the buffers from the pool
+    std::vector<cl::Buffer> ibuf, obuf;
+    std::vector<cl::Kernel> kernel;
+    for (size_t s = 0; s < nslots; ++s) {
+        ibuf.push_back(acquire_buffer(CL_MEM_READ_ONLY, sizeof(float) * chunk));
+        obuf.push_back(acquire_buffer(CL_MEM_WRITE_ONLY, sizeof(float) * chunk));
+        kernel.push_back(cl::Kernel(program_m, "square"));
+        kernel[s].setArg(0, ibuf[s]);
+        kernel[s].setArg(1, obuf[s]);
+    }
+    size_t const work_group_size = kernel[0].getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device_id]);
+    if (verbose_m) {
+        std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n"
+                  << "  work group size = " << work_group_size << "\n";
+    }
+
+    SquareChunks square(ibuf, obuf, kernel, work_group_size, idata, odata);
+    double const secs = pipelined_run(square, device_id, size, chunk, nslots);
+
+    if (profile_m) {
+        std::cerr << "[Timing]\n"
+                  << "  pipelined run time = " << secs * 1.0e3 << " ms, "
+                  << 2.0 * sizeof(float) * size / secs * 1.0e-9 << " GB/s\n";
+    }
+    report_profile("square-trace.json");
+    check_results(idata, odata, size);
+
+    // pipelined_run is done with the slots
+    for (size_t s = 0; s < nslots; ++s) {
+        release_buffer(ibuf[s], CL_MEM_READ_ONLY);
+        release_buffer(obuf[s], CL_MEM_WRITE_ONLY);
+    }
+    clear_buffer_pool();
+
+    queue.enqueueUnmapMemObject(ipinned, idata);
+    queue.enqueueUnmapMemObject(opinned, odata);
+    queue.finish();
+}
+
+
+void App::host_run()
+{
+    int rc;
+
+    if (device_list_m.size() > 1) {
+        host_run_partitioned();
+        return;
+    }
+    if (params_m.chunks > 0) {
+        host_run_pipelined();
+        return;
+    }
+
+    size_t const size = SIZE;
 
     // Select a device
     int device_id;
@@ -41,74 +296,67 @@ void App::host_run()
         std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n";
     }
 
-    // Copy input
-    queue_m[device_id].enqueueWriteBuffer(ibuf,
-                                          CL_TRUE,
-                                          0,
-                                          idata.size() * sizeof(float),
-                                          &idata[0],
-                                          NULL,
-                                          &event1);
+    // Allocate memory the host maps, the device memory itself if the device
+    // shares it with the host
+    HostBuffer ibuf, obuf;
+    create_host_buffer(device_id, CL_MEM_READ_ONLY, sizeof(float) * size, ibuf);
+    create_host_buffer(device_id, CL_MEM_WRITE_ONLY, sizeof(float) * size, obuf);
 
-    // Run kernel
-    size_t work_group_size;
-    work_group_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device_id]);
+    // host data for tests, written in place
+    float * idata = static_cast<float *>(ibuf.host);
+    for (size_t i = 0; i < size; ++i) {
+        idata[i] = i;
+    }
+
+    // Create kernel, the vectorized one of the device, of count work items
+    int width, per_item;
+    std::string const kernel_name = vector_kernel_name(device_id, width, per_item);
+    size_t const vectors = size / width;
+    size_t const count = std::max<size_t>(1, (vectors + per_item - 1) / per_item);
     if (verbose_m) {
-        std::cerr << "  work group size = " << work_group_size << "\n";
+        std::cerr << "  kernel = " << kernel_name << ", " << width
+                  << " floats per vector, " << per_item << " per work item\n";
+    }
+    cl::Kernel kernel(program_m, kernel_name.c_str(), &rc);
+    rc = kernel.setArg(0, ibuf.device);
+    rc = kernel.setArg(1, obuf.device);
+    rc = kernel.setArg(2, size);
+
+    // Copy input, or hand it over without a copy. the output goes to the
+    // device too, only a zero copy buffer needing it, unmapped
+    host_buffer_to_device(device_id, ibuf,
+                          profile("write", device_id, ibuf.zero_copy ? 0 : ibuf.size));
+    if (obuf.zero_copy) {
+        host_buffer_to_device(device_id, obuf);
     }
+
+    // Run kernel
+    size_t work_group_size;
+    work_group_size = tune_work_group_size(kernel, device_id, count);
     queue_m[device_id].enqueueNDRangeKernel(kernel,
                                             cl::NullRange,
-                                            cl::NDRange(size),
+                                            cl::NDRange(padded_size(count, work_group_size)),
                                             cl::NDRange(work_group_size),
                                             NULL,
-                                            &event2);
-    // Copy output
-    queue_m[device_id].enqueueReadBuffer(obuf,
-                                         CL_TRUE,
-                                         0,
-                                         odata.size() * sizeof(float),
-                                         &odata[0],
-                                         NULL,
-                                         &event3);
+                                            profile(kernel_name, device_id, 2 * sizeof(float) * size));
+    // Copy output, or map it back
+    host_buffer_to_host(device_id, obuf,
+                        profile("read", device_id, obuf.zero_copy ? 0 : obuf.size));
+    if (ibuf.zero_copy) {
+        host_buffer_to_host(device_id, ibuf);
+    }
 
     // Wait for completion
     queue_m[device_id].finish();
 
     // Timings
-    if (profile_m) {
-        cl_ulong start, end;
-        float t; // execution time in milliseconds
-
-        std::cerr << "[Timing]\n";
-        start = event1.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event1.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  write execution time = " << t << " ms\n";
-        start = event2.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event2.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  kernel execution time = " << t << " ms\n";
-        start = event3.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event3.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  read execution time = " << t << " ms\n";
-    }
+    report_profile("square-trace.json");
 
     // Check results
-    std::cout << "[Results]\n";
-    int nerror = 0;
-    for (size_t i = 0; i < idata.size(); ++i) {
-        float result = idata[i] * idata[i];
-        if (result != odata[i]) {
-            nerror++;
-            std::cout << "  error: idata[" << i << "]^2 ("
-                      << result
-                      << ") != odata["
-                      << i
-                      << "] ("
-                      << odata[i]
-                      << ")\n";
-        }
-    }
-    std::cerr << "  found " << nerror << " error(s) out of " << idata.size() << "\n";
+    check_results(static_cast<float const *>(ibuf.host),
+                  static_cast<float const *>(obuf.host),
+                  size);
+
+    release_host_buffer(device_id, ibuf);
+    release_host_buffer(device_id, obuf);
 }
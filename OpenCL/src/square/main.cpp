@@ -24,8 +24,15 @@ void help(const char *name)
               << "\n"
               << "Options:\n"
               << "  -h | --help         print help (this message)\n"
-              << "  -D | --device-list  comma-separated list of devices to use\n"
+              << "  -D | --device-list  comma-separated list of devices to use,\n"
+              << "                      the work split over them if several\n"
+              << "  -c | --chunks       run in this many chunks, copies and\n"
+              << "                      kernels overlapping, 0 (default) for one\n"
               << "  -d | --debug        enable debugging\n"
+              << "  -w | --vector-width floats per vector of the kernel, 1, 2, 4,\n"
+              << "                      8 or 16, 0 (default) for the device's\n"
+              << "  -e | --per-item     vectors per work item, 1, 2, 4 or 8, 0\n"
+              << "                      (default) for the device's\n"
               << "  -p | --profile      enable profiling\n"
               << "  -v | --verbose      verbose output\n"
               << "\n";
@@ -60,11 +67,18 @@ int main (int argc, char *argv[])
     int profile = 0;
     int verbose = 0;
     std::vector<int> device_list;
+    SquareParams params;
+    params.chunks = 0;
+    params.vector_width = 0;
+    params.per_item = 0;
 
     // process options
     while (1) {
         static struct option long_options[] = {
             {"help", no_argument, NULL, 'h'},
+            {"chunks", required_argument, NULL, 'c'},
+            {"vector-width", required_argument, NULL, 'w'},
+            {"per-item", required_argument, NULL, 'e'},
             {"debug", no_argument, NULL, 'd'},
             {"profile", no_argument, NULL, 'p'},
             {"verbose", no_argument, NULL, 'v'},
@@ -72,7 +86,7 @@ int main (int argc, char *argv[])
             {NULL, 0, NULL, 0}
         };
         int option_index = 0;
-        int c = getopt_long(argc, argv, "dhpvD:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "c:de:hpvw:D:", long_options, &option_index);
         if (c == -1) {
             break;
         } else if (c == '?') {
@@ -81,6 +95,22 @@ int main (int argc, char *argv[])
         } else if ('h' == c) {
             help(argv[0]);
             return 0;
+        } else if ('c' == c) {
+            params.chunks = strtoul(optarg, NULL, 0);
+        } else if ('w' == c) {
+            params.vector_width = atoi(optarg);
+            if (params.vector_width != 0 && params.vector_width != 1 &&
+                params.vector_width != 2 && params.vector_width != 4 &&
+                params.vector_width != 8 && params.vector_width != 16) {
+                usage(argv[0]);
+            }
+        } else if ('e' == c) {
+            params.per_item = atoi(optarg);
+            if (params.per_item != 0 && params.per_item != 1 &&
+                params.per_item != 2 && params.per_item != 4 &&
+                params.per_item != 8) {
+                usage(argv[0]);
+            }
         } else if ('d' == c) {
             debug = 1;
         } else if ('p' == c) {
@@ -102,6 +132,9 @@ int main (int argc, char *argv[])
                   << "  debug = " << debug << "\n"
                   << "  profile = " << profile << "\n"
                   << "  verbose = " << verbose << "\n"
+                  << "  chunks = " << params.chunks << "\n"
+                  << "  vector width = " << params.vector_width << "\n"
+                  << "  per item = " << params.per_item << "\n"
                   << "  device list = ";
         for (size_t i = 0; i < device_list.size(); ++i) {
             std::cerr << " " << device_list[i];
@@ -121,7 +154,8 @@ int main (int argc, char *argv[])
         App app(debug,
                 profile,
                 verbose,
-                device_list);
+                device_list,
+                params);
 		app.build_program();
         app.host_run();
         
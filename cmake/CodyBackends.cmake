@@ -0,0 +1,85 @@
+# Finds the toolchain of each back-end and sets CODY_HAVE_<BACKEND> when it
+# is enabled and there. The variants of a back-end that is not are skipped,
+# cody_backend_summary lists which and why
+
+set(CODY_BACKENDS OPENMP MPI CUDA OPENACC ISPC OPENCL LEGION LUA)
+
+# whether backend is built, and why not
+macro(cody_backend backend found why)
+  if(NOT DEFINED CODY_ENABLE_${backend} OR CODY_ENABLE_${backend})
+    if(${found})
+      set(CODY_HAVE_${backend} ON)
+    else()
+      set(CODY_HAVE_${backend} OFF)
+      set(CODY_WHY_${backend} "${why}")
+    endif()
+  else()
+    set(CODY_HAVE_${backend} OFF)
+    set(CODY_WHY_${backend} "CODY_ENABLE_${backend}=OFF")
+  endif()
+endmacro()
+
+if(CODY_ENABLE_OPENMP)
+  find_package(OpenMP COMPONENTS C CXX)
+endif()
+cody_backend(OPENMP OpenMP_C_FOUND "no OpenMP compiler support")
+
+if(CODY_ENABLE_MPI)
+  find_package(MPI COMPONENTS C CXX)
+endif()
+cody_backend(MPI MPI_C_FOUND "no MPI found")
+
+if(CODY_ENABLE_CUDA)
+  include(CheckLanguage)
+  check_language(CUDA)
+  if(CMAKE_CUDA_COMPILER)
+    enable_language(CUDA)
+  endif()
+endif()
+cody_backend(CUDA CMAKE_CUDA_COMPILER "no nvcc found")
+
+if(CODY_ENABLE_OPENACC)
+  find_package(OpenACC)
+endif()
+cody_backend(OPENACC OpenACC_C_FOUND "no OpenACC compiler support")
+
+if(CODY_ENABLE_ISPC)
+  find_program(ISPC_EXECUTABLE ispc)
+endif()
+cody_backend(ISPC ISPC_EXECUTABLE "no ispc found")
+
+if(CODY_ENABLE_OPENCL)
+  find_package(OpenCL)
+endif()
+cody_backend(OPENCL OpenCL_FOUND "no OpenCL headers and library")
+
+# the Legion runtime is not installed but built with the app, from its
+# sources in LG_RT_DIR
+set(CODY_LG_RT_DIR "$ENV{LG_RT_DIR}" CACHE PATH
+    "Legion runtime sources, legion/runtime of a Legion checkout")
+if(CODY_LG_RT_DIR AND EXISTS ${CODY_LG_RT_DIR}/runtime.mk)
+  set(CODY_LEGION_FOUND ON)
+else()
+  set(CODY_LEGION_FOUND OFF)
+endif()
+cody_backend(LEGION CODY_LEGION_FOUND "no runtime.mk in CODY_LG_RT_DIR")
+
+# not a back-end, but every UMMA version needs it
+find_package(Lua QUIET)
+cody_backend(LUA LUA_FOUND "no Lua headers and library, UMMA skipped")
+
+function(cody_backend_summary)
+  foreach(backend ${CODY_BACKENDS})
+    if(CODY_HAVE_${backend})
+      message(STATUS "CODY ${backend}: on")
+    else()
+      message(STATUS "CODY ${backend}: skipped, ${CODY_WHY_${backend}}")
+    endif()
+  endforeach()
+endfunction()
+
+# the flags of the Makefiles that are not in CMAKE_<LANG>_FLAGS
+set(CODY_NATIVE_FLAGS)
+if(CMAKE_C_COMPILER_ID MATCHES "GNU|Clang")
+  set(CODY_NATIVE_FLAGS -march=native)
+endif()
@@ -0,0 +1,115 @@
+# The cody-bench target. Each variant registers its benchmark run with
+# cody_bench, cody_bench_target writes them all to bench/cody-bench-runs.cmake
+# in the build tree and adds the target, which runs them one after the other
+# through cody-bench-run.cmake, CODY_BENCH_REPS times each in its own
+# directory bench/<name>/rep<k> with its log, and with CODY_CSV set so the
+# CODY rows of all the runs collect in bench/cody-bench.csv.
+#
+# cody-baseline and cody-compare run cody-bench and then perf/cody-regress.py
+# on its results, to store them as the baseline of the machine or to compare
+# them with it, see perf/README.md
+
+set(CODY_BENCH_FILTER "" CACHE STRING
+    "Regex of the benchmark runs of cody-bench, all of them when empty")
+set(CODY_BENCH_REPS 1 CACHE STRING
+    "Repetitions of each cody-bench run, 5 or more for cody-compare")
+set(CODY_BASELINE_DIR ${PROJECT_SOURCE_DIR}/perf/baselines CACHE PATH
+    "Directory of the baselines of cody-baseline and cody-compare")
+set(CODY_MACHINE "" CACHE STRING
+    "Name of the baseline of this machine, the host name when empty")
+
+# cody_bench(name target command... [MPI] [OMP] [EXIT] [RESULT regex]
+#            [DIRS dir...] [FILES src:dst...])
+#
+# runs command, which may use generator expressions such as
+# $<TARGET_FILE:target>, once target is built. MPI launches it with mpiexec
+# on CODY_BENCH_NPROC processes, OMP sets OMP_NUM_THREADS to CODY_BENCH_NTH,
+# DIRS are made in the run directory and FILES copied into it. The lines of
+# the log matching RESULT, TIME and CODY lines by default, are printed and
+# the run failed when there are none, as in MISH/bench.sh whatever its exit
+# status. EXIT is for those that print no result, the run fails on a non
+# zero exit status instead. Every run prints its wall time too, in whole
+# seconds, as
+#
+#     BENCH:name,secs
+function(cody_bench name target)
+  cmake_parse_arguments(PARSE_ARGV 2 B "MPI;OMP;EXIT" "RESULT" "DIRS;FILES")
+  set(cmd ${B_UNPARSED_ARGUMENTS})
+  if(B_MPI)
+    set(cmd ${MPIEXEC_EXECUTABLE} ${MPIEXEC_NUMPROC_FLAG} ${CODY_BENCH_NPROC}
+            ${MPIEXEC_PREFLAGS} ${cmd} ${MPIEXEC_POSTFLAGS})
+  endif()
+  set(nth 1)
+  if(B_OMP)
+    set(nth ${CODY_BENCH_NTH})
+  endif()
+  if(B_EXIT)
+    set(B_RESULT "")
+  elseif(NOT B_RESULT)
+    set(B_RESULT "^(TIME|CODY):")
+  endif()
+
+  set(line "cody_run([=[${name}]=] ${nth} [=[${B_RESULT}]=] \"")
+  foreach(d ${B_DIRS})
+    string(APPEND line "DIR:${d};")
+  endforeach()
+  foreach(f ${B_FILES})
+    string(APPEND line "FILE:${f};")
+  endforeach()
+  string(APPEND line "\"")
+  foreach(a ${cmd})
+    string(APPEND line " [=[${a}]=]")
+  endforeach()
+  string(APPEND line ")\n")
+
+  set_property(GLOBAL APPEND_STRING PROPERTY CODY_BENCH_RUNS "${line}")
+  set_property(GLOBAL APPEND PROPERTY CODY_BENCH_TARGETS ${target})
+endfunction()
+
+function(cody_bench_target)
+  get_property(runs GLOBAL PROPERTY CODY_BENCH_RUNS)
+  get_property(targets GLOBAL PROPERTY CODY_BENCH_TARGETS)
+  set(runs_file ${CMAKE_BINARY_DIR}/bench/cody-bench-runs.cmake)
+
+  file(GENERATE OUTPUT ${runs_file} CONTENT "${runs}")
+
+  # what the results depend on besides the machine, compared with that of
+  # the baseline by cody-compare
+  set(config)
+  foreach(v CMAKE_BUILD_TYPE CMAKE_C_FLAGS CMAKE_CXX_FLAGS CODY_BENCH_NPROC
+            CODY_BENCH_NTH MISH_BENCH_INIT UMMA_BENCH_NEDGES
+            UMMA_BENCH_NLOOPS QUADTREE_BENCH_ARGS)
+    string(APPEND config "${v}=${${v}}\n")
+  endforeach()
+  string(APPEND config
+    "compiler=${CMAKE_C_COMPILER_ID} ${CMAKE_C_COMPILER_VERSION}\n")
+  file(WRITE ${CMAKE_BINARY_DIR}/bench/config.txt "${config}")
+  add_custom_target(cody-bench
+    COMMAND ${CMAKE_COMMAND} -DRUNS=${runs_file}
+            -DBENCH_DIR=${CMAKE_BINARY_DIR}/bench
+            -DFILTER=${CODY_BENCH_FILTER} -DREPS=${CODY_BENCH_REPS}
+            -P ${CMAKE_SOURCE_DIR}/cmake/cody-bench-run.cmake
+    USES_TERMINAL VERBATIM)
+  if(targets)
+    list(REMOVE_DUPLICATES targets)
+    add_dependencies(cody-bench ${targets})
+  endif()
+
+  find_package(Python3 COMPONENTS Interpreter)
+  if(NOT Python3_Interpreter_FOUND)
+    message(STATUS "CODY cody-baseline and cody-compare: skipped, no python3")
+    return()
+  endif()
+  set(regress ${Python3_EXECUTABLE} ${PROJECT_SOURCE_DIR}/perf/cody-regress.py)
+  set(args ${CMAKE_BINARY_DIR}/bench --baselines ${CODY_BASELINE_DIR})
+  if(CODY_MACHINE)
+    list(APPEND args --machine ${CODY_MACHINE})
+  endif()
+  add_custom_target(cody-baseline COMMAND ${regress} save ${args}
+    USES_TERMINAL VERBATIM)
+  add_custom_target(cody-compare COMMAND ${regress} compare ${args}
+    --report ${CMAKE_BINARY_DIR}/bench/cody-compare.txt
+    USES_TERMINAL VERBATIM)
+  add_dependencies(cody-baseline cody-bench)
+  add_dependencies(cody-compare cody-bench)
+endfunction()
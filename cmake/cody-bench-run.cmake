@@ -0,0 +1,93 @@
+# Runs the benchmarks of cody-bench, see CodyBench.cmake
+#
+#     cmake -DRUNS=<runs file> -DBENCH_DIR=<dir> [-DFILTER=<regex>]
+#           [-DREPS=<n>] -P ...
+#
+# runs each one REPS times, in <dir>/<name>/rep<k> with its log and the
+# CODY rows of the run in cody.csv, prints the result lines of each, and
+# fails after the last one if any of them printed none. The names of the
+# runs that ran are listed in <dir>/runs.txt, for perf/cody-regress.py
+
+set(failed)
+set(csv ${BENCH_DIR}/cody-bench.csv)
+file(REMOVE ${csv} ${BENCH_DIR}/runs.txt)
+if(NOT REPS)
+  set(REPS 1)
+endif()
+
+# one repetition of run name in dir, appending its CODY rows to csv
+function(cody_rep name dir nth result setup)
+  file(REMOVE_RECURSE ${dir})
+  file(MAKE_DIRECTORY ${dir})
+  foreach(s ${setup})
+    if(s MATCHES "^DIR:(.*)$")
+      file(MAKE_DIRECTORY ${dir}/${CMAKE_MATCH_1})
+    elseif(s MATCHES "^FILE:(.*):(.*)$")
+      configure_file(${CMAKE_MATCH_1} ${dir}/${CMAKE_MATCH_2} COPYONLY)
+    endif()
+  endforeach()
+
+  set(ENV{OMP_NUM_THREADS} ${nth})
+  set(ENV{CODY_CSV} ${dir}/cody.csv)
+  string(TIMESTAMP t0 "%s")
+  execute_process(COMMAND ${ARGN}
+    WORKING_DIRECTORY ${dir}
+    OUTPUT_FILE ${dir}/log ERROR_FILE ${dir}/log
+    RESULT_VARIABLE rc)
+  string(TIMESTAMP t1 "%s")
+  set(lines)
+  if(result)
+    file(STRINGS ${dir}/log lines REGEX "${result}")
+    set(ok "${lines}")
+  else()
+    string(REGEX MATCH "^0$" ok "${rc}")
+  endif()
+  if(ok STREQUAL "")
+    message(STATUS "cody-bench: ${name} failed (${rc}), see ${dir}/log")
+    set(rep_ok OFF PARENT_SCOPE)
+    return()
+  endif()
+  foreach(l ${lines})
+    message("${l}")
+  endforeach()
+  math(EXPR secs "${t1} - ${t0}")
+  message("BENCH:${name},${secs}")
+
+  # the header once, at the top of csv
+  if(EXISTS ${dir}/cody.csv)
+    file(STRINGS ${dir}/cody.csv rows)
+    if(EXISTS ${csv})
+      list(REMOVE_AT rows 0)
+    endif()
+    foreach(r ${rows})
+      file(APPEND ${csv} "${r}\n")
+    endforeach()
+  endif()
+  set(rep_ok ON PARENT_SCOPE)
+endfunction()
+
+function(cody_run name nth result setup)
+  if(FILTER AND NOT name MATCHES "${FILTER}")
+    return()
+  endif()
+  file(REMOVE_RECURSE ${BENCH_DIR}/${name})
+  foreach(k RANGE 1 ${REPS})
+    message(STATUS "cody-bench: ${name} (${k}/${REPS})")
+    cody_rep(${name} ${BENCH_DIR}/${name}/rep${k} ${nth} "${result}"
+      "${setup}" ${ARGN})
+    if(NOT rep_ok)
+      set(failed ${failed} ${name} PARENT_SCOPE)
+      return()
+    endif()
+  endforeach()
+  file(APPEND ${BENCH_DIR}/runs.txt "${name}\n")
+endfunction()
+
+include(${RUNS})
+
+if(EXISTS ${csv})
+  message(STATUS "cody-bench: CODY rows in ${csv}")
+endif()
+if(failed)
+  message(FATAL_ERROR "cody-bench: failed runs: ${failed}")
+endif()
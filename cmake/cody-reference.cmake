@@ -0,0 +1,14 @@
+# The reference problems of the regression suite, perf/README.md, as an
+# initial cache so that they stay those of the stored baselines:
+#
+#     cmake -C cmake/cody-reference.cmake -S . -B build-perf
+#
+# The processes and threads are left to the machine, they are part of its
+# baseline
+
+set(CMAKE_BUILD_TYPE Release CACHE STRING "")
+set(CODY_BENCH_REPS 5 CACHE STRING "")
+set(MISH_BENCH_INIT sod CACHE STRING "")
+set(UMMA_BENCH_NEDGES 1000000 CACHE STRING "")
+set(UMMA_BENCH_NLOOPS 10 CACHE STRING "")
+set(QUADTREE_BENCH_ARGS "6 0.05" CACHE STRING "")
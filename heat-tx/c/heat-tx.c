@@ -64,70 +64,152 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/* the instruction sets of the intrinsic stencil kernels */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEATTX_X86 1
+#include <immintrin.h>
+#else
+#define HEATTX_X86 0
+#endif
+#if defined(__aarch64__)
+#define HEATTX_NEON 1
+#include <arm_neon.h>
+#else
+#define HEATTX_NEON 0
+#endif
 
-/* return codes */
-enum {
-    SUCCESS = 0,
-    FAILURE,
-    FAILURE_OOR,
-    FAILURE_IO,
-    FAILURE_INVALID_ARG
-};
-
-static char *app_name = "c-heat-tx";
-static char *app_ver = "0.2";
+#include "heat-tx.h"
 
-/* max simulation time */
-#define T_MAX 1024
-/* nx and ny */
-#define N 512
-/* thermal conductivity */
-#define THERM_COND 0.6
 /* some constant */
 #define K 0.4
 
-typedef struct mesh_t {
-    /* mesh size in x and y */
-    uint64_t nx, ny; 
-    /* mesh cells */
-    double **cells;
-} mesh_t;
-
-/* simulation parameters */
-typedef struct simulation_params_t {
-    /* thermal conductivity */
-    double c;
-    double delta_s;
-    /* time interval */
-    double delta_t;
-    /* max simulation time */
-    uint64_t max_t;
-} simulation_params_t;
-
-typedef struct simulation_t {
-    /* the meshes */
+/* the steady solver coarsens down to this many rows or columns, where the
+ * V-cycle runs MG_COARSEST_SWEEPS sweeps, and without tol stops at
+ * STEADY_TOL */
+#define MG_COARSEST 8
+#define MG_COARSEST_SWEEPS 16
+#define STEADY_TOL 1.0e-12
+
+/* the oblivious engine cuts the columns of a trapezoid only while it spans
+ * this many, so the rows of its leaves are long enough to vectorize and to
+ * pay for the recursion. 2 KiB of a row, a few of which fit any L1 */
+#define CO_MIN_COLS 256
+
+/* one step of the stencil over the inside of row nci, from row oci and its
+ * neighbours, which are pitch cells before and after it. ny is the row size */
+typedef void (*stencil_fn_t)(double *restrict nci, const double *restrict oci,
+                             uint64_t pitch, uint64_t ny, double cdtods2);
+
+/* the cells set by the constant heat source, by row: the cells of row i are
+ * col[row[i]] .. col[row[i + 1] - 1] */
+typedef struct source_t {
+    /* number of rows and of source cells */
+    uint64_t nx, ncells;
+    uint64_t *row;
+    uint64_t *col;
+    double *val;
+} source_t;
+
+/* a level of the multigrid V-cycle of the steady solver */
+typedef struct mg_level_t {
+    uint64_t nx, ny, pitch;
+    /* whether a cell keeps its value, by index into the cells of a mesh */
+    unsigned char *fixed;
+    /* correction, right hand side and residual of the level */
+    mesh_t *x, *b, *r;
+} mg_level_t;
+
+/* the background writer of the snapshots. the engine converts a mesh into
+ * frames[fill] and queues it as pending, the writer moves it to writing */
+typedef struct snapshot_t {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool started, done;
+    /* two gnuplot binary matrix frames of nframe floats */
+    float *frames[2];
+    size_t nframe;
+    /* frame to fill next, queued frame and frame being written, or -1 */
+    int fill, pending, writing;
+    /* step of the queued frame */
+    uint64_t step;
+    /* heat-live.bin and its map */
+    int live_fd;
+    float *live;
+} snapshot_t;
+
+struct simulation_t {
+    /* the meshes, step t is held by old_mesh when t is even and by new_mesh
+     * when it is odd */
     mesh_t *old_mesh, *new_mesh;
+    /* the heat source of the meshes */
+    source_t *source;
+    /* the snapshot writer while the simulation runs, NULL if none */
+    snapshot_t *snap;
     /* simulation parameters */
     simulation_params_t *params;
-} simulation_t;
+    /* the engine that advances the meshes */
+    engine_fn_t engine;
+    /* the stencil kernel of the engine and its KERNEL_* */
+    stencil_fn_t stencil;
+    int kernel;
+    /* number of steps run */
+    uint64_t t;
+    /* whether the engine computes the change of its last step, into
+     * res_linf and res_l2. res_linf is negative until a step is checked */
+    bool res_want;
+    double res_linf, res_l2;
+    bool converged;
+};
 
 /* static forward declarations */
 static int
 mesh_construct(mesh_t **new_mesh,
                int x /* number of rows */,
-               int y /* number of columns */);
+               int y /* number of columns */,
+               int nthreads /* threads of the first touch */);
 
 static int
 mesh_destruct(mesh_t *mesh);
 
 static int
-params_construct(simulation_params_t **params);
+set_initial_conds(mesh_t *sim);
 
 static int
-params_destruct(simulation_params_t *params);
+source_construct(source_t **new_source, uint64_t nx, uint64_t ny);
 
 static int
-set_initial_conds(mesh_t *sim);
+source_destruct(source_t *source);
+
+static void
+source_stamp(const source_t *src, mesh_t *mesh);
+
+static int
+snapshot_start(snapshot_t **new_snap, const mesh_t *mesh);
+
+static int
+snapshot_finish(snapshot_t *snap);
+
+static int
+run_serial(simulation_t *sim, uint64_t t0, uint64_t nsteps);
+
+static int
+run_blocked(simulation_t *sim, uint64_t t0, uint64_t nsteps);
+
+static int
+run_oblivious(simulation_t *sim, uint64_t t0, uint64_t nsteps);
+
+#ifdef _OPENMP
+static int
+run_threaded(simulation_t *sim, uint64_t t0, uint64_t nsteps);
+#endif
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
@@ -140,7 +222,7 @@ sim_param_cp(const simulation_params_t *from,
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
+int
 params_construct(simulation_params_t **params)
 {
     simulation_params_t *tmp = NULL;
@@ -154,7 +236,7 @@ params_construct(simulation_params_t **params)
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
+int
 params_destruct(simulation_params_t *params)
 {
     if (!params) return FAILURE_INVALID_ARG;
@@ -162,13 +244,30 @@ params_destruct(simulation_params_t *params)
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* row pitch for rows of y cells: whole cache lines, plus one more line when
+ * the rows would be a multiple of 4 KiB apart and the cells of a column
+ * would all map to the same cache sets */
+static uint64_t
+mesh_pitch(uint64_t y)
+{
+    uint64_t line = MESH_ALIGN / sizeof(double);
+    uint64_t pitch = (y + line - 1) / line * line;
+
+    if (0 == (pitch * sizeof(double)) % 4096) pitch += line;
+    return pitch;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 mesh_construct(mesh_t **new_mesh,
                int x /* number of rows */,
-               int y /* number of columns */)
+               int y /* number of columns */,
+               int nthreads /* threads of the first touch */)
 {
     mesh_t *tmp_mesh = NULL;
+    void *cells = NULL;
+    uint64_t pitch = mesh_pitch(y);
     int i;
 
     if (NULL == new_mesh) return FAILURE_INVALID_ARG;
@@ -179,63 +278,297 @@ mesh_construct(mesh_t **new_mesh,
         /* just bail */
         return FAILURE_OOR;
     }
-    tmp_mesh->cells = (double **)calloc(x, sizeof(double *));
-    if (NULL == tmp_mesh->cells) {
+    /* all rows in one block, so a sweep streams through memory */
+    if (0 != posix_memalign(&cells, MESH_ALIGN,
+                            (uint64_t)x * pitch * sizeof(double))) {
         fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-        goto error;
+        free(tmp_mesh);
+        return FAILURE_OOR;
     }
-    for (i = 0; i < y; ++i) {
-        tmp_mesh->cells[i] = (double *)calloc(y, sizeof(double));
-        if (NULL == tmp_mesh->cells[i]) {
-            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-            goto error;
-        }
+    /* zero the rows with the same static split over the threads as the
+     * threaded engine, so the pages of a row are first touched by, and
+     * placed on the NUMA node of, the thread that updates it */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(nthreads)
+#else
+    (void)nthreads;
+#endif
+    for (i = 0; i < x; ++i) {
+        (void)memset((double *)cells + (uint64_t)i * pitch, 0,
+                     pitch * sizeof(double));
     }
+    tmp_mesh->cells = (double *)cells;
     tmp_mesh->nx = x;
     tmp_mesh->ny = y;
+    tmp_mesh->pitch = pitch;
 
     *new_mesh = tmp_mesh;
     return SUCCESS;
-
-error:
-    if (NULL != tmp_mesh) free(tmp_mesh);
-    mesh_destruct(tmp_mesh);
-    return FAILURE_OOR;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 mesh_destruct(mesh_t *mesh)
 {
-    uint64_t i;
-
     if (!mesh) return FAILURE_INVALID_ARG;
-    if (mesh->cells) {
-        for (i = 0; i < mesh->ny; ++i) {
-            if (NULL != mesh->cells[i]) {
-                free(mesh->cells[i]);
-                mesh->cells[i] = NULL;
+    free(mesh->cells);
+    mesh->cells = NULL;
+    free(mesh);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* collects the cells that set_initial_conds sets on an nx x ny mesh. the
+ * source is stamped on a zeroed mesh, all of its values are non-zero */
+static int
+source_construct(source_t **new_source, uint64_t nx, uint64_t ny)
+{
+    source_t *tmp = NULL;
+    mesh_t *stamp = NULL;
+    uint64_t i, j, n = 0;
+    int rc = FAILURE;
+
+    if (NULL == new_source) return FAILURE_INVALID_ARG;
+
+    if (SUCCESS != (rc = mesh_construct(&stamp, nx, ny, 1))) return rc;
+    if (SUCCESS != (rc = set_initial_conds(stamp))) goto out;
+    for (i = 0; i < nx; ++i) {
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != MESH_ROW(stamp, i)[j]) ++n;
+        }
+    }
+    rc = FAILURE_OOR;
+    if (NULL == (tmp = (source_t *)calloc(1, sizeof(*tmp))) ||
+        NULL == (tmp->row = (uint64_t *)calloc(nx + 1, sizeof(uint64_t))) ||
+        NULL == (tmp->col = (uint64_t *)calloc(n + 1, sizeof(uint64_t))) ||
+        NULL == (tmp->val = (double *)calloc(n + 1, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        (void)source_destruct(tmp);
+        goto out;
+    }
+    tmp->nx = nx;
+    tmp->ncells = n;
+    for (n = 0, i = 0; i < nx; ++i) {
+        tmp->row[i] = n;
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != MESH_ROW(stamp, i)[j]) {
+                tmp->col[n] = j;
+                tmp->val[n] = MESH_ROW(stamp, i)[j];
+                ++n;
             }
         }
-        free(mesh->cells);
-        mesh->cells = NULL;
     }
-    free(mesh);
+    tmp->row[nx] = n;
+    *new_source = tmp;
+    rc = SUCCESS;
+out:
+    (void)mesh_destruct(stamp);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+source_destruct(source_t *source)
+{
+    if (!source) return FAILURE_INVALID_ARG;
+    free(source->row);
+    free(source->col);
+    free(source->val);
+    free(source);
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one step of the stencil for cells j0 .. j1 - 1 of row nci from row oci and
+ * its neighbours, which are pitch cells before and after it */
+static inline void
+stencil_cells(double *restrict nci, const double *restrict oci,
+              uint64_t pitch, uint64_t j0, uint64_t j1, double cdtods2)
+{
+    uint64_t j;
+
+    for (j = j0; j < j1; ++j) {
+        nci[j] = oci[j] + (cdtods2 * (oci[j + pitch] + oci[j - pitch] - 4.0 *
+                           oci[j] + oci[j + 1] + oci[j - 1]));
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the stencil over the inside of a row. nci and oci do not overlap, which
+ * the compiler can not see through the row pointers, so it gets restrict and
+ * a simd loop instead of a scalar one or a runtime overlap check */
+static void
+stencil_row_c(double *restrict nci, const double *restrict oci,
+              uint64_t pitch, uint64_t ny, double cdtods2)
+{
+    uint64_t j;
+
+#pragma omp simd
+    for (j = 1; j < ny - 1; ++j) {
+        nci[j] = oci[j] + (cdtods2 * (oci[j + pitch] + oci[j - pitch] - 4.0 *
+                           oci[j] + oci[j + 1] + oci[j - 1]));
+    }
+}
+
+#if HEATTX_X86
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the rows are MESH_ALIGN aligned, so after the first cells up to the next 32
+ * bytes the cell and the ones above and below it are aligned loads, and the
+ * ones to the left and right unaligned */
+__attribute__((target("avx2")))
+static void
+stencil_row_avx2(double *restrict nci, const double *restrict oci,
+                 uint64_t pitch, uint64_t ny, double cdtods2)
+{
+    const __m256d c = _mm256_set1_pd(cdtods2);
+    const __m256d four = _mm256_set1_pd(4.0);
+    uint64_t j = (ny - 1 < 4) ? ny - 1 : 4;
+    __m256d o, s;
+
+    stencil_cells(nci, oci, pitch, 1, j, cdtods2);
+    for (; j + 4 <= ny - 1; j += 4) {
+        o = _mm256_load_pd(oci + j);
+        s = _mm256_add_pd(_mm256_load_pd(oci + j + pitch),
+                          _mm256_load_pd(oci + j - pitch));
+        s = _mm256_sub_pd(s, _mm256_mul_pd(four, o));
+        s = _mm256_add_pd(s, _mm256_loadu_pd(oci + j + 1));
+        s = _mm256_add_pd(s, _mm256_loadu_pd(oci + j - 1));
+        _mm256_store_pd(nci + j, _mm256_add_pd(o, _mm256_mul_pd(c, s)));
+    }
+    stencil_cells(nci, oci, pitch, j, ny - 1, cdtods2);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* as stencil_row_avx2, 8 cells at a time */
+__attribute__((target("avx512f")))
+static void
+stencil_row_avx512(double *restrict nci, const double *restrict oci,
+                   uint64_t pitch, uint64_t ny, double cdtods2)
+{
+    const __m512d c = _mm512_set1_pd(cdtods2);
+    const __m512d four = _mm512_set1_pd(4.0);
+    uint64_t j = (ny - 1 < 8) ? ny - 1 : 8;
+    __m512d o, s;
+
+    stencil_cells(nci, oci, pitch, 1, j, cdtods2);
+    for (; j + 8 <= ny - 1; j += 8) {
+        o = _mm512_load_pd(oci + j);
+        s = _mm512_add_pd(_mm512_load_pd(oci + j + pitch),
+                          _mm512_load_pd(oci + j - pitch));
+        s = _mm512_sub_pd(s, _mm512_mul_pd(four, o));
+        s = _mm512_add_pd(s, _mm512_loadu_pd(oci + j + 1));
+        s = _mm512_add_pd(s, _mm512_loadu_pd(oci + j - 1));
+        _mm512_store_pd(nci + j, _mm512_add_pd(o, _mm512_mul_pd(c, s)));
+    }
+    stencil_cells(nci, oci, pitch, j, ny - 1, cdtods2);
+}
+#endif
+
+#if HEATTX_NEON
+/* ////////////////////////////////////////////////////////////////////////// */
+/* as stencil_row_avx2, 2 cells at a time */
+static void
+stencil_row_neon(double *restrict nci, const double *restrict oci,
+                 uint64_t pitch, uint64_t ny, double cdtods2)
+{
+    const float64x2_t c = vdupq_n_f64(cdtods2);
+    const float64x2_t four = vdupq_n_f64(4.0);
+    uint64_t j = 1;
+    float64x2_t o, s;
+
+    for (; j + 2 <= ny - 1; j += 2) {
+        o = vld1q_f64(oci + j);
+        s = vaddq_f64(vld1q_f64(oci + j + pitch), vld1q_f64(oci + j - pitch));
+        s = vsubq_f64(s, vmulq_f64(four, o));
+        s = vaddq_f64(s, vld1q_f64(oci + j + 1));
+        s = vaddq_f64(s, vld1q_f64(oci + j - 1));
+        vst1q_f64(nci + j, vaddq_f64(o, vmulq_f64(c, s)));
+    }
+    stencil_cells(nci, oci, pitch, j, ny - 1, cdtods2);
+}
+#endif
+
+/* the stencil kernels by KERNEL_*, NULL where not built */
+static const struct {
+    const char *name;
+    stencil_fn_t fn;
+} kernels[] = {
+    {"auto", NULL},
+    {"c", stencil_row_c},
+#if HEATTX_X86
+    {"avx2", stencil_row_avx2},
+    {"avx512", stencil_row_avx512},
+#else
+    {"avx2", NULL},
+    {"avx512", NULL},
+#endif
+#if HEATTX_NEON
+    {"neon", stencil_row_neon}
+#else
+    {"neon", NULL}
+#endif
+};
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* whether this CPU runs kernel */
+static bool
+kernel_supported(int kernel)
+{
+    if (kernel <= KERNEL_AUTO || kernel > KERNEL_NEON) return false;
+    if (NULL == kernels[kernel].fn) return false;
+#if HEATTX_X86
+    __builtin_cpu_init();
+    if (KERNEL_AVX2 == kernel) return __builtin_cpu_supports("avx2");
+    if (KERNEL_AVX512 == kernel) return __builtin_cpu_supports("avx512f");
+#endif
+    return true;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the kernel of params, for KERNEL_AUTO the widest one this CPU runs. -1 if
+ * the one asked for can not run here */
+static int
+select_kernel(const simulation_params_t *params)
+{
+    static const int widest[] = {KERNEL_AVX512, KERNEL_AVX2, KERNEL_NEON};
+    size_t k;
+
+    if (KERNEL_AUTO != params->kernel) {
+        return kernel_supported(params->kernel) ? params->kernel : -1;
+    }
+    for (k = 0; k < sizeof(widest) / sizeof(widest[0]); ++k) {
+        if (kernel_supported(widest[k])) return widest[k];
+    }
+    return KERNEL_C;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* number of threads of the threaded engine */
+static int
+sim_threads(const simulation_params_t *params)
+{
+#ifdef _OPENMP
+    return (params->threads > 0) ? params->threads : omp_get_max_threads();
+#else
+    (void)params;
+    return 1;
+#endif
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 gen_meshes(simulation_t *sim, uint64_t nx, uint64_t ny)
 {
     int rc = FAILURE;
 
-    if (SUCCESS != (rc = mesh_construct(&sim->old_mesh, nx, ny))) {
+    if (SUCCESS != (rc = mesh_construct(&sim->old_mesh, nx, ny,
+                                       sim_threads(sim->params)))) {
         fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
                 __LINE__);
         goto out;
     }
-    if (SUCCESS != (rc = mesh_construct(&sim->new_mesh, nx, ny))) {
+    if (SUCCESS != (rc = mesh_construct(&sim->new_mesh, nx, ny,
+                                       sim_threads(sim->params)))) {
         fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
                 __LINE__);
         goto out;
@@ -244,30 +577,67 @@ out:
     if (SUCCESS != rc) {
         mesh_destruct(sim->new_mesh);
         mesh_destruct(sim->old_mesh);
+        sim->new_mesh = sim->old_mesh = NULL;
     }
     return rc;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
+int
 simulation_destruct(simulation_t *sim)
 {
     if (!sim) return FAILURE_INVALID_ARG;
+    if (NULL != sim->snap) (void)snapshot_finish(sim->snap);
     (void)params_destruct(sim->params);
+    (void)source_destruct(sim->source);
     (void)mesh_destruct(sim->new_mesh);
     (void)mesh_destruct(sim->old_mesh);
     free(sim);
     return SUCCESS;
 }
+
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
+/* the engine selected by params, NULL if it is not available */
+static engine_fn_t
+select_engine(const simulation_params_t *params)
+{
+    switch (params->engine) {
+    case ENGINE_AUTO:
+        if (params->time_block > 1) return run_blocked;
+#ifdef _OPENMP
+        if (1 < sim_threads(params)) return run_threaded;
+#endif
+        return run_serial;
+    case ENGINE_SERIAL:
+        return run_serial;
+    case ENGINE_BLOCKED:
+        return run_blocked;
+    case ENGINE_OBLIVIOUS:
+        return run_oblivious;
+#ifdef _OPENMP
+    case ENGINE_THREADED:
+        return run_threaded;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
 simulation_construct(simulation_t **new_sim,
-               const simulation_params_t *params)
+                     const simulation_params_t *params)
 {
     simulation_t *sim = NULL;
     int rc = FAILURE;
 
     if (!new_sim || !params) return FAILURE_INVALID_ARG;
+    /* the source circle has a radius of min(nx, ny) / 4 and needs one cell
+     * inside it */
+    if (params->nx < 4 || params->ny < 4) {
+        fprintf(stderr, "mesh too small @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_INVALID_ARG;
+    }
 
     if (NULL == (sim = (simulation_t *)calloc(1, sizeof(*sim)))) {
         fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
@@ -283,51 +653,344 @@ simulation_construct(simulation_t **new_sim,
                 __LINE__, rc);
         goto out;
     }
-    if (SUCCESS != (rc = gen_meshes(sim, N, N))) {
+    if (SOLVER_TRANSIENT != params->solver &&
+        SOLVER_STEADY != params->solver) {
+        fprintf(stderr, "solver %d not available @ %s:%d\n", params->solver,
+                __FILE__, __LINE__);
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    if (params->tol > 0.0 && 0 == params->check_steps) {
+        fprintf(stderr, "tol needs check_steps @ %s:%d\n", __FILE__, __LINE__);
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    sim->res_linf = sim->res_l2 = -1.0;
+    if (0 > (sim->kernel = select_kernel(sim->params))) {
+        fprintf(stderr, "kernel %d not available @ %s:%d\n",
+                sim->params->kernel, __FILE__, __LINE__);
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    sim->stencil = kernels[sim->kernel].fn;
+    if (NULL == (sim->engine = select_engine(sim->params))) {
+        fprintf(stderr, "engine %d not available @ %s:%d\n",
+                sim->params->engine, __FILE__, __LINE__);
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    if (SUCCESS != (rc = gen_meshes(sim, params->nx, params->ny))) {
         fprintf(stderr, "gen_meshes failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         /* on failure, gen_meshes cleans up after itself */
         goto out;
     }
+    if (SUCCESS != (rc = source_construct(&sim->source, params->nx,
+                                          params->ny))) {
+        fprintf(stderr, "source_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
+    /* the initial conditions of step 0 */
+    source_stamp(sim->source, sim->old_mesh);
+    /* the writer runs for the life of the simulation, so the frames of
+     * separate simulation_step calls go through one queue */
+    if (params->snapshot_steps > 0 &&
+        SUCCESS != (rc = snapshot_start(&sim->snap, sim->old_mesh))) {
+        fprintf(stderr, "snapshot_start failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
     *new_sim = sim;
 out:
+    if (SUCCESS != rc) (void)simulation_destruct(sim);
     return rc;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
+int
 init_params(simulation_params_t *params,
-            int n,
+            int nx,
+            int ny,
             double c,
             int max_t)
 {
     if (NULL == params) return FAILURE_INVALID_ARG;
 
-    printf("o initializing simulation parameters...\n");
-
+    params->nx = nx;
+    params->ny = ny;
     params->c = c;
     params->max_t = max_t;
-    params->delta_s = 1.0 / (double)(n + 1);
+    params->solver = SOLVER_TRANSIENT;
+    params->engine = ENGINE_AUTO;
+    params->threads = 0;
+    params->kernel = KERNEL_AUTO;
+    params->time_block = 0;
+    params->snapshot_steps = 0;
+    params->dump_format = DUMP_TEXT;
+    params->tol = 0.0;
+    params->check_steps = 100;
+    /* the longer side spans the unit interval */
+    params->delta_s = 1.0 / (double)(((nx > ny) ? nx : ny) + 1);
     /* we know from theory that we have to obey the restriction:
      * delta_t <= (delta_s)^2/2c. so just make them equal.
      */
     params->delta_t = pow(params->delta_s, 2.0) / (4.0 * params->c);
 
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+print_params(const simulation_params_t *params)
+{
+    if (NULL == params) return FAILURE_INVALID_ARG;
+
+    printf("o initializing simulation parameters...\n");
+    printf(". nx: %"PRIu64"\n", params->nx);
+    printf(". ny: %"PRIu64"\n", params->ny);
     printf(". max_t: %"PRIu64"\n", params->max_t);
     printf(". c: %lf\n", params->c);
     printf(". delta_s: %lf\n", params->delta_s);
-    printf(". delta_t: %lf\n\n", params->delta_t);
+    printf(". delta_t: %lf\n", params->delta_t);
+    printf(". solver: %d\n", params->solver);
+    printf(". engine: %d\n", params->engine);
+    printf(". threads: %d\n", params->threads);
+    printf(". kernel: %s\n", (params->kernel >= KERNEL_AUTO &&
+                               params->kernel <= KERNEL_NEON) ?
+                              kernels[params->kernel].name : "?");
+    printf(". time_block: %"PRIu64"\n", params->time_block);
+    printf(". snapshot_steps: %"PRIu64"\n", params->snapshot_steps);
+    printf(". tol: %e\n", params->tol);
+    printf(". check_steps: %"PRIu64"\n\n", params->check_steps);
+
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* number of floats in a gnuplot binary matrix frame of mesh */
+static size_t
+frame_size(const mesh_t *mesh)
+{
+    return (size_t)(mesh->nx + 1) * (mesh->ny + 1);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* converts mesh to a gnuplot binary matrix: a row holding the number of
+ * columns and the column coordinates, then one row per mesh row holding its
+ * coordinate and its cells, all as floats */
+static void
+frame_fill(float *frame, const mesh_t *mesh)
+{
+    uint64_t i, j;
+    float *row = frame;
+    const double *cells;
+
+    row[0] = (float)mesh->ny;
+    for (j = 0; j < mesh->ny; ++j) row[j + 1] = (float)j;
+    for (i = 0; i < mesh->nx; ++i) {
+        row += mesh->ny + 1;
+        cells = MESH_ROW(mesh, i);
+        row[0] = (float)i;
+        for (j = 0; j < mesh->ny; ++j) row[j + 1] = (float)cells[j];
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+frame_write(const char *name, const float *frame, size_t n)
+{
+    FILE *fp = NULL;
+    int rc = SUCCESS;
+
+    if (NULL == (fp = fopen(name, "wb"))) {
+        fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_IO;
+    }
+    if (n != fwrite(frame, sizeof(float), n, fp)) {
+        fprintf(stderr, "fwrite failure @ %s:%d\n", __FILE__, __LINE__);
+        rc = FAILURE_IO;
+    }
+    fclose(fp);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the writer thread: takes the submitted frame, writes it to its own file and
+ * copies it into the live map, until snapshot_finish */
+static void *
+snapshot_writer(void *arg)
+{
+    snapshot_t *snap = (snapshot_t *)arg;
+    char name[64];
+    uint64_t step;
+    int buf;
+
+    pthread_mutex_lock(&snap->lock);
+    for (;;) {
+        while (snap->pending < 0 && !snap->done) {
+            pthread_cond_wait(&snap->cond, &snap->lock);
+        }
+        if (snap->pending < 0) break;
+        buf = snap->pending;
+        step = snap->step;
+        snap->pending = -1;
+        snap->writing = buf;
+        pthread_cond_broadcast(&snap->cond);
+        pthread_mutex_unlock(&snap->lock);
+
+        snprintf(name, sizeof(name), "heat-img-%06"PRIu64".bin", step);
+        (void)frame_write(name, snap->frames[buf], snap->nframe);
+        if (NULL != snap->live) {
+            (void)memcpy(snap->live, snap->frames[buf],
+                         snap->nframe * sizeof(float));
+        }
+
+        pthread_mutex_lock(&snap->lock);
+        snap->writing = -1;
+        pthread_cond_broadcast(&snap->cond);
+    }
+    pthread_mutex_unlock(&snap->lock);
+    return NULL;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* starts the writer of mesh sized frames, and maps heat-live.bin, which
+ * always holds the last frame written, for a viewer to follow */
+static int
+snapshot_start(snapshot_t **new_snap, const mesh_t *mesh)
+{
+    snapshot_t *snap = NULL;
+    size_t bytes;
+    void *live;
+
+    if (NULL == new_snap) return FAILURE_INVALID_ARG;
+
+    if (NULL == (snap = (snapshot_t *)calloc(1, sizeof(*snap)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    snap->nframe = frame_size(mesh);
+    bytes = snap->nframe * sizeof(float);
+    snap->frames[0] = (float *)malloc(bytes);
+    snap->frames[1] = (float *)malloc(bytes);
+    if (NULL == snap->frames[0] || NULL == snap->frames[1]) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        free(snap->frames[0]);
+        free(snap->frames[1]);
+        free(snap);
+        return FAILURE_OOR;
+    }
+    snap->pending = -1;
+    snap->writing = -1;
+    /* the run goes on without the live file if it can not be mapped */
+    snap->live_fd = open("heat-live.bin", O_RDWR | O_CREAT, 0644);
+    if (snap->live_fd >= 0 && 0 == ftruncate(snap->live_fd, bytes)) {
+        live = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    snap->live_fd, 0);
+        if (MAP_FAILED != live) snap->live = (float *)live;
+    }
+    pthread_mutex_init(&snap->lock, NULL);
+    pthread_cond_init(&snap->cond, NULL);
+    if (0 != pthread_create(&snap->thread, NULL, snapshot_writer, snap)) {
+        fprintf(stderr, "pthread_create failure @ %s:%d\n", __FILE__, __LINE__);
+        snap->done = true;
+        (void)snapshot_finish(snap);
+        return FAILURE;
+    }
+    snap->started = true;
+    *new_snap = snap;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* hands the state of mesh after step to the writer. the mesh is converted
+ * into the frame buffer the writer is not using, so the caller only waits
+ * when both frames are still queued or being written */
+static void
+snapshot_submit(snapshot_t *snap, const mesh_t *mesh, uint64_t step)
+{
+    pthread_mutex_lock(&snap->lock);
+    while (snap->writing == snap->fill || snap->pending == snap->fill) {
+        pthread_cond_wait(&snap->cond, &snap->lock);
+    }
+    pthread_mutex_unlock(&snap->lock);
+
+    frame_fill(snap->frames[snap->fill], mesh);
+
+    pthread_mutex_lock(&snap->lock);
+    while (snap->pending >= 0) {
+        pthread_cond_wait(&snap->cond, &snap->lock);
+    }
+    snap->pending = snap->fill;
+    snap->step = step;
+    snap->fill ^= 1;
+    pthread_cond_broadcast(&snap->cond);
+    pthread_mutex_unlock(&snap->lock);
+}
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* writes the frames still queued and stops the writer */
+static int
+snapshot_finish(snapshot_t *snap)
+{
+    if (!snap) return FAILURE_INVALID_ARG;
+    if (snap->started) {
+        pthread_mutex_lock(&snap->lock);
+        snap->done = true;
+        pthread_cond_broadcast(&snap->cond);
+        pthread_mutex_unlock(&snap->lock);
+        pthread_join(snap->thread, NULL);
+    }
+    pthread_cond_destroy(&snap->cond);
+    pthread_mutex_destroy(&snap->lock);
+    if (NULL != snap->live) munmap(snap->live, snap->nframe * sizeof(float));
+    if (snap->live_fd >= 0) close(snap->live_fd);
+    free(snap->frames[0]);
+    free(snap->frames[1]);
+    free(snap);
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* submits mesh to the writer when step is a snapshot step */
+static inline void
+snapshot_step(simulation_t *sim, const mesh_t *mesh, uint64_t step)
+{
+    if (NULL != sim->snap && 0 == step % sim->params->snapshot_steps) {
+        snapshot_submit(sim->snap, mesh, step);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* plot './heat-img.bin' binary matrix with image */
 static int
+dump_binary(const simulation_t *sim)
+{
+    float *frame = NULL;
+    int rc = FAILURE;
+
+    if (NULL == (frame = (float *)malloc(frame_size(sim->new_mesh) *
+                                         sizeof(float)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    frame_fill(frame, sim->new_mesh);
+    rc = frame_write("heat-img.bin", frame, frame_size(sim->new_mesh));
+    free(frame);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
 dump(const simulation_t *sim)
 {
     FILE *imgfp = NULL;
     uint64_t i, j;
 
+    if (NULL == sim) return FAILURE_INVALID_ARG;
+    if (DUMP_BINARY == sim->params->dump_format) return dump_binary(sim);
+
     if (NULL == (imgfp = fopen("heat-img.dat", "wb"))) {
         fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
         return FAILURE_IO;
@@ -335,7 +998,7 @@ dump(const simulation_t *sim)
     /* write the matrix */
     for (i = 0; i < sim->new_mesh->nx; ++i) {
         for (j = 0; j < sim->new_mesh->ny; ++j) {
-            fprintf(imgfp, "%lf%s", sim->new_mesh->cells[i][j],
+            fprintf(imgfp, "%lf%s", MESH_ROW(sim->new_mesh, i)[j],
                     (j == sim->new_mesh->ny - 1) ? "" : " ");
         }
         fprintf(imgfp, "\n");
@@ -346,120 +1009,841 @@ dump(const simulation_t *sim)
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* stamps the source cells of row i on row */
+static inline void
+source_row(const source_t *src, uint64_t i, double *row)
+{
+    uint64_t c;
+
+    for (c = src->row[i]; c < src->row[i + 1]; ++c) {
+        row[src->col[c]] = src->val[c];
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* row i of the next step: the stencil inside the mesh, then the source */
+static inline void
+step_row(stencil_fn_t stencil, const source_t *src, uint64_t i, uint64_t nx,
+         double *nci, const double *oci, uint64_t pitch, uint64_t ny,
+         double cdtods2)
+{
+    if (i > 0 && i < nx - 1) stencil(nci, oci, pitch, ny, cdtods2);
+    /* constant heat source */
+    source_row(src, i, nci);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* adds the change from oci to nci of a row, still in cache from step_row, to
+ * the largest change linf and the sum of the squares l2 */
+static inline void
+row_change(const double *nci, const double *oci, uint64_t ny, double *linf,
+           double *l2)
+{
+    double m = *linf, s = 0.0, d;
+    uint64_t j;
+
+    for (j = 0; j < ny; ++j) {
+        d = fabs(nci[j] - oci[j]);
+        m = (d > m) ? d : m;
+        s += d * d;
+    }
+    *linf = m;
+    *l2 += s;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* stamps the whole source on mesh, the same as set_initial_conds without
+ * walking the circle again */
+static void
+source_stamp(const source_t *src, mesh_t *mesh)
+{
+    uint64_t i;
+
+    for (i = 0; i < src->nx; ++i) {
+        if (src->row[i] != src->row[i + 1]) {
+            source_row(src, i, MESH_ROW(mesh, i));
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+source_apply(const simulation_t *sim, mesh_t *mesh)
+{
+    if (NULL == sim || NULL == mesh) return FAILURE_INVALID_ARG;
+    if (mesh->nx != sim->source->nx) return FAILURE_INVALID_ARG;
+    source_stamp(sim->source, mesh);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* advances the meshes time_block steps at a time along a wavefront over the
+ * rows, so a row is brought into cache once per block instead of once per
+ * step. row i of step s is updated at wavefront position i + s, after step
+ * s - 1 finished rows i - 1 .. i + 1 and before step s + 1 overwrites its
+ * input, so the two meshes end up holding the same steps as with the plain
+ * engine. the source is stamped on each row of a step right after the row is
+ * updated, as set_initial_conds would after the whole step */
 static int
-run_simulation(simulation_t *sim)
+run_blocked(simulation_t *sim, uint64_t t0, uint64_t nsteps)
+{
+    uint64_t t, p, s, i, k;
+    uint64_t nx = sim->old_mesh->nx;
+    uint64_t ny = sim->old_mesh->ny;
+    uint64_t pitch = sim->old_mesh->pitch;
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    uint64_t t_max = sim->params->max_t;
+    uint64_t t_end = t0 + nsteps;
+    /* a block of 0 steps would never advance */
+    uint64_t tb = (sim->params->time_block > 1) ? sim->params->time_block : 1;
+    const source_t *src = sim->source;
+    const stencil_fn_t stencil = sim->stencil;
+    /* step t is read from meshes[t % 2] and written to meshes[(t + 1) % 2] */
+    mesh_t *meshes[2] = {sim->old_mesh, sim->new_mesh};
+    double *nci;
+    const double *oci;
+    double linf = 0.0, l2 = 0.0;
+
+    for (t = t0; t < t_end; t += k) {
+        k = (t_end - t < tb) ? t_end - t : tb;
+        for (s = t; s < t + k; ++s) {
+            if (0 == s % 100) {
+                printf(". starting iteration %"PRIu64" of %"PRIu64"\n", s,
+                       t_max);
+            }
+        }
+        for (p = 0; p < nx + k - 1; ++p) {
+            for (s = 0; s < k && s <= p; ++s) {
+                i = p - s;
+                if (i >= nx) continue;
+                nci = MESH_ROW(meshes[(t + s + 1) % 2], i);
+                oci = MESH_ROW(meshes[(t + s) % 2], i);
+                step_row(stencil, src, i, nx, nci, oci, pitch, ny, cdtods2);
+                if (sim->res_want && t + s + 1 == t_end) {
+                    row_change(nci, oci, ny, &linf, &l2);
+                }
+            }
+        }
+        /* only the last step of a block is whole, snapshot the block that
+         * crosses a snapshot step */
+        if (NULL != sim->snap &&
+            (t + k) / sim->params->snapshot_steps !=
+            t / sim->params->snapshot_steps) {
+            snapshot_submit(sim->snap, meshes[(t + k) % 2], t + k);
+        }
+    }
+    if (sim->res_want) {
+        sim->res_linf = linf;
+        sim->res_l2 = sqrt(l2);
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the steps of run_oblivious, shared by its recursion */
+typedef struct co_walk_t {
+    /* step t is read from meshes[t % 2] and written to meshes[(t + 1) % 2] */
+    mesh_t *meshes[2];
+    const source_t *src;
+    stencil_fn_t stencil;
+    uint64_t ny, pitch;
+    double cdtods2;
+    /* the step whose change is wanted, -1 if none, and the change */
+    int64_t t_res;
+    double linf, l2;
+} co_walk_t;
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* cells j0 .. j1 - 1 of row i of step t + 1, then the source cells among
+ * them. the kernels of sim->stencil load the aligned rows from their start,
+ * so a part of a row goes to stencil_cells */
+static inline void
+co_row(co_walk_t *w, int64_t t, uint64_t i, uint64_t j0, uint64_t j1)
+{
+    double *nci = MESH_ROW(w->meshes[(t + 1) % 2], i);
+    const double *oci = MESH_ROW(w->meshes[t % 2], i);
+    const source_t *src = w->src;
+    uint64_t c;
+
+    if (1 == j0 && w->ny - 1 == j1) {
+        w->stencil(nci, oci, w->pitch, w->ny, w->cdtods2);
+    } else {
+        stencil_cells(nci, oci, w->pitch, j0, j1, w->cdtods2);
+    }
+    /* constant heat source */
+    for (c = src->row[i]; c < src->row[i + 1]; ++c) {
+        if (src->col[c] >= j0 && src->col[c] < j1) {
+            nci[src->col[c]] = src->val[c];
+        }
+    }
+    if (t == w->t_res) {
+        row_change(nci + j0, oci + j0, j1 - j0, &w->linf, &w->l2);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* steps t0 .. t1 - 1 of the trapezoid of rows x0 .. x1 - 1 and columns y0 ..
+ * y1 - 1 at t0, whose edges move by dx0, dx1, dy0 and dy1 cells per step, as
+ * in Frigo and Strumpen's cache-oblivious stencil. a trapezoid at least twice
+ * as wide as it is high is cut in two along a line of slope -1, the left one
+ * first as the right one depends on it, any other is cut in time. the pieces
+ * shrink until they fit whichever cache there is, without a block size. a
+ * cell of step t + 1 overwrites step t - 1, which every cell of step t next to
+ * it has read by then, so the two meshes are enough */
+static void
+co_walk(co_walk_t *w, int64_t t0, int64_t t1,
+        int64_t x0, int64_t dx0, int64_t x1, int64_t dx1,
+        int64_t y0, int64_t dy0, int64_t y1, int64_t dy1)
+{
+    int64_t dt = t1 - t0, t, i, m;
+
+    if (1 == dt) {
+        for (t = t0; t < t1; ++t) {
+            for (i = x0; i < x1 && y0 < y1; ++i) co_row(w, t, i, y0, y1);
+            x0 += dx0; x1 += dx1; y0 += dy0; y1 += dy1;
+        }
+    } else if (2 * (x1 - x0) + (dx1 - dx0) * dt >= 4 * dt) {
+        m = (2 * (x0 + x1) + (2 + dx0 + dx1) * dt) / 4;
+        co_walk(w, t0, t1, x0, dx0, m, -1, y0, dy0, y1, dy1);
+        co_walk(w, t0, t1, m, -1, x1, dx1, y0, dy0, y1, dy1);
+    } else if (y1 - y0 >= CO_MIN_COLS &&
+               2 * (y1 - y0) + (dy1 - dy0) * dt >= 4 * dt) {
+        m = (2 * (y0 + y1) + (2 + dy0 + dy1) * dt) / 4;
+        co_walk(w, t0, t1, x0, dx0, x1, dx1, y0, dy0, m, -1);
+        co_walk(w, t0, t1, x0, dx0, x1, dx1, m, -1, y1, dy1);
+    } else {
+        m = dt / 2;
+        co_walk(w, t0, t0 + m, x0, dx0, x1, dx1, y0, dy0, y1, dy1);
+        co_walk(w, t0 + m, t1, x0 + dx0 * m, dx0, x1 + dx1 * m, dx1,
+                y0 + dy0 * m, dy0, y1 + dy1 * m, dy1);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* advances the meshes by co_walk over the inside of the mesh, whose fixed
+ * edges are the sides of slope 0 of the first trapezoid. the run is cut at
+ * the snapshot steps, so their frames are whole. the source is stamped on
+ * each part of a row right after it is updated, and once on the mesh of step
+ * t0 + 1 for the source cells the stencil never reaches */
+static int
+run_oblivious(simulation_t *sim, uint64_t t0, uint64_t nsteps)
+{
+    uint64_t t, s, k;
+    uint64_t nx = sim->old_mesh->nx;
+    uint64_t t_max = sim->params->max_t;
+    uint64_t t_end = t0 + nsteps;
+    uint64_t snap = sim->params->snapshot_steps;
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    co_walk_t w;
+
+    w.meshes[0] = sim->old_mesh;
+    w.meshes[1] = sim->new_mesh;
+    w.src = sim->source;
+    w.stencil = sim->stencil;
+    w.ny = sim->old_mesh->ny;
+    w.pitch = sim->old_mesh->pitch;
+    w.cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    w.t_res = (sim->res_want && nsteps > 0) ? (int64_t)(t_end - 1) : -1;
+    w.linf = w.l2 = 0.0;
+
+    source_stamp(w.src, w.meshes[(t0 + 1) % 2]);
+    for (t = t0; t < t_end; t += k) {
+        k = t_end - t;
+        if (NULL != sim->snap && snap - t % snap < k) k = snap - t % snap;
+        for (s = t; s < t + k; ++s) {
+            if (0 == s % 100) {
+                printf(". starting iteration %"PRIu64" of %"PRIu64"\n", s,
+                       t_max);
+            }
+        }
+        co_walk(&w, t, t + k, 1, 0, nx - 1, 0, 1, 0, w.ny - 1, 0);
+        snapshot_step(sim, w.meshes[(t + k) % 2], t + k);
+    }
+    if (sim->res_want) {
+        sim->res_linf = w.linf;
+        sim->res_l2 = sqrt(w.l2);
+    }
+    return SUCCESS;
+}
+
+#ifdef _OPENMP
+/* ////////////////////////////////////////////////////////////////////////// */
+/* splits the rows of every step over the threads of one parallel region. each
+ * thread stamps the source on its own rows of the step and swaps its own copy
+ * of the mesh pointers, so the barrier at the end of the row loop is the only
+ * synchronization per step */
+static int
+run_threaded(simulation_t *sim, uint64_t t0, uint64_t nsteps)
 {
-    int rc = FAILURE;
-    uint64_t t, i, j;
     uint64_t nx = sim->old_mesh->nx;
     uint64_t ny = sim->old_mesh->ny;
+    uint64_t pitch = sim->old_mesh->pitch;
     double ds2 = sim->params->delta_s * sim->params->delta_s;
     double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
     uint64_t t_max = sim->params->max_t;
-    mesh_t *new_mesh = sim->new_mesh;
-    mesh_t *old_mesh = sim->old_mesh;
-    double *nci, *oci, *ocip, *ocin;
+    const source_t *src = sim->source;
+    const stencil_fn_t stencil = sim->stencil;
+    /* the change of the last step, reduced over the threads */
+    double linf = 0.0, l2 = 0.0;
 
-    printf("o starting simulation...\n");
-    for (t = 0; t < t_max; ++t) {
+#pragma omp parallel num_threads(sim_threads(sim->params))
+    {
+        mesh_t *new_mesh = simulation_mesh(sim, t0 + 1);
+        mesh_t *old_mesh = simulation_mesh(sim, t0);
+        mesh_t *tmp_meshp;
+        uint64_t t, i;
+        double *nci;
+
+        for (t = t0; t < t0 + nsteps; ++t) {
+#pragma omp master
+            if (0 == t % 100) {
+                printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t,
+                       t_max);
+            }
+            /* all rows, as in mesh_construct, for the same split */
+            if (sim->res_want && t + 1 == t0 + nsteps) {
+#pragma omp for schedule(static) reduction(max:linf) reduction(+:l2)
+                for (i = 0; i < nx; ++i) {
+                    nci = MESH_ROW(new_mesh, i);
+                    step_row(stencil, src, i, nx, nci, MESH_ROW(old_mesh, i),
+                             pitch, ny, cdtods2);
+                    row_change(nci, MESH_ROW(old_mesh, i), ny, &linf, &l2);
+                }
+            } else {
+#pragma omp for schedule(static)
+                for (i = 0; i < nx; ++i) {
+                    step_row(stencil, src, i, nx, MESH_ROW(new_mesh, i),
+                             MESH_ROW(old_mesh, i), pitch, ny, cdtods2);
+                }
+            }
+            /* swap the mesh pointers */
+            tmp_meshp = old_mesh; old_mesh = new_mesh; new_mesh = tmp_meshp;
+            /* the next step only reads old_mesh, and the barrier after it
+             * waits for the copy */
+#pragma omp master
+            snapshot_step(sim, old_mesh, t + 1);
+        }
+    }
+    if (sim->res_want) {
+        sim->res_linf = linf;
+        sim->res_l2 = sqrt(l2);
+    }
+    return SUCCESS;
+}
+#endif
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+run_serial(simulation_t *sim, uint64_t t0, uint64_t nsteps)
+{
+    uint64_t t, i;
+    uint64_t nx = sim->old_mesh->nx;
+    uint64_t ny = sim->old_mesh->ny;
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    uint64_t t_max = sim->params->max_t;
+    mesh_t *new_mesh = simulation_mesh(sim, t0 + 1);
+    mesh_t *old_mesh = simulation_mesh(sim, t0);
+    /* the step whose change is wanted, fused into its sweep */
+    uint64_t t_res = sim->res_want ? t0 + nsteps - 1 : UINT64_MAX;
+    double linf = 0.0, l2 = 0.0;
+
+    for (t = t0; t < t0 + nsteps; ++t) {
         if (0 == t % 100) {
-            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t, t_max); 
-        }
-        for (i = 1; i < nx - 1; ++i) {
-            nci =  new_mesh->cells[i];
-            oci =  old_mesh->cells[i];
-            ocip = old_mesh->cells[i - 1];
-            ocin = old_mesh->cells[i + 1];
-            for (j = 1; j < ny - 1; ++j) {
-                nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
-                                   oci[j] + oci[j + 1] + oci[j - 1]));
+            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t, t_max);
+        }
+        if (t == t_res) {
+            for (i = 0; i < nx; ++i) {
+                step_row(sim->stencil, sim->source, i, nx,
+                         MESH_ROW(new_mesh, i), MESH_ROW(old_mesh, i),
+                         old_mesh->pitch, ny, cdtods2);
+                row_change(MESH_ROW(new_mesh, i), MESH_ROW(old_mesh, i), ny,
+                           &linf, &l2);
+            }
+            sim->res_linf = linf;
+            sim->res_l2 = sqrt(l2);
+        } else {
+            for (i = 1; i < nx - 1; ++i) {
+                sim->stencil(MESH_ROW(new_mesh, i), MESH_ROW(old_mesh, i),
+                             old_mesh->pitch, ny, cdtods2);
             }
+            /* constant heat source */
+            source_stamp(sim->source, new_mesh);
         }
         /* swap the mesh pointers */
         mesh_t *tmp_meshp = old_mesh; old_mesh = new_mesh; new_mesh = tmp_meshp;
-        /* constant heat source */
-        if (SUCCESS != (rc = set_initial_conds(old_mesh))) return rc;
+        snapshot_step(sim, old_mesh, t + 1);
     }
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the steady solver. the steady state has 4 u - (the four neighbours of u) =
+ * 0, A u = 0, in every cell but the edges and the source, which keep their
+ * values. it is solved for by conjugate gradients preconditioned with a
+ * multigrid V-cycle in the manner of HPCG's ComputeMG: a symmetric
+ * Gauss-Seidel sweep, the correction from the next coarser level, which
+ * keeps every other row and column, and another sweep. the cells that keep
+ * their values are zero in every vector but u */
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-set_initial_conds(mesh_t *mesh)
+mg_levels_destruct(mg_level_t *levels, int nlevels)
 {
-    if (NULL == mesh) return FAILURE_INVALID_ARG;
+    int k;
 
-    int x0 = mesh->nx / 2;
-    int y0 = mesh->ny / 2;
-    int x = mesh->nx / 4, y = 0;
-    int radius_err = 1 - x;
+    if (NULL == levels) return FAILURE_INVALID_ARG;
+    for (k = 0; k < nlevels; ++k) {
+        free(levels[k].fixed);
+        if (NULL != levels[k].x) (void)mesh_destruct(levels[k].x);
+        if (NULL != levels[k].b) (void)mesh_destruct(levels[k].b);
+        if (NULL != levels[k].r) (void)mesh_destruct(levels[k].r);
+    }
+    free(levels);
+    return SUCCESS;
+}
 
-    while (x >= y) {
-        mesh->cells[ x + x0][ y + y0] = K * .50;
-        mesh->cells[ y + x0][ x + y0] = K * .60;
-        mesh->cells[-x + x0][ y + y0] = K * .70;
-        mesh->cells[-y + x0][ x + y0] = K * .80;
-        mesh->cells[-x + x0][-y + y0] = K * .70;
-        mesh->cells[-y + x0][-x + y0] = K * .60;
-        mesh->cells[ x + x0][-y + y0] = K * .50;
-        mesh->cells[ y + x0][-x + y0] = K;
-        y++;
-        if (radius_err < 0) radius_err += 2 * y + 1;
-        else {
-            --x;
-            radius_err += 2 * (y - x + 1);
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the levels of an nx x ny mesh with source src, down to one of at most
+ * MG_COARSEST rows or columns. a coarse cell keeps its value if the fine cell
+ * it was taken from or one next to it does, so the source stays a closed
+ * ring on every level */
+static int
+mg_levels_construct(mg_level_t **new_levels, int *nlevels,
+                    const source_t *src, uint64_t nx, uint64_t ny)
+{
+    mg_level_t *levels = NULL, *l, *f;
+    uint64_t lnx = nx, lny = ny, i, j, c;
+    int n = 1, k, rc = FAILURE_OOR;
+
+    if (NULL == new_levels || NULL == nlevels) return FAILURE_INVALID_ARG;
+    while (lnx > MG_COARSEST && lny > MG_COARSEST) {
+        lnx = (lnx - 1) / 2 + 1;
+        lny = (lny - 1) / 2 + 1;
+        ++n;
+    }
+    if (NULL == (levels = (mg_level_t *)calloc(n, sizeof(*levels)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    for (k = 0; k < n; ++k) {
+        l = levels + k;
+        l->nx = (0 == k) ? nx : (levels[k - 1].nx - 1) / 2 + 1;
+        l->ny = (0 == k) ? ny : (levels[k - 1].ny - 1) / 2 + 1;
+        if (SUCCESS != (rc = mesh_construct(&l->x, l->nx, l->ny, 1)) ||
+            SUCCESS != (rc = mesh_construct(&l->b, l->nx, l->ny, 1)) ||
+            SUCCESS != (rc = mesh_construct(&l->r, l->nx, l->ny, 1))) {
+            goto out;
+        }
+        l->pitch = l->x->pitch;
+        if (NULL == (l->fixed = (unsigned char *)calloc(l->nx * l->pitch,
+                                                        1))) {
+            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+            rc = FAILURE_OOR;
+            goto out;
+        }
+        for (i = 0; i < l->nx; ++i) {
+            for (j = 0; j < l->ny; ++j) {
+                if (0 == i || l->nx - 1 == i || 0 == j || l->ny - 1 == j) {
+                    l->fixed[i * l->pitch + j] = 1;
+                }
+            }
+        }
+        if (0 == k) {
+            for (i = 0; i < nx; ++i) {
+                for (c = src->row[i]; c < src->row[i + 1]; ++c) {
+                    l->fixed[i * l->pitch + src->col[c]] = 1;
+                }
+            }
+            continue;
+        }
+        f = l - 1;
+        for (i = 1; i < l->nx - 1; ++i) {
+            for (j = 1; j < l->ny - 1; ++j) {
+                c = 2 * i * f->pitch + 2 * j;
+                l->fixed[i * l->pitch + j] =
+                    f->fixed[c] | f->fixed[c - 1] | f->fixed[c + 1] |
+                    f->fixed[c - f->pitch] | f->fixed[c + f->pitch];
+            }
         }
     }
-    return SUCCESS;
+    *new_levels = levels;
+    *nlevels = n;
+    rc = SUCCESS;
+out:
+    if (SUCCESS != rc) (void)mg_levels_destruct(levels, n);
+    return rc;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-int
-main(void)
+/* y = A x on level l */
+static void
+mg_apply(const mg_level_t *l, const mesh_t *x, mesh_t *y)
 {
-    int rc = FAILURE;
-    int erc = EXIT_FAILURE;
-    simulation_params_t *params = NULL;
-    simulation_t *sim = NULL;
+    uint64_t i, j;
+    const double *xi;
+    double *yi;
 
-    /* print application banner */
-    printf("o %s %s\n", app_name, app_ver);
+    for (i = 1; i < l->nx - 1; ++i) {
+        xi = MESH_ROW(x, i);
+        yi = MESH_ROW(y, i);
+        for (j = 1; j < l->ny - 1; ++j) {
+            yi[j] = l->fixed[i * l->pitch + j] ? 0.0 :
+                    4.0 * xi[j] - xi[j - 1] - xi[j + 1] - xi[j - l->pitch] -
+                    xi[j + l->pitch];
+        }
+    }
+}
 
-    if (SUCCESS != (rc = params_construct(&params))) {
-        fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
-                __LINE__, rc);
-        goto cleanup;
+/* ////////////////////////////////////////////////////////////////////////// */
+/* a symmetric Gauss-Seidel sweep of A x = b on level l, forward and back */
+static void
+mg_symgs(const mg_level_t *l)
+{
+    uint64_t i, j, p = l->pitch;
+    double *x = l->x->cells;
+    const double *b = l->b->cells;
+
+    for (i = 1; i < l->nx - 1; ++i) {
+        for (j = i * p + 1; j < i * p + l->ny - 1; ++j) {
+            if (l->fixed[j]) continue;
+            x[j] = 0.25 * (b[j] + x[j - 1] + x[j + 1] + x[j - p] + x[j + p]);
+        }
     }
-    if (SUCCESS != (rc = init_params(params, N, THERM_COND, T_MAX))) {
-        fprintf(stderr, "init_params failure @ %s:%d: rc = %d\n", __FILE__,
-                __LINE__, rc);
-        goto cleanup;
+    for (i = l->nx - 2; i > 0; --i) {
+        for (j = i * p + l->ny - 2; j > i * p; --j) {
+            if (l->fixed[j]) continue;
+            x[j] = 0.25 * (b[j] + x[j - 1] + x[j + 1] + x[j - p] + x[j + p]);
+        }
     }
-    if (SUCCESS != (rc = simulation_construct(&sim, params))) {
-        fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
-                __FILE__, __LINE__, rc);
-        goto cleanup;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* x of level k from its b by a V-cycle down from k. the residual goes to the
+ * coarse level by full weighting and the correction comes back by bilinear
+ * interpolation, the transpose of it, so the V-cycle stays symmetric */
+static void
+mg_vcycle(mg_level_t *levels, int nlevels, int k)
+{
+    static const double w[3] = {0.5, 1.0, 0.5};
+    mg_level_t *l = levels + k, *c = levels + k + 1;
+    uint64_t i, j, f;
+    int64_t p = (int64_t)l->pitch;
+    double *x = l->x->cells, *r = l->r->cells, v;
+    int s, di, dj;
+
+    (void)memset(x, 0, l->nx * p * sizeof(double));
+    if (nlevels - 1 == k) {
+        for (s = 0; s < MG_COARSEST_SWEEPS; ++s) mg_symgs(l);
+        return;
     }
-    if (SUCCESS != (rc = set_initial_conds(sim->old_mesh))) {
-        fprintf(stderr, "set_initial_conds failure @ %s:%d: rc = %d\n",
-                __FILE__, __LINE__, rc);
-        goto cleanup;
+    mg_symgs(l);
+    mg_apply(l, l->x, l->r);
+    for (f = 0; f < l->nx * p; ++f) {
+        r[f] = l->fixed[f] ? 0.0 : l->b->cells[f] - r[f];
     }
-    if (SUCCESS != (rc = run_simulation(sim))) {
-        fprintf(stderr, "run_simulation failure @ %s:%d: rc = %d\n",
-                __FILE__, __LINE__, rc);
-        goto cleanup;
+    for (i = 1; i < c->nx - 1; ++i) {
+        for (j = 1; j < c->ny - 1; ++j) {
+            v = 0.0;
+            if (!c->fixed[i * c->pitch + j]) {
+                f = 2 * i * p + 2 * j;
+                for (di = -1; di <= 1; ++di) {
+                    for (dj = -1; dj <= 1; ++dj) {
+                        v += w[di + 1] * w[dj + 1] * r[f + di * p + dj];
+                    }
+                }
+            }
+            MESH_ROW(c->b, i)[j] = v;
+        }
+    }
+    mg_vcycle(levels, nlevels, k + 1);
+    for (i = 1; i < c->nx - 1; ++i) {
+        for (j = 1; j < c->ny - 1; ++j) {
+            v = MESH_ROW(c->x, i)[j];
+            f = 2 * i * p + 2 * j;
+            for (di = -1; di <= 1; ++di) {
+                for (dj = -1; dj <= 1; ++dj) {
+                    if (!l->fixed[f + di * p + dj]) {
+                        x[f + di * p + dj] += w[di + 1] * w[dj + 1] * v;
+                    }
+                }
+            }
+        }
+    }
+    mg_symgs(l);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* dot product of the inside of the nx x ny meshes a and b */
+static double
+mg_dot(const mesh_t *a, const mesh_t *b)
+{
+    uint64_t i, j;
+    double d = 0.0;
+
+    for (i = 1; i < a->nx - 1; ++i) {
+        for (j = 1; j < a->ny - 1; ++j) {
+            d += MESH_ROW(a, i)[j] * MESH_ROW(b, i)[j];
+        }
+    }
+    return d;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the largest and the L2 norm of the change a step would make from the
+ * residual r of A u = 0, as the engines compute it */
+static void
+mg_change(const mesh_t *r, double cdtods2, double *linf, double *l2)
+{
+    uint64_t i, j;
+    double m = 0.0, s = 0.0, v;
+
+    for (i = 1; i < r->nx - 1; ++i) {
+        for (j = 1; j < r->ny - 1; ++j) {
+            v = fabs(MESH_ROW(r, i)[j]);
+            if (v > m) m = v;
+            s += v * v;
+        }
     }
-    if (SUCCESS != dump(sim)) {
-        fprintf(stderr, "dump failure @ %s:%d: rc = %d\n",
+    *linf = cdtods2 * m;
+    *l2 = cdtods2 * sqrt(s);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* solves for the steady state from the current one in at most max_t
+ * iterations, until a step would change no cell by tol or more. both meshes
+ * get the result and t counts the iterations */
+static int
+run_steady(simulation_t *sim)
+{
+    const simulation_params_t *params = sim->params;
+    double cdtods2 = (params->c * params->delta_t) /
+                     (params->delta_s * params->delta_s);
+    double tol = (params->tol > 0.0) ? params->tol : STEADY_TOL;
+    mesh_t *u = simulation_mesh(sim, sim->t);
+    mesh_t *p = NULL, *q = NULL, *r, *z;
+    mg_level_t *levels = NULL;
+    int nlevels = 0, rc = FAILURE;
+    uint64_t it, i, j;
+    double rz, rz_new, alpha;
+
+    if (SUCCESS != (rc = mg_levels_construct(&levels, &nlevels, sim->source,
+                                             u->nx, u->ny)) ||
+        SUCCESS != (rc = mesh_construct(&p, u->nx, u->ny, 1)) ||
+        SUCCESS != (rc = mesh_construct(&q, u->nx, u->ny, 1))) {
+        fprintf(stderr, "steady solver setup failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
-        goto cleanup;
+        goto out;
+    }
+    printf(". multigrid levels: %d\n", nlevels);
+    /* the residual of level 0 is its b, the preconditioned one its x */
+    r = levels[0].b;
+    z = levels[0].x;
+    mg_apply(levels, u, q);
+    for (i = 1; i < u->nx - 1; ++i) {
+        for (j = 1; j < u->ny - 1; ++j) {
+            MESH_ROW(r, i)[j] = -MESH_ROW(q, i)[j];
+        }
+    }
+    mg_change(r, cdtods2, &sim->res_linf, &sim->res_l2);
+    sim->converged = sim->res_linf < tol;
+    mg_vcycle(levels, nlevels, 0);
+    (void)memcpy(p->cells, z->cells, u->nx * u->pitch * sizeof(double));
+    rz = mg_dot(r, z);
+    for (it = 0; it < params->max_t && !sim->converged; ++it) {
+        mg_apply(levels, p, q);
+        alpha = rz / mg_dot(p, q);
+        for (i = 1; i < u->nx - 1; ++i) {
+            for (j = 1; j < u->ny - 1; ++j) {
+                MESH_ROW(u, i)[j] += alpha * MESH_ROW(p, i)[j];
+                MESH_ROW(r, i)[j] -= alpha * MESH_ROW(q, i)[j];
+            }
+        }
+        mg_change(r, cdtods2, &sim->res_linf, &sim->res_l2);
+        printf(". change of iteration %"PRIu64": max %e, l2 %e\n", it + 1,
+               sim->res_linf, sim->res_l2);
+        sim->converged = sim->res_linf < tol;
+        mg_vcycle(levels, nlevels, 0);
+        rz_new = mg_dot(r, z);
+        for (i = 1; i < u->nx - 1; ++i) {
+            for (j = 1; j < u->ny - 1; ++j) {
+                MESH_ROW(p, i)[j] = MESH_ROW(z, i)[j] +
+                                    (rz_new / rz) * MESH_ROW(p, i)[j];
+            }
+        }
+        rz = rz_new;
+    }
+    sim->t += it;
+    /* the result in both meshes, for dump and simulation_mesh */
+    (void)memcpy(((u == sim->old_mesh) ? sim->new_mesh : sim->old_mesh)->cells,
+                 u->cells, u->nx * u->pitch * sizeof(double));
+    rc = SUCCESS;
+out:
+    if (NULL != q) (void)mesh_destruct(q);
+    if (NULL != p) (void)mesh_destruct(p);
+    if (NULL != levels) (void)mg_levels_destruct(levels, nlevels);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* without tol all nsteps go to the engine at once, with it the engine runs up
+ * to the next multiple of check_steps and computes the change of that step */
+int
+simulation_step(simulation_t *sim, uint64_t nsteps)
+{
+    const simulation_params_t *params = NULL;
+    uint64_t n;
+    int rc = FAILURE;
+
+    if (NULL == sim) return FAILURE_INVALID_ARG;
+    params = sim->params;
+    while (nsteps > 0 && !sim->converged) {
+        n = nsteps;
+        if (params->tol > 0.0) {
+            n = params->check_steps - sim->t % params->check_steps;
+            if (n > nsteps) n = nsteps;
+        }
+        sim->res_want = params->tol > 0.0 &&
+                        0 == (sim->t + n) % params->check_steps;
+        /* an engine of another library leaves it negative */
+        if (sim->res_want) sim->res_linf = -1.0;
+        rc = sim->engine(sim, sim->t, n);
+        sim->res_want = false;
+        if (SUCCESS != rc) {
+            fprintf(stderr, "engine failure @ %s:%d: rc = %d\n", __FILE__,
+                    __LINE__, rc);
+            return rc;
+        }
+        sim->t += n;
+        nsteps -= n;
+        if (params->tol > 0.0 && 0 == sim->t % params->check_steps &&
+            sim->res_linf >= 0.0) {
+            printf(". change of step %"PRIu64": max %e, l2 %e\n", sim->t,
+                   sim->res_linf, sim->res_l2);
+            sim->converged = sim->res_linf < params->tol;
+        }
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+bool
+simulation_converged(const simulation_t *sim)
+{
+    return sim->converged;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+simulation_residual(const simulation_t *sim, double *linf, double *l2)
+{
+    if (NULL == sim || sim->res_linf < 0.0) return FAILURE;
+    if (NULL != linf) *linf = sim->res_linf;
+    if (NULL != l2) *l2 = sim->res_l2;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+run_simulation(simulation_t *sim)
+{
+    int rc = FAILURE;
+
+    if (NULL == sim) return FAILURE_INVALID_ARG;
+
+    if (SOLVER_STEADY == sim->params->solver) {
+        printf("o starting steady solve...\n");
+        if (SUCCESS != (rc = run_steady(sim))) return rc;
+        printf("o %s after %"PRIu64" iterations\n",
+               sim->converged ? "converged" : "not converged", sim->t);
+        return SUCCESS;
+    }
+#ifdef _OPENMP
+    if (run_threaded == sim->engine) {
+        printf("o starting simulation on %d threads, %s kernel...\n",
+               sim_threads(sim->params), kernels[sim->kernel].name);
+    } else {
+        printf("o starting simulation, %s kernel...\n",
+               kernels[sim->kernel].name);
+    }
+#else
+    printf("o starting simulation, %s kernel...\n", kernels[sim->kernel].name);
+#endif
+    if (sim->t >= sim->params->max_t) return SUCCESS;
+    if (SUCCESS != (rc = simulation_step(sim, sim->params->max_t - sim->t))) {
+        return rc;
+    }
+    if (sim->converged) {
+        printf("o converged after %"PRIu64" steps\n", sim->t);
     }
-    /* all is well */
-    erc = EXIT_SUCCESS;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+uint64_t
+simulation_time(const simulation_t *sim)
+{
+    return sim->t;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+mesh_t *
+simulation_mesh(const simulation_t *sim, uint64_t t)
+{
+    return (t % 2) ? sim->new_mesh : sim->old_mesh;
+}
 
-cleanup:
-    (void)simulation_destruct(sim);
-    (void)params_destruct(params);
-    return erc;
+/* ////////////////////////////////////////////////////////////////////////// */
+const char *
+simulation_kernel(const simulation_t *sim)
+{
+    return kernels[sim->kernel].name;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+const simulation_params_t *
+simulation_params(const simulation_t *sim)
+{
+    return sim->params;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* NULL goes back to the engine selected by the parameters */
+int
+simulation_set_engine(simulation_t *sim, engine_fn_t engine)
+{
+    if (NULL == sim) return FAILURE_INVALID_ARG;
+    sim->engine = (NULL != engine) ? engine : select_engine(sim->params);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+set_initial_conds(mesh_t *mesh)
+{
+    if (NULL == mesh) return FAILURE_INVALID_ARG;
+
+    int x0 = mesh->nx / 2;
+    int y0 = mesh->ny / 2;
+    int x = ((mesh->nx < mesh->ny) ? mesh->nx : mesh->ny) / 4, y = 0;
+    int radius_err = 1 - x;
+
+    while (x >= y) {
+        MESH_ROW(mesh,  x + x0)[ y + y0] = K * .50;
+        MESH_ROW(mesh,  y + x0)[ x + y0] = K * .60;
+        MESH_ROW(mesh, -x + x0)[ y + y0] = K * .70;
+        MESH_ROW(mesh, -y + x0)[ x + y0] = K * .80;
+        MESH_ROW(mesh, -x + x0)[-y + y0] = K * .70;
+        MESH_ROW(mesh, -y + x0)[-x + y0] = K * .60;
+        MESH_ROW(mesh,  x + x0)[-y + y0] = K * .50;
+        MESH_ROW(mesh,  y + x0)[-x + y0] = K;
+        y++;
+        if (radius_err < 0) radius_err += 2 * y + 1;
+        else {
+            --x;
+            radius_err += 2 * (y - x + 1);
+        }
+    }
+    return SUCCESS;
 }
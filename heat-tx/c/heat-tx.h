@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* libheattx: the 2D heat transfer simulation of heat-tx as a library. a
+ * simulation is constructed from a set of parameters, then advanced either
+ * all the way with run_simulation or a few steps at a time with
+ * simulation_step, and its mesh read in between. */
+
+#ifndef HEAT_TX_H_INCLUDED
+#define HEAT_TX_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* return codes */
+enum {
+    SUCCESS = 0,
+    FAILURE,
+    FAILURE_OOR,
+    FAILURE_IO,
+    FAILURE_INVALID_ARG
+};
+
+/* what run_simulation solves for */
+enum {
+    /* max_t time steps, or until tol */
+    SOLVER_TRANSIENT = 0,
+    /* the steady state, by conjugate gradients preconditioned with a
+     * multigrid V-cycle, in at most max_t iterations */
+    SOLVER_STEADY
+};
+
+/* engines that advance the meshes */
+enum {
+    /* blocked if time_block > 1, else threaded if built with OpenMP and
+     * running more than one thread, else serial */
+    ENGINE_AUTO = 0,
+    /* one sweep over the mesh per step */
+    ENGINE_SERIAL,
+    /* time_block steps per sweep along a wavefront over the rows */
+    ENGINE_BLOCKED,
+    /* the rows of each step split over OpenMP threads */
+    ENGINE_THREADED,
+    /* a cache-oblivious recursive cut of space-time into trapezoids */
+    ENGINE_OBLIVIOUS
+};
+
+/* stencil kernels */
+enum {
+    /* the widest one the CPU runs */
+    KERNEL_AUTO = 0,
+    /* restrict and omp simd, for the compiler to vectorize */
+    KERNEL_C,
+    /* x86 intrinsics */
+    KERNEL_AVX2,
+    KERNEL_AVX512,
+    /* aarch64 intrinsics */
+    KERNEL_NEON
+};
+
+/* formats of dump */
+enum {
+    /* gnuplot text matrix, heat-img.dat */
+    DUMP_TEXT = 0,
+    /* gnuplot binary matrix of floats, heat-img.bin */
+    DUMP_BINARY
+};
+
+/* alignment of the mesh cells and of every row in bytes */
+#define MESH_ALIGN 64
+
+typedef struct mesh_t {
+    /* mesh size in x and y */
+    uint64_t nx, ny; 
+    /* cells from the start of one row to the start of the next, ny padded */
+    uint64_t pitch;
+    /* mesh cells, nx rows of pitch cells in one aligned block */
+    double *cells;
+} mesh_t;
+
+/* row i of mesh m */
+#define MESH_ROW(m, i) ((m)->cells + (uint64_t)(i) * (m)->pitch)
+
+/* simulation parameters */
+typedef struct simulation_params_t {
+    /* mesh size in x and y */
+    uint64_t nx, ny;
+    /* thermal conductivity */
+    double c;
+    double delta_s;
+    /* time interval */
+    double delta_t;
+    /* max simulation time */
+    uint64_t max_t;
+    /* one of SOLVER_* */
+    int solver;
+    /* one of ENGINE_* */
+    int engine;
+    /* threads of the threaded engine, 0 for the OpenMP default */
+    int threads;
+    /* one of KERNEL_* */
+    int kernel;
+    /* time steps per temporal block */
+    uint64_t time_block;
+    /* steps between the binary frames heat-img-<step>.bin written by a
+     * background thread, which also keeps the last one in the mapped
+     * heat-live.bin. 0 writes none */
+    uint64_t snapshot_steps;
+    /* one of DUMP_* */
+    int dump_format;
+    /* stop once no cell changed by more than tol in a step, 0 runs all max_t
+     * steps. the steady solver stops once a step would change no cell by
+     * tol, 1e-12 if 0 */
+    double tol;
+    /* steps between the checks of tol, the change is computed along with the
+     * last step before each check */
+    uint64_t check_steps;
+} simulation_params_t;
+
+typedef struct simulation_t simulation_t;
+
+/* an engine advances sim by nsteps steps from step t0. step t is held by the
+ * mesh returned by simulation_mesh(sim, t), step t + 1 goes to the other one,
+ * and the source has to be stamped on every step as source_apply does. the
+ * engines of the library also compute the change of the last step when tol
+ * is set, a simulation on another engine runs all of its steps */
+typedef int (*engine_fn_t)(simulation_t *sim, uint64_t t0, uint64_t nsteps);
+
+int
+params_construct(simulation_params_t **params);
+
+int
+params_destruct(simulation_params_t *params);
+
+/* sets params for an nx x ny mesh, the other parameters get their defaults */
+int
+init_params(simulation_params_t *params,
+            int nx,
+            int ny,
+            double c,
+            int max_t);
+
+int
+print_params(const simulation_params_t *params);
+
+/* constructs a simulation of a copy of params with the heat source set */
+int
+simulation_construct(simulation_t **new_sim,
+                     const simulation_params_t *params);
+
+/* also writes the snapshots still queued */
+int
+simulation_destruct(simulation_t *sim);
+
+/* runs the steps left up to max_t, or solves for the steady state, which
+ * counts its iterations as steps */
+int
+run_simulation(simulation_t *sim);
+
+/* advances sim by nsteps steps, or fewer once it converged */
+int
+simulation_step(simulation_t *sim, uint64_t nsteps);
+
+/* whether the change of a step fell below tol */
+bool
+simulation_converged(const simulation_t *sim);
+
+/* the largest and the L2 norm of the change of the cells in the last step
+ * checked, FAILURE if no step was */
+int
+simulation_residual(const simulation_t *sim, double *linf, double *l2);
+
+/* number of steps run so far */
+uint64_t
+simulation_time(const simulation_t *sim);
+
+/* the mesh holding step t; simulation_mesh(sim, simulation_time(sim)) is the
+ * current state */
+mesh_t *
+simulation_mesh(const simulation_t *sim, uint64_t t);
+
+const simulation_params_t *
+simulation_params(const simulation_t *sim);
+
+/* name of the stencil kernel sim runs */
+const char *
+simulation_kernel(const simulation_t *sim);
+
+/* replaces the engine of sim, e.g. with one from another library */
+int
+simulation_set_engine(simulation_t *sim, engine_fn_t engine);
+
+/* stamps the heat source on mesh */
+int
+source_apply(const simulation_t *sim, mesh_t *mesh);
+
+/* writes the second mesh in dump_format to heat-img.dat or heat-img.bin. as
+ * heat-tx always has, after an even number of steps that is the step before
+ * the last */
+int
+dump(const simulation_t *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,662 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* the heat-tx program: runs one simulation on libheattx, reports its rate and
+ * dumps it
+ *
+ * usage: heat-tx [--nx n] [--ny n] [--n n] [--c c] [--max-t t]
+ *                [--engine auto|serial|blocked|threaded|oblivious]
+ *                [--threads n] [--time-block k] [--snapshot-steps n]
+ *                [--dump-format text|binary|none] [--tol tol]
+ *                [--check-steps k] [--kernel auto|c|avx2|avx512|neon]
+ *                [--solver transient|steady] [--papi]
+ *
+ * every option can also be set with the environment variable named in
+ * opt_env, the command line wins */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/* the hardware counters of --papi from PAPI's low level API (-DCODY_PAPI=1,
+ * link with -lpapi, as cody_perf) */
+#ifndef CODY_PAPI
+#define CODY_PAPI 0
+#endif
+#if CODY_PAPI
+#include <pthread.h>
+#include <papi.h>
+#endif
+
+#include "heat-tx.h"
+#include "cody_perf.h"
+
+static char *app_name = "c-heat-tx";
+static char *app_ver = "0.4";
+
+/* max simulation time */
+#define T_MAX 1024
+/* nx and ny */
+#define N 512
+/* thermal conductivity */
+#define THERM_COND 0.6
+/* time steps advanced per sweep of the temporally blocked engine, 0 or 1
+ * sweeps the whole mesh once per step */
+#ifndef TIME_BLOCK
+#define TIME_BLOCK 0
+#endif
+/* format of the final dump: gnuplot text matrix in heat-img.dat, or gnuplot
+ * binary matrix in heat-img.bin */
+#ifndef DUMP_FORMAT
+#define DUMP_FORMAT DUMP_TEXT
+#endif
+/* steps between the binary frames heat-img-<step>.bin written by a background
+ * thread, which also keeps the last one in the mapped heat-live.bin. 0 writes
+ * none */
+#ifndef SNAPSHOT_STEPS
+#define SNAPSHOT_STEPS 0
+#endif
+/* no dump at all, for timing runs */
+#define DUMP_NONE -1
+/* bytes moved per cell update by a sweep that keeps the neighbouring rows in
+ * cache: the old cell is read and the new one written */
+#define BYTES_PER_UPDATE (2 * sizeof(double))
+/* bytes of the cache lines the misses of the counters move */
+#define CACHE_LINE 64
+
+/* the hardware counters of --papi, in the order of the PAPI line */
+enum {
+    CTR_CYC = 0,
+    CTR_INS,
+    CTR_L1_DCM,
+    CTR_L2_DCM,
+    CTR_L3_TCM,
+    CTR_FLOPS,
+    NCTR
+};
+
+static const char *ctr_names[] = {"cycles", "instructions", "L1 data misses",
+                                  "L2 data misses", "L3 misses", "flops"};
+
+/* the counts of a run summed over its threads, -1 for the events the
+ * machine does not count */
+typedef struct counters_t {
+    int threads;
+    long long values[NCTR];
+    /* the event set of each thread and the position of each event in it */
+    int *sets;
+    int (*slots)[NCTR];
+} counters_t;
+
+/* the run as given on the command line and in the environment */
+typedef struct app_opts_t {
+    int nx, ny;
+    double c;
+    int max_t;
+    int engine;
+    int threads;
+    int time_block;
+    int snapshot_steps;
+    int dump_format;
+    double tol;
+    int check_steps;
+    int kernel;
+    int solver;
+    int papi;
+} app_opts_t;
+
+static struct option long_opts[] = {
+    {"help",           no_argument,       0, 'h'},
+    {"nx",             required_argument, 0, 'x'},
+    {"ny",             required_argument, 0, 'y'},
+    {"n",              required_argument, 0, 'n'},
+    {"c",              required_argument, 0, 'c'},
+    {"max-t",          required_argument, 0, 't'},
+    {"engine",         required_argument, 0, 'e'},
+    {"threads",        required_argument, 0, 'p'},
+    {"time-block",     required_argument, 0, 'b'},
+    {"snapshot-steps", required_argument, 0, 's'},
+    {"dump-format",    required_argument, 0, 'f'},
+    {"tol",            required_argument, 0, 'r'},
+    {"check-steps",    required_argument, 0, 'k'},
+    {"kernel",         required_argument, 0, 'K'},
+    {"solver",         required_argument, 0, 'S'},
+    {"papi",           no_argument,       0, 'P'},
+    {0, 0, 0, 0}
+};
+
+/* the environment variable of each of long_opts */
+static const char *opt_env[] = {
+    NULL,
+    "HEATTX_NX",
+    "HEATTX_NY",
+    "HEATTX_N",
+    "HEATTX_C",
+    "HEATTX_MAX_T",
+    "HEATTX_ENGINE",
+    "HEATTX_THREADS",
+    "HEATTX_TIME_BLOCK",
+    "HEATTX_SNAPSHOT_STEPS",
+    "HEATTX_DUMP_FORMAT",
+    "HEATTX_TOL",
+    "HEATTX_CHECK_STEPS",
+    "HEATTX_KERNEL",
+    "HEATTX_SOLVER",
+    "HEATTX_PAPI",
+    NULL
+};
+
+static const char *engine_names[] = {"auto", "serial", "blocked", "threaded",
+                                     "oblivious"};
+
+static const char *dump_names[] = {"text", "binary"};
+
+static const char *kernel_names[] = {"auto", "c", "avx2", "avx512", "neon"};
+
+static const char *solver_names[] = {"transient", "steady"};
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+usage(void)
+{
+    int i;
+
+    printf("usage: heat-tx [options]\n");
+    for (i = 1; NULL != long_opts[i].name; ++i) {
+        printf("  --%-16s -%c  %s\n", long_opts[i].name, long_opts[i].val,
+               opt_env[i]);
+    }
+    printf("engines: auto serial blocked threaded oblivious\n");
+    printf("dump formats: text binary none\n");
+    printf("kernels: auto c avx2 avx512 neon\n");
+    printf("solvers: transient steady\n");
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* index of name in names, or -1 */
+static int
+name_index(const char *name, const char **names, int nnames)
+{
+    int i;
+
+    for (i = 0; i < nnames; ++i) {
+        if (0 == strcmp(name, names[i])) return i;
+    }
+    return -1;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* parses a non-negative integer of an option */
+static int
+parse_int(const char *arg, int *val)
+{
+    char *end = NULL;
+    long v = strtol(arg, &end, 10);
+
+    if ('\0' == *arg || '\0' != *end || v < 0 || v > INT32_MAX) {
+        return FAILURE_INVALID_ARG;
+    }
+    *val = (int)v;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* sets the option of short name opt to arg */
+static int
+set_opt(app_opts_t *opts, int opt, const char *arg)
+{
+    int rc = SUCCESS;
+    char *end = NULL;
+
+    switch (opt) {
+    case 'x': rc = parse_int(arg, &opts->nx); break;
+    case 'y': rc = parse_int(arg, &opts->ny); break;
+    case 'n':
+        if (SUCCESS == (rc = parse_int(arg, &opts->nx))) opts->ny = opts->nx;
+        break;
+    case 'c':
+        opts->c = strtod(arg, &end);
+        if ('\0' == *arg || '\0' != *end || opts->c <= 0.0) {
+            rc = FAILURE_INVALID_ARG;
+        }
+        break;
+    case 'r':
+        opts->tol = strtod(arg, &end);
+        if ('\0' == *arg || '\0' != *end || opts->tol < 0.0) {
+            rc = FAILURE_INVALID_ARG;
+        }
+        break;
+    case 'k':
+        rc = parse_int(arg, &opts->check_steps);
+        if (SUCCESS == rc && 0 == opts->check_steps) rc = FAILURE_INVALID_ARG;
+        break;
+    case 't': rc = parse_int(arg, &opts->max_t); break;
+    case 'e':
+        opts->engine = name_index(arg, engine_names, 5);
+        if (opts->engine < 0) rc = FAILURE_INVALID_ARG;
+        break;
+    case 'K':
+        opts->kernel = name_index(arg, kernel_names, 5);
+        if (opts->kernel < 0) rc = FAILURE_INVALID_ARG;
+        break;
+    case 'S':
+        opts->solver = name_index(arg, solver_names, 2);
+        if (opts->solver < 0) rc = FAILURE_INVALID_ARG;
+        break;
+    case 'p': rc = parse_int(arg, &opts->threads); break;
+    /* a flag on the command line, 0 or 1 in the environment */
+    case 'P':
+        if (NULL == arg) {
+            opts->papi = 1;
+        } else if (SUCCESS == (rc = parse_int(arg, &opts->papi)) &&
+                   opts->papi > 1) {
+            rc = FAILURE_INVALID_ARG;
+        }
+        break;
+    case 'b': rc = parse_int(arg, &opts->time_block); break;
+    case 's': rc = parse_int(arg, &opts->snapshot_steps); break;
+    case 'f':
+        if (0 == strcmp(arg, "none")) {
+            opts->dump_format = DUMP_NONE;
+        } else if (0 > (opts->dump_format = name_index(arg, dump_names, 2))) {
+            rc = FAILURE_INVALID_ARG;
+        }
+        break;
+    default:
+        rc = FAILURE_INVALID_ARG;
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the defaults, then the environment, then the command line */
+static int
+get_opts(app_opts_t *opts, int argc, char **argv)
+{
+    const char *env = NULL;
+    int i, c;
+
+    opts->nx = opts->ny = N;
+    opts->c = THERM_COND;
+    opts->max_t = T_MAX;
+    opts->engine = ENGINE_AUTO;
+    opts->threads = 0;
+    opts->time_block = TIME_BLOCK;
+    opts->snapshot_steps = SNAPSHOT_STEPS;
+    opts->dump_format = DUMP_FORMAT;
+    opts->tol = 0.0;
+    opts->check_steps = 100;
+    opts->kernel = KERNEL_AUTO;
+    opts->solver = SOLVER_TRANSIENT;
+    opts->papi = 0;
+
+    for (i = 1; NULL != long_opts[i].name; ++i) {
+        if (NULL == (env = getenv(opt_env[i]))) continue;
+        if (SUCCESS != set_opt(opts, long_opts[i].val, env)) {
+            fprintf(stderr, "invalid %s=%s\n", opt_env[i], env);
+            return FAILURE_INVALID_ARG;
+        }
+    }
+    while (-1 != (c = getopt_long(argc, argv, "hx:y:n:c:t:e:p:b:s:f:r:k:K:S:P",
+                                  long_opts, NULL))) {
+        if ('h' == c) {
+            usage();
+            exit(EXIT_SUCCESS);
+        }
+        if ('?' == c || SUCCESS != set_opt(opts, c, optarg)) {
+            if ('?' != c) fprintf(stderr, "invalid -%c %s\n", c, optarg);
+            usage();
+            return FAILURE_INVALID_ARG;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "unexpected argument %s\n", argv[optind]);
+        usage();
+        return FAILURE_INVALID_ARG;
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* threads of the run: those of the threaded engine, all of which are
+ * counted even when another engine leaves them idle */
+static int
+run_threads(const app_opts_t *opts)
+{
+#ifdef _OPENMP
+    return (0 == opts->threads) ? omp_get_max_threads() : opts->threads;
+#else
+    (void)opts;
+    return 1;
+#endif
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* prints the rate of the steps run in secs, and the same as one TIME line
+ * for scripts. the steady solver counts its iterations as steps and is its
+ * engine */
+static void
+report(const app_opts_t *opts, uint64_t steps, double secs)
+{
+    /* the edges are fixed, only the interior cells are updated */
+    double updates = (double)(opts->nx - 2) * (double)(opts->ny - 2) *
+                     (double)steps;
+    double cups = (secs > 0.0) ? updates / secs : 0.0;
+    double gbs = cups * BYTES_PER_UPDATE * 1.0e-9;
+    int threads = run_threads(opts);
+    const char *engine = (SOLVER_STEADY == opts->solver)
+                       ? "steady" : engine_names[opts->engine];
+
+    printf("o run time: %lf s\n", secs);
+    printf(". cell updates/s: %e\n", cups);
+    printf(". effective bandwidth: %lf GB/s\n", gbs);
+    /* TIME:app,engine,nx,ny,threads,steps,secs,cell updates/s,GB/s */
+    printf("TIME:%s,%s,%d,%d,%d,%"PRIu64",%lf,%e,%lf\n", app_name,
+           engine, opts->nx, opts->ny, threads, steps,
+           secs, cups, gbs);
+    /* and as the rows shared by the mini-apps, the engine as the variant */
+    cody_report(engine, 1, threads,
+                (double)(opts->nx - 2) * (double)(opts->ny - 2),
+                (double)steps, secs);
+    cody_metric("GBs", gbs);
+}
+
+#if CODY_PAPI
+static const int papi_events[NCTR] = {PAPI_TOT_CYC, PAPI_TOT_INS,
+                                      PAPI_L1_DCM, PAPI_L2_DCM, PAPI_L3_TCM,
+                                      PAPI_DP_OPS};
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* starts the counters on every thread of the run. PAPI counts the thread that
+ * starts them, so each OpenMP thread starts its own, and the engines run on
+ * the same threads. an event the machine does not count, or not together
+ * with those before it, is left out */
+static int
+counters_start(counters_t *ctr, const app_opts_t *opts)
+{
+    int rc = SUCCESS;
+    int t, i;
+
+    if (PAPI_VER_CURRENT != PAPI_library_init(PAPI_VER_CURRENT) ||
+        PAPI_OK != PAPI_thread_init((unsigned long (*)(void))pthread_self)) {
+        fprintf(stderr, "PAPI initialization failure @ %s:%d\n", __FILE__,
+                __LINE__);
+        return FAILURE;
+    }
+    ctr->threads = run_threads(opts);
+    ctr->sets = malloc(ctr->threads * sizeof(*ctr->sets));
+    ctr->slots = malloc(ctr->threads * sizeof(*ctr->slots));
+    if (NULL == ctr->sets || NULL == ctr->slots) return FAILURE_OOR;
+    for (t = 0; t < ctr->threads; ++t) ctr->sets[t] = PAPI_NULL;
+    for (i = 0; i < NCTR; ++i) ctr->values[i] = 0;
+
+#pragma omp parallel num_threads(ctr->threads) private(t, i)
+    {
+        int n = 0;
+        int trc = PAPI_OK;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#else
+        t = 0;
+#endif
+        if (PAPI_OK == (trc = PAPI_create_eventset(&ctr->sets[t]))) {
+            for (i = 0; i < NCTR; ++i) {
+                ctr->slots[t][i] =
+                    (PAPI_OK == PAPI_add_event(ctr->sets[t], papi_events[i]))
+                    ? n++ : -1;
+            }
+            trc = PAPI_start(ctr->sets[t]);
+        }
+        if (PAPI_OK != trc) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                fprintf(stderr, "PAPI failure on thread %d: %s\n", t,
+                        PAPI_strerror(trc));
+                rc = FAILURE;
+            }
+        }
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* stops the counters of every thread and sums them into ctr->values */
+static int
+counters_stop(counters_t *ctr)
+{
+    int rc = SUCCESS;
+    int t, i;
+
+#pragma omp parallel num_threads(ctr->threads) private(t, i)
+    {
+        long long v[NCTR];
+        int trc;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#else
+        t = 0;
+#endif
+        trc = PAPI_stop(ctr->sets[t], v);
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            if (PAPI_OK != trc) {
+                fprintf(stderr, "PAPI failure on thread %d: %s\n", t,
+                        PAPI_strerror(trc));
+                rc = FAILURE;
+            }
+            for (i = 0; i < NCTR; ++i) {
+                if (ctr->slots[t][i] < 0) {
+                    ctr->values[i] = -1;
+                } else if (PAPI_OK == trc && ctr->values[i] >= 0) {
+                    ctr->values[i] += v[ctr->slots[t][i]];
+                }
+            }
+        }
+        (void)PAPI_cleanup_eventset(ctr->sets[t]);
+        (void)PAPI_destroy_eventset(&ctr->sets[t]);
+    }
+    free(ctr->sets);
+    free(ctr->slots);
+    PAPI_shutdown();
+    return rc;
+}
+#else
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+counters_start(counters_t *ctr, const app_opts_t *opts)
+{
+    (void)ctr;
+    (void)opts;
+    fprintf(stderr, "--papi: heat-tx was built without PAPI, see the README\n");
+    return FAILURE_INVALID_ARG;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+counters_stop(counters_t *ctr)
+{
+    (void)ctr;
+    return FAILURE;
+}
+#endif
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* a / b of two counts, -1 if either was not counted */
+static double
+counts_ratio(long long a, long long b, double scale)
+{
+    return (a < 0 || b <= 0) ? -1.0 : scale * (double)a / (double)b;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* prints the counts of the run and what follows from them: instructions per
+ * cycle, bytes per cell update of the L3 misses (the memory traffic, against
+ * the BYTES_PER_UPDATE of the bandwidth) and flops per cycle, and the same on
+ * one line for scripts, -1 for what was not counted */
+static void
+report_counters(const app_opts_t *opts, const counters_t *ctr, uint64_t steps)
+{
+    double updates = (double)(opts->nx - 2) * (double)(opts->ny - 2) *
+                     (double)steps;
+    const long long *v = ctr->values;
+    double ipc = counts_ratio(v[CTR_INS], v[CTR_CYC], 1.0);
+    double bpu = (v[CTR_L3_TCM] < 0 || updates <= 0.0)
+               ? -1.0 : (double)v[CTR_L3_TCM] * CACHE_LINE / updates;
+    double fpc = counts_ratio(v[CTR_FLOPS], v[CTR_CYC], 1.0);
+    const char *engine = (SOLVER_STEADY == opts->solver)
+                       ? "steady" : engine_names[opts->engine];
+    int i;
+
+    printf("o hardware counters (PAPI, %d threads):\n", ctr->threads);
+    for (i = 0; i < NCTR; ++i) {
+        if (v[i] < 0) {
+            printf(". %s: not counted\n", ctr_names[i]);
+        } else {
+            printf(". %s: %e\n", ctr_names[i], (double)v[i]);
+        }
+    }
+    printf(". instructions/cycle: %lf\n", ipc);
+    printf(". bytes/cell update: %lf (L3 misses, the sweep needs %d)\n", bpu,
+           (int)BYTES_PER_UPDATE);
+    printf(". flops/cycle: %lf\n", fpc);
+    /* PAPI:app,engine,nx,ny,threads,steps,cycles,instructions,L1 misses,
+     * L2 misses,L3 misses,flops,IPC,bytes/update,flops/cycle */
+    printf("PAPI:%s,%s,%d,%d,%d,%"PRIu64",%lld,%lld,%lld,%lld,%lld,%lld,"
+           "%lf,%lf,%lf\n", app_name, engine, opts->nx, opts->ny,
+           ctr->threads, steps, v[CTR_CYC], v[CTR_INS], v[CTR_L1_DCM],
+           v[CTR_L2_DCM], v[CTR_L3_TCM], v[CTR_FLOPS], ipc, bpu, fpc);
+    if (ipc >= 0.0) cody_metric("IPC", ipc);
+    if (bpu >= 0.0) cody_metric("bytesPerUpdate", bpu);
+    if (fpc >= 0.0) cody_metric("flopsPerCycle", fpc);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+main(int argc, char **argv)
+{
+    int rc = FAILURE;
+    int erc = EXIT_FAILURE;
+    simulation_params_t *params = NULL;
+    simulation_t *sim = NULL;
+    app_opts_t opts;
+    counters_t ctr;
+    int r_run, r_dump;
+
+    /* print application banner */
+    printf("o %s %s\n", app_name, app_ver);
+    cody_init("heat-tx");
+    r_run = cody_region("run");
+    r_dump = cody_region("dump");
+
+    if (SUCCESS != (rc = get_opts(&opts, argc, argv))) goto cleanup;
+    if (SUCCESS != (rc = params_construct(&params))) {
+        fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto cleanup;
+    }
+    if (SUCCESS != (rc = init_params(params, opts.nx, opts.ny, opts.c,
+                                     opts.max_t))) {
+        fprintf(stderr, "init_params failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto cleanup;
+    }
+    params->engine = opts.engine;
+    params->threads = opts.threads;
+    params->time_block = opts.time_block;
+    params->snapshot_steps = opts.snapshot_steps;
+    params->dump_format = (DUMP_NONE == opts.dump_format) ? DUMP_TEXT
+                                                          : opts.dump_format;
+    params->tol = opts.tol;
+    params->check_steps = opts.check_steps;
+    params->kernel = opts.kernel;
+    params->solver = opts.solver;
+    (void)print_params(params);
+
+    if (SUCCESS != (rc = simulation_construct(&sim, params))) {
+        fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto cleanup;
+    }
+    if (opts.papi && SUCCESS != (rc = counters_start(&ctr, &opts))) {
+        goto cleanup;
+    }
+    cody_region_begin(r_run);
+    rc = run_simulation(sim);
+    cody_region_end(r_run);
+    if (SUCCESS != rc) {
+        fprintf(stderr, "run_simulation failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto cleanup;
+    }
+    if (opts.papi && SUCCESS != (rc = counters_stop(&ctr))) goto cleanup;
+    cody_region_begin(r_dump);
+    if (DUMP_NONE != opts.dump_format) rc = dump(sim);
+    cody_region_end(r_dump);
+    if (SUCCESS != rc) {
+        fprintf(stderr, "dump failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto cleanup;
+    }
+    /* after the dump, so its region is in the report, but not in the rate */
+    report(&opts, simulation_time(sim), cody_region_secs(r_run));
+    if (opts.papi) report_counters(&opts, &ctr, simulation_time(sim));
+    /* all is well */
+    erc = EXIT_SUCCESS;
+
+cleanup:
+    cody_finish();
+    (void)simulation_destruct(sim);
+    (void)params_destruct(params);
+    return erc;
+}
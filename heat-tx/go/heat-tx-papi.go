@@ -0,0 +1,191 @@
+// Copyright (c) 2014-2015 Los Alamos National Security, LLC
+//                         All rights reserved.
+//
+// This software was produced under U.S. Government contract DE-AC52-06NA25396
+// for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+// National Security, LLC for the U.S. Department of Energy. The U.S. Government
+// has rights to use, reproduce, and distribute this software.  NEITHER THE
+// GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+// OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+// software is modified to produce derivative works, such modified software
+// should be clearly marked, so as not to confuse it with the version available
+// from LANL.
+//
+// Additionally, redistribution and use in source and binary forms, with or
+// without modification, are permitted provided that the following conditions
+// are met:
+//
+// . Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// . Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+//   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+// SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// LA-CC 10-123
+
+// The hardware counters of heat-tx -papi, through go-papi (see the top-level
+// README), with the events, derived rates and PAPI line of the C version
+
+// To Build:
+// go build heat-tx.go heat-tx-papi.go
+
+package main
+
+import (
+    "fmt"
+    "sync"
+    "github.com/losalamos/go-papi"
+)
+
+// The events of the PAPI line, in its order
+const (
+    CtrCyc = iota
+    CtrIns
+    CtrL1DCM
+    CtrL2DCM
+    CtrL3TCM
+    CtrFlops
+    NCtr
+)
+
+var papiEvents = [NCtr]papi.Event{papi.TOT_CYC, papi.TOT_INS, papi.L1_DCM,
+                                  papi.L2_DCM, papi.L3_TCM, papi.DP_OPS}
+
+var papiNames = [NCtr]string{"cycles", "instructions", "L1 data misses",
+                             "L2 data misses", "L3 misses", "flops"}
+
+// Bytes of the cache lines the misses move
+const CacheLine float64 = 64
+
+type PapiCounters struct {
+    mu sync.Mutex
+    // which of papiEvents the machine counts, and those events
+    have [NCtr]bool
+    events []papi.Event
+    // the counts summed over the bands, and the first error of a band
+    values [NCtr]int64
+    err error
+}
+
+func init() {
+    NewBandCounters = func(procs int) BandCounters {
+        return NewPapiCounters()
+    }
+}
+
+// NewPapiCounters keeps the events of papiEvents that this machine counts,
+// trying each one on its own
+func NewPapiCounters() *PapiCounters {
+    c := &PapiCounters{}
+    for i, ev := range papiEvents {
+        if papi.StartCounters([]papi.Event{ev}) != nil {
+            continue
+        }
+        if _, err := papi.StopCounters(); err == nil {
+            c.have[i] = true
+            c.events = append(c.events, ev)
+        }
+    }
+    return c
+}
+
+func (c *PapiCounters) fail(p int, err error) {
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    if c.err == nil {
+        c.err = fmt.Errorf("PAPI failure on band %d: %v", p, err)
+    }
+}
+
+func (c *PapiCounters) Start(p int) {
+    if err := papi.StartCounters(c.events); err != nil {
+        c.fail(p, err)
+    }
+}
+
+// Stop adds the counts of band p to the sum
+func (c *PapiCounters) Stop(p int) {
+    v, err := papi.StopCounters()
+    if err != nil {
+        c.fail(p, err)
+        return
+    }
+    c.mu.Lock()
+    defer c.mu.Unlock()
+    k := 0
+    for i := range papiEvents {
+        if c.have[i] {
+            c.values[i] += v[k]
+            k++
+        }
+    }
+}
+
+// count returns the sum of event i, -1 if it was not counted
+func (c *PapiCounters) count(i int) int64 {
+    if !c.have[i] {
+        return -1
+    }
+    return c.values[i]
+}
+
+// ratio returns scale * a / b of two counts, -1 if either was not counted
+func ratio(a, b int64, scale float64) float64 {
+    if a < 0 || b <= 0 {
+        return -1
+    }
+    return scale * float64(a) / float64(b)
+}
+
+// Report prints the counts and what follows from them: instructions per
+// cycle, bytes per cell update of the L3 misses (the memory traffic, against
+// the BytesPerUpdate of the bandwidth) and flops per cycle, and the same on
+// one line for scripts, as the C version
+func (c *PapiCounters) Report(s *HeatTxSim, engine string) error {
+    if c.err != nil {
+        return c.err
+    }
+    nx, ny := s.oldMesh.nx, s.oldMesh.ny
+    updates := int64((nx - 2) * (ny - 2) * s.params.tMax)
+    ipc := ratio(c.count(CtrIns), c.count(CtrCyc), 1)
+    bpu := ratio(c.count(CtrL3TCM), updates, CacheLine)
+    fpc := ratio(c.count(CtrFlops), c.count(CtrCyc), 1)
+    fmt.Printf("o hardware counters (PAPI, %d goroutines):\n", s.procs)
+    for i, name := range papiNames {
+        if c.have[i] {
+            fmt.Printf(". %s: %e\n", name, float64(c.values[i]))
+        } else {
+            fmt.Printf(". %s: not counted\n", name)
+        }
+    }
+    fmt.Printf(". instructions/cycle: %f\n", ipc)
+    fmt.Printf(". bytes/cell update: %f (L3 misses, the sweep needs %d)\n",
+               bpu, int(BytesPerUpdate))
+    fmt.Printf(". flops/cycle: %f\n", fpc)
+    // PAPI:app,engine,nx,ny,threads,steps,cycles,instructions,L1 misses,
+    // L2 misses,L3 misses,flops,IPC,bytes/update,flops/cycle
+    fmt.Printf("PAPI:%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%f,%f,%f\n",
+               AppName, engine, nx, ny, s.procs, s.params.tMax,
+               c.count(CtrCyc), c.count(CtrIns), c.count(CtrL1DCM),
+               c.count(CtrL2DCM), c.count(CtrL3TCM), c.count(CtrFlops),
+               ipc, bpu, fpc)
+    return nil
+}
@@ -51,6 +51,15 @@
 // ./heat-tx -cpuprofile=heat-tx.prof
 // go tool pprof ./heat-tx ./heat-tx.prof
 
+// To Count (PAPI):
+// go build heat-tx.go heat-tx-papi.go
+// ./heat-tx -papi
+// needs go-papi, see the top-level README
+
+// To Run in Parallel:
+// ./heat-tx -procs=4
+// splits the rows into bands over 4 goroutines, GOMAXPROCS by default
+
 // To Plot (gnuplot):
 // plot './heat-img.dat' matrix with image
 
@@ -63,7 +72,10 @@ import (
     "bufio"
     "os"
     "log"
+    "runtime"
     "runtime/pprof"
+    "sync"
+    "time"
 )
 
 // Application constants
@@ -80,12 +92,17 @@ const (
     ThermCond float64 = 0.6
     // Some constant
     K float64 = 0.4
+    // Rows are padded to a multiple of this many bytes (a cache line)
+    MeshAlign uint64 = 64
+    // Bytes moved per cell update: the old cell read and the new one written
+    BytesPerUpdate float64 = 16
 )
 
 // 2D mesh
 type Mesh struct {
     nx, ny uint64 // mesh size in x and y
-    cells [][]float64 // mesh cells
+    pitch uint64 // cells from the start of one row to the next, ny padded
+    cells []float64 // mesh cells, nx rows of pitch cells
 }
 
 type SimParams struct {
@@ -101,20 +118,88 @@ type SimParams struct {
 type HeatTxSim struct {
     // The meshes
     newMesh, oldMesh *Mesh
+    // Offsets into the mesh cells and values of the constant heat source
+    srcIdx []uint64
+    srcVal []float64
     // Simulation parameters
     params *SimParams
+    // Goroutines of Run, each updating a band of rows
+    procs int
+    // Hardware counters of the bands, nil if not counted
+    counters BandCounters
+}
+
+// BandCounters counts the hardware events of a run. Each band goroutine of
+// Run starts and stops them on its own OS thread, and Report prints their sum
+// once Run is done. heat-tx-papi.go provides them through go-papi
+type BandCounters interface {
+    Start(p int)
+    Stop(p int)
+    Report(s *HeatTxSim, engine string) error
+}
+
+// Set by heat-tx-papi.go when built with it
+var NewBandCounters func(procs int) BandCounters
+
+// Barrier blocks the n goroutines that call Wait until all of them did, and
+// can be reused right away for the next step
+type Barrier struct {
+    mu sync.Mutex
+    cond *sync.Cond
+    n, count int
+    // incremented each time all n arrived, so a late wakeup of one step is
+    // not mistaken for the next
+    gen uint64
+}
+
+func NewBarrier(n int) *Barrier {
+    b := &Barrier{n: n}
+    b.cond = sync.NewCond(&b.mu)
+    return b
+}
+
+func (b *Barrier) Wait() {
+    b.mu.Lock()
+    gen := b.gen
+    b.count++
+    if b.count == b.n {
+        b.count = 0
+        b.gen++
+        b.cond.Broadcast()
+    } else {
+        for gen == b.gen {
+            b.cond.Wait()
+        }
+    }
+    b.mu.Unlock()
+}
+
+// MeshPitch returns the row pitch for rows of y cells: whole cache lines, plus
+// one more line when the rows would be a multiple of 4 KiB apart and the cells
+// of a column would all map to the same cache sets. Same as the C version.
+func MeshPitch(y uint64) uint64 {
+    line := MeshAlign / 8
+    pitch := (y + line - 1) / line * line
+    if (pitch * 8) % 4096 == 0 {
+        pitch += line
+    }
+    return pitch
 }
 
 // NewMesh returns an empty mesh of the specified width and height
 func NewMesh(x, y uint64) *Mesh {
-    cells := make([][]float64, x)
-    for i := range cells {
-        cells[i] = make([]float64, y)
-    }
+    pitch := MeshPitch(y)
+    // all rows in one slice, so a sweep streams through memory
+    cells := make([]float64, x * pitch)
     // **remember** unlike C, we can return the address of a local variable.
     // in fact, this returns a fresh instance each time the following code is
     // evaluated - w00t.
-    return &Mesh{nx: x, ny: y, cells: cells}
+    return &Mesh{nx: x, ny: y, pitch: pitch, cells: cells}
+}
+
+// Row returns the ny cells of row i, sharing the storage of the mesh
+func (m *Mesh) Row(i uint64) []float64 {
+    return m.cells[i * m.pitch : i * m.pitch + m.ny]
 }
 
 // NewSimParams returns a new set of initialized simulation parameters based on
@@ -142,18 +227,37 @@ func (p *SimParams) String() string {
 // Nice Mesh String representation
 func (m *Mesh) String() string {
     mStr := ""
-    for i := range m.cells {
-        for j := range m.cells[i] {
-            mStr += strconv.FormatFloat(m.cells[i][j], 'e', 1, 64) + " "
+    for i := uint64(0); i < m.nx; i++ {
+        for _, c := range m.Row(i) {
+            mStr += strconv.FormatFloat(c, 'e', 1, 64) + " "
         }
         mStr += "\n"
     }
     return mStr
 }
 
-func NewHeatTxSim(x, y uint64,  thermCond float64, tMax uint64) *HeatTxSim {
-    return &HeatTxSim{params: NewSimParams(x, thermCond, tMax),
-                      newMesh: NewMesh(x, y), oldMesh: NewMesh(x, y)}
+func NewHeatTxSim(x, y uint64,  thermCond float64, tMax uint64,
+                  procs int) *HeatTxSim {
+    if procs < 1 {
+        procs = 1
+    }
+    if uint64(procs) > x {
+        procs = int(x)
+    }
+    sim := &HeatTxSim{params: NewSimParams(x, thermCond, tMax),
+                      newMesh: NewMesh(x, y), oldMesh: NewMesh(x, y),
+                      procs: procs}
+    // Collect the source cells once, so Run does not walk the circle every
+    // step. All of the source values are non-zero.
+    stamp := NewMesh(x, y)
+    stamp.SetInitConds()
+    for i, c := range stamp.cells {
+        if c != 0.0 {
+            sim.srcIdx = append(sim.srcIdx, uint64(i))
+            sim.srcVal = append(sim.srcVal, c)
+        }
+    }
+    return sim
 }
 
 func (m *Mesh) SetInitConds() {
@@ -164,14 +268,14 @@ func (m *Mesh) SetInitConds() {
     radiusErr := int64(1 - x)
 
     for x >= y {
-        m.cells[ x + x0][ y + y0] = K * .50
-        m.cells[ y + x0][ x + y0] = K * .60
-        m.cells[-x + x0][ y + y0] = K * .70
-        m.cells[-y + x0][ x + y0] = K * .80
-        m.cells[-x + x0][-y + y0] = K * .70
-        m.cells[-y + x0][-x + y0] = K * .60
-        m.cells[ x + x0][-y + y0] = K * .50
-        m.cells[ y + x0][-x + y0] = K
+        m.Row( x + x0)[ y + y0] = K * .50
+        m.Row( y + x0)[ x + y0] = K * .60
+        m.Row(-x + x0)[ y + y0] = K * .70
+        m.Row(-y + x0)[ x + y0] = K * .80
+        m.Row(-x + x0)[-y + y0] = K * .70
+        m.Row(-y + x0)[-x + y0] = K * .60
+        m.Row( x + x0)[-y + y0] = K * .50
+        m.Row( y + x0)[-x + y0] = K
         y++
         if radiusErr < 0 {
             radiusErr += int64(2 * y + 1)
@@ -182,35 +286,87 @@ func (m *Mesh) SetInitConds() {
     }
 }
 
-// Runs the simulation
+// Runs the simulation, on s.procs goroutines if more than one
 func (s *HeatTxSim) Run() {
-    nx := len(s.oldMesh.cells) - 1
-    ny := len(s.oldMesh.cells[0]) - 1
+    if s.procs > 1 {
+        fmt.Println("o starting simulation on", s.procs, "goroutines...")
+    } else {
+        fmt.Println("o starting simulation...")
+    }
+    barrier := NewBarrier(s.procs)
+    var wg sync.WaitGroup
+    for p := 1; p < s.procs; p++ {
+        wg.Add(1)
+        go func(p int) {
+            defer wg.Done()
+            s.runBand(p, barrier)
+        }(p)
+    }
+    s.runBand(0, barrier)
+    wg.Wait()
+}
+
+// Runs all steps on band p of the rows: updates the rows of the band, stamps
+// the source cells in them and waits for the other bands before the next
+// step. Each goroutine swaps its own copy of the mesh pointers.
+func (s *HeatTxSim) runBand(p int, barrier *Barrier) {
+    nx := s.oldMesh.nx
+    ny := s.oldMesh.ny - 1
+    pitch := s.oldMesh.pitch
     ds2 := s.params.deltaS * s.params.deltaS
     cdtods2 := (s.params.c * s.params.deltaT) / ds2
     tMax := s.params.tMax;
     newMesh := s.newMesh
     oldMesh := s.oldMesh
+    // rows lo .. hi - 1, and the source cells in them, which are in row order
+    lo := nx * uint64(p) / uint64(s.procs)
+    hi := nx * uint64(p + 1) / uint64(s.procs)
+    srcLo := 0
+    for srcLo < len(s.srcIdx) && s.srcIdx[srcLo] < lo * pitch {
+        srcLo++
+    }
+    srcHi := srcLo
+    for srcHi < len(s.srcIdx) && s.srcIdx[srcHi] < hi * pitch {
+        srcHi++
+    }
+    // the edge rows are fixed
+    if lo < 1 {
+        lo = 1
+    }
+    if hi > nx - 1 {
+        hi = nx - 1
+    }
+    if s.counters != nil {
+        // the counters are those of the thread, keep the band on one
+        runtime.LockOSThread()
+        defer runtime.UnlockOSThread()
+        s.counters.Start(p)
+        defer s.counters.Stop(p)
+    }
 
-    fmt.Println("o starting simulation...")
     for t := uint64(0); t < tMax; t++ {
-        if t % 100 == 0 {
+        if p == 0 && t % 100 == 0 {
             fmt.Println(". starting iteration", t, "of", tMax)
         }
-        for i := 1; i < nx; i++ {
-            nci := newMesh.cells[i]
-            oci := oldMesh.cells[i]
-            ocip := oldMesh.cells[i - 1]
-            ocin := oldMesh.cells[i + 1]
-            for j := 1; j < ny; j++ {
+        for i := lo; i < hi; i++ {
+            nci := newMesh.Row(i)
+            oci := oldMesh.Row(i)
+            ocip := oldMesh.Row(i - 1)
+            ocin := oldMesh.Row(i + 1)
+            for j := uint64(1); j < ny; j++ {
                 nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
                                    oci[j] + oci[j + 1] + oci[j - 1]))
             }
         }
+        // Constant heat source
+        for c := srcLo; c < srcHi; c++ {
+            newMesh.cells[s.srcIdx[c]] = s.srcVal[c]
+        }
         // swap old and new - this is just a pointer swap
         oldMesh, newMesh = newMesh, oldMesh
-        // Constant heat source
-        oldMesh.SetInitConds()
+        // the next step reads the rows next to the band, and then overwrites
+        // the ones the other bands are reading
+        barrier.Wait()
     }
 }
 
@@ -225,10 +381,11 @@ func (s *HeatTxSim) Dump() error {
     }()
     // Create a new buffered writer
     w := bufio.NewWriter(dumpFile)
-    for i := range s.newMesh.cells {
-        for j := range s.newMesh.cells[0] {
-            fmt.Fprintf(w, "%f", s.newMesh.cells[i][j])
-            if j != len(s.newMesh.cells) - 1 {
+    for i := uint64(0); i < s.newMesh.nx; i++ {
+        row := s.newMesh.Row(i)
+        for j := range row {
+            fmt.Fprintf(w, "%f", row[j])
+            if j != len(row) - 1 {
                 fmt.Fprintf(w, " ")
             }
         }
@@ -240,6 +397,11 @@ func (s *HeatTxSim) Dump() error {
 
 func main() {
     var cpuprofile = flag.String("cpuprofile", "", "write CPU profile to file")
+    var procs = flag.Int("procs", runtime.GOMAXPROCS(0),
+                         "goroutines updating bands of rows")
+    var papiCounters = flag.Bool("papi", false,
+                                 "count the hardware events of the run " +
+                                 "(go build heat-tx.go heat-tx-papi.go)")
     // Parse user input
     flag.Parse()
     // Determine whther or not CPU profiling is on
@@ -253,9 +415,34 @@ func main() {
     }
     // Let the games begin
     fmt.Println("o", AppName, AppVerStr)
-    sim := NewHeatTxSim(N, N, ThermCond, TMax)
+    sim := NewHeatTxSim(N, N, ThermCond, TMax, *procs)
     sim.oldMesh.SetInitConds()
+    if *papiCounters {
+        if NewBandCounters == nil {
+            log.Fatal("built without PAPI: go build heat-tx.go heat-tx-papi.go")
+        }
+        sim.counters = NewBandCounters(sim.procs)
+    }
+    start := time.Now()
     sim.Run()
+    secs := time.Since(start).Seconds()
+    // the edges are fixed, only the interior cells are updated
+    cups := float64((N - 2) * (N - 2) * TMax) / secs
+    fmt.Printf("o run time: %f s\n", secs)
+    fmt.Printf(". cell updates/s: %e\n", cups)
+    fmt.Printf(". effective bandwidth: %f GB/s\n", cups * BytesPerUpdate * 1e-9)
+    // TIME:app,engine,nx,ny,threads,steps,secs,cell updates/s,GB/s as in c
+    engine := "serial"
+    if sim.procs > 1 {
+        engine = "threaded"
+    }
+    fmt.Printf("TIME:%s,%s,%d,%d,%d,%d,%f,%e,%f\n", AppName, engine, N, N,
+               sim.procs, TMax, secs, cups, cups * BytesPerUpdate * 1e-9)
+    if sim.counters != nil {
+        if err := sim.counters.Report(sim, engine); err != nil {
+            log.Fatal(err)
+        }
+    }
     err := sim.Dump()
     if (err != nil) { panic(err) }
 }
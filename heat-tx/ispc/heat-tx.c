@@ -87,6 +87,12 @@ params_destruct(simulation_params_t *params);
 int
 set_initial_conds(mesh_t *sim);
 
+static int
+source_construct(source_t **new_source, uint64_t nx, uint64_t ny);
+
+static int
+source_destruct(source_t *source);
+
 extern int32_t
 run_simulation(simulation_t *sim);
 
@@ -123,6 +129,20 @@ params_destruct(simulation_params_t *params)
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* row pitch for rows of y cells: whole cache lines, plus one more line when
+ * the rows would be a multiple of 4 KiB apart and the cells of a column
+ * would all map to the same cache sets */
+static uint64_t
+mesh_pitch(uint64_t y)
+{
+    uint64_t line = MESH_ALIGN / sizeof(double);
+    uint64_t pitch = (y + line - 1) / line * line;
+
+    if (0 == (pitch * sizeof(double)) % 4096) pitch += line;
+    return pitch;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 mesh_construct(mesh_t **new_mesh,
@@ -130,6 +150,8 @@ mesh_construct(mesh_t **new_mesh,
                int y /* number of columns */)
 {
     mesh_t *tmp_mesh = NULL;
+    void *cells = NULL;
+    uint64_t pitch = mesh_pitch(y);
     int i;
 
     if (NULL == new_mesh) return FAILURE_INVALID_ARG;
@@ -140,48 +162,93 @@ mesh_construct(mesh_t **new_mesh,
         /* just bail */
         return FAILURE_OOR;
     }
-    tmp_mesh->cells = (double **)calloc(x, sizeof(double *));
-    if (NULL == tmp_mesh->cells) {
+    /* all rows in one block, so a sweep streams through memory */
+    if (0 != posix_memalign(&cells, MESH_ALIGN,
+                            (uint64_t)x * pitch * sizeof(double))) {
         fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-        goto error;
+        free(tmp_mesh);
+        return FAILURE_OOR;
     }
-    for (i = 0; i < y; ++i) {
-        tmp_mesh->cells[i] = (double *)calloc(y, sizeof(double));
-        if (NULL == tmp_mesh->cells[i]) {
-            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-            goto error;
-        }
+    /* zero the rows in bands over the threads, like the tasks of
+     * run_simulation, so the pages of a row are first touched by, and placed
+     * on the NUMA node of, the thread that updates it */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (i = 0; i < x; ++i) {
+        (void)memset((double *)cells + (uint64_t)i * pitch, 0,
+                     pitch * sizeof(double));
     }
+    tmp_mesh->cells = (double *)cells;
     tmp_mesh->nx = x;
     tmp_mesh->ny = y;
+    tmp_mesh->pitch = pitch;
 
     *new_mesh = tmp_mesh;
     return SUCCESS;
-
-error:
-    if (NULL != tmp_mesh) free(tmp_mesh);
-    mesh_destruct(tmp_mesh);
-    return FAILURE_OOR;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 mesh_destruct(mesh_t *mesh)
 {
-    uint64_t i;
-
     if (!mesh) return FAILURE_INVALID_ARG;
-    if (mesh->cells) {
-        for (i = 0; i < mesh->ny; ++i) {
-            if (NULL != mesh->cells[i]) {
-                free(mesh->cells[i]);
-                mesh->cells[i] = NULL;
-            }
+    free(mesh->cells);
+    mesh->cells = NULL;
+    free(mesh);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* collects the cells that set_initial_conds sets on an nx x ny mesh, once, so
+ * the engine does not walk the circle every step. the source is stamped on a
+ * zeroed mesh, all of its values are non-zero */
+static int
+source_construct(source_t **new_source, uint64_t nx, uint64_t ny)
+{
+    source_t *tmp = NULL;
+    mesh_t *stamp = NULL;
+    uint64_t i, n = 0;
+    int rc = FAILURE;
+
+    if (NULL == new_source) return FAILURE_INVALID_ARG;
+
+    if (SUCCESS != (rc = mesh_construct(&stamp, nx, ny))) return rc;
+    if (SUCCESS != (rc = set_initial_conds(stamp))) goto out;
+    for (i = 0; i < nx * stamp->pitch; ++i) {
+        if (0.0 != stamp->cells[i]) ++n;
+    }
+    rc = FAILURE_OOR;
+    if (NULL == (tmp = (source_t *)calloc(1, sizeof(*tmp))) ||
+        NULL == (tmp->idx = (uint64_t *)calloc(n + 1, sizeof(uint64_t))) ||
+        NULL == (tmp->val = (double *)calloc(n + 1, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        (void)source_destruct(tmp);
+        goto out;
+    }
+    tmp->ncells = n;
+    for (n = 0, i = 0; i < nx * stamp->pitch; ++i) {
+        if (0.0 != stamp->cells[i]) {
+            tmp->idx[n] = i;
+            tmp->val[n] = stamp->cells[i];
+            ++n;
         }
-        free(mesh->cells);
-        mesh->cells = NULL;
     }
-    free(mesh);
+    *new_source = tmp;
+    rc = SUCCESS;
+out:
+    (void)mesh_destruct(stamp);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+source_destruct(source_t *source)
+{
+    if (!source) return FAILURE_INVALID_ARG;
+    free(source->idx);
+    free(source->val);
+    free(source);
     return SUCCESS;
 }
 
@@ -215,6 +282,7 @@ simulation_destruct(simulation_t *sim)
 {
     if (!sim) return FAILURE_INVALID_ARG;
     (void)params_destruct(sim->params);
+    (void)source_destruct(sim->source);
     (void)mesh_destruct(sim->new_mesh);
     (void)mesh_destruct(sim->old_mesh);
     free(sim);
@@ -250,6 +318,11 @@ simulation_construct(simulation_t **new_sim,
         /* on failure, gen_meshes cleans up after itself */
         goto out;
     }
+    if (SUCCESS != (rc = source_construct(&sim->source, N, N))) {
+        fprintf(stderr, "source_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
     *new_sim = sim;
 out:
     return rc;
@@ -296,7 +369,7 @@ dump(const simulation_t *sim)
     /* write the matrix */
     for (i = 0; i < sim->new_mesh->nx; ++i) {
         for (j = 0; j < sim->new_mesh->ny; ++j) {
-            fprintf(imgfp, "%lf%s", sim->new_mesh->cells[i][j],
+            fprintf(imgfp, "%lf%s", MESH_ROW(sim->new_mesh, i)[j],
                     (j == sim->new_mesh->ny - 1) ? "" : " ");
         }
         fprintf(imgfp, "\n");
@@ -318,14 +391,14 @@ set_initial_conds(mesh_t *mesh)
     int radius_err = 1 - x;
 
     while (x >= y) {
-        mesh->cells[ x + x0][ y + y0] = K * .50;
-        mesh->cells[ y + x0][ x + y0] = K * .60;
-        mesh->cells[-x + x0][ y + y0] = K * .70;
-        mesh->cells[-y + x0][ x + y0] = K * .80;
-        mesh->cells[-x + x0][-y + y0] = K * .70;
-        mesh->cells[-y + x0][-x + y0] = K * .60;
-        mesh->cells[ x + x0][-y + y0] = K * .50;
-        mesh->cells[ y + x0][-x + y0] = K;
+        MESH_ROW(mesh,  x + x0)[ y + y0] = K * .50;
+        MESH_ROW(mesh,  y + x0)[ x + y0] = K * .60;
+        MESH_ROW(mesh, -x + x0)[ y + y0] = K * .70;
+        MESH_ROW(mesh, -y + x0)[ x + y0] = K * .80;
+        MESH_ROW(mesh, -x + x0)[-y + y0] = K * .70;
+        MESH_ROW(mesh, -y + x0)[-x + y0] = K * .60;
+        MESH_ROW(mesh,  x + x0)[-y + y0] = K * .50;
+        MESH_ROW(mesh,  y + x0)[-x + y0] = K;
         y++;
         if (radius_err < 0) radius_err += 2 * y + 1;
         else {
@@ -88,14 +88,22 @@ typedef struct {
 #endif
     /* mesh size in x and y */
     uniform uint64_t nx, ny;
-    /* mesh cells */
-    uniform double *uniform *uniform cells;
+    /* cells from the start of one row to the start of the next, ny padded */
+    uniform uint64_t pitch;
+    /* mesh cells, nx rows of pitch cells in one aligned block */
+    uniform double *uniform cells;
 #ifdef ISPC
 };
 #else
 } mesh_t;
 #endif
 
+/* alignment of the mesh cells and of every row in bytes */
+#define MESH_ALIGN 64
+
+/* row i of mesh m */
+#define MESH_ROW(m, i) ((m)->cells + (uint64_t)(i) * (m)->pitch)
+
 /* simulation parameters */
 #ifdef ISPC
 struct simulation_params_t {
@@ -115,6 +123,22 @@ typedef struct {
 } simulation_params_t;
 #endif
 
+/* the cells set by the constant heat source, as offsets into the cells of a
+ * mesh and their values */
+#ifdef ISPC
+struct source_t {
+#else
+typedef struct {
+#endif
+    uniform uint64_t ncells;
+    uniform uint64_t *uniform idx;
+    uniform double *uniform val;
+#ifdef ISPC
+};
+#else
+} source_t;
+#endif
+
 #ifdef ISPC
 struct simulation_t {
 #else
@@ -123,6 +147,8 @@ typedef struct {
     /* the meshes */
     uniform mesh_t *uniform old_mesh;
     uniform mesh_t *uniform new_mesh;
+    /* the heat source of the meshes */
+    uniform source_t *uniform source;
     /* simulation parameters */
     uniform simulation_params_t *uniform params;
 #ifdef ISPC
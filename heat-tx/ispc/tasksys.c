@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* The task runtime that ISPC's launch and sync compile to calls into, run on
+ * OpenMP threads. A launch runs all of its tasks before it returns, which
+ * sync allows, so sync only has to free the argument blocks of the launches
+ * made since the last one. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef void (*task_fn_t)(void *data,
+                          int thread_index, int thread_count,
+                          int task_index, int task_count,
+                          int task_index0, int task_index1, int task_index2,
+                          int task_count0, int task_count1, int task_count2);
+
+/* argument block of a launch; *handle is the list of them */
+typedef struct task_mem_t {
+    struct task_mem_t *next;
+    void *mem;
+} task_mem_t;
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void *
+ISPCAlloc(void **handle, int64_t size, int32_t alignment)
+{
+    task_mem_t *node = NULL;
+    void *mem = NULL;
+
+    if (NULL == (node = (task_mem_t *)malloc(sizeof(*node)))) return NULL;
+    if (alignment < (int32_t)sizeof(void *)) alignment = sizeof(void *);
+    if (0 != posix_memalign(&mem, alignment, size)) {
+        free(node);
+        return NULL;
+    }
+    node->mem = mem;
+    node->next = (task_mem_t *)*handle;
+    *handle = node;
+    return mem;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+ISPCLaunch(void **handle, void *f, void *data,
+           int count0, int count1, int count2)
+{
+    task_fn_t fn = (task_fn_t)f;
+    int count = count0 * count1 * count2;
+    int i;
+
+    (void)handle;
+    /* a static split keeps task i on the same thread from step to step, and
+     * on the pages it first touched */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (i = 0; i < count; ++i) {
+#ifdef _OPENMP
+        int thread = omp_get_thread_num(), nthreads = omp_get_num_threads();
+#else
+        int thread = 0, nthreads = 1;
+#endif
+        fn(data, thread, nthreads, i, count,
+           i % count0, (i / count0) % count1, i / (count0 * count1),
+           count0, count1, count2);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+ISPCSync(void *handle)
+{
+    task_mem_t *node = (task_mem_t *)handle, *next;
+
+    while (NULL != node) {
+        next = node->next;
+        free(node->mem);
+        free(node);
+        node = next;
+    }
+}
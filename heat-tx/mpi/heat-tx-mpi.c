@@ -0,0 +1,678 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* the heat-tx simulation on an MPI 2D Cartesian process grid. every rank
+ * holds a block of the mesh with a one cell halo, posts the halo exchange of
+ * a step, updates the cells that do not need the halo while it is in flight,
+ * then finishes the cells along the edges of the block. the numbers are the
+ * same as those of the C heat-tx at any process count
+ *
+ * usage: mpirun -np <p> heat-tx-mpi [--nx n] [--ny n] [--n n] [--c c]
+ *                                   [--max-t t] [--blocking]
+ *                                   [--dump-format text|none] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <mpi.h>
+
+#include "heat-tx.h"
+#include "cody_perf.h"
+
+static char *app_name = "mpi-heat-tx";
+static char *app_ver = "0.1";
+
+/* max simulation time */
+#define T_MAX 1024
+/* nx and ny */
+#define N 512
+/* thermal conductivity */
+#define THERM_COND 0.6
+/* some constant */
+#define K 0.4
+/* bytes moved per cell update, as in the C heat-tx */
+#define BYTES_PER_UPDATE (2 * sizeof(double))
+
+/* halo exchange tags, by the direction the data moves */
+enum {
+    TAG_SOUTH = 0,
+    TAG_NORTH,
+    TAG_EAST,
+    TAG_WEST
+};
+
+/* the block of the mesh of one rank */
+typedef struct block_t {
+    /* global mesh size */
+    uint64_t gnx, gny;
+    /* block size and global index of its first row and column */
+    uint64_t nx, ny, x0, y0;
+    /* cells from one row to the next, the rows are ny + 2 cells with the
+     * halo */
+    uint64_t pitch;
+    /* step t is held by cells[t % 2], (nx + 2) x pitch cells each, the
+     * block cell (i, j) is at row i + 1 and column j + 1 */
+    double *cells[2];
+    /* rows ib .. ie - 1 and columns jb .. je - 1 in halo coordinates are
+     * updated, the others are global edges or halo */
+    uint64_t ib, ie, jb, je;
+    /* the source cells of the block as offsets into cells and values */
+    uint64_t nsrc;
+    uint64_t *src_off;
+    double *src_val;
+    /* the process grid and the neighbours, MPI_PROC_NULL on the edges */
+    MPI_Comm cart;
+    int north, south, west, east;
+    /* a column of the block */
+    MPI_Datatype column;
+} block_t;
+
+/* the run as given on the command line */
+typedef struct app_opts_t {
+    int nx, ny;
+    double c;
+    int max_t;
+    bool blocking;
+    bool dump;
+} app_opts_t;
+
+static struct option long_opts[] = {
+    {"help",        no_argument,       0, 'h'},
+    {"nx",          required_argument, 0, 'x'},
+    {"ny",          required_argument, 0, 'y'},
+    {"n",           required_argument, 0, 'n'},
+    {"c",           required_argument, 0, 'c'},
+    {"max-t",       required_argument, 0, 't'},
+    {"blocking",    no_argument,       0, 'B'},
+    {"dump-format", required_argument, 0, 'f'},
+    {0, 0, 0, 0}
+};
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the part of n cells of process p of np, the first n % np parts one larger */
+static void
+split(uint64_t n, int np, int p, uint64_t *len, uint64_t *off)
+{
+    uint64_t q = n / np, r = n % np;
+
+    *len = q + ((uint64_t)p < r ? 1 : 0);
+    *off = q * p + ((uint64_t)p < r ? (uint64_t)p : r);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static inline double *
+block_row(const block_t *b, int m, uint64_t i)
+{
+    return b->cells[m] + i * b->pitch;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the circle of set_initial_conds in the C heat-tx, in global coordinates,
+ * stamped on the cells of the block in mesh, which has no halo */
+static void
+stamp_circle(const block_t *b, double *mesh)
+{
+    int64_t x0 = b->gnx / 2;
+    int64_t y0 = b->gny / 2;
+    int64_t x = ((b->gnx < b->gny) ? b->gnx : b->gny) / 4, y = 0;
+    int64_t radius_err = 1 - x;
+
+#define STAMP(gi, gj, v)                                                      \
+    do {                                                                      \
+        int64_t li = (gi) - (int64_t)b->x0, lj = (gj) - (int64_t)b->y0;        \
+        if (li >= 0 && li < (int64_t)b->nx && lj >= 0 &&                      \
+            lj < (int64_t)b->ny) {                                            \
+            mesh[li * b->ny + lj] = (v);                                      \
+        }                                                                     \
+    } while (0)
+
+    while (x >= y) {
+        STAMP( x + x0,  y + y0, K * .50);
+        STAMP( y + x0,  x + y0, K * .60);
+        STAMP(-x + x0,  y + y0, K * .70);
+        STAMP(-y + x0,  x + y0, K * .80);
+        STAMP(-x + x0, -y + y0, K * .70);
+        STAMP(-y + x0, -x + y0, K * .60);
+        STAMP( x + x0, -y + y0, K * .50);
+        STAMP( y + x0, -x + y0, K);
+        y++;
+        if (radius_err < 0) radius_err += 2 * y + 1;
+        else {
+            --x;
+            radius_err += 2 * (y - x + 1);
+        }
+    }
+#undef STAMP
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* collects the source cells of the block. as in the C heat-tx the circle is
+ * stamped on a zeroed block first, so a cell stamped twice keeps its last
+ * value, and all of the values are non-zero */
+static int
+block_source_construct(block_t *b)
+{
+    double *stamp = NULL;
+    uint64_t i, j, n = 0;
+
+    if (NULL == (stamp = (double *)calloc(b->nx * b->ny, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    stamp_circle(b, stamp);
+    for (i = 0; i < b->nx * b->ny; ++i) {
+        if (0.0 != stamp[i]) ++n;
+    }
+    b->src_off = (uint64_t *)calloc(n + 1, sizeof(uint64_t));
+    b->src_val = (double *)calloc(n + 1, sizeof(double));
+    if (NULL == b->src_off || NULL == b->src_val) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        free(stamp);
+        return FAILURE_OOR;
+    }
+    for (n = 0, i = 0; i < b->nx; ++i) {
+        for (j = 0; j < b->ny; ++j) {
+            if (0.0 != stamp[i * b->ny + j]) {
+                b->src_off[n] = (i + 1) * b->pitch + j + 1;
+                b->src_val[n] = stamp[i * b->ny + j];
+                ++n;
+            }
+        }
+    }
+    b->nsrc = n;
+    free(stamp);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+block_source_apply(const block_t *b, int m)
+{
+    uint64_t k;
+
+    for (k = 0; k < b->nsrc; ++k) b->cells[m][b->src_off[k]] = b->src_val[k];
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+block_destruct(block_t *b)
+{
+    if (!b) return FAILURE_INVALID_ARG;
+    if (MPI_DATATYPE_NULL != b->column) MPI_Type_free(&b->column);
+    if (MPI_COMM_NULL != b->cart) MPI_Comm_free(&b->cart);
+    free(b->cells[0]);
+    free(b->cells[1]);
+    free(b->src_off);
+    free(b->src_val);
+    free(b);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the block of this rank of an nx x ny mesh on the process grid that
+ * MPI_Dims_create picks, with step 0 set */
+static int
+block_construct(block_t **new_block, uint64_t nx, uint64_t ny)
+{
+    block_t *b = NULL;
+    int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2];
+    int nprocs, rank, m, rc = FAILURE;
+    uint64_t line = MESH_ALIGN / sizeof(double);
+    void *cells;
+
+    if (NULL == new_block) return FAILURE_INVALID_ARG;
+
+    if (NULL == (b = (block_t *)calloc(1, sizeof(*b)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    b->cart = MPI_COMM_NULL;
+    b->column = MPI_DATATYPE_NULL;
+
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    MPI_Dims_create(nprocs, 2, dims);
+    if ((uint64_t)dims[0] > nx || (uint64_t)dims[1] > ny) {
+        fprintf(stderr, "%dx%d process grid too large for the mesh @ %s:%d\n",
+                dims[0], dims[1], __FILE__, __LINE__);
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &b->cart);
+    MPI_Comm_rank(b->cart, &rank);
+    MPI_Cart_coords(b->cart, rank, 2, coords);
+    MPI_Cart_shift(b->cart, 0, 1, &b->north, &b->south);
+    MPI_Cart_shift(b->cart, 1, 1, &b->west, &b->east);
+
+    b->gnx = nx;
+    b->gny = ny;
+    split(nx, dims[0], coords[0], &b->nx, &b->x0);
+    split(ny, dims[1], coords[1], &b->ny, &b->y0);
+    b->pitch = (b->ny + 2 + line - 1) / line * line;
+    /* the global edges stay fixed */
+    b->ib = (0 == b->x0) ? 2 : 1;
+    b->ie = (nx == b->x0 + b->nx) ? b->nx : b->nx + 1;
+    b->jb = (0 == b->y0) ? 2 : 1;
+    b->je = (ny == b->y0 + b->ny) ? b->ny : b->ny + 1;
+
+    for (m = 0; m < 2; ++m) {
+        if (0 != posix_memalign(&cells, MESH_ALIGN,
+                                (b->nx + 2) * b->pitch * sizeof(double))) {
+            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+            rc = FAILURE_OOR;
+            goto out;
+        }
+        b->cells[m] = (double *)cells;
+        (void)memset(cells, 0, (b->nx + 2) * b->pitch * sizeof(double));
+    }
+    MPI_Type_vector(b->nx, 1, b->pitch, MPI_DOUBLE, &b->column);
+    MPI_Type_commit(&b->column);
+
+    if (SUCCESS != (rc = block_source_construct(b))) goto out;
+    /* the initial conditions of step 0 */
+    block_source_apply(b, 0);
+    *new_block = b;
+out:
+    if (SUCCESS != rc) (void)block_destruct(b);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* posts the exchange of the edges of cells[m] with the halos of the
+ * neighbours */
+static void
+halo_post(const block_t *b, int m, MPI_Request req[8])
+{
+    uint64_t nx = b->nx, ny = b->ny;
+
+    MPI_Irecv(block_row(b, m, 0) + 1, ny, MPI_DOUBLE, b->north, TAG_SOUTH,
+              b->cart, &req[0]);
+    MPI_Irecv(block_row(b, m, nx + 1) + 1, ny, MPI_DOUBLE, b->south,
+              TAG_NORTH, b->cart, &req[1]);
+    MPI_Irecv(block_row(b, m, 1), 1, b->column, b->west, TAG_EAST, b->cart,
+              &req[2]);
+    MPI_Irecv(block_row(b, m, 1) + ny + 1, 1, b->column, b->east, TAG_WEST,
+              b->cart, &req[3]);
+    MPI_Isend(block_row(b, m, nx) + 1, ny, MPI_DOUBLE, b->south, TAG_SOUTH,
+              b->cart, &req[4]);
+    MPI_Isend(block_row(b, m, 1) + 1, ny, MPI_DOUBLE, b->north, TAG_NORTH,
+              b->cart, &req[5]);
+    MPI_Isend(block_row(b, m, 1) + ny, 1, b->column, b->east, TAG_EAST,
+              b->cart, &req[6]);
+    MPI_Isend(block_row(b, m, 1) + 1, 1, b->column, b->west, TAG_WEST,
+              b->cart, &req[7]);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* updates rows i0 .. i1 - 1 and columns j0 .. j1 - 1 of cells[m + 1] from
+ * cells[m], the same stencil as the C heat-tx */
+static void
+update(const block_t *b, int m, uint64_t i0, uint64_t i1, uint64_t j0,
+       uint64_t j1, double cdtods2)
+{
+    uint64_t i, j;
+
+    for (i = i0; i < i1; ++i) {
+        const double *oci = block_row(b, m, i);
+        const double *ocip = oci - b->pitch;
+        const double *ocin = oci + b->pitch;
+        double *nci = block_row(b, m ^ 1, i);
+
+        for (j = j0; j < j1; ++j) {
+            nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
+                               oci[j] + oci[j + 1] + oci[j - 1]));
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one step from cells[t % 2]. with overlap the cells two or more in from the
+ * edges of the block, which only read the block, are updated while the halo
+ * exchange is in flight, and the rows and columns along the edges after it.
+ * without it the exchange completes first */
+static void
+step(const block_t *b, uint64_t t, double cdtods2, bool overlap)
+{
+    int m = t % 2;
+    uint64_t ib = b->ib, ie = b->ie, jb = b->jb, je = b->je;
+    /* the cells that do not read the halo */
+    uint64_t iib = (ib > 2) ? ib : 2, iie = (ie < b->nx) ? ie : b->nx;
+    uint64_t ijb = (jb > 2) ? jb : 2, ije = (je < b->ny) ? je : b->ny;
+    MPI_Request req[8];
+
+    halo_post(b, m, req);
+    if (!overlap) {
+        MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+        update(b, m, ib, ie, jb, je, cdtods2);
+    } else {
+        if (iib < iie && ijb < ije) update(b, m, iib, iie, ijb, ije, cdtods2);
+        MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+        /* rows 1 and nx, then columns 1 and ny of the rows in between */
+        if (1 == ib && ie > 1) update(b, m, 1, 2, jb, je, cdtods2);
+        if (ie == b->nx + 1 && b->nx > 1) {
+            update(b, m, b->nx, b->nx + 1, jb, je, cdtods2);
+        }
+        if (iib < iie) {
+            if (1 == jb && je > 1) update(b, m, iib, iie, 1, 2, cdtods2);
+            if (je == b->ny + 1 && b->ny > 1) {
+                update(b, m, iib, iie, b->ny, b->ny + 1, cdtods2);
+            }
+        }
+    }
+    /* constant heat source */
+    block_source_apply(b, m ^ 1);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* gathers cells[m] on rank 0 and writes it as the C heat-tx does */
+static int
+block_dump(const block_t *b, int m)
+{
+    int rank, nprocs, r, coords[2], dims[2], periods[2];
+    double *mesh = NULL, *buf = NULL;
+    uint64_t i, j, len[2], off[2];
+    FILE *imgfp = NULL;
+    int rc = SUCCESS;
+
+    MPI_Comm_rank(b->cart, &rank);
+    MPI_Comm_size(b->cart, &nprocs);
+    if (0 == rank) {
+        mesh = (double *)malloc(b->gnx * b->gny * sizeof(double));
+        /* the blocks of rank 0 are the largest, split gives the remainder
+         * to the first ones */
+        buf = (double *)malloc(b->nx * b->ny * sizeof(double));
+        if (NULL == mesh || NULL == buf) {
+            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+            rc = FAILURE_OOR;
+        }
+    }
+    MPI_Bcast(&rc, 1, MPI_INT, 0, b->cart);
+    if (SUCCESS != rc) goto out;
+
+    if (0 != rank) {
+        /* the block without the halo */
+        MPI_Datatype block;
+        int sizes[2] = {(int)b->nx + 2, (int)b->pitch};
+        int subsizes[2] = {(int)b->nx, (int)b->ny};
+        int starts[2] = {1, 1};
+
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C,
+                                 MPI_DOUBLE, &block);
+        MPI_Type_commit(&block);
+        MPI_Send(b->cells[m], 1, block, 0, 0, b->cart);
+        MPI_Type_free(&block);
+        MPI_Bcast(&rc, 1, MPI_INT, 0, b->cart);
+        return rc;
+    }
+
+    MPI_Cart_get(b->cart, 2, dims, periods, coords);
+    for (r = 0; r < nprocs; ++r) {
+        MPI_Cart_coords(b->cart, r, 2, coords);
+        split(b->gnx, dims[0], coords[0], &len[0], &off[0]);
+        split(b->gny, dims[1], coords[1], &len[1], &off[1]);
+        if (0 == r) {
+            for (i = 0; i < len[0]; ++i) {
+                (void)memcpy(buf + i * len[1], block_row(b, m, i + 1) + 1,
+                             len[1] * sizeof(double));
+            }
+        } else {
+            MPI_Recv(buf, (int)(len[0] * len[1]), MPI_DOUBLE, r, 0, b->cart,
+                     MPI_STATUS_IGNORE);
+        }
+        for (i = 0; i < len[0]; ++i) {
+            (void)memcpy(mesh + (off[0] + i) * b->gny + off[1],
+                         buf + i * len[1], len[1] * sizeof(double));
+        }
+    }
+    if (NULL == (imgfp = fopen("heat-img.dat", "wb"))) {
+        fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
+        rc = FAILURE_IO;
+    } else {
+        /* write the matrix */
+        for (i = 0; i < b->gnx; ++i) {
+            for (j = 0; j < b->gny; ++j) {
+                fprintf(imgfp, "%lf%s", mesh[i * b->gny + j],
+                        (j == b->gny - 1) ? "" : " ");
+            }
+            fprintf(imgfp, "\n");
+        }
+        fclose(imgfp);
+    }
+    MPI_Bcast(&rc, 1, MPI_INT, 0, b->cart);
+out:
+    free(buf);
+    free(mesh);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+usage(void)
+{
+    int rank;
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (0 != rank) return;
+    printf("usage: mpirun -np <p> heat-tx-mpi [--nx n] [--ny n] [--n n] "
+           "[--c c] [--max-t t] [--blocking] [--dump-format text|none]\n");
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+parse_int(const char *arg, int min, int *val)
+{
+    char *end = NULL;
+    long v = strtol(arg, &end, 10);
+
+    if ('\0' == *arg || '\0' != *end || v < min || v > INT32_MAX) {
+        return FAILURE_INVALID_ARG;
+    }
+    *val = (int)v;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+get_opts(app_opts_t *opts, int argc, char **argv)
+{
+    char *end = NULL;
+    int c, rc;
+
+    opts->nx = opts->ny = N;
+    opts->c = THERM_COND;
+    opts->max_t = T_MAX;
+    opts->blocking = false;
+    opts->dump = true;
+
+    while (-1 != (c = getopt_long(argc, argv, "hx:y:n:c:t:Bf:", long_opts,
+                                  NULL))) {
+        rc = SUCCESS;
+        switch (c) {
+        case 'h': usage(); return FAILURE;
+        /* the source circle needs a mesh of at least 4 x 4 */
+        case 'x': rc = parse_int(optarg, 4, &opts->nx); break;
+        case 'y': rc = parse_int(optarg, 4, &opts->ny); break;
+        case 'n':
+            if (SUCCESS == (rc = parse_int(optarg, 4, &opts->nx))) {
+                opts->ny = opts->nx;
+            }
+            break;
+        case 'c':
+            opts->c = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || opts->c <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 't': rc = parse_int(optarg, 0, &opts->max_t); break;
+        case 'B': opts->blocking = true; break;
+        case 'f':
+            if (0 == strcmp(optarg, "none")) opts->dump = false;
+            else if (0 != strcmp(optarg, "text")) rc = FAILURE_INVALID_ARG;
+            break;
+        default: rc = FAILURE_INVALID_ARG;
+        }
+        if (SUCCESS != rc) {
+            if ('?' != c) fprintf(stderr, "invalid -%c %s\n", c, optarg);
+            usage();
+            return rc;
+        }
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+main(int argc, char **argv)
+{
+    int rc = FAILURE;
+    int erc = EXIT_FAILURE;
+    int rank, nprocs;
+    simulation_params_t *params = NULL;
+    block_t *b = NULL;
+    app_opts_t opts;
+    double ds2, cdtods2, secs, cups;
+    uint64_t t;
+    int r_run, r_dump;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+    /* print application banner */
+    if (0 == rank) printf("o %s %s\n", app_name, app_ver);
+    cody_init("heat-tx");
+    r_run = cody_region("run");
+    r_dump = cody_region("dump");
+
+    /* all ranks see the same arguments and fail together */
+    if (SUCCESS != (rc = get_opts(&opts, argc, argv))) goto cleanup;
+    if (SUCCESS != (rc = params_construct(&params))) {
+        fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto cleanup;
+    }
+    /* the same parameters as the C heat-tx */
+    if (SUCCESS != (rc = init_params(params, opts.nx, opts.ny, opts.c,
+                                     opts.max_t))) {
+        fprintf(stderr, "init_params failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto cleanup;
+    }
+    if (0 == rank) {
+        (void)print_params(params);
+        printf(". nprocs: %d\n", nprocs);
+        printf(". overlap: %s\n\n", opts.blocking ? "no" : "yes");
+    }
+    rc = block_construct(&b, params->nx, params->ny);
+    MPI_Allreduce(MPI_IN_PLACE, &rc, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (SUCCESS != rc) {
+        if (0 == rank) {
+            fprintf(stderr, "block_construct failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+        }
+        goto cleanup;
+    }
+    ds2 = params->delta_s * params->delta_s;
+    cdtods2 = (params->c * params->delta_t) / ds2;
+
+    if (0 == rank) printf("o starting simulation...\n");
+    MPI_Barrier(b->cart);
+    cody_region_begin(r_run);
+    for (t = 0; t < params->max_t; ++t) {
+        if (0 == rank && 0 == t % 100) {
+            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t,
+                   params->max_t);
+        }
+        step(b, t, cdtods2, !opts.blocking);
+    }
+    MPI_Barrier(b->cart);
+    cody_region_end(r_run);
+    secs = cody_region_secs(r_run);
+    cups = (secs > 0.0) ? (double)(opts.nx - 2) * (double)(opts.ny - 2) *
+                          (double)params->max_t / secs : 0.0;
+
+    if (0 == rank) {
+        printf("o run time: %lf s\n", secs);
+        printf(". cell updates/s: %e\n", cups);
+        printf(". effective bandwidth: %lf GB/s\n",
+               cups * BYTES_PER_UPDATE * 1.0e-9);
+        /* TIME:app,engine,nx,ny,nprocs,steps,secs,cell updates/s,GB/s */
+        printf("TIME:%s,%s,%d,%d,%d,%"PRIu64",%lf,%e,%lf\n", app_name,
+               opts.blocking ? "mpi" : "mpi-overlap", opts.nx, opts.ny,
+               nprocs, params->max_t, secs, cups,
+               cups * BYTES_PER_UPDATE * 1.0e-9);
+    }
+    /* the second mesh, as the C heat-tx writes */
+    cody_region_begin(r_dump);
+    if (opts.dump) rc = block_dump(b, 1);
+    cody_region_end(r_dump);
+    if (SUCCESS != rc) {
+        if (0 == rank) {
+            fprintf(stderr, "dump failure @ %s:%d: rc = %d\n", __FILE__,
+                    __LINE__, rc);
+        }
+        goto cleanup;
+    }
+    /* as the rows shared by the mini-apps, after the dump as the C heat-tx,
+     * the rate timed on rank 0 between the barriers */
+    if (0 == rank) {
+        cody_report(opts.blocking ? "mpi" : "mpi-overlap", nprocs, 1,
+                    (double)(opts.nx - 2) * (double)(opts.ny - 2),
+                    (double)params->max_t, secs);
+        cody_metric("GBs", cups * BYTES_PER_UPDATE * 1.0e-9);
+    }
+    /* all is well */
+    erc = EXIT_SUCCESS;
+
+cleanup:
+    cody_finish();
+    if (NULL != b) (void)block_destruct(b);
+    (void)params_destruct(params);
+    MPI_Finalize();
+    return erc;
+}
@@ -0,0 +1,304 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file AgglomeratedMG.hpp
+
+    The coarse levels of the V-cycle solved on the whole level by every shard
+    (--agglomerate=ROWS): below a few thousand global rows, the work of a level
+    is less than its halo exchanges and the tasks launched for it. The
+    residual of the first such level is gathered onto every shard by one
+    allReduce of an AgglomeratedVector, each shard runs the V-cycle of that
+    level and of the ones below it on the global problem, and keeps the rows
+    of the correction that it owns. Every shard computes the same correction.
+
+    The global levels are generated here as GenerateProblem and
+    GenerateCoarseProblem would on one shard, so the rows are numbered
+    globally, gix + gnx * (giy + gny * giz). SYMGS sweeps all of them in turn,
+    a Gauss-Seidel on the whole level instead of one per shard, which may
+    change the number of CG iterations.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+#include "CollectiveOps.hpp"
+#include "Geometry.hpp"
+#include "hpcg.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+/**
+ * One global level of an AgglomeratedMG, the matrix row-major with
+ * HPCG_STENCIL entries per row, of which the first nonzerosInRow are used.
+ */
+struct AgglomeratedLevel {
+    local_int_t gnx = 0, gny = 0, gnz = 0;
+    //
+    local_int_t nrow = 0;
+    //
+    std::vector<char> nonzerosInRow;
+    //
+    std::vector<local_int_t> cols;
+    //
+    std::vector<matrixFloatType> values;
+    //
+    std::vector<matrixFloatType> diagonal;
+    // Fine row of each row of the next level, empty on the coarsest.
+    std::vector<local_int_t> f2c;
+    // Right-hand side and solution.
+    std::vector<floatType> r, x;
+};
+
+/**
+ * The 27-point problem of a gnx by gny by gnz grid, the values of
+ * GenerateProblem.
+ */
+inline void
+AgglomeratedLevelGenerate(
+    AgglomeratedLevel &l,
+    local_int_t gnx,
+    local_int_t gny,
+    local_int_t gnz
+) {
+    l.gnx = gnx; l.gny = gny; l.gnz = gnz;
+    l.nrow = gnx * gny * gnz;
+    l.nonzerosInRow.assign(l.nrow, 0);
+    l.cols.assign(l.nrow * HPCG_STENCIL, 0);
+    l.values.assign(l.nrow * HPCG_STENCIL, 0.0);
+    l.diagonal.assign(l.nrow, 0.0);
+    l.r.assign(l.nrow, 0.0);
+    l.x.assign(l.nrow, 0.0);
+    //
+    for (local_int_t iz = 0; iz < gnz; ++iz) {
+        for (local_int_t iy = 0; iy < gny; ++iy) {
+            for (local_int_t ix = 0; ix < gnx; ++ix) {
+                const local_int_t row = iz * gnx * gny + iy * gnx + ix;
+                local_int_t *const cols = &l.cols[row * HPCG_STENCIL];
+                matrixFloatType *const vals = &l.values[row * HPCG_STENCIL];
+                int nnz = 0;
+                for (int sz = -1; sz <= 1; ++sz) {
+                    if (iz + sz < 0 || iz + sz >= gnz) continue;
+                    for (int sy = -1; sy <= 1; ++sy) {
+                        if (iy + sy < 0 || iy + sy >= gny) continue;
+                        for (int sx = -1; sx <= 1; ++sx) {
+                            if (ix + sx < 0 || ix + sx >= gnx) continue;
+                            const local_int_t col =
+                                row + sz * gnx * gny + sy * gnx + sx;
+                            vals[nnz] = (col == row) ? 26.0 : -1.0;
+                            cols[nnz++] = col;
+                        }
+                    }
+                }
+                l.nonzerosInRow[row] = char(nnz);
+                l.diagonal[row] = 26.0;
+            }
+        }
+    }
+}
+
+/**
+ * The fine row of each row of the coarse level c of level f, every other
+ * point of the fine grid, as GenerateCoarseProblem picks them.
+ */
+inline void
+AgglomeratedLevelCoarsen(
+    AgglomeratedLevel &f,
+    const AgglomeratedLevel &c
+) {
+    f.f2c.assign(c.nrow, 0);
+    for (local_int_t izc = 0; izc < c.gnz; ++izc) {
+        for (local_int_t iyc = 0; iyc < c.gny; ++iyc) {
+            for (local_int_t ixc = 0; ixc < c.gnx; ++ixc) {
+                const local_int_t rowc =
+                    izc * c.gnx * c.gny + iyc * c.gnx + ixc;
+                f.f2c[rowc] =
+                    2 * izc * f.gnx * f.gny + 2 * iyc * f.gnx + 2 * ixc;
+            }
+        }
+    }
+}
+
+/**
+ * One forward and one backward Gauss-Seidel sweep of l.x for l.r over all the
+ * rows of l, as ComputeSYMGS does over the rows of a shard.
+ */
+inline void
+AgglomeratedSYMGS(
+    AgglomeratedLevel &l
+) {
+    floatType *const x = l.x.data();
+    const floatType *const r = l.r.data();
+    //
+    auto relax = [&](local_int_t i) {
+        const local_int_t *const cols = &l.cols[i * HPCG_STENCIL];
+        const matrixFloatType *const vals = &l.values[i * HPCG_STENCIL];
+        const int nnz = l.nonzerosInRow[i];
+        const floatType diag = l.diagonal[i];
+        floatType sum = r[i];
+        for (int j = 0; j < nnz; ++j) sum -= vals[j] * x[cols[j]];
+        // Remove the diagonal contribution from the previous loop.
+        sum += x[i] * diag;
+        x[i] = sum / diag;
+    };
+    for (local_int_t i = 0; i < l.nrow; ++i) relax(i);
+    for (local_int_t i = l.nrow - 1; i >= 0; --i) relax(i);
+}
+
+/**
+ * The V-cycle of ComputeMG on the global levels of an AgglomeratedMG, from
+ * level lev down, nPre pre- and nPost post-smoothing sweeps per level like the
+ * MGData of the levels it replaces.
+ */
+inline void
+AgglomeratedVCycle(
+    std::vector<AgglomeratedLevel> &levels,
+    size_t lev,
+    int nPre,
+    int nPost
+) {
+    AgglomeratedLevel &l = levels[lev];
+    std::fill(l.x.begin(), l.x.end(), 0.0);
+    if (lev + 1 == levels.size()) {
+        AgglomeratedSYMGS(l);
+        return;
+    }
+    AgglomeratedLevel &c = levels[lev + 1];
+    //
+    for (int k = 0; k < nPre; ++k) AgglomeratedSYMGS(l);
+    // Restriction, with A x computed only on the rows that are kept, as in
+    // ComputeRestrictionFused.
+    for (local_int_t i = 0; i < c.nrow; ++i) {
+        const local_int_t row = l.f2c[i];
+        const local_int_t *const cols = &l.cols[row * HPCG_STENCIL];
+        const matrixFloatType *const vals = &l.values[row * HPCG_STENCIL];
+        const int nnz = l.nonzerosInRow[row];
+        floatType sum = 0.0;
+        for (int j = 0; j < nnz; ++j) sum += vals[j] * l.x[cols[j]];
+        c.r[i] = l.r[row] - sum;
+    }
+    //
+    AgglomeratedVCycle(levels, lev + 1, nPre, nPost);
+    // Prolongation.
+    for (local_int_t i = 0; i < c.nrow; ++i) l.x[l.f2c[i]] += c.x[i];
+    //
+    for (int k = 0; k < nPost; ++k) AgglomeratedSYMGS(l);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The agglomerated levels of a shard, task-local, built by OptimizeProblem
+ * from the Geometry of the first of them, see ComputeAgglomeratedMG.
+ */
+class AgglomeratedMG {
+public:
+    // Global levels, the first the one agglomerated.
+    std::vector<AgglomeratedLevel> levels;
+    // This shard's part of the first level.
+    int nx = 0, ny = 0, nz = 0;
+    //
+    int ipx = 0, ipy = 0, ipz = 0;
+    // Smoothing sweeps before and after the coarse correction of each level.
+    int nPre = 1, nPost = 1;
+
+    /**
+     * The level of geom and the nLevels - 1 coarser ones.
+     */
+    AgglomeratedMG(
+        const Geometry &geom,
+        int nLevels,
+        int nPre,
+        int nPost
+    ) : levels(nLevels)
+      , nx(geom.nx), ny(geom.ny), nz(geom.nz)
+      , ipx(geom.ipx), ipy(geom.ipy), ipz(geom.ipz)
+      , nPre(nPre), nPost(nPost)
+    {
+        local_int_t gnx = geom.npx * geom.nx;
+        local_int_t gny = geom.npy * geom.ny;
+        local_int_t gnz = geom.npz * geom.nz;
+        assert(gnx * gny * gnz <= LGNCG_MAX_AGGLOMERATED_ROWS);
+        for (int lev = 0; lev < nLevels; ++lev) {
+            AgglomeratedLevelGenerate(levels[lev], gnx, gny, gnz);
+            if (lev > 0) AgglomeratedLevelCoarsen(levels[lev - 1], levels[lev]);
+            gnx /= 2; gny /= 2; gnz /= 2;
+        }
+    }
+
+    /**
+     * Global row of local row i of this shard.
+     */
+    local_int_t
+    globalRow(
+        local_int_t i
+    ) const {
+        const local_int_t ix = i % nx;
+        const local_int_t iy = (i / nx) % ny;
+        const local_int_t iz = i / (nx * ny);
+        const AgglomeratedLevel &l = levels[0];
+        return (ipz * nz + iz) * l.gnx * l.gny
+             + (ipy * ny + iy) * l.gnx
+             + (ipx * nx + ix);
+    }
+
+    /**
+     * This shard's contribution to the gathered r, its rows at their global
+     * rows and zeros elsewhere.
+     */
+    void
+    gather(
+        const floatType *const r,
+        AgglomeratedVector &lr
+    ) const {
+        lr.fill(0.0);
+        const local_int_t nrow = local_int_t(nx) * ny * nz;
+        for (local_int_t i = 0; i < nrow; ++i) lr[globalRow(i)] = r[i];
+    }
+
+    /**
+     * The V-cycle of the gathered r, and this shard's rows of the result into
+     * x.
+     */
+    void
+    solve(
+        const AgglomeratedVector &r,
+        floatType *const x
+    ) {
+        AgglomeratedLevel &l = levels[0];
+        std::copy(r.begin(), r.begin() + l.nrow, l.r.begin());
+        AgglomeratedVCycle(levels, 0, nPre, nPost);
+        const local_int_t nrow = local_int_t(nx) * ny * nz;
+        for (local_int_t i = 0; i < nrow; ++i) x[i] = l.x[globalRow(i)];
+    }
+};
@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file BlockCG.hpp
+
+    CG on k right-hand sides at once (--block=K), to amortize the traffic of
+    the matrix: the k vectors of each kind are stored interleaved, row by row,
+    so the SpMV becomes an SpMM (ComputeBlockSPMV) and SYMGS relaxes the k
+    columns of a row together (ComputeBlockSYMGS), each reading the values
+    and indices of A once for all of them. One halo exchange moves the ghosts
+    of all the columns (ExchangeBlockHalo), and the dot products of all the
+    columns go to one fused collective.
+
+    The columns are k independent CGs with the reference coefficients. The
+    kernels run in the shard task on the CSR rows of A, as those of
+    ComputeMGInline, in the natural order.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "mytimer.hpp"
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionCGData.hpp"
+#include "VectorOps.hpp"
+
+#include "ComputeSPMV.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "ComputeDotProduct.hpp"
+#include "ComputeMG.hpp"
+
+#include <cmath>
+
+// Use TICK and TOCK to time a code section in MATLAB-like fashion. With
+// --timekernels both wait for what was launched before, see syncKernelTiming.
+//!< record current time in 't0'
+#define TICK() \
+    do { syncKernelTiming(ctx, lrt); t0 = mytimer(); } while (0)
+//!< store time difference in 't' using time in 't0'
+#define TOCK(t) \
+    do { syncKernelTiming(ctx, lrt); t += mytimer() - t0; } while (0)
+
+/**
+ * The right-hand sides of the block CG: column j of bdata.b is (j + 1) * b,
+ * and bdata.x the zero initial guess, so that the scaled residuals of all the
+ * columns follow those of the reference CG, which checks the block kernels.
+ */
+inline void
+SetupBlockRHS(
+    Array<floatType> &b,
+    BlockCGData &bdata,
+    Context ctx,
+    Runtime *lrt
+) {
+    const int k = bdata.k;
+    const local_int_t nrow = b.length();
+    assert(bdata.b->length() == size_t(nrow) * k);
+    // b may still be written by the tasks launched before.
+    waitForLaunched(ctx, lrt);
+    const floatType *const bv = b.data();
+    floatType *const bbv = bdata.b->data();
+    for (local_int_t i = 0; i < nrow; ++i) {
+        for (int j = 0; j < k; ++j) bbv[size_t(i) * k + j] = (j + 1) * bv[i];
+    }
+    ZeroVectorKernel(*bdata.x);
+}
+
+/*!
+    Computes approximate solutions to AX = B for the bdata.k columns of
+    bdata.b by CG, into bdata.x. The arguments are those of CG, for all the
+    columns: niters is the number of updates of X, the loop stopping once all
+    the columns have reached tolerance, and scaledResiduals the last
+    normr / normr0 of each column.
+
+    The residual norms of an iteration are reduced with its r'z, after the
+    preconditioner apply, so a converged run applies it once more than CG.
+
+    @return Returns zero on success and a non-zero value otherwise.
+
+    @see CG()
+*/
+inline int
+BlockCG(
+    SparseMatrix       &A,
+    BlockCGData        &bdata,
+    const int          maxIter,
+    const floatType    tolerance,
+    int                &niters,
+    floatType          *scaledResiduals,
+    double             *times,
+    bool               doPreconditioning,
+    Context            ctx,
+    Runtime            *lrt
+) {
+    using namespace std;
+    // Start timing right away.
+    double t_begin = mytimer();
+    const double haloBegin = totalHaloTime(A);
+    // The kernels below read and write the mapped regions of the shard.
+    waitForLaunched(ctx, lrt);
+    //
+    const int print_freq = 10;
+    const int rank = A.geom->data()->rank;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    const int k = bdata.k;
+    assert(k > 1 && k <= LGNCG_MAX_BLOCK);
+    //
+    Future dotsFuture;
+    floatType normr[LGNCG_MAX_BLOCK], normr0[LGNCG_MAX_BLOCK];
+    floatType rtz[LGNCG_MAX_BLOCK], alpha[LGNCG_MAX_BLOCK];
+    floatType beta[LGNCG_MAX_BLOCK];
+    floatType ones[LGNCG_MAX_BLOCK], minusOnes[LGNCG_MAX_BLOCK];
+    for (int j = 0; j < k; ++j) {
+        ones[j] = 1.0;
+        minusOnes[j] = -1.0;
+        rtz[j] = 0.0;
+    }
+    double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
+    //
+    niters = 0;
+    //
+    Array<floatType> &x  = *(bdata.x);
+    Array<floatType> &b  = *(bdata.b);
+    Array<floatType> &r  = *(bdata.r);  // Residual vectors.
+    Array<floatType> &z  = *(bdata.z);  // Preconditioned residuals.
+    Array<floatType> &p  = *(bdata.p);  // Direction vectors.
+    Array<floatType> &Ap = *(bdata.Ap); // Krylov vectors.
+    //
+    Item< DynColl<FusedDots> > &dcarsFD = *A.dcAllRedSumFD;
+    // The pairs of the column dot products: r'r alone, r'z and r'r, p'Ap.
+    Array<floatType> *const rrX[] = {&r}, *const rrY[] = {&r};
+    Array<floatType> *const rzX[] = {&r, &r}, *const rzY[] = {&z, &r};
+    Array<floatType> *const pApX[] = {&p}, *const pApY[] = {&Ap};
+    // Whether all the columns reached tolerance.
+    auto converged = [&](void) {
+        for (int j = 0; j < k; ++j) {
+            if (normr[j] / normr0[j] > tolerance) return false;
+        }
+        return true;
+    };
+    //
+    if (!doPreconditioning && rank == 0) {
+        cout << "WARNING: PERFORMING UNPRECONDITIONED ITERATIONS" << endl;
+    }
+    // p is of length ncols, copy x to p for sparse MV operation
+    CopyVectorKernel(x, p);
+    //
+    TICK(); // Ap = A*x (x stored in p)
+    ComputeBlockSPMV(A, p, Ap, k, ctx, lrt);
+    TOCK(t3);
+    //
+    TICK(); // r = b - Ax
+    ComputeBlockWAXPBYKernel(nrow, k, ones, b, minusOnes, Ap, r);
+    TOCK(t2);
+    //
+    TICK();
+    ComputeBlockDotProduct(
+        nrow, k, 1, rrX, rrY, dotsFuture, t4, dcarsFD, ctx, lrt
+    );
+    FusedDots dots = dotsFuture.get_result<FusedDots>(disableWarnings);
+    TOCK(t1);
+    for (int j = 0; j < k; ++j) normr0[j] = normr[j] = sqrt(dots[j]);
+    //
+    if (rank == 0) {
+        cout << "Initial Residual (column 0) = " << normr[0] << std::endl;
+    }
+    // normr is that of the residuals after the last update.
+    bool normrCurrent = true;
+    // Start iterations.
+    for (int iter = 1; iter <= maxIter; iter++) {
+        if (normrCurrent && converged()) break;
+        //
+        TICK(); // z = M^-1 * r
+        if (doPreconditioning) {
+            ComputeBlockMG(A, r, z, k, ctx, lrt);
+        }
+        else {
+            CopyVectorKernel(r, z);
+        }
+        TOCK(t5);
+        //
+        TICK(); // rtz = r'z and normr^2 = r'r, 2k values in one collective
+        ComputeBlockDotProduct(
+            nrow, k, 2, rzX, rzY, dotsFuture, t4, dcarsFD, ctx, lrt
+        );
+        dots = dotsFuture.get_result<FusedDots>(disableWarnings);
+        TOCK(t1);
+        // The residuals of the last update.
+        if (iter > 1) {
+            for (int j = 0; j < k; ++j) normr[j] = sqrt(dots[k + j]);
+            normrCurrent = true;
+            //
+            if (rank == 0 && (iter - 1) % print_freq == 0) {
+                cout << "Iteration = "<< iter - 1
+                     << "   Scaled Residual (column 0) = "
+                     << normr[0] / normr0[0] << std::endl;
+            }
+            if (converged()) break;
+        }
+        //
+        TICK();
+        for (int j = 0; j < k; ++j) {
+            const floatType oldrtz = rtz[j];
+            rtz[j] = dots[j];
+            beta[j] = iter == 1 ? 0.0 : rtz[j] / oldrtz;
+        }
+        // p = z + beta * p
+        ComputeBlockWAXPBYKernel(nrow, k, ones, z, beta, p, p);
+        TOCK(t2);
+        //
+        TICK(); // Ap = A*p
+        ComputeBlockSPMV(A, p, Ap, k, ctx, lrt);
+        TOCK(t3);
+        //
+        TICK(); // alpha = p'Ap
+        ComputeBlockDotProduct(
+            nrow, k, 1, pApX, pApY, dotsFuture, t4, dcarsFD, ctx, lrt
+        );
+        dots = dotsFuture.get_result<FusedDots>(disableWarnings);
+        TOCK(t1);
+        for (int j = 0; j < k; ++j) {
+            alpha[j] = rtz[j] / dots[j];
+            beta[j] = -alpha[j];
+        }
+        //
+        TICK(); // x = x + alpha*p, r = r - alpha*Ap
+        ComputeBlockWAXPBYKernel(nrow, k, ones, x, alpha, p, x);
+        ComputeBlockWAXPBYKernel(nrow, k, ones, r, beta, Ap, r);
+        TOCK(t2);
+        //
+        normrCurrent = false;
+        niters = iter;
+    }
+    // The residuals after the last update, if the loop did not stop on them.
+    if (!normrCurrent) {
+        TICK();
+        ComputeBlockDotProduct(
+            nrow, k, 1, rrX, rrY, dotsFuture, t4, dcarsFD, ctx, lrt
+        );
+        dots = dotsFuture.get_result<FusedDots>(disableWarnings);
+        TOCK(t1);
+        for (int j = 0; j < k; ++j) normr[j] = sqrt(dots[j]);
+    }
+    for (int j = 0; j < k; ++j) scaledResiduals[j] = normr[j] / normr0[j];
+    if (rank == 0 && niters > 0) {
+        cout << "Iteration = "<< niters << "   Scaled Residual (column 0) = "
+             << scaledResiduals[0] << std::endl;
+    }
+    // Store times.
+    times[1] += t1; // Dot product time.
+    times[2] += t2; // WAXPBY time.
+    times[3] += t3; // SPMV time.
+    times[4] += t4; // AllReduce time.
+    times[5] += t5; // Preconditioner apply time.
+    syncKernelTiming(ctx, lrt);
+    t6 = totalHaloTime(A) - haloBegin;
+    times[6] += t6; // Exchange halo time.
+    times[0] += mytimer() - t_begin;  // Total time. All done...
+    //
+    return 0;
+}
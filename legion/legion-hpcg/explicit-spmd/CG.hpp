@@ -63,14 +63,40 @@
 #include "FutureMath.hpp"
 
 #include <fstream>
+#include <vector>
 #include <cmath>
 #include <unistd.h>
 
-// Use TICK and TOCK to time a code section in MATLAB-like fashion.
+// Use TICK and TOCK to time a code section in MATLAB-like fashion. With
+// --timekernels both wait for what was launched before, see syncKernelTiming.
 //!< record current time in 't0'
-#define TICK()  t0 = mytimer()
+#define TICK() \
+    do { syncKernelTiming(ctx, lrt); t0 = mytimer(); } while (0)
 //!< store time difference in 't' using time in 't0'
-#define TOCK(t) t += mytimer() - t0
+#define TOCK(t) \
+    do { syncKernelTiming(ctx, lrt); t += mytimer() - t0; } while (0)
+
+/**
+ * ID of the trace of a CG iteration. A trace must replay the same operations
+ * on the same regions, so there is one per solution vector, with and without
+ * the preconditioner, per matrix layout and SYMGS ordering of OptimizeProblem,
+ * and for the first iteration, which starts p from z.
+ */
+inline TraceID
+CGIterationTraceID(
+    const SparseMatrix &A,
+    const Array<floatType> &x,
+    bool doPreconditioning,
+    bool firstIteration
+) {
+    TraceID id = x.logicalRegion.get_tree_id();
+    id = id * 2 + (doPreconditioning ? 1 : 0);
+    id = id * 2 + (A.multicolorSYMGS ? 1 : 0);
+    id = id * 2 + (A.sell ? 1 : 0);
+    id = id * 2 + (A.matrixFree ? 1 : 0);
+    id = id * 2 + (firstIteration ? 1 : 0);
+    return id;
+}
 
 /*!
     Reference routine to compute an approximate solution to Ax = b
@@ -105,6 +131,11 @@
     @param[in]    doPreconditioning The flag to indicate whether the
                   preconditioner should be invoked at each iteration.
 
+    @param[in]    checkFreq With a tolerance, the number of iterations launched
+                  between waits on the residual norms. niters is still the
+                  first iteration that met the tolerance, but x then has up
+                  to checkFreq - 1 more iterations applied.
+
     @return Returns zero on success and a non-zero value otherwise.
 
     @see CG()
@@ -123,21 +154,25 @@ CG(
     double           *times,
     bool             doPreconditioning,
     Context          ctx,
-    Runtime          *lrt
+    Runtime          *lrt,
+    int              checkFreq = 1
 ) {
     using namespace std;
     // Start timing right away.
     double t_begin = mytimer();
+    const double haloBegin = totalHaloTime(A);
     //
     const int print_freq = 10;
     const int rank = A.geom->data()->rank;
     const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
     //
     Future normrFuture, pApFuture, rtzFuture, oldrtzFuture;
-    floatType alpha = 0.0, beta = 0.0;
+    // Computed by the WAXPBY tasks they scale, see FutureRatio.
+    FutureRatio alpha, beta;
     double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
     //
     normr = 0.0;
+    niters = 0;
     //
     Array<floatType> &r  = *(data.r); // Residual vector.
     Array<floatType> &z  = *(data.z); // Preconditioned residual vector.
@@ -156,23 +191,38 @@ CG(
     ComputeSPMV(A, p, Ap, ctx, lrt);
     TOCK(t3);
     //
-    TICK(); // r = b - Ax (x stored in p)
-    ComputeWAXPBY(nrow, 1.0, b, -1.0, Ap, r, ctx, lrt);
+    // The dot products that follow an SpMV or a WAXPBY on its result are
+    // computed in the same task, and timed with it.
+    TICK(); // r = b - Ax (x stored in p), normr = r' * r
+    ComputeWAXPBYDotProduct(nrow, 1.0, b, -1.0, NULL, Ap, r,
+                            normrFuture, t4, dcarsFT, ctx, lrt
+    );
     TOCK(t2);
     //
-    TICK();
-    ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
-    TOCK(t1);
-    //
-    normr = ComputeFuture(
-                &normrFuture, FMO_SQRT, NULL, ctx, lrt
-            ).get_result<floatType>(disableWarnings);
+    normr = sqrt(normrFuture.get_result<floatType>(disableWarnings));
     //
     if (rank == 0) std::cout << "Initial Residual = "<< normr << std::endl;
     // Record initial residual for convergence testing.
     normr0 = normr;
+    // alpha and beta go to WAXPBY as the futures of their dot products, so an
+    // iteration is launched without waiting for them, or a task to divide
+    // them. With a zero tolerance, as in the timed runs, all maxIter
+    // iterations run and normr is only waited for after the last one.
+    // Otherwise the norms of checkFreq iterations are waited for together,
+    // each time checkFreq more have been launched.
+    const bool fixedIterations = !(tolerance > 0.0);
+    if (checkFreq < 1) checkFreq = 1;
+    std::vector<Future> pendingNormrFutures;
+    bool converged = !fixedIterations && !(normr / normr0 > tolerance);
     // Start iterations.
-    for (int k = 1; k <= maxIter && normr / normr0 > tolerance; k++ ) {
+    for (int k = 1; k <= maxIter && !converged; k++) {
+        // Every iteration launches the same operations, MG included, so the
+        // runtime replays their dependence analysis after the first one.
+        const TraceID traceID = CGIterationTraceID(
+                                    A, x, doPreconditioning, k == 1
+                                );
+        lrt->begin_trace(ctx, traceID);
+        //
         TICK();
         if (doPreconditioning) {
             // Apply preconditioner.
@@ -200,54 +250,66 @@ CG(
             ComputeDotProduct(nrow, r, z, rtzFuture, t4, dcarsFT, ctx, lrt);
             TOCK(t1);
             //
-            beta = ComputeFuture(
-                       &rtzFuture, FMO_DIV, &oldrtzFuture, ctx, lrt
-                   ).get_result<floatType>(disableWarnings);
+            beta = FutureRatio(rtzFuture, oldrtzFuture);
             //
             TICK(); // p = beta * p + z
-            ComputeWAXPBY(nrow, 1.0, z, beta, p, p, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, z, 1.0, beta, p, p, ctx, lrt);
             TOCK(t2);
         }
-        TICK(); // Ap = A * p
-        ComputeSPMV(A, p, Ap, ctx, lrt);
+        TICK(); // Ap = A * p, alpha = p' * Ap
+        ComputeSPMVDotProduct(A, p, Ap, pApFuture, t4, dcarsFT, ctx, lrt);
         TOCK(t3);
         //
-        TICK(); // alpha = p' * Ap
-        ComputeDotProduct(nrow, p, Ap, pApFuture, t4, dcarsFT, ctx, lrt);
-        TOCK(t1);
-        //
-        alpha = ComputeFuture(
-                    &rtzFuture, FMO_DIV, &pApFuture, ctx, lrt
-                ).get_result<floatType>(disableWarnings);
+        alpha = FutureRatio(rtzFuture, pApFuture);
         //
-        TICK(); // x = x + alpha * p
-        ComputeWAXPBY(nrow, 1.0, x, alpha, p, x, ctx, lrt);
-        // r = r - alpha * Ap
-        ComputeWAXPBY(nrow, 1.0, r, -alpha, Ap, r, ctx, lrt);
+        TICK(); // x = x + alpha * p, r = r - alpha * Ap, normr = r' * r
+        ComputeCGUpdate(nrow, alpha, p, Ap, x, r,
+                        normrFuture, t4, dcarsFT, ctx, lrt
+        );
         TOCK(t2);
+        // Not the norm, which only some iterations wait for.
+        lrt->end_trace(ctx, traceID);
         //
-        TICK();
-        ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
-        TOCK(t1);
-        //
-        normr = ComputeFuture(
-                    &normrFuture, FMO_SQRT, NULL, ctx, lrt
-                ).get_result<floatType>(disableWarnings);
+        niters = k;
+        if (fixedIterations) continue;
         //
-        if (rank == 0 && ( k % print_freq == 0 || k == maxIter)) {
-            cout << "Iteration = "<< k << "   Scaled Residual = "
+        pendingNormrFutures.push_back(normrFuture);
+        if (k % checkFreq != 0 && k != maxIter) continue;
+        // The first of the pending iterations to meet the tolerance is the
+        // one reported.
+        const int first = k - int(pendingNormrFutures.size()) + 1;
+        for (size_t i = 0; i < pendingNormrFutures.size() && !converged; i++) {
+            const int it = first + int(i);
+            normr = sqrt(pendingNormrFutures[i].get_result<floatType>(
+                             disableWarnings
+                         ));
+            if (rank == 0 && (it % print_freq == 0 || it == maxIter)) {
+                cout << "Iteration = "<< it << "   Scaled Residual = "
+                     << normr / normr0 << std::endl;
+            }
+            if (!(normr / normr0 > tolerance)) {
+                converged = true;
+                niters = it;
+            }
+        }
+        pendingNormrFutures.clear();
+    }
+    //
+    if (fixedIterations && niters > 0) {
+        normr = sqrt(normrFuture.get_result<floatType>(disableWarnings));
+        if (rank == 0) {
+            cout << "Iteration = "<< niters << "   Scaled Residual = "
                  << normr / normr0 << std::endl;
         }
-        //
-        niters = k;
-  }
-    // TODO pass future to WAXPBY instead of future result.
+    }
     // Store times.
     times[1] += t1; // Dot product time.
     times[2] += t2; // WAXPBY time.
     times[3] += t3; // SPMV time.
     times[4] += t4; // AllReduce time.
     times[5] += t5; // Preconditioner apply time.
+    syncKernelTiming(ctx, lrt);
+    t6 = totalHaloTime(A) - haloBegin;
     times[6] += t6; // Exchange halo time.
     times[0] += mytimer() - t_begin;  // Total time. All done...
     //
@@ -0,0 +1,381 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+#include "CUDAKernels.hpp"
+
+#include <cuda_runtime.h>
+
+#include <algorithm>
+#include <cassert>
+
+// Threads per block, and most blocks of a grid-stride launch.
+#define LGNCG_CUDA_BLOCK      256
+#define LGNCG_CUDA_MAX_BLOCKS 1024
+
+// Same as SPMVRows.
+#define LGNCG_CUDA_ROWS_ALL      0
+#define LGNCG_CUDA_ROWS_INTERIOR 1
+#define LGNCG_CUDA_ROWS_BOUNDARY 2
+
+/**
+ * Blocks of a grid-stride launch over n items.
+ */
+static inline int
+nBlocks(local_int_t n)
+{
+    const local_int_t nb = (n + LGNCG_CUDA_BLOCK - 1) / LGNCG_CUDA_BLOCK;
+    return int(std::max<local_int_t>(1, std::min<local_int_t>(
+        nb, LGNCG_CUDA_MAX_BLOCKS
+    )));
+}
+
+/**
+ * Per-block partial sums on the device, one buffer per GPU processor thread,
+ * kept across tasks.
+ */
+static floatType *
+devicePartials(void)
+{
+    static thread_local floatType *partials = nullptr;
+    if (!partials) {
+        const cudaError_t rc = cudaMalloc(
+            &partials, LGNCG_CUDA_MAX_BLOCKS * sizeof(floatType)
+        );
+        assert(rc == cudaSuccess);
+        (void)rc;
+    }
+    return partials;
+}
+
+/**
+ * Sum of the partials of a launch of nb blocks.
+ */
+static floatType
+sumPartials(const floatType *partials, int nb)
+{
+    floatType host[LGNCG_CUDA_MAX_BLOCKS];
+    cudaMemcpy(host, partials, nb * sizeof(floatType), cudaMemcpyDeviceToHost);
+    floatType sum = 0.0;
+    for (int b = 0; b < nb; ++b) sum += host[b];
+    return sum;
+}
+
+/**
+ * Stores the sum of v over the block in partials[blockIdx.x].
+ */
+__device__ void
+blockSum(floatType v, floatType *partials)
+{
+    __shared__ floatType s[LGNCG_CUDA_BLOCK];
+    s[threadIdx.x] = v;
+    __syncthreads();
+    for (int o = blockDim.x / 2; o > 0; o >>= 1) {
+        if (threadIdx.x < o) s[threadIdx.x] += s[threadIdx.x + o];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) partials[blockIdx.x] = s[0];
+}
+
+/**
+ * The sum of row i of A times x, diagonal included.
+ */
+__device__ floatType
+rowTimes(const CUDAMatrix &A, local_int_t i, const floatType *x)
+{
+    floatType sum = 0.0;
+    if (A.chunkStart) {
+        const local_int_t k = i / A.chunkSize;
+        const local_int_t base = A.chunkStart[k] + i % A.chunkSize;
+        const int width = (A.chunkStart[k + 1] - A.chunkStart[k])
+                        / A.chunkSize;
+        for (int j = 0; j < width; j++) {
+            const local_int_t e = base + j * A.chunkSize;
+            sum += A.values[e] * x[MtxIndColumn(i, A.colInds[e], A.nrow)];
+        }
+        return sum;
+    }
+    const matrixFloatType *const vals = A.values + i * A.stencilSize;
+    const mtx_ind_t *const cols = A.colInds + i * A.stencilSize;
+    const int nnz = A.nonzerosInRow[i];
+    for (int j = 0; j < nnz; j++) {
+        sum += vals[j] * x[MtxIndColumn(i, cols[j], A.nrow)];
+    }
+    return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+dotProductKernel(
+    local_int_t n,
+    const floatType *x,
+    const floatType *y,
+    floatType *partials
+) {
+    floatType sum = 0.0;
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < n;
+         i += blockDim.x * gridDim.x) {
+        sum += x[i] * y[i];
+    }
+    blockSum(sum, partials);
+}
+
+floatType
+lgncgCUDADotProduct(
+    local_int_t n,
+    const floatType *x,
+    const floatType *y
+) {
+    const int nb = nBlocks(n);
+    floatType *const partials = devicePartials();
+    dotProductKernel<<<nb, LGNCG_CUDA_BLOCK>>>(n, x, y, partials);
+    return sumPartials(partials, nb);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+waxpbyKernel(
+    local_int_t n,
+    floatType alpha,
+    const floatType *x,
+    floatType beta,
+    const floatType *y,
+    floatType *w,
+    floatType *partials
+) {
+    floatType sum = 0.0;
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < n;
+         i += blockDim.x * gridDim.x) {
+        const floatType wi = alpha * x[i] + beta * y[i];
+        w[i] = wi;
+        sum += wi * wi;
+    }
+    if (partials) blockSum(sum, partials);
+}
+
+floatType
+lgncgCUDAWAXPBY(
+    local_int_t n,
+    floatType alpha,
+    const floatType *x,
+    floatType beta,
+    const floatType *y,
+    floatType *w,
+    bool ww
+) {
+    const int nb = nBlocks(n);
+    floatType *const partials = ww ? devicePartials() : nullptr;
+    waxpbyKernel<<<nb, LGNCG_CUDA_BLOCK>>>(n, alpha, x, beta, y, w, partials);
+    return ww ? sumPartials(partials, nb) : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The interior box of SetupHalo, by value for the kernels.
+ */
+struct CUDABox {
+    local_int_t lo[3];
+    local_int_t hi[3];
+};
+
+__global__ void
+spmvKernel(
+    CUDAMatrix A,
+    int rows,
+    CUDABox box,
+    const floatType *x,
+    floatType *y,
+    floatType *partials
+) {
+    const local_int_t nrow = local_int_t(A.nx) * A.ny * A.nz;
+    floatType sum = 0.0;
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nrow;
+         i += blockDim.x * gridDim.x) {
+        if (rows != LGNCG_CUDA_ROWS_ALL) {
+            const local_int_t ix = i % A.nx;
+            const local_int_t iy = (i / A.nx) % A.ny;
+            const local_int_t iz = i / (local_int_t(A.nx) * A.ny);
+            const bool interior = ix >= box.lo[0] && ix < box.hi[0]
+                               && iy >= box.lo[1] && iy < box.hi[1]
+                               && iz >= box.lo[2] && iz < box.hi[2];
+            if (interior != (rows == LGNCG_CUDA_ROWS_INTERIOR)) continue;
+        }
+        const floatType yi = rowTimes(A, i, x);
+        y[i] = yi;
+        sum += x[i] * yi;
+    }
+    if (partials) blockSum(sum, partials);
+}
+
+floatType
+lgncgCUDASPMV(
+    const CUDAMatrix &A,
+    int rows,
+    const local_int_t lo[3],
+    const local_int_t hi[3],
+    const floatType *x,
+    floatType *y,
+    bool xy
+) {
+    CUDABox box;
+    for (int d = 0; d < 3; ++d) {
+        box.lo[d] = lo[d];
+        box.hi[d] = hi[d];
+    }
+    const int nb = nBlocks(local_int_t(A.nx) * A.ny * A.nz);
+    floatType *const partials = xy ? devicePartials() : nullptr;
+    spmvKernel<<<nb, LGNCG_CUDA_BLOCK>>>(A, rows, box, x, y, partials);
+    return xy ? sumPartials(partials, nb) : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+symgsColorKernel(
+    CUDAMatrix A,
+    int color,
+    const matrixFloatType *diag,
+    const floatType *r,
+    floatType *x
+) {
+    const int px = color & 1, py = (color >> 1) & 1, pz = color >> 2;
+    // Points of the color along each dimension.
+    const local_int_t cx = (A.nx - px + 1) / 2;
+    const local_int_t cy = (A.ny - py + 1) / 2;
+    const local_int_t cz = (A.nz - pz + 1) / 2;
+    const local_int_t n = cx * cy * cz;
+    for (local_int_t t = blockIdx.x * blockDim.x + threadIdx.x; t < n;
+         t += blockDim.x * gridDim.x) {
+        const local_int_t ix = px + 2 * (t % cx);
+        const local_int_t iy = py + 2 * ((t / cx) % cy);
+        const local_int_t iz = pz + 2 * (t / (cx * cy));
+        const local_int_t i = (iz * A.ny + iy) * A.nx + ix;
+        // Rows of a color are not coupled, so x[i] is the only one of them
+        // that the sum reads and this thread writes.
+        const floatType sum = r[i] - rowTimes(A, i, x) + x[i] * diag[i];
+        x[i] = sum / diag[i];
+    }
+}
+
+void
+lgncgCUDASYMGSMulticolor(
+    const CUDAMatrix &A,
+    const matrixFloatType *diag,
+    const floatType *r,
+    floatType *x
+) {
+    // Colors are 8 as in LGNCG_SYMGS_COLORS.
+    const int nb = nBlocks((local_int_t(A.nx) * A.ny * A.nz + 7) / 8);
+    for (int c = 0; c < 8; ++c) {
+        symgsColorKernel<<<nb, LGNCG_CUDA_BLOCK>>>(A, c, diag, r, x);
+    }
+    // Now the back sweep.
+    for (int c = 7; c >= 0; --c) {
+        symgsColorKernel<<<nb, LGNCG_CUDA_BLOCK>>>(A, c, diag, r, x);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+restrictionKernel(
+    local_int_t nc,
+    const floatType *Axf,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+) {
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nc;
+         i += blockDim.x * gridDim.x) {
+        rc[i] = rf[f2c[i]] - Axf[f2c[i]];
+    }
+}
+
+void
+lgncgCUDARestriction(
+    local_int_t nc,
+    const floatType *Axf,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+) {
+    restrictionKernel<<<nBlocks(nc), LGNCG_CUDA_BLOCK>>>(nc, Axf, f2c, rf, rc);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+fusedRestrictionKernel(
+    CUDAMatrix A,
+    local_int_t nc,
+    const floatType *x,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+) {
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nc;
+         i += blockDim.x * gridDim.x) {
+        rc[i] = rf[f2c[i]] - rowTimes(A, f2c[i], x);
+    }
+}
+
+void
+lgncgCUDAFusedRestriction(
+    const CUDAMatrix &A,
+    local_int_t nc,
+    const floatType *x,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+) {
+    fusedRestrictionKernel<<<nBlocks(nc), LGNCG_CUDA_BLOCK>>>(
+        A, nc, x, f2c, rf, rc
+    );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+prolongationKernel(
+    local_int_t nc,
+    const floatType *xc,
+    const local_int_t *f2c,
+    floatType *xf
+) {
+    // f2c maps each coarse point to a distinct fine point.
+    for (local_int_t i = blockIdx.x * blockDim.x + threadIdx.x; i < nc;
+         i += blockDim.x * gridDim.x) {
+        xf[f2c[i]] += xc[i];
+    }
+}
+
+void
+lgncgCUDAProlongation(
+    local_int_t nc,
+    const floatType *xc,
+    const local_int_t *f2c,
+    floatType *xf
+) {
+    prolongationKernel<<<nBlocks(nc), LGNCG_CUDA_BLOCK>>>(nc, xc, f2c, xf);
+}
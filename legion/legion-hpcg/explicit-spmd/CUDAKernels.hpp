@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/**
+ * Kernels of the TOC_PROC variants of the leaf tasks, built with USE_CUDA=1.
+ * They work on the framebuffer pointers of the task's regions, and run on the
+ * task's stream; results are copied back before they return.
+ */
+
+#pragma once
+
+#include "Types.hpp"
+
+#ifdef LGNCG_CUDA
+
+/**
+ * A matrix in the layout of SparseMatrix, or in the SELL layout of
+ * LegionSELLData.hpp if chunkStart is not NULL.
+ */
+struct CUDAMatrix {
+    const matrixFloatType *values;
+    const mtx_ind_t *colInds;
+    // Rows, see MtxIndColumn.
+    local_int_t nrow;
+    // CSR only.
+    const char *nonzerosInRow;
+    int stencilSize;
+    // SELL only, and its LGNCG_SELL_C.
+    const local_int_t *chunkStart;
+    int chunkSize;
+    // Local grid dimensions.
+    int nx;
+    int ny;
+    int nz;
+};
+
+/**
+ * Returns x'y over the first n entries.
+ */
+floatType
+lgncgCUDADotProduct(
+    local_int_t n,
+    const floatType *x,
+    const floatType *y
+);
+
+/**
+ * w = alpha * x + beta * y over the first n entries. Returns w'w if ww is set,
+ * 0 otherwise.
+ */
+floatType
+lgncgCUDAWAXPBY(
+    local_int_t n,
+    floatType alpha,
+    const floatType *x,
+    floatType beta,
+    const floatType *y,
+    floatType *w,
+    bool ww
+);
+
+/**
+ * y = Ax over the rows an SPMVRows selects, with the interior box lo, hi of
+ * SetupHalo. Returns x'y over those rows if xy is set, 0 otherwise.
+ */
+floatType
+lgncgCUDASPMV(
+    const CUDAMatrix &A,
+    int rows,
+    const local_int_t lo[3],
+    const local_int_t hi[3],
+    const floatType *x,
+    floatType *y,
+    bool xy
+);
+
+/**
+ * One symmetric Gauss-Seidel step in multicolor order, see
+ * SYMGSMulticolorSweeps: a kernel per color, forward then back.
+ */
+void
+lgncgCUDASYMGSMulticolor(
+    const CUDAMatrix &A,
+    const matrixFloatType *diag,
+    const floatType *r,
+    floatType *x
+);
+
+/**
+ * rc[i] = rf[f2c[i]] - Axf[f2c[i]] for i < nc.
+ */
+void
+lgncgCUDARestriction(
+    local_int_t nc,
+    const floatType *Axf,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+);
+
+/**
+ * rc[i] = rf[f2c[i]] - A(f2c[i],:)x for i < nc, with the CSR rows of A.
+ */
+void
+lgncgCUDAFusedRestriction(
+    const CUDAMatrix &A,
+    local_int_t nc,
+    const floatType *x,
+    const local_int_t *f2c,
+    const floatType *rf,
+    floatType *rc
+);
+
+/**
+ * xf[f2c[i]] += xc[i] for i < nc.
+ */
+void
+lgncgCUDAProlongation(
+    local_int_t nc,
+    const floatType *xc,
+    const local_int_t *f2c,
+    floatType *xf
+);
+
+#endif
@@ -116,13 +116,13 @@ CheckProblem(
     if (x != 0) xv = x->data();
     if (xexact != 0) xexactv = xexact->data();
 
-    const floatType *const AmatrixDiagonal = A.matrixDiagonal->data();
+    const matrixFloatType *const AmatrixDiagonal = A.matrixDiagonal->data();
     assert(AmatrixDiagonal);
     //
     const local_int_t numberOfNonzerosPerRow = Ageom->stencilSize;
     // Interpreted as 2D array
     assert(A.matrixValues->data());
-    Array2D<floatType> matrixValues(
+    Array2D<matrixFloatType> matrixValues(
         localNumberOfRows, numberOfNonzerosPerRow, A.matrixValues->data()
     );
     // Interpreted as 2D array
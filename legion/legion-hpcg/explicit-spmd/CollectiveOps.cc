@@ -33,14 +33,66 @@
 #include "LegionItems.hpp"
 
 #include <typeinfo>
+#include <cstring>
+#include <cmath>
 
-#define LGNCG_MAX(x, y) x > y ? x : y
-#define LGNCG_MIN(x, y) x < y ? x : y
+#define LGNCG_MAX(x, y) ((x) > (y) ? (x) : (y))
+#define LGNCG_MIN(x, y) ((x) < (y) ? (x) : (y))
+
+/**
+ * lhs = op(lhs, rhs), atomically with respect to other calls on the same lhs:
+ * Legion calls the non-exclusive apply and fold when several contributions
+ * reduce into one instance at once.
+ */
+template <typename OP>
+static inline void
+casUpdate(floatType &lhs, floatType rhs, OP op) {
+    static_assert(sizeof(floatType) == sizeof(int64_t), "floatType size");
+    volatile int64_t *target = reinterpret_cast<volatile int64_t *>(&lhs);
+    int64_t oldBits, newBits;
+    floatType oldVal, newVal;
+    do {
+        oldBits = *target;
+        memcpy(&oldVal, &oldBits, sizeof(oldVal));
+        newVal = op(oldVal, rhs);
+        // Nothing to write, e.g. a max that is already larger.
+        if (newVal == oldVal) return;
+        memcpy(&newBits, &newVal, sizeof(newBits));
+    } while (!__sync_bool_compare_and_swap(target, oldBits, newBits));
+}
+
+/**
+ *
+ */
+static inline void
+casAdd(floatType &lhs, floatType rhs) {
+    casUpdate(lhs, rhs, [](floatType a, floatType b) { return a + b; });
+}
+
+/**
+ *
+ */
+static inline void
+casMin(floatType &lhs, floatType rhs) {
+    casUpdate(lhs, rhs, [](floatType a, floatType b) {
+        return LGNCG_MIN(a, b);
+    });
+}
+
+/**
+ *
+ */
+static inline void
+casMax(floatType &lhs, floatType rhs) {
+    casUpdate(lhs, rhs, [](floatType a, floatType b) {
+        return LGNCG_MAX(a, b);
+    });
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-const floatType FloatReduceSumAccumulate::identity = 1.0;
+const floatType FloatReduceSumAccumulate::identity = 0.0;
 
 template<>
 void
@@ -51,25 +103,25 @@ FloatReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
 template<>
 void
 FloatReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
-    exit(1);
+    casAdd(lhs, rhs);
 }
 
 template<>
 void
 FloatReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    rhs1 += rhs2;
 }
 
 template<>
 void
 FloatReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    casAdd(rhs1, rhs2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-const floatType FloatReduceMaxAccumulate::identity = 1.0;
+const floatType FloatReduceMaxAccumulate::identity = -DBL_MAX;
 
 template<>
 void
@@ -80,25 +132,25 @@ FloatReduceMaxAccumulate::apply<true>(LHS &lhs, RHS rhs) {
 template<>
 void
 FloatReduceMaxAccumulate::apply<false>(LHS &lhs, RHS rhs) {
-    exit(1);
+    casMax(lhs, rhs);
 }
 
 template<>
 void
 FloatReduceMaxAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    rhs1 = LGNCG_MAX(rhs1, rhs2);
 }
 
 template<>
 void
 FloatReduceMaxAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    casMax(rhs1, rhs2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-const floatType FloatReduceMinAccumulate::identity = 1.0;
+const floatType FloatReduceMinAccumulate::identity = DBL_MAX;
 
 template<>
 void
@@ -109,19 +161,19 @@ FloatReduceMinAccumulate::apply<true>(LHS &lhs, RHS rhs) {
 template<>
 void
 FloatReduceMinAccumulate::apply<false>(LHS &lhs, RHS rhs) {
-    exit(1);
+    casMin(lhs, rhs);
 }
 
 template<>
 void
 FloatReduceMinAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    rhs1 = LGNCG_MIN(rhs1, rhs2);
 }
 
 template<>
 void
 FloatReduceMinAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    casMin(rhs1, rhs2);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +190,7 @@ IntReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
 template<>
 void
 IntReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
-    exit(1);
+    __sync_fetch_and_add(&lhs, rhs);
 }
 
 template<>
@@ -150,7 +202,167 @@ IntReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
 template<>
 void
 IntReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
-    exit(1);
+    __sync_fetch_and_add(&rhs1, rhs2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const FusedDots FusedDotsReduceSumAccumulate::identity = {};
+
+template<>
+void
+FusedDotsReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) lhs[i] += rhs[i];
+}
+
+// Each entry is updated atomically, which is all a sum needs.
+template<>
+void
+FusedDotsReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) casAdd(lhs[i], rhs[i]);
+}
+
+template<>
+void
+FusedDotsReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
+    for (size_t i = 0; i < rhs1.size(); ++i) rhs1[i] += rhs2[i];
+}
+
+template<>
+void
+FusedDotsReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
+    for (size_t i = 0; i < rhs1.size(); ++i) casAdd(rhs1[i], rhs2[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const AgglomeratedVector AgglomeratedVectorReduceSumAccumulate::identity = {};
+
+template<>
+void
+AgglomeratedVectorReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) lhs[i] += rhs[i];
+}
+
+// As for FusedDots, entry by entry. All but one of the contributions to an
+// entry are zeros, so the sum is exact.
+template<>
+void
+AgglomeratedVectorReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
+    for (size_t i = 0; i < lhs.size(); ++i) casAdd(lhs[i], rhs[i]);
+}
+
+template<>
+void
+AgglomeratedVectorReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
+    for (size_t i = 0; i < rhs1.size(); ++i) rhs1[i] += rhs2[i];
+}
+
+template<>
+void
+AgglomeratedVectorReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
+    for (size_t i = 0; i < rhs1.size(); ++i) casAdd(rhs1[i], rhs2[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const ExactSum ExactSumReduceSumAccumulate::identity = {};
+
+template<>
+void
+ExactSumReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
+    for (int k = 0; k < LGNCG_EXACT_SUM_DIGITS; ++k) {
+        lhs.digit[k] += rhs.digit[k];
+    }
+    lhs.special += rhs.special;
+}
+
+// Integer digits, so any interleaving of the updates gives the same sum.
+template<>
+void
+ExactSumReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
+    for (int k = 0; k < LGNCG_EXACT_SUM_DIGITS; ++k) {
+        __sync_fetch_and_add(&lhs.digit[k], rhs.digit[k]);
+    }
+    casAdd(lhs.special, rhs.special);
+}
+
+template<>
+void
+ExactSumReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
+    apply<true>(rhs1, rhs2);
+}
+
+template<>
+void
+ExactSumReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
+    apply<false>(rhs1, rhs2);
+}
+
+/**
+ * s += v, exactly. Infinities and NaNs are told apart by their exponent bits,
+ * which -ffast-math does not assume away as it does std::isfinite.
+ */
+static inline void
+exactSumAdd(ExactSum &s, floatType v) {
+    static_assert(sizeof(floatType) == sizeof(uint64_t), "floatType size");
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    if (((bits >> 52) & 0x7ff) == 0x7ff) {
+        s.special += v;
+        return;
+    }
+    if (v == 0.0) return;
+    // |v| = m 2^(e - 53), m an integer below 2^53, placed at bit p.
+    int e = 0;
+    const uint64_t m = uint64_t(ldexp(frexp(fabs(v), &e), 53));
+    const int p = e - 53 - LGNCG_EXACT_SUM_EMIN;
+    const int k = p / 32;
+    const unsigned __int128 t = (unsigned __int128)m << (p % 32);
+    const int64_t sign = (v < 0.0) ? -1 : 1;
+    s.digit[k    ] += sign * int64_t(uint64_t(t) & 0xffffffff);
+    s.digit[k + 1] += sign * int64_t(uint64_t(t >> 32) & 0xffffffff);
+    s.digit[k + 2] += sign * int64_t(uint64_t(t >> 64));
+}
+
+/**
+ * The digits of d carried up, all but the last in [0, 2^32).
+ */
+static inline void
+exactSumCarry(int64_t *d) {
+    int64_t carry = 0;
+    for (int k = 0; k < LGNCG_EXACT_SUM_DIGITS - 1; ++k) {
+        const int64_t t = d[k] + carry;
+        carry = t >> 32;
+        d[k] = t - carry * (int64_t(1) << 32);
+    }
+    d[LGNCG_EXACT_SUM_DIGITS - 1] += carry;
+}
+
+/**
+ * s rounded to a floatType. The digits are normalized first, so the result
+ * only depends on the value of s, not on how its digits were added up.
+ */
+static inline floatType
+exactSumValue(const ExactSum &s) {
+    int64_t d[LGNCG_EXACT_SUM_DIGITS];
+    memcpy(d, s.digit, sizeof(d));
+    exactSumCarry(d);
+    // The lower digits are positive, so the last one has the sign.
+    const bool negative = d[LGNCG_EXACT_SUM_DIGITS - 1] < 0;
+    if (negative) {
+        for (int k = 0; k < LGNCG_EXACT_SUM_DIGITS; ++k) d[k] = -d[k];
+        exactSumCarry(d);
+    }
+    // Largest digits first, a fixed order for the same digits.
+    floatType r = 0.0;
+    for (int k = LGNCG_EXACT_SUM_DIGITS - 1; k >= 0; --k) {
+        r += ldexp(floatType(d[k]), 32 * k + LGNCG_EXACT_SUM_EMIN);
+    }
+    return (negative ? -r : r) + s.special;
 }
 
 /**
@@ -181,6 +393,64 @@ dynCollTaskContribGIT(
     return f.get_result<global_int_t>(disableWarnings);
 }
 
+/**
+ *
+ */
+FusedDots
+dynCollTaskContribFD(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    Future f = task->futures[0];
+    return f.get_result<FusedDots>(disableWarnings);
+}
+
+/**
+ *
+ */
+AgglomeratedVector
+dynCollTaskContribAV(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    Future f = task->futures[0];
+    return f.get_result<AgglomeratedVector>(disableWarnings);
+}
+
+/**
+ * The local value of an exact sum.
+ */
+ExactSum
+dynCollTaskContribES(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    Future f = task->futures[0];
+    ExactSum s = {};
+    exactSumAdd(s, f.get_result<floatType>(disableWarnings));
+    return s;
+}
+
+/**
+ * The floatType value of an exact sum, see exactSumResult.
+ */
+floatType
+exactSumValueTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    Future f = task->futures[0];
+    return exactSumValue(f.get_result<ExactSum>(disableWarnings));
+}
+
 /**
  *
  */
@@ -205,6 +475,44 @@ registerCollectiveOpsTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "dynCollTaskContribFT"
     );
+    HighLevelRuntime::register_legion_task<FusedDots, dynCollTaskContribFD>(
+        DYN_COLL_TASK_CONTRIB_FD_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "dynCollTaskContribFD"
+    );
+    HighLevelRuntime::register_legion_task<
+        AgglomeratedVector, dynCollTaskContribAV
+    >(
+        DYN_COLL_TASK_CONTRIB_AV_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "dynCollTaskContribAV"
+    );
+    HighLevelRuntime::register_legion_task<ExactSum, dynCollTaskContribES>(
+        DYN_COLL_TASK_CONTRIB_ES_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "dynCollTaskContribES"
+    );
+    HighLevelRuntime::register_legion_task<floatType, exactSumValueTask>(
+        EXACT_SUM_VALUE_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "exactSumValueTask"
+    );
     HighLevelRuntime::register_reduction_op<FloatReduceSumAccumulate>(
         FLOAT_REDUCE_SUM_TID
     );
@@ -217,4 +525,13 @@ registerCollectiveOpsTasks(void)
     HighLevelRuntime::register_reduction_op<IntReduceSumAccumulate>(
         INT_REDUCE_SUM_TID
     );
+    HighLevelRuntime::register_reduction_op<FusedDotsReduceSumAccumulate>(
+        FUSED_DOTS_REDUCE_SUM_TID
+    );
+    HighLevelRuntime::register_reduction_op<
+        AgglomeratedVectorReduceSumAccumulate
+    >(AGGLOMERATED_VECTOR_REDUCE_SUM_TID);
+    HighLevelRuntime::register_reduction_op<ExactSumReduceSumAccumulate>(
+        EXACT_SUM_REDUCE_SUM_TID
+    );
 }
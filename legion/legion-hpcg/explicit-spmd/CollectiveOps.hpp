@@ -29,15 +29,58 @@
 
 #pragma once
 
+#include "hpcg.hpp"
 #include "Types.hpp"
 #include "LegionItems.hpp"
+#include "mytimer.hpp"
 
 #include "legion.h"
 
 #include <cfloat>
+#include <array>
 
 using namespace LegionRuntime::HighLevel;
 
+/**
+ * Maximum number of dot products reduced together by one fused collective:
+ * two per column of the block CG, see BlockCG.
+ */
+#define LGNCG_MAX_FUSED_DOTS (2 * LGNCG_MAX_BLOCK)
+
+/**
+ * The values of a fused collective, reduced element-wise. Unused trailing
+ * entries are carried as zeros.
+ */
+using FusedDots = std::array<floatType, LGNCG_MAX_FUSED_DOTS>;
+
+/**
+ * The values of a whole agglomerated coarse level, see AgglomeratedMG.hpp:
+ * each shard contributes its rows at their global indices and zeros
+ * elsewhere, so their sum is the level gathered onto every shard.
+ */
+using AgglomeratedVector =
+    std::array<floatType, LGNCG_MAX_AGGLOMERATED_ROWS>;
+
+/**
+ * Digits of an ExactSum, 32 bits each from 2^LGNCG_EXACT_SUM_EMIN up: enough
+ * for all the finite doubles, down to the subnormals, and the carries of 2^31
+ * of them.
+ */
+#define LGNCG_EXACT_SUM_DIGITS 70
+#define LGNCG_EXACT_SUM_EMIN (-1152)
+
+/**
+ * A sum of floatTypes as one fixed-point integer, digit k weighing
+ * 2^(32 k + LGNCG_EXACT_SUM_EMIN), and the sum of the infinities and NaNs
+ * apart. Adding to it is exact, so its value does not depend on the order of
+ * the additions (--repro).
+ */
+struct ExactSum {
+    int64_t digit[LGNCG_EXACT_SUM_DIGITS];
+    //
+    floatType special;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +95,18 @@ struct DynColl {
     TYPE localBuffer;
     //
     DynamicCollective dc;
+    // Two-level reduction, see allReduce: the collective of the shards of a
+    // group, the one of the group leaders, and whether this shard is the
+    // leader of its group.
+    bool hierarchical = false;
+    //
+    bool groupLeader = false;
+    //
+    DynamicCollective groupDC;
+    //
+    DynamicCollective leadersDC;
+    // A floatType sum reduced exactly, as ExactSums, see allReduce.
+    bool exact = false;
 
     /**
      *
@@ -106,6 +161,40 @@ private:
                 assert(false);
         }
     }
+
+    /**
+     *
+     */
+    void
+    mInitLocalBuffer(
+        int tid,
+        FusedDots &lb
+    ) {
+        switch (tid) {
+            case FUSED_DOTS_REDUCE_SUM_TID:
+                lb.fill(0.0);
+                break;
+            default:
+                assert(false);
+        }
+    }
+
+    /**
+     *
+     */
+    void
+    mInitLocalBuffer(
+        int tid,
+        AgglomeratedVector &lb
+    ) {
+        switch (tid) {
+            case AGGLOMERATED_VECTOR_REDUCE_SUM_TID:
+                lb.fill(0.0);
+                break;
+            default:
+                assert(false);
+        }
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -172,8 +261,80 @@ public:
     static void fold(RHS &rhs1, RHS rhs2);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class FusedDotsReduceSumAccumulate {
+public:
+    typedef FusedDots LHS;
+    typedef FusedDots RHS;
+    static const FusedDots identity;
+
+    template <bool EXCLUSIVE>
+    static void apply(LHS &lhs, RHS rhs);
+
+    template <bool EXCLUSIVE>
+    static void fold(RHS &rhs1, RHS rhs2);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class AgglomeratedVectorReduceSumAccumulate {
+public:
+    typedef AgglomeratedVector LHS;
+    typedef AgglomeratedVector RHS;
+    static const AgglomeratedVector identity;
+
+    template <bool EXCLUSIVE>
+    static void apply(LHS &lhs, RHS rhs);
+
+    template <bool EXCLUSIVE>
+    static void fold(RHS &rhs1, RHS rhs2);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class ExactSumReduceSumAccumulate {
+public:
+    typedef ExactSum LHS;
+    typedef ExactSum RHS;
+    static const ExactSum identity;
+
+    template <bool EXCLUSIVE>
+    static void apply(LHS &lhs, RHS rhs);
+
+    template <bool EXCLUSIVE>
+    static void fold(RHS &rhs1, RHS rhs2);
+};
+
+/**
+ * The floatType value of sum, a Future ExactSum, see allReduce.
+ */
+inline Future
+exactSumResult(
+    Future sum,
+    Context ctx,
+    Runtime *runtime
+) {
+    TaskLauncher tl(EXACT_SUM_VALUE_TID, TaskArgument(NULL, 0));
+    tl.add_future(sum);
+    //
+    return runtime->execute_task(ctx, tl);
+}
+
 /**
  * The type of DynColl passed in changes the behavior of the all reduce.
+ *
+ * A hierarchical DynColl first reduces over the shards of its group, one node
+ * with --allreduce=node, and only the group leaders then arrive on the
+ * collective of all groups, so it sees one arrival per group instead of one
+ * per shard.
+ *
+ * An exact DynColl reduces the ExactSums of the local values instead, and the
+ * floatType result is computed from their sum by one more task, the same
+ * whatever the order of the arrivals and the groups.
  */
 template <typename TYPE>
 Future
@@ -191,20 +352,97 @@ allReduce(
     else if (typeid(TYPE) == typeid(global_int_t)) {
         tid = DYN_COLL_TASK_CONTRIB_GIT_TID;
     }
+    else if (typeid(TYPE) == typeid(FusedDots)) {
+        tid = DYN_COLL_TASK_CONTRIB_FD_TID;
+    }
+    else if (typeid(TYPE) == typeid(AgglomeratedVector)) {
+        tid = DYN_COLL_TASK_CONTRIB_AV_TID;
+    }
     else {
         exit(1);
     }
     //
+    DynColl<TYPE> &coll = *dc.data();
+    if (coll.exact) tid = DYN_COLL_TASK_CONTRIB_ES_TID;
+    //
     TaskLauncher tl(tid, TaskArgument(NULL, 0));
     //
     tl.add_future(localFuture);
     //
     Future f = runtime->execute_task(ctx, tl);
     //
-    DynamicCollective &dynCol = dc.data()->dc;
+    Future result;
+    if (!coll.hierarchical) {
+        DynamicCollective &dynCol = coll.dc;
+        //
+        runtime->defer_dynamic_collective_arrival(ctx, dynCol, f);
+        dynCol = runtime->advance_dynamic_collective(ctx, dynCol);
+        //
+        result = runtime->get_dynamic_collective_result(ctx, dynCol);
+        return coll.exact ? exactSumResult(result, ctx, runtime) : result;
+    }
+    //
+    runtime->defer_dynamic_collective_arrival(ctx, coll.groupDC, f);
+    coll.groupDC = runtime->advance_dynamic_collective(ctx, coll.groupDC);
+    // Every shard advances the leaders' collective, only leaders arrive.
+    if (coll.groupLeader) {
+        Future groupFuture = runtime->get_dynamic_collective_result(
+                                 ctx, coll.groupDC
+                             );
+        runtime->defer_dynamic_collective_arrival(
+            ctx, coll.leadersDC, groupFuture
+        );
+    }
+    coll.leadersDC = runtime->advance_dynamic_collective(ctx, coll.leadersDC);
+    //
+    result = runtime->get_dynamic_collective_result(ctx, coll.leadersDC);
+    return coll.exact ? exactSumResult(result, ctx, runtime) : result;
+}
+
+/**
+ * allReduce of localFuture, adding the time it takes to timeAllreduce: from
+ * localFuture to the result with --timekernels, otherwise only the launch,
+ * which does not wait for either.
+ */
+template <typename TYPE>
+Future
+timedAllReduce(
+    Future localFuture,
+    Item< DynColl<TYPE> > &dc,
+    double &timeAllreduce,
+    Context ctx,
+    Runtime *runtime
+) {
+    const bool wait = kernelTimingEnabled();
+    if (wait) localFuture.get_void_result();
+    //
+    const double t0 = mytimer();
+    Future f = allReduce(localFuture, dc, ctx, runtime);
+    if (wait) f.get_void_result();
+    timeAllreduce += mytimer() - t0;
     //
-    runtime->defer_dynamic_collective_arrival(ctx, dynCol, f);
-    dynCol = runtime->advance_dynamic_collective(ctx, dynCol);
+    return f;
+}
+
+/**
+ * Seconds per round trip of allReduce over dc, waited for one after the other
+ * nSamples times: its latency, which the times taken around the allReduce
+ * calls of the benchmark, only their launch, do not include.
+ */
+inline double
+allReduceLatency(
+    Item< DynColl<floatType> > &dc,
+    int nSamples,
+    Context ctx,
+    Runtime *runtime
+) {
+    // Not timed: the first one waits for the other shards to get here.
+    Future one = Future::from_value(runtime, floatType(1.0));
+    allReduce(one, dc, ctx, runtime).get_void_result();
     //
-    return runtime->get_dynamic_collective_result(ctx, dynCol);
+    const double t0 = mytimer();
+    for (int i = 0; i < nSamples; ++i) {
+        allReduce(one, dc, ctx, runtime).get_void_result();
+    }
+    return (mytimer() - t0) / nSamples;
 }
@@ -54,6 +54,92 @@
 #include "mytimer.hpp"
 
 #include <cassert>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Entries per block of DotProductSum.
+ */
+#define LGNCG_DOT_BLOCK 1024
+
+/**
+ * x'y over [lo, hi) with four partial sums, which keep the adds from waiting
+ * on each other and let the loop vectorize, as in SPMVFullRow.
+ */
+inline floatType
+DotProductBlock(
+    const floatType *const xv,
+    const floatType *const yv,
+    local_int_t lo,
+    local_int_t hi
+) {
+    floatType s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    local_int_t i = lo;
+    for (; i + 4 <= hi; i += 4) {
+        s0 += xv[i    ] * yv[i    ];
+        s1 += xv[i + 1] * yv[i + 1];
+        s2 += xv[i + 2] * yv[i + 2];
+        s3 += xv[i + 3] * yv[i + 3];
+    }
+    for (; i < hi; i++) s0 += xv[i] * yv[i];
+    //
+    return (s0 + s1) + (s2 + s3);
+}
+
+/**
+ * Sum of the n values of v, halved recursively, so that the rounding error
+ * grows with log n rather than n.
+ */
+inline floatType
+PairwiseSum(
+    const floatType *const v,
+    local_int_t n
+) {
+    if (n <= 8) {
+        floatType sum = 0.0;
+        for (local_int_t i = 0; i < n; i++) sum += v[i];
+        return sum;
+    }
+    const local_int_t h = n / 2;
+    return PairwiseSum(v, h) + PairwiseSum(v + h, n - h);
+}
+
+/**
+ * x'y over the first n entries, by blocks of LGNCG_DOT_BLOCK entries summed by
+ * DotProductBlock, threaded with OpenMP if threaded is set. Built with
+ * LGNCG_PAIRWISE_DOT, the block sums are added by PairwiseSum, so that the
+ * result does not depend on the number of threads.
+ */
+inline floatType
+DotProductSum(
+    const floatType *const xv,
+    const floatType *const yv,
+    local_int_t n,
+    bool threaded
+) {
+    const local_int_t nBlocks = (n + LGNCG_DOT_BLOCK - 1) / LGNCG_DOT_BLOCK;
+#ifdef LGNCG_PAIRWISE_DOT
+    std::vector<floatType> sums(nBlocks);
+    LGNCG_OMP_FOR(if(threaded))
+    for (local_int_t b = 0; b < nBlocks; b++) {
+        const local_int_t lo = b * LGNCG_DOT_BLOCK;
+        sums[b] = DotProductBlock(
+                      xv, yv, lo, std::min<local_int_t>(n, lo + LGNCG_DOT_BLOCK)
+                  );
+    }
+    return PairwiseSum(sums.data(), nBlocks);
+#else
+    floatType sum = 0.0;
+    LGNCG_OMP_FOR(if(threaded) reduction(+:sum))
+    for (local_int_t b = 0; b < nBlocks; b++) {
+        const local_int_t lo = b * LGNCG_DOT_BLOCK;
+        sum += DotProductBlock(
+                   xv, yv, lo, std::min<local_int_t>(n, lo + LGNCG_DOT_BLOCK)
+               );
+    }
+    return sum;
+#endif
+}
 
 /**
  *
@@ -72,7 +158,9 @@ struct ComputeDotProductArgs {
     @param[in] x, y the input vectors
     @param[in] result a pointer to scalar value, on exit will contain result.
     @param[out] timeAllreduce the time it took to perform the communication
-    between processes
+    between processes, only its launch without --timekernels, see
+    timedAllReduce
+    @param[in] threaded whether to thread the loop with OpenMP
 
     @return returns 0 upon success and non-zero otherwise
 
@@ -84,23 +172,19 @@ ComputeDotProductKernel(
     Array<floatType> &x,
     Array<floatType> &y,
     const ComputeDotProductArgs &args,
-    floatType &result
+    floatType &result,
+    bool threaded = false
 ) {
     assert(x.length() >= size_t(args.n));
     assert(y.length() >= size_t(args.n));
     //
-    floatType local_result = 0.0;
-    //
     const floatType *const xv = x.data();
     assert(xv);
     //
     const floatType *const yv = y.data();
     assert(yv);
     //
-    const local_int_t n = args.n;
-    for (local_int_t i = 0; i < n; i++) local_result += xv[i] * yv[i];
-    //
-    result = local_result;
+    result = DotProductSum(xv, yv, args.n, threaded);
     //
     return 0;
 }
@@ -114,7 +198,7 @@ ComputeDotProduct(
     Array<floatType> &x,
     Array<floatType> &y,
     Future &resultFuture,
-    double &timeAllreduce, // FIXME
+    double &timeAllreduce,
     Item< DynColl<floatType> > &dcReduceSum,
     Context ctx,
     Runtime *lrt
@@ -142,13 +226,149 @@ ComputeDotProduct(
     rc = ComputeDotProductKernel(x, y, args, localResult);
     localFuture = Future::from_value(lrt, localResult);
 #endif
-    double t0 = mytimer(); // FIXME
-    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
-    timeAllreduce += mytimer() - t0;
+    resultFuture = timedAllReduce(
+                       localFuture, dcReduceSum, timeAllreduce, ctx, lrt
+                   );
+    //
+    return rc;
+}
+
+/**
+ *
+ */
+struct ComputeFusedDotProductArgs {
+    local_int_t n;
+    int nDots;
+};
+
+/**
+ * result[d] = x[d]' * y[d] for d < nDots, the rest of result zero.
+ */
+inline int
+ComputeFusedDotProductKernel(
+    Array<floatType> *const x[],
+    Array<floatType> *const y[],
+    const ComputeFusedDotProductArgs &args,
+    FusedDots &result,
+    bool threaded = false
+) {
+    assert(args.nDots <= LGNCG_MAX_FUSED_DOTS);
+    //
+    result.fill(0.0);
+    //
+    const local_int_t n = args.n;
+    for (int d = 0; d < args.nDots; ++d) {
+        assert(x[d]->length() >= size_t(n));
+        assert(y[d]->length() >= size_t(n));
+        //
+        const floatType *const xv = x[d]->data();
+        assert(xv);
+        //
+        const floatType *const yv = y[d]->data();
+        assert(yv);
+        //
+        result[d] = DotProductSum(xv, yv, n, threaded);
+    }
+    //
+    return 0;
+}
+
+/**
+ * Computes up to LGNCG_MAX_FUSED_DOTS dot products x[d]' * y[d] and reduces
+ * them across shards with a single collective. resultFuture holds a FusedDots
+ * whose first nDots entries are the global results.
+ */
+inline int
+ComputeFusedDotProduct(
+    local_int_t n,
+    int nDots,
+    Array<floatType> *const x[],
+    Array<floatType> *const y[],
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<FusedDots> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    assert(nDots > 0 && nDots <= LGNCG_MAX_FUSED_DOTS);
+    //
+    ComputeFusedDotProductArgs args = {
+        .n = n,
+        .nDots = nDots
+    };
+    //
+    Future localFuture;
+    //
+    int rc = 0;
+#ifdef LGNCG_TASKING
+    //
+    TaskLauncher tl(
+        FUSED_DDOT_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    for (int d = 0; d < nDots; ++d) {
+        x[d]->intent(RO_E, tl, ctx, lrt);
+        y[d]->intent(RO_E, tl, ctx, lrt);
+    }
+    //
+    localFuture = lrt->execute_task(ctx, tl);
+#else
+    FusedDots localResult;
+    rc = ComputeFusedDotProductKernel(x, y, args, localResult);
+    localFuture = Future::from_value(lrt, localResult);
+#endif
+    resultFuture = timedAllReduce(
+                       localFuture, dcReduceSum, timeAllreduce, ctx, lrt
+                   );
     //
     return rc;
 }
 
+/**
+ * The column dot products of the nPairs pairs of block vectors x[p] and y[p]
+ * of k columns, interleaved, over n rows, see BlockCG.hpp: entry p * k + j of
+ * resultFuture, a FusedDots, is x[p]' * y[p] of column j, reduced across
+ * shards with a single collective.
+ */
+inline int
+ComputeBlockDotProduct(
+    local_int_t n,
+    int k,
+    int nPairs,
+    Array<floatType> *const x[],
+    Array<floatType> *const y[],
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<FusedDots> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    assert(nPairs * k <= LGNCG_MAX_FUSED_DOTS);
+    //
+    FusedDots localResult;
+    localResult.fill(0.0);
+    for (int p = 0; p < nPairs; ++p) {
+        assert(x[p]->length() >= size_t(n) * k);
+        assert(y[p]->length() >= size_t(n) * k);
+        const floatType *const xv = x[p]->data();
+        const floatType *const yv = y[p]->data();
+        //
+        for (local_int_t i = 0; i < n; ++i) {
+            const size_t off = size_t(i) * k;
+            for (int j = 0; j < k; ++j) {
+                localResult[p * k + j] += xv[off + j] * yv[off + j];
+            }
+        }
+    }
+    resultFuture = timedAllReduce(
+                       Future::from_value(lrt, localResult),
+                       dcReduceSum, timeAllreduce, ctx, lrt
+                   );
+    //
+    return 0;
+}
+
 /**
  *
  */
@@ -164,8 +384,43 @@ ComputeDotProductTask(
     Array<floatType> x(regions[0], ctx, lrt);
     Array<floatType> y(regions[1], ctx, lrt);
     //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        return lgncgCUDADotProduct(args->n, x.data(), y.data());
+    }
+#endif
     floatType localResult = 0.0;
-    ComputeDotProductKernel(x, y, *args, localResult);
+    ComputeDotProductKernel(x, y, *args, localResult, runsThreaded(task));
+    //
+    return localResult;
+}
+
+/**
+ *
+ */
+FusedDots
+ComputeFusedDotProductTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeFusedDotProductArgs *)task->args;
+    // Regions come in x, y pairs.
+    Array<floatType> *x[LGNCG_MAX_FUSED_DOTS];
+    Array<floatType> *y[LGNCG_MAX_FUSED_DOTS];
+    for (int d = 0; d < args->nDots; ++d) {
+        x[d] = new Array<floatType>(regions[2 * d], ctx, lrt);
+        y[d] = new Array<floatType>(regions[2 * d + 1], ctx, lrt);
+    }
+    //
+    FusedDots localResult;
+    ComputeFusedDotProductKernel(x, y, *args, localResult, runsThreaded(task));
+    //
+    for (int d = 0; d < args->nDots; ++d) {
+        delete x[d];
+        delete y[d];
+    }
     //
     return localResult;
 }
@@ -178,10 +433,52 @@ registerDDotTasks(void)
         DDOT_TID /* task id */,
         Processor::LOC_PROC /* proc kind  */,
         true /* single */,
-        false /* index */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<floatType, ComputeDotProductTask>(
+        DDOT_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<floatType, ComputeDotProductTask>(
+        DDOT_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
         AUTO_GENERATE_ID,
         TaskConfigOptions(true /* leaf task */),
         "ComputeDotProductTask"
     );
+#endif
+    HighLevelRuntime::register_legion_task<FusedDots, ComputeFusedDotProductTask>(
+        FUSED_DDOT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeFusedDotProductTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<FusedDots, ComputeFusedDotProductTask>(
+        FUSED_DDOT_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeFusedDotProductTask"
+    );
+#endif
 #endif
 }
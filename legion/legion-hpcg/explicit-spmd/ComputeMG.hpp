@@ -58,6 +58,130 @@
 
 #include <iostream>
 
+/**
+ * The V-cycle of ComputeMG on an agglomerated level and the ones below it: r
+ * gathered onto every shard by one allReduce, the V-cycle of the whole level
+ * solved by each, and its rows kept in x, see AgglomeratedMG.hpp. No halo is
+ * exchanged on these levels.
+ */
+inline int
+ComputeAgglomeratedMG(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    AgglomeratedMG &amg = *A.agglomerated;
+    //
+    AgglomeratedVector lr;
+    amg.gather(r.data(), lr);
+    Future localFuture = Future::from_value(lrt, lr);
+    const AgglomeratedVector gr = allReduce(
+        localFuture, *A.dcAllRedSumAV, ctx, lrt
+    ).get_result<AgglomeratedVector>(disableWarnings);
+    //
+    ZeroVectorKernel(x);
+    amg.solve(gr, x.data());
+    //
+    return 0;
+}
+
+/**
+ * The V-cycle of ComputeMG on a level with inlineMG set, and so on all the
+ * coarser ones, in the shard task itself: the kernels run on the mapped
+ * regions of the shard and no task is launched, which on the small coarse
+ * levels costs more than the work. Halos are still exchanged by ExchangeHalo,
+ * through the phase barriers of the level, which waits for the pulls.
+ */
+inline int
+ComputeMGInline(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    assert(A.inlineMG);
+    KernelTimer timer(A.mgTime, ctx, lrt);
+    //
+    if (A.agglomerated) return ComputeAgglomeratedMG(A, r, x, ctx, lrt);
+    // The first SYMGS needs no halo exchange of the zeros.
+    ZeroVectorKernel(x);
+    markGhostsZero(x);
+    //
+    int ierr = 0;
+    if (A.mgData != NULL) {
+        const int nPre = A.mgData->numberOfPresmootherSteps;
+        for (int i = 0; i < nPre; ++i) {
+            ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeRestrictionFused(A, x, r, ctx, lrt);
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeMGInline(*A.Ac, *A.mgData->rc, *A.mgData->xc, ctx, lrt);
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeProlongation(A, x, ctx, lrt);
+        if (ierr != 0) return ierr;
+        const int nPost = A.mgData->numberOfPostsmootherSteps;
+        for (int i = 0; i < nPost; ++i) {
+            ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+        }
+        return ierr;
+    }
+    return ComputeSYMGS(A, r, x, ctx, lrt);
+}
+
+/**
+ * The V-cycle of ComputeMGInline for the k columns of the block vectors r and
+ * x, interleaved, in the shard task, through the block MG data of the levels,
+ * see BlockCG.hpp. SYMGS sweeps in the natural order.
+ */
+inline int
+ComputeBlockMG(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    int k,
+    Context ctx,
+    Runtime *lrt
+) {
+    KernelTimer timer(A.mgTime, ctx, lrt);
+    //
+    ZeroVectorKernel(x);
+    markGhostsZero(x);
+    //
+    int ierr = 0;
+    if (A.mgData != NULL) {
+        assert(A.blockMGData);
+        const int nPre = A.mgData->numberOfPresmootherSteps;
+        for (int i = 0; i < nPre; ++i) {
+            ierr += ComputeBlockSYMGS(A, r, x, k, ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeBlockRestriction(A, x, r, k, ctx, lrt);
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeBlockMG(
+                   *A.Ac, *A.blockMGData->rc, *A.blockMGData->xc, k, ctx, lrt
+               );
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeBlockProlongation(A, x, k);
+        if (ierr != 0) return ierr;
+        const int nPost = A.mgData->numberOfPostsmootherSteps;
+        for (int i = 0; i < nPost; ++i) {
+            ierr += ComputeBlockSYMGS(A, r, x, k, ctx, lrt);
+        }
+        return ierr;
+    }
+    return ComputeBlockSYMGS(A, r, x, k, ctx, lrt);
+}
+
 /*!
     @param[in] A the known system matrix.
 
@@ -82,8 +206,16 @@ ComputeMG(
     assert(Asclrs);
     // Make sure x contain space for halo values.
     assert(x.length() == size_t(Asclrs->localNumberOfColumns));
-    // Initialize x to zero.
+    // The whole V-cycle in the shard task, once the tasks before are done.
+    if (A.inlineMG) {
+        waitForLaunched(ctx, lrt);
+        return ComputeMGInline(A, r, x, ctx, lrt);
+    }
+    KernelTimer timer(A.mgTime, ctx, lrt);
+    // Initialize x to zero, ghosts included, so the first SYMGS needs no halo
+    // exchange.
     ZeroVector(x, ctx, lrt);
+    markGhostsZero(x);
     //
     int ierr = 0;
     // Go to next coarse level if defined
@@ -94,10 +226,9 @@ ComputeMG(
         }
         if (ierr != 0) return ierr;
         //
-        ierr = ComputeSPMV(A, x, *A.mgData->Axf, ctx, lrt);
-        if (ierr != 0) return ierr;
-        // Perform restriction operation using simple injection.
-        ierr = ComputeRestriction(A, r, ctx, lrt);
+        // Perform restriction operation using simple injection, of the
+        // residual at the injected points alone.
+        ierr = ComputeRestrictionFused(A, x, r, ctx, lrt);
         if (ierr != 0) return ierr;
         //
         ierr = ComputeMG(*A.Ac, *A.mgData->rc, *A.mgData->xc, ctx, lrt);
@@ -72,6 +72,10 @@ struct ComputeProlongationArgs {
     compute it for the fine grid points that will be injected into corresponding
     coarse grid points.
 
+    @param[in] threaded - Whether to thread the loop with OpenMP. f2c maps
+               each coarse point to a distinct fine point, so the updates do
+               not collide.
+
     @return Returns zero on success and a non-zero value otherwise.
 */
 inline int
@@ -79,7 +83,8 @@ ComputeProlongationKernel(
     Array<floatType>              &Afxc,
     Array<local_int_t>            &Aff2cOperator,
     Array<floatType>              &xf,
-    const ComputeProlongationArgs &args
+    const ComputeProlongationArgs &args,
+    bool                          threaded = false
 ) {
     const floatType *const xcv = Afxc.data();
     assert(xcv);
@@ -91,6 +96,7 @@ ComputeProlongationKernel(
     //
     const local_int_t nc = args.nc;
 
+    LGNCG_OMP_FOR(if(threaded))
     for (local_int_t i = 0; i < nc; ++i) {
         xfv[f2c[i]] += xcv[i];
     }
@@ -112,7 +118,14 @@ ComputeProlongation(
         .nc = local_int_t(Af.mgData->rc->length())
     };
 #ifdef LGNCG_TASKING
-    //
+    if (Af.Ac->inlineMG) {
+        return ComputeProlongationKernel(
+                   *Af.mgData->xc,
+                   *Af.mgData->f2cOperator,
+                   xf,
+                   args
+               );
+    }
     TaskLauncher tl(
         PROLONGATION_TID,
         TaskArgument(&args, sizeof(args))
@@ -135,6 +148,33 @@ ComputeProlongation(
 #endif
 }
 
+/**
+ * ComputeProlongation for block vectors of k columns in the shard task, from
+ * the xc of Af.blockMGData.
+ */
+inline int
+ComputeBlockProlongation(
+    SparseMatrix &Af,
+    Array<floatType> &xf,
+    int k
+) {
+    const floatType *const xcv = Af.blockMGData->xc->data();
+    assert(xcv);
+    const local_int_t *const f2c = Af.mgData->f2cOperator->data();
+    assert(f2c);
+    floatType *const xfv = xf.data();
+    assert(xfv);
+    //
+    const local_int_t nc = Af.blockMGData->rc->length() / k;
+    for (local_int_t i = 0; i < nc; ++i) {
+        for (int j = 0; j < k; ++j) {
+            xfv[size_t(f2c[i]) * k + j] += xcv[size_t(i) * k + j];
+        }
+    }
+    //
+    return 0;
+}
+
 /**
  *
  */
@@ -153,11 +193,18 @@ ComputeProlongationTask(
     //
     Array<floatType> xf(regions[rid++], ctx, lrt);
     //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        lgncgCUDAProlongation(args->nc, Afxc.data(), Aff2c.data(), xf.data());
+        return;
+    }
+#endif
     ComputeProlongationKernel(
         Afxc,
         Aff2c,
         xf,
-        *args
+        *args,
+        runsThreaded(task)
     );
 }
 
@@ -177,5 +224,27 @@ registerProlongationTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeProlongationTask"
     );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeProlongationTask>(
+        PROLONGATION_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeProlongationTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeProlongationTask>(
+        PROLONGATION_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeProlongationTask"
+    );
+#endif
 #endif
 }
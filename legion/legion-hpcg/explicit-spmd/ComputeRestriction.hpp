@@ -51,6 +51,7 @@
 #include "LegionStuff.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
+#include "ComputeSPMV.hpp"
 
 /*!
     Routine to compute the coarse residual vector.
@@ -66,6 +67,8 @@
     compute it for the fine grid points that will be injected into corresponding
     coarse grid points.
 
+    @param[in]    threaded - Whether to thread the loop with OpenMP.
+
     @return Returns zero on success and a non-zero value otherwise.
 */
 inline int
@@ -73,7 +76,8 @@ ComputeRestrictionKernel(
     Array<floatType>   &Axf,
     Array<local_int_t> &Af2c,
     Array<floatType>   &rc,
-    Array<floatType>   &rf
+    Array<floatType>   &rf,
+    bool               threaded = false
 ) {
     const floatType *const Axfv = Axf.data();
     const local_int_t *const f2c = Af2c.data();
@@ -82,6 +86,7 @@ ComputeRestrictionKernel(
     const floatType *const rfv = rf.data();
 
     const local_int_t nc = rc.length();
+    LGNCG_OMP_FOR(if(threaded))
     for (local_int_t i = 0; i < nc; ++i) {
         rcv[i] = rfv[f2c[i]] - Axfv[f2c[i]];
     }
@@ -97,7 +102,17 @@ ComputeRestriction(
     Runtime *lrt
 ) {
 #ifdef LGNCG_TASKING
-    //
+    // The coarse level runs in the shard task, see ComputeMGInline, and this
+    // reads what the tasks of this one wrote.
+    if (A.Ac->inlineMG) {
+        waitForLaunched(ctx, lrt);
+        return ComputeRestrictionKernel(
+                   *A.mgData->Axf,
+                   *A.mgData->f2cOperator,
+                   *A.mgData->rc,
+                   rf
+               );
+    }
     TaskLauncher tl(
         RESTRICTION_TID,
         TaskArgument(NULL, 0)
@@ -121,6 +136,194 @@ ComputeRestriction(
 #endif
 }
 
+/**
+ * rc[i] = rf[f2c[i]] - A(f2c[i],:)x: the restriction of the fine residual
+ * r - Ax, with the rows of A at the injected points alone, from the CSR rows
+ * of A, summed as by ComputeSPMVKernel. Axf is not written.
+ */
+inline int
+ComputeFusedRestrictionKernel(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<local_int_t>     &Af2c,
+    Array<floatType>       &x,
+    Array<floatType>       &rf,
+    Array<floatType>       &rc,
+    int                    stencilSize,
+    bool                   threaded = false
+) {
+    const matrixFloatType *const vals = matrixValues.data();
+    const mtx_ind_t *const inds = mtxIndL.data();
+    const char *const nnz = nonzerosInRow.data();
+    // Rows of A.
+    const local_int_t nrow = nonzerosInRow.length();
+    const local_int_t *const f2c = Af2c.data();
+    const floatType *const xv = x.data();
+    const floatType *const rfv = rf.data();
+    floatType *const rcv = rc.data();
+    //
+    const local_int_t nc = rc.length();
+    if (stencilSize == HPCG_STENCIL) {
+        LGNCG_OMP_FOR(if(threaded))
+        for (local_int_t i = 0; i < nc; ++i) {
+            const local_int_t row = f2c[i];
+            const size_t off = size_t(row) * stencilSize;
+            rcv[i] = rfv[row] - SPMVRow<HPCG_STENCIL>(
+                         vals + off, inds + off, nnz[row], row, nrow, xv
+                     );
+        }
+    }
+    else {
+        LGNCG_OMP_FOR(if(threaded))
+        for (local_int_t i = 0; i < nc; ++i) {
+            const local_int_t row = f2c[i];
+            const size_t off = size_t(row) * stencilSize;
+            rcv[i] = rfv[row] - SPMVRow<0>(
+                         vals + off, inds + off, nnz[row], row, nrow, xv
+                     );
+        }
+    }
+    //
+    return 0;
+}
+
+/**
+ * The coarse residual of x, the ComputeSPMV into Axf and the
+ * ComputeRestriction after it in one pass over the injected rows.
+ */
+inline int
+ComputeRestrictionFused(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &rf,
+    Context ctx,
+    Runtime *lrt
+) {
+    ExchangeHalo(A, x, ctx, lrt);
+    //
+    int stencilSize = A.geom->data()->stencilSize;
+#ifdef LGNCG_TASKING
+    if (A.Ac->inlineMG) {
+        waitForLaunched(ctx, lrt);
+        return ComputeFusedRestrictionKernel(
+                   *A.matrixValues,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.mgData->f2cOperator,
+                   x,
+                   rf,
+                   *A.mgData->rc,
+                   stencilSize
+               );
+    }
+    TaskLauncher tl(
+        RESTRICTION_FUSED_TID,
+        TaskArgument(&stencilSize, sizeof(stencilSize))
+    );
+    //
+    A.matrixValues->intent       (RO_E, tl, ctx, lrt);
+    A.mtxIndL->intent            (RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent      (RO_E, tl, ctx, lrt);
+    A.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
+    //
+    x.intent (RO_E, tl, ctx, lrt);
+    rf.intent(RO_E, tl, ctx, lrt);
+    //
+    A.mgData->rc->intent(WO_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    return 0;
+#else
+    return ComputeFusedRestrictionKernel(
+               *A.matrixValues,
+               *A.mtxIndL,
+               *A.nonzerosInRow,
+               *A.mgData->f2cOperator,
+               x,
+               rf,
+               *A.mgData->rc,
+               stencilSize
+           );
+#endif
+}
+
+/**
+ * ComputeFusedRestrictionKernel for the k columns of the block vectors x, rf
+ * and rc, interleaved, see BlockCG.hpp: rc[i * k + j] is rf[f2c[i] * k + j]
+ * minus the row f2c[i] of A times column j of x.
+ */
+inline int
+ComputeBlockRestrictionKernel(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<local_int_t>     &Af2c,
+    Array<floatType>       &x,
+    Array<floatType>       &rf,
+    Array<floatType>       &rc,
+    int                    stencilSize,
+    int                    k
+) {
+    assert(k > 0 && k <= LGNCG_MAX_BLOCK);
+    //
+    const matrixFloatType *const vals = matrixValues.data();
+    const mtx_ind_t *const inds = mtxIndL.data();
+    const char *const nnz = nonzerosInRow.data();
+    // Rows of A.
+    const local_int_t nrow = nonzerosInRow.length();
+    const local_int_t *const f2c = Af2c.data();
+    const floatType *const xv = x.data();
+    const floatType *const rfv = rf.data();
+    floatType *const rcv = rc.data();
+    //
+    const local_int_t nc = rc.length() / k;
+    for (local_int_t i = 0; i < nc; ++i) {
+        const local_int_t row = f2c[i];
+        const size_t off = size_t(row) * stencilSize;
+        double sums[LGNCG_MAX_BLOCK] = {0.0};
+        for (int e = 0; e < nnz[row]; e++) {
+            const matrixFloatType v = vals[off + e];
+            const floatType *const xe =
+                xv + size_t(MtxIndColumn(row, inds[off + e], nrow)) * k;
+            for (int j = 0; j < k; j++) sums[j] += v * xe[j];
+        }
+        for (int j = 0; j < k; j++) {
+            rcv[size_t(i) * k + j] = rfv[size_t(row) * k + j] - sums[j];
+        }
+    }
+    //
+    return 0;
+}
+
+/**
+ * ComputeRestrictionFused for block vectors of k columns in the shard task,
+ * into the rc of A.blockMGData.
+ */
+inline int
+ComputeBlockRestriction(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &rf,
+    int k,
+    Context ctx,
+    Runtime *lrt
+) {
+    ExchangeBlockHalo(A, x, k, ctx, lrt);
+    //
+    return ComputeBlockRestrictionKernel(
+               *A.matrixValues,
+               *A.mtxIndL,
+               *A.nonzerosInRow,
+               *A.mgData->f2cOperator,
+               x,
+               rf,
+               *A.blockMGData->rc,
+               A.geom->data()->stencilSize,
+               k
+           );
+}
+
 /**
  *
  */
@@ -139,11 +342,76 @@ ComputeRestrictionTask(
     //
     Array<floatType>   rf  (regions[rid++], ctx, lrt);
     //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        lgncgCUDARestriction(
+            rc.length(), Axf.data(), Af2c.data(), rf.data(), rc.data()
+        );
+        return;
+    }
+#endif
     ComputeRestrictionKernel(
         Axf,
         Af2c,
         rc,
-        rf
+        rf,
+        runsThreaded(task)
+    );
+}
+
+/**
+ *
+ */
+void
+ComputeRestrictionFusedTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const int stencilSize = *(int *)task->args;
+    //
+    int rid = 0;
+    Array<matrixFloatType> matrixValues (regions[rid++], ctx, lrt);
+    Array<mtx_ind_t>       mtxIndL      (regions[rid++], ctx, lrt);
+    Array<char>            nonzerosInRow(regions[rid++], ctx, lrt);
+    Array<local_int_t>     Af2c         (regions[rid++], ctx, lrt);
+    //
+    Array<floatType>       x (regions[rid++], ctx, lrt);
+    Array<floatType>       rf(regions[rid++], ctx, lrt);
+    //
+    Array<floatType>       rc(regions[rid++], ctx, lrt);
+    //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        const CUDAMatrix A = {
+            .values        = matrixValues.data(),
+            .colInds       = mtxIndL.data(),
+            .nrow          = local_int_t(nonzerosInRow.length()),
+            .nonzerosInRow = nonzerosInRow.data(),
+            .stencilSize   = stencilSize,
+            .chunkStart    = NULL,
+            .chunkSize     = 0,
+            .nx            = 0,
+            .ny            = 0,
+            .nz            = 0
+        };
+        lgncgCUDAFusedRestriction(
+            A, rc.length(), x.data(), Af2c.data(), rf.data(), rc.data()
+        );
+        return;
+    }
+#endif
+    ComputeFusedRestrictionKernel(
+        matrixValues,
+        mtxIndL,
+        nonzerosInRow,
+        Af2c,
+        x,
+        rf,
+        rc,
+        stencilSize,
+        runsThreaded(task)
     );
 }
 
@@ -163,5 +431,58 @@ registerRestrictionTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeRestrictionTask"
     );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeRestrictionTask>(
+        RESTRICTION_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeRestrictionTask>(
+        RESTRICTION_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionTask"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<ComputeRestrictionFusedTask>(
+        RESTRICTION_FUSED_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionFusedTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeRestrictionFusedTask>(
+        RESTRICTION_FUSED_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionFusedTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeRestrictionFusedTask>(
+        RESTRICTION_FUSED_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionFusedTask"
+    );
+#endif
 #endif
 }
@@ -47,6 +47,19 @@
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 #include "ExchangeHalo.hpp"
+#include "CollectiveOps.hpp"
+
+#include "mytimer.hpp"
+
+/**
+ * Rows of an SpMV task: all of them, the interior ones of SetupHalo, which
+ * read no external value of x, or the others.
+ */
+enum SPMVRows {
+    SPMV_ROWS_ALL = 0,
+    SPMV_ROWS_INTERIOR,
+    SPMV_ROWS_BOUNDARY
+};
 
 /**
  *
@@ -55,8 +68,143 @@ struct ComputeSPMVArgs {
     local_int_t localNumberOfColumns;
     local_int_t localNumberOfRows;
     int stencilSize;
+    // Local grid dimensions, used by the matrix-free kernel.
+    int nx;
+    int ny;
+    int nz;
+    // The matrix is the SELL copy of OptimizeProblem.
+    bool sell;
+    // Interior rows are computed from the stencil, see OptimizeProblem.
+    bool matrixFree;
+    // Rows to compute, an SPMVRows, and the interior ones of the matrix.
+    int rows;
+    GridBox interior;
+};
+
+/**
+ * At most two ranges [lo[k], hi[k]), k < n, of points along x.
+ */
+struct SPMVLineRanges {
+    int n;
+    local_int_t lo[2];
+    local_int_t hi[2];
 };
 
+/**
+ * The points of line (iy, iz) of the local grid that are rows of the task,
+ * see SPMVRows.
+ */
+inline SPMVLineRanges
+SPMVSelectLine(
+    const ComputeSPMVArgs &args,
+    local_int_t iy,
+    local_int_t iz
+) {
+    const GridBox &b = args.interior;
+    const bool interiorLine = iy >= b.lo[1] && iy < b.hi[1]
+                           && iz >= b.lo[2] && iz < b.hi[2];
+    switch (args.rows) {
+        case SPMV_ROWS_INTERIOR:
+            if (interiorLine) return {1, {b.lo[0], 0}, {b.hi[0], 0}};
+            return {0, {0, 0}, {0, 0}};
+        case SPMV_ROWS_BOUNDARY:
+            if (interiorLine) return {2, {0, b.hi[0]}, {b.lo[0], args.nx}};
+            return {1, {0, 0}, {args.nx, 0}};
+        default:
+            return {1, {0, 0}, {args.nx, 0}};
+    }
+}
+
+/**
+ * Whether all 26 neighbors of point (ix, iy, iz) of the local nx by ny by nz
+ * grid are local rows, so its row of A is the plain 27-point stencil: -1 for
+ * each neighbor and the diagonal.
+ */
+inline bool
+StencilRowIsInterior(
+    int ix, int iy, int iz,
+    int nx, int ny, int nz
+) {
+    return ix > 0 && ix < nx - 1
+        && iy > 0 && iy < ny - 1
+        && iz > 0 && iz < nz - 1;
+}
+
+/**
+ * Sum of xv over the 26 neighbors of interior row i of an nx by ny grid.
+ */
+inline floatType
+StencilNeighborSum(
+    const floatType *const xv,
+    local_int_t i,
+    int nx,
+    int ny
+) {
+    const local_int_t sz = local_int_t(nx) * ny;
+    floatType sum = -xv[i];
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            const floatType *const xl = xv + i + dz * sz + dy * nx;
+            sum += xl[-1] + xl[0] + xl[1];
+        }
+    }
+    return sum;
+}
+
+/**
+ * The sum of vals[j] * xv[inds[j]] over row i of exactly W nonzeros, of a
+ * matrix with nrow rows, see MtxIndColumn. The trip
+ * count is known, so the loop unrolls, and four partial sums keep the adds
+ * from waiting on each other, which lets the compiler use gathers where the
+ * target has them. The sum is not in the order of the generic loop.
+ */
+template <int W>
+inline floatType
+SPMVFullRow(
+    const matrixFloatType *const vals,
+    const mtx_ind_t *const inds,
+    local_int_t i,
+    local_int_t nrow,
+    const floatType *const xv
+) {
+    // The column of entry j.
+    auto col = [&](int j) { return MtxIndColumn(i, inds[j], nrow); };
+    floatType s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    int j = 0;
+    for (; j + 4 <= W; j += 4) {
+        s0 += vals[j    ] * xv[col(j    )];
+        s1 += vals[j + 1] * xv[col(j + 1)];
+        s2 += vals[j + 2] * xv[col(j + 2)];
+        s3 += vals[j + 3] * xv[col(j + 3)];
+    }
+    for (; j < W; j++) s0 += vals[j] * xv[col(j)];
+    //
+    return (s0 + s1) + (s2 + s3);
+}
+
+/**
+ * Row i of nnz nonzeros times xv, by SPMVFullRow if W is not 0 and the row is
+ * full, so that all the kernels on CSR rows sum them the same way.
+ */
+template <int W>
+inline floatType
+SPMVRow(
+    const matrixFloatType *const vals,
+    const mtx_ind_t *const inds,
+    int nnz,
+    local_int_t i,
+    local_int_t nrow,
+    const floatType *const xv
+) {
+    if (W > 0 && nnz == W) return SPMVFullRow<W>(vals, inds, i, nrow, xv);
+    //
+    double sum = 0.0;
+    for (int j = 0; j < nnz; j++) {
+        sum += vals[j] * xv[MtxIndColumn(i, inds[j], nrow)];
+    }
+    return sum;
+}
+
 /*!
     Routine to compute matrix vector product y = Ax where: Precondition: First
     call exchange_externals to get off-processor values of x
@@ -64,122 +212,666 @@ struct ComputeSPMVArgs {
     @param[in]  A the known system matrix
     @param[in]  x the known vector
     @param[out] y the On exit contains the result: Ax.
+    @param[in]  threaded whether to thread the rows with OpenMP.
+    @param[out] xy if not NULL, on exit x'y over the local rows, summed as y is
+                computed, see ComputeSPMVDotProduct.
+
+    Only the rows of args.rows are computed: interior ones read the local
+    entries of x alone, see ComputeSPMVLaunch.
+
+    Rows are summed by SPMVRow<W>.
 
     @return returns 0 upon success and non-zero otherwise
 
     @see ComputeSPMV
 */
+template <int W>
 inline int
-ComputeSPMVKernel(
-    Array<floatType>      &matrixValues,
-    Array<local_int_t>    &mtxIndL,
-    Array<char>           &nonzerosInRow,
-    Array<floatType>      &x,
-    Array<floatType>      &y,
-    const ComputeSPMVArgs &args
+ComputeSPMVKernelRows(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<floatType>       &x,
+    Array<floatType>       &y,
+    const ComputeSPMVArgs  &args,
+    bool                   threaded,
+    floatType              *xy
 ) {
     // Test vector lengths
-    assert(x.length() >= size_t(args.localNumberOfColumns));
+    assert(x.length() >= size_t(args.rows == SPMV_ROWS_INTERIOR
+                                ? args.localNumberOfRows
+                                : args.localNumberOfColumns));
     assert(y.length() >= size_t(args.localNumberOfRows));
     //
     const floatType *const xv = x.data();
     floatType *const yv       = y.data();
     // Number of rows.
     const local_int_t nrow    = args.localNumberOfRows;
+    const int nx = args.nx, ny = args.ny, nz = args.nz;
+    assert(local_int_t(nx) * ny * nz == nrow);
     // Number of non-zeros per row.
     const local_int_t nzpr    = args.stencilSize;
     //
-    Array2D<floatType> AmatrixValues(nrow, nzpr, matrixValues.data());
+    Array2D<matrixFloatType> AmatrixValues(nrow, nzpr, matrixValues.data());
     //
-    Array2D<local_int_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
+    Array2D<mtx_ind_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
     //
     const char *const AnonzerosInRow = nonzerosInRow.data();
     //
-    for (local_int_t i = 0; i < nrow; i++) {
-        double sum = 0.0;
-        const floatType *const cur_vals = AmatrixValues(i);
-        const local_int_t *const cur_inds = AmtxIndL(i);
-        const int cur_nnz = AnonzerosInRow[i];
+    floatType local_xy = 0.0;
+    LGNCG_OMP_FOR(if(threaded) collapse(2) reduction(+:local_xy))
+    for (int iz = 0; iz < nz; iz++) {
+        for (int iy = 0; iy < ny; iy++) {
+            const SPMVLineRanges line = SPMVSelectLine(args, iy, iz);
+            const local_int_t first = (local_int_t(iz) * ny + iy) * nx;
+            for (int k = 0; k < line.n; k++) {
+                for (local_int_t i = first + line.lo[k];
+                     i < first + line.hi[k]; i++) {
+                    const double sum = SPMVRow<W>(
+                        AmatrixValues(i), AmtxIndL(i), AnonzerosInRow[i], i,
+                        nrow, xv
+                    );
+                    yv[i] = sum;
+                    local_xy += xv[i] * sum;
+                }
+            }
+        }
+    }
+    //
+    if (xy) *xy = local_xy;
+    //
+    return 0;
+}
+
+/**
+ * y = Ax, see ComputeSPMVKernelRows: the rows of the full 27-point stencil,
+ * most of them, take the fixed-width loop when the matrix has 27 entries per
+ * row, the others the loop over their nonzeros.
+ */
+inline int
+ComputeSPMVKernel(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<floatType>       &x,
+    Array<floatType>       &y,
+    const ComputeSPMVArgs  &args,
+    bool                   threaded = false,
+    floatType              *xy = nullptr
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSPMVKernelRows<HPCG_STENCIL>(
+                   matrixValues, mtxIndL, nonzerosInRow, x, y, args, threaded,
+                   xy
+               );
+    }
+    return ComputeSPMVKernelRows<0>(
+               matrixValues, mtxIndL, nonzerosInRow, x, y, args, threaded, xy
+           );
+}
+
+/**
+ * y = Ax with A in the SELL layout of LegionSELLData.hpp. Each chunk sums its
+ * LGNCG_SELL_C rows together, one column of the chunk at a time, so the inner
+ * loop runs over consecutive values and vectorizes. Chunks are threaded with
+ * OpenMP if threaded is set.
+ */
+inline int
+ComputeSPMVSELLKernel(
+    Array<matrixFloatType> &values,
+    Array<mtx_ind_t>       &colInds,
+    Array<local_int_t>     &AchunkStart,
+    Array<floatType>       &x,
+    Array<floatType>       &y,
+    const ComputeSPMVArgs  &args,
+    bool                   threaded = false,
+    floatType              *xy = nullptr
+) {
+    // Chunks are not split into interior and boundary rows.
+    assert(args.rows == SPMV_ROWS_ALL);
+    // Test vector lengths
+    assert(x.length() >= size_t(args.localNumberOfColumns));
+    assert(y.length() >= size_t(args.localNumberOfRows));
+    //
+    const floatType *const xv = x.data();
+    floatType *const yv       = y.data();
+    //
+    const matrixFloatType *const vals = values.data();
+    const mtx_ind_t *const cols = colInds.data();
+    const local_int_t *const chunkStart = AchunkStart.data();
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nChunks = AchunkStart.length() - 1;
+    //
+    floatType local_xy = 0.0;
+    LGNCG_OMP_FOR(if(threaded) reduction(+:local_xy))
+    for (local_int_t k = 0; k < nChunks; k++) {
+        const local_int_t base = chunkStart[k];
+        const int width = (chunkStart[k + 1] - base) / LGNCG_SELL_C;
+        const local_int_t first = k * LGNCG_SELL_C;
+        //
+        floatType sum[LGNCG_SELL_C] = {};
+        for (int j = 0; j < width; j++) {
+            const matrixFloatType *const cur_vals =
+                vals + base + j * LGNCG_SELL_C;
+            const mtx_ind_t *const cur_inds = cols + base + j * LGNCG_SELL_C;
+            for (int r = 0; r < LGNCG_SELL_C; r++) {
+                const local_int_t col =
+                    MtxIndColumn(first + r, cur_inds[r], nrow);
+                sum[r] += cur_vals[r] * xv[col];
+            }
+        }
         //
-        for (int j = 0; j < cur_nnz; j++) {
-            sum += cur_vals[j] * xv[cur_inds[j]];
+        const int rows = std::min<local_int_t>(LGNCG_SELL_C, nrow - first);
+        for (int r = 0; r < rows; r++) {
+            yv[first + r] = sum[r];
+            local_xy += xv[first + r] * sum[r];
         }
-        yv[i] = sum;
     }
     //
+    if (xy) *xy = local_xy;
+    //
     return 0;
 }
 
 /**
+ * y = Ax without reading the matrix for its interior rows, where A is the
+ * 27-point stencil and only the diagonal is loaded: the 26 neighbors of a row
+ * come from the geometry. Rows on the surface of the local grid, which may
+ * have halo or no neighbors, use the assembled matrix. Planes of rows are
+ * threaded with OpenMP if threaded is set.
+ */
+inline int
+ComputeSPMVStencilKernel(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<matrixFloatType> &matrixDiagonal,
+    Array<floatType>       &x,
+    Array<floatType>       &y,
+    const ComputeSPMVArgs  &args,
+    bool                   threaded = false,
+    floatType              *xy = nullptr
+) {
+    // Test vector lengths
+    assert(x.length() >= size_t(args.rows == SPMV_ROWS_INTERIOR
+                                ? args.localNumberOfRows
+                                : args.localNumberOfColumns));
+    assert(y.length() >= size_t(args.localNumberOfRows));
+    //
+    const floatType *const xv = x.data();
+    floatType *const yv       = y.data();
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const int nx = args.nx, ny = args.ny, nz = args.nz;
+    assert(local_int_t(nx) * ny * nz == nrow);
+    // Number of non-zeros per row.
+    const local_int_t nzpr    = args.stencilSize;
+    //
+    Array2D<matrixFloatType> AmatrixValues(nrow, nzpr, matrixValues.data());
+    //
+    Array2D<mtx_ind_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
+    //
+    const char *const AnonzerosInRow = nonzerosInRow.data();
+    const matrixFloatType *const diag = matrixDiagonal.data();
+    //
+    floatType local_xy = 0.0;
+    LGNCG_OMP_FOR(if(threaded) collapse(2) reduction(+:local_xy))
+    for (int iz = 0; iz < nz; iz++) {
+        for (int iy = 0; iy < ny; iy++) {
+            const SPMVLineRanges line = SPMVSelectLine(args, iy, iz);
+            for (int k = 0; k < line.n; k++) {
+                for (int ix = line.lo[k]; ix < line.hi[k]; ix++) {
+                    const local_int_t i = (local_int_t(iz) * ny + iy) * nx
+                                        + ix;
+                    double sum = 0.0;
+                    if (StencilRowIsInterior(ix, iy, iz, nx, ny, nz)) {
+                        sum = diag[i] * xv[i]
+                            - StencilNeighborSum(xv, i, nx, ny);
+                    }
+                    else {
+                        const matrixFloatType *const cur_vals =
+                            AmatrixValues(i);
+                        const mtx_ind_t *const cur_inds = AmtxIndL(i);
+                        const int cur_nnz = AnonzerosInRow[i];
+                        //
+                        for (int j = 0; j < cur_nnz; j++) {
+                            sum += cur_vals[j]
+                                 * xv[MtxIndColumn(i, cur_inds[j], nrow)];
+                        }
+                    }
+                    yv[i] = sum;
+                    local_xy += xv[i] * sum;
+                }
+            }
+        }
+    }
+    //
+    if (xy) *xy = local_xy;
+    //
+    return 0;
+}
+
+#ifdef LGNCG_TASKING
+/**
+ * Adds the matrix regions the kernel of args reads to tl.
+ */
+inline void
+ComputeSPMVMatrixIntents(
+    SparseMatrix &A,
+    const ComputeSPMVArgs &args,
+    TaskLauncher &tl,
+    Context ctx,
+    Runtime *lrt
+) {
+    if (args.sell) {
+        A.sell->values->intent(RO_E, tl, ctx, lrt);
+        A.sell->colInds->intent(RO_E, tl, ctx, lrt);
+        A.sell->chunkStart->intent(RO_E, tl, ctx, lrt);
+    }
+    else {
+        A.matrixValues->intent(RO_E, tl, ctx, lrt);
+        A.mtxIndL->intent(RO_E, tl, ctx, lrt);
+        A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
+        if (args.matrixFree) A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
+    }
+}
+#endif
+
+/**
+ * Runs the kernel of args on the mapped regions of A, x and y, in the calling
+ * task, and stores x'y in xy if it is not NULL: the path without
+ * LGNCG_TASKING, and the one of the levels of ComputeMGInline.
+ */
+inline int
+ComputeSPMVInline(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    const ComputeSPMVArgs &args,
+    floatType *xy
+) {
+    int rc = 0;
+    if (args.matrixFree) {
+        rc = ComputeSPMVStencilKernel(
+                 *A.matrixValues,
+                 *A.mtxIndL,
+                 *A.nonzerosInRow,
+                 *A.matrixDiagonal,
+                 x,
+                 y,
+                 args,
+                 false,
+                 xy
+             );
+    }
+    else if (args.sell) {
+        rc = ComputeSPMVSELLKernel(
+                 *A.sell->values,
+                 *A.sell->colInds,
+                 *A.sell->chunkStart,
+                 x,
+                 y,
+                 args,
+                 false,
+                 xy
+             );
+    }
+    else {
+        rc = ComputeSPMVKernel(
+                 *A.matrixValues,
+                 *A.mtxIndL,
+                 *A.nonzerosInRow,
+                 x,
+                 y,
+                 args,
+                 false,
+                 xy
+             );
+    }
+    return rc;
+}
+
+/**
+ * y = Ax, and if xyFuture is not NULL x'y over the local rows in the same
+ * pass: *xyFuture is set to the local partial sum, a floatType.
  *
+ * With neighbors, the interior rows go in a task of their own that reads only
+ * the local entries of x, so it runs while the halo is in flight; the task of
+ * the boundary rows then waits on the pulls of ExchangeHalo. The SELL chunks
+ * are not split.
  */
 inline int
-ComputeSPMV(
+ComputeSPMVLaunch(
     SparseMatrix &A,
     Array<floatType> &x,
     Array<floatType> &y,
+    Future *xyFuture,
     Context ctx,
     Runtime *lrt
 ) {
     ExchangeHalo(A, x, ctx, lrt);
     //
-    const ComputeSPMVArgs args = {
-        .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
-        .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
-        .stencilSize          = A.geom->data()->stencilSize
+    const Geometry *const Ageom = A.geom->data();
+    const SparseMatrixScalars *const Asclrs = A.sclrs->data();
+    ComputeSPMVArgs args = {
+        .localNumberOfColumns = Asclrs->localNumberOfColumns,
+        .localNumberOfRows    = Asclrs->localNumberOfRows,
+        .stencilSize          = Ageom->stencilSize,
+        .nx                   = Ageom->nx,
+        .ny                   = Ageom->ny,
+        .nz                   = Ageom->nz,
+        .sell                 = (A.sell != nullptr && !A.matrixFree),
+        .matrixFree           = A.matrixFree,
+        .rows                 = SPMV_ROWS_ALL,
+        .interior             = Asclrs->interior
     };
     //
 #ifdef LGNCG_TASKING
+    if (A.inlineMG) {
+        floatType xy = 0.0;
+        const int rc = ComputeSPMVInline(A, x, y, args, &xy);
+        if (xyFuture) *xyFuture = Future::from_value(lrt, xy);
+        return rc;
+    }
+    const int tid = xyFuture ? SPMV_DDOT_TID : SPMV_TID;
+    const bool overlap = !args.sell && Asclrs->numberOfSendNeighbors > 0;
     //
-    TaskLauncher tl(
-        SPMV_TID,
-        TaskArgument(&args, sizeof(args))
-    );
+    Future interiorFuture;
+    if (overlap) {
+        args.rows = SPMV_ROWS_INTERIOR;
+        TaskLauncher tl(tid, TaskArgument(&args, sizeof(args)));
+        ComputeSPMVMatrixIntents(A, args, tl, ctx, lrt);
+        // Not the ghosts, which are still being pulled.
+        const LogicalRegion xPrivateLR = getPrivateLogicalRegion(x);
+        tl.add_region_requirement(
+            RegionRequirement(xPrivateLR, RO_E, x.logicalRegion)
+        ).add_field(x.fid);
+        //
+        y.intent(WO_E, tl, ctx, lrt);
+        //
+        interiorFuture = lrt->execute_task(ctx, tl);
+        args.rows = SPMV_ROWS_BOUNDARY;
+    }
     //
-    A.matrixValues->intent(RO_E, tl, ctx, lrt);
-    A.mtxIndL->intent(RO_E, tl, ctx, lrt);
-    A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
+    TaskLauncher tl(tid, TaskArgument(&args, sizeof(args)));
+    ComputeSPMVMatrixIntents(A, args, tl, ctx, lrt);
     //
     x.intent(RO_E, tl, ctx, lrt);
+    // Keep the interior rows.
+    if (overlap) y.intent(RW_E, tl, ctx, lrt);
+    else y.intent(WO_E, tl, ctx, lrt);
+    // Which adds their x'y to its own.
+    if (overlap && xyFuture) tl.add_future(interiorFuture);
     //
-    y.intent(WO_E, tl, ctx, lrt);
-    //
-    lrt->execute_task(ctx, tl);
+    Future f = lrt->execute_task(ctx, tl);
+    if (xyFuture) *xyFuture = f;
     //
     return 0;
 #else
-    return ComputeSPMVKernel(
+    floatType xy = 0.0;
+    const int rc = ComputeSPMVInline(A, x, y, args, &xy);
+    if (xyFuture) *xyFuture = Future::from_value(lrt, xy);
+    return rc;
+#endif
+}
+
+/**
+ *
+ */
+inline int
+ComputeSPMV(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeSPMVLaunch(A, x, y, NULL, ctx, lrt);
+}
+
+/**
+ * y = Ax and resultFuture = x'y, reduced across shards, in one task: y is not
+ * read back from memory for the dot product, see ComputeDotProduct.
+ */
+inline int
+ComputeSPMVDotProduct(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    Future localFuture;
+    const int rc = ComputeSPMVLaunch(A, x, y, &localFuture, ctx, lrt);
+    //
+    resultFuture = timedAllReduce(
+                       localFuture, dcReduceSum, timeAllreduce, ctx, lrt
+                   );
+    //
+    return rc;
+}
+
+/**
+ * Y = AX for the block vectors X and Y of k right-hand sides, interleaved, so
+ * that entry i of column j is at i * k + j, see BlockCG.hpp. Each value and
+ * column index of the CSR rows of A is read once for all k columns, which
+ * sum in the order of SPMVRow<0>.
+ */
+inline int
+ComputeBlockSPMVKernel(
+    Array<matrixFloatType> &matrixValues,
+    Array<mtx_ind_t>       &mtxIndL,
+    Array<char>            &nonzerosInRow,
+    Array<floatType>       &x,
+    Array<floatType>       &y,
+    int                    stencilSize,
+    int                    k
+) {
+    assert(k > 0 && k <= LGNCG_MAX_BLOCK);
+    // Rows of A.
+    const local_int_t nrow = nonzerosInRow.length();
+    assert(y.length() >= size_t(nrow) * k);
+    //
+    const matrixFloatType *const vals = matrixValues.data();
+    const mtx_ind_t *const inds = mtxIndL.data();
+    const char *const nnz = nonzerosInRow.data();
+    const floatType *const xv = x.data();
+    floatType *const yv = y.data();
+    //
+    for (local_int_t i = 0; i < nrow; i++) {
+        const size_t off = size_t(i) * stencilSize;
+        double sums[LGNCG_MAX_BLOCK] = {0.0};
+        for (int e = 0; e < nnz[i]; e++) {
+            const matrixFloatType v = vals[off + e];
+            const floatType *const xe =
+                xv + size_t(MtxIndColumn(i, inds[off + e], nrow)) * k;
+            for (int j = 0; j < k; j++) sums[j] += v * xe[j];
+        }
+        for (int j = 0; j < k; j++) yv[size_t(i) * k + j] = sums[j];
+    }
+    //
+    return 0;
+}
+
+/**
+ * Y = AX for block vectors of k columns in the shard task, after one
+ * ExchangeBlockHalo for all of them.
+ */
+inline int
+ComputeBlockSPMV(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    int k,
+    Context ctx,
+    Runtime *lrt
+) {
+    ExchangeBlockHalo(A, x, k, ctx, lrt);
+    //
+    return ComputeBlockSPMVKernel(
                *A.matrixValues,
                *A.mtxIndL,
                *A.nonzerosInRow,
                x,
                y,
-               args
+               A.geom->data()->stencilSize,
+               k
            );
-#endif
 }
 
+#ifdef LGNCG_CUDA
 /**
- *
+ * y = Ax over the rows of args on the GPU of the task, see lgncgCUDASPMV.
  */
-void
-ComputeSPMVTask(
+inline void
+ComputeSPMVCUDA(
+    const CUDAMatrix      &A,
+    Array<floatType>      &x,
+    Array<floatType>      &y,
+    const ComputeSPMVArgs &args,
+    floatType             *xy
+) {
+    const floatType localXY = lgncgCUDASPMV(
+        A, args.rows, args.interior.lo, args.interior.hi, x.data(), y.data(),
+        xy != NULL
+    );
+    if (xy) *xy = localXY;
+}
+#endif
+
+/**
+ * Unpacks the regions of SPMV_TID and SPMV_DDOT_TID and runs the kernel of
+ * the matrix layout, which stores x'y in xy if it is not NULL.
+ */
+inline void
+ComputeSPMVFromRegions(
     const Task *task,
     const std::vector<PhysicalRegion> &regions,
+    floatType *xy,
     Context ctx,
     Runtime *lrt
 ) {
     const auto *const args = (ComputeSPMVArgs *)task->args;
     //
+    if (args->sell) {
+        int rid = 0;
+        Array<matrixFloatType> values(regions[rid++], ctx, lrt);
+        Array<mtx_ind_t> colInds(regions[rid++], ctx, lrt);
+        Array<local_int_t> chunkStart(regions[rid++], ctx, lrt);
+        //
+        Array<floatType> x(regions[rid++], ctx, lrt);
+        Array<floatType> y(regions[rid++], ctx, lrt);
+        //
+#ifdef LGNCG_CUDA
+        if (runsOnGPU(task)) {
+            const CUDAMatrix A = {
+                .values        = values.data(),
+                .colInds       = colInds.data(),
+                .nrow          = args->localNumberOfRows,
+                .nonzerosInRow = NULL,
+                .stencilSize   = args->stencilSize,
+                .chunkStart    = chunkStart.data(),
+                .chunkSize     = LGNCG_SELL_C,
+                .nx            = args->nx,
+                .ny            = args->ny,
+                .nz            = args->nz
+            };
+            ComputeSPMVCUDA(A, x, y, *args, xy);
+            return;
+        }
+#endif
+        ComputeSPMVSELLKernel(
+            values, colInds, chunkStart, x, y, *args, runsThreaded(task), xy
+        );
+        return;
+    }
+    //
     int rid = 0;
-    Array<floatType> matrixValues(regions[rid++], ctx, lrt);
-    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<matrixFloatType> matrixValues(regions[rid++], ctx, lrt);
+    Array<mtx_ind_t> mtxIndL(regions[rid++], ctx, lrt);
     Array<char> nonzerosInRow(regions[rid++], ctx, lrt);
+    // The GPU reads the assembled matrix for all rows, matrix-free or not.
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        if (args->matrixFree) rid++;
+        //
+        Array<floatType> x(regions[rid++], ctx, lrt);
+        Array<floatType> y(regions[rid++], ctx, lrt);
+        //
+        const CUDAMatrix A = {
+            .values        = matrixValues.data(),
+            .colInds       = mtxIndL.data(),
+            .nrow          = args->localNumberOfRows,
+            .nonzerosInRow = nonzerosInRow.data(),
+            .stencilSize   = args->stencilSize,
+            .chunkStart    = NULL,
+            .chunkSize     = 0,
+            .nx            = args->nx,
+            .ny            = args->ny,
+            .nz            = args->nz
+        };
+        ComputeSPMVCUDA(A, x, y, *args, xy);
+        return;
+    }
+#endif
+    if (args->matrixFree) {
+        Array<matrixFloatType> matrixDiagonal(regions[rid++], ctx, lrt);
+        //
+        Array<floatType> x(regions[rid++], ctx, lrt);
+        Array<floatType> y(regions[rid++], ctx, lrt);
+        //
+        ComputeSPMVStencilKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal, x, y, *args,
+            runsThreaded(task), xy
+        );
+        return;
+    }
     //
     Array<floatType> x(regions[rid++], ctx, lrt);
     Array<floatType> y(regions[rid++], ctx, lrt);
     //
-    ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, *args);
+    ComputeSPMVKernel(
+        matrixValues, mtxIndL, nonzerosInRow, x, y, *args, runsThreaded(task),
+        xy
+    );
+}
+
+/**
+ *
+ */
+void
+ComputeSPMVTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeSPMVFromRegions(task, regions, NULL, ctx, lrt);
+}
+
+/**
+ * Returns the local x'y.
+ */
+floatType
+ComputeSPMVDotProductTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    floatType localResult = 0.0;
+    ComputeSPMVFromRegions(task, regions, &localResult, ctx, lrt);
+    // The boundary rows add the x'y of the interior ones, see
+    // ComputeSPMVLaunch.
+    if (!task->futures.empty()) {
+        localResult += task->futures[0].get_result<floatType>(disableWarnings);
+    }
+    //
+    return localResult;
 }
 
 /**
@@ -198,5 +890,58 @@ registerSPMVTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeSPMVTask"
     );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeSPMVTask>(
+        SPMV_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeSPMVTask>(
+        SPMV_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVTask"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<floatType, ComputeSPMVDotProductTask>(
+        SPMV_DDOT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVDotProductTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<floatType, ComputeSPMVDotProductTask>(
+        SPMV_DDOT_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVDotProductTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<floatType, ComputeSPMVDotProductTask>(
+        SPMV_DDOT_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVDotProductTask"
+    );
+#endif
 #endif
 }
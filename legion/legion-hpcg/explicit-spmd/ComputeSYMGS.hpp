@@ -52,6 +52,7 @@
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 #include "ExchangeHalo.hpp"
+#include "ComputeSPMV.hpp"
 
 #include <cassert>
 
@@ -62,6 +63,16 @@ struct ComputeSYMGSArgs {
     local_int_t localNumberOfColumns;
     local_int_t localNumberOfRows;
     int stencilSize;
+    // Local grid dimensions, for the multicolor sweeps.
+    int nx;
+    int ny;
+    int nz;
+    // Sweep the rows color by color, see OptimizeProblem.
+    bool multicolor;
+    // The matrix is the SELL copy of OptimizeProblem.
+    bool sell;
+    // Interior rows are relaxed from the stencil, see OptimizeProblem.
+    bool matrixFree;
 };
 
 /*!
@@ -101,13 +112,13 @@ struct ComputeSYMGSArgs {
 */
 inline int
 ComputeSYMGSKernel(
-    Array<floatType>       &AmatrixValues,
-    Array<local_int_t>     &AmtxIndL,
-    const Array<char>      &AnonzerosInRow,
-    const Array<floatType> &AmatrixDiagonal,
-    const Array<floatType> &r,
-    Array<floatType>       &x,
-    const ComputeSYMGSArgs &args
+    Array<matrixFloatType>       &AmatrixValues,
+    Array<mtx_ind_t>             &AmtxIndL,
+    const Array<char>            &AnonzerosInRow,
+    const Array<matrixFloatType> &AmatrixDiagonal,
+    const Array<floatType>       &r,
+    Array<floatType>             &x,
+    const ComputeSYMGSArgs       &args
 ) {
     // Make sure x contain space for halo values.
     assert(x.length() == size_t(args.localNumberOfColumns));
@@ -115,7 +126,7 @@ ComputeSYMGSKernel(
     const local_int_t nrow = args.localNumberOfRows;
     const local_int_t nnpr = args.stencilSize;
     //
-    const floatType *const matrixDiagonal = AmatrixDiagonal.data();
+    const matrixFloatType *const matrixDiagonal = AmatrixDiagonal.data();
     assert(matrixDiagonal);
     //
     const floatType *const rv = r.data();
@@ -123,24 +134,25 @@ ComputeSYMGSKernel(
     floatType *const xv = x.data();
     assert(xv);
     // Interpreted as 2D array
-    Array2D<floatType> matrixValues(
+    Array2D<matrixFloatType> matrixValues(
         nrow, nnpr, AmatrixValues.data()
     );
     // Interpreted as 2D array
-    Array2D<local_int_t> mtxIndL(
+    Array2D<mtx_ind_t> mtxIndL(
         nrow, nnpr, AmtxIndL.data()
     );
     const char *const nonzerosInRow = AnonzerosInRow.data();
     //
     for (local_int_t i = 0; i < nrow; i++) {
-        const floatType *const currentValues = matrixValues(i);
-        const local_int_t *const currentColIndices = mtxIndL(i);
+        const matrixFloatType *const currentValues = matrixValues(i);
+        const mtx_ind_t *const currentColIndices = mtxIndL(i);
         const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
         const floatType currentDiagonal = matrixDiagonal[i];
         floatType sum = rv[i]; // RHS value
         //
         for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
-            const local_int_t curCol = currentColIndices[j];
+            const local_int_t curCol =
+                MtxIndColumn(i, currentColIndices[j], nrow);
             sum -= currentValues[j] * xv[curCol];
         }
         // Remove diagonal contribution from previous loop.
@@ -150,24 +162,372 @@ ComputeSYMGSKernel(
     }
     // Now the back sweep.
     for (local_int_t i = nrow - 1; i >= 0; i--) {
-        const floatType *const currentValues = matrixValues(i);
-        const local_int_t *const currentColIndices = mtxIndL(i);
+        const matrixFloatType *const currentValues = matrixValues(i);
+        const mtx_ind_t *const currentColIndices = mtxIndL(i);
+        const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
+        const floatType currentDiagonal = matrixDiagonal[i];
+        floatType sum = rv[i]; // RHS value
+        //
+        for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
+            const local_int_t curCol =
+                MtxIndColumn(i, currentColIndices[j], nrow);
+            sum -= currentValues[j] * xv[curCol];
+        }
+        // Remove diagonal contribution from previous loop.
+        sum += xv[i] * currentDiagonal;
+        xv[i] = sum / currentDiagonal;
+    }
+    //
+    return 0;
+}
+
+/**
+ * One symmetric Gauss-Seidel step of ComputeSYMGSKernel for the k columns of
+ * the block vectors r and x, interleaved, see BlockCG.hpp, in the natural
+ * row order. Each row of A is read once for all the columns, in both sweeps.
+ */
+inline int
+ComputeBlockSYMGSKernel(
+    Array<matrixFloatType>       &AmatrixValues,
+    Array<mtx_ind_t>             &AmtxIndL,
+    const Array<char>            &AnonzerosInRow,
+    const Array<matrixFloatType> &AmatrixDiagonal,
+    const Array<floatType>       &r,
+    Array<floatType>             &x,
+    int                          stencilSize,
+    int                          k
+) {
+    assert(k > 0 && k <= LGNCG_MAX_BLOCK);
+    //
+    const local_int_t nrow = AnonzerosInRow.length();
+    const matrixFloatType *const vals = AmatrixValues.data();
+    const mtx_ind_t *const inds = AmtxIndL.data();
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    const matrixFloatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    // Relaxes the k columns of row i.
+    auto relaxRow = [&](local_int_t i) {
+        const size_t off = size_t(i) * stencilSize;
+        const floatType currentDiagonal = matrixDiagonal[i];
+        floatType *const xi = xv + size_t(i) * k;
+        floatType sums[LGNCG_MAX_BLOCK];
+        for (int j = 0; j < k; j++) sums[j] = rv[size_t(i) * k + j];
+        //
+        for (int e = 0; e < nonzerosInRow[i]; e++) {
+            const matrixFloatType v = vals[off + e];
+            const floatType *const xe =
+                xv + size_t(MtxIndColumn(i, inds[off + e], nrow)) * k;
+            for (int j = 0; j < k; j++) sums[j] -= v * xe[j];
+        }
+        // Remove diagonal contribution from previous loop.
+        for (int j = 0; j < k; j++) {
+            xi[j] = (sums[j] + xi[j] * currentDiagonal) / currentDiagonal;
+        }
+    };
+    for (local_int_t i = 0; i < nrow; i++) relaxRow(i);
+    // Now the back sweep.
+    for (local_int_t i = nrow - 1; i >= 0; i--) relaxRow(i);
+    //
+    return 0;
+}
+
+/**
+ * Number of colors of the multicolor SYMGS. Row (ix, iy, iz) has color
+ * (ix % 2) + 2 * (iy % 2) + 4 * (iz % 2): the 27-point stencil only couples
+ * rows at most one apart in each direction, so rows of one color are never
+ * coupled and can be relaxed in any order, or all at once.
+ */
+#define LGNCG_SYMGS_COLORS 8
+
+/**
+ * Calls relaxRow(i) for all rows in multicolor order: a forward sweep over
+ * colors 0 to 7 and a back sweep over colors 7 to 0. The rows of a color are
+ * threaded with OpenMP if threaded is set.
+ */
+template <typename RELAX>
+inline void
+SYMGSMulticolorSweeps(
+    const ComputeSYMGSArgs &args,
+    bool threaded,
+    RELAX relaxRow
+) {
+    const int nx = args.nx, ny = args.ny, nz = args.nz;
+    assert(local_int_t(nx) * ny * nz == args.localNumberOfRows);
+    //
+    auto relaxColor = [&](int color) {
+        const int px = color & 1, py = (color >> 1) & 1, pz = color >> 2;
+        LGNCG_OMP_FOR(if(threaded) collapse(2))
+        for (int iz = pz; iz < nz; iz += 2) {
+            for (int iy = py; iy < ny; iy += 2) {
+                for (int ix = px; ix < nx; ix += 2) {
+                    relaxRow((local_int_t(iz) * ny + iy) * nx + ix);
+                }
+            }
+        }
+    };
+    //
+    for (int c = 0; c < LGNCG_SYMGS_COLORS; ++c) relaxColor(c);
+    // Now the back sweep.
+    for (int c = LGNCG_SYMGS_COLORS - 1; c >= 0; --c) relaxColor(c);
+}
+
+/**
+ * One symmetric Gauss-Seidel step with the rows in multicolor order, see
+ * SYMGSMulticolorSweeps.
+ */
+inline int
+ComputeSYMGSMulticolorKernel(
+    Array<matrixFloatType>       &AmatrixValues,
+    Array<mtx_ind_t>             &AmtxIndL,
+    const Array<char>            &AnonzerosInRow,
+    const Array<matrixFloatType> &AmatrixDiagonal,
+    const Array<floatType>       &r,
+    Array<floatType>             &x,
+    const ComputeSYMGSArgs       &args,
+    bool                         threaded = false
+) {
+    // Make sure x contain space for halo values.
+    assert(x.length() == size_t(args.localNumberOfColumns));
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nnpr = args.stencilSize;
+    //
+    const matrixFloatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    // Interpreted as 2D array
+    Array2D<matrixFloatType> matrixValues(
+        nrow, nnpr, AmatrixValues.data()
+    );
+    // Interpreted as 2D array
+    Array2D<mtx_ind_t> mtxIndL(
+        nrow, nnpr, AmtxIndL.data()
+    );
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    //
+    SYMGSMulticolorSweeps(args, threaded, [&](local_int_t i) {
+        const matrixFloatType *const currentValues = matrixValues(i);
+        const mtx_ind_t *const currentColIndices = mtxIndL(i);
         const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
         const floatType currentDiagonal = matrixDiagonal[i];
         floatType sum = rv[i]; // RHS value
         //
         for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
-            const local_int_t curCol = currentColIndices[j];
+            const local_int_t curCol =
+                MtxIndColumn(i, currentColIndices[j], nrow);
             sum -= currentValues[j] * xv[curCol];
         }
         // Remove diagonal contribution from previous loop.
         sum += xv[i] * currentDiagonal;
+        //
         xv[i] = sum / currentDiagonal;
+    });
+    //
+    return 0;
+}
+
+/**
+ * One symmetric Gauss-Seidel step with A in the SELL layout of
+ * LegionSELLData.hpp, in natural or, with args.multicolor, multicolor order.
+ * The padding entries of a row are zeros, so they drop out of its sum.
+ */
+inline int
+ComputeSYMGSSELLKernel(
+    Array<matrixFloatType>       &values,
+    Array<mtx_ind_t>             &colInds,
+    Array<local_int_t>           &AchunkStart,
+    const Array<matrixFloatType> &AmatrixDiagonal,
+    const Array<floatType>       &r,
+    Array<floatType>             &x,
+    const ComputeSYMGSArgs       &args,
+    bool                         threaded = false
+) {
+    // Make sure x contain space for halo values.
+    assert(x.length() == size_t(args.localNumberOfColumns));
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    //
+    const matrixFloatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    //
+    const matrixFloatType *const vals = values.data();
+    const mtx_ind_t *const cols = colInds.data();
+    const local_int_t *const chunkStart = AchunkStart.data();
+    //
+    auto relaxRow = [&](local_int_t i) {
+        const local_int_t k = i / LGNCG_SELL_C;
+        const local_int_t base = chunkStart[k] + i % LGNCG_SELL_C;
+        const int width = (chunkStart[k + 1] - chunkStart[k]) / LGNCG_SELL_C;
+        const floatType currentDiagonal = matrixDiagonal[i];
+        floatType sum = rv[i]; // RHS value
+        //
+        for (int j = 0; j < width; j++) {
+            const local_int_t e = base + j * LGNCG_SELL_C;
+            sum -= vals[e] * xv[MtxIndColumn(i, cols[e], nrow)];
+        }
+        // Remove diagonal contribution from previous loop.
+        sum += xv[i] * currentDiagonal;
+        //
+        xv[i] = sum / currentDiagonal;
+    };
+    //
+    if (args.multicolor) {
+        SYMGSMulticolorSweeps(args, threaded, relaxRow);
+        return 0;
     }
+    for (local_int_t i = 0; i < nrow; i++) relaxRow(i);
+    // Now the back sweep.
+    for (local_int_t i = nrow - 1; i >= 0; i--) relaxRow(i);
     //
     return 0;
 }
 
+/**
+ * One symmetric Gauss-Seidel step that relaxes the interior rows of the local
+ * grid from the 27-point stencil and the diagonal alone, see
+ * ComputeSPMVStencilKernel, and the other rows from the assembled matrix. The
+ * rows are swept in natural or, with args.multicolor, multicolor order.
+ */
+inline int
+ComputeSYMGSStencilKernel(
+    Array<matrixFloatType>       &AmatrixValues,
+    Array<mtx_ind_t>             &AmtxIndL,
+    const Array<char>            &AnonzerosInRow,
+    const Array<matrixFloatType> &AmatrixDiagonal,
+    const Array<floatType>       &r,
+    Array<floatType>             &x,
+    const ComputeSYMGSArgs       &args,
+    bool                         threaded = false
+) {
+    // Make sure x contain space for halo values.
+    assert(x.length() == size_t(args.localNumberOfColumns));
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nnpr = args.stencilSize;
+    const int nx = args.nx, ny = args.ny, nz = args.nz;
+    //
+    const matrixFloatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    // Interpreted as 2D array
+    Array2D<matrixFloatType> matrixValues(
+        nrow, nnpr, AmatrixValues.data()
+    );
+    // Interpreted as 2D array
+    Array2D<mtx_ind_t> mtxIndL(
+        nrow, nnpr, AmtxIndL.data()
+    );
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    //
+    auto relaxRow = [&](local_int_t i) {
+        const int ix = i % nx, iy = (i / nx) % ny, iz = i / (nx * ny);
+        const floatType currentDiagonal = matrixDiagonal[i];
+        if (StencilRowIsInterior(ix, iy, iz, nx, ny, nz)) {
+            xv[i] = (rv[i] + StencilNeighborSum(xv, i, nx, ny))
+                  / currentDiagonal;
+            return;
+        }
+        const matrixFloatType *const currentValues = matrixValues(i);
+        const mtx_ind_t *const currentColIndices = mtxIndL(i);
+        const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
+        floatType sum = rv[i]; // RHS value
+        //
+        for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
+            const local_int_t curCol =
+                MtxIndColumn(i, currentColIndices[j], nrow);
+            sum -= currentValues[j] * xv[curCol];
+        }
+        // Remove diagonal contribution from previous loop.
+        sum += xv[i] * currentDiagonal;
+        //
+        xv[i] = sum / currentDiagonal;
+    };
+    //
+    if (args.multicolor) {
+        SYMGSMulticolorSweeps(args, threaded, relaxRow);
+        return 0;
+    }
+    for (local_int_t i = 0; i < nrow; i++) relaxRow(i);
+    // Now the back sweep.
+    for (local_int_t i = nrow - 1; i >= 0; i--) relaxRow(i);
+    //
+    return 0;
+}
+
+/**
+ * Runs the kernel of args on the mapped regions of A, r and x, in the calling
+ * task: the path without LGNCG_TASKING, and the one of the levels of
+ * ComputeMGInline.
+ */
+inline int
+ComputeSYMGSInline(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    const ComputeSYMGSArgs &args
+) {
+    if (args.matrixFree) {
+        return ComputeSYMGSStencilKernel(
+                   *A.matrixValues,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.matrixDiagonal,
+                   r,
+                   x,
+                   args
+               );
+    }
+    if (args.sell) {
+        return ComputeSYMGSSELLKernel(
+                   *A.sell->values,
+                   *A.sell->colInds,
+                   *A.sell->chunkStart,
+                   *A.matrixDiagonal,
+                   r,
+                   x,
+                   args
+               );
+    }
+    if (args.multicolor) {
+        return ComputeSYMGSMulticolorKernel(
+                   *A.matrixValues,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.matrixDiagonal,
+                   r,
+                   x,
+                   args
+               );
+    }
+    return ComputeSYMGSKernel(
+               *A.matrixValues,
+               *A.mtxIndL,
+               *A.nonzerosInRow,
+               *A.matrixDiagonal,
+               r,
+               x,
+               args
+           );
+}
+
 /**
  *
  */
@@ -181,22 +541,38 @@ ComputeSYMGS(
 ) {
     ExchangeHalo(A, x, ctx, lrt);
     //
+    const Geometry *const Ageom = A.geom->data();
     const ComputeSYMGSArgs args = {
         .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
         .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
-        .stencilSize          = A.geom->data()->stencilSize
+        .stencilSize          = Ageom->stencilSize,
+        .nx                   = Ageom->nx,
+        .ny                   = Ageom->ny,
+        .nz                   = Ageom->nz,
+        .multicolor           = A.multicolorSYMGS,
+        .sell                 = (A.sell != nullptr && !A.matrixFree),
+        .matrixFree           = A.matrixFree
     };
     //
 #ifdef LGNCG_TASKING
-    //
+    if (A.inlineMG) return ComputeSYMGSInline(A, r, x, args);
+    // Multicolor sweeps have a task of their own, which can run on a GPU.
     TaskLauncher tl(
-        SYMGS_TID,
+        (args.multicolor && !args.matrixFree) ? SYMGS_MULTICOLOR_TID
+                                              : SYMGS_TID,
         TaskArgument(&args, sizeof(args))
     );
     //
-    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
-    A.mtxIndL->intent       (RO_E, tl, ctx, lrt);
-    A.nonzerosInRow->intent (RO_E, tl, ctx, lrt);
+    if (args.sell) {
+        A.sell->values->intent    (RO_E, tl, ctx, lrt);
+        A.sell->colInds->intent   (RO_E, tl, ctx, lrt);
+        A.sell->chunkStart->intent(RO_E, tl, ctx, lrt);
+    }
+    else {
+        A.matrixValues->intent  (RO_E, tl, ctx, lrt);
+        A.mtxIndL->intent       (RO_E, tl, ctx, lrt);
+        A.nonzerosInRow->intent (RO_E, tl, ctx, lrt);
+    }
     A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
     //
     r.intent(RO_E, tl, ctx, lrt);
@@ -206,16 +582,36 @@ ComputeSYMGS(
     //
     return 0;
 #else
-    return ComputeSYMGSKernel(
+    return ComputeSYMGSInline(A, r, x, args);
+#endif
+}
+
+/**
+ * ComputeSYMGS for block vectors of k columns in the shard task, on the CSR
+ * rows of A in the natural order, after one ExchangeBlockHalo for all of
+ * them.
+ */
+inline int
+ComputeBlockSYMGS(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    int k,
+    Context ctx,
+    Runtime *lrt
+) {
+    ExchangeBlockHalo(A, x, k, ctx, lrt);
+    //
+    return ComputeBlockSYMGSKernel(
                *A.matrixValues,
                *A.mtxIndL,
                *A.nonzerosInRow,
                *A.matrixDiagonal,
                r,
                x,
-               args
+               A.geom->data()->stencilSize,
+               k
            );
-#endif
 }
 
 /**
@@ -230,15 +626,105 @@ ComputeSYMGSTask(
 ) {
     const auto *const args = (ComputeSYMGSArgs *)task->args;
     //
+    if (args->sell) {
+        int rid = 0;
+        Array<matrixFloatType> values        (regions[rid++], ctx, lrt);
+        Array<mtx_ind_t> colInds             (regions[rid++], ctx, lrt);
+        Array<local_int_t> chunkStart        (regions[rid++], ctx, lrt);
+        Array<matrixFloatType> matrixDiagonal(regions[rid++], ctx, lrt);
+        //
+        Array<floatType> r(regions[rid++], ctx, lrt);
+        Array<floatType> x(regions[rid++], ctx, lrt);
+        //
+#ifdef LGNCG_CUDA
+        if (runsOnGPU(task)) {
+            assert(args->multicolor);
+            const CUDAMatrix A = {
+                .values        = values.data(),
+                .colInds       = colInds.data(),
+                .nrow          = args->localNumberOfRows,
+                .nonzerosInRow = NULL,
+                .stencilSize   = args->stencilSize,
+                .chunkStart    = chunkStart.data(),
+                .chunkSize     = LGNCG_SELL_C,
+                .nx            = args->nx,
+                .ny            = args->ny,
+                .nz            = args->nz
+            };
+            lgncgCUDASYMGSMulticolor(
+                A, matrixDiagonal.data(), r.data(), x.data()
+            );
+            return;
+        }
+#endif
+        ComputeSYMGSSELLKernel(
+            values,
+            colInds,
+            chunkStart,
+            matrixDiagonal,
+            r,
+            x,
+            *args,
+            runsThreaded(task)
+        );
+        return;
+    }
+    //
     int rid = 0;
-    Array<floatType> matrixValues  (regions[rid++], ctx, lrt);
-    Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
-    Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
-    Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
+    Array<matrixFloatType> matrixValues  (regions[rid++], ctx, lrt);
+    Array<mtx_ind_t> mtxIndL             (regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow            (regions[rid++], ctx, lrt);
+    Array<matrixFloatType> matrixDiagonal(regions[rid++], ctx, lrt);
     //
     Array<floatType> r(regions[rid++], ctx, lrt);
     Array<floatType> x(regions[rid++], ctx, lrt);
     //
+    if (args->matrixFree) {
+        ComputeSYMGSStencilKernel(
+            matrixValues,
+            mtxIndL,
+            nonzerosInRow,
+            matrixDiagonal,
+            r,
+            x,
+            *args,
+            runsThreaded(task)
+        );
+        return;
+    }
+    if (args->multicolor) {
+#ifdef LGNCG_CUDA
+        if (runsOnGPU(task)) {
+            const CUDAMatrix A = {
+                .values        = matrixValues.data(),
+                .colInds       = mtxIndL.data(),
+                .nrow          = args->localNumberOfRows,
+                .nonzerosInRow = nonzerosInRow.data(),
+                .stencilSize   = args->stencilSize,
+                .chunkStart    = NULL,
+                .chunkSize     = 0,
+                .nx            = args->nx,
+                .ny            = args->ny,
+                .nz            = args->nz
+            };
+            lgncgCUDASYMGSMulticolor(
+                A, matrixDiagonal.data(), r.data(), x.data()
+            );
+            return;
+        }
+#endif
+        ComputeSYMGSMulticolorKernel(
+            matrixValues,
+            mtxIndL,
+            nonzerosInRow,
+            matrixDiagonal,
+            r,
+            x,
+            *args,
+            runsThreaded(task)
+        );
+        return;
+    }
     ComputeSYMGSKernel(
         matrixValues,
         mtxIndL,
@@ -266,5 +752,49 @@ registerSYMGSTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeSYMGSTask"
     );
+    // Only the multicolor sweeps are threaded, in either matrix layout.
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeSYMGSTask>(
+        SYMGS_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSTask"
+    );
+#endif
+    // The multicolor sweeps also run on GPUs, see ComputeSYMGS.
+    HighLevelRuntime::register_legion_task<ComputeSYMGSTask>(
+        SYMGS_MULTICOLOR_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMulticolorTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeSYMGSTask>(
+        SYMGS_MULTICOLOR_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMulticolorTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeSYMGSTask>(
+        SYMGS_MULTICOLOR_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMulticolorTask"
+    );
+#endif
 #endif
 }
@@ -49,6 +49,11 @@
 #pragma once
 
 #include "LegionArrays.hpp"
+#include "CollectiveOps.hpp"
+#include "FutureMath.hpp"
+#include "StreamingStores.hpp"
+
+#include "mytimer.hpp"
 
 #include <cassert>
 
@@ -62,6 +67,9 @@ struct ComputeWAXPBYArgs {
     bool xySame;
     bool xwSame;
     bool ywSame;
+    // beta is scaled by the FutureRatio of this many of the task's futures,
+    // 0 for none.
+    int betaFutures;
 };
 
 /*!
@@ -75,6 +83,12 @@ struct ComputeWAXPBYArgs {
     @param[in] alpha, beta the scalars applied to x and y respectively.
     @param[in] x, y the input vectors
     @param[out] w the output vector.
+    @param[in] threaded whether to thread the loop with OpenMP.
+    @param[out] ww if not NULL, on exit w'w, summed as w is computed, see
+    ComputeWAXPBYDotProduct.
+
+    w is stored with streaming stores if it is neither x nor y and
+    useStreamingStores says so.
 
     @return returns 0 upon success and non-zero otherwise
 
@@ -87,7 +101,9 @@ ComputeWAXPBYKernel(
     const Array<floatType> &x,
     const floatType beta,
     const Array<floatType> &y,
-    Array<floatType> &w
+    Array<floatType> &w,
+    bool threaded = false,
+    floatType *ww = nullptr
 ) {
     // Test vector lengths
     assert(x.length() >= size_t(n));
@@ -97,13 +113,43 @@ ComputeWAXPBYKernel(
     const floatType *const yv = y.data();
     floatType *const wv = w.data();
 
-    if (alpha == 1.0) {
+#ifdef LGNCG_STREAMING_STORES
+    const size_t vectors = (xv == yv) ? 2 : 3;
+    if (wv != xv && wv != yv &&
+        useStreamingStores(vectors * n * sizeof(floatType))) {
+        const __m128d va = _mm_set1_pd(alpha);
+        const __m128d vb = _mm_set1_pd(beta);
+        streamVector(
+            wv, n, threaded,
+            [=](local_int_t i) {
+                return _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(xv + i)),
+                                  _mm_mul_pd(vb, _mm_loadu_pd(yv + i)));
+            },
+            [=](local_int_t i) { return alpha * xv[i] + beta * yv[i]; },
+            ww
+        );
+        return 0;
+    }
+#endif
+    if (ww) {
+        floatType local_ww = 0.0;
+        LGNCG_OMP_FOR(if(threaded) reduction(+:local_ww))
+        for (local_int_t i = 0; i < n; i++) {
+            wv[i] = alpha * xv[i] + beta * yv[i];
+            local_ww += wv[i] * wv[i];
+        }
+        *ww = local_ww;
+    }
+    else if (alpha == 1.0) {
+        LGNCG_OMP_FOR(if(threaded))
         for (local_int_t i = 0; i < n; i++) wv[i] = xv[i] + beta * yv[i];
     }
     else if (beta == 1.0) {
+        LGNCG_OMP_FOR(if(threaded))
         for (local_int_t i = 0; i < n; i++) wv[i] = alpha * xv[i] + yv[i];
     }
     else  {
+        LGNCG_OMP_FOR(if(threaded))
         for (local_int_t i = 0; i < n; i++) wv[i] = alpha * xv[i] + beta * yv[i];
     }
     //
@@ -111,16 +157,54 @@ ComputeWAXPBYKernel(
 }
 
 /**
- *
+ * W = X * diag(alpha) + Y * diag(beta) for the block vectors of k columns,
+ * interleaved, over n rows, see BlockCG.hpp: column j of W is
+ * alpha[j] * x + beta[j] * y.
  */
 inline int
-ComputeWAXPBY(
+ComputeBlockWAXPBYKernel(
+    const local_int_t n,
+    const int k,
+    const floatType *const alpha,
+    const Array<floatType> &x,
+    const floatType *const beta,
+    const Array<floatType> &y,
+    Array<floatType> &w
+) {
+    assert(x.length() >= size_t(n) * k);
+    assert(y.length() >= size_t(n) * k);
+    //
+    const floatType *const xv = x.data();
+    const floatType *const yv = y.data();
+    floatType *const wv = w.data();
+    //
+    for (local_int_t i = 0; i < n; i++) {
+        const size_t off = size_t(i) * k;
+        for (int j = 0; j < k; j++) {
+            wv[off + j] = alpha[j] * xv[off + j] + beta[j] * yv[off + j];
+        }
+    }
+    //
+    return 0;
+}
+
+/**
+ * w = alpha * x + beta * y, with beta times the value of betaRatio if it is
+ * not NULL. Its futures are handed to the task, which computes it, so a
+ * coefficient computed from earlier results does not block the caller. If
+ * wwFuture is not NULL it is set to the local w'w, a floatType, computed in
+ * the same pass.
+ */
+inline int
+ComputeWAXPBYLaunch(
     const local_int_t n,
     const floatType alpha,
     Array<floatType> &x,
     const floatType beta,
+    const FutureRatio *betaRatio,
     Array<floatType> &y,
     Array<floatType> &w,
+    Future *wwFuture,
     Context ctx,
     Runtime *lrt
 ) {
@@ -135,14 +219,17 @@ ComputeWAXPBY(
         .beta   = beta,
         .xySame = xySame,
         .xwSame = xwSame,
-        .ywSame = ywSame
+        .ywSame = ywSame,
+        .betaFutures = betaRatio ? betaRatio->nFutures() : 0
     };
     //
     TaskLauncher tl(
-        WAXPBY_TID,
+        wwFuture ? WAXPBY_DDOT_TID : WAXPBY_TID,
         TaskArgument(&args, sizeof(args))
     );
     //
+    if (betaRatio) betaRatio->addTo(tl);
+    //
     x.intent(
         xwSame ? RW : RO,
         EXCLUSIVE,
@@ -160,20 +247,100 @@ ComputeWAXPBY(
         w.intent(WO_E, tl, ctx, lrt);
     }
     //
-    lrt->execute_task(ctx, tl);
+    Future f = lrt->execute_task(ctx, tl);
+    if (wwFuture) *wwFuture = f;
     return 0;
 #else
-    return ComputeWAXPBYKernel(n, alpha, x, beta, y, w);
+    floatType betav = beta;
+    if (betaRatio) betav *= betaRatio->value();
+    floatType ww = 0.0;
+    const int rc = ComputeWAXPBYKernel(
+                       n, alpha, x, betav, y, w, false, wwFuture ? &ww : NULL
+                   );
+    if (wwFuture) *wwFuture = Future::from_value(lrt, ww);
+    return rc;
 #endif
 }
 
 /**
  *
  */
-void
-ComputeWAXPBYTask(
+inline int
+ComputeWAXPBY(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeWAXPBYLaunch(n, alpha, x, beta, NULL, y, w, NULL, ctx, lrt);
+}
+
+/**
+ * w = alpha * x + (beta * betaRatio) * y, see ComputeWAXPBYLaunch.
+ */
+inline int
+ComputeWAXPBY(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    const FutureRatio &betaRatio,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeWAXPBYLaunch(
+               n, alpha, x, beta, &betaRatio, y, w, NULL, ctx, lrt
+           );
+}
+
+/**
+ * w = alpha * x + (beta * betaRatio) * y, with betaRatio skipped if it is
+ * NULL, and resultFuture = w'w, reduced across shards, in one task: w is not
+ * read back from memory for the dot product, see ComputeDotProduct.
+ */
+inline int
+ComputeWAXPBYDotProduct(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    const FutureRatio *betaRatio,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    Future localFuture;
+    const int rc = ComputeWAXPBYLaunch(
+                       n, alpha, x, beta, betaRatio, y, w, &localFuture,
+                       ctx, lrt
+                   );
+    //
+    resultFuture = timedAllReduce(
+                       localFuture, dcReduceSum, timeAllreduce, ctx, lrt
+                   );
+    //
+    return rc;
+}
+
+/**
+ * Unpacks the regions of WAXPBY_TID and WAXPBY_DDOT_TID and runs the kernel,
+ * which stores w'w in ww if it is not NULL.
+ */
+inline void
+ComputeWAXPBYFromRegions(
     const Task *task,
     const std::vector<PhysicalRegion> &regions,
+    floatType *ww,
     Context ctx,
     Runtime *lrt
 ) {
@@ -192,7 +359,186 @@ ComputeWAXPBYTask(
     Array<floatType> y(regions[yRID], ctx, lrt);
     Array<floatType> w(regions[wRID], ctx, lrt);
     //
-    ComputeWAXPBYKernel(args->n, args->alpha, x, args->beta, y, w);
+    floatType beta = args->beta;
+    if (args->betaFutures) {
+        beta *= FutureRatioValue(task, 0, args->betaFutures);
+    }
+    //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        const floatType localWW = lgncgCUDAWAXPBY(
+            args->n, args->alpha, x.data(), beta, y.data(), w.data(),
+            ww != NULL
+        );
+        if (ww) *ww = localWW;
+        return;
+    }
+#endif
+    ComputeWAXPBYKernel(
+        args->n, args->alpha, x, beta, y, w, runsThreaded(task), ww
+    );
+}
+
+/**
+ *
+ */
+void
+ComputeWAXPBYTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeWAXPBYFromRegions(task, regions, NULL, ctx, lrt);
+}
+
+/**
+ * Returns the local w'w.
+ */
+floatType
+ComputeWAXPBYDotProductTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    floatType localResult = 0.0;
+    ComputeWAXPBYFromRegions(task, regions, &localResult, ctx, lrt);
+    //
+    return localResult;
+}
+
+/**
+ *
+ */
+struct ComputeCGUpdateArgs {
+    local_int_t n;
+    // alpha is the FutureRatio of this many of the task's futures.
+    int alphaFutures;
+};
+
+/**
+ * The two updates of a CG iteration in one pass: x = x + alpha * p and
+ * r = r - alpha * Ap, and rr = r'r, summed as r is computed. p and Ap are
+ * read once instead of once per WAXPBY.
+ */
+inline int
+ComputeCGUpdateKernel(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const Array<floatType> &p,
+    Array<floatType> &r,
+    const Array<floatType> &Ap,
+    floatType &rr,
+    bool threaded = false
+) {
+    assert(x.length() >= size_t(n));
+    assert(p.length() >= size_t(n));
+    assert(r.length() >= size_t(n));
+    assert(Ap.length() >= size_t(n));
+    //
+    floatType *const xv = x.data();
+    const floatType *const pv = p.data();
+    floatType *const rv = r.data();
+    const floatType *const Apv = Ap.data();
+    //
+    floatType local_rr = 0.0;
+    LGNCG_OMP_FOR(if(threaded) reduction(+:local_rr))
+    for (local_int_t i = 0; i < n; i++) {
+        xv[i] += alpha * pv[i];
+        const floatType ri = rv[i] - alpha * Apv[i];
+        rv[i] = ri;
+        local_rr += ri * ri;
+    }
+    rr = local_rr;
+    //
+    return 0;
+}
+
+/**
+ * x = x + alpha * p, r = r - alpha * Ap and resultFuture = r'r, reduced across
+ * shards, in one task, see ComputeCGUpdateKernel. alpha is computed by the
+ * task, see FutureRatio.
+ */
+inline int
+ComputeCGUpdate(
+    const local_int_t n,
+    const FutureRatio &alpha,
+    Array<floatType> &p,
+    Array<floatType> &Ap,
+    Array<floatType> &x,
+    Array<floatType> &r,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    Future localFuture;
+    int rc = 0;
+#ifdef LGNCG_TASKING
+    ComputeCGUpdateArgs args {
+        .n = n,
+        .alphaFutures = alpha.nFutures()
+    };
+    //
+    TaskLauncher tl(CG_UPDATE_TID, TaskArgument(&args, sizeof(args)));
+    alpha.addTo(tl);
+    //
+    x.intent( RW_E, tl, ctx, lrt);
+    p.intent( RO_E, tl, ctx, lrt);
+    r.intent( RW_E, tl, ctx, lrt);
+    Ap.intent(RO_E, tl, ctx, lrt);
+    //
+    localFuture = lrt->execute_task(ctx, tl);
+#else
+    floatType rr = 0.0;
+    rc = ComputeCGUpdateKernel(n, alpha.value(), x, p, r, Ap, rr);
+    localFuture = Future::from_value(lrt, rr);
+#endif
+    resultFuture = timedAllReduce(
+                       localFuture, dcReduceSum, timeAllreduce, ctx, lrt
+                   );
+    //
+    return rc;
+}
+
+/**
+ * Returns the local r'r.
+ */
+floatType
+ComputeCGUpdateTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeCGUpdateArgs *)task->args;
+    //
+    Array<floatType> x (regions[0], ctx, lrt);
+    Array<floatType> p (regions[1], ctx, lrt);
+    Array<floatType> r (regions[2], ctx, lrt);
+    Array<floatType> Ap(regions[3], ctx, lrt);
+    //
+    const floatType alpha = FutureRatioValue(task, 0, args->alphaFutures);
+    //
+#ifdef LGNCG_CUDA
+    if (runsOnGPU(task)) {
+        lgncgCUDAWAXPBY(
+            args->n, 1.0, x.data(), alpha, p.data(), x.data(), false
+        );
+        return lgncgCUDAWAXPBY(
+                   args->n, 1.0, r.data(), -alpha, Ap.data(), r.data(), true
+               );
+    }
+#endif
+    floatType rr = 0.0;
+    ComputeCGUpdateKernel(
+        args->n, alpha, x, p, r, Ap, rr, runsThreaded(task)
+    );
+    //
+    return rr;
 }
 
 /**
@@ -206,10 +552,94 @@ registerWAXPBYTasks(void)
         WAXPBY_TID /* task id */,
         Processor::LOC_PROC /* proc kind  */,
         true /* single */,
-        false /* index */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<ComputeWAXPBYTask>(
+        WAXPBY_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
         AUTO_GENERATE_ID,
         TaskConfigOptions(true /* leaf task */),
         "ComputeWAXPBYTask"
     );
 #endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<ComputeWAXPBYTask>(
+        WAXPBY_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYTask"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<floatType, ComputeWAXPBYDotProductTask>(
+        WAXPBY_DDOT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYDotProductTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<floatType, ComputeWAXPBYDotProductTask>(
+        WAXPBY_DDOT_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYDotProductTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<floatType, ComputeWAXPBYDotProductTask>(
+        WAXPBY_DDOT_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYDotProductTask"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<floatType, ComputeCGUpdateTask>(
+        CG_UPDATE_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeCGUpdateTask"
+    );
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<floatType, ComputeCGUpdateTask>(
+        CG_UPDATE_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeCGUpdateTask"
+    );
+#endif
+#ifdef LGNCG_CUDA
+    HighLevelRuntime::register_legion_task<floatType, ComputeCGUpdateTask>(
+        CG_UPDATE_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeCGUpdateTask"
+    );
+#endif
+#endif
 }
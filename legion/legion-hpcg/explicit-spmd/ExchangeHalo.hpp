@@ -46,9 +46,115 @@
 #include "LegionArrays.hpp"
 #include "VectorOps.hpp"
 #include "LegionMatrices.hpp"
-#include "RegionToRegionCopy.hpp"
 
 #include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+/**
+ * Whether the pulls of the halo exchanges from the neighbors in this process
+ * read their pull buffers directly (--directhalo), see ExchangeHaloBuffers.
+ * Shared by the shards of a process, which all have the same parameters.
+ */
+inline bool &
+directHaloEnabled(void)
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+/**
+ * The pull buffers of the shards of this process, by the global rows of their
+ * level, the values per entry, the shard filling them and the neighbor they
+ * are for. A shard publishes its own at its first exchange of each, before it
+ * arrives at its ready barrier, and the pointers stay valid for the run since
+ * they are into the instances mapped by the shard task.
+ */
+class DirectHaloPullBuffers {
+    using Key = std::tuple<global_int_t, int, int, int>;
+    //
+    std::mutex mLock;
+    //
+    std::map<Key, const floatType *> mBuffers;
+
+public:
+    /**
+     *
+     */
+    static DirectHaloPullBuffers &
+    get(void)
+    {
+        static DirectHaloPullBuffers buffers;
+        return buffers;
+    }
+
+    /**
+     *
+     */
+    void
+    publish(
+        global_int_t levelRows,
+        int width,
+        int owner,
+        int receiver,
+        const floatType *buffer
+    ) {
+        std::lock_guard<std::mutex> guard(mLock);
+        mBuffers[Key(levelRows, width, owner, receiver)] = buffer;
+    }
+
+    /**
+     * The buffer of owner for receiver, null if owner is in another process.
+     */
+    const floatType *
+    find(
+        global_int_t levelRows,
+        int width,
+        int owner,
+        int receiver
+    ) {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto it = mBuffers.find(Key(levelRows, width, owner, receiver));
+        return it == mBuffers.end() ? nullptr : it->second;
+    }
+};
+
+/**
+ * Issues the pulls of an exchange, the copy requirements of which are already
+ * in cl, as one copy operation. It waits for all the neighbors to have filled
+ * their pull buffers and arrives at their done barriers once it completes, so
+ * no task is launched per neighbor. The neighbors with a non-null entry in
+ * direct, if any, are pulled by the caller instead.
+ */
+inline void
+issueHaloCopy(
+    CopyLauncher &cl,
+    Synchronizers *syncs,
+    int nNeighbors,
+    Context ctx,
+    Runtime *lrt,
+    const floatType *const *direct = nullptr
+) {
+    bool any = false;
+    for (int n = 0; n < nNeighbors; ++n) {
+        if (direct && direct[n]) continue;
+        any = true;
+        //
+        syncs->neighbors[n].ready = lrt->advance_phase_barrier(
+            ctx, syncs->neighbors[n].ready
+        );
+        cl.add_wait_barrier(syncs->neighbors[n].ready);
+        //
+        cl.add_arrival_barrier(syncs->neighbors[n].done);
+        syncs->neighbors[n].done = lrt->advance_phase_barrier(
+            ctx, syncs->neighbors[n].done
+        );
+    }
+    //
+    if (any) lrt->issue_copy_operation(ctx, cl);
+}
 
 #if 0
 #define LGNCG_DO_TASKY_EXCHANGE
@@ -87,9 +193,13 @@ ExchangeHalo(
     const SparseMatrixScalars *const Asclrs = A.sclrs->data();
     const int nTxNeighbors = Asclrs->numberOfSendNeighbors;
     const int nRxNeighbors = Asclrs->numberOfRecvNeighbors;
-    const int *const neighbors = A.neighbors->data();
     // Nothing to do.
     if (nTxNeighbors == 0) return;
+    // The ghosts are the zeros of markGhostsZero everywhere.
+    if (x.halo.ghostsZero) {
+        x.halo.ghostsZero = false;
+        return;
+    }
     // Make sure that x's ghosts are already setup.
     if (!x.hasGhosts()) {
         assert(false && "x does not have ghost regions setup.");
@@ -102,17 +212,7 @@ ExchangeHalo(
         EXCHANGE_HALO_TID,
         TaskArgument(&args, sizeof(args))
     );
-    LogicalRegion xPrivateLR;
-    {
-        auto xis = x.logicalRegion.get_index_space();
-        auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
-        auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
-        xPrivateLR = lrt->get_logical_subregion_by_color(
-            ctx,
-            xlp,
-            DomainPoint::from_point<1>(0) // First is private.
-        );
-    }
+    LogicalRegion xPrivateLR = getPrivateLogicalRegion(x);
     // x (private partition).
     RegionRequirement xrr(
         xPrivateLR, RO_E, xPrivateLR
@@ -127,29 +227,9 @@ ExchangeHalo(
     for (int n = 0; n < nTxNeighbors; ++n) {
         A.pullBuffers[n]->intent(RW_E, tl, ctx, lrt);
     }
-    // Pull regions in neighbor order.
-    for (int n = 0; n < nRxNeighbors; ++n) {
-        const int nid = neighbors[n];
-        auto srcIt = A.nidToPullRegion.find(nid);
-        assert(srcIt != A.nidToPullRegion.end());
-        auto srclr = srcIt->second.get_logical_region();
-        //
-        RegionRequirement srcrr(
-            srclr, RO_E, srclr
-        );
-        static const int fid = 0;
-        tl.add_region_requirement(srcrr).add_field(fid);
-    }
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        LogicalArray<floatType> *dstArray = x.ghosts[n];
-        assert(dstArray->hasParentLogicalRegion());
-        RegionRequirement dstrr(
-            dstArray->logicalRegion,
-            WO_E,
-            dstArray->getParentLogicalRegion()
-        );
-        tl.add_region_requirement(dstrr).add_field(dstArray->fid);
-    }
+    // Pull regions in neighbor order, then the ghosts, see SetupGhostArrays.
+    for (auto &srcrr : x.halo.srcReqs) tl.add_region_requirement(srcrr);
+    for (auto &dstrr : x.halo.dstReqs) tl.add_region_requirement(dstrr);
     //
     lrt->execute_task(ctx, tl);
 }
@@ -190,26 +270,14 @@ ExchangeHaloTask(
     assert(syncs);
     PhaseBarriers &myPBs = syncs->mine;
     //
-    std::vector<Array<floatType> *> ApullBuffers;
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        auto *item = new Array<floatType>(regions[rid++], ctx, lrt);
-        assert(item->data());
-        ApullBuffers.push_back(item);
-    }
-    std::vector<LogicalRegion> srclrs;
-    for (int n = 0; n < nRxNeighbors; ++n) {
-        srclrs.push_back(regions[rid++].get_logical_region());
-    }
-    std::vector<LogicalRegion> dstlrs;
-    for (int n = 0; n < nRxNeighbors; ++n) {
-        dstlrs.push_back(regions[rid++].get_logical_region());
-    }
-    //
     myPBs.done.wait();
     myPBs.done = lrt->advance_phase_barrier(ctx, myPBs.done);
-    // Fill up pull buffers (the buffers that neighboring task will pull from).
+    // Fill up pull buffers (the buffers that neighboring task will pull from),
+    // each wrapped only while it is filled.
     for (int n = 0, txidx = 0; n < nTxNeighbors; ++n) {
-        floatType *const pbd = ApullBuffers[n]->data();
+        Array<floatType> ApullBuffer(regions[rid++], ctx, lrt);
+        floatType *const pbd = ApullBuffer.data();
+        assert(pbd);
         //
         for (int i = 0; i < sendLengthsd[n]; ++i) {
             pbd[i] = xv[elementsToSend[txidx++]];
@@ -218,43 +286,21 @@ ExchangeHaloTask(
     myPBs.ready.arrive(1);
     myPBs.ready = lrt->advance_phase_barrier(ctx, myPBs.ready);
     //
-    for (int n = 0; n < nTxNeighbors; ++n) {
+    const int srcrid = rid, dstrid = rid + nRxNeighbors;
+    CopyLauncher cl;
+    for (int n = 0; n < nRxNeighbors; ++n) {
         static const int fid = 0;
-        // Source region requirement.
-        RegionRequirement srcrr(
-            srclrs[n], RO_E, srclrs[n]
-        );
-        srcrr.add_field(fid);
-        // Destination region requirement.
+        auto srclr = regions[srcrid + n].get_logical_region();
+        auto dstlr = regions[dstrid + n].get_logical_region();
         //
-        RegionRequirement dstrr(
-            dstlrs[n], WO_E, dstlrs[n]
-        );
+        RegionRequirement srcrr(srclr, RO_E, srclr);
+        srcrr.add_field(fid);
+        RegionRequirement dstrr(dstlr, WO_E, dstlr);
         dstrr.add_field(fid);
         //
-        TaskLauncher tl(
-            REGION_TO_REGION_COPY_TID,
-            TaskArgument(NULL, 0)
-        );
-        tl.add_region_requirement(srcrr);
-        tl.add_region_requirement(dstrr);
-        //
-        syncs->neighbors[n].ready = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].ready
-        );
-        tl.add_wait_barrier(syncs->neighbors[n].ready);
-        //
-        tl.add_arrival_barrier(syncs->neighbors[n].done);
-        syncs->neighbors[n].done = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].done
-        );
-        //
-        lrt->execute_task(ctx, tl);
-    }
-    // Cleanup
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        delete ApullBuffers[n];
+        cl.add_copy_requirements(srcrr, dstrr);
     }
+    issueHaloCopy(cl, syncs, nRxNeighbors, ctx, lrt);
 }
 #endif
 
@@ -277,11 +323,39 @@ registerExchangeHaloTasks(void)
 #endif
 }
 
-#ifndef LGNCG_DO_TASKY_EXCHANGE
+/**
+ * Seconds spent in the halo exchanges of A and its coarser levels so far,
+ * with --timekernels, see SparseMatrix::haloTime.
+ */
+inline double
+totalHaloTime(
+    const SparseMatrix &A
+) {
+    double t = 0.0;
+    for (const SparseMatrix *l = &A; l; l = l->Ac) t += l->haloTime;
+    return t;
+}
+
+/**
+ * The exchange of ExchangeHalo and ExchangeBlockHalo: fills pullBuffers with
+ * the width values per entry sent of x, interleaved, then pulls the ghosts of
+ * x, partitioned with the same width, from those of the neighbors.
+ *
+ * With --directhalo, the ghosts from the neighbors in this process are read
+ * from their pull buffers by the shard itself once their ready barrier
+ * triggers, without a copy or an instance of those buffers. Only where the
+ * kernels reading the ghosts run in the shard task, the levels with inlineMG
+ * and the block exchanges, since the launched ones are only ordered after the
+ * ghosts by the copy. The neighbors are looked up from the second exchange
+ * on: by then every neighbor has published its pull buffers, as it did so
+ * before its first pull, which our done barrier waited for.
+ */
 inline void
-ExchangeHalo(
+ExchangeHaloBuffers(
     SparseMatrix &A,
     Array<floatType> &x,
+    std::vector< Array<floatType> *> &pullBuffers,
+    int width,
     Context ctx,
     Runtime *lrt
 ) {
@@ -289,10 +363,7 @@ ExchangeHalo(
     // Extract Matrix pieces
     const SparseMatrixScalars *const Asclrs = A.sclrs->data();
     const int nNeighbors = Asclrs->numberOfSendNeighbors;
-    // Nothing to do.
-    if (nNeighbors == 0) return;
     // Else we have neighbors and data to move around.
-    const int *const neighbors = A.neighbors->data();
     // Non-region memory populated during SetupHalo().
     const local_int_t *const elementsToSend = A.elementsToSend->data();
     assert(elementsToSend);
@@ -307,66 +378,155 @@ ExchangeHalo(
     Synchronizers *syncs = A.synchronizers->data();
     PhaseBarriers &myPBs = syncs->mine;
     //
+    const int set = (&pullBuffers == &A.blockPullBuffers) ? 1 : 0;
+    const int exchange = A.haloExchanges[set]++;
+    const bool direct = directHaloEnabled() && (set == 1 || A.inlineMG);
+    const int rank = A.geom->data()->rank;
+    const int *const nids = A.neighbors->data();
+    assert(nids);
+    //
     myPBs.done.wait();
     myPBs.done = lrt->advance_phase_barrier(ctx, myPBs.done);
+    //
+    vector<const floatType *> &directPulls = A.directPulls[set];
+    if (direct && exchange == 1) {
+        directPulls.resize(nNeighbors);
+        for (int n = 0; n < nNeighbors; ++n) {
+            directPulls[n] = DirectHaloPullBuffers::get().find(
+                Asclrs->totalNumberOfRows, width, nids[n], rank
+            );
+        }
+    }
     // Fill up pull buffers (the buffers that neighboring task will pull from).
     const local_int_t *const sendLengthsd = A.sendLength->data();
     assert(sendLengthsd);
     //
     for (int n = 0, txidx = 0; n < nNeighbors; ++n) {
-        floatType *const pbd = A.pullBuffers[n]->data();
+        floatType *const pbd = pullBuffers[n]->data();
         assert(pbd);
         //
+        if (exchange == 0 && directHaloEnabled()) {
+            DirectHaloPullBuffers::get().publish(
+                Asclrs->totalNumberOfRows, width, rank, nids[n], pbd
+            );
+        }
+        //
+        if (width == 1) {
+            for (int i = 0; i < sendLengthsd[n]; ++i) {
+                pbd[i] = xv[elementsToSend[txidx++]];
+            }
+            continue;
+        }
         for (int i = 0; i < sendLengthsd[n]; ++i) {
-            pbd[i] = xv[elementsToSend[txidx++]];
+            const floatType *const xe =
+                xv + size_t(elementsToSend[txidx++]) * width;
+            for (int j = 0; j < width; ++j) pbd[i * width + j] = xe[j];
         }
     }
     myPBs.ready.arrive(1);
     myPBs.ready = lrt->advance_phase_barrier(ctx, myPBs.ready);
-    //
+    // Pull from all the other neighbors at once, with the requirements of
+    // SetupGhostArrays.
+    const floatType *const *const dps =
+        directPulls.empty() ? nullptr : directPulls.data();
+    CopyLauncher cl;
     for (int n = 0; n < nNeighbors; ++n) {
-        //
-        const int nid = neighbors[n];
-        // Source
-        auto srcIt = A.nidToPullRegion.find(nid);
-        assert(srcIt != A.nidToPullRegion.end());
-        auto srclr = srcIt->second.get_logical_region();
-        //
-        RegionRequirement srcrr(
-            srclr, RO_E, srclr
-        );
-        // Only ever one field for all of our structures.
-        static const int srcFid = 0;
-        srcrr.add_field(srcFid);
-        // Destination.
-        LogicalArray<floatType> *dstArray = x.ghosts[n];
-        assert(dstArray->hasParentLogicalRegion());
-        //
-        RegionRequirement dstrr(
-            dstArray->logicalRegion,
-            WO_E,
-            dstArray->getParentLogicalRegion()
-        );
-        dstrr.add_field(dstArray->fid);
-        //
-        TaskLauncher tl(
-            REGION_TO_REGION_COPY_TID,
-            TaskArgument(NULL, 0)
-        );
-        tl.add_region_requirement(srcrr);
-        tl.add_region_requirement(dstrr);
-        //
-        syncs->neighbors[n].ready = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].ready
-        );
-        tl.add_wait_barrier(syncs->neighbors[n].ready);
-        //
-        tl.add_arrival_barrier(syncs->neighbors[n].done);
-        syncs->neighbors[n].done = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].done
-        );
-        //
-        lrt->execute_task(ctx, tl);
+        if (dps && dps[n]) continue;
+        cl.add_copy_requirements(x.halo.srcReqs[n], x.halo.dstReqs[n]);
     }
+    issueHaloCopy(cl, syncs, nNeighbors, ctx, lrt, dps);
+    if (!dps) return;
+    // The ghosts follow the local entries in neighbor order, see
+    // SetupGhostArrays, and the barriers go as in issueHaloCopy.
+    const local_int_t *const recvLengthsd = A.recvLength->data();
+    assert(recvLengthsd);
+    floatType *ghosts = x.data() + size_t(Asclrs->localNumberOfRows) * width;
+    for (int n = 0; n < nNeighbors; ++n) {
+        const size_t len = size_t(recvLengthsd[n]) * width;
+        if (dps[n]) {
+            syncs->neighbors[n].ready = lrt->advance_phase_barrier(
+                ctx, syncs->neighbors[n].ready
+            );
+            syncs->neighbors[n].ready.wait();
+            memcpy(ghosts, dps[n], len * sizeof(floatType));
+            //
+            syncs->neighbors[n].done.arrive(1);
+            syncs->neighbors[n].done = lrt->advance_phase_barrier(
+                ctx, syncs->neighbors[n].done
+            );
+        }
+        ghosts += len;
+    }
+}
+
+/**
+ * The neighbors of A and those pulled directly with --directhalo, over the
+ * levels, see ExchangeHaloBuffers.
+ */
+inline void
+countDirectHaloPulls(
+    const SparseMatrix &A,
+    int &neighbors,
+    int &direct
+) {
+    neighbors = 0;
+    direct = 0;
+    for (const SparseMatrix *l = &A; l; l = l->Ac) {
+        neighbors += l->sclrs->data()->numberOfSendNeighbors;
+        for (const floatType *dp : l->directPulls[0]) direct += (dp != nullptr);
+    }
+}
+
+#ifndef LGNCG_DO_TASKY_EXCHANGE
+inline void
+ExchangeHalo(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    // Nothing to do.
+    if (A.sclrs->data()->numberOfSendNeighbors == 0) return;
+    // The ghosts are the zeros of markGhostsZero everywhere: every shard skips
+    // the exchange, so the phase barriers stay in step.
+    if (x.halo.ghostsZero) {
+        x.halo.ghostsZero = false;
+        return;
+    }
+    KernelTimer timer(A.haloTime, ctx, lrt);
+    //
+    ExchangeHaloBuffers(A, x, A.pullBuffers, 1, ctx, lrt);
+    // The kernels of the level read the ghosts right after.
+    if (A.inlineMG) waitForLaunched(ctx, lrt);
 }
 #endif
+
+/**
+ * ExchangeHalo of a block vector of width right-hand sides, interleaved, see
+ * BlockCG.hpp: one exchange moves the ghosts of all of them, through the
+ * block pull buffers of A and the phase barriers of the scalar exchanges. x
+ * has ghosts set up by SetupGhostArrays with the same width. The block kernels
+ * run in the shard task, so this waits for the pulls.
+ */
+inline void
+ExchangeBlockHalo(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    int width,
+    Context ctx,
+    Runtime *lrt
+) {
+    // Nothing to do.
+    if (A.sclrs->data()->numberOfSendNeighbors == 0) return;
+    // As in ExchangeHalo.
+    if (x.halo.ghostsZero) {
+        x.halo.ghostsZero = false;
+        return;
+    }
+    KernelTimer timer(A.haloTime, ctx, lrt);
+    //
+    assert(A.blockPullBuffers.size() ==
+           size_t(A.sclrs->data()->numberOfSendNeighbors));
+    ExchangeHaloBuffers(A, x, A.blockPullBuffers, width, ctx, lrt);
+    waitForLaunched(ctx, lrt);
+}
@@ -29,119 +29,92 @@
 
 /*!
     @file FutureMath.hpp
+
+    Scalars of CG computed from the futures of the dot products where they are
+    used: the tasks that scale by one take its futures and compute it, so the
+    scalar math costs neither a task launch nor a wait in the caller.
  */
 
 #pragma once
 
 #include "LegionStuff.hpp"
 
-enum FutureMathOp {
-    FMO_DIV,
-    FMO_SQRT
-};
-
 /**
- *
+ * The value of num, divided by the value of den if it is set, e.g. alpha =
+ * rtz / pAp. Handed to a task with addTo, which evaluates it on the futures of
+ * the task with FutureRatioValue.
  */
-struct ComputeFutureArgs {
-    FutureMathOp op;
-};
+struct FutureRatio {
+    Future num;
+    Future den;
+    bool hasDen = false;
 
-/**
- *
- */
-inline floatType
-ComputeFutureKernel(
-    Future *a,
-    FutureMathOp op,
-    Future *b
-) {
-    const floatType av = a->get_result<floatType>(disableWarnings);
-    floatType bv = 0.0;
-    //
-    if (b) {
-        bv = b->get_result<floatType>(disableWarnings);
-    }
-    //
-    switch (op) {
-        case FMO_DIV:  return  av / bv;
-        case FMO_SQRT: return  sqrt(av);
-        default: exit(1);
+    /**
+     *
+     */
+    FutureRatio(void) = default;
+
+    /**
+     *
+     */
+    explicit FutureRatio(
+        const Future &n
+    ) : num(n) { }
+
+    /**
+     *
+     */
+    FutureRatio(
+        const Future &n,
+        const Future &d
+    ) : num(n)
+      , den(d)
+      , hasDen(true) { }
+
+    /**
+     * Number of futures addTo adds.
+     */
+    int
+    nFutures(void) const { return hasDen ? 2 : 1; }
+
+    /**
+     *
+     */
+    void
+    addTo(TaskLauncher &tl) const {
+        tl.add_future(num);
+        if (hasDen) tl.add_future(den);
     }
-    //
-    return 0;
-}
 
-/**
- *
- */
-inline Future
-ComputeFuture(
-    Future *a,
-    FutureMathOp op,
-    Future *b,
-    Context ctx,
-    Runtime *lrt
-) {
-#ifdef LGNCG_TASKING
-    //
-    ComputeFutureArgs args {
-        .op = op
-    };
-    //
-    TaskLauncher tl(
-        FUTURE_MATH_TID,
-        TaskArgument(&args, sizeof(args))
-    );
-    //
-    tl.add_future(*a);
-    if (b) tl.add_future(*b);
-    //
-    return lrt->execute_task(ctx, tl);
-#else
-    const floatType res = ComputeFutureKernel(a, op, b);
-    return Future::from_value(lrt, res);
-#endif
-}
+    /**
+     * Waits for the futures, for the runs without tasking.
+     */
+    floatType
+    value(void) const {
+        Future nf = num, df = den;
+        const floatType n = nf.get_result<floatType>(disableWarnings);
+        if (!hasDen) return n;
+        return n / df.get_result<floatType>(disableWarnings);
+    }
+};
 
 /**
- *
+ * The value of the FutureRatio of nFutures futures, 1 or 2, that addTo added
+ * to task at futures[first]. They are ready when the task runs.
  */
-floatType
-ComputeFutureTask(
+inline floatType
+FutureRatioValue(
     const Task *task,
-    const std::vector<PhysicalRegion> &regions,
-    Context ctx,
-    Runtime *lrt
+    int first,
+    int nFutures
 ) {
-    const auto *const args = (ComputeFutureArgs *)task->args;
+    assert(nFutures == 1 || nFutures == 2);
+    assert(task->futures.size() >= size_t(first + nFutures));
     //
-    const int nf = task->futures.size();
-    // Always at least one.
-    Future af = task->futures[0];
-    Future bf;
-    if (nf == 2) {
-        bf = task->futures[1];
-    }
+    Future nf = task->futures[first];
+    const floatType n = nf.get_result<floatType>(disableWarnings);
+    if (nFutures == 1) return n;
     //
-    return ComputeFutureKernel(&af, args->op, nf == 2 ? &bf : NULL);
-}
-
-/**
- *
- */
-inline void
-registerFutureMathTasks(void)
-{
-#ifdef LGNCG_TASKING
-    HighLevelRuntime::register_legion_task<floatType, ComputeFutureTask>(
-        FUTURE_MATH_TID /* task id */,
-        Processor::LOC_PROC /* proc kind  */,
-        true /* single */,
-        true /* index */,
-        AUTO_GENERATE_ID,
-        TaskConfigOptions(true /* leaf task */),
-        "ComputeFutureTask"
-    );
-#endif
+    Future df = task->futures[first + 1];
+    return n / df.get_result<floatType>(disableWarnings);
 }
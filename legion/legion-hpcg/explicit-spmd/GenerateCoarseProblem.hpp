@@ -116,29 +116,20 @@ GenerateCoarseProblemTopLevel(
     std::string name = "A-L" + std::to_string(level);
     Ac->allocate(name, *geomc, ctx, runtime);
     //
+    Ac->allReduceGroupSize = Af.allReduceGroupSize;
+    Ac->reproducibleReductions = Af.reproducibleReductions;
     Ac->partition(geomc->size, ctx, runtime);
     //
     Ac->geom = geomc;
     Af.Ac = Ac;
 }
 
-/*!
-    Routine to construct a prolongation/restriction operator for a given fine
-    grid matrix solution (as computed by a direct solver).
-
-    @param[inout]  Af - The known system matrix, on output its coarse operator,
-                   fine-to-coarse operator and auxiliary vectors will be defined.
-
-    Note that the matrix Af is considered const because the attributes we are
-    modifying are declared as mutable.
-
-*/
+/**
+ * The geometry of the coarse level of Af, which only depends on that of Af.
+ */
 inline void
-GenerateCoarseProblem(
-    SparseMatrix &Af,
-    int level,
-    Context ctx,
-    HighLevelRuntime *lrt
+GenerateCoarseGeometry(
+    SparseMatrix &Af
 ) {
     const Geometry *const AfGeom = Af.geom->data();
     assert(AfGeom);
@@ -160,8 +151,33 @@ GenerateCoarseProblem(
         AfGeom->stencilSize,
         Af.Ac->geom->data()
     );
+}
+
+/*!
+    Routine to construct a prolongation/restriction operator for a given fine
+    grid matrix solution (as computed by a direct solver).
+
+    @param[inout]  Af - The known system matrix, on output its coarse operator,
+                   fine-to-coarse operator and auxiliary vectors will be defined.
+
+    @param[in]     threaded - Whether to generate the coarse operator over the
+                   OpenMP threads of the task.
+
+    Note that the matrix Af is considered const because the attributes we are
+    modifying are declared as mutable.
+
+*/
+inline void
+GenerateCoarseProblem(
+    SparseMatrix &Af,
+    int level,
+    bool threaded,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    GenerateCoarseGeometry(Af);
     //
-    GenerateProblem(*Af.Ac, NULL, NULL, NULL, level, ctx, lrt);
+    GenerateProblem(*Af.Ac, NULL, NULL, NULL, level, threaded, ctx, lrt);
     GetNeighborInfo(*Af.Ac);
 }
 
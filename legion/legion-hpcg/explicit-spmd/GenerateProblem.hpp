@@ -59,33 +59,61 @@
 
 #include <cassert>
 
-/*!
-    Reference version of GenerateProblem to generate the sparse matrix, right
-    hand side, initial guess, and exact solution.
-
-    @param[in]  A        The known system matrix.
-
-    @param[inout] b      The newly allocated and generated right hand side
-                         vector (if b != 0 on entry).
-
-    @param[inout] x      The newly allocated solution vector with entries set to
-                         0.0 (if x != 0 on entry).
-
-    @param[inout] xexact The newly allocated solution vector with entries set to
-                         the exact solution (if the xexact!=0 non-zero on
-                         entry).
+/**
+ * Prints the memory footprint of the problem GenerateProblem generates for A
+ * and the vectors given, from rank 0.
+ */
+inline void
+GenerateProblemReport(
+    const SparseMatrix &A,
+    const Array<floatType> *b,
+    const Array<floatType> *x,
+    const Array<floatType> *xexact,
+    int level
+) {
+    using namespace std;
+    //
+    const Geometry *const Ageom = A.geom->data();
+    const local_int_t localNumberOfRows = Ageom->nx * Ageom->ny * Ageom->nz;
+    const local_int_t numberOfNonzerosPerRow = Ageom->stencilSize;
+    //
+    if (Ageom->rank == 0) {
+        const size_t mn = localNumberOfRows * numberOfNonzerosPerRow;
+        const size_t sparseMatMemInB = (
+            sizeof(char)         * localNumberOfRows //nonzerosInRow
+          + sizeof(global_int_t) * mn                //mtxIndG
+          + sizeof(mtx_ind_t)    * mn                //mtxIndL
+          + sizeof(matrixFloatType) * mn             //matrixValues
+          + sizeof(matrixFloatType) * localNumberOfRows //matrixDiagonal
+          + sizeof(global_int_t) * localNumberOfRows //localToGlobalMap
+        ) * Ageom->size;
+        //
+        const size_t vectorsMemInB = (
+            (b      ? sizeof(floatType) * localNumberOfRows : 0)
+          + (x      ? sizeof(floatType) * localNumberOfRows : 0)
+          + (xexact ? sizeof(floatType) * localNumberOfRows : 0)
+        ) * Ageom->size;
+        //
+        const size_t pMemInB = sparseMatMemInB + vectorsMemInB;
+        const double pMemInMB = pMemInB / 1024.0 / 1024.0;
+        cout << "--> Approximate Generate Problem Memory Footprint"
+                " (Level " << level << ")="
+             << pMemInMB << " MB" << endl;
+    }
+}
 
-    @see GenerateGeometry
-*/
+/**
+ * The rows of A and the entries of b, x and xexact of GenerateProblem, and the
+ * local scalars of A. Makes no Legion calls, so it may run on another thread
+ * than the task's, see genProblemTask.
+ */
 inline void
-GenerateProblem(
+GenerateProblemRows(
     SparseMatrix &A,
     Array<floatType> *b,
     Array<floatType> *x,
     Array<floatType> *xexact,
-    int level,
-    Context ctx,
-    Runtime *runtime
+    bool threaded
 ) {
     using namespace std;
     //
@@ -123,29 +151,6 @@ GenerateProblem(
     ////////////////////////////////////////////////////////////////////////////
     // Allocate arrays
     ////////////////////////////////////////////////////////////////////////////
-    if (Ageom->rank == 0) {
-        const size_t mn = localNumberOfRows * numberOfNonzerosPerRow;
-        const size_t sparseMatMemInB = (
-            sizeof(char)         * localNumberOfRows //nonzerosInRow
-          + sizeof(global_int_t) * mn                //mtxIndG
-          + sizeof(local_int_t)  * mn                //mtxIndL
-          + sizeof(floatType)    * mn                //matrixValues
-          + sizeof(floatType)    * localNumberOfRows //matrixDiagonal
-          + sizeof(global_int_t) * localNumberOfRows //localToGlobalMap
-        ) * Ageom->size;
-        //
-        const size_t vectorsMemInB = (
-            (b      ? sizeof(floatType) * localNumberOfRows : 0)
-          + (x      ? sizeof(floatType) * localNumberOfRows : 0)
-          + (xexact ? sizeof(floatType) * localNumberOfRows : 0)
-        ) * Ageom->size;
-        //
-        const size_t pMemInB = sparseMatMemInB + vectorsMemInB;
-        const double pMemInMB = pMemInB / 1024.0 / 1024.0;
-        cout << "--> Approximate Generate Problem Memory Footprint"
-                " (Level " << level << ")="
-             << pMemInMB << " MB" << endl;
-    }
     char *nonzerosInRow = A.nonzerosInRow->data();
     assert(nonzerosInRow);
     // Interpreted as 2D array
@@ -153,15 +158,15 @@ GenerateProblem(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndG->data()
     );
     // Interpreted as 2D array
-    Array2D<local_int_t> mtxIndL(
+    Array2D<mtx_ind_t> mtxIndL(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndL->data()
     );
     // Interpreted as 2D array
-    Array2D<floatType> matrixValues(
+    Array2D<matrixFloatType> matrixValues(
         localNumberOfRows, numberOfNonzerosPerRow, A.matrixValues->data()
     );
     //
-    floatType *matrixDiagonal = A.matrixDiagonal->data();
+    matrixFloatType *matrixDiagonal = A.matrixDiagonal->data();
     //
     global_int_t *localToGlobalMap = A.localToGlobalMap->data();
     //
@@ -185,7 +190,8 @@ GenerateProblem(
     }
     //
     global_int_t localNumberOfNonzeros = 0;
-    //
+    // Rows are independent of one another, so share the z-planes out.
+    LGNCG_OMP_FOR(if(threaded) reduction(+:localNumberOfNonzeros))
     for (local_int_t iz = 0; iz < nz; iz++) {
         global_int_t giz = ipz * nz + iz;
         for (local_int_t iy = 0; iy < ny; iy++) {
@@ -246,6 +252,21 @@ GenerateProblem(
     // Will be updated later to include external values in GetNeighborInfo.
     Asclrs->localNumberOfColumns  = localNumberOfRows;
     Asclrs->localNumberOfNonzeros = localNumberOfNonzeros;
+}
+
+/**
+ * The allReduce of the local nonzeros of A, set by GenerateProblemRows, over
+ * the shards, which GenerateProblemSetNonzeros takes. Those of several levels
+ * may be in flight at once.
+ */
+inline Future
+GenerateProblemNonzeros(
+    SparseMatrix &A,
+    Context ctx,
+    Runtime *runtime
+) {
+    const global_int_t localNumberOfNonzeros =
+        A.sclrs->data()->localNumberOfNonzeros;
 #if 0 // Debug
     {
         global_int_t expected = 0;
@@ -254,18 +275,30 @@ GenerateProblem(
         for (int i = 0; i < 10; ++i) {
             tnnz += allReduce(lnnz, *A.dcAllRedSumGI, ctx, runtime);
             lnnz++;
-            expected += (i * Ageom->size);
+            expected += (i * A.geom->data()->size);
         }
         //
         std::cout << "Expected=" << expected << " Actual=" << tnnz << std::endl;
     }
+    return Future();
 #else
     //
     Future lnnzf = Future::from_value(runtime, localNumberOfNonzeros);
-    Asclrs->totalNumberOfNonzeros = allReduce(
-        lnnzf, *A.dcAllRedSumGI, ctx, runtime
-    ).get_result<global_int_t>(disableWarnings);
+    return allReduce(lnnzf, *A.dcAllRedSumGI, ctx, runtime);
 #endif
+}
+
+/**
+ * Sets the global nonzeros of A from the GenerateProblemNonzeros of A.
+ */
+inline void
+GenerateProblemSetNonzeros(
+    SparseMatrix &A,
+    Future totalNonzeros
+) {
+    SparseMatrixScalars *Asclrs = A.sclrs->data();
+    Asclrs->totalNumberOfNonzeros =
+        totalNonzeros.get_result<global_int_t>(disableWarnings);
     // If this assert fails, it most likely means that the global_int_t is
     // set to int and should be set to long long This assert is usually the
     // first to fail as problem size increases beyond the 32-bit integer
@@ -273,3 +306,40 @@ GenerateProblem(
     // zero (can happen if int overflow)
     assert(Asclrs->totalNumberOfNonzeros > 0);
 }
+
+/*!
+    Reference version of GenerateProblem to generate the sparse matrix, right
+    hand side, initial guess, and exact solution.
+
+    @param[in]  A        The known system matrix.
+
+    @param[inout] b      The newly allocated and generated right hand side
+                         vector (if b != 0 on entry).
+
+    @param[inout] x      The newly allocated solution vector with entries set to
+                         0.0 (if x != 0 on entry).
+
+    @param[inout] xexact The newly allocated solution vector with entries set to
+                         the exact solution (if the xexact!=0 non-zero on
+                         entry).
+
+    @param[in] threaded  Whether to generate the rows over the OpenMP threads
+                         of the task, a z-plane at a time.
+
+    @see GenerateGeometry
+*/
+inline void
+GenerateProblem(
+    SparseMatrix &A,
+    Array<floatType> *b,
+    Array<floatType> *x,
+    Array<floatType> *xexact,
+    int level,
+    bool threaded,
+    Context ctx,
+    Runtime *runtime
+) {
+    GenerateProblemReport(A, b, x, xexact, level);
+    GenerateProblemRows(A, b, x, xexact, threaded);
+    GenerateProblemSetNonzeros(A, GenerateProblemNonzeros(A, ctx, runtime));
+}
@@ -100,6 +100,33 @@ ComputeRankOfMatrixRow(
     return rank;
 }
 
+/*!
+  Returns the global row index of a local row of this process, as
+  localToGlobalMap holds it during setup.
+
+  @param[in] geom     The description of the problem's geometry.
+  @param[in] localRow The local row index
+
+  @return Returns the global row index
+*/
+inline global_int_t
+ComputeGlobalRow(
+    const Geometry &geom,
+    local_int_t localRow
+) {
+    global_int_t gnx = geom.nx*geom.npx;
+    global_int_t gny = geom.ny*geom.npy;
+
+    global_int_t ix = localRow%geom.nx;
+    global_int_t iy = (localRow/geom.nx)%geom.ny;
+    global_int_t iz = localRow/(geom.nx*geom.ny);
+    global_int_t gix = geom.ipx*geom.nx+ix;
+    global_int_t giy = geom.ipy*geom.ny+iy;
+    global_int_t giz = geom.ipz*geom.nz+iz;
+    //
+    return giz*gnx*gny+giy*gnx+gix;
+}
+
 /**
  *
  */
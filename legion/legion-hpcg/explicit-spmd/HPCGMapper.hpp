@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+#pragma once
+
+#include "TaskTIDs.hpp"
+#include "Types.hpp"
+
+#include "legion.h"
+#include "default_mapper.h"
+
+#include <vector>
+
+/**
+ * Mapper of the explicit-SPMD port. The tasks a shard launches stay on the
+ * shard's processor, or on the GPU or OpenMP processor paired with it when
+ * they have a variant for it, GPU first, and are never stolen. Instances of
+ * GPU tasks go in the framebuffer of the GPU, where the matrix then stays
+ * from one iteration to the next. The others go in the system memory of the
+ * node, except pull buffers, which go in registered memory where there is
+ * some so that the neighbors pull straight from them. Otherwise instances
+ * are found or created as by the DefaultMapper, which reuses any valid one in
+ * the target memory.
+ */
+class HPCGMapper : public Legion::Mapping::DefaultMapper {
+protected:
+    // System memory of the local processor.
+    Legion::Memory mSysMem;
+    // Registered memory of the local processor, if any.
+    Legion::Memory mRegMem;
+    // OpenMP processor paired with the local processor, if any.
+    Legion::Processor mOMPProc;
+    // GPU paired with the local processor, if any, and its framebuffer.
+    Legion::Processor mGPUProc;
+    Legion::Memory mFBMem;
+
+    /**
+     * Whether task tid has a variant for processors of kind.
+     */
+    bool
+    mHasVariant(
+        const Legion::Mapping::MapperContext ctx,
+        Legion::TaskID tid,
+        Legion::Processor::Kind kind
+    ) {
+        std::vector<Legion::VariantID> variants;
+        runtime->find_valid_variants(ctx, tid, variants, kind);
+        return !variants.empty();
+    }
+
+public:
+    /**
+     *
+     */
+    HPCGMapper(
+        Legion::Mapping::MapperRuntime *rt,
+        Legion::Machine machine,
+        Legion::Processor local
+    ) : Legion::Mapping::DefaultMapper(rt, machine, local, "HPCGMapper")
+    {
+        using namespace Legion;
+        //
+        mSysMem = Machine::MemoryQuery(machine)
+                  .only_kind(Memory::SYSTEM_MEM)
+                  .has_affinity_to(local)
+                  .first();
+        mRegMem = Machine::MemoryQuery(machine)
+                  .only_kind(Memory::REGDMA_MEM)
+                  .has_affinity_to(local)
+                  .first();
+        // The i-th CPU of a node gets the OpenMP processor i modulo their
+        // number, so with one OpenMP processor per shard each has its own.
+        std::vector<Processor> cpus, omps;
+        Machine::ProcessorQuery cpuq(machine);
+        cpuq.only_kind(Processor::LOC_PROC).same_address_space_as(local);
+        for (auto p : cpuq) cpus.push_back(p);
+        Machine::ProcessorQuery ompq(machine);
+        ompq.only_kind(Processor::OMP_PROC).same_address_space_as(local);
+        for (auto p : ompq) omps.push_back(p);
+        // And GPUs the same way.
+        std::vector<Processor> gpus;
+        Machine::ProcessorQuery gpuq(machine);
+        gpuq.only_kind(Processor::TOC_PROC).same_address_space_as(local);
+        for (auto p : gpuq) gpus.push_back(p);
+        //
+        if (local.kind() == Processor::LOC_PROC) {
+            for (size_t i = 0; i < cpus.size(); ++i) {
+                if (cpus[i] != local) continue;
+                if (!omps.empty()) mOMPProc = omps[i % omps.size()];
+                if (!gpus.empty()) mGPUProc = gpus[i % gpus.size()];
+            }
+        }
+        if (mGPUProc.exists()) {
+            mFBMem = Machine::MemoryQuery(machine)
+                     .only_kind(Memory::GPU_FB_MEM)
+                     .best_affinity_to(mGPUProc)
+                     .first();
+        }
+    }
+
+    /**
+     *
+     */
+    virtual void
+    select_task_options(
+        const Legion::Mapping::MapperContext ctx,
+        const Legion::Task &task,
+        TaskOptions &output
+    ) override {
+        using namespace Legion;
+        //
+        DefaultMapper::select_task_options(ctx, task, output);
+        output.stealable = false;
+        // The top-level task is placed by the DefaultMapper, and the shards
+        // by its map_must_epoch.
+        if (task.task_id == MAIN_TID) return;
+        // Index launches of the top-level task are sliced by the
+        // DefaultMapper.
+        if (task.is_index_space) return;
+        output.initial_proc = local_proc;
+        if (mGPUProc.exists() &&
+            mHasVariant(ctx, task.task_id, Processor::TOC_PROC)) {
+            output.initial_proc = mGPUProc;
+        }
+        else if (mOMPProc.exists() &&
+                 mHasVariant(ctx, task.task_id, Processor::OMP_PROC)) {
+            output.initial_proc = mOMPProc;
+        }
+    }
+
+    /**
+     *
+     */
+    virtual Legion::Memory
+    default_policy_select_target_memory(
+        Legion::Mapping::MapperContext ctx,
+        Legion::Processor targetProc,
+        const Legion::RegionRequirement &req
+    ) override {
+        if (targetProc == mGPUProc && mFBMem.exists()) return mFBMem;
+        // Only ours share the local processor's memories.
+        if (targetProc != local_proc && targetProc != mOMPProc) {
+            return DefaultMapper::default_policy_select_target_memory(
+                ctx, targetProc, req
+            );
+        }
+        if (req.tag == LGNCG_PULL_BUFFER_TAG && mRegMem.exists()) {
+            return mRegMem;
+        }
+        if (mSysMem.exists()) return mSysMem;
+        //
+        return DefaultMapper::default_policy_select_target_memory(
+            ctx, targetProc, req
+        );
+    }
+};
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/**
+ * Arena of the halo metadata of a matrix level: the pull buffer structures of
+ * a LogicalSparseMatrix and of a SparseMatrix, and the neighbor tables built
+ * while setting up the halo. Objects are carved out of large blocks and
+ * released together, by release or the destructor, instead of one new and
+ * delete each, and none of them is forgotten by a destructor.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ *
+ */
+class HaloArena {
+    // Bytes per block, larger requests get a block of their own.
+    static const size_t sBlockBytes = 64 * 1024;
+    //
+    std::vector< std::unique_ptr<char[]> > mBlocks;
+    //
+    char *mNext = nullptr;
+    //
+    size_t mLeft = 0;
+    // Of the objects made with a destructor to run, in order.
+    std::vector< std::function<void(void)> > mDestructors;
+
+public:
+    /**
+     *
+     */
+    HaloArena(void) = default;
+
+    /**
+     *
+     */
+    HaloArena(const HaloArena &) = delete;
+
+    /**
+     *
+     */
+    HaloArena &
+    operator=(const HaloArena &) = delete;
+
+    /**
+     *
+     */
+    ~HaloArena(void)
+    {
+        release();
+    }
+
+    /**
+     * Uninitialized room for bytes bytes aligned to align, valid until
+     * release.
+     */
+    void *
+    allocateBytes(
+        size_t bytes,
+        size_t align
+    ) {
+        if (bytes == 0) bytes = 1;
+        size_t pad = (align - size_t(mNext) % align) % align;
+        if (!mNext || pad + bytes > mLeft) {
+            // Blocks are aligned for any type, see new.
+            const size_t blockBytes = bytes > sBlockBytes ? bytes : sBlockBytes;
+            mBlocks.emplace_back(new char[blockBytes]);
+            mNext = mBlocks.back().get();
+            mLeft = blockBytes;
+            pad = 0;
+        }
+        void *p = mNext + pad;
+        mNext += pad + bytes;
+        mLeft -= pad + bytes;
+        return p;
+    }
+
+    /**
+     * Uninitialized room for n T, aligned for T, valid until release.
+     */
+    template <typename T>
+    T *
+    allocate(
+        size_t n
+    ) {
+        static_assert(
+            std::is_trivially_destructible<T>::value,
+            "allocate is for trivially destructible types, see make"
+        );
+        return static_cast<T *>(allocateBytes(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * A T constructed from args, destroyed by release.
+     */
+    template <typename T, typename... Args>
+    T *
+    make(
+        Args &&... args
+    ) {
+        void *p = allocateBytes(sizeof(T), alignof(T));
+        T *t = new (p) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            mDestructors.push_back([t] { t->~T(); });
+        }
+        return t;
+    }
+
+    /**
+     * Destroys the objects made, last first, and frees all the blocks.
+     */
+    void
+    release(void)
+    {
+        for (auto d = mDestructors.rbegin(); d != mDestructors.rend(); ++d) {
+            (*d)();
+        }
+        mDestructors.clear();
+        mBlocks.clear();
+        mNext = nullptr;
+        mLeft = 0;
+    }
+};
+
+/**
+ * Allocator of the standard containers from a HaloArena: deallocate does
+ * nothing, the nodes go with the arena. For the temporary maps and sets of
+ * the halo setup, which are built once and thrown away whole.
+ */
+template <typename T>
+struct HaloArenaAllocator {
+    typedef T value_type;
+    //
+    HaloArena *arena;
+
+    /**
+     *
+     */
+    explicit HaloArenaAllocator(
+        HaloArena &a
+    ) : arena(&a) { }
+
+    /**
+     *
+     */
+    template <typename U>
+    HaloArenaAllocator(
+        const HaloArenaAllocator<U> &other
+    ) : arena(other.arena) { }
+
+    /**
+     *
+     */
+    T *
+    allocate(
+        size_t n
+    ) {
+        return static_cast<T *>(
+            arena->allocateBytes(n * sizeof(T), alignof(T))
+        );
+    }
+
+    /**
+     *
+     */
+    void
+    deallocate(T *, size_t) { }
+
+    /**
+     *
+     */
+    template <typename U>
+    bool
+    operator==(const HaloArenaAllocator<U> &other) const {
+        return arena == other.arena;
+    }
+
+    /**
+     *
+     */
+    template <typename U>
+    bool
+    operator!=(const HaloArenaAllocator<U> &other) const {
+        return arena != other.arena;
+    }
+};
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/**
+ * The vector kernels of CG launched from the top-level task, one index launch
+ * over the shard partition per kernel, instead of by each shard for its part:
+ * the implicit counterpart of the explicit-SPMD port, for --implicit. The
+ * leaf tasks are the same, and dot products are reduced by the runtime into
+ * one future instead of with a dynamic collective.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "ComputeDotProduct.hpp"
+#include "ComputeWAXPBY.hpp"
+
+#include "mytimer.hpp"
+
+/**
+ * w = alpha * x + beta * y over all shards, n entries each.
+ */
+inline void
+ComputeWAXPBYIndex(
+    const local_int_t n,
+    const floatType alpha,
+    LogicalArray<floatType> &x,
+    const floatType beta,
+    LogicalArray<floatType> &y,
+    LogicalArray<floatType> &w,
+    Context ctx,
+    Runtime *lrt
+) {
+    const bool xySame = (&x == &y);
+    const bool xwSame = (&x == &w);
+    const bool ywSame = (&y == &w);
+    //
+    ComputeWAXPBYArgs args {
+        .n = n,
+        .alpha  = alpha,
+        .beta   = beta,
+        .xySame = xySame,
+        .xwSame = xwSame,
+        .ywSame = ywSame,
+        .betaFutures = 0
+    };
+    //
+    IndexLauncher il(
+        WAXPBY_TID,
+        w.launchDomain,
+        TaskArgument(&args, sizeof(args)),
+        ArgumentMap()
+    );
+    // Regions as in ComputeWAXPBYLaunch.
+    x.intent(xwSame ? RW : RO, EXCLUSIVE, il, ctx, lrt);
+    if (!xySame) {
+        y.intent(ywSame ? RW : RO, EXCLUSIVE, il, ctx, lrt);
+    }
+    if (!xwSame && !ywSame) {
+        w.intent(WO_E, il, ctx, lrt);
+    }
+    //
+    lrt->execute_index_space(ctx, il);
+}
+
+/**
+ * Returns a future of x'y over all shards, n entries each.
+ */
+inline Future
+ComputeDotProductIndex(
+    local_int_t n,
+    LogicalArray<floatType> &x,
+    LogicalArray<floatType> &y,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeDotProductArgs args = {
+        .n = n
+    };
+    //
+    IndexLauncher il(
+        DDOT_TID,
+        x.launchDomain,
+        TaskArgument(&args, sizeof(args)),
+        ArgumentMap()
+    );
+    //
+    x.intent(RO_E, il, ctx, lrt);
+    y.intent(RO_E, il, ctx, lrt);
+    //
+    return lrt->execute_index_space(ctx, il, FLOAT_REDUCE_SUM_TID);
+}
+
+/**
+ * Runs nIters iterations of the vector kernels of a CG iteration, r'z, p'Ap
+ * and r'r and the updates of p, x and r, on r, p and x, and returns the time
+ * they took. As in CG, the residual norm is waited on before the next
+ * iteration.
+ * The values are of no interest: the coefficients only keep them bounded.
+ */
+inline double
+ImplicitVectorOps(
+    local_int_t n,
+    int nIters,
+    LogicalArray<floatType> &r,
+    LogicalArray<floatType> &p,
+    LogicalArray<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    const double start = mytimer();
+    //
+    for (int k = 0; k < nIters; ++k) {
+        ComputeDotProductIndex(n, r, r, ctx, lrt);
+        ComputeWAXPBYIndex(n, 0.5, r, 0.5, p, p, ctx, lrt);
+        ComputeDotProductIndex(n, p, p, ctx, lrt);
+        ComputeWAXPBYIndex(n, 1.0, x, 1.0e-3, p, x, ctx, lrt);
+        ComputeWAXPBYIndex(n, 1.0, r, -1.0e-3, p, r, ctx, lrt);
+        //
+        Future normr = ComputeDotProductIndex(n, r, r, ctx, lrt);
+        normr.get_result<floatType>(disableWarnings);
+    }
+    //
+    return mytimer() - start;
+}
@@ -83,6 +83,7 @@ public:
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
+        if (this->mShareOwnerPartition()) return;
         // Only allow even partitioning.
         assert(0 == this->mLength % nParts && "Uneven partitioning requested.");
         //
@@ -185,6 +186,22 @@ public:
     }
 };
 
+/**
+ * The halo exchange of a vector, built once by SetupGhostArrays: the
+ * subregion of its local entries, and the copy requirements from the pull
+ * buffers of its neighbors into its ghosts, in neighbor order.
+ */
+struct HaloPlan {
+    LogicalRegion privateLR = LogicalRegion::NO_REGION;
+    std::vector<RegionRequirement> srcReqs;
+    std::vector<RegionRequirement> dstReqs;
+    // Set by markGhostsZero: every shard zeroed the vector, ghosts included,
+    // and has not written it since, so the ghosts are current. The next halo
+    // exchange of the vector is skipped, by all the shards alike, and clears
+    // it.
+    bool ghostsZero = false;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,6 +210,8 @@ template<typename TYPE>
 struct Array : public Item<TYPE> {
     //
     std::vector<LogicalArray<TYPE> *> ghosts;
+    //
+    HaloPlan halo;
 
     /**
      *
@@ -203,6 +222,16 @@ struct Array : public Item<TYPE> {
         HighLevelRuntime *runtime
     ) : Item<TYPE>(physicalRegion, ctx, runtime) { }
 
+    /**
+     *
+     */
+    Array(
+        const PhysicalRegion &physicalRegion,
+        Legion::FieldID fieldID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) : Item<TYPE>(physicalRegion, fieldID, ctx, runtime) { }
+
     /**
      *
      */
@@ -206,3 +206,379 @@ protected:
         mNRegionEntries = cid - baseRID;
     }
 };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The vectors PipelinedCG needs besides those of CGData, all nrow long: the
+ * recurrences it keeps instead of an SpMV and a preconditioner apply per
+ * dot product. CGData's z and p hold its u = M^-1 r and m = M^-1 w, which
+ * need halos, and Ap its w = A u.
+ */
+struct LogicalPipelinedCGData : public LogicalMultiBase {
+    LogicalArray<floatType> n;  //!< A * m.
+    LogicalArray<floatType> p;  //!< Direction vector.
+    LogicalArray<floatType> s;  //!< A * p.
+    LogicalArray<floatType> q;  //!< M^-1 * s.
+    LogicalArray<floatType> Aq; //!< A * q.
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {&n, &p, &s, &q, &Aq};
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalPipelinedCGData(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    void
+    allocate(
+        const std::string &name,
+        SparseMatrix &A,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        #define aalloca(sName, size, ctx, rtp)                                 \
+        do {                                                                   \
+            sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
+        } while(0)
+
+        const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+        //
+        aalloca(n,  nrow, ctx, lrt);
+        aalloca(p,  nrow, ctx, lrt);
+        aalloca(s,  nrow, ctx, lrt);
+        aalloca(q,  nrow, ctx, lrt);
+        aalloca(Aq, nrow, ctx, lrt);
+
+        #undef aalloca
+    }
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct PipelinedCGData : public PhysicalMultiBase {
+    //
+    Array<floatType> *n = nullptr;
+    //
+    Array<floatType> *p = nullptr;
+    //
+    Array<floatType> *s = nullptr;
+    //
+    Array<floatType> *q = nullptr;
+    //
+    Array<floatType> *Aq = nullptr;
+
+    /**
+     *
+     */
+    PipelinedCGData(void) = default;
+
+    /**
+     *
+     */
+    virtual
+    ~PipelinedCGData(void) {
+        delete n;
+        delete p;
+        delete s;
+        delete q;
+        delete Aq;
+    }
+
+    /**
+     *
+     */
+    PipelinedCGData(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, n->physicalRegion);
+        lrt->unmap_region(ctx, p->physicalRegion);
+        lrt->unmap_region(ctx, s->physicalRegion);
+        lrt->unmap_region(ctx, q->physicalRegion);
+        lrt->unmap_region(ctx, Aq->physicalRegion);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        // Populate members from physical regions.
+        n = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(n->data());
+        //
+        p = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(p->data());
+        //
+        s = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(s->data());
+        //
+        q = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(q->data());
+        //
+        Aq = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(Aq->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The block vectors of BlockCG, k right-hand sides each, interleaved: entry i
+ * of column j is at i * k + j. z and p are ncol * k long and partitioned with
+ * width k for ExchangeBlockHalo, the others nrow * k.
+ */
+struct LogicalBlockCGData : public LogicalMultiBase {
+    LogicalArray<floatType> x;  //!< Solutions.
+    LogicalArray<floatType> b;  //!< Right-hand sides.
+    LogicalArray<floatType> r;  //!< Residual vectors.
+    LogicalArray<floatType> z;  //!< Preconditioned residual vectors.
+    LogicalArray<floatType> p;  //!< Direction vectors.
+    LogicalArray<floatType> Ap; //!< Krylov vectors.
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {&x, &b, &r, &z, &p, &Ap};
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalBlockCGData(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    void
+    allocate(
+        const std::string &name,
+        SparseMatrix &A,
+        int k,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        #define aalloca(sName, size, ctx, rtp)                                 \
+        do {                                                                   \
+            sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
+        } while(0)
+
+        const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+        const local_int_t ncol = A.sclrs->data()->localNumberOfColumns;
+        //
+        aalloca(x,  nrow * k, ctx, lrt);
+        aalloca(b,  nrow * k, ctx, lrt);
+        aalloca(r,  nrow * k, ctx, lrt);
+        aalloca(z,  ncol * k, ctx, lrt);
+        aalloca(p,  ncol * k, ctx, lrt);
+        aalloca(Ap, nrow * k, ctx, lrt);
+
+        #undef aalloca
+    }
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     *
+     */
+    void
+    partition(
+        SparseMatrix &A,
+        int k,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        Partition(A, z, ctx, lrt, k);
+        Partition(A, p, ctx, lrt, k);
+        // The others don't need to be partitioned.
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct BlockCGData : public PhysicalMultiBase {
+    // Number of right-hand sides.
+    int k = 0;
+    //
+    Array<floatType> *x = nullptr;
+    //
+    Array<floatType> *b = nullptr;
+    //
+    Array<floatType> *r = nullptr;
+    //
+    Array<floatType> *z = nullptr;
+    //
+    Array<floatType> *p = nullptr;
+    //
+    Array<floatType> *Ap = nullptr;
+
+    /**
+     *
+     */
+    BlockCGData(void) = default;
+
+    /**
+     *
+     */
+    virtual
+    ~BlockCGData(void) {
+        delete x;
+        delete b;
+        delete r;
+        delete z;
+        delete p;
+        delete Ap;
+    }
+
+    /**
+     *
+     */
+    BlockCGData(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        int k,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) : k(k) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, x->physicalRegion);
+        lrt->unmap_region(ctx, b->physicalRegion);
+        lrt->unmap_region(ctx, r->physicalRegion);
+        lrt->unmap_region(ctx, z->physicalRegion);
+        lrt->unmap_region(ctx, p->physicalRegion);
+        lrt->unmap_region(ctx, Ap->physicalRegion);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        // Populate members from physical regions.
+        x = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(x->data());
+        //
+        b = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(b->data());
+        //
+        r = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(r->data());
+        //
+        z = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(z->data());
+        //
+        p = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(p->data());
+        //
+        Ap = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(Ap->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
@@ -32,6 +32,8 @@
 
 #include <cassert>
 #include <deque>
+#include <unordered_map>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -51,6 +53,10 @@ public:
     Legion::LogicalPartition logicalPartition;
     // Parent logical region (if set).
     LogicalRegion parentLogicalRegion;
+    // The item whose region this one is a field of, see allocateField.
+    LogicalItemBase *fieldOwner = nullptr;
+    // The fields of the items that are fields of this one's region.
+    std::vector<Legion::FieldID> memberFIDs;
 
 protected:
     // Name we attach to item.
@@ -58,6 +64,20 @@ protected:
     //
     bool mHasParentLogicalRegion = false;
 
+    /**
+     * Items that are fields of another's region use its partition, so it must
+     * be partitioned first. Returns whether that is the case.
+     */
+    bool
+    mShareOwnerPartition(void) {
+        if (!fieldOwner) return false;
+        //
+        indexPartition = fieldOwner->indexPartition;
+        logicalPartition = fieldOwner->logicalPartition;
+        launchDomain = fieldOwner->launchDomain;
+        return true;
+    }
+
 public:
 
     /**
@@ -94,6 +114,73 @@ public:
         ).add_field(fid);
     }
 
+    /**
+     * All the subregions of the partition, one per point of the launch.
+     */
+    void
+    intent(
+        Legion::PrivilegeMode privMode,
+        Legion::CoherenceProperty cohProp,
+        Legion::IndexLauncher &launcher,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        launcher.add_region_requirement(
+            RegionRequirement(
+                logicalPartition,
+                0 /* identity projection */,
+                privMode,
+                cohProp,
+                logicalRegion
+            )
+        ).add_field(fid);
+    }
+
+    /**
+     * The subregion of shard with the fields of this item and of all the items
+     * that are fields of its region, in one requirement.
+     */
+    void
+    groupIntent(
+        Legion::PrivilegeMode privMode,
+        Legion::CoherenceProperty cohProp,
+        int shard,
+        Legion::TaskLauncher &launcher,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        auto lsr = lrt->get_logical_subregion_by_color(
+            ctx, logicalPartition, shard
+        );
+        RegionRequirement rr(lsr, privMode, cohProp, logicalRegion);
+        rr.add_field(fid);
+        for (auto mfid : memberFIDs) rr.add_field(mfid);
+        launcher.add_region_requirement(rr);
+    }
+
+    /**
+     *
+     */
+    void
+    groupIntent(
+        Legion::PrivilegeMode privMode,
+        Legion::CoherenceProperty cohProp,
+        Legion::IndexLauncher &launcher,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        RegionRequirement rr(
+            logicalPartition,
+            0 /* identity projection */,
+            privMode,
+            cohProp,
+            logicalRegion
+        );
+        rr.add_field(fid);
+        for (auto mfid : memberFIDs) rr.add_field(mfid);
+        launcher.add_region_requirement(rr);
+    }
+
     /**
      *
      */
@@ -191,7 +278,8 @@ public:
     }
 
     /**
-     *
+     * One requirement per region: items that are fields of another's region
+     * come with it.
      */
     virtual void
     intent(
@@ -203,7 +291,25 @@ public:
         HighLevelRuntime *lrt
     ) {
         for (auto &a : mLogicalItems) {
-            a->intent(privMode, cohProp, shard, launcher, ctx, lrt);
+            if (a->fieldOwner) continue;
+            a->groupIntent(privMode, cohProp, shard, launcher, ctx, lrt);
+        }
+    }
+
+    /**
+     *
+     */
+    virtual void
+    intent(
+        Legion::PrivilegeMode privMode,
+        Legion::CoherenceProperty cohProp,
+        Legion::IndexLauncher &launcher,
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        for (auto &a : mLogicalItems) {
+            if (a->fieldOwner) continue;
+            a->groupIntent(privMode, cohProp, launcher, ctx, lrt);
         }
     }
 };
@@ -352,6 +458,43 @@ public:
         mAllocate(name, 1, ctx, lrt);
     }
 
+    /**
+     * Allocates the item as field fieldID of the region of owner, which must
+     * not be partitioned yet: the item has the length, and will have the
+     * partition, of owner, and goes with it in its group intents. The region
+     * is returned with owner.
+     */
+    void
+    allocateField(
+        const std::string &name,
+        LogicalItemBase &owner,
+        Legion::FieldID fieldID,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        fid = fieldID;
+        logicalRegion = owner.logicalRegion;
+        mIndexSpace = logicalRegion.get_index_space();
+        mFS = logicalRegion.get_field_space();
+        mBounds = lrt->get_index_space_domain(
+                      ctx, mIndexSpace
+                  ).get_rect<1>();
+        mLength = mBounds.volume();
+        //
+        FieldAllocator fa = lrt->create_field_allocator(ctx, mFS);
+        fa.allocate_field(sizeof(TYPE), fid);
+        // Stash some info for equality checks.
+        mIndexSpaceID = mIndexSpace.get_id();
+        mFieldSpaceID = mFS.get_id();
+        mRTreeID      = logicalRegion.get_tree_id();
+        //
+        mName = name;
+        lrt->attach_name(mFS, fid, mName.c_str());
+        //
+        fieldOwner = &owner;
+        owner.memberFIDs.push_back(fid);
+    }
+
     /**
      * Cleans up and returns all allocated resources.
      */
@@ -360,6 +503,9 @@ public:
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
+        // The region is the owner's to return.
+        if (fieldOwner) return;
+        //
         lrt->destroy_index_space(ctx, mIndexSpace);
         lrt->destroy_field_space(ctx, mFS);
         lrt->destroy_logical_region(ctx, logicalRegion);
@@ -413,6 +559,37 @@ public:
     }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The bounds of index space is, asked of the runtime the first time only.
+ * Index spaces never change, and the leaf tasks wrap the same subregions in
+ * Items at every launch of the benchmark, so after the first iteration
+ * building them is just getting their pointers. One cache per processor
+ * thread, so no locking.
+ */
+inline Rect<1>
+indexSpaceBounds(
+    const Legion::IndexSpace &is,
+    Context ctx,
+    HighLevelRuntime *runtime
+) {
+    static thread_local std::unordered_map<
+        Legion::IndexSpaceID, Rect<1>
+    > bounds;
+    //
+    auto it = bounds.find(is.get_id());
+    if (it != bounds.end()) return it->second;
+    //
+    const Rect<1> rect = runtime->get_index_space_domain(
+        ctx, is
+    ).get_rect<1>();
+    bounds[is.get_id()] = rect;
+    return rect;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -425,35 +602,60 @@ protected:
     //
     TYPE *mData = nullptr;
 
+    /**
+     *
+     */
+    static Legion::FieldID
+    mOnlyField(
+        const PhysicalRegion &physicalReg
+    ) {
+        std::vector<Legion::FieldID> fields;
+        physicalReg.get_fields(fields);
+        assert(fields.size() == 1 && "Field ID needed for multi-field region.");
+        return fields[0];
+    }
+
 public:
     //
     LogicalRegion logicalRegion;
     //
     PhysicalRegion physicalRegion;
-    // Field ID (only one, so it doesn't change).
+    // Field ID of the item in its region.
     const Legion::FieldID fid = 0;
 
     /**
-     *
+     * From the only field of physicalReg.
      */
     Item(
         const PhysicalRegion &physicalReg,
         Context ctx,
         HighLevelRuntime *runtime
-    ) {
+    ) : Item(physicalReg, mOnlyField(physicalReg), ctx, runtime) { }
+
+    /**
+     * From field fieldID of physicalReg, which may have others, see
+     * LogicalItem::allocateField.
+     */
+    Item(
+        const PhysicalRegion &physicalReg,
+        Legion::FieldID fieldID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) : fid(fieldID)
+    {
         // Cache logical and physical regions.
         physicalRegion = physicalReg;
         logicalRegion = physicalRegion.get_logical_region();
         //
         using GRA = RegionAccessor<AccessorType::Generic, TYPE>;
-        GRA tAcc = physicalRegion.get_field_accessor(0).template typeify<TYPE>();
+        GRA tAcc = physicalRegion.get_field_accessor(fid).template
+                   typeify<TYPE>();
         //
-        Domain tDom = runtime->get_index_space_domain(
-            ctx, physicalRegion.get_logical_region().get_index_space()
-        );
         Rect<1> subrect;
         ByteOffset inOffsets[1];
-        auto subGridBounds = tDom.get_rect<1>();
+        const Rect<1> subGridBounds = indexSpaceBounds(
+            logicalRegion.get_index_space(), ctx, runtime
+        );
         mLength = subGridBounds.volume();
         //
         mData = tAcc.template raw_rect_ptr<1>(
@@ -484,7 +686,7 @@ public:
      *
      */
     FieldID
-    getFieldID(void) { return 0; }
+    getFieldID(void) { return fid; }
 
     /**
      *
@@ -494,10 +696,9 @@ public:
         Context ctx,
         HighLevelRuntime *lrt
     ) {
-        Rect<1> rect = lrt->get_index_space_domain(
-            ctx,
-            logicalRegion.get_index_space()
-        ).template get_rect<1>();
+        const Rect<1> rect = indexSpaceBounds(
+            logicalRegion.get_index_space(), ctx, lrt
+        );
         //
         return rect.lo.x[0];
     }
@@ -103,3 +103,50 @@ LogicalMGData::partition(
     Partition(A, Axf, ctx, lrt);
     // f2cOperator and rc don't need to be partitioned.
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+void
+LogicalBlockMGData::allocate(
+    const std::string &name,
+    SparseMatrix &A,
+    int k,
+    LegionRuntime::HighLevel::Context ctx,
+    LegionRuntime::HighLevel::HighLevelRuntime *lrt
+) {
+    #define aalloca(sName, size, ctx, rtp)                                     \
+    do {                                                                       \
+        sName.allocate(name + "-block-" #sName, size, ctx, rtp);               \
+    } while(0)
+
+    assert(A.Ac);
+
+    auto *Acsclrs = A.Ac->sclrs->data();
+    //
+    const local_int_t nrowc = Acsclrs->localNumberOfRows;
+    const local_int_t ncolc = Acsclrs->localNumberOfColumns;
+    //
+    aalloca(rc, nrowc * k, ctx, lrt);
+    aalloca(xc, ncolc * k, ctx, lrt);
+
+    #undef aalloca
+}
+
+/**
+ *
+ */
+void
+LogicalBlockMGData::partition(
+    SparseMatrix &A,
+    int k,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    assert(A.Ac);
+    //
+    Partition(*A.Ac, xc, ctx, lrt, k);
+    // rc doesn't need to be partitioned.
+}
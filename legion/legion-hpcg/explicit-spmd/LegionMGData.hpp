@@ -223,3 +223,152 @@ protected:
         mNRegionEntries = cid - baseRID;
     }
 };
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * The coarse vectors of the block V-cycle of ComputeBlockMG, k right-hand
+ * sides each, interleaved. The f2cOperator is that of MGData, and the fused
+ * restriction needs no Axf.
+ */
+struct LogicalBlockMGData : public LogicalMultiBase {
+    // Coarse grid residual vectors.
+    LogicalArray<floatType> rc;
+    // Coarse grid solution vectors.
+    LogicalArray<floatType> xc;
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {
+            &rc,
+            &xc
+        };
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalBlockMGData(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        SparseMatrix &A,
+        int k,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    );
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     *
+     */
+    void
+    partition(
+        SparseMatrix &A,
+        int k,
+        Context ctx,
+        HighLevelRuntime *lrt
+    );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct BlockMGData : public PhysicalMultiBase {
+    //
+    Array<floatType> *rc = nullptr;
+    //
+    Array<floatType> *xc = nullptr;
+
+    /**
+     *
+     */
+    BlockMGData(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    virtual
+    ~BlockMGData(void) {
+        delete rc;
+        delete xc;
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, rc->physicalRegion);
+        lrt->unmap_region(ctx, xc->physicalRegion);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        // Populate members from physical regions.
+        rc = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(rc->data());
+        //
+        xc = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(xc->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
@@ -43,14 +43,30 @@
 #include "LegionStuff.hpp"
 #include "LegionItems.hpp"
 #include "LegionArrays.hpp"
+#include "LegionSELLData.hpp"
 #include "LegionMGData.hpp"
+#include "AgglomeratedMG.hpp"
 #include "CollectiveOps.hpp"
+#include "HaloArena.hpp"
 
 #include "hpcg.hpp"
 #include "Geometry.hpp"
 
 #include <vector>
 #include <map>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * A box of the local grid: the points lo[d] <= i[d] < hi[d] along x, y and z.
+ */
+struct GridBox {
+    local_int_t lo[3] = {0, 0, 0};
+    local_int_t hi[3] = {0, 0, 0};
+};
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -77,6 +93,9 @@ struct SparseMatrixScalars {
     int numberOfRecvNeighbors = 0;
     //Total number of entries to be sent.
     local_int_t totalToBeSent = 0;
+    // Local rows with no external column, set by SetupHalo. Empty if there
+    // are none.
+    GridBox interior;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -96,6 +115,41 @@ struct Synchronizers {
     PhaseBarriers neighbors[HPCG_STENCIL - 1];
 };
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * Field IDs of the arrays of a sparse matrix. The arrays of the same length
+ * that the same tasks use are fields of one region, that of the first one,
+ * for fewer regions to map per task: the per-shard, the per-row, the
+ * per-nonzero and the per-neighbor arrays. The setup-only arrays have their
+ * own, returned after setup.
+ */
+enum SparseMatrixFIDs {
+    // Per shard.
+    SM_GEOMS_FID = 0,
+    SM_SCLRS_FID,
+    SM_DC_ALL_RED_SUM_GI_FID,
+    SM_DC_ALL_RED_SUM_FT_FID,
+    SM_DC_ALL_RED_MIN_FT_FID,
+    SM_DC_ALL_RED_MAX_FT_FID,
+    SM_DC_ALL_RED_SUM_FD_FID,
+    SM_DC_ALL_RED_SUM_AV_FID,
+    SM_SYNCHRONIZERS_FID,
+    // Per row.
+    SM_NONZEROS_IN_ROW_FID = 0,
+    SM_MATRIX_DIAGONAL_FID,
+    SM_MATD_IDX_TO_MAT_ROW_COL_FID,
+    // Per nonzero.
+    SM_MTX_IND_L_FID = 0,
+    SM_MATRIX_VALUES_FID,
+    // Per neighbor.
+    SM_NEIGHBORS_FID = 0,
+    SM_SEND_LENGTH_FID,
+    SM_RECV_LENGTH_FID
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,21 +162,23 @@ struct LogicalSparseMatrix : public LogicalMultiBase {
     LogicalArray<SparseMatrixScalars> sclrs;
     //
     LogicalArray<char> nonzerosInRow;
-    //
+    // Setup only, see deallocateSetupData.
     LogicalArray<global_int_t> mtxIndG;
     //
-    LogicalArray<local_int_t> mtxIndL;
-    //
-    LogicalArray<floatType> matrixValues;
+    LogicalArray<mtx_ind_t> mtxIndL;
     //
-    LogicalArray<floatType> matrixDiagonal;
+    LogicalArray<matrixFloatType> matrixValues;
     //
+    LogicalArray<matrixFloatType> matrixDiagonal;
+    // Setup only, see deallocateSetupData.
     LogicalArray<global_int_t> localToGlobalMap;
     // Dynamic collective structures (1 per task).
     LogicalArray< DynColl<global_int_t> > dcAllRedSumGI;
     LogicalArray< DynColl<floatType> > dcAllRedSumFT;
     LogicalArray< DynColl<floatType> > dcAllRedMinFT;
     LogicalArray< DynColl<floatType> > dcAllRedMaxFT;
+    LogicalArray< DynColl<FusedDots> > dcAllRedSumFD;
+    LogicalArray< DynColl<AgglomeratedVector> > dcAllRedSumAV;
     // Neighboring processes.
     LogicalArray<int> neighbors;
     // Number of items that will be sent on a per neighbor basis.
@@ -137,26 +193,46 @@ struct LogicalSparseMatrix : public LogicalMultiBase {
     // Vector index is for a given shard that is sharing pull region info.
     // Innermost vector is for neighboring regions that we are sharing.
     ////////////////////////////////////////////////////////////////////////////
-    // TODO Free up resources properly in destructor.
+    // Made from haloArena, returned by deallocate.
     std::vector< std::vector< LogicalArray<floatType> *> > srcSharedRegions;
     // Similar structure the pullers will use to setup RegionRequirements.
     std::vector< std::vector< LogicalArray<floatType> *> > dstSharedRegions;
+    // The same for the pull buffers of the block halo exchanges, blockWidth
+    // values per entry sent, see ExchangeBlockHalo.
+    std::vector< std::vector< LogicalArray<floatType> *> >
+        srcBlockSharedRegions;
+    std::vector< std::vector< LogicalArray<floatType> *> >
+        dstBlockSharedRegions;
     ////////////////////////////////////////////////////////////////////////////
     // Task-local (i.e., only valid in task where instance was created).
     ////////////////////////////////////////////////////////////////////////////
+    // The pull buffer structures of the shared regions, see HaloArena.hpp.
+    HaloArena haloArena;
     // Coarse grid matrix.
     LogicalSparseMatrix *Ac = nullptr;
     // Geometry for top-level setup.
     Geometry *geom = nullptr;
+    // Shards per group of the two-level allReduce of the collectives made by
+    // partition, 0 for one collective of all shards (--allreduce).
+    int64_t allReduceGroupSize = 0;
+    // Whether the floatType sums of partition are exact (--repro).
+    bool reproducibleReductions = false;
+    // Right-hand sides of the block pull buffers added by intent with
+    // IFLAG_W_BLOCK_GHOSTS (--block), set before the first intent with ghosts.
+    int blockWidth = 0;
 
 protected:
     // Number of shards used for SparseMatrix decomposition.
     int mSize = 0;
     //
     bool mSharedRegionsPopulated = false;
+    //
+    bool mSetupDataDeallocated = false;
 
     /**
-     * Order matters here. If you update this, also update unpack.
+     * Order matters here. If you update this, also update unpack, which only
+     * sees the regions of the items that are not fields of another's, see
+     * SparseMatrixFIDs.
      */
     void
     mPopulateRegionList(void) {
@@ -172,6 +248,8 @@ protected:
                          &dcAllRedSumFT,
                          &dcAllRedMinFT,
                          &dcAllRedMaxFT,
+                         &dcAllRedSumFD,
+                         &dcAllRedSumAV,
                          &neighbors,
                          &sendLength,
                          &recvLength,
@@ -234,44 +312,55 @@ public:
         Array2D<local_int_t> sendLengthsd(
             mSize, maxNumNeighbors, aSendLengths.data()
         );
-        // Iterate over all shards and populate table that maps task IDs to
-        // their index into the neighbor list.
-        vector< map<int, int> > tidToNIdx(mSize);
-        for (int shard = 0; shard < mSize; ++shard) {
-            // Get total number of neighbors this shard has.
-            const SparseMatrixScalars &myScalars = sclrsd[shard];
-            const int nNeighbors = myScalars.numberOfSendNeighbors;
-            //
-            for (int n = 0; n < nNeighbors; ++n) {
-                int tid = neighborsd(shard, n);
-                tidToNIdx[shard][tid] = n;
-            }
-        }
-        // We are going to need mSize slots for the vectors.
-        srcSharedRegions.resize(mSize);
-        dstSharedRegions.resize(mSize);
-        // Figure out how many receive neighbors each shard has.
-        for (int shard = 0; shard < mSize; ++shard) {
-            const int nRecvNeighbors = tidToNIdx[shard].size();
-            dstSharedRegions[shard].resize(nRecvNeighbors);
-        }
-        //
-        for (int shard = 0; shard < mSize; ++shard) {
+        // The index of shard tid in the neighbor list of shard, a scan of at
+        // most HPCG_STENCIL - 1 neighbors instead of a map per shard.
+        auto neighborIndex = [&](int shard, int tid) -> int {
             const int nNeighbors = sclrsd[shard].numberOfSendNeighbors;
             for (int n = 0; n < nNeighbors; ++n) {
-                const int nid = neighborsd(shard, n);
-                auto *sa = new LogicalArray<floatType>();
-                string rName = "A-pullRegion-SourceRank=" + to_string(shard)
-                             + "DestinationRank=" + to_string(nid);
-                sa->allocate(
-                    rName,
-                    sendLengthsd(shard, n),
-                    ctx,
-                    lrt
-                );
-                srcSharedRegions[shard].push_back(sa);
-                dstSharedRegions[nid][tidToNIdx[nid][shard]] = sa;
+                if (neighborsd(shard, n) == tid) return n;
+            }
+            assert(false && "tid is not a neighbor of shard.");
+            return -1;
+        };
+        // The pull buffers of width values per entry sent into src and dst.
+        auto populate = [&](
+            std::vector< std::vector< LogicalArray<floatType> *> > &src,
+            std::vector< std::vector< LogicalArray<floatType> *> > &dst,
+            const string &prefix,
+            int width
+        ) {
+            // We are going to need mSize slots for the vectors.
+            src.resize(mSize);
+            dst.resize(mSize);
+            // Send and receive neighbors are the same.
+            for (int shard = 0; shard < mSize; ++shard) {
+                dst[shard].resize(sclrsd[shard].numberOfSendNeighbors);
             }
+            //
+            for (int shard = 0; shard < mSize; ++shard) {
+                const int nNeighbors = sclrsd[shard].numberOfSendNeighbors;
+                for (int n = 0; n < nNeighbors; ++n) {
+                    const int nid = neighborsd(shard, n);
+                    auto *sa = haloArena.make< LogicalArray<floatType> >();
+                    string rName = prefix + "-SourceRank=" + to_string(shard)
+                                 + "DestinationRank=" + to_string(nid);
+                    sa->allocate(
+                        rName,
+                        sendLengthsd(shard, n) * width,
+                        ctx,
+                        lrt
+                    );
+                    src[shard].push_back(sa);
+                    dst[nid][neighborIndex(nid, shard)] = sa;
+                }
+            }
+        };
+        populate(srcSharedRegions, dstSharedRegions, "A-pullRegion", 1);
+        if (blockWidth > 1) {
+            populate(
+                srcBlockSharedRegions, dstBlockSharedRegions,
+                "A-blockPullRegion", blockWidth
+            );
         }
         //
         sclrs.unmapRegion(ctx, lrt);
@@ -294,64 +383,82 @@ public:
         LegionRuntime::HighLevel::Context ctx,
         LegionRuntime::HighLevel::HighLevelRuntime *lrt
     ) {
-        LogicalMultiBase::intent(privMode, cohProp, shard, launcher, ctx, lrt);
+        if (withSetupData(iFlags)) {
+            LogicalMultiBase::intent(
+                privMode, cohProp, shard, launcher, ctx, lrt
+            );
+        }
+        else {
+            for (auto *a : mLogicalItems) {
+                if (a == &mtxIndG || a == &localToGlobalMap) continue;
+                if (a->fieldOwner) continue;
+                a->groupIntent(privMode, cohProp, shard, launcher, ctx, lrt);
+            }
+        }
         //
         if (withGhosts(iFlags)) {
             if (!mSharedRegionsPopulated) {
                 mPopulateSharedRegions(ctx, lrt);
             }
-            const int maxNumNeighbors = HPCG_STENCIL - 1;
-            //
-            Array<SparseMatrixScalars> aSparseMatrixScalars(
-                sclrs.mapRegion(RO_E, ctx, lrt), ctx, lrt
+            mGhostIntents(
+                srcSharedRegions[shard], dstSharedRegions[shard], launcher
             );
-            SparseMatrixScalars *sclrsd = aSparseMatrixScalars.data();
-            assert(sclrsd);
-            //
-            Array<int> aNeighbors(
-                neighbors.mapRegion(RO_E, ctx, lrt), ctx, lrt
-            );
-            assert(aNeighbors.data());
-            // For convenience we'll interpret this as a 2D array.
-            Array2D<int> neighborsd(
-                mSize, maxNumNeighbors, aNeighbors.data()
+        }
+        // After them, in the same order, those of the block halo.
+        if (withBlockGhosts(iFlags)) {
+            assert(withGhosts(iFlags) && blockWidth > 1);
+            mGhostIntents(
+                srcBlockSharedRegions[shard], dstBlockSharedRegions[shard],
+                launcher
             );
-            const int nNeighbors = sclrsd[shard].numberOfSendNeighbors;
-            // First nNeighbors regions are the ones I'm populating. That is,
-            // I'm the source for the values and my neighbors pull from those.
-            for (int n = 0; n < nNeighbors; ++n) {
-                auto *ap = srcSharedRegions[shard][n];
-                auto &lr = ap->logicalRegion;
-                launcher.add_region_requirement(
-                    RegionRequirement(
-                        lr,
-                        READ_WRITE,
-                        SIMULTANEOUS,
-                        lr
-                    )
-                ).add_field(ap->fid);
-            }
-            // Next nNeighbors regions are the ones I need for my computation.
-            // That is, they are the once that other tasks have populated.
-            const int nRecvNeighbors = dstSharedRegions[shard].size();
-            for (int n = 0; n < nRecvNeighbors; ++n) {
-                auto *ap = dstSharedRegions[shard][n];
-                auto &lr = ap->logicalRegion;
-                launcher.add_region_requirement(
-                    RegionRequirement(
-                        lr,
-                        READ_ONLY,
-                        SIMULTANEOUS,
-                        lr
-                    ).add_flags(NO_ACCESS_FLAG)
-                ).add_field(ap->fid);
-            }
-            //
-            sclrs.unmapRegion(ctx, lrt);
-            neighbors.unmapRegion(ctx, lrt);
         }
     }
 
+protected:
+
+    /**
+     * Adds the pull buffers of a shard, src the ones it fills and dst the
+     * ones of its neighbors, to launcher. The neighbor counts are those of
+     * the tables of the shared regions, so nothing needs to be mapped here.
+     */
+    void
+    mGhostIntents(
+        const std::vector< LogicalArray<floatType> *> &src,
+        const std::vector< LogicalArray<floatType> *> &dst,
+        Legion::TaskLauncher &launcher
+    ) {
+        // First nNeighbors regions are the ones I'm populating. That is,
+        // I'm the source for the values and my neighbors pull from those.
+        for (auto *ap : src) {
+            auto &lr = ap->logicalRegion;
+            launcher.add_region_requirement(
+                RegionRequirement(
+                    lr,
+                    READ_WRITE,
+                    SIMULTANEOUS,
+                    lr,
+                    LGNCG_PULL_BUFFER_TAG
+                )
+            ).add_field(ap->fid);
+        }
+        // Next nNeighbors regions are the ones I need for my computation.
+        // That is, they are the once that other tasks have populated.
+        for (auto *ap : dst) {
+            auto &lr = ap->logicalRegion;
+            launcher.add_region_requirement(
+                RegionRequirement(
+                    lr,
+                    READ_ONLY,
+                    SIMULTANEOUS,
+                    lr,
+                    LGNCG_PULL_BUFFER_TAG
+                ).add_flags(NO_ACCESS_FLAG)
+            ).add_field(ap->fid);
+        }
+    }
+
+public:
+
     /**
      *
      */
@@ -366,13 +473,18 @@ public:
         do {                                                                   \
             sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
         } while(0)
+        // A field of the region of oName, see SparseMatrixFIDs.
+        #define afield(sName, oName, sFID, ctx, rtp)                           \
+        do {                                                                   \
+            sName.allocateField(name + "-" #sName, oName, sFID, ctx, rtp);     \
+        } while(0)
 
         mSize = geom.size;
         const auto globalXYZ   = getGlobalXYZ(geom);
         const auto stencilSize = geom.stencilSize;
 
         aalloca(geoms, mSize, ctx, lrt);
-        aalloca(sclrs, mSize, ctx, lrt);
+        afield(sclrs, geoms, SM_SCLRS_FID, ctx, lrt);
         //
         aalloca(nonzerosInRow, globalXYZ, ctx, lrt);
         // Flattened to 1D from 2D.
@@ -380,27 +492,35 @@ public:
         // Flattened to 1D from 2D.
         aalloca(mtxIndL, globalXYZ * stencilSize, ctx, lrt);
         // Flattened to 1D from 2D.
-        aalloca(matrixValues, globalXYZ * stencilSize, ctx, lrt);
+        afield(matrixValues, mtxIndL, SM_MATRIX_VALUES_FID, ctx, lrt);
         // 2D thing in reference implementation, but not needed (1D suffices).
-        aalloca(matrixDiagonal, globalXYZ, ctx, lrt);
+        afield(
+            matrixDiagonal, nonzerosInRow, SM_MATRIX_DIAGONAL_FID, ctx, lrt
+        );
         //
         aalloca(localToGlobalMap, globalXYZ, ctx, lrt);
         //
-        aalloca(dcAllRedSumGI, mSize, ctx, lrt);
-        aalloca(dcAllRedSumFT, mSize, ctx, lrt);
-        aalloca(dcAllRedMinFT, mSize, ctx, lrt);
-        aalloca(dcAllRedMaxFT, mSize, ctx, lrt);
+        afield(dcAllRedSumGI, geoms, SM_DC_ALL_RED_SUM_GI_FID, ctx, lrt);
+        afield(dcAllRedSumFT, geoms, SM_DC_ALL_RED_SUM_FT_FID, ctx, lrt);
+        afield(dcAllRedMinFT, geoms, SM_DC_ALL_RED_MIN_FT_FID, ctx, lrt);
+        afield(dcAllRedMaxFT, geoms, SM_DC_ALL_RED_MAX_FT_FID, ctx, lrt);
+        afield(dcAllRedSumFD, geoms, SM_DC_ALL_RED_SUM_FD_FID, ctx, lrt);
+        afield(dcAllRedSumAV, geoms, SM_DC_ALL_RED_SUM_AV_FID, ctx, lrt);
         //
         const int maxNumNeighbors = geom.stencilSize - 1;
         // Each task will have at most 26 neighbors.
         aalloca(neighbors,  mSize * maxNumNeighbors, ctx, lrt);
-        aalloca(sendLength, mSize * maxNumNeighbors, ctx, lrt);
-        aalloca(recvLength, mSize * maxNumNeighbors, ctx, lrt);
+        afield(sendLength, neighbors, SM_SEND_LENGTH_FID, ctx, lrt);
+        afield(recvLength, neighbors, SM_RECV_LENGTH_FID, ctx, lrt);
         //
-        aalloca(synchronizers, mSize, ctx, lrt);
+        afield(synchronizers, geoms, SM_SYNCHRONIZERS_FID, ctx, lrt);
         //
-        aalloca(matdIdxToMatRowCol, globalXYZ, ctx, lrt);
+        afield(
+            matdIdxToMatRowCol, nonzerosInRow,
+            SM_MATD_IDX_TO_MAT_ROW_COL_FID, ctx, lrt
+        );
 
+        #undef afield
         #undef aalloca
     }
 
@@ -423,6 +543,7 @@ public:
         mPopulateDynamicCollectives(dcAllRedSumGI, dynColGI, ctx, lrt);
         //
         DynColl<floatType> dynColSumFT(FLOAT_REDUCE_SUM_TID, nArrivals);
+        dynColSumFT.exact = reproducibleReductions;
         mPopulateDynamicCollectives(dcAllRedSumFT, dynColSumFT, ctx, lrt);
         //
         DynColl<floatType> dynColMinFT(FLOAT_REDUCE_MIN_TID, nArrivals);
@@ -430,6 +551,14 @@ public:
         //
         DynColl<floatType> dynColMaxFT(FLOAT_REDUCE_MAX_TID, nArrivals);
         mPopulateDynamicCollectives(dcAllRedMaxFT, dynColMaxFT, ctx, lrt);
+        //
+        DynColl<FusedDots> dynColSumFD(FUSED_DOTS_REDUCE_SUM_TID, nArrivals);
+        mPopulateDynamicCollectives(dcAllRedSumFD, dynColSumFD, ctx, lrt);
+        //
+        DynColl<AgglomeratedVector> dynColSumAV(
+            AGGLOMERATED_VECTOR_REDUCE_SUM_TID, nArrivals
+        );
+        mPopulateDynamicCollectives(dcAllRedSumAV, dynColSumAV, ctx, lrt);
         // Just pick a structure that has a representative launch domain.
         launchDomain = geoms.launchDomain;
     }
@@ -443,8 +572,39 @@ public:
         LegionRuntime::HighLevel::HighLevelRuntime *lrt
     ) {
         for (auto *i : mLogicalItems) {
+            if (mSetupDataDeallocated &&
+                (i == &mtxIndG || i == &localToGlobalMap)) continue;
             i->deallocate(ctx, lrt);
         }
+        // The pull buffers, each once: the dst tables hold the same ones.
+        for (auto *src : {&srcSharedRegions, &srcBlockSharedRegions}) {
+            for (auto &shardRegions : *src) {
+                for (auto *sa : shardRegions) sa->deallocate(ctx, lrt);
+            }
+            src->clear();
+        }
+        dstSharedRegions.clear();
+        dstBlockSharedRegions.clear();
+        haloArena.release();
+        mSharedRegionsPopulated = false;
+    }
+
+    /**
+     * Returns the regions of the global column indices and the local to global
+     * row map. They are only read while setting up the problem, in the task
+     * that converts mtxIndG to mtxIndL, so the benchmark tasks are launched
+     * without them (IFLAG_WO_SETUP) and these 8 * 28 bytes per row are not
+     * resident for the rest of the run.
+     */
+    void
+    deallocateSetupData(
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        if (mSetupDataDeallocated) return;
+        mtxIndG.deallocate(ctx, lrt);
+        localToGlobalMap.deallocate(ctx, lrt);
+        mSetupDataDeallocated = true;
     }
 
 private:
@@ -460,24 +620,65 @@ private:
         LegionRuntime::HighLevel::Context ctx,
         LegionRuntime::HighLevel::HighLevelRuntime *lrt
     ) {
+        const int64_t nShards = dynCol.nArrivals;
+        const int64_t groupSize = allReduceGroupSize;
+        dynCol.hierarchical = (groupSize > 1 && groupSize < nShards);
         Array< DynColl<TYPE> > dcs(
             targetLogicalArray.mapRegion(RW_E, ctx, lrt), ctx, lrt
         );
         //
         DynColl<TYPE> *dcsd = dcs.data();
         assert(dcsd);
+        // An exact sum reduces ExactSums, see allReduce.
+        static const ExactSum exactZero = {};
+        const int redop = dynCol.exact ? EXACT_SUM_REDUCE_SUM_TID : dynCol.tid;
+        const void *init = &dynCol.localBuffer;
+        size_t initSize = sizeof(dynCol.localBuffer);
+        if (dynCol.exact) {
+            init = &exactZero;
+            initSize = sizeof(exactZero);
+        }
         //
         dynCol.dc = lrt->create_dynamic_collective(
             ctx,
             dynCol.nArrivals /* Number of arrivals. */,
-            dynCol.tid,
-            &dynCol.localBuffer,
-            sizeof(dynCol.localBuffer)
+            redop,
+            init,
+            initSize
         );
         // Replicate
-        for (int64_t i = 0; i < dynCol.nArrivals; ++i) {
+        for (int64_t i = 0; i < nShards; ++i) {
             dcsd[i] = dynCol;
         }
+        // Shards i * groupSize up to the next group share a collective, and
+        // the first of them also arrives on the one of the group leaders.
+        if (dynCol.hierarchical) {
+            const int64_t nGroups = (nShards + groupSize - 1) / groupSize;
+            const DynamicCollective leadersDC = lrt->create_dynamic_collective(
+                ctx,
+                nGroups /* Number of arrivals. */,
+                redop,
+                init,
+                initSize
+            );
+            for (int64_t g = 0; g < nGroups; ++g) {
+                const int64_t first = g * groupSize;
+                const int64_t last = std::min(first + groupSize, nShards);
+                const DynamicCollective groupDC =
+                    lrt->create_dynamic_collective(
+                        ctx,
+                        last - first /* Number of arrivals. */,
+                        redop,
+                        init,
+                        initSize
+                    );
+                for (int64_t i = first; i < last; ++i) {
+                    dcsd[i].groupDC = groupDC;
+                    dcsd[i].leadersDC = leadersDC;
+                    dcsd[i].groupLeader = (i == first);
+                }
+            }
+        }
         // Done, so unmap.
         targetLogicalArray.unmapRegion(ctx, lrt);
     }
@@ -494,15 +695,15 @@ struct SparseMatrix : public PhysicalMultiBase {
     Item<SparseMatrixScalars> *sclrs = nullptr;
     //
     Array<char> *nonzerosInRow = nullptr;
-    // Flattened to 1D from 2D.
+    // Flattened to 1D from 2D. Setup only: nullptr with IFLAG_WO_SETUP.
     Array<global_int_t> *mtxIndG = nullptr;
     // Flattened to 1D from 2D.
-    Array<local_int_t> *mtxIndL = nullptr;
+    Array<mtx_ind_t> *mtxIndL = nullptr;
     // Flattened to 1D from 2D.
-    Array<floatType> *matrixValues = nullptr;
-    //
-    Array<floatType> *matrixDiagonal = nullptr;
+    Array<matrixFloatType> *matrixValues = nullptr;
     //
+    Array<matrixFloatType> *matrixDiagonal = nullptr;
+    // Setup only: nullptr with IFLAG_WO_SETUP.
     Array<global_int_t> *localToGlobalMap = nullptr;
     //
     Item< DynColl<global_int_t> > *dcAllRedSumGI = nullptr;
@@ -513,6 +714,10 @@ struct SparseMatrix : public PhysicalMultiBase {
     //
     Item< DynColl<floatType> > *dcAllRedMaxFT = nullptr;
     //
+    Item< DynColl<FusedDots> > *dcAllRedSumFD = nullptr;
+    //
+    Item< DynColl<AgglomeratedVector> > *dcAllRedSumAV = nullptr;
+    //
     Array<int> *neighbors = nullptr;
     //
     Array<local_int_t> *sendLength = nullptr;
@@ -532,6 +737,9 @@ struct SparseMatrix : public PhysicalMultiBase {
     // Global to local mapping. NOTE: only valid after a call to
     // PopulateGlobalToLocalMap.
     std::map< global_int_t, local_int_t > globalToLocalMap;
+    // The structures of elementsToSend and of the pull buffers below, see
+    // HaloArena.hpp.
+    HaloArena haloArena;
     // Only valid after a call to SetupHalo.
     LogicalArray<local_int_t> lElementsToSend;
     Array<local_int_t> *elementsToSend = nullptr;
@@ -539,10 +747,41 @@ struct SparseMatrix : public PhysicalMultiBase {
     std::map<int, PhysicalRegion> nidToPullRegion;
     // Pull regions that I populate for consumption by other tasks.
     std::vector< Array<floatType> *> pullBuffers;
-    // No optimization here.
+    // The same for the block halo exchanges, with IFLAG_W_BLOCK_GHOSTS.
+    std::map<int, PhysicalRegion> nidToBlockPullRegion;
+    std::vector< Array<floatType> *> blockPullBuffers;
+    // With --directhalo, the pull buffers of the neighbors in this process
+    // read directly by the exchanges through pullBuffers ([0]) and
+    // blockPullBuffers ([1]), null for the other neighbors, and the number of
+    // those exchanges so far, see ExchangeHaloBuffers.
+    std::vector<const floatType *> directPulls[2];
+    int haloExchanges[2] = {0, 0};
+    // Block right-hand sides of the coarse level of this fine matrix for the
+    // block V-cycle, set by the block CG phase, see BlockCG.hpp.
+    BlockMGData *blockMGData = nullptr;
+    // Set for the coarse levels with --fmg: ComputeMG runs the V-cycle from
+    // here down in the shard task itself, see ComputeMGInline.
+    bool inlineMG = false;
+    // Set by OptimizeProblem with --agglomerate on the level whose V-cycle,
+    // the coarser levels included, every shard solves on the whole level,
+    // see ComputeAgglomeratedMG. inlineMG is set from here down.
+    AgglomeratedMG *agglomerated = nullptr;
+    // Seconds spent in the halo exchanges of this level, and in its V-cycles,
+    // coarser levels included, with --timekernels, see KernelTimer.
+    double haloTime = 0.0;
+    double mgTime = 0.0;
+    // Set by OptimizeProblem: SYMGS sweeps the rows in multicolor order.
+    bool multicolorSYMGS = false;
+    // Set by OptimizeProblem: SELL copy used by SpMV and SYMGS.
+    LogicalSELLData *lSELL = nullptr;
+    SELLData *sell = nullptr;
+    // Set by OptimizeProblem: SpMV and SYMGS compute the interior rows from
+    // the 27-point stencil instead of reading the matrix.
+    bool matrixFree = false;
+    // No optimization here, but for those OptimizeProblem sets up.
     const bool isDotProductOptimized = false;
-    const bool isSpmvOptimized = false;
-    const bool isMgOptimized = false;
+    bool isSpmvOptimized = false;
+    bool isMgOptimized = false;
     const bool isWaxpbyOptimized = false;
 
     /**
@@ -592,21 +831,20 @@ struct SparseMatrix : public PhysicalMultiBase {
         delete dcAllRedSumFT;
         delete dcAllRedMinFT;
         delete dcAllRedMaxFT;
+        delete dcAllRedSumFD;
+        delete dcAllRedSumAV;
         delete neighbors;
         delete sendLength;
         delete recvLength;
         delete synchronizers;
         delete matdIdxToMatRowCol;
-        // Task-local allocation of non-region memory.
-        if (elementsToSend) {
-            // TODO
-            //lElementsToSend.unmapRegion
-            //elementsToSend->deallocate
-            delete elementsToSend;
-        }
-        for (auto *i : pullBuffers) delete i;
+        // elementsToSend and the pull buffers go with haloArena.
+        delete sell;
+        delete lSELL;
         if (Ac) delete Ac;
         if (mgData) delete mgData;
+        delete blockMGData;
+        delete agglomerated;
     }
 
 protected:
@@ -639,72 +877,124 @@ protected:
         HighLevelRuntime *rt
     ) {
         size_t cid = baseRID;
-        // Populate members from physical regions.
-        geom = new Item<Geometry>(regions[cid++], ctx, rt);
+        // Populate members from physical regions, see SparseMatrixFIDs.
+        const PhysicalRegion &shardPR = regions[cid++];
+        //
+        geom = new Item<Geometry>(shardPR, SM_GEOMS_FID, ctx, rt);
         assert(geom->data());
         //
-        sclrs = new Item<SparseMatrixScalars>(regions[cid++], ctx, rt);
+        sclrs = new Item<SparseMatrixScalars>(shardPR, SM_SCLRS_FID, ctx, rt);
         assert(sclrs->data());
         //
-        nonzerosInRow = new Array<char>(regions[cid++], ctx, rt);
-        assert(nonzerosInRow->data());
+        dcAllRedSumGI = new Item< DynColl<global_int_t> >(
+            shardPR, SM_DC_ALL_RED_SUM_GI_FID, ctx, rt
+        );
+        assert(dcAllRedSumGI->data());
         //
-        mtxIndG = new Array<global_int_t>(regions[cid++], ctx, rt);
-        assert(mtxIndG->data());
+        dcAllRedSumFT = new Item< DynColl<floatType> >(
+            shardPR, SM_DC_ALL_RED_SUM_FT_FID, ctx, rt
+        );
+        assert(dcAllRedSumFT->data());
         //
-        mtxIndL = new Array<local_int_t>(regions[cid++], ctx, rt);
-        assert(mtxIndL->data());
+        dcAllRedMinFT = new Item< DynColl<floatType> >(
+            shardPR, SM_DC_ALL_RED_MIN_FT_FID, ctx, rt
+        );
+        assert(dcAllRedMinFT->data());
         //
-        matrixValues = new Array<floatType>(regions[cid++], ctx, rt);
-        assert(matrixValues->data());
+        dcAllRedMaxFT = new Item< DynColl<floatType> >(
+            shardPR, SM_DC_ALL_RED_MAX_FT_FID, ctx, rt
+        );
+        assert(dcAllRedMaxFT->data());
+        //
+        dcAllRedSumFD = new Item< DynColl<FusedDots> >(
+            shardPR, SM_DC_ALL_RED_SUM_FD_FID, ctx, rt
+        );
+        assert(dcAllRedSumFD->data());
+        //
+        dcAllRedSumAV = new Item< DynColl<AgglomeratedVector> >(
+            shardPR, SM_DC_ALL_RED_SUM_AV_FID, ctx, rt
+        );
+        assert(dcAllRedSumAV->data());
+        //
+        synchronizers = new Item<Synchronizers>(
+            shardPR, SM_SYNCHRONIZERS_FID, ctx, rt
+        );
+        assert(synchronizers->data());
+        //
+        const PhysicalRegion &rowPR = regions[cid++];
+        //
+        nonzerosInRow = new Array<char>(rowPR, SM_NONZEROS_IN_ROW_FID, ctx, rt);
+        assert(nonzerosInRow->data());
         //
-        matrixDiagonal = new Array<floatType>(regions[cid++], ctx, rt);
+        matrixDiagonal = new Array<matrixFloatType>(
+            rowPR, SM_MATRIX_DIAGONAL_FID, ctx, rt
+        );
         assert(matrixDiagonal->data());
         //
-        localToGlobalMap = new Array<global_int_t>(regions[cid++], ctx, rt);
-        assert(localToGlobalMap->data());
+        matdIdxToMatRowCol = new Array<rcpType>(
+            rowPR, SM_MATD_IDX_TO_MAT_ROW_COL_FID, ctx, rt
+        );
+        assert(matdIdxToMatRowCol->data());
         //
-        dcAllRedSumGI = new Item< DynColl<global_int_t> >(regions[cid++], ctx, rt);
-        assert(dcAllRedSumGI->data());
+        if (withSetupData(iFlags)) {
+            mtxIndG = new Array<global_int_t>(regions[cid++], ctx, rt);
+            assert(mtxIndG->data());
+        }
         //
-        dcAllRedSumFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
-        assert(dcAllRedSumFT->data());
+        const PhysicalRegion &nonzeroPR = regions[cid++];
         //
-        dcAllRedMinFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
-        assert(dcAllRedMinFT->data());
+        mtxIndL = new Array<mtx_ind_t>(nonzeroPR, SM_MTX_IND_L_FID, ctx, rt);
+        assert(mtxIndL->data());
         //
-        dcAllRedMaxFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
-        assert(dcAllRedMaxFT->data());
+        matrixValues = new Array<matrixFloatType>(
+            nonzeroPR, SM_MATRIX_VALUES_FID, ctx, rt
+        );
+        assert(matrixValues->data());
+        //
+        if (withSetupData(iFlags)) {
+            localToGlobalMap = new Array<global_int_t>(regions[cid++], ctx, rt);
+            assert(localToGlobalMap->data());
+        }
         //
-        neighbors = new Array<int>(regions[cid++], ctx, rt);
+        const PhysicalRegion &neighborPR = regions[cid++];
+        //
+        neighbors = new Array<int>(neighborPR, SM_NEIGHBORS_FID, ctx, rt);
         assert(neighbors->data());
         //
-        sendLength = new Array<local_int_t>(regions[cid++], ctx, rt);
+        sendLength = new Array<local_int_t>(
+            neighborPR, SM_SEND_LENGTH_FID, ctx, rt
+        );
         assert(sendLength->data());
         //
-        recvLength = new Array<local_int_t>(regions[cid++], ctx, rt);
+        recvLength = new Array<local_int_t>(
+            neighborPR, SM_RECV_LENGTH_FID, ctx, rt
+        );
         assert(recvLength->data());
         //
-        synchronizers = new Item<Synchronizers>(regions[cid++], ctx, rt);
-        assert(synchronizers->data());
-        //
-        matdIdxToMatRowCol = new Array<rcpType>(regions[cid++], ctx, rt);
-        assert(matdIdxToMatRowCol->data());
-        //
         if (withGhosts(iFlags)) {
-            cid += mSetupGhostStructures(regions, cid, ctx, rt);
+            cid += mSetupGhostStructures(
+                regions, cid, pullBuffers, nidToPullRegion, ctx, rt
+            );
+        }
+        if (withBlockGhosts(iFlags)) {
+            cid += mSetupGhostStructures(
+                regions, cid, blockPullBuffers, nidToBlockPullRegion, ctx, rt
+            );
         }
         // Calculate number of region entries for this structure.
         mNRegionEntries = cid - baseRID;
     }
 
     /**
-     *
+     * Unpacks the pull buffers of intent into buffers, the ones this shard
+     * fills, and nidToRegion, those of its neighbors.
      */
     int
     mSetupGhostStructures(
         const std::vector<PhysicalRegion> &regions,
         size_t baseRID,
+        std::vector< Array<floatType> *> &buffers,
+        std::map<int, PhysicalRegion> &nidToRegion,
         Context ctx,
         HighLevelRuntime *runtime
     ) {
@@ -714,14 +1004,14 @@ protected:
         int cid = baseRID;
         // Setup my push Arrays.
         for (int n = 0; n < sclrsd->numberOfSendNeighbors; ++n) {
-            pullBuffers.push_back(
-                new Array<floatType>(regions[cid++], ctx, runtime)
+            buffers.push_back(
+                haloArena.make< Array<floatType> >(regions[cid++], ctx, runtime)
             );
         }
         // Get neighbor regions that I will pull from.
         for (int n = 0; n < sclrsd->numberOfRecvNeighbors; ++n) {
             const int nid = nd[n];
-            nidToPullRegion[nid] = regions[cid++];
+            nidToRegion[nid] = regions[cid++];
         }
         // Return number of regions that we have consumed.
         return cid - baseRID;
@@ -768,14 +1058,18 @@ PopulateGlobalToLocalMap(
 }
 
 /**
- *
+ * Sets up the ghosts of x and its HaloPlan, so that ExchangeHalo looks up
+ * no region and builds no requirement. A block vector of width > 1 right-hand
+ * sides, partitioned with the same width, pulls from the block pull buffers
+ * instead, see ExchangeBlockHalo.
  */
 inline void
 SetupGhostArrays(
     SparseMatrix &A,
     Array<floatType> &x,
     LegionRuntime::HighLevel::Context ctx,
-    LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    LegionRuntime::HighLevel::HighLevelRuntime *lrt,
+    int width = 1
 ) {
     // Make sure that we aren't doing this again for something that already has
     // the ghosts setup.
@@ -784,23 +1078,61 @@ SetupGhostArrays(
     const SparseMatrixScalars *const Asclrs = A.sclrs->data();
     assert(Asclrs);
     const int nNeighbors = Asclrs->numberOfSendNeighbors;
-
+    // Nothing to exchange.
+    if (nNeighbors == 0) return;
+    //
+    const int *const neighbors = A.neighbors->data();
+    assert(neighbors);
+    //
+    auto xis = x.logicalRegion.get_index_space();
+    auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
+    auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
+    // First is private.
+    x.halo.privateLR = lrt->get_logical_subregion_by_color(
+        ctx, xlp, DomainPoint::from_point<1>(0)
+    );
+    //
     for (int n = 0; n < nNeighbors; ++n) {
-        auto xis = x.logicalRegion.get_index_space();
-        auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
-        auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
         LogicalRegion xSubReg = lrt->get_logical_subregion_by_color(
             ctx,
             xlp,
-            DomainPoint::from_point<1>(n + 1) // First is private.
+            DomainPoint::from_point<1>(n + 1)
         );
         auto *dst = new LogicalArray<floatType>(xSubReg, ctx, lrt);
         dst->setParentLogicalRegion(x.logicalRegion);
         // Cache in x.
         x.ghosts.push_back(dst);
+        // Source: the pull buffer of neighbor n.
+        auto &nidToRegion =
+            width > 1 ? A.nidToBlockPullRegion : A.nidToPullRegion;
+        auto srcIt = nidToRegion.find(neighbors[n]);
+        assert(srcIt != nidToRegion.end());
+        auto srclr = srcIt->second.get_logical_region();
+        //
+        RegionRequirement srcrr(srclr, RO_E, srclr);
+        // Only ever one field for all of our structures.
+        static const int srcFid = 0;
+        srcrr.add_field(srcFid);
+        x.halo.srcReqs.push_back(srcrr);
+        //
+        RegionRequirement dstrr(xSubReg, WO_E, x.logicalRegion);
+        dstrr.add_field(dst->fid);
+        x.halo.dstReqs.push_back(dstrr);
     }
 }
 
+/**
+ * The subregion of x with its local entries, the first of the partition that
+ * SetupGhostArrays takes the ghosts from.
+ */
+inline LogicalRegion
+getPrivateLogicalRegion(
+    const Array<floatType> &x
+) {
+    assert(x.halo.privateLR != LogicalRegion::NO_REGION);
+    return x.halo.privateLR;
+}
+
 /*!
     Copy values from matrix diagonal into user-provided vector.
 
@@ -816,7 +1148,7 @@ CopyMatrixDiagonal(
     Context ctx,
     HighLevelRuntime *lrt
 ) {
-    const floatType *const curDiagA = A.matrixDiagonal->data();
+    const matrixFloatType *const curDiagA = A.matrixDiagonal->data();
     floatType *const dv = diagonal.data();
     //
     const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
@@ -847,7 +1179,7 @@ ReplaceMatrixDiagonal(
     //
     assert(nrow == local_int_t(diagonal.length()));
     //
-    floatType *const curDiagA = A.matrixDiagonal->data();
+    matrixFloatType *const curDiagA = A.matrixDiagonal->data();
     assert(curDiagA);
     //
     const rcpType *const mid2rc = A.matdIdxToMatRowCol->data();
@@ -855,11 +1187,16 @@ ReplaceMatrixDiagonal(
     //
     assert(A.matrixValues->data());
     // Interpreted as 2D array
-    Array2D<floatType> matrixValues(
+    Array2D<matrixFloatType> matrixValues(
         nrow, nnpr, A.matrixValues->data()
     );
     //
     const floatType *const dv = diagonal.data();
+    // Keep the SELL copy, if any, in step.
+    matrixFloatType *const sellValues =
+        A.sell ? A.sell->values->data() : nullptr;
+    const local_int_t *const sellChunkStart =
+        A.sell ? A.sell->chunkStart->data() : nullptr;
     //
     for (local_int_t i = 0; i < nrow; ++i) {
         curDiagA[i] = dv[i];
@@ -867,36 +1204,41 @@ ReplaceMatrixDiagonal(
         const local_int_t mrow = mid2rc[i].first;
         const local_int_t mcol = mid2rc[i].second;
         matrixValues(mrow, mcol) = dv[i];
+        if (sellValues) {
+            sellValues[SELLIndex(sellChunkStart, mrow, mcol)] = dv[i];
+        }
     }
 }
 
 /**
- * Matrix-dependent partitioning of a LegionArray.
+ * Matrix-dependent partitioning of a LegionArray, of width interleaved values
+ * per row or column for the block vectors, see BlockCG.hpp.
  */
 inline void
 Partition(
     SparseMatrix &A,
     LogicalArray<floatType> &x,
     Context ctx,
-    HighLevelRuntime *lrt
+    HighLevelRuntime *lrt,
+    int width = 1
 ) {
     const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
     const local_int_t ncol = A.sclrs->data()->localNumberOfColumns;
     // First nrow items are 'local data'. After is remote data.
     std::vector<local_int_t> partLens;
     // First partition for local data.
-    local_int_t totLen = nrow;
-    partLens.push_back(nrow);
+    local_int_t totLen = nrow * width;
+    partLens.push_back(nrow * width);
     // The rest are based on receive lengths.
     const int nNeighbors = A.sclrs->data()->numberOfRecvNeighbors;
     const local_int_t *const recvLength = A.recvLength->data();
     //
     for (int n = 0; n < nNeighbors; ++n) {
-        const local_int_t recvl = recvLength[n];
+        const local_int_t recvl = recvLength[n] * width;
         partLens.push_back(recvl);
         totLen += recvl;
     }
-    assert(totLen == ncol);
+    assert(totLen == ncol * width);
     //
     x.partition(partLens, ctx, lrt);
 }
@@ -0,0 +1,296 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file LegionSELLData.hpp
+
+    Sliced ELLPACK (SELL-C-sigma with sigma = 1) copy of a SparseMatrix, built
+    by OptimizeProblem. The rows, in their natural order, are cut into chunks
+    of LGNCG_SELL_C rows, and each chunk is stored column-major, padded to its
+    longest row: entry j of row i is at
+
+        chunkStart[i / C] + j * C + i % C
+
+    so one column of a chunk is C consecutive values, one per row, as a SIMD
+    SpMV loads them. Padding entries are zero and point at their own row. The
+    rows keep their numbering, so vectors and halos are not affected.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+
+#include <algorithm>
+
+/**
+ * Rows per chunk, the length of a vector of doubles with AVX-512.
+ */
+#define LGNCG_SELL_C 8
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct LogicalSELLData : public LogicalMultiBase {
+    // Chunk-column-major matrix values.
+    LogicalArray<matrixFloatType> values;
+    // Local column indices, laid out as values.
+    LogicalArray<mtx_ind_t> colInds;
+    // Offset of each chunk into values, and the total number stored last.
+    LogicalArray<local_int_t> chunkStart;
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {&values, &colInds, &chunkStart};
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalSELLData(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     * nChunks chunks holding nStored entries, padding included.
+     */
+    void
+    allocate(
+        const std::string &name,
+        local_int_t nChunks,
+        local_int_t nStored,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        values.allocate(    name + "-values",     nStored,     ctx, lrt);
+        colInds.allocate(   name + "-colInds",    nStored,     ctx, lrt);
+        chunkStart.allocate(name + "-chunkStart", nChunks + 1, ctx, lrt);
+    }
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct SELLData : public PhysicalMultiBase {
+    //
+    Array<matrixFloatType> *values = nullptr;
+    //
+    Array<mtx_ind_t> *colInds = nullptr;
+    //
+    Array<local_int_t> *chunkStart = nullptr;
+
+    /**
+     *
+     */
+    SELLData(void) = default;
+
+    /**
+     *
+     */
+    virtual
+    ~SELLData(void) {
+        delete values;
+        delete colInds;
+        delete chunkStart;
+    }
+
+    /**
+     *
+     */
+    SELLData(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, values->physicalRegion);
+        lrt->unmap_region(ctx, colInds->physicalRegion);
+        lrt->unmap_region(ctx, chunkStart->physicalRegion);
+    }
+
+    /**
+     * Bytes of the three arrays.
+     */
+    double
+    memoryUse(void) const {
+        return double(values->length()) * sizeof(matrixFloatType)
+             + double(colInds->length()) * sizeof(mtx_ind_t)
+             + double(chunkStart->length()) * sizeof(local_int_t);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        // Populate members from physical regions.
+        values = new Array<matrixFloatType>(regions[cid++], ctx, rt);
+        assert(values->data());
+        //
+        colInds = new Array<mtx_ind_t>(regions[cid++], ctx, rt);
+        assert(colInds->data());
+        //
+        chunkStart = new Array<local_int_t>(regions[cid++], ctx, rt);
+        assert(chunkStart->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
+
+/**
+ * Number of entries, padding included, of the SELL copy of a matrix with
+ * nrow rows of nonzerosInRow entries each.
+ */
+inline local_int_t
+SELLNumberStored(
+    const char *const nonzerosInRow,
+    local_int_t nrow
+) {
+    local_int_t nStored = 0;
+    for (local_int_t first = 0; first < nrow; first += LGNCG_SELL_C) {
+        int width = 0;
+        const local_int_t last = std::min(nrow, first + LGNCG_SELL_C);
+        for (local_int_t i = first; i < last; ++i) {
+            width = std::max(width, int(nonzerosInRow[i]));
+        }
+        nStored += local_int_t(width) * LGNCG_SELL_C;
+    }
+    return nStored;
+}
+
+/**
+ * Fills sell from the padded row-major matrixValues and mtxIndL, nnpr entries
+ * per row.
+ */
+inline void
+SELLPopulate(
+    const matrixFloatType *const matrixValues,
+    const mtx_ind_t *const mtxIndL,
+    const char *const nonzerosInRow,
+    local_int_t nrow,
+    int nnpr,
+    SELLData &sell
+) {
+    matrixFloatType *const vals = sell.values->data();
+    mtx_ind_t *const cols = sell.colInds->data();
+    local_int_t *const chunkStart = sell.chunkStart->data();
+    //
+    const local_int_t nChunks = sell.chunkStart->length() - 1;
+    local_int_t offset = 0;
+    for (local_int_t k = 0; k < nChunks; ++k) {
+        const local_int_t first = k * LGNCG_SELL_C;
+        const local_int_t last = std::min(nrow, first + LGNCG_SELL_C);
+        int width = 0;
+        for (local_int_t i = first; i < last; ++i) {
+            width = std::max(width, int(nonzerosInRow[i]));
+        }
+        chunkStart[k] = offset;
+        for (int j = 0; j < width; ++j) {
+            for (int r = 0; r < LGNCG_SELL_C; ++r) {
+                const local_int_t i = first + r;
+                const local_int_t e = offset + j * LGNCG_SELL_C + r;
+                if (i < last && j < nonzerosInRow[i]) {
+                    vals[e] = matrixValues[i * nnpr + j];
+                    // Both stored relative to row i, see MtxIndEncode.
+                    cols[e] = mtxIndL[i * nnpr + j];
+                }
+                else {
+                    // Rows past the last of the matrix point at its last
+                    // row, which is near them.
+                    vals[e] = 0.0;
+                    cols[e] = MtxIndEncode(i, i < last ? i : last - 1, nrow);
+                }
+            }
+        }
+        offset += local_int_t(width) * LGNCG_SELL_C;
+    }
+    chunkStart[nChunks] = offset;
+    assert(offset == local_int_t(sell.values->length()));
+}
+
+/**
+ * Index of entry j of row i in the arrays of sell.
+ */
+inline local_int_t
+SELLIndex(
+    const local_int_t *const chunkStart,
+    local_int_t i,
+    int j
+) {
+    return chunkStart[i / LGNCG_SELL_C] + j * LGNCG_SELL_C + i % LGNCG_SELL_C;
+}
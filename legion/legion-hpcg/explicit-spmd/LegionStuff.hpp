@@ -33,6 +33,9 @@
 
 #include "TaskTIDs.hpp"
 #include "Types.hpp"
+#include "HPCGMapper.hpp"
+#include "CUDAKernels.hpp"
+#include "mytimer.hpp"
 
 #include "legion.h"
 
@@ -60,6 +63,108 @@ using namespace LegionRuntime::HighLevel;
 // Let the RT know that we 'know what we are doing'
 static constexpr bool disableWarnings = true;
 
+/**
+ * Whether a leaf task was mapped to an OpenMP processor, in which case its
+ * kernel threads its loops over the processor's cores. Variants on LOC_PROC
+ * stay single-threaded: they share the node with the other shards.
+ */
+inline bool
+runsThreaded(const Task *task)
+{
+#ifdef LGNCG_OPENMP
+    return task->target_proc.kind() == Processor::OMP_PROC;
+#else
+    LGNCG_UNUSED(task);
+    return false;
+#endif
+}
+
+/**
+ * Whether a leaf task was mapped to a GPU, in which case its regions are in
+ * framebuffer memory and its kernel is the one of CUDAKernels.hpp.
+ */
+inline bool
+runsOnGPU(const Task *task)
+{
+#ifdef LGNCG_CUDA
+    return task->target_proc.kind() == Processor::TOC_PROC;
+#else
+    LGNCG_UNUSED(task);
+    return false;
+#endif
+}
+
+/**
+ * Waits for all the operations the calling task has launched so far, so that
+ * it can read what they wrote through its own mapped regions.
+ */
+inline void
+waitForLaunched(
+    Context ctx,
+    Runtime *lrt
+) {
+    lrt->issue_execution_fence(ctx).get_void_result();
+}
+
+/**
+ * Whether the kernels are timed running (--timekernels): the timers of CG,
+ * the halo exchanges and the V-cycles then wait for what they time, since
+ * launches only take the time to defer them. Shared by the shards of a
+ * process, which all have the same parameters.
+ */
+inline bool &
+kernelTimingEnabled(void)
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+/**
+ * Waits for the operations launched so far if the kernels are timed.
+ */
+inline void
+syncKernelTiming(
+    Context ctx,
+    Runtime *lrt
+) {
+    if (kernelTimingEnabled()) waitForLaunched(ctx, lrt);
+}
+
+/**
+ * Adds the seconds from its construction to its destruction to total if the
+ * kernels are timed, waiting for the operations launched before both.
+ */
+class KernelTimer {
+    double *mTotal = nullptr;
+    //
+    double mStart = 0.0;
+    //
+    Context mCtx;
+    //
+    Runtime *mRuntime;
+
+public:
+    KernelTimer(
+        double &total,
+        Context ctx,
+        Runtime *lrt
+    ) : mCtx(ctx)
+      , mRuntime(lrt)
+    {
+        if (!kernelTimingEnabled()) return;
+        waitForLaunched(ctx, lrt);
+        mTotal = &total;
+        mStart = mytimer();
+    }
+
+    ~KernelTimer(void)
+    {
+        if (!mTotal) return;
+        waitForLaunched(mCtx, mRuntime);
+        *mTotal += mytimer() - mStart;
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Task forward declarations.
 ////////////////////////////////////////////////////////////////////////////////
@@ -84,13 +189,6 @@ startBenchmarkTask(
     Context ctx, HighLevelRuntime *runtime
 );
 
-void
-regionToRegionCopyTask(
-    const Task *task,
-    const std::vector<PhysicalRegion> &regions,
-    Context ctx, HighLevelRuntime *runtime
-);
-
 void
 registerCollectiveOpsTasks(void);
 
@@ -115,15 +213,15 @@ registerProlongationTasks(void);
 void
 registerRestrictionTasks(void);
 
-void
-registerFutureMathTasks(void);
-
 void
 registerComputeResidualTasks(void);
 
 void
 registerExchangeHaloTasks(void);
 
+void
+registerSetupHaloTasks(void);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Task Registration
 ////////////////////////////////////////////////////////////////////////////////
@@ -144,23 +242,25 @@ registerTasks(void)
         TaskConfigOptions(false /* leaf task */),
         "genProblemTask"
     );
-    HighLevelRuntime::register_legion_task<startBenchmarkTask>(
-        START_BENCHMARK_TID /* task id */,
-        Processor::LOC_PROC /* proc kind  */,
+#ifdef LGNCG_OPENMP
+    HighLevelRuntime::register_legion_task<genProblemTask>(
+        GEN_PROB_TID /* task id */,
+        Processor::OMP_PROC /* proc kind  */,
         true /* single */,
         true /* index */,
         AUTO_GENERATE_ID,
         TaskConfigOptions(false /* leaf task */),
-        "startBenchmarkTask"
+        "genProblemTask"
     );
-    HighLevelRuntime::register_legion_task<regionToRegionCopyTask>(
-        REGION_TO_REGION_COPY_TID /* task id */,
+#endif
+    HighLevelRuntime::register_legion_task<startBenchmarkTask>(
+        START_BENCHMARK_TID /* task id */,
         Processor::LOC_PROC /* proc kind  */,
         true /* single */,
         true /* index */,
         AUTO_GENERATE_ID,
-        TaskConfigOptions(true /* leaf task */),
-        "regionToRegionCopyTask"
+        TaskConfigOptions(false /* leaf task */),
+        "startBenchmarkTask"
     );
     //
     registerCollectiveOpsTasks();
@@ -179,11 +279,11 @@ registerTasks(void)
     //
     registerRestrictionTasks();
     //
-    registerFutureMathTasks();
-    //
     registerComputeResidualTasks();
     //
     registerExchangeHaloTasks();
+    //
+    registerSetupHaloTasks();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,11 +293,11 @@ updateMappers(
     HighLevelRuntime *runtime,
     const std::set<Processor> &local_procs
 ) {
-#if 0 // Disable for now.
     for (const auto &p : local_procs) {
-        runtime->replace_default_mapper(new CGMapper(machine, runtime, p), p);
+        runtime->replace_default_mapper(
+            new HPCGMapper(runtime->get_mapper_runtime(), machine, p), p
+        );
     }
-#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -278,3 +378,22 @@ getNumProcs(void)
     }
     return nProc;
 }
+
+/**
+ * Number of CPUs in the address space of the calling task, the shards of a
+ * node when all nodes are alike.
+ */
+inline size_t
+getNumProcsPerNode(void)
+{
+    const AddressSpace local =
+        Processor::get_executing_processor().address_space();
+    size_t nProc = 0;
+    std::set<Processor> allProcs;
+    Realm::Machine::get_machine().get_all_processors(allProcs);
+    for (auto &p : allProcs) {
+        if (p.kind() == Processor::LOC_PROC &&
+            p.address_space() == local) nProc++;
+    }
+    return nProc;
+}
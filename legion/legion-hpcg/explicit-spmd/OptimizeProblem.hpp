@@ -69,6 +69,32 @@
 
     @param[inout] xexact The exact solution vector.
 
+    @param[in]    params The optimizations asked for on all levels:
+
+                         multicolorSYMGS: SYMGS uses the multicolor ordering,
+                         see ComputeSYMGSMulticolorKernel. Rows keep their
+                         numbering and only the sweeps visit them by color, so
+                         no data structure changes. The ordering usually needs
+                         a few more CG iterations to reach the reference
+                         residual, which the optimized phase must report.
+
+                         sellFormat: SpMV and SYMGS use a SELL copy of the
+                         matrix, see LegionSELLData.hpp. The copy is allocated
+                         and mapped here, and kept next to the original, which
+                         the rest of the code still reads.
+
+                         matrixFree: SpMV and SYMGS compute the interior rows
+                         from the 27-point stencil, see
+                         ComputeSPMVStencilKernel. It relies on the values
+                         GenerateProblem sets, so the run is not an official
+                         result. It takes precedence over sellFormat.
+
+                         agglomerateRows: the first coarse level of at most
+                         that many global rows, and the ones below it, are
+                         solved on the whole level by every shard, see
+                         AgglomeratedMG.hpp. Its SYMGS is a Gauss-Seidel on
+                         the whole level, which may change the iterations.
+
     @return returns 0 upon success and non-zero otherwise.
 
     @see GenerateGeometry
@@ -76,23 +102,91 @@
 */
 inline int
 OptimizeProblem(
-    SparseMatrix &,
+    SparseMatrix &A,
     CGData &,
     Array<floatType> &,
     Array<floatType> &,
-    Array<floatType> &
+    Array<floatType> &,
+    const HPCG_Params &params,
+    Context ctx,
+    Runtime *lrt
 ) {
     // This function can be used to completely transform any part of the data
-    // structures.  Right now it does nothing.
+    // structures.
+    const bool multicolorSYMGS = params.multicolorSYMGS;
+    const bool matrixFree = params.matrixFree;
+    const bool sellFormat = params.sellFormat && !matrixFree;
+    //
+    int level = 0;
+    bool agglomerated = false;
+    for (SparseMatrix *curLevelMatrix = &A; curLevelMatrix;
+         curLevelMatrix = curLevelMatrix->Ac, ++level) {
+        curLevelMatrix->multicolorSYMGS = multicolorSYMGS;
+        curLevelMatrix->matrixFree = matrixFree;
+        // The first level small enough holds the levels below it.
+        const global_int_t totalRows =
+            curLevelMatrix->sclrs->data()->totalNumberOfRows;
+        if (level > 0 && !agglomerated && params.agglomerateRows > 0 &&
+            totalRows <= params.agglomerateRows) {
+            int nLevels = 0;
+            for (SparseMatrix *l = curLevelMatrix; l; l = l->Ac) ++nLevels;
+            if (!curLevelMatrix->agglomerated) {
+                curLevelMatrix->agglomerated = new AgglomeratedMG(
+                    *curLevelMatrix->geom->data(), nLevels,
+                    params.preSmootherSteps, params.postSmootherSteps
+                );
+            }
+            agglomerated = true;
+        }
+        if (agglomerated) curLevelMatrix->inlineMG = true;
+        if (!sellFormat || curLevelMatrix->sell) continue;
+        //
+        const local_int_t nrow =
+            curLevelMatrix->sclrs->data()->localNumberOfRows;
+        const char *const nonzerosInRow =
+            curLevelMatrix->nonzerosInRow->data();
+        const local_int_t nChunks = (nrow + LGNCG_SELL_C - 1) / LGNCG_SELL_C;
+        const local_int_t nStored = SELLNumberStored(nonzerosInRow, nrow);
+        //
+        const std::string name = "A-L" + std::to_string(level) + "-sell";
+        auto *lSELL = new LogicalSELLData();
+        lSELL->allocate(name, nChunks, nStored, ctx, lrt);
+        //
+        std::vector<PhysicalRegion> sellRegions;
+        sellRegions.push_back(    lSELL->values.mapRegion(RW_E, ctx, lrt));
+        sellRegions.push_back(   lSELL->colInds.mapRegion(RW_E, ctx, lrt));
+        sellRegions.push_back(lSELL->chunkStart.mapRegion(RW_E, ctx, lrt));
+        //
+        curLevelMatrix->lSELL = lSELL;
+        curLevelMatrix->sell = new SELLData(sellRegions, 0, ctx, lrt);
+        SELLPopulate(
+            curLevelMatrix->matrixValues->data(),
+            curLevelMatrix->mtxIndL->data(),
+            nonzerosInRow,
+            nrow,
+            curLevelMatrix->geom->data()->stencilSize,
+            *curLevelMatrix->sell
+        );
+    }
+    A.isSpmvOptimized = sellFormat || matrixFree;
+    A.isMgOptimized = multicolorSYMGS || sellFormat || matrixFree ||
+                      agglomerated;
+    //
     return 0;
 }
 
 /**
- *
+ * Bytes of the SELL copies over all ranks, assuming every rank stores as much
+ * as this one.
  */
 inline double
 OptimizeProblemMemoryUse(
-    SparseMatrix &
+    SparseMatrix &A
 ) {
-    return 0.0;
+    double bytes = 0.0;
+    for (SparseMatrix *curLevelMatrix = &A; curLevelMatrix;
+         curLevelMatrix = curLevelMatrix->Ac) {
+        if (curLevelMatrix->sell) bytes += curLevelMatrix->sell->memoryUse();
+    }
+    return bytes * A.geom->data()->size;
 }
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file PersistentSolves.hpp
+
+    Many solves on one operator, as an application time stepping with HPCG's
+    matrix would run them: the matrices, halos, CG traces and mapped instances
+    of the benchmark stay alive and only the right-hand side changes between
+    solves. The first solve pays for what the runtime still sets up lazily,
+    e.g. the capture of traces, so the others give the steady-state time.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "mytimer.hpp"
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionCGData.hpp"
+#include "VectorOps.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "CG.hpp"
+
+#include <vector>
+
+/**
+ * The first solve and the steady state of the others.
+ */
+struct PersistentSolveTimes {
+    // Of the first solve (s).
+    double first = 0.0;
+    // Mean of the other solves (s).
+    double steady = 0.0;
+    // Fastest of the other solves (s).
+    double steadyMin = 0.0;
+};
+
+/**
+ *
+ */
+inline PersistentSolveTimes
+persistentSolveTimes(
+    const std::vector<double> &solveTimes
+) {
+    PersistentSolveTimes st;
+    if (solveTimes.empty()) return st;
+    //
+    st.first = solveTimes[0];
+    if (solveTimes.size() < 2) {
+        st.steady = st.steadyMin = st.first;
+        return st;
+    }
+    st.steadyMin = solveTimes[1];
+    for (size_t i = 1; i < solveTimes.size(); ++i) {
+        st.steady += solveTimes[i];
+        if (solveTimes[i] < st.steadyMin) st.steadyMin = solveTimes[i];
+    }
+    st.steady /= double(solveTimes.size() - 1);
+    return st;
+}
+
+/**
+ * Runs nSolves CG solves of maxIters iterations each, with no tolerance, on
+ * A as it is set up, from a zero x. Solve k has b + (k / nSolves) * xexact as
+ * its right-hand side, so each solve starts from new data and the first one
+ * is that of the benchmark. b is restored afterwards. Returns the time of each
+ * solve, the largest over the shards.
+ */
+inline std::vector<double>
+PersistentSolves(
+    SparseMatrix &A,
+    CGData &data,
+    Array<floatType> &b,
+    Array<floatType> &x,
+    Array<floatType> &xexact,
+    int nSolves,
+    int maxIters,
+    bool doMG,
+    Context ctx,
+    Runtime *lrt
+) {
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    // The original right-hand side, from which each solve's is made.
+    LogicalArray<floatType> origBl;
+    origBl.allocate("origB", nrow, ctx, lrt);
+    Array<floatType> origB(origBl.mapRegion(RW_E, ctx, lrt), ctx, lrt);
+    CopyVector(b, origB, ctx, lrt);
+    //
+    std::vector<double> solveTimes(nSolves, 0.0);
+    std::vector<double> times(9, 0.0);
+    for (int k = 0; k < nSolves; ++k) {
+        const floatType scale = floatType(k) / floatType(nSolves);
+        ComputeWAXPBY(nrow, 1.0, origB, scale, xexact, b, ctx, lrt);
+        ZeroVector(x, ctx, lrt);
+        //
+        int niters = 0;
+        floatType normr = 0.0, normr0 = 0.0;
+        const double tBegin = mytimer();
+        // With no tolerance CG waits for the residual after its last
+        // iteration, so the time is that of the whole solve.
+        CG(A, data, b, x, maxIters, 0.0, niters, normr, normr0,
+           &times[0], doMG, ctx, lrt);
+        const double t = mytimer() - tBegin;
+        // The solve is only as fast as its slowest shard.
+        Future tf = Future::from_value(lrt, t);
+        solveTimes[k] = allReduce(tf, *A.dcAllRedMaxFT, ctx, lrt)
+                        .get_result<floatType>(disableWarnings);
+    }
+    //
+    CopyVector(origB, b, ctx, lrt);
+    origBl.deallocate(ctx, lrt);
+    origBl.unmapRegion(ctx, lrt);
+    //
+    return solveTimes;
+}
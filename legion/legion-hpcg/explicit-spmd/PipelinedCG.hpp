@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file PipelinedCG.hpp
+
+    Pipelined preconditioned CG of P. Ghysels and W. Vanroose, "Hiding global
+    synchronization latency in the preconditioned Conjugate Gradient
+    algorithm", Parallel Computing 40 (2014). The dot products of an iteration
+    are all taken from the vectors at its start, so they go to one fused
+    collective (ComputeFusedDotProduct), and the preconditioner apply and SpMV
+    of the iteration run while it is reduced. Recurrences for A * p, M^-1 * A * p and A * M^-1 * A * p
+    stand in for the dependent SpMV and dot products of CG.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "mytimer.hpp"
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionCGData.hpp"
+#include "VectorOps.hpp"
+
+#include "ComputeSPMV.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "ComputeDotProduct.hpp"
+#include "ComputeMG.hpp"
+
+#include <cmath>
+
+// Use TICK and TOCK to time a code section in MATLAB-like fashion. With
+// --timekernels both wait for what was launched before, see syncKernelTiming.
+//!< record current time in 't0'
+#define TICK() \
+    do { syncKernelTiming(ctx, lrt); t0 = mytimer(); } while (0)
+//!< store time difference in 't' using time in 't0'
+#define TOCK(t) \
+    do { syncKernelTiming(ctx, lrt); t += mytimer() - t0; } while (0)
+
+/*!
+    Computes an approximate solution to Ax = b by pipelined CG. The arguments
+    are those of CG, with pdata holding the vectors of the recurrences.
+
+    niters and normr are those CG would report: the number of updates of x and
+    the 2-norm of the recurrence residual after the last one. The residual of
+    r_i is only known at iteration i + 1, so a converged run also computes the
+    preconditioner apply and SpMV of the one after its last update.
+
+    @return Returns zero on success and a non-zero value otherwise.
+
+    @see CG()
+*/
+inline int
+PipelinedCG(
+    SparseMatrix       &A,
+    CGData             &data,
+    PipelinedCGData    &pdata,
+    Array<floatType>   &b,
+    Array<floatType>   &x,
+    const int          maxIter,
+    const floatType    tolerance,
+    int                &niters,
+    floatType          &normr,
+    floatType          &normr0,
+    double             *times,
+    bool               doPreconditioning,
+    Context            ctx,
+    Runtime            *lrt
+) {
+    using namespace std;
+    // Start timing right away.
+    double t_begin = mytimer();
+    const double haloBegin = totalHaloTime(A);
+    //
+    const int print_freq = 10;
+    const int rank = A.geom->data()->rank;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    //
+    Future dotsFuture, normrFuture;
+    floatType gamma = 0.0, oldgamma = 0.0, delta = 0.0;
+    floatType alpha = 0.0, beta = 0.0;
+    double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
+    //
+    normr = 0.0;
+    niters = 0;
+    //
+    Array<floatType> &r  = *(data.r);  // Residual vector.
+    Array<floatType> &u  = *(data.z);  // M^-1 * r (ncol >= nrow).
+    Array<floatType> &m  = *(data.p);  // M^-1 * w (ncol >= nrow).
+    Array<floatType> &w  = *(data.Ap); // A * u.
+    Array<floatType> &n  = *(pdata.n); // A * m.
+    Array<floatType> &p  = *(pdata.p); // Direction vector.
+    Array<floatType> &s  = *(pdata.s); // A * p.
+    Array<floatType> &q  = *(pdata.q); // M^-1 * s.
+    Array<floatType> &Aq = *(pdata.Aq);// A * q.
+    //
+    Item< DynColl<floatType> > &dcarsFT = *A.dcAllRedSumFT;
+    Item< DynColl<FusedDots> > &dcarsFD = *A.dcAllRedSumFD;
+    // The pairs of the fused dot products: gamma, delta and normr^2.
+    Array<floatType> *const dotsX[] = {&r, &w, &r};
+    Array<floatType> *const dotsY[] = {&u, &u, &r};
+    //
+    if (!doPreconditioning && rank == 0) {
+        cout << "WARNING: PERFORMING UNPRECONDITIONED ITERATIONS" << endl;
+    }
+    // m is of length ncols, copy x to m for sparse MV operation
+    CopyVector(x, m, ctx, lrt);
+    //
+    TICK(); // w = A*x (x stored in m)
+    ComputeSPMV(A, m, w, ctx, lrt);
+    TOCK(t3);
+    //
+    TICK(); // r = b - Ax
+    ComputeWAXPBY(nrow, 1.0, b, -1.0, w, r, ctx, lrt);
+    TOCK(t2);
+    //
+    TICK();
+    ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
+    TOCK(t1);
+    //
+    TICK(); // u = M^-1 * r
+    if (doPreconditioning) {
+        ComputeMG(A, r, u, ctx, lrt);
+    }
+    else {
+        CopyVector(r, u, ctx, lrt);
+    }
+    TOCK(t5);
+    //
+    TICK(); // w = A * u
+    ComputeSPMV(A, u, w, ctx, lrt);
+    TOCK(t3);
+    //
+    normr = sqrt(normrFuture.get_result<floatType>(disableWarnings));
+    //
+    if (rank == 0) std::cout << "Initial Residual = "<< normr << std::endl;
+    // Record initial residual for convergence testing.
+    normr0 = normr;
+    // normr is that of the residual after the last update.
+    bool normrCurrent = true;
+    // Start iterations.
+    for (int k = 1; k <= maxIter; k++) {
+        // The residual of this iteration is known, so is whether it runs.
+        if (!(normr / normr0 > tolerance)) break;
+        //
+        TICK(); // gamma = r' * u, delta = w' * u, normr^2 = r' * r
+        ComputeFusedDotProduct(
+            nrow, 3, dotsX, dotsY, dotsFuture, t4, dcarsFD, ctx, lrt
+        );
+        TOCK(t1);
+        // While they are reduced.
+        TICK(); // m = M^-1 * w
+        if (doPreconditioning) {
+            ComputeMG(A, w, m, ctx, lrt);
+        }
+        else {
+            CopyVector(w, m, ctx, lrt);
+        }
+        TOCK(t5);
+        //
+        TICK(); // n = A * m
+        ComputeSPMV(A, m, n, ctx, lrt);
+        TOCK(t3);
+        //
+        TICK();
+        const FusedDots dots =
+            dotsFuture.get_result<FusedDots>(disableWarnings);
+        oldgamma = gamma;
+        gamma = dots[0];
+        delta = dots[1];
+        TOCK(t4);
+        // The residual of the vectors at the start of the iteration.
+        if (k > 1) {
+            normr = sqrt(dots[2]);
+            normrCurrent = true;
+            //
+            if (rank == 0 && (k - 1) % print_freq == 0) {
+                cout << "Iteration = "<< k - 1 << "   Scaled Residual = "
+                     << normr / normr0 << std::endl;
+            }
+            if (!(normr / normr0 > tolerance)) break;
+        }
+        //
+        TICK();
+        if (k == 1) {
+            beta = 0.0;
+            alpha = gamma / delta;
+            // Aq = n, q = m, s = w, p = u
+            ComputeWAXPBY(nrow, 1.0, n, 0.0, n, Aq, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, m, 0.0, m, q,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, w, 0.0, w, s,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, u, 0.0, u, p,  ctx, lrt);
+        }
+        else {
+            beta = gamma / oldgamma;
+            alpha = gamma / (delta - beta * gamma / alpha);
+            // Aq = n + beta * Aq, q = m + beta * q, s = w + beta * s,
+            // p = u + beta * p
+            ComputeWAXPBY(nrow, 1.0, n, beta, Aq, Aq, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, m, beta, q,  q,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, w, beta, s,  s,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, u, beta, p,  p,  ctx, lrt);
+        }
+        // x = x + alpha * p, r = r - alpha * s, u = u - alpha * q,
+        // w = w - alpha * Aq
+        ComputeWAXPBY(nrow, 1.0, x, alpha,  p,  x, ctx, lrt);
+        ComputeWAXPBY(nrow, 1.0, r, -alpha, s,  r, ctx, lrt);
+        ComputeWAXPBY(nrow, 1.0, u, -alpha, q,  u, ctx, lrt);
+        ComputeWAXPBY(nrow, 1.0, w, -alpha, Aq, w, ctx, lrt);
+        TOCK(t2);
+        //
+        normrCurrent = false;
+        niters = k;
+    }
+    // The residual after the last update, if the loop did not stop on it.
+    if (!normrCurrent) {
+        TICK();
+        ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
+        TOCK(t1);
+        normr = sqrt(normrFuture.get_result<floatType>(disableWarnings));
+    }
+    if (rank == 0 && niters > 0) {
+        cout << "Iteration = "<< niters << "   Scaled Residual = "
+             << normr / normr0 << std::endl;
+    }
+    // Store times.
+    times[1] += t1; // Dot product time.
+    times[2] += t2; // WAXPBY time.
+    times[3] += t3; // SPMV time.
+    times[4] += t4; // AllReduce time.
+    times[5] += t5; // Preconditioner apply time.
+    syncKernelTiming(ctx, lrt);
+    t6 = totalHaloTime(A) - haloBegin;
+    times[6] += t6; // Exchange halo time.
+    times[0] += mytimer() - t_begin;  // Total time. All done...
+    //
+    return 0;
+}
@@ -0,0 +1,350 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ProblemCache.hpp
+
+    Binary cache of the problems genProblemTask generates, for campaigns that
+    run the same problem size on the same number of shards many times. With
+    --cache=DIR each shard writes, after the setup it does in genProblemTask,
+    the regions the benchmark tasks read on all the levels to
+
+        DIR/hpcg-[SHARDS]-[NX]x[NY]x[NZ]-[SHARD].bin
+
+    and the top-level task then adds DIR/hpcg-[SHARDS]-[NX]x[NY]x[NZ].time with
+    the phase 1 time of the run, which marks the cache complete. Later runs of
+    the same size find it, map the files of their shards and copy them into
+    their regions instead of generating the problems, and report that phase 1
+    time, not the time the copy took. DIR must be the same path on all nodes.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LGNCG_CACHE_MAGIC "LGNCGPC1"
+
+/**
+ * Start of the file of a shard: what its problem depends on, and the bytes
+ * of the regions that follow.
+ */
+struct ProblemCacheHeader {
+    char magic[8];
+    int commSize;
+    int rank;
+    int numThreads;
+    int nx;
+    int ny;
+    int nz;
+    int stencilSize;
+    int nLevels;
+    // Of local_int_t, global_int_t, mtx_ind_t and matrixFloatType.
+    int typeSizes[4];
+    uint64_t nBytes;
+};
+
+/**
+ * The pieces of memory a cached problem is made of, in file order.
+ */
+using ProblemCacheSections = std::vector< std::pair<void *, size_t> >;
+
+/**
+ * Path of the file name ends with in the cache of params, see the @file.
+ */
+inline std::string
+ProblemCachePath(
+    const HPCG_Params &params,
+    const std::string &end
+) {
+    return std::string(params.problemCacheDir) + "/hpcg-"
+         + std::to_string(params.commSize) + "-"
+         + std::to_string(params.nx) + "x"
+         + std::to_string(params.ny) + "x"
+         + std::to_string(params.nz) + end;
+}
+
+/**
+ * Path of the file of shard rank.
+ */
+inline std::string
+ProblemCacheShardPath(
+    const HPCG_Params &params,
+    int rank
+) {
+    return ProblemCachePath(params, "-" + std::to_string(rank) + ".bin");
+}
+
+/**
+ * The header the file of shard rank must start with, nBytes aside.
+ */
+inline ProblemCacheHeader
+ProblemCacheMakeHeader(
+    const HPCG_Params &params,
+    int rank
+) {
+    ProblemCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LGNCG_CACHE_MAGIC, sizeof(h.magic));
+    h.commSize = params.commSize;
+    h.rank = rank;
+    h.numThreads = params.numThreads;
+    h.nx = params.nx;
+    h.ny = params.ny;
+    h.nz = params.nz;
+    h.stencilSize = params.stencilSize;
+    h.nLevels = params.mgLevels;
+    h.typeSizes[0] = sizeof(local_int_t);
+    h.typeSizes[1] = sizeof(global_int_t);
+    h.typeSizes[2] = sizeof(mtx_ind_t);
+    h.typeSizes[3] = sizeof(matrixFloatType);
+    return h;
+}
+
+/**
+ * Whether h is the header of shard rank for params, nBytes aside.
+ */
+inline bool
+ProblemCacheHeaderMatches(
+    const ProblemCacheHeader &h,
+    const HPCG_Params &params,
+    int rank
+) {
+    ProblemCacheHeader want = ProblemCacheMakeHeader(params, rank);
+    want.nBytes = h.nBytes;
+    return memcmp(&h, &want, sizeof(h)) == 0;
+}
+
+/**
+ *
+ */
+template <typename T>
+inline void
+ProblemCacheAdd(
+    Array<T> *a,
+    ProblemCacheSections &sections
+) {
+    assert(a && a->data());
+    sections.push_back({a->data(), a->length() * sizeof(T)});
+}
+
+/**
+ *
+ */
+template <typename T>
+inline void
+ProblemCacheAdd(
+    Item<T> *i,
+    ProblemCacheSections &sections
+) {
+    assert(i && i->data());
+    sections.push_back({i->data(), sizeof(T)});
+}
+
+/**
+ * The regions of all the levels of A the benchmark tasks read, and b, x and
+ * xexact. The global indices are not, genProblemTask makes their last use,
+ * nor are the collectives and synchronizers the top-level task sets up.
+ */
+inline ProblemCacheSections
+ProblemCacheGetSections(
+    SparseMatrix &A,
+    Array<floatType> &b,
+    Array<floatType> &x,
+    Array<floatType> &xexact
+) {
+    ProblemCacheSections sections;
+    for (SparseMatrix *Al = &A; Al; Al = Al->Ac) {
+        ProblemCacheAdd(Al->geom,               sections);
+        ProblemCacheAdd(Al->sclrs,              sections);
+        ProblemCacheAdd(Al->nonzerosInRow,      sections);
+        ProblemCacheAdd(Al->matrixDiagonal,     sections);
+        ProblemCacheAdd(Al->matdIdxToMatRowCol, sections);
+        ProblemCacheAdd(Al->mtxIndL,            sections);
+        ProblemCacheAdd(Al->matrixValues,       sections);
+        ProblemCacheAdd(Al->neighbors,          sections);
+        ProblemCacheAdd(Al->sendLength,         sections);
+        ProblemCacheAdd(Al->recvLength,         sections);
+    }
+    ProblemCacheAdd(&b,      sections);
+    ProblemCacheAdd(&x,      sections);
+    ProblemCacheAdd(&xexact, sections);
+    return sections;
+}
+
+/**
+ * Writes the problem of shard rank to its file, through a temporary file so
+ * that no run maps a partial one. Returns whether it did, a failure is only
+ * reported, as the run goes on without the cache.
+ */
+inline bool
+ProblemCacheWrite(
+    const HPCG_Params &params,
+    int rank,
+    const ProblemCacheSections &sections
+) {
+    const std::string path = ProblemCacheShardPath(params, rank);
+    const std::string tmp = path + ".tmp";
+    //
+    ProblemCacheHeader h = ProblemCacheMakeHeader(params, rank);
+    for (const auto &s : sections) h.nBytes += s.second;
+    //
+    FILE *f = fopen(tmp.c_str(), "wb");
+    bool ok = f && fwrite(&h, sizeof(h), 1, f) == 1;
+    for (const auto &s : sections) {
+        if (!ok) break;
+        ok = fwrite(s.first, 1, s.second, f) == s.second;
+    }
+    if (f && fclose(f) != 0) ok = false;
+    if (ok) ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        std::cerr << "*** Could not write problem cache " << path << std::endl;
+        unlink(tmp.c_str());
+    }
+    return ok;
+}
+
+/**
+ * Maps the file of shard rank and copies it into sections. The top-level
+ * task checked its header, see ProblemCacheFind, so any mismatch left is a
+ * cache changed under the run, and fatal: the other shards have not
+ * generated their problems either.
+ */
+inline void
+ProblemCacheRead(
+    const HPCG_Params &params,
+    int rank,
+    const ProblemCacheSections &sections
+) {
+    const std::string path = ProblemCacheShardPath(params, rank);
+    //
+    uint64_t nBytes = 0;
+    for (const auto &s : sections) nBytes += s.second;
+    const size_t fileBytes = sizeof(ProblemCacheHeader) + nBytes;
+    //
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) != fileBytes) {
+        std::cerr << "*** Problem cache " << path << " does not fit this run"
+                  << std::endl;
+        exit(1);
+    }
+    void *map = mmap(NULL, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "*** Could not map problem cache " << path << std::endl;
+        exit(1);
+    }
+    const char *p = (const char *)map;
+    const auto *h = (const ProblemCacheHeader *)p;
+    if (!ProblemCacheHeaderMatches(*h, params, rank) || h->nBytes != nBytes) {
+        std::cerr << "*** Problem cache " << path << " does not fit this run"
+                  << std::endl;
+        exit(1);
+    }
+    p += sizeof(ProblemCacheHeader);
+    for (const auto &s : sections) {
+        memcpy(s.first, p, s.second);
+        p += s.second;
+    }
+    munmap(map, fileBytes);
+}
+
+/**
+ * Whether the cache of params has a file of the right header for each shard.
+ */
+inline bool
+ProblemCacheHasShards(
+    const HPCG_Params &params
+) {
+    for (int rank = 0; rank < params.commSize; ++rank) {
+        FILE *f = fopen(ProblemCacheShardPath(params, rank).c_str(), "rb");
+        if (!f) return false;
+        ProblemCacheHeader h;
+        const bool read = fread(&h, sizeof(h), 1, f) == 1;
+        fclose(f);
+        if (!read || !ProblemCacheHeaderMatches(h, params, rank)) return false;
+    }
+    return true;
+}
+
+/**
+ * Whether the cache of params is complete: it has the files of all the
+ * shards and the phase 1 time of the run that wrote them, returned in
+ * phase1InitTime.
+ */
+inline bool
+ProblemCacheFind(
+    const HPCG_Params &params,
+    double &phase1InitTime
+) {
+    FILE *f = fopen(ProblemCachePath(params, ".time").c_str(), "r");
+    if (!f) return false;
+    const bool timed = fscanf(f, "%lf", &phase1InitTime) == 1;
+    fclose(f);
+    //
+    return timed && ProblemCacheHasShards(params);
+}
+
+/**
+ * Completes the cache the shards wrote with their problems, if they all did,
+ * by writing the phase 1 time of this run to it.
+ */
+inline void
+ProblemCacheFinish(
+    const HPCG_Params &params,
+    double phase1InitTime
+) {
+    if (!ProblemCacheHasShards(params)) return;
+    //
+    const std::string path = ProblemCachePath(params, ".time");
+    FILE *f = fopen(path.c_str(), "w");
+    bool ok = f && fprintf(f, "%.17g\n", phase1InitTime) > 0;
+    if (f && fclose(f) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "*** Could not write problem cache " << path << std::endl;
+        return;
+    }
+    std::cout << "--> Problem cache written to "
+              << params.problemCacheDir << std::endl;
+}
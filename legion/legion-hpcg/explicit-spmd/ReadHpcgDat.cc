@@ -39,7 +39,7 @@ SkipUntilEol(FILE *stream) {
 }
 
 int
-ReadHpcgDat(int *localDimensions, int *secondsPerRun) {
+ReadHpcgDat(int *localDimensions, int *secondsPerRun, int *mgParams) {
   FILE * hpcgStream = fopen("hpcg.dat", "r");
 
   if (! hpcgStream)
@@ -60,6 +60,15 @@ ReadHpcgDat(int *localDimensions, int *secondsPerRun) {
 		  secondsPerRun[0] = 30 * 60; // 30 minutes
   }
 
+  // The optional fourth line: MG levels, pre- and post-smoother steps, left
+  // as they are if not there
+  if (mgParams!=0) {
+    SkipUntilEol( hpcgStream ); // skip the rest of the third line
+    int mg[3];
+    if (fscanf(hpcgStream, "%d %d %d", mg, mg+1, mg+2) == 3)
+      for (int i = 0; i < 3; ++i) mgParams[i] = mg[i];
+  }
+
   fclose(hpcgStream);
 
   return 0;
@@ -15,6 +15,6 @@
 #ifndef READHPCGDAT_HPP
 #define READHPCGDAT_HPP
 
-int ReadHpcgDat(int *localDimensions, int *secondsPerRun);
+int ReadHpcgDat(int *localDimensions, int *secondsPerRun, int *mgParams = 0);
 
 #endif // READHPCGDAT_HPP
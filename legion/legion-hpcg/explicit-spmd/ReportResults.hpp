@@ -75,6 +75,10 @@
     @param[in] times  Vector of cumulative timings for each of the phases of a
                       preconditioned CG iteration.
 
+    @param[in] pipelinedTimes The timings of one set of refMaxIters pipelined
+                              CG iterations, laid out as times, or NULL if
+                              PipelinedCG was not run.
+
     @param[in] testcg_data    The data structure with the results of the
                               CG-correctness test including pass/fail
                               information.
@@ -98,6 +102,7 @@ ReportResults(
     int refMaxIters,
     int optMaxIters,
     double times[],
+    const double *pipelinedTimes,
     const TestCGData &testcg_data,
     const TestSymmetryData &testsymmetry_data,
     const TestNormsData &testnorms_data,
@@ -116,10 +121,20 @@ ReportResults(
     double t4max = 0.0;
     double t4avg = 0.0;
     //
-    t4min = allReduce(t4, *A.dcAllRedMinFT, ctx, lrt);
-    t4max = allReduce(t4, *A.dcAllRedMaxFT, ctx, lrt);
-    t4avg = allReduce(t4, *A.dcAllRedSumFT, ctx, lrt);
+    Future t4f = Future::from_value(lrt, t4);
+    t4min = allReduce(t4f, *A.dcAllRedMinFT, ctx, lrt)
+            .get_result<floatType>(disableWarnings);
+    t4max = allReduce(t4f, *A.dcAllRedMaxFT, ctx, lrt)
+            .get_result<floatType>(disableWarnings);
+    t4avg = allReduce(t4f, *A.dcAllRedSumFT, ctx, lrt)
+            .get_result<floatType>(disableWarnings);
     t4avg = t4avg / ((double)Ageom->size);
+    // The times above are those of launching the allReduce calls, which do
+    // not wait for their results. This is the round trip of one.
+    const double allReduceTime = allReduceLatency(
+        *A.dcAllRedSumFT, 10, ctx, lrt
+    );
+    const bool allReduceHierarchical = A.dcAllRedSumFT->data()->hierarchical;
 
     // initialize YAML doc
 
@@ -163,7 +178,7 @@ ReportResults(
         double fnwrites_ddot = (3.0 * fniters + fNumberOfCgSets) * sizeof(double); // 3 ddots with 1 write
         double fnreads_waxpby = (3.0 * fniters + fNumberOfCgSets) * 2.0 * fnrow * sizeof(double); // 3 WAXPBYs with nrow adds and nrow mults
         double fnwrites_waxpby = (3.0 * fniters + fNumberOfCgSets) * fnrow * sizeof(double); // 3 WAXPBYs with nrow adds and nrow mults
-        double fnreads_sparsemv = (fniters + fNumberOfCgSets) * (fnnz * (sizeof(double) + sizeof(local_int_t)) + fnrow * sizeof(double)); // 1 SpMV with nnz reads of values, nnz reads indices,
+        double fnreads_sparsemv = (fniters + fNumberOfCgSets) * (fnnz * (sizeof(double) + sizeof(mtx_ind_t)) + fnrow * sizeof(double)); // 1 SpMV with nnz reads of values, nnz reads indices,
         // plus nrow reads of x
         double fnwrites_sparsemv = (fniters + fNumberOfCgSets) * fnrow * sizeof(double); // 1 SpMV nrow writes
         // Op counts from the multigrid preconditioners
@@ -176,18 +191,18 @@ ReportResults(
             double fnrow_Af = Afsclrs->totalNumberOfRows;
             double fnumberOfPresmootherSteps = Af->mgData->numberOfPresmootherSteps;
             double fnumberOfPostsmootherSteps = Af->mgData->numberOfPostsmootherSteps;
-            fnreads_precond += fnumberOfPresmootherSteps * fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double)); // number of presmoother reads
+            fnreads_precond += fnumberOfPresmootherSteps * fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(mtx_ind_t)) + fnrow_Af * sizeof(double)); // number of presmoother reads
             fnwrites_precond += fnumberOfPresmootherSteps * fniters * fnrow_Af * sizeof(double); // number of presmoother writes
-            fnreads_precond += fniters * (fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double)); // Number of reads for fine grid residual calculation
+            fnreads_precond += fniters * (fnnz_Af * (sizeof(double) + sizeof(mtx_ind_t)) + fnrow_Af * sizeof(double)); // Number of reads for fine grid residual calculation
             fnwrites_precond += fniters * fnnz_Af * sizeof(double); // Number of writes for fine grid residual calculation
-            fnreads_precond += fnumberOfPostsmootherSteps * fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double)); // number of postsmoother reads
+            fnreads_precond += fnumberOfPostsmootherSteps * fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(mtx_ind_t)) + fnrow_Af * sizeof(double)); // number of postsmoother reads
             fnwrites_precond += fnumberOfPostsmootherSteps * fniters * fnnz_Af * sizeof(double); // number of postsmoother writes
             Af = Af->Ac; // Go to next coarse level
         }
 
         double fnnz_Af = Af->sclrs->data()->totalNumberOfNonzeros;
         double fnrow_Af = Af->sclrs->data()->totalNumberOfRows;
-        fnreads_precond += fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double));; // One symmetric GS sweep at the coarsest level
+        fnreads_precond += fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(mtx_ind_t)) + fnrow_Af * sizeof(double));; // One symmetric GS sweep at the coarsest level
         fnwrites_precond += fniters * fnrow_Af * sizeof(double); // One symmetric GS sweep at the coarsest level
         double fnreads = fnreads_ddot + fnreads_waxpby + fnreads_sparsemv + fnreads_precond;
         double fnwrites = fnwrites_ddot + fnwrites_waxpby + fnwrites_sparsemv + fnwrites_precond;
@@ -205,21 +220,24 @@ ReportResults(
         double fnbytes = ((double) sizeof(Geometry));      // Geometry struct in main.cpp
         fnbytes += ((double) sizeof(double) * fNumberOfCgSets); // testnorms_data in main.cpp
 
-        // Model for GenerateProblem_ref.cpp
+        // Model for GenerateProblem_ref.cpp, less mtxIndG and localToGlobalMap:
+        // they are returned after setup, see deallocateSetupData.
         fnbytes += fnrow * sizeof(char);    // array nonzerosInRow
-        fnbytes += fnrow * ((double) sizeof(global_int_t *)); // mtxIndG
         fnbytes += fnrow * ((double) sizeof(local_int_t *)); // mtxIndL
         fnbytes += fnrow * ((double) sizeof(double *));   // matrixValues
         fnbytes += fnrow * ((double) sizeof(double *));   // matrixDiagonal
-        fnbytes += fnrow * numberOfNonzerosPerRow * ((double) sizeof(local_int_t)); // mtxIndL[1..nrows]
-        fnbytes += fnrow * numberOfNonzerosPerRow * ((double) sizeof(double));   // matrixValues[1..nrows]
-        fnbytes += fnrow * numberOfNonzerosPerRow * ((double) sizeof(global_int_t)); // mtxIndG[1..nrows]
+        fnbytes += fnrow * numberOfNonzerosPerRow * ((double) sizeof(mtx_ind_t)); // mtxIndL[1..nrows]
+        fnbytes += fnrow * numberOfNonzerosPerRow * ((double) sizeof(matrixFloatType));   // matrixValues[1..nrows]
         fnbytes += fnrow * ((double) 3 * sizeof(double)); // x, b, xexact
 
         // Model for CGData.hpp
         double fncol = ((global_int_t) Asclrs->localNumberOfColumns) * size; // Estimate of the global number of columns using the value from rank 0
         fnbytes += fnrow * ((double) 2 * sizeof(double)); // r, Ap
         fnbytes += fncol * ((double) 2 * sizeof(double)); // z, p
+        // Model for PipelinedCGData.
+        if (pipelinedTimes) {
+            fnbytes += fnrow * ((double) 5 * sizeof(double)); // n, p, s, q, Aq
+        }
 
         std::vector<double> fnbytesPerLevel(numberOfMgLevels); // Count byte usage per level (level 0 is main CG level)
         fnbytesPerLevel[0] = fnbytes;
@@ -242,13 +260,11 @@ ReportResults(
 
             // Model for GenerateProblem.cpp (called within GenerateCoarseProblem.cpp)
             fnbytes_Af += fnrow_Af * sizeof(char);    // array nonzerosInRow
-            fnbytes_Af += fnrow_Af * ((double) sizeof(global_int_t *)); // mtxIndG
             fnbytes_Af += fnrow_Af * ((double) sizeof(local_int_t *)); // mtxIndL
             fnbytes_Af += fnrow_Af * ((double) sizeof(double *));   // matrixValues
             fnbytes_Af += fnrow_Af * ((double) sizeof(double *));   // matrixDiagonal
-            fnbytes_Af += fnrow_Af * numberOfNonzerosPerRow * ((double) sizeof(local_int_t)); // mtxIndL[1..nrows]
-            fnbytes_Af += fnrow_Af * numberOfNonzerosPerRow * ((double) sizeof(double));   // matrixValues[1..nrows]
-            fnbytes_Af += fnrow_Af * numberOfNonzerosPerRow * ((double) sizeof(global_int_t)); // mtxIndG[1..nrows]
+            fnbytes_Af += fnrow_Af * numberOfNonzerosPerRow * ((double) sizeof(mtx_ind_t)); // mtxIndL[1..nrows]
+            fnbytes_Af += fnrow_Af * numberOfNonzerosPerRow * ((double) sizeof(matrixFloatType));   // matrixValues[1..nrows]
 
             // Model for SetupHalo.hpp.
             //sendBuffer
@@ -368,6 +384,16 @@ ReportResults(
         doc.get("Iteration Count Information")->add("Optimized CG iterations per set", optMaxIters);
         doc.get("Iteration Count Information")->add("Total number of reference iterations", refMaxIters * numberOfCgSets);
         doc.get("Iteration Count Information")->add("Total number of optimized iterations", optMaxIters * numberOfCgSets);
+        if (A.multicolorSYMGS) {
+            doc.get("Iteration Count Information")->add("SYMGS ordering", "Multicolor (8 colors)");
+            doc.get("Iteration Count Information")->add("Iteration penalty per set", optMaxIters - refMaxIters);
+        }
+        if (A.matrixFree) {
+            doc.get("Iteration Count Information")->add("Matrix format", "Matrix-free 27-point stencil, not an official result");
+        }
+        else if (A.sell) {
+            doc.get("Iteration Count Information")->add("Matrix format", "SELL-8-1");
+        }
 
         doc.add("########## Reproducibility Summary  ##########", "");
         doc.add("Reproducibility Information", "");
@@ -417,6 +443,23 @@ ReportResults(
         double totalGflops24 = frefnops / (times[0] + fNumberOfCgSets * times[7] / 10.0) / 1.0E9;
         doc.get("GFLOP/s Summary")->add("Total with convergence and optimization phase overhead", totalGflops);
 
+        // A separate optimized solver, not part of the official rating. Its
+        // iterations are those of one reference set, so they are rated by the
+        // flops CG performs for them.
+        if (pipelinedTimes) {
+            double fnops_pcg = frefnops / fNumberOfCgSets;
+            doc.add("Pipelined CG Summary", "");
+            doc.get("Pipelined CG Summary")->add("Solver", "Pipelined CG (Ghysels-Vanroose), not an official result");
+            doc.get("Pipelined CG Summary")->add("Iterations", refMaxIters);
+            doc.get("Pipelined CG Summary")->add("DDOT", pipelinedTimes[1]);
+            doc.get("Pipelined CG Summary")->add("WAXPBY", pipelinedTimes[2]);
+            doc.get("Pipelined CG Summary")->add("SpMV", pipelinedTimes[3]);
+            doc.get("Pipelined CG Summary")->add("AllReduce", pipelinedTimes[4]);
+            doc.get("Pipelined CG Summary")->add("MG", pipelinedTimes[5]);
+            doc.get("Pipelined CG Summary")->add("Total", pipelinedTimes[0]);
+            doc.get("Pipelined CG Summary")->add("GFLOP/s rated by the CG model", fnops_pcg / pipelinedTimes[0] / 1.0E9);
+        }
+
         doc.add("User Optimization Overheads", "");
         doc.get("User Optimization Overheads")->add("Optimization phase time (sec)", (times[7]));
         doc.get("User Optimization Overheads")->add("Optimization phase time vs reference SpMV+MG time", times[7] / times[8]);
@@ -425,9 +468,22 @@ ReportResults(
         doc.get("DDOT Timing Variations")->add("Min DDOT MPI_Allreduce time", t4min);
         doc.get("DDOT Timing Variations")->add("Max DDOT MPI_Allreduce time", t4max);
         doc.get("DDOT Timing Variations")->add("Avg DDOT MPI_Allreduce time", t4avg);
+        doc.get("DDOT Timing Variations")->add("Allreduce latency (sec)", allReduceTime);
+        doc.get("DDOT Timing Variations")->add("Allreduce mode", allReduceHierarchical ? "two-level" : "flat");
+
+        doc.add("Sparse Operations Overheads", "");
+        doc.get("Sparse Operations Overheads")->add("Kernels timed running", kernelTimingEnabled() ? "yes" : "no, launches only");
+        doc.get("Sparse Operations Overheads")->add("Halo exchange time (sec)", (times[6]));
+        doc.get("Sparse Operations Overheads")->add("Halo exchange as percentage of SpMV time", (times[6])/times[3]*100.0);
+        doc.get("Sparse Operations Overheads")->add("AllReduce time (sec)", (times[4]));
 
-        //doc.get("Sparse Operations Overheads")->add("Halo exchange time (sec)", (times[6]));
-        //doc.get("Sparse Operations Overheads")->add("Halo exchange as percentage of SpMV time", (times[6])/totalSparseMVTime*100.0);
+        doc.add("Multigrid Level Times", "");
+        Af = &A;
+        for (int i = 0; i < numberOfMgLevels; ++i) {
+            const double below = Af->Ac ? Af->Ac->mgTime : 0.0;
+            doc.get("Multigrid Level Times")->add("Level " + std::to_string(i) + " (sec)", Af->mgTime - below);
+            Af = Af->Ac;
+        }
         doc.add("__________ Final Summary __________", "");
         bool isValidRun = (testcg_data.count_fail == 0) && (testsymmetry_data.count_fail == 0) && (testnorms_data.pass) && (!global_failure);
         if (isValidRun) {
@@ -450,7 +506,11 @@ ReportResults(
             if (!A.isWaxpbyOptimized) {
                 doc.get("__________ Final Summary __________")->add("Reference version of ComputeWAXPBY used", "Performance results are most likely suboptimal");
             }
-            if (times[0] >= minOfficialTime) {
+            if (A.matrixFree) {
+                // The stencil values are hard-wired, not read from the matrix.
+                doc.get("__________ Final Summary __________")->add("Matrix-free SpMV and SYMGS used", "Results are NOT official and may NOT be submitted.");
+            }
+            else if (times[0] >= minOfficialTime) {
                 doc.get("__________ Final Summary __________")->add("Please upload results from the YAML file contents to", "http://hpcg-benchmark.org");
             }
             else {
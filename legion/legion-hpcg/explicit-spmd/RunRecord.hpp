@@ -0,0 +1,268 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file RunRecord.hpp
+
+    The machine-readable record of a run, next to the YAML_Doc report and the
+    "--> " lines on stdout. With --record=FILE shard 0 writes one JSON object
+    to FILE at the end of the benchmark task: the configuration, the shard
+    grid, the CG times by kernel and the GFLOP/s the HPCG model rates them at,
+    the memory model and the overheads of the runtime. The scaling scripts
+    read it instead of the log; the keys are listed in README.md.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "Geometry.hpp"
+#include "LegionMatrices.hpp"
+#include "OptimizeProblem.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <type_traits>
+
+/**
+ * A JSON object written as it is built: members are added in order, objects
+ * and arrays nested with beginObject/beginArray and end. Members of an array
+ * take an empty key.
+ */
+class RunRecord {
+    std::ostringstream out;
+    // The open objects ('}') and arrays (']'), and whether each has a member.
+    std::vector<char> closers;
+    std::vector<bool> hasMember;
+
+    static std::string
+    quote(const std::string &s) {
+        std::string q = "\"";
+        for (const char c : s) {
+            if (c == '"' || c == '\\') {
+                q += '\\';
+                q += c;
+            }
+            else if ((unsigned char)c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                q += esc;
+            }
+            else q += c;
+        }
+        return q + "\"";
+    }
+
+    void
+    member(const std::string &key) {
+        if (hasMember.back()) out << ", ";
+        hasMember.back() = true;
+        if (closers.back() == '}') out << quote(key) << ": ";
+    }
+
+    void
+    open(const std::string &key, char opener, char closer) {
+        member(key);
+        out << opener;
+        closers.push_back(closer);
+        hasMember.push_back(false);
+    }
+
+public:
+    RunRecord(void) {
+        out << "{";
+        closers.push_back('}');
+        hasMember.push_back(false);
+    }
+
+    void
+    beginObject(const std::string &key) { open(key, '{', '}'); }
+
+    void
+    beginArray(const std::string &key) { open(key, '[', ']'); }
+
+    void
+    end(void) {
+        out << closers.back();
+        closers.pop_back();
+        hasMember.pop_back();
+    }
+
+    /**
+     * Not finite numbers, a time divided by a zero one, are null.
+     */
+    void
+    add(const std::string &key, double v) {
+        member(key);
+        if (!std::isfinite(v)) {
+            out << "null";
+            return;
+        }
+        char s[32];
+        snprintf(s, sizeof(s), "%.17g", v);
+        out << s;
+    }
+
+    template <typename T>
+    typename std::enable_if<
+        std::is_integral<T>::value && !std::is_same<T, bool>::value
+    >::type
+    add(const std::string &key, T v) {
+        member(key);
+        out << (long long)v;
+    }
+
+    void
+    add(const std::string &key, bool v) {
+        member(key);
+        out << (v ? "true" : "false");
+    }
+
+    void
+    add(const std::string &key, const std::string &v) {
+        member(key);
+        out << quote(v);
+    }
+
+    void
+    add(const std::string &key, const char *v) {
+        add(key, std::string(v));
+    }
+
+    /**
+     * The record, closing what is still open.
+     */
+    std::string
+    str(void) const {
+        std::string s = out.str();
+        for (size_t i = closers.size(); i > 0; --i) s += closers[i - 1];
+        return s;
+    }
+
+    /**
+     * Writes the record to path as one line, returns whether it could.
+     */
+    bool
+    write(const std::string &path) const {
+        std::ofstream f(path.c_str());
+        f << str() << std::endl;
+        return bool(f);
+    }
+};
+
+/**
+ * Floating-point operations of the CG kernels, the model of ReportResults.
+ */
+struct CGFlops {
+    double ddot = 0.0;
+    double waxpby = 0.0;
+    double spmv = 0.0;
+    double mg = 0.0;
+
+    double
+    total(void) const { return ddot + waxpby + spmv + mg; }
+};
+
+/**
+ * The flops of nSets CG sets of nIters iterations each on A, one extra of each
+ * kernel per set for the preamble.
+ */
+inline CGFlops
+cgFlops(
+    const SparseMatrix &A,
+    int numberOfMgLevels,
+    double nSets,
+    double nIters
+) {
+    const double fniters = nSets * nIters;
+    const double fnrow = A.sclrs->data()->totalNumberOfRows;
+    const double fnnz = A.sclrs->data()->totalNumberOfNonzeros;
+    //
+    CGFlops f;
+    f.ddot = (3.0 * fniters + nSets) * 2.0 * fnrow;
+    f.waxpby = (3.0 * fniters + nSets) * 2.0 * fnrow;
+    f.spmv = (fniters + nSets) * 2.0 * fnnz;
+    // Smoothing steps of 4 flops per nonzero, the residual 2, and one
+    // symmetric sweep on the coarsest level.
+    const SparseMatrix *Af = &A;
+    for (int i = 1; i < numberOfMgLevels; ++i) {
+        const double fnnzAf = Af->sclrs->data()->totalNumberOfNonzeros;
+        const double steps = Af->mgData->numberOfPresmootherSteps
+                           + Af->mgData->numberOfPostsmootherSteps;
+        f.mg += fniters * (4.0 * steps + 2.0) * fnnzAf;
+        Af = Af->Ac;
+    }
+    f.mg += fniters * 4.0 * Af->sclrs->data()->totalNumberOfNonzeros;
+    return f;
+}
+
+/**
+ * Bytes of the data of the run across the shards, the memory model of
+ * ReportResults estimated from shard 0's sizes, with the PipelinedCGData if
+ * pipelined and the OptimizeProblem data.
+ */
+inline double
+problemMemoryUse(
+    SparseMatrix &A,
+    int numberOfMgLevels,
+    bool pipelined
+) {
+    const double size = A.geom->data()->size;
+    const double perRowMatrix = sizeof(char) + sizeof(local_int_t *)
+                              + 2 * sizeof(double *)
+                              + HPCG_STENCIL * (double)(sizeof(mtx_ind_t)
+                                                + sizeof(matrixFloatType));
+    // The linear system, b, x and xexact, and CGData.
+    const auto *const Asclrs = A.sclrs->data();
+    const double fnrow = Asclrs->totalNumberOfRows;
+    const double fncol = Asclrs->localNumberOfColumns * size;
+    double bytes = sizeof(Geometry);
+    bytes += fnrow * (perRowMatrix + 5 * sizeof(double));
+    bytes += fncol * 2 * sizeof(double);
+    if (pipelined) bytes += fnrow * 5 * sizeof(double);
+    // The coarse levels: f2cOperator, rc, xc, Axf, their matrices and halos.
+    const SparseMatrix *Af = A.Ac;
+    for (int i = 1; i < numberOfMgLevels; ++i) {
+        const auto *const s = Af->sclrs->data();
+        const double fnrowAf = s->totalNumberOfRows;
+        const double fncolAf = s->localNumberOfColumns * size;
+        bytes += fnrowAf * (perRowMatrix + sizeof(local_int_t)
+                            + sizeof(double));
+        bytes += fncolAf * 2 * sizeof(double);
+        bytes += s->totalToBeSent * (double)(sizeof(double)
+                                             + sizeof(local_int_t));
+        bytes += s->numberOfSendNeighbors * (double)(sizeof(int)
+                                                     + sizeof(local_int_t));
+        Af = Af->Ac;
+    }
+    return bytes + OptimizeProblemMemoryUse(A);
+}
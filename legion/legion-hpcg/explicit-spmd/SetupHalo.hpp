@@ -48,11 +48,51 @@
 #include "LegionItems.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
+#include "HaloArena.hpp"
 
 #include <map>
 #include <set>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
+
+/**
+ * The global indices sent to or received from each neighbor while setting up
+ * the halo, and the local indices of the external ones, all in the nodes of a
+ * HaloArena that is released whole once they are used.
+ */
+typedef std::set<
+    global_int_t, std::less<global_int_t>, HaloArenaAllocator<global_int_t>
+> HaloIndexSet;
+//
+typedef std::map<
+    int, HaloIndexSet, std::less<int>,
+    HaloArenaAllocator< std::pair<const int, HaloIndexSet> >
+> HaloNeighborSets;
+//
+typedef std::map<
+    global_int_t, local_int_t, std::less<global_int_t>,
+    HaloArenaAllocator< std::pair<const global_int_t, local_int_t> >
+> HaloIndexMap;
+
+/**
+ * The set of rank in sets, added empty, from the arena of sets, if not there.
+ */
+inline HaloIndexSet &
+haloNeighborSet(
+    HaloNeighborSets &sets,
+    int rank
+) {
+    auto it = sets.find(rank);
+    if (it == sets.end()) {
+        HaloIndexSet empty(
+            std::less<global_int_t>(),
+            HaloArenaAllocator<global_int_t>(sets.get_allocator())
+        );
+        it = sets.emplace(rank, std::move(empty)).first;
+    }
+    return it->second;
+}
 
 inline void
 GetNeighborInfo(
@@ -75,10 +115,13 @@ GetNeighborInfo(
     //
     global_int_t *AlocalToGlobalMap = A.localToGlobalMap->data();
 
-    std::map< int, std::set< global_int_t> > sendList, receiveList;
-    typedef std::map< int, std::set< global_int_t> >::iterator map_iter;
-    typedef std::set<global_int_t>::iterator set_iter;
-    std::map< local_int_t, local_int_t > externalToLocalMap;
+    // Released on return.
+    HaloArena arena;
+    HaloArenaAllocator<int> alloc(arena);
+    HaloNeighborSets sendList(std::less<int>(), alloc);
+    HaloNeighborSets receiveList(std::less<int>(), alloc);
+    typedef HaloNeighborSets::iterator map_iter;
+    typedef HaloIndexSet::iterator set_iter;
 
     for (local_int_t i = 0; i < localNumberOfRows; i++) {
         global_int_t currentGlobalRow = AlocalToGlobalMap[i];
@@ -88,10 +131,14 @@ GetNeighborInfo(
             // If column index is not a row index, then it comes from another
             // processor
             if (Ageom->rank != rankIdOfColumnEntry) {
-                receiveList[rankIdOfColumnEntry].insert(curIndex);
+                haloNeighborSet(receiveList, rankIdOfColumnEntry).insert(
+                    curIndex
+                );
                 // Matrix symmetry means we know the neighbor process wants my
                 // value
-                sendList[rankIdOfColumnEntry].insert(currentGlobalRow);
+                haloNeighborSet(sendList, rankIdOfColumnEntry).insert(
+                    currentGlobalRow
+                );
             }
         }
     }
@@ -101,12 +148,14 @@ GetNeighborInfo(
          curNeighbor != sendList.end(); ++curNeighbor) {
         totalToBeSent += (curNeighbor->second).size();
     }
-    // Build the arrays and lists needed by the ExchangeHalo function.
-    local_int_t *elementsToSend = new local_int_t[totalToBeSent];
-    int *neighbors = new int[sendList.size()];
-    local_int_t *receiveLength = new local_int_t[receiveList.size()];
-    local_int_t *sendLength = new local_int_t[sendList.size()];
+    // Build the lists needed by the ExchangeHalo function, straight into the
+    // arrays of A: the elements to send are set by SetupHalo.
+    int *const neighbors = A.neighbors->data();
+    local_int_t *const receiveLength = A.recvLength->data();
+    local_int_t *const sendLength = A.sendLength->data();
     int neighborCount = 0;
+    // The remote columns are indexed at end of internals, each in the list of
+    // its one owner.
     local_int_t receiveEntryCount = 0;
     for (map_iter curNeighbor = receiveList.begin();
          curNeighbor != receiveList.end();
@@ -115,145 +164,92 @@ GetNeighborInfo(
         int neighborId = curNeighbor->first;
         // store rank ID of current neighbor
         neighbors[neighborCount] = neighborId;
-        receiveLength[neighborCount] = receiveList[neighborId].size();
+        receiveLength[neighborCount] = curNeighbor->second.size();
         // Get count of sends/receives
-        sendLength[neighborCount] = sendList[neighborId].size();
-        for (set_iter i = receiveList[neighborId].begin();
-             i != receiveList[neighborId].end();
-             ++i, ++receiveEntryCount) {
-            // The remote columns are indexed at end of internals
-            externalToLocalMap[*i] = localNumberOfRows + receiveEntryCount;
-        }
+        sendLength[neighborCount] = sendList.at(neighborId).size();
+        receiveEntryCount += receiveLength[neighborCount];
     }
     // Store contents in our matrix struct.
     Asclrs->numberOfRecvNeighbors = receiveList.size();
-    Asclrs->numberOfExternalValues = externalToLocalMap.size();
+    Asclrs->numberOfExternalValues = receiveEntryCount;
     //
     Asclrs->localNumberOfColumns = Asclrs->localNumberOfRows
                                    + Asclrs->numberOfExternalValues;
     //
     Asclrs->numberOfSendNeighbors = sendList.size();
     Asclrs->totalToBeSent = totalToBeSent;
-    //
-    for (int i = 0; i < Asclrs->numberOfSendNeighbors; ++i) {
-        A.neighbors->data()[i]  = neighbors[i];
-        A.sendLength->data()[i] = sendLength[i];
-        A.recvLength->data()[i] = receiveLength[i];
-    }
-    //
-    delete[] elementsToSend;
-    delete[] neighbors;
-    delete[] receiveLength;
-    delete[] sendLength;
 }
 
 /*!
-  Reference version of SetupHalo that prepares system matrix data structure and
-  creates data necessary for communication of boundary values of this process.
+  Converts the global column indices of A, mtxIndG, into the local ones the
+  kernels use, mtxIndL. Columns of this process become the index of their row,
+  the others are indexed after the local rows, grouped by neighbor in the order
+  of GetNeighborInfo and in increasing global index within a neighbor, and all
+  are stored by MtxIndEncode. This is the last use of mtxIndG and
+  localToGlobalMap, so it runs in the setup task: the benchmark tasks are
+  launched without them.
 
-  @param[inout] A    The known system matrix
+  @param[inout] A    The known system matrix, after GetNeighborInfo
 
-  @see ExchangeHalo
+  @see SetupHalo
 */
 inline void
-SetupHalo(
+SetupLocalColumnIndices(
     SparseMatrix &A,
     LegionRuntime::HighLevel::Context ctx,
     LegionRuntime::HighLevel::Runtime *lrt
-)
-{
+) {
     using namespace std;
     //
     PopulateGlobalToLocalMap(A, ctx, lrt);
     // Extract Matrix pieces
-    SparseMatrixScalars *Asclrs = A.sclrs->data();
-    Geometry *Ageom = A.geom->data();
+    const Geometry *const Ageom = A.geom->data();
     //
     const local_int_t numberOfNonzerosPerRow = Ageom->stencilSize;
     //
-    local_int_t localNumberOfRows = Asclrs->localNumberOfRows;
+    const local_int_t localNumberOfRows = A.sclrs->data()->localNumberOfRows;
     //
-    char *nonzerosInRow = A.nonzerosInRow->data();
+    const char *const nonzerosInRow = A.nonzerosInRow->data();
     // Interpreted as 2D array
     Array2D<global_int_t> mtxIndG(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndG->data()
     );
     // Interpreted as 2D array
-    Array2D<local_int_t> mtxIndL(
+    Array2D<mtx_ind_t> mtxIndL(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndL->data()
     );
-    //
-    global_int_t *AlocalToGlobalMap = A.localToGlobalMap->data();
 
-    std::map< int, std::set< global_int_t> > sendList, receiveList;
-    typedef std::map< int, std::set< global_int_t> >::iterator map_iter;
-    typedef std::set<global_int_t>::iterator set_iter;
-    std::map< local_int_t, local_int_t > externalToLocalMap;
+    // Released on return.
+    HaloArena arena;
+    HaloArenaAllocator<int> alloc(arena);
+    HaloNeighborSets receiveList(std::less<int>(), alloc);
+    typedef HaloNeighborSets::iterator map_iter;
+    typedef HaloIndexSet::iterator set_iter;
+    HaloIndexMap externalToLocalMap(std::less<global_int_t>(), alloc);
 
     for (local_int_t i = 0; i < localNumberOfRows; i++) {
-        global_int_t currentGlobalRow = AlocalToGlobalMap[i];
         for (int j = 0; j < nonzerosInRow[i]; j++) {
             global_int_t curIndex = mtxIndG(i, j);
             int rankIdOfColumnEntry = ComputeRankOfMatrixRow(*(Ageom), curIndex);
             // If column index is not a row index, then it comes from another
             // processor
             if (Ageom->rank != rankIdOfColumnEntry) {
-                receiveList[rankIdOfColumnEntry].insert(curIndex);
-                // Matrix symmetry means we know the neighbor process wants my
-                // value
-                sendList[rankIdOfColumnEntry].insert(currentGlobalRow);
+                haloNeighborSet(receiveList, rankIdOfColumnEntry).insert(
+                    curIndex
+                );
             }
         }
     }
-    // Count number of matrix entries to send and receive.
-    local_int_t totalToBeSent = 0;
-    for (map_iter curNeighbor = sendList.begin();
-         curNeighbor != sendList.end(); ++curNeighbor) {
-        totalToBeSent += (curNeighbor->second).size();
-    }
-    local_int_t totalToBeReceived = 0;
-    for (map_iter curNeighbor = receiveList.begin();
-         curNeighbor != receiveList.end(); ++curNeighbor) {
-        totalToBeReceived += (curNeighbor->second).size();
-    }
-    // Build the arrays and lists needed by the ExchangeHalo function.
-    A.lElementsToSend.allocate(
-        "elementsToSend", totalToBeSent, ctx, lrt
-    );
-    auto *AelementsToSend = new Array<local_int_t>(
-        A.lElementsToSend.mapRegion(RW_E, ctx, lrt), ctx, lrt
-    );
-    local_int_t *elementsToSend = AelementsToSend->data();
-    assert(elementsToSend);
     //
-    int *neighbors = new int[sendList.size()];
-    local_int_t *receiveLength = new local_int_t[receiveList.size()];
-    local_int_t *sendLength = new local_int_t[sendList.size()];
-    int neighborCount = 0;
     local_int_t receiveEntryCount = 0;
-    local_int_t sendEntryCount = 0;
     for (map_iter curNeighbor = receiveList.begin();
-         curNeighbor != receiveList.end();
-         ++curNeighbor, ++neighborCount) {
-        // rank of current neighbor we are processing
-        int neighborId = curNeighbor->first;
-        // store rank ID of current neighbor
-        neighbors[neighborCount] = neighborId;
-        receiveLength[neighborCount] = receiveList[neighborId].size();
-        // Get count of sends/receives
-        sendLength[neighborCount] = sendList[neighborId].size();
-        for (set_iter i = receiveList[neighborId].begin();
-             i != receiveList[neighborId].end();
+         curNeighbor != receiveList.end(); ++curNeighbor) {
+        for (set_iter i = curNeighbor->second.begin();
+             i != curNeighbor->second.end();
              ++i, ++receiveEntryCount) {
             // The remote columns are indexed at end of internals
             externalToLocalMap[*i] = localNumberOfRows + receiveEntryCount;
         }
-        for (set_iter i = sendList[neighborId].begin();
-             i != sendList[neighborId].end();
-             ++i, ++sendEntryCount) {
-            // Store local ids of entry to send.
-            elementsToSend[sendEntryCount] = A.globalToLocalMap[*i];
-        }
     }
     //
     for (local_int_t i = 0; i < localNumberOfRows; i++) {
@@ -262,16 +258,123 @@ SetupHalo(
             int rankIdOfColumnEntry = ComputeRankOfMatrixRow(*(Ageom), curIndex);
             // My column index, so convert to local index
             if (Ageom->rank == rankIdOfColumnEntry) {
-                mtxIndL(i, j) = A.globalToLocalMap[curIndex];
+                mtxIndL(i, j) = MtxIndEncode(
+                    i, A.globalToLocalMap[curIndex], localNumberOfRows
+                );
             }
             // If column index is not a row index, then it comes from another processor
             else {
-                mtxIndL(i, j) = externalToLocalMap[curIndex];
+                mtxIndL(i, j) = MtxIndEncode(
+                    i, externalToLocalMap[curIndex], localNumberOfRows
+                );
+            }
+        }
+    }
+    // Only needed here.
+    A.globalToLocalMap.clear();
+}
+
+/*!
+  Reference version of SetupHalo that prepares system matrix data structure and
+  creates data necessary for communication of boundary values of this process.
+
+  The local column indices are set by SetupLocalColumnIndices, so this works
+  from mtxIndL alone: the rows sent to a neighbor are the ones with a column in
+  that neighbor's range of externals. The matrix is symmetric, and local rows
+  are in the order of their global indices, so this is the same list in the
+  same order as the reference builds from the global indices.
+
+  @param[inout] A    The known system matrix
+
+  @see ExchangeHalo
+*/
+inline void
+SetupHalo(
+    SparseMatrix &A,
+    LegionRuntime::HighLevel::Context ctx,
+    LegionRuntime::HighLevel::Runtime *lrt
+)
+{
+    using namespace std;
+    // Extract Matrix pieces
+    SparseMatrixScalars *Asclrs = A.sclrs->data();
+    Geometry *Ageom = A.geom->data();
+    //
+    const local_int_t numberOfNonzerosPerRow = Ageom->stencilSize;
+    //
+    local_int_t localNumberOfRows = Asclrs->localNumberOfRows;
+    //
+    char *nonzerosInRow = A.nonzerosInRow->data();
+    // Interpreted as 2D array
+    Array2D<mtx_ind_t> mtxIndL(
+        localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndL->data()
+    );
+    //
+    const local_int_t *const recvLength = A.recvLength->data();
+    const local_int_t totalToBeSent = Asclrs->totalToBeSent;
+    // Build the arrays and lists needed by the ExchangeHalo function.
+    A.lElementsToSend.allocate(
+        "elementsToSend", totalToBeSent, ctx, lrt
+    );
+    auto *AelementsToSend = A.haloArena.make< Array<local_int_t> >(
+        A.lElementsToSend.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    local_int_t *elementsToSend = AelementsToSend->data();
+    assert(elementsToSend);
+    //
+    local_int_t sendEntryCount = 0;
+    local_int_t firstExternal = localNumberOfRows;
+    for (int n = 0; n < Asclrs->numberOfSendNeighbors; ++n) {
+        const local_int_t lastExternal = firstExternal + recvLength[n];
+        for (local_int_t i = 0; i < localNumberOfRows; i++) {
+            for (int j = 0; j < nonzerosInRow[i]; j++) {
+                const local_int_t curCol =
+                    MtxIndColumn(i, mtxIndL(i, j), localNumberOfRows);
+                if (curCol >= firstExternal && curCol < lastExternal) {
+                    // Store local ids of entry to send.
+                    elementsToSend[sendEntryCount++] = i;
+                    break;
+                }
             }
         }
+        firstExternal = lastExternal;
     }
+    assert(sendEntryCount == totalToBeSent);
     // Store contents in our matrix struct.
     A.elementsToSend = AelementsToSend;
+    // Rows off the faces shared with a neighbor read no external value, so
+    // ComputeSPMV can run them while the halo is in flight.
+    const local_int_t n[3] = {Ageom->nx, Ageom->ny, Ageom->nz};
+    const int ip[3] = {Ageom->ipx, Ageom->ipy, Ageom->ipz};
+    const int np[3] = {Ageom->npx, Ageom->npy, Ageom->npz};
+    GridBox interior;
+    bool interiorIsEmpty = false;
+    for (int d = 0; d < 3; ++d) {
+        interior.lo[d] = (ip[d] > 0) ? 1 : 0;
+        interior.hi[d] = n[d] - ((ip[d] < np[d] - 1) ? 1 : 0);
+        if (interior.hi[d] <= interior.lo[d]) interiorIsEmpty = true;
+    }
+    Asclrs->interior = interiorIsEmpty ? GridBox() : interior;
+#if 0 // Debug
+    {
+        const GridBox &b = Asclrs->interior;
+        for (local_int_t i = 0; i < localNumberOfRows; i++) {
+            const local_int_t ix = i % n[0];
+            const local_int_t iy = (i / n[0]) % n[1];
+            const local_int_t iz = i / (n[0] * n[1]);
+            const bool inside = ix >= b.lo[0] && ix < b.hi[0]
+                             && iy >= b.lo[1] && iy < b.hi[1]
+                             && iz >= b.lo[2] && iz < b.hi[2];
+            bool readsExternal = false;
+            for (int j = 0; j < nonzerosInRow[i]; j++) {
+                const local_int_t curCol =
+                    MtxIndColumn(i, mtxIndL(i, j), localNumberOfRows);
+                if (curCol >= localNumberOfRows) readsExternal = true;
+            }
+            assert(!(inside && readsExternal));
+        }
+    }
+#endif
 #if 0 // Debug
     {
         const int me = Ageom->rank;
@@ -294,16 +397,84 @@ SetupHalo(
         fclose(f);
     }
 #endif
+    // Not deleted here: stored in the sparse matrix, made from its arena.
+}
 
-    delete[] neighbors;
-    delete[] receiveLength;
-    delete[] sendLength;
-    // delete[] elementsToSend; Don't delete. Stored in sparse matrix.
+/**
+ * Number of shards next to shard ip, at offsets -1, 0 and 1, along a process
+ * grid dimension of np shards.
+ */
+inline int
+nNeighborOffsets(int ip, int np)
+{
+    return 1 + (ip > 0) + (ip < np - 1);
 }
 
+/**
+ * Rows of the block of PhaseBarriers around a shard, see
+ * SetupSynchronizersArgs.
+ */
+#define LGNCG_AROUND 3
+
 /**
  *
  */
+struct SetupSynchronizersArgs {
+    // The PhaseBarriers of the shard and of the shards next to it, entry
+    // ((dz + 1) * 3 + dy + 1) * 3 + dx + 1 for the one at offset (dx, dy, dz)
+    // in the process grid. Entries past the grid are not set.
+    PhaseBarriers around[LGNCG_AROUND * LGNCG_AROUND * LGNCG_AROUND];
+};
+
+/**
+ * Fills the Synchronizers of one shard from the PhaseBarriers around it: its
+ * own, and the ones of its neighbors in the order of its neighbor list.
+ */
+void
+SetupSynchronizersTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    const auto *const args = (SetupSynchronizersArgs *)task->args;
+    //
+    int rid = 0;
+    Item<Geometry> geom(regions[rid++], ctx, lrt);
+    Item<SparseMatrixScalars> sclrs(regions[rid++], ctx, lrt);
+    Array<int> neighbors(regions[rid++], ctx, lrt);
+    Item<Synchronizers> synchronizers(regions[rid++], ctx, lrt);
+    //
+    const Geometry &g = *geom.data();
+    const int nNeighbors = sclrs.data()->numberOfSendNeighbors;
+    // Every shard that touches this one, corners included, is a neighbor.
+    assert(nNeighbors == nNeighborOffsets(g.ipx, g.npx)
+                       * nNeighborOffsets(g.ipy, g.npy)
+                       * nNeighborOffsets(g.ipz, g.npz) - 1);
+    //
+    Synchronizers &mySync = *synchronizers.data();
+    // This one is mine.
+    mySync.mine = args->around[(LGNCG_AROUND + 1) * LGNCG_AROUND + 1];
+    // And the ones of my neighbors, where I pull from.
+    for (int n = 0; n < nNeighbors; ++n) {
+        const int tid = neighbors.data()[n];
+        const int dx = tid % g.npx - g.ipx;
+        const int dy = (tid / g.npx) % g.npy - g.ipy;
+        const int dz = tid / (g.npx * g.npy) - g.ipz;
+        assert(abs(dx) <= 1 && abs(dy) <= 1 && abs(dz) <= 1);
+        //
+        mySync.neighbors[n] = args->around[
+            ((dz + 1) * LGNCG_AROUND + dy + 1) * LGNCG_AROUND + dx + 1
+        ];
+    }
+}
+
+/**
+ * Sets up the PhaseBarriers of the halo exchanges of a level. They are
+ * created here, the top-level task being their parent, from the process grid
+ * alone: no region is mapped. Each shard then wires its own Synchronizers in
+ * a SetupSynchronizersTask, from its neighbor list.
+ */
 inline void
 SetupHaloTopLevel(
     LogicalSparseMatrix &A,
@@ -316,112 +487,79 @@ SetupHaloTopLevel(
     cout << "*** Setting Up Structures for SPMD Exchanges (Level "
          << level << ")" << endl;
     const double startTime = mytimer();
-    const int nShards = A.geom->size;
-    // Extract required info from logical structures.
-    cout << "--> Memory for SparseMatrixScalars="
-         << (sizeof(SparseMatrixScalars) * nShards) / 1024.0 / 1024.0
-         << " MB" << endl;
-    Array<SparseMatrixScalars> aSparseMatrixScalars(
-        A.sclrs.mapRegion(RW_E, ctx, lrt), ctx, lrt
-    );
-    SparseMatrixScalars *smScalars = aSparseMatrixScalars.data();
-    assert(smScalars);
-    //
-    const int maxNumNeighbors = A.geom->stencilSize - 1;
-    cout << "--> Memory for Neighbors="
-         << (sizeof(int) * nShards * maxNumNeighbors) / 1024.0 / 1024.0
-         << " MB" << endl;
-    //
-    Array<int> aNeighbors(
-        A.neighbors.mapRegion(RO_E, ctx, lrt), ctx, lrt
-    );
-    // For convenience we'll interpret this as a 2D array.
-    Array2D<int> neighbors(nShards, maxNumNeighbors, aNeighbors.data());
     //
-    cout << "--> Memory for Synchronizers="
-         << (sizeof(Synchronizers) * nShards) / 1024.0 / 1024.0
-         << " MB" << endl;
-    Array<Synchronizers> aSynchronizers(
-        A.synchronizers.mapRegion(RW_E, ctx, lrt), ctx, lrt
-    );
-    Synchronizers *synchronizers = aSynchronizers.data();
-    assert(synchronizers);
-    //
-    cout << "--> Memory for Send Lengths="
-         << (sizeof(local_int_t) * nShards * maxNumNeighbors) / 1024.0 / 1024.0
-         << " MB" << endl;
-    Array<local_int_t> aSendLengths(
-        A.sendLength.mapRegion(RO_E, ctx, lrt), ctx, lrt
-    );
-    Array2D<local_int_t> ASendLengths(
-        nShards, maxNumNeighbors, aSendLengths.data()
-    );
-    // Iterate over all shards and populate table that maps task IDs to their
-    // index into the neighbor list.
-    vector< map<int, int> > tidToNIdx(nShards);
+    const Geometry &g = *A.geom;
+    const int nShards = g.size;
+    // Create PhaseBarriers for all shards.
+    vector<PhaseBarriers> pbs(nShards);
     for (int shard = 0; shard < nShards; ++shard) {
-        // Get total number of neighbors this shard has
-        const SparseMatrixScalars &myScalars = smScalars[shard];
-        const int nNeighbors = myScalars.numberOfSendNeighbors;
-        //
-        for (int n = 0; n < nNeighbors; ++n) {
-            int tid = neighbors(shard, n);
-            tidToNIdx[shard][tid] = n;
-        }
-    }
-    // Iterate over all the shards and populate the synchronization structures.
-    for (int shard = 0; shard < nShards; ++shard) {
-        // Get total number of neighbors this shard has
-        const SparseMatrixScalars &myScalars = smScalars[shard];
-        const int nNeighbors = myScalars.numberOfSendNeighbors;
-#if 0 // Debug
-        cout << "Rank " << shard << " Has "
-             << nNeighbors << " Pull Neighbors: " << endl;
-        for (int n = 0; n < nNeighbors; ++n) {
-            cout << neighbors(shard, n) << " ";
-        }
-        cout << endl;
-#endif // Debug
-        // Create PhaseBarriers for shard.
-        PhaseBarriers pbs = {
+        const int nNeighbors = nNeighborOffsets(shard % g.npx, g.npx)
+                             * nNeighborOffsets((shard / g.npx) % g.npy, g.npy)
+                             * nNeighborOffsets(shard / (g.npx * g.npy), g.npz)
+                             - 1;
+        pbs[shard] = {
             // Means I am ready for neighboring tasks to PULL values.
             .ready = lrt->create_phase_barrier(ctx, 1),
             // Means All pulls are complete.
             .done  = lrt->create_phase_barrier(ctx, nNeighbors)
         };
-        //
-        Synchronizers &mySync = synchronizers[shard];
-        // This one is mine.
-        mySync.mine = pbs;
-        // Share mine with my all neighbors.
-        for (int n = 0; n < nNeighbors; ++n) {
-            // Get nth neighbor ID.
-            const int myn = neighbors(shard, n);
-            // Share my Synchronizers with that neighbor.
-            synchronizers[myn].neighbors[tidToNIdx[myn][shard]] = pbs;
-        }
     }
-#if 0 // Debug Synchronizers
+    // Hand each shard the ones around it.
+    vector<Future> futures;
+    futures.reserve(nShards);
     for (int shard = 0; shard < nShards; ++shard) {
-        const SparseMatrixScalars &myScalars = smScalars[shard];
-        const int nNeighbors = myScalars.numberOfSendNeighbors;
-        const Synchronizers &mySync = synchronizers[shard];
-        cout << "task=" << shard << " sync data: " << endl;
-        cout << "--------> mine.ready=" << mySync.mine.ready << endl;
-        cout << "--------> mine.done =" << mySync.mine.done << endl;
-        for (int n = 0; n < nNeighbors; ++n) {
-            cout << "--------> .ready=" << mySync.neighbors[n].ready << endl;
-            cout << "--------> .done =" << mySync.neighbors[n].done << endl;
+        const int ipx = shard % g.npx;
+        const int ipy = (shard / g.npx) % g.npy;
+        const int ipz = shard / (g.npx * g.npy);
+        //
+        SetupSynchronizersArgs args;
+        for (int dz = -1; dz <= 1; ++dz) {
+            if (ipz + dz < 0 || ipz + dz >= g.npz) continue;
+            for (int dy = -1; dy <= 1; ++dy) {
+                if (ipy + dy < 0 || ipy + dy >= g.npy) continue;
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (ipx + dx < 0 || ipx + dx >= g.npx) continue;
+                    const int tid = shard + dx + dy * g.npx
+                                  + dz * g.npx * g.npy;
+                    args.around[
+                        ((dz + 1) * LGNCG_AROUND + dy + 1) * LGNCG_AROUND
+                        + dx + 1
+                    ] = pbs[tid];
+                }
+            }
         }
+        //
+        TaskLauncher tl(
+            SETUP_SYNCHRONIZERS_TID,
+            TaskArgument(&args, sizeof(args))
+        );
+        A.geoms.intent(        RO_E, shard, tl, ctx, lrt);
+        A.sclrs.intent(        RO_E, shard, tl, ctx, lrt);
+        A.neighbors.intent(    RO_E, shard, tl, ctx, lrt);
+        A.synchronizers.intent(WO_E, shard, tl, ctx, lrt);
+        //
+        futures.push_back(lrt->execute_task(ctx, tl));
     }
-#endif
-    // Cleanup and reporting.
-    A.sclrs.unmapRegion(ctx, lrt);
-    A.neighbors.unmapRegion(ctx, lrt);
-    A.synchronizers.unmapRegion(ctx, lrt);
-    A.sendLength.unmapRegion(ctx, lrt);
+    for (auto &f : futures) f.wait();
     //
     const double initEnd = mytimer();
     const double initTime = initEnd - startTime;
     cout << "--> Time=" << initTime << " s" << endl;
 }
+
+/**
+ *
+ */
+inline void
+registerSetupHaloTasks(void)
+{
+    HighLevelRuntime::register_legion_task<SetupSynchronizersTask>(
+        SETUP_SYNCHRONIZERS_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "SetupSynchronizersTask"
+    );
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/**
+ * Streaming (non-temporal) stores for the vector kernels that write a whole
+ * vector which is not one of their inputs, WAXPBY, ZeroVector and CopyVector.
+ * A regular store first reads the line it writes into the cache (write
+ * allocate), a third of the traffic of WAXPBY and half of that of CopyVector;
+ * a streaming store writes the line to memory without reading it. That only
+ * pays once the vectors no longer fit in the last level cache, where the next
+ * kernel would have found the destination, so by default the kernels stream
+ * above that size (--ntstores=auto|on|off).
+ */
+
+#pragma once
+
+#include "Types.hpp"
+
+#include <cstdlib>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+// The kernels have a streaming path, stores of pairs of doubles.
+#define LGNCG_STREAMING_STORES
+#endif
+
+/**
+ * When the vector kernels stream their stores (--ntstores).
+ */
+enum StreamingStoresMode {
+    STREAMING_STORES_OFF = 0,
+    STREAMING_STORES_ON,
+    // When the vectors of a kernel are larger than the last level cache.
+    STREAMING_STORES_AUTO
+};
+
+/**
+ * The StreamingStoresMode of the process, set from the parameters as
+ * kernelTimingEnabled.
+ */
+inline int &
+streamingStoresMode(void)
+{
+    static int mode = STREAMING_STORES_AUTO;
+    return mode;
+}
+
+/**
+ * Bytes of the last level cache of the machine, 32 MiB if the C library does
+ * not know.
+ */
+inline size_t
+lastLevelCacheBytes(void)
+{
+    static const size_t bytes = [] {
+        long b = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        b = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (b <= 0) b = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return b > 0 ? size_t(b) : size_t(32) << 20;
+    }();
+    return bytes;
+}
+
+/**
+ * Whether a kernel whose vectors take bytes should stream its stores.
+ */
+inline bool
+useStreamingStores(
+    size_t bytes
+) {
+#ifdef LGNCG_STREAMING_STORES
+    switch (streamingStoresMode()) {
+        case STREAMING_STORES_OFF: return false;
+        case STREAMING_STORES_ON: return true;
+        default: return bytes > lastLevelCacheBytes();
+    }
+#else
+    LGNCG_UNUSED(bytes);
+    return false;
+#endif
+}
+
+#ifdef LGNCG_STREAMING_STORES
+/**
+ * Doubles per block of the streaming loop. Each block ends with an sfence, so
+ * the weakly ordered stores of a thread are all visible when the loop is done.
+ */
+#define LGNCG_STREAM_BLOCK 1024
+
+/**
+ * w[i] = scalar(i) for i < n with streaming stores: pair(i) returns the __m128d
+ * of w[i] and w[i + 1] for the 16 byte aligned w + i, scalar(i) the element
+ * before the first aligned pair and after the last. If ww is not NULL it is
+ * set to w'w, summed in the order of the elements within each block.
+ */
+template <typename Pair, typename Scalar>
+inline void
+streamVector(
+    floatType *const w,
+    const local_int_t n,
+    bool threaded,
+    Pair pair,
+    Scalar scalar,
+    floatType *ww = nullptr
+) {
+    // Elements before the first 16 byte boundary, at most one of doubles.
+    const local_int_t head = (uintptr_t(w) & 15) && n > 0 ? 1 : 0;
+    const local_int_t pairs = (n - head) / 2;
+    const local_int_t nblocks =
+        (2 * pairs + LGNCG_STREAM_BLOCK - 1) / LGNCG_STREAM_BLOCK;
+    floatType sum = 0.0;
+    //
+    if (head) {
+        w[0] = scalar(0);
+        sum += w[0] * w[0];
+    }
+    LGNCG_OMP_FOR(if(threaded) reduction(+:sum))
+    for (local_int_t b = 0; b < nblocks; ++b) {
+        const local_int_t lo = head + b * local_int_t(LGNCG_STREAM_BLOCK);
+        local_int_t hi = lo + LGNCG_STREAM_BLOCK;
+        if (hi > head + 2 * pairs) hi = head + 2 * pairs;
+        for (local_int_t i = lo; i < hi; i += 2) {
+            const __m128d v = pair(i);
+            _mm_stream_pd(w + i, v);
+            if (ww) {
+                const floatType v0 = _mm_cvtsd_f64(v);
+                const floatType v1 = _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+                sum += v0 * v0;
+                sum += v1 * v1;
+            }
+        }
+        _mm_sfence();
+    }
+    for (local_int_t i = head + 2 * pairs; i < n; ++i) {
+        w[i] = scalar(i);
+        sum += w[i] * w[i];
+    }
+    if (ww) *ww = sum;
+}
+#endif
@@ -38,23 +38,35 @@ enum {
     MAIN_TID = 0,
     GEN_PROB_TID,
     START_BENCHMARK_TID,
-    REGION_TO_REGION_COPY_TID,
+    SETUP_SYNCHRONIZERS_TID,
     DYN_COLL_TASK_CONTRIB_GIT_TID,
     DYN_COLL_TASK_CONTRIB_FT_TID,
+    DYN_COLL_TASK_CONTRIB_FD_TID,
+    DYN_COLL_TASK_CONTRIB_AV_TID,
+    DYN_COLL_TASK_CONTRIB_ES_TID,
+    EXACT_SUM_VALUE_TID,
     FLOAT_REDUCE_SUM_TID,
     FLOAT_REDUCE_MIN_TID,
     FLOAT_REDUCE_MAX_TID,
     INT_REDUCE_SUM_TID,
+    FUSED_DOTS_REDUCE_SUM_TID,
+    AGGLOMERATED_VECTOR_REDUCE_SUM_TID,
+    EXACT_SUM_REDUCE_SUM_TID,
     COPY_VECTOR_TID,
     ZERO_VECTOR_TID,
     FILLRAND_VECTOR_TID,
     WAXPBY_TID,
+    WAXPBY_DDOT_TID,
+    CG_UPDATE_TID,
     SPMV_TID,
+    SPMV_DDOT_TID,
     DDOT_TID,
+    FUSED_DDOT_TID,
     SYMGS_TID,
+    SYMGS_MULTICOLOR_TID,
     PROLONGATION_TID,
     RESTRICTION_TID,
-    FUTURE_MATH_TID,
+    RESTRICTION_FUSED_TID,
     COMPUTE_RESIDUAL_TID,
     EXCHANGE_HALO_TID
 };
@@ -53,6 +53,8 @@
 #include "LegionMatrices.hpp"
 #include "LegionCGData.hpp"
 #include "VectorOps.hpp"
+#include "CG.hpp"
+#include "PipelinedCG.hpp"
 
 #include "hpcg.hpp"
 
@@ -93,6 +95,12 @@ struct TestCGData {
     @param[out]   testcg_data the data structure with the results of the test
                   including pass/fail information.
 
+    @param[in]    pdata if not NULL, the pipelined CG vectors, and the test is
+                  of PipelinedCG instead of CG.
+
+    @param[in]    checkFreq the iterations between the residual checks of CG,
+                  see CG.
+
     @return Returns zero on success and a non-zero value otherwise.
 
     @see CG()
@@ -105,7 +113,9 @@ TestCG(
     Array<floatType> &x,
     TestCGData &testcg_data,
     Context ctx,
-    Runtime *lrt
+    Runtime *lrt,
+    PipelinedCGData *pdata = nullptr,
+    int checkFreq = 1
 ) {
     using namespace std;
     // Use this array for collecting timing information.
@@ -135,9 +145,9 @@ TestCG(
     // Modify the matrix diagonal to greatly exaggerate diagonal values.  CG
     // should converge in about 10 iterations for this problem, regardless of
     // problem size.
-    const global_int_t *const AlocalToGlobalMap = A.localToGlobalMap->data();
+    const Geometry *const Ageom = A.geom->data();
     for (local_int_t i = 0; i < nrow; ++i) {
-        global_int_t globalRowID = AlocalToGlobalMap[i];
+        global_int_t globalRowID = ComputeGlobalRow(*Ageom, i);
         if (globalRowID < 9) {
             floatType scale = (globalRowID + 2) * 1.0e6;
             ScaleVectorValue(exaggeratedDiagA, i, scale, ctx, lrt);
@@ -172,9 +182,19 @@ TestCG(
         if (k == 1) expected_niters = testcg_data.expected_niters_prec;
         for (int i = 0; i < numberOfCgCalls; ++i) {
             ZeroVector(x, ctx, lrt); // Zero out x
-            int ierr = CG(A, data, b, x, maxIters, tolerance, niters,
-                          normr, normr0, &times[0], k == 1, ctx, lrt
+            int ierr = 0;
+            if (pdata) {
+                ierr = PipelinedCG(A, data, *pdata, b, x, maxIters, tolerance,
+                                   niters, normr, normr0, &times[0], k == 1,
+                                   ctx, lrt
+                       );
+            }
+            else {
+                ierr = CG(A, data, b, x, maxIters, tolerance, niters,
+                          normr, normr0, &times[0], k == 1, ctx, lrt,
+                          checkFreq
                        );
+            }
             if (ierr) cerr << "Error in call to CG: " << ierr << ".\n" << endl;
             //
             if (niters <= expected_niters) {
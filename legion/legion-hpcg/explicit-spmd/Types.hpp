@@ -40,6 +40,18 @@ do {                                                                           \
     (void)(x);                                                                 \
 } while (0)
 
+/**
+ * Threads the loop that follows with OpenMP when built with LGNCG_OPENMP, e.g.
+ * LGNCG_OMP_FOR(if(threaded) reduction(+:sum)). Clauses must not contain
+ * commas.
+ */
+#ifdef LGNCG_OPENMP
+#define LGNCG_PRAGMA(x) _Pragma(#x)
+#define LGNCG_OMP_FOR(clauses) LGNCG_PRAGMA(omp parallel for clauses)
+#else
+#define LGNCG_OMP_FOR(clauses)
+#endif
+
 /**
  * Flags that influence how Item structures are treated.
  */
@@ -47,6 +59,10 @@ using ItemFlags = uint16_t;
 
 #define IFLAG_NIL      0x0000
 #define IFLAG_W_GHOSTS 0x0001
+// Leave out the matrix structures only setup uses, see LogicalSparseMatrix.
+#define IFLAG_WO_SETUP 0x0002
+// Also the pull buffers of the block halo exchanges, see ExchangeBlockHalo.
+#define IFLAG_W_BLOCK_GHOSTS 0x0004
 
 /**
  *
@@ -57,6 +73,29 @@ withGhosts(ItemFlags flags)
     return (flags & IFLAG_W_GHOSTS);
 }
 
+/**
+ *
+ */
+inline bool
+withSetupData(ItemFlags flags)
+{
+    return !(flags & IFLAG_WO_SETUP);
+}
+
+/**
+ *
+ */
+inline bool
+withBlockGhosts(ItemFlags flags)
+{
+    return (flags & IFLAG_W_BLOCK_GHOSTS);
+}
+
+/**
+ * Mapping tag of the region requirements of pull buffers, see HPCGMapper.
+ */
+#define LGNCG_PULL_BUFFER_TAG 1
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 struct PhaseBarriers {
@@ -71,13 +110,29 @@ struct PhaseBarriers {
  */
 using floatType = double;
 
+/**
+ * Floating point type the matrix values and diagonals are stored in, float
+ * when built with -DLGNCG_MIXED_PRECISION. Vectors, dot products and the
+ * residual stay floatType, so only the matrix traffic of SpMV, SYMGS and MG
+ * is halved.
+ */
+#ifdef LGNCG_MIXED_PRECISION
+using matrixFloatType = float;
+#else
+using matrixFloatType = floatType;
+#endif
+
 /*!
     This defines the type for integers that have local subdomain dimension.
 
-    Define as "long long" when local problem dimension is > 2^31
+    Defined as "long long" with LGNCG_LONG_LOCAL_INDEX, for local problem
+    dimensions > 2^31.
 */
+#ifdef LGNCG_LONG_LOCAL_INDEX
+typedef long long local_int_t;
+#else
 typedef int local_int_t;
-//typedef long long local_int_t;
+#endif
 
 /*!
     This defines the type for integers that have global dimension
@@ -92,3 +147,73 @@ typedef long long global_int_t;
 //#define HPCG_NO_LONG_LONG
 
 using rcpType = std::pair<local_int_t, local_int_t>;
+
+/**
+ * Functions the CUDA kernels share with the host.
+ */
+#ifdef __CUDACC__
+#define LGNCG_HOST_DEVICE __host__ __device__
+#else
+#define LGNCG_HOST_DEVICE
+#endif
+
+/**
+ * Type the column indices of the matrices, mtxIndL and the SELL colInds, are
+ * stored in. With LGNCG_LONG_LOCAL_INDEX they are 32-bit offsets from the row
+ * they are in, see MtxIndEncode, so SpMV and SYMGS read as many index bytes as
+ * with int local indices. Otherwise they are the columns themselves.
+ */
+#ifdef LGNCG_LONG_LOCAL_INDEX
+typedef int32_t mtx_ind_t;
+#else
+typedef local_int_t mtx_ind_t;
+#endif
+
+/**
+ * Offsets from the row are within +/- LGNCG_MTX_IND_SPAN, the 27-point stencil
+ * needs nx * ny + nx + 1. Halo columns, nrow and up, are stored below that, as
+ * INT32_MIN plus their index in the halo.
+ */
+#define LGNCG_MTX_IND_SPAN (local_int_t(1) << 30)
+
+/**
+ * Stored index of column col of row i of a matrix with nrow rows.
+ */
+inline mtx_ind_t
+MtxIndEncode(
+    local_int_t i,
+    local_int_t col,
+    local_int_t nrow
+) {
+#ifdef LGNCG_LONG_LOCAL_INDEX
+    if (col >= nrow) {
+        assert(col - nrow < LGNCG_MTX_IND_SPAN);
+        return mtx_ind_t(INT32_MIN + (col - nrow));
+    }
+    assert(col - i > -LGNCG_MTX_IND_SPAN && col - i < LGNCG_MTX_IND_SPAN);
+    return mtx_ind_t(col - i);
+#else
+    LGNCG_UNUSED(i);
+    LGNCG_UNUSED(nrow);
+    return col;
+#endif
+}
+
+/**
+ * Column of row i of a matrix with nrow rows stored as ind, see MtxIndEncode.
+ */
+inline LGNCG_HOST_DEVICE local_int_t
+MtxIndColumn(
+    local_int_t i,
+    mtx_ind_t ind,
+    local_int_t nrow
+) {
+#ifdef LGNCG_LONG_LOCAL_INDEX
+    return ind < -LGNCG_MTX_IND_SPAN ? nrow + (local_int_t(ind) - INT32_MIN)
+                                     : i + ind;
+#else
+    LGNCG_UNUSED(i);
+    LGNCG_UNUSED(nrow);
+    return ind;
+#endif
+}
@@ -51,6 +51,7 @@
 #include "hpcg.hpp"
 #include "LegionArrays.hpp"
 #include "Geometry.hpp"
+#include "StreamingStores.hpp"
 
 #include <cassert>
 #include <cstdlib>
@@ -58,7 +59,8 @@
 #include <fstream>
 
 /*!
-    Fill the input vector with zero values.
+    Fill the input vector with zero values, with streaming stores if
+    useStreamingStores says so.
 
     @param[inout] v - On entrance v is initialized, on exit all its values are
                       zero.
@@ -69,9 +71,32 @@ ZeroVectorKernel(
 ) {
     const local_int_t localLength = v.length();
     floatType *const vv = v.data();
+#ifdef LGNCG_STREAMING_STORES
+    if (useStreamingStores(localLength * sizeof(floatType))) {
+        streamVector(
+            vv, localLength, false,
+            [](local_int_t) { return _mm_setzero_pd(); },
+            [](local_int_t) { return floatType(0.0); }
+        );
+        return;
+    }
+#endif
     for (local_int_t i = 0; i < localLength; ++i) vv[i] = 0.0;
 }
 
+/**
+ * Marks the ghosts of v, just zeroed with the rest of v by ZeroVector or
+ * ZeroVectorKernel, as current, so that its next ExchangeHalo is skipped. All
+ * the shards must mark v at the same point, and v must not be written before
+ * that exchange.
+ */
+inline void
+markGhostsZero(
+    Array<floatType> &v
+) {
+    if (v.hasGhosts()) v.halo.ghostsZero = true;
+}
+
 /**
  *
  */
@@ -110,7 +135,8 @@ ZeroVectorTask(
 }
 
 /*!
-    Copy input vector to output vector.
+    Copy input vector to output vector, with streaming stores if they are not
+    the same and useStreamingStores says so.
 
     @param[in] v Input vector.
     @param[in] w Output vector.
@@ -125,6 +151,17 @@ CopyVectorKernel(
 
     const floatType *const vv = v.data();
     floatType *const wv = w.data();
+#ifdef LGNCG_STREAMING_STORES
+    if (vv != wv &&
+        useStreamingStores(2 * localLength * sizeof(floatType))) {
+        streamVector(
+            wv, localLength, false,
+            [vv](local_int_t i) { return _mm_loadu_pd(vv + i); },
+            [vv](local_int_t i) { return vv[i]; }
+        );
+        return;
+    }
+#endif
     //
     for (local_int_t i = 0; i < localLength; ++i) wv[i] = vv[i];
 }
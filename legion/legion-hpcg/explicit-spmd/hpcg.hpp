@@ -51,7 +51,12 @@
 #include <iostream>
 
 #define HPCG_STENCIL  27
+// Default number of MG levels, the first included (--mg=LEVELS).
 #define NUM_MG_LEVELS 4
+// Most right-hand sides of the block CG phase, see BlockCG.hpp.
+#define LGNCG_MAX_BLOCK 8
+// Most global rows of an agglomerated MG level, see AgglomeratedMG.hpp.
+#define LGNCG_MAX_AGGLOMERATED_ROWS 4096
 
 struct HPCG_Params {
     int commSize ; //!< Total number of shards.
@@ -62,7 +67,59 @@ struct HPCG_Params {
     //!< Number of seconds to run the timed portion of the benchmark.
     int runningTime;
     int stencilSize; //!< Size of the stencil
+    //!< MG levels, the first included (--mg=LEVELS or hpcg.dat).
+    int mgLevels;
+    //!< SYMGS sweeps before and after the coarse correction of each MG level
+    //!< (--presmooth=N, --postsmooth=N or hpcg.dat).
+    int preSmootherSteps;
+    int postSmootherSteps;
     double phase1InitTime;
+    //!< Also time the pipelined CG variant (--pcg).
+    int pipelinedCG;
+    //!< Use the multicolor SYMGS after the reference CG (--mc).
+    int multicolorSYMGS;
+    //!< Use a SELL copy of the matrix after the reference CG (--sell).
+    int sellFormat;
+    //!< Compute SpMV and SYMGS from the stencil, not official (--mf).
+    int matrixFree;
+    //!< Also time the CG vector kernels as index launches (--implicit).
+    int implicitMode;
+    //!< Run the MG levels of at most this many local rows in the shard task,
+    //!< 0 for none (--fmg=ROWS).
+    int fusedMGRows;
+    //!< Iterations between residual checks of the CG runs to a tolerance
+    //!< (--cgcheck=K).
+    int cgCheckFreq;
+    //!< Shards per group of the two-level allReduce, -1 for those of a node
+    //!< and 0 for one flat collective (--allreduce=node|SHARDS).
+    int allReduceGroupSize;
+    //!< Sum the dot products across shards exactly, so that they do not
+    //!< depend on the order of the arrivals (--repro).
+    int reproducibleReductions;
+    //!< Time the kernels running, waiting for each (--timekernels).
+    int timeKernels;
+    //!< When the vector kernels stream their stores, a StreamingStoresMode
+    //!< (--ntstores=auto|on|off).
+    int streamingStores;
+    //!< Read the ghosts from the neighbors in this process straight from their
+    //!< pull buffers where the kernels run in the shard (--directhalo).
+    int directHalo;
+    //!< Directory of the problem cache, empty for none (--cache=DIR).
+    char problemCacheDir[256];
+    //!< Set by the top-level task: the shards copy their problems from the
+    //!< cache instead of generating them, see ProblemCache.hpp.
+    int problemCacheLoad;
+    //!< File of the JSON record of the run, empty for none (--record=FILE).
+    char runRecordFile[256];
+    //!< Right-hand sides solved together by the block CG phase, 0 for none
+    //!< (--block=K).
+    int blockWidth;
+    //!< Solve the first coarse level of at most this many global rows, and
+    //!< those below, on every shard, 0 for none (--agglomerate=ROWS).
+    int agglomerateRows;
+    //!< Solves with a new right-hand side each on the set up problem after
+    //!< the other phases, 0 for none (--solves=N).
+    int persistentSolves;
 };
 
 /**
@@ -78,6 +135,26 @@ emit(const HPCG_Params &params) {
     cout << "nx: "          << params.nx << endl;
     cout << "ny: "          << params.ny << endl;
     cout << "nz: "          << params.nz << endl;
+    cout << "mgLevels: "    << params.mgLevels << endl;
+    cout << "preSmootherSteps: " << params.preSmootherSteps << endl;
+    cout << "postSmootherSteps: " << params.postSmootherSteps << endl;
+    cout << "pipelinedCG: " << params.pipelinedCG << endl;
+    cout << "multicolorSYMGS: " << params.multicolorSYMGS << endl;
+    cout << "sellFormat: " << params.sellFormat << endl;
+    cout << "matrixFree: " << params.matrixFree << endl;
+    cout << "implicitMode: " << params.implicitMode << endl;
+    cout << "fusedMGRows: " << params.fusedMGRows << endl;
+    cout << "cgCheckFreq: " << params.cgCheckFreq << endl;
+    cout << "allReduceGroupSize: " << params.allReduceGroupSize << endl;
+    cout << "reproducibleReductions: " << params.reproducibleReductions << endl;
+    cout << "timeKernels: " << params.timeKernels << endl;
+    cout << "streamingStores: " << params.streamingStores << endl;
+    cout << "directHalo: " << params.directHalo << endl;
+    cout << "problemCacheDir: " << params.problemCacheDir << endl;
+    cout << "runRecordFile: " << params.runRecordFile << endl;
+    cout << "blockWidth: " << params.blockWidth << endl;
+    cout << "agglomerateRows: " << params.agglomerateRows << endl;
+    cout << "persistentSolves: " << params.persistentSolves << endl;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -42,11 +42,17 @@
 
 #include <cstdio>
 #include <cstring>
+#include <cstdlib>
+
+#ifdef LGNCG_OPENMP
+#include <omp.h>
+#endif
 
 #include "hpcg.hpp"
 #include "ReadHpcgDat.hpp"
 
 #include "LegionStuff.hpp"
+#include "StreamingStores.hpp"
 
 static int
 startswith(
@@ -68,9 +74,150 @@ HPCG_Init(
     char cparams[4][6] = {"--nx=", "--ny=", "--nz=", "--rt="};
     // Initialize iparams
     for (int i = 0; i < 4; ++i) iparams[i] = 0;
+    params.pipelinedCG = 0;
+    params.multicolorSYMGS = 0;
+    params.sellFormat = 0;
+    params.matrixFree = 0;
+    params.implicitMode = 0;
+    params.fusedMGRows = 0;
+    params.cgCheckFreq = 1;
+    params.allReduceGroupSize = 0;
+    params.reproducibleReductions = 0;
+    params.timeKernels = 0;
+    params.streamingStores = STREAMING_STORES_AUTO;
+    params.directHalo = 0;
+    params.problemCacheDir[0] = '\0';
+    params.problemCacheLoad = 0;
+    params.runRecordFile[0] = '\0';
+    params.blockWidth = 0;
+    params.agglomerateRows = 0;
+    params.persistentSolves = 0;
+    // MG levels, pre- and post-smoother steps, -1 if not on the command line.
+    int mgParams[3] = {-1, -1, -1};
     // process any user-supplied arguments
     const InputArgs &cArgs = HighLevelRuntime::get_input_args();
     for (int i = 1; i < cArgs.argc; ++i) {
+        if (!strcmp(cArgs.argv[i], "--pcg")) {
+            params.pipelinedCG = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--mc")) {
+            params.multicolorSYMGS = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--sell")) {
+            params.sellFormat = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--mf")) {
+            params.matrixFree = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--timekernels")) {
+            params.timeKernels = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--directhalo")) {
+            params.directHalo = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--repro")) {
+            params.reproducibleReductions = 1;
+            continue;
+        }
+        if (!strcmp(cArgs.argv[i], "--implicit")) {
+            params.implicitMode = 1;
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--fmg=")) {
+            params.fusedMGRows = atoi(cArgs.argv[i] + strlen("--fmg="));
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--mg=")) {
+            mgParams[0] = atoi(cArgs.argv[i] + strlen("--mg="));
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--presmooth=")) {
+            mgParams[1] = atoi(cArgs.argv[i] + strlen("--presmooth="));
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--postsmooth=")) {
+            mgParams[2] = atoi(cArgs.argv[i] + strlen("--postsmooth="));
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--cgcheck=")) {
+            params.cgCheckFreq = atoi(cArgs.argv[i] + strlen("--cgcheck="));
+            if (params.cgCheckFreq < 1) params.cgCheckFreq = 1;
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--allreduce=")) {
+            const char *mode = cArgs.argv[i] + strlen("--allreduce=");
+            params.allReduceGroupSize = strcmp(mode, "node") ? atoi(mode) : -1;
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--ntstores=")) {
+            const char *mode = cArgs.argv[i] + strlen("--ntstores=");
+            if (!strcmp(mode, "auto")) {
+                params.streamingStores = STREAMING_STORES_AUTO;
+            }
+            else if (!strcmp(mode, "on")) {
+                params.streamingStores = STREAMING_STORES_ON;
+            }
+            else if (!strcmp(mode, "off")) {
+                params.streamingStores = STREAMING_STORES_OFF;
+            }
+            else {
+                fprintf(stderr, "--ntstores takes auto, on or off\n");
+                exit(1);
+            }
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--cache=")) {
+            const char *dir = cArgs.argv[i] + strlen("--cache=");
+            if (strlen(dir) >= sizeof(params.problemCacheDir)) {
+                fprintf(stderr, "--cache directory too long: %s\n", dir);
+                exit(1);
+            }
+            strcpy(params.problemCacheDir, dir);
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--block=")) {
+            params.blockWidth = atoi(cArgs.argv[i] + strlen("--block="));
+            if (params.blockWidth < 2 || params.blockWidth > LGNCG_MAX_BLOCK) {
+                fprintf(stderr, "--block takes 2 to %d right-hand sides\n",
+                        LGNCG_MAX_BLOCK);
+                exit(1);
+            }
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--solves=")) {
+            params.persistentSolves = atoi(cArgs.argv[i] + strlen("--solves="));
+            if (params.persistentSolves < 2) {
+                fprintf(stderr, "--solves takes at least 2 solves\n");
+                exit(1);
+            }
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--agglomerate=")) {
+            const char *rows = cArgs.argv[i] + strlen("--agglomerate=");
+            params.agglomerateRows = atoi(rows);
+            if (params.agglomerateRows < 1 ||
+                params.agglomerateRows > LGNCG_MAX_AGGLOMERATED_ROWS) {
+                fprintf(stderr, "--agglomerate takes 1 to %d rows\n",
+                        LGNCG_MAX_AGGLOMERATED_ROWS);
+                exit(1);
+            }
+            continue;
+        }
+        if (startswith(cArgs.argv[i], "--record=")) {
+            const char *file = cArgs.argv[i] + strlen("--record=");
+            if (strlen(file) >= sizeof(params.runRecordFile)) {
+                fprintf(stderr, "--record file name too long: %s\n", file);
+                exit(1);
+            }
+            strcpy(params.runRecordFile, file);
+            continue;
+        }
         for (int j = 0; j < 4; ++j) {
             if (startswith(cArgs.argv[i], cparams[j])) {
                 if (sscanf(cArgs.argv[i] + strlen(cparams[j]),
@@ -88,7 +235,12 @@ HPCG_Init(
     if (iparams[3]) rt = 0;
     // no geometry arguments on the command line
     if (!iparams[0] && !iparams[1] && !iparams[2]) {
-        ReadHpcgDat(iparams, rt);
+        // The command line takes precedence over its MG parameters too.
+        int datMGParams[3] = {NUM_MG_LEVELS, 1, 1};
+        ReadHpcgDat(iparams, rt, datMGParams);
+        for (int i = 0; i < 3; ++i) {
+            if (mgParams[i] < 0) mgParams[i] = datMGParams[i];
+        }
     }
     // Check for small or unspecified nx, ny, nz values If any dimension is less
     // than 16, make it the max over the other two dimensions, or 16, whichever
@@ -108,9 +260,33 @@ HPCG_Init(
     //
     params.runningTime = iparams[3];
     //
+    params.mgLevels = mgParams[0] < 0 ? NUM_MG_LEVELS : mgParams[0];
+    params.preSmootherSteps = mgParams[1] < 0 ? 1 : mgParams[1];
+    params.postSmootherSteps = mgParams[2] < 0 ? 1 : mgParams[2];
+    if (params.mgLevels < 1 || params.mgLevels > 16) {
+        fprintf(stderr, "--mg takes 1 to 16 levels\n");
+        exit(1);
+    }
+    if (params.preSmootherSteps < 0 || params.postSmootherSteps < 0) {
+        fprintf(stderr, "--presmooth and --postsmooth take 0 or more steps\n");
+        exit(1);
+    }
+    // Each coarse level halves the local dimensions of the one above.
+    const int coarsening = 1 << (params.mgLevels - 1);
+    if (params.nx % coarsening || params.ny % coarsening ||
+        params.nz % coarsening) {
+        fprintf(stderr, "--mg=%d needs nx, ny and nz divisible by %d\n",
+                params.mgLevels, coarsening);
+        exit(1);
+    }
+    //
     params.commSize = spmdMeta.nRanks;
     //
     params.numThreads = 1;
+#ifdef LGNCG_OPENMP
+    // Threads of a leaf task mapped to an OpenMP processor.
+    params.numThreads = omp_get_max_threads();
+#endif
     //
     params.stencilSize = HPCG_STENCIL;
     //
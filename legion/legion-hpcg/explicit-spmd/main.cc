@@ -56,12 +56,21 @@
 #include "GenerateCoarseProblem.hpp"
 #include "SetupHalo.hpp"
 #include "CG.hpp"
+#include "PipelinedCG.hpp"
+#include "BlockCG.hpp"
+#include "OptimizeProblem.hpp"
 #include "TestNorms.hpp"
 #include "CheckProblem.hpp"
 #include "ComputeResidual.hpp"
+#include "ImplicitVectorOps.hpp"
+#include "ProblemCache.hpp"
+#include "RunRecord.hpp"
+#include "PersistentSolves.hpp"
 
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
+#include <thread>
 
 using namespace std;
 
@@ -77,6 +86,8 @@ genProblemTask(
 ) {
     const int taskID = getTaskID(task);
     const HPCG_Params params = *(HPCG_Params *)task->args;
+    // Generate the rows over the cores of an OpenMP processor, if on one.
+    const bool threaded = runsThreaded(task);
     // Number of processes, my process ID
     const int size = params.commSize, rank = taskID;
     //
@@ -115,7 +126,7 @@ genProblemTask(
     if (ierr) exit(ierr);
     //
     SparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < params.mgLevels; ++level) {
         curLevelMatrix->Ac = new SparseMatrix(regions, rid, ctx, runtime);
         rid += curLevelMatrix->Ac->nRegionEntries();
         curLevelMatrix = curLevelMatrix->Ac;
@@ -124,16 +135,79 @@ genProblemTask(
     Array<floatType> b     (regions[rid++], ctx, runtime);
     Array<floatType> x     (regions[rid++], ctx, runtime);
     Array<floatType> xexact(regions[rid++], ctx, runtime);
-    //
-    const int levelZero = 0;
-    GenerateProblem(A, &b, &x, &xexact, levelZero, ctx, runtime);
+    // From the cache of an earlier run instead, see ProblemCache.hpp.
+    if (params.problemCacheLoad) {
+        ProblemCacheRead(
+            params, rank, ProblemCacheGetSections(A, b, x, xexact)
+        );
+        return;
+    }
+    // The coarse levels only depend on their geometry, so their rows and
+    // neighbors are generated on another thread while those of level 0 are
+    // here, and the allReduces of the nonzeros of all levels are in flight at
+    // once, instead of one level after the other. That thread is not one of
+    // Realm's, so it must not start OpenMP regions: the coarse levels, an
+    // eighth of the rows of the one above each, are filled serially.
+    vector<SparseMatrix *> levels(1, &A);
+    for (int level = 1; level < params.mgLevels; ++level) {
+        GenerateCoarseGeometry(*levels.back());
+        levels.push_back(levels.back()->Ac);
+    }
+    GenerateProblemReport(A, &b, &x, &xexact, 0);
+    for (int level = 1; level < params.mgLevels; ++level) {
+        GenerateProblemReport(*levels[level], NULL, NULL, NULL, level);
+    }
+    std::thread coarseLevels([&levels] {
+        for (size_t level = 1; level < levels.size(); ++level) {
+            GenerateProblemRows(*levels[level], NULL, NULL, NULL, false);
+            GetNeighborInfo(*levels[level]);
+        }
+    });
+    GenerateProblemRows(A, &b, &x, &xexact, threaded);
     GetNeighborInfo(A);
+    coarseLevels.join();
     //
+    vector<Future> totalNonzeros;
+    for (SparseMatrix *l : levels) {
+        totalNonzeros.push_back(GenerateProblemNonzeros(*l, ctx, runtime));
+    }
+    for (size_t level = 0; level < levels.size(); ++level) {
+        GenerateProblemSetNonzeros(*levels[level], totalNonzeros[level]);
+    }
+    ////////////////////////////////////////////////////////////////////////////
+    // Problem Sanity Phase
+    ////////////////////////////////////////////////////////////////////////////
+    // Here, since it checks the global indices the benchmark tasks do without.
+#if 0
+    {
+        SparseMatrix *curLevelMatrix = &A;
+        Array<floatType> *curb = &b;
+        Array<floatType> *curx = &x;
+        Array<floatType> *curxexact = &xexact;
+        //
+        for (int level = 0; level < params.mgLevels; ++level) {
+            CheckProblem(*curLevelMatrix, curb, curx, curxexact, ctx, runtime);
+            // Make the nextcoarse grid the next level.
+            curLevelMatrix = curLevelMatrix->Ac;
+            // No vectors after the top level.
+            curb = NULL;
+            curx = NULL;
+            curxexact = NULL;
+        }
+    }
+#endif
+    // Last use of the global indices, see SetupLocalColumnIndices.
     curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
-        GenerateCoarseProblem(*curLevelMatrix, level, ctx, runtime);
+    for (int level = 0; level < params.mgLevels; ++level) {
+        SetupLocalColumnIndices(*curLevelMatrix, ctx, runtime);
         curLevelMatrix = curLevelMatrix->Ac;
     }
+    //
+    if (params.problemCacheDir[0]) {
+        ProblemCacheWrite(
+            params, rank, ProblemCacheGetSections(A, b, x, xexact)
+        );
+    }
 }
 
 /**
@@ -173,6 +247,7 @@ createLogicalStructures(
     LogicalArray<floatType> &y,
     LogicalArray<floatType> &xexact,
     const Geometry          &geom,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *runtime
 ) {
@@ -194,7 +269,7 @@ createLogicalStructures(
     //
     cout << "*** Creating Logical MG Structures..." << endl;
     LogicalSparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < numberOfMgLevels; ++level) {
         GenerateCoarseProblemTopLevel(*curLevelMatrix, level, ctx, runtime);
         curLevelMatrix = curLevelMatrix->Ac;
     }
@@ -213,6 +288,7 @@ destroyLogicalStructures(
     LogicalArray<floatType> &x,
     LogicalArray<floatType> &y,
     LogicalArray<floatType> &xexact,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *lrt
 ) {
@@ -220,7 +296,7 @@ destroyLogicalStructures(
     const double start = mytimer();
     //
     LogicalSparseMatrix *curLevelMatrix = &A;
-    for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 0; level < numberOfMgLevels; ++level) {
         curLevelMatrix->deallocate(ctx, lrt);
         curLevelMatrix = curLevelMatrix->Ac;
     }
@@ -276,42 +352,68 @@ mainTask(
     cout << "--> nx="   << initGeom.nx   << endl;
     cout << "--> ny="   << initGeom.ny   << endl;
     cout << "--> nz="   << initGeom.nz   << endl;
-    cout << "--> nmg="  << NUM_MG_LEVELS << endl;
+    cout << "--> nmg="  << params.mgLevels << endl;
     ////////////////////////////////////////////////////////////////////////////
     cout << "*** Starting Initialization..." << endl;;
     // Application structures.
     LogicalSparseMatrix A;
     LogicalArray<floatType> b, x, xexact;
+    // The shards of a node are consecutive, as the DefaultMapper's
+    // map_must_epoch lays them out over the processors.
+    A.allReduceGroupSize = params.allReduceGroupSize;
+    if (A.allReduceGroupSize < 0) A.allReduceGroupSize = getNumProcsPerNode();
+    if (A.allReduceGroupSize > 1) {
+        cout << "--> allReduce groups of " << A.allReduceGroupSize
+             << " shards" << endl;
+    }
+    A.reproducibleReductions = params.reproducibleReductions;
+    if (A.reproducibleReductions) {
+        cout << "--> Exact dot product sums across shards ("
+             << sizeof(ExactSum) << " B per arrival)" << endl;
+    }
     //
     createLogicalStructures(
-        A, b, x, xexact, initGeom, ctx, runtime
+        A, b, x, xexact, initGeom, params.mgLevels, ctx, runtime
     );
+    // The problems of an earlier run of this size, if it cached them all.
+    double cachedInitTime = 0.0;
+    if (params.problemCacheDir[0]) {
+        params.problemCacheLoad = ProblemCacheFind(params, cachedInitTime);
+        if (params.problemCacheLoad) {
+            cout << "--> Problems from cache " << params.problemCacheDir
+                 << endl;
+        }
+        else {
+            mkdir(params.problemCacheDir, 0755);
+        }
+    }
     // Time to initialize problem before start of benchmark (phase 1).
     const double initStart = mytimer();
     {
         cout << "*** Launching Initialization Tasks..." << endl;;
         //
+        // One index launch over the shard partitions, in a must epoch since
+        // the shards reduce the number of nonzeros together.
         MustEpochLauncher mel;
-        //
-        for (int shard = 0; shard < initGeom.size; ++shard) {
-            TaskLauncher launcher(
-                GEN_PROB_TID,
-                TaskArgument(&params, sizeof(params))
-            );
-            // Add all matrix levels.
-            LogicalSparseMatrix *curLevelMatrix = &A;
-            for (int level = 0; level < NUM_MG_LEVELS; ++level) {
-                curLevelMatrix->intent(RW_E, shard, launcher, ctx, runtime);
-                curLevelMatrix = curLevelMatrix->Ac;
-            }
-            //
-            b.intent(     RW_E, shard, launcher, ctx, runtime);
-            x.intent(     RW_E, shard, launcher, ctx, runtime);
-            xexact.intent(RW_E, shard, launcher, ctx, runtime);
-            //
-            mel.add_single_task(DomainPoint::from_point<1>(shard), launcher);
+        IndexLauncher launcher(
+            GEN_PROB_TID,
+            A.launchDomain,
+            TaskArgument(&params, sizeof(params)),
+            ArgumentMap()
+        );
+        // Add all matrix levels.
+        LogicalSparseMatrix *curLevelMatrix = &A;
+        for (int level = 0; level < params.mgLevels; ++level) {
+            curLevelMatrix->intent(RW_E, launcher, ctx, runtime);
+            curLevelMatrix = curLevelMatrix->Ac;
         }
         //
+        b.intent(     RW_E, launcher, ctx, runtime);
+        x.intent(     RW_E, launcher, ctx, runtime);
+        xexact.intent(RW_E, launcher, ctx, runtime);
+        //
+        mel.add_index_task(launcher);
+        //
         FutureMap fm = runtime->execute_must_epoch(ctx, mel);
         fm.wait_all_results();
         //
@@ -321,14 +423,31 @@ mainTask(
     // PhaseBarriers.
     {
         LogicalSparseMatrix *curLevelMatrix = &A;
-        for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+        for (int level = 0; level < params.mgLevels; ++level) {
             SetupHaloTopLevel(*curLevelMatrix, level, ctx, runtime);
             curLevelMatrix = curLevelMatrix->Ac;
         }
     }
+    // The benchmark tasks are launched without the setup-only structures, so
+    // return them before.
+    {
+        LogicalSparseMatrix *curLevelMatrix = &A;
+        for (int level = 0; level < params.mgLevels; ++level) {
+            curLevelMatrix->deallocateSetupData(ctx, runtime);
+            curLevelMatrix = curLevelMatrix->Ac;
+        }
+    }
     // Capture phase 1 initialization time to pass to benchmark tasks.
     params.phase1InitTime = mytimer() - initStart;
     cout << "--> Time=" << params.phase1InitTime << " s" << endl;
+    // Reported as the setup of the run that wrote the cache.
+    if (params.problemCacheLoad) {
+        params.phase1InitTime = cachedInitTime;
+        cout << "--> Generation Time=" << cachedInitTime << " s" << endl;
+    }
+    else if (params.problemCacheDir[0]) {
+        ProblemCacheFinish(params, params.phase1InitTime);
+    }
 
     ////////////////////////////////////////////////////////////////////////////
     // Launch the tasks to begin the benchmark.
@@ -342,16 +461,23 @@ mainTask(
         const double start = mytimer();
         //
         MustEpochLauncher mel;
+        // The block pull buffers of --block, before the first intent.
+        ItemFlags aif = IFLAG_W_GHOSTS | IFLAG_WO_SETUP;
+        if (params.blockWidth > 1) {
+            aif |= IFLAG_W_BLOCK_GHOSTS;
+            for (LogicalSparseMatrix *l = &A; l; l = l->Ac) {
+                l->blockWidth = params.blockWidth;
+            }
+        }
         //
         for (int shard = 0; shard < initGeom.size; ++shard) {
             TaskLauncher launcher(
                 START_BENCHMARK_TID,
                 TaskArgument(&params, sizeof(params))
             );
-            const ItemFlags aif = IFLAG_W_GHOSTS;
             // Add all matrix levels.
             LogicalSparseMatrix *curLevelMatrix = &A;
-            for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+            for (int level = 0; level < params.mgLevels; ++level) {
                 curLevelMatrix->intent(RW_E, aif, shard, launcher, ctx, runtime);
                 curLevelMatrix = curLevelMatrix->Ac;
             }
@@ -373,11 +499,23 @@ mainTask(
         //
         cout << "--> Time=" << totalTime << " s" << endl;
     }
+    // The vector kernels of CG again, launched from here over all shards.
+    if (params.implicitMode) {
+        cout << "*** Starting Implicit Vector Kernels..." << endl;
+        //
+        const local_int_t n = local_int_t(params.nx) * params.ny * params.nz;
+        const int nIters = 50;
+        const double implicitTime = ImplicitVectorOps(
+            n, nIters, b, xexact, x, ctx, runtime
+        );
+        cout << "--> Time=" << implicitTime << " s for " << nIters
+             << " iterations" << endl;
+    }
     //
     cout << "*** Cleaning Up..." << endl;
     //
     destroyLogicalStructures(
-        A, b, x, xexact, ctx, runtime
+        A, b, x, xexact, params.mgLevels, ctx, runtime
     );
 }
 
@@ -408,6 +546,31 @@ allocateMGData(
     A.mgData = new MGData(mgRegions, mgDataBaseRID, ctx, lrt);
 }
 
+/**
+ * The block MGData of the level of A for k right-hand sides, see BlockCG.hpp.
+ */
+static void
+allocateBlockMGData(
+    SparseMatrix &A,
+    int level,
+    int k,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    const string levels = to_string(level);
+    const string matrixName = level == 0 ? "A" : "A-L" + levels;
+    // TODO deallocate.
+    LogicalBlockMGData lBlockMGData;
+    lBlockMGData.allocate(matrixName, A, k, ctx, lrt);
+    lBlockMGData.partition(A, k, ctx, lrt);
+    //
+    std::vector<PhysicalRegion> mgRegions;
+    mgRegions.push_back(lBlockMGData.rc.mapRegion(RW_E, ctx, lrt));
+    mgRegions.push_back(lBlockMGData.xc.mapRegion(RW_E, ctx, lrt));
+    //
+    A.blockMGData = new BlockMGData(mgRegions, 0, ctx, lrt);
+}
+
 /**
  *
  */
@@ -415,17 +578,222 @@ static void
 destroySolveLocalStructures(
     SparseMatrix &A,
     CGData &cgData,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *lrt
 ) {
     SparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < numberOfMgLevels; ++level) {
         // These were mapped inline in startBenchmarkTask, so explicitly unmap.
         curLevelMatrix->mgData->unmapRegions(ctx, lrt);
+        if (curLevelMatrix->blockMGData) {
+            curLevelMatrix->blockMGData->unmapRegions(ctx, lrt);
+        }
         curLevelMatrix = curLevelMatrix->Ac;
     }
     //
     cgData.unmapRegions(ctx, lrt);
+    // The SELL copies of OptimizeProblem, on all levels.
+    for (curLevelMatrix = &A; curLevelMatrix;
+         curLevelMatrix = curLevelMatrix->Ac) {
+        if (!curLevelMatrix->sell) continue;
+        curLevelMatrix->sell->unmapRegions(ctx, lrt);
+        curLevelMatrix->lSELL->deallocate(ctx, lrt);
+    }
+}
+
+/**
+ * Writes the record of --record, see RunRecord.hpp. The CG times are those
+ * of the cgIters reference iterations that "--> Average Run Time for CG"
+ * reports, times those of setup (9) and OptimizeProblem (7). optIters,
+ * pcgIters and bcgIters are 0 for the phases that did not run, solveTimes
+ * empty without --solves.
+ */
+static void
+writeRunRecord(
+    const HPCG_Params &params,
+    SparseMatrix &A,
+    int numberOfMgLevels,
+    int cgIters,
+    const std::vector<double> &cgTimes,
+    const std::vector<double> &times,
+    double allReduceTime,
+    int optIters,
+    const std::vector<double> &optTimes,
+    int pcgIters,
+    const std::vector<double> &pcgTimes,
+    int bcgIters,
+    const std::vector<double> &bcgTimes,
+    const std::vector<double> &solveTimes
+) {
+    const Geometry *const geom = A.geom->data();
+    const auto *const Asclrs = A.sclrs->data();
+    RunRecord r;
+    r.add("benchmark", "HPCG");
+    r.add("version", "3.0");
+    r.add("implementation", "Legion");
+#ifdef LGNCG_TASKING
+    r.add("options", "Tasking");
+#else
+    r.add("options", "");
+#endif
+    //
+    r.beginObject("config");
+    r.add("nx", params.nx);
+    r.add("ny", params.ny);
+    r.add("nz", params.nz);
+    r.add("runningTime", params.runningTime);
+    r.add("numThreads", params.numThreads);
+    r.add("preSmootherSteps", params.preSmootherSteps);
+    r.add("postSmootherSteps", params.postSmootherSteps);
+    r.add("pipelinedCG", bool(params.pipelinedCG));
+    r.add("blockWidth", params.blockWidth);
+    r.add("multicolorSYMGS", bool(params.multicolorSYMGS));
+    r.add("sellFormat", bool(params.sellFormat));
+    r.add("matrixFree", bool(params.matrixFree));
+    r.add("agglomerateRows", params.agglomerateRows);
+    r.add("persistentSolves", params.persistentSolves);
+    r.add("implicitMode", bool(params.implicitMode));
+    r.add("fusedMGRows", params.fusedMGRows);
+    r.add("cgCheckFreq", params.cgCheckFreq);
+    r.add("allReduceGroupSize", params.allReduceGroupSize);
+    r.add("reproducibleReductions", bool(params.reproducibleReductions));
+    r.add("timeKernels", bool(params.timeKernels));
+    r.add("streamingStores",
+          params.streamingStores == STREAMING_STORES_AUTO ? "auto" :
+          params.streamingStores == STREAMING_STORES_ON ? "on" : "off");
+    r.add("directHalo", bool(params.directHalo));
+    r.add("problemCache", bool(params.problemCacheDir[0]));
+    r.end();
+    //
+    r.beginObject("grid");
+    r.add("size", geom->size);
+    r.add("npx", geom->npx);
+    r.add("npy", geom->npy);
+    r.add("npz", geom->npz);
+    r.add("nx", geom->nx);
+    r.add("ny", geom->ny);
+    r.add("nz", geom->nz);
+    r.add("globalNx", geom->npx * geom->nx);
+    r.add("globalNy", geom->npy * geom->ny);
+    r.add("globalNz", geom->npz * geom->nz);
+    r.end();
+    //
+    r.beginObject("problem");
+    r.add("rows", Asclrs->totalNumberOfRows);
+    r.add("nonzeros", Asclrs->totalNumberOfNonzeros);
+    r.add("mgLevels", numberOfMgLevels);
+    r.end();
+    //
+    r.beginObject("cg");
+    r.add("iterations", cgIters);
+    r.add("sets", 1);
+    r.add("time", cgTimes[0]);
+    r.add("timePerIteration", cgTimes[0] / cgIters);
+    r.end();
+    //
+    r.beginObject("times");
+    r.add("total", cgTimes[0]);
+    r.add("ddot", cgTimes[1]);
+    r.add("waxpby", cgTimes[2]);
+    r.add("spmv", cgTimes[3]);
+    r.add("mg", cgTimes[5]);
+    r.add("allReduce", cgTimes[4]);
+    r.add("halo", cgTimes[6]);
+    r.add("setup", times[9]);
+    r.add("optimization", times[7]);
+    r.end();
+    // By kernel only meaningful with timeKernels, see overheads.
+    const CGFlops f = cgFlops(A, numberOfMgLevels, 1.0, cgIters);
+    r.beginObject("gflops");
+    r.add("ddot", f.ddot / cgTimes[1] / 1.0e9);
+    r.add("waxpby", f.waxpby / cgTimes[2] / 1.0e9);
+    r.add("spmv", f.spmv / cgTimes[3] / 1.0e9);
+    r.add("mg", f.mg / cgTimes[5] / 1.0e9);
+    r.add("total", f.total() / cgTimes[0] / 1.0e9);
+    r.end();
+    //
+    const double bytes = problemMemoryUse(A, numberOfMgLevels,
+                                          params.pipelinedCG);
+    r.beginObject("memory");
+    r.add("totalGB", bytes / 1.0e9);
+    r.add("optimizeProblemGB", OptimizeProblemMemoryUse(A) / 1.0e9);
+    r.add("bytesPerRow", bytes / Asclrs->totalNumberOfRows);
+    r.end();
+    //
+    r.beginObject("overheads");
+    r.add("kernelsTimed", kernelTimingEnabled());
+    r.add("phase1InitTime", params.phase1InitTime);
+    r.add("allReduceLatency", allReduceTime);
+    r.add("allReduceMode",
+          A.dcAllRedSumFT->data()->hierarchical ? "two-level" : "flat");
+    r.add("haloFractionOfSpmv", cgTimes[6] / cgTimes[3]);
+    r.end();
+    // Each level's V-cycle time includes the levels below it.
+    if (params.timeKernels) {
+        r.beginArray("mgLevelTimes");
+        int level = 0;
+        for (SparseMatrix *l = &A; l; l = l->Ac, ++level) {
+            r.beginObject("");
+            r.add("level", level);
+            r.add("time", l->mgTime - (l->Ac ? l->Ac->mgTime : 0.0));
+            r.add("halo", l->haloTime);
+            r.end();
+        }
+        r.end();
+    }
+    if (optIters) {
+        r.beginObject("optimized");
+        r.add("multicolorSYMGS", A.multicolorSYMGS);
+        r.add("sell", bool(A.sell));
+        r.add("matrixFree", A.matrixFree);
+        int agglomeratedLevel = -1, level = 0;
+        for (SparseMatrix *l = &A; l; l = l->Ac, ++level) {
+            if (l->agglomerated && agglomeratedLevel < 0) {
+                agglomeratedLevel = level;
+            }
+        }
+        r.add("agglomeratedLevel", agglomeratedLevel);
+        r.add("iterations", optIters);
+        r.add("penalty", std::max(0, optIters - cgIters));
+        r.add("time", optTimes[0]);
+        r.end();
+    }
+    if (pcgIters) {
+        r.beginObject("pipelined");
+        r.add("iterations", pcgIters);
+        r.add("time", pcgTimes[0]);
+        r.end();
+    }
+    // All the right-hand sides, so timePerRhs compares with cg.time.
+    if (bcgIters) {
+        const int k = params.blockWidth;
+        const CGFlops bf = cgFlops(A, numberOfMgLevels, 1.0, bcgIters);
+        r.beginObject("block");
+        r.add("width", k);
+        r.add("iterations", bcgIters);
+        r.add("time", bcgTimes[0]);
+        r.add("timePerRhs", bcgTimes[0] / k);
+        r.add("gflops", k * bf.total() / bcgTimes[0] / 1.0e9);
+        r.end();
+    }
+    // The first solve and the mean of the others, see PersistentSolves.
+    if (!solveTimes.empty()) {
+        const PersistentSolveTimes st = persistentSolveTimes(solveTimes);
+        r.beginObject("persistentSolves");
+        r.add("solves", int(solveTimes.size()));
+        r.add("iterations", cgIters);
+        r.add("firstTime", st.first);
+        r.add("steadyTime", st.steady);
+        r.add("steadyMinTime", st.steadyMin);
+        r.add("warmupTime", st.first - st.steady);
+        r.end();
+    }
+    //
+    if (!r.write(params.runRecordFile)) {
+        cerr << "Cannot write the run record to " << params.runRecordFile
+             << endl;
+    }
 }
 
 /**
@@ -442,18 +810,22 @@ startBenchmarkTask(
     static const bool doMG = true;
     //
     double setup_time = mytimer();
+    //
+    const HPCG_Params params = *(HPCG_Params *)task->args;
     // Number of levels including first.
-    const int numberOfMgLevels = NUM_MG_LEVELS;
+    const int numberOfMgLevels = params.mgLevels;
     // Use this array for collecting timing information.
     std::vector<double> times(10, 0.0);
-    //
-    const HPCG_Params params = *(HPCG_Params *)task->args;
+    kernelTimingEnabled() = params.timeKernels;
+    streamingStoresMode() = params.streamingStores;
+    directHaloEnabled() = params.directHalo;
     // Check if QuickPath option is enabled.  If the running time is set to
     // zero, we minimize all paths through the program.
     const bool quickPath = (params.runningTime == 0);
     //
     size_t rid = 0;
-    const ItemFlags aif = IFLAG_W_GHOSTS;
+    ItemFlags aif = IFLAG_W_GHOSTS | IFLAG_WO_SETUP;
+    if (params.blockWidth > 1) aif |= IFLAG_W_BLOCK_GHOSTS;
     //
     SparseMatrix A(regions, rid, aif, ctx, lrt);
     rid += A.nRegionEntries();
@@ -492,11 +864,59 @@ startBenchmarkTask(
     //
     const int cgDataBaseRID = 0;
     CGData data(cgRegions, cgDataBaseRID, ctx, lrt);
+    // PipelinedCGData, only if the pipelined variant is timed.
+    LogicalPipelinedCGData lPCGData;
+    PipelinedCGData *pdata = nullptr;
+    if (params.pipelinedCG) {
+        lPCGData.allocate("pcgdata", A, ctx, lrt);
+        //
+        vector<PhysicalRegion> pcgRegions;
+        const int nPCGDataRegions = 5;
+        pcgRegions.reserve(nPCGDataRegions);
+        //
+        pcgRegions.push_back( lPCGData.n.mapRegion(RW_E, ctx, lrt));
+        pcgRegions.push_back( lPCGData.p.mapRegion(RW_E, ctx, lrt));
+        pcgRegions.push_back( lPCGData.s.mapRegion(RW_E, ctx, lrt));
+        pcgRegions.push_back( lPCGData.q.mapRegion(RW_E, ctx, lrt));
+        pcgRegions.push_back(lPCGData.Aq.mapRegion(RW_E, ctx, lrt));
+        //
+        pdata = new PipelinedCGData(pcgRegions, 0, ctx, lrt);
+    }
+    // BlockCGData, only with --block.
+    const int blockWidth = params.blockWidth;
+    LogicalBlockCGData lBCGData;
+    BlockCGData *bdata = nullptr;
+    if (blockWidth > 1) {
+        lBCGData.allocate("bcgdata", A, blockWidth, ctx, lrt);
+        lBCGData.partition(A, blockWidth, ctx, lrt);
+        //
+        vector<PhysicalRegion> bcgRegions;
+        const int nBCGDataRegions = 6;
+        bcgRegions.reserve(nBCGDataRegions);
+        //
+        bcgRegions.push_back( lBCGData.x.mapRegion(RW_E, ctx, lrt));
+        bcgRegions.push_back( lBCGData.b.mapRegion(RW_E, ctx, lrt));
+        bcgRegions.push_back( lBCGData.r.mapRegion(RW_E, ctx, lrt));
+        bcgRegions.push_back( lBCGData.z.mapRegion(RW_E, ctx, lrt));
+        bcgRegions.push_back( lBCGData.p.mapRegion(RW_E, ctx, lrt));
+        bcgRegions.push_back(lBCGData.Ap.mapRegion(RW_E, ctx, lrt));
+        //
+        bdata = new BlockCGData(bcgRegions, 0, blockWidth, ctx, lrt);
+    }
     // MGData
     curLevelMatrix = &A;
     for (int level = 1; level < numberOfMgLevels; ++level) {
         allocateMGData(*curLevelMatrix, level - 1, ctx, lrt);
+        curLevelMatrix->mgData->numberOfPresmootherSteps =
+            params.preSmootherSteps;
+        curLevelMatrix->mgData->numberOfPostsmootherSteps =
+            params.postSmootherSteps;
         f2cOperatorPopulate(*curLevelMatrix, ctx, lrt);
+        if (bdata) {
+            allocateBlockMGData(
+                *curLevelMatrix, level - 1, blockWidth, ctx, lrt
+            );
+        }
         curLevelMatrix = curLevelMatrix->Ac;
     }
     // Setup halo information for all levels before we begin.
@@ -518,8 +938,34 @@ startBenchmarkTask(
             ctx,
             lrt
         );
+        if (bdata) {
+            SetupGhostArrays(
+                *curLevelMatrix->Ac,
+                *curLevelMatrix->blockMGData->xc,
+                ctx,
+                lrt,
+                blockWidth
+            );
+        }
         curLevelMatrix = curLevelMatrix->Ac;
     }
+    if (bdata) {
+        SetupGhostArrays(A, *bdata->z, ctx, lrt, blockWidth);
+        SetupGhostArrays(A, *bdata->p, ctx, lrt, blockWidth);
+    }
+    // With --fmg, the first level of at most that many rows and all the ones
+    // below run their V-cycle in this task, see ComputeMGInline.
+    if (params.fusedMGRows > 0) {
+        bool inlineMG = false;
+        curLevelMatrix = &A;
+        for (int level = 0; level < numberOfMgLevels; ++level) {
+            const local_int_t nrow =
+                curLevelMatrix->sclrs->data()->localNumberOfRows;
+            inlineMG = inlineMG || nrow <= params.fusedMGRows;
+            curLevelMatrix->inlineMG = inlineMG;
+            curLevelMatrix = curLevelMatrix->Ac;
+        }
+    }
     // Passed this point, we have to manually unmap regions that are created.
 
     // Capture total time of setup.
@@ -559,28 +1005,6 @@ startBenchmarkTask(
     //
     const auto *const Asclrs = A.sclrs->data();
 
-    ////////////////////////////////////////////////////////////////////////////
-    // Problem Sanity Phase
-    ////////////////////////////////////////////////////////////////////////////
-#if 0
-    {
-        SparseMatrix *curLevelMatrix = &A;
-        Array<floatType> *curb = &b;
-        Array<floatType> *curx = &x;
-        Array<floatType> *curxexact = &xexact;
-        //
-        for (int level = 0; level< numberOfMgLevels; ++level) {
-            CheckProblem(*curLevelMatrix, curb, curx, curxexact, ctx, lrt);
-            // Make the nextcoarse grid the next level.
-            curLevelMatrix = curLevelMatrix->Ac;
-            // No vectors after the top level.
-            curb = NULL;
-            curx = NULL;
-            curxexact = NULL;
-        }
-    }
-#endif
-    //
     ////////////////////////////////////////////////////////////////////////////
     // Reference CG Timing Phase                                              //
     ////////////////////////////////////////////////////////////////////////////
@@ -610,9 +1034,205 @@ startBenchmarkTask(
     if (rank == 0 && err_count) {
         cerr << err_count << " error(s) in call(s) to reference CG." << endl;
     }
-#if 0
     //
-    double refTolerance = normr / normr0;
+    const double refTolerance = normr / normr0;
+    if (rank == 0) {
+        // The timed sets of the optimized phase below are disabled, so the
+        // scaling scripts take their CG time from these.
+        cout << "--> Iterations per CG set="
+             << totalNiters_ref / numberOfCalls << endl;
+        cout << "--> Average Run Time for CG="
+             << ref_times[0] / numberOfCalls << " s" << endl;
+        // Compare the WAXPBY times of runs with --ntstores=on and off.
+        cout << "--> Streaming stores: "
+#ifdef LGNCG_STREAMING_STORES
+             << (params.streamingStores == STREAMING_STORES_AUTO ?
+                 "auto, above a last level cache of " +
+                 std::to_string(lastLevelCacheBytes()) + " bytes" :
+                 params.streamingStores == STREAMING_STORES_ON ? "on" : "off")
+#else
+             << "none, no SSE2"
+#endif
+             << endl;
+        if (params.directHalo) {
+            int neighbors = 0, direct = 0;
+            countDirectHaloPulls(A, neighbors, direct);
+            cout << "--> Direct halo pulls: " << direct << " of the "
+                 << neighbors << " neighbors of shard 0 over the levels"
+                 << endl;
+        }
+        cout << "--> Reference CG times (s"
+             << (params.timeKernels ? "" : ", of the launches only")
+             << "): DDOT=" << ref_times[1]
+             << " WAXPBY=" << ref_times[2]
+             << " SpMV=" << ref_times[3]
+             << " MG=" << ref_times[5]
+             << " halo=" << ref_times[6]
+             << " allReduce=" << ref_times[4]
+             << " total=" << ref_times[0] << endl;
+        // Each level's V-cycle time includes the levels below it.
+        if (params.timeKernels) {
+            int level = 0;
+            for (SparseMatrix *l = &A; l; l = l->Ac, ++level) {
+                const double below = l->Ac ? l->Ac->mgTime : 0.0;
+                cout << "--> MG level " << level << " time (s) = "
+                     << l->mgTime - below << " (halo " << l->haloTime << ")"
+                     << endl;
+            }
+        }
+    }
+    // The dot products of CG only time the launch of their allReduce.
+    const double allReduceTime = allReduceLatency(
+        *A.dcAllRedSumFT, 10, ctx, lrt
+    );
+    if (rank == 0) {
+        cout << "--> allReduce latency (s) = " << allReduceTime
+             << (A.dcAllRedSumFT->data()->hierarchical ? " (two-level)" : "")
+             << endl;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Pipelined CG Timing Phase                                              //
+    ////////////////////////////////////////////////////////////////////////////
+    // The same iterations as the reference CG, so the times compare directly.
+    std::vector<double> pcg_times(9, 0.0);
+    int totalNiters_pcg = 0;
+    if (pdata) {
+        err_count = 0;
+        for (int i = 0; i < numberOfCalls; ++i) {
+            ZeroVector(x, ctx, lrt);
+            ierr = PipelinedCG(A, data, *pdata, b, x, refMaxIters, tolerance,
+                               niters, normr, normr0, &pcg_times[0], doMG,
+                               ctx, lrt
+                   );
+            if (ierr) ++err_count;
+            totalNiters_pcg += niters;
+        }
+        if (rank == 0 && err_count) {
+            cerr << err_count << " error(s) in call(s) to pipelined CG."
+                 << endl;
+        }
+        if (rank == 0) {
+            cout << "--> Pipelined CG time (s) = " << pcg_times[0]
+                 << " (reference CG " << ref_times[0] << ") for "
+                 << totalNiters_pcg << " iterations" << endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Block CG Timing Phase                                                  //
+    ////////////////////////////////////////////////////////////////////////////
+    // blockWidth right-hand sides for the iterations of the reference CG:
+    // compared with blockWidth times its time, the gain of reading A once for
+    // all of them.
+    std::vector<double> bcg_times(9, 0.0);
+    int totalNiters_bcg = 0;
+    std::vector<floatType> bcgResiduals(blockWidth > 1 ? blockWidth : 0);
+    if (bdata) {
+        SetupBlockRHS(b, *bdata, ctx, lrt);
+        ierr = BlockCG(A, *bdata, refMaxIters, tolerance, totalNiters_bcg,
+                       bcgResiduals.data(), &bcg_times[0], doMG, ctx, lrt
+               );
+        if (rank == 0 && ierr) {
+            cerr << "Error in call to block CG." << endl;
+        }
+        if (rank == 0) {
+            // All the columns follow the reference CG, see SetupBlockRHS.
+            floatType worst = 0.0;
+            for (floatType res : bcgResiduals) {
+                worst = std::max<floatType>(
+                            worst, std::fabs(res - refTolerance)
+                        );
+            }
+            cout << "--> Block CG (k=" << blockWidth << ") time (s) = "
+                 << bcg_times[0] << " (reference CG " << ref_times[0]
+                 << " per right-hand side) for " << totalNiters_bcg
+                 << " iterations, speedup per right-hand side "
+                 << blockWidth * ref_times[0] / bcg_times[0] << endl;
+            cout << "--> Block CG largest deviation from the reference "
+                 << "scaled residual = " << worst << endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Optimized Problem Phase                                                //
+    ////////////////////////////////////////////////////////////////////////////
+    // The reference runs above used the natural ordering and the original
+    // matrix. From here on SYMGS may sweep by color, which may take more
+    // iterations to reach the reference residual reduction: that count is the
+    // penalty HPCG charges. The SELL layout and the matrix-free stencil alone
+    // do not change the result.
+    std::vector<double> optProblemTimes(9, 0.0);
+    int optProblemNiters = 0;
+    if (params.multicolorSYMGS || params.sellFormat || params.matrixFree ||
+        params.agglomerateRows) {
+        double t7 = mytimer();
+        OptimizeProblem(A, data, b, x, xexact, params, ctx, lrt);
+        times[7] = mytimer() - t7;
+        //
+        ZeroVector(x, ctx, lrt);
+        ierr = CG(A, data, b, x, 10 * refMaxIters, refTolerance, niters,
+                  normr, normr0, &optProblemTimes[0], doMG, ctx, lrt,
+                  params.cgCheckFreq
+               );
+        if (rank == 0 && ierr) {
+            cerr << "Error in call to CG with the optimized problem." << endl;
+        }
+        optProblemNiters = niters;
+        if (rank == 0) {
+            string opts;
+            if (A.multicolorSYMGS) opts += ", multicolor SYMGS";
+            if (A.sell) opts += ", SELL matrix";
+            if (A.matrixFree) opts += ", matrix-free, not official";
+            int level = 0;
+            for (SparseMatrix *l = &A; l; l = l->Ac, ++level) {
+                if (!l->agglomerated) continue;
+                opts += ", agglomerated from level " + std::to_string(level);
+                break;
+            }
+            cout << "--> Optimized problem (" << opts.substr(2) << "): "
+                 << niters
+                 << " iterations to reach the reference residual reduction "
+                 << refTolerance << " (reference " << refMaxIters
+                 << "), penalty " << std::max(0, niters - refMaxIters) << endl;
+            cout << "--> Optimized problem CG time (s) = "
+                 << optProblemTimes[0]
+                 << " (reference CG " << ref_times[0] << ")" << endl;
+            cout << "--> Optimized problem data (GB) = "
+                 << OptimizeProblemMemoryUse(A) / 1000000000.0 << endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Persistent Solves Phase                                                //
+    ////////////////////////////////////////////////////////////////////////////
+    // The production pattern of many solves on one operator: the matrices,
+    // halos, traces and instances set up by now are kept, and only the
+    // right-hand side changes. The first solve pays what is left of the
+    // runtime warmup, the others are the steady state.
+    std::vector<double> solveTimes;
+    if (params.persistentSolves) {
+        solveTimes = PersistentSolves(
+            A, data, b, x, xexact, params.persistentSolves, refMaxIters,
+            doMG, ctx, lrt
+        );
+        if (rank == 0) {
+            const PersistentSolveTimes st = persistentSolveTimes(solveTimes);
+            cout << "--> Persistent solves: " << solveTimes.size()
+                 << " of " << refMaxIters << " iterations, first (s) = "
+                 << st.first << ", steady state (s) = " << st.steady
+                 << " per solve (fastest " << st.steadyMin << "), warmup (s) = "
+                 << st.first - st.steady << endl;
+        }
+    }
+    if (rank == 0 && params.runRecordFile[0]) {
+        writeRunRecord(params, A, numberOfMgLevels,
+                       totalNiters_ref / numberOfCalls, ref_times, times,
+                       allReduceTime, optProblemNiters, optProblemTimes,
+                       totalNiters_pcg, pcg_times, totalNiters_bcg,
+                       bcg_times, solveTimes);
+    }
+#if 0
 
     ////////////////////////////////////////////////////////////////////////////
     // Optimized CG Setup Phase                                               //
@@ -747,6 +1367,7 @@ startBenchmarkTask(
         refMaxIters,
         optMaxIters,
         &times[0],
+        pdata ? &pcg_times[0] : NULL,
         testCGData,
         testSymmetryData,
         testnormsData,
@@ -759,8 +1380,18 @@ startBenchmarkTask(
     ////////////////////////////////////////////////////////////////////////////
     // Cleanup task-local strucutres allocated for solve.
     ////////////////////////////////////////////////////////////////////////////
-    destroySolveLocalStructures(A, data, ctx, lrt);
+    destroySolveLocalStructures(A, data, numberOfMgLevels, ctx, lrt);
     lCGData.deallocate(ctx, lrt);
+    if (pdata) {
+        pdata->unmapRegions(ctx, lrt);
+        delete pdata;
+        lPCGData.deallocate(ctx, lrt);
+    }
+    if (bdata) {
+        bdata->unmapRegions(ctx, lrt);
+        delete bdata;
+        lBCGData.deallocate(ctx, lrt);
+    }
 }
 
 /**
@@ -0,0 +1,104 @@
+
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+/*!
+ @file ComputeChebyshev.cpp
+
+ HPCG routine
+ */
+
+#include "ComputeChebyshev.hpp"
+#include "ComputeSPMV.hpp"
+#include "OptimizeProblem.hpp"
+
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
+#include <cassert>
+
+/*!
+  Routine to smooth x for Ax = r by a Chebyshev polynomial of degree HPCG_CHEBYSHEV_DEGREE in D^-1*A, D the
+  diagonal of A, in place of one symmetric Gauss-Seidel sweep:
+
+  - The polynomial damps the eigenvalues of D^-1*A between HPCG_CHEBYSHEV_LOWER and HPCG_CHEBYSHEV_UPPER times the
+    estimate of the largest one made by SetupChebyshev, the error components a smoother has to remove.
+  - It is built from SpMVs and vector updates only, so all the rows are independent: no coloring, no ordering,
+    and every update runs in parallel.
+  - The polynomial is the same for every call, so the MG preconditioner stays symmetric.
+
+  @param[in]    A the known system matrix, with the Chebyshev data of SetupChebyshev
+  @param[in]    r the input vector
+  @param[inout] x On entry the initial guess, on exit the smoothed solution
+  @param[in]    zeroGuess x is zero on entry, which saves the SpMV of the first residual
+
+  @return returns 0 upon success and non-zero otherwise
+
+  @see SetupChebyshev
+*/
+int ComputeChebyshev( const SparseMatrix & A, const Vector & r, Vector & x, bool zeroGuess) {
+
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+
+  OptimizationData & od = *(OptimizationData *) A.optimizationData;
+  assert(od.chebyshev);
+  const local_int_t nrow = A.localNumberOfRows;
+  const double * const rv = r.values;
+  const double * const invD = &od.inverseDiagonal[0];
+  double * const xv = x.values;
+  double * const resv = od.residual.values;
+  double * const dv = od.direction.values;
+  double * const pv = od.product.values;
+
+  const double upper = HPCG_CHEBYSHEV_UPPER*od.lambdaMax;
+  const double lower = HPCG_CHEBYSHEV_LOWER*od.lambdaMax;
+  const double theta = 0.5*(upper + lower); // center of the interval
+  const double delta = 0.5*(upper - lower); // half width
+  const double sigma = theta/delta;
+  double rho = 1.0/sigma;
+
+  int ierr = 0;
+  if (!zeroGuess) ierr = ComputeSPMV(A, x, od.product);
+  if (ierr != 0) return ierr;
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
+  for (local_int_t i=0; i<nrow; i++) {
+    resv[i] = zeroGuess ? rv[i] : rv[i] - pv[i];
+    dv[i] = invD[i]*resv[i]/theta;
+  }
+
+  for (int k=1; ; k++) {
+#ifndef HPCG_NO_OPENMP
+    #pragma omp parallel for
+#endif
+    for (local_int_t i=0; i<nrow; i++) xv[i] += dv[i];
+    if (k == HPCG_CHEBYSHEV_DEGREE) break;
+
+    ierr = ComputeSPMV(A, od.direction, od.product);
+    if (ierr != 0) return ierr;
+    const double rhoNew = 1.0/(2.0*sigma - rho);
+    const double alpha = rhoNew*rho;
+    const double beta = 2.0*rhoNew/delta;
+#ifndef HPCG_NO_OPENMP
+    #pragma omp parallel for
+#endif
+    for (local_int_t i=0; i<nrow; i++) {
+      resv[i] -= pv[i];
+      dv[i] = alpha*dv[i] + beta*invD[i]*resv[i];
+    }
+    rho = rhoNew;
+  }
+
+  return 0;
+}
@@ -0,0 +1,21 @@
+
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+#ifndef COMPUTECHEBYSHEV_HPP
+#define COMPUTECHEBYSHEV_HPP
+#include "SparseMatrix.hpp"
+#include "Vector.hpp"
+
+int ComputeChebyshev( const SparseMatrix  & A, const Vector & r, Vector & x, bool zeroGuess);
+
+#endif // COMPUTECHEBYSHEV_HPP
@@ -20,6 +20,23 @@
 
 #include "ComputeMG.hpp"
 #include "ComputeMG_ref.hpp"
+#include "ComputeSYMGS.hpp"
+#include "ComputeChebyshev.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeRestriction_ref.hpp"
+#include "ComputeProlongation_ref.hpp"
+#include "OptimizeProblem.hpp"
+#include <cassert>
+
+/*!
+  One smoothing step of the level of A: the Chebyshev polynomial of ComputeChebyshev on the levels
+  SetupChebyshev set up, ComputeSYMGS on the others, for which zeroGuess does not matter.
+*/
+static inline int ComputeSmoother(const SparseMatrix & A, const Vector & r, Vector & x, bool zeroGuess) {
+  const OptimizationData & od = *(const OptimizationData *) A.optimizationData;
+  if (od.chebyshev) return ComputeChebyshev(A, r, x, zeroGuess);
+  return ComputeSYMGS(A, r, x);
+}
 
 /*!
   @param[in] A the known system matrix
@@ -28,11 +45,40 @@
 
   @return returns 0 upon success and non-zero otherwise
 
+  The V-cycle of ComputeMG_ref, with the smoother and the SpMV of ComputeSYMGS
+  and ComputeSPMV, when OptimizeProblem built the OptimizationData of A
+  (HPCG_USE_OPTIMIZED_KERNELS), or ComputeChebyshev as the smoother of the
+  levels given to SetupChebyshev. The reference implementation is called otherwise.
+
   @see ComputeMG_ref
 */
 int ComputeMG(const SparseMatrix  & A, const Vector & r, Vector & x) {
 
-  // This line and the next two lines should be removed and your version of ComputeSYMGS should be used.
-  A.isMgOptimized = false;
-  return ComputeMG_ref(A, r, x);
+  if (A.optimizationData == 0) {
+    A.isMgOptimized = false;
+    return ComputeMG_ref(A, r, x);
+  }
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+
+  ZeroVector(x); // initialize x to zero
+
+  int ierr = 0;
+  if (A.mgData!=0) { // Go to next coarse level if defined
+    int numberOfPresmootherSteps = A.mgData->numberOfPresmootherSteps;
+    for (int i=0; i< numberOfPresmootherSteps; ++i) ierr += ComputeSmoother(A, r, x, i==0);
+    if (ierr!=0) return ierr;
+    ierr = ComputeSPMV(A, x, *A.mgData->Axf); if (ierr!=0) return ierr;
+    // Perform restriction operation using simple injection
+    ierr = ComputeRestriction_ref(A, r);  if (ierr!=0) return ierr;
+    ierr = ComputeMG(*A.Ac,*A.mgData->rc, *A.mgData->xc);  if (ierr!=0) return ierr;
+    ierr = ComputeProlongation_ref(A, x);  if (ierr!=0) return ierr;
+    int numberOfPostsmootherSteps = A.mgData->numberOfPostsmootherSteps;
+    for (int i=0; i< numberOfPostsmootherSteps; ++i) ierr += ComputeSmoother(A, r, x, false);
+    if (ierr!=0) return ierr;
+  }
+  else {
+    ierr = ComputeSmoother(A, r, x, true);
+    if (ierr!=0) return ierr;
+  }
+  return 0;
 }
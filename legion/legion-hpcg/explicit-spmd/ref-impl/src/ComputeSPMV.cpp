@@ -20,14 +20,101 @@
 
 #include "ComputeSPMV.hpp"
 #include "ComputeSPMV_ref.hpp"
+#include "ComputeDotProduct.hpp"
+#include "OptimizeProblem.hpp"
+#include "ExchangeHalo.hpp"
+#include "mytimer.hpp"
+
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
+#include <cassert>
+
+/*!
+  Computes the rows of one SELL chunk of y = Ax.
+
+  @return the sum of x[i]*y[i] over the rows i of the chunk if dot, 0 otherwise
+*/
+static inline double ComputeSPMVChunk(const OptimizationData & od, local_int_t k,
+    const double * const xv, double * const yv, bool dot) {
+  const local_int_t offset = od.chunkOffset[k];
+  const local_int_t width = (od.chunkOffset[k+1] - offset)/HPCG_SELL_C;
+  const double * const vals = &od.values[offset];
+  const local_int_t * const inds = &od.columns[offset];
+  double sum[HPCG_SELL_C];
+  for (int s=0; s<HPCG_SELL_C; s++) sum[s] = 0.0;
+  for (local_int_t j=0; j<width; j++)
+    for (int s=0; s<HPCG_SELL_C; s++)
+      sum[s] += vals[j*HPCG_SELL_C+s]*xv[inds[j*HPCG_SELL_C+s]];
+
+  const local_int_t * const rows = &od.rows[k*HPCG_SELL_C];
+  double result = 0.0;
+  for (int s=0; s<HPCG_SELL_C; s++) {
+    if (rows[s] < 0) continue;
+    yv[rows[s]] = sum[s];
+    if (dot) result += xv[rows[s]]*sum[s];
+  }
+  return result;
+}
+
+/*!
+  SELL SpMV over the OptimizationData of A. The interior chunks are computed
+  while the halo of x is in flight, the boundary ones after it arrived.
+
+  @return the local part of x'*y if dot, 0 otherwise
+*/
+static double ComputeSPMVOptimized(const SparseMatrix & A, Vector & x, Vector & y, bool dot) {
+
+  assert(x.localLength>=A.localNumberOfColumns); // Test vector lengths
+  assert(y.localLength>=A.localNumberOfRows);
+
+  OptimizationData & od = *(OptimizationData *) A.optimizationData;
+  const double * const xv = x.values;
+  double * const yv = y.values;
+  const int numberOfColors = od.numberOfColors;
+
+  double local_result = 0.0;
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel reduction (+:local_result)
+#endif
+  {
+#ifndef HPCG_NO_MPI
+#ifndef HPCG_NO_OPENMP
+    #pragma omp single nowait
+#endif
+    ExchangeHaloBegin(A, x);
+#endif
+    for (int c=0; c<numberOfColors; c++) {
+#ifndef HPCG_NO_OPENMP
+      #pragma omp for nowait
+#endif
+      for (local_int_t k=od.colorChunks[2*c]; k<od.colorChunks[2*c+1]; k++)
+        local_result += ComputeSPMVChunk(od, k, xv, yv, dot);
+    }
+#ifndef HPCG_NO_MPI
+#ifndef HPCG_NO_OPENMP
+    #pragma omp single
+#endif
+    ExchangeHaloEnd(A, x);
+#endif
+    for (int c=0; c<numberOfColors; c++) {
+#ifndef HPCG_NO_OPENMP
+      #pragma omp for nowait
+#endif
+      for (local_int_t k=od.colorChunks[2*c+1]; k<od.colorChunks[2*c+2]; k++)
+        local_result += ComputeSPMVChunk(od, k, xv, yv, dot);
+    }
+  }
+  return local_result;
+}
 
 /*!
   Routine to compute sparse matrix vector product y = Ax where:
   Precondition: First call exchange_externals to get off-processor values of x
 
-  This routine calls the reference SpMV implementation by default, but
-  can be replaced by a custom, optimized routine suited for
-  the target system.
+  This routine uses the SELL format of OptimizeProblem when it built one for
+  A (HPCG_USE_OPTIMIZED_KERNELS), and calls the reference SpMV implementation
+  otherwise.
 
   @param[in]  A the known system matrix
   @param[in]  x the known vector
@@ -39,7 +126,48 @@
 */
 int ComputeSPMV( const SparseMatrix & A, Vector & x, Vector & y) {
 
-  // This line and the next two lines should be removed and your version of ComputeSPMV should be used.
-  A.isSpmvOptimized = false;
-  return ComputeSPMV_ref(A, x, y);
+  if (A.optimizationData == 0) {
+    A.isSpmvOptimized = false;
+    return ComputeSPMV_ref(A, x, y);
+  }
+  ComputeSPMVOptimized(A, x, y, false);
+  return 0;
+}
+
+/*!
+  Routine to compute y = Ax and the dot product x'*y in one pass over y.
+
+  @param[in]  A the known system matrix
+  @param[in]  x the known vector
+  @param[out] y On exit contains the result: Ax.
+  @param[out] result On exit contains x'*y.
+  @param[out] time_allreduce the time it took to perform the communication between processes
+
+  @return returns 0 upon success and non-zero otherwise
+
+  @see ComputeSPMV
+  @see ComputeDotProduct
+*/
+int ComputeSPMVDotProduct(const SparseMatrix & A, Vector & x, Vector & y,
+    double & result, double & time_allreduce) {
+
+  if (A.optimizationData == 0) {
+    int ierr = ComputeSPMV(A, x, y);
+    if (ierr) return ierr;
+    return ComputeDotProduct(A.localNumberOfRows, x, y, result, time_allreduce, A.isDotProductOptimized);
+  }
+  double local_result = ComputeSPMVOptimized(A, x, y, true);
+
+#ifndef HPCG_NO_MPI
+  double t0 = mytimer();
+  double global_result = 0.0;
+  MPI_Allreduce(&local_result, &global_result, 1, MPI_DOUBLE, MPI_SUM,
+      MPI_COMM_WORLD);
+  result = global_result;
+  time_allreduce += mytimer() - t0;
+#else
+  result = local_result;
+#endif
+
+  return 0;
 }
@@ -18,5 +18,7 @@
 #include "SparseMatrix.hpp"
 
 int ComputeSPMV( const SparseMatrix & A, Vector & x, Vector & y);
+int ComputeSPMVDotProduct(const SparseMatrix & A, Vector & x, Vector & y,
+    double & result, double & time_allreduce);
 
 #endif  // COMPUTESPMV_HPP
@@ -20,6 +20,39 @@
 
 #include "ComputeSYMGS.hpp"
 #include "ComputeSYMGS_ref.hpp"
+#include "OptimizeProblem.hpp"
+#ifndef HPCG_NO_MPI
+#include "ExchangeHalo.hpp"
+#endif
+
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
+#include <cassert>
+
+/*!
+  Updates the rows of one SELL chunk, which are of one color and so do not
+  read each other: x[i] += (r[i] - A[i]*x)/A[i][i].
+*/
+static inline void ComputeSYMGSChunk(const OptimizationData & od, local_int_t k,
+    const double * const rv, double * const xv) {
+  const local_int_t offset = od.chunkOffset[k];
+  const local_int_t width = (od.chunkOffset[k+1] - offset)/HPCG_SELL_C;
+  const double * const vals = &od.values[offset];
+  const local_int_t * const inds = &od.columns[offset];
+  double sum[HPCG_SELL_C];
+  for (int s=0; s<HPCG_SELL_C; s++) sum[s] = 0.0;
+  for (local_int_t j=0; j<width; j++)
+    for (int s=0; s<HPCG_SELL_C; s++)
+      sum[s] += vals[j*HPCG_SELL_C+s]*xv[inds[j*HPCG_SELL_C+s]];
+
+  const local_int_t * const rows = &od.rows[k*HPCG_SELL_C];
+  const double * const diag = &od.diagonal[k*HPCG_SELL_C];
+  for (int s=0; s<HPCG_SELL_C; s++) {
+    if (rows[s] < 0) continue;
+    xv[rows[s]] += (rv[rows[s]] - sum[s])/diag[s];
+  }
+}
 
 /*!
   Routine to one step of symmetrix Gauss-Seidel:
@@ -45,11 +78,70 @@
 
   @warning Early versions of this kernel (Version 1.1 and earlier) had the r and x arguments in reverse order, and out of sync with other kernels.
 
+  Multicolor notes:
+  - With the OptimizationData of OptimizeProblem (HPCG_USE_OPTIMIZED_KERNELS) the
+    rows are swept color by color, first to last and back, and the rows of a
+    color in parallel. This is a Gauss-Seidel in the multicolor ordering, so CG
+    may need more iterations than with the natural ordering of ComputeSYMGS_ref.
+  - The interior rows of the first color are updated while the halo is in flight.
+  - Without it the reference implementation is called.
+
   @see ComputeSYMGS_ref
 */
 int ComputeSYMGS( const SparseMatrix & A, const Vector & r, Vector & x) {
 
-  // This line and the next two lines should be removed and your version of ComputeSYMGS should be used.
-  return ComputeSYMGS_ref(A, r, x);
+  if (A.optimizationData == 0) return ComputeSYMGS_ref(A, r, x);
+
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+
+  OptimizationData & od = *(OptimizationData *) A.optimizationData;
+  const double * const rv = r.values;
+  double * const xv = x.values;
+  const int numberOfColors = od.numberOfColors;
+  local_int_t firstChunk = od.colorChunks[0];
+#ifndef HPCG_NO_MPI
+  firstChunk = od.colorChunks[1];
+#endif
+
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel
+#endif
+  {
+#ifndef HPCG_NO_MPI
+#ifndef HPCG_NO_OPENMP
+    #pragma omp single nowait
+#endif
+    ExchangeHaloBegin(A, x);
+#ifndef HPCG_NO_OPENMP
+    #pragma omp for
+#endif
+    for (local_int_t k=od.colorChunks[0]; k<od.colorChunks[1]; k++)
+      ComputeSYMGSChunk(od, k, rv, xv);
+#ifndef HPCG_NO_OPENMP
+    #pragma omp single
+#endif
+    ExchangeHaloEnd(A, x);
+#endif
+
+    // Forward sweep
+    for (int c=0; c<numberOfColors; c++) {
+      local_int_t first = c==0 ? firstChunk : od.colorChunks[2*c];
+#ifndef HPCG_NO_OPENMP
+      #pragma omp for
+#endif
+      for (local_int_t k=first; k<od.colorChunks[2*c+2]; k++)
+        ComputeSYMGSChunk(od, k, rv, xv);
+    }
+
+    // Back sweep
+    for (int c=numberOfColors-1; c>=0; c--) {
+#ifndef HPCG_NO_OPENMP
+      #pragma omp for
+#endif
+      for (local_int_t k=od.colorChunks[2*c]; k<od.colorChunks[2*c+2]; k++)
+        ComputeSYMGSChunk(od, k, rv, xv);
+    }
+  }
 
+  return 0;
 }
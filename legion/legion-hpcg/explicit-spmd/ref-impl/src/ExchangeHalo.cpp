@@ -21,18 +21,47 @@
 // Compile this routine only if running with MPI
 #ifndef HPCG_NO_MPI
 #include <mpi.h>
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
 #include "Geometry.hpp"
 #include "ExchangeHalo.hpp"
 #include <cstdlib>
 
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES) && defined(HPCG_USE_PERSISTENT_HALO)
+#error "HPCG_USE_NEIGHBOR_COLLECTIVES and HPCG_USE_PERSISTENT_HALO are exclusive"
+#endif
+
+/*!
+  Fills the send buffer of A with the border entries of x, all neighbors' in one go.
+ */
+static void PackSendBuffer(const SparseMatrix & A, const double * const xv) {
+
+  double * const sendBuffer = A.sendBuffer;
+  const local_int_t * const elementsToSend = A.elementsToSend;
+  const local_int_t totalToBeSent = A.totalToBeSent;
+
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
+  for (local_int_t i=0; i<totalToBeSent; i++) sendBuffer[i] = xv[elementsToSend[i]];
+}
+
 /*!
   Communicates data that is at the border of the part of the domain assigned to this processor.
 
+  With HPCG_USE_NEIGHBOR_COLLECTIVES or HPCG_USE_PERSISTENT_HALO this is
+  ExchangeHaloBegin followed by ExchangeHaloEnd.
+
   @param[in]    A The known system matrix
   @param[inout] x On entry: the local vector entries followed by entries to be communicated; on exit: the vector with non-local entries updated by other processors
  */
 void ExchangeHalo(const SparseMatrix & A, Vector & x) {
 
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES) || defined(HPCG_USE_PERSISTENT_HALO)
+  ExchangeHaloBegin(A, x);
+  ExchangeHaloEnd(A, x);
+#else
   // Extract Matrix pieces
 
   local_int_t localNumberOfRows = A.localNumberOfRows;
@@ -41,8 +70,6 @@ void ExchangeHalo(const SparseMatrix & A, Vector & x) {
   local_int_t * sendLength = A.sendLength;
   int * neighbors = A.neighbors;
   double * sendBuffer = A.sendBuffer;
-  local_int_t totalToBeSent = A.totalToBeSent;
-  local_int_t * elementsToSend = A.elementsToSend;
 
   double * const xv = x.values;
 
@@ -78,8 +105,7 @@ void ExchangeHalo(const SparseMatrix & A, Vector & x) {
   // Fill up send buffer
   //
 
-  // TODO: Thread this loop
-  for (local_int_t i=0; i<totalToBeSent; i++) sendBuffer[i] = xv[elementsToSend[i]];
+  PackSendBuffer(A, xv);
 
   //
   // Send to each neighbor
@@ -106,6 +132,92 @@ void ExchangeHalo(const SparseMatrix & A, Vector & x) {
 
   delete [] request;
 
+  return;
+#endif
+}
+
+/*!
+  Starts the exchange of ExchangeHalo without waiting for it: fills the send
+  buffer, then starts
+
+  - one MPI_Ineighbor_alltoallv on A.haloComm with HPCG_USE_NEIGHBOR_COLLECTIVES,
+  - the persistent receives and sends of SetupHalo with HPCG_USE_PERSISTENT_HALO,
+  - an MPI_Irecv and an MPI_Isend per neighbor otherwise.
+
+  @param[in]    A The known system matrix
+  @param[inout] x The vector whose externals are received, not to be read before ExchangeHaloEnd
+ */
+void ExchangeHaloBegin(const SparseMatrix & A, Vector & x) {
+
+  double * const xv = x.values;
+
+  PackSendBuffer(A, xv);
+
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES)
+  MPI_Ineighbor_alltoallv(A.sendBuffer, A.sendLength, A.sendDisplacements, MPI_DOUBLE,
+      xv + A.localNumberOfRows, A.receiveLength, A.receiveDisplacements, MPI_DOUBLE,
+      A.haloComm, A.haloRequests);
+#elif defined(HPCG_USE_PERSISTENT_HALO)
+  MPI_Startall(2*A.numberOfSendNeighbors, A.haloRequests);
+#else
+  int num_neighbors = A.numberOfSendNeighbors;
+  local_int_t * receiveLength = A.receiveLength;
+  local_int_t * sendLength = A.sendLength;
+  int * neighbors = A.neighbors;
+  double * sendBuffer = A.sendBuffer;
+  double * x_external = xv + A.localNumberOfRows;
+
+  int MPI_MY_TAG = 99;
+
+  for (int i = 0; i < num_neighbors; i++) {
+    local_int_t n_recv = receiveLength[i];
+    MPI_Irecv(x_external, n_recv, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+i);
+    x_external += n_recv;
+  }
+
+  // The send buffer is only reused by the next ExchangeHaloBegin, after the
+  // ExchangeHaloEnd of this one
+  for (int i = 0; i < num_neighbors; i++) {
+    local_int_t n_send = sendLength[i];
+    MPI_Isend(sendBuffer, n_send, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+num_neighbors+i);
+    sendBuffer += n_send;
+  }
+#endif
+
+  return;
+}
+
+/*!
+  Completes the exchange started by ExchangeHaloBegin. The persistent
+  receives land in A.receiveBuffer and are copied to the externals of x here.
+
+  @param[in]    A The known system matrix
+  @param[inout] x The vector of ExchangeHaloBegin, with its externals updated on exit
+ */
+void ExchangeHaloEnd(const SparseMatrix & A, Vector & x) {
+
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES)
+  if ( MPI_Wait(A.haloRequests, MPI_STATUS_IGNORE) ) {
+    std::exit(-1); // TODO: have better error exit
+  }
+#else
+  if ( MPI_Waitall(2*A.numberOfSendNeighbors, A.haloRequests, MPI_STATUSES_IGNORE) ) {
+    std::exit(-1); // TODO: have better error exit
+  }
+#endif
+
+#if defined(HPCG_USE_PERSISTENT_HALO)
+  double * const x_external = x.values + A.localNumberOfRows;
+  const double * const receiveBuffer = A.receiveBuffer;
+  const local_int_t numberOfExternalValues = A.numberOfExternalValues;
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
+  for (local_int_t i=0; i<numberOfExternalValues; i++) x_external[i] = receiveBuffer[i];
+#else
+  (void) x; // the receives went to the externals of x directly
+#endif
+
   return;
 }
 #endif
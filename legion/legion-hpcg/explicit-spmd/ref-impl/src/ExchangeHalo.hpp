@@ -17,4 +17,8 @@
 #include "SparseMatrix.hpp"
 #include "Vector.hpp"
 void ExchangeHalo(const SparseMatrix & A, Vector & x);
+// Split form of ExchangeHalo, so that work not reading the halo of x can go
+// on between the two. One exchange per matrix at a time, on A.haloRequests.
+void ExchangeHaloBegin(const SparseMatrix & A, Vector & x);
+void ExchangeHaloEnd(const SparseMatrix & A, Vector & x);
 #endif // EXCHANGEHALO_HPP
@@ -18,7 +18,100 @@
  HPCG routine
  */
 
+#include <algorithm>
+#include <cmath>
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
 #include "OptimizeProblem.hpp"
+#include "ComputeSPMV.hpp"
+
+#if defined(HPCG_USE_OPTIMIZED_KERNELS)
+/*!
+  Builds the OptimizationData of one level: colors the rows greedily (a
+  likely non-optimal coloring, 8 colors for the 27-point stencil), sorts them
+  by color and interior/boundary, and packs them in SELL chunks.
+
+  @param[in] A The matrix of the level, after SetupHalo
+
+  @return the OptimizationData, to be freed by DeleteOptimizationData
+*/
+static OptimizationData * OptimizeLevel(const SparseMatrix & A) {
+  const local_int_t nrow = A.localNumberOfRows;
+  const local_int_t C = HPCG_SELL_C;
+
+  // Smallest color not taken by an already colored (lower) neighbor
+  std::vector<int> colors(nrow, 0);
+  int totalColors = 0;
+  for (local_int_t i=0; i < nrow; ++i) {
+    std::vector<bool> assigned(totalColors+1, false);
+    for (int j=0; j < A.nonzerosInRow[i]; j++) {
+      local_int_t curCol = A.mtxIndL[i][j];
+      if (curCol < i) assigned[colors[curCol]] = true;
+    }
+    int c = 0;
+    while (assigned[c]) ++c;
+    colors[i] = c;
+    if (c == totalColors) ++totalColors;
+  }
+
+  // Bucket 2*c holds the interior rows of color c, 2*c+1 its boundary rows
+  const int numberOfBuckets = 2*totalColors;
+  std::vector<int> bucket(nrow);
+  std::vector<local_int_t> bucketStart(numberOfBuckets+1, 0);
+  for (local_int_t i=0; i < nrow; ++i) {
+    bool boundary = false;
+    for (int j=0; j < A.nonzerosInRow[i]; j++)
+      if (A.mtxIndL[i][j] >= nrow) boundary = true;
+    bucket[i] = 2*colors[i] + (boundary ? 1 : 0);
+    ++bucketStart[bucket[i]+1];
+  }
+  for (int b=0; b < numberOfBuckets; ++b) bucketStart[b+1] += bucketStart[b];
+  std::vector<local_int_t> order(nrow);
+  std::vector<local_int_t> next(bucketStart.begin(), bucketStart.end()-1);
+  for (local_int_t i=0; i < nrow; ++i) order[next[bucket[i]]++] = i;
+
+  OptimizationData * od = new OptimizationData;
+  od->numberOfColors = totalColors;
+  od->chebyshev = false;
+  od->lambdaMax = 0.0;
+  od->residual.values = od->direction.values = od->product.values = 0;
+  od->colorChunks.assign(numberOfBuckets+1, 0);
+  od->chunkOffset.push_back(0);
+  for (int b=0; b < numberOfBuckets; ++b) {
+    od->colorChunks[b] = od->chunkOffset.size()-1;
+    for (local_int_t first = bucketStart[b]; first < bucketStart[b+1]; first += C) {
+      local_int_t last = std::min(first+C, bucketStart[b+1]);
+      int width = 0;
+      for (local_int_t p = first; p < last; ++p)
+        width = std::max(width, (int) A.nonzerosInRow[order[p]]);
+      local_int_t offset = od->chunkOffset.back();
+      od->chunkOffset.push_back(offset + width*C);
+      // Padding reads the first row of the chunk with a zero coefficient
+      od->values.resize(offset + width*C, 0.0);
+      od->columns.resize(offset + width*C, order[first]);
+      for (local_int_t s = 0; s < C; ++s) {
+        local_int_t p = first+s;
+        if (p >= last) {
+          od->rows.push_back(-1);
+          od->diagonal.push_back(1.0);
+          continue;
+        }
+        local_int_t i = order[p];
+        od->rows.push_back(i);
+        od->diagonal.push_back(*A.matrixDiagonal[i]);
+        for (int j=0; j < A.nonzerosInRow[i]; j++) {
+          od->values[offset + j*C + s] = A.matrixValues[i][j];
+          od->columns[offset + j*C + s] = A.mtxIndL[i][j];
+        }
+      }
+    }
+  }
+  od->colorChunks[numberOfBuckets] = od->chunkOffset.size()-1;
+  return od;
+}
+#endif
+
 /*!
   Optimizes the data structures used for CG iteration to increase the
   performance of the benchmark version of the preconditioned CG algorithm.
@@ -36,71 +129,109 @@
 */
 int OptimizeProblem(SparseMatrix & A, CGData & data, Vector & b, Vector & x, Vector & xexact) {
 
-  // This function can be used to completely transform any part of the data structures.
-  // Right now it does nothing, so compiling with a check for unused variables results in complaints
+  // Only the matrices are transformed: the rows keep their numbering, so the
+  // vectors, the halos and the MG transfers are those of the reference.
+  // Without HPCG_USE_OPTIMIZED_KERNELS no OptimizationData is built and the
+  // kernels fall back to the reference ones.
 
-#if defined(HPCG_USE_MULTICOLORING)
-  const local_int_t nrow = A.localNumberOfRows;
-  std::vector<local_int_t> colors(nrow, nrow); // value `nrow' means `uninitialized'; initialized colors go from 0 to nrow-1
-  int totalColors = 1;
-  colors[0] = 0; // first point gets color 0
-
-  // Finds colors in a greedy (a likely non-optimal) fashion.
-
-  for (local_int_t i=1; i < nrow; ++i) {
-    if (colors[i] == nrow) { // if color not assigned
-      std::vector<int> assigned(totalColors, 0);
-      int currentlyAssigned = 0;
-      const local_int_t * const currentColIndices = A.mtxIndL[i];
-      const int currentNumberOfNonzeros = A.nonzerosInRow[i];
-
-      for (int j=0; j< currentNumberOfNonzeros; j++) { // scan neighbors
-        local_int_t curCol = currentColIndices[j];
-        if (curCol < i) { // if this point has an assigned color (points beyond `i' are unassigned)
-          if (assigned[colors[curCol]] == 0)
-            currentlyAssigned += 1;
-          assigned[colors[curCol]] = 1; // this color has been used before by `curCol' point
-        } // else // could take advantage of indices being sorted
-      }
+#if defined(HPCG_USE_OPTIMIZED_KERNELS)
+  for (SparseMatrix * curLevelMatrix = &A; curLevelMatrix != 0; curLevelMatrix = curLevelMatrix->Ac) {
+    DeleteOptimizationData(*curLevelMatrix);
+    curLevelMatrix->optimizationData = OptimizeLevel(*curLevelMatrix);
+  }
+#endif
 
-      if (currentlyAssigned < totalColors) { // if there is at least one color left to use
-        for (int j=0; j < totalColors; ++j)  // try all current colors
-          if (assigned[j] == 0) { // if no neighbor with this color
-            colors[i] = j;
-            break;
-          }
-      } else {
-        if (colors[i] == nrow) {
-          colors[i] = totalColors;
-          totalColors += 1;
-        }
-      }
+  return 0;
+}
+
+/*!
+  Estimates the largest eigenvalue of D^-1*A, D the diagonal of A, by power iterations from a vector of
+  the global row numbers, so that the estimate does not depend on the number of processes: the Rayleigh
+  quotient v'*A*v/v'*D*v of the last iterate, which is below the eigenvalue.
+
+  @param[in]    A  The matrix of the level, with its OptimizationData for ComputeSPMV
+  @param[inout] od The OptimizationData of A, with its vectors and inverseDiagonal allocated
+
+  @return the estimate
+*/
+static double EstimateLambdaMax(const SparseMatrix & A, OptimizationData & od) {
+  const local_int_t nrow = A.localNumberOfRows;
+  const double * const invD = &od.inverseDiagonal[0];
+  double * const vv = od.direction.values;
+  double * const avv = od.product.values;
+
+  for (local_int_t i=0; i < nrow; ++i)
+    vv[i] = ((A.localToGlobalMap[i]*2654435761ULL) % 1024)/1024.0 - 0.5;
+
+  double lambda = 0.0;
+  for (int k=0; k < HPCG_CHEBYSHEV_POWER_ITERATIONS; ++k) {
+    ComputeSPMV(A, od.direction, od.product);
+    double local[3] = {0.0, 0.0, 0.0}; // v'*A*v, v'*D*v and |D^-1*A*v|^2
+    for (local_int_t i=0; i < nrow; ++i) {
+      local[0] += vv[i]*avv[i];
+      local[1] += vv[i]*vv[i]/invD[i];
+      local[2] += invD[i]*avv[i]*invD[i]*avv[i];
     }
+    double global[3] = {local[0], local[1], local[2]};
+#ifndef HPCG_NO_MPI
+    MPI_Allreduce(local, global, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+    lambda = global[0]/global[1];
+    const double scale = 1.0/std::sqrt(global[2]);
+    for (local_int_t i=0; i < nrow; ++i) vv[i] = invD[i]*avv[i]*scale;
   }
+  return lambda;
+}
 
-  std::vector<local_int_t> counters(totalColors);
-  for (local_int_t i=0; i<nrow; ++i)
-    counters[colors[i]]++;
+int SetupChebyshev(SparseMatrix & A, int levels) {
 
-  local_int_t old, old0;
-  for (int i=1; i < totalColors; ++i) {
-    old0 = counters[i];
-    counters[i] = counters[i-1] + old;
-    old = old0;
-  }
-  counters[0] = 0;
+  if (levels == 0) return 0;
 
-  // translate `colors' into a permutation
-  for (local_int_t i=0; i<nrow; ++i) // for each color `c'
-    colors[i] = counters[colors[i]]++;
-#endif
+  int level = 0;
+  for (SparseMatrix * curLevelMatrix = &A; curLevelMatrix != 0; curLevelMatrix = curLevelMatrix->Ac, ++level) {
+    OptimizationData * od = (OptimizationData *) curLevelMatrix->optimizationData;
+    if (od == 0) return -1;
+    if (!(levels & (1 << level)) || od->chebyshev) continue;
+
+    const local_int_t nrow = curLevelMatrix->localNumberOfRows;
+    od->inverseDiagonal.resize(nrow);
+    for (local_int_t i=0; i < nrow; ++i) od->inverseDiagonal[i] = 1.0/(*curLevelMatrix->matrixDiagonal[i]);
+    InitializeVector(od->residual, nrow);
+    InitializeVector(od->direction, curLevelMatrix->localNumberOfColumns);
+    InitializeVector(od->product, nrow);
+    ZeroVector(od->direction);
 
+    od->lambdaMax = EstimateLambdaMax(*curLevelMatrix, *od);
+    od->chebyshev = true;
+  }
   return 0;
 }
 
+void DeleteOptimizationData(SparseMatrix & A) {
+  for (SparseMatrix * curLevelMatrix = &A; curLevelMatrix != 0; curLevelMatrix = curLevelMatrix->Ac) {
+    OptimizationData * od = (OptimizationData *) curLevelMatrix->optimizationData;
+    if (od != 0) {
+      DeleteVector(od->residual);
+      DeleteVector(od->direction);
+      DeleteVector(od->product);
+    }
+    delete od;
+    curLevelMatrix->optimizationData = 0;
+  }
+}
+
 // Helper function (see OptimizeProblem.hpp for details)
 double OptimizeProblemMemoryUse(const SparseMatrix & A) {
 
-  return 0.0;
+  double numberOfBytes = 0.0;
+  for (const SparseMatrix * curLevelMatrix = &A; curLevelMatrix != 0; curLevelMatrix = curLevelMatrix->Ac) {
+    const OptimizationData * od = (const OptimizationData *) curLevelMatrix->optimizationData;
+    if (od == 0) continue;
+    numberOfBytes += sizeof(OptimizationData);
+    numberOfBytes += (od->colorChunks.size() + od->chunkOffset.size() + od->rows.size() + od->columns.size())*sizeof(local_int_t);
+    numberOfBytes += (od->diagonal.size() + od->values.size() + od->inverseDiagonal.size())*sizeof(double);
+    numberOfBytes += (od->residual.localLength + od->direction.localLength + od->product.localLength)*sizeof(double);
+  }
+  return numberOfBytes;
 
 }
@@ -15,12 +15,65 @@
 #ifndef OPTIMIZEPROBLEM_HPP
 #define OPTIMIZEPROBLEM_HPP
 
+#include <vector>
 #include "SparseMatrix.hpp"
 #include "Vector.hpp"
 #include "CGData.hpp"
 
+//! Rows per chunk of the SELL format of OptimizationData
+#define HPCG_SELL_C 8
+
+//! Degree of the Chebyshev smoother, one SpMV per degree past the first
+#define HPCG_CHEBYSHEV_DEGREE 2
+//! Power iterations estimating the largest eigenvalue for the Chebyshev smoother
+#define HPCG_CHEBYSHEV_POWER_ITERATIONS 10
+//! The Chebyshev smoother damps the eigenvalues of D^-1*A from this fraction of the estimate up
+#define HPCG_CHEBYSHEV_LOWER 0.3
+//! and up to this multiple of it, the power iterations underestimate it
+#define HPCG_CHEBYSHEV_UPPER 1.1
+
+/*!
+  The matrix of one level in the SELL-C format (sliced ELLPACK), built by
+  OptimizeProblem with HPCG_USE_OPTIMIZED_KERNELS and kept in
+  SparseMatrix::optimizationData for the optimized SPMV, SYMGS and MG.
+
+  The rows are ordered by color, no two rows of a color are coupled, and
+  within a color the interior rows (no halo column) come before the boundary
+  rows. Chunks of HPCG_SELL_C rows of one color and kind store their entries
+  column by column: entry j of the row in slot s of chunk k is at
+  chunkOffset[k] + j*HPCG_SELL_C + s. Slots past the last row of a color have
+  row -1, and entries past the end of a row are zeros.
+
+  The entries are copies, so OptimizeProblem must run again after the matrix
+  changes (ReplaceMatrixDiagonal in TestCG).
+*/
+struct OptimizationData_STRUCT {
+  int numberOfColors; //!< number of colors of the ordering
+  std::vector<local_int_t> colorChunks; //!< chunks of color c are colorChunks[2*c] to colorChunks[2*c+2], the interior ones before colorChunks[2*c+1]
+  std::vector<local_int_t> chunkOffset; //!< first entry of each chunk, and the number of entries at the end
+  std::vector<local_int_t> rows; //!< row of each slot, -1 for padding
+  std::vector<double> diagonal; //!< diagonal value of each slot, 1.0 for padding
+  std::vector<double> values; //!< entries of the chunks
+  std::vector<local_int_t> columns; //!< local column of each entry
+  // Set by SetupChebyshev, for the levels smoothed by ComputeChebyshev
+  bool chebyshev; //!< the level is smoothed by ComputeChebyshev instead of ComputeSYMGS
+  double lambdaMax; //!< estimate of the largest eigenvalue of D^-1*A
+  std::vector<double> inverseDiagonal; //!< 1/A[i][i] of each row
+  Vector residual; //!< r - A*x, localNumberOfRows long
+  Vector direction; //!< the update of x, localNumberOfColumns long for its halo
+  Vector product; //!< A*direction, localNumberOfRows long
+};
+typedef struct OptimizationData_STRUCT OptimizationData;
+
 int OptimizeProblem(SparseMatrix & A, CGData & data,  Vector & b, Vector & x, Vector & xexact);
 
+// Smooths the levels l of A with bit l of levels set by ComputeChebyshev, after OptimizeProblem; returns -1 without
+// OptimizationData (HPCG_USE_OPTIMIZED_KERNELS).
+int SetupChebyshev(SparseMatrix & A, int levels);
+
+// Frees the OptimizationData of A and its coarse levels, before DeleteMatrix.
+void DeleteOptimizationData(SparseMatrix & A);
+
 // This helper function should be implemented in a non-trivial way if OptimizeProblem is non-trivial
 // It should return as type double, the total number of bytes allocated and retained after calling OptimizeProblem.
 // This value will be used to report Gbytes used in ReportResults (the value returned will be divided by 1000000000.0).
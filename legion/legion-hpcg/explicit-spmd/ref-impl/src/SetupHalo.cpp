@@ -45,5 +45,39 @@ void SetupHalo(SparseMatrix & A) {
   // However, any code must work for general unstructured sparse matrices.  Special knowledge about the
   // specific nature of the sparsity pattern may not be explicitly used.
 
-  return(SetupHalo_ref(A));
+  SetupHalo_ref(A);
+
+#ifndef HPCG_NO_MPI
+  // Communication structures of ExchangeHaloBegin. The neighbors are both the
+  // sources and the destinations, with the messages in the order of neighbors.
+  int num_neighbors = A.numberOfSendNeighbors;
+  A.haloRequests = new MPI_Request[2*num_neighbors+1]; // At least one for the neighbor collective
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES)
+  A.sendDisplacements = new int[num_neighbors];
+  A.receiveDisplacements = new int[num_neighbors];
+  int sendOffset = 0, receiveOffset = 0;
+  for (int i = 0; i < num_neighbors; i++) {
+    A.sendDisplacements[i] = sendOffset;
+    A.receiveDisplacements[i] = receiveOffset;
+    sendOffset += A.sendLength[i];
+    receiveOffset += A.receiveLength[i];
+  }
+  MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, num_neighbors, A.neighbors, MPI_UNWEIGHTED,
+      num_neighbors, A.neighbors, MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &A.haloComm);
+#elif defined(HPCG_USE_PERSISTENT_HALO)
+  // The receives go to one buffer, for any vector, and ExchangeHaloEnd copies them out
+  A.receiveBuffer = new double[A.numberOfExternalValues];
+  int MPI_MY_TAG = 99;
+  double * receiveBuffer = A.receiveBuffer;
+  double * sendBuffer = A.sendBuffer;
+  for (int i = 0; i < num_neighbors; i++) {
+    MPI_Recv_init(receiveBuffer, A.receiveLength[i], MPI_DOUBLE, A.neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+i);
+    MPI_Send_init(sendBuffer, A.sendLength[i], MPI_DOUBLE, A.neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+num_neighbors+i);
+    receiveBuffer += A.receiveLength[i];
+    sendBuffer += A.sendLength[i];
+  }
+#endif
+#endif
+
+  return;
 }
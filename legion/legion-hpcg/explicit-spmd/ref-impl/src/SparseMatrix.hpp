@@ -21,6 +21,9 @@
 #ifndef SPARSEMATRIX_HPP
 #define SPARSEMATRIX_HPP
 
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
 #include <map>
 #include <vector>
 #include <cassert>
@@ -64,6 +67,11 @@ struct SparseMatrix_STRUCT {
   local_int_t * receiveLength; //!< lenghts of messages received from neighboring processes
   local_int_t * sendLength; //!< lenghts of messages sent to neighboring processes
   double * sendBuffer; //!< send buffer for non-blocking sends
+  MPI_Request * haloRequests; //!< requests of ExchangeHaloBegin, the persistent ones with HPCG_USE_PERSISTENT_HALO
+  double * receiveBuffer; //!< receive buffer of the persistent receives (HPCG_USE_PERSISTENT_HALO)
+  MPI_Comm haloComm; //!< graph communicator of the neighbors (HPCG_USE_NEIGHBOR_COLLECTIVES)
+  int * sendDisplacements; //!< offsets of the messages to the neighbors in sendBuffer (HPCG_USE_NEIGHBOR_COLLECTIVES)
+  int * receiveDisplacements; //!< offsets of the messages from the neighbors in the externals (HPCG_USE_NEIGHBOR_COLLECTIVES)
 #endif
 };
 typedef struct SparseMatrix_STRUCT SparseMatrix;
@@ -103,9 +111,15 @@ inline void InitializeSparseMatrix(SparseMatrix & A, Geometry * geom) {
   A.receiveLength = 0;
   A.sendLength = 0;
   A.sendBuffer = 0;
+  A.haloRequests = 0;
+  A.receiveBuffer = 0;
+  A.haloComm = MPI_COMM_NULL;
+  A.sendDisplacements = 0;
+  A.receiveDisplacements = 0;
 #endif
   A.mgData = 0; // Fine-to-coarse grid transfer initially not defined.
   A.Ac =0;
+  A.optimizationData = 0; // Built by OptimizeProblem, if at all
   return;
 }
 
@@ -161,6 +175,15 @@ inline void DeleteMatrix(SparseMatrix & A) {
   if (A.receiveLength)            delete [] A.receiveLength;
   if (A.sendLength)            delete [] A.sendLength;
   if (A.sendBuffer)            delete [] A.sendBuffer;
+#if defined(HPCG_USE_PERSISTENT_HALO)
+  if (A.haloRequests)
+    for (int i = 0; i < 2*A.numberOfSendNeighbors; ++i) MPI_Request_free(A.haloRequests+i);
+#endif
+  if (A.haloRequests)            delete [] A.haloRequests;
+  if (A.receiveBuffer)            delete [] A.receiveBuffer;
+  if (A.haloComm != MPI_COMM_NULL) MPI_Comm_free(&A.haloComm);
+  if (A.sendDisplacements)            delete [] A.sendDisplacements;
+  if (A.receiveDisplacements)            delete [] A.receiveDisplacements;
 #endif
 
   if (A.geom!=0) { delete A.geom; A.geom = 0;}
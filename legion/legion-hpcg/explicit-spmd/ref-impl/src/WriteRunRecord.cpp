@@ -0,0 +1,237 @@
+
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+/*!
+ @file WriteRunRecord.cpp
+
+ HPCG routine
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "WriteRunRecord.hpp"
+#include "OptimizeProblem.hpp"
+
+/*!
+  A JSON object written as it is built, the same record as the Legion
+  version's RunRecord. Members of an array take an empty key.
+*/
+class RunRecord {
+  std::ostringstream out;
+  std::vector<char> closers; // '}' or ']' of the open objects and arrays
+  std::vector<bool> hasMember;
+
+  static std::string quote(const std::string & s) {
+    std::string q = "\"";
+    for (size_t i = 0; i < s.size(); ++i) {
+      char c = s[i];
+      if (c == '"' || c == '\\') {
+        q += '\\';
+        q += c;
+      } else if ((unsigned char) c < 0x20) {
+        char esc[8];
+        sprintf(esc, "\\u%04x", c);
+        q += esc;
+      } else q += c;
+    }
+    return q + "\"";
+  }
+
+  void member(const std::string & key) {
+    if (hasMember.back()) out << ", ";
+    hasMember.back() = true;
+    if (closers.back() == '}') out << quote(key) << ": ";
+  }
+
+  void open(const std::string & key, char opener, char closer) {
+    member(key);
+    out << opener;
+    closers.push_back(closer);
+    hasMember.push_back(false);
+  }
+
+public:
+  RunRecord() {
+    out << "{";
+    closers.push_back('}');
+    hasMember.push_back(false);
+  }
+
+  void beginObject(const std::string & key) { open(key, '{', '}'); }
+  void beginArray(const std::string & key) { open(key, '[', ']'); }
+
+  void end() {
+    out << closers.back();
+    closers.pop_back();
+    hasMember.pop_back();
+  }
+
+  // Times divided by a zero time are not finite and written as null
+  void add(const std::string & key, double v) {
+    member(key);
+    if (v != v || v - v != 0.0) {
+      out << "null";
+      return;
+    }
+    char s[32];
+    sprintf(s, "%.17g", v);
+    out << s;
+  }
+  void add(const std::string & key, int v) { member(key); out << v; }
+  void add(const std::string & key, long long v) { member(key); out << v; }
+  void add(const std::string & key, bool v) { member(key); out << (v ? "true" : "false"); }
+  void add(const std::string & key, const std::string & v) { member(key); out << quote(v); }
+  void add(const std::string & key, const char * v) { add(key, std::string(v)); }
+
+  std::string str() const {
+    std::string s = out.str();
+    for (size_t i = closers.size(); i > 0; --i) s += closers[i - 1];
+    return s;
+  }
+};
+
+/*!
+  Writes the JSON record of the run to params.runRecordFile: the configuration, the process grid, the timed CG sets by
+  kernel and the GFLOP/s of the flop model of ReportResults. Called by rank 0 only.
+
+  @param[in] params The parameters of the run, the file of the record among them.
+  @param[in] A      The known system matrix
+  @param[in] numberOfMgLevels Number of levels in multigrid V cycle
+  @param[in] numberOfCgSets Number of timed CG sets
+  @param[in] optMaxIters Number of iterations of each CG set
+  @param[in] aveRuntime Average time of a CG set
+  @param[in] times  Vector of cumulative timings of the timed CG sets, times[7] and times[9] those of the optimization
+                    and setup phases
+
+  @return Returns zero on success and a non-zero value if the record could not be written.
+*/
+int WriteRunRecord(const HPCG_Params & params, const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int optMaxIters,
+    double aveRuntime, const std::vector< double > & times) {
+
+  const Geometry * geom = A.geom;
+  double fNumberOfCgSets = numberOfCgSets;
+  double fniters = fNumberOfCgSets * (double) optMaxIters;
+  double fnrow = A.totalNumberOfRows;
+  double fnnz = A.totalNumberOfNonzeros;
+
+  // The flop model of ReportResults
+  double fnops_ddot = (3.0*fniters+fNumberOfCgSets)*2.0*fnrow;
+  double fnops_waxpby = (3.0*fniters+fNumberOfCgSets)*2.0*fnrow;
+  double fnops_sparsemv = (fniters+fNumberOfCgSets)*2.0*fnnz;
+  double fnops_precond = 0.0;
+  const SparseMatrix * Af = &A;
+  for (int i=1; i<numberOfMgLevels; ++i) {
+    double fnnz_Af = Af->totalNumberOfNonzeros;
+    double steps = Af->mgData->numberOfPresmootherSteps + Af->mgData->numberOfPostsmootherSteps;
+    fnops_precond += fniters*(4.0*steps + 2.0)*fnnz_Af;
+    Af = Af->Ac;
+  }
+  fnops_precond += fniters*4.0*((double) Af->totalNumberOfNonzeros);
+  double fnops = fnops_ddot+fnops_waxpby+fnops_sparsemv+fnops_precond;
+
+  RunRecord r;
+  r.add("benchmark", "HPCG");
+  r.add("version", "3.0");
+  r.add("implementation", "MPI");
+  r.add("options", "");
+
+  r.beginObject("config");
+  r.add("nx", params.nx);
+  r.add("ny", params.ny);
+  r.add("nz", params.nz);
+  r.add("runningTime", params.runningTime);
+  r.add("numThreads", params.numThreads);
+#ifdef HPCG_USE_OPTIMIZED_KERNELS
+  r.add("optimizedKernels", A.optimizationData != 0);
+#else
+  r.add("optimizedKernels", false);
+#endif
+  // The smoother of each MG level, the finest first (--smoother=LIST)
+  r.beginArray("smoothers");
+  for (int level = 0; level < numberOfMgLevels; ++level)
+    r.add("", (params.chebyshevLevels >> level) & 1 ? "cheb" : "symgs");
+  r.end();
+  r.add("skipValidation", params.skipValidation != 0);
+#if defined(HPCG_USE_NEIGHBOR_COLLECTIVES)
+  r.add("haloExchange", "neighbor");
+#elif defined(HPCG_USE_PERSISTENT_HALO)
+  r.add("haloExchange", "persistent");
+#else
+  r.add("haloExchange", "point-to-point");
+#endif
+  r.end();
+
+  r.beginObject("grid");
+  r.add("size", geom->size);
+  r.add("npx", geom->npx);
+  r.add("npy", geom->npy);
+  r.add("npz", geom->npz);
+  r.add("nx", (long long) geom->nx);
+  r.add("ny", (long long) geom->ny);
+  r.add("nz", (long long) geom->nz);
+  r.add("globalNx", (long long) geom->npx*geom->nx);
+  r.add("globalNy", (long long) geom->npy*geom->ny);
+  r.add("globalNz", (long long) geom->npz*geom->nz);
+  r.end();
+
+  r.beginObject("problem");
+  r.add("rows", (long long) A.totalNumberOfRows);
+  r.add("nonzeros", (long long) A.totalNumberOfNonzeros);
+  r.add("mgLevels", numberOfMgLevels);
+  r.end();
+
+  r.beginObject("cg");
+  r.add("iterations", optMaxIters);
+  r.add("sets", numberOfCgSets);
+  r.add("time", aveRuntime*fNumberOfCgSets);
+  r.add("timePerIteration", aveRuntime/optMaxIters);
+  r.end();
+
+  // Times of one CG set, those of the kernels on rank 0
+  r.beginObject("times");
+  r.add("total", times[0]/fNumberOfCgSets);
+  r.add("ddot", times[1]/fNumberOfCgSets);
+  r.add("waxpby", times[2]/fNumberOfCgSets);
+  r.add("spmv", times[3]/fNumberOfCgSets);
+  r.add("mg", times[5]/fNumberOfCgSets);
+  r.add("allReduce", times[4]/fNumberOfCgSets);
+  r.add("setup", times[9]);
+  r.add("optimization", times[7]);
+  r.end();
+
+  r.beginObject("gflops");
+  r.add("ddot", fnops_ddot/times[1]/1.0e9);
+  r.add("waxpby", fnops_waxpby/times[2]/1.0e9);
+  r.add("spmv", fnops_sparsemv/times[3]/1.0e9);
+  r.add("mg", fnops_precond/times[5]/1.0e9);
+  r.add("total", fnops/times[0]/1.0e9);
+  r.end();
+
+  r.beginObject("memory");
+  r.add("optimizeProblemGB", OptimizeProblemMemoryUse(A)/1.0e9);
+  r.end();
+
+  r.beginObject("overheads");
+  r.add("allReduceFraction", times[4]/times[0]);
+  r.end();
+
+  std::ofstream f(params.runRecordFile);
+  f << r.str() << std::endl;
+  return f ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+#ifndef WRITERUNRECORD_HPP
+#define WRITERUNRECORD_HPP
+#include <vector>
+#include "hpcg.hpp"
+#include "SparseMatrix.hpp"
+
+int WriteRunRecord(const HPCG_Params & params, const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int optMaxIters,
+    double aveRuntime, const std::vector< double > & times);
+#endif // WRITERUNRECORD_HPP
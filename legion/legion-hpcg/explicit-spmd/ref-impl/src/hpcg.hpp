@@ -33,6 +33,9 @@ struct HPCG_Params_STRUCT {
   int ny; //!< Number of y-direction grid points for each local subdomain
   int nz; //!< Number of z-direction grid points for each local subdomain
   int runningTime; //!< Number of seconds to run the timed portion of the benchmark
+  int chebyshevLevels; //!< Bit l set: MG level l, 0 the finest, is smoothed by ComputeChebyshev instead of ComputeSYMGS (--smoother=LIST)
+  int skipValidation; //!< Nonzero: CheckProblem and the comparison with the exact solution are skipped, the run is not a valid HPCG result (--skip-validation)
+  char runRecordFile[256]; //!< File rank 0 writes the JSON record of the run to, empty for none (--record=FILE)
 };
 /*!
   HPCG_Params is a shorthand for HPCG_Params_STRUCT
@@ -28,6 +28,7 @@ const char* NULLDEVICE="/dev/null";
 
 #include <ctime>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include <fstream>
@@ -86,6 +87,46 @@ HPCG_Init(int * argc_p, char ** *argv_p, HPCG_Params & params) {
       if (startswith(argv[i], cparams[j]))
         if (sscanf(argv[i]+strlen(cparams[j]), "%d", iparams+j) != 1 || iparams[j] < 10) iparams[j] = 0;
 
+  // The JSON record of the run, only written by rank 0
+  params.runRecordFile[0] = '\0';
+  for (i = 1; i <= argc && argv[i]; ++i)
+    if (startswith(argv[i], "--record=")) {
+      if (strlen(argv[i]+9) >= sizeof(params.runRecordFile)) {
+        std::cerr << "--record=FILE is too long" << std::endl;
+        std::exit(1);
+      }
+      strcpy(params.runRecordFile, argv[i]+9);
+    }
+
+  // The smoother of each MG level, finest first, the last one for the levels below: --smoother=symgs,cheb
+  params.chebyshevLevels = 0;
+  for (i = 1; i <= argc && argv[i]; ++i)
+    if (startswith(argv[i], "--smoother=")) {
+      params.chebyshevLevels = 0;
+      int level = 0;
+      const char * s = argv[i]+11;
+      bool chebyshev = false;
+      while (*s) {
+        if (startswith(s, "cheb")) chebyshev = true;
+        else if (startswith(s, "symgs")) chebyshev = false;
+        else {
+          std::cerr << "--smoother=LIST takes symgs or cheb for each level" << std::endl;
+          std::exit(1);
+        }
+        if (chebyshev) params.chebyshevLevels |= 1 << level;
+        ++level;
+        while (*s && *s != ',') ++s;
+        if (*s == ',') ++s;
+      }
+      // The last smoother for all the coarser levels
+      if (chebyshev) for (; level < 31; ++level) params.chebyshevLevels |= 1 << level;
+    }
+
+  // Performance engineering runs without the checks of the problem and of the solution
+  params.skipValidation = 0;
+  for (i = 1; i <= argc && argv[i]; ++i)
+    if (strcmp(argv[i], "--skip-validation") == 0) params.skipValidation = 1;
+
   // Check if --rt was specified on the command line
   int * rt  = iparams+3;  // Assume runtime was not specified and will be read from the hpcg.dat file
   if (! iparams[3]) rt = 0; // If --rt was specified, we already have the runtime, so don't read it from file
@@ -20,6 +20,17 @@ export RXHPCG_NZ="16"
 # Values < 10 result in only one CG set.
 export RXHPCG_RT="1"
 
+# Set to 1 to run with Legion Prof (-lg:prof) and keep its logs, statistics
+# and views in the data directory, see make prof-weak. RXHPCG_PROF_TOOL is the
+# legion_prof.py to process them with, from the PATH or LG_RT_DIR by default.
+export RXHPCG_PROF="0"
+
+# Set to strong to run every sub-block count on each global size of
+# RXHPCG_GLOBAL_SIZES (NX or NXxNYxNZ), the local size derived from the
+# process grid HPCG picks. RXHPCG_NX, RXHPCG_NY and RXHPCG_NZ are for weak.
+export RXHPCG_SWEEP="weak"
+export RXHPCG_GLOBAL_SIZES="64 128"
+
 echo "### run-xhpcg Setup"
 env | grep RXHPCG | sort
 echo "### run-xhpcg Setup"
@@ -21,6 +21,12 @@ export RXHPCG_NZ="16"
 # Values < 10 result in only one CG set.
 export RXHPCG_RT="1"
 
+# Set to strong to run every sub-block count on each global size of
+# RXHPCG_GLOBAL_SIZES (NX or NXxNYxNZ), the local size derived from the
+# process grid HPCG picks. RXHPCG_NX, RXHPCG_NY and RXHPCG_NZ are for weak.
+export RXHPCG_SWEEP="weak"
+export RXHPCG_GLOBAL_SIZES="64 128"
+
 echo "### run-xhpcg Setup"
 env | grep RXHPCG | sort
 echo "### run-xhpcg Setup"
@@ -33,6 +33,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <inttypes.h>
 
@@ -123,6 +124,9 @@ getParamsFromArgs(DriverParams &params)
         if (!strcmp(cArgs.argv[i], "-npz")) {
             params.npz = (int64_t)strtol(cArgs.argv[++i], NULL, 10);
         }
+        if (!strcmp(cArgs.argv[i], "-tol")) {
+            params.tolerance = strtod(cArgs.argv[++i], NULL);
+        }
         if (!strcmp(cArgs.argv[i], "-nmg")) {
             params.nMGLevels = (int64_t)strtol(cArgs.argv[++i], NULL, 10);
         }
@@ -132,8 +136,8 @@ getParamsFromArgs(DriverParams &params)
         if (!strcmp(cArgs.argv[i], "-h") || !strcmp(cArgs.argv[i], "-help")) {
             std::cout << "usage: " << DRIVER_NAME
                       << " [-npx X] [-npy Y] [-npz Z] [-nx X] [-ny Y] [-nz Z]"
-                         " [-i MAX_ITERS] [-s N_SUBR] [-nmg N_MGL]"
-                         " [-no-precond] [-h | --help]"
+                         " [-i MAX_ITERS] [-tol TOL] [-s N_SUBR]"
+                         " [-nmg N_MGL] [-no-precond] [-h | --help]"
                       << std::endl;
             exit(EXIT_SUCCESS);
         }
@@ -152,26 +156,104 @@ echoBanner(const DriverParams &params)
 {
     printf("%s %d.%d\n", DRIVER_NAME, DRIVER_VER, DRIVER_SUBVER);
     printf("Legion Setup Summary:\n"
-           "  Number of Subregions: %"PRId64"\n", params.nSubRgns);
+           "  Number of Subregions: %" PRId64 "\n", params.nSubRgns);
     printf("Global Problem Dimensions:\n"
-           "  Global nx : %"PRId64"\n"
-           "  Global ny : %"PRId64"\n"
-           "  Global nz : %"PRId64"\n",
+           "  Global nx : %" PRId64 "\n"
+           "  Global ny : %" PRId64 "\n"
+           "  Global nz : %" PRId64 "\n",
            params.npx * params.nx,
            params.npy * params.ny,
            params.npz * params.nz);
     printf("Processor Dimensions:\n"
-           "  npx : %"PRId64"\n"
-           "  npy : %"PRId64"\n"
-           "  npz : %"PRId64"\n",
+           "  npx : %" PRId64 "\n"
+           "  npy : %" PRId64 "\n"
+           "  npz : %" PRId64 "\n",
            params.npx, params.npy, params.npz);
     printf("Local Domain Dimensions:\n"
-           "  nx : %"PRId64"\n"
-           "  ny : %"PRId64"\n"
-           "  nz : %"PRId64"\n",
+           "  nx : %" PRId64 "\n"
+           "  ny : %" PRId64 "\n"
+           "  nz : %" PRId64 "\n",
            params.nx, params.ny, params.nz);
 }
 
+/**
+ * nonzeros of the 27-point stencil matrix of geom: 3 neighbors per dimension
+ * per point, 2 on the boundaries.
+ */
+double
+stencilNon0s(const lgncg::Geometry &geom)
+{
+    return double(3 * geom.npx * geom.nx - 2) *
+           double(3 * geom.npy * geom.ny - 2) *
+           double(3 * geom.npz * geom.nz - 2);
+}
+
+/**
+ * the time and GFLOP/s summaries of ReportResults in the explicit-SPMD port,
+ * for one CG set of nIters iterations, with the same operation counts, so
+ * that the two are compared at equal problem size.
+ */
+void
+reportResults(const DriverParams &params,
+              const Problem &problem,
+              const double *times,
+              int64_t nIters)
+{
+    const double fniters = double(nIters);
+    const double fnrow = double(problem.A.nRows);
+    const double fnnz = stencilNon0s(problem.A.geom);
+    // 3 ddots, 3 WAXPBYs and 1 SpMV per iteration, and one of each before
+    const double fnopsDDOT = (3.0 * fniters + 1.0) * 2.0 * fnrow;
+    const double fnopsWAXPBY = (3.0 * fniters + 1.0) * 2.0 * fnrow;
+    const double fnopsSpMV = (fniters + 1.0) * 2.0 * fnnz;
+    // pre- and post-smoothers and the residual on each level but the
+    // coarsest, one symmetric GS sweep on it
+    double fnopsMG = 0.0;
+    if (params.doPreconditioning) {
+        const lgncg::SparseMatrix *Af = &problem.A;
+        for (; Af->mgData; Af = Af->Ac) {
+            const double fnnzAf = stencilNon0s(Af->geom);
+            fnopsMG += Af->mgData->nPresmootherSteps * fniters * 4.0 * fnnzAf;
+            fnopsMG += fniters * 2.0 * fnnzAf;
+            fnopsMG += Af->mgData->nPostsmootherSteps * fniters * 4.0 * fnnzAf;
+        }
+        fnopsMG += fniters * 4.0 * stencilNon0s(Af->geom);
+    }
+    const double fnops = fnopsDDOT + fnopsWAXPBY + fnopsSpMV + fnopsMG;
+    //
+    printf("Iteration Count Information:\n"
+           "  Iterations: %" PRId64 "\n", nIters);
+    printf("Benchmark Time Summary:\n"
+           "  DDOT: %lf\n"
+           "  WAXPBY: %lf\n"
+           "  SpMV: %lf\n"
+           "  MG: %lf\n"
+           "  Total: %lf\n",
+           times[lgncg::LGNCG_TIME_DDOT],
+           times[lgncg::LGNCG_TIME_WAXPBY],
+           times[lgncg::LGNCG_TIME_SPMV],
+           times[lgncg::LGNCG_TIME_MG],
+           times[lgncg::LGNCG_TIME_TOTAL]);
+    printf("Floating Point Operations Summary:\n"
+           "  Raw DDOT: %le\n"
+           "  Raw WAXPBY: %le\n"
+           "  Raw SpMV: %le\n"
+           "  Raw MG: %le\n"
+           "  Total: %le\n",
+           fnopsDDOT, fnopsWAXPBY, fnopsSpMV, fnopsMG, fnops);
+    printf("GFLOP/s Summary:\n"
+           "  Raw DDOT: %lf\n"
+           "  Raw WAXPBY: %lf\n"
+           "  Raw SpMV: %lf\n"
+           "  Raw MG: %lf\n"
+           "  Raw Total: %lf\n",
+           fnopsDDOT / times[lgncg::LGNCG_TIME_DDOT] / 1.0E9,
+           fnopsWAXPBY / times[lgncg::LGNCG_TIME_WAXPBY] / 1.0E9,
+           fnopsSpMV / times[lgncg::LGNCG_TIME_SPMV] / 1.0E9,
+           fnopsMG / times[lgncg::LGNCG_TIME_MG] / 1.0E9,
+           fnops / times[lgncg::LGNCG_TIME_TOTAL] / 1.0E9);
+}
+
 /**
  * interface for launching tasks that verify that we are close enough to the
  * known, correct solution.
@@ -273,16 +355,21 @@ mainTask(const lrthl::Task *task,
     double start = LegionRuntime::TimeStamp::get_current_time_in_micros();
     printf("starting solve...\n");
     // solve the thing
+    double times[lgncg::LGNCG_N_TIMES] = {0.0};
+    int64_t nIters = 0;
     lgncg::cgSolv(problem.A,
                   problem.b,
                   params.tolerance,
                   params.maxIters,
                   problem.x,
                   params.doPreconditioning,
+                  times,
+                  nIters,
                   ctx,
                   lrt);
     double stop = LegionRuntime::TimeStamp::get_current_time_in_micros();
     printf("  . done in: %7.3lf ms\n", (stop - start) * 1e-3);
+    reportResults(params, problem, times, nIters);
     start = LegionRuntime::TimeStamp::get_current_time_in_micros();
     printf("verifying answer...\n");
     // make sure we get the answer we expect
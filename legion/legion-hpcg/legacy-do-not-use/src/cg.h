@@ -30,6 +30,7 @@
 #ifndef LGNCG_CG_H_INCLUDED
 #define LGNCG_CG_H_INCLUDED
 
+#include "lgncg.h"
 #include "tids.h"
 #include "vector.h"
 #include "sparsemat.h"
@@ -56,6 +57,14 @@
 #define PRId64 "lli"
 #endif
 
+// the time of the calls between them added to times[i]: their launches, and
+// for the dot products the wait for their results, as in the explicit-SPMD
+// port without --timekernels
+#define LGNCG_TICK() \
+    do { t0 = lgncg::cg::now(); } while (0)
+#define LGNCG_TOCK(i) \
+    do { times[(i)] += lgncg::cg::now() - t0; } while (0)
+
 namespace {
 
 void
@@ -90,7 +99,18 @@ static inline void
 finalize(void) { }
 
 /**
- * interface that performs the CG solve.
+ * wall clock time in seconds.
+ */
+static inline double
+now(void)
+{
+    return LegionRuntime::TimeStamp::get_current_time_in_micros() * 1e-6;
+}
+
+/**
+ * interface that performs the CG solve. the times of the kernels are added to
+ * times, LGNCG_N_TIMES of them, and the number of iterations stored in
+ * nIters. a tolerance of 0 runs maxIters iterations.
  */
 static inline void
 solv(SparseMatrix &A,
@@ -99,6 +119,8 @@ solv(SparseMatrix &A,
      int64_t maxIters,
      Vector &x,
      bool doPreconditioning,
+     double *times,
+     int64_t &nIters,
      LegionRuntime::HighLevel::Context &ctx,
      LegionRuntime::HighLevel::HighLevelRuntime *lrt)
 {
@@ -121,57 +143,91 @@ solv(SparseMatrix &A,
     if (!doPreconditioning) {
         printf("*** WARNING: PERFORMING UNPRECONDITIONED ITERATIONS ***\n");
     }
+    double t0 = 0.0;
+    const double tBegin = now();
+    nIters = 0;
     // p = x
     veccp(x, p, ctx, lrt);
     // Ap = A * p
+    LGNCG_TICK();
     spmv(A, p, Ap, ctx, lrt);
+    LGNCG_TOCK(LGNCG_TIME_SPMV);
     // r = b - Ax
+    LGNCG_TICK();
     waxpby(1.0, b, -1.0, Ap, r, ctx, lrt);
+    LGNCG_TOCK(LGNCG_TIME_WAXPBY);
     // normr = r' * r
+    LGNCG_TICK();
     dotprod(r, r, normr, ctx, lrt);
+    LGNCG_TOCK(LGNCG_TIME_DDOT);
     normr = sqrt(normr);
     printf("  . initial residual = %lf\n", normr);
     // record initial residual for convergence testing
     normr0 = normr;
 #if 1
     for (int64_t k = 1; k <= maxIters && (normr / normr0 > tolerance); ++k) {
+        LGNCG_TICK();
         if (doPreconditioning) {
             mg(A, r, z, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_MG);
         }
         else {
             // copy r to z - no preconditioning (could also use veccp, but this
             // is the way HPCG does it...
             waxpby(1.0, r, 0.0, r, z, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_WAXPBY);
         }
         if (1 == k) {
             // p = z
+            LGNCG_TICK();
             veccp(z, p, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_WAXPBY);
             // rtz = r' * z
+            LGNCG_TICK();
             dotprod(r, z, rtz, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_DDOT);
         }
         else {
             rtzOld = rtz;
             // rtz = r' * z
+            LGNCG_TICK();
             dotprod(r, z, rtz, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_DDOT);
             beta = rtz / rtzOld;
             // p = 1 * z + beta * p
+            LGNCG_TICK();
             waxpby(1.0, z, beta, p, p, ctx, lrt);
+            LGNCG_TOCK(LGNCG_TIME_WAXPBY);
         }
         // Ap = A * p
+        LGNCG_TICK();
         spmv(A, p, Ap, ctx, lrt);
+        LGNCG_TOCK(LGNCG_TIME_SPMV);
         // pAp = p' * Ap
+        LGNCG_TICK();
         dotprod(p, Ap, pAp, ctx, lrt);
+        LGNCG_TOCK(LGNCG_TIME_DDOT);
         alpha = rtz / pAp;
         // x = 1 * x + alpha * p
+        LGNCG_TICK();
         waxpby(1.0, x, alpha, p, x, ctx, lrt);
         // r = 1 * r + -alpha * Ap
         waxpby(1.0, r, -alpha, Ap, r, ctx, lrt);
+        LGNCG_TOCK(LGNCG_TIME_WAXPBY);
         // normr = r' * r
+        LGNCG_TICK();
         dotprod(r, r, normr, ctx, lrt);
+        LGNCG_TOCK(LGNCG_TIME_DDOT);
         normr = sqrt(normr);
-        printf("  . iteration = %03"PRId64
+        nIters = k;
+        printf("  . iteration = %03" PRId64
                " scaled residual = %lf\n", k, normr / normr0);
     }
+    // the last dot product waited for r, but not for x
+    LGNCG_TICK();
+    lrt->issue_execution_fence(ctx).get_void_result();
+    LGNCG_TOCK(LGNCG_TIME_WAXPBY);
+    times[LGNCG_TIME_TOTAL] += now() - tBegin;
 #else // TESTING ONLY
     printf("*** WARNING: SYMGS-ONLY SOLVE ***\n");
     // this is just for unit testing purposes, so just run maxIters.
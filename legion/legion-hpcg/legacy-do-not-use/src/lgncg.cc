@@ -46,7 +46,7 @@ void
 finalize(void) { }
 
 /**
- * simple interface to real call.
+ * simple interface to real call. times holds LGNCG_N_TIMES entries.
  */
 void
 cgSolv(SparseMatrix &A,
@@ -55,11 +55,13 @@ cgSolv(SparseMatrix &A,
        int64_t maxIters,
        Vector &x,
        bool doPreconditioning,
+       double *times,
+       int64_t &nIters,
        LegionRuntime::HighLevel::Context ctx,
        LegionRuntime::HighLevel::HighLevelRuntime *lrt)
 {
     lgncg::cg::solv(A, b, tolerance, maxIters, x,
-                    doPreconditioning, ctx, lrt);
+                    doPreconditioning, times, nIters, ctx, lrt);
 }
 
 std::ostream &
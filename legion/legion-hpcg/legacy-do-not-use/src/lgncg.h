@@ -42,6 +42,18 @@
 struct SparseMatrix;
 
 namespace lgncg {
+// indices of the times cgSolv accumulates, those of ReportResults in the
+// explicit-SPMD port
+enum {
+    LGNCG_TIME_TOTAL = 0,
+    LGNCG_TIME_DDOT,
+    LGNCG_TIME_WAXPBY,
+    LGNCG_TIME_SPMV,
+    LGNCG_TIME_UNUSED,
+    LGNCG_TIME_MG,
+    LGNCG_N_TIMES
+};
+
 void
 init(void);
 
@@ -55,6 +67,8 @@ cgSolv(SparseMatrix &A,
        int64_t maxIters,
        Vector &x,
        bool doPreconditioning,
+       double *times,
+       int64_t &nIters,
        LegionRuntime::HighLevel::Context ctx,
        LegionRuntime::HighLevel::HighLevelRuntime *lrt);
 
@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+
+###############################################################################
+# The performance regression check of the CODY mini-apps, on the results of
+# the cody-bench target: the metrics of every run are taken from its logs and
+# CODY rows, reduced over the repetitions to their median and median absolute
+# deviation (MAD), and either stored as the baseline of the machine or
+# compared with it.
+#
+#     cody-regress.py save    <bench dir> [--baselines dir] [--machine name]
+#     cody-regress.py compare <bench dir> [--baselines dir] [--machine name]
+#                             [--baseline file] [--report file]
+#                             [--noise k] [--threshold frac]
+#
+# A metric got worse when its median got worse than the baseline one by more
+# than the noise, k (3) times the combined MAD of both as a standard
+# deviation (1.4826 MAD), and by more than the threshold (2%). Only the
+# headline metrics of each run gate, with k raised for their number so that
+# all of them together are as unlikely to fail on noise as one metric at k:
+# a slower headline metric is a regression. The others are only reported.
+# compare lists those, the improvements and the metrics that are only on one
+# side, writes the table of all of them to --report, and exits with 1 on a
+# regression. See README.md.
+###############################################################################
+
+import argparse
+import csv
+import datetime
+import glob
+import json
+import math
+import os
+import re
+import socket
+import statistics
+import subprocess
+import sys
+
+# MAD to the standard deviation of a normal distribution
+MAD_SIGMA = 1.4826
+
+# TIME lines of MISH:
+#     TIME:cType,mType,init,nproc,nth,niters,ncells,wRunt,wComp,wOut
+# and of heat-tx (C, MPI, OpenCL):
+#     TIME:app,engine,nx,ny,threads,steps,secs,cell updates/s,GB/s
+TIME_RE = re.compile(r'^TIME:(.*)$')
+# the rows of the QuadTree benchmark
+QTREE_HEADER = 'app,backend,numCells,maxLevel,op,nodes,ns_per_op'
+# the stack UMMA versions, per loop
+UMMA_RE = re.compile(r'^Time: ([0-9.eE+-]+) s')
+# the OpenCL square, partitioned or pipelined
+SQUARE_RE = re.compile(r'(\w+) run time = [0-9.eE+-]+ ms, ([0-9.eE+-]+) GB/s')
+# the rating of HPCG, in its YAML report
+HPCG_RE = re.compile(r'GFLOP/s rating of: ([0-9.eE+-]+)')
+
+# the CODY rows compared, the rates
+CODY_METRICS = ('updatesPerSec', 'GBs')
+# the QuadTree operation that gates, on the largest tree of the run
+QTREE_HEADLINE_OP = 'update'
+
+
+class Metric:
+    """A metric of a run over the repetitions, higher or lower is better"""
+
+    def __init__(self, higher, values=None, median=None, mad=None):
+        self.higher = higher
+        self.values = values or []
+        self.stored_median = median
+        self.stored_mad = mad
+
+    @property
+    def median(self):
+        if self.stored_median is not None:
+            return self.stored_median
+        return statistics.median(self.values)
+
+    @property
+    def mad(self):
+        if self.stored_mad is not None:
+            return self.stored_mad
+        m = self.median
+        return statistics.median([abs(v - m) for v in self.values])
+
+    def record(self):
+        return {'median': self.median, 'mad': self.mad,
+                'n': len(self.values), 'higher': self.higher,
+                'values': self.values}
+
+    @staticmethod
+    def from_record(r):
+        return Metric(r['higher'], r.get('values', []), r['median'], r['mad'])
+
+
+def add(metrics, key, value, higher):
+    if key not in metrics:
+        metrics[key] = Metric(higher)
+    metrics[key].values.append(value)
+
+
+def parse_log(path, metrics, run, headlines):
+    """The metrics of the log of a repetition of run, the headline ones also
+    to headlines"""
+    qtree = False
+    qtree_updates = {}
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            m = TIME_RE.match(line)
+            if m:
+                t = [x.strip('"') for x in m.group(1).split(',')]
+                if len(t) == 10 and float(t[8]) > 0:
+                    # cells per second outside the output, as bench.sh
+                    key = '%s/%s:cellsPerSec' % (run, t[0])
+                    add(metrics, key,
+                        float(t[5]) * float(t[6]) / float(t[8]), True)
+                    headlines.add(key)
+                elif len(t) == 9:
+                    key = '%s/%s:%s:updatesPerSec' % (run, t[0], t[1])
+                    add(metrics, key, float(t[7]), True)
+                    headlines.add(key)
+                continue
+            if line.startswith(QTREE_HEADER):
+                qtree = True
+                continue
+            if qtree:
+                t = line.split(',')
+                if len(t) >= 9:
+                    key = '%s/%s:%s:%s:%s:%s:nsPerOp' \
+                        % (run, t[0], t[1], t[2], t[3], t[4])
+                    add(metrics, key, float(t[6]), False)
+                    if t[4] == QTREE_HEADLINE_OP:
+                        size = (int(t[3]), int(t[2]))
+                        qtree_updates.setdefault(size, []).append(key)
+                continue
+            m = UMMA_RE.match(line)
+            if m:
+                key = '%s/secsPerLoop' % run
+                add(metrics, key, float(m.group(1)), False)
+                headlines.add(key)
+                continue
+            m = SQUARE_RE.search(line)
+            if m:
+                key = '%s/%s:GBs' % (run, m.group(1))
+                add(metrics, key, float(m.group(2)), True)
+                headlines.add(key)
+    # the sub-microsecond operations of the small trees are all noise, the
+    # update of each tree at the largest level and number of cells is not
+    if qtree_updates:
+        headlines.update(qtree_updates[max(qtree_updates)])
+
+
+def parse_cody(path, metrics, run):
+    """The rates of the CODY rows of a repetition of run"""
+    with open(path) as f:
+        for row in csv.DictReader(f):
+            if row['metric'] in CODY_METRICS:
+                add(metrics, '%s/%s:%s:%s' % (run, row['app'], row['variant'],
+                                               row['metric']),
+                    float(row['value']), True)
+
+
+def parse_hpcg(path, metrics, run, headlines):
+    with open(path, errors='replace') as f:
+        for line in f:
+            m = HPCG_RE.search(line)
+            if m:
+                add(metrics, '%s/gflops' % run, float(m.group(1)), True)
+                headlines.add('%s/gflops' % run)
+
+
+def collect(bench, headlines=None):
+    """The metrics of the runs of the last cody-bench in bench, the keys of
+    the headline ones to headlines"""
+    metrics = {}
+    if headlines is None:
+        headlines = set()
+    runs_file = os.path.join(bench, 'runs.txt')
+    if not os.path.exists(runs_file):
+        sys.exit('cody-regress: no %s, run cody-bench first' % runs_file)
+    with open(runs_file) as f:
+        runs = [r.strip() for r in f if r.strip()]
+    for run in runs:
+        for rep in sorted(glob.glob(os.path.join(bench, run, 'rep*'))):
+            if os.path.exists(os.path.join(rep, 'log')):
+                parse_log(os.path.join(rep, 'log'), metrics, run, headlines)
+            if os.path.exists(os.path.join(rep, 'cody.csv')):
+                parse_cody(os.path.join(rep, 'cody.csv'), metrics, run)
+            for y in glob.glob(os.path.join(rep, '*.yaml')):
+                parse_hpcg(y, metrics, run, headlines)
+    return metrics
+
+
+def read_config(bench):
+    config = {}
+    path = os.path.join(bench, 'config.txt')
+    if os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                if '=' in line:
+                    k, v = line.rstrip('\n').split('=', 1)
+                    config[k] = v
+    return config
+
+
+def git_rev():
+    here = os.path.dirname(os.path.abspath(__file__))
+    try:
+        return subprocess.check_output(
+            ['git', '-C', here, 'rev-parse', '--short', 'HEAD'],
+            stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+
+def baseline_path(args):
+    if args.baseline:
+        return args.baseline
+    machine = args.machine or socket.gethostname().split('.')[0]
+    return os.path.join(args.baselines, machine + '.json')
+
+
+def save(args):
+    metrics = collect(args.bench)
+    if not metrics:
+        sys.exit('cody-regress: no metrics in %s' % args.bench)
+    path = baseline_path(args)
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    doc = {'machine': os.path.splitext(os.path.basename(path))[0],
+           'date': datetime.date.today().isoformat(),
+           'rev': git_rev(),
+           'config': read_config(args.bench),
+           'metrics': {k: m.record() for k, m in sorted(metrics.items())}}
+    with open(path, 'w') as f:
+        json.dump(doc, f, indent=1, sort_keys=True)
+        f.write('\n')
+    print('cody-regress: %d metrics saved to %s' % (len(metrics), path))
+    return 0
+
+
+def compare(args):
+    path = baseline_path(args)
+    if not os.path.exists(path):
+        sys.exit('cody-regress: no baseline %s, make one with save '
+                 '(the cody-baseline target)' % path)
+    with open(path) as f:
+        doc = json.load(f)
+    base = {k: Metric.from_record(r) for k, r in doc['metrics'].items()}
+    headlines = set()
+    new = collect(args.bench, headlines)
+    gated = len([k for k in headlines if k in base])
+    # one-sided, the tail of k spread over the gated metrics (Bonferroni)
+    normal = statistics.NormalDist()
+    gate_noise = normal.inv_cdf(1 - (1 - normal.cdf(args.noise))
+                                / max(gated, 1))
+
+    print('cody-regress: against %s, %s of %s'
+          % (path, doc.get('rev', '?'), doc.get('date', '?')))
+    config = read_config(args.bench)
+    for k in sorted(set(config) | set(doc.get('config', {}))):
+        if config.get(k) != doc['config'].get(k):
+            print('cody-regress: %s is %r, %r in the baseline, the problems '
+                  'differ' % (k, config.get(k), doc['config'].get(k)))
+
+    rows = []
+    regressions = improvements = slower = 0
+    for k in sorted(set(base) | set(new)):
+        if k not in new:
+            rows.append((k, base[k].median, None, None, None, 'missing'))
+            continue
+        if k not in base:
+            rows.append((k, None, new[k].median, None, None, 'new'))
+            continue
+        b, n = base[k], new[k]
+        if b.median == 0:
+            continue
+        # the relative change, positive when it got worse
+        change = (n.median - b.median) / abs(b.median)
+        if b.higher:
+            change = -change
+        headline = k in headlines
+        k_noise = gate_noise if headline else args.noise
+        noise = k_noise * MAD_SIGMA * math.hypot(b.mad, n.mad) \
+            / abs(b.median)
+        status = 'ok'
+        if change > max(noise, args.threshold):
+            if headline:
+                status = 'REGRESSION'
+                regressions += 1
+            else:
+                status = 'slower'
+                slower += 1
+        elif -change > max(noise, args.threshold):
+            status = 'improved'
+            improvements += 1
+        if headline:
+            status += ' *'
+        rows.append((k, b.median, n.median, change, noise, status))
+
+    def fmt(v, pct=False):
+        if v is None:
+            return '-'
+        return '%+.1f%%' % (100 * v) if pct else '%.4g' % v
+
+    table = ['%-60s %12s %12s %9s %8s  %s'
+             % ('metric', 'baseline', 'now', 'worse', 'noise', 'status')]
+    for k, b, n, c, z, s in rows:
+        table.append('%-60s %12s %12s %9s %8s  %s'
+                     % (k, fmt(b), fmt(n), fmt(c, True), fmt(z, True), s))
+    if args.report:
+        with open(args.report, 'w') as f:
+            f.write('\n'.join(table) + '\n')
+
+    print(table[0])
+    for line, r in zip(table[1:], rows):
+        if not r[5].startswith('ok'):
+            print(line)
+    print('cody-regress: %d metrics, %d headline (*) at %.1f standard '
+          'deviations: %d regressions; the others %d slower, not gating; '
+          '%d improvements%s'
+          % (len(rows), gated, gate_noise, regressions, slower, improvements,
+             ', all in %s' % args.report if args.report else ''))
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Stores or compares the cody-bench results of a machine')
+    parser.add_argument('command', choices=['save', 'compare'])
+    parser.add_argument('bench', help='bench directory of the build tree')
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser.add_argument('--baselines', default=os.path.join(here, 'baselines'),
+                        help='directory of the baselines, one per machine')
+    parser.add_argument('--machine',
+                        help='baseline name, the host name by default')
+    parser.add_argument('--baseline', help='baseline file, instead of the '
+                        'one of the machine')
+    parser.add_argument('--report', help='file for the table of all metrics')
+    parser.add_argument('--noise', type=float, default=3.0,
+                        help='standard deviations of noise allowed for one '
+                        'metric (3), more for the headline metrics together')
+    parser.add_argument('--threshold', type=float, default=0.02,
+                        help='smallest relative change flagged (0.02)')
+    args = parser.parse_args()
+    if args.command == 'save':
+        return save(args)
+    return compare(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
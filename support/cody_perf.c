@@ -0,0 +1,260 @@
+/* cody_perf: see cody_perf.h */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "cody_perf.h"
+
+/* hardware counters of the regions from PAPI's high level API
+ * (-DCODY_PAPI=1, link with -lpapi) */
+#ifndef CODY_PAPI
+#define CODY_PAPI 0
+#endif
+#if CODY_PAPI
+#include <papi.h>
+#endif
+
+/* likwid marker regions (-DCODY_LIKWID=1, link with -llikwid and run under
+ * likwid-perfctr -m) */
+#ifndef CODY_LIKWID
+#define CODY_LIKWID 0
+#endif
+#if CODY_LIKWID
+#define LIKWID_PERFMON
+#include <likwid-marker.h>
+#endif
+
+/* the interleave policy of mbind, from numaif.h, which needs libnuma */
+#define CODY_MPOL_INTERLEAVE 3
+
+typedef struct cody_region_t {
+    char name[32];
+    /* seconds in the region, start of the open one, and the times entered */
+    double secs, t0;
+    long calls;
+} cody_region_t;
+
+static cody_region_t regions[CODY_MAX_REGIONS];
+static int nregions = 0;
+
+/* the app and the run of the last report, for cody_metric */
+static const char *app_name = "?";
+static const char *variant_name = "?";
+static int run_nproc = 0, run_nthreads = 0;
+static double run_ncells = 0.0, run_nsteps = 0.0;
+
+/* ////////////////////////////////////////////////////////////////////////// */
+double
+cody_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* whether an array of bytes with flags is mapped rather than from the heap,
+ * and the length of its mapping */
+static int
+mapped(size_t bytes, int flags)
+{
+    return (flags & CODY_MEM_INTERLEAVE) ||
+           ((flags & CODY_MEM_HUGE) && bytes >= CODY_HUGE_PAGE);
+}
+
+static size_t
+map_size(size_t bytes, int flags)
+{
+    if (!(flags & CODY_MEM_HUGE)) return bytes > 0 ? bytes : 1;
+    /* huge page mappings have to be whole huge pages */
+    return (bytes + CODY_HUGE_PAGE - 1) / CODY_HUGE_PAGE * CODY_HUGE_PAGE;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void *
+cody_alloc(size_t bytes, int flags)
+{
+    void *p = NULL;
+    size_t len = map_size(bytes, flags);
+    unsigned long nodes = ~0UL;
+
+    if (!mapped(bytes, flags)) {
+        if (0 != posix_memalign(&p, CODY_ALIGN, bytes > 0 ? bytes : 1)) {
+            return NULL;
+        }
+        return p;
+    }
+    p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if ((flags & CODY_MEM_HUGE) && bytes >= CODY_HUGE_PAGE) {
+        /* reserved huge pages if there are any */
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (MAP_FAILED == p) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == p) return NULL;
+#ifdef MADV_HUGEPAGE
+        if ((flags & CODY_MEM_HUGE) && bytes >= CODY_HUGE_PAGE) {
+            (void)madvise(p, len, MADV_HUGEPAGE);
+        }
+#endif
+    }
+#ifdef SYS_mbind
+    /* before the first touch places the pages. the kernel keeps the nodes
+     * of the mask the process may use, a failure leaves the default policy */
+    if (flags & CODY_MEM_INTERLEAVE) {
+        (void)syscall(SYS_mbind, p, len, CODY_MPOL_INTERLEAVE, &nodes,
+                      8 * sizeof(nodes), 0);
+    }
+#else
+    (void)nodes;
+#endif
+    return p;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_free(void *p, size_t bytes, int flags)
+{
+    if (NULL == p) return;
+    if (mapped(bytes, flags)) {
+        (void)munmap(p, map_size(bytes, flags));
+    } else {
+        free(p);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_init(const char *app)
+{
+    app_name = app;
+#if CODY_LIKWID
+    LIKWID_MARKER_INIT;
+#endif
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_finish(void)
+{
+#if CODY_PAPI
+    (void)PAPI_hl_stop();
+#endif
+#if CODY_LIKWID
+    LIKWID_MARKER_CLOSE;
+#endif
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+cody_region(const char *name)
+{
+    int r;
+
+    for (r = 0; r < nregions; ++r) {
+        if (0 == strcmp(regions[r].name, name)) return r;
+    }
+    if (nregions == CODY_MAX_REGIONS) return -1;
+    r = nregions++;
+    snprintf(regions[r].name, sizeof(regions[r].name), "%s", name);
+    regions[r].secs = 0.0;
+    regions[r].calls = 0;
+    return r;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_region_begin(int r)
+{
+    if (r < 0 || r >= nregions) return;
+#if CODY_PAPI
+    (void)PAPI_hl_region_begin(regions[r].name);
+#endif
+#if CODY_LIKWID
+    LIKWID_MARKER_START(regions[r].name);
+#endif
+    regions[r].t0 = cody_now();
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_region_end(int r)
+{
+    if (r < 0 || r >= nregions) return;
+    regions[r].secs += cody_now() - regions[r].t0;
+    ++regions[r].calls;
+#if CODY_LIKWID
+    LIKWID_MARKER_STOP(regions[r].name);
+#endif
+#if CODY_PAPI
+    (void)PAPI_hl_region_end(regions[r].name);
+#endif
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+double
+cody_region_secs(int r)
+{
+    if (r < 0 || r >= nregions) return 0.0;
+    return regions[r].secs;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* prints one row and appends it to $CODY_CSV */
+static void
+emit(const char *metric, const char *name, double value)
+{
+    const char *path = getenv("CODY_CSV");
+    FILE *fp;
+
+    printf("CODY:%s,%s,%d,%d,%.0f,%.0f,%s%s,%g\n", app_name, variant_name,
+           run_nproc, run_nthreads, run_ncells, run_nsteps, metric, name,
+           value);
+    if (NULL == path || '\0' == path[0]) return;
+    if (NULL == (fp = fopen(path, "a"))) return;
+    if (0 == fseek(fp, 0, SEEK_END) && 0 == ftell(fp)) {
+        fprintf(fp, "app,variant,nproc,nthreads,ncells,nsteps,metric,value\n");
+    }
+    fprintf(fp, "%s,%s,%d,%d,%.0f,%.0f,%s%s,%g\n", app_name, variant_name,
+            run_nproc, run_nthreads, run_ncells, run_nsteps, metric, name,
+            value);
+    fclose(fp);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_report(const char *variant, int nproc, int nthreads, double ncells,
+            double nsteps, double secs)
+{
+    int r;
+
+    variant_name = variant;
+    run_nproc = nproc;
+    run_nthreads = nthreads;
+    run_ncells = ncells;
+    run_nsteps = nsteps;
+    emit("secs", "", secs);
+    emit("updatesPerSec", "", (secs > 0.0) ? ncells * nsteps / secs : 0.0);
+    for (r = 0; r < nregions; ++r) {
+        emit("region:", regions[r].name, regions[r].secs);
+    }
+    fflush(stdout);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_metric(const char *metric, double value)
+{
+    emit(metric, "", value);
+}
@@ -0,0 +1,95 @@
+/* cody_perf: the timers, allocators and result lines shared by the CODY
+ * mini-apps, so that the runs of all of them are timed and reported the same
+ * way. build cody_perf.c along with the app, see README.md for the options */
+
+#ifndef CODY_PERF_H_INCLUDED
+#define CODY_PERF_H_INCLUDED
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* alignment of every cody_alloc array, a cache line */
+#define CODY_ALIGN 64
+
+/* arrays of at least this many bytes are mapped on huge pages with
+ * CODY_MEM_HUGE */
+#define CODY_HUGE_PAGE (2 * 1024 * 1024)
+
+/* most regions of a run, further ones are not timed */
+#define CODY_MAX_REGIONS 32
+
+/* flags of cody_alloc */
+enum {
+    /* aligned to CODY_ALIGN */
+    CODY_MEM_DEFAULT = 0,
+    /* on reserved huge pages if the system has any, transparent ones
+     * otherwise */
+    CODY_MEM_HUGE = 1,
+    /* pages spread round robin over the NUMA nodes, for arrays shared by
+     * threads on all sockets that are not first touched by their own */
+    CODY_MEM_INTERLEAVE = 2
+};
+
+/* monotonic wall clock in seconds, from an arbitrary start */
+double
+cody_now(void);
+
+/* bytes bytes with flags CODY_MEM_*, NULL if there is not enough memory. an
+ * array is released by cody_free with the same bytes and flags */
+void *
+cody_alloc(size_t bytes, int flags);
+
+void
+cody_free(void *p, size_t bytes, int flags);
+
+/* names the app of the results, e.g. "MISH", and starts the counters of the
+ * hooks built in. call once before the regions */
+void
+cody_init(const char *app);
+
+/* stops the counters, after the last report */
+void
+cody_finish(void);
+
+/* the handle of region name, which is created on first use. -1 once there
+ * are CODY_MAX_REGIONS, which begin and end ignore */
+int
+cody_region(const char *name);
+
+/* times the code between them as region r, also as a PAPI or likwid region
+ * of the same name when built with them. regions may nest but not overlap
+ * themselves and are only timed on the thread that calls them */
+void
+cody_region_begin(int r);
+
+void
+cody_region_end(int r);
+
+/* seconds spent in region r so far */
+double
+cody_region_secs(int r);
+
+/* prints the result lines of a run of variant, e.g. "hydro_c", of nsteps
+ * steps over ncells cells in secs seconds on nproc processes of nthreads
+ * threads, then those of the regions:
+ *
+ *     CODY:app,variant,nproc,nthreads,ncells,nsteps,metric,value
+ *
+ * with metric secs, updatesPerSec and region:<name>. with $CODY_CSV set the
+ * rows are also appended to that file, with the header when it is new */
+void
+cody_report(const char *variant, int nproc, int nthreads, double ncells,
+            double nsteps, double secs);
+
+/* one more row of the last report, e.g. a bandwidth */
+void
+cody_metric(const char *metric, double value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cuda_runtime.h>
+#include "umma.h"
+#include "umma-cuda.h"
+
+/* the arrays of the graph, on the host or on the GPU */
+struct graph {
+    int* v0;
+    int* v1;
+    float* v0_data;
+    float* v1_data;
+    float* data;
+};
+
+int npoints;
+int nedges;
+float* pt_data;
+float* edge_data;
+struct graph gr;
+
+/* for SCATTER_SORTED the ends of the edges by point */
+struct point_csr ends;
+
+/* takes over the edge arrays of el */
+int graph_init(struct edge_list* el) {
+    int i;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    gr.v0 = el->v0;
+    gr.v1 = el->v1;
+    gr.v0_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.v1_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc(nedges * sizeof(float));
+    pt_data = (float*) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (gr.v0_data == NULL || gr.v1_data == NULL || gr.data == NULL ||
+            pt_data == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < nedges * 3; i++) {
+        gr.v0_data[i] = 0;
+        gr.v1_data[i] = 0;
+    }
+
+    el->v0 = NULL;
+    el->v1 = NULL;
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(gr.v0, nedges * sizeof(int));
+    umma_free(gr.v1, nedges * sizeof(int));
+    umma_free(gr.v0_data, nedges * 3 * sizeof(float));
+    umma_free(gr.v1_data, nedges * 3 * sizeof(float));
+    umma_free(gr.data, nedges * sizeof(float));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+}
+
+/* copies the graph between the host and the GPU */
+void graph_copy(struct graph* dst, struct graph* src, cudaMemcpyKind kind) {
+    cudaMemcpy(dst->v0, src->v0, nedges * sizeof(int), kind);
+    cudaMemcpy(dst->v1, src->v1, nedges * sizeof(int), kind);
+    cudaMemcpy(dst->v0_data, src->v0_data, nedges * 3 * sizeof(float), kind);
+    cudaMemcpy(dst->v1_data, src->v1_data, nedges * 3 * sizeof(float), kind);
+    cudaMemcpy(dst->data, src->data, nedges * sizeof(float), kind);
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[3*i+0] = 1;
+        pt_data[3*i+1] = 1;
+        pt_data[3*i+2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+__global__ void edge_gather(float* pt_data, float* edge_data,
+        struct graph gr, int nedges) {
+
+    int i;
+    int v0;
+    int v1;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+    if (i < nedges) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        gr.v0_data[3*i+0] = pt_data[3*v0+0];
+        gr.v0_data[3*i+1] = pt_data[3*v0+1];
+        gr.v0_data[3*i+2] = pt_data[3*v0+2];
+
+        gr.v1_data[3*i+0] = pt_data[3*v1+0];
+        gr.v1_data[3*i+1] = pt_data[3*v1+1];
+        gr.v1_data[3*i+2] = pt_data[3*v1+2];
+
+        gr.data[i] = edge_data[i];
+    }
+}
+
+__global__ void edge_compute(struct graph gr, int nedges) {
+    int i;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (i < nedges) {
+        v0_p0 = gr.v0_data[3*i+0];
+        v0_p1 = gr.v0_data[3*i+1];
+        v0_p2 = gr.v0_data[3*i+2];
+
+        v1_p0 = gr.v1_data[3*i+0];
+        v1_p1 = gr.v1_data[3*i+1];
+        v1_p2 = gr.v1_data[3*i+2];
+
+        e_data = gr.data[i];
+
+        x0 = (v0_p0 + v1_p0) * e_data;
+        x1 = (v0_p1 + v1_p1) * e_data;
+        x2 = (v0_p2 + v1_p2) * e_data;
+
+        gr.v0_data[3*i+0] = x0;
+        gr.v0_data[3*i+1] = x1;
+        gr.v0_data[3*i+2] = x2;
+
+        gr.v1_data[3*i+0] = x0;
+        gr.v1_data[3*i+1] = x1;
+        gr.v1_data[3*i+2] = x2;
+    }
+}
+
+__global__ void edge_scatter(float* pt_data, struct graph gr,
+        int nedges, int aggregate) {
+    int i;
+    int v0;
+    int v1;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (i < nedges) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        add_point(pt_data, v0, gr.v0_data[3*i+0], gr.v0_data[3*i+1],
+                gr.v0_data[3*i+2], aggregate);
+        add_point(pt_data, v1, gr.v1_data[3*i+0], gr.v1_data[3*i+1],
+                gr.v1_data[3*i+2], aggregate);
+    }
+}
+
+/* adds to each point the sum of what its edges add to it, the ends of the
+ * edges at point p being end[start[p]] .. end[start[p + 1] - 1], so each
+ * point is written by one thread, without atomics */
+__global__ void point_reduce(float* pt_data, struct graph gr, int* start,
+        int* end, int npoints) {
+    int p, k, e;
+    float* d;
+    float s0, s1, s2;
+
+    p = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (p < npoints) {
+        s0 = 0;
+        s1 = 0;
+        s2 = 0;
+        for (k = start[p]; k < start[p + 1]; k++) {
+            e = end[k] / 2;
+            d = (end[k] % 2 == 0) ? gr.v0_data + 3*e : gr.v1_data + 3*e;
+            s0 += d[0];
+            s1 += d[1];
+            s2 += d[2];
+        }
+
+        pt_data[3*p+0] += s0;
+        pt_data[3*p+1] += s1;
+        pt_data[3*p+2] += s2;
+    }
+}
+
+/* gather, compute and scatter in one pass, from the points at the start of
+ * the loop into pt_data, without the edge temporaries */
+__global__ void edge_fused(float* pt_last, float* pt_data, float* edge_data,
+        int* v0s, int* v1s, int nedges,
+        int aggregate) {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float e_data;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (i < nedges) {
+        v0 = v0s[i];
+        v1 = v1s[i];
+        e_data = edge_data[i];
+
+        x0 = (pt_last[3*v0+0] + pt_last[3*v1+0]) * e_data;
+        x1 = (pt_last[3*v0+1] + pt_last[3*v1+1]) * e_data;
+        x2 = (pt_last[3*v0+2] + pt_last[3*v1+2]) * e_data;
+
+        add_point(pt_data, v0, x0, x1, x2, aggregate);
+        add_point(pt_data, v1, x0, x1, x2, aggregate);
+    }
+}
+
+/* the device arrays and launch sizes of a loop, set by main for
+ * --persistent */
+struct device_loop {
+    float* pt_data;
+    float* pt_last;
+    struct graph gr;
+    float* edge_data;
+    int* start;
+    int* end;
+    int nBlocks;
+    int nPointBlocks;
+    int aggregate;
+    int pass;
+    int scatter;
+};
+
+struct device_loop dev;
+
+/* one loop of the kernels on stream, the data already on the device */
+void enqueue_loop(cudaStream_t stream) {
+    if (dev.pass == PASS_FUSED) {
+        cudaMemcpyAsync(dev.pt_last, dev.pt_data, npoints * 3 * sizeof(float),
+                cudaMemcpyDeviceToDevice, stream);
+        edge_fused<<<dev.nBlocks,NTHREADS,0,stream>>>(dev.pt_last,
+                dev.pt_data, dev.edge_data, dev.gr.v0, dev.gr.v1, nedges,
+                dev.aggregate);
+        return;
+    }
+
+    edge_gather<<<dev.nBlocks,NTHREADS,0,stream>>>(dev.pt_data,
+            dev.edge_data, dev.gr, nedges);
+    edge_compute<<<dev.nBlocks,NTHREADS,0,stream>>>(dev.gr, nedges);
+    if (dev.scatter == SCATTER_SORTED) {
+        point_reduce<<<dev.nPointBlocks,NTHREADS,0,stream>>>(dev.pt_data,
+                dev.gr, dev.start, dev.end, npoints);
+    } else {
+        edge_scatter<<<dev.nBlocks,NTHREADS,0,stream>>>(dev.pt_data,
+                dev.gr, nedges, dev.aggregate);
+    }
+}
+
+/* --persistent: the points and edges copied to the device once, the loops
+ * by run_persistent and the points copied back once. prints the time of
+ * the copies, returns that of the loops */
+double persistent_loops(int nloops) {
+    double t0, t1, t2;
+    double time;
+
+    t0 = timer();
+    cudaMemcpy(dev.pt_data, pt_data, npoints * 3 * sizeof(float),
+            cudaMemcpyHostToDevice);
+    graph_copy(&dev.gr, &gr, cudaMemcpyHostToDevice);
+    cudaMemcpy(dev.edge_data, edge_data, nedges * sizeof(float),
+            cudaMemcpyHostToDevice);
+    cudaDeviceSynchronize();
+    t1 = timer();
+
+    time = run_persistent(enqueue_loop, nloops);
+
+    t2 = timer();
+    cudaMemcpy(pt_data, dev.pt_data, npoints * 3 * sizeof(float),
+            cudaMemcpyDeviceToHost);
+    printf("Transfer: %f s to the device, %f s back \n", t1 - t0,
+            timer() - t2);
+
+    return time;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    struct umma_opts opts;
+    struct edge_list el;
+
+    float* d_pt_data;
+    float* d_pt_last;
+    int* d_start = NULL;
+    int* d_end = NULL;
+    struct graph d_gr;
+    float* d_edge_data;
+
+    int nBlocks;
+    int nPointBlocks;
+    int aggregate;
+
+    umma_parse_args(argc, argv, &opts);
+    if (opts.pass == PASS_PIPELINED) {
+        printf("The CUDA versions have no pipelined pass. \n");
+        exit(0);
+    }
+    if (opts.scatter == SCATTER_COLOR || opts.scatter == SCATTER_PRIVATE) {
+        printf("The CUDA versions have no color or private scatter. \n");
+        exit(0);
+    }
+    if (opts.scatter == SCATTER_SORTED && opts.pass == PASS_FUSED) {
+        printf("The fused pass has no sorted scatter. \n");
+        exit(0);
+    }
+    aggregate = opts.scatter == SCATTER_WARP;
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 ||
+            (opts.scatter == SCATTER_SORTED && umma_csr_init(&el, &ends) < 0) ||
+            graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+
+    data_init();
+    edge_data_init();
+
+    nBlocks = (nedges / NTHREADS) + 1;
+    nPointBlocks = (npoints / NTHREADS) + 1;
+
+    // allocate memory on the GPU
+    cudaMalloc((void**) &d_pt_data, npoints * 3 * sizeof(float));
+    cudaMalloc((void**) &d_pt_last, npoints * 3 * sizeof(float));
+    cudaMalloc((void**) &d_gr.v0, nedges * sizeof(int));
+    cudaMalloc((void**) &d_gr.v1, nedges * sizeof(int));
+    cudaMalloc((void**) &d_gr.v0_data, nedges * 3 * sizeof(float));
+    cudaMalloc((void**) &d_gr.v1_data, nedges * 3 * sizeof(float));
+    cudaMalloc((void**) &d_gr.data, nedges * sizeof(float));
+    cudaMalloc((void**) &d_edge_data, nedges * sizeof(float));
+
+    // the ends by point do not change, copy them over once
+    if (opts.scatter == SCATTER_SORTED) {
+        cudaMalloc((void**) &d_start, (npoints + 1) * sizeof(int));
+        cudaMalloc((void**) &d_end, ends.nadj * sizeof(int));
+        cudaMemcpy(d_start, ends.start, (npoints + 1) * sizeof(int),
+                cudaMemcpyHostToDevice);
+        cudaMemcpy(d_end, ends.end, ends.nadj * sizeof(int),
+                cudaMemcpyHostToDevice);
+    }
+
+    // loop
+    if (opts.persistent) {
+        dev.pt_data = d_pt_data;
+        dev.pt_last = d_pt_last;
+        dev.gr = d_gr;
+        dev.edge_data = d_edge_data;
+        dev.start = d_start;
+        dev.end = d_end;
+        dev.nBlocks = nBlocks;
+        dev.nPointBlocks = nPointBlocks;
+        dev.aggregate = aggregate;
+        dev.pass = opts.pass;
+        dev.scatter = opts.scatter;
+
+        time0 = 0;
+        time1 = persistent_loops(opts.nloops);
+    } else {
+        time0 = timer();
+        for (i = 0; i < opts.nloops; i++) {
+
+            if (opts.pass == PASS_FUSED) {
+                // copy over, the points twice
+                cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyHostToDevice);
+                cudaMemcpy(d_pt_last, d_pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyDeviceToDevice);
+                cudaMemcpy(d_gr.v0, gr.v0, nedges * sizeof(int),
+                        cudaMemcpyHostToDevice);
+                cudaMemcpy(d_gr.v1, gr.v1, nedges * sizeof(int),
+                        cudaMemcpyHostToDevice);
+                cudaMemcpy(d_edge_data, edge_data, nedges * sizeof(float),
+                        cudaMemcpyHostToDevice);
+
+                // invoke kernel
+                edge_fused<<<nBlocks,NTHREADS>>>(d_pt_last, d_pt_data,
+                        d_edge_data, d_gr.v0, d_gr.v1, nedges, aggregate);
+
+                // copy back
+                cudaMemcpy(pt_data, d_pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyDeviceToHost);
+                continue;
+            }
+
+            /*
+             * Edge Gather
+             */
+            // copy over
+            cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                    cudaMemcpyHostToDevice);
+            graph_copy(&d_gr, &gr, cudaMemcpyHostToDevice);
+            cudaMemcpy(d_edge_data, edge_data, nedges * sizeof(float),
+                    cudaMemcpyHostToDevice);
+
+            // invoke kernel
+            edge_gather<<<nBlocks,NTHREADS>>>(d_pt_data, d_edge_data,
+                    d_gr, nedges);
+
+            // copy back
+            graph_copy(&gr, &d_gr, cudaMemcpyDeviceToHost);
+
+            /*
+             * Edge Compute
+             */
+            // copy over
+            graph_copy(&d_gr, &gr, cudaMemcpyHostToDevice);
+
+            // call kernel
+            edge_compute<<<nBlocks,NTHREADS>>>(d_gr, nedges);
+
+            // copy back
+            graph_copy(&gr, &d_gr, cudaMemcpyDeviceToHost);
+
+            /*
+             * Edge Scatter
+             */
+            // copy over
+            cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                    cudaMemcpyHostToDevice);
+            graph_copy(&d_gr, &gr, cudaMemcpyHostToDevice);
+
+            // call kernel
+            if (opts.scatter == SCATTER_SORTED) {
+                point_reduce<<<nPointBlocks,NTHREADS>>>(d_pt_data, d_gr,
+                        d_start, d_end, npoints);
+            } else {
+                edge_scatter<<<nBlocks,NTHREADS>>>(d_pt_data, d_gr, nedges,
+                        aggregate);
+            }
+
+            // copy back
+            cudaMemcpy(pt_data, d_pt_data, npoints * 3 * sizeof(float),
+                    cudaMemcpyDeviceToHost);
+
+        }
+        time1 = timer();
+    }
+
+    // free memory
+    cudaFree(d_pt_data);
+    cudaFree(d_pt_last);
+    cudaFree(d_gr.v0);
+    cudaFree(d_gr.v1);
+    cudaFree(d_gr.v0_data);
+    cudaFree(d_gr.v1_data);
+    cudaFree(d_gr.data);
+    cudaFree(d_edge_data);
+    cudaFree(d_start);
+    cudaFree(d_end);
+
+    umma_print_results(pt_data, npoints, time1 - time0, opts.nloops);
+
+    graph_free();
+    umma_csr_free(&ends);
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef _umma_cuda_h_
+#define _umma_cuda_h_
+
+#define NTHREADS 128
+
+/* adds x0, x1, x2 to point v of pt_data. with aggregate, the threads of a
+ * warp adding to the same point first sum what they add, and one of them
+ * adds the sum, so a point at many edges of a warp takes one atomic per
+ * component instead of one per edge. needs __match_any_sync, sm_70 on */
+__device__ void add_point(float* pt_data, int v, float x0, float x1,
+        float x2, int aggregate) {
+#if __CUDA_ARCH__ >= 700
+    unsigned peers, m;
+    int src;
+    float s0, s1, s2;
+
+    if (aggregate) {
+        peers = __match_any_sync(__activemask(), v);
+        s0 = 0;
+        s1 = 0;
+        s2 = 0;
+        for (m = peers; m != 0; m &= m - 1) {
+            src = __ffs(m) - 1;
+            s0 += __shfl_sync(peers, x0, src);
+            s1 += __shfl_sync(peers, x1, src);
+            s2 += __shfl_sync(peers, x2, src);
+        }
+        if ((threadIdx.x % 32) != (unsigned) (__ffs(peers) - 1)) {
+            return;
+        }
+        x0 = s0;
+        x1 = s1;
+        x2 = s2;
+    }
+#endif
+
+    atomicAdd(&pt_data[3*v+0], x0);
+    atomicAdd(&pt_data[3*v+1], x1);
+    atomicAdd(&pt_data[3*v+2], x2);
+}
+
+/* the loops of --persistent: the kernels of a loop, which enqueue puts on
+ * a stream, captured once into a CUDA graph and the graph launched nloops
+ * times, so a loop costs one launch and no copies. a runtime without graphs
+ * (before CUDA 11.4) launches the kernels of each loop instead. returns the
+ * seconds of the nloops loops */
+double run_persistent(void (*enqueue)(cudaStream_t), int nloops) {
+    cudaStream_t stream;
+    double t;
+    int i;
+#if CUDART_VERSION >= 11040
+    cudaGraph_t graph;
+    cudaGraphExec_t exec;
+#endif
+
+    cudaStreamCreate(&stream);
+
+#if CUDART_VERSION >= 11040
+    cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal);
+    enqueue(stream);
+    cudaStreamEndCapture(stream, &graph);
+    cudaGraphInstantiateWithFlags(&exec, graph, 0);
+    // on the device before the timing, without running it
+    cudaGraphUpload(exec, stream);
+    cudaStreamSynchronize(stream);
+
+    t = timer();
+    for (i = 0; i < nloops; i++) {
+        cudaGraphLaunch(exec, stream);
+    }
+    cudaStreamSynchronize(stream);
+    t = timer() - t;
+
+    cudaGraphExecDestroy(exec);
+    cudaGraphDestroy(graph);
+#else
+    t = timer();
+    for (i = 0; i < nloops; i++) {
+        enqueue(stream);
+    }
+    cudaStreamSynchronize(stream);
+    t = timer() - t;
+#endif
+
+    cudaStreamDestroy(stream);
+
+    return t;
+}
+
+#endif
@@ -0,0 +1,48 @@
+//
+// heap/ispc/micro-app-aosoa.h
+// (Header automatically generated by the ispc compiler.)
+// DO NOT EDIT THIS FILE.
+//
+
+#ifndef ISPC_HEAP_ISPC_MICRO_APP_AOSOA_H
+#define ISPC_HEAP_ISPC_MICRO_APP_AOSOA_H
+
+#include <stdint.h>
+
+
+
+#ifdef __cplusplus
+namespace ispc { /* namespace */
+#endif // __cplusplus
+struct edge_block {
+    int32_t v0[8];
+    int32_t v1[8];
+    float data[8];
+    float v0_data[3][8];
+    float v1_data[3][8];
+};
+
+struct point_block {
+    float p[3][8];
+};
+
+
+///////////////////////////////////////////////////////////////////////////
+// Functions exported from ispc code
+///////////////////////////////////////////////////////////////////////////
+#if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
+extern "C" {
+#endif // __cplusplus
+    extern void edge_compute(int32_t neblocks, struct edge_block * edges);
+    extern void edge_gather(int32_t neblocks, struct edge_block * edges, struct point_block * pt_data, float * edge_data);
+    extern void edge_scatter(int32_t neblocks, struct edge_block * edges, struct point_block * pt_data);
+#if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
+} /* end extern C */
+#endif // __cplusplus
+
+
+#ifdef __cplusplus
+} /* namespace */
+#endif // __cplusplus
+
+#endif // ISPC_HEAP_ISPC_MICRO_APP_AOSOA_H
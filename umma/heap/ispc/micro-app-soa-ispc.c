@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "umma.h"
+#include "micro-app-soa.h"
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float* edge_data;
+struct graph gr;
+
+/* the pass of --pass, and the points at the start of the loop, which the
+ * fused and pipelined passes read while they add into pt_data */
+int pass;
+float (*pt_last)[3];
+
+/* the tasks of --tasks, 0 to run the kernels on one core, and the scatter
+ * of --scatter over them, with the colors of the edges for SCATTER_COLOR
+ * and ntasks copies of the points for SCATTER_PRIVATE */
+int ntasks;
+int scatter;
+struct edge_colors colors;
+float* priv;
+
+/* takes over the edge arrays of el */
+int graph_init(struct edge_list* el) {
+    int i;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    gr.v0 = el->v0;
+    gr.v1 = el->v1;
+    gr.v0_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.v1_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc(nedges * sizeof(float));
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (gr.v0_data == NULL || gr.v1_data == NULL || gr.data == NULL ||
+            pt_data == NULL || pt_last == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < nedges * 3; i++) {
+        gr.v0_data[i] = 0;
+        gr.v1_data[i] = 0;
+    }
+
+    el->v0 = NULL;
+    el->v1 = NULL;
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(gr.v0, nedges * sizeof(int));
+    umma_free(gr.v1, nedges * sizeof(int));
+    umma_free(gr.v0_data, nedges * 3 * sizeof(float));
+    umma_free(gr.v1_data, nedges * 3 * sizeof(float));
+    umma_free(gr.data, nedges * sizeof(float));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+    umma_colors_free(&colors);
+    umma_free(priv, (size_t) ntasks * npoints * 3 * sizeof(float));
+}
+
+/* sets up the tasks and the scatter of opts for the graph of el */
+int tasks_init(const struct umma_opts* opts, const struct edge_list* el) {
+    ntasks = opts->tasks;
+    scatter = opts->scatter;
+
+    if (scatter > SCATTER_PRIVATE) {
+        printf("The ISPC versions have no %s scatter. \n",
+                scatter == SCATTER_WARP ? "warp" : "sorted");
+        return -1;
+    }
+    if (ntasks == 0 && scatter != SCATTER_ATOMIC) {
+        printf("The color and private scatters need --tasks. \n");
+        return -1;
+    }
+    if (ntasks > 0 && pass != PASS_PHASES) {
+        printf("The tasks run the phases pass only. \n");
+        return -1;
+    }
+
+    if (scatter == SCATTER_COLOR) {
+        return umma_color_edges(el, &colors);
+    }
+    if (scatter == SCATTER_PRIVATE) {
+        priv = (float*) umma_alloc((size_t) ntasks * el->npoints * 3 *
+                sizeof(float));
+        if (priv == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/* the three kernels over a block of edges at a time, the temporaries of a
+ * block in buffers that stay in cache */
+int edge_pipelined() {
+    int b, n;
+    struct graph blk;
+    static float blk_v0_data[UMMA_BLOCK * 3];
+    static float blk_v1_data[UMMA_BLOCK * 3];
+    static float blk_data[UMMA_BLOCK];
+
+    memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+
+    blk.v0_data = blk_v0_data;
+    blk.v1_data = blk_v1_data;
+    blk.data = blk_data;
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        n = nedges - b < UMMA_BLOCK ? nedges - b : UMMA_BLOCK;
+        blk.v0 = gr.v0 + b;
+        blk.v1 = gr.v1 + b;
+
+        edge_gather(n, &blk, pt_last, edge_data + b);
+        edge_compute(n, &blk);
+        edge_scatter(n, &blk, pt_data);
+    }
+
+    return 0;
+}
+
+/* the three kernels, each launched over ntasks tasks */
+int edge_tasks() {
+    edge_gather_tasks(ntasks, nedges, &gr, pt_data, edge_data);
+    edge_compute_tasks(ntasks, nedges, &gr);
+    if (scatter == SCATTER_COLOR) {
+        edge_scatter_color_tasks(ntasks, colors.ncolors, colors.start,
+                colors.edges, &gr, pt_data);
+    } else if (scatter == SCATTER_PRIVATE) {
+        edge_scatter_private_tasks(ntasks, nedges, npoints, &gr, pt_data,
+                priv);
+    } else {
+        edge_scatter_atomic_tasks(ntasks, nedges, &gr, pt_data);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    pass = opts.pass;
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 ||
+            tasks_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+    if (ntasks > 0) {
+        printf("Tasks: %d \n", ntasks);
+    }
+    if (scatter == SCATTER_COLOR) {
+        printf("Scatter: color, %d colors \n", colors.ncolors);
+    } else if (scatter == SCATTER_PRIVATE) {
+        printf("Scatter: private, %d copies \n", ntasks);
+    }
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        if (pass == PASS_FUSED) {
+            memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+            edge_fused(nedges, &gr, pt_last, pt_data, edge_data);
+        } else if (pass == PASS_PIPELINED) {
+            edge_pipelined();
+        } else if (ntasks > 0) {
+            edge_tasks();
+        } else {
+            edge_gather(nedges, &gr, pt_data, edge_data);
+            edge_compute(nedges, &gr);
+            edge_scatter(nedges, &gr, pt_data);
+        }
+    }
+    time1 = timer();
+
+    umma_print_results(&pt_data[0][0], npoints, time1 - time0, opts.nloops);
+
+    graph_free();
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+//
+// heap/ispc/micro-app-soa.h
+// (Header automatically generated by the ispc compiler.)
+// DO NOT EDIT THIS FILE.
+//
+
+#ifndef ISPC_HEAP_ISPC_MICRO_APP_SOA_H
+#define ISPC_HEAP_ISPC_MICRO_APP_SOA_H
+
+#include <stdint.h>
+
+
+
+#ifdef __cplusplus
+namespace ispc { /* namespace */
+#endif // __cplusplus
+struct graph {
+    int32_t * v0;
+    int32_t * v1;
+    float * v0_data;
+    float * v1_data;
+    float * data;
+};
+
+
+///////////////////////////////////////////////////////////////////////////
+// Functions exported from ispc code
+///////////////////////////////////////////////////////////////////////////
+#if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
+extern "C" {
+#endif // __cplusplus
+    extern void edge_compute(int32_t nedges, struct graph * g);
+    extern void edge_compute_tasks(int32_t ntasks, int32_t nedges, struct graph * g);
+    extern void edge_fused(int32_t nedges, struct graph * g, float pt_last[][3], float pt_data[][3], float * edge_data);
+    extern void edge_gather(int32_t nedges, struct graph * g, float pt_data[][3], float * edge_data);
+    extern void edge_gather_tasks(int32_t ntasks, int32_t nedges, struct graph * g, float pt_data[][3], float * edge_data);
+    extern void edge_scatter(int32_t nedges, struct graph * g, float pt_data[][3]);
+    extern void edge_scatter_atomic_tasks(int32_t ntasks, int32_t nedges, struct graph * g, float pt_data[][3]);
+    extern void edge_scatter_color_tasks(int32_t ntasks, int32_t ncolors, int32_t * color_start, int32_t * color_edges, struct graph * g, float pt_data[][3]);
+    extern void edge_scatter_private_tasks(int32_t ntasks, int32_t nedges, int32_t npoints, struct graph * g, float pt_data[][3], float * priv);
+#if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
+} /* end extern C */
+#endif // __cplusplus
+
+
+#ifdef __cplusplus
+} /* namespace */
+#endif // __cplusplus
+
+#endif // ISPC_HEAP_ISPC_MICRO_APP_SOA_H
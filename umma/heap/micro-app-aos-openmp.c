@@ -0,0 +1,575 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "umma.h"
+
+struct edge {
+    int v0;
+    int v1;
+    float data;
+    float v0_pt_data[3];
+    float v1_pt_data[3];
+};
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float* edge_data;
+struct edge* edges;
+
+/* the pass of --pass, and the points at the start of the loop, which the
+ * fused and pipelined passes read while they add into pt_data */
+int pass;
+float (*pt_last)[3];
+
+/* the --prefetch distance of the gather */
+int prefetch;
+
+/* the scatter of --scatter, with the colors of the edges for
+ * SCATTER_COLOR and nthreads copies of the points for SCATTER_PRIVATE */
+int scatter;
+struct edge_colors colors;
+int nthreads;
+float* priv;
+
+int graph_init(const struct edge_list* el) {
+    int i, j;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    edges = (struct edge*) umma_alloc(nedges * sizeof(struct edge));
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (edges == NULL || pt_data == NULL || pt_last == NULL ||
+            edge_data == NULL) {
+        return -1;
+    }
+
+    // each edge first touched by the thread of the edge loops
+#pragma omp parallel for \
+    private(i, j)
+    for (i = 0; i < nedges; i++) {
+        // build edges array here
+        edges[i].v0 = el->v0[i];
+        edges[i].v1 = el->v1[i];
+
+        for (j = 0; j < 3; j++) {
+            edges[i].v0_pt_data[j] = 0;
+            edges[i].v1_pt_data[j] = 0;
+        }
+    }
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(edges, nedges * sizeof(struct edge));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+    umma_colors_free(&colors);
+    umma_free(priv, (size_t) nthreads * npoints * 3 * sizeof(float));
+}
+
+/* sets up the scatter of opts for the graph of el */
+int scatter_init(const struct umma_opts* opts, const struct edge_list* el) {
+    scatter = opts->scatter;
+
+    if (scatter > SCATTER_PRIVATE) {
+        printf("The OpenMP versions have no %s scatter. \n",
+                scatter == SCATTER_WARP ? "warp" : "sorted");
+        return -1;
+    }
+
+    if (scatter == SCATTER_COLOR) {
+        return umma_color_edges(el, &colors);
+    }
+    if (scatter == SCATTER_PRIVATE) {
+        nthreads = omp_get_max_threads();
+        priv = (float*) umma_alloc((size_t) nthreads * el->npoints * 3 *
+                sizeof(float));
+        if (priv == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int data_init() {
+    int i;
+
+#pragma omp parallel for \
+    private(i)
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+
+        pt_last[i][0] = 0;
+        pt_last[i][1] = 0;
+        pt_last[i][2] = 0;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+#pragma omp parallel for \
+    private(i)
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+int edge_gather() {
+    int i;
+    int v0;
+    int v1;
+
+#pragma omp parallel for \
+    private(i, v0, v1)
+    for (i = 0; i < nedges; i++) {
+        if (prefetch > 0 && i + prefetch < nedges) {
+            __builtin_prefetch(pt_data[edges[i + prefetch].v0]);
+            __builtin_prefetch(pt_data[edges[i + prefetch].v1]);
+        }
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+        edges[i].v0_pt_data[0] = pt_data[v0][0];
+        edges[i].v0_pt_data[1] = pt_data[v0][1];
+        edges[i].v0_pt_data[2] = pt_data[v0][2];
+
+        edges[i].v1_pt_data[0] = pt_data[v1][0];
+        edges[i].v1_pt_data[1] = pt_data[v1][1];
+        edges[i].v1_pt_data[2] = pt_data[v1][2];
+
+        edges[i].data = edge_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+#pragma omp parallel for \
+    private(i, v0_p0, v0_p1, v0_p2) \
+    private(v1_p0, v1_p1, v1_p2) \
+    private(x0, x1, x2, e_data)
+    for (i = 0; i < nedges; i++) {
+        v0_p0 = edges[i].v0_pt_data[0];
+        v0_p1 = edges[i].v0_pt_data[1];
+        v0_p2 = edges[i].v0_pt_data[2];
+
+        v1_p0 = edges[i].v1_pt_data[0];
+        v1_p1 = edges[i].v1_pt_data[1];
+        v1_p2 = edges[i].v1_pt_data[2];
+
+        e_data = edges[i].data;
+
+        x0 = (v0_p0 + v1_p0) * e_data;
+        x1 = (v0_p1 + v1_p1) * e_data;
+        x2 = (v0_p2 + v1_p2) * e_data;
+
+        edges[i].v0_pt_data[0] = x0;
+        edges[i].v0_pt_data[1] = x1;
+        edges[i].v0_pt_data[2] = x2;
+
+        edges[i].v1_pt_data[0] = x0;
+        edges[i].v1_pt_data[1] = x1;
+        edges[i].v1_pt_data[2] = x2;
+    }
+
+    return 0;
+}
+
+/* the points of an edge may be those of another edge on another thread */
+int edge_scatter_atomic() {
+    int i;
+    int v0;
+    int v1;
+
+#pragma omp parallel for \
+    private(i, v0, v1)
+    for (i = 0; i < nedges; i++) {
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+#pragma omp atomic
+        pt_data[v0][0] += edges[i].v0_pt_data[0];
+#pragma omp atomic
+        pt_data[v0][1] += edges[i].v0_pt_data[1];
+#pragma omp atomic
+        pt_data[v0][2] += edges[i].v0_pt_data[2];
+
+#pragma omp atomic
+        pt_data[v1][0] += edges[i].v1_pt_data[0];
+#pragma omp atomic
+        pt_data[v1][1] += edges[i].v1_pt_data[1];
+#pragma omp atomic
+        pt_data[v1][2] += edges[i].v1_pt_data[2];
+    }
+
+    return 0;
+}
+
+/* no two edges of a color share a point, so the edges of a color are
+ * added without atomics */
+int edge_scatter_color() {
+    int c, k;
+    int i;
+    int v0;
+    int v1;
+
+    for (c = 0; c < colors.ncolors; c++) {
+#pragma omp parallel for \
+    private(k, i, v0, v1)
+        for (k = colors.start[c]; k < colors.start[c + 1]; k++) {
+            i = colors.edges[k];
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            pt_data[v0][0] += edges[i].v0_pt_data[0];
+            pt_data[v0][1] += edges[i].v0_pt_data[1];
+            pt_data[v0][2] += edges[i].v0_pt_data[2];
+
+            pt_data[v1][0] += edges[i].v1_pt_data[0];
+            pt_data[v1][1] += edges[i].v1_pt_data[1];
+            pt_data[v1][2] += edges[i].v1_pt_data[2];
+        }
+    }
+
+    return 0;
+}
+
+/* the copy of the points of this thread, zeroed */
+float (*private_zero())[3] {
+    int p;
+    float (*acc)[3];
+
+    acc = (float (*)[3]) (priv + omp_get_thread_num() * (size_t) npoints * 3);
+    for (p = 0; p < npoints; p++) {
+        acc[p][0] = 0;
+        acc[p][1] = 0;
+        acc[p][2] = 0;
+    }
+
+    return acc;
+}
+
+/* sums the copies of the points pairwise in log2(threads) steps, each over
+ * all the points, and adds the sum to pt_data. called by all threads */
+void private_sum() {
+    int p, s, t, nt;
+    size_t n = (size_t) npoints * 3;
+
+    nt = omp_get_num_threads();
+    for (s = 1; s < nt; s *= 2) {
+#pragma omp for
+        for (p = 0; p < npoints * 3; p++) {
+            for (t = 0; t + s < nt; t += 2 * s) {
+                priv[t * n + p] += priv[(t + s) * n + p];
+            }
+        }
+    }
+
+#pragma omp for
+    for (p = 0; p < npoints; p++) {
+        pt_data[p][0] += priv[3*p+0];
+        pt_data[p][1] += priv[3*p+1];
+        pt_data[p][2] += priv[3*p+2];
+    }
+}
+
+/* each thread adds its edges to its own copy of the points */
+int edge_scatter_private() {
+#pragma omp parallel
+    {
+        int i;
+        int v0;
+        int v1;
+        float (*acc)[3] = private_zero();
+
+#pragma omp for
+        for (i = 0; i < nedges; i++) {
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            acc[v0][0] += edges[i].v0_pt_data[0];
+            acc[v0][1] += edges[i].v0_pt_data[1];
+            acc[v0][2] += edges[i].v0_pt_data[2];
+
+            acc[v1][0] += edges[i].v1_pt_data[0];
+            acc[v1][1] += edges[i].v1_pt_data[1];
+            acc[v1][2] += edges[i].v1_pt_data[2];
+        }
+
+        private_sum();
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    if (scatter == SCATTER_COLOR) {
+        return edge_scatter_color();
+    }
+    if (scatter == SCATTER_PRIVATE) {
+        return edge_scatter_private();
+    }
+    return edge_scatter_atomic();
+}
+
+/* the fused pass over entries k0 .. k1 - 1 of list, or edges k0 .. k1 - 1
+ * without a list, from the points at the start of the loop into dst, with
+ * atomic adds if atomic */
+void fused_edges(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic) {
+    int k, i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float e_data;
+
+    for (k = k0; k < k1; k++) {
+        i = list != NULL ? list[k] : k;
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+        e_data = edge_data[i];
+
+        x0 = (pt_last[v0][0] + pt_last[v1][0]) * e_data;
+        x1 = (pt_last[v0][1] + pt_last[v1][1]) * e_data;
+        x2 = (pt_last[v0][2] + pt_last[v1][2]) * e_data;
+
+        if (atomic) {
+#pragma omp atomic
+            dst[v0][0] += x0;
+#pragma omp atomic
+            dst[v0][1] += x1;
+#pragma omp atomic
+            dst[v0][2] += x2;
+
+#pragma omp atomic
+            dst[v1][0] += x0;
+#pragma omp atomic
+            dst[v1][1] += x1;
+#pragma omp atomic
+            dst[v1][2] += x2;
+        } else {
+            dst[v0][0] += x0;
+            dst[v0][1] += x1;
+            dst[v0][2] += x2;
+
+            dst[v1][0] += x0;
+            dst[v1][1] += x1;
+            dst[v1][2] += x2;
+        }
+    }
+}
+
+/* the three phases over the same edges as fused_edges, a block at a time,
+ * the temporaries of a block in buffers that stay in cache */
+void pipelined_edges(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic) {
+    int b, n, i, j;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float blk_v0_data[UMMA_BLOCK][3];
+    float blk_v1_data[UMMA_BLOCK][3];
+    float blk_data[UMMA_BLOCK];
+
+    for (b = k0; b < k1; b += UMMA_BLOCK) {
+        n = k1 - b < UMMA_BLOCK ? k1 - b : UMMA_BLOCK;
+
+        for (j = 0; j < n; j++) {
+            i = list != NULL ? list[b + j] : b + j;
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            blk_v0_data[j][0] = pt_last[v0][0];
+            blk_v0_data[j][1] = pt_last[v0][1];
+            blk_v0_data[j][2] = pt_last[v0][2];
+
+            blk_v1_data[j][0] = pt_last[v1][0];
+            blk_v1_data[j][1] = pt_last[v1][1];
+            blk_v1_data[j][2] = pt_last[v1][2];
+
+            blk_data[j] = edge_data[i];
+        }
+
+        for (j = 0; j < n; j++) {
+            x0 = (blk_v0_data[j][0] + blk_v1_data[j][0]) * blk_data[j];
+            x1 = (blk_v0_data[j][1] + blk_v1_data[j][1]) * blk_data[j];
+            x2 = (blk_v0_data[j][2] + blk_v1_data[j][2]) * blk_data[j];
+
+            blk_v0_data[j][0] = x0;
+            blk_v0_data[j][1] = x1;
+            blk_v0_data[j][2] = x2;
+
+            blk_v1_data[j][0] = x0;
+            blk_v1_data[j][1] = x1;
+            blk_v1_data[j][2] = x2;
+        }
+
+        for (j = 0; j < n; j++) {
+            i = list != NULL ? list[b + j] : b + j;
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            if (atomic) {
+#pragma omp atomic
+                dst[v0][0] += blk_v0_data[j][0];
+#pragma omp atomic
+                dst[v0][1] += blk_v0_data[j][1];
+#pragma omp atomic
+                dst[v0][2] += blk_v0_data[j][2];
+
+#pragma omp atomic
+                dst[v1][0] += blk_v1_data[j][0];
+#pragma omp atomic
+                dst[v1][1] += blk_v1_data[j][1];
+#pragma omp atomic
+                dst[v1][2] += blk_v1_data[j][2];
+            } else {
+                dst[v0][0] += blk_v0_data[j][0];
+                dst[v0][1] += blk_v0_data[j][1];
+                dst[v0][2] += blk_v0_data[j][2];
+
+                dst[v1][0] += blk_v1_data[j][0];
+                dst[v1][1] += blk_v1_data[j][1];
+                dst[v1][2] += blk_v1_data[j][2];
+            }
+        }
+    }
+}
+
+typedef void (*edges_fn)(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic);
+
+/* runs fn over all the edges, a block of them at a time on each thread,
+ * adding into the points as --scatter asks */
+int edge_pass(edges_fn fn) {
+    int b, c, k0, k1;
+
+#pragma omp parallel for \
+    private(b)
+    for (b = 0; b < npoints; b++) {
+        pt_last[b][0] = pt_data[b][0];
+        pt_last[b][1] = pt_data[b][1];
+        pt_last[b][2] = pt_data[b][2];
+    }
+
+    if (scatter == SCATTER_COLOR) {
+        for (c = 0; c < colors.ncolors; c++) {
+            k0 = colors.start[c];
+            k1 = colors.start[c + 1];
+#pragma omp parallel for \
+    private(b)
+            for (b = k0; b < k1; b += UMMA_BLOCK) {
+                fn(colors.edges, b, k1 - b < UMMA_BLOCK ? k1 : b + UMMA_BLOCK,
+                        pt_data, 0);
+            }
+        }
+    } else if (scatter == SCATTER_PRIVATE) {
+#pragma omp parallel \
+    private(b)
+        {
+            float (*acc)[3] = private_zero();
+
+#pragma omp for
+            for (b = 0; b < nedges; b += UMMA_BLOCK) {
+                fn(NULL, b, nedges - b < UMMA_BLOCK ? nedges : b + UMMA_BLOCK,
+                        acc, 0);
+            }
+
+            private_sum();
+        }
+    } else {
+#pragma omp parallel for \
+    private(b)
+        for (b = 0; b < nedges; b += UMMA_BLOCK) {
+            fn(NULL, b, nedges - b < UMMA_BLOCK ? nedges : b + UMMA_BLOCK,
+                    pt_data, 1);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    double phase_time[UMMA_NPHASES] = {0};
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    pass = opts.pass;
+    prefetch = opts.prefetch;
+    if (opts.gather_width != 1) {
+        printf("The aos gather loads each point, no --gather-width. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 ||
+            scatter_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    umma_edges_free(&el);
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+    umma_print_binding();
+    if (scatter == SCATTER_COLOR) {
+        printf("Scatter: color, %d colors \n", colors.ncolors);
+    } else if (scatter == SCATTER_PRIVATE) {
+        printf("Scatter: private, %d threads \n", nthreads);
+    }
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        time1 = timer();
+        if (pass == PASS_FUSED) {
+            edge_pass(fused_edges);
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else if (pass == PASS_PIPELINED) {
+            edge_pass(pipelined_edges);
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else {
+            edge_gather();
+            phase_time[PHASE_GATHER] += timer() - time1;
+            time1 = timer();
+            edge_compute();
+            phase_time[PHASE_COMPUTE] += timer() - time1;
+            time1 = timer();
+            edge_scatter();
+            phase_time[PHASE_SCATTER] += timer() - time1;
+        }
+    }
+    time1 = timer();
+
+    umma_print_results(&pt_data[0][0], npoints, time1 - time0, opts.nloops);
+    umma_print_phases(&opts, phase_time, npoints, nedges);
+
+    graph_free();
+
+    return 0;
+}
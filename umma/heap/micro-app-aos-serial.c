@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "umma.h"
+
+struct edge {
+    int v0;
+    int v1;
+    float data;
+    float v0_pt_data[3];
+    float v1_pt_data[3];
+};
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float* edge_data;
+struct edge* edges;
+
+/* the pass of --pass, and the points at the start of the loop, which the
+ * fused and pipelined passes read while they add into pt_data */
+int pass;
+float (*pt_last)[3];
+
+/* the --prefetch distance of the gather */
+int prefetch;
+
+int graph_init(const struct edge_list* el) {
+    int i, j;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    edges = (struct edge*) umma_alloc(nedges * sizeof(struct edge));
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (edges == NULL || pt_data == NULL || pt_last == NULL ||
+            edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < nedges; i++) {
+        // build edges array here
+        edges[i].v0 = el->v0[i];
+        edges[i].v1 = el->v1[i];
+
+        for (j = 0; j < 3; j++) {
+            edges[i].v0_pt_data[j] = 0;
+            edges[i].v1_pt_data[j] = 0;
+        }
+    }
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(edges, nedges * sizeof(struct edge));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+int edge_gather() {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = 0; i < nedges; i++) {
+        if (prefetch > 0 && i + prefetch < nedges) {
+            __builtin_prefetch(pt_data[edges[i + prefetch].v0]);
+            __builtin_prefetch(pt_data[edges[i + prefetch].v1]);
+        }
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+        edges[i].v0_pt_data[0] = pt_data[v0][0];
+        edges[i].v0_pt_data[1] = pt_data[v0][1];
+        edges[i].v0_pt_data[2] = pt_data[v0][2];
+
+        edges[i].v1_pt_data[0] = pt_data[v1][0];
+        edges[i].v1_pt_data[1] = pt_data[v1][1];
+        edges[i].v1_pt_data[2] = pt_data[v1][2];
+
+        edges[i].data = edge_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+    for (i = 0; i < nedges; i++) {
+        v0_p0 = edges[i].v0_pt_data[0];
+        v0_p1 = edges[i].v0_pt_data[1];
+        v0_p2 = edges[i].v0_pt_data[2];
+
+        v1_p0 = edges[i].v1_pt_data[0];
+        v1_p1 = edges[i].v1_pt_data[1];
+        v1_p2 = edges[i].v1_pt_data[2];
+
+        e_data = edges[i].data;
+
+        x0 = (v0_p0 + v1_p0) * e_data;
+        x1 = (v0_p1 + v1_p1) * e_data;
+        x2 = (v0_p2 + v1_p2) * e_data;
+
+        edges[i].v0_pt_data[0] = x0;
+        edges[i].v0_pt_data[1] = x1;
+        edges[i].v0_pt_data[2] = x2;
+
+        edges[i].v1_pt_data[0] = x0;
+        edges[i].v1_pt_data[1] = x1;
+        edges[i].v1_pt_data[2] = x2;
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = 0; i < nedges; i++) {
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+        pt_data[v0][0] += edges[i].v0_pt_data[0];
+        pt_data[v0][1] += edges[i].v0_pt_data[1];
+        pt_data[v0][2] += edges[i].v0_pt_data[2];
+
+        pt_data[v1][0] += edges[i].v1_pt_data[0];
+        pt_data[v1][1] += edges[i].v1_pt_data[1];
+        pt_data[v1][2] += edges[i].v1_pt_data[2];
+    }
+
+    return 0;
+}
+
+/* gather, compute and scatter in one pass over the edges, from the points
+ * at the start of the loop, without the edge temporaries */
+int edge_fused() {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float e_data;
+
+    memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+
+    for (i = 0; i < nedges; i++) {
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+        e_data = edge_data[i];
+
+        x0 = (pt_last[v0][0] + pt_last[v1][0]) * e_data;
+        x1 = (pt_last[v0][1] + pt_last[v1][1]) * e_data;
+        x2 = (pt_last[v0][2] + pt_last[v1][2]) * e_data;
+
+        pt_data[v0][0] += x0;
+        pt_data[v0][1] += x1;
+        pt_data[v0][2] += x2;
+
+        pt_data[v1][0] += x0;
+        pt_data[v1][1] += x1;
+        pt_data[v1][2] += x2;
+    }
+
+    return 0;
+}
+
+/* the three phases over a block of edges at a time, the temporaries of a
+ * block in buffers that stay in cache */
+int edge_pipelined() {
+    int b, n, i, j;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    static float blk_v0_data[UMMA_BLOCK][3];
+    static float blk_v1_data[UMMA_BLOCK][3];
+    static float blk_data[UMMA_BLOCK];
+
+    memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        n = nedges - b < UMMA_BLOCK ? nedges - b : UMMA_BLOCK;
+
+        for (j = 0; j < n; j++) {
+            i = b + j;
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            blk_v0_data[j][0] = pt_last[v0][0];
+            blk_v0_data[j][1] = pt_last[v0][1];
+            blk_v0_data[j][2] = pt_last[v0][2];
+
+            blk_v1_data[j][0] = pt_last[v1][0];
+            blk_v1_data[j][1] = pt_last[v1][1];
+            blk_v1_data[j][2] = pt_last[v1][2];
+
+            blk_data[j] = edge_data[i];
+        }
+
+        for (j = 0; j < n; j++) {
+            x0 = (blk_v0_data[j][0] + blk_v1_data[j][0]) * blk_data[j];
+            x1 = (blk_v0_data[j][1] + blk_v1_data[j][1]) * blk_data[j];
+            x2 = (blk_v0_data[j][2] + blk_v1_data[j][2]) * blk_data[j];
+
+            blk_v0_data[j][0] = x0;
+            blk_v0_data[j][1] = x1;
+            blk_v0_data[j][2] = x2;
+
+            blk_v1_data[j][0] = x0;
+            blk_v1_data[j][1] = x1;
+            blk_v1_data[j][2] = x2;
+        }
+
+        for (j = 0; j < n; j++) {
+            i = b + j;
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            pt_data[v0][0] += blk_v0_data[j][0];
+            pt_data[v0][1] += blk_v0_data[j][1];
+            pt_data[v0][2] += blk_v0_data[j][2];
+
+            pt_data[v1][0] += blk_v1_data[j][0];
+            pt_data[v1][1] += blk_v1_data[j][1];
+            pt_data[v1][2] += blk_v1_data[j][2];
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    double phase_time[UMMA_NPHASES] = {0};
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    pass = opts.pass;
+    prefetch = opts.prefetch;
+    if (opts.gather_width != 1) {
+        printf("The aos gather loads each point, no --gather-width. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    umma_edges_free(&el);
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        time1 = timer();
+        if (pass == PASS_FUSED) {
+            edge_fused();
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else if (pass == PASS_PIPELINED) {
+            edge_pipelined();
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else {
+            edge_gather();
+            phase_time[PHASE_GATHER] += timer() - time1;
+            time1 = timer();
+            edge_compute();
+            phase_time[PHASE_COMPUTE] += timer() - time1;
+            time1 = timer();
+            edge_scatter();
+            phase_time[PHASE_SCATTER] += timer() - time1;
+        }
+    }
+    time1 = timer();
+
+    umma_print_results(&pt_data[0][0], npoints, time1 - time0, opts.nloops);
+    umma_print_phases(&opts, phase_time, npoints, nedges);
+
+    graph_free();
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "umma.h"
+
+/*
+ * Array of structs of arrays: the points and the edges in blocks of
+ * UMMA_LANES, each component of a block contiguous over its lanes. The
+ * compute runs on whole vectors of lanes as in the soa versions, while a
+ * point, or an edge, is in one block as in the aos versions. The edges are
+ * padded to whole blocks with edges of point 0 and data 0, which add
+ * nothing.
+ */
+
+struct point_block {
+    float p[3][UMMA_LANES];
+};
+
+struct edge_block {
+    int v0[UMMA_LANES];
+    int v1[UMMA_LANES];
+    float data[UMMA_LANES];
+    float v0_data[3][UMMA_LANES];
+    float v1_data[3][UMMA_LANES];
+};
+
+int npoints;
+int nedges;
+int npblocks;
+int neblocks;
+struct point_block* pt_data;
+float* edge_data;
+struct edge_block* edges;
+
+int graph_init(const struct edge_list* el) {
+    int i, k, l;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+    npblocks = (npoints + UMMA_LANES - 1) / UMMA_LANES;
+    neblocks = (nedges + UMMA_LANES - 1) / UMMA_LANES;
+
+    edges = (struct edge_block*) umma_alloc(neblocks *
+            sizeof(struct edge_block));
+    pt_data = (struct point_block*) umma_alloc(npblocks *
+            sizeof(struct point_block));
+    edge_data = (float*) umma_alloc(neblocks * UMMA_LANES * sizeof(float));
+    if (edges == NULL || pt_data == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < neblocks * UMMA_LANES; i++) {
+        l = i % UMMA_LANES;
+        // build edges array here
+        edges[i / UMMA_LANES].v0[l] = i < nedges ? el->v0[i] : 0;
+        edges[i / UMMA_LANES].v1[l] = i < nedges ? el->v1[i] : 0;
+
+        for (k = 0; k < 3; k++) {
+            edges[i / UMMA_LANES].v0_data[k][l] = 0;
+            edges[i / UMMA_LANES].v1_data[k][l] = 0;
+        }
+    }
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(edges, neblocks * sizeof(struct edge_block));
+    umma_free(pt_data, npblocks * sizeof(struct point_block));
+    umma_free(edge_data, neblocks * UMMA_LANES * sizeof(float));
+}
+
+int data_init() {
+    int i, k;
+
+    for (i = 0; i < npblocks * UMMA_LANES; i++) {
+        for (k = 0; k < 3; k++) {
+            pt_data[i / UMMA_LANES].p[k][i % UMMA_LANES] = 1;
+        }
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < neblocks * UMMA_LANES; i++) {
+        edge_data[i] = i < nedges ? 1 : 0;
+    }
+
+    return 0;
+}
+
+/* the points are unsigned, so their blocks and lanes are shifts and masks */
+int edge_gather() {
+    int b, l;
+    unsigned v0;
+    unsigned v1;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        for (l = 0; l < UMMA_LANES; l++) {
+            v0 = e->v0[l];
+            v1 = e->v1[l];
+
+            e->v0_data[0][l] = pt_data[v0 / UMMA_LANES].p[0][v0 % UMMA_LANES];
+            e->v0_data[1][l] = pt_data[v0 / UMMA_LANES].p[1][v0 % UMMA_LANES];
+            e->v0_data[2][l] = pt_data[v0 / UMMA_LANES].p[2][v0 % UMMA_LANES];
+
+            e->v1_data[0][l] = pt_data[v1 / UMMA_LANES].p[0][v1 % UMMA_LANES];
+            e->v1_data[1][l] = pt_data[v1 / UMMA_LANES].p[1][v1 % UMMA_LANES];
+            e->v1_data[2][l] = pt_data[v1 / UMMA_LANES].p[2][v1 % UMMA_LANES];
+
+            e->data[l] = edge_data[b * UMMA_LANES + l];
+        }
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int b, k, l;
+    float x;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        for (k = 0; k < 3; k++) {
+            for (l = 0; l < UMMA_LANES; l++) {
+                x = (e->v0_data[k][l] + e->v1_data[k][l]) * e->data[l];
+
+                e->v0_data[k][l] = x;
+                e->v1_data[k][l] = x;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    int b, l;
+    unsigned v0;
+    unsigned v1;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        for (l = 0; l < UMMA_LANES; l++) {
+            v0 = e->v0[l];
+            v1 = e->v1[l];
+
+            pt_data[v0 / UMMA_LANES].p[0][v0 % UMMA_LANES] += e->v0_data[0][l];
+            pt_data[v0 / UMMA_LANES].p[1][v0 % UMMA_LANES] += e->v0_data[1][l];
+            pt_data[v0 / UMMA_LANES].p[2][v0 % UMMA_LANES] += e->v0_data[2][l];
+
+            pt_data[v1 / UMMA_LANES].p[0][v1 % UMMA_LANES] += e->v1_data[0][l];
+            pt_data[v1 / UMMA_LANES].p[1][v1 % UMMA_LANES] += e->v1_data[1][l];
+            pt_data[v1 / UMMA_LANES].p[2][v1 % UMMA_LANES] += e->v1_data[2][l];
+        }
+    }
+
+    return 0;
+}
+
+/* prints the results from the points as 3 floats per point */
+void print_results(double time, int nloops) {
+    int i, k;
+    float* xyz;
+
+    xyz = (float*) malloc(npoints * 3 * sizeof(float));
+    if (xyz == NULL) {
+        return;
+    }
+    for (i = 0; i < npoints; i++) {
+        for (k = 0; k < 3; k++) {
+            xyz[3*i+k] = pt_data[i / UMMA_LANES].p[k][i % UMMA_LANES];
+        }
+    }
+    umma_print_results(xyz, npoints, time, nloops);
+    free(xyz);
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    if (opts.pass != PASS_PHASES) {
+        printf("The aosoa versions have only the phases pass. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    umma_edges_free(&el);
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        edge_gather();
+        edge_compute();
+        edge_scatter();
+    }
+    time1 = timer();
+
+    print_results(time1 - time0, opts.nloops);
+
+    graph_free();
+
+    return 0;
+}
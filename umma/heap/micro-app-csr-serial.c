@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "umma.h"
+
+/*
+ * The owner-computes form of the micro-app: each point pulls the results
+ * of the edges at it, from the csr of the edges by point, so the gather,
+ * compute and scatter of an edge are done, once for each of its points,
+ * without the edge temporaries of the other versions and without two
+ * threads ever adding into one point. The points of the last loop are read
+ * from pt_data and the new ones written to pt_next.
+ */
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float (*pt_next)[3];
+float* edge_data;
+struct point_csr csr;
+/* edge_data of the edges of csr, in csr order */
+float* adj_data;
+
+int graph_init(const struct edge_list* el) {
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_next = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    adj_data = (float*) umma_alloc(2 * nedges * sizeof(float));
+    if (pt_data == NULL || pt_next == NULL || edge_data == NULL ||
+            adj_data == NULL) {
+        return -1;
+    }
+
+    return umma_csr_init(el, &csr);
+}
+
+void graph_free() {
+    umma_csr_free(&csr);
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_next, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+    umma_free(adj_data, 2 * nedges * sizeof(float));
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    for (i = 0; i < 2 * nedges; i++) {
+        adj_data[i] = edge_data[csr.end[i] / 2];
+    }
+
+    return 0;
+}
+
+int point_pull() {
+    int p, k, q;
+    float p0, p1, p2;
+    float s0, s1, s2;
+    float e_data;
+    float (*t)[3];
+
+    for (p = 0; p < npoints; p++) {
+        p0 = pt_data[p][0];
+        p1 = pt_data[p][1];
+        p2 = pt_data[p][2];
+        s0 = p0;
+        s1 = p1;
+        s2 = p2;
+
+        for (k = csr.start[p]; k < csr.start[p + 1]; k++) {
+            q = csr.adj[k];
+            e_data = adj_data[k];
+
+            s0 += (p0 + pt_data[q][0]) * e_data;
+            s1 += (p1 + pt_data[q][1]) * e_data;
+            s2 += (p2 + pt_data[q][2]) * e_data;
+        }
+
+        pt_next[p][0] = s0;
+        pt_next[p][1] = s1;
+        pt_next[p][2] = s2;
+    }
+
+    t = pt_data;
+    pt_data = pt_next;
+    pt_next = t;
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    umma_edges_free(&el);
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        point_pull();
+    }
+    time1 = timer();
+
+    umma_print_results(&pt_data[0][0], npoints, time1 - time0, opts.nloops);
+
+    graph_free();
+
+    return 0;
+}
@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "umma.h"
+
+/*
+ * The soa micro-app over MPI ranks. The points are partitioned over the
+ * ranks by --partition (umma_partition), and each rank owns its points and
+ * the edges whose v0 it owns. The points at the other end of its cut edges,
+ * the ones another rank owns, are its ghost points, kept after its own
+ * points in pt_data. A loop sends the owned points other ranks have as
+ * ghosts and, while they travel, gathers and computes the interior edges,
+ * those with both points owned; then it does the cut edges, scattering
+ * into the ghosts, and sends the ghost sums back to their owners, which add
+ * them to their points while the interior edges are scattered. The points
+ * come out as those of the serial versions, summed in another order.
+ */
+
+struct graph {
+    int* v0;
+    int* v1;
+    float (*v0_data)[3];
+    float (*v1_data)[3];
+    float* data;
+};
+
+int rank;
+int nprocs;
+
+/* the whole graph, and what this rank has of it: nown points, then nghost
+ * ghosts, and nlocal edges, the first ninterior of them interior */
+int npoints;
+int nedges;
+int nown;
+int nghost;
+int nlocal;
+int ninterior;
+float (*pt_data)[3];
+float* edge_data;
+struct graph gr;
+
+/* the points of this rank by their number in the graph */
+int* own;
+
+/* the exchanges: the ghosts from rank ghost_rank[k] are pt_data[nown +
+ * ghost_start[k]] .. pt_data[nown + ghost_start[k + 1] - 1], and the owned
+ * points rank send_rank[k] has as ghosts send_pts[send_start[k]] ..
+ * send_pts[send_start[k + 1] - 1], sent and received through send_buf */
+int nghost_ranks;
+int* ghost_rank;
+int* ghost_start;
+int nsend_ranks;
+int* send_rank;
+int* send_start;
+int* send_pts;
+float (*send_buf)[3];
+MPI_Request* reqs;
+
+/* the seconds spent waiting for the exchanges */
+double wait_time;
+
+/* the whole graph on every rank, made by rank 0 */
+int graph_bcast(const struct umma_opts* opts, struct edge_list* el) {
+    int rv = 0;
+
+    if (rank == 0) {
+        rv = umma_edges_init(opts, el);
+    }
+    MPI_Bcast(&rv, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rv < 0) {
+        return -1;
+    }
+    MPI_Bcast(&el->npoints, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&el->nedges, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        el->v0 = (int*) umma_alloc(el->nedges * sizeof(int));
+        el->v1 = (int*) umma_alloc(el->nedges * sizeof(int));
+        rv = el->v0 == NULL || el->v1 == NULL ? -1 : 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &rv, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (rv < 0) {
+        return -1;
+    }
+    MPI_Bcast(el->v0, el->nedges, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(el->v1, el->nedges, MPI_INT, 0, MPI_COMM_WORLD);
+
+    return 0;
+}
+
+/* the points, ghosts, edges and exchanges of this rank from the partition
+ * of el, part */
+int graph_init(const struct edge_list* el, const int* part) {
+    int i, k, p, q, n;
+    int* lid;
+    int* ghost_count;
+    int* send_count;
+    int* ghost_offset;
+    int* send_offset;
+    int* ghosts;
+    int* wanted;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    // the owned points in the order of the graph, lid[p] the local number
+    // of point p, nown + its index among the ghosts for a ghost
+    lid = (int*) malloc(npoints * sizeof(int));
+    ghost_count = (int*) calloc(nprocs, sizeof(int));
+    send_count = (int*) calloc(nprocs, sizeof(int));
+    ghost_offset = (int*) calloc(nprocs + 1, sizeof(int));
+    send_offset = (int*) calloc(nprocs + 1, sizeof(int));
+    if (lid == NULL || ghost_count == NULL || send_count == NULL ||
+            ghost_offset == NULL || send_offset == NULL) {
+        return -1;
+    }
+    nown = 0;
+    for (p = 0; p < npoints; p++) {
+        lid[p] = part[p] == rank ? nown++ : -1;
+    }
+    own = (int*) malloc(nown * sizeof(int));
+    if (own == NULL) {
+        return -1;
+    }
+    for (p = 0, n = 0; p < npoints; p++) {
+        if (part[p] == rank) {
+            own[n++] = p;
+        }
+    }
+
+    // the edges of this rank and its ghosts, marked -2 and counted by owner
+    nlocal = 0;
+    ninterior = 0;
+    for (i = 0; i < nedges; i++) {
+        if (part[el->v0[i]] != rank) {
+            continue;
+        }
+        nlocal++;
+        q = el->v1[i];
+        if (part[q] == rank) {
+            ninterior++;
+        } else if (lid[q] == -1) {
+            lid[q] = -2;
+            ghost_count[part[q]]++;
+        }
+    }
+
+    // the ghosts by owner, then by number, so those of a rank are together
+    for (k = 0; k < nprocs; k++) {
+        ghost_offset[k + 1] = ghost_offset[k] + ghost_count[k];
+    }
+    nghost = ghost_offset[nprocs];
+    ghosts = (int*) malloc((nghost + 1) * sizeof(int));
+    if (ghosts == NULL) {
+        return -1;
+    }
+    memset(ghost_count, 0, nprocs * sizeof(int));
+    for (p = 0; p < npoints; p++) {
+        if (lid[p] == -2) {
+            n = ghost_offset[part[p]] + ghost_count[part[p]]++;
+            ghosts[n] = p;
+            lid[p] = nown + n;
+        }
+    }
+
+    // the owners are told which of their points this rank has as ghosts
+    MPI_Alltoall(ghost_count, 1, MPI_INT, send_count, 1, MPI_INT,
+            MPI_COMM_WORLD);
+    for (k = 0; k < nprocs; k++) {
+        send_offset[k + 1] = send_offset[k] + send_count[k];
+    }
+    wanted = (int*) malloc((send_offset[nprocs] + 1) * sizeof(int));
+    send_pts = (int*) malloc((send_offset[nprocs] + 1) * sizeof(int));
+    send_buf = (float (*)[3]) umma_alloc((send_offset[nprocs] + 1) * 3 *
+            sizeof(float));
+    if (wanted == NULL || send_pts == NULL || send_buf == NULL) {
+        return -1;
+    }
+    MPI_Alltoallv(ghosts, ghost_count, ghost_offset, MPI_INT, wanted,
+            send_count, send_offset, MPI_INT, MPI_COMM_WORLD);
+    for (i = 0; i < send_offset[nprocs]; i++) {
+        send_pts[i] = lid[wanted[i]];
+    }
+
+    // the ranks with something to exchange
+    ghost_rank = (int*) malloc(nprocs * sizeof(int));
+    ghost_start = (int*) malloc((nprocs + 1) * sizeof(int));
+    send_rank = (int*) malloc(nprocs * sizeof(int));
+    send_start = (int*) malloc((nprocs + 1) * sizeof(int));
+    reqs = (MPI_Request*) malloc(2 * nprocs * sizeof(MPI_Request));
+    if (ghost_rank == NULL || ghost_start == NULL || send_rank == NULL ||
+            send_start == NULL || reqs == NULL) {
+        return -1;
+    }
+    nghost_ranks = 0;
+    nsend_ranks = 0;
+    ghost_start[0] = 0;
+    send_start[0] = 0;
+    for (k = 0; k < nprocs; k++) {
+        if (ghost_count[k] > 0) {
+            ghost_rank[nghost_ranks] = k;
+            ghost_start[++nghost_ranks] = ghost_offset[k + 1];
+        }
+        if (send_count[k] > 0) {
+            send_rank[nsend_ranks] = k;
+            send_start[++nsend_ranks] = send_offset[k + 1];
+        }
+    }
+
+    // the interior edges first, then the cut ones
+    gr.v0 = (int*) umma_alloc((nlocal + 1) * sizeof(int));
+    gr.v1 = (int*) umma_alloc((nlocal + 1) * sizeof(int));
+    gr.v0_data = (float (*)[3]) umma_alloc((nlocal + 1) * 3 * sizeof(float));
+    gr.v1_data = (float (*)[3]) umma_alloc((nlocal + 1) * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc((nlocal + 1) * sizeof(float));
+    edge_data = (float*) umma_alloc((nlocal + 1) * sizeof(float));
+    pt_data = (float (*)[3]) umma_alloc((nown + nghost + 1) * 3 *
+            sizeof(float));
+    if (gr.v0 == NULL || gr.v1 == NULL || gr.v0_data == NULL ||
+            gr.v1_data == NULL || gr.data == NULL || edge_data == NULL ||
+            pt_data == NULL) {
+        return -1;
+    }
+    for (i = 0, k = 0, n = ninterior; i < nedges; i++) {
+        if (part[el->v0[i]] != rank) {
+            continue;
+        }
+        q = part[el->v1[i]] == rank ? k++ : n++;
+        gr.v0[q] = lid[el->v0[i]];
+        gr.v1[q] = lid[el->v1[i]];
+    }
+    memset(gr.v0_data, 0, nlocal * 3 * sizeof(float));
+    memset(gr.v1_data, 0, nlocal * 3 * sizeof(float));
+
+    free(lid);
+    free(ghost_count);
+    free(send_count);
+    free(ghost_offset);
+    free(send_offset);
+    free(ghosts);
+    free(wanted);
+    return 0;
+}
+
+void graph_free() {
+    int nsend = send_start[nsend_ranks];
+
+    umma_free(gr.v0, (nlocal + 1) * sizeof(int));
+    umma_free(gr.v1, (nlocal + 1) * sizeof(int));
+    umma_free(gr.v0_data, (nlocal + 1) * 3 * sizeof(float));
+    umma_free(gr.v1_data, (nlocal + 1) * 3 * sizeof(float));
+    umma_free(gr.data, (nlocal + 1) * sizeof(float));
+    umma_free(edge_data, (nlocal + 1) * sizeof(float));
+    umma_free(pt_data, (nown + nghost + 1) * 3 * sizeof(float));
+    umma_free(send_buf, (nsend + 1) * 3 * sizeof(float));
+    free(own);
+    free(send_pts);
+    free(ghost_rank);
+    free(ghost_start);
+    free(send_rank);
+    free(send_start);
+    free(reqs);
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < nown + nghost; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nlocal; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/* the owned points out to the ranks that have them as ghosts, and their
+ * ghosts in */
+void ghosts_begin() {
+    int i, k, n;
+
+    n = 0;
+    for (k = 0; k < nghost_ranks; k++) {
+        MPI_Irecv(&pt_data[nown + ghost_start[k]][0],
+                3 * (ghost_start[k + 1] - ghost_start[k]), MPI_FLOAT,
+                ghost_rank[k], 0, MPI_COMM_WORLD, &reqs[n++]);
+    }
+    for (i = 0; i < send_start[nsend_ranks]; i++) {
+        send_buf[i][0] = pt_data[send_pts[i]][0];
+        send_buf[i][1] = pt_data[send_pts[i]][1];
+        send_buf[i][2] = pt_data[send_pts[i]][2];
+    }
+    for (k = 0; k < nsend_ranks; k++) {
+        MPI_Isend(&send_buf[send_start[k]][0],
+                3 * (send_start[k + 1] - send_start[k]), MPI_FLOAT,
+                send_rank[k], 0, MPI_COMM_WORLD, &reqs[n++]);
+    }
+}
+
+/* the ghost sums back to their owners, into send_buf */
+void sums_begin() {
+    int k, n;
+
+    n = 0;
+    for (k = 0; k < nsend_ranks; k++) {
+        MPI_Irecv(&send_buf[send_start[k]][0],
+                3 * (send_start[k + 1] - send_start[k]), MPI_FLOAT,
+                send_rank[k], 1, MPI_COMM_WORLD, &reqs[n++]);
+    }
+    for (k = 0; k < nghost_ranks; k++) {
+        MPI_Isend(&pt_data[nown + ghost_start[k]][0],
+                3 * (ghost_start[k + 1] - ghost_start[k]), MPI_FLOAT,
+                ghost_rank[k], 1, MPI_COMM_WORLD, &reqs[n++]);
+    }
+}
+
+/* waits for the exchange begun last, and lets it move on between the
+ * phases with test */
+void exchange_wait() {
+    double time0 = timer();
+
+    MPI_Waitall(nghost_ranks + nsend_ranks, reqs, MPI_STATUSES_IGNORE);
+    wait_time += timer() - time0;
+}
+
+void exchange_test() {
+    int done;
+
+    MPI_Testall(nghost_ranks + nsend_ranks, reqs, &done,
+            MPI_STATUSES_IGNORE);
+}
+
+/* the three phases over edges lo .. hi - 1, as in the soa serial version */
+int edge_gather(int lo, int hi) {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = lo; i < hi; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        gr.v0_data[i][0] = pt_data[v0][0];
+        gr.v0_data[i][1] = pt_data[v0][1];
+        gr.v0_data[i][2] = pt_data[v0][2];
+
+        gr.v1_data[i][0] = pt_data[v1][0];
+        gr.v1_data[i][1] = pt_data[v1][1];
+        gr.v1_data[i][2] = pt_data[v1][2];
+
+        gr.data[i] = edge_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute(int lo, int hi) {
+    int i;
+    float x0, x1, x2;
+
+    for (i = lo; i < hi; i++) {
+        x0 = (gr.v0_data[i][0] + gr.v1_data[i][0]) * gr.data[i];
+        x1 = (gr.v0_data[i][1] + gr.v1_data[i][1]) * gr.data[i];
+        x2 = (gr.v0_data[i][2] + gr.v1_data[i][2]) * gr.data[i];
+
+        gr.v0_data[i][0] = x0;
+        gr.v0_data[i][1] = x1;
+        gr.v0_data[i][2] = x2;
+
+        gr.v1_data[i][0] = x0;
+        gr.v1_data[i][1] = x1;
+        gr.v1_data[i][2] = x2;
+    }
+
+    return 0;
+}
+
+int edge_scatter(int lo, int hi) {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = lo; i < hi; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        pt_data[v0][0] += gr.v0_data[i][0];
+        pt_data[v0][1] += gr.v0_data[i][1];
+        pt_data[v0][2] += gr.v0_data[i][2];
+
+        pt_data[v1][0] += gr.v1_data[i][0];
+        pt_data[v1][1] += gr.v1_data[i][1];
+        pt_data[v1][2] += gr.v1_data[i][2];
+    }
+
+    return 0;
+}
+
+/* one loop. every gather reads the points of the start of the loop: the
+ * interior ones come before any scatter, the cut ones once the ghosts are
+ * in and before the cut scatter, which starts the ghosts from 0 so that
+ * they sum what this rank adds to them */
+int edge_loop() {
+    int i;
+
+    ghosts_begin();
+    edge_gather(0, ninterior);
+    exchange_test();
+    edge_compute(0, ninterior);
+    exchange_wait();
+
+    edge_gather(ninterior, nlocal);
+    edge_compute(ninterior, nlocal);
+    memset(pt_data[nown], 0, nghost * 3 * sizeof(float));
+    edge_scatter(ninterior, nlocal);
+
+    sums_begin();
+    edge_scatter(0, ninterior);
+    exchange_wait();
+    for (i = 0; i < send_start[nsend_ranks]; i++) {
+        pt_data[send_pts[i]][0] += send_buf[i][0];
+        pt_data[send_pts[i]][1] += send_buf[i][1];
+        pt_data[send_pts[i]][2] += send_buf[i][2];
+    }
+
+    return 0;
+}
+
+/* the edges, cut edges and ghosts of the ranks, their largest and total */
+void print_partition(const struct umma_opts* opts) {
+    int local[3] = {nlocal, nlocal - ninterior, nghost};
+    int most[3];
+    int sum[3];
+
+    MPI_Reduce(local, most, 3, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(local, sum, 3, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        printf("Partition: %s, %d ranks, %d cut edges (%.1f%%), %d ghosts, "
+                "at most %d edges, %d cut and %d ghosts a rank \n",
+                opts->partition == PARTITION_BLOCK ? "block" : "rgb", nprocs,
+                sum[1], 100.0 * sum[1] / nedges, sum[2], most[0], most[1],
+                most[2]);
+    }
+}
+
+/* the points of all the ranks on rank 0, by their number in the graph */
+float* points_gather() {
+    int i, k;
+    int* counts = NULL;
+    int* offsets = NULL;
+    int* ids = NULL;
+    float* pts = NULL;
+    float* all = NULL;
+
+    if (rank == 0) {
+        counts = (int*) malloc(nprocs * sizeof(int));
+        offsets = (int*) malloc((nprocs + 1) * sizeof(int));
+        ids = (int*) malloc(npoints * sizeof(int));
+        pts = (float*) malloc(npoints * 3 * sizeof(float));
+        all = (float*) malloc(npoints * 3 * sizeof(float));
+    }
+    MPI_Gather(&nown, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offsets[0] = 0;
+        for (k = 0; k < nprocs; k++) {
+            offsets[k + 1] = offsets[k] + counts[k];
+        }
+    }
+    MPI_Gatherv(own, nown, MPI_INT, ids, counts, offsets, MPI_INT, 0,
+            MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (k = 0; k < nprocs; k++) {
+            counts[k] *= 3;
+            offsets[k] *= 3;
+        }
+    }
+    MPI_Gatherv(pt_data, 3 * nown, MPI_FLOAT, pts, counts, offsets,
+            MPI_FLOAT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (i = 0; i < npoints; i++) {
+            all[3*ids[i]+0] = pts[3*i+0];
+            all[3*ids[i]+1] = pts[3*i+1];
+            all[3*ids[i]+2] = pts[3*i+2];
+        }
+    }
+
+    free(counts);
+    free(offsets);
+    free(ids);
+    free(pts);
+    return all;
+}
+
+int main(int argc, char** argv) {
+    int i, rv;
+    double time0, time1, wait_max;
+    struct umma_opts opts;
+    struct edge_list el = {0, 0, NULL, NULL};
+    int* part;
+    float* all;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+
+    umma_parse_args(argc, argv, &opts);
+    umma_set_nprocs(nprocs);
+    if (opts.pass != PASS_PHASES) {
+        if (rank == 0) {
+            printf("The MPI version has the phases pass only. \n");
+        }
+        MPI_Finalize();
+        exit(0);
+    }
+
+    // initialize data structures, every rank partitions the whole graph
+    rv = graph_bcast(&opts, &el);
+    part = rv < 0 ? NULL : (int*) malloc(el.npoints * sizeof(int));
+    if (rv < 0 || part == NULL ||
+            umma_partition(opts.partition, &el, nprocs, part) < 0 ||
+            graph_init(&el, part) < 0) {
+        printf("Error creating graph. \n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    umma_edges_free(&el);
+    free(part);
+    if (rank == 0) {
+        printf("Graph: %d points, %d edges \n", npoints, nedges);
+    }
+    print_partition(&opts);
+
+    data_init();
+    edge_data_init();
+
+    // loop
+    MPI_Barrier(MPI_COMM_WORLD);
+    wait_time = 0;
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        edge_loop();
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    time1 = timer();
+
+    MPI_Reduce(&wait_time, &wait_max, 1, MPI_DOUBLE, MPI_MAX, 0,
+            MPI_COMM_WORLD);
+    all = points_gather();
+    if (rank == 0) {
+        printf("Exchange: %f s waited a loop, at most over the ranks \n",
+                wait_max / opts.nloops);
+        umma_print_results(all, npoints, time1 - time0, opts.nloops);
+    }
+    free(all);
+
+    graph_free();
+    MPI_Finalize();
+
+    return 0;
+}
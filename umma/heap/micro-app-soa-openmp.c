@@ -0,0 +1,903 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "umma.h"
+
+struct graph {
+    int* v0;
+    int* v1;
+    float (*v0_data)[3];
+    float (*v1_data)[3];
+    float* data;
+};
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float* edge_data;
+struct graph gr;
+
+/* the pass of --pass, and the points at the start of the loop, which the
+ * fused and pipelined passes read while they add into pt_data */
+int pass;
+float (*pt_last)[3];
+
+/* the --prefetch distance and --gather-width of the gather */
+int prefetch;
+int gather_width;
+
+/* the scatter of --scatter, with the colors of the edges for
+ * SCATTER_COLOR and nthreads copies of the points for SCATTER_PRIVATE */
+int scatter;
+struct edge_colors colors;
+int nthreads;
+float* priv;
+
+/* the --index, --edge-data and --accumulate forms of the phases, if any is
+ * not the default: the point numbers as deltas, the values of the edges as
+ * halves and the points summed as doubles in pt_wide */
+int compressed;
+int index_form;
+int value_form;
+int accumulate;
+struct umma_index gr_index;
+unsigned short* edge_half;
+double (*pt_wide)[3];
+
+/* the edges and points of each thread: thread t of nparts loops over the
+ * edges part_edges[t] .. part_edges[t + 1] - 1 and the points part_pts[t]
+ * .. part_pts[t + 1] - 1, even runs of them or with --edge-partition the
+ * points of its part and their edges, and touches them first, so that
+ * their pages are on its NUMA node. part_order[p] is the number of point p
+ * in the graph made, with --edge-partition */
+int nparts;
+int* part_pts;
+int* part_edges;
+int* part_order;
+
+/* the parts of the threads of opts over the graph of el, renumbered by
+ * --edge-partition */
+int parts_init(const struct umma_opts* opts, struct edge_list* el) {
+    int t;
+
+    nparts = omp_get_max_threads();
+    part_pts = (int*) malloc((nparts + 1) * sizeof(int));
+    part_edges = (int*) malloc((nparts + 1) * sizeof(int));
+    if (part_pts == NULL || part_edges == NULL) {
+        return -1;
+    }
+
+    if (opts->edge_partition) {
+        part_order = (int*) malloc(el->npoints * sizeof(int));
+        if (part_order == NULL) {
+            return -1;
+        }
+        return umma_partition_edges(opts->partition, el, nparts,
+                part_order, part_pts, part_edges);
+    }
+
+    for (t = 0; t <= nparts; t++) {
+        part_pts[t] = (long) el->npoints * t / nparts;
+        part_edges[t] = (long) el->nedges * t / nparts;
+    }
+
+    return 0;
+}
+
+void parts_free() {
+    free(part_pts);
+    free(part_edges);
+    free(part_order);
+}
+
+/* copies the edges of el, which it frees, each thread its edges and points
+ * as the loops run over them */
+int graph_init(struct edge_list* el) {
+    int i, t;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    gr.v0 = (int*) umma_alloc(nedges * sizeof(int));
+    gr.v1 = (int*) umma_alloc(nedges * sizeof(int));
+    gr.v0_data = (float (*)[3]) umma_alloc(nedges * 3 * sizeof(float));
+    gr.v1_data = (float (*)[3]) umma_alloc(nedges * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc(nedges * sizeof(float));
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (gr.v0 == NULL || gr.v1 == NULL || gr.v0_data == NULL ||
+            gr.v1_data == NULL || gr.data == NULL || pt_data == NULL ||
+            pt_last == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+            gr.v0[i] = el->v0[i];
+            gr.v1[i] = el->v1[i];
+
+            gr.v0_data[i][0] = 0;
+            gr.v0_data[i][1] = 0;
+            gr.v0_data[i][2] = 0;
+
+            gr.v1_data[i][0] = 0;
+            gr.v1_data[i][1] = 0;
+            gr.v1_data[i][2] = 0;
+
+            gr.data[i] = 0;
+        }
+    }
+
+    umma_edges_free(el);
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(gr.v0, nedges * sizeof(int));
+    umma_free(gr.v1, nedges * sizeof(int));
+    umma_free(gr.v0_data, nedges * 3 * sizeof(float));
+    umma_free(gr.v1_data, nedges * 3 * sizeof(float));
+    umma_free(gr.data, nedges * sizeof(float));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+    umma_colors_free(&colors);
+    umma_free(priv, (size_t) nthreads * npoints * 3 * sizeof(float));
+}
+
+/* sets up the scatter of opts for the graph of el */
+int scatter_init(const struct umma_opts* opts, const struct edge_list* el) {
+    scatter = opts->scatter;
+
+    if (scatter > SCATTER_PRIVATE) {
+        printf("The OpenMP versions have no %s scatter. \n",
+                scatter == SCATTER_WARP ? "warp" : "sorted");
+        return -1;
+    }
+
+    if (scatter == SCATTER_COLOR) {
+        return umma_color_edges(el, &colors);
+    }
+    if (scatter == SCATTER_PRIVATE) {
+        nthreads = omp_get_max_threads();
+        priv = (float*) umma_alloc((size_t) nthreads * el->npoints * 3 *
+                sizeof(float));
+        if (priv == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int data_init() {
+    int i, t;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_pts[t]; i < part_pts[t + 1]; i++) {
+            pt_data[i][0] = 1;
+            pt_data[i][1] = 1;
+            pt_data[i][2] = 1;
+
+            pt_last[i][0] = 0;
+            pt_last[i][1] = 0;
+            pt_last[i][2] = 0;
+        }
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i, t;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+            edge_data[i] = 1;
+        }
+    }
+
+    return 0;
+}
+
+/* the forms of opts from the edges and data of the plain ones */
+int forms_init(const struct umma_opts* opts) {
+    struct edge_list el = {npoints, nedges, gr.v0, gr.v1};
+    int i;
+
+    index_form = opts->index_form;
+    value_form = opts->value_form;
+    accumulate = opts->accumulate;
+    compressed = index_form != INDEX_INT || value_form != VALUE_FLOAT ||
+        accumulate != ACCUM_FLOAT;
+
+    if (index_form == INDEX_DELTA16 && umma_index_init(&el, &gr_index) < 0) {
+        return -1;
+    }
+    if (value_form == VALUE_HALF) {
+        edge_half = (unsigned short*) umma_alloc(nedges *
+                sizeof(unsigned short));
+        if (edge_half == NULL) {
+            return -1;
+        }
+        umma_float_to_half(edge_data, edge_half, nedges);
+    }
+    if (accumulate == ACCUM_DOUBLE) {
+        pt_wide = (double (*)[3]) umma_alloc(npoints * 3 * sizeof(double));
+        if (pt_wide == NULL) {
+            return -1;
+        }
+#pragma omp parallel for \
+    private(i)
+        for (i = 0; i < npoints; i++) {
+            pt_wide[i][0] = pt_data[i][0];
+            pt_wide[i][1] = pt_data[i][1];
+            pt_wide[i][2] = pt_data[i][2];
+        }
+    }
+
+    return 0;
+}
+
+/* the points summed as doubles back to pt_data */
+void forms_free() {
+    int i;
+
+    if (index_form == INDEX_DELTA16) {
+        umma_index_free(&gr_index);
+    }
+    umma_free(edge_half, nedges * sizeof(unsigned short));
+    if (pt_wide != NULL) {
+        for (i = 0; i < npoints; i++) {
+            pt_data[i][0] = (float) pt_wide[i][0];
+            pt_data[i][1] = (float) pt_wide[i][1];
+            pt_data[i][2] = (float) pt_wide[i][2];
+        }
+        umma_free(pt_wide, npoints * 3 * sizeof(double));
+    }
+}
+
+/* the point numbers of edges b .. b + UMMA_BLOCK - 1, decoded into the
+ * buffers or in place, returns the number of edges */
+int block_index(int b, int* blk_v0, int* blk_v1, const int** v0,
+        const int** v1) {
+    if (index_form == INDEX_DELTA16) {
+        *v0 = blk_v0;
+        *v1 = blk_v1;
+        return umma_index_decode(&gr_index, b / UMMA_BLOCK, blk_v0, blk_v1);
+    }
+    *v0 = gr.v0 + b;
+    *v1 = gr.v1 + b;
+    return nedges - b < UMMA_BLOCK ? nedges - b : UMMA_BLOCK;
+}
+
+/* the gather in the compressed forms, a block of edges at a time on each
+ * thread, the point numbers of a block decoded on the stack */
+int edge_gather_blocks() {
+    int b, n, i, j;
+    const int* v0;
+    const int* v1;
+
+#pragma omp parallel for \
+    private(b, n, i, j, v0, v1)
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        int blk_v0[UMMA_BLOCK];
+        int blk_v1[UMMA_BLOCK];
+
+        n = block_index(b, blk_v0, blk_v1, &v0, &v1);
+
+        if (accumulate == ACCUM_DOUBLE) {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+                gr.v0_data[i][0] = (float) pt_wide[v0[j]][0];
+                gr.v0_data[i][1] = (float) pt_wide[v0[j]][1];
+                gr.v0_data[i][2] = (float) pt_wide[v0[j]][2];
+
+                gr.v1_data[i][0] = (float) pt_wide[v1[j]][0];
+                gr.v1_data[i][1] = (float) pt_wide[v1[j]][1];
+                gr.v1_data[i][2] = (float) pt_wide[v1[j]][2];
+            }
+        } else {
+            umma_gather_points(&pt_data[0][0], v0, &gr.v0_data[b][0], n,
+                    gather_width, prefetch);
+            umma_gather_points(&pt_data[0][0], v1, &gr.v1_data[b][0], n,
+                    gather_width, prefetch);
+        }
+
+        if (value_form == VALUE_HALF) {
+            umma_half_to_float(edge_half + b, gr.data + b, n);
+        } else {
+            memcpy(gr.data + b, edge_data + b, n * sizeof(float));
+        }
+    }
+
+    return 0;
+}
+
+/* the gather by umma_gather_points over the edges of each thread */
+int edge_gather_points() {
+    int t, i0, i1;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i0, i1)
+    for (t = 0; t < nparts; t++) {
+        i0 = part_edges[t];
+        i1 = part_edges[t + 1];
+
+        umma_gather_points(&pt_data[0][0], gr.v0 + i0, &gr.v0_data[i0][0],
+                i1 - i0, gather_width, prefetch);
+        umma_gather_points(&pt_data[0][0], gr.v1 + i0, &gr.v1_data[i0][0],
+                i1 - i0, gather_width, prefetch);
+        memcpy(gr.data + i0, edge_data + i0, (i1 - i0) * sizeof(float));
+    }
+
+    return 0;
+}
+
+int edge_gather() {
+    int i, t;
+    int v0;
+    int v1;
+
+    if (compressed) {
+        return edge_gather_blocks();
+    }
+    if (prefetch > 0 || gather_width > 1) {
+        return edge_gather_points();
+    }
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i, v0, v1)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            gr.v0_data[i][0] = pt_data[v0][0];
+            gr.v0_data[i][1] = pt_data[v0][1];
+            gr.v0_data[i][2] = pt_data[v0][2];
+
+            gr.v1_data[i][0] = pt_data[v1][0];
+            gr.v1_data[i][1] = pt_data[v1][1];
+            gr.v1_data[i][2] = pt_data[v1][2];
+
+            gr.data[i] = edge_data[i];
+        }
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i, t;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i, v0_p0, v0_p1, v0_p2) \
+    private(v1_p0, v1_p1, v1_p2) \
+    private(x0, x1, x2, e_data)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+            v0_p0 = gr.v0_data[i][0];
+            v0_p1 = gr.v0_data[i][1];
+            v0_p2 = gr.v0_data[i][2];
+
+            v1_p0 = gr.v1_data[i][0];
+            v1_p1 = gr.v1_data[i][1];
+            v1_p2 = gr.v1_data[i][2];
+
+            e_data = gr.data[i];
+
+            x0 = (v0_p0 + v1_p0) * e_data;
+            x1 = (v0_p1 + v1_p1) * e_data;
+            x2 = (v0_p2 + v1_p2) * e_data;
+
+            gr.v0_data[i][0] = x0;
+            gr.v0_data[i][1] = x1;
+            gr.v0_data[i][2] = x2;
+
+            gr.v1_data[i][0] = x0;
+            gr.v1_data[i][1] = x1;
+            gr.v1_data[i][2] = x2;
+        }
+    }
+
+    return 0;
+}
+
+/* the points of an edge may be those of another edge on another thread */
+int edge_scatter_atomic() {
+    int i, t;
+    int v0;
+    int v1;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, i, v0, v1)
+    for (t = 0; t < nparts; t++) {
+        for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+#pragma omp atomic
+            pt_data[v0][0] += gr.v0_data[i][0];
+#pragma omp atomic
+            pt_data[v0][1] += gr.v0_data[i][1];
+#pragma omp atomic
+            pt_data[v0][2] += gr.v0_data[i][2];
+
+#pragma omp atomic
+            pt_data[v1][0] += gr.v1_data[i][0];
+#pragma omp atomic
+            pt_data[v1][1] += gr.v1_data[i][1];
+#pragma omp atomic
+            pt_data[v1][2] += gr.v1_data[i][2];
+        }
+    }
+
+    return 0;
+}
+
+/* no two edges of a color share a point, so the edges of a color are
+ * added without atomics */
+int edge_scatter_color() {
+    int c, k;
+    int i;
+    int v0;
+    int v1;
+
+    for (c = 0; c < colors.ncolors; c++) {
+#pragma omp parallel for \
+    private(k, i, v0, v1)
+        for (k = colors.start[c]; k < colors.start[c + 1]; k++) {
+            i = colors.edges[k];
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            pt_data[v0][0] += gr.v0_data[i][0];
+            pt_data[v0][1] += gr.v0_data[i][1];
+            pt_data[v0][2] += gr.v0_data[i][2];
+
+            pt_data[v1][0] += gr.v1_data[i][0];
+            pt_data[v1][1] += gr.v1_data[i][1];
+            pt_data[v1][2] += gr.v1_data[i][2];
+        }
+    }
+
+    return 0;
+}
+
+/* the copy of the points of this thread, zeroed */
+float (*private_zero())[3] {
+    int p;
+    float (*acc)[3];
+
+    acc = (float (*)[3]) (priv + omp_get_thread_num() * (size_t) npoints * 3);
+    for (p = 0; p < npoints; p++) {
+        acc[p][0] = 0;
+        acc[p][1] = 0;
+        acc[p][2] = 0;
+    }
+
+    return acc;
+}
+
+/* sums the copies of the points pairwise in log2(threads) steps, each over
+ * all the points, and adds the sum to pt_data. called by all threads */
+void private_sum() {
+    int p, s, t, nt;
+    size_t n = (size_t) npoints * 3;
+
+    nt = omp_get_num_threads();
+    for (s = 1; s < nt; s *= 2) {
+#pragma omp for
+        for (p = 0; p < npoints * 3; p++) {
+            for (t = 0; t + s < nt; t += 2 * s) {
+                priv[t * n + p] += priv[(t + s) * n + p];
+            }
+        }
+    }
+
+#pragma omp for
+    for (p = 0; p < npoints; p++) {
+        pt_data[p][0] += priv[3*p+0];
+        pt_data[p][1] += priv[3*p+1];
+        pt_data[p][2] += priv[3*p+2];
+    }
+}
+
+/* each thread adds its edges to its own copy of the points */
+int edge_scatter_private() {
+#pragma omp parallel
+    {
+        int i, t;
+        int v0;
+        int v1;
+        float (*acc)[3] = private_zero();
+
+#pragma omp for schedule(static, 1)
+        for (t = 0; t < nparts; t++) {
+            for (i = part_edges[t]; i < part_edges[t + 1]; i++) {
+                v0 = gr.v0[i];
+                v1 = gr.v1[i];
+
+                acc[v0][0] += gr.v0_data[i][0];
+                acc[v0][1] += gr.v0_data[i][1];
+                acc[v0][2] += gr.v0_data[i][2];
+
+                acc[v1][0] += gr.v1_data[i][0];
+                acc[v1][1] += gr.v1_data[i][1];
+                acc[v1][2] += gr.v1_data[i][2];
+            }
+        }
+
+        private_sum();
+    }
+
+    return 0;
+}
+
+/* the atomic scatter in the compressed forms, a block of edges at a time
+ * on each thread */
+int edge_scatter_blocks() {
+    int b, n, i, j;
+    const int* v0;
+    const int* v1;
+
+#pragma omp parallel for \
+    private(b, n, i, j, v0, v1)
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        int blk_v0[UMMA_BLOCK];
+        int blk_v1[UMMA_BLOCK];
+
+        n = block_index(b, blk_v0, blk_v1, &v0, &v1);
+
+        if (accumulate == ACCUM_DOUBLE) {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+#pragma omp atomic
+                pt_wide[v0[j]][0] += gr.v0_data[i][0];
+#pragma omp atomic
+                pt_wide[v0[j]][1] += gr.v0_data[i][1];
+#pragma omp atomic
+                pt_wide[v0[j]][2] += gr.v0_data[i][2];
+
+#pragma omp atomic
+                pt_wide[v1[j]][0] += gr.v1_data[i][0];
+#pragma omp atomic
+                pt_wide[v1[j]][1] += gr.v1_data[i][1];
+#pragma omp atomic
+                pt_wide[v1[j]][2] += gr.v1_data[i][2];
+            }
+        } else {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+#pragma omp atomic
+                pt_data[v0[j]][0] += gr.v0_data[i][0];
+#pragma omp atomic
+                pt_data[v0[j]][1] += gr.v0_data[i][1];
+#pragma omp atomic
+                pt_data[v0[j]][2] += gr.v0_data[i][2];
+
+#pragma omp atomic
+                pt_data[v1[j]][0] += gr.v1_data[i][0];
+#pragma omp atomic
+                pt_data[v1[j]][1] += gr.v1_data[i][1];
+#pragma omp atomic
+                pt_data[v1[j]][2] += gr.v1_data[i][2];
+            }
+        }
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    if (compressed) {
+        return edge_scatter_blocks();
+    }
+    if (scatter == SCATTER_COLOR) {
+        return edge_scatter_color();
+    }
+    if (scatter == SCATTER_PRIVATE) {
+        return edge_scatter_private();
+    }
+    return edge_scatter_atomic();
+}
+
+/* the fused pass over entries k0 .. k1 - 1 of list, or edges k0 .. k1 - 1
+ * without a list, from the points at the start of the loop into dst, with
+ * atomic adds if atomic */
+void fused_edges(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic) {
+    int k, i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float e_data;
+
+    for (k = k0; k < k1; k++) {
+        i = list != NULL ? list[k] : k;
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+        e_data = edge_data[i];
+
+        x0 = (pt_last[v0][0] + pt_last[v1][0]) * e_data;
+        x1 = (pt_last[v0][1] + pt_last[v1][1]) * e_data;
+        x2 = (pt_last[v0][2] + pt_last[v1][2]) * e_data;
+
+        if (atomic) {
+#pragma omp atomic
+            dst[v0][0] += x0;
+#pragma omp atomic
+            dst[v0][1] += x1;
+#pragma omp atomic
+            dst[v0][2] += x2;
+
+#pragma omp atomic
+            dst[v1][0] += x0;
+#pragma omp atomic
+            dst[v1][1] += x1;
+#pragma omp atomic
+            dst[v1][2] += x2;
+        } else {
+            dst[v0][0] += x0;
+            dst[v0][1] += x1;
+            dst[v0][2] += x2;
+
+            dst[v1][0] += x0;
+            dst[v1][1] += x1;
+            dst[v1][2] += x2;
+        }
+    }
+}
+
+/* the three phases over the same edges as fused_edges, a block at a time,
+ * the temporaries of a block in buffers that stay in cache */
+void pipelined_edges(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic) {
+    int b, n, i, j;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float blk_v0_data[UMMA_BLOCK][3];
+    float blk_v1_data[UMMA_BLOCK][3];
+    float blk_data[UMMA_BLOCK];
+
+    for (b = k0; b < k1; b += UMMA_BLOCK) {
+        n = k1 - b < UMMA_BLOCK ? k1 - b : UMMA_BLOCK;
+
+        for (j = 0; j < n; j++) {
+            i = list != NULL ? list[b + j] : b + j;
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            blk_v0_data[j][0] = pt_last[v0][0];
+            blk_v0_data[j][1] = pt_last[v0][1];
+            blk_v0_data[j][2] = pt_last[v0][2];
+
+            blk_v1_data[j][0] = pt_last[v1][0];
+            blk_v1_data[j][1] = pt_last[v1][1];
+            blk_v1_data[j][2] = pt_last[v1][2];
+
+            blk_data[j] = edge_data[i];
+        }
+
+        for (j = 0; j < n; j++) {
+            x0 = (blk_v0_data[j][0] + blk_v1_data[j][0]) * blk_data[j];
+            x1 = (blk_v0_data[j][1] + blk_v1_data[j][1]) * blk_data[j];
+            x2 = (blk_v0_data[j][2] + blk_v1_data[j][2]) * blk_data[j];
+
+            blk_v0_data[j][0] = x0;
+            blk_v0_data[j][1] = x1;
+            blk_v0_data[j][2] = x2;
+
+            blk_v1_data[j][0] = x0;
+            blk_v1_data[j][1] = x1;
+            blk_v1_data[j][2] = x2;
+        }
+
+        for (j = 0; j < n; j++) {
+            i = list != NULL ? list[b + j] : b + j;
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            if (atomic) {
+#pragma omp atomic
+                dst[v0][0] += blk_v0_data[j][0];
+#pragma omp atomic
+                dst[v0][1] += blk_v0_data[j][1];
+#pragma omp atomic
+                dst[v0][2] += blk_v0_data[j][2];
+
+#pragma omp atomic
+                dst[v1][0] += blk_v1_data[j][0];
+#pragma omp atomic
+                dst[v1][1] += blk_v1_data[j][1];
+#pragma omp atomic
+                dst[v1][2] += blk_v1_data[j][2];
+            } else {
+                dst[v0][0] += blk_v0_data[j][0];
+                dst[v0][1] += blk_v0_data[j][1];
+                dst[v0][2] += blk_v0_data[j][2];
+
+                dst[v1][0] += blk_v1_data[j][0];
+                dst[v1][1] += blk_v1_data[j][1];
+                dst[v1][2] += blk_v1_data[j][2];
+            }
+        }
+    }
+}
+
+typedef void (*edges_fn)(const int* list, int k0, int k1, float (*dst)[3],
+        int atomic);
+
+/* runs fn over all the edges, a block of them at a time on each thread,
+ * adding into the points as --scatter asks */
+int edge_pass(edges_fn fn) {
+    int b, c, t, k0, k1;
+
+#pragma omp parallel for schedule(static, 1) \
+    private(t, b)
+    for (t = 0; t < nparts; t++) {
+        for (b = part_pts[t]; b < part_pts[t + 1]; b++) {
+            pt_last[b][0] = pt_data[b][0];
+            pt_last[b][1] = pt_data[b][1];
+            pt_last[b][2] = pt_data[b][2];
+        }
+    }
+
+    if (scatter == SCATTER_COLOR) {
+        for (c = 0; c < colors.ncolors; c++) {
+            k0 = colors.start[c];
+            k1 = colors.start[c + 1];
+#pragma omp parallel for \
+    private(b)
+            for (b = k0; b < k1; b += UMMA_BLOCK) {
+                fn(colors.edges, b, k1 - b < UMMA_BLOCK ? k1 : b + UMMA_BLOCK,
+                        pt_data, 0);
+            }
+        }
+    } else if (scatter == SCATTER_PRIVATE) {
+#pragma omp parallel \
+    private(b)
+        {
+            float (*acc)[3] = private_zero();
+
+#pragma omp for schedule(static, 1) \
+    private(t, k1)
+            for (t = 0; t < nparts; t++) {
+                k1 = part_edges[t + 1];
+                for (b = part_edges[t]; b < k1; b += UMMA_BLOCK) {
+                    fn(NULL, b, k1 - b < UMMA_BLOCK ? k1 : b + UMMA_BLOCK,
+                            acc, 0);
+                }
+            }
+
+            private_sum();
+        }
+    } else {
+#pragma omp parallel for schedule(static, 1) \
+    private(t, b, k1)
+        for (t = 0; t < nparts; t++) {
+            k1 = part_edges[t + 1];
+            for (b = part_edges[t]; b < k1; b += UMMA_BLOCK) {
+                fn(NULL, b, k1 - b < UMMA_BLOCK ? k1 : b + UMMA_BLOCK,
+                        pt_data, 1);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* prints the results from the points in the numbering of the graph made */
+void print_results(double time, int nloops) {
+    int p;
+    float (*xyz)[3];
+
+    if (part_order == NULL) {
+        umma_print_results(&pt_data[0][0], npoints, time, nloops);
+        return;
+    }
+
+    xyz = (float (*)[3]) malloc(npoints * 3 * sizeof(float));
+    if (xyz == NULL) {
+        return;
+    }
+    for (p = 0; p < npoints; p++) {
+        xyz[part_order[p]][0] = pt_data[p][0];
+        xyz[part_order[p]][1] = pt_data[p][1];
+        xyz[part_order[p]][2] = pt_data[p][2];
+    }
+    umma_print_results(&xyz[0][0], npoints, time, nloops);
+    free(xyz);
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    double phase_time[UMMA_NPHASES] = {0};
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    pass = opts.pass;
+    prefetch = opts.prefetch;
+    gather_width = opts.gather_width;
+    if ((pass != PASS_PHASES || opts.scatter != SCATTER_ATOMIC) &&
+            (opts.index_form != INDEX_INT ||
+             opts.value_form != VALUE_FLOAT ||
+             opts.accumulate != ACCUM_FLOAT)) {
+        printf("The compressed forms have the phases pass and atomic "
+                "scatter only. \n");
+        exit(0);
+    }
+
+    // initialize data structures, each thread touching its part first
+    if (umma_edges_init(&opts, &el) < 0 || parts_init(&opts, &el) < 0 ||
+            scatter_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+    umma_print_binding();
+    if (scatter == SCATTER_COLOR) {
+        printf("Scatter: color, %d colors \n", colors.ncolors);
+    } else if (scatter == SCATTER_PRIVATE) {
+        printf("Scatter: private, %d threads \n", nthreads);
+    }
+
+    data_init();
+    edge_data_init();
+    if (forms_init(&opts) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        time1 = timer();
+        if (pass == PASS_FUSED) {
+            edge_pass(fused_edges);
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else if (pass == PASS_PIPELINED) {
+            edge_pass(pipelined_edges);
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else {
+            edge_gather();
+            phase_time[PHASE_GATHER] += timer() - time1;
+            time1 = timer();
+            edge_compute();
+            phase_time[PHASE_COMPUTE] += timer() - time1;
+            time1 = timer();
+            edge_scatter();
+            phase_time[PHASE_SCATTER] += timer() - time1;
+        }
+    }
+    time1 = timer();
+    forms_free();
+
+    print_results(time1 - time0, opts.nloops);
+    umma_print_phases(&opts, phase_time, npoints, nedges);
+
+    graph_free();
+    parts_free();
+
+    return 0;
+}
@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "umma.h"
+
+struct graph {
+    int* v0;
+    int* v1;
+    float (*v0_data)[3];
+    float (*v1_data)[3];
+    float* data;
+};
+
+int npoints;
+int nedges;
+float (*pt_data)[3];
+float* edge_data;
+struct graph gr;
+
+/* the pass of --pass, and the points at the start of the loop, which the
+ * fused and pipelined passes read while they add into pt_data */
+int pass;
+float (*pt_last)[3];
+
+/* the --prefetch distance and --gather-width of the gather */
+int prefetch;
+int gather_width;
+
+/* the --index, --edge-data and --accumulate forms of the phases, if any is
+ * not the default: the point numbers as deltas, the values of the edges as
+ * halves and the points summed as doubles in pt_wide */
+int compressed;
+int index_form;
+int value_form;
+int accumulate;
+struct umma_index gr_index;
+unsigned short* edge_half;
+double (*pt_wide)[3];
+
+/* takes over the edge arrays of el */
+int graph_init(struct edge_list* el) {
+    int i, j;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    gr.v0 = el->v0;
+    gr.v1 = el->v1;
+    gr.v0_data = (float (*)[3]) umma_alloc(nedges * 3 * sizeof(float));
+    gr.v1_data = (float (*)[3]) umma_alloc(nedges * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc(nedges * sizeof(float));
+    pt_data = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float (*)[3]) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (gr.v0_data == NULL || gr.v1_data == NULL || gr.data == NULL ||
+            pt_data == NULL || pt_last == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < nedges; i++) {
+        for (j = 0; j < 3; j++) {
+            gr.v0_data[i][j] = 0;
+            gr.v1_data[i][j] = 0;
+        }
+    }
+
+    el->v0 = NULL;
+    el->v1 = NULL;
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(gr.v0, nedges * sizeof(int));
+    umma_free(gr.v1, nedges * sizeof(int));
+    umma_free(gr.v0_data, nedges * 3 * sizeof(float));
+    umma_free(gr.v1_data, nedges * 3 * sizeof(float));
+    umma_free(gr.data, nedges * sizeof(float));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/* the forms of opts from the edges and data of the plain ones */
+int forms_init(const struct umma_opts* opts) {
+    struct edge_list el = {npoints, nedges, gr.v0, gr.v1};
+    int i;
+
+    index_form = opts->index_form;
+    value_form = opts->value_form;
+    accumulate = opts->accumulate;
+    compressed = index_form != INDEX_INT || value_form != VALUE_FLOAT ||
+        accumulate != ACCUM_FLOAT;
+
+    if (index_form == INDEX_DELTA16 && umma_index_init(&el, &gr_index) < 0) {
+        return -1;
+    }
+    if (value_form == VALUE_HALF) {
+        edge_half = (unsigned short*) umma_alloc(nedges *
+                sizeof(unsigned short));
+        if (edge_half == NULL) {
+            return -1;
+        }
+        umma_float_to_half(edge_data, edge_half, nedges);
+    }
+    if (accumulate == ACCUM_DOUBLE) {
+        pt_wide = (double (*)[3]) umma_alloc(npoints * 3 * sizeof(double));
+        if (pt_wide == NULL) {
+            return -1;
+        }
+        for (i = 0; i < npoints; i++) {
+            pt_wide[i][0] = pt_data[i][0];
+            pt_wide[i][1] = pt_data[i][1];
+            pt_wide[i][2] = pt_data[i][2];
+        }
+    }
+
+    return 0;
+}
+
+/* the points summed as doubles back to pt_data */
+void forms_free() {
+    int i;
+
+    if (index_form == INDEX_DELTA16) {
+        umma_index_free(&gr_index);
+    }
+    umma_free(edge_half, nedges * sizeof(unsigned short));
+    if (pt_wide != NULL) {
+        for (i = 0; i < npoints; i++) {
+            pt_data[i][0] = (float) pt_wide[i][0];
+            pt_data[i][1] = (float) pt_wide[i][1];
+            pt_data[i][2] = (float) pt_wide[i][2];
+        }
+        umma_free(pt_wide, npoints * 3 * sizeof(double));
+    }
+}
+
+/* the point numbers of edges b .. b + UMMA_BLOCK - 1, decoded into the
+ * buffers or in place, returns the number of edges */
+int block_index(int b, int* blk_v0, int* blk_v1, const int** v0,
+        const int** v1) {
+    if (index_form == INDEX_DELTA16) {
+        *v0 = blk_v0;
+        *v1 = blk_v1;
+        return umma_index_decode(&gr_index, b / UMMA_BLOCK, blk_v0, blk_v1);
+    }
+    *v0 = gr.v0 + b;
+    *v1 = gr.v1 + b;
+    return nedges - b < UMMA_BLOCK ? nedges - b : UMMA_BLOCK;
+}
+
+/* the gather in the compressed forms, a block of edges at a time */
+int edge_gather_blocks() {
+    int b, n, i, j;
+    const int* v0;
+    const int* v1;
+    static int blk_v0[UMMA_BLOCK];
+    static int blk_v1[UMMA_BLOCK];
+
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        n = block_index(b, blk_v0, blk_v1, &v0, &v1);
+
+        if (accumulate == ACCUM_DOUBLE) {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+                gr.v0_data[i][0] = (float) pt_wide[v0[j]][0];
+                gr.v0_data[i][1] = (float) pt_wide[v0[j]][1];
+                gr.v0_data[i][2] = (float) pt_wide[v0[j]][2];
+
+                gr.v1_data[i][0] = (float) pt_wide[v1[j]][0];
+                gr.v1_data[i][1] = (float) pt_wide[v1[j]][1];
+                gr.v1_data[i][2] = (float) pt_wide[v1[j]][2];
+            }
+        } else {
+            umma_gather_points(&pt_data[0][0], v0, &gr.v0_data[b][0], n,
+                    gather_width, prefetch);
+            umma_gather_points(&pt_data[0][0], v1, &gr.v1_data[b][0], n,
+                    gather_width, prefetch);
+        }
+
+        if (value_form == VALUE_HALF) {
+            umma_half_to_float(edge_half + b, gr.data + b, n);
+        } else {
+            memcpy(gr.data + b, edge_data + b, n * sizeof(float));
+        }
+    }
+
+    return 0;
+}
+
+int edge_gather() {
+    int i;
+    int v0;
+    int v1;
+
+    if (compressed) {
+        return edge_gather_blocks();
+    }
+    if (prefetch > 0 || gather_width > 1) {
+        umma_gather_points(&pt_data[0][0], gr.v0, &gr.v0_data[0][0], nedges,
+                gather_width, prefetch);
+        umma_gather_points(&pt_data[0][0], gr.v1, &gr.v1_data[0][0], nedges,
+                gather_width, prefetch);
+        memcpy(gr.data, edge_data, nedges * sizeof(float));
+        return 0;
+    }
+
+    for (i = 0; i < nedges; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        gr.v0_data[i][0] = pt_data[v0][0];
+        gr.v0_data[i][1] = pt_data[v0][1];
+        gr.v0_data[i][2] = pt_data[v0][2];
+
+        gr.v1_data[i][0] = pt_data[v1][0];
+        gr.v1_data[i][1] = pt_data[v1][1];
+        gr.v1_data[i][2] = pt_data[v1][2];
+
+        gr.data[i] = edge_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+    for (i = 0; i < nedges; i++) {
+        v0_p0 = gr.v0_data[i][0];
+        v0_p1 = gr.v0_data[i][1];
+        v0_p2 = gr.v0_data[i][2];
+
+        v1_p0 = gr.v1_data[i][0];
+        v1_p1 = gr.v1_data[i][1];
+        v1_p2 = gr.v1_data[i][2];
+
+        e_data = gr.data[i];
+
+        x0 = (v0_p0 + v1_p0) * e_data;
+        x1 = (v0_p1 + v1_p1) * e_data;
+        x2 = (v0_p2 + v1_p2) * e_data;
+
+        gr.v0_data[i][0] = x0;
+        gr.v0_data[i][1] = x1;
+        gr.v0_data[i][2] = x2;
+
+        gr.v1_data[i][0] = x0;
+        gr.v1_data[i][1] = x1;
+        gr.v1_data[i][2] = x2;
+    }
+
+    return 0;
+}
+
+/* the scatter in the compressed forms, a block of edges at a time */
+int edge_scatter_blocks() {
+    int b, n, i, j;
+    const int* v0;
+    const int* v1;
+    static int blk_v0[UMMA_BLOCK];
+    static int blk_v1[UMMA_BLOCK];
+
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        n = block_index(b, blk_v0, blk_v1, &v0, &v1);
+
+        if (accumulate == ACCUM_DOUBLE) {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+                pt_wide[v0[j]][0] += gr.v0_data[i][0];
+                pt_wide[v0[j]][1] += gr.v0_data[i][1];
+                pt_wide[v0[j]][2] += gr.v0_data[i][2];
+
+                pt_wide[v1[j]][0] += gr.v1_data[i][0];
+                pt_wide[v1[j]][1] += gr.v1_data[i][1];
+                pt_wide[v1[j]][2] += gr.v1_data[i][2];
+            }
+        } else {
+            for (j = 0; j < n; j++) {
+                i = b + j;
+
+                pt_data[v0[j]][0] += gr.v0_data[i][0];
+                pt_data[v0[j]][1] += gr.v0_data[i][1];
+                pt_data[v0[j]][2] += gr.v0_data[i][2];
+
+                pt_data[v1[j]][0] += gr.v1_data[i][0];
+                pt_data[v1[j]][1] += gr.v1_data[i][1];
+                pt_data[v1[j]][2] += gr.v1_data[i][2];
+            }
+        }
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    int i;
+    int v0;
+    int v1;
+
+    if (compressed) {
+        return edge_scatter_blocks();
+    }
+
+    for (i = 0; i < nedges; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        pt_data[v0][0] += gr.v0_data[i][0];
+        pt_data[v0][1] += gr.v0_data[i][1];
+        pt_data[v0][2] += gr.v0_data[i][2];
+
+        pt_data[v1][0] += gr.v1_data[i][0];
+        pt_data[v1][1] += gr.v1_data[i][1];
+        pt_data[v1][2] += gr.v1_data[i][2];
+    }
+
+    return 0;
+}
+
+/* gather, compute and scatter in one pass over the edges, from the points
+ * at the start of the loop, without the edge temporaries */
+int edge_fused() {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float e_data;
+
+    memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+
+    for (i = 0; i < nedges; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+        e_data = edge_data[i];
+
+        x0 = (pt_last[v0][0] + pt_last[v1][0]) * e_data;
+        x1 = (pt_last[v0][1] + pt_last[v1][1]) * e_data;
+        x2 = (pt_last[v0][2] + pt_last[v1][2]) * e_data;
+
+        pt_data[v0][0] += x0;
+        pt_data[v0][1] += x1;
+        pt_data[v0][2] += x2;
+
+        pt_data[v1][0] += x0;
+        pt_data[v1][1] += x1;
+        pt_data[v1][2] += x2;
+    }
+
+    return 0;
+}
+
+/* the three phases over a block of edges at a time, the temporaries of a
+ * block in buffers that stay in cache */
+int edge_pipelined() {
+    int b, n, i, j;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    static float blk_v0_data[UMMA_BLOCK][3];
+    static float blk_v1_data[UMMA_BLOCK][3];
+    static float blk_data[UMMA_BLOCK];
+
+    memcpy(pt_last, pt_data, npoints * 3 * sizeof(float));
+
+    for (b = 0; b < nedges; b += UMMA_BLOCK) {
+        n = nedges - b < UMMA_BLOCK ? nedges - b : UMMA_BLOCK;
+
+        for (j = 0; j < n; j++) {
+            i = b + j;
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            blk_v0_data[j][0] = pt_last[v0][0];
+            blk_v0_data[j][1] = pt_last[v0][1];
+            blk_v0_data[j][2] = pt_last[v0][2];
+
+            blk_v1_data[j][0] = pt_last[v1][0];
+            blk_v1_data[j][1] = pt_last[v1][1];
+            blk_v1_data[j][2] = pt_last[v1][2];
+
+            blk_data[j] = edge_data[i];
+        }
+
+        for (j = 0; j < n; j++) {
+            x0 = (blk_v0_data[j][0] + blk_v1_data[j][0]) * blk_data[j];
+            x1 = (blk_v0_data[j][1] + blk_v1_data[j][1]) * blk_data[j];
+            x2 = (blk_v0_data[j][2] + blk_v1_data[j][2]) * blk_data[j];
+
+            blk_v0_data[j][0] = x0;
+            blk_v0_data[j][1] = x1;
+            blk_v0_data[j][2] = x2;
+
+            blk_v1_data[j][0] = x0;
+            blk_v1_data[j][1] = x1;
+            blk_v1_data[j][2] = x2;
+        }
+
+        for (j = 0; j < n; j++) {
+            i = b + j;
+            v0 = gr.v0[i];
+            v1 = gr.v1[i];
+
+            pt_data[v0][0] += blk_v0_data[j][0];
+            pt_data[v0][1] += blk_v0_data[j][1];
+            pt_data[v0][2] += blk_v0_data[j][2];
+
+            pt_data[v1][0] += blk_v1_data[j][0];
+            pt_data[v1][1] += blk_v1_data[j][1];
+            pt_data[v1][2] += blk_v1_data[j][2];
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1;
+    double phase_time[UMMA_NPHASES] = {0};
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    pass = opts.pass;
+    prefetch = opts.prefetch;
+    gather_width = opts.gather_width;
+    if (pass != PASS_PHASES && (opts.index_form != INDEX_INT ||
+                opts.value_form != VALUE_FLOAT ||
+                opts.accumulate != ACCUM_FLOAT)) {
+        printf("The compressed forms have the phases pass only. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+
+    data_init();
+    edge_data_init();
+    if (forms_init(&opts) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+
+    // loop
+    time0 = timer();
+    for (i = 0; i < opts.nloops; i++) {
+        time1 = timer();
+        if (pass == PASS_FUSED) {
+            edge_fused();
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else if (pass == PASS_PIPELINED) {
+            edge_pipelined();
+            phase_time[PHASE_LOOP] += timer() - time1;
+        } else {
+            edge_gather();
+            phase_time[PHASE_GATHER] += timer() - time1;
+            time1 = timer();
+            edge_compute();
+            phase_time[PHASE_COMPUTE] += timer() - time1;
+            time1 = timer();
+            edge_scatter();
+            phase_time[PHASE_SCATTER] += timer() - time1;
+        }
+    }
+    time1 = timer();
+    forms_free();
+
+    umma_print_results(&pt_data[0][0], npoints, time1 - time0, opts.nloops);
+    umma_print_phases(&opts, phase_time, npoints, nedges);
+
+    graph_free();
+
+    return 0;
+}
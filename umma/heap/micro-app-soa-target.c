@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "umma.h"
+
+/* the arrays of the graph, mapped to the device for all the loops */
+struct graph {
+    int* v0;
+    int* v1;
+    float* v0_data;
+    float* v1_data;
+    float* data;
+};
+
+int npoints;
+int nedges;
+float* pt_data;
+float* pt_last;
+float* edge_data;
+struct graph gr;
+
+/* takes over the edge arrays of el */
+int graph_init(struct edge_list* el) {
+    int i;
+
+    npoints = el->npoints;
+    nedges = el->nedges;
+
+    gr.v0 = el->v0;
+    gr.v1 = el->v1;
+    gr.v0_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.v1_data = (float*) umma_alloc(nedges * 3 * sizeof(float));
+    gr.data = (float*) umma_alloc(nedges * sizeof(float));
+    pt_data = (float*) umma_alloc(npoints * 3 * sizeof(float));
+    pt_last = (float*) umma_alloc(npoints * 3 * sizeof(float));
+    edge_data = (float*) umma_alloc(nedges * sizeof(float));
+    if (gr.v0_data == NULL || gr.v1_data == NULL || gr.data == NULL ||
+            pt_data == NULL || pt_last == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < nedges * 3; i++) {
+        gr.v0_data[i] = 0;
+        gr.v1_data[i] = 0;
+    }
+
+    el->v0 = NULL;
+    el->v1 = NULL;
+
+    return 0;
+}
+
+void graph_free() {
+    umma_free(gr.v0, nedges * sizeof(int));
+    umma_free(gr.v1, nedges * sizeof(int));
+    umma_free(gr.v0_data, nedges * 3 * sizeof(float));
+    umma_free(gr.v1_data, nedges * 3 * sizeof(float));
+    umma_free(gr.data, nedges * sizeof(float));
+    umma_free(pt_data, npoints * 3 * sizeof(float));
+    umma_free(pt_last, npoints * 3 * sizeof(float));
+    umma_free(edge_data, nedges * sizeof(float));
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[3*i+0] = 1;
+        pt_data[3*i+1] = 1;
+        pt_data[3*i+2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * The phases each run as one target region on the arrays main maps for all
+ * the loops, so a loop copies nothing. They take the arrays as pointers,
+ * which a target region finds mapped and translates to the device copies;
+ * the pointers in a struct passed in would not be.
+ */
+
+int edge_gather(float* pt, float* e_data, int* g_v0, int* g_v1,
+        float* g_v0_data, float* g_v1_data, float* g_data, int n) {
+    int i;
+    int v0;
+    int v1;
+
+#pragma omp target teams distribute parallel for \
+    private(v0, v1)
+    for (i = 0; i < n; i++) {
+        v0 = g_v0[i];
+        v1 = g_v1[i];
+
+        g_v0_data[3*i+0] = pt[3*v0+0];
+        g_v0_data[3*i+1] = pt[3*v0+1];
+        g_v0_data[3*i+2] = pt[3*v0+2];
+
+        g_v1_data[3*i+0] = pt[3*v1+0];
+        g_v1_data[3*i+1] = pt[3*v1+1];
+        g_v1_data[3*i+2] = pt[3*v1+2];
+
+        g_data[i] = e_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute(float* g_v0_data, float* g_v1_data, float* g_data,
+        int n) {
+    int i;
+    float v0_p0, v0_p1, v0_p2;
+    float v1_p0, v1_p1, v1_p2;
+    float x0, x1, x2;
+    float e_data;
+
+#pragma omp target teams distribute parallel for \
+    private(v0_p0, v0_p1, v0_p2, v1_p0, v1_p1, v1_p2, x0, x1, x2, e_data)
+    for (i = 0; i < n; i++) {
+        v0_p0 = g_v0_data[3*i+0];
+        v0_p1 = g_v0_data[3*i+1];
+        v0_p2 = g_v0_data[3*i+2];
+
+        v1_p0 = g_v1_data[3*i+0];
+        v1_p1 = g_v1_data[3*i+1];
+        v1_p2 = g_v1_data[3*i+2];
+
+        e_data = g_data[i];
+
+        x0 = (v0_p0 + v1_p0) * e_data;
+        x1 = (v0_p1 + v1_p1) * e_data;
+        x2 = (v0_p2 + v1_p2) * e_data;
+
+        g_v0_data[3*i+0] = x0;
+        g_v0_data[3*i+1] = x1;
+        g_v0_data[3*i+2] = x2;
+
+        g_v1_data[3*i+0] = x0;
+        g_v1_data[3*i+1] = x1;
+        g_v1_data[3*i+2] = x2;
+    }
+
+    return 0;
+}
+
+int edge_scatter(float* pt, int* g_v0, int* g_v1, float* g_v0_data,
+        float* g_v1_data, int n) {
+    int i;
+    int v0;
+    int v1;
+
+#pragma omp target teams distribute parallel for \
+    private(v0, v1)
+    for (i = 0; i < n; i++) {
+        v0 = g_v0[i];
+        v1 = g_v1[i];
+
+#pragma omp atomic
+        pt[3*v0+0] += g_v0_data[3*i+0];
+#pragma omp atomic
+        pt[3*v0+1] += g_v0_data[3*i+1];
+#pragma omp atomic
+        pt[3*v0+2] += g_v0_data[3*i+2];
+
+#pragma omp atomic
+        pt[3*v1+0] += g_v1_data[3*i+0];
+#pragma omp atomic
+        pt[3*v1+1] += g_v1_data[3*i+1];
+#pragma omp atomic
+        pt[3*v1+2] += g_v1_data[3*i+2];
+    }
+
+    return 0;
+}
+
+/* gather, compute and scatter in one pass, from the points at the start of
+ * the loop, copied on the device, into pt */
+int edge_fused(float* last, float* pt, float* e_data, int* g_v0, int* g_v1,
+        int n, int np) {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < np * 3; i++) {
+        last[i] = pt[i];
+    }
+
+#pragma omp target teams distribute parallel for \
+    private(v0, v1, x0, x1, x2)
+    for (i = 0; i < n; i++) {
+        v0 = g_v0[i];
+        v1 = g_v1[i];
+
+        x0 = (last[3*v0+0] + last[3*v1+0]) * e_data[i];
+        x1 = (last[3*v0+1] + last[3*v1+1]) * e_data[i];
+        x2 = (last[3*v0+2] + last[3*v1+2]) * e_data[i];
+
+#pragma omp atomic
+        pt[3*v0+0] += x0;
+#pragma omp atomic
+        pt[3*v0+1] += x1;
+#pragma omp atomic
+        pt[3*v0+2] += x2;
+
+#pragma omp atomic
+        pt[3*v1+0] += x0;
+#pragma omp atomic
+        pt[3*v1+1] += x1;
+#pragma omp atomic
+        pt[3*v1+2] += x2;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    double time0, time1, time2, time3;
+    struct umma_opts opts;
+    struct edge_list el;
+
+    umma_parse_args(argc, argv, &opts);
+    if (opts.pass == PASS_PIPELINED) {
+        printf("The target version has no pipelined pass. \n");
+        exit(0);
+    }
+    if (opts.scatter != SCATTER_ATOMIC) {
+        printf("The target version has the atomic scatter only. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    if (umma_edges_init(&opts, &el) < 0 || graph_init(&el) < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", npoints, nedges);
+    printf("Devices: %d, running on %s \n", omp_get_num_devices(),
+            omp_get_num_devices() > 0 ? "device 0" : "the host");
+
+    data_init();
+    edge_data_init();
+
+    // loop, with the arrays on the device from the first loop to the last
+    time0 = timer();
+#pragma omp target data \
+    map(tofrom: pt_data[0:npoints*3]) \
+    map(to: gr.v0[0:nedges], gr.v1[0:nedges], edge_data[0:nedges]) \
+    map(alloc: gr.v0_data[0:nedges*3], gr.v1_data[0:nedges*3], \
+            gr.data[0:nedges], pt_last[0:npoints*3])
+    {
+        time1 = timer();
+        for (i = 0; i < opts.nloops; i++) {
+            if (opts.pass == PASS_FUSED) {
+                edge_fused(pt_last, pt_data, edge_data, gr.v0, gr.v1,
+                        nedges, npoints);
+            } else {
+                edge_gather(pt_data, edge_data, gr.v0, gr.v1, gr.v0_data,
+                        gr.v1_data, gr.data, nedges);
+                edge_compute(gr.v0_data, gr.v1_data, gr.data, nedges);
+                edge_scatter(pt_data, gr.v0, gr.v1, gr.v0_data, gr.v1_data,
+                        nedges);
+            }
+        }
+        time2 = timer();
+    }
+    time3 = timer();
+
+    printf("Transfer: %f s to the device, %f s back \n", time1 - time0,
+            time3 - time2);
+    umma_print_results(pt_data, npoints, time2 - time1, opts.nloops);
+
+    graph_free();
+
+    return 0;
+}
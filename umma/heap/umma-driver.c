@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "umma.h"
+
+/*
+ * Runs heap versions one after the other on one graph: the graph is made
+ * once, as for any version, and written to a binary file that each version
+ * maps with --type binary, so they all run on the same edges without making
+ * it again. Each version writes its points with --results, which are
+ * checked against those of the first one, and the times and errors end up
+ * in one table.
+ *
+ *     heap-umma-driver --type rmat --nedges 1000000 --nloops 10 \
+ *         --variants soa-serial,soa-openmp,csr-openmp
+ *
+ * takes the options of the versions, the graph ones used here and the
+ * others passed on, and
+ *
+ *     --variants the versions to run, comma separated, soa-serial first by
+ *                default, all of them if not given
+ *     --bindir   the directory of the heap-micro-app-* binaries, . if not
+ *                given
+ */
+
+/* the versions of --variants, the ones built by make heap */
+static const char* all_variants[] = {
+    "soa-serial", "aos-serial", "csr-serial", "aosoa-serial",
+    "soa-openmp", "aos-openmp", "csr-openmp", "aosoa-openmp",
+    "soa-ispc", "aos-ispc", "aosoa-ispc",
+    "soa-cuda", "aos-cuda", "soa-target",
+    NULL
+};
+
+/* the options of the graph, made here and not passed on */
+static const char* graph_options[] = {
+    "--type", "--file", "--npoints", "--nedges", "--reorder", "--save",
+    "--results", NULL
+};
+
+/* largest relative error of a point against the first version for which a
+ * version still passes, what summing the floats in another order costs */
+#define UMMA_TOLERANCE 1e-4
+
+#define MAX_VARIANTS 32
+#define MAX_ARGS 64
+
+/* the outcome of a version */
+struct run {
+    char name[32];
+    double time;
+    double error;
+    const char* status;
+    char message[80];
+};
+
+/* runs argv with its output into out, size bytes at most, and returns its
+ * exit status, 127 if it can not be run */
+static int run_command(char** argv, char* out, size_t size) {
+    int fd[2];
+    int status;
+    size_t n = 0;
+    ssize_t r;
+    pid_t pid;
+
+    if (pipe(fd) < 0) {
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(fd[1], STDOUT_FILENO);
+        dup2(fd[1], STDERR_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    close(fd[1]);
+    while ((r = read(fd[0], out + n, size - 1 - n)) > 0) {
+        n += r;
+        if (n == size - 1) {
+            // keep draining so the version does not block
+            char skip[4096];
+            while (read(fd[0], skip, sizeof(skip)) > 0) {
+            }
+            break;
+        }
+    }
+    out[n] = '\0';
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) < 0) {
+        return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* the npoints * 3 floats of a --results file, NULL if it has fewer */
+static float* read_points(const char* fname, int npoints) {
+    FILE* f;
+    float* pt;
+
+    pt = (float*) malloc(npoints * 3 * sizeof(float));
+    f = fopen(fname, "rb");
+    if (pt == NULL || f == NULL ||
+            fread(pt, 3 * sizeof(float), npoints, f) != (size_t) npoints) {
+        free(pt);
+        pt = NULL;
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+
+    return pt;
+}
+
+/* the largest error of pt against ref, relative to the point of ref */
+static double max_error(const float* ref, const float* pt, int npoints) {
+    double e, m = 0;
+    int i;
+
+    for (i = 0; i < npoints * 3; i++) {
+        e = fabs((double) pt[i] - ref[i]) / fmax(fabs((double) ref[i]), 1);
+        if (e > m || e != e) {
+            m = e;
+        }
+    }
+
+    return m;
+}
+
+static int is_graph_option(const char* arg) {
+    int i;
+    size_t n;
+
+    for (i = 0; graph_options[i] != NULL; i++) {
+        n = strlen(graph_options[i]);
+        if (strncmp(arg, graph_options[i], n) == 0 &&
+                (arg[n] == '\0' || arg[n] == '=')) {
+            return arg[n] == '\0' ? 2 : 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    struct umma_opts opts;
+    struct edge_list el;
+    char* variants = NULL;
+    char* bindir = ".";
+    char* names[MAX_VARIANTS];
+    int nvariants = 0;
+    char* opt_argv[MAX_ARGS];
+    int opt_argc = 0;
+    char* pass_argv[MAX_ARGS];
+    int pass_argc = 0;
+    char* argv_v[MAX_ARGS];
+    struct run runs[MAX_VARIANTS];
+    char gname[] = "/tmp/umma-graph-XXXXXX";
+    char rname[64];
+    char bin[1024];
+    static char out[1 << 16];
+    float* ref = NULL;
+    float* pt;
+    char* s;
+    char* line;
+    int fd, i, j, k, rc;
+
+    // the options of the driver out, the rest to umma_parse_args
+    opt_argv[opt_argc++] = argv[0];
+    for (i = 1; i < argc && opt_argc < MAX_ARGS - 1; i++) {
+        if (strcmp(argv[i], "--variants") == 0 && i + 1 < argc) {
+            variants = argv[++i];
+        } else if (strcmp(argv[i], "--bindir") == 0 && i + 1 < argc) {
+            bindir = argv[++i];
+        } else {
+            opt_argv[opt_argc++] = argv[i];
+        }
+    }
+    opt_argv[opt_argc] = NULL;
+
+    // and the ones that are not about the graph to the versions
+    for (i = 1; i < opt_argc && pass_argc < MAX_ARGS - 8; i++) {
+        k = is_graph_option(opt_argv[i]);
+        if (k == 2) {
+            i++;
+        } else if (k == 0) {
+            pass_argv[pass_argc++] = opt_argv[i];
+        }
+    }
+
+    if (variants == NULL) {
+        for (i = 0; all_variants[i] != NULL; i++) {
+            names[nvariants++] = (char*) all_variants[i];
+        }
+    } else {
+        for (s = strtok(variants, ","); s != NULL && nvariants < MAX_VARIANTS;
+                s = strtok(NULL, ",")) {
+            names[nvariants++] = s;
+        }
+    }
+
+    umma_parse_args(opt_argc, opt_argv, &opts);
+
+    // initialize data structures
+    fd = mkstemp(gname);
+    if (fd < 0) {
+        printf("Error creating %s. \n", gname);
+        exit(0);
+    }
+    close(fd);
+    if (umma_edges_init(&opts, &el) < 0 ||
+            umma_edges_save(gname, &el) < 0) {
+        printf("Error creating graph. \n");
+        unlink(gname);
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges \n", el.npoints, el.nedges);
+    umma_print_binding();
+    snprintf(rname, sizeof(rname), "%s.pts", gname);
+
+    for (j = 0; j < nvariants; j++) {
+        snprintf(runs[j].name, sizeof(runs[j].name), "%s", names[j]);
+        runs[j].time = 0;
+        runs[j].error = 0;
+        runs[j].status = "ok";
+        runs[j].message[0] = '\0';
+
+        snprintf(bin, sizeof(bin), "%s/heap-micro-app-%s", bindir, names[j]);
+        k = 0;
+        argv_v[k++] = bin;
+        for (i = 0; i < pass_argc; i++) {
+            argv_v[k++] = pass_argv[i];
+        }
+        argv_v[k++] = "--type";
+        argv_v[k++] = "binary";
+        argv_v[k++] = "--file";
+        argv_v[k++] = gname;
+        argv_v[k++] = "--results";
+        argv_v[k++] = rname;
+        argv_v[k] = NULL;
+
+        unlink(rname);
+        rc = run_command(argv_v, out, sizeof(out));
+        if (rc == 127 && access(bin, X_OK) != 0) {
+            runs[j].status = "not built";
+            continue;
+        }
+
+        s = strstr(out, "Time:");
+        pt = read_points(rname, el.npoints);
+        if (s == NULL || pt == NULL) {
+            // the version turned the options down, keep what it said
+            runs[j].status = "failed";
+            line = strtok(out, "\n");
+            while (line != NULL && (strncmp(line, "Graph:", 6) == 0 ||
+                    strncmp(line, "Partition:", 10) == 0 ||
+                    strncmp(line, "Binding:", 8) == 0)) {
+                line = strtok(NULL, "\n");
+            }
+            snprintf(runs[j].message, sizeof(runs[j].message), "%s",
+                    line != NULL ? line : "");
+            for (i = strlen(runs[j].message); i > 0 &&
+                    runs[j].message[i - 1] == ' '; i--) {
+                runs[j].message[i - 1] = '\0';
+            }
+            free(pt);
+            continue;
+        }
+        sscanf(s, "Time: %lf", &runs[j].time);
+
+        if (ref == NULL) {
+            ref = pt;
+            continue;
+        }
+        runs[j].error = max_error(ref, pt, el.npoints);
+        if (!(runs[j].error <= UMMA_TOLERANCE)) {
+            runs[j].status = "WRONG";
+        }
+        free(pt);
+    }
+
+    // the first version that ran is the reference
+    printf("\n%-16s %12s %8s %12s  %s \n", "variant", "time/loop", "speedup",
+            "max error", "status");
+    for (j = 0, k = -1; j < nvariants; j++) {
+        if (k < 0 && strcmp(runs[j].status, "ok") == 0) {
+            k = j;
+        }
+        if (strcmp(runs[j].status, "ok") != 0 &&
+                strcmp(runs[j].status, "WRONG") != 0) {
+            printf("%-16s %12s %8s %12s  %s %s \n", runs[j].name, "-", "-",
+                    "-", runs[j].status, runs[j].message);
+            continue;
+        }
+        printf("%-16s %12f %8.2f %12.3g  %s \n", runs[j].name, runs[j].time,
+                runs[k].time / runs[j].time, runs[j].error, runs[j].status);
+    }
+
+    free(ref);
+    unlink(rname);
+    unlink(gname);
+    umma_edges_free(&el);
+
+    return 0;
+}
@@ -0,0 +1,1795 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "umma.h"
+#include "cody_perf.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UMMA_X86 1
+#include <immintrin.h>
+#else
+#define UMMA_X86 0
+#endif
+
+/* whether umma_alloc puts the large arrays on huge pages */
+static int use_hugepages = 0;
+
+/* the --results file of umma_print_results */
+static const char* results_file = NULL;
+
+/* the version run, the name of its binary, and its ranks, for the CODY
+ * rows */
+static const char* variant = "umma";
+static int nprocs = 1;
+
+/* the --scatter names, by SCATTER_* */
+static const char* scatter_names[] = {
+    "atomic", "color", "private", "warp", "sorted"
+};
+
+/* the --pass names, by PASS_* */
+static const char* pass_names[] = {
+    "phases", "fused", "pipelined"
+};
+
+/* the --reorder names, by REORDER_* */
+static const char* reorder_names[] = {
+    "none", "sort", "bfs", "rcm", "degree"
+};
+
+/* the --index, --edge-data and --accumulate names, by INDEX_*, VALUE_* and
+ * ACCUM_* */
+static const char* index_names[] = {
+    "int", "delta16"
+};
+
+static const char* value_names[] = {
+    "float", "half"
+};
+
+static const char* accum_names[] = {
+    "float", "double"
+};
+
+/* the --partition names, by PARTITION_* */
+static const char* partition_names[] = {
+    "block", "rgb"
+};
+
+void print_help() {
+    printf("Usage: \n");
+    printf("\t --help print this message and exit \n");
+    printf("\t --type Type of graph, must be one of:\n");
+    printf("\t\t\t pure_random \n");
+    printf("\t\t\t regular_random \n");
+    printf("\t\t\t contiguous \n");
+    printf("\t\t\t file \n");
+    printf("\t\t\t binary (file written by --save) \n");
+    printf("\t\t\t rmat (power-law R-MAT graph of nedges edges) \n");
+    printf("\t\t\t mesh2d (triangulated grid, degree 6) \n");
+    printf("\t\t\t mesh3d (tetrahedral grid, degree 14) \n");
+    printf("\t --nloops Number of repetitions, must be \n");
+    printf("\t          at least one. \n");
+    printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Number of points, %d by default \n", NPOINTS);
+    printf("\t --nedges Number of edges (pure_random, file) or \n");
+    printf("\t          edges per point (regular_random), %d by \n", NEDGES);
+    printf("\t          default \n");
+    printf("\t --save Write the graph to a binary file \n");
+    printf("\t --scatter Scatter of the OpenMP and CUDA versions, one of: \n");
+    printf("\t\t\t atomic (default) \n");
+    printf("\t\t\t color (edges colored, a color at a time, OpenMP) \n");
+    printf("\t\t\t private (a copy of the points per thread, OpenMP) \n");
+    printf("\t\t\t warp (atomics combined in a warp, CUDA) \n");
+    printf("\t\t\t sorted (a sum per point of its edges, CUDA) \n");
+    printf("\t --pass Passes over the edges of a loop, one of: \n");
+    printf("\t\t\t phases (default, gather, compute, scatter) \n");
+    printf("\t\t\t fused (the three in one pass) \n");
+    printf("\t\t\t pipelined (the three per block of %d edges) \n",
+            UMMA_BLOCK);
+    printf("\t --prefetch Prefetch the points of the edge this many \n");
+    printf("\t          edges ahead in the gather, 0 (default) for none \n");
+    printf("\t --gather-width Points per gather instruction in the soa \n");
+    printf("\t          gathers: 1 (default, scalar loads), 8 (AVX2) \n");
+    printf("\t          or 16 (AVX-512) \n");
+    printf("\t --stream Measure the STREAM triad after the run and \n");
+    printf("\t          compare the bandwidth of the loop to it \n");
+    printf("\t --persistent CUDA versions: copy the data to the device \n");
+    printf("\t          once and run the loops there, as one CUDA graph \n");
+    printf("\t --tasks ISPC versions: launch this many tasks over the \n");
+    printf("\t          edges, 0 (default) to run on one core \n");
+    printf("\t --results Write all the points at the end to this file \n");
+    printf("\t --index soa versions: point numbers of the edges, int \n");
+    printf("\t          (default) or delta16 (16-bit deltas, best after \n");
+    printf("\t          --reorder) \n");
+    printf("\t --edge-data soa versions: values of the edges stored as \n");
+    printf("\t          float (default) or half \n");
+    printf("\t --accumulate soa versions: points summed as float \n");
+    printf("\t          (default) or double \n");
+    printf("\t --partition MPI version and --edge-partition: partition \n");
+    printf("\t          of the points over the ranks or threads, one of: \n");
+    printf("\t\t\t rgb (default, recursive graph bisection) \n");
+    printf("\t\t\t block (consecutive points, best after --reorder) \n");
+    printf("\t --edge-partition soa OpenMP version: each thread loops \n");
+    printf("\t          over the edges of the points of its part, \n");
+    printf("\t          renumbered to be contiguous \n");
+    printf("\t --hugepages Put the large arrays on huge pages \n");
+    printf("\t --reorder Renumbering of the points before the run, \n");
+    printf("\t          one of: \n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t sort (edges sorted by point only) \n");
+    printf("\t\t\t bfs \n");
+    printf("\t\t\t rcm (reverse Cuthill-McKee) \n");
+    printf("\t\t\t degree (most edges first) \n");
+}
+
+double timer() {
+    return cody_now();
+}
+
+/* whether this CPU has gather instructions of width floats */
+static int gather_supported(int width) {
+    if (width == 1) {
+        return 1;
+    }
+#if UMMA_X86
+    __builtin_cpu_init();
+    if (width == 8) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (width == 16) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return 0;
+}
+
+int umma_parse_args(int argc, char** argv, struct umma_opts* opts) {
+    int c, opt_i, i;
+
+    static struct option long_opts[] = {
+        {"help",      no_argument,       0, 0},
+        {"type",      required_argument, 0, 0},
+        {"nloops",    required_argument, 0, 0},
+        {"file",      required_argument, 0, 0},
+        {"npoints",   required_argument, 0, 0},
+        {"nedges",    required_argument, 0, 0},
+        {"hugepages", no_argument,       0, 0},
+        {"reorder",   required_argument, 0, 0},
+        {"save",      required_argument, 0, 0},
+        {"scatter",   required_argument, 0, 0},
+        {"pass",      required_argument, 0, 0},
+        {"prefetch",  required_argument, 0, 0},
+        {"gather-width", required_argument, 0, 0},
+        {"stream",    no_argument,       0, 0},
+        {"persistent", no_argument,      0, 0},
+        {"tasks",     required_argument, 0, 0},
+        {"results",   required_argument, 0, 0},
+        {"index",     required_argument, 0, 0},
+        {"edge-data", required_argument, 0, 0},
+        {"accumulate", required_argument, 0, 0},
+        {"partition", required_argument, 0, 0},
+        {"edge-partition", no_argument,  0, 0},
+        {0, 0, 0, 0}
+    };
+
+    opts->type = "";
+    opts->fname = NULL;
+    opts->nloops = 0;
+    opts->npoints = NPOINTS;
+    opts->nedges = NEDGES;
+    opts->hugepages = 0;
+    opts->reorder = REORDER_NONE;
+    opts->save = NULL;
+    opts->scatter = SCATTER_ATOMIC;
+    opts->pass = PASS_PHASES;
+    opts->prefetch = 0;
+    opts->gather_width = 1;
+    opts->stream = 0;
+    opts->persistent = 0;
+    opts->tasks = 0;
+    opts->results = NULL;
+    opts->index_form = INDEX_INT;
+    opts->value_form = VALUE_FLOAT;
+    opts->accumulate = ACCUM_FLOAT;
+    opts->partition = PARTITION_RGB;
+    opts->edge_partition = 0;
+
+    /* Parse command-line arguments */
+    while (1) {
+        c = getopt_long(argc, argv, "",
+                long_opts, &opt_i);
+
+        if (c == -1) {
+            break;
+        }
+
+        if (c == 0) {
+            switch (opt_i) {
+                case 0:
+                    print_help();
+                    exit(0);
+                case 1:
+                    opts->type = optarg;
+                    break;
+                case 2:
+                    opts->nloops = atoi(optarg);
+                    break;
+                case 3:
+                    opts->fname = optarg;
+                    break;
+                case 4:
+                    opts->npoints = atoi(optarg);
+                    break;
+                case 5:
+                    opts->nedges = atoi(optarg);
+                    break;
+                case 6:
+                    opts->hugepages = 1;
+                    break;
+                case 7:
+                    opts->reorder = -1;
+                    for (i = REORDER_NONE; i <= REORDER_DEGREE; i++) {
+                        if (strcmp(optarg, reorder_names[i]) == 0) {
+                            opts->reorder = i;
+                        }
+                    }
+                    if (opts->reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 8:
+                    opts->save = optarg;
+                    break;
+                case 9:
+                    opts->scatter = -1;
+                    for (i = SCATTER_ATOMIC; i <= SCATTER_SORTED; i++) {
+                        if (strcmp(optarg, scatter_names[i]) == 0) {
+                            opts->scatter = i;
+                        }
+                    }
+                    if (opts->scatter < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    opts->pass = -1;
+                    for (i = PASS_PHASES; i <= PASS_PIPELINED; i++) {
+                        if (strcmp(optarg, pass_names[i]) == 0) {
+                            opts->pass = i;
+                        }
+                    }
+                    if (opts->pass < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 11:
+                    opts->prefetch = atoi(optarg);
+                    break;
+                case 12:
+                    opts->gather_width = atoi(optarg);
+                    break;
+                case 13:
+                    opts->stream = 1;
+                    break;
+                case 14:
+                    opts->persistent = 1;
+                    break;
+                case 15:
+                    opts->tasks = atoi(optarg);
+                    break;
+                case 16:
+                    opts->results = optarg;
+                    break;
+                case 17:
+                    opts->index_form = -1;
+                    for (i = INDEX_INT; i <= INDEX_DELTA16; i++) {
+                        if (strcmp(optarg, index_names[i]) == 0) {
+                            opts->index_form = i;
+                        }
+                    }
+                    if (opts->index_form < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 18:
+                    opts->value_form = -1;
+                    for (i = VALUE_FLOAT; i <= VALUE_HALF; i++) {
+                        if (strcmp(optarg, value_names[i]) == 0) {
+                            opts->value_form = i;
+                        }
+                    }
+                    if (opts->value_form < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 19:
+                    opts->accumulate = -1;
+                    for (i = ACCUM_FLOAT; i <= ACCUM_DOUBLE; i++) {
+                        if (strcmp(optarg, accum_names[i]) == 0) {
+                            opts->accumulate = i;
+                        }
+                    }
+                    if (opts->accumulate < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 20:
+                    opts->partition = -1;
+                    for (i = PARTITION_BLOCK; i <= PARTITION_RGB; i++) {
+                        if (strcmp(optarg, partition_names[i]) == 0) {
+                            opts->partition = i;
+                        }
+                    }
+                    if (opts->partition < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 21:
+                    opts->edge_partition = 1;
+                    break;
+            }
+        } else {
+            print_help();
+            exit(0);
+        }
+    }
+
+    /* check for errors */
+    if (opts->nloops < 1 || opts->npoints < 2 || opts->nedges < 1) {
+        print_help();
+        exit(0);
+    }
+
+    if (opts->prefetch < 0 || opts->tasks < 0 ||
+            (opts->gather_width != 1 && opts->gather_width != 8 &&
+             opts->gather_width != 16)) {
+        print_help();
+        exit(0);
+    }
+    if (!gather_supported(opts->gather_width)) {
+        printf("This CPU has no gather of %d points. \n",
+                opts->gather_width);
+        exit(0);
+    }
+
+    use_hugepages = opts->hugepages;
+    results_file = opts->results;
+
+    cody_init("umma");
+    variant = strrchr(argv[0], '/') != NULL ? strrchr(argv[0], '/') + 1
+                                            : argv[0];
+
+    return 0;
+}
+
+void* umma_alloc(size_t bytes) {
+    return cody_alloc(bytes, use_hugepages ? CODY_MEM_HUGE : 0);
+}
+
+void umma_free(void* p, size_t bytes) {
+    cody_free(p, bytes, use_hugepages ? CODY_MEM_HUGE : 0);
+}
+
+/* a xorshift64* generator for the graphs made here, seeded the same every
+ * run so a graph type and size is always the same graph */
+static unsigned long long rng_state;
+
+static unsigned long long rng_next() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* the R-MAT probabilities of the quadrants of the adjacency matrix, those
+ * of Graph500 */
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+static int edges_alloc(struct edge_list* el, int nedges) {
+    el->nedges = nedges;
+    el->v0 = (int*) umma_alloc(nedges * sizeof(int));
+    el->v1 = (int*) umma_alloc(nedges * sizeof(int));
+    if (el->v0 == NULL || el->v1 == NULL) {
+        umma_edges_free(el);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* opts->nedges edges of an R-MAT graph on the next power of two of
+ * opts->npoints points: each edge picks one quadrant of the adjacency
+ * matrix after the other down to a single entry, so the degrees follow a
+ * power law. the points are shuffled so that the ones of high degree are
+ * not all at the low numbers, loops are drawn again */
+static int create_rmat(const struct umma_opts* opts, struct edge_list* el) {
+    int scale, n, i, b, t, u, v;
+    int* perm;
+    double r;
+
+    for (scale = 1; (1 << scale) < opts->npoints; scale++) {
+    }
+    n = 1 << scale;
+
+    perm = (int*) malloc(n * sizeof(int));
+    if (perm == NULL || edges_alloc(el, opts->nedges) < 0) {
+        free(perm);
+        return -1;
+    }
+    el->npoints = n;
+
+    rng_state = 88172645463325252ULL;
+    for (i = 0; i < n; i++) {
+        perm[i] = i;
+    }
+    for (i = n - 1; i > 0; i--) {
+        t = rng_next() % (i + 1);
+        u = perm[i];
+        perm[i] = perm[t];
+        perm[t] = u;
+    }
+
+    i = 0;
+    while (i < el->nedges) {
+        u = 0;
+        v = 0;
+        for (b = 0; b < scale; b++) {
+            r = (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+            u <<= 1;
+            v <<= 1;
+            if (r >= RMAT_A + RMAT_B + RMAT_C) {
+                u |= 1;
+                v |= 1;
+            } else if (r >= RMAT_A + RMAT_B) {
+                u |= 1;
+            } else if (r >= RMAT_A) {
+                v |= 1;
+            }
+        }
+        if (u == v) {
+            continue;
+        }
+
+        u = perm[u];
+        v = perm[v];
+        el->v0[i] = u < v ? u : v;
+        el->v1[i] = u < v ? v : u;
+        i++;
+    }
+
+    free(perm);
+
+    return 0;
+}
+
+/* the offsets to the neighbours of a grid point that its edges go to, in
+ * x, y, z: the triangles of a square split along a diagonal and the six
+ * tetrahedra of a cube around its main diagonal (Kuhn's split) */
+static const int mesh2d_steps[][3] = {
+    {1, 0, 0}, {0, 1, 0}, {1, 1, 0}
+};
+static const int mesh3d_steps[][3] = {
+    {1, 0, 0}, {0, 1, 0}, {0, 0, 1},
+    {1, 1, 0}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}
+};
+
+/* a grid of dims dimensions with side points a side, the smallest one of at
+ * least opts->npoints points, numbered along x fastest. the edges of a
+ * point follow it, so the points of an edge are close in number like those
+ * of a mesh numbered well, and no point has more than 2 * nsteps edges */
+static int create_mesh(const struct umma_opts* opts, struct edge_list* el,
+        int dims, const int (*steps)[3], int nsteps) {
+    int side, n, i, x, y, z, s;
+    int x1, y1, z1, depth;
+    long ne;
+
+    for (side = 2; ; side++) {
+        n = dims == 2 ? side * side : side * side * side;
+        if (n >= opts->npoints) {
+            break;
+        }
+    }
+    depth = dims == 2 ? 1 : side;
+
+    // the edges whose far end is in the grid
+    ne = 0;
+    for (s = 0; s < nsteps; s++) {
+        ne += (long) (side - steps[s][0]) * (side - steps[s][1]) *
+            (depth - steps[s][2]);
+    }
+    if (edges_alloc(el, (int) ne) < 0) {
+        return -1;
+    }
+    el->npoints = n;
+
+    i = 0;
+    for (z = 0; z < depth; z++) {
+        for (y = 0; y < side; y++) {
+            for (x = 0; x < side; x++) {
+                for (s = 0; s < nsteps; s++) {
+                    x1 = x + steps[s][0];
+                    y1 = y + steps[s][1];
+                    z1 = z + steps[s][2];
+                    if (x1 >= side || y1 >= side || z1 >= depth) {
+                        continue;
+                    }
+                    el->v0[i] = (z * side + y) * side + x;
+                    el->v1[i] = (z1 * side + y1) * side + x1;
+                    i++;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* the graph types made here rather than by graph.lua */
+static int create_native(const struct umma_opts* opts, struct edge_list* el) {
+    if (strcmp(opts->type, "rmat") == 0) {
+        return create_rmat(opts, el);
+    }
+    if (strcmp(opts->type, "mesh2d") == 0) {
+        return create_mesh(opts, el, 2, mesh2d_steps, 3);
+    }
+    return create_mesh(opts, el, 3, mesh3d_steps, 7);
+}
+
+int umma_edges_init(const struct umma_opts* opts, struct edge_list* el) {
+    lua_State *L;
+    int i, k, v;
+
+    el->npoints = opts->npoints;
+    el->nedges = 0;
+    el->v0 = NULL;
+    el->v1 = NULL;
+
+    if (strcmp(opts->type, "binary") == 0) {
+        if (opts->fname == NULL || umma_edges_load(opts->fname, el) < 0) {
+            return -1;
+        }
+        goto loaded;
+    }
+    if (strcmp(opts->type, "rmat") == 0 || strcmp(opts->type, "mesh2d") == 0 ||
+            strcmp(opts->type, "mesh3d") == 0) {
+        if (create_native(opts, el) < 0) {
+            return -1;
+        }
+        goto loaded;
+    }
+
+    L = luaL_newstate();
+    luaL_openlibs(L);
+    luaL_loadfile(L, "graph.lua");
+    lua_pcall(L, 0, 0, 0);
+
+    lua_getglobal(L, "create_graph");
+    lua_pushstring(L, opts->type);
+    lua_pushinteger(L, opts->npoints);
+    lua_pushinteger(L, opts->nedges);
+
+    if (opts->fname != NULL) {
+        lua_pushstring(L, opts->fname);
+        lua_call(L, 4, 1);
+    } else {
+        lua_call(L, 3, 1);
+    }
+
+    /* Table is now sitting at the top of the stack, count its edges */
+    i = 0;
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        lua_pushnil(L);
+        while (lua_next(L, -2) != 0) {
+            lua_pop(L,1);
+            i++;
+        }
+        lua_pop(L,1);
+    }
+
+    if (i == 0) {
+        lua_close(L);
+        return -1;
+    }
+
+    el->nedges = i;
+    el->v0 = (int*) umma_alloc(i * sizeof(int));
+    el->v1 = (int*) umma_alloc(i * sizeof(int));
+    if (el->v0 == NULL || el->v1 == NULL) {
+        lua_close(L);
+        umma_edges_free(el);
+        return -1;
+    }
+
+    i = 0;
+    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
+    while (lua_next(L, -2) != 0) {
+        // fetch first key
+        k = lua_tointeger(L, -2);
+        lua_pushnil(L);
+        while (lua_next(L, -2) != 0) { // loop over neighbors
+            lua_pop(L,1);
+            v = lua_tointeger(L, -1);
+
+            el->v0[i] = k - 1;
+            el->v1[i] = v - 1;
+            if (k > el->npoints) {
+                el->npoints = k;
+            }
+            if (v > el->npoints) {
+                el->npoints = v;
+            }
+
+            i++;
+        }
+        lua_pop(L,1);
+    }
+
+    lua_close(L);
+
+loaded:
+    if (opts->reorder != REORDER_NONE && umma_reorder(opts, el) < 0) {
+        umma_edges_free(el);
+        return -1;
+    }
+
+    if (opts->save != NULL && umma_edges_save(opts->save, el) < 0) {
+        printf("Error writing %s. \n", opts->save);
+    }
+
+    return 0;
+}
+
+int umma_edges_load(const char* fname, struct edge_list* el) {
+    int fd, i;
+    struct stat st;
+    const struct umma_file_header* h;
+    const int* v;
+    void* map;
+    size_t bytes;
+    int rv = -1;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(*h)) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    h = (const struct umma_file_header*) map;
+    v = (const int*) (h + 1);
+    if (memcmp(h->magic, UMMA_MAGIC, sizeof(h->magic)) != 0 ||
+            h->nedges < 1 || h->npoints < 1 ||
+            st.st_size != (off_t) (sizeof(*h) +
+                2 * (size_t) h->nedges * sizeof(int))) {
+        goto out;
+    }
+
+    bytes = h->nedges * sizeof(int);
+    el->npoints = h->npoints;
+    el->nedges = h->nedges;
+    el->v0 = (int*) umma_alloc(bytes);
+    el->v1 = (int*) umma_alloc(bytes);
+    if (el->v0 == NULL || el->v1 == NULL) {
+        umma_edges_free(el);
+        goto out;
+    }
+    memcpy(el->v0, v, bytes);
+    memcpy(el->v1, v + h->nedges, bytes);
+
+    for (i = 0; i < el->nedges; i++) {
+        if (el->v0[i] < 0 || el->v0[i] >= el->npoints ||
+                el->v1[i] < 0 || el->v1[i] >= el->npoints) {
+            umma_edges_free(el);
+            goto out;
+        }
+    }
+    rv = 0;
+
+out:
+    munmap(map, st.st_size);
+    return rv;
+}
+
+int umma_edges_save(const char* fname, const struct edge_list* el) {
+    FILE* f;
+    struct umma_file_header h;
+    int rv = 0;
+
+    memcpy(h.magic, UMMA_MAGIC, sizeof(h.magic));
+    h.npoints = el->npoints;
+    h.nedges = el->nedges;
+
+    f = fopen(fname, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    if (fwrite(&h, sizeof(h), 1, f) != 1 ||
+            fwrite(el->v0, sizeof(int), el->nedges, f) !=
+            (size_t) el->nedges ||
+            fwrite(el->v1, sizeof(int), el->nedges, f) !=
+            (size_t) el->nedges) {
+        rv = -1;
+    }
+    if (fclose(f) != 0) {
+        rv = -1;
+    }
+    return rv;
+}
+
+void umma_edges_free(struct edge_list* el) {
+    umma_free(el->v0, el->nedges * sizeof(int));
+    umma_free(el->v1, el->nedges * sizeof(int));
+    el->v0 = NULL;
+    el->v1 = NULL;
+}
+
+int umma_csr_init(const struct edge_list* el, struct point_csr* csr) {
+    int i, p;
+    int* fill;
+
+    csr->npoints = el->npoints;
+    csr->nadj = 2 * el->nedges;
+    csr->start = (int*) umma_alloc((el->npoints + 1) * sizeof(int));
+    csr->adj = (int*) umma_alloc(csr->nadj * sizeof(int));
+    csr->end = (int*) umma_alloc(csr->nadj * sizeof(int));
+    fill = (int*) malloc((el->npoints + 1) * sizeof(int));
+    if (csr->start == NULL || csr->adj == NULL || csr->end == NULL ||
+            fill == NULL) {
+        free(fill);
+        umma_csr_free(csr);
+        return -1;
+    }
+
+    memset(csr->start, 0, (el->npoints + 1) * sizeof(int));
+    for (i = 0; i < el->nedges; i++) {
+        csr->start[el->v0[i] + 1]++;
+        csr->start[el->v1[i] + 1]++;
+    }
+    for (p = 0; p < el->npoints; p++) {
+        csr->start[p + 1] += csr->start[p];
+    }
+    memcpy(fill, csr->start, (el->npoints + 1) * sizeof(int));
+    for (i = 0; i < el->nedges; i++) {
+        csr->adj[fill[el->v0[i]]] = el->v1[i];
+        csr->end[fill[el->v0[i]]++] = 2 * i;
+        csr->adj[fill[el->v1[i]]] = el->v0[i];
+        csr->end[fill[el->v1[i]]++] = 2 * i + 1;
+    }
+
+    free(fill);
+    return 0;
+}
+
+void umma_csr_free(struct point_csr* csr) {
+    umma_free(csr->start, (csr->npoints + 1) * sizeof(int));
+    umma_free(csr->adj, csr->nadj * sizeof(int));
+    umma_free(csr->end, csr->nadj * sizeof(int));
+    csr->start = NULL;
+    csr->adj = NULL;
+    csr->end = NULL;
+}
+
+/* degrees for the qsort comparisons, which take no argument */
+static const int* sort_degree;
+
+static int by_degree(const void* a, const void* b) {
+    int pa = *(const int*) a;
+    int pb = *(const int*) b;
+    int da = sort_degree[pa + 1] - sort_degree[pa];
+    int db = sort_degree[pb + 1] - sort_degree[pb];
+
+    if (da != db) {
+        return da < db ? -1 : 1;
+    }
+    return pa < pb ? -1 : pa > pb;
+}
+
+static int by_degree_down(const void* a, const void* b) {
+    return by_degree(b, a);
+}
+
+/* the points in breadth first order, each component from the point of
+ * least degree not yet visited. rcm visits the neighbours of a point by
+ * increasing degree (Cuthill-McKee) and reverses the order at the end */
+static void order_bfs(const struct edge_list* el, const struct point_csr* a,
+        int rcm, int* order) {
+    int i, p, q, head, tail, lo;
+    int* roots;
+    char* seen;
+
+    roots = (int*) malloc(el->npoints * sizeof(int));
+    seen = (char*) calloc(el->npoints, 1);
+
+    for (p = 0; p < el->npoints; p++) {
+        roots[p] = p;
+    }
+    sort_degree = a->start;
+    qsort(roots, el->npoints, sizeof(int), by_degree);
+
+    tail = 0;
+    for (i = 0; i < el->npoints; i++) {
+        if (seen[roots[i]]) {
+            continue;
+        }
+        seen[roots[i]] = 1;
+        order[tail++] = roots[i];
+        for (head = tail - 1; head < tail; head++) {
+            p = order[head];
+            lo = tail;
+            for (q = a->start[p]; q < a->start[p + 1]; q++) {
+                if (!seen[a->adj[q]]) {
+                    seen[a->adj[q]] = 1;
+                    order[tail++] = a->adj[q];
+                }
+            }
+            if (rcm) {
+                qsort(order + lo, tail - lo, sizeof(int), by_degree);
+            }
+        }
+    }
+
+    if (rcm) {
+        for (i = 0; i < el->npoints / 2; i++) {
+            p = order[i];
+            order[i] = order[el->npoints - 1 - i];
+            order[el->npoints - 1 - i] = p;
+        }
+    }
+
+    free(roots);
+    free(seen);
+}
+
+static int by_edge(const void* a, const void* b) {
+    long long ea = *(const long long*) a;
+    long long eb = *(const long long*) b;
+
+    return ea < eb ? -1 : ea > eb;
+}
+
+/* seconds per loop of a gather and scatter of 3 floats per edge, the
+ * access pattern of the micro-apps */
+static double time_gather_scatter(const struct edge_list* el, int nloops) {
+    int i, l, v0, v1;
+    float* pt;
+    float* ed;
+    double time0, time1;
+
+    pt = (float*) calloc(el->npoints * 3, sizeof(float));
+    ed = (float*) malloc(el->nedges * 3 * sizeof(float));
+    if (pt == NULL || ed == NULL) {
+        free(pt);
+        free(ed);
+        return 0;
+    }
+
+    // the first loop, untimed, faults the arrays in
+    time0 = 0;
+    for (l = -1; l < nloops; l++) {
+        if (l == 0) {
+            time0 = timer();
+        }
+        for (i = 0; i < el->nedges; i++) {
+            v0 = el->v0[i];
+            v1 = el->v1[i];
+            ed[3*i+0] = pt[3*v0+0] + pt[3*v1+0] + 1;
+            ed[3*i+1] = pt[3*v0+1] + pt[3*v1+1] + 1;
+            ed[3*i+2] = pt[3*v0+2] + pt[3*v1+2] + 1;
+        }
+        for (i = 0; i < el->nedges; i++) {
+            v0 = el->v0[i];
+            v1 = el->v1[i];
+            pt[3*v0+0] += ed[3*i+0];
+            pt[3*v0+1] += ed[3*i+1];
+            pt[3*v0+2] += ed[3*i+2];
+            pt[3*v1+0] += ed[3*i+0];
+            pt[3*v1+1] += ed[3*i+1];
+            pt[3*v1+2] += ed[3*i+2];
+        }
+    }
+    time1 = timer();
+
+    free(pt);
+    free(ed);
+    return (time1 - time0) / nloops;
+}
+
+int umma_reorder(const struct umma_opts* opts, struct edge_list* el) {
+    int i, p;
+    int* order = NULL;
+    int* renum = NULL;
+    long long* keys = NULL;
+    struct point_csr a = {0, 0, NULL, NULL, NULL};
+    double time0, time1;
+    int rv = -1;
+
+    time0 = time_gather_scatter(el, opts->nloops);
+
+    order = (int*) malloc(el->npoints * sizeof(int));
+    renum = (int*) malloc(el->npoints * sizeof(int));
+    keys = (long long*) malloc(el->nedges * sizeof(long long));
+    if (order == NULL || renum == NULL || keys == NULL) {
+        goto out;
+    }
+
+    // order[new] = old
+    if (opts->reorder == REORDER_SORT) {
+        for (p = 0; p < el->npoints; p++) {
+            order[p] = p;
+        }
+    } else {
+        if (umma_csr_init(el, &a) < 0) {
+            goto out;
+        }
+        if (opts->reorder == REORDER_DEGREE) {
+            for (p = 0; p < el->npoints; p++) {
+                order[p] = p;
+            }
+            sort_degree = a.start;
+            qsort(order, el->npoints, sizeof(int), by_degree_down);
+        } else {
+            order_bfs(el, &a, opts->reorder == REORDER_RCM, order);
+        }
+    }
+    for (p = 0; p < el->npoints; p++) {
+        renum[order[p]] = p;
+    }
+
+    // renumber, then sort the edges by (v0, v1)
+    for (i = 0; i < el->nedges; i++) {
+        keys[i] = ((long long) renum[el->v0[i]] << 32) | renum[el->v1[i]];
+    }
+    qsort(keys, el->nedges, sizeof(long long), by_edge);
+    for (i = 0; i < el->nedges; i++) {
+        el->v0[i] = (int) (keys[i] >> 32);
+        el->v1[i] = (int) (keys[i] & 0xffffffff);
+    }
+
+    time1 = time_gather_scatter(el, opts->nloops);
+    printf("Reorder: %s, gather/scatter %f s -> %f s, speedup %.2f \n",
+            reorder_names[opts->reorder], time0, time1,
+            time1 > 0 ? time0 / time1 : 0);
+    rv = 0;
+
+out:
+    umma_csr_free(&a);
+    free(order);
+    free(renum);
+    free(keys);
+    return rv;
+}
+
+/* the state of the bisections of umma_partition. mark[p] is stamp for the
+ * points of the part being split and stamp + 1 once a sweep reached them,
+ * the sweeps append the points they reach to queue */
+struct bisection {
+    const struct point_csr* a;
+    int* part;
+    int* mark;
+    int* queue;
+    int stamp;
+};
+
+/* the work of point p, its edges and itself */
+static long long point_weight(const struct point_csr* a, int p) {
+    return a->start[p + 1] - a->start[p] + 1;
+}
+
+/* the first of the n points of pts to go to the second of two parts that
+ * take a fraction num / den of their weight and the rest */
+static int weight_split(const struct point_csr* a, const int* pts, int n,
+        int num, int den) {
+    long long total, goal, sum;
+    int i;
+
+    total = 0;
+    for (i = 0; i < n; i++) {
+        total += point_weight(a, pts[i]);
+    }
+    goal = total * num / den;
+    sum = 0;
+    for (i = 0; i < n && sum < goal; i++) {
+        sum += point_weight(a, pts[i]);
+    }
+    return i;
+}
+
+/* a breadth first sweep from root over the points marked stamp, marking
+ * them stamp + 1 and appending them to queue from tail, returns the new
+ * tail */
+static int sweep(struct bisection* b, int root, int tail) {
+    int head, p, k, q;
+
+    b->mark[root] = b->stamp + 1;
+    b->queue[tail++] = root;
+    for (head = tail - 1; head < tail; head++) {
+        p = b->queue[head];
+        for (k = b->a->start[p]; k < b->a->start[p + 1]; k++) {
+            q = b->a->adj[k];
+            if (b->mark[q] == b->stamp) {
+                b->mark[q] = b->stamp + 1;
+                b->queue[tail++] = q;
+            }
+        }
+    }
+    return tail;
+}
+
+/* splits the n points of pts into nparts parts from first: orders them by
+ * a sweep from the last point a sweep from pts[0] reaches, which is far
+ * from everything, each other component after it, and gives the first
+ * nparts / 2 parts worth of weight of that order to the first half */
+static void bisect(struct bisection* b, int* pts, int n, int first,
+        int nparts) {
+    int i, t, far, nleft, left;
+
+    if (nparts == 1) {
+        for (i = 0; i < n; i++) {
+            b->part[pts[i]] = first;
+        }
+        return;
+    }
+
+    b->stamp += 2;
+    for (i = 0; i < n; i++) {
+        b->mark[pts[i]] = b->stamp;
+    }
+    t = n > 0 ? sweep(b, pts[0], 0) : 0;
+    far = t > 0 ? b->queue[t - 1] : 0;
+    for (i = 0; i < t; i++) {
+        b->mark[b->queue[i]] = b->stamp;
+    }
+    t = t > 0 ? sweep(b, far, 0) : 0;
+    for (i = 0; i < n; i++) {
+        if (b->mark[pts[i]] == b->stamp) {
+            t = sweep(b, pts[i], t);
+        }
+    }
+    memcpy(pts, b->queue, n * sizeof(int));
+
+    nleft = nparts / 2;
+    left = weight_split(b->a, pts, n, nleft, nparts);
+    bisect(b, pts, left, first, nleft);
+    bisect(b, pts + left, n - left, first + nleft, nparts - nleft);
+}
+
+int umma_partition(int method, const struct edge_list* el, int nparts,
+        int* part) {
+    int p;
+    long long total, sum;
+    int* pts = NULL;
+    struct point_csr a = {0, 0, NULL, NULL, NULL};
+    struct bisection b;
+    int rv = -1;
+
+    pts = (int*) malloc(el->npoints * sizeof(int));
+    b.mark = (int*) malloc(el->npoints * sizeof(int));
+    b.queue = (int*) malloc(el->npoints * sizeof(int));
+    if (pts == NULL || b.mark == NULL || b.queue == NULL ||
+            umma_csr_init(el, &a) < 0) {
+        goto out;
+    }
+    for (p = 0; p < el->npoints; p++) {
+        pts[p] = p;
+        b.mark[p] = 0;
+    }
+
+    if (method == PARTITION_BLOCK) {
+        // a point goes to the part of the weight of the points before it
+        total = 0;
+        for (p = 0; p < el->npoints; p++) {
+            total += point_weight(&a, p);
+        }
+        sum = 0;
+        for (p = 0; p < el->npoints; p++) {
+            part[p] = (int) (sum * nparts / total);
+            sum += point_weight(&a, p);
+        }
+    } else {
+        b.a = &a;
+        b.part = part;
+        b.stamp = 0;
+        bisect(&b, pts, el->npoints, 0, nparts);
+    }
+    rv = 0;
+
+out:
+    umma_csr_free(&a);
+    free(pts);
+    free(b.mark);
+    free(b.queue);
+    return rv;
+}
+
+int umma_partition_edges(int method, struct edge_list* el, int nparts,
+        int* order, int* pt_start, int* edge_start) {
+    int i, p, t;
+    int* part = NULL;
+    int* renum = NULL;
+    long long* keys = NULL;
+    long long ncut;
+    int rv = -1;
+
+    part = (int*) malloc(el->npoints * sizeof(int));
+    renum = (int*) malloc(el->npoints * sizeof(int));
+    keys = (long long*) malloc(el->nedges * sizeof(long long));
+    if (part == NULL || renum == NULL || keys == NULL ||
+            umma_partition(method, el, nparts, part) < 0) {
+        goto out;
+    }
+
+    // the points of a part after those of the parts before it
+    for (t = 0; t <= nparts; t++) {
+        pt_start[t] = 0;
+    }
+    for (p = 0; p < el->npoints; p++) {
+        pt_start[part[p] + 1]++;
+    }
+    for (t = 0; t < nparts; t++) {
+        pt_start[t + 1] += pt_start[t];
+    }
+    memcpy(edge_start, pt_start, (nparts + 1) * sizeof(int));
+    for (p = 0; p < el->npoints; p++) {
+        renum[p] = edge_start[part[p]]++;
+        order[renum[p]] = p;
+    }
+
+    // renumber, then sort the edges by (v0, v1), so by the part of v0
+    for (i = 0; i < el->nedges; i++) {
+        keys[i] = ((long long) renum[el->v0[i]] << 32) | renum[el->v1[i]];
+    }
+    qsort(keys, el->nedges, sizeof(long long), by_edge);
+    for (i = 0; i < el->nedges; i++) {
+        el->v0[i] = (int) (keys[i] >> 32);
+        el->v1[i] = (int) (keys[i] & 0xffffffff);
+    }
+
+    ncut = 0;
+    for (t = 0, i = 0; t < nparts; t++) {
+        edge_start[t] = i;
+        for (; i < el->nedges && el->v0[i] < pt_start[t + 1]; i++) {
+            if (el->v1[i] < pt_start[t] || el->v1[i] >= pt_start[t + 1]) {
+                ncut++;
+            }
+        }
+    }
+    edge_start[nparts] = el->nedges;
+
+    printf("Partition: %s, %d threads, %lld edges to the points of "
+            "another thread (%.1f%%) \n", partition_names[method], nparts,
+            ncut, 100.0 * ncut / el->nedges);
+    rv = 0;
+
+out:
+    free(part);
+    free(renum);
+    free(keys);
+    return rv;
+}
+
+/* color c takes every edge still uncolored whose points no edge of color
+ * c has taken yet, in edge order */
+int umma_color_edges(const struct edge_list* el, struct edge_colors* ec) {
+    int i, k, c, n, nleft;
+    int* stamp;
+    int* left;
+    int* color;
+    int rv = -1;
+
+    ec->ncolors = 0;
+    ec->start = NULL;
+    ec->edges = (int*) malloc(el->nedges * sizeof(int));
+    stamp = (int*) malloc(el->npoints * sizeof(int));
+    left = (int*) malloc(el->nedges * sizeof(int));
+    color = (int*) malloc(el->nedges * sizeof(int));
+    if (ec->edges == NULL || stamp == NULL || left == NULL ||
+            color == NULL) {
+        goto out;
+    }
+
+    for (i = 0; i < el->npoints; i++) {
+        stamp[i] = -1;
+    }
+    for (i = 0; i < el->nedges; i++) {
+        left[i] = i;
+    }
+
+    nleft = el->nedges;
+    for (c = 0; nleft > 0; c++) {
+        n = 0;
+        for (k = 0; k < nleft; k++) {
+            i = left[k];
+            if (stamp[el->v0[i]] != c && stamp[el->v1[i]] != c) {
+                stamp[el->v0[i]] = c;
+                stamp[el->v1[i]] = c;
+                color[i] = c;
+            } else {
+                left[n++] = i;
+            }
+        }
+        nleft = n;
+    }
+    ec->ncolors = c;
+
+    // the edges of each color in edge order
+    ec->start = (int*) calloc(ec->ncolors + 1, sizeof(int));
+    if (ec->start == NULL) {
+        goto out;
+    }
+    for (i = 0; i < el->nedges; i++) {
+        ec->start[color[i] + 1]++;
+    }
+    for (c = 0; c < ec->ncolors; c++) {
+        ec->start[c + 1] += ec->start[c];
+    }
+    for (i = 0; i < el->nedges; i++) {
+        ec->edges[ec->start[color[i]]++] = i;
+    }
+    for (c = ec->ncolors; c > 0; c--) {
+        ec->start[c] = ec->start[c - 1];
+    }
+    ec->start[0] = 0;
+    rv = 0;
+
+out:
+    if (rv < 0) {
+        umma_colors_free(ec);
+    }
+    free(stamp);
+    free(left);
+    free(color);
+    return rv;
+}
+
+void umma_colors_free(struct edge_colors* ec) {
+    free(ec->start);
+    free(ec->edges);
+    ec->start = NULL;
+    ec->edges = NULL;
+}
+
+static void gather_points_scalar(const float* pt, const int* v, float* out,
+        int j, int n, int prefetch) {
+    int k;
+
+    for (; j < n; j++) {
+        if (prefetch > 0 && j + prefetch < n) {
+            __builtin_prefetch(&pt[3 * v[j + prefetch]]);
+        }
+        for (k = 0; k < 3; k++) {
+            out[3*j+k] = pt[3*v[j]+k];
+        }
+    }
+}
+
+#if UMMA_X86
+/* the points of 8 edges at a time by 3 gathers of a component each, stored
+ * back interleaved through a buffer, AVX2 having no scatter */
+__attribute__((target("avx2")))
+static void gather_points_avx2(const float* pt, const int* v, float* out,
+        int n, int prefetch) {
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i idx;
+    float x[3][8];
+    int j, k, l;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        if (prefetch > 0) {
+            for (l = 0; l < 8 && j + prefetch + l < n; l++) {
+                __builtin_prefetch(&pt[3 * v[j + prefetch + l]]);
+            }
+        }
+        idx = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*) (v + j)),
+                three);
+        for (k = 0; k < 3; k++) {
+            _mm256_storeu_ps(x[k], _mm256_i32gather_ps(pt, idx, 4));
+            idx = _mm256_add_epi32(idx, one);
+        }
+        for (l = 0; l < 8; l++) {
+            out[3*(j+l)+0] = x[0][l];
+            out[3*(j+l)+1] = x[1][l];
+            out[3*(j+l)+2] = x[2][l];
+        }
+    }
+    gather_points_scalar(pt, v, out, j, n, prefetch);
+}
+
+/* the points of 16 edges at a time by 3 gathers of a component each and 3
+ * scatters into place */
+__attribute__((target("avx512f")))
+static void gather_points_avx512(const float* pt, const int* v, float* out,
+        int n, int prefetch) {
+    const __m512i three = _mm512_set1_epi32(3);
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i lanes = _mm512_mullo_epi32(three, _mm512_setr_epi32(0, 1,
+                2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __m512i idx;
+    int j, k, l;
+
+    for (j = 0; j + 16 <= n; j += 16) {
+        if (prefetch > 0) {
+            for (l = 0; l < 16 && j + prefetch + l < n; l++) {
+                __builtin_prefetch(&pt[3 * v[j + prefetch + l]]);
+            }
+        }
+        idx = _mm512_mullo_epi32(_mm512_loadu_si512(v + j), three);
+        for (k = 0; k < 3; k++) {
+            _mm512_i32scatter_ps(out + 3 * j + k, lanes,
+                    _mm512_i32gather_ps(idx, pt, 4), 4);
+            idx = _mm512_add_epi32(idx, one);
+        }
+    }
+    gather_points_scalar(pt, v, out, j, n, prefetch);
+}
+#endif
+
+void umma_gather_points(const float* pt, const int* v, float* out, int n,
+        int width, int prefetch) {
+#if UMMA_X86
+    if (width == 16) {
+        gather_points_avx512(pt, v, out, n, prefetch);
+        return;
+    }
+    if (width == 8) {
+        gather_points_avx2(pt, v, out, n, prefetch);
+        return;
+    }
+#endif
+    gather_points_scalar(pt, v, out, 0, n, prefetch);
+}
+
+/* the deltas of el in a first pass to count the escapes, then in a second
+ * to fill in ix, the deltas of a block from the first v0 of the block */
+static int encode_index(const struct edge_list* el, struct umma_index* ix) {
+    int i, b, d, k = 0;
+    int p = 0;
+
+    for (i = 0; i < el->nedges; i++) {
+        b = i / UMMA_BLOCK;
+        if (i % UMMA_BLOCK == 0) {
+            p = el->v0[i];
+            if (ix->base != NULL) {
+                ix->base[b] = p;
+                ix->wide_start[b] = k;
+            }
+        }
+
+        d = el->v0[i] - p;
+        if (d > -32768 && d < 32768) {
+            if (ix->d0 != NULL) {
+                ix->d0[i] = (short) d;
+            }
+        } else {
+            if (ix->d0 != NULL) {
+                ix->d0[i] = UMMA_ESCAPE;
+                ix->wide[k] = el->v0[i];
+            }
+            k++;
+        }
+        p = el->v0[i];
+
+        d = el->v1[i] - p;
+        if (d > -32768 && d < 32768) {
+            if (ix->d1 != NULL) {
+                ix->d1[i] = (short) d;
+            }
+        } else {
+            if (ix->d1 != NULL) {
+                ix->d1[i] = UMMA_ESCAPE;
+                ix->wide[k] = el->v1[i];
+            }
+            k++;
+        }
+    }
+    if (ix->wide_start != NULL) {
+        ix->wide_start[ix->nblocks] = k;
+    }
+
+    return k;
+}
+
+int umma_index_init(const struct edge_list* el, struct umma_index* ix) {
+    ix->nedges = el->nedges;
+    ix->nblocks = (el->nedges + UMMA_BLOCK - 1) / UMMA_BLOCK;
+    ix->d0 = NULL;
+    ix->d1 = NULL;
+    ix->base = NULL;
+    ix->wide_start = NULL;
+    ix->wide = NULL;
+    ix->nwide = encode_index(el, ix);
+
+    ix->d0 = (short*) umma_alloc(ix->nedges * sizeof(short));
+    ix->d1 = (short*) umma_alloc(ix->nedges * sizeof(short));
+    ix->base = (int*) umma_alloc(ix->nblocks * sizeof(int));
+    ix->wide_start = (int*) umma_alloc((ix->nblocks + 1) * sizeof(int));
+    ix->wide = (int*) umma_alloc(ix->nwide * sizeof(int));
+    if (ix->d0 == NULL || ix->d1 == NULL || ix->base == NULL ||
+            ix->wide_start == NULL || ix->wide == NULL) {
+        umma_index_free(ix);
+        return -1;
+    }
+    encode_index(el, ix);
+
+    printf("Index: delta16, %d of %d point numbers escaped, %.2f bytes "
+            "per edge \n", ix->nwide, 2 * ix->nedges,
+            (4.0 * ix->nedges + 8.0 * ix->nblocks + 4.0 * ix->nwide) /
+            ix->nedges);
+
+    return 0;
+}
+
+void umma_index_free(struct umma_index* ix) {
+    umma_free(ix->d0, ix->nedges * sizeof(short));
+    umma_free(ix->d1, ix->nedges * sizeof(short));
+    umma_free(ix->base, ix->nblocks * sizeof(int));
+    umma_free(ix->wide_start, (ix->nblocks + 1) * sizeof(int));
+    umma_free(ix->wide, ix->nwide * sizeof(int));
+    ix->d0 = NULL;
+    ix->d1 = NULL;
+    ix->base = NULL;
+    ix->wide_start = NULL;
+    ix->wide = NULL;
+}
+
+int umma_index_decode(const struct umma_index* ix, int b, int* v0, int* v1) {
+    const short* d0 = ix->d0 + (long) b * UMMA_BLOCK;
+    const short* d1 = ix->d1 + (long) b * UMMA_BLOCK;
+    const int* wide = ix->wide + ix->wide_start[b];
+    int j, n;
+    int p = ix->base[b];
+
+    n = ix->nedges - b * UMMA_BLOCK;
+    n = n < UMMA_BLOCK ? n : UMMA_BLOCK;
+    for (j = 0; j < n; j++) {
+        p = d0[j] != UMMA_ESCAPE ? p + d0[j] : *wide++;
+        v0[j] = p;
+        v1[j] = d1[j] != UMMA_ESCAPE ? p + d1[j] : *wide++;
+    }
+
+    return n;
+}
+
+/* IEEE binary16 by hand, rounding to nearest even, for the CPUs without
+ * F16C */
+static unsigned short float_to_half(float f) {
+    unsigned int x, sign, mant, rem, half;
+    int e;
+
+    memcpy(&x, &f, sizeof(x));
+    sign = (x >> 16) & 0x8000;
+    mant = x & 0x7fffff;
+    if (((x >> 23) & 0xff) == 0xff) {
+        // infinity, or a quiet NaN
+        return sign | 0x7c00 | (mant != 0 ? 0x200 : 0);
+    }
+    e = (int) ((x >> 23) & 0xff) - 127 + 15;
+    if (e >= 31) {
+        return sign | 0x7c00;
+    }
+    if (e <= 0) {
+        // a subnormal half, or zero
+        if (e < -10) {
+            return sign;
+        }
+        mant |= 0x800000;
+        half = mant >> (14 - e);
+        rem = mant & ((1u << (14 - e)) - 1);
+        if (rem > (1u << (13 - e)) ||
+                (rem == (1u << (13 - e)) && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    // a carry out of the mantissa rounds up into the exponent
+    half = sign | (e << 10) | (mant >> 13);
+    rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return half;
+}
+
+static float half_to_float(unsigned short h) {
+    unsigned int sign = (unsigned int) (h & 0x8000) << 16;
+    unsigned int e = (h >> 10) & 0x1f;
+    unsigned int mant = h & 0x3ff;
+    unsigned int x;
+    float f;
+
+    if (e == 0x1f) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else if (e != 0) {
+        x = sign | ((e + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        x = sign;
+    } else {
+        // a subnormal half is a normal float
+        e = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            e--;
+        }
+        x = sign | (e << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+#if UMMA_X86
+__attribute__((target("avx,f16c")))
+static void float_to_half_f16c(const float* f, unsigned short* h, int n) {
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*) (h + i),
+                _mm256_cvtps_ph(_mm256_loadu_ps(f + i),
+                    _MM_FROUND_TO_NEAREST_INT));
+    }
+    for (; i < n; i++) {
+        h[i] = float_to_half(f[i]);
+    }
+}
+
+__attribute__((target("avx,f16c")))
+static void half_to_float_f16c(const unsigned short* h, float* f, int n) {
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(f + i,
+                _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (h + i))));
+    }
+    for (; i < n; i++) {
+        f[i] = half_to_float(h[i]);
+    }
+}
+
+/* whether this CPU has F16C, -1 until asked */
+static int has_f16c = -1;
+
+static int f16c_supported() {
+    if (has_f16c < 0) {
+        __builtin_cpu_init();
+        has_f16c = __builtin_cpu_supports("avx") &&
+            __builtin_cpu_supports("f16c");
+    }
+    return has_f16c;
+}
+#endif
+
+void umma_float_to_half(const float* f, unsigned short* h, int n) {
+    int i;
+
+#if UMMA_X86
+    if (f16c_supported()) {
+        float_to_half_f16c(f, h, n);
+        return;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+        h[i] = float_to_half(f[i]);
+    }
+}
+
+void umma_half_to_float(const unsigned short* h, float* f, int n) {
+    int i;
+
+#if UMMA_X86
+    if (f16c_supported()) {
+        half_to_float_f16c(h, f, n);
+        return;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+        f[i] = half_to_float(h[i]);
+    }
+}
+
+void umma_print_results(const float* pt_data, int npoints, double time,
+        int nloops) {
+    int i, nthreads;
+    FILE* f;
+
+    // print results
+    for (i = 0; i < 10 && i < npoints; i++) {
+        printf("%i : %f %f %f \n", i, pt_data[3*i+0], pt_data[3*i+1],
+                pt_data[3*i+2]);
+    }
+
+    printf("Time: %f s \n", time / ((float) nloops));
+
+    // the points updated per loop as the cells, the threads of the openmp
+    // versions from their name, umma.c is always built with -fopenmp
+    nthreads = 1;
+#ifdef _OPENMP
+    if (strstr(variant, "openmp") != NULL) {
+        nthreads = omp_get_max_threads();
+    }
+#endif
+    cody_report(variant, nprocs, nthreads, npoints, nloops, time);
+
+    if (results_file != NULL) {
+        f = fopen(results_file, "wb");
+        if (f == NULL || fwrite(pt_data, 3 * sizeof(float), npoints, f) !=
+                (size_t) npoints) {
+            printf("Error writing %s. \n", results_file);
+        }
+        if (f != NULL) {
+            fclose(f);
+        }
+    }
+}
+
+void umma_set_nprocs(int n) {
+    nprocs = n;
+}
+
+void umma_print_binding() {
+#ifdef _OPENMP
+    static const char* bind_names[] = {
+        "false", "true", "master", "close", "spread"
+    };
+    const char* places = getenv("OMP_PLACES");
+    int bind = (int) omp_get_proc_bind();
+
+    printf("Binding: %d threads, OMP_PROC_BIND=%s, OMP_PLACES=%s, "
+            "%d places \n", omp_get_max_threads(),
+            bind >= 0 && bind <= 4 ? bind_names[bind] : "?",
+            places != NULL ? places : "unset", omp_get_num_places());
+    if (bind == omp_proc_bind_false) {
+        // the threads may move off the NUMA node of the pages they touched
+        printf("Binding: unbound, pin the threads with OMP_PROC_BIND=close "
+                "OMP_PLACES=cores, or spread to use all the sockets with "
+                "fewer threads \n");
+    }
+#endif
+}
+
+double umma_phase_bytes(const struct umma_opts* opts, int phase,
+        int npoints, int nedges) {
+    double pt = 3 * sizeof(float);
+    double index = 2 * sizeof(int);
+    double value = sizeof(float);
+    // the temporaries stay floats whatever the forms of the edges
+    double tmp = 3 * sizeof(float);
+    double tmp_value = sizeof(float);
+
+    if (opts->index_form == INDEX_DELTA16) {
+        index = 2 * sizeof(short);
+    }
+    if (opts->value_form == VALUE_HALF) {
+        value = sizeof(unsigned short);
+    }
+    if (opts->accumulate == ACCUM_DOUBLE) {
+        pt = 3 * sizeof(double);
+    }
+
+    switch (phase) {
+        case PHASE_GATHER:
+            // the indices, the points and the value to the temporaries
+            return nedges * (index + 2 * pt + value + 2 * tmp + tmp_value);
+        case PHASE_COMPUTE:
+            // the temporaries read and written back
+            return nedges * (2 * tmp + tmp_value + 2 * tmp);
+        case PHASE_SCATTER:
+            // the indices and temporaries, and the points read and written
+            return nedges * (index + 2 * tmp + 4 * pt);
+        case PHASE_LOOP:
+            // the copy of the points at the start, then the edges
+            return 2.0 * npoints * pt +
+                nedges * (index + value + 2 * pt + 4 * pt);
+    }
+
+    return 0;
+}
+
+double umma_triad() {
+    double* a;
+    double* b;
+    double* c;
+    double t, best = 0;
+    long i;
+    int r;
+    size_t bytes = UMMA_TRIAD_SIZE * sizeof(double);
+
+    a = (double*) umma_alloc(bytes);
+    b = (double*) umma_alloc(bytes);
+    c = (double*) umma_alloc(bytes);
+    if (a == NULL || b == NULL || c == NULL) {
+        umma_free(a, bytes);
+        umma_free(b, bytes);
+        umma_free(c, bytes);
+        return 0;
+    }
+
+#pragma omp parallel for
+    for (i = 0; i < UMMA_TRIAD_SIZE; i++) {
+        a[i] = 0;
+        b[i] = 1;
+        c[i] = 2;
+    }
+
+    for (r = 0; r < 5; r++) {
+        t = timer();
+#pragma omp parallel for
+        for (i = 0; i < UMMA_TRIAD_SIZE; i++) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+        t = timer() - t;
+        if (t > 0 && 3.0 * bytes / t > best) {
+            best = 3.0 * bytes / t;
+        }
+    }
+
+    umma_free(a, bytes);
+    umma_free(b, bytes);
+    umma_free(c, bytes);
+
+    return best * 1e-9;
+}
+
+void umma_print_phases(const struct umma_opts* opts, const double* time,
+        int npoints, int nedges) {
+    static const char* names[UMMA_NPHASES] = {
+        "gather", "compute", "scatter", "loop"
+    };
+    double bytes = 0, total = 0, triad, gbs;
+    int p;
+
+    for (p = 0; p < UMMA_NPHASES; p++) {
+        if (time[p] <= 0) {
+            continue;
+        }
+        printf("Phase %s: %f s, %.2f GB/s \n", names[p],
+                time[p] / opts->nloops,
+                umma_phase_bytes(opts, p, npoints, nedges) * opts->nloops /
+                time[p] * 1e-9);
+        bytes += umma_phase_bytes(opts, p, npoints, nedges);
+        total += time[p];
+    }
+    if (total <= 0) {
+        return;
+    }
+    gbs = bytes * opts->nloops / total * 1e-9;
+    printf("Bandwidth: %.0f bytes per loop, %.2f GB/s \n", bytes, gbs);
+    cody_metric("GBs", gbs);
+
+    if (opts->stream) {
+        triad = umma_triad();
+        if (triad > 0) {
+            printf("Triad: %.2f GB/s, the loop at %.0f%% \n", triad,
+                    100 * gbs / triad);
+        }
+    }
+}
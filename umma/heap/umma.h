@@ -0,0 +1,281 @@
+#ifndef _umma_h_
+#define _umma_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* default graph sizes, the same as the stack versions */
+#define NPOINTS 10000
+#define NEDGES  10000
+
+/* alignment of the heap arrays, a cache line */
+#define UMMA_ALIGN 64
+
+/* arrays of at least this many bytes go on huge pages with --hugepages */
+#define UMMA_HUGE_PAGE (2 * 1024 * 1024)
+
+/* renumberings of the points, see umma_reorder */
+#define REORDER_NONE   0
+#define REORDER_SORT   1
+#define REORDER_BFS    2
+#define REORDER_RCM    3
+#define REORDER_DEGREE 4
+
+/* scatters of the OpenMP versions */
+#define SCATTER_ATOMIC  0
+#define SCATTER_COLOR   1
+#define SCATTER_PRIVATE 2
+/* and of the CUDA versions */
+#define SCATTER_WARP    3
+#define SCATTER_SORTED  4
+
+/* passes over the edges of a loop: the gather, compute and scatter phases
+ * each over all the edges, one fused pass that keeps nothing per edge, or
+ * the phases over one block of UMMA_BLOCK edges after the other */
+#define PASS_PHASES    0
+#define PASS_FUSED     1
+#define PASS_PIPELINED 2
+
+#define UMMA_BLOCK 1024
+
+/* the phases timed by the versions, see umma_phase_bytes: the gather,
+ * compute and scatter of PASS_PHASES, or the whole loop of the others */
+#define PHASE_GATHER  0
+#define PHASE_COMPUTE 1
+#define PHASE_SCATTER 2
+#define PHASE_LOOP    3
+#define UMMA_NPHASES  4
+
+/* doubles per array of the STREAM triad of --stream, 64MB, well past the
+ * caches */
+#define UMMA_TRIAD_SIZE (8 * 1024 * 1024)
+
+/* forms of --index, --edge-data and --accumulate: the point numbers of the
+ * edges as ints or as 16-bit deltas, see umma_index, the values of the
+ * edges as floats or halves, and the points summed as floats or doubles */
+#define INDEX_INT     0
+#define INDEX_DELTA16 1
+
+#define VALUE_FLOAT 0
+#define VALUE_HALF  1
+
+#define ACCUM_FLOAT  0
+#define ACCUM_DOUBLE 1
+
+/* partitions of the points over the ranks of the MPI version, or the
+ * threads of the soa OpenMP one with --edge-partition, see umma_partition */
+#define PARTITION_BLOCK 0
+#define PARTITION_RGB   1
+
+/* points and edges per block of the aosoa versions, a vector of floats */
+#define UMMA_LANES 8
+
+/* command-line options shared by the heap versions */
+struct umma_opts {
+    char* type;
+    char* fname;
+    int nloops;
+    /* points and edges asked of graph.lua, see create_graph */
+    int npoints;
+    int nedges;
+    int hugepages;
+    int reorder;
+    /* binary graph file to write, see umma_edges_save */
+    char* save;
+    int scatter;
+    int pass;
+    /* edges ahead of the gather to prefetch the points of, 0 for none, and
+     * points per gather instruction of the soa gathers, 1, 8 or 16 */
+    int prefetch;
+    int gather_width;
+    /* measure the STREAM triad after the run, see umma_print_phases */
+    int stream;
+    /* CUDA versions: the data on the device for all the loops */
+    int persistent;
+    /* ISPC versions: tasks launched over the edges, 0 for one core */
+    int tasks;
+    /* file to write all the points to at the end, see umma_print_results */
+    char* results;
+    /* soa versions: the compressed forms of the phases, INDEX_*, VALUE_*
+     * and ACCUM_* */
+    int index_form;
+    int value_form;
+    int accumulate;
+    /* MPI version: the partition of the points, PARTITION_* */
+    int partition;
+    /* soa OpenMP version: the points and their edges partitioned over the
+     * threads by partition, see umma_partition_edges */
+    int edge_partition;
+};
+
+/* the edges of a graph, 0-based, in the order graph.lua returns them */
+struct edge_list {
+    int npoints;
+    int nedges;
+    int* v0;
+    int* v1;
+};
+
+void print_help();
+
+double timer();
+
+/* parses the command line into opts, exits on --help or an error */
+int umma_parse_args(int argc, char** argv, struct umma_opts* opts);
+
+/* aligned arrays of bytes bytes, on huge pages if asked for. memory from
+ * umma_alloc must be released by umma_free with the same size */
+void* umma_alloc(size_t bytes);
+void umma_free(void* p, size_t bytes);
+
+/* builds the graph of opts. the number of edges is the one of the graph
+ * created, the number of points the larger of opts->npoints and the largest
+ * point of an edge plus one */
+int umma_edges_init(const struct umma_opts* opts, struct edge_list* el);
+void umma_edges_free(struct edge_list* el);
+
+/* out[3*j+k] = pt[3*v[j]+k] for j < n and k < 3: the gather of the points
+ * of n edges, width points per gather instruction (8 with AVX2, 16 with
+ * AVX-512, 1 for scalar loads), prefetching the points of the edge
+ * prefetch edges ahead if it is not 0 */
+void umma_gather_points(const float* pt, const int* v, float* out, int n,
+        int width, int prefetch);
+
+/* the point numbers of the edges as 16-bit deltas, decoded a block of
+ * UMMA_BLOCK edges at a time. in block b, v0 starts at base[b] and each edge
+ * adds its d0 to it, and v1 is v0 plus d1. a delta that does not fit is
+ * UMMA_ESCAPE, and the point number is the next one of wide, from
+ * wide[wide_start[b]], v0 before v1 */
+#define UMMA_ESCAPE (-32768)
+
+struct umma_index {
+    int nedges;
+    int nblocks;
+    short* d0;
+    short* d1;
+    int* base;
+    int* wide_start;
+    int nwide;
+    int* wide;
+};
+
+/* encodes the edges of el, best sorted by (v0, v1) after --reorder, and
+ * prints how many deltas did not fit. returns -1 if out of memory */
+int umma_index_init(const struct edge_list* el, struct umma_index* ix);
+void umma_index_free(struct umma_index* ix);
+
+/* the point numbers of the edges of block b into v0 and v1, UMMA_BLOCK of
+ * them at most, returns the number of edges of the block */
+int umma_index_decode(const struct umma_index* ix, int b, int* v0, int* v1);
+
+/* h[i] = f[i] rounded to the nearest half, an IEEE binary16 in an unsigned
+ * short, and back, for i < n, by F16C where the CPU has it */
+void umma_float_to_half(const float* f, unsigned short* h, int n);
+void umma_half_to_float(const unsigned short* h, float* f, int n);
+
+/* the binary graph file of --type binary and --save: this header, then
+ * nedges ints of v0 and nedges ints of v1, 0-based, in host byte order */
+#define UMMA_MAGIC "UMMAGRF1"
+
+struct umma_file_header {
+    char magic[8];
+    int npoints;
+    int nedges;
+};
+
+/* read and write el as a binary graph file, return -1 on an error */
+int umma_edges_load(const char* fname, struct edge_list* el);
+int umma_edges_save(const char* fname, const struct edge_list* el);
+
+/* the edges by color, no two edges of a color share a point. the edges of
+ * color c are edges[start[c]] .. edges[start[c + 1] - 1] */
+struct edge_colors {
+    int ncolors;
+    int* start;
+    int* edges;
+};
+
+/* colors the edges of el greedily, return -1 if out of memory */
+int umma_color_edges(const struct edge_list* el, struct edge_colors* ec);
+void umma_colors_free(struct edge_colors* ec);
+
+/* the edges at each point, both ways along each edge: the other points of
+ * the edges at point p are adj[start[p]] .. adj[start[p + 1] - 1], and the
+ * ends of the edges at p end[start[p]] .. end[start[p + 1] - 1], 2 * i for
+ * the v0 end of edge i and 2 * i + 1 for its v1 end */
+struct point_csr {
+    int npoints;
+    int nadj;
+    int* start;
+    int* adj;
+    int* end;
+};
+
+/* builds the csr of el, return -1 if out of memory */
+int umma_csr_init(const struct edge_list* el, struct point_csr* csr);
+void umma_csr_free(struct point_csr* csr);
+
+/* the part of each point of el in part, nparts parts of as near equal
+ * work as can be, a point weighing its edges plus one: by PARTITION_BLOCK
+ * runs of consecutive points, best after --reorder, by PARTITION_RGB the
+ * points split in two recursively along their breadth first order from a
+ * far point (recursive graph bisection), so that a part is a connected
+ * region of the graph where it can be. returns -1 if out of memory */
+int umma_partition(int method, const struct edge_list* el, int nparts,
+        int* part);
+
+/* partitions the points of el over nparts threads by method and
+ * renumbers them so that part t is the points pt_start[t] ..
+ * pt_start[t + 1] - 1, in their order before, then sorts the edges by
+ * (v0, v1), so that the edges of the points of part t are edge_start[t] ..
+ * edge_start[t + 1] - 1. order[p] is the number of point p before, the
+ * arrays have npoints and nparts + 1 entries. prints the edges whose v1 is
+ * on another part on a 'Partition:' line, returns -1 if out of memory */
+int umma_partition_edges(int method, struct edge_list* el, int nparts,
+        int* order, int* pt_start, int* edge_start);
+
+/* renumbers the points of el by opts->reorder and sorts its edges by
+ * (v0, v1), printing the speedup of a gather and scatter over the edges.
+ * umma_edges_init calls it, returns -1 if out of memory */
+int umma_reorder(const struct umma_opts* opts, struct edge_list* el);
+
+/* prints the first points of pt_data, 3 floats per point, and the time per
+ * loop. with --results it also writes all the points to that file, as
+ * npoints * 3 floats in host byte order */
+void umma_print_results(const float* pt_data, int npoints, double time,
+        int nloops);
+
+/* the ranks of the run for the CODY rows of umma_print_results, 1 unless
+ * the MPI version sets it */
+void umma_set_nprocs(int nprocs);
+
+/* prints the OpenMP threads and how they are bound to the places on a
+ * 'Binding:' line, and how to pin them if they are not, as the data is
+ * placed on the NUMA node of the thread that first touches it */
+void umma_print_binding();
+
+/* bytes a loop reads and writes in phase, from the accesses of the edge
+ * loops: the two point numbers and the value of each edge, the points at
+ * both its ends and the temporaries between the phases, in the forms of
+ * opts, the escapes of the deltas aside */
+double umma_phase_bytes(const struct umma_opts* opts, int phase,
+        int npoints, int nedges);
+
+/* the GB/s of a STREAM triad over arrays of UMMA_TRIAD_SIZE doubles, the
+ * best of a few runs, on the OpenMP threads */
+double umma_triad();
+
+/* prints the time per loop and the GB/s of each phase with a time, the
+ * phases accumulated over nloops loops, and with opts->stream the triad and
+ * the fraction of it the loop reaches */
+void umma_print_phases(const struct umma_opts* opts, const double* time,
+        int npoints, int nedges);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
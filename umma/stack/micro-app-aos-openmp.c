@@ -100,6 +100,8 @@ int graph_init(char* graph_type, char* fname) {
 int data_init() {
     int i;
 
+#pragma omp parallel for \
+    private(i)
     for (i = 0; i < NPOINTS; i++) {
         pt_data[i][0] = 1;
         pt_data[i][1] = 1;
@@ -112,6 +114,8 @@ int data_init() {
 int edge_data_init() {
     int i;
 
+#pragma omp parallel for \
+    private(i)
     for (i = 0; i < NEDGES; i++) {
         edge_data[i] = 1;
     }
@@ -44,7 +44,7 @@ double timer() {
 
 int graph_init(char* graph_type, char* fname) {
     lua_State *L;
-    int i, j, k, v;
+    int i, k, v;
 
     L = luaL_newstate();
     luaL_openlibs(L);
@@ -74,15 +74,11 @@ int graph_init(char* graph_type, char* fname) {
             lua_pop(L,1);
             v = lua_tointeger(L, -1);
 
-            // build the graph
+            // build the graph, the temporaries are first touched by
+            // edge_data_init
             gr.v0[i] = k - 1;
             gr.v1[i] = v - 1;
 
-            for (j = 0; j < 3; j++) {
-                gr.v0_data[i][j] = 0;
-                gr.v1_data[i][j] = 0;
-            }
-
             i++;
         }
         lua_pop(L,1);
@@ -100,6 +96,8 @@ int graph_init(char* graph_type, char* fname) {
 int data_init() {
     int i;
 
+#pragma omp parallel for \
+    private(i)
     for (i = 0; i < NPOINTS; i++) {
         pt_data[i][0] = 1;
         pt_data[i][1] = 1;
@@ -110,10 +108,18 @@ int data_init() {
 }
 
 int edge_data_init() {
-    int i;
+    int i, j;
 
+#pragma omp parallel for \
+    private(i, j)
     for (i = 0; i < NEDGES; i++) {
         edge_data[i] = 1;
+
+        for (j = 0; j < 3; j++) {
+            gr.v0_data[i][j] = 0;
+            gr.v1_data[i][j] = 0;
+        }
+        gr.data[i] = 0;
     }
 
     return 0;